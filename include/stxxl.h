@@ -20,19 +20,30 @@
 #include <stxxl/priority_queue>
 #include <stxxl/stack>
 #include <stxxl/vector>
+#include <stxxl/bit_vector>
+#include <stxxl/var_vector>
+#include <stxxl/compressed_graph>
+#include <stxxl/string_sorter>
+#include <stxxl/inverted_index>
 #if ! defined(__GNUG__) || ((__GNUC__ * 10000 + __GNUC_MINOR__ * 100) >= 30400)
 // map does not work with g++ 3.3
 #include <stxxl/map>
 #endif
 #include <stxxl/deque>
+#include <stxxl/block_deque>
 #include <stxxl/queue>
+#include <stxxl/concurrent_queue>
+#include <stxxl/migrating>
 #include <stxxl/unordered_map>
+#include <stxxl/var_unordered_map>
 
 #include <stxxl/algorithm>
 
 #include <stxxl/comparator>
 
 #include <stxxl/seed>
+#include <stxxl/memory_manager>
+#include <stxxl/stats_sampler>
 
 #include <stxxl/stream>
 
@@ -0,0 +1,284 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/balanced_prefetcher.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_BALANCED_PREFETCHER_HEADER
+#define STXXL_ALGO_BALANCED_PREFETCHER_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/io/request.hpp>
+#include <foxxll/mng/block_prefetcher.hpp>
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/algo/sort_base.h>
+#include <stxxl/bits/common/block_array.h>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+/*!
+ * Prefetcher of the blocks of sorted runs, a drop-in replacement for
+ * foxxll::block_prefetcher which balances the outstanding reads over the
+ * disks.
+ *
+ * The blocks are consumed in the order of the consume sequence and read in the
+ * order of the precomputed prefetch sequence, but whenever a buffer is
+ * returned, the next read is chosen among the next few blocks of the prefetch
+ * sequence as the one on the disk with the fewest reads in flight. Completed
+ * requests are polled before each choice, so the schedule follows the actual
+ * progress of the disks instead of the order of the trigger keys alone. A
+ * block being consumed before it was read is fetched immediately.
+ */
+template <typename BlockType, typename BidIteratorType>
+class balanced_prefetcher
+{
+    static constexpr bool debug = false;
+
+public:
+    using block_type = BlockType;
+    using bid_iterator_type = BidIteratorType;
+    using bid_type = typename block_type::bid_type;
+
+protected:
+    bid_iterator_type consume_seq_begin;
+    const size_t seq_length;
+
+    //! precomputed order of the reads
+    const size_t* const prefetch_seq;
+    //! position of the first block in prefetch_seq which was not read yet
+    size_t nextread;
+    //! next block to be consumed
+    size_t nextconsume;
+
+    const size_t nreadblocks;
+    //! number of blocks of prefetch_seq considered for the next read
+    const size_t window;
+
+    block_type* read_buffers;
+    std::vector<foxxll::request_ptr> read_reqs;
+
+    //! buffer holding each block, or nreadblocks if not read yet
+    std::vector<size_t> buffer_of;
+    //! block read into each buffer
+    std::vector<size_t> block_in;
+    //! disk of each block
+    std::vector<size_t> disk_of;
+    //! number of reads in flight per disk
+    std::vector<size_t> disk_load;
+
+    //! buffers currently not in use
+    std::vector<size_t> free_buffers;
+    //! buffers with read requests which were not yet seen completed
+    std::vector<size_t> inflight;
+
+    //! Remove the request of inflight[i] and decrease the load of its disk.
+    void completed(size_t i)
+    {
+        --disk_load[disk_of[block_in[inflight[i]]]];
+        inflight[i] = inflight.back();
+        inflight.pop_back();
+    }
+
+    //! Account for all requests which completed meanwhile.
+    void poll_completed()
+    {
+        for (size_t i = 0; i < inflight.size(); )
+        {
+            if (read_reqs[inflight[i]]->poll())
+                completed(i);
+            else
+                ++i;
+        }
+    }
+
+    //! Read block iblock of the consume sequence into a free buffer.
+    void issue(size_t iblock)
+    {
+        assert(!free_buffers.empty());
+        const size_t ibuffer = free_buffers.back();
+        free_buffers.pop_back();
+
+        TLX_LOG << "balanced_prefetcher: read block " << iblock
+                << " from disk " << disk_of[iblock]
+                << " load " << disk_load[disk_of[iblock]];
+
+        const bid_type bid = consume_seq_begin[iblock];
+        read_reqs[ibuffer] = read_buffers[ibuffer].read(bid);
+        buffer_of[iblock] = ibuffer;
+        block_in[ibuffer] = iblock;
+        ++disk_load[disk_of[iblock]];
+        inflight.push_back(ibuffer);
+    }
+
+    //! Read the block on the least loaded disk among the next window blocks
+    //! of the prefetch sequence.
+    void issue_balanced()
+    {
+        while (nextread < seq_length && buffer_of[prefetch_seq[nextread]] != nreadblocks)
+            ++nextread;
+        if (nextread == seq_length)
+            return;
+
+        poll_completed();
+
+        size_t best = prefetch_seq[nextread];
+        size_t candidates = 1;
+        for (size_t i = nextread + 1; i < seq_length && candidates < window; ++i)
+        {
+            const size_t iblock = prefetch_seq[i];
+            if (buffer_of[iblock] != nreadblocks)
+                continue;
+            if (disk_load[disk_of[iblock]] < disk_load[disk_of[best]])
+                best = iblock;
+            ++candidates;
+        }
+        issue(best);
+    }
+
+    block_type * wait(size_t iblock)
+    {
+        const size_t ibuffer = buffer_of[iblock];
+        TLX_LOG << "balanced_prefetcher: waiting block " << iblock;
+        read_reqs[ibuffer]->wait();
+
+        const auto it = std::find(inflight.begin(), inflight.end(), ibuffer);
+        if (it != inflight.end())
+            completed(static_cast<size_t>(it - inflight.begin()));
+        return read_buffers + ibuffer;
+    }
+
+public:
+    //! Constructs an object and immediately starts prefetching.
+    //! \param cons_begin \c bid_iterator pointing to the \c bid of the first block to be consumed
+    //! \param cons_end \c bid_iterator pointing to the \c bid of the ( \b last + 1 ) block of consumption sequence
+    //! \param pref_seq gives the prefetch order, is a pointer to the integer array that contains
+    //!        the indices of the blocks in the consumption sequence
+    //! \param prefetch_buf_size amount of prefetch buffers to use
+    balanced_prefetcher(bid_iterator_type cons_begin,
+                        bid_iterator_type cons_end,
+                        size_t* pref_seq,
+                        size_t prefetch_buf_size)
+        : consume_seq_begin(cons_begin),
+          seq_length(cons_end - cons_begin),
+          prefetch_seq(pref_seq),
+          nextread(0),
+          nextconsume(0),
+          nreadblocks(std::min(prefetch_buf_size, seq_length)),
+          window(std::max<size_t>(
+                     1, std::min<size_t>(
+                         nreadblocks, 2 * foxxll::config::get_instance()->disks_number()))),
+          read_buffers(new_block_array<block_type>(nreadblocks)),
+          read_reqs(nreadblocks),
+          buffer_of(seq_length, nreadblocks),
+          block_in(nreadblocks),
+          disk_of(seq_length)
+    {
+        TLX_LOG << "balanced_prefetcher: seq_length=" << seq_length
+                << " buffers=" << nreadblocks << " window=" << window;
+
+        size_t ndevices = 0;
+        for (size_t i = 0; i < seq_length; ++i)
+        {
+            const bid_type bid = consume_seq_begin[i];
+            disk_of[i] = static_cast<size_t>(bid.storage->get_device_id());
+            ndevices = std::max(ndevices, disk_of[i] + 1);
+        }
+        disk_load.resize(ndevices, 0);
+
+        free_buffers.reserve(nreadblocks);
+        for (size_t i = nreadblocks; i > 0; --i)
+            free_buffers.push_back(i - 1);
+        inflight.reserve(nreadblocks);
+
+        // the first buffers are filled in schedule order, they must hold the
+        // blocks pulled before any is consumed
+        for ( ; nextread < nreadblocks; ++nextread)
+            issue(prefetch_seq[nextread]);
+    }
+
+    //! non-copyable: delete copy-constructor
+    balanced_prefetcher(const balanced_prefetcher&) = delete;
+    //! non-copyable: delete assignment operator
+    balanced_prefetcher& operator = (const balanced_prefetcher&) = delete;
+
+    //! Pulls next unconsumed block from the consumption sequence.
+    //! \return Pointer to the already prefetched block from the internal buffer pool
+    block_type * pull_block()
+    {
+        assert(nextconsume < seq_length);
+        const size_t iblock = nextconsume++;
+        if (buffer_of[iblock] == nreadblocks)
+            issue(iblock);
+        return wait(iblock);
+    }
+
+    //! Exchanges buffers between prefetcher and application.
+    //! \param buffer pointer to the consumed buffer. After call if return value is true \c buffer
+    //!        contains valid pointer to the next unconsumed prefetched buffer.
+    //! \remark parameter \c buffer must be value returned by \c pull_block() or \c block_consumed() methods
+    //! \return \c false if there are no blocks to prefetch left, \c true if consumption sequence is not emptied
+    bool block_consumed(block_type*& buffer)
+    {
+        free_buffers.push_back(static_cast<size_t>(buffer - read_buffers));
+
+        // the freed buffer goes to the next consumed block if it was not
+        // read yet, pull_block() fetches it
+        if (nextconsume < seq_length && buffer_of[nextconsume] != nreadblocks)
+            issue_balanced();
+
+        if (nextconsume >= seq_length)
+            return false;
+
+        buffer = pull_block();
+        return true;
+    }
+
+    //! No more consumable blocks available, but can't delete the
+    //! prefetcher, because not all blocks may have been returned, yet.
+    bool empty() const
+    {
+        return nextconsume >= seq_length;
+    }
+
+    //! Index of the next element in the consume sequence.
+    size_t pos() const
+    {
+        return nextconsume;
+    }
+
+    //! Frees used memory.
+    ~balanced_prefetcher()
+    {
+        for (size_t ibuffer : inflight)
+            read_reqs[ibuffer]->wait();
+        delete_block_array(read_buffers, nreadblocks);
+    }
+};
+
+//! Prefetcher of the run mergers of the sorters.
+template <typename BlockType, typename BidIteratorType>
+using run_prefetcher =
+#if STXXL_SORT_BALANCED_PREFETCHING
+          balanced_prefetcher<BlockType, BidIteratorType>;
+#else
+          foxxll::block_prefetcher<BlockType, BidIteratorType>;
+#endif
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_BALANCED_PREFETCHER_HEADER
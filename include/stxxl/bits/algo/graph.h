@@ -0,0 +1,1122 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/graph.h
+ *
+ *  External memory breadth first search as described in Kameshwar Munagala
+ *  and Abhiram Ranade. "I/O-complexity of graph algorithms". SODA 1999, and
+ *  Kurt Mehlhorn and Ulrich Meyer. "External-Memory Breadth-First Search with
+ *  Sublinear I/O". ESA 2002, and connected components by edge contraction
+ *  as in Yi-Jen Chiang et al. "External-Memory Graph Algorithms". SODA 1995.
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_GRAPH_HEADER
+#define STXXL_ALGO_GRAPH_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io/iostats.hpp>
+
+#include <stxxl/bits/algo/list_rank.h>
+#include <stxxl/bits/common/comparator.h>
+#include <stxxl/bits/containers/sorter.h>
+#include <stxxl/bits/containers/vector.h>
+#include <stxxl/bits/stream/stream.h>
+#include <stxxl/bits/stream/unique.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+//! Breadth first search algorithm of stxxl::breadth_first_search().
+enum class bfs_algorithm
+{
+    //! reads the adjacency list of each node with random I/Os
+    munagala_ranade,
+    //! reads clusters of adjacency lists into a hot pool, which is scanned
+    //! once per level
+    mehlhorn_meyer
+};
+
+//! I/O volume and time of one phase of a graph algorithm.
+struct graph_phase_profile
+{
+    //! name of the phase
+    std::string name;
+    //! I/Os of the phase
+    uint64_t read_count, write_count, read_bytes, write_bytes;
+    //! seconds waiting for I/O and of the whole phase
+    double io_wait_time, elapsed_time;
+};
+
+//! Phases of a graph algorithm in the order they ran.
+using graph_profile = std::vector<graph_phase_profile>;
+
+namespace graph_local {
+
+static constexpr bool debug = false;
+
+//! Records the I/O statistics of consecutive phases into a graph_profile.
+class phase_recorder
+{
+    graph_profile* m_profile;
+    foxxll::stats_data m_begin;
+    double m_time;
+
+public:
+    explicit phase_recorder(graph_profile* profile)
+        : m_profile(profile),
+          m_begin(*foxxll::stats::get_instance()),
+          m_time(foxxll::timestamp())
+    {
+        if (m_profile)
+            m_profile->clear();
+    }
+
+    //! End the current phase and begin the next.
+    void end(const char* name)
+    {
+        const foxxll::stats_data now(*foxxll::stats::get_instance());
+        const double time = foxxll::timestamp();
+        const foxxll::stats_data io = now - m_begin;
+
+        TLX_LOGC(debug) << "graph phase " << name << ": read " << io.get_read_bytes()
+                        << " bytes, wrote " << io.get_write_bytes() << " bytes";
+
+        if (m_profile) {
+            graph_phase_profile p;
+            p.name = name;
+            p.read_count = io.get_read_count();
+            p.write_count = io.get_write_count();
+            p.read_bytes = io.get_read_bytes();
+            p.write_bytes = io.get_write_bytes();
+            p.io_wait_time = io.get_io_wait_time();
+            p.elapsed_time = time - m_time;
+            m_profile->push_back(p);
+        }
+        m_begin = now;
+        m_time = time;
+    }
+};
+
+//! Reads the elements of a vector at nondecreasing indexes in one scan.
+template <typename Vector>
+class monotone_reader
+{
+    typename Vector::bufreader_type m_reader;
+    external_size_type m_index;
+
+public:
+    explicit monotone_reader(const Vector& v) : m_reader(v), m_index(0) { }
+
+    const typename Vector::value_type& operator () (external_size_type i)
+    {
+        assert(i >= m_index);
+        for ( ; m_index < i; ++m_index)
+            ++m_reader;
+        return *m_reader;
+    }
+};
+
+/*!
+ * Graph kernels on the symmetric adjacency array of an undirected graph:
+ * the edges (u, v) and (v, u) of each edge sorted by (u, v), without
+ * duplicates and self-loops.
+ *
+ * \param NodeId node id type
+ */
+template <typename NodeId>
+class kernels
+{
+public:
+    using size_type = external_size_type;
+
+    //! (u, v)
+    using edge_type = std::tuple<NodeId, NodeId>;
+    using edge_less = stxxl::comparator<edge_type, stxxl::direction::Less, stxxl::direction::Less>;
+    using edge_sorter_type = stxxl::sorter<edge_type, edge_less>;
+    using edge_vector_type = stxxl::vector<edge_type>;
+
+    using id_vector_type = stxxl::vector<NodeId>;
+
+    //! (node, cluster of node)
+    using node_cluster_type = std::tuple<NodeId, NodeId>;
+    //! (u, v, cluster of v)
+    using pool_edge_type = std::tuple<NodeId, NodeId, NodeId>;
+    using pool_vector_type = stxxl::vector<pool_edge_type>;
+
+    //! node marking the absence of a node
+    static NodeId none()
+    {
+        return std::numeric_limits<NodeId>::max();
+    }
+
+    //! Throw if the node ids and twice their number do not fit into NodeId.
+    static void check_nodes(size_type n, const char* function)
+    {
+        if (2 * n + 1 >= static_cast<size_type>(none()))
+            throw foxxll::bad_parameter(std::string(function) + ": graph is too large for the node type");
+    }
+
+    //! Sort both directions of the edges, dropping duplicates and self-loops.
+    template <typename EdgeVector>
+    static void symmetrize(const EdgeVector& edges, size_type n, edge_vector_type& adj,
+                           size_t mem, const char* function)
+    {
+        edge_sorter_type sorter(edge_less(), mem);
+        for (typename EdgeVector::bufreader_type in(edges); !in.empty(); ++in)
+        {
+            const NodeId u = std::get<0>(*in), v = std::get<1>(*in);
+            if (static_cast<size_type>(u) >= n || static_cast<size_type>(v) >= n)
+                throw foxxll::bad_parameter(std::string(function) + ": edge endpoint out of range");
+            if (u == v)
+                continue;
+            sorter.push(edge_type(u, v));
+            sorter.push(edge_type(v, u));
+        }
+        sorter.sort();
+
+        stream::unique<edge_sorter_type> unique(sorter);
+        adj.clear();
+        typename edge_vector_type::bufwriter_type writer(adj);
+        for ( ; !unique.empty(); ++unique)
+            writer << *unique;
+        writer.finish();
+    }
+
+    //! \name Levels of breadth first search
+    //! \{
+
+    //! Write the nodes of the sorted stream, without duplicates, which are
+    //! neither in a nor in b, both sorted, to out.
+    template <typename Stream, typename Vector, typename OutVector>
+    static void subtract(Stream& s, const Vector& a, const Vector& b, OutVector& out)
+    {
+        typename Vector::bufreader_type ra(a), rb(b);
+        out.clear();
+        typename OutVector::bufwriter_type writer(out);
+        bool first = true;
+        NodeId last = 0;
+        for ( ; !s.empty(); ++s)
+        {
+            const NodeId v = std::get<0>(*s);
+            if (!first && v == last)
+                continue;
+            first = false;
+            last = v;
+
+            while (!ra.empty() && std::get<0>(*ra) < v) ++ra;
+            while (!rb.empty() && std::get<0>(*rb) < v) ++rb;
+            if ((ra.empty() || std::get<0>(*ra) != v) && (rb.empty() || std::get<0>(*rb) != v))
+                writer << *s;
+        }
+        writer.finish();
+    }
+
+    //! Write dist[v] = level of v from the sorted (v, level) pairs, with the
+    //! maximum of DistVector's value_type for unreached nodes.
+    template <typename LevelSorter, typename DistVector>
+    static void write_distances(LevelSorter& levels, size_type n, DistVector& dist)
+    {
+        using dist_type = typename DistVector::value_type;
+        levels.sort();
+        dist.clear();
+        typename DistVector::bufwriter_type writer(dist);
+        for (size_type v = 0; v < n; ++v)
+        {
+            if (!levels.empty() && static_cast<size_type>(std::get<0>(*levels)) == v) {
+                writer << static_cast<dist_type>(std::get<1>(*levels));
+                ++levels;
+            }
+            else
+                writer << std::numeric_limits<dist_type>::max();
+        }
+        writer.finish();
+    }
+
+    //! \}
+
+    //! Breadth first search by Munagala and Ranade, reading the adjacency
+    //! list of each node of a level through the offsets of the lists.
+    template <typename DistVector>
+    static void bfs_mr(const edge_vector_type& adj, size_type n, NodeId source,
+                       DistVector& dist, size_t mem, phase_recorder& phases)
+    {
+        // first edge of each node
+        stxxl::vector<size_type> offsets;
+        {
+            typename stxxl::vector<size_type>::bufwriter_type writer(offsets);
+            typename edge_vector_type::bufreader_type in(adj);
+            size_type pos = 0;
+            for (size_type v = 0; v <= n; ++v)
+            {
+                while (!in.empty() && static_cast<size_type>(std::get<0>(*in)) < v)
+                    ++in, ++pos;
+                writer << pos;
+            }
+            writer.finish();
+        }
+        phases.end("adjacency offsets");
+
+        using level_type = std::tuple<NodeId, NodeId>;
+        using level_less = stxxl::comparator<level_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+        stxxl::sorter<level_type, level_less> levels(level_less(), mem / 4);
+
+        using node_less = stxxl::comparator<std::tuple<NodeId>, stxxl::direction::Less>;
+        using node_sorter_type = stxxl::sorter<std::tuple<NodeId>, node_less>;
+        using node_vector_type = stxxl::vector<std::tuple<NodeId> >;
+
+        node_vector_type prev, curr, next;
+        curr.push_back(std::tuple<NodeId>(source));
+
+        for (NodeId t = 0; !curr.empty(); ++t)
+        {
+            node_sorter_type neighbors(node_less(), mem / 2);
+            for (typename node_vector_type::bufreader_type in(curr); !in.empty(); ++in)
+            {
+                const NodeId v = std::get<0>(*in);
+                levels.push(level_type(v, t));
+                const size_type begin = offsets[v], end = offsets[v + 1];
+                for (typename edge_vector_type::const_iterator e = adj.cbegin() + begin;
+                     e != adj.cbegin() + end; ++e)
+                    neighbors.push(std::tuple<NodeId>(std::get<1>(*e)));
+            }
+            neighbors.sort();
+
+            subtract(neighbors, curr, prev, next);
+            prev.swap(curr);
+            curr.swap(next);
+        }
+        phases.end("levels");
+
+        write_distances(levels, n, dist);
+        phases.end("distances");
+    }
+
+    //! \name Connected components by random mating
+    //! \{
+
+    //! Contracted edge (u, v), with the original edge (a, b) if the spanning
+    //! forest is requested.
+    template <bool Forest>
+    using cedge_type = typename std::conditional<
+              Forest, std::tuple<NodeId, NodeId, NodeId, NodeId>, edge_type>::type;
+
+    static void init_cedge(edge_type& c, const edge_type& e)
+    {
+        c = e;
+    }
+
+    static void init_cedge(std::tuple<NodeId, NodeId, NodeId, NodeId>& c, const edge_type& e)
+    {
+        c = std::make_tuple(std::get<0>(e), std::get<1>(e), std::get<0>(e), std::get<1>(e));
+    }
+
+    static edge_type original(const std::tuple<NodeId, NodeId, NodeId, NodeId>& c)
+    {
+        return edge_type(std::get<2>(c), std::get<3>(c));
+    }
+
+    static edge_type original(const edge_type& c)
+    {
+        return c;
+    }
+
+    //! equality of the contracted endpoints
+    struct same_cedge
+    {
+        template <typename CEdge>
+        bool operator () (const CEdge& a, const CEdge& b) const
+        {
+            return std::get<0>(a) == std::get<0>(b) && std::get<1>(a) == std::get<1>(b);
+        }
+    };
+
+    //! Merge the (node, label) pairs sorted by node of a and b into out.
+    static void merge_labels(const edge_vector_type& a, const edge_vector_type& b,
+                             edge_vector_type& out)
+    {
+        typename edge_vector_type::bufreader_type ra(a), rb(b);
+        out.clear();
+        typename edge_vector_type::bufwriter_type writer(out);
+        while (!ra.empty() || !rb.empty())
+        {
+            if (rb.empty() || (!ra.empty() && std::get<0>(*ra) < std::get<0>(*rb)))
+                writer << *ra, ++ra;
+            else
+                writer << *rb, ++rb;
+        }
+        writer.finish();
+    }
+
+    /*!
+     * Union-find in internal memory of the nodes of the contracted edges,
+     * writing (node, label) sorted by node, where the label of a component
+     * is its smallest node, and the edges joining two components to forest.
+     */
+    template <bool Forest>
+    static void union_find(const stxxl::vector<cedge_type<Forest> >& edges, edge_vector_type& labels,
+                           typename edge_vector_type::bufwriter_type* forest)
+    {
+        using cedge_vector_type = stxxl::vector<cedge_type<Forest> >;
+
+        std::vector<NodeId> ids;
+        for (typename cedge_vector_type::bufreader_type in(edges); !in.empty(); ++in)
+        {
+            if (ids.empty() || ids.back() != std::get<0>(*in))
+                ids.push_back(std::get<0>(*in));
+        }
+
+        std::vector<size_t> parent(ids.size());
+        for (size_t i = 0; i < parent.size(); ++i)
+            parent[i] = i;
+
+        auto find = [&parent](size_t i) {
+                        while (parent[i] != i)
+                            i = parent[i] = parent[parent[i]];
+                        return i;
+                    };
+        auto index = [&ids](const NodeId& v) {
+                         return static_cast<size_t>(
+                             std::lower_bound(ids.begin(), ids.end(), v) - ids.begin());
+                     };
+
+        for (typename cedge_vector_type::bufreader_type in(edges); !in.empty(); ++in)
+        {
+            // each edge is present in both directions
+            if (!(std::get<0>(*in) < std::get<1>(*in)))
+                continue;
+            const size_t a = find(index(std::get<0>(*in))), b = find(index(std::get<1>(*in)));
+            if (a == b)
+                continue;
+            parent[std::max(a, b)] = std::min(a, b);
+            if (forest)
+                *forest << original(*in);
+        }
+
+        labels.clear();
+        typename edge_vector_type::bufwriter_type writer(labels);
+        for (size_t i = 0; i < ids.size(); ++i)
+            writer << edge_type(ids[i], ids[find(i)]);
+        writer.finish();
+    }
+
+    /*!
+     * Label the components of the symmetric adjacency array adj: label[v]
+     * receives a node of v's component, the same for all its nodes, and
+     * with Forest the edges of a spanning forest are written to forest.
+     *
+     * Each round flips a coin for each node and hooks the tails to their
+     * smallest neighbor among the heads, which contracts a quarter of the
+     * nodes with edges in expectation. The edges are relabeled by two sorts
+     * and deduplicated. Once the nodes with edges fit into internal memory,
+     * union-find on one scan of the edges finishes the contraction, after
+     * which the hooks are replayed backwards. Returns whether the labels
+     * are the smallest nodes of the components.
+     */
+    template <bool Forest>
+    static bool components(const edge_vector_type& adj, size_type n, id_vector_type& label,
+                           edge_vector_type* forest, size_t mem, phase_recorder& phases)
+    {
+        using cedge = cedge_type<Forest>;
+        using cedge_vector_type = stxxl::vector<cedge>;
+        using source_less = typename std::conditional<
+                  Forest, stxxl::comparator<cedge, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare, stxxl::direction::DontCare>,
+                  stxxl::comparator<cedge, stxxl::direction::Less, stxxl::direction::DontCare> >::type;
+        using cedge_less = typename std::conditional<
+                  Forest, stxxl::comparator<cedge, stxxl::direction::Less, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare>,
+                  stxxl::comparator<cedge, stxxl::direction::Less, stxxl::direction::Less> >::type;
+        using source_sorter_type = stxxl::sorter<cedge, source_less>;
+        using cedge_sorter_type = stxxl::sorter<cedge, cedge_less>;
+        using label_less = stxxl::comparator<edge_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+        using label_sorter_type = stxxl::sorter<edge_type, label_less>;
+
+        // node sizes of union-find: id and parent
+        const size_type node_bytes = sizeof(NodeId) + sizeof(size_t);
+
+        std::unique_ptr<typename edge_vector_type::bufwriter_type> forest_writer;
+        if (forest) {
+            forest->clear();
+            forest_writer.reset(new typename edge_vector_type::bufwriter_type(*forest));
+        }
+
+        cedge_vector_type edges;
+        size_type nodes = 0;
+        {
+            typename cedge_vector_type::bufwriter_type writer(edges);
+            NodeId last = none();
+            for (typename edge_vector_type::bufreader_type in(adj); !in.empty(); ++in)
+            {
+                cedge c;
+                init_cedge(c, *in);
+                writer << c;
+                if (std::get<0>(*in) != last)
+                    ++nodes, last = std::get<0>(*in);
+            }
+            writer.finish();
+        }
+
+        // (u, h) of the nodes hooked in each round, sorted by u
+        std::vector<std::unique_ptr<edge_vector_type> > hooks;
+        edge_vector_type labels;
+
+        for (unsigned round = 0; !edges.empty(); ++round)
+        {
+            if (nodes * node_bytes <= mem / 2) {
+                union_find<Forest>(edges, labels, forest_writer.get());
+                edges.clear();
+                phases.end("union-find");
+                break;
+            }
+
+            TLX_LOGC(debug) << "components(): round " << round << " with " << nodes
+                            << " nodes and " << edges.size() << " edges";
+
+            // hook tails to their smallest head neighbor
+            hooks.emplace_back(new edge_vector_type);
+            {
+                typename edge_vector_type::bufwriter_type writer(*hooks.back());
+                NodeId last = none();
+                for (typename cedge_vector_type::bufreader_type in(edges); !in.empty(); ++in)
+                {
+                    const NodeId u = std::get<0>(*in), v = std::get<1>(*in);
+                    if (u == last || list_rank_local::coin(u, round))
+                        continue;
+                    if (list_rank_local::coin(v, round)) {
+                        writer << edge_type(u, v);
+                        if (forest_writer)
+                            *forest_writer << original(*in);
+                        last = u;
+                    }
+                }
+                writer.finish();
+            }
+            const edge_vector_type& hook = *hooks.back();
+
+            // relabel the sources, emitting the reversed edges
+            source_sorter_type reversed(source_less(), mem / 2);
+            {
+                typename edge_vector_type::bufreader_type h(hook);
+                for (typename cedge_vector_type::bufreader_type in(edges); !in.empty(); ++in)
+                {
+                    cedge c = *in;
+                    while (!h.empty() && std::get<0>(*h) < std::get<0>(c)) ++h;
+                    const NodeId u = (!h.empty() && std::get<0>(*h) == std::get<0>(c))
+                                     ? std::get<1>(*h) : std::get<0>(c);
+                    std::get<0>(c) = std::get<1>(*in);
+                    std::get<1>(c) = u;
+                    reversed.push(c);
+                }
+            }
+            edges.clear();
+            reversed.sort();
+
+            // relabel the targets, dropping the contracted edges
+            cedge_sorter_type relabeled(cedge_less(), mem / 2);
+            {
+                typename edge_vector_type::bufreader_type h(hook);
+                for ( ; !reversed.empty(); ++reversed)
+                {
+                    cedge c = *reversed;
+                    while (!h.empty() && std::get<0>(*h) < std::get<0>(c)) ++h;
+                    if (!h.empty() && std::get<0>(*h) == std::get<0>(c))
+                        std::get<0>(c) = std::get<1>(*h);
+                    if (std::get<0>(c) != std::get<1>(c))
+                        relabeled.push(c);
+                }
+            }
+            reversed.finish_clear();
+            relabeled.sort();
+
+            stream::unique<cedge_sorter_type, same_cedge> unique(relabeled, same_cedge());
+            nodes = 0;
+            {
+                typename cedge_vector_type::bufwriter_type writer(edges);
+                NodeId last = none();
+                for ( ; !unique.empty(); ++unique)
+                {
+                    writer << *unique;
+                    if (std::get<0>(*unique) != last)
+                        ++nodes, last = std::get<0>(*unique);
+                }
+                writer.finish();
+            }
+            relabeled.finish_clear();
+            phases.end("contraction round");
+        }
+
+        if (forest_writer)
+            forest_writer->finish();
+
+        // replay the hooks backwards: the label of u is that of h, or h
+        for (size_t r = hooks.size(); r-- > 0; )
+        {
+            label_sorter_type by_head(label_less(), mem / 2);
+            for (typename edge_vector_type::bufreader_type in(*hooks[r]); !in.empty(); ++in)
+                by_head.push(edge_type(std::get<1>(*in), std::get<0>(*in)));
+            by_head.sort();
+
+            label_sorter_type hooked(label_less(), mem / 2);
+            {
+                typename edge_vector_type::bufreader_type l(labels);
+                for ( ; !by_head.empty(); ++by_head)
+                {
+                    const NodeId h = std::get<0>(*by_head);
+                    while (!l.empty() && std::get<0>(*l) < h) ++l;
+                    const NodeId lh = (!l.empty() && std::get<0>(*l) == h) ? std::get<1>(*l) : h;
+                    hooked.push(edge_type(std::get<1>(*by_head), lh));
+                }
+            }
+            by_head.finish_clear();
+            hooked.sort();
+
+            edge_vector_type hooked_labels;
+            {
+                typename edge_vector_type::bufwriter_type writer(hooked_labels);
+                for ( ; !hooked.empty(); ++hooked)
+                    writer << *hooked;
+                writer.finish();
+            }
+            hooked.finish_clear();
+            hooks[r].reset();
+
+            edge_vector_type merged;
+            merge_labels(labels, hooked_labels, merged);
+            labels.swap(merged);
+        }
+
+        label.clear();
+        {
+            typename id_vector_type::bufwriter_type writer(label);
+            typename edge_vector_type::bufreader_type l(labels);
+            for (size_type v = 0; v < n; ++v)
+            {
+                if (!l.empty() && static_cast<size_type>(std::get<0>(*l)) == v)
+                    writer << std::get<1>(*l), ++l;
+                else
+                    writer << NodeId(v);
+            }
+            writer.finish();
+        }
+        phases.end("labels");
+
+        return hooks.empty();
+    }
+
+    //! Replace the labels by the smallest node of each component.
+    template <typename ComponentVector>
+    static void smallest_labels(const id_vector_type& label, ComponentVector& component,
+                                size_t mem)
+    {
+        using pair_sorter_type = stxxl::sorter<edge_type, edge_less>;
+        using by_node_less = stxxl::comparator<edge_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+
+        pair_sorter_type by_label(edge_less(), mem / 2);
+        {
+            typename id_vector_type::bufreader_type in(label);
+            for (size_type v = 0; !in.empty(); ++in, ++v)
+                by_label.push(edge_type(*in, NodeId(v)));
+        }
+        by_label.sort();
+
+        stxxl::sorter<edge_type, by_node_less> by_node(by_node_less(), mem / 2);
+        NodeId last = none(), smallest = 0;
+        for ( ; !by_label.empty(); ++by_label)
+        {
+            if (std::get<0>(*by_label) != last)
+                last = std::get<0>(*by_label), smallest = std::get<1>(*by_label);
+            by_node.push(edge_type(std::get<1>(*by_label), smallest));
+        }
+        by_label.finish_clear();
+        by_node.sort();
+
+        component.resize(label.size());
+        stream::choose<decltype(by_node), 1> labels(by_node);
+        stream::materialize(labels, component.begin(), component.end());
+    }
+
+    //! \}
+
+    //! \name Breadth first search by Mehlhorn and Meyer
+    //! \{
+
+    /*!
+     * Cluster the nodes by chopping the Euler tour of the spanning forest
+     * into pieces of mu arcs. The successor of the arc (w, x) is (x, y),
+     * where y follows w among the neighbors of x. The cycle of each tree is
+     * broken at its root, the node labeled by itself, and the trees are
+     * chained in order of their roots, such that list_rank() yields the
+     * position of each arc in one tour. A node belongs to the piece of its
+     * first arc, isolated nodes to cluster zero. Returns the number of
+     * clusters.
+     */
+    static size_type euler_clusters(const edge_vector_type& forest, const id_vector_type& label,
+                                    size_type n, size_type mu, id_vector_type& cluster,
+                                    size_t mem)
+    {
+        // all arcs sorted by (x, y), whose index is their id
+        edge_vector_type arcs;
+        {
+            edge_sorter_type sorter(edge_less(), mem);
+            for (typename edge_vector_type::bufreader_type in(forest); !in.empty(); ++in)
+            {
+                sorter.push(*in);
+                sorter.push(edge_type(std::get<1>(*in), std::get<0>(*in)));
+            }
+            sorter.sort();
+            typename edge_vector_type::bufwriter_type writer(arcs);
+            for ( ; !sorter.empty(); ++sorter)
+                writer << *sorter;
+            writer.finish();
+        }
+        const size_type num_arcs = arcs.size();
+
+        // id of the reversal of each arc: the reversed arcs sorted by (y, x)
+        // are in the order of the arcs
+        id_vector_type reverse;
+        {
+            using rev_type = std::tuple<NodeId, NodeId, NodeId>;
+            using rev_less = stxxl::comparator<rev_type, stxxl::direction::Less, stxxl::direction::Less, stxxl::direction::DontCare>;
+            stxxl::sorter<rev_type, rev_less> sorter(rev_less(), mem);
+            NodeId p = 0;
+            for (typename edge_vector_type::bufreader_type in(arcs); !in.empty(); ++in, ++p)
+                sorter.push(rev_type(std::get<1>(*in), std::get<0>(*in), p));
+            sorter.sort();
+            typename id_vector_type::bufwriter_type writer(reverse);
+            for ( ; !sorter.empty(); ++sorter)
+                writer << std::get<2>(*sorter);
+            writer.finish();
+        }
+
+        // successors of the arcs
+        id_vector_type succ;
+        {
+            using succ_less = stxxl::comparator<edge_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+            stxxl::sorter<edge_type, succ_less> sorter(succ_less(), mem);
+            monotone_reader<id_vector_type> labels(label);
+
+            typename edge_vector_type::bufreader_type in(arcs);
+            typename id_vector_type::bufreader_type rev(reverse);
+            NodeId p = 0, prev_tail = none();
+            while (!in.empty())
+            {
+                const NodeId x = std::get<0>(*in), first = p;
+                NodeId last_rev = *rev;
+                ++in, ++rev, ++p;
+                for ( ; !in.empty() && std::get<0>(*in) == x; ++in, ++rev, ++p) {
+                    sorter.push(edge_type(last_rev, p));
+                    last_rev = *rev;
+                }
+
+                if (labels(x) != x) {
+                    sorter.push(edge_type(last_rev, first));
+                    continue;
+                }
+                // root: chain the previous tree to this one
+                if (prev_tail != none())
+                    sorter.push(edge_type(prev_tail, first));
+                prev_tail = last_rev;
+            }
+            if (prev_tail != none())
+                sorter.push(edge_type(prev_tail, prev_tail));
+            sorter.sort();
+
+            succ.resize(num_arcs);
+            stream::choose<decltype(sorter), 1> succ_stream(sorter);
+            stream::materialize(succ_stream, succ.begin(), succ.end());
+        }
+        reverse.clear();
+
+        id_vector_type rank;
+        list_rank(succ, rank, mem);
+        succ.clear();
+
+        // first position of each node
+        edge_sorter_type first(edge_less(), mem);
+        {
+            typename edge_vector_type::bufreader_type in(arcs);
+            typename id_vector_type::bufreader_type r(rank);
+            for ( ; !in.empty(); ++in, ++r)
+            {
+                const NodeId pos = NodeId(num_arcs - 1 - *r);
+                first.push(edge_type(std::get<0>(*in), pos));
+                first.push(edge_type(std::get<1>(*in), pos));
+            }
+        }
+        arcs.clear();
+        rank.clear();
+        first.sort();
+
+        cluster.clear();
+        typename id_vector_type::bufwriter_type writer(cluster);
+        for (size_type v = 0; v < n; ++v)
+        {
+            if (!first.empty() && static_cast<size_type>(std::get<0>(*first)) == v) {
+                writer << NodeId(std::get<1>(*first) / mu);
+                while (!first.empty() && static_cast<size_type>(std::get<0>(*first)) == v)
+                    ++first;
+            }
+            else
+                writer << NodeId(0);
+        }
+        writer.finish();
+
+        return num_arcs ? (num_arcs - 1) / mu + 1 : 1;
+    }
+
+    //! Write the adjacency lists ordered by the clusters of their nodes,
+    //! with the cluster of each target, and the first edge of each cluster.
+    static void cluster_layout(const edge_vector_type& adj, const id_vector_type& cluster,
+                               size_type num_clusters, pool_vector_type& file,
+                               stxxl::vector<size_type>& directory, size_t mem)
+    {
+        // (v, u, cluster of u)
+        using by_target_type = std::tuple<NodeId, NodeId, NodeId>;
+        using by_target_less = stxxl::comparator<by_target_type, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare>;
+        stxxl::sorter<by_target_type, by_target_less> by_target(by_target_less(), mem / 2);
+        {
+            monotone_reader<id_vector_type> clusters(cluster);
+            for (typename edge_vector_type::bufreader_type in(adj); !in.empty(); ++in)
+                by_target.push(by_target_type(std::get<1>(*in), std::get<0>(*in), clusters(std::get<0>(*in))));
+        }
+        by_target.sort();
+
+        // (cluster of u, u, v, cluster of v)
+        using layout_type = std::tuple<NodeId, NodeId, NodeId, NodeId>;
+        using layout_less = stxxl::comparator<layout_type, stxxl::direction::Less, stxxl::direction::Less, stxxl::direction::Less, stxxl::direction::DontCare>;
+        stxxl::sorter<layout_type, layout_less> layout(layout_less(), mem / 2);
+        {
+            monotone_reader<id_vector_type> clusters(cluster);
+            for ( ; !by_target.empty(); ++by_target)
+            {
+                const by_target_type& e = *by_target;
+                layout.push(layout_type(std::get<2>(e), std::get<1>(e), std::get<0>(e),
+                                        clusters(std::get<0>(e))));
+            }
+        }
+        by_target.finish_clear();
+        layout.sort();
+
+        file.clear();
+        directory.clear();
+        typename pool_vector_type::bufwriter_type writer(file);
+        typename stxxl::vector<size_type>::bufwriter_type dir(directory);
+        size_type pos = 0, c = 0;
+        for ( ; !layout.empty(); ++layout, ++pos)
+        {
+            const layout_type& e = *layout;
+            for ( ; c <= static_cast<size_type>(std::get<0>(e)); ++c)
+                dir << pos;
+            writer << pool_edge_type(std::get<1>(e), std::get<2>(e), std::get<3>(e));
+        }
+        for ( ; c <= num_clusters; ++c)
+            dir << pos;
+        writer.finish();
+        dir.finish();
+    }
+
+    /*!
+     * Breadth first search by Mehlhorn and Meyer: the adjacency lists are
+     * grouped into clusters of nodes close in a spanning forest, and the
+     * cluster of a node is moved into the hot pool when the node is first
+     * reached. The hot pool is sorted by node and merged once per level
+     * with the level's nodes, removing their adjacency lists, hence each
+     * cluster is read with one random I/O and each edge rescanned about as
+     * often as there are levels within a cluster.
+     */
+    template <typename DistVector>
+    static void bfs_mm(const edge_vector_type& adj, size_type n, NodeId source,
+                       DistVector& dist, size_t mem, phase_recorder& phases)
+    {
+        id_vector_type label;
+        edge_vector_type forest;
+        components<true>(adj, n, label, &forest, mem, phases);
+
+        // sqrt(B) nodes per cluster
+        const size_type mu = std::max<size_type>(
+            1, static_cast<size_type>(std::sqrt(
+                                          static_cast<double>(pool_vector_type::block_size / sizeof(pool_edge_type)))));
+
+        id_vector_type cluster;
+        const size_type num_clusters = euler_clusters(forest, label, n, mu, cluster, mem);
+        forest.clear();
+        label.clear();
+        phases.end("euler tour clustering");
+
+        pool_vector_type file;
+        stxxl::vector<size_type> directory;
+        cluster_layout(adj, cluster, num_clusters, file, directory, mem);
+        phases.end("cluster layout");
+
+        using level_type = std::tuple<NodeId, NodeId>;
+        using level_less = stxxl::comparator<level_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+        stxxl::sorter<level_type, level_less> levels(level_less(), mem / 4);
+
+        using pool_less = stxxl::comparator<pool_edge_type, stxxl::direction::Less, stxxl::direction::Less, stxxl::direction::DontCare>;
+        using pool_sorter_type = stxxl::sorter<pool_edge_type, pool_less>;
+        using id_less = stxxl::comparator<std::tuple<NodeId>, stxxl::direction::Less>;
+        using id_sorter_type = stxxl::sorter<std::tuple<NodeId>, id_less>;
+        using node_cluster_less = stxxl::comparator<node_cluster_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+        using node_cluster_sorter_type = stxxl::sorter<node_cluster_type, node_cluster_less>;
+        using node_cluster_vector_type = stxxl::vector<node_cluster_type>;
+        using cluster_vector_type = stxxl::vector<std::tuple<NodeId> >;
+
+        node_cluster_vector_type prev, curr, next;
+        curr.push_back(node_cluster_type(source, cluster[source]));
+        cluster.clear();
+
+        pool_vector_type pool;
+        cluster_vector_type loaded;
+
+        for (NodeId t = 0; !curr.empty(); ++t)
+        {
+            // clusters of the level not yet in the hot pool
+            id_sorter_type wanted(id_less(), mem / 4);
+            for (typename node_cluster_vector_type::bufreader_type in(curr); !in.empty(); ++in)
+            {
+                levels.push(level_type(std::get<0>(*in), t));
+                wanted.push(std::tuple<NodeId>(std::get<1>(*in)));
+            }
+            wanted.sort();
+
+            cluster_vector_type fresh;
+            subtract(wanted, loaded, loaded, fresh);
+            wanted.finish_clear();
+
+            // read them into the hot pool
+            if (!fresh.empty())
+            {
+                pool_sorter_type incoming(pool_less(), mem / 4);
+                for (typename cluster_vector_type::bufreader_type in(fresh); !in.empty(); ++in)
+                {
+                    const NodeId c = std::get<0>(*in);
+                    const size_type begin = directory[c], end = directory[c + 1];
+                    for (typename pool_vector_type::const_iterator e = file.cbegin() + begin;
+                         e != file.cbegin() + end; ++e)
+                        incoming.push(*e);
+                }
+                incoming.sort();
+
+                pool_vector_type merged;
+                {
+                    typename pool_vector_type::bufwriter_type writer(merged);
+                    typename pool_vector_type::bufreader_type p(pool);
+                    while (!p.empty() || !incoming.empty())
+                    {
+                        if (incoming.empty() || (!p.empty() && pool_less()(*p, *incoming)))
+                            writer << *p, ++p;
+                        else
+                            writer << *incoming, ++incoming;
+                    }
+                    writer.finish();
+                }
+                pool.swap(merged);
+
+                cluster_vector_type all;
+                {
+                    typename cluster_vector_type::bufreader_type a(loaded), b(fresh);
+                    typename cluster_vector_type::bufwriter_type writer(all);
+                    while (!a.empty() || !b.empty())
+                    {
+                        if (b.empty() || (!a.empty() && *a < *b))
+                            writer << *a, ++a;
+                        else
+                            writer << *b, ++b;
+                    }
+                    writer.finish();
+                }
+                loaded.swap(all);
+            }
+
+            // take the adjacency lists of the level out of the hot pool
+            node_cluster_sorter_type neighbors(node_cluster_less(), mem / 4);
+            {
+                pool_vector_type rest;
+                typename pool_vector_type::bufwriter_type writer(rest);
+                typename node_cluster_vector_type::bufreader_type v(curr);
+                for (typename pool_vector_type::bufreader_type p(pool); !p.empty(); ++p)
+                {
+                    while (!v.empty() && std::get<0>(*v) < std::get<0>(*p)) ++v;
+                    if (!v.empty() && std::get<0>(*v) == std::get<0>(*p))
+                        neighbors.push(node_cluster_type(std::get<1>(*p), std::get<2>(*p)));
+                    else
+                        writer << *p;
+                }
+                writer.finish();
+                pool.swap(rest);
+            }
+            neighbors.sort();
+
+            subtract(neighbors, curr, prev, next);
+            prev.swap(curr);
+            curr.swap(next);
+        }
+        phases.end("levels");
+
+        write_distances(levels, n, dist);
+        phases.end("distances");
+    }
+
+    //! \}
+};
+
+} // namespace graph_local
+
+/*!
+ * Breadth first search in external memory on the undirected graph with the
+ * nodes 0..n-1 and the given edges: dist[v] receives the number of edges on
+ * a shortest path from source to v, or the maximum of its value_type if v
+ * is not reachable. edges is an stxxl::vector of pairs or tuples (u, v) in
+ * any order, each edge may be given in one or both directions, duplicates
+ * and self-loops are ignored.
+ *
+ * Both algorithms first sort the edges into adjacency lists, then compute
+ * the levels one after another, each from the neighbors of the previous
+ * one, by sorting and removing the nodes of the two previous levels.
+ * munagala_ranade reads the adjacency list of each node with a random I/O,
+ * which takes O(n + sort(m)) I/Os. mehlhorn_meyer first clusters the nodes
+ * by an Euler tour of a spanning forest, obtained from
+ * connected_components(), and reads the adjacency lists cluster-wise into a
+ * hot pool, which takes O(sqrt(n m / B) + sort(n + m)) I/Os and is faster
+ * on sparse graphs with many nodes. All sorts run in parallel with
+ * STXXL_PARALLEL.
+ *
+ * \param edges edge list, an stxxl::vector
+ * \param n number of nodes
+ * \param source node to search from
+ * \param dist vector receiving the distances, an stxxl::vector
+ * \param M internal memory to use in bytes
+ * \param algo search algorithm
+ * \param profile if not null, receives the I/O volume of each phase
+ */
+template <typename EdgeVector, typename DistVector>
+void breadth_first_search(const EdgeVector& edges, external_size_type n,
+                          external_size_type source, DistVector& dist, size_t M,
+                          bfs_algorithm algo = bfs_algorithm::mehlhorn_meyer,
+                          graph_profile* profile = nullptr)
+{
+    using node_id_type = typename std::decay<
+              typename std::tuple_element<0, typename EdgeVector::value_type>::type>::type;
+    using kernels_type = graph_local::kernels<node_id_type>;
+
+    kernels_type::check_nodes(n, "stxxl::breadth_first_search()");
+    if (source >= n)
+        throw foxxll::bad_parameter("stxxl::breadth_first_search(): source out of range");
+
+    graph_local::phase_recorder phases(profile);
+
+    typename kernels_type::edge_vector_type adj;
+    kernels_type::symmetrize(edges, n, adj, M, "stxxl::breadth_first_search()");
+    phases.end("adjacency");
+
+    if (algo == bfs_algorithm::munagala_ranade)
+        kernels_type::bfs_mr(adj, n, node_id_type(source), dist, M, phases);
+    else
+        kernels_type::bfs_mm(adj, n, node_id_type(source), dist, M, phases);
+}
+
+/*!
+ * Compute the connected components in external memory of the undirected
+ * graph with the nodes 0..n-1 and the given edges: component[v] receives the
+ * smallest node of v's component. edges is an stxxl::vector of pairs or
+ * tuples (u, v) in any order, see breadth_first_search().
+ *
+ * If the nodes fit into half of M, union-find in internal memory on one scan
+ * of the edges computes the components. Otherwise the edges are sorted into
+ * adjacency lists and contracted by random mating, each round costing a
+ * constant number of sorts of the remaining edges, until the remaining
+ * nodes fit, and the contractions are replayed backwards. All sorts run in
+ * parallel with STXXL_PARALLEL.
+ *
+ * \param edges edge list, an stxxl::vector
+ * \param n number of nodes
+ * \param component vector receiving the components, an stxxl::vector
+ * \param M internal memory to use in bytes
+ * \param profile if not null, receives the I/O volume of each phase
+ */
+template <typename EdgeVector, typename ComponentVector>
+void connected_components(const EdgeVector& edges, external_size_type n,
+                          ComponentVector& component, size_t M,
+                          graph_profile* profile = nullptr)
+{
+    using node_id_type = typename std::decay<
+              typename std::tuple_element<0, typename EdgeVector::value_type>::type>::type;
+    using kernels_type = graph_local::kernels<node_id_type>;
+    using comp_type = typename ComponentVector::value_type;
+
+    kernels_type::check_nodes(n, "stxxl::connected_components()");
+
+    graph_local::phase_recorder phases(profile);
+
+    if (n * (sizeof(node_id_type) + sizeof(size_t)) <= M / 2)
+    {
+        // union-find with the nodes in internal memory
+        std::vector<size_t> parent(n);
+        for (size_t i = 0; i < parent.size(); ++i)
+            parent[i] = i;
+        auto find = [&parent](size_t i) {
+                        while (parent[i] != i)
+                            i = parent[i] = parent[parent[i]];
+                        return i;
+                    };
+
+        for (typename EdgeVector::bufreader_type in(edges); !in.empty(); ++in)
+        {
+            const external_size_type u = std::get<0>(*in), v = std::get<1>(*in);
+            if (u >= n || v >= n)
+                throw foxxll::bad_parameter("stxxl::connected_components(): edge endpoint out of range");
+            const size_t a = find(u), b = find(v);
+            parent[std::max(a, b)] = std::min(a, b);
+        }
+
+        component.clear();
+        typename ComponentVector::bufwriter_type writer(component);
+        for (size_t i = 0; i < parent.size(); ++i)
+            writer << static_cast<comp_type>(find(i));
+        writer.finish();
+        phases.end("union-find");
+        return;
+    }
+
+    typename kernels_type::edge_vector_type adj;
+    kernels_type::symmetrize(edges, n, adj, M, "stxxl::connected_components()");
+    phases.end("adjacency");
+
+    typename kernels_type::id_vector_type label;
+    const bool smallest = kernels_type::template components<false>(adj, n, label, nullptr, M, phases);
+    adj.clear();
+
+    if (smallest) {
+        component.resize(n);
+        typename kernels_type::id_vector_type::bufreader_type in(label);
+        stream::materialize(in, component.begin(), component.end());
+    }
+    else {
+        kernels_type::smallest_labels(label, component, M);
+    }
+    phases.end("smallest labels");
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_GRAPH_HEADER
@@ -16,6 +16,7 @@
 
 #include <foxxll/io/request_operations.hpp>
 #include <stxxl/bits/algo/bid_adapter.h>
+#include <stxxl/bits/algo/sort_kernel.h>
 #include <stxxl/bits/algo/trigger_entry.h>
 #include <stxxl/bits/parallel.h>
 #include <tlx/simple_vector.hpp>
@@ -24,7 +25,9 @@
 
 namespace stxxl {
 
-template <typename ExtIterator, typename StrictWeakOrdering>
+//! Sort [first, last) in internal memory, keeping the order of equal
+//! elements if Stable.
+template <bool Stable = false, typename ExtIterator, typename StrictWeakOrdering>
 void stl_in_memory_sort(ExtIterator first, ExtIterator last, StrictWeakOrdering cmp)
 {
     using block_type = typename ExtIterator::block_type;
@@ -43,10 +46,21 @@ void stl_in_memory_sort(ExtIterator first, ExtIterator last, StrictWeakOrdering
 
     size_t last_block_correction = last.block_offset() ? (block_type::size - last.block_offset()) : 0;
     check_sort_settings();
-    potentially_parallel::
-    sort(make_element_iterator(blocks.begin(), first.block_offset()),
-         make_element_iterator(blocks.begin(), nblocks * block_type::size - last_block_correction),
-         cmp);
+    if (Stable)
+    {
+        potentially_parallel::
+        stable_sort(make_element_iterator(blocks.begin(), first.block_offset()),
+                    make_element_iterator(blocks.begin(), nblocks * block_type::size - last_block_correction),
+                    cmp);
+    }
+    else if (!sort_kernel_blocks(blocks.begin(), first.block_offset(),
+                                 nblocks * block_type::size - last_block_correction, cmp))
+    {
+        potentially_parallel::
+        sort(make_element_iterator(blocks.begin(), first.block_offset()),
+             make_element_iterator(blocks.begin(), nblocks * block_type::size - last_block_correction),
+             cmp);
+    }
 
     for (i = 0; i < nblocks; ++i)
         reqs[i] = blocks[i].write(*(first.bid() + i));
@@ -15,8 +15,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <type_traits>
 #include <utility>
 
+#include <tlx/math/integer_log2.hpp>
 #include <tlx/unused.hpp>
 
 #include <foxxll/common/types.hpp>
@@ -25,11 +27,46 @@
 
 namespace stxxl {
 
+//! largest number of buckets for which count() uses interleaved histograms
+constexpr size_t intksort_interleaved_count_buckets = 256;
+
+//! size of the software write-combining buffer of each bucket in classify()
+constexpr size_t intksort_write_combining_bytes = 64;
+
+//! digit width of the in-place MSD radix sort
+constexpr unsigned intksort_inplace_digit_bits = 8;
+
+//! buckets of the in-place MSD radix sort below this size are comparison sorted
+constexpr size_t intksort_inplace_min_bucket = 64;
+
 template <typename TypeKey>
 static void
 count(TypeKey* a, TypeKey* aEnd, size_t* bucket, size_t K,
       typename TypeKey::key_type offset, unsigned shift)
 {
+    if (K <= intksort_interleaved_count_buckets &&
+        static_cast<size_t>(aEnd - a) >= 16 * K)
+    {
+        // count into four interleaved histograms, which breaks the store to
+        // load dependency of runs of equal bucket indexes.
+        size_t hist[4][intksort_interleaved_count_buckets] = { };
+
+        TypeKey* p = a;
+        for ( ; p + 4 <= aEnd; p += 4)
+        {
+            hist[0][(p[0].key - offset) >> shift]++;
+            hist[1][(p[1].key - offset) >> shift]++;
+            hist[2][(p[2].key - offset) >> shift]++;
+            hist[3][(p[3].key - offset) >> shift]++;
+        }
+        for ( ; p < aEnd; p++)
+            hist[0][(p->key - offset) >> shift]++;
+
+        for (size_t i = 0; i < K; i++)
+            bucket[i] = hist[0][i] + hist[1][i] + hist[2][i] + hist[3][i];
+        return;
+    }
+
     // reset buckets
     std::fill(bucket, bucket + K, 0);
 
@@ -75,6 +112,47 @@ classify(TypeKey* a, TypeKey* aEnd, TypeKey* b, size_t* bucket,
     }
 }
 
+// distribute input a to output b using bucket[0..K-1] for the starting
+// indices. For large inputs, elements are first collected in a small
+// write-combining buffer per bucket, which is flushed to b as a whole, thus
+// turning the random scattered stores into sequential bursts per bucket.
+template <typename TypeKey>
+static void
+classify(TypeKey* a, TypeKey* aEnd, TypeKey* b, size_t* bucket, size_t K,
+         typename TypeKey::key_type offset, unsigned shift)
+{
+    constexpr size_t W = intksort_write_combining_bytes / sizeof(TypeKey);
+
+    if (W < 2 || static_cast<size_t>(aEnd - a) < 4 * W * K)
+        return classify(a, aEnd, b, bucket, offset, shift);
+
+    TypeKey* buffer = new TypeKey[W * K];
+    size_t* fill = new size_t[K];
+    std::fill(fill, fill + K, 0);
+
+    for (TypeKey* p = a; p < aEnd; p++)
+    {
+        size_t i = (p->key - offset) >> shift;
+        TypeKey* buf = buffer + i * W;
+        buf[fill[i]] = *p;
+        if (++fill[i] == W)
+        {
+            std::copy(buf, buf + W, b + bucket[i]);
+            bucket[i] += W;
+            fill[i] = 0;
+        }
+    }
+
+    for (size_t i = 0; i < K; i++)
+    {
+        std::copy(buffer + i * W, buffer + i * W + fill[i], b + bucket[i]);
+        bucket[i] += fill[i];
+    }
+
+    delete[] fill;
+    delete[] buffer;
+}
+
 template <class Type>
 inline void
 sort2(Type& a, Type& b)
@@ -325,7 +403,7 @@ l1sort(TypeKey* a,
 {
     count(a, aEnd, bucket, K, offset, shift);
     exclusive_prefix_sum(bucket, K);
-    classify(a, aEnd, b, bucket, offset, shift);
+    classify(a, aEnd, b, bucket, K, offset, shift);
     cleanup(b, bucket, K);
 }
 
@@ -366,6 +444,139 @@ void classify_block(Type* begin, Type* end, TypeKey*& out, size_t* bucket, typen
     tlx::unused(K);
 }
 
+// distribute a..aEnd-1 in place (American flag sort) into the buckets
+// given by the digit (key(x) >> shift) & (K-1), K = 2^intksort_inplace_digit_bits.
+// bucket[0..K-1] returns the end offset of each bucket.
+template <typename Type, typename KeyExtractor>
+void inplace_classify(Type* a, Type* aEnd, size_t* bucket, unsigned shift,
+                      KeyExtractor keyobj)
+{
+    constexpr size_t K = size_t(1) << intksort_inplace_digit_bits;
+    auto digit = [&](const Type& x) {
+                     return static_cast<size_t>(keyobj(x) >> shift) & (K - 1);
+                 };
+
+    std::fill(bucket, bucket + K, 0);
+    for (Type* p = a; p < aEnd; ++p)
+        ++bucket[digit(*p)];
+
+    size_t next[K];
+    exclusive_prefix_sum(bucket, K);
+    std::copy(bucket, bucket + K, next);
+    for (size_t i = 0; i < K - 1; ++i)
+        bucket[i] = bucket[i + 1];
+    bucket[K - 1] = aEnd - a;
+
+    for (size_t i = 0; i < K; ++i)
+    {
+        while (next[i] < bucket[i])
+        {
+            Type x = a[next[i]];
+            size_t d = digit(x);
+            while (d != i)
+            {
+                std::swap(x, a[next[d]++]);
+                d = digit(x);
+            }
+            a[next[i]++] = x;
+        }
+    }
+}
+
+// finishes the small buckets and the buckets of equal keys of the in-place
+// radix sorts by comparison sorting.
+struct comparison_leaf_sort
+{
+    template <typename Type, typename Compare>
+    void operator () (Type* a, Type* aEnd, Compare cmp) const
+    {
+        std::sort(a, aEnd, cmp _STXXL_FORCE_SEQUENTIAL);
+    }
+};
+
+// sort a..aEnd-1 by MSD radix sort on the digits of key(x) starting at bit
+// shift. Small buckets and buckets of equal keys are finished by leaf using
+// cmp, which must order consistently with the keys, so that key(x) may also
+// be only a prefix of the sort key.
+template <typename Type, typename KeyExtractor, typename Compare,
+          typename LeafSort = comparison_leaf_sort>
+void inplace_ksort(Type* a, Type* aEnd, unsigned shift,
+                   KeyExtractor keyobj, Compare cmp, LeafSort leaf = LeafSort())
+{
+    constexpr size_t K = size_t(1) << intksort_inplace_digit_bits;
+
+    if (static_cast<size_t>(aEnd - a) < intksort_inplace_min_bucket)
+    {
+        leaf(a, aEnd, cmp);
+        return;
+    }
+
+    size_t bucket[K];
+    inplace_classify(a, aEnd, bucket, shift, keyobj);
+
+    for (size_t i = 0, begin = 0; i < K; begin = bucket[i++])
+    {
+        if (bucket[i] - begin < 2)
+            continue;
+        if (shift == 0)
+            leaf(a + begin, a + bucket[i], cmp);
+        else
+            inplace_ksort(a + begin, a + bucket[i],
+                          shift > intksort_inplace_digit_bits ? shift - intksort_inplace_digit_bits : 0,
+                          keyobj, cmp, leaf);
+    }
+}
+
+// sort a..aEnd-1 by the unsigned integer key(x) using an in-place MSD radix
+// sort, starting at the highest bit in which the keys differ. The buckets
+// of the first digit are sorted in parallel, small buckets and buckets of
+// equal keys are finished by leaf.
+template <typename Type, typename KeyExtractor, typename Compare,
+          typename LeafSort = comparison_leaf_sort>
+void radix_sort(Type* a, Type* aEnd, KeyExtractor keyobj, Compare cmp,
+                LeafSort leaf = LeafSort())
+{
+    using key_type = typename KeyExtractor::key_type;
+    static_assert(std::is_integral<key_type>::value && std::is_unsigned<key_type>::value,
+                  "radix_sort() requires an unsigned integer key");
+    constexpr size_t K = size_t(1) << intksort_inplace_digit_bits;
+
+    if (aEnd - a < 2)
+        return;
+
+    // skip the leading bits common to all keys
+    const key_type first = keyobj(*a);
+    key_type diff = 0;
+    for (Type* p = a + 1; p < aEnd; ++p)
+        diff |= keyobj(*p) ^ first;
+
+    if (diff == 0)
+    {
+        leaf(a, aEnd, cmp);
+        return;
+    }
+
+    const unsigned high_bit = tlx::integer_log2_floor(diff);
+    const unsigned shift = high_bit >= intksort_inplace_digit_bits
+                           ? high_bit + 1 - intksort_inplace_digit_bits : 0;
+    const unsigned next_shift = shift > intksort_inplace_digit_bits
+                                ? shift - intksort_inplace_digit_bits : 0;
+
+    size_t bucket[K];
+    inplace_classify(a, aEnd, bucket, shift, keyobj);
+
+    parallel_for(
+        0, K, [&](size_t i) {
+            const size_t begin = (i == 0) ? 0 : bucket[i - 1];
+            if (bucket[i] - begin < 2)
+                return;
+            if (shift == 0)
+                leaf(a + begin, a + bucket[i], cmp);
+            else
+                inplace_ksort(a + begin, a + bucket[i], next_shift, keyobj, cmp, leaf);
+        });
+}
+
 } // namespace stxxl
 
 #endif // !STXXL_ALGO_INTKSORT_HEADER
@@ -17,12 +17,15 @@
 
 #include <algorithm>
 #include <functional>
+#include <iterator>
 #include <utility>
+#include <vector>
 
 #include <tlx/define.hpp>
 #include <tlx/logger/core.hpp>
 #include <tlx/simple_vector.hpp>
 
+#include <foxxll/common/error_handling.hpp>
 #include <foxxll/common/onoff_switch.hpp>
 #include <foxxll/common/utils.hpp>
 #include <foxxll/mng/async_schedule.hpp>
@@ -31,14 +34,18 @@
 #include <foxxll/mng/block_prefetcher.hpp>
 #include <foxxll/mng/buf_writer.hpp>
 
+#include <stxxl/bits/algo/balanced_prefetcher.h>
 #include <stxxl/bits/algo/bid_adapter.h>
 #include <stxxl/bits/algo/inmemsort.h>
 #include <stxxl/bits/algo/intksort.h>
 #include <stxxl/bits/algo/losertree.h>
 #include <stxxl/bits/algo/run_cursor.h>
 #include <stxxl/bits/algo/sort_base.h>
+#include <stxxl/bits/algo/sort_helper.h>
 #include <stxxl/bits/algo/trigger_entry.h>
+#include <stxxl/bits/common/block_array.h>
 #include <stxxl/bits/common/is_sorted.h>
+#include <stxxl/bits/parallel.h>
 
 //#define INTERLEAVED_ALLOC
 
@@ -57,6 +64,8 @@ namespace stxxl {
  */
 namespace ksort_local {
 
+constexpr bool debug = false;
+
 template <typename BIDType, typename KeyType>
 struct trigger_entry
 {
@@ -199,8 +208,8 @@ create_runs(
     using request_ptr = foxxll::request_ptr;
 
     foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-    BlockType* Blocks1 = new BlockType[m2];
-    BlockType* Blocks2 = new BlockType[m2];
+    BlockType* Blocks1 = new_block_array<BlockType>(m2);
+    BlockType* Blocks2 = new_block_array<BlockType>(m2);
     bid_type* bids = new bid_type[m2];
     type_key_* refs1 = new type_key_[m2 * Blocks1->size];
     type_key_* refs2 = new type_key_[m2 * Blocks1->size];
@@ -257,7 +266,7 @@ create_runs(
         }
 
         exclusive_prefix_sum(bucket1, k1);
-        classify(refs1, refs1 + run_size * Blocks1->size, refs2, bucket1,
+        classify(refs1, refs1 + run_size * Blocks1->size, refs2, bucket1, k1,
                  offset, shift1);
 
         size_t out_block = 0;
@@ -297,8 +306,8 @@ create_runs(
     delete[] bucket2;
     delete[] refs1;
     delete[] refs2;
-    delete[] Blocks1;
-    delete[] Blocks2;
+    delete_block_array(Blocks1, m2);
+    delete_block_array(Blocks2, m2);
     delete[] bids;
     delete[] next_run_reads;
     delete[] read_reqs;
@@ -337,12 +346,19 @@ class key_comparison
     KeyExtractor ke;
 
 public:
+    using key_type = typename KeyExtractor::key_type;
+
     key_comparison() { }
     explicit key_comparison(KeyExtractor ke_) : ke(ke_) { }
     bool operator () (const RecordType& a, const RecordType& b) const
     {
         return ke(a) < ke(b);
     }
+    //! compare a trigger key with a record, used to find splitting positions
+    bool operator () (const key_type& a, const RecordType& b) const
+    {
+        return a < ke(b);
+    }
 };
 
 template <typename BlockType, typename RunType, typename KeyExtractorWithMin>
@@ -449,7 +465,7 @@ template <typename BlockType, typename RunType, typename KeyExtractor>
 void merge_runs(RunType** in_runs, size_t nruns, RunType* out_run, size_t _m, KeyExtractor keyobj)
 {
     using block_type = BlockType;
-    using prefetcher_type = foxxll::block_prefetcher<BlockType, typename RunType::iterator>;
+    using prefetcher_type = run_prefetcher<BlockType, typename RunType::iterator>;
     using run_cursor_type = run_cursor2<BlockType, prefetcher_type>;
 
     size_t i;
@@ -503,19 +519,106 @@ void merge_runs(RunType** in_runs, size_t nruns, RunType* out_run, size_t _m, Ke
 
     size_t out_run_size = out_run->size();
 
-    run_cursor2_cmp<block_type, prefetcher_type, KeyExtractor> cmp(keyobj);
-    loser_tree<
-        run_cursor_type,
-        run_cursor2_cmp<block_type, prefetcher_type, KeyExtractor> >
-    losers(&prefetcher, nruns, cmp);
-
     block_type* out_buffer = writer.get_free_block();
 
-    for (i = 0; i < out_run_size; i++)
+    if (do_parallel_merge())
     {
-        losers.multi_merge(out_buffer->elem, out_buffer->elem + block_type::size);
-        (*out_run)[i].key = keyobj(out_buffer->elem[0]);
-        out_buffer = writer.write(out_buffer, (*out_run)[i].bid);
+#if STXXL_PARALLEL_MULTIWAY_MERGE
+
+// begin of STL-style merging
+
+        using value_type = typename block_type::value_type;
+        using value_cmp = key_comparison<value_type, KeyExtractor>;
+        using diff_type = typename std::iterator_traits<typename block_type::iterator>::difference_type;
+        using sequence = std::pair<typename block_type::iterator, typename block_type::iterator>;
+
+        value_cmp cmp(keyobj);
+        std::vector<sequence> seqs(nruns);
+        std::vector<block_type*> buffers(nruns);
+
+        for (i = 0; i < nruns; i++)                       // initialize sequences
+        {
+            buffers[i] = prefetcher.pull_block();         // get first block of each run
+            seqs[i] = std::make_pair(buffers[i]->begin(), buffers[i]->end());
+            // this memory location stays the same, only the data is exchanged
+        }
+
+        diff_type num_currently_mergeable = 0;
+
+        for (i = 0; i < out_run_size; ++i)                // for the whole output run, out_run_size is in blocks
+        {
+            diff_type rest = block_type::size;            // elements still to merge for this output block
+
+            TLX_LOG << "output block " << i;
+            do {
+                if (num_currently_mergeable < rest)
+                {
+                    if (prefetcher.empty())
+                    {
+                        // anything remaining is already in memory
+                        num_currently_mergeable = (out_run_size - i) * block_type::size
+                                                  - (block_type::size - rest);
+                    }
+                    else
+                    {
+                        // everything up to the key of the next block to be
+                        // fetched can be merged safely
+                        num_currently_mergeable = sort_helper::count_elements_less_equal(
+                            seqs, consume_seq[prefetcher.pos()].key, cmp);
+                    }
+                }
+
+                diff_type output_size = std::min(num_currently_mergeable, rest);       // at most rest elements
+
+                TLX_LOG << "before merge " << output_size;
+
+                // the parallel multiway merge splits the output among the
+                // threads by key ranges of the input sequences
+                potentially_parallel::multiway_merge(
+                    seqs.begin(), seqs.end(),
+                    out_buffer->end() - rest, output_size, cmp);
+                // sequence iterators are progressed appropriately
+
+                rest -= output_size;
+                num_currently_mergeable -= output_size;
+
+                TLX_LOG << "after merge";
+
+                sort_helper::refill_or_remove_empty_sequences(seqs, buffers, prefetcher);
+            } while (rest > 0 && seqs.size() > 0);
+
+ #if STXXL_CHECK_ORDER_IN_SORTS
+            assert(stxxl::is_sorted(out_buffer->cbegin(), out_buffer->cend(), cmp));
+ #endif
+
+            (*out_run)[i].key = keyobj(out_buffer->elem[0]);       // save smallest key
+            out_buffer = writer.write(out_buffer, (*out_run)[i].bid);
+        }
+
+// end of STL-style merging
+
+#else
+        FOXXLL_THROW_UNREACHABLE();
+#endif
+    }
+    else
+    {
+// begin of native merging procedure
+
+        run_cursor2_cmp<block_type, prefetcher_type, KeyExtractor> cmp(keyobj);
+        loser_tree<
+            run_cursor_type,
+            run_cursor2_cmp<block_type, prefetcher_type, KeyExtractor> >
+        losers(&prefetcher, nruns, cmp);
+
+        for (i = 0; i < out_run_size; i++)
+        {
+            losers.multi_merge(out_buffer->elem, out_buffer->elem + block_type::size);
+            (*out_run)[i].key = keyobj(out_buffer->elem[0]);
+            out_buffer = writer.write(out_buffer, (*out_run)[i].bid);
+        }
+
+// end of native merging procedure
     }
 
     delete[] prefetch_seq;
@@ -0,0 +1,524 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/list_rank.h
+ *
+ *  External memory list ranking by independent set removal and Euler tours
+ *  of forests given by parent arrays, as described in Yi-Jen Chiang et al.
+ *  "External-Memory Graph Algorithms". SODA 1995.
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_LIST_RANK_HEADER
+#define STXXL_ALGO_LIST_RANK_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+
+#include <stxxl/bits/common/comparator.h>
+#include <stxxl/bits/containers/sorter.h>
+#include <stxxl/bits/containers/vector.h>
+#include <stxxl/bits/stream/stream.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+namespace list_rank_local {
+
+static constexpr bool debug = false;
+
+//! Coin flip of node id in round, the same for all passes of the round.
+inline bool coin(uint64_t id, unsigned round)
+{
+    uint64_t x = id + (static_cast<uint64_t>(round) + 1) * 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return ((x ^ (x >> 31)) & 1) != 0;
+}
+
+/*!
+ * Ranking of lists given by nodes (id, succ, weight) sorted by id, where the
+ * tails point to themselves. The rank of a node is the sum of the weights of
+ * the links from it to its tail, the weight of a node being that of its link.
+ *
+ * Each round removes an independent set of non-tail nodes, chosen by coin
+ * flips, by linking their predecessors to their successors, and the nodes
+ * of lists reduced to their tail. The remaining nodes are ranked
+ * recursively, those removed from their successors' ranks afterwards. A
+ * round removes a quarter of the nodes in expectation and costs a constant
+ * number of sorts, until the nodes fit into internal memory.
+ *
+ * \param NodeId node id type
+ * \param Rank weight and rank type
+ */
+template <typename NodeId, typename Rank>
+class ranker
+{
+public:
+    //! (id, succ, weight)
+    using node_type = std::tuple<NodeId, NodeId, Rank>;
+    //! (id, rank)
+    using rank_pair_type = std::tuple<NodeId, Rank>;
+
+    using node_vector_type = stxxl::vector<node_type>;
+    using rank_vector_type = stxxl::vector<rank_pair_type>;
+
+protected:
+    //! (succ, id) of the non-tail nodes
+    using pred_type = std::tuple<NodeId, NodeId>;
+    //! (pred, succ, weight) of a removed node, to relink its predecessor
+    using bridge_type = std::tuple<NodeId, NodeId, Rank>;
+    //! (succ, id, weight) of a removed node
+    using removed_type = std::tuple<NodeId, NodeId, Rank>;
+
+    using pred_less = stxxl::comparator<pred_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+    using bridge_less = stxxl::comparator<bridge_type, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare>;
+    using removed_less = stxxl::comparator<removed_type, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare>;
+    using rank_less = stxxl::comparator<rank_pair_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+
+    using pred_sorter_type = stxxl::sorter<pred_type, pred_less>;
+    using bridge_sorter_type = stxxl::sorter<bridge_type, bridge_less>;
+    using removed_sorter_type = stxxl::sorter<removed_type, removed_less>;
+    using rank_sorter_type = stxxl::sorter<rank_pair_type, rank_less>;
+
+    using removed_vector_type = stxxl::vector<removed_type>;
+    using id_vector_type = stxxl::vector<NodeId>;
+
+    static bool is_tail(const node_type& v)
+    {
+        return std::get<1>(v) == std::get<0>(v);
+    }
+
+    //! Rank the nodes in internal memory by walking from the heads.
+    static void rank_internal(const node_vector_type& nodes, rank_vector_type& ranks)
+    {
+        const std::vector<node_type> v(nodes.cbegin(), nodes.cend());
+        const size_t n = v.size();
+
+        auto index = [&v](const NodeId& id) {
+                         return static_cast<size_t>(
+                             std::lower_bound(v.begin(), v.end(), id,
+                                              [](const node_type& a, const NodeId& b) {
+                                                  return std::get<0>(a) < b;
+                                              }) - v.begin());
+                     };
+
+        std::vector<size_t> succ(n);
+        std::vector<bool> has_pred(n, false);
+        for (size_t i = 0; i < n; ++i)
+        {
+            succ[i] = is_tail(v[i]) ? i : index(std::get<1>(v[i]));
+            assert(succ[i] < n && std::get<0>(v[succ[i]]) == std::get<1>(v[i]));
+            if (succ[i] != i)
+                has_pred[succ[i]] = true;
+        }
+
+        std::vector<Rank> rank(n);
+        std::vector<size_t> path;
+        size_t ranked = 0;
+        for (size_t h = 0; h < n; ++h)
+        {
+            if (has_pred[h])
+                continue;
+
+            path.clear();
+            size_t i = h;
+            while (succ[i] != i)
+            {
+                path.push_back(i);
+                i = succ[i];
+                if (path.size() > n)
+                    throw foxxll::bad_parameter("stxxl::list_rank(): the successors contain a cycle");
+            }
+            rank[i] = 0;
+            for (size_t k = path.size(); k-- > 0; )
+                rank[path[k]] = std::get<2>(v[path[k]]) + rank[succ[path[k]]];
+            ranked += path.size() + 1;
+        }
+        if (ranked != n)
+            throw foxxll::bad_parameter("stxxl::list_rank(): the successors contain a cycle");
+
+        ranks.clear();
+        typename rank_vector_type::bufwriter_type writer(ranks);
+        for (size_t i = 0; i < n; ++i)
+            writer << rank_pair_type(std::get<0>(v[i]), rank[i]);
+        writer.finish();
+    }
+
+public:
+    //! Rank the nodes sorted by id, writing (id, rank) sorted by id.
+    static void rank(const node_vector_type& nodes, rank_vector_type& ranks,
+                     size_t mem, unsigned round = 0)
+    {
+        if (nodes.size() * sizeof(node_type) <= mem / 2) {
+            rank_internal(nodes, ranks);
+            return;
+        }
+
+        TLX_LOGC(debug) << "list_rank(): round " << round << " of " << nodes.size() << " nodes";
+
+        // find the predecessor of each node
+        pred_sorter_type preds(pred_less(), mem / 2);
+        for (typename node_vector_type::bufreader_type in(nodes); !in.empty(); ++in)
+        {
+            if (!is_tail(*in))
+                preds.push(pred_type(std::get<1>(*in), std::get<0>(*in)));
+        }
+        preds.sort();
+
+        // remove an independent set and the lone tails
+        bridge_sorter_type bridges(bridge_less(), mem / 2);
+        removed_vector_type removed;
+        node_vector_type kept;
+        id_vector_type lone;
+        {
+            typename removed_vector_type::bufwriter_type removed_writer(removed);
+            typename node_vector_type::bufwriter_type kept_writer(kept);
+            typename id_vector_type::bufwriter_type lone_writer(lone);
+
+            for (typename node_vector_type::bufreader_type in(nodes); !in.empty(); ++in)
+            {
+                const node_type& v = *in;
+                const NodeId& id = std::get<0>(v);
+
+                const bool has_pred = !preds.empty() && std::get<0>(*preds) == id;
+                NodeId pred = 0;
+                if (has_pred) {
+                    pred = std::get<1>(*preds);
+                    ++preds;
+                    if (!preds.empty() && std::get<0>(*preds) == id)
+                        throw foxxll::bad_parameter("stxxl::list_rank(): a node has two predecessors");
+                }
+
+                if (!is_tail(v) && coin(id, round) && (!has_pred || !coin(pred, round)))
+                {
+                    removed_writer << removed_type(std::get<1>(v), id, std::get<2>(v));
+                    if (has_pred)
+                        bridges.push(bridge_type(pred, std::get<1>(v), std::get<2>(v)));
+                }
+                else if (is_tail(v) && !has_pred)
+                    lone_writer << id;
+                else
+                    kept_writer << v;
+            }
+            removed_writer.finish();
+            kept_writer.finish();
+            lone_writer.finish();
+        }
+        preds.finish_clear();
+        bridges.sort();
+
+        // link the predecessors of removed nodes to their successors
+        node_vector_type next;
+        {
+            typename node_vector_type::bufwriter_type writer(next);
+            for (typename node_vector_type::bufreader_type in(kept); !in.empty(); ++in)
+            {
+                node_type v = *in;
+                if (!bridges.empty() && std::get<0>(*bridges) == std::get<0>(v)) {
+                    std::get<1>(v) = std::get<1>(*bridges);
+                    std::get<2>(v) += std::get<2>(*bridges);
+                    ++bridges;
+                }
+                writer << v;
+            }
+            writer.finish();
+        }
+        assert(bridges.empty());
+        bridges.finish_clear();
+        kept.clear();
+
+        rank_vector_type next_ranks;
+        rank(next, next_ranks, mem, round + 1);
+        next.clear();
+
+        // rank the removed nodes from their successors, which were kept
+        removed_sorter_type removed_sorter(removed_less(), mem / 2);
+        for (typename removed_vector_type::bufreader_type in(removed); !in.empty(); ++in)
+            removed_sorter.push(*in);
+        removed.clear();
+        removed_sorter.sort(mem / 4);
+
+        rank_sorter_type removed_ranks(rank_less(), mem / 4);
+        for (typename rank_vector_type::bufreader_type in(next_ranks);
+             !in.empty() && !removed_sorter.empty(); ++in)
+        {
+            while (!removed_sorter.empty() && std::get<0>(*removed_sorter) == std::get<0>(*in)) {
+                removed_ranks.push(rank_pair_type(
+                                       std::get<1>(*removed_sorter),
+                                       std::get<2>(*removed_sorter) + std::get<1>(*in)));
+                ++removed_sorter;
+            }
+        }
+        assert(removed_sorter.empty());
+        removed_sorter.finish_clear();
+
+        for (typename id_vector_type::bufreader_type in(lone); !in.empty(); ++in)
+            removed_ranks.push(rank_pair_type(*in, 0));
+        lone.clear();
+        removed_ranks.sort();
+
+        // merge both by id
+        ranks.clear();
+        typename rank_vector_type::bufwriter_type writer(ranks);
+        for (typename rank_vector_type::bufreader_type in(next_ranks);
+             !in.empty() || !removed_ranks.empty(); )
+        {
+            if (removed_ranks.empty() ||
+                (!in.empty() && std::get<0>(*in) < std::get<0>(*removed_ranks))) {
+                writer << *in;
+                ++in;
+            }
+            else {
+                writer << *removed_ranks;
+                ++removed_ranks;
+            }
+        }
+        writer.finish();
+    }
+};
+
+//! Rank the nodes and write their ranks, which are all ids 0..n-1, to rank.
+template <typename NodeId, typename Rank, typename RankVector>
+void rank_to_vector(const typename ranker<NodeId, Rank>::node_vector_type& nodes,
+                    RankVector& rank, size_t M)
+{
+    using ranker_type = ranker<NodeId, Rank>;
+    typename ranker_type::rank_vector_type ranks;
+    ranker_type::rank(nodes, ranks, M);
+
+    rank.resize(ranks.size());
+    typename ranker_type::rank_vector_type::bufreader_type in(ranks);
+    stream::choose<decltype(in), 1> rank_stream(in);
+    stream::materialize(rank_stream, rank.begin(), rank.end());
+}
+
+} // namespace list_rank_local
+
+/*!
+ * Rank the lists given by the successor array succ in external memory:
+ * succ[i] is the node following i, and the tail of each list points to
+ * itself. rank[i] receives the sum of the weights of the nodes from i to the
+ * tail of its list, excluding the tail, such that the tails are ranked zero.
+ * succ may hold any number of disjoint lists, but no cycles.
+ *
+ * The lists are ranked by independent set removal, which takes O(sort(n))
+ * I/Os in expectation. The sorts run in parallel with STXXL_PARALLEL.
+ *
+ * \param succ successor array, an stxxl::vector
+ * \param weight weight of the link from i to succ[i], of the same size
+ * \param rank vector receiving the ranks, an stxxl::vector
+ * \param M internal memory to use in bytes
+ */
+template <typename SuccVector, typename WeightVector, typename RankVector>
+void list_rank(const SuccVector& succ, const WeightVector& weight, RankVector& rank,
+               size_t M)
+{
+    using node_id_type = typename SuccVector::value_type;
+    using rank_type = typename RankVector::value_type;
+    using ranker_type = list_rank_local::ranker<node_id_type, rank_type>;
+    using node_type = typename ranker_type::node_type;
+
+    const external_size_type n = succ.size();
+    if (weight.size() != n)
+        throw foxxll::bad_parameter("stxxl::list_rank(): weight and succ differ in size");
+
+    typename ranker_type::node_vector_type nodes;
+    {
+        typename ranker_type::node_vector_type::bufwriter_type writer(nodes);
+        typename SuccVector::bufreader_type succ_in(succ);
+        typename WeightVector::bufreader_type weight_in(weight);
+        for (external_size_type i = 0; i < n; ++i, ++succ_in, ++weight_in)
+        {
+            if (static_cast<external_size_type>(*succ_in) >= n)
+                throw foxxll::bad_parameter("stxxl::list_rank(): successor out of range");
+            writer << node_type(node_id_type(i), *succ_in, rank_type(*weight_in));
+        }
+        writer.finish();
+    }
+
+    list_rank_local::rank_to_vector<node_id_type, rank_type>(nodes, rank, M);
+}
+
+/*!
+ * Rank the lists given by the successor array succ in external memory with
+ * unit weights: rank[i] is the number of links from i to the tail of its
+ * list. See the weighted list_rank().
+ *
+ * \param succ successor array, an stxxl::vector
+ * \param rank vector receiving the ranks, an stxxl::vector
+ * \param M internal memory to use in bytes
+ */
+template <typename SuccVector, typename RankVector>
+void list_rank(const SuccVector& succ, RankVector& rank, size_t M)
+{
+    using node_id_type = typename SuccVector::value_type;
+    using rank_type = typename RankVector::value_type;
+    using ranker_type = list_rank_local::ranker<node_id_type, rank_type>;
+    using node_type = typename ranker_type::node_type;
+
+    const external_size_type n = succ.size();
+
+    typename ranker_type::node_vector_type nodes;
+    {
+        typename ranker_type::node_vector_type::bufwriter_type writer(nodes);
+        typename SuccVector::bufreader_type succ_in(succ);
+        for (external_size_type i = 0; i < n; ++i, ++succ_in)
+        {
+            if (static_cast<external_size_type>(*succ_in) >= n)
+                throw foxxll::bad_parameter("stxxl::list_rank(): successor out of range");
+            const rank_type w = (*succ_in == node_id_type(i)) ? 0 : 1;
+            writer << node_type(node_id_type(i), *succ_in, w);
+        }
+        writer.finish();
+    }
+
+    list_rank_local::rank_to_vector<node_id_type, rank_type>(nodes, rank, M);
+}
+
+/*!
+ * Compute the Euler tour of the forest given by the parent array parent in
+ * external memory: parent[v] is the parent of node v, and the roots are
+ * their own parents. tour receives 2n nodes, each node is written when the
+ * tour enters and when it leaves it, visiting the children of each node in
+ * order of their ids and the trees in order of their roots. The number of
+ * nodes entered before v is its preorder number, and half the distance of
+ * the two positions of v, plus one half, is the size of its subtree.
+ *
+ * The tour is built by sorting the children by their parents and ranked by
+ * list_rank(), which takes O(sort(n)) I/Os in expectation.
+ *
+ * \param parent parent array, an stxxl::vector
+ * \param tour vector receiving the tour, an stxxl::vector
+ * \param M internal memory to use in bytes
+ */
+template <typename ParentVector, typename TourVector>
+void euler_tour(const ParentVector& parent, TourVector& tour, size_t M)
+{
+    using node_id_type = typename ParentVector::value_type;
+    using ranker_type = list_rank_local::ranker<node_id_type, node_id_type>;
+    using node_type = typename ranker_type::node_type;
+
+    const external_size_type n = parent.size();
+    if (2 * n + 1 >= static_cast<external_size_type>(std::numeric_limits<node_id_type>::max()))
+        throw foxxll::bad_parameter("stxxl::euler_tour(): forest is too large for the node type");
+
+    tour.clear();
+    if (n == 0)
+        return;
+
+    // (parent, child), the roots being children of the virtual node n
+    using edge_type = std::tuple<node_id_type, node_id_type>;
+    using edge_less = stxxl::comparator<edge_type, stxxl::direction::Less, stxxl::direction::Less>;
+    stxxl::sorter<edge_type, edge_less> edges(edge_less(), M / 2);
+
+    {
+        typename ParentVector::bufreader_type in(parent);
+        for (external_size_type v = 0; v < n; ++v, ++in)
+        {
+            if (static_cast<external_size_type>(*in) >= n)
+                throw foxxll::bad_parameter("stxxl::euler_tour(): parent out of range");
+            edges.push(edge_type(*in == node_id_type(v) ? node_id_type(n) : *in, node_id_type(v)));
+        }
+    }
+    edges.sort();
+
+    // first child of each node in order of the nodes, and (child, next
+    // sibling, parent) with n for none
+    using sibling_type = std::tuple<node_id_type, node_id_type, node_id_type>;
+    using sibling_less = stxxl::comparator<sibling_type, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare>;
+    stxxl::sorter<sibling_type, sibling_less> siblings(sibling_less(), M / 2);
+
+    stxxl::vector<edge_type> first_child;
+    {
+        typename stxxl::vector<edge_type>::bufwriter_type writer(first_child);
+        node_id_type prev_parent = node_id_type(n);
+        bool first = true;
+        while (!edges.empty())
+        {
+            const edge_type e = *edges;
+            ++edges;
+            if ((first || std::get<0>(e) != prev_parent) && std::get<0>(e) != node_id_type(n))
+                writer << e;
+            first = false;
+            prev_parent = std::get<0>(e);
+
+            const node_id_type next =
+                (!edges.empty() && std::get<0>(*edges) == std::get<0>(e))
+                ? std::get<1>(*edges) : node_id_type(n);
+            siblings.push(sibling_type(std::get<1>(e), next, std::get<0>(e)));
+        }
+        writer.finish();
+    }
+    edges.finish_clear();
+    siblings.sort();
+
+    // the tour enters v at 2v and leaves it at 2v + 1
+    typename ranker_type::node_vector_type nodes;
+    {
+        typename ranker_type::node_vector_type::bufwriter_type writer(nodes);
+        typename stxxl::vector<edge_type>::bufreader_type fc(first_child);
+        for (external_size_type v = 0; v < n; ++v, ++siblings)
+        {
+            assert(!siblings.empty() && std::get<0>(*siblings) == node_id_type(v));
+            const node_id_type enter = node_id_type(2 * v), leave = node_id_type(2 * v + 1);
+
+            if (!fc.empty() && std::get<0>(*fc) == node_id_type(v)) {
+                writer << node_type(enter, node_id_type(2 * std::get<1>(*fc)), 1);
+                ++fc;
+            }
+            else
+                writer << node_type(enter, leave, 1);
+
+            const node_id_type& next = std::get<1>(*siblings);
+            const node_id_type& up = std::get<2>(*siblings);
+            if (next != node_id_type(n))
+                writer << node_type(leave, node_id_type(2 * next), 1);
+            else if (up != node_id_type(n))
+                writer << node_type(leave, node_id_type(2 * up + 1), 1);
+            else // the tour's tail
+                writer << node_type(leave, leave, 0);
+        }
+        writer.finish();
+    }
+    siblings.finish_clear();
+    first_child.clear();
+
+    typename ranker_type::rank_vector_type ranks;
+    ranker_type::rank(nodes, ranks, M);
+    nodes.clear();
+
+    // (position, node) with position = 2n - 1 - rank
+    stxxl::sorter<edge_type, edge_less> positions(edge_less(), M);
+    for (typename ranker_type::rank_vector_type::bufreader_type in(ranks); !in.empty(); ++in)
+    {
+        positions.push(edge_type(node_id_type(2 * n - 1 - std::get<1>(*in)),
+                                 node_id_type(std::get<0>(*in) / 2)));
+    }
+    ranks.clear();
+    positions.sort();
+
+    tour.resize(2 * n);
+    stream::choose<decltype(positions), 1> tour_stream(positions);
+    stream::materialize(tour_stream, tour.begin(), tour.end());
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_LIST_RANK_HEADER
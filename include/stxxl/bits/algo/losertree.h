@@ -16,6 +16,7 @@
 #define STXXL_ALGO_LOSERTREE_HEADER
 
 #include <algorithm>
+#include <type_traits>
 #include <utility>
 
 #include <foxxll/common/types.hpp>
@@ -24,11 +25,32 @@
 #include <tlx/define.hpp>
 #include <tlx/logger/core.hpp>
 
+#include <stxxl/bits/algo/run_cursor.h>
+#include <stxxl/bits/common/comparator.h>
 #include <stxxl/types>
 #include <tlx/math/integer_log2.hpp>
 
 namespace stxxl {
 
+namespace loser_tree_local {
+
+//! Whether the run cursor comparator exposes its value comparator as
+//! value_cmp and the values are is_branchless_comparable with it.
+template <typename ValueType, typename CursorCmpType, typename = void>
+struct is_branchless_cursor_cmp : public std::false_type
+{ };
+
+template <typename ValueType, typename CursorCmpType>
+struct is_branchless_cursor_cmp<
+    ValueType, CursorCmpType,
+    typename std::conditional<
+        true, void, typename CursorCmpType::value_cmp>::type>
+    : public is_branchless_comparable<
+          ValueType, typename CursorCmpType::value_cmp>
+{ };
+
+} // namespace loser_tree_local
+
 template <typename RunCursorType,
           typename RunCursorCmpType>
 class loser_tree
@@ -67,6 +89,38 @@ public:
     using prefetcher_type = typename RunCursorType::prefetcher_type;
     using value_type = typename RunCursorType::value_type;
 
+private:
+    //! whether matches are played by conditional moves, see
+    //! is_branchless_comparable
+    static constexpr bool branchless =
+        loser_tree_local::is_branchless_cursor_cmp<
+            value_type, RunCursorCmpType>::value;
+
+    //! Play the winner against the loser in slot, leaves the loser in slot.
+    void play(size_t& slot, size_t& winnerIndex, RunCursorType*& winnerE,
+              std::false_type)
+    {
+        RunCursorType* currentE = current + slot;
+        if (cmp(*currentE, *winnerE))
+        {
+            std::swap(slot, winnerIndex);
+            winnerE = currentE;
+        }
+    }
+
+    //! Play the winner against the loser in slot without branching on the
+    //! outcome, the slot is always written.
+    void play(size_t& slot, size_t& winnerIndex, RunCursorType*& winnerE,
+              std::true_type)
+    {
+        const size_t index = slot;
+        const bool lost = cmp(current[index], *winnerE);
+        slot = lost ? winnerIndex : index;
+        winnerIndex = lost ? index : winnerIndex;
+        winnerE = current + winnerIndex;
+    }
+
+public:
     loser_tree(
         prefetcher_type* p,
         size_t nruns,
@@ -91,7 +145,7 @@ public:
         // init cursors
         for (i = 0; i < nruns; ++i)
         {
-            current[i].buffer = p->pull_block();
+            pull_first_block(current[i], p);
             //current[i].pos = 0; // done in constructor
             entry[kReg + i] = i;
         }
@@ -129,7 +183,7 @@ private:
     template <int LogK>
     void multi_merge_unrolled(value_type* out_first, value_type* out_last)
     {
-        RunCursorType* currentE, * winnerE;
+        RunCursorType* winnerE;
         size_t* regEntry = entry;
         size_t winnerIndex = regEntry[0];
 
@@ -141,17 +195,12 @@ private:
 
             ++(*winnerE);
 
-#define TreeStep(L)                                                                                              \
-    if (LogK >= L)                                                                                               \
-    {                                                                                                            \
-        currentE = current +                                                                                     \
-                   regEntry[(winnerIndex + (1 << LogK)) >> (((int(LogK - L) + 1) >= 0) ? ((LogK - L) + 1) : 0)]; \
-        if (cmp(*currentE, *winnerE))                                                                            \
-        {                                                                                                        \
-            std::swap(regEntry[(winnerIndex + (1 << LogK))                                                       \
-                               >> (((int(LogK - L) + 1) >= 0) ? ((LogK - L) + 1) : 0)], winnerIndex);            \
-            winnerE = currentE;                                                                                  \
-        }                                                                                                        \
+#define TreeStep(L)                                                             \
+    if (LogK >= L)                                                              \
+    {                                                                           \
+        play(regEntry[(winnerIndex + (1 << LogK))                               \
+                      >> (((int(LogK - L) + 1) >= 0) ? ((LogK - L) + 1) : 0)],  \
+             winnerIndex, winnerE, std::integral_constant<bool, branchless>()); \
     }
 
             TreeStep(10);
@@ -183,7 +232,7 @@ private:
 
     void multi_merge_k(value_type* out_first, value_type* out_last)
     {
-        RunCursorType* currentE, * winnerE;
+        RunCursorType* winnerE;
         size_t kReg = k;
         size_t winnerIndex = entry[0];
 
@@ -196,15 +245,8 @@ private:
             ++(*winnerE);
 
             for (size_t i = (winnerIndex + kReg) >> 1; i > 0; i >>= 1)
-            {
-                currentE = current + entry[i];
-
-                if (cmp(*currentE, *winnerE))
-                {
-                    std::swap(entry[i], winnerIndex);
-                    winnerE = currentE;
-                }
-            }
+                play(entry[i], winnerIndex, winnerE,
+                     std::integral_constant<bool, branchless>());
         }
 
         entry[0] = winnerIndex;
@@ -253,6 +295,13 @@ public:
             break;
         }
     }
+
+    //! Cursor holding the element multi_merge() outputs next, it is empty
+    //! once all runs are exhausted.
+    const RunCursorType & winner() const
+    {
+        return current[entry[0]];
+    }
 };
 
 } // namespace stxxl
@@ -0,0 +1,348 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/permute.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_PERMUTE_HEADER
+#define STXXL_ALGO_PERMUTE_HEADER
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/utils.hpp>
+#include <foxxll/mng/read_write_pool.hpp>
+
+#include <stxxl/bits/defines.h>
+#include <stxxl/bits/stream/materialize.h>
+#include <stxxl/bits/stream/stream.h>
+#include <stxxl/stack>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+namespace permute_local {
+
+//! Buckets of a distribution pass: stacks whose blocks are written by one
+//! scheduler sharing a pool of write buffers, as in random_shuffle().
+template <typename ValueType, size_t BlockSize, unsigned PageSize>
+class bucket_set
+{
+public:
+    using stack_type = typename STACK_GENERATOR<
+              ValueType, external, grow_shrink2, PageSize, BlockSize>::result;
+    using block_type = typename stack_type::block_type;
+
+private:
+    foxxll::read_write_pool<block_type> m_pool;
+    typename stack_type::scheduler_type m_scheduler;
+    std::vector<std::unique_ptr<stack_type> > m_stacks;
+
+public:
+    bucket_set(size_t k, size_t write_buffers)
+        : m_pool(0, write_buffers), m_scheduler(m_pool)
+    {
+        for (size_t b = 0; b < k; ++b)
+            m_stacks.emplace_back(new stack_type(m_scheduler, 0));
+    }
+
+    void push(size_t b, const ValueType& v)
+    {
+        m_stacks[b]->push(v);
+    }
+
+    //! Write the buffered blocks and turn the pool to prefetching.
+    void flush()
+    {
+        m_scheduler.flush();
+        m_pool.resize_write(0);
+        m_pool.resize_prefetch(PageSize);
+    }
+
+    stack_type& bucket(size_t b)
+    {
+        m_stacks[b]->set_prefetch_aggr(PageSize);
+        return *m_stacks[b];
+    }
+
+    //! Free bucket b once it was read.
+    void release(size_t b)
+    {
+        m_stacks[b].reset();
+    }
+};
+
+//! Stream popping the elements of a stack.
+template <typename StackType>
+class stack_stream
+{
+    StackType& m_stack;
+
+public:
+    using value_type = typename StackType::value_type;
+
+    explicit stack_stream(StackType& stack) : m_stack(stack) { }
+
+    const value_type& operator * () const
+    {
+        return m_stack.top();
+    }
+
+    stack_stream& operator ++ ()
+    {
+        m_stack.pop();
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return m_stack.empty();
+    }
+};
+
+//! Raise M to the minimum of a distribution pass: 6 blocks and a page.
+template <size_t BlockSize, unsigned PageSize>
+size_t check_memory(size_t M, const char* name)
+{
+    const size_t min_memory = 6 * BlockSize + PageSize * BlockSize;
+    if (M < min_memory) {
+        TLX_LOG1 << name << ": insufficient memory, " << M << " bytes supplied,";
+        TLX_LOG1 << name << ": increasing to " << min_memory << " bytes (6 blocks + 1 page)";
+        return min_memory;
+    }
+    return M;
+}
+
+//! Number of buckets splitting range elements of value_size bytes, such that
+//! each fits into half of the memory of the next pass, at most M / 3 blocks.
+template <size_t BlockSize, unsigned PageSize>
+size_t num_buckets(uint64_t range, size_t value_size, size_t M)
+{
+    const size_t k = static_cast<size_t>(
+        std::min<uint64_t>(M / (3 * BlockSize),
+                           foxxll::div_ceil(range * value_size,
+                                            (M - M / 3 - PageSize * BlockSize) / 2)));
+    return std::max<size_t>(2, k);
+}
+
+/*!
+ * Write the value v of each pair (i, v) of the stream pairs to out[i], with
+ * i in [0, range) and each i exactly once. If the range fits into half of the
+ * memory, it is filled in memory and written sequentially. Otherwise the pairs
+ * are distributed into buckets of subranges, on which this recurses.
+ */
+template <size_t BlockSize, unsigned PageSize,
+          typename PairStream, typename OutputIterator>
+void scatter_pairs(PairStream& pairs, uint64_t range, OutputIterator out, size_t M)
+{
+    constexpr bool debug = false;
+    using value_type = typename std::decay<
+              typename std::tuple_element<1, typename PairStream::value_type>::type>::type;
+
+    M = check_memory<BlockSize, PageSize>(M, "scatter");
+
+    if (range * sizeof(value_type) <= M / 2)
+    {
+        std::vector<value_type> values(static_cast<size_t>(range));
+        for ( ; !pairs.empty(); ++pairs)
+            values[static_cast<size_t>(std::get<0>(*pairs))] = std::get<1>(*pairs);
+
+        auto in = stream::streamify(values.begin(), values.end());
+        stream::materialize(in, out, out + range);
+        return;
+    }
+
+    const size_t k = num_buckets<BlockSize, PageSize>(range, sizeof(value_type), M);
+    const uint64_t sub = foxxll::div_ceil(range, k);
+    TLX_LOG << "scatter: " << range << " elements into " << k << " buckets";
+
+    using pair_type = std::pair<uint64_t, value_type>;
+    bucket_set<pair_type, BlockSize, PageSize> buckets(k, M / BlockSize - k);
+    for ( ; !pairs.empty(); ++pairs)
+    {
+        const uint64_t i = std::get<0>(*pairs);
+        buckets.push(static_cast<size_t>(i / sub), pair_type(i % sub, std::get<1>(*pairs)));
+    }
+    buckets.flush();
+
+    size_t space_left = M - k * BlockSize - PageSize * BlockSize;
+    for (size_t b = 0; b < k; ++b)
+    {
+        const uint64_t begin = b * sub;
+        if (begin >= range)
+            break;
+        stack_stream<typename bucket_set<pair_type, BlockSize, PageSize>::stack_type>
+        bucket(buckets.bucket(b));
+        scatter_pairs<BlockSize, PageSize>(
+            bucket, std::min(sub, range - begin), out + begin, space_left);
+        buckets.release(b);
+        space_left += BlockSize;
+    }
+}
+
+/*!
+ * Answer each request (i, j) of the stream requests, with i in [0, range), by
+ * calling answer(j, in[i]). If the range fits into half of the memory,
+ * it is read at once, otherwise the requests are distributed into buckets of
+ * subranges, on which this recurses.
+ */
+template <size_t BlockSize, unsigned PageSize, typename RequestStream,
+          typename InputIterator, typename AnswerFunction>
+void answer_requests(RequestStream& requests, uint64_t range,
+                     InputIterator in, AnswerFunction& answer, size_t M)
+{
+    constexpr bool debug = false;
+    using value_type = typename std::iterator_traits<InputIterator>::value_type;
+
+    M = check_memory<BlockSize, PageSize>(M, "permute");
+
+    if (range * sizeof(value_type) <= M / 2)
+    {
+        std::vector<value_type> values(static_cast<size_t>(range));
+        auto source = stream::streamify(in, in + range);
+        stream::materialize(source, values.begin());
+
+        for ( ; !requests.empty(); ++requests)
+            answer(std::get<1>(*requests), values[static_cast<size_t>(std::get<0>(*requests))]);
+        return;
+    }
+
+    const size_t k = num_buckets<BlockSize, PageSize>(range, sizeof(value_type), M);
+    const uint64_t sub = foxxll::div_ceil(range, k);
+    TLX_LOG << "permute: " << range << " sources into " << k << " buckets";
+
+    using request_type = std::pair<uint64_t, uint64_t>;
+    bucket_set<request_type, BlockSize, PageSize> buckets(k, M / BlockSize - k);
+    for ( ; !requests.empty(); ++requests)
+    {
+        const uint64_t i = std::get<0>(*requests);
+        buckets.push(static_cast<size_t>(i / sub),
+                     request_type(i % sub, std::get<1>(*requests)));
+    }
+    buckets.flush();
+
+    size_t space_left = M - k * BlockSize - PageSize * BlockSize;
+    for (size_t b = 0; b < k; ++b)
+    {
+        const uint64_t begin = b * sub;
+        if (begin >= range)
+            break;
+        stack_stream<typename bucket_set<request_type, BlockSize, PageSize>::stack_type>
+        bucket(buckets.bucket(b));
+        // sources nobody requested are not read
+        if (!bucket.empty())
+            answer_requests<BlockSize, PageSize>(
+                bucket, std::min(sub, range - begin), in + begin, answer, space_left);
+        buckets.release(b);
+        space_left += BlockSize;
+    }
+}
+
+} // namespace permute_local
+
+//! External scatter: out[perm[i]] = in[i] for each i in [0, n), with
+//! n = in_last - in_first and perm a permutation of [0, n).
+//!
+//! The pairs (perm[i], in[i]) are distributed into buckets of destination
+//! ranges, recursively until a range fits into half of the memory. Each range
+//! is then filled in memory and written sequentially, about two I/O passes
+//! per distribution level instead of two sorts of tagged records.
+//!
+//! \param in_first begin of the values to scatter
+//! \param in_last end of the values to scatter
+//! \param perm_first begin of the n destination indexes
+//! \param out_first begin of the n output elements
+//! \param M number of bytes for internal use
+//!
+//! - BlockSize size of the blocks of the buckets
+//! - PageSize number of blocks prefetched from a bucket
+template <size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(uint64_t), unsigned PageSize = 4,
+          typename InputIterator, typename IndexIterator, typename OutputIterator>
+void scatter(InputIterator in_first, InputIterator in_last,
+             IndexIterator perm_first, OutputIterator out_first, size_t M)
+{
+    const uint64_t n = static_cast<uint64_t>(in_last - in_first);
+    if (n == 0)
+        return;
+
+    auto in = stream::streamify(in_first, in_last);
+    auto perm = stream::streamify(perm_first, perm_first + n);
+    stream::make_tuplestream<decltype(perm), decltype(in)> pairs(perm, in);
+
+    permute_local::scatter_pairs<BlockSize, PageSize>(pairs, n, out_first, M);
+}
+
+//! External permute: out[i] = in[idx[i]] for each i in [0, m), with
+//! m = idx_last - idx_first and idx any indexes into [in_first, in_last),
+//! e.g. a permutation.
+//!
+//! The requests (idx[i], i) are distributed into buckets of source ranges that
+//! fit into half of the memory, recursively if needed. Each range is read once
+//! to answer its requests with pairs (i, in[idx[i]]), which are scattered to
+//! the output, see scatter().
+//!
+//! \param in_first begin of the values to read
+//! \param in_last end of the values to read
+//! \param idx_first begin of the source indexes
+//! \param idx_last end of the source indexes
+//! \param out_first begin of the m output elements
+//! \param M number of bytes for internal use
+//!
+//! - BlockSize size of the blocks of the buckets
+//! - PageSize number of blocks prefetched from a bucket
+template <size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(uint64_t), unsigned PageSize = 4,
+          typename InputIterator, typename IndexIterator, typename OutputIterator>
+void permute(InputIterator in_first, InputIterator in_last,
+             IndexIterator idx_first, IndexIterator idx_last,
+             OutputIterator out_first, size_t M)
+{
+    using value_type = typename std::iterator_traits<InputIterator>::value_type;
+    using answer_set = permute_local::bucket_set<
+              std::pair<uint64_t, value_type>, BlockSize, PageSize>;
+
+    const uint64_t n = static_cast<uint64_t>(in_last - in_first);
+    const uint64_t m = static_cast<uint64_t>(idx_last - idx_first);
+    if (m == 0)
+        return;
+
+    M = permute_local::check_memory<BlockSize, PageSize>(M, "permute");
+
+    // the answers are pushed onto one stack with 2 write buffers
+    answer_set answers(1, 2);
+    auto answer = [&answers](uint64_t i, const value_type& v) {
+                      answers.push(0, std::make_pair(i, v));
+                  };
+    {
+        auto idx = stream::streamify(idx_first, idx_last);
+        stream::counter<uint64_t> dest;
+        stream::make_tuplestream<decltype(idx), decltype(dest)> requests(idx, dest);
+        permute_local::answer_requests<BlockSize, PageSize>(
+            requests, n, in_first, answer, M - 3 * BlockSize);
+    }
+    answers.flush();
+
+    permute_local::stack_stream<typename answer_set::stack_type>
+    pairs(answers.bucket(0));
+    permute_local::scatter_pairs<BlockSize, PageSize>(
+        pairs, m, out_first, M - 3 * BlockSize);
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_PERMUTE_HEADER
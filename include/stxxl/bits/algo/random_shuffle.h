@@ -20,11 +20,14 @@
 //        (free stacks buffers)
 // TODO: shuffle small input in internal memory
 
+#include <algorithm>
+#include <mutex>
 #include <random>
 #include <vector>
 
 #include <tlx/logger/core.hpp>
 
+#include <stxxl/bits/common/seed.h>
 #include <stxxl/bits/parallel.h>
 #include <stxxl/bits/stream/stream.h>
 #include <stxxl/scan>
@@ -89,12 +92,15 @@ void random_shuffle(ExtIterator first,
     TLX_LOG << "random_shuffle: " << M / BlockSize - k << " write buffers for " << k << " buckets";
     foxxll::read_write_pool<block_type> pool(0, M / BlockSize - k);  // no read buffers and M/B-k write buffers
 
+    // allocates each bucket's blocks in extents and writes them in batches
+    typename stack_type::scheduler_type scheduler(pool);
+
     stack_type** buckets;
 
     // create and put buckets into container
     buckets = new stack_type*[k];
     for (size_t j = 0; j < k; j++)
-        buckets[j] = new stack_type(pool, 0);
+        buckets[j] = new stack_type(scheduler, 0);
 
     ///// Reading input /////////////////////
     using input_stream = typename stream::streamify_traits<ExtIterator>::stream_type;
@@ -110,6 +116,7 @@ void random_shuffle(ExtIterator first,
 
     ///// Processing //////////////////////
     // resize buffers
+    scheduler.flush();
     pool.resize_write(0);
     pool.resize_prefetch(PageSize);
 
@@ -265,12 +272,15 @@ void random_shuffle(
     // no read buffers and M/B-k write buffers
     foxxll::read_write_pool<block_type> pool(0, M / BlockSize - k);
 
+    // allocates each bucket's blocks in extents and writes them in batches
+    typename stack_type::scheduler_type scheduler(pool);
+
     stack_type** buckets;
 
     // create and put buckets into container
     buckets = new stack_type*[k];
     for (j = 0; j < k; j++)
-        buckets[j] = new stack_type(pool, 0);
+        buckets[j] = new stack_type(scheduler, 0);
 
     using buf_istream_type = foxxll::buf_istream<block_type, bids_container_iterator>;
     using buf_ostream_type = foxxll::buf_ostream<block_type, bids_container_iterator>;
@@ -303,6 +313,7 @@ void random_shuffle(
 
     ///// Processing //////////////////////
     // resize buffers
+    scheduler.flush();
     pool.resize_write(0);
     pool.resize_prefetch(PageSize);
 
@@ -415,6 +426,238 @@ void shuffle(
     random_shuffle<VectorConfig>(first, last, rand, M);
 }
 
+//! Parallel external equivalent of std::shuffle (for stxxl::vector).
+//!
+//! The elements are distributed into random buckets by all threads, each
+//! drawing from its own random number generator seeded by \c seed_sequence
+//! and collecting the elements of each bucket in a thread-local buffer,
+//! which is pushed into the bucket once it is full. The buckets are then
+//! read back in order and shuffled in internal memory in parallel, several
+//! buckets at once if they fit.
+//!
+//! \param first begin of the range to shuffle
+//! \param last end of the range to shuffle
+//! \param M number of bytes for internal use
+template <typename VectorConfig>
+void parallel_shuffle(
+    stxxl::vector_iterator<VectorConfig> first,
+    stxxl::vector_iterator<VectorConfig> last,
+    size_t M)
+{
+    constexpr bool debug = false;
+
+    using ExtIterator = stxxl::vector_iterator<VectorConfig>;
+    using AllocStrategy = typename ExtIterator::vector_type::alloc_strategy_type;
+    constexpr unsigned PageSize = ExtIterator::vector_type::page_size;
+    constexpr unsigned BlockSize = ExtIterator::vector_type::block_size;
+    using value_type = typename ExtIterator::value_type;
+    using size_type = typename ExtIterator::size_type;
+    using bids_container_iterator = typename ExtIterator::bids_container_iterator;
+    using stack_type = typename stxxl::STACK_GENERATOR<value_type, stxxl::external,
+                                                       stxxl::grow_shrink2, PageSize, BlockSize>::result;
+    using block_type = typename stack_type::block_type;
+    using vector_block_type = typename ExtIterator::block_type;
+    using rng_type = std::mt19937_64;
+
+    TLX_LOG << "parallel_shuffle: Vector Version";
+
+    if (first == last)
+        return;
+
+    // make sure we have at least 6 blocks + 1 page
+    if (M < 6 * BlockSize + PageSize * BlockSize) {
+        TLX_LOG1 << "parallel_shuffle: insufficient memory, " << M << " bytes supplied,";
+        M = 6 * BlockSize + PageSize * BlockSize;
+        TLX_LOG1 << "parallel_shuffle: increasing to " << M << " bytes (6 blocks + 1 page)";
+    }
+
+    const size_t nthreads = task_runtime::get_instance().max_threads();
+
+    // number of buckets, each bucket needs a block of thread-local buffers
+    // in addition to the buffers of random_shuffle()
+    const size_t k = std::max<size_t>(1, M / (4 * BlockSize));
+    // elements in the thread-local buffer of each thread and bucket
+    const size_t local_size = std::max<size_t>(1, block_type::size / nthreads);
+
+    // independent random number generators
+    std::vector<rng_type> rngs;
+    for (size_t t = 0; t < nthreads; ++t)
+        rngs.emplace_back(seed_sequence::get_ref().get_next_seed());
+
+    using temp_vector_type = typename stxxl::vector<
+              value_type, PageSize, stxxl::lru_pager<4>, BlockSize, AllocStrategy
+              >;
+
+    // no read buffers and M/B-2k write buffers
+    foxxll::read_write_pool<block_type> pool(0, M / BlockSize - 2 * k);
+
+    // allocates each bucket's blocks in extents and writes them in batches
+    typename stack_type::scheduler_type scheduler(pool);
+
+    std::vector<stack_type*> buckets(k);
+    for (size_t j = 0; j < k; j++)
+        buckets[j] = new stack_type(scheduler, 0);
+
+    // keep the parts of the first and last block outside [first,last)
+    first.flush();     // flush container
+
+    std::vector<value_type> head, tail;
+    {
+        vector_block_type block;
+        if (first.block_offset())
+        {
+            block.read(*first.bid())->wait();
+            head.assign(block.elem, block.elem + first.block_offset());
+        }
+        if (last.block_offset())
+        {
+            block.read(*last.bid())->wait();
+            tail.assign(block.elem + last.block_offset(), block.elem + vector_block_type::size);
+        }
+    }
+
+    ///// Reading input /////////////////////
+
+    // thread-local buffers of each bucket, the buckets are pushed into by
+    // one thread at a time, as they share the write pool
+    std::vector<std::vector<std::vector<value_type> > > local(
+        nthreads, std::vector<std::vector<value_type> >(k));
+    std::mutex buckets_mutex;
+
+    auto flush_local =
+        [&](std::vector<value_type>& buffer, size_t bucket) {
+            std::unique_lock<std::mutex> lock(buckets_mutex);
+            for (const value_type& v : buffer)
+                buckets[bucket]->push(v);
+            buffer.clear();
+        };
+
+    scan_local::parallel_scan_blocks(
+        first, last,
+        [&](value_type* begin, value_type* end, size_type) {
+            const size_t t = task_runtime::thread_id();
+            std::uniform_int_distribution<size_t> distr(0, k - 1);
+            for ( ; begin != end; ++begin)
+            {
+                size_t bucket = distr(rngs[t]);
+                std::vector<value_type>& buffer = local[t][bucket];
+                buffer.push_back(*begin);
+                if (buffer.size() == local_size)
+                    flush_local(buffer, bucket);
+            }
+        },
+        true, false, 0);
+
+    for (size_t t = 0; t < nthreads; ++t)
+    {
+        for (size_t j = 0; j < k; ++j)
+            flush_local(local[t][j], j);
+    }
+    local.clear();
+
+    ///// Processing //////////////////////
+    // resize buffers
+    scheduler.flush();
+    pool.resize_write(0);
+    pool.resize_prefetch(PageSize);
+
+    // remaining int space
+    size_t space_left = M - k * BlockSize - PageSize * BlockSize;
+
+    using buf_ostream_type = foxxll::buf_ostream<vector_block_type, bids_container_iterator>;
+    buf_ostream_type out(first.bid(), 2);
+
+    for (const value_type& v : head)
+        out << v;
+
+    for (size_t i = 0; i < k; ) {
+        buckets[i]->set_prefetch_aggr(PageSize);
+        const size_t size = buckets[i]->size();
+        TLX_LOG << "parallel_shuffle: bucket no " << i << " contains " << size << " elements";
+
+        // does the bucket fit into memory?
+        if (size * sizeof(value_type) < space_left) {
+            // collect the following buckets that fit as well
+            std::vector<size_t> offsets(1, 0);
+            size_t total = 0, end = i;
+            while (end < k && (total + buckets[end]->size()) * sizeof(value_type) < space_left)
+            {
+                total += buckets[end]->size();
+                offsets.push_back(total);
+                ++end;
+            }
+            TLX_LOG << "parallel_shuffle: no recursion, buckets " << i << " to " << end;
+
+            // copy buckets into temp. array
+            std::vector<value_type> temp_array(total);
+            for (size_t b = i; b < end; ++b) {
+                buckets[b]->set_prefetch_aggr(PageSize);
+                for (size_t j = offsets[b - i]; j < offsets[b - i + 1]; ++j) {
+                    temp_array[j] = buckets[b]->top();
+                    buckets[b]->pop();
+                }
+            }
+
+            // shuffle the buckets in parallel
+            parallel_for(
+                0, end - i, [&](size_t b) {
+                    std::shuffle(temp_array.begin() + offsets[b],
+                                 temp_array.begin() + offsets[b + 1],
+                                 rngs[task_runtime::thread_id()]);
+                });
+
+            // write back
+            for (const value_type& v : temp_array)
+                out << v;
+
+            // free buckets
+            for ( ; i < end; ++i) {
+                delete buckets[i];
+                space_left += BlockSize;
+            }
+        }
+        else {
+            TLX_LOG << "parallel_shuffle: recursion";
+            // copy bucket into temp. stxxl::vector
+            temp_vector_type* temp_vector = new temp_vector_type(size);
+
+            for (size_t j = 0; j < size; j++) {
+                (*temp_vector)[j] = buckets[i]->top();
+                buckets[i]->pop();
+            }
+
+            pool.resize_prefetch(0);
+            space_left += PageSize * BlockSize;
+
+            TLX_LOG << "parallel_shuffle: Space left: " << space_left;
+
+            // recursive shuffle
+            stxxl::parallel_shuffle(temp_vector->begin(),
+                                    temp_vector->end(), space_left);
+
+            pool.resize_prefetch(PageSize);
+
+            // write back
+            for (size_t j = 0; j < size; j++) {
+                value_type tmp = (*temp_vector)[j];
+                out << tmp;
+            }
+
+            // free memory
+            delete temp_vector;
+
+            // free bucket
+            delete buckets[i];
+            space_left += BlockSize;
+            ++i;
+        }
+    }
+
+    // leave part of the block after last untouched
+    for (const value_type& v : tail)
+        out << v;
+}
+
 //! \}
 
 } // namespace stxxl
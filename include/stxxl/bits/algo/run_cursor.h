@@ -111,6 +111,58 @@ template <typename MustBeVoid>
 void* have_prefetcher<MustBeVoid>::untyped_prefetcher = nullptr;
 #endif
 
+/*!
+ * Run cursor of stable merging, which also records the position in the
+ * consume sequence of the block it holds. The prefetcher hands the blocks out
+ * in the order of the consume sequence to whichever cursor runs empty, hence
+ * ties of the current elements are broken by the position of the blocks in
+ * the runs, see sort_helper::stable_run_cursor2_cmp.
+ */
+template <typename BlockType,
+          typename PrefetcherType>
+struct stable_run_cursor2 : public run_cursor2<BlockType, PrefetcherType>
+{
+    using base = run_cursor2<BlockType, PrefetcherType>;
+    using block_type = typename base::block_type;
+
+    using base::pos;
+    using base::buffer;
+    using base::prefetcher;
+
+    //! position of buffer in the consume sequence
+    size_t block;
+
+    stable_run_cursor2() : block(0) { }
+
+    inline void operator ++ ()
+    {
+        assert(!this->empty());
+        ++pos;
+        if (TLX_UNLIKELY(pos >= block_type::size))
+        {
+            block = prefetcher()->pos();
+            if (prefetcher()->block_consumed(buffer))
+                pos = 0;
+        }
+    }
+};
+
+//! Pull the first block of a run cursor from the prefetcher.
+template <typename RunCursorType, typename PrefetcherType>
+inline void pull_first_block(RunCursorType& cursor, PrefetcherType* p)
+{
+    cursor.buffer = p->pull_block();
+}
+
+//! Pull the first block of a stable run cursor, recording its position.
+template <typename BlockType, typename PrefetcherType>
+inline void pull_first_block(stable_run_cursor2<BlockType, PrefetcherType>& cursor,
+                             PrefetcherType* p)
+{
+    cursor.block = p->pos();
+    cursor.buffer = p->pull_block();
+}
+
 #if 0
 template <typename block_type>
 struct run_cursor_cmp
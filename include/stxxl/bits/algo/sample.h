@@ -0,0 +1,168 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/sample.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_SAMPLE_HEADER
+#define STXXL_ALGO_SAMPLE_HEADER
+
+#include <algorithm>
+#include <random>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+#include <tlx/simple_vector.hpp>
+
+#include <foxxll/common/utils.hpp>
+#include <foxxll/io/request_operations.hpp>
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/common/seed.h>
+#include <stxxl/bits/containers/vector.h>
+#include <stxxl/bits/stream/sample.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+namespace sample_local {
+
+static constexpr bool debug = false;
+
+//! k distinct uniform random positions in [0, n) in ascending order, by
+//! Robert Floyd's algorithm.
+inline std::vector<external_size_type>
+random_positions(external_size_type n, size_t k, std::mt19937_64& rng)
+{
+    std::unordered_set<external_size_type> chosen(2 * k);
+    std::vector<external_size_type> positions;
+    positions.reserve(k);
+    for (external_size_type j = n - k; j < n; ++j)
+    {
+        const external_size_type t =
+            std::uniform_int_distribution<external_size_type>(0, j)(rng);
+        const external_size_type p = chosen.insert(t).second ? t : j;
+        if (p == j)
+            chosen.insert(j);
+        positions.push_back(p);
+    }
+    std::sort(positions.begin(), positions.end());
+    return positions;
+}
+
+//! Read the elements at the positions of a compressed vector through its page
+//! cache.
+template <typename VectorType>
+void read_positions(const VectorType& v, const std::vector<external_size_type>& positions,
+                    std::vector<typename VectorType::value_type>& out, std::true_type)
+{
+    const typename VectorType::const_iterator first = v.cbegin();
+    for (const external_size_type& p : positions)
+        out.push_back(*(first + p));
+}
+
+//! Read the blocks holding the positions of the vector directly, keeping
+//! 2 * disks blocks in flight, and pick the elements at the positions.
+template <typename VectorType>
+void read_positions(const VectorType& v, const std::vector<external_size_type>& positions,
+                    std::vector<typename VectorType::value_type>& out, std::false_type)
+{
+    using block_type = typename VectorType::block_type;
+
+    v.flush();
+
+    // the blocks holding the positions
+    std::vector<external_size_type> blocks;
+    for (const external_size_type& p : positions)
+    {
+        if (blocks.empty() || blocks.back() != p / block_type::size)
+            blocks.push_back(p / block_type::size);
+    }
+
+    const size_t nbuffers = std::min<size_t>(
+        blocks.size(), 2 * foxxll::config::get_instance()->disks_number());
+    tlx::simple_vector<block_type> buffers(nbuffers);
+    tlx::simple_vector<foxxll::request_ptr> reqs(nbuffers);
+
+    const typename VectorType::const_iterator first = v.cbegin();
+    auto issue = [&](size_t b) {
+                     reqs[b % nbuffers] = buffers[b % nbuffers].read(
+                         *((first + blocks[b] * block_type::size).bid()));
+                 };
+
+    for (size_t b = 0; b < nbuffers; ++b)
+        issue(b);
+
+    size_t i = 0;
+    for (size_t b = 0; b < blocks.size(); ++b)
+    {
+        reqs[b % nbuffers]->wait();
+        const block_type& block = buffers[b % nbuffers];
+        for ( ; i < positions.size() && positions[i] / block_type::size == blocks[b]; ++i)
+            out.push_back(block[static_cast<size_t>(positions[i] % block_type::size)]);
+        if (b + nbuffers < blocks.size())
+            issue(b + nbuffers);
+    }
+
+    TLX_LOG << "sample(): read " << blocks.size() << " of "
+            << foxxll::div_ceil(v.size(), block_type::size) << " blocks";
+}
+
+} // namespace sample_local
+
+/*!
+ * Draw a uniform random sample of k elements of the vector v without
+ * replacement, or all elements if v has at most k.
+ *
+ * The positions are drawn first, and then only the blocks holding them are
+ * read, skipping the others, with several reads in flight. A sample of k
+ * elements hence costs at most k block reads instead of a scan of v. The
+ * elements of a compressed vector are read through its page cache instead.
+ *
+ * \param v vector to sample
+ * \param k size of the sample
+ * \param seed seed of the random positions, by default the next seed of the
+ *        seed_sequence
+ * \return the sample in the order of the elements in v
+ */
+template <typename VectorType>
+std::vector<typename VectorType::value_type>
+sample(const VectorType& v, size_t k,
+       unsigned seed = seed_sequence::get_ref().get_next_seed())
+{
+    using value_type = typename VectorType::value_type;
+
+    std::vector<value_type> out;
+    if (v.size() <= k)
+    {
+        out.reserve(static_cast<size_t>(v.size()));
+        typename VectorType::bufreader_type reader(v);
+        for ( ; !reader.empty(); ++reader)
+            out.push_back(*reader);
+        return out;
+    }
+
+    std::mt19937_64 rng(seed);
+    const std::vector<external_size_type> positions =
+        sample_local::random_positions(v.size(), k, rng);
+
+    out.reserve(k);
+    sample_local::read_positions(
+        v, positions, out, typename VectorType::is_compressed());
+    return out;
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_SAMPLE_HEADER
@@ -0,0 +1,564 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/sample_sort.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_SAMPLE_SORT_HEADER
+#define STXXL_ALGO_SAMPLE_SORT_HEADER
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <tlx/define.hpp>
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/utils.hpp>
+#include <foxxll/io/request_operations.hpp>
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/buf_writer.hpp>
+#include <foxxll/mng/config.hpp>
+#include <foxxll/mng/typed_block.hpp>
+
+#include <stxxl/bits/algo/bid_adapter.h>
+#include <stxxl/bits/algo/sort_kernel.h>
+#include <stxxl/bits/common/block_array.h>
+#include <stxxl/bits/common/disk_space.h>
+#include <stxxl/bits/common/seed.h>
+#include <stxxl/bits/config.h>
+#include <stxxl/bits/parallel.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+namespace sample_sort_local {
+
+/*!
+ * Distribution sort engine, an alternative to the run formation and k-way
+ * merging of stxxl::sort and stream::sort.
+ *
+ * Elements passed to push() are collected in a batch in memory. The splitters
+ * are drawn from a random sample of the first full batch, each batch is then
+ * classified in parallel and distributed to the per-bucket block lists.
+ * Besides the buckets between two splitters, each splitter has a bucket of
+ * the elements equal to it, which is never sorted, so that many duplicates
+ * do not hurt. output() sorts groups of buckets which fit into memory
+ * together in parallel and delivers the elements in order. Buckets too large
+ * for memory are distributed again, using splitters sampled from random
+ * blocks of the bucket.
+ */
+template <typename ValueType, typename CompareType, size_t BlockSize, typename AllocStr>
+class sample_sorter
+{
+    static constexpr bool debug = false;
+
+public:
+    using value_type = ValueType;
+    using block_type = foxxll::typed_block<BlockSize, value_type>;
+    using bid_type = typename block_type::bid_type;
+
+    //! number of random samples drawn per bucket
+    static constexpr size_t oversampling = 16;
+
+    //! maximum number of buckets between two splitters
+    static constexpr size_t max_buckets = 1024;
+
+private:
+    using writer_type = foxxll::buffered_writer<block_type>;
+    using request_ptr = foxxll::request_ptr;
+
+    //! elements between two splitters, or equal to a splitter
+    struct bucket_type
+    {
+        //! blocks holding the elements, only the last one may be partial
+        std::vector<bid_type> bids;
+        //! block receiving the next elements during distribution
+        block_type* block = nullptr;
+        //! number of elements in block
+        size_t fill = 0;
+        //! number of elements of the bucket
+        external_size_type size = 0;
+        //! true if the elements are all equal to a splitter
+        bool equal = false;
+    };
+
+    using buckets_type = std::vector<bucket_type>;
+
+    //! comparator object
+    CompareType m_cmp;
+
+    //! number of write buffers of a distribution
+    const size_t m_nwrite_buffers;
+
+    //! maximum number of splitters of a distribution
+    size_t m_max_splitters;
+
+    //! number of blocks in m_blocks
+    size_t m_nbatch_blocks;
+
+    //! batch of elements to distribute, or buckets to sort
+    block_type* m_blocks;
+
+    //! number of elements in the batch
+    size_t m_batch_size;
+
+    //! bucket of each element of the batch
+    std::vector<uint16_t> m_oracle;
+
+    //! splitters of the first distribution
+    std::vector<value_type> m_splitters;
+
+    //! buckets of the first distribution, empty until the first batch is full
+    buckets_type m_buckets;
+
+    //! writer of the first distribution
+    std::unique_ptr<writer_type> m_writer;
+
+    //! number of elements pushed
+    external_size_type m_size;
+
+    //! random source of the samples
+    std::mt19937_64 m_rng;
+
+    size_t batch_capacity() const
+    {
+        return m_nbatch_blocks * block_type::size;
+    }
+
+    //! Pick up to m_max_splitters distinct, equally spaced splitters.
+    std::vector<value_type> choose_splitters(std::vector<value_type>& sample) const
+    {
+        assert(!sample.empty());
+        std::sort(sample.begin(), sample.end(), m_cmp);
+
+        std::vector<value_type> splitters;
+        const size_t k = m_max_splitters + 1;
+        for (size_t i = 1; i < k; ++i)
+        {
+            const value_type& s = sample[i * sample.size() / k];
+            if (splitters.empty() || m_cmp(splitters.back(), s))
+                splitters.push_back(s);
+        }
+        return splitters;
+    }
+
+    //! Draw a random sample of the batch.
+    std::vector<value_type> sample_batch()
+    {
+        const size_t nsamples = std::min(m_batch_size, oversampling * (m_max_splitters + 1));
+        std::uniform_int_distribution<size_t> pos(0, m_batch_size - 1);
+
+        std::vector<value_type> sample(nsamples);
+        for (size_t i = 0; i < nsamples; ++i)
+            sample[i] = *make_element_iterator(m_blocks, pos(m_rng));
+        return sample;
+    }
+
+    //! Draw a random sample of a bucket on disk, from one random block of
+    //! each of equally sized strata of its blocks.
+    std::vector<value_type> sample_bucket(const bucket_type& b)
+    {
+        const size_t nblocks = b.bids.size();
+        const size_t nstrata = std::min(nblocks, std::min(m_nbatch_blocks, m_max_splitters + 1));
+        const size_t per_block = foxxll::div_ceil(oversampling * (m_max_splitters + 1), nstrata);
+
+        std::vector<size_t> block_ids(nstrata);
+        std::vector<request_ptr> reqs(nstrata);
+        for (size_t s = 0; s < nstrata; ++s)
+        {
+            const size_t lo = s * nblocks / nstrata;
+            const size_t hi = (s + 1) * nblocks / nstrata;
+            block_ids[s] = std::uniform_int_distribution<size_t>(lo, hi - 1)(m_rng);
+            reqs[s] = m_blocks[s].read(b.bids[block_ids[s]]);
+        }
+        wait_all(reqs.data(), nstrata);
+
+        std::vector<value_type> sample;
+        sample.reserve(nstrata * per_block);
+        for (size_t s = 0; s < nstrata; ++s)
+        {
+            const size_t count = (block_ids[s] + 1 == nblocks)
+                                 ? static_cast<size_t>(b.size - external_size_type(nblocks - 1) * block_type::size)
+                                 : block_type::size;
+            std::uniform_int_distribution<size_t> pos(0, count - 1);
+            for (size_t i = 0; i < per_block; ++i)
+                sample.push_back(m_blocks[s][pos(m_rng)]);
+        }
+        return sample;
+    }
+
+    //! Bucket of an element: 2 * j for the elements between splitters j - 1
+    //! and j, 2 * j + 1 for the elements equal to splitter j.
+    size_t classify(const value_type& v, const std::vector<value_type>& splitters) const
+    {
+        const size_t j = static_cast<size_t>(
+            std::lower_bound(splitters.begin(), splitters.end(), v, m_cmp) - splitters.begin());
+        return (j < splitters.size() && !m_cmp(v, splitters[j])) ? 2 * j + 1 : 2 * j;
+    }
+
+    //! Create the buckets of nsplitters splitters and their writer.
+    void open_buckets(buckets_type& buckets, std::unique_ptr<writer_type>& writer,
+                      size_t nsplitters)
+    {
+        buckets.clear();
+        buckets.resize(2 * nsplitters + 1);
+        writer.reset(new writer_type(buckets.size() + m_nwrite_buffers, m_nwrite_buffers));
+
+        for (size_t i = 0; i < buckets.size(); ++i)
+        {
+            buckets[i].equal = (i % 2 == 1);
+            buckets[i].block = writer->get_free_block();
+        }
+    }
+
+    //! Write the block of a bucket to a newly allocated block.
+    void write_block(bucket_type& b, writer_type& writer)
+    {
+        b.bids.emplace_back();
+        foxxll::block_manager::get_instance()->new_block(
+            AllocStr(), b.bids.back(), b.bids.size() - 1);
+        b.block = writer.write(b.block, b.bids.back());
+        b.fill = 0;
+    }
+
+    //! Distribute the batch to the buckets.
+    void distribute_batch(buckets_type& buckets, writer_type& writer,
+                          const std::vector<value_type>& splitters)
+    {
+        const size_t n = m_batch_size;
+
+        // classification is the expensive part, the copying is bound by memory
+        const size_t threads = task_runtime::get_instance().max_threads();
+        const size_t chunk = (n + threads - 1) / threads;
+        parallel_for(
+            0, threads, [&](size_t t) {
+                const size_t end = std::min(n, (t + 1) * chunk);
+                for (size_t i = t * chunk; i < end; ++i)
+                {
+                    m_oracle[i] = static_cast<uint16_t>(
+                        classify(*make_element_iterator(m_blocks, i), splitters));
+                }
+            });
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            bucket_type& b = buckets[m_oracle[i]];
+            b.block->elem[b.fill] = *make_element_iterator(m_blocks, i);
+            ++b.size;
+            if (++b.fill == block_type::size)
+                write_block(b, writer);
+        }
+
+        m_batch_size = 0;
+    }
+
+    //! Write the partial blocks of the buckets and release the writer.
+    void close_buckets(buckets_type& buckets, std::unique_ptr<writer_type>& writer)
+    {
+        for (bucket_type& b : buckets)
+        {
+            if (b.fill != 0)
+                write_block(b, *writer);
+            // the blocks belong to the writer
+            b.block = nullptr;
+        }
+        writer->flush();
+        writer.reset();
+    }
+
+    //! Read the blocks [first, first + n) of a bucket into m_blocks + offset.
+    void read_blocks(const bucket_type& b, size_t first, size_t n, size_t offset,
+                     std::vector<request_ptr>& reqs)
+    {
+        for (size_t i = 0; i < n; ++i)
+            reqs.push_back(m_blocks[offset + i].read(b.bids[first + i]));
+    }
+
+    //! Release the blocks of a bucket.
+    static void free_bucket(bucket_type& b)
+    {
+        disk_space_reclaimer::get_instance().delete_blocks(b.bids.begin(), b.bids.end());
+        std::vector<bid_type>().swap(b.bids);
+        b.size = 0;
+    }
+
+    //! Deliver n sorted elements starting at blocks.
+    template <typename Sink>
+    static void emit(block_type* blocks, size_t n, Sink& sink)
+    {
+        for (size_t i = 0; i < n; ++i)
+            sink(*make_element_iterator(blocks, i));
+    }
+
+    //! Deliver the elements of a bucket of equal elements.
+    template <typename Sink>
+    void copy_bucket(bucket_type& b, Sink& sink)
+    {
+        std::vector<request_ptr> reqs;
+        external_size_type left = b.size;
+        for (size_t first = 0; first < b.bids.size(); first += m_nbatch_blocks)
+        {
+            const size_t n = std::min(m_nbatch_blocks, b.bids.size() - first);
+            reqs.clear();
+            read_blocks(b, first, n, 0, reqs);
+            wait_all(reqs.data(), n);
+
+            const size_t count = static_cast<size_t>(
+                std::min<external_size_type>(left, external_size_type(n) * block_type::size));
+            emit(m_blocks, count, sink);
+            left -= count;
+        }
+        free_bucket(b);
+    }
+
+    //! Distribute a bucket too large for memory again and sort the parts.
+    template <typename Sink>
+    void sort_large_bucket(bucket_type& b, Sink& sink, unsigned depth)
+    {
+        TLX_LOG << "sample_sorter: distributing bucket of " << b.size
+                << " elements, depth " << depth;
+
+        std::vector<value_type> sample = sample_bucket(b);
+        const std::vector<value_type> splitters = choose_splitters(sample);
+
+        buckets_type buckets;
+        std::unique_ptr<writer_type> writer;
+        open_buckets(buckets, writer, splitters.size());
+
+        std::vector<request_ptr> reqs;
+        external_size_type left = b.size;
+        for (size_t first = 0; first < b.bids.size(); first += m_nbatch_blocks)
+        {
+            const size_t n = std::min(m_nbatch_blocks, b.bids.size() - first);
+            reqs.clear();
+            read_blocks(b, first, n, 0, reqs);
+            wait_all(reqs.data(), n);
+
+            m_batch_size = static_cast<size_t>(
+                std::min<external_size_type>(left, external_size_type(n) * block_type::size));
+            left -= m_batch_size;
+            distribute_batch(buckets, *writer, splitters);
+        }
+        free_bucket(b);
+        close_buckets(buckets, writer);
+
+        sort_buckets(buckets, sink, depth + 1);
+    }
+
+    //! Sort the buckets in order and deliver their elements.
+    template <typename Sink>
+    void sort_buckets(buckets_type& buckets, Sink& sink, unsigned depth)
+    {
+        std::vector<request_ptr> reqs;
+        std::vector<size_t> offsets;
+
+        size_t i = 0;
+        while (i < buckets.size())
+        {
+            if (buckets[i].size == 0)
+            {
+                ++i;
+                continue;
+            }
+
+            if (buckets[i].bids.size() > m_nbatch_blocks)
+            {
+                if (buckets[i].equal)
+                    copy_bucket(buckets[i], sink);
+                else
+                    sort_large_bucket(buckets[i], sink, depth);
+                ++i;
+                continue;
+            }
+
+            // load the following buckets which fit into memory together
+            size_t end = i, nblocks = 0;
+            reqs.clear();
+            offsets.clear();
+            while (end < buckets.size() &&
+                   nblocks + buckets[end].bids.size() <= m_nbatch_blocks)
+            {
+                offsets.push_back(nblocks);
+                read_blocks(buckets[end], 0, buckets[end].bids.size(), nblocks, reqs);
+                nblocks += buckets[end].bids.size();
+                ++end;
+            }
+            wait_all(reqs.data(), reqs.size());
+
+            if (end - i == 1)
+            {
+                const auto n = static_cast<size_t>(buckets[i].size);
+                if (!buckets[i].equal && !sort_kernel_blocks(m_blocks, 0, n, m_cmp))
+                {
+                    potentially_parallel::sort(make_element_iterator(m_blocks, 0),
+                                               make_element_iterator(m_blocks, n),
+                                               m_cmp);
+                }
+            }
+            else
+            {
+                parallel_for(
+                    0, end - i, [&](size_t j) {
+                        const bucket_type& b = buckets[i + j];
+                        if (b.equal || b.size == 0)
+                            return;
+                        block_type* blocks = m_blocks + offsets[j];
+                        if (!sort_kernel_blocks(blocks, 0, static_cast<size_t>(b.size), m_cmp))
+                            std::sort(make_element_iterator(blocks, 0),
+                                      make_element_iterator(blocks, static_cast<size_t>(b.size)),
+                                      m_cmp _STXXL_FORCE_SEQUENTIAL);
+                    });
+            }
+
+            for (size_t j = i; j < end; ++j)
+            {
+                emit(m_blocks + offsets[j - i], static_cast<size_t>(buckets[j].size), sink);
+                free_bucket(buckets[j]);
+            }
+            i = end;
+        }
+    }
+
+public:
+    //! Create the sorter.
+    //! \param cmp comparator object
+    //! \param memory_to_use memory in bytes the sorter may use
+    sample_sorter(CompareType cmp, size_t memory_to_use)
+        : m_cmp(cmp),
+          m_nwrite_buffers(2 * foxxll::config::get_instance()->disks_number()),
+          m_batch_size(0),
+          m_size(0),
+          m_rng(seed_sequence::get_ref().get_next_seed())
+    {
+        const size_t mem_blocks = memory_to_use / BlockSize;
+        if (mem_blocks < m_nwrite_buffers + 8) {
+            throw foxxll::bad_parameter(
+                      "stxxl::sample_sorter(): INSUFFICIENT MEMORY provided, "
+                      "please increase parameter 'memory_to_use'");
+        }
+        const size_t avail = mem_blocks - m_nwrite_buffers;
+
+        // each of the 2k-1 buckets of k-1 splitters keeps one block during
+        // the distribution, the rest holds the batch and its bucket oracle
+        const size_t k = std::max<size_t>(2, std::min(size_t(max_buckets), avail / 8));
+        m_max_splitters = k - 1;
+        m_nbatch_blocks = std::max<size_t>(
+            1, (avail - 2 * k) * sizeof(value_type) / (sizeof(value_type) + sizeof(uint16_t)));
+
+        m_blocks = new_block_array<block_type>(m_nbatch_blocks);
+        m_oracle.resize(batch_capacity());
+    }
+
+    //! non-copyable: delete copy-constructor
+    sample_sorter(const sample_sorter&) = delete;
+    //! non-copyable: delete assignment operator
+    sample_sorter& operator = (const sample_sorter&) = delete;
+
+    ~sample_sorter()
+    {
+        if (m_writer)
+            close_buckets(m_buckets, m_writer);
+        for (bucket_type& b : m_buckets)
+            free_bucket(b);
+        delete_block_array(m_blocks, m_nbatch_blocks);
+    }
+
+    //! Add an element.
+    void push(const value_type& v)
+    {
+        *make_element_iterator(m_blocks, m_batch_size) = v;
+        ++m_size;
+
+        if (TLX_UNLIKELY(++m_batch_size == batch_capacity()))
+        {
+            if (m_buckets.empty())
+            {
+                std::vector<value_type> sample = sample_batch();
+                m_splitters = choose_splitters(sample);
+                open_buckets(m_buckets, m_writer, m_splitters.size());
+                TLX_LOG << "sample_sorter: distributing to " << m_buckets.size()
+                        << " buckets";
+            }
+            distribute_batch(m_buckets, *m_writer, m_splitters);
+        }
+    }
+
+    //! Number of elements pushed.
+    external_size_type size() const
+    {
+        return m_size;
+    }
+
+    //! Deliver the elements in sorted order by calling sink(v) for each of
+    //! them, leaving the sorter empty.
+    template <typename Sink>
+    void output(Sink sink)
+    {
+        if (m_buckets.empty())
+        {
+            // all elements fit into memory
+            if (!sort_kernel_blocks(m_blocks, 0, m_batch_size, m_cmp))
+            {
+                potentially_parallel::sort(make_element_iterator(m_blocks, 0),
+                                           make_element_iterator(m_blocks, m_batch_size),
+                                           m_cmp);
+            }
+            emit(m_blocks, m_batch_size, sink);
+        }
+        else
+        {
+            distribute_batch(m_buckets, *m_writer, m_splitters);
+            close_buckets(m_buckets, m_writer);
+            sort_buckets(m_buckets, sink, 0);
+            m_buckets.clear();
+        }
+
+        m_batch_size = 0;
+        m_size = 0;
+    }
+};
+
+/*!
+ * stxxl::sort with the sample_sorter: the range is read with overlapped
+ * I/O, distributed, and the sorted buckets are written back.
+ */
+template <typename ExtIterator, typename CompareType>
+void sort(ExtIterator first, ExtIterator last, CompareType cmp, size_t M)
+{
+    using vector_type = typename ExtIterator::vector_type;
+    using value_type = typename vector_type::value_type;
+    using sorter_type = sample_sorter<
+              value_type, CompareType, vector_type::block_size,
+              typename vector_type::alloc_strategy_type>;
+
+    const size_t nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+    sorter_type sorter(cmp, M - std::min(M, nbuffers * vector_type::block_size));
+
+    {
+        typename vector_type::bufreader_type reader(first, last, nbuffers);
+        for ( ; !reader.empty(); ++reader)
+            sorter.push(*reader);
+    }
+
+    typename vector_type::bufwriter_type writer(first, nbuffers);
+    sorter.output([&writer](const value_type& v) { writer << v; });
+}
+
+} // namespace sample_sort_local
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_SAMPLE_SORT_HEADER
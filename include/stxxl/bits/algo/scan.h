@@ -15,10 +15,19 @@
 #ifndef STXXL_ALGO_SCAN_HEADER
 #define STXXL_ALGO_SCAN_HEADER
 
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <foxxll/common/utils.hpp>
+#include <foxxll/io/request.hpp>
 #include <foxxll/mng/buf_istream.hpp>
 #include <foxxll/mng/buf_ostream.hpp>
 #include <foxxll/mng/config.hpp>
 
+#include <stxxl/bits/common/numa.h>
+#include <stxxl/bits/parallel.h>
 #include <stxxl/types>
 
 namespace stxxl {
@@ -320,6 +329,444 @@ ExtIterator find(ExtIterator begin, ExtIterator end,
     return cur;
 }
 
+/*! \internal
+ */
+namespace scan_local {
+
+//! Default number of buffers of the parallel scans: two batches of one block
+//! per thread, but at least one block per disk.
+inline size_t parallel_scan_buffers()
+{
+    const size_t threads = task_runtime::get_instance().max_threads();
+    return 2 * std::max(threads, foxxll::config::get_instance()->disks_number());
+}
+
+//! Batch function of parallel_scan_blocks() doing nothing.
+struct no_batch_function
+{
+    template <typename Ranges>
+    void operator () (Ranges&) const { }
+};
+
+/*!
+ * Apply block_function to the blocks of [begin,end) in parallel, one block
+ * per task. The blocks are processed in batches of nbuffers / 2 blocks: while
+ * one batch is processed, the next one is read. block_function is called as
+ * block_function(first, last, pos) with the pointers [first,last) to the
+ * elements of one block inside [begin,end) and the position pos of *first
+ * relative to begin. Afterwards batch_function is called with the vector of
+ * the element ranges of the batch's blocks in order.
+ *
+ * If SETTINGS::numa_partition is set, the buffers of a batch are partitioned
+ * over the NUMA nodes and their blocks processed by threads on their node
+ * first.
+ *
+ * \param read_all read all blocks, otherwise only the partially covered
+ * first and last block are read
+ * \param write write the blocks back, in order of their position
+ */
+template <typename ExtIterator, typename BlockFunction,
+          typename BatchFunction = no_batch_function>
+void parallel_scan_blocks(ExtIterator begin, ExtIterator end,
+                          BlockFunction block_function,
+                          bool read_all, bool write, size_t nbuffers,
+                          BatchFunction batch_function = BatchFunction())
+{
+    using block_type = typename ExtIterator::block_type;
+    using bids_container_iterator = typename ExtIterator::bids_container_iterator;
+    using value_type = typename ExtIterator::value_type;
+    using size_type = typename ExtIterator::size_type;
+    using request_ptr = foxxll::request_ptr;
+    using range_type = std::pair<value_type*, value_type*>;
+
+    if (begin == end)
+        return;
+
+    begin.flush();     // flush container
+
+    if (nbuffers == 0)
+        nbuffers = parallel_scan_buffers();
+
+    const bids_container_iterator first_bid = begin.bid();
+    const size_t begin_offset = begin.block_offset();
+    const size_t end_offset = end.block_offset();
+    const size_t nblocks = (end.bid() - first_bid) + (end_offset ? 1 : 0);
+    const size_t batch = std::max<size_t>(1, nbuffers / 2);
+    const size_t nbatches = foxxll::div_ceil(nblocks, batch);
+
+    // each batch's buffers are spread over the NUMA nodes
+    block_type* blocks = new block_type[2 * batch];
+    numa_partition_blocks(blocks, batch);
+    numa_partition_blocks(blocks + batch, batch);
+    request_ptr* reqs = new request_ptr[2 * batch];
+    std::vector<range_type> ranges(batch);
+
+    // read the blocks of batch b into its half of the buffers, once they
+    // are written back from batch b - 2
+    auto issue_reads =
+        [&](size_t b) {
+            const size_t half = (b % 2) * batch;
+            for (size_t j = b * batch; j < std::min(nblocks, (b + 1) * batch); ++j)
+            {
+                const size_t slot = half + j - b * batch;
+                if (reqs[slot].get())
+                    reqs[slot]->wait();
+
+                bool partial = (j == 0 && begin_offset) ||
+                               (j == nblocks - 1 && end_offset);
+                if (read_all || partial)
+                    reqs[slot] = blocks[slot].read(*(first_bid + j));
+                else
+                    reqs[slot] = request_ptr();
+            }
+        };
+
+    issue_reads(0);
+
+    for (size_t b = 0; b < nbatches; ++b)
+    {
+        const size_t half = (b % 2) * batch;
+        const size_t batch_begin = b * batch;
+        const size_t batch_end = std::min(nblocks, (b + 1) * batch);
+
+        if (b + 1 < nbatches)
+            issue_reads(b + 1);
+
+        for (size_t j = batch_begin; j < batch_end; ++j)
+        {
+            if (reqs[half + j - batch_begin].get())
+                reqs[half + j - batch_begin]->wait();
+        }
+
+        ranges.resize(batch_end - batch_begin);
+        for (size_t j = batch_begin; j < batch_end; ++j)
+        {
+            block_type& block = blocks[half + j - batch_begin];
+            const size_t first = (j == 0) ? begin_offset : 0;
+            const size_t last = (j == nblocks - 1 && end_offset) ? end_offset : block_type::size;
+            ranges[j - batch_begin] = range_type(block.elem + first, block.elem + last);
+        }
+
+        numa_parallel_for(
+            ranges.size(), [batch](size_t j) { return numa_block_node(j, batch); },
+            [&](size_t j) {
+                const range_type& range = ranges[j];
+                const size_t first = static_cast<size_t>(range.first - blocks[half + j].elem);
+                block_function(range.first, range.second,
+                               size_type(batch_begin + j) * block_type::size + first - begin_offset);
+            });
+
+        batch_function(ranges);
+
+        if (write)
+        {
+            for (size_t j = batch_begin; j < batch_end; ++j)
+                reqs[half + j - batch_begin] = blocks[half + j - batch_begin].write(*(first_bid + j));
+        }
+    }
+
+    for (size_t i = 0; i < 2 * batch; ++i)
+    {
+        if (reqs[i].get())
+            reqs[i]->wait();
+    }
+
+    delete[] reqs;
+    delete[] blocks;
+}
+
+} // namespace scan_local
+
+/*!
+ * Parallel external equivalent of std::for_each.
+ *
+ * stxxl::parallel_for_each applies the function object \c functor to each
+ * element in the range [first, last) like \ref for_each, but the blocks of
+ * the range are processed concurrently by all threads, hence \c functor must
+ * be safe to call from several threads and the order of the applications is
+ * unspecified. While one batch of \c nbuffers / 2 blocks is processed, the
+ * next batch is read.
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param functor function object of model of \c std::UnaryFunction concept
+ * \param nbuffers number of buffers (blocks) for internal use (should be at least 2*P and 2*D, or zero for automatic)
+ * \return function object \c functor
+ */
+template <typename ExtIterator, typename UnaryFunction>
+UnaryFunction parallel_for_each(ExtIterator begin, ExtIterator end,
+                                UnaryFunction functor, size_t nbuffers = 0)
+{
+    using value_type = typename ExtIterator::value_type;
+    using size_type = typename ExtIterator::size_type;
+
+    scan_local::parallel_scan_blocks(
+        begin, end,
+        [&functor](value_type* first, value_type* last, size_type) {
+            for ( ; first != last; ++first)
+            {
+                value_type tmp = *first;
+                functor(tmp);
+            }
+        },
+        true, false, nbuffers);
+
+    return functor;
+}
+
+/*!
+ * Parallel external equivalent of std::for_each (mutating).
+ *
+ * stxxl::parallel_for_each_m applies the function object \c functor to each
+ * element in the range [first, last) like \ref for_each_m, but the blocks of
+ * the range are processed concurrently by all threads, hence \c functor must
+ * be safe to call from several threads and the order of the applications is
+ * unspecified. The modified blocks are written back in order.
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param functor object of model of \c std::UnaryFunction concept
+ * \param nbuffers number of buffers (blocks) for internal use (should be at least 2*P and 2*D, or zero for automatic)
+ * \return function object \c functor
+ */
+template <typename ExtIterator, typename UnaryFunction>
+UnaryFunction parallel_for_each_m(ExtIterator begin, ExtIterator end,
+                                  UnaryFunction functor, size_t nbuffers = 0)
+{
+    using value_type = typename ExtIterator::value_type;
+    using size_type = typename ExtIterator::size_type;
+
+    scan_local::parallel_scan_blocks(
+        begin, end,
+        [&functor](value_type* first, value_type* last, size_type) {
+            for ( ; first != last; ++first)
+                functor(*first);
+        },
+        true, true, nbuffers);
+
+    return functor;
+}
+
+/*!
+ * Parallel external equivalent of std::transform, in place.
+ *
+ * stxxl::parallel_transform_m replaces each element \c x in the range
+ * [first, last) by \c op(x). The blocks of the range are processed
+ * concurrently by all threads, hence \c op must be safe to call from several
+ * threads.
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param op function object of model of \c std::UnaryFunction concept
+ * \param nbuffers number of buffers (blocks) for internal use (should be at least 2*P and 2*D, or zero for automatic)
+ */
+template <typename ExtIterator, typename UnaryOperation>
+void parallel_transform_m(ExtIterator begin, ExtIterator end,
+                          UnaryOperation op, size_t nbuffers = 0)
+{
+    using value_type = typename ExtIterator::value_type;
+    using size_type = typename ExtIterator::size_type;
+
+    scan_local::parallel_scan_blocks(
+        begin, end,
+        [&op](value_type* first, value_type* last, size_type) {
+            for ( ; first != last; ++first)
+                *first = op(*first);
+        },
+        true, true, nbuffers);
+}
+
+/*!
+ * Parallel external equivalent of std::generate.
+ *
+ * stxxl::parallel_generate assigns \c generator(i) to the element at
+ * position \c begin + \c i of the range [first, last). Unlike \ref generate
+ * the generator receives the position, since the blocks of the range are
+ * generated concurrently by all threads; \c generator must be safe to call
+ * from several threads. Only the partially covered first and last blocks are
+ * read.
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param generator function object taking the position of the element
+ * \param nbuffers number of buffers (blocks) for internal use (should be at least 2*P and 2*D, or zero for automatic)
+ */
+template <typename ExtIterator, typename Generator>
+void parallel_generate(ExtIterator begin, ExtIterator end,
+                       Generator generator, size_t nbuffers = 0)
+{
+    using value_type = typename ExtIterator::value_type;
+    using size_type = typename ExtIterator::size_type;
+
+    scan_local::parallel_scan_blocks(
+        begin, end,
+        [&generator](value_type* first, value_type* last, size_type pos) {
+            for ( ; first != last; ++first, ++pos)
+                *first = generator(pos);
+        },
+        false, true, nbuffers);
+}
+
+/*!
+ * External equivalent of std::transform_reduce.
+ *
+ * stxxl::transform_reduce returns the reduction of \c init and \c
+ * transform(x) for all elements \c x in the range [first, last) with \c
+ * reduce. The blocks are prefetched in batches and reduced concurrently by
+ * all threads, hence \c reduce must be associative and commutative, and both
+ * function objects must be safe to call from several threads.
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param init initial value of the reduction
+ * \param reduce binary function object combining two values of type T
+ * \param transform unary function object mapping an element to type T
+ * \param nbuffers number of buffers (blocks) for internal use (should be at least 2*P and 2*D, or zero for automatic)
+ * \return reduction of \c init and the transformed elements
+ */
+template <typename ExtIterator, typename T,
+          typename BinaryReduceOp, typename UnaryTransformOp>
+T transform_reduce(ExtIterator begin, ExtIterator end, T init,
+                   BinaryReduceOp reduce, UnaryTransformOp transform,
+                   size_t nbuffers = 0)
+{
+    using value_type = typename ExtIterator::value_type;
+    using size_type = typename ExtIterator::size_type;
+
+    const size_t nthreads = task_runtime::get_instance().max_threads();
+
+    // partial reduction of each thread, if the thread saw any elements
+    std::vector<T> partial(nthreads, init);
+    std::vector<char> has_partial(nthreads, false);
+
+    scan_local::parallel_scan_blocks(
+        begin, end,
+        [&](value_type* first, value_type* last, size_type) {
+            const size_t t = task_runtime::thread_id();
+            if (first == last)
+                return;
+
+            T acc = transform(*first);
+            for (++first; first != last; ++first)
+                acc = reduce(acc, transform(*first));
+
+            partial[t] = has_partial[t] ? reduce(partial[t], acc) : acc;
+            has_partial[t] = true;
+        },
+        true, false, nbuffers);
+
+    for (size_t t = 0; t < nthreads; ++t)
+    {
+        if (has_partial[t])
+            init = reduce(init, partial[t]);
+    }
+
+    return init;
+}
+
+/*!
+ * External equivalent of std::reduce.
+ *
+ * stxxl::reduce returns the reduction of \c init and all elements in the
+ * range [first, last) with \c op, see \ref transform_reduce.
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param init initial value of the reduction
+ * \param op associative and commutative binary function object
+ * \param nbuffers number of buffers (blocks) for internal use (should be at least 2*P and 2*D, or zero for automatic)
+ * \return reduction of \c init and the elements
+ */
+template <typename ExtIterator, typename T, typename BinaryOp = std::plus<T> >
+T reduce(ExtIterator begin, ExtIterator end, T init,
+         BinaryOp op = BinaryOp(), size_t nbuffers = 0)
+{
+    using value_type = typename ExtIterator::value_type;
+
+    return stxxl::transform_reduce(
+        begin, end, init, op,
+        [](const value_type& v) -> T { return v; }, nbuffers);
+}
+
+/*!
+ * External equivalent of std::inclusive_scan, in place.
+ *
+ * stxxl::inclusive_scan replaces each element in the range [first, last) by
+ * the combination with \c op of all elements up to and including it. The
+ * blocks are prefetched in batches; the blocks of a batch are scanned
+ * concurrently, then the carries of the preceding blocks are propagated in a
+ * second parallel pass, and the batch is written back in order. \c op must
+ * be associative and safe to call from several threads.
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param op associative binary function object
+ * \param nbuffers number of buffers (blocks) for internal use (should be at least 2*P and 2*D, or zero for automatic)
+ */
+template <typename ExtIterator, typename BinaryOp>
+void inclusive_scan(ExtIterator begin, ExtIterator end, BinaryOp op,
+                    size_t nbuffers = 0)
+{
+    using value_type = typename ExtIterator::value_type;
+    using size_type = typename ExtIterator::size_type;
+    using range_type = std::pair<value_type*, value_type*>;
+
+    // combination of all elements of the previous batches
+    value_type carry = value_type();
+    bool has_carry = false;
+
+    scan_local::parallel_scan_blocks(
+        begin, end,
+        [&op](value_type* first, value_type* last, size_type) {
+            if (first == last)
+                return;
+            for (value_type* prev = first++; first != last; prev = first++)
+                *first = op(*prev, *first);
+        },
+        true, true, nbuffers,
+        [&](std::vector<range_type>& ranges) {
+            // carry into each block of the batch
+            std::vector<value_type> carries(ranges.size());
+            std::vector<char> has_carries(ranges.size());
+            for (size_t i = 0; i < ranges.size(); ++i)
+            {
+                carries[i] = carry;
+                has_carries[i] = has_carry;
+                if (ranges[i].first == ranges[i].second)
+                    continue;
+
+                const value_type& total = *(ranges[i].second - 1);
+                carry = has_carry ? op(carry, total) : total;
+                has_carry = true;
+            }
+
+            parallel_for(
+                0, ranges.size(), [&](size_t i) {
+                    if (!has_carries[i])
+                        return;
+                    for (value_type* v = ranges[i].first; v != ranges[i].second; ++v)
+                        *v = op(carries[i], *v);
+                });
+        });
+}
+
+/*!
+ * External prefix sum, in place: each element in the range [first, last)
+ * is replaced by the sum of all elements up to and including it, see \ref
+ * inclusive_scan.
+ *
+ * \param begin object of model of \c ext_random_access_iterator concept
+ * \param end object of model of \c ext_random_access_iterator concept
+ * \param nbuffers number of buffers (blocks) for internal use (should be at least 2*P and 2*D, or zero for automatic)
+ */
+template <typename ExtIterator>
+void prefix_sum(ExtIterator begin, ExtIterator end, size_t nbuffers = 0)
+{
+    using value_type = typename ExtIterator::value_type;
+
+    inclusive_scan(begin, end, std::plus<value_type>(), nbuffers);
+}
+
 //! \}
 
 } // namespace stxxl
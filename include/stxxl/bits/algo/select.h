@@ -0,0 +1,357 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/select.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_SELECT_HEADER
+#define STXXL_ALGO_SELECT_HEADER
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/utils.hpp>
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/algo/sort.h>
+#include <stxxl/bits/common/seed.h>
+#include <stxxl/bits/containers/vector.h>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+namespace select_local {
+
+static constexpr bool debug = false;
+
+//! number of buffers of the overlapped readers and writers
+inline size_t num_buffers()
+{
+    return 2 * foxxll::config::get_instance()->disks_number();
+}
+
+/*!
+ * Move the k = middle - first smallest elements of [first, last) to [first,
+ * middle) in one scan, keeping them in a bounded max-heap. The other elements
+ * are written to [middle, last) in their input order while the range is
+ * read. The k elements are sorted if sorted is set, otherwise the largest of
+ * them is placed at middle - 1.
+ */
+template <typename ExtIterator, typename CompareType>
+void heap_select(ExtIterator first, ExtIterator middle, ExtIterator last,
+                 CompareType cmp, bool sorted)
+{
+    using vector_type = typename ExtIterator::vector_type;
+    using value_type = typename vector_type::value_type;
+
+    const size_t k = static_cast<size_t>(middle - first);
+    const size_t nbuffers = num_buffers();
+
+    std::vector<value_type> heap;
+    heap.reserve(k);
+
+    {
+        typename vector_type::bufreader_type reader(first, last, nbuffers);
+        for ( ; heap.size() < k; ++reader)
+            heap.push_back(*reader);
+        std::make_heap(heap.begin(), heap.end(), cmp);
+
+        // the writer never passes the reader, which is k elements ahead
+        typename vector_type::bufwriter_type writer(middle, nbuffers);
+        for ( ; !reader.empty(); ++reader)
+        {
+            if (cmp(*reader, heap.front()))
+            {
+                writer << heap.front();
+                std::pop_heap(heap.begin(), heap.end(), cmp);
+                heap.back() = *reader;
+                std::push_heap(heap.begin(), heap.end(), cmp);
+            }
+            else
+            {
+                writer << *reader;
+            }
+        }
+    }
+
+    if (sorted)
+        std::sort_heap(heap.begin(), heap.end(), cmp);
+    else
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+
+    typename vector_type::bufwriter_type writer(first, nbuffers);
+    for (const value_type& v : heap)
+        writer << v;
+}
+
+/*!
+ * Draw a random sample of [first, last): the range is split into strata,
+ * from each of which a random block is sampled, so that only few blocks are
+ * read.
+ */
+template <typename ExtIterator>
+std::vector<typename ExtIterator::vector_type::value_type>
+sample_range(ExtIterator first, ExtIterator last, size_t nsamples)
+{
+    using vector_type = typename ExtIterator::vector_type;
+    using value_type = typename vector_type::value_type;
+    using const_iterator = typename vector_type::const_iterator;
+    using block_type = typename ExtIterator::block_type;
+
+    const external_size_type n = last - first;
+    const auto nstrata = static_cast<size_t>(
+        std::min<external_size_type>(32, foxxll::div_ceil(n, block_type::size)));
+    const size_t per_stratum = foxxll::div_ceil(nsamples, nstrata);
+
+    std::mt19937_64 rng(seed_sequence::get_ref().get_next_seed());
+    const const_iterator cfirst(first);
+
+    std::vector<value_type> sample;
+    sample.reserve(nstrata * per_stratum);
+    for (size_t s = 0; s < nstrata; ++s)
+    {
+        const external_size_type lo = s * n / nstrata;
+        const external_size_type hi = (s + 1) * n / nstrata;
+        const external_size_type p =
+            std::uniform_int_distribution<external_size_type>(lo, hi - 1)(rng);
+
+        // sample the elements of the block containing p
+        const external_size_type block_begin =
+            p - std::min<external_size_type>(p, (cfirst + p).block_offset());
+        const external_size_type block_end =
+            std::min<external_size_type>(n, block_begin + block_type::size);
+        std::uniform_int_distribution<external_size_type> pos(block_begin, block_end - 1);
+        for (size_t i = 0; i < per_stratum; ++i)
+            sample.push_back(*(cfirst + pos(rng)));
+    }
+    return sample;
+}
+
+/*!
+ * Rearrange [first, last) such that the element of rank r is at first + r,
+ * preceded by no greater and followed by no smaller elements.
+ *
+ * The splitters lo <= hi are drawn from a sample such that rank r likely lies
+ * between them and the elements between fit into memory. One scan writes the
+ * elements less than lo in place and collects the elements between lo and hi
+ * in memory, the elements greater than hi are written to a temporary vector.
+ * The middle elements are selected in memory and written back, followed by
+ * the greater ones. If the sample missed rank r, the part containing it is
+ * selected again; pivot restricts the splitters to the sampled element of
+ * rank r, which guarantees progress on many equal elements.
+ */
+template <typename ExtIterator, typename CompareType>
+void partition_select(ExtIterator first, ExtIterator last,
+                      external_size_type r, CompareType cmp, size_t M,
+                      bool pivot = false)
+{
+    using vector_type = typename ExtIterator::vector_type;
+    using value_type = typename vector_type::value_type;
+    using temp_vector_type = stxxl::vector<
+              value_type, 1, lru_pager<1>, vector_type::block_size,
+              typename vector_type::alloc_strategy_type>;
+
+    const external_size_type n = last - first;
+    const size_t nbuffers = num_buffers();
+
+    // elements kept in memory besides the readers and writers
+    const size_t capacity = std::max<size_t>(
+        1, (M - std::min(M, 4 * nbuffers * vector_type::block_size)) / sizeof(value_type));
+
+    if (n <= capacity)
+    {
+        std::vector<value_type> buffer(static_cast<size_t>(n));
+        {
+            typename vector_type::bufreader_type reader(first, last, nbuffers);
+            for (value_type& v : buffer)
+            {
+                v = *reader;
+                ++reader;
+            }
+        }
+        std::nth_element(buffer.begin(), buffer.begin() + r, buffer.end(), cmp);
+
+        typename vector_type::bufwriter_type writer(first, nbuffers);
+        for (const value_type& v : buffer)
+            writer << v;
+        return;
+    }
+
+    // pick splitters around rank r, the elements between them are expected
+    // to take half of the memory
+    std::vector<value_type> sample = sample_range(first, last, 4096);
+    std::sort(sample.begin(), sample.end(), cmp);
+
+    const size_t s = sample.size();
+    const auto q = static_cast<size_t>(r * s / n);
+    const size_t d = pivot ? 0 : static_cast<size_t>(s * capacity / (4 * n));
+    const value_type lo = sample[q - std::min(q, d)];
+    const value_type hi = sample[std::min(s - 1, q + d)];
+
+    std::vector<value_type> middle;
+    middle.reserve(capacity);
+    temp_vector_type greater, overflow;
+
+    external_size_type nless = 0;
+    typename vector_type::bufwriter_type writer(first, nbuffers);
+    {
+        typename temp_vector_type::bufwriter_type greater_writer(greater, nbuffers);
+        typename temp_vector_type::bufwriter_type overflow_writer(overflow, nbuffers);
+
+        // the writer never passes the reader, it only writes smaller elements
+        typename vector_type::bufreader_type reader(first, last, nbuffers);
+        for ( ; !reader.empty(); ++reader)
+        {
+            const value_type& v = *reader;
+            if (cmp(v, lo))
+            {
+                writer << v;
+                ++nless;
+            }
+            else if (cmp(hi, v))
+                greater_writer << v;
+            else if (middle.size() < capacity)
+                middle.push_back(v);
+            else
+                overflow_writer << v;
+        }
+    }
+
+    const external_size_type nmiddle = middle.size() + overflow.size();
+    TLX_LOG << "partition_select: n=" << n << " r=" << r << " less=" << nless
+            << " middle=" << nmiddle << " greater=" << greater.size();
+
+    const bool select_middle = overflow.empty() && nless <= r && r < nless + nmiddle;
+    if (select_middle)
+    {
+        std::nth_element(middle.begin(), middle.begin() + (r - nless), middle.end(), cmp);
+    }
+
+    for (const value_type& v : middle)
+        writer << v;
+    std::vector<value_type>().swap(middle);
+    {
+        typename temp_vector_type::bufreader_type overflow_reader(overflow, nbuffers);
+        for ( ; !overflow_reader.empty(); ++overflow_reader)
+            writer << *overflow_reader;
+    }
+    overflow.clear();
+    {
+        typename temp_vector_type::bufreader_type greater_reader(greater, nbuffers);
+        for ( ; !greater_reader.empty(); ++greater_reader)
+            writer << *greater_reader;
+    }
+    greater.clear();
+    writer.finish();
+
+    if (select_middle)
+        return;
+
+    if (r < nless)
+    {
+        partition_select(first, first + nless, r, cmp, M);
+    }
+    else if (r >= nless + nmiddle)
+    {
+        partition_select(first + (nless + nmiddle), last, r - nless - nmiddle, cmp, M);
+    }
+    else if (cmp(lo, hi))
+    {
+        // the middle elements did not fit into memory
+        partition_select(first + nless, first + (nless + nmiddle), r - nless, cmp, M, true);
+    }
+    // otherwise the middle elements are all equal
+}
+
+} // namespace select_local
+
+/*!
+ * External equivalent of std::nth_element: rearranges [first, last) such that
+ * the element at nth is the one which would be there if the range was
+ * sorted; no element of [first, nth) is greater and no element of (nth, last)
+ * is less than it.
+ *
+ * If the nth - first + 1 smallest elements fit into the memory, they are
+ * found in one scan using a bounded heap. Otherwise the range is partitioned
+ * around splitters sampled close to the rank of nth, which usually takes one
+ * pass over the range plus writing back the elements greater than the
+ * splitters.
+ *
+ * \param first object of model of \c ext_random_access_iterator concept
+ * \param nth position of the element to select
+ * \param last object of model of \c ext_random_access_iterator concept
+ * \param cmp comparison object of \ref StrictWeakOrdering
+ * \param M amount of memory for internal use (in bytes)
+ */
+template <typename ExtIterator, typename StrictWeakOrdering>
+void nth_element(ExtIterator first, ExtIterator nth, ExtIterator last,
+                 StrictWeakOrdering cmp, size_t M)
+{
+    using value_type = typename ExtIterator::vector_type::value_type;
+
+    if (nth == last)
+        return;
+
+    const external_size_type k = nth - first + 1;
+    const size_t buffers_size = 2 * select_local::num_buffers() * ExtIterator::block_type::raw_size;
+
+    if (k * sizeof(value_type) + buffers_size <= M)
+        select_local::heap_select(first, nth + 1, last, cmp, false);
+    else
+        select_local::partition_select(first, last, k - 1, cmp, M);
+}
+
+/*!
+ * External equivalent of std::partial_sort: rearranges [first, last) such
+ * that [first, middle) holds the middle - first smallest elements in sorted
+ * order, the order of the others in [middle, last) is unspecified.
+ *
+ * If the middle - first smallest elements fit into the memory, they are found
+ * and sorted in one scan using a bounded heap. Otherwise the range is
+ * partitioned like by \c nth_element and [first, middle) is sorted with
+ * \c stxxl::sort.
+ *
+ * \param first object of model of \c ext_random_access_iterator concept
+ * \param middle end of the range to sort
+ * \param last object of model of \c ext_random_access_iterator concept
+ * \param cmp comparison object of \ref StrictWeakOrdering, as for
+ * \c stxxl::sort it must provide min_value() and max_value()
+ * \param M amount of memory for internal use (in bytes)
+ */
+template <typename ExtIterator, typename StrictWeakOrderingWithMinMax>
+void partial_sort(ExtIterator first, ExtIterator middle, ExtIterator last,
+                  StrictWeakOrderingWithMinMax cmp, size_t M)
+{
+    using value_type = typename ExtIterator::vector_type::value_type;
+
+    if (first == middle)
+        return;
+
+    const external_size_type k = middle - first;
+    const size_t buffers_size = 2 * select_local::num_buffers() * ExtIterator::block_type::raw_size;
+
+    if (k * sizeof(value_type) + buffers_size <= M)
+    {
+        select_local::heap_select(first, middle, last, cmp, true);
+        return;
+    }
+
+    if (middle != last)
+        select_local::partition_select(first, last, k - 1, cmp, M);
+    stxxl::sort(first, middle, cmp, M);
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_SELECT_HEADER
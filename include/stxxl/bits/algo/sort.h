@@ -32,16 +32,23 @@
 #include <foxxll/mng/block_prefetcher.hpp>
 #include <foxxll/mng/buf_writer.hpp>
 
+#include <stxxl/bits/algo/balanced_prefetcher.h>
 #include <stxxl/bits/algo/bid_adapter.h>
 #include <stxxl/bits/algo/inmemsort.h>
 #include <stxxl/bits/algo/intksort.h>
 #include <stxxl/bits/algo/losertree.h>
 #include <stxxl/bits/algo/run_cursor.h>
+#include <stxxl/bits/algo/sample_sort.h>
 #include <stxxl/bits/algo/sort_base.h>
 #include <stxxl/bits/algo/sort_helper.h>
+#include <stxxl/bits/algo/sort_kernel.h>
 #include <stxxl/bits/algo/trigger_entry.h>
+#include <stxxl/bits/common/block_array.h>
+#include <stxxl/bits/common/disk_space.h>
 #include <stxxl/bits/common/is_sorted.h>
+#include <stxxl/bits/common/memory_manager.h>
 #include <stxxl/bits/common/settings.h>
+#include <stxxl/bits/common/trace.h>
 #include <stxxl/bits/parallel.h>
 
 namespace stxxl {
@@ -68,30 +75,47 @@ struct read_next_after_write_completed
     }
 };
 
+/*!
+ * Form sorted runs from the input blocks. The runs are processed in groups of
+ * runs_per_group consecutive runs, whose blocks are read into one half of the
+ * run formation buffers while the other half is sorted and written. The runs
+ * of one group are sorted concurrently, one thread per run, which keeps all
+ * cores busy even if the in-memory sort itself is sequential. If Stable, the
+ * runs are sorted stably, which keeps equal elements in input order.
+ */
 template <
     typename BlockType,
     typename RunType,
     typename InputBidIterator,
-    typename ValueCmp>
+    typename ValueCmp,
+    bool Stable = false>
 void
 create_runs(
     InputBidIterator it,
     RunType** runs,
     const size_t nruns,
     const size_t _m,
-    ValueCmp cmp)
+    ValueCmp cmp,
+    typename BlockType::value_type* last_values,
+    const size_t runs_per_group = 1)
 {
     using block_type = BlockType;
     using run_type = RunType;
     using request_ptr = foxxll::request_ptr;
 
     using bid_type = typename block_type::bid_type;
-    TLX_LOG << "stxxl::create_runs nruns=" << nruns << " m=" << _m;
+    TLX_LOG << "stxxl::create_runs nruns=" << nruns << " m=" << _m
+            << " runs_per_group=" << runs_per_group;
+
+    STXXL_TRACE_SPAN(span, "create_runs");
+    for (size_t r = 0; r < nruns; ++r)
+        span.add_bytes(runs[r]->size() * block_type::raw_size);
 
     const size_t m2 = _m / 2;
+    const size_t ngroups = foxxll::div_ceil(nruns, runs_per_group);
     foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-    block_type* Blocks1 = new block_type[m2];
-    block_type* Blocks2 = new block_type[m2];
+    block_type* Blocks1 = new_block_array<block_type>(m2);
+    block_type* Blocks2 = new_block_array<block_type>(m2);
     bid_type* bids1 = new bid_type[m2];
     bid_type* bids2 = new bid_type[m2];
     request_ptr* read_reqs1 = new request_ptr[m2];
@@ -100,15 +124,81 @@ create_runs(
     read_next_after_write_completed<block_type, bid_type>* next_run_reads =
         new read_next_after_write_completed<block_type, bid_type>[m2];
 
+    // number of blocks in all runs of group k
+    auto group_size =
+        [&](size_t k) -> size_t {
+            size_t size = 0;
+            for (size_t r = k * runs_per_group;
+                 r < std::min(nruns, (k + 1) * runs_per_group); ++r)
+                size += runs[r]->size();
+            return size;
+        };
+
+    // sort the runs of group k, which are consecutive in blocks
+    auto sort_group =
+        [&](block_type* blocks, size_t k) {
+            const size_t first_run = k * runs_per_group;
+            const size_t nruns_group = std::min(nruns, first_run + runs_per_group) - first_run;
+
+            check_sort_settings();
+            if (nruns_group == 1)
+            {
+                const size_t elements = runs[first_run]->size() * block_type::size;
+                if (Stable)
+                {
+                    if (!std::is_sorted(make_element_iterator(blocks, 0),
+                                        make_element_iterator(blocks, elements), cmp))
+                    {
+                        potentially_parallel::
+                        stable_sort(make_element_iterator(blocks, 0),
+                                    make_element_iterator(blocks, elements),
+                                    cmp);
+                    }
+                }
+                else if (!sort_helper::sort_presorted(make_element_iterator(blocks, 0),
+                                                 make_element_iterator(blocks, elements),
+                                                 cmp) &&
+                    !sort_kernel_blocks(blocks, 0, elements, cmp))
+                {
+                    potentially_parallel::
+                    sort(make_element_iterator(blocks, 0),
+                         make_element_iterator(blocks, elements),
+                         cmp);
+                }
+                last_values[first_run] = *make_element_iterator(blocks, elements - 1);
+                return;
+            }
+
+            std::vector<size_t> offsets(nruns_group + 1, 0);
+            for (size_t r = 0; r < nruns_group; ++r)
+                offsets[r + 1] = offsets[r] + runs[first_run + r]->size();
+
+            parallel_for(
+                0, nruns_group, [&](size_t r) {
+                    auto begin = make_element_iterator(blocks, offsets[r] * block_type::size);
+                    auto end = make_element_iterator(blocks, offsets[r + 1] * block_type::size);
+                    if (Stable)
+                    {
+                        if (!std::is_sorted(begin, end, cmp))
+                            std::stable_sort(begin, end, cmp _STXXL_FORCE_SEQUENTIAL);
+                    }
+                    else if (!sort_helper::sort_presorted(begin, end, cmp) &&
+                        !sort_kernel_blocks(blocks, offsets[r] * block_type::size,
+                                            offsets[r + 1] * block_type::size, cmp))
+                        std::sort(begin, end, cmp _STXXL_FORCE_SEQUENTIAL);
+                    last_values[first_run + r] = *(end - 1);
+                });
+        };
+
     foxxll::disk_queues::get_instance()->set_priority_op(foxxll::request_queue::WRITE);
 
     size_t i;
     size_t run_size = 0;
 
-    assert(nruns >= 2);
+    assert(ngroups >= 2);
 
-    run_size = runs[0]->size();
-    assert(run_size == m2);
+    run_size = group_size(0);
+    assert(run_size <= m2);
 
     for (i = 0; i < run_size; ++i)
     {
@@ -117,7 +207,7 @@ create_runs(
         read_reqs1[i] = Blocks1[i].read(bids1[i]);
     }
 
-    run_size = runs[1]->size();
+    run_size = group_size(1);
 
     for (i = 0; i < run_size; ++i)
     {
@@ -126,14 +216,14 @@ create_runs(
         read_reqs2[i] = Blocks2[i].read(bids2[i]);
     }
 
-    for (size_t k = 0; k < nruns - 1; ++k)
+    size_t nwrites = 0;
+
+    for (size_t k = 0; k < ngroups - 1; ++k)
     {
-        run_type* run = runs[k];
-        run_size = run->size();
-        assert(run_size == m2);
+        run_size = group_size(k);
         {
-            size_t next_run_size = runs[k + 1]->size();
-            assert((next_run_size == m2) || (next_run_size <= m2 && k == nruns - 2));
+            size_t next_run_size = group_size(k + 1);
+            assert((next_run_size == run_size) || (next_run_size <= run_size && k == ngroups - 2));
             tlx::unused(next_run_size);
         }
 
@@ -143,69 +233,70 @@ create_runs(
         for (i = 0; i < run_size; ++i)
             bm->delete_block(bids1[i]);
 
-        check_sort_settings();
-        potentially_parallel::
-        sort(make_element_iterator(Blocks1, 0),
-             make_element_iterator(Blocks1, run_size * block_type::size),
-             cmp);
+        sort_group(Blocks1, k);
 
         TLX_LOG << "stxxl::create_runs start waiting write_reqs";
-        if (k > 0)
-            wait_all(write_reqs, m2);
+        wait_all(write_reqs, nwrites);
         TLX_LOG << "stxxl::create_runs finish waiting write_reqs";
 
-        size_t runplus2size = (k < nruns - 2) ? runs[k + 2]->size() : 0;
-        for (i = 0; i < m2; ++i)
+        size_t runplus2size = (k < ngroups - 2) ? group_size(k + 2) : 0;
+        i = 0;
+        for (size_t r = k * runs_per_group; r < (k + 1) * runs_per_group; ++r)
         {
-            TLX_LOG << "stxxl::create_runs posting write " << Blocks1[i].elem;
-            (*run)[i].value = Blocks1[i][0];
-            if (i >= runplus2size) {
-                write_reqs[i] = Blocks1[i].write((*run)[i].bid);
-            }
-            else
+            run_type* run = runs[r];
+            for (size_t j = 0; j < run->size(); ++j, ++i)
             {
-                next_run_reads[i].block = Blocks1 + i;
-                next_run_reads[i].req = read_reqs1 + i;
-                bids1[i] = next_run_reads[i].bid = *(it++);
-                write_reqs[i] = Blocks1[i].write((*run)[i].bid, next_run_reads[i]);
+                TLX_LOG << "stxxl::create_runs posting write " << Blocks1[i].elem;
+                (*run)[j].value = Blocks1[i][0];
+                if (i >= runplus2size) {
+                    write_reqs[i] = Blocks1[i].write((*run)[j].bid);
+                }
+                else
+                {
+                    next_run_reads[i].block = Blocks1 + i;
+                    next_run_reads[i].req = read_reqs1 + i;
+                    bids1[i] = next_run_reads[i].bid = *(it++);
+                    write_reqs[i] = Blocks1[i].write((*run)[j].bid, next_run_reads[i]);
+                }
             }
         }
+        nwrites = i;
         std::swap(Blocks1, Blocks2);
         std::swap(bids1, bids2);
         std::swap(read_reqs1, read_reqs2);
     }
 
-    run_type* run = runs[nruns - 1];
-    run_size = run->size();
+    run_size = group_size(ngroups - 1);
     TLX_LOG << "stxxl::create_runs start waiting read_reqs1";
     wait_all(read_reqs1, run_size);
     TLX_LOG << "stxxl::create_runs finish waiting read_reqs1";
     for (i = 0; i < run_size; ++i)
         bm->delete_block(bids1[i]);
 
-    check_sort_settings();
-    potentially_parallel::
-    sort(make_element_iterator(Blocks1, 0),
-         make_element_iterator(Blocks1, run_size * block_type::size),
-         cmp);
+    sort_group(Blocks1, ngroups - 1);
 
     TLX_LOG << "stxxl::create_runs start waiting write_reqs";
-    wait_all(write_reqs, m2);
+    wait_all(write_reqs, nwrites);
     TLX_LOG << "stxxl::create_runs finish waiting write_reqs";
 
-    for (i = 0; i < run_size; ++i)
+    i = 0;
+    for (size_t r = (ngroups - 1) * runs_per_group; r < nruns; ++r)
     {
-        TLX_LOG << "stxxl::create_runs posting write " << Blocks1[i].elem;
-        (*run)[i].value = Blocks1[i][0];
-        write_reqs[i] = Blocks1[i].write((*run)[i].bid);
+        run_type* run = runs[r];
+        for (size_t j = 0; j < run->size(); ++j, ++i)
+        {
+            TLX_LOG << "stxxl::create_runs posting write " << Blocks1[i].elem;
+            (*run)[j].value = Blocks1[i][0];
+            write_reqs[i] = Blocks1[i].write((*run)[j].bid);
+        }
     }
 
     TLX_LOG << "stxxl::create_runs start waiting write_reqs";
     wait_all(write_reqs, run_size);
     TLX_LOG << "stxxl::create_runs finish waiting write_reqs";
 
-    delete[] Blocks1;
-    delete[] Blocks2;
+    delete_block_array(Blocks1, m2);
+    delete_block_array(Blocks2, m2);
     delete[] bids1;
     delete[] bids2;
     delete[] read_reqs1;
@@ -315,7 +406,52 @@ bool check_sorted_runs(RunType** runs,
     return true;
 }
 
-template <typename BlockType, typename RunType, typename CompareWithMin>
+/*!
+ * Concatenate consecutive runs if the first element of a run is not smaller
+ * than the last element of its predecessor, given in last_values, as happens
+ * for presorted input. Returns the new number of runs in runs.
+ */
+template <typename RunType, typename ValueType, typename ValueCmp>
+size_t concatenate_runs(RunType** runs, size_t nruns,
+                        const ValueType* last_values, ValueCmp cmp)
+{
+    using run_type = RunType;
+
+    size_t new_nruns = 0;
+    for (size_t r = 0; r < nruns; )
+    {
+        size_t end = r + 1, blocks = runs[r]->size();
+        while (end < nruns && !cmp((*runs[end])[0].value, last_values[end - 1]))
+            blocks += runs[end++]->size();
+
+        if (end - r == 1)
+        {
+            runs[new_nruns++] = runs[r++];
+            continue;
+        }
+
+        TLX_LOG << "stxxl::concatenate_runs runs " << r << " to " << end;
+
+        run_type* run = new run_type(blocks);
+        typename run_type::iterator it = run->begin();
+        for ( ; r < end; ++r)
+        {
+            it = std::copy(runs[r]->begin(), runs[r]->end(), it);
+            delete runs[r];
+        }
+        runs[new_nruns++] = run;
+    }
+
+    return new_nruns;
+}
+
+/*!
+ * Merge the runs in_runs into out_run. If Stable, equal elements are output in
+ * the order of the runs, by a loser tree breaking ties by the position of the
+ * blocks in the runs, which needs no extra payload in the elements.
+ */
+template <typename BlockType, typename RunType, typename CompareWithMin,
+          bool Stable = false>
 void merge_runs(RunType** in_runs, size_t nruns,
                 RunType* out_run, size_t _m, CompareWithMin cmp)
 {
@@ -323,10 +459,13 @@ void merge_runs(RunType** in_runs, size_t nruns,
     using run_type = RunType;
     using value_cmp = CompareWithMin;
     using trigger_entry_type = typename run_type::value_type;
-    using prefetcher_type = foxxll::block_prefetcher<block_type, typename run_type::iterator>;
+    using prefetcher_type = run_prefetcher<block_type, typename run_type::iterator>;
     using run_cursor_type = run_cursor2<block_type, prefetcher_type>;
     using run_cursor2_cmp_type = sort_helper::run_cursor2_cmp<block_type, prefetcher_type, value_cmp>;
 
+    STXXL_TRACE_SPAN(span, "merge_runs");
+    span.add_bytes(out_run->size() * block_type::raw_size);
+
     run_type consume_seq(out_run->size());
 
     size_t* prefetch_seq = new size_t[out_run->size()];
@@ -341,8 +480,13 @@ void merge_runs(RunType** in_runs, size_t nruns,
             copy_start);
     }
 
-    std::stable_sort(consume_seq.begin(), consume_seq.end(),
-                     sort_helper::trigger_entry_cmp<trigger_entry_type, value_cmp>(cmp) _STXXL_SORT_TRIGGER_FORCE_SEQUENTIAL);
+    // position in the runs of each block of the consume sequence
+    std::vector<size_t> origin;
+    if (Stable)
+        sort_helper::sort_consume_seq_stable(consume_seq, origin, cmp);
+    else
+        std::stable_sort(consume_seq.begin(), consume_seq.end(),
+                         sort_helper::trigger_entry_cmp<trigger_entry_type, value_cmp>(cmp) _STXXL_SORT_TRIGGER_FORCE_SEQUENTIAL);
 
     size_t disks_number = foxxll::config::get_instance()->disks_number();
 
@@ -353,7 +497,13 @@ void merge_runs(RunType** in_runs, size_t nruns,
     const size_t n_write_buffers = std::max(2 * disks_number, _m - nruns - n_prefetch_buffers);
  #if STXXL_SORT_OPTIMAL_PREFETCHING
     // heuristic
-    const size_t n_opt_prefetch_buffers = 2 * disks_number + (3 * (n_prefetch_buffers - 2 * disks_number)) / 10;
+    size_t max_run_blocks = 0;
+    for (size_t i = 0; i < nruns; i++)
+        max_run_blocks = std::max(max_run_blocks, in_runs[i]->size());
+
+    const size_t n_opt_prefetch_buffers = optimal_prefetch_buffers(
+        2 * disks_number, n_prefetch_buffers,
+        nruns, max_run_blocks, out_run->size());
  #endif
 #endif
 
@@ -382,8 +532,9 @@ void merge_runs(RunType** in_runs, size_t nruns,
 
 //If parallelism is activated, one can still fall back to the
 //native merge routine by setting stxxl::SETTINGS::native_merge= true, //otherwise, it is used anyway.
+//Stable merging always uses the native loser tree.
 
-    if (do_parallel_merge())
+    if (!Stable && do_parallel_merge())
     {
 #if STXXL_PARALLEL_MULTIWAY_MERGE
 
@@ -477,28 +628,45 @@ void merge_runs(RunType** in_runs, size_t nruns,
     {
 // begin of native merging procedure
 
-        loser_tree<run_cursor_type, run_cursor2_cmp_type>
-        losers(&prefetcher, nruns, run_cursor2_cmp_type(cmp));
-
+        auto native_merge =
+            [&](auto& losers) {
 #if STXXL_CHECK_ORDER_IN_SORTS
-        value_type last_elem = cmp.min_value();
+                value_type last_elem = cmp.min_value();
 #endif
 
-        for (size_t i = 0; i < out_run_size; ++i)
-        {
-            losers.multi_merge(out_buffer->elem, out_buffer->elem + block_type::size);
-            (*out_run)[i].value = *(out_buffer->elem);
+                for (size_t i = 0; i < out_run_size; ++i)
+                {
+                    losers.multi_merge(out_buffer->elem, out_buffer->elem + block_type::size);
+                    (*out_run)[i].value = *(out_buffer->elem);
 
 #if STXXL_CHECK_ORDER_IN_SORTS
-            assert(stxxl::is_sorted(out_buffer->cbegin(), out_buffer->cend(), cmp));
+                    assert(stxxl::is_sorted(out_buffer->cbegin(), out_buffer->cend(), cmp));
 
-            if (i)
-                assert(cmp(*(out_buffer->elem), last_elem) == false);
+                    if (i)
+                        assert(cmp(*(out_buffer->elem), last_elem) == false);
 
-            last_elem = (*out_buffer).elem[block_type::size - 1];
+                    last_elem = (*out_buffer).elem[block_type::size - 1];
 #endif
 
-            out_buffer = writer.write(out_buffer, (*out_run)[i].bid);
+                    out_buffer = writer.write(out_buffer, (*out_run)[i].bid);
+                }
+            };
+
+        if (Stable)
+        {
+            using stable_cursor_type = stable_run_cursor2<block_type, prefetcher_type>;
+            using stable_cursor_cmp_type =
+                      sort_helper::stable_run_cursor2_cmp<block_type, prefetcher_type, value_cmp>;
+
+            loser_tree<stable_cursor_type, stable_cursor_cmp_type>
+            losers(&prefetcher, nruns, stable_cursor_cmp_type(cmp, origin.data()));
+            native_merge(losers);
+        }
+        else
+        {
+            loser_tree<run_cursor_type, run_cursor2_cmp_type>
+            losers(&prefetcher, nruns, run_cursor2_cmp_type(cmp));
+            native_merge(losers);
         }
 
 // end of native merging procedure
@@ -506,12 +674,11 @@ void merge_runs(RunType** in_runs, size_t nruns,
 
     delete[] prefetch_seq;
 
-    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    disk_space_reclaimer& reclaimer = disk_space_reclaimer::get_instance();
     for (size_t i = 0; i < nruns; ++i)
     {
-        size_t sz = in_runs[i]->size();
-        for (size_t j = 0; j < sz; ++j)
-            bm->delete_block((*in_runs[i])[j].bid);
+        reclaimer.delete_blocks(make_bid_iterator(in_runs[i]->begin()),
+                                make_bid_iterator(in_runs[i]->end()));
 
         delete in_runs[i];
     }
@@ -520,7 +687,8 @@ void merge_runs(RunType** in_runs, size_t nruns,
 template <typename BlockType,
           typename AllocStrategy,
           typename InputBidIterator,
-          typename ValueCmp>
+          typename ValueCmp,
+          bool Stable = false>
 tlx::simple_vector<sort_helper::trigger_entry<BlockType> >*
 sort_blocks(InputBidIterator input_bids,
             size_t _n,
@@ -538,8 +706,13 @@ sort_blocks(InputBidIterator input_bids,
               typename foxxll::interleaved_alloc_traits<alloc_strategy>::strategy;
 
     size_t m2 = _m / 2;
-    size_t full_runs = _n / m2;
-    size_t partial_runs = ((_n % m2) ? 1 : 0);
+    // with parallel run formation each thread sorts its own run of m2 /
+    // runs_per_group blocks, thus yielding more but smaller runs.
+    const size_t runs_per_group =
+        std::max<size_t>(1, std::min(sort_run_formation_threads(), m2));
+    size_t run_size = m2 / runs_per_group;
+    size_t full_runs = _n / run_size;
+    size_t partial_runs = ((_n % run_size) ? 1 : 0);
     size_t nruns = full_runs + partial_runs;
     size_t i;
 
@@ -550,20 +723,27 @@ sort_blocks(InputBidIterator input_bids,
     run_type** runs = new run_type*[nruns];
 
     for (i = 0; i < full_runs; i++)
-        runs[i] = new run_type(m2);
+        runs[i] = new run_type(run_size);
 
     if (partial_runs)
-        runs[i] = new run_type(_n - full_runs * m2);
+        runs[i] = new run_type(_n - full_runs * run_size);
 
     for (i = 0; i < nruns; ++i)
         mng->new_blocks(alloc_strategy(),
                         make_bid_iterator(runs[i]->begin()),
                         make_bid_iterator(runs[i]->end()));
 
+    std::vector<typename block_type::value_type> last_values(nruns);
+
     sort_local::create_runs<block_type,
                             run_type,
                             input_bid_iterator,
-                            value_cmp>(input_bids, runs, nruns, _m, cmp);
+                            value_cmp,
+                            Stable>(input_bids, runs, nruns, _m, cmp,
+                                       last_values.data(), runs_per_group);
+
+    // runs of presorted input need not be merged
+    nruns = concatenate_runs(runs, nruns, last_values.data(), cmp);
 
     after_runs_creation = foxxll::timestamp();
 
@@ -641,8 +821,9 @@ sort_blocks(InputBidIterator input_bids,
             assert((check_sorted_runs<block_type, run_type, value_cmp>(runs + nruns - runs_left, runs2merge, m2, cmp)));
 #endif
             TLX_LOG1 << "Merging " << runs2merge << " runs";
-            merge_runs<block_type, run_type>(runs + nruns - runs_left,
-                                             runs2merge, *(new_runs + (cur_out_run++)), _m, cmp);
+            merge_runs<block_type, run_type, value_cmp, Stable>(
+                runs + nruns - runs_left,
+                runs2merge, *(new_runs + (cur_out_run++)), _m, cmp);
             runs_left -= runs2merge;
         }
 
@@ -663,29 +844,13 @@ sort_blocks(InputBidIterator input_bids,
     return result;
 }
 
-} // namespace sort_local
-
 /*!
- * Sort records comparison-based, see \ref design_algo_sort.
- *
- * stxxl::sort sorts the elements in [first, last) into ascending order,
- * meaning that if \c i and \c j are any two valid iterators in [first, last)
- * such that \c i precedes \c j, then \c *j is not less than \c *i. Note: as
- * std::sort, stxxl::sort is not guaranteed to be stable. That is, suppose that
- * \c *i and \c *j are equivalent: neither one is less than the other. It is
- * not guaranteed that the relative order of these two elements will be
- * preserved by stxxl::sort.
- *
- * The order is defined by the \c cmp parameter. The sorter's internal memory
- * consumption is bounded by \a M bytes.
- *
- * \param first object of model of \c ext_random_access_iterator concept
- * \param last object of model of \c ext_random_access_iterator concept
- * \param cmp comparison object of \ref StrictWeakOrdering
- * \param M amount of memory for internal use (in bytes)
+ * Sort [first, last) of an external vector, see stxxl::sort() and
+ * stxxl::stable_sort(). If Stable, the runs are formed by stable sorting and
+ * merged stably, and the sample sort is not used.
  */
-template <typename ExtIterator, typename StrictWeakOrderingWithMinMax>
-void sort(ExtIterator first, ExtIterator last, StrictWeakOrderingWithMinMax cmp, size_t M)
+template <bool Stable, typename ExtIterator, typename StrictWeakOrderingWithMinMax>
+void sort_range(ExtIterator first, ExtIterator last, StrictWeakOrderingWithMinMax cmp, size_t M)
 {
     sort_helper::verify_sentinel_strict_weak_ordering(cmp);
 
@@ -701,11 +866,17 @@ void sort(ExtIterator first, ExtIterator last, StrictWeakOrderingWithMinMax cmp,
 
     foxxll::block_manager* mng = foxxll::block_manager::get_instance();
 
+    memory_reservation reservation(Stable ? "stxxl::stable_sort" : "stxxl::sort", M);
+
     first.flush();
 
     if ((last - first) * sizeof(value_type) * sort_memory_usage_factor() < M)
     {
-        stl_in_memory_sort(first, last, cmp);
+        stl_in_memory_sort<Stable>(first, last, cmp);
+    }
+    else if (!Stable && SETTINGS::sample_sort)
+    {
+        sample_sort_local::sort(first, last, cmp, M);
     }
     else
     {
@@ -760,8 +931,9 @@ void sort(ExtIterator first, ExtIterator last, StrictWeakOrderingWithMinMax cmp,
                 delete last_block;
 
                 run_type* out =
-                    sort_local::sort_blocks<
-                        block_type, alloc_strategy_type, bids_container_iterator
+                    sort_blocks<
+                        block_type, alloc_strategy_type, bids_container_iterator,
+                        StrictWeakOrderingWithMinMax, Stable
                         >(first.bid(), n,
                           M / sort_memory_usage_factor() / block_type::raw_size, cmp);
 
@@ -854,8 +1026,9 @@ void sort(ExtIterator first, ExtIterator last, StrictWeakOrderingWithMinMax cmp,
                 delete first_block;
 
                 run_type* out =
-                    sort_local::sort_blocks<
-                        block_type, alloc_strategy_type, bids_container_iterator
+                    sort_blocks<
+                        block_type, alloc_strategy_type, bids_container_iterator,
+                        StrictWeakOrderingWithMinMax, Stable
                         >(first.bid(), n,
                           M / sort_memory_usage_factor() / block_type::raw_size, cmp);
 
@@ -933,8 +1106,9 @@ void sort(ExtIterator first, ExtIterator last, StrictWeakOrderingWithMinMax cmp,
                 delete last_block;
 
                 run_type* out =
-                    sort_local::sort_blocks<
-                        block_type, alloc_strategy_type, bids_container_iterator
+                    sort_blocks<
+                        block_type, alloc_strategy_type, bids_container_iterator,
+                        StrictWeakOrderingWithMinMax, Stable
                         >(first.bid(), n,
                           M / sort_memory_usage_factor() / block_type::raw_size, cmp);
 
@@ -981,8 +1155,9 @@ void sort(ExtIterator first, ExtIterator last, StrictWeakOrderingWithMinMax cmp,
                 n = last.bid() - first.bid();
 
                 run_type* out =
-                    sort_local::sort_blocks<
-                        block_type, alloc_strategy_type, bids_container_iterator
+                    sort_blocks<
+                        block_type, alloc_strategy_type, bids_container_iterator,
+                        StrictWeakOrderingWithMinMax, Stable
                         >(first.bid(), n,
                           M / sort_memory_usage_factor() / block_type::raw_size, cmp);
 
@@ -1005,6 +1180,58 @@ void sort(ExtIterator first, ExtIterator last, StrictWeakOrderingWithMinMax cmp,
 #endif
 }
 
+} // namespace sort_local
+
+/*!
+ * Sort records comparison-based, see \ref design_algo_sort.
+ *
+ * stxxl::sort sorts the elements in [first, last) into ascending order,
+ * meaning that if \c i and \c j are any two valid iterators in [first, last)
+ * such that \c i precedes \c j, then \c *j is not less than \c *i. Note: as
+ * std::sort, stxxl::sort is not guaranteed to be stable. That is, suppose that
+ * \c *i and \c *j are equivalent: neither one is less than the other. It is
+ * not guaranteed that the relative order of these two elements will be
+ * preserved by stxxl::sort.
+ *
+ * The order is defined by the \c cmp parameter. The sorter's internal memory
+ * consumption is bounded by \a M bytes.
+ *
+ * \param first object of model of \c ext_random_access_iterator concept
+ * \param last object of model of \c ext_random_access_iterator concept
+ * \param cmp comparison object of \ref StrictWeakOrdering
+ * \param M amount of memory for internal use (in bytes)
+ */
+template <typename ExtIterator, typename StrictWeakOrderingWithMinMax>
+void sort(ExtIterator first, ExtIterator last, StrictWeakOrderingWithMinMax cmp, size_t M)
+{
+    sort_local::sort_range<false>(first, last, cmp, M);
+}
+
+/*!
+ * Sort records comparison-based and stably, see \ref design_algo_sort.
+ *
+ * stxxl::stable_sort sorts the elements in [first, last) into ascending order
+ * like stxxl::sort, but equivalent elements keep their relative order, as with
+ * std::stable_sort. The runs are formed by stable in-memory sorting, in
+ * parallel as by stxxl::sort, and merged by a loser tree which breaks ties by
+ * the position of the blocks in the runs. Hence, unlike appending the input
+ * position to each record, no extra bytes are read or written. The parallel
+ * multiway merger and the sample sort are not used.
+ *
+ * The order is defined by the \c cmp parameter. The sorter's internal memory
+ * consumption is bounded by \a M bytes.
+ *
+ * \param first object of model of \c ext_random_access_iterator concept
+ * \param last object of model of \c ext_random_access_iterator concept
+ * \param cmp comparison object of \ref StrictWeakOrdering
+ * \param M amount of memory for internal use (in bytes)
+ */
+template <typename ExtIterator, typename StrictWeakOrderingWithMinMax>
+void stable_sort(ExtIterator first, ExtIterator last, StrictWeakOrderingWithMinMax cmp, size_t M)
+{
+    sort_local::sort_range<true>(first, last, cmp, M);
+}
+
 //! \}
 
 } // namespace stxxl
@@ -21,6 +21,10 @@
 #define STXXL_SORT_OPTIMAL_PREFETCHING 1
 #endif
 
+#ifndef STXXL_SORT_BALANCED_PREFETCHING
+#define STXXL_SORT_BALANCED_PREFETCHING 1
+#endif
+
 #ifndef STXXL_CHECK_ORDER_IN_SORTS
 #define STXXL_CHECK_ORDER_IN_SORTS 0
 #endif
@@ -37,6 +41,29 @@ inline size_t optimal_merge_factor(size_t num_runs, size_t max_concurrent_runs)
     return size_t(ceil(pow(double(num_runs), 1. / ceil(log(double(num_runs)) / log(double(max_concurrent_runs))))));
 }
 
+// Number of prefetch buffers to plan the optimal prefetch schedule with:
+// 30% of the buffers exceeding min_buffers if all runs have the same length,
+// more if the longest run is consumed faster than the average run, since its
+// blocks are requested in bursts. max_run_blocks is the length of the longest
+// run and total_blocks the length of all runs in blocks.
+inline size_t optimal_prefetch_buffers(size_t min_buffers, size_t num_buffers,
+                                       size_t num_runs, size_t max_run_blocks,
+                                       size_t total_blocks)
+{
+    if (num_buffers <= min_buffers || total_blocks == 0)
+        return min_buffers;
+
+    // consumption rate of the longest run relative to the average, in tenths
+    // of the spare buffers: 3 for runs of equal length.
+    size_t share = 3 * max_run_blocks * num_runs / total_blocks;
+    if (share > 10)
+        share = 10;
+    if (share < 3)
+        share = 3;
+
+    return min_buffers + (share * (num_buffers - min_buffers)) / 10;
+}
+
 } // namespace stxxl
 
 #endif // !STXXL_ALGO_SORT_BASE_HEADER
@@ -16,6 +16,8 @@
 
 #include <algorithm>
 #include <functional>
+#include <iterator>
+#include <vector>
 
 #include <tlx/define.hpp>
 #include <tlx/logger/core.hpp>
@@ -94,6 +96,62 @@ struct run_cursor2_cmp
     }
 };
 
+//! Comparator of stable_run_cursor2 objects, which breaks ties of the
+//! current elements by the position in the runs of the blocks of the
+//! cursors, given for each position of the consume sequence by origin.
+template <typename BlockType,
+          typename PrefetcherType,
+          typename ValueCmp>
+struct stable_run_cursor2_cmp
+{
+    using block_type = BlockType;
+    using prefetcher_type = PrefetcherType;
+    using value_cmp = ValueCmp;
+
+    using cursor_type = stable_run_cursor2<block_type, prefetcher_type>;
+    value_cmp cmp;
+    const size_t* origin;
+
+    stable_run_cursor2_cmp(value_cmp c, const size_t* o) : cmp(c), origin(o) { }
+    inline bool operator () (const cursor_type& a, const cursor_type& b) const
+    {
+        if (TLX_UNLIKELY(b.empty()))
+            return true;
+        // sentinel emulation
+        if (TLX_UNLIKELY(a.empty()))
+            return false;
+        // sentinel emulation
+
+        if (cmp(a.current(), b.current()))
+            return true;
+        if (cmp(b.current(), a.current()))
+            return false;
+        return origin[a.block] < origin[b.block];
+    }
+};
+
+//! Sort the trigger entries of the runs concatenated in consume_seq by their
+//! values for stable merging: equal values keep the order of the runs. The
+//! position in the runs of each entry is stored in origin.
+template <typename RunType, typename ValueCmp>
+inline void sort_consume_seq_stable(RunType& consume_seq, std::vector<size_t>& origin,
+                                    ValueCmp cmp)
+{
+    origin.resize(consume_seq.size());
+    for (size_t i = 0; i < origin.size(); ++i)
+        origin[i] = i;
+
+    std::stable_sort(origin.begin(), origin.end(),
+                     [&consume_seq, &cmp](const size_t& a, const size_t& b) {
+                         return cmp(consume_seq[a].value, consume_seq[b].value);
+                     });
+
+    RunType sorted(consume_seq.size());
+    for (size_t i = 0; i < origin.size(); ++i)
+        sorted[i] = consume_seq[origin[i]];
+    consume_seq.swap(sorted);
+}
+
 // this function is used by parallel mergers
 template <typename SequenceVector, typename ValueType, typename Comparator>
 inline size_t
@@ -144,6 +202,32 @@ refill_or_remove_empty_sequences(SequenceVector& seqs,
     }
 }
 
+// this function is used by run formation to skip sorting presorted input:
+// returns true if [begin,end) is sorted, possibly after reversing it because
+// it was sorted in descending order. Unsorted input is detected at the first
+// inversion in each direction.
+template <typename RandomAccessIterator, typename Comparator>
+inline bool
+sort_presorted(RandomAccessIterator begin, RandomAccessIterator end,
+               Comparator cmp)
+{
+    using value_type = typename std::iterator_traits<RandomAccessIterator>::value_type;
+
+    if (std::is_sorted(begin, end, cmp))
+        return true;
+
+    if (std::is_sorted(begin, end,
+                       [&cmp](const value_type& a, const value_type& b) {
+                           return cmp(b, a);
+                       }))
+    {
+        std::reverse(begin, end);
+        return true;
+    }
+
+    return false;
+}
+
 } // namespace sort_helper
 } // namespace stxxl
 
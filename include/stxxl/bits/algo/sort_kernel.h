@@ -0,0 +1,575 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/sort_kernel.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_SORT_KERNEL_HEADER
+#define STXXL_ALGO_SORT_KERNEL_HEADER
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <stxxl/bits/algo/intksort.h>
+#include <stxxl/bits/common/comparator.h>
+#include <stxxl/bits/parallel.h>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+/*!
+ * Integer key used by the in-memory sort kernel for integral types: the
+ * value with the sign bit flipped for signed types, complemented for
+ * descending order.
+ */
+template <typename ValueType, bool Descending>
+struct sort_kernel_key
+{
+    using key_type = typename std::make_unsigned<ValueType>::type;
+
+    key_type operator () (const ValueType& x) const
+    {
+        key_type k = static_cast<key_type>(x);
+        if (std::is_signed<ValueType>::value)
+            k ^= key_type(1) << (8 * sizeof(key_type) - 1);
+        return Descending ? static_cast<key_type>(~k) : k;
+    }
+};
+
+//! Key of field I of tuples used by the in-memory sort kernel.
+template <typename TupleType, size_t I, bool Descending>
+struct sort_kernel_field_key
+{
+    using field_key = sort_kernel_key<
+              typename std::tuple_element<I, TupleType>::type, Descending>;
+    using key_type = typename field_key::key_type;
+
+    key_type operator () (const TupleType& x) const
+    {
+        return field_key()(std::get<I>(x));
+    }
+};
+
+//! Key of pairs used by the in-memory sort kernel: the key of the first
+//! component, ties are broken by the comparator.
+template <typename PairType, bool Descending>
+struct sort_kernel_first_key
+{
+    using first_key = sort_kernel_key<typename PairType::first_type, Descending>;
+    using key_type = typename first_key::key_type;
+
+    key_type operator () (const PairType& x) const
+    {
+        return first_key()(x.first);
+    }
+};
+
+//! Key of values compared by a stxxl::struct_comparator used by the
+//! in-memory sort kernel: the key of the first extracted field, ties are
+//! broken by the comparator.
+template <typename CompareType, bool Descending>
+struct sort_kernel_struct_key
+{
+    using traits = comparator_traits<CompareType>;
+    using field_key = sort_kernel_key<
+              typename std::tuple_element<0, typename traits::key_type>::type, Descending>;
+    using key_type = typename field_key::key_type;
+
+    //! comparator holding the key extractor
+    CompareType m_cmp;
+
+    explicit sort_kernel_struct_key(const CompareType& cmp)
+        : m_cmp(cmp)
+    { }
+
+    key_type operator () (const typename traits::value_type& x) const
+    {
+        return field_key()(std::get<0>(traits::keys(m_cmp, x)));
+    }
+};
+
+/*!
+ * Selects the in-memory sort kernel for sorting values of ValueType with
+ * CompareType at compile time. The kernel is enabled for integral types
+ * compared by stxxl::comparator, std::less or std::greater, for pairs of
+ * them compared by stxxl::comparator, for tuples of integral fields compared
+ * by stxxl::comparator, which are radix sorted field by field with descending
+ * fields complemented, and for structs compared by stxxl::struct_comparator
+ * whose first key is integral, see comparator_traits.
+ *
+ * Other types can enable it by a specialization deriving from
+ * sort_kernel_enabled with an unsigned integer key extractor ordered
+ * consistently with CompareType, and optionally a leaf sorter. Key extractors
+ * which are not default constructible are created from the comparator by a
+ * static make_key_extractor() of the specialization.
+ */
+template <typename ValueType, typename CompareType, typename Enable = void>
+struct sort_kernel_traits
+{
+    static constexpr bool enabled = false;
+};
+
+namespace sort_kernel_local {
+struct network_leaf_sort;
+} // namespace sort_kernel_local
+
+template <typename KeyExtractor,
+          typename LeafSort = sort_kernel_local::network_leaf_sort>
+struct sort_kernel_enabled
+{
+    static constexpr bool enabled = true;
+    using key_extractor = KeyExtractor;
+    using leaf_sort = LeafSort;
+
+    template <typename CompareType>
+    static key_extractor make_key_extractor(const CompareType&)
+    {
+        return key_extractor();
+    }
+};
+
+namespace sort_kernel_local {
+
+template <typename ValueType>
+using enable_if_integral = typename std::enable_if<
+          std::is_integral<ValueType>::value && !std::is_same<ValueType, bool>::value>::type;
+
+//! A compare-exchange of a sorting network, a[i] <= a[j] afterwards.
+struct network_pair
+{
+    unsigned char i, j;
+};
+
+//! Batcher's odd-even merge sort network for 16 elements. Dropping the
+//! comparators with j >= n sorts n < 16 elements.
+static constexpr network_pair network16[63] = {
+    { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 }, { 8, 9 }, { 10, 11 }, { 12, 13 }, { 14, 15 },
+    { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 }, { 8, 10 }, { 9, 11 }, { 12, 14 }, { 13, 15 },
+    { 1, 2 }, { 5, 6 }, { 9, 10 }, { 13, 14 },
+    { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }, { 8, 12 }, { 9, 13 }, { 10, 14 }, { 11, 15 },
+    { 2, 4 }, { 3, 5 }, { 10, 12 }, { 11, 13 },
+    { 1, 2 }, { 3, 4 }, { 5, 6 }, { 9, 10 }, { 11, 12 }, { 13, 14 },
+    { 0, 8 }, { 1, 9 }, { 2, 10 }, { 3, 11 }, { 4, 12 }, { 5, 13 }, { 6, 14 }, { 7, 15 },
+    { 4, 8 }, { 5, 9 }, { 6, 10 }, { 7, 11 },
+    { 2, 4 }, { 3, 5 }, { 6, 8 }, { 7, 9 }, { 10, 12 }, { 11, 13 },
+    { 1, 2 }, { 3, 4 }, { 5, 6 }, { 7, 8 }, { 9, 10 }, { 11, 12 }, { 13, 14 }
+};
+
+//! network chunk size
+static constexpr size_t network_size = 16;
+
+//! largest range sorted by networks and merges, larger ones use std::sort
+static constexpr size_t small_sort_size = intksort_inplace_min_bucket;
+
+//! Branch-free compare-exchange, compiled to conditional moves.
+template <typename Type, typename Compare>
+inline void compare_exchange(Type& a, Type& b, Compare cmp)
+{
+    const bool swap = cmp(b, a);
+    const Type lo = swap ? b : a;
+    const Type hi = swap ? a : b;
+    a = lo;
+    b = hi;
+}
+
+//! Sort n <= 16 elements with the network.
+template <typename Type, typename Compare>
+inline void network_sort(Type* a, size_t n, Compare cmp)
+{
+    if (n == network_size)
+    {
+        for (const network_pair& p : network16)
+            compare_exchange(a[p.i], a[p.j], cmp);
+    }
+    else
+    {
+        for (const network_pair& p : network16)
+        {
+            if (p.j < n)
+                compare_exchange(a[p.i], a[p.j], cmp);
+        }
+    }
+}
+
+//! Branch-free merge of the sorted ranges [a, a_end) and [b, b_end) into out.
+template <typename Type, typename Compare>
+inline void branchless_merge(const Type* a, const Type* a_end,
+                             const Type* b, const Type* b_end, Type* out, Compare cmp)
+{
+    while (a != a_end && b != b_end)
+    {
+        const bool take_b = cmp(*b, *a);
+        *out++ = take_b ? *b : *a;
+        a += !take_b;
+        b += take_b;
+    }
+    out = std::copy(a, a_end, out);
+    std::copy(b, b_end, out);
+}
+
+//! Leaf sorter of the radix sort: chunks of 16 elements are sorted by the
+//! network and merged pairwise through a buffer on the stack.
+struct network_leaf_sort
+{
+    template <typename Type, typename Compare>
+    void operator () (Type* a, Type* a_end, Compare cmp) const
+    {
+        const size_t n = static_cast<size_t>(a_end - a);
+        if (n > small_sort_size)
+        {
+            std::sort(a, a_end, cmp _STXXL_FORCE_SEQUENTIAL);
+            return;
+        }
+
+        for (size_t c = 0; c < n; c += network_size)
+            network_sort(a + c, std::min(network_size, n - c), cmp);
+
+        Type buffer[small_sort_size];
+        for (size_t width = network_size; width < n; width *= 2)
+        {
+            for (size_t c = 0; c + width < n; c += 2 * width)
+            {
+                const size_t mid = c + width, end = std::min(c + 2 * width, n);
+                branchless_merge(a + c, a + mid, a + mid, a + end, buffer, cmp);
+                std::copy(buffer, buffer + (end - c), a + c);
+            }
+        }
+    }
+};
+
+//! Direction of field I, fields without a direction are sorted ascending
+//! like stxxl::comparator does.
+template <size_t I, typename Modes>
+struct field_direction
+{
+    static constexpr direction value = direction::Less;
+};
+
+template <direction M1, direction... Modes>
+struct field_direction<0, direction_list<M1, Modes...> >
+{
+    static constexpr direction value = M1;
+};
+
+template <size_t I, direction M1, direction... Modes>
+struct field_direction<I, direction_list<M1, Modes...> >
+    : field_direction<I - 1, direction_list<Modes...> >
+{ };
+
+template <typename TupleType, typename Modes, size_t I>
+struct tuple_field_leaf_sort;
+
+//! Radix sort of tuples which are equal in the fields before I by the
+//! fields from I on, skipping fields without order.
+template <typename TupleType, typename Modes, size_t I,
+          direction Mode = field_direction<I, Modes>::value,
+          bool End = (I >= std::tuple_size<TupleType>::value)>
+struct tuple_field_sort
+{
+    template <typename Compare>
+    static void sort(TupleType* a, TupleType* a_end, Compare cmp)
+    {
+        radix_sort(a, a_end,
+                   sort_kernel_field_key<TupleType, I, Mode == direction::Greater>(),
+                   cmp, tuple_field_leaf_sort<TupleType, Modes, I>());
+    }
+};
+
+template <typename TupleType, typename Modes, size_t I>
+struct tuple_field_sort<TupleType, Modes, I, direction::DontCare, false>
+    : tuple_field_sort<TupleType, Modes, I + 1>
+{ };
+
+template <typename TupleType, typename Modes, size_t I, direction Mode>
+struct tuple_field_sort<TupleType, Modes, I, Mode, true>
+{
+    //! all fields are equal
+    template <typename Compare>
+    static void sort(TupleType*, TupleType*, Compare)
+    { }
+};
+
+//! Leaf sorter of the radix sort on field I of tuples: the radix sort hands
+//! over small ranges, which are sorted by the networks, and larger ranges
+//! only if they are equal in field I, which are sorted by the next fields.
+template <typename TupleType, typename Modes, size_t I>
+struct tuple_field_leaf_sort
+{
+    template <typename Compare>
+    void operator () (TupleType* a, TupleType* a_end, Compare cmp) const
+    {
+        if (static_cast<size_t>(a_end - a) < intksort_inplace_min_bucket)
+            network_leaf_sort()(a, a_end, cmp);
+        else
+            tuple_field_sort<TupleType, Modes, I + 1>::sort(a, a_end, cmp);
+    }
+};
+
+template <typename... Types>
+struct all_integral : std::true_type { };
+
+template <typename T1, typename... Types>
+struct all_integral<T1, Types...>
+    : std::integral_constant<
+          bool, std::is_integral<T1>::value && !std::is_same<T1, bool>::value &&
+          all_integral<Types...>::value>
+{ };
+
+template <typename ValueType, typename CompareType>
+void sort_range(ValueType* a, ValueType* a_end, CompareType cmp)
+{
+    using traits = sort_kernel_traits<ValueType, CompareType>;
+    using leaf_sort = typename traits::leaf_sort;
+    radix_sort(a, a_end, traits::make_key_extractor(cmp), cmp, leaf_sort());
+}
+
+template <typename BlockType, typename CompareType>
+bool sort_blocks(BlockType*, size_t, size_t, CompareType, std::false_type)
+{
+    return false;
+}
+
+template <typename BlockType, typename CompareType>
+bool sort_blocks(BlockType* blocks, size_t begin, size_t end, CompareType cmp,
+                 std::true_type)
+{
+    using value_type = typename BlockType::value_type;
+    if (sizeof(BlockType) != BlockType::size * sizeof(value_type))
+        return false;
+
+    sort_range(blocks[0].begin() + begin, blocks[0].begin() + end, cmp);
+    return true;
+}
+
+} // namespace sort_kernel_local
+
+// integral types
+
+template <typename ValueType>
+struct sort_kernel_traits<ValueType, std::less<ValueType>,
+                          sort_kernel_local::enable_if_integral<ValueType> >
+    : sort_kernel_enabled<sort_kernel_key<ValueType, false> >{ };
+
+template <typename ValueType>
+struct sort_kernel_traits<ValueType, std::less<>,
+                          sort_kernel_local::enable_if_integral<ValueType> >
+    : sort_kernel_enabled<sort_kernel_key<ValueType, false> >{ };
+
+template <typename ValueType>
+struct sort_kernel_traits<ValueType, std::greater<ValueType>,
+                          sort_kernel_local::enable_if_integral<ValueType> >
+    : sort_kernel_enabled<sort_kernel_key<ValueType, true> >{ };
+
+template <typename ValueType>
+struct sort_kernel_traits<ValueType, comparator<ValueType>,
+                          sort_kernel_local::enable_if_integral<ValueType> >
+    : sort_kernel_enabled<sort_kernel_key<ValueType, false> >{ };
+
+template <typename ValueType>
+struct sort_kernel_traits<ValueType, comparator<ValueType, direction::Less>,
+                          sort_kernel_local::enable_if_integral<ValueType> >
+    : sort_kernel_enabled<sort_kernel_key<ValueType, false> >{ };
+
+template <typename ValueType>
+struct sort_kernel_traits<ValueType, comparator<ValueType, direction::Greater>,
+                          sort_kernel_local::enable_if_integral<ValueType> >
+    : sort_kernel_enabled<sort_kernel_key<ValueType, true> >{ };
+
+// pairs, by the first component
+
+template <typename T1, typename T2>
+struct sort_kernel_traits<std::pair<T1, T2>, comparator<std::pair<T1, T2> >,
+                          sort_kernel_local::enable_if_integral<T1> >
+    : sort_kernel_enabled<sort_kernel_first_key<std::pair<T1, T2>, false> >{ };
+
+template <typename T1, typename T2, direction... Modes>
+struct sort_kernel_traits<std::pair<T1, T2>, comparator<std::pair<T1, T2>, direction::Less, Modes...>,
+                          sort_kernel_local::enable_if_integral<T1> >
+    : sort_kernel_enabled<sort_kernel_first_key<std::pair<T1, T2>, false> >{ };
+
+template <typename T1, typename T2, direction... Modes>
+struct sort_kernel_traits<std::pair<T1, T2>, comparator<std::pair<T1, T2>, direction::Greater, Modes...>,
+                          sort_kernel_local::enable_if_integral<T1> >
+    : sort_kernel_enabled<sort_kernel_first_key<std::pair<T1, T2>, true> >{ };
+
+// tuples of integral fields, field by field
+
+template <typename T1, typename... Types, direction M1, direction... Modes>
+struct sort_kernel_traits<
+    std::tuple<T1, Types...>, comparator<std::tuple<T1, Types...>, M1, Modes...>,
+    typename std::enable_if<
+        M1 != direction::DontCare &&
+        sort_kernel_local::all_integral<T1, Types...>::value>::type>
+    : sort_kernel_enabled<
+          sort_kernel_field_key<std::tuple<T1, Types...>, 0, M1 == direction::Greater>,
+          sort_kernel_local::tuple_field_leaf_sort<
+              std::tuple<T1, Types...>,
+              direction_list<M1, Modes...>, 0> >{ };
+
+template <typename T1, typename... Types>
+struct sort_kernel_traits<
+    std::tuple<T1, Types...>, comparator<std::tuple<T1, Types...> >,
+    typename std::enable_if<sort_kernel_local::all_integral<T1, Types...>::value>::type>
+    : sort_kernel_traits<
+          std::tuple<T1, Types...>, comparator<std::tuple<T1, Types...>, direction::Less> >{ };
+
+// structs compared by struct_comparator, by the first key
+
+template <typename ValueType, typename KeyExtract, direction... Modes>
+struct sort_kernel_traits<
+    ValueType, struct_comparator<ValueType, KeyExtract, Modes...>,
+    typename std::enable_if<
+        comparator_traits<struct_comparator<ValueType, KeyExtract, Modes...> >
+        ::first_direction != direction::DontCare &&
+        comparator_details::is_integral_key<
+            typename std::tuple_element<
+                0, typename comparator_traits<
+                    struct_comparator<ValueType, KeyExtract, Modes...> >
+                ::key_type>::type>::value>::type>
+    : sort_kernel_enabled<
+          sort_kernel_struct_key<
+              struct_comparator<ValueType, KeyExtract, Modes...>,
+              comparator_traits<struct_comparator<ValueType, KeyExtract, Modes...> >
+              ::first_direction == direction::Greater> >
+{
+    using compare_type = struct_comparator<ValueType, KeyExtract, Modes...>;
+    using key_extractor = sort_kernel_struct_key<
+              compare_type,
+              comparator_traits<compare_type>::first_direction == direction::Greater>;
+
+    static key_extractor make_key_extractor(const compare_type& cmp)
+    {
+        return key_extractor(cmp);
+    }
+};
+
+/*!
+ * Sort the elements [begin, end) of the consecutive blocks with the in-memory
+ * sort kernel if sort_kernel_traits enables it for the value type and
+ * comparator: an in-place MSD radix sort on the integer key, whose small
+ * buckets are sorted by branch-free sorting networks and merges. Returns
+ * false if the kernel is not available or the blocks have gaps between their
+ * elements, the caller then sorts with a comparison sort.
+ */
+template <typename BlockType, typename CompareType>
+bool sort_kernel_blocks(BlockType* blocks, size_t begin, size_t end, CompareType cmp)
+{
+    using value_type = typename BlockType::value_type;
+    return sort_kernel_local::sort_blocks(
+        blocks, begin, end, cmp,
+        std::integral_constant<
+            bool, sort_kernel_traits<value_type, CompareType>::enabled>());
+}
+
+namespace sort_kernel_local {
+
+//! Normalized key of a value and its index in the range sorted.
+template <typename KeyType>
+struct normalized_entry
+{
+    KeyType key;
+    uint32_t index;
+};
+
+template <typename KeyType>
+struct normalized_entry_key
+{
+    using key_type = KeyType;
+
+    key_type operator () (const normalized_entry<KeyType>& e) const
+    {
+        return e.key;
+    }
+};
+
+//! Sort [a, a_end) by sorting the normalized keys with the indexes of the
+//! values, whose ties are decided by the comparator on the values, and
+//! permuting the values once along the cycles of the sorted indexes.
+template <typename ValueType, typename CompareType, typename KeyFunction>
+void normalized_sort_range(
+    ValueType* a, ValueType* a_end,
+    const normalized_key_comparator<CompareType, KeyFunction>& cmp)
+{
+    using key_type = typename std::decay<decltype(cmp.key(*a))>::type;
+    static_assert(std::is_integral<key_type>::value && std::is_unsigned<key_type>::value,
+                  "normalized keys must be unsigned integers");
+    using entry_type = normalized_entry<key_type>;
+
+    const size_t n = static_cast<size_t>(a_end - a);
+    std::vector<entry_type> entries(n);
+    for (size_t i = 0; i < n; ++i)
+        entries[i] = entry_type { cmp.key(a[i]), static_cast<uint32_t>(i) };
+
+    const CompareType& value_cmp = cmp.compare();
+    auto entry_cmp =
+        [a, &value_cmp](const entry_type& x, const entry_type& y) {
+            if (x.key != y.key)
+                return x.key < y.key;
+            return value_cmp(a[x.index], a[y.index]);
+        };
+    radix_sort(entries.data(), entries.data() + n,
+               normalized_entry_key<key_type>(), entry_cmp, network_leaf_sort());
+
+    // position i receives the value at entries[i].index
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (entries[i].index == i)
+            continue;
+        ValueType tmp = a[i];
+        size_t j = i;
+        while (true)
+        {
+            const size_t k = entries[j].index;
+            entries[j].index = static_cast<uint32_t>(j);
+            if (k == i)
+            {
+                a[j] = tmp;
+                break;
+            }
+            a[j] = a[k];
+            j = k;
+        }
+    }
+}
+
+} // namespace sort_kernel_local
+
+/*!
+ * Sort the elements [begin, end) of the consecutive blocks by their
+ * normalized keys, see normalized_key_comparator. Returns false if the
+ * blocks have gaps between their elements or the range has more than 2^32
+ * elements, the caller then sorts with a comparison sort, which compares
+ * the keys first as well.
+ */
+template <typename BlockType, typename CompareType, typename KeyFunction>
+bool sort_kernel_blocks(
+    BlockType* blocks, size_t begin, size_t end,
+    const normalized_key_comparator<CompareType, KeyFunction>& cmp)
+{
+    using value_type = typename BlockType::value_type;
+    if (sizeof(BlockType) != BlockType::size * sizeof(value_type) ||
+        end - begin > std::numeric_limits<uint32_t>::max())
+        return false;
+
+    sort_kernel_local::normalized_sort_range(
+        blocks[0].begin() + begin, blocks[0].begin() + end, cmp);
+    return true;
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_SORT_KERNEL_HEADER
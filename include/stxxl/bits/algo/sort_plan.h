@@ -0,0 +1,260 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/sort_plan.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_SORT_PLAN_HEADER
+#define STXXL_ALGO_SORT_PLAN_HEADER
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+
+#include <foxxll/common/utils.hpp>
+
+#include <stxxl/bits/algo/sort_base.h>
+#include <stxxl/bits/common/settings.h>
+#include <stxxl/bits/parallel.h>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+/*!
+ * Prediction of the runs, merge passes and I/O volume of an external sort,
+ * computed by plan_sort() or plan_stream_sort() from the same formulas the
+ * sorters use to form and merge their runs, without sorting anything. The
+ * I/O counts assume runs of equal length and input which is not presorted.
+ */
+struct sort_plan
+{
+    //! whether memory suffices to sort at all, see min_memory
+    bool feasible = false;
+    //! whether the input is sorted in internal memory without runs
+    bool in_memory = false;
+    //! blocks of the input
+    uint64_t blocks = 0;
+    //! runs formed
+    uint64_t runs = 0;
+    //! blocks per run
+    uint64_t run_blocks = 0;
+    //! passes merging runs, including the final one
+    size_t merge_levels = 0;
+    //! bytes read from and written to disk by the sort
+    uint64_t bytes_read = 0, bytes_written = 0;
+    //! least memory to sort at all
+    uint64_t min_memory = 0;
+    //! least memory to merge the runs in a single pass
+    uint64_t single_pass_memory = 0;
+};
+
+//! Print a sort_plan, one field per line.
+inline std::ostream& operator << (std::ostream& os, const sort_plan& p)
+{
+    return os << "feasible:           " << (p.feasible ? "yes" : "no") << '\n'
+              << "in memory:          " << (p.in_memory ? "yes" : "no") << '\n'
+              << "blocks:             " << p.blocks << '\n'
+              << "runs:               " << p.runs << '\n'
+              << "blocks per run:     " << p.run_blocks << '\n'
+              << "merge levels:       " << p.merge_levels << '\n'
+              << "bytes read:         " << p.bytes_read << '\n'
+              << "bytes written:      " << p.bytes_written << '\n'
+              << "min memory:         " << p.min_memory << '\n'
+              << "single pass memory: " << p.single_pass_memory << '\n';
+}
+
+namespace sort_plan_local {
+
+//! Number of merge phases of stxxl::sort over nruns runs with m blocks of
+//! memory, see sort_local::sort_blocks().
+inline size_t merge_levels(uint64_t nruns, size_t m)
+{
+    if (nruns <= 1)
+        return 0;
+    const uint64_t merge_factor = optimal_merge_factor(nruns, m);
+    size_t levels = 0;
+    for ( ; nruns > 1; ++levels)
+        nruns = foxxll::div_ceil(nruns, merge_factor);
+    return levels;
+}
+
+//! Runs of stxxl::sort with m blocks of memory and threads run formation
+//! threads, sets run_blocks.
+inline uint64_t runs(uint64_t blocks, size_t m, size_t threads, uint64_t& run_blocks)
+{
+    const size_t m2 = m / 2;
+    run_blocks = m2 / std::max<size_t>(1, std::min(threads, m2));
+    return foxxll::div_ceil(blocks, run_blocks);
+}
+
+//! Output blocks of the runs merger, two with merging ahead.
+inline size_t merger_out_blocks()
+{
+    return SETTINGS::async_pipelining ? 2 : 1;
+}
+
+//! Runs of stream::runs_creator with memory bytes, sets run_blocks.
+inline uint64_t stream_runs(uint64_t records, size_t per_block, uint64_t memory,
+                            size_t block_size, uint64_t& run_blocks)
+{
+    run_blocks = memory / block_size / sort_memory_usage_factor() / 2;
+    return foxxll::div_ceil(records, run_blocks * per_block);
+}
+
+} // namespace sort_plan_local
+
+/*!
+ * Plan stxxl::sort() of records of record_size bytes with memory bytes of
+ * internal memory in blocks of block_size bytes. The runs are formed by as
+ * many threads as sort_run_formation_threads() and merged with
+ * optimal_merge_factor(), memory is divided by sort_memory_usage_factor(),
+ * all as in the current settings. The sort reads and writes all blocks once
+ * to form the runs and once per merge level. The disks do not change
+ * stxxl::sort's passes but are part of the interface of plan_stream_sort().
+ */
+inline sort_plan plan_sort(uint64_t records, size_t record_size, uint64_t memory,
+                           size_t /* disks */, size_t block_size)
+{
+    sort_plan p;
+    const size_t per_block = block_size / record_size;
+    const size_t factor = sort_memory_usage_factor();
+    const size_t threads = sort_run_formation_threads();
+
+    p.blocks = foxxll::div_ceil(records, per_block);
+    p.min_memory = 2 * block_size * factor;
+
+    // the least m whose runs are merged in one pass, m >= runs(m)
+    {
+        uint64_t run_blocks, lo = 2, hi = std::max<uint64_t>(2, 2 * threads * p.blocks);
+        while (lo < hi)
+        {
+            const uint64_t m = lo + (hi - lo) / 2;
+            if (sort_plan_local::runs(p.blocks, m, threads, run_blocks) <= m)
+                hi = m;
+            else
+                lo = m + 1;
+        }
+        p.single_pass_memory = lo * block_size * factor;
+    }
+
+    if (records * record_size * factor < memory)
+    {
+        p.feasible = p.in_memory = true;
+        p.runs = 1, p.run_blocks = p.blocks;
+        p.bytes_read = p.bytes_written = p.blocks * block_size;
+        return p;
+    }
+    if (memory < p.min_memory)
+        return p;
+
+    const size_t m = static_cast<size_t>(memory / factor / block_size);
+
+    p.feasible = true;
+    p.runs = sort_plan_local::runs(p.blocks, m, threads, p.run_blocks);
+    p.merge_levels = sort_plan_local::merge_levels(p.runs, m);
+    p.bytes_read = p.bytes_written = (1 + p.merge_levels) * p.blocks * block_size;
+    return p;
+}
+
+/*!
+ * Plan stream::sort or sorter of records of record_size bytes in blocks of
+ * block_size bytes, with memory bytes for both the runs creator and the
+ * runs merger and the prefetch and write buffers of disks disks. The runs
+ * are written once; a merger which cannot hold a block of each run besides
+ * its buffers merges runs recursively as basic_runs_merger does, each level
+ * reading and rewriting the merged runs, before the final merge reads all
+ * runs and hands the records on. Inputs of a single block, or of the run
+ * buffers with SETTINGS::in_memory_sort, stay in internal memory.
+ */
+inline sort_plan plan_stream_sort(uint64_t records, size_t record_size, uint64_t memory,
+                                  size_t disks, size_t block_size)
+{
+    sort_plan p;
+    const size_t per_block = block_size / record_size;
+    const size_t out_blocks = sort_plan_local::merger_out_blocks();
+    const uint64_t prefetch_buffers = 2 * disks;
+
+    p.blocks = foxxll::div_ceil(records, per_block);
+    p.min_memory = std::max<uint64_t>(
+        2 * block_size * sort_memory_usage_factor(),
+        (4 * disks + out_blocks + 2) * block_size);
+
+    // the least memory whose runs fit into the merger with its buffers
+    {
+        uint64_t run_blocks, lo = p.min_memory / block_size,
+                             hi = std::max(lo, 2 * sort_memory_usage_factor() * p.blocks + prefetch_buffers + out_blocks);
+        while (lo < hi)
+        {
+            const uint64_t k = lo + (hi - lo) / 2;
+            if (sort_plan_local::stream_runs(records, per_block, k * block_size, block_size, run_blocks)
+                + prefetch_buffers + out_blocks <= k)
+                hi = k;
+            else
+                lo = k + 1;
+        }
+        p.single_pass_memory = lo * block_size;
+    }
+
+    if (memory < p.min_memory)
+        return p;
+    p.feasible = true;
+
+    p.runs = sort_plan_local::stream_runs(records, per_block, memory, block_size, p.run_blocks);
+    if (records <= per_block ||
+        (SETTINGS::in_memory_sort && records <= 2 * p.run_blocks * per_block))
+    {
+        p.in_memory = true;
+        p.runs = 0;
+        return p;
+    }
+
+    const uint64_t total = p.blocks * block_size;
+    p.bytes_written = total;
+
+    const uint64_t input_buffers = memory / block_size - out_blocks;
+    uint64_t nruns = p.runs;
+    if (nruns + prefetch_buffers > input_buffers)
+    {
+        const uint64_t final_arity = input_buffers > prefetch_buffers
+                                     ? input_buffers - prefetch_buffers : 1;
+        const uint64_t max_arity = memory / block_size - 2 * prefetch_buffers - out_blocks;
+
+        while (nruns > final_arity)
+        {
+            const uint64_t reduction = nruns - final_arity;
+            const uint64_t partial_groups = foxxll::div_ceil(reduction, max_arity - 1);
+            uint64_t merged;
+            if (reduction + partial_groups <= nruns)
+            {
+                // the last level merges only as many (short) runs as needed
+                merged = (reduction + partial_groups) * p.run_blocks * block_size;
+                nruns = final_arity;
+            }
+            else
+            {
+                merged = total;
+                nruns = foxxll::div_ceil(nruns, optimal_merge_factor(nruns, max_arity));
+            }
+            p.bytes_read += std::min(merged, total);
+            p.bytes_written += std::min(merged, total);
+            ++p.merge_levels;
+        }
+    }
+
+    // the final merge
+    p.bytes_read += total;
+    ++p.merge_levels;
+    return p;
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_SORT_PLAN_HEADER
@@ -0,0 +1,403 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/spatial.h
+ *
+ *  Z-order (Morton) and Hilbert keys of points for sorting by space-filling
+ *  curves, and a sort-based spatial join of rectangles and points.
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_SPATIAL_HEADER
+#define STXXL_ALGO_SPATIAL_HEADER
+
+#if defined(__BMI2__)
+    #include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+#include <tlx/logger/core.hpp>
+
+#include <stxxl/bits/containers/sorter.h>
+#include <stxxl/bits/stream/spatial_join.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+//! \name Space-Filling Curves
+//! \{
+
+/*!
+ * Z-order (Morton) key of the point (x, y): the bits of x and y interleaved,
+ * with x in the even bits. Uses the BMI2 instruction pdep if available.
+ */
+inline uint64_t morton_encode(uint32_t x, uint32_t y)
+{
+#if defined(__BMI2__)
+    return _pdep_u64(x, 0x5555555555555555ull) | _pdep_u64(y, 0xAAAAAAAAAAAAAAAAull);
+#else
+    auto spread = [](uint64_t v) {
+                      v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+                      v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+                      v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+                      v = (v | (v << 2)) & 0x3333333333333333ull;
+                      v = (v | (v << 1)) & 0x5555555555555555ull;
+                      return v;
+                  };
+    return spread(x) | (spread(y) << 1);
+#endif
+}
+
+//! Point (x, y) of the Z-order (Morton) key. Uses the BMI2 instruction pext
+//! if available.
+inline void morton_decode(uint64_t key, uint32_t& x, uint32_t& y)
+{
+#if defined(__BMI2__)
+    x = static_cast<uint32_t>(_pext_u64(key, 0x5555555555555555ull));
+    y = static_cast<uint32_t>(_pext_u64(key, 0xAAAAAAAAAAAAAAAAull));
+#else
+    auto compact = [](uint64_t v) {
+                       v &= 0x5555555555555555ull;
+                       v = (v | (v >> 1)) & 0x3333333333333333ull;
+                       v = (v | (v >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+                       v = (v | (v >> 4)) & 0x00FF00FF00FF00FFull;
+                       v = (v | (v >> 8)) & 0x0000FFFF0000FFFFull;
+                       v = (v | (v >> 16)) & 0x00000000FFFFFFFFull;
+                       return static_cast<uint32_t>(v);
+                   };
+    x = compact(key);
+    y = compact(key >> 1);
+#endif
+}
+
+namespace spatial_local {
+
+static constexpr bool debug = false;
+
+/*!
+ * Tables converting Morton to Hilbert keys and back, four levels of the
+ * curve (one byte of the key) per lookup. The state of the conversion is
+ * the orientation of the current quadrant: bit 0 whether x and y are
+ * swapped, bit 1 whether they are complemented.
+ */
+class hilbert_tables
+{
+public:
+    //! entry [state][morton byte]: hilbert byte, and the next state in the
+    //! bits 8 and 9
+    uint16_t to_hilbert[4][256];
+    //! entry [state][hilbert byte]: morton byte, and the next state in the
+    //! bits 8 and 9
+    uint16_t to_morton[4][256];
+
+    hilbert_tables()
+    {
+        for (unsigned state = 0; state < 4; ++state)
+        {
+            for (unsigned byte = 0; byte < 256; ++byte)
+            {
+                unsigned s = state, hilbert = 0, morton = 0, t = state;
+                for (int level = 3; level >= 0; --level)
+                {
+                    // Morton to Hilbert
+                    unsigned x = (byte >> (2 * level)) & 1, y = (byte >> (2 * level + 1)) & 1;
+                    if (s & 1) std::swap(x, y);
+                    if (s & 2) x ^= 1, y ^= 1;
+                    hilbert = (hilbert << 2) | ((3 * x) ^ y);
+                    s ^= next_state(x, y);
+
+                    // Hilbert to Morton
+                    const unsigned digit = (byte >> (2 * level)) & 3;
+                    unsigned u = digit >> 1, v = (digit >> 1) ^ (digit & 1);
+                    const unsigned change = next_state(u, v);
+                    if (t & 2) u ^= 1, v ^= 1;
+                    if (t & 1) std::swap(u, v);
+                    morton = (morton << 2) | (v << 1) | u;
+                    t ^= change;
+                }
+                to_hilbert[state][byte] = static_cast<uint16_t>(hilbert | (s << 8));
+                to_morton[state][byte] = static_cast<uint16_t>(morton | (t << 8));
+            }
+        }
+    }
+
+    static const hilbert_tables& get()
+    {
+        static const hilbert_tables tables;
+        return tables;
+    }
+
+private:
+    //! orientation change entering the quadrant with the relative bits x, y
+    static unsigned next_state(unsigned x, unsigned y)
+    {
+        return (y == 0) ? (1 | (x << 1)) : 0;
+    }
+};
+
+} // namespace spatial_local
+
+/*!
+ * Hilbert key of the point (x, y) on the curve through the 2^32 x 2^32 grid
+ * starting at (0, 0) and ending at (2^32 - 1, 0). Consecutive keys are
+ * neighboring points. Computed from the Morton key, four levels of the
+ * curve per table lookup.
+ */
+inline uint64_t hilbert_encode(uint32_t x, uint32_t y)
+{
+    const spatial_local::hilbert_tables& tables = spatial_local::hilbert_tables::get();
+    const uint64_t morton = morton_encode(x, y);
+    uint64_t key = 0;
+    unsigned state = 0;
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+        const uint16_t entry = tables.to_hilbert[state][(morton >> shift) & 0xFF];
+        key = (key << 8) | (entry & 0xFF);
+        state = entry >> 8;
+    }
+    return key;
+}
+
+//! Point (x, y) of the Hilbert key.
+inline void hilbert_decode(uint64_t key, uint32_t& x, uint32_t& y)
+{
+    const spatial_local::hilbert_tables& tables = spatial_local::hilbert_tables::get();
+    uint64_t morton = 0;
+    unsigned state = 0;
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+        const uint16_t entry = tables.to_morton[state][(key >> shift) & 0xFF];
+        morton = (morton << 8) | (entry & 0xFF);
+        state = entry >> 8;
+    }
+    morton_decode(morton, x, y);
+}
+
+//! \}
+
+//! \name Spatial Types
+//! \{
+
+//! A point with an identifier.
+struct spatial_point
+{
+    uint32_t x, y;
+    uint64_t id;
+
+    friend std::ostream& operator << (std::ostream& os, const spatial_point& p)
+    {
+        return os << "(" << p.x << "," << p.y << ")#" << p.id;
+    }
+};
+
+//! A closed axis-parallel rectangle [x_min, x_max] x [y_min, y_max] with an
+//! identifier.
+struct spatial_rectangle
+{
+    uint32_t x_min, y_min, x_max, y_max;
+    uint64_t id;
+
+    friend std::ostream& operator << (std::ostream& os, const spatial_rectangle& r)
+    {
+        return os << "[" << r.x_min << "," << r.x_max << "]x["
+                  << r.y_min << "," << r.y_max << "]#" << r.id;
+    }
+};
+
+/*!
+ * Key extractor of the Z-order (Morton) keys of points with uint32_t
+ * members x and y, for stxxl::ksort and for radix sorting the runs of
+ * stream::runs_creator. min_value() and max_value() are the points with the
+ * smallest and largest keys.
+ */
+template <typename Point = spatial_point>
+struct morton_key
+{
+    using key_type = uint64_t;
+
+    key_type operator () (const Point& p) const
+    {
+        return morton_encode(p.x, p.y);
+    }
+    Point min_value() const
+    {
+        Point p = Point();
+        p.x = p.y = 0;
+        return p;
+    }
+    Point max_value() const
+    {
+        Point p = Point();
+        p.x = p.y = std::numeric_limits<uint32_t>::max();
+        return p;
+    }
+};
+
+//! Key extractor of the Hilbert keys of points with uint32_t members x and
+//! y, see morton_key.
+template <typename Point = spatial_point>
+struct hilbert_key
+{
+    using key_type = uint64_t;
+
+    key_type operator () (const Point& p) const
+    {
+        return hilbert_encode(p.x, p.y);
+    }
+    Point min_value() const
+    {
+        Point p = Point();
+        hilbert_decode(0, p.x, p.y);
+        return p;
+    }
+    Point max_value() const
+    {
+        Point p = Point();
+        hilbert_decode(std::numeric_limits<uint64_t>::max(), p.x, p.y);
+        return p;
+    }
+};
+
+//! Comparator ordering by the keys of a key extractor like morton_key or
+//! hilbert_key, with its min_value() and max_value(), for stxxl::sort,
+//! stxxl::sorter and stream::sort.
+template <typename KeyExtractor>
+struct spatial_key_less : public KeyExtractor
+{
+    template <typename Point>
+    bool operator () (const Point& a, const Point& b) const
+    {
+        return KeyExtractor::operator () (a) < KeyExtractor::operator () (b);
+    }
+};
+
+//! Comparator ordering rectangles by y_min, for spatial_join().
+template <typename Rectangle = spatial_rectangle>
+struct rectangle_y_less
+{
+    bool operator () (const Rectangle& a, const Rectangle& b) const
+    {
+        return a.y_min < b.y_min;
+    }
+    Rectangle min_value() const
+    {
+        Rectangle r = Rectangle();
+        r.y_min = std::numeric_limits<decltype(r.y_min)>::min();
+        return r;
+    }
+    Rectangle max_value() const
+    {
+        Rectangle r = Rectangle();
+        r.y_min = std::numeric_limits<decltype(r.y_min)>::max();
+        return r;
+    }
+};
+
+//! Comparator ordering points by y, then by x, for spatial_join().
+template <typename Point = spatial_point>
+struct point_y_less
+{
+    bool operator () (const Point& a, const Point& b) const
+    {
+        return a.y < b.y || (a.y == b.y && a.x < b.x);
+    }
+    Point min_value() const
+    {
+        Point p = Point();
+        p.x = std::numeric_limits<decltype(p.x)>::min();
+        p.y = std::numeric_limits<decltype(p.y)>::min();
+        return p;
+    }
+    Point max_value() const
+    {
+        Point p = Point();
+        p.x = std::numeric_limits<decltype(p.x)>::max();
+        p.y = std::numeric_limits<decltype(p.y)>::max();
+        return p;
+    }
+};
+
+//! \}
+
+//! \name Spatial Join
+//! \{
+
+/*!
+ * Join the stream of rectangles with the stream of points: calls
+ * function(r, p) for each point p contained in the closed rectangle r.
+ *
+ * Both inputs are sorted from bottom to top with a stxxl::sorter of M / 2
+ * bytes each, and then joined by one stream::plane_sweep_join over the
+ * bounding box of the rectangles. Hence the join costs the I/Os of two
+ * sorts if the rectangles intersecting any horizontal line fit into
+ * internal memory, in addition to M.
+ *
+ * \param rectangles stream of rectangles like spatial_rectangle
+ * \param points stream of points like spatial_point
+ * \param function called with the rectangle and the point of each pair
+ * \param M internal memory of the sorts in bytes
+ * \param num_strips number of strips of the sweep line
+ * \return number of pairs
+ */
+template <typename RectangleInput, typename PointInput, typename Function>
+external_size_type spatial_join(RectangleInput& rectangles, PointInput& points,
+                                Function function, size_t M,
+                                size_t num_strips = 1024)
+{
+    using rectangle_type = typename RectangleInput::value_type;
+    using point_type = typename PointInput::value_type;
+    using rectangle_sorter_type = sorter<rectangle_type, rectangle_y_less<rectangle_type> >;
+    using point_sorter_type = sorter<point_type, point_y_less<point_type> >;
+
+    // sort the rectangles and find the range of their x coordinates
+    rectangle_sorter_type sorted_rectangles(rectangle_y_less<rectangle_type>(), M / 2);
+    uint64_t x_begin = std::numeric_limits<uint64_t>::max(), x_end = 0;
+    external_size_type num_rectangles = 0, num_points = 0;
+    for ( ; !rectangles.empty(); ++rectangles, ++num_rectangles)
+    {
+        const rectangle_type& r = *rectangles;
+        x_begin = std::min<uint64_t>(x_begin, r.x_min);
+        x_end = std::max<uint64_t>(x_end, r.x_max);
+        sorted_rectangles.push(r);
+    }
+    sorted_rectangles.sort();
+
+    point_sorter_type sorted_points(point_y_less<point_type>(), M / 2);
+    for ( ; !points.empty(); ++points, ++num_points)
+        sorted_points.push(*points);
+    sorted_points.sort();
+
+    if (x_end < x_begin)
+        return 0;
+
+    stream::plane_sweep_join<rectangle_sorter_type, point_sorter_type> join(
+        sorted_rectangles, sorted_points, num_strips, x_begin, x_end);
+
+    external_size_type pairs = 0;
+    for ( ; !join.empty(); ++join, ++pairs)
+        function(join->first, join->second);
+
+    TLX_LOGC(spatial_local::debug)
+        << "spatial_join(): " << num_rectangles << " rectangles and "
+        << num_points << " points joined into " << pairs << " pairs";
+
+    return pairs;
+}
+
+//! \}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_SPATIAL_HEADER
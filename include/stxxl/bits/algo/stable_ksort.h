@@ -14,12 +14,13 @@
 #ifndef STXXL_ALGO_STABLE_KSORT_HEADER
 #define STXXL_ALGO_STABLE_KSORT_HEADER
 
-// it is a first try: distribution sort without sampling
-// I rework the stable_ksort when I would have a time
 #include <algorithm>
+#include <future>
+#include <limits>
+#include <random>
 #include <utility>
+#include <vector>
 
-#include <tlx/die/core.hpp>
 #include <tlx/logger/core.hpp>
 #include <tlx/math/integer_log2.hpp>
 #include <tlx/simple_vector.hpp>
@@ -31,11 +32,15 @@
 
 #include <stxxl/bits/algo/intksort.h>
 #include <stxxl/bits/algo/sort_base.h>
+#include <stxxl/bits/common/seed.h>
 
 namespace stxxl {
 
 constexpr bool debug_stable_ksort = false;
 
+//! number of sample keys drawn per bucket to select the splitters
+constexpr size_t stable_ksort_oversampling = 16;
+
 //! \addtogroup stlalgo
 //! \{
 
@@ -70,16 +75,18 @@ struct type_key
     { }
 };
 
+// ties are broken by position, which keeps the sort stable since the
+// references of a bucket point into consecutive memory in input order.
 template <typename Type>
 bool operator < (const type_key<Type>& a, const type_key<Type>& b)
 {
-    return a.key < b.key;
+    return a.key < b.key || (!(b.key < a.key) && a.ptr < b.ptr);
 }
 
 template <typename Type>
 bool operator > (const type_key<Type>& a, const type_key<Type>& b)
 {
-    return a.key > b.key;
+    return b < a;
 }
 
 template <typename BIDType, typename AllocStrategy>
@@ -133,30 +140,159 @@ public:
     }
 };
 
-template <typename ExtIterator, typename KeyExtract>
+/*!
+ * Maps keys to buckets using splitters drawn from a sorted sample of the
+ * input. Every splitter value gets an equality bucket of its own, such that
+ * heavily repeated keys do not blow up the bucket of their neighbours: keys
+ * smaller than the smallest splitter go to bucket 0, keys equal to splitter j
+ * to bucket 2j+1, and keys between splitter j and j+1 to bucket 2j+2.
+ */
+template <typename KeyType>
+class splitter_classifier
+{
+public:
+    using key_type = KeyType;
+
+protected:
+    //! unique splitters in ascending order
+    std::vector<key_type> splitters_;
+
+    //! number of sample keys falling into each bucket
+    std::vector<size_t> sample_counts_;
+
+    //! total number of sample keys
+    size_t sample_size_;
+
+public:
+    //! select at most (nmaxbuckets - 1) / 2 splitters from the sample
+    splitter_classifier(std::vector<key_type>& sample, size_t nmaxbuckets)
+        : sample_size_(sample.size())
+    {
+        std::sort(sample.begin(), sample.end());
+
+        const size_t nsplitters = std::min((nmaxbuckets - 1) / 2, sample.size());
+        for (size_t j = 1; j <= nsplitters; ++j)
+        {
+            const key_type& s = sample[j * sample.size() / (nsplitters + 1)];
+            if (splitters_.empty() || splitters_.back() < s)
+                splitters_.push_back(s);
+        }
+
+        sample_counts_.resize(num_buckets(), 0);
+        for (const key_type& key : sample)
+            sample_counts_[operator () (key)]++;
+    }
+
+    //! number of buckets the keys are distributed to
+    size_t num_buckets() const
+    {
+        return 2 * splitters_.size() + 1;
+    }
+
+    //! bucket index of a key
+    size_t operator () (const key_type& key) const
+    {
+        const size_t j = static_cast<size_t>(
+            std::lower_bound(splitters_.begin(), splitters_.end(), key)
+            - splitters_.begin());
+        return (j < splitters_.size() && !(key < splitters_[j])) ? 2 * j + 1 : 2 * j;
+    }
+
+    //! expected number of records in a bucket, extrapolated from the sample
+    uint64_t estimated_size(size_t bucket, uint64_t n) const
+    {
+        if (sample_size_ == 0)
+            return n;
+        return n / sample_size_ * sample_counts_[bucket]
+               + n % sample_size_ * sample_counts_[bucket] / sample_size_;
+    }
+};
+
+/*!
+ * Draw a random sample of nsamples keys from the n records starting at
+ * element first_offset of the blocks in bids. The sample is taken from at
+ * most nsample_blocks blocks, one chosen at random from each of equally sized
+ * strata, which are read in batches of at most nbuffers blocks.
+ */
+template <typename BlockType, typename BidIterator, typename KeyExtract>
+std::vector<typename BlockType::value_type::key_type>
+sample_keys(BidIterator bids, const size_t first_offset, const uint64_t n,
+            const size_t nsample_blocks, const size_t nbuffers,
+            const size_t nsamples, KeyExtract key_extract)
+{
+    using block_type = BlockType;
+    using key_type = typename block_type::value_type::key_type;
+    using request_ptr = foxxll::request_ptr;
+
+    std::vector<key_type> sample;
+    if (n == 0)
+        return sample;
+
+    const uint64_t end_offset = first_offset + n;
+    const auto nblocks = static_cast<size_t>(foxxll::div_ceil(end_offset, block_type::size));
+    const size_t nstrata = std::max<size_t>(1, std::min(nblocks, nsample_blocks));
+    const size_t samples_per_block = std::max<size_t>(1, foxxll::div_ceil(nsamples, nstrata));
+    const size_t nbatch = std::max<size_t>(1, std::min(nbuffers, nstrata));
+
+    std::mt19937_64 rng(seed_sequence::get_ref().get_next_seed());
+
+    block_type* blocks = new block_type[nbatch];
+    request_ptr* reqs = new request_ptr[nbatch];
+    size_t* block_ids = new size_t[nbatch];
+
+    sample.reserve(nstrata * samples_per_block);
+
+    for (size_t stratum = 0; stratum < nstrata; stratum += nbatch)
+    {
+        const size_t batch = std::min(nbatch, nstrata - stratum);
+        for (size_t j = 0; j < batch; ++j)
+        {
+            const size_t lo = (stratum + j) * nblocks / nstrata;
+            const size_t hi = (stratum + j + 1) * nblocks / nstrata;
+            block_ids[j] = std::uniform_int_distribution<size_t>(lo, hi - 1)(rng);
+            reqs[j] = blocks[j].read(*(bids + block_ids[j]));
+        }
+        wait_all(reqs, batch);
+
+        for (size_t j = 0; j < batch; ++j)
+        {
+            // restrict to the records of the block which are part of the range
+            const uint64_t block_begin = uint64_t(block_ids[j]) * block_type::size;
+            const auto lo = static_cast<size_t>(std::max<uint64_t>(first_offset, block_begin) - block_begin);
+            const auto hi = static_cast<size_t>(
+                std::min<uint64_t>(end_offset, block_begin + block_type::size) - block_begin);
+            std::uniform_int_distribution<size_t> pos(lo, hi - 1);
+            for (size_t i = 0; i < samples_per_block; ++i)
+                sample.push_back(key_extract(blocks[j][pos(rng)]));
+        }
+    }
+
+    delete[] block_ids;
+    delete[] reqs;
+    delete[] blocks;
+
+    return sample;
+}
+
+template <typename BlockType, typename BucketBids, typename InputStream,
+          typename Classifier, typename KeyExtract>
 void distribute(
-    bid_sequence<typename ExtIterator::vector_type::block_type::bid_type,
-                 typename ExtIterator::vector_type::alloc_strategy_type>* bucket_bids,
+    BucketBids* bucket_bids,
     uint64_t* bucket_sizes,
-    const size_t nbuckets,
-    const unsigned lognbuckets,
-    ExtIterator first,
-    ExtIterator last,
-    const size_t nread_buffers,
+    typename Classifier::key_type* bucket_min,
+    typename Classifier::key_type* bucket_max,
+    const Classifier& classifier,
+    InputStream& in,
+    const uint64_t n,
     const size_t nwrite_buffers,
     KeyExtract key_extract)
 {
-    using key_type = decltype(key_extract(*first));
-    using block_type = typename ExtIterator::block_type;
-    using bids_container_iterator = typename ExtIterator::bids_container_iterator;
-
-    using buf_istream_type = foxxll::buf_istream<block_type, bids_container_iterator>;
+    using key_type = typename Classifier::key_type;
+    using block_type = BlockType;
 
+    const size_t nbuckets = classifier.num_buckets();
     size_t i = 0;
 
-    buf_istream_type in(first.bid(), last.bid() + ((first.block_offset()) ? 1 : 0),
-                        nread_buffers);
-
     foxxll::buffered_writer<block_type> out(
         nbuckets + nwrite_buffers,
         nwrite_buffers);
@@ -168,24 +304,20 @@ void distribute(
     std::fill(bucket_sizes, bucket_sizes + nbuckets, 0);
     std::fill(bucket_iblock, bucket_iblock + nbuckets, 0);
     std::fill(bucket_block_offsets, bucket_block_offsets + nbuckets, 0);
+    std::fill(bucket_min, bucket_min + nbuckets, std::numeric_limits<key_type>::max());
+    std::fill(bucket_max, bucket_max + nbuckets, std::numeric_limits<key_type>::lowest());
 
     for (i = 0; i < nbuckets; i++)
         bucket_blocks[i] = out.get_free_block();
 
-    ExtIterator cur = first - first.block_offset();
-
-    // skip part of the block before first untouched
-    for ( ; cur != first; cur++)
-        ++in;
-
-    const size_t shift = sizeof(key_type) * 8 - lognbuckets;
-    // search in the the range [_begin,_end)
     TLX_LOGC(debug_stable_ksort)
-        << "Shift by: " << shift << " bits, lognbuckets: " << lognbuckets;
-    for ( ; cur != last; cur++)
+        << "Distributing " << n << " records to " << nbuckets << " buckets";
+    for (uint64_t r = 0; r < n; ++r)
     {
-        key_type cur_key = key_extract(in.current());
-        size_t ibucket = cur_key >> shift;
+        const key_type cur_key = key_extract(in.current());
+        const size_t ibucket = classifier(cur_key);
+        bucket_min[ibucket] = std::min(bucket_min[ibucket], cur_key);
+        bucket_max[ibucket] = std::max(bucket_max[ibucket], cur_key);
 
         size_t block_offset = bucket_block_offsets[ibucket];
         in >> (bucket_blocks[ibucket]->elem[block_offset++]);
@@ -207,7 +339,7 @@ void distribute(
                           bucket_block_offsets[i];
         TLX_LOGC(debug_stable_ksort)
             << "Bucket " << i << " has size " << bucket_sizes[i]
-            << ", estimated size: " << ((last - first) / int64_t(nbuckets));
+            << ", estimated size: " << classifier.estimated_size(i, n);
     }
 
     delete[] bucket_blocks;
@@ -215,19 +347,362 @@ void distribute(
     delete[] bucket_iblock;
 }
 
+//! Allocate the blocks of each bucket according to the sample's estimate.
+template <typename BlockType, typename BucketBids, typename Classifier>
+BucketBids* create_bucket_bids(const Classifier& classifier, const uint64_t n)
+{
+    const size_t nbuckets = classifier.num_buckets();
+    BucketBids* bucket_bids = new BucketBids[nbuckets];
+    for (size_t i = 0; i < nbuckets; ++i)
+    {
+        bucket_bids[i].init(static_cast<size_t>(
+                                foxxll::div_ceil(classifier.estimated_size(i, n), BlockType::size)) + 1);
+    }
+    return bucket_bids;
+}
+
+template <typename BlockType, typename AllocStrategy, typename OutStream,
+          typename BidIterator, typename KeyExtract>
+void sort_bucket_recursive(
+    OutStream& out, BidIterator bids, const uint64_t n,
+    const size_t m, const size_t ndisks,
+    KeyExtract key_extract, const unsigned depth);
+
+/*!
+ * Sort the buckets one after another and append them to the output stream.
+ * The buckets are kept in a ring of two or three in-memory buffers: while a
+ * bucket is sorted, the next one is read, and with three buffers the
+ * previous one is written to the output stream by a background thread. The
+ * third buffer is only used if it fits into the m blocks of memory. The
+ * subbuckets of a bucket are sorted in parallel. Buckets exceeding half of
+ * the memory are either copied through if they only contain one key, or are
+ * distributed recursively.
+ */
+template <typename BlockType, typename AllocStrategy, typename OutStream,
+          typename BucketBids, typename KeyType, typename KeyExtract>
+void sort_buckets(
+    OutStream& out,
+    BucketBids* bucket_bids,
+    const uint64_t* bucket_sizes,
+    const KeyType* bucket_min,
+    const KeyType* bucket_max,
+    const size_t nbuckets,
+    const size_t m,
+    const size_t ndisks,
+    KeyExtract key_extract,
+    const unsigned depth)
+{
+    using block_type = BlockType;
+    using value_type = typename block_type::value_type;
+    using key_type = KeyType;
+    using type_key_ = type_key<value_type>;
+    using request_ptr = foxxll::request_ptr;
+
+    size_t i = 0;
+
+    // largest bucket which is sorted in memory, in number of records
+    const uint64_t max_bucket_size_rec = uint64_t(m / 2) * block_type::size;
+    uint64_t max_bucket_size_act = 0;
+    for (i = 0; i < nbuckets; i++)
+    {
+        if (bucket_sizes[i] <= max_bucket_size_rec)
+            max_bucket_size_act = std::max(bucket_sizes[i], max_bucket_size_act);
+    }
+    const auto max_bucket_size_bl = static_cast<size_t>(foxxll::div_ceil(max_bucket_size_act, block_type::size));
+
+    // a third buffer holds the bucket being written while the next is sorted
+    const size_t nsets = (3 * max_bucket_size_bl <= m) ? 3 : 2;
+
+    const unsigned log_k1 = std::max<unsigned>(
+        tlx::integer_log2_ceil(max_bucket_size_act * sizeof(type_key_) / STXXL_L2_SIZE), 1);
+    size_t* bucket1 = new size_t[size_t(1) << log_k1];
+
+    TLX_LOGC(debug_stable_ksort)
+        << "Sorting " << nbuckets << " buckets, max in-memory bucket size:"
+        << max_bucket_size_act << " block size:" << block_type::size
+        << " log_k1:" << log_k1 << " buffers:" << nsets << " depth:" << depth;
+
+    // buffers of a bucket: its blocks, their read requests, and the sorted
+    // references to its records
+    struct buffer_set
+    {
+        block_type* blocks = nullptr;
+        request_ptr* reqs = nullptr;
+        type_key_* refs = nullptr;
+    };
+    buffer_set sets[3];
+    // references classified by the first key digit, shared by all buckets
+    type_key_* refs_tmp = nullptr;
+
+    // writes the sorted bucket in the background
+    std::future<void> writer;
+
+    auto allocate_buffers =
+        [&]() {
+            for (size_t s = 0; s < nsets; s++)
+            {
+                sets[s].blocks = new block_type[max_bucket_size_bl];
+                sets[s].reqs = new request_ptr[max_bucket_size_bl];
+                sets[s].refs = new type_key_[static_cast<size_t>(max_bucket_size_act)];
+            }
+            refs_tmp = new type_key_[static_cast<size_t>(max_bucket_size_act)];
+        };
+    auto free_buffers =
+        [&]() {
+            for (size_t s = 0; s < nsets; s++)
+            {
+                delete[] sets[s].refs;
+                delete[] sets[s].blocks;
+                delete[] sets[s].reqs;
+            }
+            delete[] refs_tmp;
+        };
+    auto bucket_fits =
+        [&](size_t b) {
+            return b < nbuckets && bucket_sizes[b] > 0 &&
+                   bucket_sizes[b] <= max_bucket_size_rec;
+        };
+    auto bucket_blocks =
+        [&](size_t b) {
+            return static_cast<size_t>(foxxll::div_ceil(bucket_sizes[b], block_type::size));
+        };
+    // read bucket b into its buffer set, if it is sorted in memory
+    auto post_read =
+        [&](size_t b) {
+            if (!bucket_fits(b))
+                return;
+            buffer_set& set = sets[b % nsets];
+            for (size_t j = 0; j < bucket_blocks(b); j++)
+                set.reqs[j] = set.blocks[j].read(bucket_bids[b][j]);
+        };
+    // append the sorted records of bucket b to the output stream
+    auto write_bucket =
+        [&out, bucket_sizes](const type_key_* refs, size_t b) {
+            const type_key_* end = refs + bucket_sizes[b];
+            for (const type_key_* p = refs; p < end; p++)
+                out << (*(p->ptr));
+        };
+    // wait until the previous bucket is written, rethrowing its errors
+    auto join_writer =
+        [&]() {
+            if (writer.valid())
+                writer.get();
+        };
+
+    allocate_buffers();
+
+    // submit reading first 2 buckets (Peter's scheme)
+    post_read(0);
+    post_read(1);
+
+    for (size_t k = 0; k < nbuckets; k++)
+    {
+        const size_t nbucket_blocks = bucket_blocks(k);
+        buffer_set& set = sets[k % nsets];
+        bool sorted = false;
+
+        if (bucket_sizes[k] == 0)
+        {
+            // nothing to do
+        }
+        else if (!bucket_fits(k))
+        {
+            // release the in-memory buffers to the oversized bucket, which
+            // writes to the output stream itself
+            join_writer();
+            if (bucket_fits(k + 1))
+                wait_all(sets[(k + 1) % nsets].reqs, bucket_blocks(k + 1));
+            free_buffers();
+
+            if (!(bucket_min[k] < bucket_max[k]))
+            {
+                TLX_LOGC(debug_stable_ksort)
+                    << "Copying bucket " << k << " with single key, size:" << bucket_sizes[k];
+                using buf_istream_type = foxxll::buf_istream<block_type, typename BucketBids::iterator>;
+                buf_istream_type in(bucket_bids[k].begin(), bucket_bids[k].begin() + nbucket_blocks,
+                                    std::min(m, nbucket_blocks));
+                for (uint64_t r = 0; r < bucket_sizes[k]; ++r)
+                {
+                    out << in.current();
+                    ++in;
+                }
+            }
+            else
+            {
+                sort_bucket_recursive<block_type, AllocStrategy>(
+                    out, bucket_bids[k].begin(), bucket_sizes[k],
+                    m, ndisks, key_extract, depth + 1);
+            }
+
+            // restore state: bucket k + 1 is read again
+            allocate_buffers();
+            post_read(k + 1);
+        }
+        else
+        {
+            // radix sort the bucket by the key range it actually contains
+            const key_type offset1 = bucket_min[k];
+            const auto range = static_cast<uint64_t>(bucket_max[k] - bucket_min[k]);
+            const unsigned range_bits = (range == 0) ? 0 : tlx::integer_log2_floor(range) + 1;
+            const unsigned log_k1_k = std::min(
+                range_bits,
+                std::max<unsigned>(
+                    tlx::integer_log2_ceil(bucket_sizes[k] * sizeof(type_key_) / STXXL_L2_SIZE), 1));
+            assert(log_k1_k <= log_k1);
+            const size_t k1 = static_cast<size_t>(1) << log_k1_k;
+            const unsigned shift1 = range_bits - log_k1_k;
+            std::fill(bucket1, bucket1 + k1, 0);
+
+            TLX_LOGC(debug_stable_ksort)
+                << "Classifying bucket " << k << " size:" << bucket_sizes[k]
+                << " blocks:" << nbucket_blocks << " log_k1:" << log_k1_k;
+            // classify first nbucket_blocks-1 blocks, they are full
+            type_key_* ref_ptr = set.refs;
+            for (i = 0; i < nbucket_blocks - 1; i++)
+            {
+                set.reqs[i]->wait();
+                stable_ksort_local::classify_block(
+                    set.blocks[i].begin(), set.blocks[i].end(), ref_ptr,
+                    bucket1, offset1, shift1, key_extract);
+            }
+            // last block might be non-full
+            const auto last_block_size =
+                static_cast<size_t>(bucket_sizes[k] - (nbucket_blocks - 1) * block_type::size);
+            set.reqs[i]->wait();
+
+            stable_ksort_local::classify_block(
+                set.blocks[i].begin(), set.blocks[i].begin() + last_block_size, ref_ptr,
+                bucket1, offset1, shift1, key_extract);
+
+            exclusive_prefix_sum(bucket1, k1);
+            classify(set.refs, set.refs + bucket_sizes[k], refs_tmp, bucket1, k1, offset1, shift1);
+
+            // sort the subbuckets from refs_tmp back into set.refs
+            parallel_for(
+                0, k1, [&](size_t j) {
+                    const size_t begin = (j == 0) ? 0 : bucket1[j - 1];
+                    const size_t size = bucket1[j] - begin;
+
+                    // adaptive bucket size
+                    const unsigned log_k2 = std::min(
+                        shift1, (size > 1) ? static_cast<unsigned>(tlx::integer_log2_floor(size)) - 1 : 0u);
+                    const size_t k2 = size_t(1) << log_k2;
+                    size_t* bucket2 = new size_t[k2];
+                    const unsigned shift2 = shift1 - log_k2;
+
+                    l1sort(refs_tmp + begin, refs_tmp + bucket1[j], set.refs + begin, bucket2, k2,
+                           offset1 + (key_type(1) << key_type(shift1)) * key_type(j),
+                           shift2);
+
+                    delete[] bucket2;
+                });
+            sorted = true;
+        }
+
+        if (nsets == 3)
+        {
+            // the buffers of bucket k + 2 were written from by bucket k - 1
+            join_writer();
+            post_read(k + 2);
+            if (sorted)
+            {
+                writer = std::async(
+                    std::launch::async,
+                    [&write_bucket, refs = set.refs, k]() { write_bucket(refs, k); });
+            }
+        }
+        else
+        {
+            // bucket k + 2 is read into the buffers of bucket k
+            if (sorted)
+                write_bucket(set.refs, k);
+            post_read(k + 2);
+        }
+    }
+
+    join_writer();
+    free_buffers();
+    delete[] bucket1;
+}
+
+/*!
+ * Sort a bucket which does not fit into memory by sampling and distributing
+ * it once more, appending the sorted records to the output stream.
+ */
+template <typename BlockType, typename AllocStrategy, typename OutStream,
+          typename BidIterator, typename KeyExtract>
+void sort_bucket_recursive(
+    OutStream& out, BidIterator bids, const uint64_t n,
+    const size_t m, const size_t ndisks,
+    KeyExtract key_extract, const unsigned depth)
+{
+    using block_type = BlockType;
+    using key_type = typename block_type::value_type::key_type;
+    using bid_type = typename block_type::bid_type;
+    using bucket_bids_type = bid_sequence<bid_type, AllocStrategy>;
+    using buf_istream_type = foxxll::buf_istream<block_type, BidIterator>;
+
+    const size_t write_buffers_multiple = 2;
+    const size_t read_buffers_multiple = 2;
+    const size_t min_num_read_write_buffers = (write_buffers_multiple + read_buffers_multiple) * ndisks;
+    if (m < min_num_read_write_buffers + 3) {
+        throw foxxll::bad_parameter("stxxl::stable_ksort(): INSUFFICIENT MEMORY provided for recursion, please increase parameter 'M'");
+    }
+    const size_t nmaxbuckets = m - min_num_read_write_buffers;
+    const auto nblocks = static_cast<size_t>(foxxll::div_ceil(n, block_type::size));
+
+    TLX_LOGC(debug_stable_ksort)
+        << "Recursing into bucket with " << n << " records, depth " << depth;
+
+    std::vector<key_type> sample = sample_keys<block_type>(
+        bids, 0, n, nmaxbuckets, m, stable_ksort_oversampling * nmaxbuckets, key_extract);
+    splitter_classifier<key_type> classifier(sample, nmaxbuckets);
+    const size_t nbuckets = classifier.num_buckets();
+
+    const size_t nwrite_buffers = (m - nbuckets) * write_buffers_multiple / (read_buffers_multiple + write_buffers_multiple);
+    const size_t nread_buffers = std::min(
+        nblocks, (m - nbuckets) * read_buffers_multiple / (read_buffers_multiple + write_buffers_multiple));
+
+    bucket_bids_type* bucket_bids =
+        create_bucket_bids<block_type, bucket_bids_type>(classifier, n);
+    uint64_t* bucket_sizes = new uint64_t[nbuckets];
+    key_type* bucket_min = new key_type[nbuckets];
+    key_type* bucket_max = new key_type[nbuckets];
+
+    {
+        buf_istream_type in(bids, bids + nblocks, nread_buffers);
+        distribute<block_type>(
+            bucket_bids, bucket_sizes, bucket_min, bucket_max,
+            classifier, in, n, nwrite_buffers, key_extract);
+    }
+
+    sort_buckets<block_type, AllocStrategy>(
+        out, bucket_bids, bucket_sizes, bucket_min, bucket_max, nbuckets,
+        m, ndisks, key_extract, depth);
+
+    delete[] bucket_max;
+    delete[] bucket_min;
+    delete[] bucket_sizes;
+    delete[] bucket_bids;
+}
+
 } // namespace stable_ksort_local
 
 //! Sort records with integer keys
+//!
+//! The bucket boundaries are chosen from a random sample of the keys, such
+//! that the buckets are of about equal size regardless of the key
+//! distribution. Buckets consisting of a single repeated key are passed
+//! through, buckets which still exceed the memory are distributed
+//! recursively.
+//!
 //! \param first object of model of \c ext_random_access_iterator concept
 //! \param last object of model of \c ext_random_access_iterator concept
 //! \param key_extract must provide a key_type operator(const value_type&) to extract the key from value_type
 //! \param M amount of memory for internal use (in bytes)
-//! \remark Not yet fully implemented, it assumes that the keys are uniformly
-//! distributed between [0,std::numeric_limits<key_type>::max().
 template <typename ExtIterator, typename KeyExtract>
 void stable_ksort(ExtIterator first, ExtIterator last, KeyExtract key_extract, size_t M)
 {
-    TLX_LOG1 << "Warning: stable_ksort is not yet fully implemented, it assumes that the keys are uniformly distributed between [0,std::numeric_limits<key_type>::max()]";
     using value_type = typename ExtIterator::vector_type::value_type;
     using key_type = typename value_type::key_type;
     using block_type = typename ExtIterator::block_type;
@@ -235,11 +710,13 @@ void stable_ksort(ExtIterator first, ExtIterator last, KeyExtract key_extract, s
     using bid_type = typename block_type::bid_type;
     using alloc_strategy = typename ExtIterator::vector_type::alloc_strategy_type;
     using bucket_bids_type = stable_ksort_local::bid_sequence<bid_type, alloc_strategy>;
-    using type_key_ = stable_ksort_local::type_key<value_type>;
     using request_ptr = foxxll::request_ptr;
 
     first.flush();     // flush container
 
+    if (first == last)
+        return;
+
     double begin = foxxll::timestamp();
 
     size_t i = 0;
@@ -250,21 +727,27 @@ void stable_ksort(ExtIterator first, ExtIterator last, KeyExtract key_extract, s
     const size_t read_buffers_multiple = 2;
     const size_t ndisks = cfg->disks_number();
     const size_t min_num_read_write_buffers = (write_buffers_multiple + read_buffers_multiple) * ndisks;
-    const size_t nmaxbuckets = m - min_num_read_write_buffers;
-    const unsigned int lognbuckets = tlx::integer_log2_floor(nmaxbuckets);
-    const size_t nbuckets = size_t(1) << lognbuckets;
-    const size_t est_bucket_size = static_cast<size_t>(foxxll::div_ceil((last - first) / nbuckets, block_type::size));      //in blocks
 
-    if (m < min_num_read_write_buffers + 2 || nbuckets < 2) {
+    if (m < min_num_read_write_buffers + 3) {
         TLX_LOG1 << "stxxl::stable_ksort: Not enough memory. Blocks available: " << m
                  << ", required for r/w buffers: " << min_num_read_write_buffers
-                 << ", required for buckets: 2, nbuckets: " << nbuckets;
+                 << ", required for buckets: 3";
         throw foxxll::bad_parameter("stxxl::stable_ksort(): INSUFFICIENT MEMORY provided, please increase parameter 'M'");
     }
+    const size_t nmaxbuckets = m - min_num_read_write_buffers;
+    const auto n = static_cast<uint64_t>(last - first);
+
     TLX_LOGC(debug_stable_ksort)
-        << "Elements to sort: " << (last - first);
+        << "Elements to sort: " << n;
+
+    std::vector<key_type> sample = stable_ksort_local::sample_keys<block_type>(
+        first.bid(), first.block_offset(), n, nmaxbuckets, m,
+        stable_ksort_oversampling * nmaxbuckets, key_extract);
+    stable_ksort_local::splitter_classifier<key_type> classifier(sample, nmaxbuckets);
+    const size_t nbuckets = classifier.num_buckets();
+
     TLX_LOGC(debug_stable_ksort)
-        << "Number of buckets has to be reduced from " << nmaxbuckets << " to " << nbuckets;
+        << "Number of buckets: " << nbuckets << " of at most " << nmaxbuckets;
     const size_t nread_buffers = (m - nbuckets) * read_buffers_multiple / (read_buffers_multiple + write_buffers_multiple);
     const size_t nwrite_buffers = (m - nbuckets) * write_buffers_multiple / (read_buffers_multiple + write_buffers_multiple);
 
@@ -273,24 +756,29 @@ void stable_ksort(ExtIterator first, ExtIterator last, KeyExtract key_extract, s
     TLX_LOGC(debug_stable_ksort)
         << "Write buffers in distribution phase: " << nwrite_buffers;
 
-    bucket_bids_type* bucket_bids = new bucket_bids_type[nbuckets];
-    for (i = 0; i < nbuckets; ++i)
-        bucket_bids[i].init(est_bucket_size);
+    bucket_bids_type* bucket_bids =
+        stable_ksort_local::create_bucket_bids<block_type, bucket_bids_type>(classifier, n);
 
     uint64_t* bucket_sizes = new uint64_t[nbuckets];
+    key_type* bucket_min = new key_type[nbuckets];
+    key_type* bucket_max = new key_type[nbuckets];
 
     foxxll::disk_queues::get_instance()->set_priority_op(foxxll::request_queue::WRITE);
 
-    stable_ksort_local::distribute(
-        bucket_bids,
-        bucket_sizes,
-        nbuckets,
-        lognbuckets,
-        first,
-        last,
-        nread_buffers,
-        nwrite_buffers,
-        key_extract);
+    {
+        using buf_istream_type = foxxll::buf_istream<block_type, bids_container_iterator>;
+
+        buf_istream_type in(first.bid(), last.bid() + ((last.block_offset()) ? 1 : 0),
+                            nread_buffers);
+
+        // skip part of the block before first untouched
+        for (i = 0; i < first.block_offset(); ++i)
+            ++in;
+
+        stable_ksort_local::distribute<block_type>(
+            bucket_bids, bucket_sizes, bucket_min, bucket_max,
+            classifier, in, n, nwrite_buffers, key_extract);
+    }
 
     double dist_end = foxxll::timestamp(), end;
     double io_wait_after_d = foxxll::stats::get_instance()->get_io_wait_time();
@@ -301,28 +789,38 @@ void stable_ksort(ExtIterator first, ExtIterator last, KeyExtract key_extract, s
         size_t max_bucket_size_bl = (m - write_buffers_multiple_bs * ndisks) / 2;       // in number of blocks
         uint64_t max_bucket_size_rec = uint64_t(max_bucket_size_bl) * block_type::size; // in number of records
         uint64_t max_bucket_size_act = 0;                                               // actual max bucket size
+        bool oversized_buckets = false;
         // establish output stream
 
         for (i = 0; i < nbuckets; i++)
         {
-            max_bucket_size_act = std::max(bucket_sizes[i], max_bucket_size_act);
             if (bucket_sizes[i] > max_bucket_size_rec)
             {
-                tlx_die(
-                    "Bucket " << i << " is too large: " << bucket_sizes[i] <<
-                        " records, maximum: " << max_bucket_size_rec << "\n"
-                        "Recursion on buckets is not yet implemented, aborting.");
+                TLX_LOGC(debug_stable_ksort)
+                    << "Bucket " << i << " is too large: " << bucket_sizes[i]
+                    << " records, maximum: " << max_bucket_size_rec;
+                oversized_buckets = true;
             }
+            else
+                max_bucket_size_act = std::max(bucket_sizes[i], max_bucket_size_act);
         }
         // here we can increase write_buffers_multiple_b knowing max(bucket_sizes[i])
-        // ... and decrease max_bucket_size_bl
-        const auto max_bucket_size_act_bl = static_cast<size_t>(foxxll::div_ceil(max_bucket_size_act, block_type::size));
-        TLX_LOGC(debug_stable_ksort)
-            << "Reducing required number of required blocks per bucket from "
-            << max_bucket_size_bl << " to " << max_bucket_size_act_bl;
-        max_bucket_size_rec = max_bucket_size_act;
-        max_bucket_size_bl = max_bucket_size_act_bl;
-        const size_t nwrite_buffers_bs = m - 2 * max_bucket_size_bl;
+        // ... and decrease max_bucket_size_bl, unless some bucket has to be
+        // recursed into, which may then use all memory but the output stream's.
+        if (!oversized_buckets)
+        {
+            const auto max_bucket_size_act_bl = static_cast<size_t>(foxxll::div_ceil(max_bucket_size_act, block_type::size));
+            TLX_LOGC(debug_stable_ksort)
+                << "Reducing required number of required blocks per bucket from "
+                << max_bucket_size_bl << " to " << max_bucket_size_act_bl;
+            max_bucket_size_bl = max_bucket_size_act_bl;
+        }
+        // a third bucket buffer lets a sorted bucket be written back while
+        // the next one is sorted, if it leaves enough write buffers
+        const size_t nbucket_buffers =
+            (!oversized_buckets &&
+             3 * max_bucket_size_bl + write_buffers_multiple_bs * ndisks <= m) ? 3 : 2;
+        const size_t nwrite_buffers_bs = m - nbucket_buffers * max_bucket_size_bl;
         TLX_LOGC(debug_stable_ksort)
             << "Write buffers in bucket sorting phase: " << nwrite_buffers_bs;
 
@@ -345,118 +843,15 @@ void stable_ksort(ExtIterator first, ExtIterator last, KeyExtract key_extract, s
             }
             delete block;
         }
-        block_type* blocks1 = new block_type[max_bucket_size_bl];
-        block_type* blocks2 = new block_type[max_bucket_size_bl];
-        request_ptr* reqs1 = new request_ptr[max_bucket_size_bl];
-        request_ptr* reqs2 = new request_ptr[max_bucket_size_bl];
-        type_key_* refs1 = new type_key_[static_cast<size_t>(max_bucket_size_rec)];
-        type_key_* refs2 = new type_key_[static_cast<size_t>(max_bucket_size_rec)];
-
-        // submit reading first 2 buckets (Peter's scheme)
-        auto nbucket_blocks = static_cast<size_t>(foxxll::div_ceil(bucket_sizes[0], block_type::size));
-        for (i = 0; i < nbucket_blocks; i++)
-            reqs1[i] = blocks1[i].read(bucket_bids[0][i]);
-
-        nbucket_blocks = static_cast<size_t>(foxxll::div_ceil(bucket_sizes[1], block_type::size));
-        for (i = 0; i < nbucket_blocks; i++)
-            reqs2[i] = blocks2[i].read(bucket_bids[1][i]);
-
-        key_type offset = 0;
-        const unsigned log_k1 = std::max<unsigned>(
-            tlx::integer_log2_ceil(max_bucket_size_rec * sizeof(type_key_) / STXXL_L2_SIZE), 1);
-        size_t k1 = size_t(1) << log_k1;
-        size_t* bucket1 = new size_t[k1];
-
-        const unsigned int shift = static_cast<unsigned int>(sizeof(key_type) * 8 - lognbuckets);
-        const unsigned int shift1 = shift - log_k1;
-
-        TLX_LOGC(debug_stable_ksort)
-            << "Classifying " << nbuckets << " buckets, max size:" << max_bucket_size_rec
-            << " block size:" << block_type::size << " log_k1:" << log_k1;
-
-        for (size_t k = 0; k < nbuckets; k++)
-        {
-            nbucket_blocks = static_cast<size_t>(foxxll::div_ceil(bucket_sizes[k], block_type::size));
-            const unsigned log_k1_k = std::max<unsigned>(
-                tlx::integer_log2_ceil(bucket_sizes[k] * sizeof(type_key_) / STXXL_L2_SIZE), 1);
-            assert(log_k1_k <= log_k1);
-            k1 = static_cast<size_t>(1) << log_k1_k;
-            std::fill(bucket1, bucket1 + k1, 0);
-
-            TLX_LOGC(debug_stable_ksort)
-                << "Classifying bucket " << k << " size:" << bucket_sizes[k]
-                << " blocks:" << nbucket_blocks << " log_k1:" << log_k1_k;
-            // classify first nbucket_blocks-1 blocks, they are full
-            type_key_* ref_ptr = refs1;
-            key_type offset1 = offset + (key_type(1) << key_type(shift)) * key_type(k);
-            for (i = 0; i < nbucket_blocks - 1; i++)
-            {
-                reqs1[i]->wait();
-                stable_ksort_local::classify_block(
-                    blocks1[i].begin(), blocks1[i].end(), ref_ptr,
-                    bucket1, offset1, shift1, key_extract);
-            }
-            // last block might be non-full
-            const auto last_block_size =
-                static_cast<size_t>(bucket_sizes[k] - (nbucket_blocks - 1) * block_type::size);
-            reqs1[i]->wait();
 
-            //STXXL_MSG("block_type::size: "<<block_type::size<<" last_block_size:"<<last_block_size);
-
-            stable_ksort_local::classify_block(
-                blocks1[i].begin(), blocks1[i].begin() + last_block_size, ref_ptr,
-                bucket1, offset1, shift1, key_extract);
-
-            exclusive_prefix_sum(bucket1, k1);
-            classify(refs1, refs1 + bucket_sizes[k], refs2, bucket1, offset1, shift1);
-
-            type_key_* c = refs2;
-            type_key_* d = refs1;
-            for (i = 0; i < k1; i++)
-            {
-                type_key_* cEnd = refs2 + bucket1[i];
-                type_key_* dEnd = refs1 + bucket1[i];
-
-                const unsigned log_k2 = tlx::integer_log2_floor(bucket1[i]) - 1;        // adaptive bucket size
-                const size_t k2 = size_t(1) << log_k2;
-                size_t* bucket2 = new size_t[k2];
-                const unsigned shift2 = shift1 - log_k2;
-
-                // STXXL_MSG("Sorting bucket "<<k<<":"<<i);
-                l1sort(c, cEnd, d, bucket2, k2,
-                       offset1 + (key_type(1) << key_type(shift1)) * key_type(i),
-                       shift2);
-
-                // write out all
-                for (type_key_* p = d; p < dEnd; p++)
-                    out << (*(p->ptr));
-
-                delete[] bucket2;
-                c = cEnd;
-                d = dEnd;
-            }
-            // submit next read
-            const size_t bucket2submit = k + 2;
-            if (bucket2submit < nbuckets)
-            {
-                nbucket_blocks = static_cast<size_t>(foxxll::div_ceil(bucket_sizes[bucket2submit], block_type::size));
-                for (i = 0; i < nbucket_blocks; i++)
-                    reqs1[i] = blocks1[i].read(bucket_bids[bucket2submit][i]);
-            }
-
-            std::swap(blocks1, blocks2);
-            std::swap(reqs1, reqs2);
-        }
+        stable_ksort_local::sort_buckets<block_type, alloc_strategy>(
+            out, bucket_bids, bucket_sizes, bucket_min, bucket_max, nbuckets,
+            nbucket_buffers * max_bucket_size_bl, ndisks, key_extract, 0);
 
-        delete[] bucket1;
-        delete[] refs1;
-        delete[] refs2;
-        delete[] blocks1;
-        delete[] blocks2;
-        delete[] reqs1;
-        delete[] reqs2;
         delete[] bucket_bids;
         delete[] bucket_sizes;
+        delete[] bucket_min;
+        delete[] bucket_max;
 
         if (last.block_offset())
         {
@@ -485,8 +880,6 @@ void stable_ksort(ExtIterator first, ExtIterator last, KeyExtract key_extract, s
 //! \param last object of model of \c ext_random_access_iterator concept
 //! \param M amount of memory for internal use (in bytes)
 //! \remark Elements must provide a method key() which returns the integer key.
-//! \remark Not yet fully implemented, it assumes that the keys are uniformly
-//! distributed between [0,std::numeric_limits<key_type>::max().
 template <typename ExtIterator>
 void stable_ksort(ExtIterator first, ExtIterator last, size_t M)
 {
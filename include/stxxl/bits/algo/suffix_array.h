@@ -0,0 +1,1592 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/suffix_array.h
+ *
+ *  External memory suffix array construction with DC3 aka skew3 as described
+ *  in Roman Dementiev, Juha Kaerkkaeinen, Jens Mehnert and Peter Sanders.
+ *  "Better External Memory Suffix Array Construction". Journal of
+ *  Experimental Algorithmics (JEA), volume 12, 2008, or by prefix doubling,
+ *  LCP array construction as in Kasai et al. (2001), and the Burrows-Wheeler
+ *  transform streamed from the final DC3 merge.
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Copyright (C) 2004 Jens Mehnert <jmehnert@mpi-sb.mpg.de>
+ *  Copyright (C) 2012-2015 Timo Bingmann <tb@panthema.net>
+ *  Copyright (C) 2012-2015 Daniel Feist <daniel.feist@student.kit.edu>
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_SUFFIX_ARRAY_HEADER
+#define STXXL_ALGO_SUFFIX_ARRAY_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+
+#include <stxxl/bits/common/comparator.h>
+#include <stxxl/bits/config.h>
+#include <stxxl/bits/containers/sorter.h>
+#include <stxxl/bits/containers/vector.h>
+#include <stxxl/bits/stream/sort_stream.h>
+#include <stxxl/bits/stream/stream.h>
+#include <stxxl/types>
+
+#if STXXL_PARALLEL
+#include <omp.h>
+#endif
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+//! Suffix array construction algorithm of stxxl::suffix_array().
+enum class suffix_array_algorithm
+{
+    //! prefix doubling if its sorts fit into internal memory, DC3 otherwise
+    automatic,
+    //! DC3 aka skew3, whose I/O volume is independent of the text
+    dc3,
+    //! prefix doubling, one sort per doubling of the compared prefix length
+    prefix_doubling
+};
+
+/*! \internal
+ */
+namespace suffix_array_local {
+
+static constexpr bool debug = false;
+
+using size_type = external_size_type;
+
+/// DC3 aka skew algorithm
+
+/*
+ * DC3 aka skew algorithm a short description. T := input string
+ * The recursion works as follows:
+ * Step 1: a) pick all mod1/mod2 triples (i.e. triples T[i,i+2] at position i mod 3 != 0) (-> extract_mod12 class)
+ *         b) sort mod1/mod2 triples lexicographically (-> build_sa class)
+ *         c) give mod1/mod2 triples lexicographical ascending names n (-> naming class)
+ *         d) check lexicographical names for uniqueness (-> naming class)
+ *            If yes: proceed to next Step, If no: set T := lexicographical names and run Step 1 again
+ * Step 2: a) by sorting the lexicographical names n we receive ranks r
+ *         b) construct mod0-quints, mod1-quads and mod2-quints  (-> build_sa class)
+ *         c) prepare for merging by:
+ *            sort mod0-quints by 2 components, sort mod1-quads / mod2-quints by one component (-> build_sa class)
+ *         c) merge mod0-quints, mod1-quads and mod2-quints (-> merge_sa class)
+ * Step 3: a) return Suffix Array of T
+ *
+ * \param offset_type later suffix array data type
+ */
+template <typename offset_type>
+class skew
+{
+public:
+    using size_type = external_size_type;
+
+    // 2-tuple, 3-tuple, 4-tuple (=quads), 5-tuple(=quints) definition
+    using skew_pair_type = std::tuple<offset_type, offset_type>;
+    using skew_triple_type = std::tuple<offset_type, offset_type, offset_type>;
+    using skew_quad_type = std::tuple<offset_type, offset_type, offset_type, offset_type>;
+    using skew_quint_type = std::tuple<offset_type, offset_type, offset_type, offset_type, offset_type>;
+
+    using offset_array_type = typename stxxl::vector<offset_type, 1, stxxl::lru_pager<2> >;
+    using offset_array_it_rg = stream::vector_iterator2stream<typename offset_array_type::iterator>;
+
+    /** Comparison function for the mod0 tuples. */
+    using less_mod0 = stxxl::comparator<skew_quint_type, stxxl::direction::DontCare, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::Less, stxxl::direction::DontCare>;
+
+    using less_mod1 = stxxl::comparator<skew_quad_type, stxxl::direction::DontCare, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare>;
+    using less_mod2 = stxxl::comparator<skew_quint_type, stxxl::direction::DontCare, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare, stxxl::direction::DontCare>;
+
+    /** Check, if last two components of tree quads are equal. */
+    template <class quad_type>
+    static inline bool quad_eq(const quad_type& a, const quad_type& b)
+    {
+        return (std::get<1>(a) == std::get<1>(b)) && (std::get<2>(a) == std::get<2>(b)) && (std::get<3>(a) == std::get<3>(b));
+    }
+
+    /** Naming pipe for the conventional skew algorithm without discarding. */
+    template <class Input>
+    class naming
+    {
+    public:
+        using quad_type = typename Input::value_type;
+
+        using value_type = skew_pair_type;
+
+    private:
+        Input& A;
+
+        bool& unique;
+        offset_type lexname;
+        quad_type prev;
+        skew_pair_type result;
+
+    public:
+        naming(Input& A_, bool& unique_)
+            : A(A_), unique(unique_), lexname(0)
+        {
+            assert(!A.empty());
+            unique = true;
+
+            prev = *A;
+            std::get<0>(result) = std::get<0>(prev);
+            std::get<1>(result) = lexname;
+        }
+
+        const value_type& operator * () const
+        {
+            return result;
+        }
+
+        naming& operator ++ ()
+        {
+            assert(!A.empty());
+
+            ++A;
+            if (A.empty())
+                return *this;
+
+            quad_type curr = *A;
+            if (!quad_eq(prev, curr)) {
+                ++lexname;
+            }
+            else {
+                if (!A.empty() && std::get<1>(curr) != offset_type(0)) {
+                    unique = false;
+                }
+            }
+
+            std::get<0>(result) = std::get<0>(curr);
+            std::get<1>(result) = lexname;
+
+            prev = curr;
+            return *this;
+        }
+
+        bool empty() const
+        {
+            return A.empty();
+        }
+    };
+
+    /** Create tuples of 2 components until one of the input streams are empty. */
+    template <class InputA, class InputB, const int add_alphabet = 0>
+    class make_pairs
+    {
+    public:
+        using value_type = std::tuple<typename InputA::value_type, offset_type>;
+
+    private:
+        InputA& A;
+        InputB& B;
+        value_type result;
+
+    public:
+        make_pairs(InputA& a, InputB& b)
+            : A(a), B(b)
+        {
+            assert(!A.empty());
+            assert(!B.empty());
+            if (!empty()) {
+                result = value_type(*A, *B + add_alphabet);
+            }
+        }
+
+        const value_type& operator * () const
+        { return result; }
+
+        make_pairs& operator ++ ()
+        {
+            assert(!A.empty());
+            assert(!B.empty());
+
+            ++A;
+            ++B;
+
+            if (!A.empty() && !B.empty()) {
+                result = value_type(*A, *B + add_alphabet);
+            }
+
+            return *this;
+        }
+
+        bool empty() const
+        { return (A.empty() || B.empty()); }
+    };
+
+    /**
+     * Collect three characters t_i, t_{i+1}, t_{i+2} beginning at the index
+     * i. Since we need at least one unique endcaracter, we free the first
+     * characters i.e. we map (t_i) -> (i,t_i,t_{i+1},t_{i+2})
+     *
+     * \param Input holds all characters t_i from input string t
+     * \param alphabet_type
+     * \param add_alphabet
+     */
+    template <class Input, typename alphabet_type, const int add_alphabet = 0>
+    class make_quads
+    {
+    public:
+        using value_type = std::tuple<offset_type, alphabet_type, alphabet_type, alphabet_type>;
+
+    private:
+        Input& A;
+        value_type current;
+        offset_type counter;
+        unsigned int z3z;  // = counter mod 3, ("+",Z/3Z) is cheaper than %
+        bool finished;
+
+        offset_array_type& text;
+
+    public:
+        make_quads(Input& data_in_, offset_array_type& text_)
+            : A(data_in_),
+              current(0, 0, 0, 0),
+              counter(0),
+              z3z(0),
+              finished(false),
+              text(text_)
+        {
+            assert(!A.empty());
+
+            std::get<0>(current) = counter;
+            std::get<1>(current) = std::get<1>(*A) + add_alphabet;
+            ++A;
+
+            if (!A.empty()) {
+                std::get<2>(current) = std::get<1>(*A) + add_alphabet;
+                ++A;
+            }
+            else {
+                std::get<2>(current) = 0;
+                std::get<3>(current) = 0;
+            }
+
+            if (!A.empty()) {
+                std::get<3>(current) = std::get<1>(*A) + add_alphabet;
+            }
+            else {
+                std::get<3>(current) = 0;
+            }
+        }
+
+        const value_type& operator * () const
+        { return current; }
+
+        make_quads& operator ++ ()
+        {
+            assert(!A.empty() || !finished);
+
+            if (std::get<1>(current) != offset_type(0)) {
+                text.push_back(std::get<1>(current));
+            }
+
+            // Calculate module
+            if (++z3z == 3) z3z = 0;
+
+            std::get<0>(current) = ++counter;
+            std::get<1>(current) = std::get<2>(current);
+            std::get<2>(current) = std::get<3>(current);
+
+            if (!A.empty())
+                ++A;
+
+            if (!A.empty()) {
+                std::get<3>(current) = std::get<1>(*A) + add_alphabet;
+            }
+            else {
+                std::get<3>(current) = 0;
+            }
+
+            // Inserts a dummy tuple for input sizes of n%3==1
+            if ((std::get<1>(current) == offset_type(0)) && (z3z != 1)) {
+                finished = true;
+            }
+
+            return *this;
+        }
+
+        bool empty() const
+        { return (A.empty() && finished); }
+    };
+
+    /** Drop 1/3 of the input. More exactly the offsets at positions (0 mod
+     * 3). Index begins with 0. */
+    template <class Input>
+    class extract_mod12
+    {
+    public:
+        using value_type = typename Input::value_type;
+
+    private:
+        Input& A;
+        offset_type counter;
+        offset_type output_counter;
+        value_type result;
+
+    public:
+        explicit extract_mod12(Input& A_)
+            : A(A_),
+              counter(0),
+              output_counter(0)
+        {
+            assert(!A.empty());
+            ++A, ++counter;  // skip 0 = mod0 offset
+            if (!A.empty()) {
+                result = *A;
+                std::get<0>(result) = output_counter;
+            }
+        }
+
+        const value_type& operator * () const
+        { return result; }
+
+        extract_mod12& operator ++ ()
+        {
+            assert(!A.empty());
+
+            ++A, ++counter, ++output_counter;
+
+            if (!A.empty() && (counter % 3) == 0) {
+                // skip mod0 offsets
+                ++A, ++counter;
+            }
+            if (!A.empty()) {
+                result = *A;
+                std::get<0>(result) = output_counter;
+            }
+
+            return *this;
+        }
+
+        bool empty() const
+        { return A.empty(); }
+    };
+
+    /** Create the suffix array from the current sub problem by simple
+     *  comparison-based merging.  More precisely: compare characters(out of
+     *  text t) and ranks(out of ISA12) of the following constellation:
+     *  Input constellation:
+     *  \param Mod0 5-tuple (quint): <i, t_i, t_{i+1}, ISA12[i+1], ISA12[i+2]>
+     *  \param Mod1 4-tuple (quad): <i, ISA12[i], t_i, ISA12[i+1]>
+     *  \param Mod2 5-tuple (quint): <i, ISA[i], t_i, t_{i+1}, ISA12[i+1]>
+     *  The tuples may carry t_{i-1} as an additional last component.
+     */
+    template <class Mod0, class Mod1, class Mod2>
+    class merge_sa
+    {
+    public:
+        using value_type = offset_type;
+
+    private:
+        Mod0& A;
+        Mod1& B;
+        Mod2& C;
+
+        typename Mod0::value_type s0;
+        typename Mod1::value_type s1;
+        typename Mod2::value_type s2;
+
+        int selected;
+        bool done[3];
+
+        offset_type index;
+        offset_type merge_result;
+
+        bool cmp_mod1_less_mod2()
+        {
+            assert(!done[1] && !done[2]);
+
+            return std::get<1>(s1) < std::get<1>(s2);
+        }
+
+        bool cmp_mod0_less_mod2()
+        {
+            assert(!done[0] && !done[2]);
+
+            if (std::get<1>(s0) == std::get<2>(s2)) {
+                if (std::get<2>(s0) == std::get<3>(s2))
+                    return std::get<4>(s0) < std::get<4>(s2);
+                else
+                    return std::get<2>(s0) < std::get<3>(s2);
+            }
+            else
+                return std::get<1>(s0) < std::get<2>(s2);
+        }
+
+        bool cmp_mod0_less_mod1()
+        {
+            assert(!done[0] && !done[1]);
+
+            if (std::get<1>(s0) == std::get<2>(s1))
+                return std::get<3>(s0) < std::get<3>(s1);
+            else
+                return std::get<1>(s0) < std::get<2>(s1);
+        }
+
+        void merge()
+        {
+            assert(!done[0] || !done[1] || !done[2]);
+
+            if (done[0])
+            {
+                if (done[2] || (!done[1] && cmp_mod1_less_mod2()))
+                {
+                    selected = 1;
+                    merge_result = std::get<0>(s1);
+                }
+                else
+                {
+                    selected = 2;
+                    merge_result = std::get<0>(s2);
+                }
+            }
+            else if (done[1] || cmp_mod0_less_mod1())
+            {
+                if (done[2] || cmp_mod0_less_mod2())
+                {
+                    selected = 0;
+                    merge_result = std::get<0>(s0);
+                }
+                else
+                {
+                    selected = 2;
+                    merge_result = std::get<0>(s2);
+                }
+            }
+            else
+            {
+                if (done[2] || cmp_mod1_less_mod2())
+                {
+                    selected = 1;
+                    merge_result = std::get<0>(s1);
+                }
+                else
+                {
+                    selected = 2;
+                    merge_result = std::get<0>(s2);
+                }
+            }
+
+            assert(!done[selected]);
+        }
+
+        template <typename Tuple>
+        static const offset_type& last(const Tuple& t)
+        {
+            return std::get<std::tuple_size<Tuple>::value - 1>(t);
+        }
+
+    public:
+        bool empty() const
+        {
+            return (A.empty() && B.empty() && C.empty());
+        }
+
+        //! Last component of the current suffix's tuple, which is t_{i-1}
+        //! if the tuples carry it.
+        const offset_type& preceding() const
+        {
+            return (selected == 0) ? last(s0) : (selected == 1) ? last(s1) : last(s2);
+        }
+
+        merge_sa(Mod0& x1, Mod1& x2, Mod2& x3)
+            : A(x1), B(x2), C(x3), selected(-1), index(0)
+        {
+            assert(!A.empty());
+            assert(!B.empty());
+            assert(!C.empty());
+            done[0] = false;
+            done[1] = false;
+            done[2] = false;
+            s0 = *A;
+            s1 = *B;
+            s2 = *C;
+
+            merge();
+        }
+
+        const value_type& operator * () const
+        {
+            return merge_result;
+        }
+
+        merge_sa& operator ++ ()
+        {
+            if (selected == 0) {
+                assert(!A.empty());
+                ++A;
+                if (!A.empty())
+                    s0 = *A;
+                else
+                    done[0] = true;
+            }
+            else if (selected == 1) {
+                assert(!B.empty());
+                ++B;
+                if (!B.empty())
+                    s1 = *B;
+                else
+                    done[1] = true;
+            }
+            else {
+                assert(!C.empty());
+                assert(selected == 2);
+                ++C;
+                if (!C.empty())
+                    s2 = *C;
+                else
+                    done[2] = true;
+            }
+
+            ++index;
+            if (!empty())
+                merge();
+
+            return *this;
+        }
+    };
+
+    /** Helper function for computing the size of the 2/3 subproblem. */
+    static inline size_type subp_size(size_type n)
+    {
+        return (n / 3) * 2 + ((n % 3) == 2);
+    }
+
+    /**
+     * Sort mod0-quints / mod1-quads / mod2-quints and run merge_sa class to
+     * merge them together.
+     * \param S input string pipe type.
+     * \param Mod1 mod1 tuples input pipe type.
+     * \param Mod2 mod2 tuples input pipe type.
+     * \param WithPrev whether the tuples carry the preceding character, such
+     * that preceding() yields the BWT while merging.
+     */
+    template <class S, class Mod1, class Mod2, bool WithPrev = false>
+    class build_sa
+    {
+    public:
+        using value_type = offset_type;
+
+        static const unsigned int add_rank = 1;  // free first rank to mark ranks beyond end of input
+
+    private:
+        // tuples with the preceding character t_{i-1} as last component
+        using prev_type = typename std::conditional<WithPrev, std::tuple<offset_type>, std::tuple<> >::type;
+        using mod0_tuple_type = decltype(std::tuple_cat(std::declval<skew_quint_type>(), std::declval<prev_type>()));
+        using mod1_tuple_type = decltype(std::tuple_cat(std::declval<skew_quad_type>(), std::declval<prev_type>()));
+        using mod2_tuple_type = decltype(std::tuple_cat(std::declval<skew_quint_type>(), std::declval<prev_type>()));
+
+        using mod0_cmp_type = typename std::conditional<
+                  WithPrev, stxxl::comparator<mod0_tuple_type, stxxl::direction::DontCare, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare>,
+                  less_mod0>::type;
+        using mod1_cmp_type = typename std::conditional<
+                  WithPrev, stxxl::comparator<mod1_tuple_type, stxxl::direction::DontCare, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare, stxxl::direction::DontCare>,
+                  less_mod1>::type;
+        using mod2_cmp_type = typename std::conditional<
+                  WithPrev, stxxl::comparator<mod2_tuple_type, stxxl::direction::DontCare, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare, stxxl::direction::DontCare, stxxl::direction::DontCare>,
+                  less_mod2>::type;
+
+        // mod1 types
+        using mod1_push_type = typename stream::use_push<mod1_tuple_type>;
+        using mod1_runs_type = typename stream::runs_creator<mod1_push_type, mod1_cmp_type>;
+        using sorted_mod1_runs_type = typename mod1_runs_type::sorted_runs_type;
+        using mod1_rm_type = typename stream::runs_merger<sorted_mod1_runs_type, mod1_cmp_type>;
+
+        // mod2 types
+        using mod2_push_type = typename stream::use_push<mod2_tuple_type>;
+        using mod2_runs_type = typename stream::runs_creator<mod2_push_type, mod2_cmp_type>;
+        using sorted_mod2_runs_type = typename mod2_runs_type::sorted_runs_type;
+        using mod2_rm_type = typename stream::runs_merger<sorted_mod2_runs_type, mod2_cmp_type>;
+
+        // mod0 types
+        using mod0_push_type = typename stream::use_push<mod0_tuple_type>;
+        using mod0_runs_type = typename stream::runs_creator<mod0_push_type, mod0_cmp_type>;
+        using sorted_mod0_runs_type = typename mod0_runs_type::sorted_runs_type;
+        using mod0_rm_type = typename stream::runs_merger<sorted_mod0_runs_type, mod0_cmp_type>;
+
+        // Merge type
+        using merge_sa_type = merge_sa<mod0_rm_type, mod1_rm_type, mod2_rm_type>;
+
+        // Functions
+        mod0_cmp_type c0;
+        mod1_cmp_type c1;
+        mod2_cmp_type c2;
+
+        //! Append the preceding character to a tuple, if carried.
+        template <typename Tuple>
+        static auto with_prev(const Tuple& t, offset_type prev)
+        {
+            return std::tuple_cat(t, make_prev(prev, std::integral_constant<bool, WithPrev>()));
+        }
+
+        static std::tuple<offset_type> make_prev(offset_type prev, std::true_type)
+        {
+            return std::tuple<offset_type>(prev);
+        }
+
+        static std::tuple<> make_prev(offset_type /* prev */, std::false_type)
+        {
+            return std::tuple<>();
+        }
+
+        // Runs merger
+        mod1_rm_type* mod1_result;
+        mod2_rm_type* mod2_result;
+        mod0_rm_type* mod0_result;
+
+        // Merger
+        merge_sa_type* vmerge_sa;
+
+        // Input
+        S& source;
+        Mod1& mod_1;
+        Mod2& mod_2;
+
+        // Tmp variables
+        offset_type t[3];
+        offset_type old_t1;
+        offset_type old_t2;
+        offset_type old_mod2;
+        bool exists[3];
+        offset_type mod_one;
+        offset_type mod_two;
+
+        offset_type index;
+
+        // Empty_flag
+        bool ready;
+
+        // Result
+        value_type result;
+        offset_type result_prev;
+
+    public:
+        build_sa(S& source_, Mod1& mod_1_, Mod2& mod_2_, size_type a_size, size_t memsize)
+            : source(source_), mod_1(mod_1_), mod_2(mod_2_), index(0), ready(false)
+        {
+            assert(!source_.empty());
+
+            // Runs storage
+
+            // input: ISA_1,2 from previous level
+            mod0_runs_type mod0_runs(c0, memsize / 4);
+            mod1_runs_type mod1_runs(c1, memsize / 4);
+            mod2_runs_type mod2_runs(c2, memsize / 4);
+
+            while (!source.empty())
+            {
+                exists[0] = false;
+                exists[1] = false;
+                exists[2] = false;
+
+                if (!source.empty()) {
+                    t[0] = *source;
+                    ++source;
+                    exists[0] = true;
+                }
+
+                if (!source.empty()) {
+                    assert(!mod_1.empty());
+                    t[1] = *source;
+                    ++source;
+                    mod_one = *mod_1 + add_rank;
+                    ++mod_1;
+                    exists[1] = true;
+                }
+
+                if (!source.empty()) {
+                    assert(!mod_2.empty());
+                    t[2] = *source;
+                    ++source;
+                    mod_two = *mod_2 + add_rank;
+                    ++mod_2;
+                    exists[2] = true;
+                }
+
+                // Check special cases in the middle of "source"
+                // Cases are cx|xc cxx|cxx and cxxc|xxc
+
+                assert(t[0] != offset_type(0));
+                assert(t[1] != offset_type(0));
+                assert(t[2] != offset_type(0));
+
+                // Mod 0 : (index0,char0,char1,mod1,mod2)
+                // Mod 1 : (index1,mod1,char1,mod2)
+                // Mod 2 : (index2,mod2)
+
+                if (exists[2]) { // Nothing is missed
+                    mod0_runs.push(with_prev(skew_quint_type(index, t[0], t[1], mod_one, mod_two), index ? old_t2 : 0));
+                    mod1_runs.push(with_prev(skew_quad_type(index + 1, mod_one, t[1], mod_two), t[0]));
+
+                    if (index != offset_type(0)) {
+                        mod2_runs.push(with_prev(skew_quint_type((index - 1), old_mod2, old_t2, t[0], mod_one), old_t1));
+                    }
+                }
+                else if (exists[1]) { // Last element missed
+                    mod0_runs.push(with_prev(skew_quint_type(index, t[0], t[1], mod_one, 0), index ? old_t2 : 0));
+                    mod1_runs.push(with_prev(skew_quad_type(index + 1, mod_one, t[1], 0), t[0]));
+
+                    if (index != offset_type(0)) {
+                        mod2_runs.push(with_prev(skew_quint_type((index - 1), old_mod2, old_t2, t[0], mod_one), old_t1));
+                    }
+                }
+                else { // Only one element left
+                    assert(exists[0]);
+                    mod0_runs.push(with_prev(skew_quint_type(index, t[0], 0, 0, 0), index ? old_t2 : 0));
+
+                    if (index != offset_type(0)) {
+                        mod2_runs.push(with_prev(skew_quint_type((index - 1), old_mod2, old_t2, t[0], 0), old_t1));
+                    }
+                }
+
+                old_mod2 = mod_two;
+                old_t1 = t[1];
+                old_t2 = t[2];
+                index += 3;
+            }
+
+            if ((a_size % 3) == 0) { // changed
+                if (index != offset_type(0)) {
+                    mod2_runs.push(with_prev(skew_quint_type((index - 1), old_mod2, old_t2, 0, 0), old_t1));
+                }
+            }
+
+            mod0_runs.deallocate();
+            mod1_runs.deallocate();
+            mod2_runs.deallocate();
+
+            LOG << "merging S0 = " << mod0_runs.size() << ", S1 = " << mod1_runs.size()
+                << ", S2 = " << mod2_runs.size() << " tuples";
+
+            // Prepare for merging
+
+            mod0_result = new mod0_rm_type(mod0_runs.result(), c0, memsize / 5);
+            mod1_result = new mod1_rm_type(mod1_runs.result(), c1, memsize / 5);
+            mod2_result = new mod2_rm_type(mod2_runs.result(), c2, memsize / 5);
+
+            // output: ISA_1,2 for next level
+            vmerge_sa = new merge_sa_type(*mod0_result, *mod1_result, *mod2_result);
+
+            // read first suffix
+            result = *(*vmerge_sa);
+            result_prev = vmerge_sa->preceding();
+        }
+
+        const value_type& operator * () const
+        {
+            return result;
+        }
+
+        //! Character preceding the current suffix, shifted by one as in the
+        //! input of the level, or zero for the first suffix. Only meaningful
+        //! with WithPrev.
+        const offset_type& preceding() const
+        {
+            return result_prev;
+        }
+
+        build_sa& operator ++ ()
+        {
+            assert(vmerge_sa != 0 && !vmerge_sa->empty());
+
+            ++(*vmerge_sa);
+            if (!vmerge_sa->empty()) {
+                result = *(*vmerge_sa);
+                result_prev = vmerge_sa->preceding();
+            }
+            else {  // cleaning up
+                assert(vmerge_sa->empty());
+                ready = true;
+
+                assert(vmerge_sa != nullptr);
+                delete vmerge_sa, vmerge_sa = nullptr;
+
+                assert(mod0_result != nullptr && mod1_result != nullptr && mod2_result != nullptr);
+                delete mod0_result, mod0_result = nullptr;
+                delete mod1_result, mod1_result = nullptr;
+                delete mod2_result, mod2_result = nullptr;
+            }
+
+            return *this;
+        }
+
+        ~build_sa()
+        {
+            if (vmerge_sa) delete vmerge_sa;
+
+            if (mod0_result) delete mod0_result;
+            if (mod1_result) delete mod1_result;
+            if (mod2_result) delete mod2_result;
+        }
+
+        bool empty() const
+        {
+            return ready;
+        }
+    };
+
+    /** The skew algorithm.
+     *  \param Input type of the input pipe.
+     *  \param WithBWT whether the top level also yields the preceding
+     *  character of each suffix, see preceding(). */
+    template <class Input, bool WithBWT = false>
+    class algorithm
+    {
+    public:
+        using value_type = offset_type;
+        using alphabet_type = typename Input::value_type;
+
+    protected:
+        // finished reading final suffix array
+        bool finished;
+
+        // current recursion depth
+        unsigned int rec_depth;
+
+        // memory used by the sorters of each recursion level
+        size_t m_mem;
+
+    protected:
+        // generate (i) sequence
+        using counter_stream_type = stxxl::stream::counter<offset_type>;
+
+        // Sorter
+        using mod12cmp = stxxl::comparator<skew_pair_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+        using mod12_sorter_type = stxxl::sorter<skew_pair_type, mod12cmp>;
+
+        // Additional streaming items
+        using isa_second_type = stream::choose<mod12_sorter_type, 1>;
+        using buildSA_type = build_sa<offset_array_it_rg, isa_second_type, isa_second_type>;
+        using precompute_isa_type = make_pairs<buildSA_type, counter_stream_type>;
+
+        // only the top level carries the preceding characters
+        using topSA_type = build_sa<offset_array_it_rg, isa_second_type, isa_second_type, WithBWT>;
+
+        template <bool Top>
+        using level_sa_type = typename std::conditional<Top, topSA_type, buildSA_type>::type;
+
+        // Real recursive skew3 implementation
+        // This part is the core of the skew algorithm and runs all class objects in their respective order
+        template <bool Top, typename RecInputType>
+        level_sa_type<Top>* skew3(RecInputType& p_Input)
+        {
+            // (t_i) -> (i,t_i,t_{i+1},t_{i+2})
+            using make_quads_input_type = make_quads<RecInputType, offset_type, 1>;
+
+            // (t_i) -> (i,t_i,t_{i+1},t_{i+2}) with i = 1,2 mod 3
+            using mod12_quads_input_type = extract_mod12<make_quads_input_type>;
+
+            // sort (i,t_i,t_{i+1},t_{i+2}) by (t_i,t_{i+1},t_{i+2})
+            using less_quad_offset_type = stxxl::comparator<std::tuple<offset_type, offset_type, offset_type, offset_type>, stxxl::direction::DontCare>;
+            using sort_mod12_input_type = typename stream::sort<mod12_quads_input_type, less_quad_offset_type>;
+
+            // name (i,t_i,t_{i+1},t_{i+2}) -> (i,n_i)
+            using naming_input_type = naming<sort_mod12_input_type>;
+
+            mod12_sorter_type m1_sorter(mod12cmp(), m_mem / 5);
+            mod12_sorter_type m2_sorter(mod12cmp(), m_mem / 5);
+
+            // sorted mod1 runs -concatenate- sorted mod2 runs
+            using concatenation_type = stxxl::stream::concatenate<mod12_sorter_type, mod12_sorter_type>;
+
+            // (t_i) -> (i,t_i,t_{i+1},t_{i+2})
+            offset_array_type text;
+            make_quads_input_type quads_input(p_Input, text);
+
+            // (t_i) -> (i,t_i,t_{i+1},t_{i+2}) with i = 1,2 mod 3
+            mod12_quads_input_type mod12_quads_input(quads_input);
+
+            // sort (i,t_i,t_{i+1},t_{i+2}) by (t_i,t_i+1},t_{i+2})
+            sort_mod12_input_type sort_mod12_input(mod12_quads_input, less_quad_offset_type(), m_mem / 5);
+
+            // name (i,t_i,t_{i+1},t_{i+2}) -> (i,"n_i")
+            bool unique = false;         // is the current quad array unique?
+            naming_input_type names_input(sort_mod12_input, unique);
+
+            // create (i, s^12[i])
+            size_type concat_length = 0; // holds length of current S_12
+            while (!names_input.empty()) {
+                const skew_pair_type& tmp = *names_input;
+                if (std::get<0>(tmp) & 1) {
+                    m2_sorter.push(tmp); // sorter #2
+                }
+                else {
+                    m1_sorter.push(tmp); // sorter #1
+                }
+                ++names_input;
+                concat_length++;
+            }
+
+            LOG << "recursion string length = " << concat_length;
+
+            m1_sorter.sort();
+            m2_sorter.sort();
+
+            if (!unique)
+            {
+                LOG << "not unique -> next recursion level = " << ++rec_depth;
+
+                // compute s^12 := lexname[S[1 mod 3]] . lexname[S[2 mod 3]], (also known as reduced recursion string 'R')
+                concatenation_type concat_mod1mod2(m1_sorter, m2_sorter);
+
+                buildSA_type* recType = skew3<false>(concat_mod1mod2);  // recursion with recursion string T' = concat_mod1mod2 lexnames
+
+                LOG << "exit recursion level = " << --rec_depth;
+
+                counter_stream_type isa_loop_index;
+                precompute_isa_type isa_pairs(*recType, isa_loop_index); // add index as component => (SA12, i)
+
+                // store beginning of mod2-tuples of s^12 in mod2_pos
+                offset_type special = (concat_length != subp_size(text.size()));
+                offset_type mod2_pos = offset_type((subp_size(text.size()) >> 1) + (subp_size(text.size()) & 1) + special);
+
+                mod12_sorter_type isa1_pair(mod12cmp(), m_mem / 5);
+                mod12_sorter_type isa2_pair(mod12cmp(), m_mem / 5);
+
+                while (!isa_pairs.empty()) {
+                    const skew_pair_type& tmp = *isa_pairs;
+                    if (std::get<0>(tmp) < mod2_pos) {
+                        if (std::get<0>(tmp) + special < mod2_pos) // else: special sentinel tuple is dropped
+                            isa1_pair.push(tmp);                   // sorter #1
+                    }
+                    else {
+                        isa2_pair.push(tmp);                       // sorter #2
+                    }
+                    ++isa_pairs;
+                }
+
+                delete recType;
+
+                isa1_pair.finish();
+                isa2_pair.finish();
+
+                offset_array_it_rg input(text.begin(), text.end());
+
+                // => (i, ISA)
+                isa1_pair.sort(m_mem / 8);
+                isa2_pair.sort(m_mem / 8);
+
+                // pick ISA of (i, ISA)
+                isa_second_type isa1(isa1_pair);
+                isa_second_type isa2(isa2_pair);
+
+                // prepare and run merger
+                return new level_sa_type<Top>(input, isa1, isa2, text.size(), m_mem);
+            }
+            else // unique
+            {
+                LOG << "unique names!";
+
+                isa_second_type isa1(m1_sorter);
+                isa_second_type isa2(m2_sorter);
+
+                offset_array_it_rg source(text.begin(), text.end());
+
+                // prepare and run merger
+                return new level_sa_type<Top>(source, isa1, isa2, text.size(), m_mem);
+            }
+        } // end of skew3()
+
+    protected:
+        // Adapt (t_i) -> (i,t_i) for input to fit to recursive call
+        using make_pairs_input_type = make_pairs<counter_stream_type, Input>;
+
+        // points to final constructed suffix array generator
+        topSA_type* out_sa;
+
+    public:
+        algorithm(Input& data_in, size_t mem)
+            : finished(false), rec_depth(0), m_mem(mem)
+        {
+            // (t_i) -> (i,t_i)
+            counter_stream_type dummy;
+            make_pairs_input_type pairs_input(dummy, data_in);
+
+            out_sa = skew3<true>(pairs_input);
+        }
+
+        const value_type& operator * () const
+        {
+            return *(*out_sa);
+        }
+
+        //! Character preceding the current suffix, plus one, or zero for the
+        //! suffix at position zero. Requires WithBWT.
+        const offset_type& preceding() const
+        {
+            static_assert(WithBWT, "preceding() requires WithBWT");
+            return out_sa->preceding();
+        }
+
+        algorithm& operator ++ ()
+        {
+            assert(out_sa);
+            assert(!out_sa->empty());
+
+            ++(*out_sa);
+
+            if (out_sa->empty()) {
+                finished = true;
+                delete out_sa;
+                out_sa = nullptr;
+            }
+            return *this;
+        }
+
+        ~algorithm()
+        {
+            if (out_sa) delete out_sa;
+        }
+
+        bool empty() const
+        {
+            return finished;
+        }
+    }; // algorithm class
+};     // skew class
+
+/// Prefix doubling
+
+/*!
+ * Prefix doubling in external memory. The rank of a suffix is one plus the
+ * number of suffixes whose first h characters are smaller. Each round sorts
+ * the triples (rank[i], rank[i+h], i), which orders the suffixes by their
+ * first 2h characters, and names them with the ranks for 2h, until all ranks
+ * are distinct. The ranks are kept in a vector indexed by the position, read
+ * twice in parallel at distance h to build the triples. The naming works on
+ * batches of sorted triples, in parallel with STXXL_PARALLEL.
+ *
+ * \param offset_type suffix array data type
+ */
+template <typename offset_type>
+class prefix_doubling
+{
+public:
+    using rank_vector_type = stxxl::vector<offset_type, 1, stxxl::lru_pager<2> >;
+
+    //! (rank[i], rank[i+h], i)
+    using triple_type = std::tuple<offset_type, offset_type, offset_type>;
+    //! (i, rank[i])
+    using pair_type = std::tuple<offset_type, offset_type>;
+
+    using triple_less = stxxl::comparator<triple_type, stxxl::direction::Less, stxxl::direction::Less, stxxl::direction::DontCare>;
+    using pair_less = stxxl::comparator<pair_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+
+    using triple_sorter_type = stxxl::sorter<triple_type, triple_less>;
+    using pair_sorter_type = stxxl::sorter<pair_type, pair_less>;
+
+    static bool equal_ranks(const triple_type& a, const triple_type& b)
+    {
+        return std::get<0>(a) == std::get<0>(b) && std::get<1>(a) == std::get<1>(b);
+    }
+
+    /*!
+     * Name a batch of sorted triples: the new rank of a triple is one plus
+     * the position of the first triple with equal ranks, where first is the
+     * position of batch[0]. prev is the last triple of the previous batch
+     * and prev_rank its new rank, if first > 0. Returns the number of
+     * distinct ranks which start in the batch.
+     */
+    static size_t name_batch(const std::vector<triple_type>& batch,
+                             std::vector<offset_type>& names, size_type first,
+                             const triple_type& prev, offset_type prev_rank)
+    {
+        const size_t n = batch.size();
+        names.resize(n);
+
+#if STXXL_PARALLEL
+        const size_t num_parts = std::max<size_t>(
+            std::min<size_t>(static_cast<size_t>(omp_get_max_threads()), n / 4096), 1);
+#else
+        const size_t num_parts = 1;
+#endif
+        std::vector<size_t> distinct(num_parts, 0);
+
+        // name the triples of each part, 0 for those continuing the group of
+        // the previous part
+#if STXXL_PARALLEL
+#pragma omp parallel for num_threads(num_parts) schedule(static, 1)
+#endif
+        for (size_t p = 0; p < num_parts; ++p)
+        {
+            const size_t begin = n * p / num_parts, end = n * (p + 1) / num_parts;
+            offset_type name = 0;
+            for (size_t j = begin; j < end; ++j)
+            {
+                const bool head = (j == 0)
+                                  ? (first == 0 || !equal_ranks(prev, batch[0]))
+                                  : !equal_ranks(batch[j - 1], batch[j]);
+                if (head) {
+                    name = static_cast<offset_type>(first + j + 1);
+                    ++distinct[p];
+                }
+                names[j] = name;
+            }
+        }
+
+        // continue the groups across the parts
+        offset_type carry = prev_rank;
+        for (size_t p = 0; p < num_parts; ++p)
+        {
+            const size_t begin = n * p / num_parts, end = n * (p + 1) / num_parts;
+            for (size_t j = begin; j < end && names[j] == offset_type(0); ++j)
+                names[j] = carry;
+            if (end > begin)
+                carry = names[end - 1];
+        }
+
+        size_t total = 0;
+        for (size_t d : distinct)
+            total += d;
+        return total;
+    }
+
+    /*!
+     * Construct the suffix array of the n characters of text into sa, which
+     * must have size n.
+     */
+    template <typename TextStream, typename SAVector>
+    static void construct(TextStream& text, size_type n, SAVector& sa, size_t mem)
+    {
+        rank_vector_type rank(n);
+
+        // the ranks for h = 1 are the characters, shifted by one to keep 0
+        // for positions beyond the end
+        {
+            typename rank_vector_type::bufwriter_type writer(rank);
+            for ( ; !text.empty(); ++text)
+                writer << static_cast<offset_type>(static_cast<offset_type>(*text) + 1);
+            writer.finish();
+        }
+
+        const size_t batch_size = std::max<size_t>(
+            mem / 4 / (sizeof(triple_type) + sizeof(offset_type)), 1);
+
+        for (size_type h = 1; ; h *= 2)
+        {
+            triple_sorter_type triples(triple_less(), mem / 2);
+            {
+                typename rank_vector_type::bufreader_type ranks(rank);
+                typename rank_vector_type::bufreader_type ahead(
+                    rank.cbegin() + std::min(h, n), rank.cend());
+                for (size_type i = 0; i < n; ++i, ++ranks)
+                {
+                    offset_type next = 0;
+                    if (!ahead.empty()) {
+                        next = *ahead;
+                        ++ahead;
+                    }
+                    triples.push(triple_type(*ranks, next, static_cast<offset_type>(i)));
+                }
+            }
+            triples.sort();
+
+            // name the suffixes by their first 2h characters, the positions
+            // in sorted order are the suffix array once all names differ
+            pair_sorter_type pairs(pair_less(), mem / 4);
+            size_type distinct = 0;
+            {
+                typename SAVector::bufwriter_type sa_writer(sa);
+                std::vector<triple_type> batch;
+                std::vector<offset_type> names;
+                triple_type prev;
+                offset_type prev_rank = 0;
+
+                for (size_type first = 0; !triples.empty(); first += batch.size())
+                {
+                    batch.clear();
+                    for ( ; !triples.empty() && batch.size() < batch_size; ++triples)
+                        batch.push_back(*triples);
+
+                    distinct += name_batch(batch, names, first, prev, prev_rank);
+
+                    for (size_t j = 0; j < batch.size(); ++j)
+                    {
+                        pairs.push(pair_type(std::get<2>(batch[j]), names[j]));
+                        sa_writer << std::get<2>(batch[j]);
+                    }
+                    prev = batch.back();
+                    prev_rank = names.back();
+                }
+                sa_writer.finish();
+            }
+
+            LOG << "prefix doubling: " << distinct << " distinct ranks of prefixes of length " << 2 * h;
+
+            if (distinct == n)
+                return;
+
+            pairs.sort();
+            stream::choose<pair_sorter_type, 1> new_ranks(pairs);
+            stream::materialize(new_ranks, rank.begin(), rank.end());
+        }
+    }
+};
+
+/// Kasai's semi external LCP array construction.
+
+//! Maps SA[k] to (SA[k], k, SA[k-1]).
+template <typename InputStream>
+class sa_index_stream
+{
+public:
+    using offset_type = typename InputStream::value_type;
+    using value_type = std::tuple<offset_type, offset_type, offset_type>;
+
+private:
+    size_type m_counter;
+
+    InputStream& m_input;
+
+    value_type m_curr;
+
+public:
+    explicit sa_index_stream(InputStream& input) : m_counter(0), m_input(input)
+    {
+        if (!m_input.empty())
+            m_curr = value_type(*m_input, offset_type(m_counter++), 0);
+    }
+
+    const value_type& operator * () const
+    {
+        return m_curr;
+    }
+
+    sa_index_stream& operator ++ ()
+    {
+        ++m_input;
+        if (!m_input.empty())
+            m_curr = value_type(*m_input, offset_type(m_counter++), std::get<0>(m_curr));
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return m_input.empty();
+    }
+};
+
+/*!
+ * Calculate the LCP array from a text and its suffix array in linear time.
+ * Based on the ideas of Kasai et al. (2001), implemented by Timo Bingmann
+ * (2012). The text is held in internal memory, the inverse suffix array and
+ * the LCP array are sorted in external memory.
+ */
+template <typename TextIterator, typename SAVector, typename LCPVector>
+void lcp_kasai(TextIterator text_begin, TextIterator text_end,
+               const SAVector& sa, LCPVector& lcp, size_t mem)
+{
+    using alphabet_type = typename std::iterator_traits<TextIterator>::value_type;
+    using offset_type = typename SAVector::value_type;
+    using lcp_type = typename LCPVector::value_type;
+
+    using offset_triple_type = std::tuple<offset_type, offset_type, offset_type>;
+    using lcp_pair_type = std::tuple<offset_type, lcp_type>;
+
+    // sort (SA[k], k, SA[k-1]) by SA[k] to get ISA[i] and SA[ISA[i]-1]
+    using sa_stream_type = stream::vector_iterator2stream<typename SAVector::const_iterator>;
+    sa_stream_type sa_stream(sa.cbegin(), sa.cend());
+    sa_index_stream<sa_stream_type> sa_index(sa_stream);
+
+    using isa_less_type = stxxl::comparator<offset_triple_type, stxxl::direction::Less, stxxl::direction::DontCare, stxxl::direction::DontCare>;
+    using isa_sort_type = stream::sort<sa_index_stream<sa_stream_type>, isa_less_type>;
+    isa_sort_type isa_sort(sa_index, isa_less_type(), mem / 2);
+
+    using lcp_less_type = stxxl::comparator<lcp_pair_type, stxxl::direction::Less, stxxl::direction::DontCare>;
+    using lcp_sorter_type = stxxl::sorter<lcp_pair_type, lcp_less_type>;
+    lcp_sorter_type lcp_sorter(lcp_less_type(), mem / 2);
+
+    {
+        const std::vector<alphabet_type> text(text_begin, text_end);
+
+        size_type h = 0; // current height
+        size_type i = 0; // ISA index counter
+
+        lcp_sorter.push(lcp_pair_type(0, 0));
+
+        while (!isa_sort.empty()) {
+            const offset_type k = std::get<1>(*isa_sort);   // k = ISA[i]
+
+            if (k > offset_type(0)) {
+                const size_type j = std::get<2>(*isa_sort); // j = SA[k-1]
+
+                while (i + h < text.size() && j + h < text.size() &&
+                       text[i + h] == text[j + h])
+                    h++;
+
+                lcp_sorter.push(lcp_pair_type(k, static_cast<lcp_type>(h)));
+            }
+            if (h > 0) h--;
+
+            ++isa_sort, ++i;
+        }
+    }
+
+    lcp.resize(sa.size());
+    lcp_sorter.sort();
+
+    stream::choose<lcp_sorter_type, 1> lcp_stream(lcp_sorter);
+    stream::materialize(lcp_stream, lcp.begin(), lcp.end());
+}
+
+/// Burrows-Wheeler transform from the final DC3 merge.
+
+/*!
+ * Run DC3 on the text [text_begin, text_end) and call consumer(sa, prev) for
+ * each suffix in lexicographic order, where prev is the character preceding
+ * the suffix sa plus one, or zero for sa = 0. The preceding characters are
+ * carried through the sorts of the top recursion level only, hence the BWT
+ * is available while the suffix array is merged, without another pass.
+ * Texts shorter than three characters are sorted in internal memory.
+ */
+template <typename offset_type, typename TextIterator, typename Consumer>
+void dc3_with_preceding(TextIterator text_begin, TextIterator text_end,
+                        size_t mem, Consumer&& consumer)
+{
+    using alphabet_type = typename std::iterator_traits<TextIterator>::value_type;
+
+    const size_type n = static_cast<size_type>(text_end - text_begin);
+
+    if (n < 3)
+    {
+        const std::vector<alphabet_type> text(text_begin, text_end);
+        std::vector<offset_type> sa;
+        for (size_type i = 0; i < n; ++i)
+            sa.push_back(offset_type(i));
+        std::sort(sa.begin(), sa.end(),
+                  [&text](const offset_type& a, const offset_type& b) {
+                      return std::lexicographical_compare(
+                          text.begin() + a, text.end(), text.begin() + b, text.end());
+                  });
+        for (const offset_type& i : sa)
+            consumer(i, i ? offset_type(text[i - 1]) + 1 : offset_type(0));
+        return;
+    }
+
+    auto text = stream::streamify(text_begin, text_end);
+    using text_stream_type = decltype(text);
+    using skew_type = typename skew<offset_type>::template algorithm<text_stream_type, true>;
+
+    for (skew_type skew(text, mem); !skew.empty(); ++skew)
+        consumer(*skew, skew.preceding());
+}
+
+//! Throw if the text is too long for the offset type of DC3.
+template <typename offset_type>
+void check_text_length(size_type n, const char* function)
+{
+    if (n + 3 >= static_cast<size_type>(std::numeric_limits<offset_type>::max()))
+        throw foxxll::bad_parameter(
+                  std::string(function) + ": text is too long for the offset type");
+}
+
+} // namespace suffix_array_local
+
+/*!
+ * Construct the suffix array of the text [text_begin, text_end) in external
+ * memory: sa[k] is the position of the k-th smallest suffix. The text may be
+ * given by iterators of an stxxl::vector or of an internal container, its
+ * characters must be integers smaller than the maximum of sa's value_type,
+ * and sa must be an stxxl::vector. It is resized to the length of the text,
+ * which must be smaller than the maximum of its value_type minus three.
+ *
+ * With suffix_array_algorithm::automatic, prefix doubling is used if the
+ * sorts of its rounds fit into M, since it then needs only a few scans for
+ * texts without long repeats, and DC3 otherwise, whose I/O volume does not
+ * depend on the text. The sorts of both run in parallel with STXXL_PARALLEL.
+ *
+ * \param text_begin begin of the text
+ * \param text_end end of the text
+ * \param sa vector receiving the suffix array
+ * \param M internal memory to use in bytes
+ * \param algo construction algorithm
+ */
+template <typename TextIterator, typename SAVector>
+void suffix_array(TextIterator text_begin, TextIterator text_end, SAVector& sa,
+                  size_t M,
+                  suffix_array_algorithm algo = suffix_array_algorithm::automatic)
+{
+    using offset_type = typename SAVector::value_type;
+    using triple_type = typename suffix_array_local::prefix_doubling<offset_type>::triple_type;
+
+    const external_size_type n = static_cast<external_size_type>(text_end - text_begin);
+    if (n + 3 >= static_cast<external_size_type>(std::numeric_limits<offset_type>::max()))
+        throw foxxll::bad_parameter("stxxl::suffix_array(): text is too long for the suffix array's value type");
+
+    sa.resize(n);
+    if (n == 0)
+        return;
+
+    // DC3 needs at least three positions for its mod 0, 1 and 2 tuples
+    if (algo == suffix_array_algorithm::automatic)
+        algo = (n < 3 || n * sizeof(triple_type) <= M / 2)
+               ? suffix_array_algorithm::prefix_doubling
+               : suffix_array_algorithm::dc3;
+    else if (n < 3)
+        algo = suffix_array_algorithm::prefix_doubling;
+
+    auto text = stream::streamify(text_begin, text_end);
+
+    if (algo == suffix_array_algorithm::dc3)
+    {
+        TLX_LOGC(suffix_array_local::debug) << "suffix_array(): DC3 of " << n << " characters";
+        using text_stream_type = decltype(text);
+        using skew_type = typename suffix_array_local::skew<offset_type>::template algorithm<text_stream_type>;
+        skew_type skew(text, M);
+        stream::materialize(skew, sa.begin(), sa.end());
+    }
+    else
+    {
+        TLX_LOGC(suffix_array_local::debug) << "suffix_array(): prefix doubling of " << n << " characters";
+        suffix_array_local::prefix_doubling<offset_type>::construct(text, n, sa, M);
+    }
+}
+
+/*!
+ * Construct the suffix array and the LCP array of the text [text_begin,
+ * text_end) in external memory: lcp[k] is the length of the longest common
+ * prefix of the suffixes sa[k-1] and sa[k], and lcp[0] = 0. The LCP array is
+ * computed from the suffix array by Kasai's algorithm, which holds the text
+ * in internal memory in addition to M. See suffix_array() for the other
+ * parameters.
+ *
+ * \param text_begin begin of the text
+ * \param text_end end of the text
+ * \param sa vector receiving the suffix array
+ * \param lcp vector receiving the LCP array
+ * \param M internal memory to use in bytes
+ * \param algo construction algorithm of the suffix array
+ */
+template <typename TextIterator, typename SAVector, typename LCPVector>
+void suffix_array(TextIterator text_begin, TextIterator text_end, SAVector& sa,
+                  LCPVector& lcp, size_t M,
+                  suffix_array_algorithm algo = suffix_array_algorithm::automatic)
+{
+    suffix_array(text_begin, text_end, sa, M, algo);
+    if (sa.empty()) {
+        lcp.clear();
+        return;
+    }
+    suffix_array_local::lcp_kasai(text_begin, text_end, sa, lcp, M);
+}
+
+/*!
+ * Compute the suffix array and the Burrows-Wheeler transform of the text
+ * [text_begin, text_end) with DC3, writing both while the suffix array is
+ * merged. Row zero of the BWT matrix is the rotation starting with the
+ * sentinel, which is smaller than all characters, and row k + 1 the suffix
+ * sa[k]. As in bwt of libdivsufsort, bwt holds the last column without the
+ * sentinel, that is bwt[0] is the last character of the text and the
+ * sentinel is omitted at the returned primary index. See suffix_array() for
+ * the requirements on the text and the vectors.
+ *
+ * \param text_begin begin of the text
+ * \param text_end end of the text
+ * \param sa vector receiving the suffix array
+ * \param bwt vector receiving the transform, of the text's character type
+ * \param M internal memory to use in bytes
+ * eturn row of the suffix at position zero, or zero for an empty text
+ */
+template <typename TextIterator, typename SAVector, typename BWTVector>
+external_size_type
+burrows_wheeler_transform(TextIterator text_begin, TextIterator text_end,
+                          SAVector& sa, BWTVector& bwt, size_t M)
+{
+    using offset_type = typename SAVector::value_type;
+    using alphabet_type = typename BWTVector::value_type;
+
+    const external_size_type n = static_cast<external_size_type>(text_end - text_begin);
+    suffix_array_local::check_text_length<offset_type>(n, "stxxl::burrows_wheeler_transform()");
+
+    sa.clear();
+    bwt.clear();
+    if (n == 0)
+        return 0;
+
+    typename SAVector::bufwriter_type sa_writer(sa);
+    typename BWTVector::bufwriter_type bwt_writer(bwt);
+
+    // row of the sentinel, preceded by the last character
+    bwt_writer << static_cast<alphabet_type>(*(text_end - 1));
+
+    external_size_type row = 0, primary = 0;
+    suffix_array_local::dc3_with_preceding<offset_type>(
+        text_begin, text_end, M,
+        [&](const offset_type& pos, const offset_type& prev) {
+            sa_writer << pos;
+            ++row;
+            if (prev == offset_type(0))
+                primary = row;
+            else
+                bwt_writer << static_cast<alphabet_type>(prev - 1);
+        });
+
+    sa_writer.finish();
+    bwt_writer.finish();
+
+    return primary;
+}
+
+/*!
+ * Compute the Burrows-Wheeler transform of the text [text_begin, text_end)
+ * with DC3 without storing the suffix array, see the overload above.
+ * OffsetType is the type of the positions used by DC3.
+ *
+ * \param text_begin begin of the text
+ * \param text_end end of the text
+ * \param bwt vector receiving the transform, of the text's character type
+ * \param M internal memory to use in bytes
+ * eturn row of the suffix at position zero, or zero for an empty text
+ */
+template <typename OffsetType = external_size_type,
+          typename TextIterator, typename BWTVector>
+external_size_type
+burrows_wheeler_transform(TextIterator text_begin, TextIterator text_end,
+                          BWTVector& bwt, size_t M)
+{
+    using alphabet_type = typename BWTVector::value_type;
+
+    const external_size_type n = static_cast<external_size_type>(text_end - text_begin);
+    suffix_array_local::check_text_length<OffsetType>(n, "stxxl::burrows_wheeler_transform()");
+
+    bwt.clear();
+    if (n == 0)
+        return 0;
+
+    typename BWTVector::bufwriter_type bwt_writer(bwt);
+    bwt_writer << static_cast<alphabet_type>(*(text_end - 1));
+
+    external_size_type row = 0, primary = 0;
+    suffix_array_local::dc3_with_preceding<OffsetType>(
+        text_begin, text_end, M,
+        [&](const OffsetType& /* pos */, const OffsetType& prev) {
+            ++row;
+            if (prev == OffsetType(0))
+                primary = row;
+            else
+                bwt_writer << static_cast<alphabet_type>(prev - 1);
+        });
+
+    bwt_writer.finish();
+
+    return primary;
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_SUFFIX_ARRAY_HEADER
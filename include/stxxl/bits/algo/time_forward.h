@@ -0,0 +1,338 @@
+/***************************************************************************
+ *  include/stxxl/bits/algo/time_forward.h
+ *
+ *  Time-forward processing as described in Yi-Jen Chiang et al.
+ *  "External-Memory Graph Algorithms". SODA 1995, on the bulk-limit
+ *  operations of the parallel_priority_queue.
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_ALGO_TIME_FORWARD_HEADER
+#define STXXL_ALGO_TIME_FORWARD_HEADER
+
+#if STXXL_PARALLEL
+    #include <omp.h>
+#endif
+
+#include <atomic>
+#include <exception>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+
+#include <stxxl/bits/config.h>
+#include <stxxl/bits/containers/parallel_priority_queue.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlalgo
+//! \{
+
+namespace time_forward_local {
+
+//! A message in flight to the node target.
+template <typename Node, typename Msg>
+struct envelope
+{
+    Node target;
+    Msg message;
+
+    friend std::ostream& operator << (std::ostream& os, const envelope& e)
+    {
+        return os << "(to " << e.target << ")";
+    }
+};
+
+//! Orders the envelopes such that the queue's top is the earliest target.
+template <typename Node, typename Msg>
+struct envelope_compare
+{
+    bool operator () (const envelope<Node, Msg>& a, const envelope<Node, Msg>& b) const
+    {
+        return a.target > b.target;
+    }
+};
+
+} // namespace time_forward_local
+
+/*!
+ * Time-forward processing: evaluates the nodes 0, 1, 2, ... of a DAG in their
+ * topological numbering, where each node receives the messages sent to it by
+ * earlier nodes and sends messages to later ones. The messages in flight are
+ * kept in a parallel_priority_queue ordered by their target.
+ *
+ * The nodes are evaluated in batches of consecutive ids: step() opens a
+ * bulk-limit window of the queue at the end of the batch, extracts all
+ * messages of the batch, groups them by target and calls the user function
+ * on the nodes of the batch in parallel, each thread pushing the outgoing
+ * messages into its own insertion heap inside the window. Hence a node must
+ * only send to nodes after the end of its batch, and the nodes of a batch
+ * are evaluated independently, e.g. when the batches are the levels of the
+ * DAG. run() evaluates all nodes in batches of a fixed size.
+ *
+ * The messages of a batch are held in internal memory in addition to the
+ * queue's memory. The messages of a node are delivered in arbitrary order.
+ *
+ * \tparam Node integral node id type
+ * \tparam Msg default constructible message type
+ */
+template <typename Node, typename Msg>
+class time_forward
+{
+    static_assert(std::is_integral<Node>::value, "time_forward requires integral node ids");
+
+    static constexpr bool debug = false;
+
+public:
+    //! \name Types
+    //! \{
+
+    using node_type = Node;
+    using message_type = Msg;
+    using size_type = external_size_type;
+
+    using envelope_type = time_forward_local::envelope<Node, Msg>;
+    using envelope_compare_type = time_forward_local::envelope_compare<Node, Msg>;
+    using queue_type = parallel_priority_queue<envelope_type, envelope_compare_type>;
+
+    //! iterator over the messages of a node
+    using message_iterator = typename std::vector<message_type>::const_iterator;
+
+    //! Sends the messages of the nodes evaluated by one thread.
+    class sender
+    {
+        time_forward& m_tf;
+        size_t m_heap;
+
+    public:
+        sender(time_forward& tf, size_t heap) : m_tf(tf), m_heap(heap) { }
+
+        /*!
+         * Send msg to the node target, which must not be before the end of the
+         * current batch.
+         */
+        void send(const node_type& target, const message_type& msg)
+        {
+            if (target < m_tf.m_batch_end)
+                throw foxxll::bad_parameter(
+                          "stxxl::time_forward::sender::send(): target is not after the current batch");
+            m_tf.m_queue.limit_push(envelope_type { target, msg }, m_heap);
+            ++m_tf.m_sent[m_heap];
+        }
+    };
+
+    //! \}
+
+protected:
+    //! number of threads evaluating a batch and of insertion heaps
+    size_t m_num_threads;
+
+    //! the messages in flight
+    queue_type m_queue;
+
+    //! first node not yet evaluated
+    node_type m_next;
+
+    //! end of the batch being evaluated, m_next outside of step()
+    node_type m_batch_end;
+
+    //! messages pushed into each insertion heap in the current batch
+    std::vector<size_type> m_sent;
+
+    //! messages of the current batch, grouped by target
+    std::vector<message_type> m_messages;
+
+    //! first message of each node of the current batch
+    std::vector<size_t> m_offsets;
+
+public:
+    //! \name Constructors
+    //! \{
+
+    /*!
+     * Create an empty framework starting at node zero. The nodes of a batch
+     * are evaluated by omp_get_max_threads() threads, one per insertion heap
+     * of the priority queue.
+     *
+     * \param total_ram internal memory of the priority queue in bytes
+     */
+    explicit time_forward(size_type total_ram = 1024 * 1024 * 1024)
+        :
+#if STXXL_PARALLEL
+          m_num_threads(static_cast<size_t>(omp_get_max_threads())),
+#else
+          m_num_threads(1),
+#endif
+          m_queue(envelope_compare_type(), total_ram),
+          m_next(0), m_batch_end(0),
+          m_sent(m_num_threads, 0)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    time_forward(const time_forward&) = delete;
+    //! non-copyable: delete assignment operator
+    time_forward& operator = (const time_forward&) = delete;
+
+    //! \}
+
+    //! \name Properties
+    //! \{
+
+    //! first node not yet evaluated
+    const node_type & next_node() const
+    {
+        return m_next;
+    }
+
+    //! number of messages in flight
+    size_type size() const
+    {
+        return m_queue.size();
+    }
+
+    //! whether no messages are in flight
+    bool empty() const
+    {
+        return m_queue.empty();
+    }
+
+    //! threads evaluating the nodes of a batch
+    size_t num_threads() const
+    {
+        return m_num_threads;
+    }
+
+    //! \}
+
+    //! \name Evaluation
+    //! \{
+
+    //! Send msg to the node target, which must not be before next_node(),
+    //! outside of step(), e.g. the initial messages.
+    void push(const node_type& target, const message_type& msg)
+    {
+        if (target < m_next)
+            throw foxxll::bad_parameter(
+                      "stxxl::time_forward::push(): target was already evaluated");
+        m_queue.push(envelope_type { target, msg });
+    }
+
+    /*!
+     * Evaluate the batch of nodes [next_node(), batch_end) by calling
+     * function(node, begin, end, out) for each of them in parallel, where
+     * [begin, end) are the messages sent to node and out is a sender for the
+     * messages to nodes from batch_end on. Rethrows the first exception
+     * thrown by function, after the batch was evaluated, except for the
+     * remaining nodes of the throwing thread. Returns the number of messages
+     * delivered.
+     */
+    template <typename Function>
+    size_type step(const node_type& batch_end, Function function)
+    {
+        if (batch_end < m_next)
+            throw foxxll::bad_parameter(
+                      "stxxl::time_forward::step(): batch ends before next_node()");
+
+        const size_t batch_size = static_cast<size_t>(batch_end - m_next);
+
+        // extract the messages of the batch
+        m_batch_end = batch_end;
+        m_queue.limit_begin(envelope_type { batch_end, message_type() }, batch_size);
+
+        m_messages.clear();
+        m_offsets.assign(batch_size + 1, 0);
+        for (;;)
+        {
+            const envelope_type& top = m_queue.limit_top();
+            if (!(top.target < batch_end))
+                break;
+            ++m_offsets[static_cast<size_t>(top.target - m_next) + 1];
+            m_messages.push_back(top.message);
+            m_queue.limit_pop();
+        }
+        for (size_t i = 0; i < batch_size; ++i)
+            m_offsets[i + 1] += m_offsets[i];
+
+        // evaluate the nodes
+        std::vector<std::exception_ptr> errors(m_num_threads);
+        std::fill(m_sent.begin(), m_sent.end(), 0);
+
+#if STXXL_PARALLEL
+#pragma omp parallel for num_threads(m_num_threads) schedule(dynamic, 64)
+#endif
+        for (size_t i = 0; i < batch_size; ++i)
+        {
+#if STXXL_PARALLEL
+            const size_t thread = static_cast<size_t>(omp_get_thread_num());
+#else
+            const size_t thread = 0;
+#endif
+            if (errors[thread])
+                continue;
+            try
+            {
+                sender out(*this, thread);
+                function(static_cast<node_type>(m_next + i),
+                         m_messages.cbegin() + m_offsets[i],
+                         m_messages.cbegin() + m_offsets[i + 1], out);
+            }
+            catch (...)
+            {
+                errors[thread] = std::current_exception();
+            }
+        }
+
+        m_queue.limit_end();
+        m_next = m_batch_end;
+
+        size_type sent = 0;
+        for (const size_type& s : m_sent)
+            sent += s;
+        TLX_LOG << "time_forward::step(): batch of " << batch_size << " nodes received "
+                << m_messages.size() << " and sent " << sent << " messages";
+
+        for (std::exception_ptr& error : errors)
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
+        return m_messages.size();
+    }
+
+    /*!
+     * Evaluate the nodes [next_node(), num_nodes) in batches of batch_size
+     * consecutive nodes with step(). Messages to nodes from num_nodes on stay
+     * in flight.
+     */
+    template <typename Function>
+    void run(const node_type& num_nodes, const node_type& batch_size, Function function)
+    {
+        if (batch_size <= 0)
+            throw foxxll::bad_parameter("stxxl::time_forward::run(): batch_size must be positive");
+
+        while (m_next < num_nodes)
+        {
+            const node_type end = (num_nodes - m_next > batch_size)
+                                  ? static_cast<node_type>(m_next + batch_size) : num_nodes;
+            step(end, function);
+        }
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_ALGO_TIME_FORWARD_HEADER
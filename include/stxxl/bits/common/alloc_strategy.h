@@ -0,0 +1,386 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/alloc_strategy.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_ALLOC_STRATEGY_HEADER
+#define STXXL_COMMON_ALLOC_STRATEGY_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/mng/block_alloc_strategy.hpp>
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/common/settings.h>
+#include <stxxl/bits/common/seed.h>
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Measured speeds of the configured disks, from which weighted_striping
+ * derives the share of blocks each disk gets.
+ *
+ * The speeds are measured by <tt>stxxl_tool calibrate_disks</tt>, which writes
+ * them to a file. The file is loaded by load(), or on first use from the path
+ * in the environment variable STXXL_DISK_WEIGHTS. Each line holds the index
+ * of a disk in the configuration and its read and write throughput in bytes
+ * per second, lines starting with '#' are comments.
+ */
+class disk_weights
+{
+    mutable std::mutex m_mutex;
+
+    //! read and write throughput of each disk in bytes/s, zero if unknown
+    std::vector<double> m_read, m_write;
+
+    //! fraction of the shares given by the capacity instead of the speed
+    double m_space_weight;
+
+    disk_weights()
+        : m_space_weight(0.0)
+    {
+        if (const char* path = getenv("STXXL_DISK_WEIGHTS"))
+        {
+            try {
+                load(path);
+            }
+            catch (const foxxll::io_error& e) {
+                TLX_LOG1 << "disk_weights: ignoring STXXL_DISK_WEIGHTS: " << e.what();
+            }
+        }
+    }
+
+public:
+    //! non-copyable: delete copy-constructor
+    disk_weights(const disk_weights&) = delete;
+    //! non-copyable: delete assignment operator
+    disk_weights& operator = (const disk_weights&) = delete;
+
+    static disk_weights& get_instance()
+    {
+        static disk_weights instance;
+        return instance;
+    }
+
+    //! Set the measured throughput of disk in bytes per second.
+    void set_speed(size_t disk, double read_speed, double write_speed)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (disk >= m_read.size())
+        {
+            m_read.resize(disk + 1, 0.0);
+            m_write.resize(disk + 1, 0.0);
+        }
+        m_read[disk] = read_speed;
+        m_write[disk] = write_speed;
+    }
+
+    //! Mean of the read and write throughput of disk, zero if unknown.
+    double speed(size_t disk) const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return disk < m_read.size() ? (m_read[disk] + m_write[disk]) / 2 : 0.0;
+    }
+
+    //! Set the fraction in [0,1] of the shares given by the capacity of the
+    //! disks instead of their speed, default 0. Raising it lets small fast
+    //! disks fill up later.
+    void set_space_weight(double space_weight)
+    {
+        assert(space_weight >= 0.0 && space_weight <= 1.0);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_space_weight = space_weight;
+    }
+
+    double space_weight() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_space_weight;
+    }
+
+    //! Forget all speeds.
+    void clear()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_read.clear();
+        m_write.clear();
+    }
+
+    //! Load speeds written by save(), replacing those of the disks listed.
+    void load(const std::string& path)
+    {
+        std::ifstream in(path.c_str());
+        if (!in.good())
+            FOXXLL_THROW_ERRNO(foxxll::io_error,
+                               "disk_weights: cannot open " << path);
+
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream ls(line);
+            size_t disk;
+            double read_speed, write_speed;
+            if (!(ls >> disk >> read_speed >> write_speed))
+                FOXXLL_THROW_ERRNO(foxxll::io_error,
+                                   "disk_weights: invalid line in " << path << ": " << line);
+            set_speed(disk, read_speed, write_speed);
+        }
+    }
+
+    //! Save the speeds to path, with the disk paths as comments.
+    void save(const std::string& path) const
+    {
+        std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+        if (!out.good())
+            FOXXLL_THROW_ERRNO(foxxll::io_error,
+                               "disk_weights: cannot create " << path);
+
+        foxxll::config* cfg = foxxll::config::get_instance();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        out << "# disk read_bytes_per_s write_bytes_per_s" << std::endl;
+        for (size_t d = 0; d < m_read.size(); ++d)
+        {
+            if (d < cfg->disks_number())
+                out << "# " << cfg->disk(d).path << std::endl;
+            out << d << ' ' << m_read[d] << ' ' << m_write[d] << std::endl;
+        }
+    }
+
+    /*!
+     * Shares of the disks [begin, end) of the blocks, which sum to one: the
+     * speed of each disk relative to the sum of their speeds, mixed with its
+     * relative capacity by space_weight(). Disks without measured speed get
+     * the mean speed of the others, all disks are equally fast if none was
+     * measured.
+     */
+    std::vector<double> shares(size_t begin, size_t end) const
+    {
+        assert(begin < end);
+        const size_t n = end - begin;
+
+        std::vector<double> speeds(n), capacities(n);
+        foxxll::config* cfg = foxxll::config::get_instance();
+        for (size_t i = 0; i < n; ++i)
+        {
+            speeds[i] = speed(begin + i);
+            capacities[i] = begin + i < cfg->disks_number()
+                            ? static_cast<double>(cfg->disk(begin + i).size) : 0.0;
+        }
+
+        // fill in unknown values with the mean of the known ones
+        auto normalize =
+            [](std::vector<double>& v) {
+                double sum = 0;
+                size_t known = 0;
+                for (double x : v)
+                    sum += x, known += (x > 0);
+                const double mean = known ? sum / static_cast<double>(known) : 1.0;
+                for (double& x : v)
+                {
+                    if (!(x > 0))
+                        x = mean, sum += mean;
+                }
+                for (double& x : v)
+                    x /= sum;
+            };
+        normalize(speeds);
+        normalize(capacities);
+
+        const double alpha = space_weight();
+        std::vector<double> result(n);
+        for (size_t i = 0; i < n; ++i)
+            result[i] = (1.0 - alpha) * speeds[i] + alpha * capacities[i];
+        return result;
+    }
+};
+
+/*!
+ * Allocation strategy distributing the blocks to the disks in the proportion
+ * of their speed and capacity, see disk_weights, e.g. to let an SSD and an
+ * HDD both work at their full throughput instead of the SSD waiting for the
+ * HDD as with striping.
+ *
+ * The disks are assigned by a fixed interleaved sequence, in which each disk
+ * appears according to its share, started at a random position per strategy
+ * object similar to foxxll::random_cyclic.
+ */
+class weighted_striping
+{
+    //! first disk
+    size_t m_begin;
+    //! sequence of the disks relative to m_begin, shared between copies
+    std::shared_ptr<const std::vector<uint16_t> > m_sequence;
+    //! start position in the sequence
+    size_t m_offset;
+
+    //! slots of the sequence per disk, the resolution of the shares
+    static constexpr size_t slots_per_disk = 64;
+
+    void init(size_t begin, size_t end)
+    {
+        const std::vector<double> shares = disk_weights::get_instance().shares(begin, end);
+        const size_t n = shares.size();
+        std::vector<uint16_t> sequence(slots_per_disk * n);
+
+        // smooth weighted round robin: each slot goes to the disk furthest
+        // behind its share, which interleaves the disks evenly
+        std::vector<double> credit(n, 0.0);
+        for (uint16_t& slot : sequence)
+        {
+            size_t best = 0;
+            for (size_t d = 0; d < n; ++d)
+            {
+                credit[d] += shares[d];
+                if (credit[d] > credit[best])
+                    best = d;
+            }
+            credit[best] -= 1.0;
+            slot = static_cast<uint16_t>(best);
+        }
+
+        m_begin = begin;
+        m_sequence = std::make_shared<const std::vector<uint16_t> >(std::move(sequence));
+        m_offset = seed_sequence::get_ref().get_next_seed() % m_sequence->size();
+    }
+
+public:
+    //! Distribute to the disks [begin, end).
+    weighted_striping(size_t begin, size_t end)
+    {
+        init(begin, end);
+    }
+
+    //! Distribute to all disks.
+    weighted_striping()
+    {
+        init(0, foxxll::config::get_instance()->disks_number());
+    }
+
+    size_t operator () (size_t i) const
+    {
+        const std::vector<uint16_t>& seq = *m_sequence;
+        return m_begin + seq[(m_offset + i) % seq.size()];
+    }
+
+    static const char * name()
+    {
+        return "weighted striping by disk speed and capacity";
+    }
+};
+
+/*!
+ * Allocation strategy chosen at run time by SETTINGS::alloc_strategy when the
+ * strategy object is constructed, instead of by the template parameter. It
+ * is the default allocation strategy of stxxl::vector, sorter,
+ * parallel_priority_queue and the stream sorters, and costs one virtual call
+ * per allocated block.
+ */
+class runtime_alloc_strategy
+{
+    struct base_type
+    {
+        virtual ~base_type() { }
+        virtual size_t operator () (size_t i) const = 0;
+        virtual const char * name() const = 0;
+    };
+
+    template <typename Strategy>
+    struct impl_type : public base_type
+    {
+        Strategy strategy;
+
+        impl_type() = default;
+
+        impl_type(size_t begin, size_t end)
+            : strategy(begin, end)
+        { }
+
+        size_t operator () (size_t i) const final
+        {
+            return strategy(i);
+        }
+
+        const char * name() const final
+        {
+            return Strategy::name();
+        }
+    };
+
+    std::shared_ptr<const base_type> m_impl;
+
+    template <typename... Args>
+    static std::shared_ptr<const base_type>
+    make(alloc_strategy_kind kind, Args... args)
+    {
+        switch (kind) {
+        case alloc_strategy_kind::striping:
+            return std::make_shared<impl_type<foxxll::striping> >(args...);
+        case alloc_strategy_kind::fully_random:
+            return std::make_shared<impl_type<foxxll::fully_random> >(args...);
+        case alloc_strategy_kind::simple_random:
+            return std::make_shared<impl_type<foxxll::simple_random> >(args...);
+        case alloc_strategy_kind::random_cyclic:
+            return std::make_shared<impl_type<foxxll::random_cyclic> >(args...);
+        case alloc_strategy_kind::weighted:
+            return std::make_shared<impl_type<weighted_striping> >(args...);
+        case alloc_strategy_kind::default_strategy:
+        default:
+            return std::make_shared<impl_type<foxxll::default_alloc_strategy> >(args...);
+        }
+    }
+
+public:
+    //! Strategy of SETTINGS::alloc_strategy over all disks.
+    runtime_alloc_strategy()
+        : m_impl(make(SETTINGS::alloc_strategy))
+    { }
+
+    //! Strategy of SETTINGS::alloc_strategy over the disks [begin, end).
+    runtime_alloc_strategy(size_t begin, size_t end)
+        : m_impl(make(SETTINGS::alloc_strategy, begin, end))
+    { }
+
+    //! Strategy of the given kind over all disks.
+    explicit runtime_alloc_strategy(alloc_strategy_kind kind)
+        : m_impl(make(kind))
+    { }
+
+    size_t operator () (size_t i) const
+    {
+        return (*m_impl)(i);
+    }
+
+    //! Name of the chosen strategy.
+    const char * name() const
+    {
+        return m_impl->name();
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_ALLOC_STRATEGY_HEADER
@@ -0,0 +1,416 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/arena.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_ARENA_HEADER
+#define STXXL_COMMON_ARENA_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include <tlx/math/integer_log2.hpp>
+
+#include <stxxl/bits/common/block_array.h>
+#include <stxxl/bits/common/settings.h>
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Slab allocator for the internal buffers of containers, which accounts for
+ * their memory exactly and frees it in one shot.
+ *
+ * Requests of up to a quarter slab are rounded up to a power of two size
+ * class and carved from slabs of slab_size bytes, which are backed by huge
+ * pages if requested and possible. Freed chunks are kept on free lists of
+ * their size class and reused, never returned to the heap, hence the arena
+ * does not fragment the heap and its footprint is bounded by its capacity.
+ * Larger requests get a mapping of their own.
+ *
+ * Each thread allocates from one of several shards, which have their own
+ * free lists, current slab and lock, such that concurrent threads rarely
+ * contend.
+ *
+ * The capacity is the memory budget of the containers using the arena: if
+ * reserving another slab would exceed it, allocate() throws std::bad_alloc.
+ * The destructor or release() frees all slabs, whether or not their chunks
+ * were deallocated.
+ */
+class arena
+{
+public:
+    //! capacity of an arena without budget
+    static constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+
+    //! smallest size class
+    static constexpr size_t min_chunk_size = 16;
+
+private:
+    //! chunk on a free list, stored in the chunk itself
+    struct free_chunk
+    {
+        free_chunk* next;
+    };
+
+    //! allocation state of one group of threads
+    struct shard_type
+    {
+        std::mutex mutex;
+        //! free list of each size class
+        std::vector<free_chunk*> free;
+        //! unused rest of the current slab
+        char* bump = nullptr;
+        char* bump_end = nullptr;
+    };
+
+    //! slab or large allocation
+    struct mapping_type
+    {
+        void* ptr;
+        size_t bytes;
+        bool huge;
+    };
+
+    size_t m_capacity;
+    size_t m_slab_size;
+    bool m_huge_pages;
+
+    //! number of size classes, chunks of class c have min_chunk_size << c bytes
+    size_t m_num_classes;
+
+    std::vector<shard_type> m_shards;
+
+    //! all slabs, and the large allocations by address
+    std::mutex m_mutex;
+    std::vector<mapping_type> m_slabs;
+    std::unordered_map<void*, mapping_type> m_large;
+
+    //! bytes of slabs and large allocations
+    std::atomic<size_t> m_reserved;
+    //! bytes handed out, rounded up to the size classes
+    std::atomic<size_t> m_allocated;
+    std::atomic<size_t> m_peak;
+
+    //! Shard of the calling thread, threads are assigned round robin.
+    shard_type& my_shard()
+    {
+        static std::atomic<size_t> next_thread { 0 };
+        static thread_local size_t thread_id = next_thread++;
+        return m_shards[thread_id % m_shards.size()];
+    }
+
+    size_t size_class(size_t bytes) const
+    {
+        if (bytes <= min_chunk_size)
+            return 0;
+        return tlx::integer_log2_ceil(bytes) - tlx::integer_log2_floor(min_chunk_size);
+    }
+
+    //! Reserve bytes of the capacity, or throw std::bad_alloc.
+    void reserve(size_t bytes)
+    {
+        size_t reserved = m_reserved.load();
+        do {
+            if (bytes > m_capacity || reserved > m_capacity - bytes)
+                throw std::bad_alloc();
+        } while (!m_reserved.compare_exchange_weak(reserved, reserved + bytes));
+    }
+
+    //! Map bytes of memory, with huge pages if enabled.
+    mapping_type map(size_t bytes)
+    {
+        reserve(bytes);
+#if STXXL_HAVE_HUGE_PAGES
+        if (m_huge_pages && bytes >= block_array_local::huge_page_size)
+        {
+            if (void* p = block_array_local::map_huge_pages(bytes))
+                return mapping_type { p, bytes, true };
+        }
+#endif
+        try {
+            return mapping_type { ::operator new (bytes), bytes, false };
+        }
+        catch (...) {
+            m_reserved -= bytes;
+            throw;
+        }
+    }
+
+    void unmap(const mapping_type& m)
+    {
+#if STXXL_HAVE_HUGE_PAGES
+        if (m.huge)
+        {
+            munmap(m.ptr, block_array_local::mapping_registry::get_instance().erase(m.ptr));
+            m_reserved -= m.bytes;
+            return;
+        }
+#endif
+        ::operator delete (m.ptr);
+        m_reserved -= m.bytes;
+    }
+
+    void count_allocation(size_t bytes)
+    {
+        const size_t allocated = (m_allocated += bytes);
+        size_t peak = m_peak.load();
+        while (peak < allocated && !m_peak.compare_exchange_weak(peak, allocated)) { }
+    }
+
+public:
+    /*!
+     * Create an arena.
+     *
+     * \param capacity bytes the slabs and large allocations may occupy
+     * \param slab_size bytes of a slab, a power of two, at least the huge page
+     * size for huge pages
+     * \param huge_pages back the slabs with huge pages if possible
+     * \param num_shards number of shards the threads are assigned to
+     */
+    explicit arena(size_t capacity = unlimited,
+                   size_t slab_size = 2 * 1024 * 1024,
+                   bool huge_pages = SETTINGS::huge_pages,
+                   size_t num_shards = 16)
+        : m_capacity(capacity), m_slab_size(slab_size), m_huge_pages(huge_pages),
+          m_shards(num_shards),
+          m_reserved(0), m_allocated(0), m_peak(0)
+    {
+        assert(num_shards > 0);
+        assert(slab_size >= 4 * min_chunk_size);
+        assert((slab_size & (slab_size - 1)) == 0);
+        m_num_classes = size_class(slab_size / 4) + 1;
+        for (shard_type& s : m_shards)
+            s.free.resize(m_num_classes, nullptr);
+    }
+
+    //! non-copyable: delete copy-constructor
+    arena(const arena&) = delete;
+    //! non-copyable: delete assignment operator
+    arena& operator = (const arena&) = delete;
+
+    //! Frees all memory of the arena.
+    ~arena()
+    {
+        release();
+    }
+
+    //! Allocate bytes, aligned like by operator new.
+    void * allocate(size_t bytes)
+    {
+        const size_t c = size_class(bytes);
+        if (c >= m_num_classes)
+        {
+            mapping_type m = map(bytes);
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_large.emplace(m.ptr, m);
+            }
+            count_allocation(bytes);
+            return m.ptr;
+        }
+
+        const size_t chunk_size = min_chunk_size << c;
+        shard_type& s = my_shard();
+        std::unique_lock<std::mutex> lock(s.mutex);
+
+        if (free_chunk* f = s.free[c])
+        {
+            s.free[c] = f->next;
+            count_allocation(chunk_size);
+            return f;
+        }
+
+        if (static_cast<size_t>(s.bump_end - s.bump) < chunk_size)
+        {
+            // the rest of the current slab is lost, less than a quarter slab
+            mapping_type m = map(m_slab_size);
+            {
+                std::unique_lock<std::mutex> global_lock(m_mutex);
+                m_slabs.push_back(m);
+            }
+            s.bump = static_cast<char*>(m.ptr);
+            s.bump_end = s.bump + m_slab_size;
+        }
+        void* p = s.bump;
+        s.bump += chunk_size;
+        count_allocation(chunk_size);
+        return p;
+    }
+
+    //! Return the memory p of bytes bytes allocated by allocate().
+    void deallocate(void* p, size_t bytes)
+    {
+        if (p == nullptr)
+            return;
+
+        const size_t c = size_class(bytes);
+        if (c >= m_num_classes)
+        {
+            mapping_type m;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                auto it = m_large.find(p);
+                assert(it != m_large.end());
+                m = it->second;
+                m_large.erase(it);
+            }
+            unmap(m);
+            m_allocated -= bytes;
+            return;
+        }
+
+        shard_type& s = my_shard();
+        std::unique_lock<std::mutex> lock(s.mutex);
+        free_chunk* f = static_cast<free_chunk*>(p);
+        f->next = s.free[c];
+        s.free[c] = f;
+        m_allocated -= min_chunk_size << c;
+    }
+
+    //! Free all memory of the arena, all allocations become invalid. Must
+    //! not run concurrently with allocations.
+    void release()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (shard_type& s : m_shards)
+        {
+            std::fill(s.free.begin(), s.free.end(), nullptr);
+            s.bump = s.bump_end = nullptr;
+        }
+        for (const mapping_type& m : m_slabs)
+            unmap(m);
+        m_slabs.clear();
+        for (const auto& m : m_large)
+            unmap(m.second);
+        m_large.clear();
+        m_allocated = 0;
+    }
+
+    //! Bytes handed out, rounded up to the size classes.
+    size_t allocated() const
+    {
+        return m_allocated;
+    }
+
+    //! Maximum of allocated() since construction.
+    size_t peak() const
+    {
+        return m_peak;
+    }
+
+    //! Bytes of the slabs and large allocations, at most capacity().
+    size_t reserved() const
+    {
+        return m_reserved;
+    }
+
+    //! Bytes the arena may reserve.
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+    //! Bytes of a slab.
+    size_t slab_size() const
+    {
+        return m_slab_size;
+    }
+};
+
+/*!
+ * Allocator allocating from an arena, for the allocator parameters of
+ * containers like stxxl::unordered_map. A default constructed allocator
+ * has no arena and allocates from the heap.
+ */
+template <typename ValueType>
+class arena_allocator
+{
+public:
+    using value_type = ValueType;
+    using pointer = value_type *;
+    using const_pointer = const value_type *;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using size_type = size_t;
+    using difference_type = std::ptrdiff_t;
+
+    template <typename Other>
+    struct rebind
+    {
+        using other = arena_allocator<Other>;
+    };
+
+private:
+    arena* m_arena;
+
+public:
+    //! Allocator without arena, which allocates from the heap.
+    arena_allocator() noexcept
+        : m_arena(nullptr)
+    { }
+
+    //! Allocator allocating from a, which must outlive the allocations.
+    explicit arena_allocator(arena& a) noexcept
+        : m_arena(&a)
+    { }
+
+    template <typename Other>
+    arena_allocator(const arena_allocator<Other>& other) noexcept
+        : m_arena(other.get_arena())
+    { }
+
+    pointer allocate(size_type n)
+    {
+        if (m_arena == nullptr)
+            return static_cast<pointer>(::operator new (n * sizeof(value_type)));
+        return static_cast<pointer>(m_arena->allocate(n * sizeof(value_type)));
+    }
+
+    void deallocate(pointer p, size_type n)
+    {
+        if (m_arena == nullptr)
+            ::operator delete (p);
+        else
+            m_arena->deallocate(p, n * sizeof(value_type));
+    }
+
+    //! The arena of the allocator, or nullptr.
+    arena * get_arena() const
+    {
+        return m_arena;
+    }
+
+    template <typename Other>
+    bool operator == (const arena_allocator<Other>& other) const
+    {
+        return m_arena == other.get_arena();
+    }
+
+    template <typename Other>
+    bool operator != (const arena_allocator<Other>& other) const
+    {
+        return m_arena != other.get_arena();
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_ARENA_HEADER
@@ -19,17 +19,24 @@
 #define STXXL_COMMON_BINARY_BUFFER_HEADER
 
 #include <tlx/define.hpp>
+#include <tlx/math/ctz.hpp>
 
 #include <foxxll/common/types.hpp>
 #include <foxxll/common/utils.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace stxxl {
 
 //! \addtogroup support
@@ -477,6 +484,90 @@ public:
     }
 };
 
+namespace binary_buffer_local {
+
+//! Decode one varint with up to 32-bit at p, for which at least five bytes
+//! are readable, and advance p.
+inline uint32_t decode_varint(const uint8_t*& p)
+{
+    uint32_t u, v = *p++;
+    if (!(v & 0x80)) return v;
+    v &= 0x7F;
+    u = *p++, v |= (u & 0x7F) << 7;
+    if (!(u & 0x80)) return v;
+    u = *p++, v |= (u & 0x7F) << 14;
+    if (!(u & 0x80)) return v;
+    u = *p++, v |= (u & 0x7F) << 21;
+    if (!(u & 0x80)) return v;
+    u = *p++;
+    if (u & 0xF0)
+        throw std::overflow_error("Overflow during varint decoding.");
+    v |= (u & 0x7F) << 28;
+    return v;
+}
+
+/*!
+ * Decode up to n consecutive varints with up to 32-bit from [p,end) into
+ * out, as written by binary_buffer::put_varint(), and advance p. Stops before
+ * a varint which is incomplete in [p,end).
+ *
+ * With SSE2, sixteen bytes are tested at once and runs of one byte varints,
+ * the common case for deltas and lengths, are widened without branches.
+ *
+ * \return number of varints decoded
+ */
+inline size_t decode_varints(
+    const uint8_t*& p, const uint8_t* end, uint32_t* out, size_t n)
+{
+    size_t i = 0;
+    while (i < n)
+    {
+#if defined(__SSE2__)
+        if (n - i >= 16 && end - p >= 16)
+        {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(x));
+            if (mask == 0)
+            {
+                const __m128i zero = _mm_setzero_si128();
+                const __m128i lo = _mm_unpacklo_epi8(x, zero);
+                const __m128i hi = _mm_unpackhi_epi8(x, zero);
+                __m128i* o = reinterpret_cast<__m128i*>(out + i);
+                _mm_storeu_si128(o + 0, _mm_unpacklo_epi16(lo, zero));
+                _mm_storeu_si128(o + 1, _mm_unpackhi_epi16(lo, zero));
+                _mm_storeu_si128(o + 2, _mm_unpacklo_epi16(hi, zero));
+                _mm_storeu_si128(o + 3, _mm_unpackhi_epi16(hi, zero));
+                p += 16, i += 16;
+                continue;
+            }
+            // the one byte varints before the first continuation bit
+            for (unsigned k = tlx::ctz(mask); k != 0; --k)
+                out[i++] = *p++;
+        }
+#endif
+        if (end - p >= 5)
+        {
+            out[i++] = decode_varint(p);
+            continue;
+        }
+
+        // near the end: decode only if the varint is complete
+        const uint8_t* q = p;
+        while (q != end && (*q & 0x80))
+            ++q;
+        if (q == end)
+            break;
+        uint8_t tmp[5] = { 0, 0, 0, 0, 0 };
+        memcpy(tmp, p, static_cast<size_t>(q + 1 - p));
+        const uint8_t* t = tmp;
+        out[i++] = decode_varint(t);
+        p = q + 1;
+    }
+    return i;
+}
+
+} // namespace binary_buffer_local
+
 /*!
  * binary_reader represents a binary_buffer_ref with an additional cursor with which
  * the memory can be read incrementally.
@@ -627,6 +718,20 @@ public:
         return v;
     }
 
+    //! Fetch n consecutive varints with up to 32-bit, as written by
+    //! put_varint(), from the buffer into out. Faster than n calls of
+    //! get_varint(), see binary_buffer_local::decode_varints().
+    binary_reader & get_varint_array(uint32_t* out, size_t n)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(m_data + m_curr);
+        const uint8_t* end = reinterpret_cast<const uint8_t*>(m_data + m_size);
+        const size_t done = binary_buffer_local::decode_varints(p, end, out, n);
+        m_curr = static_cast<size_t>(reinterpret_cast<const char*>(p) - m_data);
+        if (done != n)
+            throw std::underflow_error("binary_reader underrun");
+        return *this;
+    }
+
     //! Fetch a string which was put via put_string().
     std::string get_string()
     {
@@ -647,6 +752,268 @@ public:
     }
 };
 
+/*!
+ * segmented_binary_reader reads serialized data, which was written by a
+ * binary_buffer, from a sequence of memory segments without copying it into
+ * one contiguous area first. The segments are typically the blocks of a run
+ * or container read from disk, or parts of an mmap'd region, and items may
+ * span the boundaries of segments. The memory is referenced, not copied, and
+ * must outlive the reader.
+ *
+ * The interface matches binary_reader. Items within one segment are decoded
+ * in place, only those spanning a boundary are assembled byte by byte.
+ */
+class segmented_binary_reader
+{
+protected:
+    //! referenced segments, none empty
+    std::vector<binary_buffer_ref> m_segments;
+
+    //! total size of all segments
+    size_t m_size;
+
+    //! current segment, offset therein, and overall read cursor
+    size_t m_seg, m_pos, m_curr;
+
+    //! Bytes left in the current segment.
+    size_t segment_left() const
+    {
+        return m_seg < m_segments.size() ? m_segments[m_seg].size() - m_pos : 0;
+    }
+
+    //! Pointer to the cursor in the current segment.
+    const char * segment_curr() const
+    {
+        return static_cast<const char*>(m_segments[m_seg].data()) + m_pos;
+    }
+
+    //! Advance the cursor by n bytes within the current segment.
+    void advance(size_t n)
+    {
+        assert(n <= segment_left());
+        m_pos += n, m_curr += n;
+        if (m_seg < m_segments.size() && m_pos == m_segments[m_seg].size())
+            ++m_seg, m_pos = 0;
+    }
+
+    //! Fetch a varint with up to max_bytes bytes which may span segments by
+    //! collecting its bytes first.
+    binary_reader collect_varint(uint8_t* tmp, size_t max_bytes)
+    {
+        size_t len = 0;
+        do {
+            check_available(1);
+            tmp[len] = static_cast<uint8_t>(*segment_curr());
+            advance(1);
+        } while ((tmp[len++] & 0x80) && len < max_bytes);
+        return binary_reader(tmp, len);
+    }
+
+public:
+    //! Create a reader without segments.
+    segmented_binary_reader()
+        : m_size(0), m_seg(0), m_pos(0), m_curr(0)
+    { }
+
+    //! Create a reader over the given segments.
+    explicit segmented_binary_reader(const std::vector<binary_buffer_ref>& segments)
+        : segmented_binary_reader()
+    {
+        for (const binary_buffer_ref& s : segments)
+            add_segment(s.data(), s.size());
+    }
+
+    //! Append a segment of memory, e.g. a part of an mmap'd region.
+    segmented_binary_reader & add_segment(const void* data, size_t n)
+    {
+        if (n != 0)
+        {
+            m_segments.emplace_back(data, n);
+            m_size += n;
+        }
+        return *this;
+    }
+
+    //! Append the memory of the blocks in [first,last), e.g. typed_blocks in
+    //! a std::vector or a buffer array.
+    template <typename BlockIterator>
+    segmented_binary_reader & add_blocks(BlockIterator first, BlockIterator last)
+    {
+        for ( ; first != last; ++first)
+            add_segment(&*first, sizeof(*first));
+        return *this;
+    }
+
+    //! Return the total size of all segments.
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    //! Return the current read cursor.
+    size_t curr() const
+    {
+        return m_curr;
+    }
+
+    //! Reset the read cursor.
+    segmented_binary_reader & rewind()
+    {
+        m_seg = m_pos = m_curr = 0;
+        return *this;
+    }
+
+    //! Check that n bytes are available at the cursor.
+    bool cursor_available(size_t n) const
+    {
+        return (m_curr + n <= m_size);
+    }
+
+    //! Throws a std::underflow_error unless n bytes are available at the
+    //! cursor.
+    void check_available(size_t n) const
+    {
+        if (!cursor_available(n))
+            throw std::underflow_error("segmented_binary_reader underrun");
+    }
+
+    //! Return true if the cursor is at the end of the segments.
+    bool empty() const
+    {
+        return (m_curr == m_size);
+    }
+
+    //! Advance the cursor given number of bytes without reading them.
+    segmented_binary_reader & skip(size_t n)
+    {
+        check_available(n);
+        while (n != 0)
+        {
+            const size_t part = std::min(n, segment_left());
+            advance(part);
+            n -= part;
+        }
+        return *this;
+    }
+
+    //! Fetch a number of unstructured bytes, advancing the cursor.
+    segmented_binary_reader & read(void* outdata, size_t datalen)
+    {
+        check_available(datalen);
+        char* out = static_cast<char*>(outdata);
+        while (datalen != 0)
+        {
+            const size_t part = std::min(datalen, segment_left());
+            memcpy(out, segment_curr(), part);
+            advance(part);
+            out += part, datalen -= part;
+        }
+        return *this;
+    }
+
+    //! Fetch a number of unstructured bytes as std::string, advancing the
+    //! cursor.
+    std::string read(size_t datalen)
+    {
+        std::string out(datalen, 0);
+        read(&out[0], datalen);
+        return out;
+    }
+
+    //! Fetch a single item of the template type Type, advancing the cursor.
+    //! Be careful with implicit type conversions!
+    template <typename Type>
+    Type get()
+    {
+        Type ret;
+        if (segment_left() >= sizeof(Type))
+        {
+            memcpy(&ret, segment_curr(), sizeof(Type));
+            advance(sizeof(Type));
+        }
+        else
+            read(&ret, sizeof(Type));
+        return ret;
+    }
+
+    //! Fetch a varint with up to 32-bit at the cursor.
+    uint32_t get_varint()
+    {
+        if (segment_left() >= 5)
+        {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(segment_curr());
+            const uint8_t* begin = p;
+            const uint32_t v = binary_buffer_local::decode_varint(p);
+            advance(static_cast<size_t>(p - begin));
+            return v;
+        }
+        uint8_t tmp[5];
+        return collect_varint(tmp, sizeof(tmp)).get_varint();
+    }
+
+    //! Fetch a 64-bit varint at the cursor.
+    uint64_t get_varint64()
+    {
+        if (segment_left() >= 10)
+        {
+            binary_reader br(segment_curr(), 10);
+            const uint64_t v = br.get_varint64();
+            advance(br.curr());
+            return v;
+        }
+        uint8_t tmp[10];
+        return collect_varint(tmp, sizeof(tmp)).get_varint64();
+    }
+
+    //! Fetch n consecutive varints with up to 32-bit into out, decoding the
+    //! runs within segments in bulk, see binary_reader::get_varint_array().
+    segmented_binary_reader & get_varint_array(uint32_t* out, size_t n)
+    {
+        while (n != 0)
+        {
+            if (m_seg < m_segments.size())
+            {
+                const uint8_t* begin = reinterpret_cast<const uint8_t*>(segment_curr());
+                const uint8_t* p = begin;
+                const size_t done = binary_buffer_local::decode_varints(
+                    p, begin + segment_left(), out, n);
+                advance(static_cast<size_t>(p - begin));
+                out += done, n -= done;
+                if (n == 0)
+                    break;
+            }
+            // the next varint spans a segment boundary
+            *out++ = get_varint(), --n;
+        }
+        return *this;
+    }
+
+    //! Fetch a string which was put via put_string().
+    std::string get_string()
+    {
+        uint32_t len = get_varint();
+        return read(len);
+    }
+
+    //! Fetch a binary string or blob which was put via put_string(). Does NOT
+    //! copy the data if it lies within one segment, otherwise it is copied
+    //! into staging, which the returned reference points into.
+    binary_buffer_ref get_binary_buffer_ref(binary_buffer& staging)
+    {
+        uint32_t len = get_varint();
+        check_available(len);
+        if (len <= segment_left())
+        {
+            binary_buffer_ref br(segment_curr(), len);
+            advance(len);
+            return br;
+        }
+        staging.alloc(len).set_size(len);
+        read(staging.data(), len);
+        return staging;
+    }
+};
+
 //! \}
 
 } // namespace stxxl
@@ -0,0 +1,195 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/block_array.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_BLOCK_ARRAY_HEADER
+#define STXXL_COMMON_BLOCK_ARRAY_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+#include <tlx/logger/core.hpp>
+#include <tlx/unused.hpp>
+
+#include <stxxl/bits/common/settings.h>
+#include <stxxl/bits/config.h>
+
+#if !STXXL_WINDOWS
+#include <sys/mman.h>
+#endif
+
+#if defined(MAP_ANONYMOUS) && (defined(MAP_HUGETLB) || defined(MADV_HUGEPAGE))
+#define STXXL_HAVE_HUGE_PAGES 1
+#else
+#define STXXL_HAVE_HUGE_PAGES 0
+#endif
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+namespace block_array_local {
+
+static constexpr bool debug = false;
+
+//! size of the huge pages backing the block arrays
+static constexpr size_t huge_page_size = size_t(2) * 1024 * 1024;
+
+#if STXXL_HAVE_HUGE_PAGES
+
+//! Lengths of the mappings returned by map_huge_pages(), needed to unmap
+//! them.
+class mapping_registry
+{
+    std::mutex mutex_;
+    std::unordered_map<const void*, size_t> lengths_;
+
+public:
+    static mapping_registry& get_instance()
+    {
+        static mapping_registry instance;
+        return instance;
+    }
+
+    void insert(const void* p, size_t length)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        lengths_[p] = length;
+    }
+
+    //! Remove p, returns the length of its mapping or 0 if p was not mapped.
+    size_t erase(const void* p)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = lengths_.find(p);
+        if (it == lengths_.end())
+            return 0;
+        const size_t length = it->second;
+        lengths_.erase(it);
+        return length;
+    }
+};
+
+//! Map bytes of memory backed by huge pages: explicitly reserved ones if
+//! available (1 GiB pages for arrays of at least 1 GiB), otherwise
+//! transparent huge pages. Returns nullptr if the mapping failed.
+inline void * map_huge_pages(size_t bytes)
+{
+    const size_t length = (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+    void* p = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+#if defined(MAP_HUGE_1GB)
+    if (length >= (size_t(1) << 30) && length % (size_t(1) << 30) == 0)
+    {
+        p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+    }
+#endif
+    if (p == MAP_FAILED)
+    {
+        p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (p != MAP_FAILED)
+    {
+        TLX_LOG << "block_array: mapped " << length << " bytes of reserved huge pages";
+        mapping_registry::get_instance().insert(p, length);
+        return p;
+    }
+#endif
+
+#if defined(MADV_HUGEPAGE)
+    // over-allocate to align the array to a huge page, then trim the ends
+    const size_t slack = length + huge_page_size;
+    p = mmap(nullptr, slack, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+
+    const uintptr_t base = reinterpret_cast<uintptr_t>(p);
+    const uintptr_t aligned = (base + huge_page_size - 1) / huge_page_size * huge_page_size;
+    if (aligned > base)
+        munmap(p, aligned - base);
+    if (aligned + length < base + slack)
+        munmap(reinterpret_cast<void*>(aligned + length), base + slack - aligned - length);
+
+    p = reinterpret_cast<void*>(aligned);
+    if (madvise(p, length, MADV_HUGEPAGE) != 0)
+    {
+        TLX_LOG << "block_array: madvise(MADV_HUGEPAGE) failed";
+    }
+
+    TLX_LOG << "block_array: mapped " << length << " bytes of transparent huge pages";
+    mapping_registry::get_instance().insert(p, length);
+    return p;
+#else
+    return nullptr;
+#endif
+}
+
+#endif // STXXL_HAVE_HUGE_PAGES
+
+} // namespace block_array_local
+
+/*!
+ * Allocate an array of n default constructed blocks like new BlockType[n].
+ *
+ * If SETTINGS::huge_pages is set and the array spans at least one huge page,
+ * it is backed by huge pages to reduce the TLB misses of sorting or scanning
+ * it; if these cannot be mapped, the array is allocated normally. The array
+ * must be released with delete_block_array().
+ */
+template <typename BlockType>
+BlockType * new_block_array(size_t n)
+{
+#if STXXL_HAVE_HUGE_PAGES
+    const size_t bytes = n * sizeof(BlockType);
+    if (SETTINGS::huge_pages && bytes >= block_array_local::huge_page_size)
+    {
+        if (void* p = block_array_local::map_huge_pages(bytes))
+        {
+            BlockType* blocks = static_cast<BlockType*>(p);
+            for (size_t i = 0; i < n; ++i)
+                new (blocks + i)BlockType;
+            return blocks;
+        }
+    }
+#endif
+    return new BlockType[n];
+}
+
+//! Release an array of n blocks allocated by new_block_array().
+template <typename BlockType>
+void delete_block_array(BlockType* blocks, size_t n)
+{
+#if STXXL_HAVE_HUGE_PAGES
+    if (blocks == nullptr)
+        return;
+    if (const size_t length = block_array_local::mapping_registry::get_instance().erase(blocks))
+    {
+        for (size_t i = 0; i < n; ++i)
+            blocks[i].~BlockType();
+        munmap(blocks, length);
+        return;
+    }
+#endif
+    tlx::unused(n);
+    delete[] blocks;
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_BLOCK_ARRAY_HEADER
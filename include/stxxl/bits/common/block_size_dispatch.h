@@ -0,0 +1,101 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/block_size_dispatch.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_BLOCK_SIZE_DISPATCH_HEADER
+#define STXXL_COMMON_BLOCK_SIZE_DISPATCH_HEADER
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/exceptions.hpp>
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+//! List of block sizes instantiated by dispatch_block_size().
+template <size_t... BlockSizes>
+struct block_size_list
+{ };
+
+//! Block sizes instantiated by default, from 64 KiB for SSDs to 16 MiB for
+//! hard disks, including the default block size of 2 MiB.
+using default_block_sizes = block_size_list<
+          64 * 1024, 256 * 1024, 512 * 1024,
+          1024 * 1024, 2 * 1024 * 1024, 4 * 1024 * 1024,
+          8 * 1024 * 1024, 16 * 1024 * 1024>;
+
+namespace block_size_dispatch_local {
+
+template <typename Functor, typename List>
+struct result;
+
+template <typename Functor, size_t BlockSize, size_t... BlockSizes>
+struct result<Functor, block_size_list<BlockSize, BlockSizes...> >
+{
+    using type = decltype(
+        std::declval<Functor>()(std::integral_constant<size_t, BlockSize>()));
+};
+
+template <typename Functor, typename Result>
+Result dispatch(size_t block_size, Functor&&, block_size_list<>)
+{
+    FOXXLL_THROW2(foxxll::bad_parameter, "dispatch_block_size()",
+                  "block size " << block_size << " is not instantiated");
+}
+
+template <typename Functor, typename Result,
+          size_t BlockSize, size_t... BlockSizes>
+Result dispatch(size_t block_size, Functor&& f,
+                block_size_list<BlockSize, BlockSizes...>)
+{
+    if (block_size == BlockSize)
+        return f(std::integral_constant<size_t, BlockSize>());
+    return dispatch<Functor, Result>(
+        block_size, std::forward<Functor>(f), block_size_list<BlockSizes...>());
+}
+
+} // namespace block_size_dispatch_local
+
+/*!
+ * Select the block size of containers and sorters at run time, which the
+ * template parameters otherwise fix at compile time. The functor is called
+ * with a std::integral_constant holding block_size, for which it
+ * instantiates the containers, e.g. with a generic lambda:
+ *
+ * \code
+ * stxxl::dispatch_block_size(block_size, [&](auto bs) {
+ *     stxxl::sorter<int, cmp, decltype(bs)::value> s(cmp(), 512 * 1024 * 1024);
+ *     ...
+ * });
+ * \endcode
+ *
+ * Thus one binary can use e.g. small blocks on SSDs and large ones on hard
+ * disks. Each block size in List is instantiated, which multiplies the code
+ * size of the functor. The results of all instantiations must have the type
+ * of the first. Throws foxxll::bad_parameter if block_size is not in List.
+ */
+template <typename List = default_block_sizes, typename Functor>
+typename block_size_dispatch_local::result<Functor, List>::type
+dispatch_block_size(size_t block_size, Functor&& f)
+{
+    return block_size_dispatch_local::dispatch<
+        Functor, typename block_size_dispatch_local::result<Functor, List>::type>(
+        block_size, std::forward<Functor>(f), List());
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_BLOCK_SIZE_DISPATCH_HEADER
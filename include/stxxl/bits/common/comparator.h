@@ -13,6 +13,7 @@
 #ifndef STXXL_COMMON_COMPARATOR_HEADER
 #define STXXL_COMMON_COMPARATOR_HEADER
 
+#include <cstdint>
 #include <limits>
 #include <tuple>
 #include <type_traits>
@@ -381,6 +382,12 @@ public:
         return impl(keys(a), keys(b));
     }
 
+    //! The key extractor, see comparator_traits.
+    const KeyExtract& key_extract() const
+    {
+        return keys;
+    }
+
 private:
     // store key extractor
     KeyExtract keys;
@@ -412,6 +419,265 @@ auto make_struct_comparator(const KeyExtract extract)
     return struct_comparator<ValueType, KeyExtract, Modes...>(extract);
 }
 
+//! List of the directions of the keys of a comparator, see
+//! comparator_traits.
+template <direction... Modes>
+struct direction_list { };
+
+namespace comparator_details {
+
+template <typename Type>
+struct is_integral_key
+    : public std::integral_constant<
+          bool, std::is_integral<Type>::value && !std::is_same<Type, bool>::value>
+{ };
+
+//! Whether all keys of the key type are integral.
+template <typename KeyType>
+struct all_integral_keys : is_integral_key<KeyType>{ };
+
+template <typename... Types>
+struct all_integral_keys<std::tuple<Types...> >
+    : public std::integral_constant<
+          bool, sizeof ... (Types) != 0 &&
+          std::is_same<std::integer_sequence<bool, is_integral_key<Types>::value...>,
+                       std::integer_sequence<bool, (sizeof(Types), true)...> >::value>
+{ };
+
+template <typename T1, typename T2>
+struct all_integral_keys<std::pair<T1, T2> >
+    : all_integral_keys<std::tuple<T1, T2> >{ };
+
+template <typename KeyType>
+struct num_keys : std::integral_constant<size_t, 1>{ };
+
+template <typename... Types>
+struct num_keys<std::tuple<Types...> >
+    : std::integral_constant<size_t, sizeof ... (Types)>{ };
+
+template <typename T1, typename T2>
+struct num_keys<std::pair<T1, T2> >: std::integral_constant<size_t, 2>{ };
+
+//! Key types with the references of tuple members removed.
+template <typename KeyType>
+struct remove_key_refs
+{
+    using type = typename std::decay<KeyType>::type;
+};
+
+template <typename... Types>
+struct remove_key_refs<std::tuple<Types...> >
+{
+    using type = std::tuple<typename std::decay<Types>::type...>;
+};
+
+//! Direction of the first key, which is ascending if none is given.
+template <direction... Modes>
+struct first_direction
+{
+    static constexpr direction value = direction::Less;
+};
+
+template <direction M1, direction... Modes>
+struct first_direction<M1, Modes...>
+{
+    static constexpr direction value = M1;
+};
+
+} // namespace comparator_details
+
+/*!
+ * Introspection of the typed comparators stxxl::comparator and
+ * stxxl::struct_comparator, with which algorithms select specialized kernels
+ * at compile time, see sort_kernel_traits.
+ *
+ * For typed comparators, is_typed is true and the traits describe them as a
+ * lexicographic comparison of key_type, which is a tuple or pair or a single
+ * key: directions is the direction_list of the keys, first_direction that of
+ * the first key, num_keys their number, and integral_keys whether all keys
+ * are integral. keys() extracts the keys compared of a value.
+ */
+template <typename CompareType>
+struct comparator_traits
+{
+    static constexpr bool is_typed = false;
+};
+
+template <typename ValueType, direction... Modes>
+struct comparator_traits<comparator<ValueType, Modes...> >
+{
+    static constexpr bool is_typed = true;
+
+    using value_type = ValueType;
+    using key_type = ValueType;
+    using directions = direction_list<Modes...>;
+
+    static constexpr direction first_direction =
+        comparator_details::first_direction<Modes...>::value;
+    static constexpr size_t num_keys = comparator_details::num_keys<key_type>::value;
+    static constexpr bool integral_keys =
+        comparator_details::all_integral_keys<key_type>::value;
+
+    static const key_type& keys(const comparator<ValueType, Modes...>&,
+                                const value_type& v)
+    {
+        return v;
+    }
+};
+
+template <typename ValueType, typename KeyExtract, direction... Modes>
+struct comparator_traits<struct_comparator<ValueType, KeyExtract, Modes...> >
+{
+    static constexpr bool is_typed = true;
+
+    using value_type = ValueType;
+    using key_type = typename comparator_details::remove_key_refs<
+              decltype(std::declval<const KeyExtract&>()(
+                           std::declval<const ValueType&>()))>::type;
+    using directions = direction_list<Modes...>;
+
+    static constexpr direction first_direction =
+        comparator_details::first_direction<Modes...>::value;
+    static constexpr size_t num_keys = comparator_details::num_keys<key_type>::value;
+    static constexpr bool integral_keys =
+        comparator_details::all_integral_keys<key_type>::value;
+
+    static auto keys(const struct_comparator<ValueType, KeyExtract, Modes...>& cmp,
+                     const value_type& v)
+    {
+        return cmp.key_extract()(v);
+    }
+};
+
+/*!
+ * Comparator with a normalized key: KeyFunction maps a value to an unsigned
+ * integer prefix whose order is consistent with CompareType, i.e. smaller
+ * prefixes belong to smaller values, and equal prefixes are decided by
+ * CompareType. Comparisons test the prefixes first, which avoids the full
+ * comparison of composite keys in merges.
+ *
+ * Run formation of stxxl::sort, stream::sort and sorter detects this
+ * comparator and sorts pairs of prefixes and indexes instead of the values,
+ * which are then permuted once, see sort_kernel_blocks(). For large records,
+ * this moves much less memory than sorting the records themselves.
+ *
+ * A memcmp-able byte encoding of the keys is turned into a prefix by
+ * normalized_key_from_bytes().
+ */
+template <typename CompareType, typename KeyFunction>
+class normalized_key_comparator
+{
+public:
+    using compare_type = CompareType;
+    using key_function = KeyFunction;
+
+private:
+    CompareType m_cmp;
+    KeyFunction m_key;
+
+public:
+    explicit normalized_key_comparator(const CompareType& cmp = CompareType(),
+                                       const KeyFunction& key = KeyFunction())
+        : m_cmp(cmp), m_key(key)
+    { }
+
+    template <typename ValueType>
+    bool operator () (const ValueType& a, const ValueType& b) const
+    {
+        const auto ka = m_key(a), kb = m_key(b);
+        if (ka != kb)
+            return ka < kb;
+        return m_cmp(a, b);
+    }
+
+    auto min_value() const
+    {
+        return m_cmp.min_value();
+    }
+
+    auto max_value() const
+    {
+        return m_cmp.max_value();
+    }
+
+    //! The normalized key of x.
+    template <typename ValueType>
+    auto key(const ValueType& x) const
+    {
+        return m_key(x);
+    }
+
+    //! The comparator deciding equal keys.
+    const CompareType& compare() const
+    {
+        return m_cmp;
+    }
+};
+
+//! Create a normalized_key_comparator from a comparator and a function
+//! mapping values to an unsigned integer prefix consistent with it.
+template <typename CompareType, typename KeyFunction>
+normalized_key_comparator<CompareType, KeyFunction>
+make_normalized_key_comparator(const CompareType& cmp, const KeyFunction& key)
+{
+    return normalized_key_comparator<CompareType, KeyFunction>(cmp, key);
+}
+
+//! Pack the first bytes of a memcmp-able encoding into an unsigned integer
+//! prefix, whose order matches memcmp() of the first sizeof(KeyType) bytes.
+//! Shorter encodings are padded with zeros.
+template <typename KeyType = uint64_t>
+KeyType normalized_key_from_bytes(const void* data, size_t size)
+{
+    static_assert(std::is_unsigned<KeyType>::value, "normalized keys are unsigned");
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    KeyType key = 0;
+    for (size_t i = 0; i < sizeof(KeyType); ++i)
+        key = static_cast<KeyType>((key << 8) | (i < size ? p[i] : 0));
+    return key;
+}
+
+/*!
+ * Trait whether keys of ValueType compared by CompareType are cheap to compare
+ * and to copy, so that loser trees play their matches without branches: the
+ * outcome of each comparison selects the winner and the loser by conditional
+ * moves instead of a jump, which the branch predictor cannot guess for merged
+ * keys.
+ *
+ * Holds for arithmetic and pointer keys with any comparator, and for small
+ * trivially copyable keys compared by stxxl::comparator or
+ * stxxl::struct_comparator. Specialize it for further key types.
+ */
+template <typename ValueType, typename CompareType>
+struct is_branchless_comparable
+    : public std::integral_constant<
+          bool, std::is_arithmetic<ValueType>::value ||
+          std::is_pointer<ValueType>::value>
+{ };
+
+namespace comparator_details {
+
+template <typename ValueType>
+struct is_small_trivial
+    : public std::integral_constant<
+          bool, std::is_trivially_copy_constructible<ValueType>::value &&
+          std::is_trivially_destructible<ValueType>::value &&
+          sizeof(ValueType) <= 2 * sizeof(uint64_t)>
+{ };
+
+} // namespace comparator_details
+
+template <typename ValueType, direction... Modes>
+struct is_branchless_comparable<ValueType, comparator<ValueType, Modes...> >
+    : public comparator_details::is_small_trivial<ValueType>
+{ };
+
+template <typename ValueType, typename KeyExtract, direction... Modes>
+struct is_branchless_comparable<
+    ValueType, struct_comparator<ValueType, KeyExtract, Modes...> >
+    : public comparator_details::is_small_trivial<ValueType>
+{ };
+
 } // namespace stxxl
 
 /*!
@@ -0,0 +1,194 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/coroutine.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_COROUTINE_HEADER
+#define STXXL_COMMON_COROUTINE_HEADER
+
+// coroutines need C++20, the library itself is built as C++14
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define STXXL_HAVE_COROUTINES 1
+#endif
+#endif
+
+#ifndef STXXL_HAVE_COROUTINES
+#define STXXL_HAVE_COROUTINES 0
+#endif
+
+#if STXXL_HAVE_COROUTINES
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+#include <foxxll/io/request.hpp>
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Event loop of the coroutines awaiting asynchronous container accesses,
+ * e.g. vector::async_get().
+ *
+ * An awaiting coroutine submits its request, whose completion handler posts
+ * the coroutine to the scheduler from the I/O thread. run() resumes the
+ * posted coroutines on the calling thread, so one thread keeps as many
+ * accesses in flight as it has coroutines waiting, and the coroutines never
+ * run on the I/O threads.
+ */
+class io_scheduler
+{
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    //! coroutines whose request completed
+    std::deque<std::coroutine_handle<> > m_ready;
+    //! number of requests submitted and not yet completed
+    size_t m_in_flight = 0;
+
+public:
+    io_scheduler() = default;
+
+    //! non-copyable: delete copy-constructor
+    io_scheduler(const io_scheduler&) = delete;
+    //! non-copyable: delete assignment operator
+    io_scheduler& operator = (const io_scheduler&) = delete;
+
+    //! The scheduler of the calling thread, used by default.
+    static io_scheduler& this_thread()
+    {
+        static thread_local io_scheduler scheduler;
+        return scheduler;
+    }
+
+    //! Count a request submitted by an awaiting coroutine.
+    void submitted()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_in_flight;
+    }
+
+    //! Uncount a request whose submission failed.
+    void cancelled()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        --m_in_flight;
+        m_cv.notify_one();
+    }
+
+    //! Post the coroutine h awaiting a completed request, may be called from
+    //! any thread.
+    void post(std::coroutine_handle<> h)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_ready.push_back(h);
+        --m_in_flight;
+        m_cv.notify_one();
+    }
+
+    //! Completion handler of a request, posting the awaiting coroutine.
+    struct resume_handler
+    {
+        io_scheduler* scheduler;
+        std::coroutine_handle<> handle;
+
+        void operator () (foxxll::request* /* req */, bool /* success */)
+        {
+            scheduler->post(handle);
+        }
+    };
+
+    //! Number of requests in flight.
+    size_t in_flight()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_in_flight;
+    }
+
+    //! Resume the posted coroutines without waiting, returns their number.
+    size_t poll()
+    {
+        size_t n = 0;
+        while (true)
+        {
+            std::coroutine_handle<> h;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_ready.empty())
+                    return n;
+                h = m_ready.front();
+                m_ready.pop_front();
+            }
+            h.resume();
+            ++n;
+        }
+    }
+
+    //! Resume the coroutines as their requests complete, until no request
+    //! is in flight anymore.
+    void run()
+    {
+        while (true)
+        {
+            std::coroutine_handle<> h;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]() { return !m_ready.empty() || m_in_flight == 0; });
+                if (m_ready.empty())
+                    return;
+                h = m_ready.front();
+                m_ready.pop_front();
+            }
+            h.resume();
+        }
+    }
+};
+
+/*!
+ * Return type of coroutines which are started and not awaited, e.g. one per
+ * lookup driven by io_scheduler::run(). The coroutine runs until its first
+ * suspension when called and frees itself at its end; exceptions escaping
+ * it terminate the program.
+ */
+struct detached_task
+{
+    struct promise_type
+    {
+        detached_task get_return_object() noexcept
+        {
+            return detached_task();
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return { };
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return { };
+        }
+        void return_void() noexcept { }
+        void unhandled_exception() noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // STXXL_HAVE_COROUTINES
+
+#endif // !STXXL_COMMON_COROUTINE_HEADER
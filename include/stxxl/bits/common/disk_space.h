@@ -0,0 +1,244 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/disk_space.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_DISK_SPACE_HEADER
+#define STXXL_COMMON_DISK_SPACE_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+#include <tlx/unused.hpp>
+
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/common/settings.h>
+#include <stxxl/bits/config.h>
+
+#if !STXXL_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+#define STXXL_HAVE_PUNCH_HOLE 1
+#else
+#define STXXL_HAVE_PUNCH_HOLE 0
+#endif
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Returns the disk space of freed blocks to the file system while the
+ * program runs.
+ *
+ * The disk files of the block manager only grow: freed blocks are reused by
+ * later allocations, but their space stays occupied on the scratch volume.
+ * Containers and sorters free their blocks through delete_blocks(), which,
+ * if SETTINGS::reclaim_disk_space is set, sorts the blocks by disk and
+ * offset, coalesces adjacent ones into extents and deallocates the extents
+ * on the volume with fallocate(FALLOC_FL_PUNCH_HOLE) before returning the
+ * blocks to the block manager. The file size is kept, hence the block
+ * manager's view of the file does not change, and reading a punched block
+ * returns zeros.
+ *
+ * The holes are punched on a descriptor of the path of the disk in the
+ * configuration, opened on first use. Disks which cannot be opened, such as
+ * files deleted on open or memory disks, and file systems without hole
+ * punching are skipped after the first failure.
+ */
+class disk_space_reclaimer
+{
+    static constexpr bool debug = false;
+
+    struct disk_type
+    {
+        //! descriptor for punching holes, -1 if not opened yet
+        int fd = -1;
+        //! punching holes failed, do not try again
+        bool failed = false;
+    };
+
+    std::mutex m_mutex;
+    std::vector<disk_type> m_disks;
+
+    //! bytes of punched holes and number of fallocate calls
+    std::atomic<uint64_t> m_reclaimed { 0 };
+    std::atomic<uint64_t> m_calls { 0 };
+
+    disk_space_reclaimer() = default;
+
+    //! extent of a disk
+    struct extent_type
+    {
+        size_t disk;
+        uint64_t offset, size;
+
+        bool operator < (const extent_type& b) const
+        {
+            return disk < b.disk || (disk == b.disk && offset < b.offset);
+        }
+    };
+
+    //! Punch a hole of the extent e, return whether it succeeded.
+    bool punch(const extent_type& e)
+    {
+#if STXXL_HAVE_PUNCH_HOLE
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (e.disk >= m_disks.size())
+            m_disks.resize(e.disk + 1);
+        disk_type& d = m_disks[e.disk];
+        if (d.failed)
+            return false;
+
+        if (d.fd < 0)
+        {
+            foxxll::config* cfg = foxxll::config::get_instance();
+            if (e.disk >= cfg->disks_number() ||
+                (d.fd = ::open(cfg->disk(e.disk).path.c_str(), O_RDWR)) < 0)
+            {
+                TLX_LOG1 << "disk_space_reclaimer: cannot open disk " << e.disk
+                         << ", its space is not reclaimed";
+                d.failed = true;
+                return false;
+            }
+        }
+        const int fd = d.fd;
+        lock.unlock();
+
+        if (::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                        static_cast<off_t>(e.offset),
+                        static_cast<off_t>(e.size)) != 0)
+        {
+            TLX_LOG1 << "disk_space_reclaimer: punching holes on disk " << e.disk
+                     << " failed: " << strerror(errno)
+                     << ", its space is not reclaimed";
+            lock.lock();
+            d.failed = true;
+            return false;
+        }
+
+        TLX_LOG << "punched hole of " << e.size << " bytes at " << e.offset
+                << " of disk " << e.disk;
+        m_reclaimed += e.size;
+        m_calls++;
+        return true;
+#else
+        tlx::unused(e);
+        return false;
+#endif
+    }
+
+public:
+    //! non-copyable: delete copy-constructor
+    disk_space_reclaimer(const disk_space_reclaimer&) = delete;
+    //! non-copyable: delete assignment operator
+    disk_space_reclaimer& operator = (const disk_space_reclaimer&) = delete;
+
+    ~disk_space_reclaimer()
+    {
+#if !STXXL_WINDOWS
+        for (disk_type& d : m_disks)
+        {
+            if (d.fd >= 0)
+                ::close(d.fd);
+        }
+#endif
+    }
+
+    static disk_space_reclaimer& get_instance()
+    {
+        static disk_space_reclaimer instance;
+        return instance;
+    }
+
+    //! Whether holes can be punched on this platform.
+    static constexpr bool supported()
+    {
+        return STXXL_HAVE_PUNCH_HOLE != 0;
+    }
+
+    /*!
+     * Punch holes of the blocks [begin, end), which must not be accessed
+     * anymore, coalescing adjacent blocks into one extent. The blocks stay
+     * allocated, returns the bytes reclaimed.
+     */
+    template <typename BIDIterator>
+    uint64_t punch_holes(BIDIterator begin, BIDIterator end)
+    {
+        std::vector<extent_type> extents;
+        for (BIDIterator it = begin; it != end; ++it)
+        {
+            const auto& bid = *it;
+            // skip blocks of files outside the block manager, e.g. checkpoints
+            if (!bid.valid() || bid.storage->get_allocator_id() < 0)
+                continue;
+            extents.push_back(extent_type {
+                                  static_cast<size_t>(bid.storage->get_allocator_id()),
+                                  bid.offset, bid.size
+                              });
+        }
+        std::sort(extents.begin(), extents.end());
+
+        uint64_t reclaimed = 0;
+        for (size_t i = 0; i < extents.size(); )
+        {
+            extent_type e = extents[i++];
+            while (i < extents.size() && extents[i].disk == e.disk &&
+                   extents[i].offset == e.offset + e.size)
+            {
+                e.size += extents[i++].size;
+            }
+            if (punch(e))
+                reclaimed += e.size;
+        }
+        return reclaimed;
+    }
+
+    /*!
+     * Free the blocks [begin, end) in the block manager. If
+     * SETTINGS::reclaim_disk_space is set, their space is first returned to
+     * the file system, see punch_holes().
+     */
+    template <typename BIDIterator>
+    void delete_blocks(BIDIterator begin, BIDIterator end)
+    {
+        if (SETTINGS::reclaim_disk_space)
+            punch_holes(begin, end);
+        foxxll::block_manager::get_instance()->delete_blocks(begin, end);
+    }
+
+    //! Bytes returned to the file system since the start of the program.
+    uint64_t reclaimed_bytes() const
+    {
+        return m_reclaimed;
+    }
+
+    //! Number of holes punched since the start of the program.
+    uint64_t holes_punched() const
+    {
+        return m_calls;
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_DISK_SPACE_HEADER
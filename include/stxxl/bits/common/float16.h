@@ -0,0 +1,168 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/float16.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_FLOAT16_HEADER
+#define STXXL_COMMON_FLOAT16_HEADER
+
+#include <cstdint>
+#include <cstring>
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * IEEE 754 half precision floating point number, which stores a float in 16
+ * bits with 5 exponent and 10 mantissa bits, e.g. to halve the I/O volume of
+ * external containers. Values convert implicitly to and from float, rounding
+ * to nearest even, and all arithmetic is done in float.
+ */
+class float16
+{
+public:
+    //! uninitialized, like a float
+    float16() = default;
+
+    float16(float value) // NOLINT
+        : m_bits(from_float(value)) { }
+
+    operator float () const // NOLINT
+    { return to_float(m_bits); }
+
+    float16& operator += (float value) { return *this = float(*this) + value; }
+    float16& operator -= (float value) { return *this = float(*this) - value; }
+    float16& operator *= (float value) { return *this = float(*this) * value; }
+    float16& operator /= (float value) { return *this = float(*this) / value; }
+
+    //! the bit representation
+    uint16_t bits() const { return m_bits; }
+
+    static float16 from_bits(uint16_t bits)
+    {
+        float16 f;
+        f.m_bits = bits;
+        return f;
+    }
+
+    static uint16_t from_float(float value)
+    {
+        uint32_t x;
+        std::memcpy(&x, &value, sizeof(x));
+        const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+        x &= 0x7FFFFFFF;
+
+        // infinity and NaN
+        if (x >= 0x7F800000)
+            return static_cast<uint16_t>(sign | 0x7C00 | (x > 0x7F800000 ? 0x0200 : 0));
+        // rounds to 65520 or more, which overflows
+        if (x >= 0x477FF000)
+            return static_cast<uint16_t>(sign | 0x7C00);
+        // below 2^-14 the result is subnormal: adding 0.5 rounds the value to
+        // a multiple of 2^-24, which then is the mantissa of the result
+        if (x < 0x38800000)
+        {
+            float abs_value;
+            std::memcpy(&abs_value, &x, sizeof(x));
+            abs_value += 0.5f;
+            std::memcpy(&x, &abs_value, sizeof(x));
+            return static_cast<uint16_t>(sign | (x - 0x3F000000));
+        }
+        // round the mantissa to nearest even and rebias the exponent
+        x += 0x0FFF + ((x >> 13) & 1);
+        return static_cast<uint16_t>(sign | ((x - (uint32_t(112) << 23)) >> 13));
+    }
+
+    static float to_float(uint16_t bits)
+    {
+        const uint32_t sign = uint32_t(bits & 0x8000) << 16;
+        const uint32_t exponent = (bits >> 10) & 0x1F, mantissa = bits & 0x03FF;
+        uint32_t x;
+        if (exponent == 0x1F)
+            x = sign | 0x7F800000 | (mantissa << 13);
+        else if (exponent != 0)
+            x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        else
+        {
+            // zero or subnormal, mantissa * 2^-24 is exact
+            const float value = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+            std::memcpy(&x, &value, sizeof(x));
+            x |= sign;
+        }
+        float value;
+        std::memcpy(&value, &x, sizeof(x));
+        return value;
+    }
+
+private:
+    uint16_t m_bits;
+};
+
+/*!
+ * Brain floating point number, the upper 16 bits of a float with its 8
+ * exponent but only 7 mantissa bits. It has the range of a float at a lower
+ * precision than float16. Values convert implicitly to and from float,
+ * rounding to nearest even, and all arithmetic is done in float.
+ */
+class bfloat16
+{
+public:
+    //! uninitialized, like a float
+    bfloat16() = default;
+
+    bfloat16(float value) // NOLINT
+        : m_bits(from_float(value)) { }
+
+    operator float () const // NOLINT
+    { return to_float(m_bits); }
+
+    bfloat16& operator += (float value) { return *this = float(*this) + value; }
+    bfloat16& operator -= (float value) { return *this = float(*this) - value; }
+    bfloat16& operator *= (float value) { return *this = float(*this) * value; }
+    bfloat16& operator /= (float value) { return *this = float(*this) / value; }
+
+    //! the bit representation
+    uint16_t bits() const { return m_bits; }
+
+    static bfloat16 from_bits(uint16_t bits)
+    {
+        bfloat16 f;
+        f.m_bits = bits;
+        return f;
+    }
+
+    static uint16_t from_float(float value)
+    {
+        uint32_t x;
+        std::memcpy(&x, &value, sizeof(x));
+        // keep NaN a quiet NaN instead of rounding it to infinity
+        if ((x & 0x7FFFFFFF) > 0x7F800000)
+            return static_cast<uint16_t>((x >> 16) | 0x0040);
+        x += 0x7FFF + ((x >> 16) & 1);
+        return static_cast<uint16_t>(x >> 16);
+    }
+
+    static float to_float(uint16_t bits)
+    {
+        const uint32_t x = uint32_t(bits) << 16;
+        float value;
+        std::memcpy(&value, &x, sizeof(x));
+        return value;
+    }
+
+private:
+    uint16_t m_bits;
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_FLOAT16_HEADER
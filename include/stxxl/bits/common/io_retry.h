@@ -0,0 +1,247 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/io_retry.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_IO_RETRY_HEADER
+#define STXXL_COMMON_IO_RETRY_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+#include <foxxll/common/utils.hpp>
+#include <foxxll/io/file.hpp>
+#include <foxxll/io/request.hpp>
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Recovery of failed block I/Os for the containers.
+ *
+ * Requests of some file types fail with foxxll::io_error if the device
+ * completes only part of them, e.g. network block devices under memory
+ * pressure, and reads of blocks beyond the end of a file fail similarly. The
+ * containers wait for their block requests through wait(), which catches the
+ * error and redoes the I/O synchronously up to max_retries() times: the n-th
+ * attempt splits the I/O into 2^n requests of whole alignment units, waiting
+ * backoff() times n before it, and reads beyond the end of the file return
+ * zeros instead. If the last attempt fails, its error is thrown.
+ *
+ * Retried I/Os are counted by the foxxll statistics like all others,
+ * retried(), split() and failed() count the recovery attempts.
+ */
+class io_retry
+{
+    //! maximum number of attempts after a failed request
+    std::atomic<unsigned> m_max_retries { 3 };
+    //! wait before the first retry in milliseconds, growing linearly
+    std::atomic<unsigned> m_backoff_ms { 10 };
+
+    //! number of I/Os retried, of requests issued by splitting, of I/Os
+    //! which failed after all attempts, and of bytes zeroed beyond EOF
+    std::atomic<uint64_t> m_retried { 0 };
+    std::atomic<uint64_t> m_split { 0 };
+    std::atomic<uint64_t> m_failed { 0 };
+    std::atomic<uint64_t> m_zeroed { 0 };
+
+    //! unit of split requests, the alignment required by direct I/O
+    static constexpr size_t alignment = 4096;
+
+    io_retry() = default;
+
+    //! Synchronously perform the I/O in parts requests, zeroing the part of a
+    //! read beyond the end of the file. Returns the last request. All parts
+    //! are waited for before the first error is rethrown, so none of them
+    //! still accesses the buffer when the next attempt starts.
+    foxxll::request_ptr redo(foxxll::file* file, void* buffer, uint64_t offset,
+                             size_t bytes, bool write, size_t parts)
+    {
+        char* cbuffer = static_cast<char*>(buffer);
+
+        if (!write)
+        {
+            const uint64_t file_size = file->size();
+            const uint64_t end = std::max(offset, std::min(offset + bytes, file_size));
+            // keep whole alignment units, which the file reads up to its end
+            const size_t keep = std::min<size_t>(
+                bytes, foxxll::div_ceil(end - offset, size_t(alignment)) * alignment);
+            if (keep < bytes)
+            {
+                memset(cbuffer + keep, 0, bytes - keep);
+                m_zeroed += bytes - keep;
+                bytes = keep;
+            }
+        }
+
+        const size_t part_size = std::max(
+            size_t(alignment),
+            foxxll::div_ceil(foxxll::div_ceil(bytes, parts), size_t(alignment)) * alignment);
+
+        std::vector<foxxll::request_ptr> reqs;
+        std::exception_ptr error;
+        try {
+            for (size_t pos = 0; pos < bytes; pos += part_size)
+            {
+                const size_t n = std::min(part_size, bytes - pos);
+                reqs.push_back(write ? file->awrite(cbuffer + pos, offset + pos, n)
+                               : file->aread(cbuffer + pos, offset + pos, n));
+            }
+        }
+        catch (const foxxll::io_error&) {
+            error = std::current_exception();
+        }
+        if (reqs.size() > 1)
+            m_split += reqs.size();
+
+        for (foxxll::request_ptr& r : reqs)
+        {
+            try {
+                r->wait();
+            }
+            catch (const foxxll::io_error&) {
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+        if (error)
+            std::rethrow_exception(error);
+        return reqs.empty() ? foxxll::request_ptr() : reqs.back();
+    }
+
+public:
+    //! non-copyable: delete copy-constructor
+    io_retry(const io_retry&) = delete;
+    //! non-copyable: delete assignment operator
+    io_retry& operator = (const io_retry&) = delete;
+
+    static io_retry& get_instance()
+    {
+        static io_retry instance;
+        return instance;
+    }
+
+    //! Set the number of attempts after a failed request, zero disables
+    //! recovery, default 3.
+    void set_max_retries(unsigned max_retries)
+    {
+        m_max_retries = max_retries;
+    }
+
+    unsigned max_retries() const
+    {
+        return m_max_retries;
+    }
+
+    //! Set the wait before the first retry in milliseconds, the n-th waits n
+    //! times as long, default 10.
+    void set_backoff(unsigned milliseconds)
+    {
+        m_backoff_ms = milliseconds;
+    }
+
+    unsigned backoff() const
+    {
+        return m_backoff_ms;
+    }
+
+    /*!
+     * Wait for req, the I/O of bytes of buffer at offset of file. If it fails
+     * with foxxll::io_error, the I/O is retried, see io_retry, and req is
+     * replaced by the completed request of the last attempt.
+     */
+    void wait(foxxll::request_ptr& req, foxxll::file* file, void* buffer,
+              uint64_t offset, size_t bytes, bool write)
+    {
+        try {
+            req->wait();
+            return;
+        }
+        catch (const foxxll::io_error& e) {
+            if (m_max_retries == 0)
+                throw;
+            TLX_LOG1 << "io_retry: " << (write ? "write" : "read") << " of "
+                     << bytes << " bytes at " << offset << " failed: " << e.what();
+        }
+
+        m_retried++;
+        for (unsigned attempt = 1; ; ++attempt)
+        {
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds(attempt * m_backoff_ms));
+            try {
+                req = redo(file, buffer, offset, bytes, write, size_t(1) << std::min(attempt, 16u));
+                return;
+            }
+            catch (const foxxll::io_error&) {
+                if (attempt >= m_max_retries)
+                {
+                    m_failed++;
+                    throw;
+                }
+            }
+        }
+    }
+
+    //! Wait for req, the I/O of block from or to its BID, see above.
+    template <typename BlockType, typename BIDType>
+    void wait(foxxll::request_ptr& req, BlockType& block, const BIDType& bid,
+              bool write)
+    {
+        wait(req, bid.storage, &block, bid.offset, BlockType::raw_size, write);
+    }
+
+    //! Number of I/Os retried.
+    uint64_t retried() const
+    {
+        return m_retried;
+    }
+
+    //! Number of requests issued by splitting retried I/Os.
+    uint64_t split() const
+    {
+        return m_split;
+    }
+
+    //! Number of I/Os which failed after all retries.
+    uint64_t failed() const
+    {
+        return m_failed;
+    }
+
+    //! Bytes of reads beyond the end of files returned as zeros.
+    uint64_t zeroed() const
+    {
+        return m_zeroed;
+    }
+
+    void print_status(std::ostream& os) const
+    {
+        os << "io_retry: retried " << retried() << " I/Os, split into "
+           << split() << " requests, " << failed() << " failed, "
+           << zeroed() << " bytes beyond EOF zeroed" << std::endl;
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_IO_RETRY_HEADER
@@ -0,0 +1,192 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/locked_memory.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_LOCKED_MEMORY_HEADER
+#define STXXL_COMMON_LOCKED_MEMORY_HEADER
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include <tlx/logger/core.hpp>
+#include <tlx/unused.hpp>
+
+#include <stxxl/bits/common/settings.h>
+#include <stxxl/bits/config.h>
+
+#if !STXXL_WINDOWS
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Registry of the memory ranges of the containers' caches and pools locked
+ * into RAM by mlock(), such that they are not swapped out under memory
+ * pressure.
+ *
+ * Only the whole pages inside a range are locked, hence a range never shares
+ * a locked page with another one. The locked bytes are accounted against the
+ * soft RLIMIT_MEMLOCK, or a limit set by set_limit(); ranges which exceed it
+ * or which mlock() refuses stay unlocked, and a warning is logged once.
+ */
+class locked_memory
+{
+    static constexpr bool debug = false;
+
+    std::mutex mutex_;
+
+    //! locked pages of the ranges, by their first byte
+    std::unordered_map<const void*, std::pair<void*, size_t> > ranges_;
+
+    //! number of bytes locked
+    std::atomic<size_t> locked_ { 0 };
+
+    //! limit of the locked bytes
+    size_t limit_;
+
+    //! whether the warning was logged
+    bool warned_ = false;
+
+    locked_memory()
+    {
+#if !STXXL_WINDOWS
+        struct rlimit rl;
+        if (getrlimit(RLIMIT_MEMLOCK, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+            limit_ = static_cast<size_t>(rl.rlim_cur);
+        else
+            limit_ = std::numeric_limits<size_t>::max();
+#else
+        limit_ = 0;
+#endif
+    }
+
+    void warn(const char* reason, size_t bytes)
+    {
+        if (warned_)
+            return;
+        warned_ = true;
+        TLX_LOG1 << "WARNING: stxxl::locked_memory: cannot lock " << bytes
+                 << " more bytes into RAM (" << reason << "), " << locked_
+                 << " of at most " << limit_ << " bytes are locked. The"
+                 << " remaining caches may be swapped out, raise the limit"
+                 << " with ulimit -l or grant CAP_IPC_LOCK.";
+    }
+
+public:
+    static locked_memory& get_instance()
+    {
+        static locked_memory instance;
+        return instance;
+    }
+
+    //! Lock the pages inside [p, p + bytes), returns whether they were
+    //! locked. Ranges without a whole page are not locked.
+    bool lock(const void* p, size_t bytes)
+    {
+#if !STXXL_WINDOWS
+        const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        const uintptr_t begin = (reinterpret_cast<uintptr_t>(p) + page - 1) / page * page;
+        const uintptr_t end = (reinterpret_cast<uintptr_t>(p) + bytes) / page * page;
+        if (p == nullptr || end <= begin)
+            return false;
+        const size_t length = end - begin;
+        void* first = reinterpret_cast<void*>(begin);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (ranges_.count(p))
+            return true;
+        if (locked_ + length > limit_)
+        {
+            warn("RLIMIT_MEMLOCK reached", length);
+            return false;
+        }
+        if (mlock(first, length) != 0)
+        {
+            warn(strerror(errno), length);
+            return false;
+        }
+        ranges_[p] = std::make_pair(first, length);
+        locked_ += length;
+        TLX_LOG << "locked_memory: locked " << length << " bytes, "
+                << locked_ << " in total";
+        return true;
+#else
+        tlx::unused(p, bytes);
+        return false;
+#endif
+    }
+
+    //! Unlock the range locked by lock(p, ...), no-op if it was not locked.
+    void unlock(const void* p)
+    {
+#if !STXXL_WINDOWS
+        if (locked_ == 0)
+            return;
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = ranges_.find(p);
+        if (it == ranges_.end())
+            return;
+        munlock(it->second.first, it->second.second);
+        locked_ -= it->second.second;
+        ranges_.erase(it);
+#else
+        tlx::unused(p);
+#endif
+    }
+
+    //! number of bytes locked
+    size_t locked() const { return locked_; }
+
+    //! limit of the locked bytes
+    size_t limit() const { return limit_; }
+
+    //! Set the limit of the locked bytes, e.g. below RLIMIT_MEMLOCK to keep
+    //! some for the application.
+    void set_limit(size_t limit)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        limit_ = limit;
+        warned_ = false;
+    }
+};
+
+//! Lock the n blocks at blocks into RAM if SETTINGS::lock_memory is set,
+//! they must be released by unlock_blocks() before they are freed.
+template <typename BlockType>
+void lock_blocks(const BlockType* blocks, size_t n = 1)
+{
+    if (SETTINGS::lock_memory)
+        locked_memory::get_instance().lock(blocks, n * sizeof(BlockType));
+}
+
+//! Unlock blocks locked by lock_blocks(), no-op if they were not locked.
+template <typename BlockType>
+void unlock_blocks(const BlockType* blocks)
+{
+    locked_memory::get_instance().unlock(blocks);
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_LOCKED_MEMORY_HEADER
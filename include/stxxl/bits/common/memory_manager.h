@@ -0,0 +1,403 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/memory_manager.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_MEMORY_MANAGER_HEADER
+#define STXXL_COMMON_MEMORY_MANAGER_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+#include <tlx/string/format_iec_units.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/exceptions.hpp>
+
+#include <stxxl/bits/config.h>
+
+#if STXXL_HAVE_MALLOC_COUNT
+#include <stxxl/bits/utils/malloc_count.h>
+#endif
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Process wide budget of internal memory, from which containers and
+ * algorithms reserve their buffers, see memory_reservation.
+ *
+ * Each container takes its own memory parameter, the manager checks that the
+ * sum of the reservations stays within limit(). If a reservation would exceed
+ * the limit, the shrink callbacks of the other reservations are asked, largest
+ * first, to release the missing bytes, for example by spilling buffered items
+ * to disk. If they cannot, the reservation either throws
+ * foxxll::bad_parameter or is granted anyway with a warning, depending on
+ * the overdraft policy.
+ *
+ * Without a limit, which is the default, the manager only keeps account of the
+ * reservations, see print_status(). With malloc_count, heap_allocated() is
+ * the heap allocation of the whole process, which includes the reserved
+ * buffers.
+ */
+class memory_manager
+{
+public:
+    //! limit of a manager without budget
+    static constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+
+    //! Function asked to release memory of a reservation. It is called with
+    //! the missing number of bytes and returns the number it released by
+    //! shrinking its reservation.
+    using shrink_callback = std::function<size_t(size_t needed)>;
+
+    //! behaviour if a reservation exceeds the limit
+    enum overdraft_policy {
+        //! throw foxxll::bad_parameter
+        throw_error,
+        //! grant the reservation and log a warning
+        allow
+    };
+
+private:
+    struct entry_type
+    {
+        std::string name;
+        size_t size;
+        shrink_callback shrink;
+    };
+
+    mutable std::mutex m_mutex;
+
+    size_t m_limit;
+    overdraft_policy m_policy;
+
+    //! sum and maximum sum of the reservations
+    size_t m_reserved;
+    size_t m_peak;
+
+    //! reservations by id, zero is no reservation
+    std::map<uint64_t, entry_type> m_entries;
+    uint64_t m_next_id;
+
+    memory_manager()
+        : m_limit(unlimited), m_policy(throw_error),
+          m_reserved(0), m_peak(0), m_next_id(1)
+    { }
+
+    //! Ask the shrink callbacks of all reservations except id to release
+    //! needed bytes. Called without the lock, since the callbacks resize
+    //! their reservations.
+    void shrink_others(uint64_t id, size_t needed)
+    {
+        std::vector<std::pair<size_t, shrink_callback> > callbacks;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (const auto& e : m_entries)
+            {
+                if (e.first != id && e.second.shrink && e.second.size > 0)
+                    callbacks.emplace_back(e.second.size, e.second.shrink);
+            }
+        }
+        std::sort(callbacks.begin(), callbacks.end(),
+                  [](const std::pair<size_t, shrink_callback>& a,
+                     const std::pair<size_t, shrink_callback>& b) {
+                      return a.first > b.first;
+                  });
+
+        for (const auto& c : callbacks)
+        {
+            const size_t released = c.second(needed);
+            if (released >= needed)
+                return;
+            needed -= released;
+        }
+    }
+
+    //! Whether growing the reservations by bytes fits into the limit.
+    bool fits(size_t bytes) const
+    {
+        return bytes <= m_limit && m_reserved <= m_limit - bytes;
+    }
+
+public:
+    //! non-copyable: delete copy-constructor
+    memory_manager(const memory_manager&) = delete;
+    //! non-copyable: delete assignment operator
+    memory_manager& operator = (const memory_manager&) = delete;
+
+    static memory_manager& get_instance()
+    {
+        static memory_manager instance;
+        return instance;
+    }
+
+    //! Set the budget of all reservations, existing reservations are kept
+    //! even if they exceed it.
+    void set_limit(size_t limit)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_limit = limit;
+    }
+
+    //! Budget of all reservations.
+    size_t limit() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_limit;
+    }
+
+    void set_overdraft_policy(overdraft_policy policy)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_policy = policy;
+    }
+
+    overdraft_policy get_overdraft_policy() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_policy;
+    }
+
+    //! Sum of all reservations.
+    size_t reserved() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_reserved;
+    }
+
+    //! Maximum of reserved() since the start of the program.
+    size_t peak() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_peak;
+    }
+
+    //! Bytes of the budget not reserved, zero if overdrawn.
+    size_t available() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_reserved < m_limit ? m_limit - m_reserved : 0;
+    }
+
+    //! Bytes allocated on the heap by the whole process, only with
+    //! malloc_count, otherwise 0.
+    static size_t heap_allocated()
+    {
+#if STXXL_HAVE_MALLOC_COUNT
+        return malloc_count_current();
+#else
+        return 0;
+#endif
+    }
+
+    //! \name Interface of memory_reservation
+    //! \{
+
+    //! Register an empty reservation and return its id.
+    uint64_t add(const std::string& name, shrink_callback shrink)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const uint64_t id = m_next_id++;
+        m_entries.emplace(id, entry_type { name, 0, std::move(shrink) });
+        return id;
+    }
+
+    //! Change the size of the reservation id to bytes. Growing beyond the
+    //! limit first asks the other reservations to shrink, then applies the
+    //! overdraft policy.
+    void resize(uint64_t id, size_t bytes)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(id);
+        assert(it != m_entries.end());
+
+        if (bytes > it->second.size && !fits(bytes - it->second.size))
+        {
+            const size_t missing = m_reserved + (bytes - it->second.size) - m_limit;
+            lock.unlock();
+            shrink_others(id, missing);
+            lock.lock();
+            it = m_entries.find(id);
+            assert(it != m_entries.end());
+
+            if (bytes > it->second.size && !fits(bytes - it->second.size))
+            {
+                if (m_policy == throw_error)
+                {
+                    FOXXLL_THROW2(foxxll::bad_parameter, "memory_manager::resize()",
+                                  "INSUFFICIENT MEMORY: reservation \"" << it->second.name
+                                  << "\" of " << bytes << " bytes exceeds the limit of "
+                                  << m_limit << " bytes, " << m_reserved
+                                  << " bytes are reserved");
+                }
+                TLX_LOG1 << "memory_manager: reservation \"" << it->second.name
+                         << "\" of " << bytes << " bytes exceeds the limit of "
+                         << m_limit << " bytes, " << m_reserved
+                         << " bytes are reserved";
+            }
+        }
+
+        m_reserved = m_reserved - it->second.size + bytes;
+        it->second.size = bytes;
+        m_peak = std::max(m_peak, m_reserved);
+    }
+
+    //! Unregister the reservation id, releasing its bytes.
+    void remove(uint64_t id)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(id);
+        assert(it != m_entries.end());
+        m_reserved -= it->second.size;
+        m_entries.erase(it);
+    }
+
+    //! \}
+
+    //! Print the limit and the reservations by name.
+    void print_status(std::ostream& os) const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        std::map<std::string, std::pair<size_t, size_t> > by_name;
+        for (const auto& e : m_entries)
+        {
+            std::pair<size_t, size_t>& n = by_name[e.second.name];
+            n.first++;
+            n.second += e.second.size;
+        }
+
+        os << "memory_manager: reserved "
+           << tlx::format_iec_units(m_reserved) << "B of limit "
+           << (m_limit == unlimited ? std::string("unlimited")
+            : tlx::format_iec_units(m_limit) + "B")
+           << ", peak " << tlx::format_iec_units(m_peak) << "B";
+#if STXXL_HAVE_MALLOC_COUNT
+        os << ", heap " << tlx::format_iec_units(malloc_count_current()) << "B";
+#endif
+        os << std::endl;
+        for (const auto& n : by_name)
+        {
+            os << "  " << n.first << ": " << n.second.first << " reservations, "
+               << tlx::format_iec_units(n.second.second) << "B" << std::endl;
+        }
+    }
+};
+
+/*!
+ * Reservation of bytes of the budget of the memory_manager, which is
+ * released when the reservation is destroyed.
+ *
+ * Containers and algorithms reserve the memory of their buffers before
+ * allocating them. If they can free memory on request, for example by
+ * writing buffered items to disk, they pass a shrink callback, which calls
+ * resize() on their reservation and returns the bytes released. Callbacks
+ * are called synchronously by the thread whose reservation exceeds the limit.
+ */
+class memory_reservation
+{
+public:
+    using shrink_callback = memory_manager::shrink_callback;
+
+private:
+    //! id at the manager, zero if moved from
+    uint64_t m_id;
+    //! bytes reserved
+    size_t m_size;
+
+public:
+    //! Reserve bytes under name, see memory_manager::resize().
+    explicit memory_reservation(const std::string& name = std::string(),
+                                size_t bytes = 0,
+                                shrink_callback shrink = shrink_callback())
+        : m_id(memory_manager::get_instance().add(name, std::move(shrink))),
+          m_size(0)
+    {
+        try {
+            resize(bytes);
+        }
+        catch (...) {
+            memory_manager::get_instance().remove(m_id);
+            throw;
+        }
+    }
+
+    //! non-copyable: delete copy-constructor
+    memory_reservation(const memory_reservation&) = delete;
+    //! non-copyable: delete assignment operator
+    memory_reservation& operator = (const memory_reservation&) = delete;
+
+    memory_reservation(memory_reservation&& other) noexcept
+        : m_id(other.m_id), m_size(other.m_size)
+    {
+        other.m_id = 0;
+        other.m_size = 0;
+    }
+
+    memory_reservation& operator = (memory_reservation&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    //! Releases the reservation.
+    ~memory_reservation()
+    {
+        if (m_id != 0)
+            memory_manager::get_instance().remove(m_id);
+    }
+
+    //! Change the reservation to bytes, may throw foxxll::bad_parameter if
+    //! growing it exceeds the limit.
+    void resize(size_t bytes)
+    {
+        assert(m_id != 0);
+        if (bytes == m_size)
+            return;
+        memory_manager::get_instance().resize(m_id, bytes);
+        m_size = bytes;
+    }
+
+    //! Release the reserved bytes, keeping the reservation registered.
+    void release()
+    {
+        if (m_id != 0)
+            resize(0);
+    }
+
+    //! Bytes reserved.
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    void swap(memory_reservation& other) noexcept
+    {
+        std::swap(m_id, other.m_id);
+        std::swap(m_size, other.m_size);
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_MEMORY_MANAGER_HEADER
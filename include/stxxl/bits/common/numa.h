@@ -0,0 +1,262 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/numa.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_NUMA_HEADER
+#define STXXL_COMMON_NUMA_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+#include <tlx/unused.hpp>
+
+#include <stxxl/bits/common/settings.h>
+#include <stxxl/bits/common/task_runtime.h>
+#include <stxxl/bits/config.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(SYS_mbind)
+#define STXXL_HAVE_NUMA 1
+#else
+#define STXXL_HAVE_NUMA 0
+#endif
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * The NUMA nodes with CPUs of the machine, as listed in /sys, and placement
+ * of memory ranges on them by mbind(). Without NUMA support, or on machines
+ * with a single node, there is one node and memory is not moved.
+ *
+ * Nodes are numbered 0 to nodes() - 1 here, which need not be the kernel's
+ * node ids.
+ */
+class numa_topology
+{
+    static constexpr bool debug = false;
+
+    //! kernel's node id of each node
+    std::vector<size_t> node_ids_;
+
+    //! node of each CPU
+    std::vector<size_t> cpu_node_;
+
+    numa_topology()
+    {
+#if STXXL_HAVE_NUMA
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string list;
+        if (online >> list)
+        {
+            for (size_t id : parse_list(list))
+            {
+                std::ifstream cpus("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+                std::string cpu_list;
+                if (!(cpus >> cpu_list))
+                    continue;
+                const std::vector<size_t> node_cpus = parse_list(cpu_list);
+                if (node_cpus.empty())
+                    continue;
+                for (size_t cpu : node_cpus)
+                {
+                    if (cpu >= cpu_node_.size())
+                        cpu_node_.resize(cpu + 1, 0);
+                    cpu_node_[cpu] = node_ids_.size();
+                }
+                node_ids_.push_back(id);
+            }
+        }
+#endif
+        if (node_ids_.empty())
+            node_ids_.push_back(0);
+        TLX_LOG << "numa_topology: " << node_ids_.size() << " nodes";
+    }
+
+    //! Parse a list of ranges like "0-3,8,10-11".
+    static std::vector<size_t> parse_list(const std::string& list)
+    {
+        std::vector<size_t> values;
+        std::istringstream in(list);
+        std::string range;
+        while (std::getline(in, range, ','))
+        {
+            const size_t dash = range.find('-');
+            try {
+                const size_t first = std::stoul(range.substr(0, dash));
+                const size_t last = dash == std::string::npos
+                                    ? first : std::stoul(range.substr(dash + 1));
+                for (size_t v = first; v <= last; ++v)
+                    values.push_back(v);
+            }
+            catch (const std::exception&) { }
+        }
+        return values;
+    }
+
+public:
+    static numa_topology& get_instance()
+    {
+        static numa_topology instance;
+        return instance;
+    }
+
+    //! number of nodes
+    size_t nodes() const { return node_ids_.size(); }
+
+    //! Node of the CPU the calling thread runs on. Threads are not pinned,
+    //! hence this is where the thread runs now.
+    size_t current_node() const
+    {
+#if STXXL_HAVE_NUMA
+        const int cpu = sched_getcpu();
+        if (cpu >= 0 && static_cast<size_t>(cpu) < cpu_node_.size())
+            return cpu_node_[cpu];
+#endif
+        return 0;
+    }
+
+    //! Place the whole pages inside [p, p + bytes) on node, moving those
+    //! already touched. Returns whether mbind() succeeded.
+    bool bind(const void* p, size_t bytes, size_t node) const
+    {
+#if STXXL_HAVE_NUMA
+        if (nodes() <= 1 || node >= nodes())
+            return false;
+
+        const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        const uintptr_t begin = (reinterpret_cast<uintptr_t>(p) + page - 1) / page * page;
+        const uintptr_t end = (reinterpret_cast<uintptr_t>(p) + bytes) / page * page;
+        if (p == nullptr || end <= begin)
+            return false;
+
+        // MPOL_PREFERRED falls back to other nodes if the node is full
+        static constexpr int mpol_preferred = 1;
+        static constexpr unsigned mpol_mf_move = 1u << 1;
+        constexpr size_t word_bits = 8 * sizeof(unsigned long);
+        const size_t id = node_ids_[node];
+        std::vector<unsigned long> mask(id / word_bits + 1, 0);
+        mask[id / word_bits] |= 1ul << (id % word_bits);
+
+        if (syscall(SYS_mbind, reinterpret_cast<void*>(begin), end - begin,
+                    mpol_preferred, mask.data(), mask.size() * word_bits + 1,
+                    mpol_mf_move) != 0)
+        {
+            TLX_LOG << "numa_topology: mbind() to node " << id << " failed";
+            return false;
+        }
+        return true;
+#else
+        tlx::unused(p, bytes, node);
+        return false;
+#endif
+    }
+};
+
+//! Node of block i of an array of n blocks placed by numa_partition_blocks()
+//! in groups of group blocks.
+inline size_t numa_block_node(size_t i, size_t n, size_t group = 1)
+{
+    const size_t groups = (n + group - 1) / group;
+    return groups == 0 ? 0 : i / group * numa_topology::get_instance().nodes() / groups;
+}
+
+/*!
+ * Partition the array of n blocks into one contiguous range per node if
+ * SETTINGS::numa_partition is set, keeping groups of group blocks, e.g. the
+ * pages of a vector, on one node. Block i is placed on numa_block_node(i, n,
+ * group).
+ */
+template <typename BlockType>
+void numa_partition_blocks(BlockType* blocks, size_t n, size_t group = 1)
+{
+    numa_topology& topology = numa_topology::get_instance();
+    if (!SETTINGS::numa_partition || topology.nodes() <= 1 || n == 0)
+        return;
+
+    size_t first = 0;
+    for (size_t i = 1; i <= n; ++i)
+    {
+        if (i < n && numa_block_node(i, n, group) == numa_block_node(first, n, group))
+            continue;
+        topology.bind(blocks + first, (i - first) * sizeof(BlockType),
+                      numa_block_node(first, n, group));
+        first = i;
+    }
+}
+
+/*!
+ * Call functor(i) for each i in [0, n) in parallel like parallel_for(),
+ * where each thread first takes the indexes i with node_of(i) equal to its
+ * current node, and then helps with those of the other nodes. Exceptions
+ * are rethrown as by parallel_for(). Without SETTINGS::numa_partition, or
+ * with a single node, this is parallel_for().
+ */
+template <typename NodeOf, typename Functor>
+void numa_parallel_for(size_t n, NodeOf node_of, Functor&& functor)
+{
+    numa_topology& topology = numa_topology::get_instance();
+    const size_t nodes = topology.nodes();
+    if (!SETTINGS::numa_partition || nodes <= 1)
+    {
+        parallel_for(0, n, std::forward<Functor>(functor));
+        return;
+    }
+
+    std::vector<std::vector<size_t> > queues(nodes);
+    for (size_t i = 0; i < n; ++i)
+        queues[node_of(i) % nodes].push_back(i);
+    std::unique_ptr<std::atomic<size_t>[]> next(new std::atomic<size_t>[nodes]);
+    for (size_t node = 0; node < nodes; ++node)
+        next[node] = 0;
+    // a call threw, the remaining indexes are skipped
+    std::atomic<bool> failed { false };
+
+    const size_t threads = std::min(n, task_runtime::get_instance().max_threads());
+    parallel_for(
+        0, threads, [&](size_t) {
+            const size_t home = topology.current_node();
+            for (size_t k = 0; k < nodes; ++k)
+            {
+                const size_t node = (home + k) % nodes;
+                for (size_t q; !failed && (q = next[node]++) < queues[node].size(); )
+                {
+                    try {
+                        functor(queues[node][q]);
+                    }
+                    catch (...) {
+                        failed = true;
+                        throw;
+                    }
+                }
+            }
+        });
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_NUMA_HEADER
@@ -0,0 +1,129 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/prefetch_controller.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_PREFETCH_CONTROLLER_HEADER
+#define STXXL_COMMON_PREFETCH_CONTROLLER_HEADER
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <foxxll/common/timer.hpp>
+
+namespace stxxl {
+
+/*!
+ * Adapts the number of blocks a container prefetches to the rate at which its
+ * blocks are consumed, such that the prefetched blocks just cover the I/O
+ * latency.
+ *
+ * The container reports each block it reads from the prefetching side, with
+ * the time it had to wait for it. The controller keeps a moving average of the
+ * time to consume a block, excluding waits. A wait means that the latency
+ * exceeds the blocks in flight, by about the wait divided by the consumption
+ * time of a block, and the depth grows by as much, once the blocks hinted
+ * before the last increase have arrived. Without waits, the depth shrinks by
+ * one block every few blocks, which returns blocks to a shared prefetch pool
+ * until the consumer waits again.
+ */
+class prefetch_controller
+{
+    //! bounds of the depth
+    size_t m_min_depth, m_max_depth;
+    //! current number of blocks to prefetch
+    size_t m_depth;
+    //! end of the last wait, or zero before the first block
+    double m_last_ready;
+    //! moving average of the time to consume a block
+    double m_consume_time;
+    //! number of blocks since the last wait or decrease
+    size_t m_calm_blocks;
+    //! number of blocks hinted before the last increase, which are still
+    //! late and do not increase the depth again
+    size_t m_settle_blocks;
+
+public:
+    //! waits shorter than this fraction of the consumption time of a block
+    //! are not counted as stalls
+    static constexpr double stall_fraction = 0.05;
+    //! weight of the last block in the moving average
+    static constexpr double smoothing = 0.25;
+    //! blocks without wait, in multiples of the depth, before it is decreased
+    static constexpr size_t calm_factor = 4;
+
+    explicit prefetch_controller(size_t max_depth = 1, size_t min_depth = 1)
+        : m_min_depth(std::min(min_depth, max_depth)),
+          m_max_depth(max_depth),
+          m_depth(m_min_depth),
+          m_last_ready(0.0),
+          m_consume_time(0.0),
+          m_calm_blocks(0),
+          m_settle_blocks(0)
+    { }
+
+    //! Returns the current number of blocks to prefetch.
+    size_t depth() const { return m_depth; }
+
+    //! Sets the maximum number of blocks to prefetch, e.g. to the size of
+    //! the prefetch pool.
+    void set_max_depth(size_t max_depth)
+    {
+        m_max_depth = max_depth;
+        m_min_depth = std::min(m_min_depth, max_depth);
+        m_depth = std::min(m_depth, max_depth);
+    }
+
+    //! Reports a block for which the container waited from wait_begin to
+    //! wait_end, timestamps of foxxll::timestamp(). Returns the new depth.
+    size_t on_block(double wait_begin, double wait_end)
+    {
+        const double wait = wait_end - wait_begin;
+
+        if (m_last_ready > 0.0)
+        {
+            const double consume = std::max(wait_begin - m_last_ready, 0.0);
+            m_consume_time = (m_consume_time == 0.0)
+                             ? consume
+                             : (1.0 - smoothing) * m_consume_time + smoothing * consume;
+        }
+        m_last_ready = wait_end;
+
+        if (m_settle_blocks > 0)
+        {
+            --m_settle_blocks;
+            m_calm_blocks = 0;
+        }
+        else if (wait > stall_fraction * m_consume_time)
+        {
+            // the blocks in flight did not cover the latency
+            const double missing = (m_consume_time > 0.0)
+                                   ? std::ceil(wait / m_consume_time)
+                                   : 1.0;
+            m_settle_blocks = m_depth;
+            m_depth = std::min(m_max_depth, m_depth + static_cast<size_t>(
+                                   std::min(missing, static_cast<double>(m_max_depth))));
+            m_calm_blocks = 0;
+        }
+        else if (++m_calm_blocks >= calm_factor * m_depth && m_depth > m_min_depth)
+        {
+            --m_depth;
+            m_calm_blocks = 0;
+        }
+
+        return m_depth;
+    }
+
+    //! Returns the moving average of the time to consume a block.
+    double consume_time() const { return m_consume_time; }
+};
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_PREFETCH_CONTROLLER_HEADER
@@ -20,16 +20,91 @@
 
 namespace stxxl {
 
+//! allocation strategies selectable at run time by
+//! settings::alloc_strategy, see runtime_alloc_strategy
+enum class alloc_strategy_kind {
+    //! foxxll::default_alloc_strategy
+    default_strategy,
+    striping,
+    fully_random,
+    simple_random,
+    random_cyclic,
+    //! stxxl::weighted_striping by measured disk speed and capacity
+    weighted
+};
+
 template <typename MustBeInt = int>
 class settings
 {
 public:
     static bool native_merge;
+
+    //! form one run per thread concurrently in stxxl::sort's run formation
+    static bool parallel_run_formation;
+
+    //! let the stream sorters sort and write runs, and merge ahead the next
+    //! output block, in a background thread
+    static bool async_pipelining;
+
+    //! let stxxl::sort distribute the elements to buckets by sampled
+    //! splitters and sort the buckets in memory, instead of merging runs
+    static bool sample_sort;
+
+    //! back the large block arrays of the sorters with huge pages
+    static bool huge_pages;
+
+    //! let the stream sorters keep inputs which fit into their run buffers
+    //! in internal memory and serve them from there, without writing runs
+    static bool in_memory_sort;
+
+    //! allocation strategy of the containers and sorters whose strategy
+    //! parameter is runtime_alloc_strategy, read when they are constructed
+    static alloc_strategy_kind alloc_strategy;
+
+    //! return the disk space of blocks freed by the sorters and containers
+    //! to the file system by punching holes, see disk_space_reclaimer
+    static bool reclaim_disk_space;
+
+    //! lock the page caches, block caches and prefetch pools of the
+    //! containers into RAM by mlock(), see locked_memory
+    static bool lock_memory;
+
+    //! partition the page caches of the vectors and the buffers of the
+    //! parallel scans over the NUMA nodes, and process each part on threads
+    //! of its node, see numa_topology
+    static bool numa_partition;
 };
 
 template <typename MustBeInt>
 bool settings<MustBeInt>::native_merge = false;
 
+template <typename MustBeInt>
+bool settings<MustBeInt>::parallel_run_formation = false;
+
+template <typename MustBeInt>
+bool settings<MustBeInt>::async_pipelining = false;
+
+template <typename MustBeInt>
+bool settings<MustBeInt>::sample_sort = false;
+
+template <typename MustBeInt>
+bool settings<MustBeInt>::huge_pages = false;
+
+template <typename MustBeInt>
+bool settings<MustBeInt>::in_memory_sort = false;
+
+template <typename MustBeInt>
+alloc_strategy_kind settings<MustBeInt>::alloc_strategy = alloc_strategy_kind::default_strategy;
+
+template <typename MustBeInt>
+bool settings<MustBeInt>::reclaim_disk_space = false;
+
+template <typename MustBeInt>
+bool settings<MustBeInt>::lock_memory = false;
+
+template <typename MustBeInt>
+bool settings<MustBeInt>::numa_partition = false;
+
 using SETTINGS = settings<>;
 
 } // namespace stxxl
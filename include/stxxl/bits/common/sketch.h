@@ -0,0 +1,401 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/sketch.h
+ *
+ *  Mergeable summaries of the distribution of a sequence: the quantile
+ *  sketch of Zohar Karnin, Kevin Lang and Edo Liberty. "Optimal Quantile
+ *  Approximation in Streams". FOCS 2016, and the cardinality estimate of
+ *  Philippe Flajolet et al. "HyperLogLog: the analysis of a near-optimal
+ *  cardinality estimation algorithm". AofA 2007.
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_SKETCH_HEADER
+#define STXXL_COMMON_SKETCH_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <tlx/math/integer_log2.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * KLL quantile sketch: estimates the rank of a value among the values
+ * inserted, and the value of a given rank, with an additive error of about
+ * 1.7 / k of the number of values with high probability, in
+ * O(k + log(n / k)) values of memory.
+ *
+ * The values are kept in compactors of geometrically decreasing capacity,
+ * the values of level h standing for 2^h inserted values each. A full
+ * compactor is sorted and every other value, starting at a random offset,
+ * is promoted to the next level. Sketches of different parts of a sequence,
+ * e.g. filled by different threads, are combined by merge().
+ *
+ * \tparam ValueType type of the values
+ * \tparam CompareType strict weak ordering of the values
+ */
+template <typename ValueType, typename CompareType = std::less<ValueType> >
+class kll_sketch
+{
+public:
+    using value_type = ValueType;
+    using compare_type = CompareType;
+    using size_type = external_size_type;
+
+private:
+    //! accuracy parameter: capacity of the top compactor
+    size_t m_k;
+
+    CompareType m_cmp;
+
+    //! compactors, level h weighing 2^h
+    std::vector<std::vector<value_type> > m_levels;
+
+    //! number of values inserted
+    size_type m_size;
+
+    //! number of values held, and the sum of the capacities of the levels
+    size_t m_held, m_capacity;
+
+    //! smallest and largest value inserted
+    value_type m_minimum, m_maximum;
+
+    //! state of the xorshift generator choosing the compaction offsets
+    uint64_t m_random;
+
+    //! Capacity of level h: k scaled by (2/3)^(height - 1 - h), at least 8.
+    size_t level_capacity(size_t h) const
+    {
+        const double depth = static_cast<double>(m_levels.size() - 1 - h);
+        return std::max<size_t>(
+            static_cast<size_t>(std::ceil(static_cast<double>(m_k) * std::pow(2.0 / 3.0, depth))), 8);
+    }
+
+    void update_capacity()
+    {
+        m_capacity = 0;
+        for (size_t h = 0; h < m_levels.size(); ++h)
+            m_capacity += level_capacity(h);
+    }
+
+    bool random_bit()
+    {
+        m_random ^= m_random << 13;
+        m_random ^= m_random >> 7;
+        m_random ^= m_random << 17;
+        return (m_random >> 32) & 1;
+    }
+
+    //! Compact the lowest level at its capacity until the values held fit
+    //! into the capacity.
+    void compress()
+    {
+        while (m_held >= m_capacity)
+        {
+            size_t h = 0;
+            while (m_levels[h].size() < level_capacity(h))
+                ++h;
+
+            if (h + 1 == m_levels.size())
+            {
+                m_levels.emplace_back();
+                update_capacity();
+            }
+
+            std::vector<value_type>& level = m_levels[h];
+            std::vector<value_type>& next = m_levels[h + 1];
+            std::sort(level.begin(), level.end(), m_cmp);
+
+            // an odd value stays in the level
+            const size_t pairs = level.size() / 2;
+            const size_t offset = random_bit() ? 1 : 0;
+            for (size_t i = 0; i < pairs; ++i)
+                next.push_back(level[level.size() - 2 * pairs + 2 * i + offset]);
+            level.resize(level.size() - 2 * pairs);
+            m_held -= pairs;
+        }
+    }
+
+    //! The values held with their weights in ascending order.
+    std::vector<std::pair<value_type, size_type> > weighted_values() const
+    {
+        std::vector<std::pair<value_type, size_type> > values;
+        values.reserve(m_held);
+        for (size_t h = 0; h < m_levels.size(); ++h)
+        {
+            for (const value_type& v : m_levels[h])
+                values.emplace_back(v, size_type(1) << h);
+        }
+        std::sort(values.begin(), values.end(),
+                  [this](const std::pair<value_type, size_type>& a,
+                         const std::pair<value_type, size_type>& b) {
+                      return m_cmp(a.first, b.first);
+                  });
+        return values;
+    }
+
+public:
+    //! Create an empty sketch with accuracy parameter k.
+    explicit kll_sketch(size_t k = 200, const CompareType& cmp = CompareType(),
+                        uint64_t seed = 0x9E3779B97F4A7C15ull)
+        : m_k(k), m_cmp(cmp), m_levels(1), m_size(0), m_held(0),
+          m_minimum(), m_maximum(), m_random(seed | 1)
+    {
+        if (k < 8)
+            throw foxxll::bad_parameter("stxxl::kll_sketch(): k must be at least 8");
+        update_capacity();
+    }
+
+    //! Insert a value.
+    void insert(const value_type& v)
+    {
+        if (m_size == 0 || m_cmp(v, m_minimum))
+            m_minimum = v;
+        if (m_size == 0 || m_cmp(m_maximum, v))
+            m_maximum = v;
+        m_levels[0].push_back(v);
+        ++m_size;
+        if (++m_held >= m_capacity)
+            compress();
+    }
+
+    //! Add the values summarized by other to this sketch.
+    void merge(const kll_sketch& other)
+    {
+        if (other.empty())
+            return;
+        if (empty() || m_cmp(other.m_minimum, m_minimum))
+            m_minimum = other.m_minimum;
+        if (empty() || m_cmp(m_maximum, other.m_maximum))
+            m_maximum = other.m_maximum;
+        while (m_levels.size() < other.m_levels.size())
+            m_levels.emplace_back();
+        for (size_t h = 0; h < other.m_levels.size(); ++h)
+        {
+            m_levels[h].insert(m_levels[h].end(),
+                               other.m_levels[h].begin(), other.m_levels[h].end());
+        }
+        m_size += other.m_size;
+        m_held += other.m_held;
+        update_capacity();
+        compress();
+    }
+
+    //! number of values inserted
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    //! whether no values were inserted
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    //! number of values held
+    size_t num_retained() const
+    {
+        return m_held;
+    }
+
+    //! accuracy parameter
+    size_t k() const
+    {
+        return m_k;
+    }
+
+    //! smallest value inserted, the sketch must not be empty
+    const value_type & minimum() const
+    {
+        assert(!empty());
+        return m_minimum;
+    }
+
+    //! largest value inserted, the sketch must not be empty
+    const value_type & maximum() const
+    {
+        assert(!empty());
+        return m_maximum;
+    }
+
+    //! Estimated number of values inserted which are less than v.
+    size_type rank(const value_type& v) const
+    {
+        size_type r = 0;
+        for (size_t h = 0; h < m_levels.size(); ++h)
+        {
+            for (const value_type& x : m_levels[h])
+            {
+                if (m_cmp(x, v))
+                    r += size_type(1) << h;
+            }
+        }
+        return r;
+    }
+
+    //! Estimated value of rank q * size() for q in [0, 1], the minimum() for
+    //! q = 0 and the maximum() for q = 1. The sketch must not be empty.
+    value_type quantile(double q) const
+    {
+        return quantiles({ q }).front();
+    }
+
+    //! Estimated values of the ranks qs[i] * size() for ascending qs[i] in
+    //! [0, 1], computed from one sorted copy of the sketch. The sketch must
+    //! not be empty.
+    std::vector<value_type> quantiles(const std::vector<double>& qs) const
+    {
+        assert(!empty());
+        const std::vector<std::pair<value_type, size_type> > values = weighted_values();
+
+        std::vector<value_type> result;
+        result.reserve(qs.size());
+        size_t i = 0;
+        size_type weight = values[0].second;
+        for (const double& q : qs)
+        {
+            assert(q >= 0.0 && q <= 1.0);
+            if (q <= 0.0 || q >= 1.0)
+            {
+                result.push_back(q <= 0.0 ? m_minimum : m_maximum);
+                continue;
+            }
+            const double target = q * static_cast<double>(m_size);
+            // the first value whose cumulative weight exceeds the rank
+            while (i + 1 < values.size() && static_cast<double>(weight) <= target)
+                weight += values[++i].second;
+            result.push_back(values[i].first);
+        }
+        return result;
+    }
+
+    //! Estimated splitters of num_parts parts of equal size, the
+    //! num_parts - 1 values of the ranks i * size() / num_parts, e.g. for
+    //! sorter::partitioned_output().
+    std::vector<value_type> splitters(size_t num_parts) const
+    {
+        std::vector<double> qs;
+        for (size_t i = 1; i < num_parts; ++i)
+            qs.push_back(static_cast<double>(i) / static_cast<double>(num_parts));
+        if (qs.empty() || empty())
+            return std::vector<value_type>();
+        return quantiles(qs);
+    }
+};
+
+/*!
+ * HyperLogLog cardinality estimate: estimates the number of distinct values
+ * inserted with a relative standard error of 1.04 / sqrt(2^precision), in
+ * 2^precision bytes. The hash values are mixed with the finalizer of
+ * MurmurHash3, such that identity hashes of integers may be used. For small
+ * cardinalities, the estimate is corrected by linear counting. Sketches of
+ * different parts of a sequence, e.g. filled by different threads, are
+ * combined by merge().
+ *
+ * \tparam ValueType type of the values
+ * \tparam HashType hash function object of the values
+ */
+template <typename ValueType, typename HashType = std::hash<ValueType> >
+class hyperloglog
+{
+public:
+    using value_type = ValueType;
+    using hash_type = HashType;
+
+private:
+    //! number of bits of the hash selecting the register
+    unsigned m_precision;
+
+    HashType m_hash;
+
+    //! maximum position of the first one bit after the register bits
+    std::vector<uint8_t> m_registers;
+
+public:
+    //! Create an empty estimate of 2^precision registers, precision in [4, 18].
+    explicit hyperloglog(unsigned precision = 14, const HashType& hash = HashType())
+        : m_precision(precision), m_hash(hash)
+    {
+        if (precision < 4 || precision > 18)
+            throw foxxll::bad_parameter(
+                      "stxxl::hyperloglog(): precision must be in [4, 18]");
+        m_registers.assign(size_t(1) << precision, 0);
+    }
+
+    //! Insert a value.
+    void insert(const value_type& v)
+    {
+        uint64_t h = static_cast<uint64_t>(m_hash(v));
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+
+        const size_t index = static_cast<size_t>(h >> (64 - m_precision));
+        const uint64_t rest = h & ((uint64_t(1) << (64 - m_precision)) - 1);
+        const uint8_t rho = static_cast<uint8_t>(
+            rest == 0 ? 65 - m_precision : 64 - m_precision - tlx::integer_log2_floor(rest));
+        m_registers[index] = std::max(m_registers[index], rho);
+    }
+
+    //! Add the values summarized by other, of the same precision, to this
+    //! estimate.
+    void merge(const hyperloglog& other)
+    {
+        if (other.m_precision != m_precision)
+            throw foxxll::bad_parameter(
+                      "stxxl::hyperloglog::merge(): the precisions differ");
+        for (size_t i = 0; i < m_registers.size(); ++i)
+            m_registers[i] = std::max(m_registers[i], other.m_registers[i]);
+    }
+
+    //! Estimated number of distinct values inserted.
+    double estimate() const
+    {
+        const double m = static_cast<double>(m_registers.size());
+        double sum = 0.0;
+        size_t zeros = 0;
+        for (const uint8_t& r : m_registers)
+        {
+            sum += std::ldexp(1.0, -static_cast<int>(r));
+            zeros += (r == 0);
+        }
+
+        const double alpha = 0.7213 / (1.0 + 1.079 / m);
+        const double raw = alpha * m * m / sum;
+        if (raw <= 2.5 * m && zeros != 0)
+            return m * std::log(m / static_cast<double>(zeros));
+        return raw;
+    }
+
+    //! number of bits of the hash selecting the register
+    unsigned precision() const
+    {
+        return m_precision;
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_SKETCH_HEADER
@@ -0,0 +1,279 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/stats_sampler.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_STATS_SAMPLER_HEADER
+#define STXXL_COMMON_STATS_SAMPLER_HEADER
+
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io/iostats.hpp>
+
+#include <stxxl/bits/common/custom_stats.h>
+#include <stxxl/bits/config.h>
+
+#if STXXL_HAVE_MALLOC_COUNT
+#include <stxxl/bits/utils/malloc_count.h>
+#endif
+
+namespace stxxl {
+
+//! One snapshot of a stats_sampler. All values are cumulative since the
+//! start of the program, except the current heap allocation.
+struct stats_sample
+{
+    //! seconds since the sampler was constructed
+    double time;
+    //! I/O statistics of foxxll
+    foxxll::stats_data io;
+    //! bytes allocated on the heap, only with malloc_count, otherwise 0
+    size_t malloc_current;
+    //! peak bytes allocated on the heap, only with malloc_count, otherwise 0
+    size_t malloc_peak;
+    //! values of the registered counters, in the order of registration
+    std::vector<uint64_t> counters;
+};
+
+/*!
+ * Background thread which periodically snapshots the foxxll I/O statistics,
+ * the heap allocation of malloc_count and registered custom_stats_counter
+ * objects, for diagnosing long running programs while they run.
+ *
+ * The last capacity samples are kept in a ring buffer, see samples(). If a
+ * log is set, each sample is also written as one line of key=value pairs,
+ * which <tt>stxxl_tool top</tt> follows and displays as rates:
+ *
+ * \verbatim
+ STATS time=12.0 read_count=1024 read_bytes=2147483648 ... counter.runs=17
+ \endverbatim
+ *
+ * Counters are read without synchronization by the sampler thread, hence a
+ * sample may miss the latest updates of a counter. Counters must be
+ * registered before start() and outlive the sampler.
+ */
+class stats_sampler
+{
+public:
+    //! function returning the current value of a counter
+    using counter_function = std::function<uint64_t()>;
+
+private:
+    //! seconds between two samples
+    double m_interval;
+
+    //! ring buffer of the last samples, m_next is the slot of the next one
+    std::vector<stats_sample> m_samples;
+    size_t m_next, m_count;
+
+    std::vector<std::string> m_counter_names;
+    std::vector<counter_function> m_counters;
+
+    //! time of construction
+    double m_begin;
+
+    //! log of the samples, or nullptr
+    std::ostream* m_log;
+    //! log file opened by set_log_file()
+    std::ofstream m_log_file;
+
+    std::thread m_thread;
+    bool m_running;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    //! Write one sample to the log.
+    void write_log(const stats_sample& s)
+    {
+        std::ostream& os = *m_log;
+        os << "STATS time=" << s.time
+           << " read_count=" << s.io.get_read_count()
+           << " read_bytes=" << s.io.get_read_bytes()
+           << " read_time=" << s.io.get_read_time()
+           << " write_count=" << s.io.get_write_count()
+           << " write_bytes=" << s.io.get_write_bytes()
+           << " write_time=" << s.io.get_write_time()
+           << " io_wait=" << s.io.get_io_wait_time()
+           << " malloc_current=" << s.malloc_current
+           << " malloc_peak=" << s.malloc_peak;
+        for (size_t i = 0; i < m_counter_names.size(); ++i)
+            os << " counter." << m_counter_names[i] << '=' << s.counters[i];
+        // flush such that readers following the log see whole samples
+        os << std::endl;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running)
+        {
+            if (m_cv.wait_for(lock, std::chrono::duration<double>(m_interval),
+                              [this]() { return !m_running; }))
+                break;
+            lock.unlock();
+            sample();
+            lock.lock();
+        }
+    }
+
+public:
+    //! Create a sampler, which is started by start().
+    //! \param interval seconds between two samples
+    //! \param capacity number of samples kept in the ring buffer
+    explicit stats_sampler(double interval = 1.0, size_t capacity = 3600)
+        : m_interval(interval), m_samples(capacity), m_next(0), m_count(0),
+          m_begin(foxxll::timestamp()), m_log(nullptr), m_running(false)
+    {
+        assert(interval > 0 && capacity > 0);
+    }
+
+    //! non-copyable: delete copy-constructor
+    stats_sampler(const stats_sampler&) = delete;
+    //! non-copyable: delete assignment operator
+    stats_sampler& operator = (const stats_sampler&) = delete;
+
+    //! Stops the thread, the last sample is taken on stop().
+    ~stats_sampler()
+    {
+        stop();
+    }
+
+    //! Register a counter sampled by calling f.
+    //! \param name name of the counter in the log, must not contain spaces or '='
+    void add_counter(const std::string& name, counter_function f)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        assert(!m_running);
+        assert(name.find_first_of(" =") == std::string::npos);
+        m_counter_names.push_back(name);
+        m_counters.push_back(std::move(f));
+    }
+
+    //! Register a custom_stats_counter, which must outlive the sampler.
+    //! \param name name of the counter in the log, must not contain spaces or '='
+    template <typename ValueType>
+    void add_counter(const std::string& name,
+                     const custom_stats_counter<ValueType>& counter)
+    {
+        add_counter(name, [&counter]() {
+                        return static_cast<uint64_t>(static_cast<ValueType>(counter));
+                    });
+    }
+
+    //! Write the samples as lines to os, which must outlive the sampler.
+    void set_log(std::ostream& os)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_log = &os;
+    }
+
+    //! Write the samples as lines to the file at path, which is truncated.
+    void set_log_file(const std::string& path)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_log_file.close();
+        m_log_file.open(path.c_str(), std::ios::out | std::ios::trunc);
+        if (!m_log_file.good())
+            FOXXLL_THROW_ERRNO(foxxll::io_error,
+                               "stats_sampler: cannot open log file " << path);
+        m_log = &m_log_file;
+    }
+
+    //! Start the sampling thread.
+    void start()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_running)
+            return;
+        m_running = true;
+        m_thread = std::thread([this]() { run(); });
+    }
+
+    //! Stop the sampling thread and take a last sample.
+    void stop()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_running)
+                return;
+            m_running = false;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+        sample();
+    }
+
+    //! Take a sample now, in addition to the periodic ones.
+    void sample()
+    {
+        stats_sample s;
+        s.time = foxxll::timestamp() - m_begin;
+        s.io = foxxll::stats_data(*foxxll::stats::get_instance());
+#if STXXL_HAVE_MALLOC_COUNT
+        s.malloc_current = malloc_count_current();
+        s.malloc_peak = malloc_count_peak();
+#else
+        s.malloc_current = s.malloc_peak = 0;
+#endif
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        s.counters.reserve(m_counters.size());
+        for (const counter_function& f : m_counters)
+            s.counters.push_back(f());
+
+        if (m_log)
+            write_log(s);
+
+        m_samples[m_next] = std::move(s);
+        m_next = (m_next + 1) % m_samples.size();
+        if (m_count < m_samples.size())
+            ++m_count;
+    }
+
+    //! The samples in the ring buffer, oldest first.
+    std::vector<stats_sample> samples() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::vector<stats_sample> out;
+        out.reserve(m_count);
+        size_t i = (m_next + m_samples.size() - m_count) % m_samples.size();
+        for (size_t k = 0; k < m_count; ++k, i = (i + 1) % m_samples.size())
+            out.push_back(m_samples[i]);
+        return out;
+    }
+
+    //! Names of the registered counters.
+    const std::vector<std::string>& counter_names() const
+    {
+        return m_counter_names;
+    }
+
+    //! Seconds between two samples.
+    double interval() const
+    {
+        return m_interval;
+    }
+};
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_STATS_SAMPLER_HEADER
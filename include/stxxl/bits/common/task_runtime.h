@@ -0,0 +1,417 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/task_runtime.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_TASK_RUNTIME_HEADER
+#define STXXL_COMMON_TASK_RUNTIME_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <stxxl/bits/config.h>
+
+#if STXXL_PARALLEL
+ #include <omp.h>
+#endif
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+//! A task submitted to a task_executor.
+using task_type = std::function<void()>;
+
+/*!
+ * Interface of the executors running the tasks of the parallel algorithms
+ * and containers, see task_runtime.
+ */
+class task_executor
+{
+public:
+    virtual ~task_executor() = default;
+
+    //! Run the task asynchronously on some thread. Tasks must not throw.
+    virtual void submit(task_type task) = 0;
+
+    //! Number of tasks the executor runs concurrently.
+    virtual size_t concurrency() const = 0;
+};
+
+/*!
+ * Pool of threads, each with its own deque of tasks. Tasks submitted by a
+ * worker go to the back of its deque, which it works on last in first out,
+ * others are distributed round robin. Idle workers steal from the front of
+ * the other deques.
+ */
+class work_stealing_pool : public task_executor
+{
+    struct worker_type
+    {
+        std::mutex mutex;
+        std::deque<task_type> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_type> > m_workers;
+    std::vector<std::thread> m_threads;
+
+    //! number of tasks in the deques
+    std::atomic<size_t> m_pending { 0 };
+    //! next deque of a task submitted by a thread outside the pool
+    std::atomic<size_t> m_next { 0 };
+
+    std::mutex m_idle_mutex;
+    std::condition_variable m_idle_cv;
+    bool m_terminate = false;
+
+    //! pool and index of the worker running on this thread
+    static work_stealing_pool*& this_pool()
+    {
+        static thread_local work_stealing_pool* pool = nullptr;
+        return pool;
+    }
+    static size_t& this_index()
+    {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    //! Take a task from the back of deque w or the front of another.
+    bool take(size_t w, task_type& task)
+    {
+        for (size_t i = 0; i < m_workers.size(); ++i)
+        {
+            worker_type& q = *m_workers[(w + i) % m_workers.size()];
+            std::unique_lock<std::mutex> lock(q.mutex);
+            if (q.tasks.empty())
+                continue;
+            if (i == 0) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            else {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            --m_pending;
+            return true;
+        }
+        return false;
+    }
+
+    void worker(size_t w)
+    {
+        this_pool() = this;
+        this_index() = w;
+
+        task_type task;
+        while (true)
+        {
+            if (take(w, task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_idle_mutex);
+            m_idle_cv.wait(lock, [this]() { return m_pending > 0 || m_terminate; });
+            if (m_terminate && m_pending == 0)
+                return;
+        }
+    }
+
+public:
+    //! Start num_threads workers, default one per hardware thread.
+    explicit work_stealing_pool(size_t num_threads = 0)
+    {
+        if (num_threads == 0)
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (size_t w = 0; w < num_threads; ++w)
+            m_workers.emplace_back(new worker_type);
+        for (size_t w = 0; w < num_threads; ++w)
+            m_threads.emplace_back([this, w]() { worker(w); });
+    }
+
+    //! non-copyable: delete copy-constructor
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    //! non-copyable: delete assignment operator
+    work_stealing_pool& operator = (const work_stealing_pool&) = delete;
+
+    //! Run the remaining tasks and join the workers.
+    ~work_stealing_pool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_idle_mutex);
+            m_terminate = true;
+        }
+        m_idle_cv.notify_all();
+        for (std::thread& t : m_threads)
+            t.join();
+    }
+
+    void submit(task_type task) final
+    {
+        const size_t w = (this_pool() == this)
+                         ? this_index() : m_next++ % m_workers.size();
+        {
+            std::unique_lock<std::mutex> lock(m_workers[w]->mutex);
+            m_workers[w]->tasks.push_back(std::move(task));
+        }
+        ++m_pending;
+        {
+            std::unique_lock<std::mutex> lock(m_idle_mutex);
+        }
+        m_idle_cv.notify_one();
+    }
+
+    size_t concurrency() const final
+    {
+        return m_threads.size();
+    }
+};
+
+//! Adapter of a submit function of the application's executor, e.g. a
+//! thread pool it already runs, to task_executor.
+class function_executor : public task_executor
+{
+    std::function<void(task_type)> m_submit;
+    size_t m_concurrency;
+
+public:
+    function_executor(std::function<void(task_type)> submit, size_t concurrency)
+        : m_submit(std::move(submit)), m_concurrency(std::max<size_t>(1, concurrency))
+    { }
+
+    void submit(task_type task) final
+    {
+        m_submit(std::move(task));
+    }
+
+    size_t concurrency() const final
+    {
+        return m_concurrency;
+    }
+};
+
+/*!
+ * Runtime executing the parallel loops of the algorithms and containers.
+ *
+ * All loops submit their tasks to one executor, by default a
+ * work_stealing_pool with one thread per hardware thread, created on first
+ * use. Thus concurrent sorts started from an application's threads share the
+ * cores, instead of each opening an OpenMP team of its own. set_executor()
+ * replaces the pool, e.g. by the application's executor via
+ * function_executor.
+ *
+ * parallel_for() runs a loop on up to max_threads() threads, the calling
+ * thread included, which takes part in the loop. Hence loops nested in the
+ * tasks of another loop cannot dead-lock, even if all workers are busy.
+ */
+class task_runtime
+{
+    mutable std::mutex m_mutex;
+    std::shared_ptr<task_executor> m_executor;
+    //! whether the executor was set by set_executor()
+    bool m_user_executor = false;
+
+    //! index of the current thread in the innermost loop
+    static size_t& this_thread_id()
+    {
+        static thread_local size_t id = 0;
+        return id;
+    }
+
+    task_runtime() = default;
+
+    //! Shared state of a parallel_for.
+    template <typename Functor>
+    struct loop_type
+    {
+        size_t begin, size;
+        Functor* functor;
+        //! next index and number of indexes done
+        std::atomic<size_t> next { 0 }, done { 0 };
+        //! a call threw, the remaining indexes are skipped
+        std::atomic<bool> failed { false };
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::exception_ptr error;
+
+        //! Run indexes until none are left, as thread id of the loop.
+        void run(size_t id)
+        {
+            const size_t prev_id = this_thread_id();
+            this_thread_id() = id;
+
+            size_t finished = 0;
+            for (size_t i; (i = next++) < size; ++finished)
+            {
+                if (failed)
+                    continue;
+                try {
+                    (*functor)(begin + i);
+                }
+                catch (...) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (!error)
+                        error = std::current_exception();
+                    failed = true;
+                }
+            }
+
+            this_thread_id() = prev_id;
+            if (finished != 0 && (done += finished) == size)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.notify_all();
+            }
+        }
+    };
+
+public:
+    //! non-copyable: delete copy-constructor
+    task_runtime(const task_runtime&) = delete;
+    //! non-copyable: delete assignment operator
+    task_runtime& operator = (const task_runtime&) = delete;
+
+    static task_runtime& get_instance()
+    {
+        static task_runtime instance;
+        return instance;
+    }
+
+    //! Submit the tasks to executor from now on, nullptr returns to the
+    //! default pool. Loops running keep their executor.
+    void set_executor(std::shared_ptr<task_executor> executor)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_user_executor = (executor != nullptr);
+        m_executor = std::move(executor);
+    }
+
+    //! Submit the tasks to the application's executor by its submit
+    //! function, which runs up to concurrency tasks at a time.
+    void set_executor(std::function<void(task_type)> submit, size_t concurrency)
+    {
+        set_executor(std::make_shared<function_executor>(std::move(submit), concurrency));
+    }
+
+    //! The executor, creating the default pool on first use.
+    std::shared_ptr<task_executor> executor()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_executor)
+            m_executor = std::make_shared<work_stealing_pool>();
+        return m_executor;
+    }
+
+    /*!
+     * Maximum number of threads of a loop: the concurrency of an executor set
+     * by set_executor(), otherwise omp_get_max_threads(), hence
+     * OMP_NUM_THREADS and omp_set_num_threads() limit the loops, or one
+     * without OpenMP.
+     */
+    size_t max_threads() const
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_user_executor)
+                return m_executor->concurrency();
+        }
+#if STXXL_PARALLEL
+        return static_cast<size_t>(std::max(1, omp_get_max_threads()));
+#else
+        return 1;
+#endif
+    }
+
+    //! Index of the current thread in the innermost parallel_for() running
+    //! on it, less than the max_threads() at the start of the loop, for
+    //! per-thread state. Zero outside of loops.
+    static size_t thread_id()
+    {
+        return this_thread_id();
+    }
+
+    /*!
+     * Call functor(i) for each i in [begin, end) on up to max_threads()
+     * threads, each taking the next index when done with its last, like
+     * OpenMP's schedule(dynamic, 1). Returns when all calls are done, and
+     * rethrows the first exception thrown by them, skipping the indexes not
+     * started yet.
+     */
+    template <typename Functor>
+    void parallel_for(size_t begin, size_t end, Functor&& functor)
+    {
+        if (end <= begin)
+            return;
+
+        const size_t threads = std::min(end - begin, max_threads());
+        if (threads <= 1)
+        {
+            const size_t prev_id = this_thread_id();
+            this_thread_id() = 0;
+            try {
+                for (size_t i = begin; i < end; ++i)
+                    functor(i);
+            }
+            catch (...) {
+                this_thread_id() = prev_id;
+                throw;
+            }
+            this_thread_id() = prev_id;
+            return;
+        }
+
+        using loop_ptr = std::shared_ptr<loop_type<typename std::remove_reference<Functor>::type> >;
+        loop_ptr loop = std::make_shared<typename loop_ptr::element_type>();
+        loop->begin = begin;
+        loop->size = end - begin;
+        loop->functor = &functor;
+
+        // helpers starting after the loop is done find no index left, and
+        // never touch the functor
+        std::shared_ptr<task_executor> exec = executor();
+        for (size_t id = 1; id < threads; ++id)
+            exec->submit([loop, id]() { loop->run(id); });
+
+        loop->run(0);
+
+        std::unique_lock<std::mutex> lock(loop->mutex);
+        loop->cv.wait(lock, [&loop]() { return loop->done == loop->size; });
+        if (loop->error)
+            std::rethrow_exception(loop->error);
+    }
+};
+
+//! Run functor(i) for each i in [begin, end) in parallel, see
+//! task_runtime::parallel_for().
+template <typename Functor>
+void parallel_for(size_t begin, size_t end, Functor&& functor)
+{
+    task_runtime::get_instance().parallel_for(
+        begin, end, std::forward<Functor>(functor));
+}
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_COMMON_TASK_RUNTIME_HEADER
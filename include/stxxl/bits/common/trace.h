@@ -0,0 +1,271 @@
+/***************************************************************************
+ *  include/stxxl/bits/common/trace.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_COMMON_TRACE_HEADER
+#define STXXL_COMMON_TRACE_HEADER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/exceptions.hpp>
+
+#include <stxxl/bits/config.h>
+
+#ifndef STXXL_TRACE
+#define STXXL_TRACE 0
+#endif
+
+namespace stxxl {
+
+//! \addtogroup support
+//! \{
+
+/*!
+ * Recorder of the trace spans of the sorters and containers.
+ *
+ * Each thread appends the spans it completes to a buffer of its own, so
+ * recording takes no shared lock. The spans can be exported in the Chrome
+ * trace event format, which chrome://tracing, Perfetto and speedscope show
+ * as a flame chart per thread, e.g. run formation on one thread next to the
+ * async writes of the runs.
+ *
+ * Spans are only compiled in with STXXL_TRACE, see STXXL_TRACE_SPAN, and
+ * recorded while enabled. If the environment variable STXXL_TRACE_FILE is
+ * set, recording starts enabled and the trace is saved to that path at the
+ * end of the program.
+ */
+class trace_recorder
+{
+public:
+    //! a completed span, with timestamps in microseconds since the start
+    struct event_type
+    {
+        const char* name;
+        size_t thread;
+        uint64_t begin, end;
+        //! bytes transferred or processed in the span
+        uint64_t bytes;
+    };
+
+private:
+    struct thread_type
+    {
+        size_t id;
+        std::mutex mutex;
+        std::vector<event_type> events;
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<std::shared_ptr<thread_type> > m_threads;
+
+    std::atomic<bool> m_enabled { false };
+    const std::chrono::steady_clock::time_point m_start;
+    //! path of STXXL_TRACE_FILE, saved to in the destructor
+    std::string m_path;
+
+    trace_recorder()
+        : m_start(std::chrono::steady_clock::now())
+    {
+        if (const char* path = getenv("STXXL_TRACE_FILE"))
+        {
+            m_path = path;
+            m_enabled = true;
+        }
+    }
+
+    //! Buffer of the current thread, registered on first use.
+    thread_type& this_thread()
+    {
+        static thread_local std::shared_ptr<thread_type> thread;
+        if (!thread)
+        {
+            thread = std::make_shared<thread_type>();
+            std::unique_lock<std::mutex> lock(m_mutex);
+            thread->id = m_threads.size();
+            m_threads.push_back(thread);
+        }
+        return *thread;
+    }
+
+public:
+    //! non-copyable: delete copy-constructor
+    trace_recorder(const trace_recorder&) = delete;
+    //! non-copyable: delete assignment operator
+    trace_recorder& operator = (const trace_recorder&) = delete;
+
+    ~trace_recorder()
+    {
+        if (m_path.empty())
+            return;
+        try {
+            save(m_path);
+        }
+        catch (const foxxll::io_error& e) {
+            TLX_LOG1 << "trace_recorder: " << e.what();
+        }
+    }
+
+    static trace_recorder& get_instance()
+    {
+        static trace_recorder instance;
+        return instance;
+    }
+
+    //! Start or stop recording spans.
+    void enable(bool enabled = true)
+    {
+        m_enabled = enabled;
+    }
+
+    bool enabled() const
+    {
+        return m_enabled;
+    }
+
+    //! Microseconds since the recorder was created.
+    uint64_t now() const
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - m_start).count());
+    }
+
+    //! Record a span of the current thread, name must be a string literal.
+    void record(const char* name, uint64_t begin, uint64_t end, uint64_t bytes)
+    {
+        thread_type& t = this_thread();
+        std::unique_lock<std::mutex> lock(t.mutex);
+        t.events.push_back(event_type { name, t.id, begin, end, bytes });
+    }
+
+    //! The spans recorded, by thread and in order of completion.
+    std::vector<event_type> events() const
+    {
+        std::vector<event_type> events;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (const std::shared_ptr<thread_type>& t : m_threads)
+        {
+            std::unique_lock<std::mutex> thread_lock(t->mutex);
+            events.insert(events.end(), t->events.begin(), t->events.end());
+        }
+        return events;
+    }
+
+    //! Discard the spans recorded.
+    void clear()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (const std::shared_ptr<thread_type>& t : m_threads)
+        {
+            std::unique_lock<std::mutex> thread_lock(t->mutex);
+            t->events.clear();
+        }
+    }
+
+    //! Write the spans as Chrome trace event JSON, one complete event each.
+    void write_chrome_trace(std::ostream& os) const
+    {
+        os << "{\"traceEvents\":[";
+        bool first = true;
+        for (const event_type& e : events())
+        {
+            os << (first ? "\n" : ",\n")
+               << "{\"name\":\"" << e.name << "\",\"cat\":\"stxxl\",\"ph\":\"X\""
+               << ",\"ts\":" << e.begin << ",\"dur\":" << (e.end - e.begin)
+               << ",\"pid\":0,\"tid\":" << e.thread
+               << ",\"args\":{\"bytes\":" << e.bytes << "}}";
+            first = false;
+        }
+        os << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+    }
+
+    //! Save the spans as Chrome trace event JSON to path.
+    void save(const std::string& path) const
+    {
+        std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+        if (!out.good())
+            FOXXLL_THROW_ERRNO(foxxll::io_error,
+                               "trace_recorder: cannot create " << path);
+        write_chrome_trace(out);
+    }
+};
+
+/*!
+ * Scoped span of a phase, recording the time from construction to
+ * destruction on the current thread, if the trace_recorder is enabled.
+ */
+class trace_span
+{
+    const char* m_name;
+    uint64_t m_begin;
+    uint64_t m_bytes = 0;
+    bool m_enabled;
+
+public:
+    //! Begin the span, name must be a string literal.
+    explicit trace_span(const char* name)
+        : m_name(name),
+          m_enabled(trace_recorder::get_instance().enabled())
+    {
+        m_begin = m_enabled ? trace_recorder::get_instance().now() : 0;
+    }
+
+    //! non-copyable: delete copy-constructor
+    trace_span(const trace_span&) = delete;
+    //! non-copyable: delete assignment operator
+    trace_span& operator = (const trace_span&) = delete;
+
+    ~trace_span()
+    {
+        if (!m_enabled)
+            return;
+        trace_recorder& r = trace_recorder::get_instance();
+        r.record(m_name, m_begin, r.now(), m_bytes);
+    }
+
+    //! Count bytes transferred or processed in the span.
+    void add_bytes(uint64_t bytes)
+    {
+        m_bytes += bytes;
+    }
+};
+
+//! Replacement of trace_span if STXXL_TRACE is off, compiled to nothing.
+class null_trace_span
+{
+public:
+    explicit null_trace_span(const char*) { }
+
+    void add_bytes(uint64_t) { }
+};
+
+//! \}
+
+} // namespace stxxl
+
+//! Declare the trace span var of the phase name, which ends with the scope.
+#if STXXL_TRACE
+#define STXXL_TRACE_SPAN(var, name) ::stxxl::trace_span var(name)
+#else
+#define STXXL_TRACE_SPAN(var, name) ::stxxl::null_trace_span var(name)
+#endif
+
+#endif // !STXXL_COMMON_TRACE_HEADER
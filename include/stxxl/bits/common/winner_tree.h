@@ -14,7 +14,9 @@
 #ifndef STXXL_COMMON_WINNER_TREE_HEADER
 #define STXXL_COMMON_WINNER_TREE_HEADER
 
+#include <algorithm>
 #include <cassert>
+#include <functional>
 #include <limits>
 #include <string>
 #include <vector>
@@ -366,6 +368,219 @@ public:
     }
 };
 
+/*!
+ * Winner tree like winner_tree, whose nodes hold the key of their winner
+ * next to its index, such that the games of a replay compare keys inside the
+ * tree instead of dereferencing the players through the comparator. The
+ * nodes are laid out in breadth-first (Eytzinger) order: the children of
+ * node i are 2i+1 and 2i+2, and a replay walks one contiguous path of
+ * nodes. This pays off for small keys, e.g. integers or key prefixes, and a
+ * large number of players.
+ *
+ * Equal keys are won by the player with the smaller index. The number of
+ * players is fixed at construction.
+ *
+ * \tparam KeyType key of the players, copied into the nodes
+ * \tparam CompareType comparison of keys, operator () (a, b) returns true
+ * if a < b
+ */
+template <typename KeyType, typename CompareType = std::less<KeyType> >
+class keyed_winner_tree
+{
+public:
+    using key_type = KeyType;
+
+    static constexpr size_t invalid_key = std::numeric_limits<size_t>::max();
+
+protected:
+    struct node_type
+    {
+        key_type key;
+        //! index of the winning player, or invalid_key
+        size_t index;
+    };
+
+    //! the binary tree of size 2^(k+1)-1, leaves are the players
+    std::vector<node_type> m_tree;
+
+    //! number of slots for the players (2^k)
+    size_t m_num_slots;
+
+    CompareType m_less;
+
+    //! Position of the leaf of player index.
+    size_t leaf(size_t index) const
+    {
+        return m_num_slots - 1 + index;
+    }
+
+    //! Whether player (key, index) wins against node b.
+    bool beats(const key_type& key, size_t index, const node_type& b) const
+    {
+        if (b.index == invalid_key)
+            return true;
+        if (m_less(key, b.key))
+            return true;
+        return !m_less(b.key, key) && index < b.index;
+    }
+
+    //! Set the leaf of player index and replay the games on its path.
+    void replay(size_t index, const key_type& key, bool done)
+    {
+        size_t p = leaf(index);
+        m_tree[p].key = key;
+        m_tree[p].index = done ? invalid_key : index;
+
+        node_type top = m_tree[p];
+        while (p > 0)
+        {
+            const node_type& sibling = m_tree[(p & 1) ? p + 1 : p - 1];
+            if (sibling.index != invalid_key &&
+                (top.index == invalid_key || beats(sibling.key, sibling.index, top)))
+                top = sibling;
+            p = (p - 1) / 2;
+            m_tree[p] = top;
+        }
+    }
+
+public:
+    //! Construct a tree of num_players deactivated players.
+    explicit keyed_winner_tree(size_t num_players,
+                               const CompareType& less = CompareType())
+        : m_less(less)
+    {
+        assert(num_players > 0);
+        m_num_slots = size_t(1) << tlx::integer_log2_ceil(num_players);
+        m_tree.resize(2 * m_num_slots - 1, node_type { key_type(), invalid_key });
+    }
+
+    //! Activate player index with the given key, or update its key, and
+    //! replay.
+    void activate_player(size_t index, const key_type& key)
+    {
+        assert(index < m_num_slots);
+        replay(index, key, false);
+    }
+
+    //! Update the key of player index and replay.
+    void notify_change(size_t index, const key_type& key)
+    {
+        activate_player(index, key);
+    }
+
+    //! Activate player index with the given key without replaying, run
+    //! rebuild() afterwards.
+    void activate_without_replay(size_t index, const key_type& key)
+    {
+        assert(index < m_num_slots);
+        m_tree[leaf(index)] = node_type { key, index };
+    }
+
+    //! Deactivate player index and replay.
+    void deactivate_player(size_t index)
+    {
+        assert(index < m_num_slots);
+        replay(index, key_type(), true);
+    }
+
+    //! Index of the winner.
+    size_t top() const
+    {
+        return m_tree[0].index;
+    }
+
+    //! Key of the winner.
+    const key_type& top_key() const
+    {
+        assert(!empty());
+        return m_tree[0].key;
+    }
+
+    //! Returns if all players are deactivated.
+    bool empty() const
+    {
+        return m_tree[0].index == invalid_key;
+    }
+
+    //! Return the number of slots
+    size_t num_slots() const
+    {
+        return m_num_slots;
+    }
+
+    //! Replay after the key of the winning player changed to key.
+    void replay_on_pop(const key_type& key)
+    {
+        assert(!empty());
+        replay(m_tree[0].index, key, false);
+    }
+
+    /*!
+     * Pop up to max_pops winners with a single replay. As long as the winner
+     * of the last pop beats the best of the other players, which does not
+     * change meanwhile, it wins again without touching the tree.
+     *
+     * \param advance function object called as advance(index, key) for each
+     * pop of player index, whose current key is key: it consumes the current
+     * element of the player, stores the key of its next one in key and
+     * returns true, or returns false if the player is exhausted, which is
+     * deactivated.
+     *
+     * \param max_pops maximum number of pops
+     *
+     * \return number of pops, at least one
+     */
+    template <typename Advance>
+    size_t replay_on_pop(Advance&& advance, size_t max_pops)
+    {
+        assert(!empty() && max_pops > 0);
+        const size_t index = m_tree[0].index;
+
+        // the best other player is the best winner of the siblings on the
+        // path of the winner
+        const node_type* runner_up = nullptr;
+        for (size_t p = leaf(index); p > 0; p = (p - 1) / 2)
+        {
+            const node_type& sibling = m_tree[(p & 1) ? p + 1 : p - 1];
+            if (sibling.index != invalid_key &&
+                (!runner_up || beats(sibling.key, sibling.index, *runner_up)))
+                runner_up = &sibling;
+        }
+
+        key_type key = m_tree[0].key;
+        size_t pops = 0;
+        bool active;
+        do {
+            ++pops;
+            active = advance(index, key);
+        } while (active && pops < max_pops &&
+                 (!runner_up || beats(key, index, *runner_up)));
+
+        replay(index, key, !active);
+        return pops;
+    }
+
+    //! Build the tree from the leaves from scratch.
+    void rebuild()
+    {
+        for (size_t i = m_num_slots - 1; i > 0; --i)
+        {
+            const node_type& lc = m_tree[2 * i - 1];
+            const node_type& rc = m_tree[2 * i];
+            m_tree[i - 1] =
+                (rc.index != invalid_key &&
+                 (lc.index == invalid_key || beats(rc.key, rc.index, lc)))
+                ? rc : lc;
+        }
+    }
+
+    //! Deactivate all players
+    void clear()
+    {
+        std::fill(m_tree.begin(), m_tree.end(), node_type { key_type(), invalid_key });
+    }
+};
+
 } // namespace stxxl
 
 #endif // !STXXL_COMMON_WINNER_TREE_HEADER
@@ -0,0 +1,270 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/addressable_priority_queue.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_ADDRESSABLE_PRIORITY_QUEUE_HEADER
+#define STXXL_CONTAINERS_ADDRESSABLE_PRIORITY_QUEUE_HEADER
+
+#include <cassert>
+#include <cstdint>
+#include <unordered_set>
+
+#include <stxxl/bits/containers/priority_queue.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External priority queue with handles to its elements, which support
+ * decrease-key and deletion by lazy invalidation.
+ *
+ * push() returns a handle of the element. invalidate() merely records the
+ * handle as dead, the element is dropped whenever it is merged into a new
+ * sequence of the underlying stxxl::priority_queue, so dead elements stop
+ * consuming I/O on the following merges, or when it reaches the top. update()
+ * invalidates an element and pushes its new value, which replaces decrease-key.
+ *
+ * The handles of the dead elements still stored are kept in an internal hash
+ * set, each is removed again when its element is dropped.
+ *
+ * \tparam ValueType type of the contained objects (POD with no references to
+ *   internal memory)
+ * \tparam CompareTypeWithMin comparator with a min_value() sentinel, see
+ *   PRIORITY_QUEUE_GENERATOR
+ * \tparam IntMemory upper limit of internal memory consumption in bytes
+ * \tparam MaxItems upper limit of the number of elements, including dead ones
+ * \tparam Tune tuning parameter of PRIORITY_QUEUE_GENERATOR
+ */
+template <class ValueType,
+          class CompareTypeWithMin,
+          size_t IntMemory,
+          external_size_type MaxItems,
+          unsigned Tune = 6>
+class addressable_priority_queue
+{
+public:
+    //! The type of object stored in the priority_queue.
+    using value_type = ValueType;
+    //! Comparison object.
+    using comparator_type = CompareTypeWithMin;
+    //! Handle of an element returned by push().
+    using handle_type = uint64_t;
+    using size_type = external_size_type;
+
+    //! element as stored in the underlying priority_queue
+    struct entry_type
+    {
+        value_type value;
+        handle_type handle;
+    };
+
+    //! comparator of the entries by their values
+    class entry_compare
+    {
+    public:
+        explicit entry_compare(const comparator_type& cmp) : cmp(cmp) { }
+
+        bool operator () (const entry_type& a, const entry_type& b) const
+        {
+            return cmp(a.value, b.value);
+        }
+
+        entry_type min_value() const
+        {
+            return entry_type { cmp.min_value(), 0 };
+        }
+
+    protected:
+        comparator_type cmp;
+    };
+
+    //! entry filter of the underlying priority_queue dropping dead entries
+    struct dead_entries
+    {
+        static constexpr bool enabled = true;
+
+        //! handles of the dead entries still stored
+        std::unordered_set<handle_type> handles;
+
+        //! Whether the entry is dead, its handle is forgotten as it is dropped.
+        bool operator () (const entry_type& e)
+        {
+            return handles.erase(e.handle) != 0;
+        }
+    };
+
+    using generator_type = PRIORITY_QUEUE_GENERATOR<
+              entry_type, entry_compare, IntMemory, MaxItems, Tune>;
+    //! The underlying priority_queue of entries.
+    using pq_type = priority_queue<
+              typename generator_type::result::Config, dead_entries>;
+    using block_type = typename pq_type::block_type;
+    using pool_type = typename pq_type::pool_type;
+
+protected:
+    pq_type m_pq;
+
+    //! number of live elements
+    size_type m_size;
+
+    //! handle of the next element pushed
+    handle_type m_next_handle;
+
+    //! Drop dead entries from the top of the queue.
+    void skip_dead()
+    {
+        while (!m_pq.empty() && m_pq.entry_filter()(m_pq.top()))
+            m_pq.pop();
+    }
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Constructs the queue using the given pool, see priority_queue.
+    explicit addressable_priority_queue(
+        pool_type& pool, const comparator_type& comp = comparator_type())
+        : m_pq(pool, entry_compare(comp)),
+          m_size(0), m_next_handle(0)
+    { }
+
+    //! Constructs the queue with pools of the given sizes in bytes, see
+    //! priority_queue.
+    addressable_priority_queue(
+        const size_t p_pool_mem, const size_t w_pool_mem,
+        const comparator_type& comp = comparator_type())
+        : m_pq(p_pool_mem, w_pool_mem, entry_compare(comp)),
+          m_size(0), m_next_handle(0)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    addressable_priority_queue(const addressable_priority_queue&) = delete;
+    //! non-copyable: delete assignment operator
+    addressable_priority_queue& operator = (const addressable_priority_queue&) = delete;
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Returns number of live elements.
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    //! Returns true if the queue has no live elements.
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    //! Returns number of dead elements still stored.
+    size_type num_dead() const
+    {
+        return m_pq.size() - m_size;
+    }
+
+    //! \}
+
+    //! \name Operators
+    //! \{
+
+    //! Returns the "largest" live element. Precondition: \c empty() is false.
+    const value_type & top() const
+    {
+        assert(!empty());
+        return m_pq.top().value;
+    }
+
+    //! Returns the handle of the top element. Precondition: \c empty() is
+    //! false.
+    handle_type top_handle() const
+    {
+        assert(!empty());
+        return m_pq.top().handle;
+    }
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Inserts the element and returns its handle.
+    handle_type push(const value_type& obj)
+    {
+        const handle_type h = m_next_handle++;
+        m_pq.push(entry_type { obj, h });
+        ++m_size;
+        return h;
+    }
+
+    //! Removes the element at the top.
+    void pop()
+    {
+        assert(!empty());
+        m_pq.pop();
+        --m_size;
+        skip_dead();
+    }
+
+    //! Removes the element of the handle lazily. Precondition: the element
+    //! is stored, it was neither popped nor invalidated before.
+    void invalidate(const handle_type h)
+    {
+        assert(h < m_next_handle);
+        assert(!empty());
+        m_pq.entry_filter().handles.insert(h);
+        --m_size;
+        skip_dead();
+    }
+
+    //! Replaces the element of the handle by obj, e.g. to decrease its key,
+    //! and returns the new handle. Precondition: as for invalidate().
+    handle_type update(const handle_type h, const value_type& obj)
+    {
+        invalidate(h);
+        return push(obj);
+    }
+
+    //! Moves the elements held in internal memory to external memory, see
+    //! priority_queue::spill().
+    void spill()
+    {
+        m_pq.spill();
+    }
+
+    //! \}
+
+    //! \name Miscellaneous
+    //! \{
+
+    //! Number of batches processed, see priority_queue::num_batches().
+    external_size_type num_batches() const
+    {
+        return m_pq.num_batches();
+    }
+
+    //! Number of bytes consumed from the internal memory not including pools
+    //! and the hash set of dead handles.
+    size_t mem_cons() const
+    {
+        return sizeof(*this) - sizeof(m_pq) + m_pq.mem_cons();
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_ADDRESSABLE_PRIORITY_QUEUE_HEADER
@@ -0,0 +1,466 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/bit_vector.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_BIT_VECTOR_HEADER
+#define STXXL_CONTAINERS_BIT_VECTOR_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <tlx/math/ctz.hpp>
+#include <tlx/math/popcount.hpp>
+
+#include <foxxll/common/types.hpp>
+
+#include <stxxl/bits/containers/pager.h>
+#include <stxxl/bits/containers/vector.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont_vector
+//! \{
+
+/*!
+ * External vector of bits, packed into 64-bit words which are stored in a
+ * stxxl::vector, hence eight times denser than a vector of bools.
+ *
+ * Single bits are accessed with test(), set(), reset() and flip(), whole words
+ * with get_word() and set_word(). The bits after size() in the last word are
+ * always zero. The bulk operations &=, |= and ^= combine two bit vectors of
+ * the same size word by word in one scan, count() and for_each_set() scan the
+ * words with overlapped I/O, and stream(bits) streams the bits.
+ *
+ * build_rank_index() samples the number of set bits before every
+ * sample_words-th word in internal memory, one size_type each. rank() and
+ * select() then read at most sample_words words. Modifications invalidate
+ * the index.
+ *
+ * \tparam PagerType pager of the page cache of the words
+ * \tparam BlockSize external block size in bytes
+ * \tparam AllocStr parallel disk block allocation strategy
+ */
+template <typename PagerType = lru_pager<8>,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(uint64_t),
+          typename AllocStr = foxxll::default_alloc_strategy>
+class bit_vector
+{
+public:
+    //! \name Types
+    //! \{
+
+    using word_type = uint64_t;
+    using size_type = foxxll::external_size_type;
+
+    //! number of bits per word
+    static constexpr size_t word_bits = 64;
+
+    //! vector storing the words
+    using word_vector_type = stxxl::vector<word_type, 4, PagerType, BlockSize, AllocStr>;
+    using word_bufreader_type = typename word_vector_type::bufreader_type;
+
+    //! \}
+
+protected:
+    word_vector_type m_words;
+
+    //! number of bits
+    size_type m_size;
+
+    //! words between two samples of the rank index
+    size_t m_sample_words;
+
+    //! number of set bits before every m_sample_words-th word
+    std::vector<size_type> m_rank_samples;
+
+    //! whether m_rank_samples matches the bits
+    bool m_index_valid;
+
+    static size_type words_for(size_type nbits)
+    {
+        return (nbits + word_bits - 1) / word_bits;
+    }
+
+    static word_type bit_mask(size_type i)
+    {
+        return word_type(1) << (i % word_bits);
+    }
+
+    //! mask of the valid bits of the word w
+    word_type word_mask(size_type w) const
+    {
+        const size_type end = std::min(m_size - w * word_bits, size_type(word_bits));
+        return (end == word_bits) ? ~word_type(0) : ((word_type(1) << end) - 1);
+    }
+
+    //! Combines the words with the ones of other by op, in one scan.
+    template <typename Operation>
+    void combine(const bit_vector& other, Operation op)
+    {
+        assert(other.size() == size());
+        m_index_valid = false;
+
+        word_bufreader_type reader(other.m_words);
+        for (typename word_vector_type::iterator it = m_words.begin();
+             it != m_words.end(); ++it, ++reader)
+        {
+            *it = op(*it, *reader);
+        }
+    }
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Construct a bit vector of n zero bits.
+    explicit bit_vector(size_type n = 0)
+        : m_size(0), m_sample_words(0), m_index_valid(false)
+    {
+        resize(n);
+    }
+
+    //! non-copyable: delete copy-constructor
+    bit_vector(const bit_vector&) = delete;
+    //! non-copyable: delete assignment operator
+    bit_vector& operator = (const bit_vector&) = delete;
+
+    void swap(bit_vector& obj)
+    {
+        m_words.swap(obj.m_words);
+        std::swap(m_size, obj.m_size);
+        std::swap(m_sample_words, obj.m_sample_words);
+        std::swap(m_rank_samples, obj.m_rank_samples);
+        std::swap(m_index_valid, obj.m_index_valid);
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Number of bits.
+    size_type size() const { return m_size; }
+
+    bool empty() const { return m_size == 0; }
+
+    //! Number of words storing the bits.
+    size_type num_words() const { return m_words.size(); }
+
+    //! Resize to n bits, new bits are zero.
+    void resize(size_type n)
+    {
+        m_index_valid = false;
+
+        const size_type old_words = m_words.size();
+        m_words.resize(words_for(n));
+        for (size_type w = old_words; w < m_words.size(); ++w)
+            m_words[w] = 0;
+
+        m_size = n;
+        if (n < size_type(old_words) * word_bits && !m_words.empty())
+            m_words[m_words.size() - 1] &= word_mask(m_words.size() - 1);
+    }
+
+    //! Remove all bits and deallocate the external memory.
+    void clear()
+    {
+        m_words.clear();
+        m_size = 0;
+        m_index_valid = false;
+    }
+
+    //! Flush the page cache of the words.
+    void flush() const
+    {
+        m_words.flush();
+    }
+
+    //! \}
+
+    //! \name Bit and Word Access
+    //! \{
+
+    bool test(size_type i) const
+    {
+        assert(i < m_size);
+        return (static_cast<const word_vector_type&>(m_words)[i / word_bits] & bit_mask(i)) != 0;
+    }
+
+    bool operator [] (size_type i) const
+    {
+        return test(i);
+    }
+
+    void set(size_type i)
+    {
+        assert(i < m_size);
+        m_index_valid = false;
+        m_words[i / word_bits] |= bit_mask(i);
+    }
+
+    void set(size_type i, bool value)
+    {
+        if (value)
+            set(i);
+        else
+            reset(i);
+    }
+
+    void reset(size_type i)
+    {
+        assert(i < m_size);
+        m_index_valid = false;
+        m_words[i / word_bits] &= ~bit_mask(i);
+    }
+
+    void flip(size_type i)
+    {
+        assert(i < m_size);
+        m_index_valid = false;
+        m_words[i / word_bits] ^= bit_mask(i);
+    }
+
+    //! Set the bit if it was not set, returns whether it was.
+    bool test_and_set(size_type i)
+    {
+        assert(i < m_size);
+        word_type& word = m_words[i / word_bits];
+        if (word & bit_mask(i))
+            return true;
+        m_index_valid = false;
+        word |= bit_mask(i);
+        return false;
+    }
+
+    //! Append a bit at the end.
+    void push_back(bool value)
+    {
+        m_index_valid = false;
+        if (m_size % word_bits == 0)
+            m_words.push_back(0);
+        if (value)
+            m_words.back() |= bit_mask(m_size);
+        ++m_size;
+    }
+
+    //! Return the w-th word, bit i of it is bit w * word_bits + i.
+    word_type get_word(size_type w) const
+    {
+        assert(w < num_words());
+        return static_cast<const word_vector_type&>(m_words)[w];
+    }
+
+    //! Overwrite the w-th word, the bits after size() are dropped.
+    void set_word(size_type w, word_type value)
+    {
+        assert(w < num_words());
+        m_index_valid = false;
+        m_words[w] = value & word_mask(w);
+    }
+
+    //! Set all bits to value.
+    void fill(bool value)
+    {
+        m_index_valid = false;
+        for (size_type w = 0; w < m_words.size(); ++w)
+            m_words[w] = value ? word_mask(w) : 0;
+    }
+
+    //! The vector storing the words.
+    const word_vector_type & words() const { return m_words; }
+
+    //! \}
+
+    //! \name Bulk Operations
+    //! \{
+
+    bit_vector& operator &= (const bit_vector& other)
+    {
+        if (&other != this)
+            combine(other, [](word_type a, word_type b) { return a & b; });
+        return *this;
+    }
+
+    bit_vector& operator |= (const bit_vector& other)
+    {
+        if (&other != this)
+            combine(other, [](word_type a, word_type b) { return a | b; });
+        return *this;
+    }
+
+    bit_vector& operator ^= (const bit_vector& other)
+    {
+        if (&other == this)
+            fill(false);
+        else
+            combine(other, [](word_type a, word_type b) { return a ^ b; });
+        return *this;
+    }
+
+    //! Number of set bits, in one scan.
+    size_type count() const
+    {
+        if (m_index_valid)
+            return m_rank_samples.back();
+
+        size_type ones = 0;
+        for (word_bufreader_type reader(m_words); !reader.empty(); ++reader)
+            ones += tlx::popcount(*reader);
+        return ones;
+    }
+
+    //! Call f(i) for each set bit i in increasing order, in one scan.
+    template <typename Functor>
+    void for_each_set(Functor f) const
+    {
+        size_type base = 0;
+        for (word_bufreader_type reader(m_words); !reader.empty(); ++reader)
+        {
+            for (word_type word = *reader; word != 0; word &= word - 1)
+                f(base + tlx::ctz(word));
+            base += word_bits;
+        }
+    }
+
+    //! \}
+
+    //! \name Rank and Select
+    //! \{
+
+    //! Build the rank index in one scan, which samples the number of set
+    //! bits before every sample_words-th word.
+    void build_rank_index(size_t sample_words = 64)
+    {
+        assert(sample_words > 0);
+        m_sample_words = sample_words;
+        m_rank_samples.clear();
+        m_rank_samples.reserve(m_words.size() / sample_words + 2);
+
+        size_type ones = 0, w = 0;
+        for (word_bufreader_type reader(m_words); !reader.empty(); ++reader, ++w)
+        {
+            if (w % sample_words == 0)
+                m_rank_samples.push_back(ones);
+            ones += tlx::popcount(*reader);
+        }
+        // the total number of set bits
+        m_rank_samples.push_back(ones);
+
+        m_index_valid = true;
+    }
+
+    //! Whether the rank index matches the bits.
+    bool has_rank_index() const { return m_index_valid; }
+
+    //! Number of set bits before position i, requires the rank index.
+    size_type rank(size_type i) const
+    {
+        assert(m_index_valid);
+        assert(i <= m_size);
+
+        const size_type w = i / word_bits;
+        const size_type sample = w / m_sample_words;
+        size_type ones = m_rank_samples[sample];
+        for (size_type v = sample * m_sample_words; v < w; ++v)
+            ones += tlx::popcount(get_word(v));
+        if (i % word_bits != 0)
+            ones += tlx::popcount(get_word(w) & (bit_mask(i) - 1));
+        return ones;
+    }
+
+    //! Position of the set bit with rank k, i.e. of the (k+1)-th one,
+    //! requires the rank index and k < count().
+    size_type select(size_type k) const
+    {
+        assert(m_index_valid);
+        assert(k < count());
+
+        // last sample that is at most k, before the total at the back
+        const size_type sample = static_cast<size_type>(
+            std::upper_bound(m_rank_samples.begin(), m_rank_samples.end() - 1, k)
+            - m_rank_samples.begin()) - 1;
+
+        size_type ones = m_rank_samples[sample];
+        for (size_type w = sample * m_sample_words; ; ++w)
+        {
+            word_type word = get_word(w);
+            const size_type n = tlx::popcount(word);
+            if (ones + n > k)
+            {
+                // clear the lowest k - ones set bits
+                for (size_type j = ones; j < k; ++j)
+                    word &= word - 1;
+                return w * word_bits + tlx::ctz(word);
+            }
+            ones += n;
+        }
+    }
+
+    //! \}
+
+    //! \name Streams
+    //! \{
+
+    //! Stream of the bits, which reads the words with overlapped I/O.
+    class stream
+    {
+    public:
+        using value_type = bool;
+
+    protected:
+        word_bufreader_type m_reader;
+        size_type m_size;
+        word_type m_word;
+        size_t m_bit;
+
+    public:
+        explicit stream(const bit_vector& bits)
+            : m_reader(bits.m_words), m_size(bits.size()),
+              m_word(m_reader.empty() ? 0 : *m_reader), m_bit(0)
+        { }
+
+        //! number of bits left
+        size_type size() const { return m_size; }
+
+        //! standard stream method
+        bool empty() const { return m_size == 0; }
+
+        //! standard stream method
+        value_type operator * () const
+        {
+            assert(!empty());
+            return ((m_word >> m_bit) & 1) != 0;
+        }
+
+        //! standard stream method
+        stream& operator ++ ()
+        {
+            assert(!empty());
+            --m_size;
+            if (++m_bit == word_bits && m_size > 0)
+            {
+                ++m_reader;
+                m_word = *m_reader;
+                m_bit = 0;
+            }
+            return *this;
+        }
+    };
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_BIT_VECTOR_HEADER
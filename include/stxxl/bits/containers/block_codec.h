@@ -0,0 +1,189 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/block_codec.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_BLOCK_CODEC_HEADER
+#define STXXL_CONTAINERS_BLOCK_CODEC_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace stxxl {
+
+//! \addtogroup stlcont_vector
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     BLOCK CODECS                                                   //
+////////////////////////////////////////////////////////////////////////
+
+//! Default block codec of stxxl::vector: blocks are stored plain.
+struct no_block_codec { };
+
+//! Granularity of the compressed extents written by a block codec, the
+//! alignment required for direct I/O.
+static constexpr size_t block_codec_alignment = 4096;
+
+/*!
+ * Block codec storing the elements of a block bit-packed relative to their
+ * minimum (frame of reference), or with Delta the differences between
+ * consecutive elements relative to their minimum. The value type must be an
+ * integer; small values or, with Delta, sorted ones compress best.
+ *
+ * A block codec provides encode(), which writes the n elements of a block
+ * into at most capacity bytes and returns their number, or 0 if they do not
+ * fit, and decode(), which restores the elements from the encoded bytes.
+ *
+ * The encoding is the first element and the minimum as uint64_t, the bit
+ * width as uint64_t, followed by the packed values in 64-bit words.
+ */
+template <typename ValueType, bool Delta = false>
+struct frame_of_reference_codec
+{
+    static_assert(std::is_integral<ValueType>::value,
+                  "frame_of_reference_codec requires an integer value type");
+
+    using value_type = ValueType;
+    using unsigned_type = typename std::make_unsigned<ValueType>::type;
+
+    static constexpr size_t header_size = 3 * sizeof(uint64_t);
+
+    //! Order preserving map of the values to unsigned integers.
+    static unsigned_type to_unsigned(const value_type& v)
+    {
+        unsigned_type u = static_cast<unsigned_type>(v);
+        if (std::is_signed<value_type>::value)
+            u ^= unsigned_type(1) << (8 * sizeof(unsigned_type) - 1);
+        return u;
+    }
+
+    static value_type from_unsigned(unsigned_type u)
+    {
+        if (std::is_signed<value_type>::value)
+            u ^= unsigned_type(1) << (8 * sizeof(unsigned_type) - 1);
+        return static_cast<value_type>(u);
+    }
+
+    //! value i of the sequence to pack, before subtracting the minimum
+    static unsigned_type term(const value_type* in, size_t i)
+    {
+        if (Delta)
+            return static_cast<unsigned_type>(to_unsigned(in[i + 1]) - to_unsigned(in[i]));
+        return to_unsigned(in[i]);
+    }
+
+    static size_t encode(const value_type* in, size_t n, char* out, size_t capacity)
+    {
+        if (n == 0 || capacity < header_size)
+            return 0;
+
+        const size_t terms = Delta ? n - 1 : n;
+
+        unsigned_type min = terms ? term(in, 0) : 0, max = min;
+        for (size_t i = 1; i < terms; ++i)
+        {
+            const unsigned_type t = term(in, i);
+            min = t < min ? t : min;
+            max = t > max ? t : max;
+        }
+
+        uint64_t width = 0;
+        for (uint64_t range = static_cast<unsigned_type>(max - min); range != 0; range >>= 1)
+            ++width;
+
+        const size_t bytes = header_size + (terms * width + 63) / 64 * sizeof(uint64_t);
+        if (bytes > capacity)
+            return 0;
+
+        const uint64_t first = to_unsigned(in[0]), base = min;
+        memcpy(out, &first, sizeof(first));
+        memcpy(out + sizeof(uint64_t), &base, sizeof(base));
+        memcpy(out + 2 * sizeof(uint64_t), &width, sizeof(width));
+        if (width == 0)
+            return bytes;
+
+        char* words = out + header_size;
+        uint64_t acc = 0;
+        uint64_t used = 0;
+        for (size_t i = 0; i < terms; ++i)
+        {
+            const uint64_t v = static_cast<unsigned_type>(term(in, i) - min);
+            acc |= v << used;
+            used += width;
+            if (used >= 64)
+            {
+                memcpy(words, &acc, sizeof(acc));
+                words += sizeof(acc);
+                used -= 64;
+                acc = used ? v >> (width - used) : 0;
+            }
+        }
+        if (used)
+            memcpy(words, &acc, sizeof(acc));
+
+        return bytes;
+    }
+
+    static void decode(const char* in, size_t /* bytes */, value_type* out, size_t n)
+    {
+        if (n == 0)
+            return;
+
+        uint64_t first, base, width;
+        memcpy(&first, in, sizeof(first));
+        memcpy(&base, in + sizeof(uint64_t), sizeof(base));
+        memcpy(&width, in + 2 * sizeof(uint64_t), sizeof(width));
+
+        const unsigned_type min = static_cast<unsigned_type>(base);
+        const size_t terms = Delta ? n - 1 : n;
+        const char* words = in + header_size;
+        const uint64_t mask = width == 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+
+        unsigned_type prev = static_cast<unsigned_type>(first);
+        if (Delta)
+            out[0] = from_unsigned(prev);
+
+        for (size_t i = 0, bit = 0; i < terms; ++i, bit += width)
+        {
+            uint64_t v = 0;
+            if (width != 0)
+            {
+                const size_t word = bit / 64, offset = bit % 64;
+                uint64_t w;
+                memcpy(&w, words + word * sizeof(w), sizeof(w));
+                v = w >> offset;
+                if (offset + width > 64)
+                {
+                    memcpy(&w, words + (word + 1) * sizeof(w), sizeof(w));
+                    v |= w << (64 - offset);
+                }
+                v &= mask;
+            }
+
+            const unsigned_type t = static_cast<unsigned_type>(min + v);
+            if (Delta)
+            {
+                prev = static_cast<unsigned_type>(prev + t);
+                out[i + 1] = from_unsigned(prev);
+            }
+            else
+            {
+                out[i] = from_unsigned(t);
+            }
+        }
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_BLOCK_CODEC_HEADER
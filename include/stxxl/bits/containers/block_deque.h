@@ -0,0 +1,576 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/block_deque.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_BLOCK_DEQUE_HEADER
+#define STXXL_CONTAINERS_BLOCK_DEQUE_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <utility>
+
+#include <tlx/define.hpp>
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/read_write_pool.hpp>
+#include <foxxll/mng/typed_block.hpp>
+
+#include <stxxl/bits/defines.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External deque consisting of a sequence of blocks, with random access.
+ *
+ * Like stxxl::sequence, the front and the back block are kept in internal
+ * memory, and pushing and popping at both ends writes and reads whole blocks
+ * through a read_write_pool, which prefetches the blocks next to the front
+ * and the back. The blocks in between are recorded in a table of block
+ * identifiers, which grows at both ends without moving any data, unlike
+ * stxxl::deque, which doubles and copies its vector.
+ *
+ * Random access with operator [] locates the block of an element in the table
+ * and reads it into a cache of one block, which is written back when another
+ * block is accessed, hence it takes at most two I/Os. A reference returned by
+ * operator [], front() or back() is valid until the next access or
+ * modification of the deque.
+ *
+ * \tparam ValueType type of the contained objects (POD with no references to internal memory)
+ * \tparam BlockSize size of the external memory block in bytes, default is \c STXXL_DEFAULT_BLOCK_SIZE(ValueType)
+ * \tparam AllocStr parallel disk block allocation strategy, default is \c foxxll::default_alloc_strategy
+ * \tparam SizeType size data type, default is \c external_size_type
+ */
+template <class ValueType,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
+          class AllocStr = foxxll::default_alloc_strategy,
+          class SizeType = external_size_type>
+class block_deque
+{
+    static constexpr bool debug = false;
+
+public:
+    using value_type = ValueType;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using alloc_strategy_type = AllocStr;
+    using size_type = SizeType;
+    enum {
+        block_size = BlockSize
+    };
+
+    using block_type = foxxll::typed_block<block_size, value_type>;
+    using bid_type = foxxll::BID<block_size>;
+
+    using bid_deque_type = std::deque<bid_type>;
+
+private:
+    using pool_type = foxxll::read_write_pool<block_type>;
+
+    //! current number of items in the deque
+    size_type m_size;
+
+    //! whether the m_pool object is own and should be deleted.
+    bool m_owns_pool;
+
+    //! read_write_pool of blocks
+    pool_type* m_pool;
+
+    //! current front and back block of the deque, which are the same block
+    //! if the deque fits into one
+    block_type* m_front_block;
+    block_type* m_back_block;
+
+    //! the items are [m_front_pos, block_type::size) of the front block,
+    //! the blocks of m_bids, and [0, m_back_end) of the back block, or
+    //! [m_front_pos, m_back_end) if the front block is the back block.
+    size_t m_front_pos, m_back_end;
+
+    //! block allocation strategy
+    alloc_strategy_type m_alloc_strategy;
+
+    //! block allocation counter
+    size_t m_alloc_count;
+
+    //! identifiers of the blocks between the front and the back block
+    bid_deque_type m_bids;
+
+    //! block manager used
+    foxxll::block_manager* m_bm;
+
+    //! number of blocks to prefetch at each end
+    size_t m_blocks2prefetch;
+
+    //! \name Cache of the block of the last random access
+    //! \{
+    mutable block_type* m_access_block;
+    mutable bid_type m_access_bid;
+    mutable bool m_access_valid;
+    mutable bool m_access_dirty;
+    //! \}
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Constructs empty deque with own write and prefetch block pool
+    //!
+    //! \param D  number of parallel disks, defaulting to the configured number of scratch disks,
+    //!           memory consumption will be 2 * D + 3 blocks
+    //!           (first, last and accessed block, D blocks as write cache, D block for prefetching)
+    explicit block_deque(const int D = -1)
+        : m_size(0),
+          m_owns_pool(true),
+          m_alloc_count(0),
+          m_bm(foxxll::block_manager::get_instance())
+    {
+        const size_t disks = (D < 1)
+                             ? foxxll::config::get_instance()->disks_number()
+                             : static_cast<size_t>(D);
+
+        TLX_LOG << "block_deque[" << this << "]::block_deque(D)";
+        m_pool = new pool_type(disks, disks + 3);
+        init();
+    }
+
+    //! Constructs empty deque with own write and prefetch block pool
+    //!
+    //! \param w_pool_size  number of blocks in the write pool, must be at least 3, recommended at least 4
+    //! \param p_pool_size  number of blocks in the prefetch pool, recommended at least 2
+    //! \param blocks2prefetch  defines the number of blocks to prefetch at each end,
+    //!                         default is half the number of blocks in the prefetch pool
+    explicit block_deque(const size_t w_pool_size, const size_t p_pool_size, int blocks2prefetch = -1)
+        : m_size(0),
+          m_owns_pool(true),
+          m_alloc_count(0),
+          m_bm(foxxll::block_manager::get_instance())
+    {
+        TLX_LOG << "block_deque[" << this << "]::block_deque(sizes)";
+        m_pool = new pool_type(p_pool_size, w_pool_size);
+        init(blocks2prefetch);
+    }
+
+    //! Constructs empty deque
+    //!
+    //! \param pool block write/prefetch pool
+    //! \param blocks2prefetch  defines the number of blocks to prefetch at each end,
+    //!                         default is half the number of blocks in the prefetch pool
+    //!  \warning Number of blocks in the write pool must be at least 3, recommended at least 4
+    //!  \warning Number of blocks in the prefetch pool recommended at least 2
+    explicit block_deque(pool_type& pool, int blocks2prefetch = -1)
+        : m_size(0),
+          m_owns_pool(false),
+          m_pool(&pool),
+          m_alloc_count(0),
+          m_bm(foxxll::block_manager::get_instance())
+    {
+        TLX_LOG << "block_deque[" << this << "]::block_deque(pool)";
+        init(blocks2prefetch);
+    }
+
+    //! non-copyable: delete copy-constructor
+    block_deque(const block_deque&) = delete;
+    //! non-copyable: delete assignment operator
+    block_deque& operator = (const block_deque&) = delete;
+
+    ~block_deque()
+    {
+        if (m_front_block != m_back_block)
+            m_pool->add(m_back_block);
+        m_pool->add(m_front_block);
+        m_pool->add(m_access_block);
+
+        if (m_owns_pool)
+            delete m_pool;
+
+        if (!m_bids.empty())
+            m_bm->delete_blocks(m_bids.begin(), m_bids.end());
+    }
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    void swap(block_deque& obj)
+    {
+        std::swap(m_size, obj.m_size);
+        std::swap(m_owns_pool, obj.m_owns_pool);
+        std::swap(m_pool, obj.m_pool);
+        std::swap(m_front_block, obj.m_front_block);
+        std::swap(m_back_block, obj.m_back_block);
+        std::swap(m_front_pos, obj.m_front_pos);
+        std::swap(m_back_end, obj.m_back_end);
+        std::swap(m_alloc_strategy, obj.m_alloc_strategy);
+        std::swap(m_alloc_count, obj.m_alloc_count);
+        std::swap(m_bids, obj.m_bids);
+        std::swap(m_bm, obj.m_bm);
+        std::swap(m_blocks2prefetch, obj.m_blocks2prefetch);
+        std::swap(m_access_block, obj.m_access_block);
+        std::swap(m_access_bid, obj.m_access_bid);
+        std::swap(m_access_valid, obj.m_access_valid);
+        std::swap(m_access_dirty, obj.m_access_dirty);
+    }
+
+    //! \}
+
+private:
+    void init(int blocks2prefetch = -1)
+    {
+        // the front, back and accessed block, and one block being written
+        if (m_pool->size_write() < 3) {
+            TLX_LOG1 << "block_deque: invalid configuration, not enough blocks (" << m_pool->size_write() <<
+                ") in write pool, at least 3 are needed, resizing to 4";
+            m_pool->resize_write(4);
+        }
+
+        if (m_pool->size_write() < 4) {
+            TLX_LOG1 << "block_deque: inefficient configuration, no blocks for buffered writing available";
+        }
+
+        if (m_pool->size_prefetch() < 2) {
+            TLX_LOG1 << "block_deque: inefficient configuration, not enough blocks for prefetching at both ends available";
+        }
+
+        m_front_block = m_back_block = m_pool->steal();
+        m_access_block = m_pool->steal();
+        m_access_valid = m_access_dirty = false;
+        reset_positions();
+        set_prefetch_aggr(blocks2prefetch);
+    }
+
+    //! Places the empty range in the middle of the single block, such that
+    //! both ends have room.
+    void reset_positions()
+    {
+        assert(m_size == 0 && m_front_block == m_back_block);
+        m_front_pos = m_back_end = block_type::size / 2;
+    }
+
+    //! Writes block to a newly allocated external block, and replaces it by
+    //! an empty block.
+    bid_type write_block(block_type*& block)
+    {
+        bid_type bid;
+        m_bm->new_block(m_alloc_strategy, bid, m_alloc_count++);
+
+        TLX_LOG << "block_deque[" << this << "]: write block " << block << " @ " << bid;
+        m_pool->write(block, bid);
+        block = m_pool->steal();
+        return bid;
+    }
+
+    //! Reads the external block bid into block, which becomes the front or
+    //! back block, and frees it.
+    void read_block(block_type*& block, const bid_type& bid)
+    {
+        if (m_access_valid && m_access_bid == bid)
+        {
+            // the cached block is up to date, and may be modified
+            std::swap(block, m_access_block);
+            m_access_valid = m_access_dirty = false;
+            m_pool->invalidate(bid);
+        }
+        else
+        {
+            TLX_LOG << "block_deque[" << this << "]: read block " << block << " @ " << bid;
+            m_pool->read(block, bid)->wait();
+        }
+        m_bm->delete_block(bid);
+    }
+
+    //! Returns the block bid in the cache of random accesses.
+    block_type * access_block(const bid_type& bid) const
+    {
+        if (m_access_valid && m_access_bid == bid)
+            return m_access_block;
+
+        if (m_access_valid && m_access_dirty)
+        {
+            TLX_LOG << "block_deque[" << this << "]: write back block " << m_access_block << " @ " << m_access_bid;
+            m_pool->write(m_access_block, m_access_bid);
+            m_access_block = m_pool->steal();
+        }
+
+        m_pool->read(m_access_block, bid)->wait();
+        m_access_bid = bid;
+        m_access_valid = true;
+        m_access_dirty = false;
+        return m_access_block;
+    }
+
+    //! Returns the item at position n, marking its block as modified if
+    //! modify is set.
+    value_type & element(size_type n, bool modify) const
+    {
+        assert(n < size());
+
+        const size_type pos = m_front_pos + n;
+        const size_type index = pos / block_type::size;
+        const size_t offset = static_cast<size_t>(pos % block_type::size);
+
+        if (index == 0)
+            return (*m_front_block)[offset];
+        if (index == m_bids.size() + 1)
+            return (*m_back_block)[offset];
+
+        block_type* block = access_block(m_bids[index - 1]);
+        m_access_dirty = m_access_dirty || modify;
+        return (*block)[offset];
+    }
+
+public:
+    //! \name Miscellaneous
+    //! \{
+
+    //! Defines the number of blocks to prefetch at each end.
+    //! This method should be called whenever the prefetch pool is resized
+    //! \param blocks2prefetch  defines the number of blocks to prefetch at each end,
+    //!                         a negative value means to use half the number of blocks in the prefetch pool
+    void set_prefetch_aggr(int blocks2prefetch)
+    {
+        if (blocks2prefetch < 0)
+            m_blocks2prefetch = std::max<size_t>(m_pool->size_prefetch() / 2, 1);
+        else
+            m_blocks2prefetch = blocks2prefetch;
+    }
+
+    //! Returns the number of blocks prefetched at each end
+    size_t get_prefetch_aggr() const
+    {
+        return m_blocks2prefetch;
+    }
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Adds an element to the front of the deque
+    void push_front(const value_type& val)
+    {
+        if (TLX_UNLIKELY(m_front_pos == 0))
+        {
+            // front block is completely filled
+            if (m_front_block == m_back_block) {
+                TLX_LOG << "block_deque::push_front Case 1";
+                m_front_block = m_pool->steal();
+            }
+            else {
+                TLX_LOG << "block_deque::push_front Case 2";
+                m_bids.push_front(write_block(m_front_block));
+            }
+            m_front_pos = block_type::size;
+        }
+
+        (*m_front_block)[--m_front_pos] = val;
+        ++m_size;
+    }
+
+    //! Adds an element to the end of the deque
+    void push_back(const value_type& val)
+    {
+        if (TLX_UNLIKELY(m_back_end == block_type::size))
+        {
+            // back block is completely filled
+            if (m_front_block == m_back_block) {
+                TLX_LOG << "block_deque::push_back Case 1";
+                m_back_block = m_pool->steal();
+            }
+            else {
+                TLX_LOG << "block_deque::push_back Case 2";
+                m_bids.push_back(write_block(m_back_block));
+            }
+            m_back_end = 0;
+        }
+
+        (*m_back_block)[m_back_end++] = val;
+        ++m_size;
+    }
+
+    //! Removes element from the front of the deque
+    void pop_front()
+    {
+        assert(!empty());
+
+        ++m_front_pos;
+        --m_size;
+
+        if (m_front_block == m_back_block)
+        {
+            if (m_size == 0)
+                reset_positions();
+            return;
+        }
+
+        if (TLX_UNLIKELY(m_front_pos == block_type::size))
+        {
+            if (!m_bids.empty())
+            {
+                TLX_LOG << "block_deque::pop_front Case 1";
+                const bid_type bid = m_bids.front();
+                m_bids.pop_front();
+
+                // give prefetching hints
+                for (size_t i = 0; i < m_blocks2prefetch && i < m_bids.size(); ++i)
+                    m_pool->hint(m_bids[i]);
+
+                read_block(m_front_block, bid);
+            }
+            else
+            {
+                TLX_LOG << "block_deque::pop_front Case 2";
+                // the back block is the next block
+                m_pool->add(m_front_block);
+                m_front_block = m_back_block;
+            }
+            m_front_pos = 0;
+        }
+    }
+
+    //! Removes element from the back of the deque
+    void pop_back()
+    {
+        assert(!empty());
+
+        --m_back_end;
+        --m_size;
+
+        if (m_front_block == m_back_block)
+        {
+            if (m_size == 0)
+                reset_positions();
+            return;
+        }
+
+        if (TLX_UNLIKELY(m_back_end == 0))
+        {
+            if (!m_bids.empty())
+            {
+                TLX_LOG << "block_deque::pop_back Case 1";
+                const bid_type bid = m_bids.back();
+                m_bids.pop_back();
+
+                // give prefetching hints
+                for (size_t i = 0; i < m_blocks2prefetch && i < m_bids.size(); ++i)
+                    m_pool->hint(m_bids[m_bids.size() - 1 - i]);
+
+                read_block(m_back_block, bid);
+            }
+            else
+            {
+                TLX_LOG << "block_deque::pop_back Case 2";
+                // the front block is the previous block
+                m_pool->add(m_back_block);
+                m_back_block = m_front_block;
+            }
+            m_back_end = block_type::size;
+        }
+    }
+
+    //! Removes all elements.
+    void clear()
+    {
+        m_access_valid = m_access_dirty = false;
+
+        // drop prefetched copies of the blocks
+        for (const bid_type& bid : m_bids)
+            m_pool->invalidate(bid);
+
+        if (!m_bids.empty())
+            m_bm->delete_blocks(m_bids.begin(), m_bids.end());
+        m_bids.clear();
+
+        if (m_front_block != m_back_block)
+        {
+            m_pool->add(m_back_block);
+            m_back_block = m_front_block;
+        }
+
+        m_size = 0;
+        reset_positions();
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Returns the size of the deque
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    //! Returns \c true if deque is empty
+    bool empty() const
+    {
+        return (m_size == 0);
+    }
+
+    //! \}
+
+    //! \name Operators
+    //! \{
+
+    //! Returns a mutable reference to the element at position n, which
+    //! takes up to two I/Os if it is neither in the front nor the back block.
+    reference operator [] (size_type n)
+    {
+        return element(n, true);
+    }
+
+    //! Returns a const reference to the element at position n, which takes
+    //! up to two I/Os if it is neither in the front nor the back block.
+    const_reference operator [] (size_type n) const
+    {
+        return element(n, false);
+    }
+
+    //! Returns a mutable reference at the back of the deque
+    reference back()
+    {
+        assert(!empty());
+        return (*m_back_block)[m_back_end - 1];
+    }
+
+    //! Returns a const reference at the back of the deque
+    const_reference back() const
+    {
+        assert(!empty());
+        return (*m_back_block)[m_back_end - 1];
+    }
+
+    //! Returns a mutable reference at the front of the deque
+    reference front()
+    {
+        assert(!empty());
+        return (*m_front_block)[m_front_pos];
+    }
+
+    //! Returns a const reference at the front of the deque
+    const_reference front() const
+    {
+        assert(!empty());
+        return (*m_front_block)[m_front_pos];
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_BLOCK_DEQUE_HEADER
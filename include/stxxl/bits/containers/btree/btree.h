@@ -14,8 +14,13 @@
 #define STXXL_CONTAINERS_BTREE_BTREE_HEADER
 
 #include <algorithm>
+#include <deque>
+#include <functional>
+#include <iterator>
 #include <limits>
 #include <map>
+#include <memory>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -25,8 +30,13 @@
 #include <stxxl/bits/containers/btree/node.h>
 #include <stxxl/bits/containers/btree/node_cache.h>
 #include <stxxl/bits/containers/btree/root_node.h>
+#include <stxxl/bits/config.h>
 #include <stxxl/vector>
 
+#if STXXL_PARALLEL
+#include <omp.h>
+#endif
+
 namespace stxxl {
 namespace btree {
 
@@ -35,7 +45,9 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression = no_compression,
+          class PagerType = stxxl::lru_pager<>
           >
 class btree
 {
@@ -47,9 +59,11 @@ public:
     using key_compare = KeyCompareWithMaxType;
 
     using self_type = btree<KeyType, DataType, KeyCompareWithMaxType,
-                            RawNodeSize, RawLeafSize, PDAllocStrategy>;
+                            RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>;
 
     using alloc_strategy_type = PDAllocStrategy;
+    using compression_type = Compression;
+    using pager_type = PagerType;
 
     using size_type = external_size_type;
     using difference_type = external_diff_type;
@@ -60,8 +74,8 @@ public:
     using const_pointer = value_type const*;
 
     // leaf type declarations
-    using leaf_type = normal_leaf<key_type, data_type, key_compare, RawLeafSize, self_type>;
-    friend class normal_leaf<key_type, data_type, key_compare, RawLeafSize, self_type>;
+    using leaf_type = normal_leaf<key_type, data_type, key_compare, RawLeafSize, self_type, Compression>;
+    friend class normal_leaf<key_type, data_type, key_compare, RawLeafSize, self_type, Compression>;
     using leaf_block_type = typename leaf_type::block_type;
     using leaf_bid_type = typename leaf_type::bid_type;
     using leaf_cache_type = node_cache<leaf_type, self_type>;
@@ -69,19 +83,25 @@ public:
     // iterator types
     using iterator = btree_iterator<self_type>;
     using const_iterator = btree_const_iterator<self_type>;
+    using snapshot_iterator = btree_snapshot_iterator<self_type>;
     friend class btree_iterator_base<self_type>;
+    friend class btree_snapshot_iterator<self_type>;
     // iterator map type
     using iterator_map_type = iterator_map<self_type>;
     // node type declarations
-    using node_type = normal_node<key_type, key_compare, RawNodeSize, self_type>;
+    using node_type = normal_node<key_type, key_compare, RawNodeSize, self_type, Compression>;
     using node_block_type = typename node_type::block_type;
-    friend class normal_node<key_type, key_compare, RawNodeSize, self_type>;
+    friend class normal_node<key_type, key_compare, RawNodeSize, self_type, Compression>;
     using node_bid_type = typename node_type::bid_type;
     using node_cache_type = node_cache<node_type, self_type>;
     friend class node_cache<node_type, self_type>;
 
     using value_compare = typename leaf_type::value_compare;
 
+    //! whether the subtree sizes for rank() and select() are maintained,
+    //! which requires uncompressed nodes
+    static constexpr bool counted = node_type::counted;
+
     enum {
         min_node_size = node_type::min_size,
         max_node_size = node_type::max_size,
@@ -91,12 +111,28 @@ public:
 
 private:
     key_compare m_key_compare;
+    //! file the tree is stored in, if any; it outlives the caches, which
+    //! write their nodes to it when destroyed
+    std::unique_ptr<file_storage> m_storage;
     mutable node_cache_type m_node_cache;
     mutable leaf_cache_type m_leaf_cache;
     iterator_map_type m_iterator_map;
     size_type m_size;
     unsigned int m_height;
     bool m_prefetching_enabled;
+    //! number of upper node levels kept in the node cache, see
+    //! set_pinned_levels()
+    unsigned m_pinned_levels { 0 };
+    //! node_cache::nchanges() when the pinned nodes were last determined
+    mutable uint64_t m_pinned_changes { 0 };
+    //! number of leaves read ahead of scanning iterators, see set_read_ahead()
+    size_t m_read_ahead { 8 };
+    //! leaves prefetched ahead of the current scan, in key order
+    mutable std::deque<leaf_bid_type> m_read_ahead_bids;
+    //! splitter key of the last leaf prefetched ahead
+    mutable key_type m_read_ahead_last;
+    //! end key of the current scan, set by range()
+    mutable key_type m_read_ahead_bound;
     foxxll::block_manager* m_bm;
     alloc_strategy_type m_alloc_strategy;
 
@@ -106,15 +142,463 @@ private:
     using root_node_pair_type = std::pair<key_type, node_bid_type>;
 
     root_node_type m_root_node;
+    //! number of elements in the subtree of each entry of the root, if counted
+    using root_counts_type = std::map<key_type, size_type, key_compare>;
+    root_counts_type m_root_counts;
     iterator m_end_iterator;
 
+    //! kinds of messages buffered by insert_oblivious(), erase_oblivious()
+    //! and upsert()
+    enum message_kind { message_insert, message_erase, message_upsert };
+
+    struct message
+    {
+        message_kind kind;
+        data_type data;
+    };
+
+    using message_buffer_type = std::map<key_type, message, key_compare>;
+
+    //! approximate internal memory of a buffered message
+    static constexpr size_t message_bytes =
+        sizeof(typename message_buffer_type::value_type) + 4 * sizeof(void*);
+
+    //! messages not yet applied to the tree, at most one per key
+    message_buffer_type m_messages;
+    //! number of messages that triggers applying them
+    size_t m_max_messages { 16 * 1024 * 1024 / message_bytes };
+    //! merge function of the messages buffered by upsert()
+    std::function<data_type(const data_type&, const data_type&)> m_merge;
+
+    using concurrent_node_cache_type = sharded_node_cache<node_type>;
+    using concurrent_leaf_cache_type = sharded_node_cache<leaf_type>;
+
+    //! node and leaf caches of the readers, see begin_concurrent_reads()
+    std::unique_ptr<concurrent_node_cache_type> m_concurrent_node_cache;
+    std::unique_ptr<concurrent_leaf_cache_type> m_concurrent_leaf_cache;
+
+    void check_messages()
+    {
+        if (m_messages.size() >= m_max_messages)
+            apply_messages();
+    }
+
+    //! Applies the buffered messages in key order, hence all messages to a leaf
+    //! are applied while it is cached.
+    void apply_message_buffer()
+    {
+        TLX_LOG << "btree::apply_message_buffer messages=" << m_messages.size();
+
+        message_buffer_type messages(m_key_compare);
+        std::swap(messages, m_messages);
+
+        for (const auto& m : messages)
+        {
+            if (m.second.kind == message_erase)
+            {
+                erase(m.first);
+                continue;
+            }
+
+            std::pair<iterator, bool> result = insert(value_type(m.first, m.second.data));
+            if (result.second)
+                continue;
+
+            if (m.second.kind == message_insert)
+                result.first->second = m.second.data;
+            else
+                result.first->second = m_merge(result.first->second, m.second.data);
+        }
+    }
+
+    //! Whether the leaves collected by collect_leaves() suffice: n of them,
+    //! or up to the first one that reaches the bound of the scan.
+    bool read_ahead_collected(
+        const std::vector<std::pair<key_type, leaf_bid_type> >& leaves, size_t n) const
+    {
+        return leaves.size() >= n ||
+               (!leaves.empty() && !m_key_compare(leaves.back().first, m_read_ahead_bound));
+    }
+
+    //! Appends the splitter keys and BIDs of the leaves following the key
+    //! after in the subtree of a node until read_ahead_collected().
+    void collect_leaves(const node_bid_type& bid, unsigned height,
+                        const key_type& after, size_t n,
+                        std::vector<std::pair<key_type, leaf_bid_type> >& leaves) const
+    {
+        const node_type* node = m_node_cache.get_const_node(bid, true);
+        assert(node);
+
+        unsigned i = 0;
+        while (i < node->size() && !m_key_compare(after, (*node)[i].first))
+            ++i;
+
+        for ( ; i < node->size() && !read_ahead_collected(leaves, n); ++i)
+        {
+            if (height == 2)
+                leaves.emplace_back((*node)[i].first, static_cast<leaf_bid_type>((*node)[i].second));
+            else
+                collect_leaves((*node)[i].second, height - 1, after, n, leaves);
+        }
+
+        m_node_cache.unfix_node(bid);
+    }
+
+    //! Collects the leaves whose keys follow the key after, from the root.
+    void collect_leaves(const key_type& after, size_t n,
+                        std::vector<std::pair<key_type, leaf_bid_type> >& leaves) const
+    {
+        for (root_node_const_iterator_type it = m_root_node.upper_bound(after);
+             it != m_root_node.end() && !read_ahead_collected(leaves, n); ++it)
+        {
+            if (m_height == 2)
+                leaves.emplace_back(it->first, static_cast<leaf_bid_type>(it->second));
+            else
+                collect_leaves(it->second, m_height - 1, after, n, leaves);
+        }
+    }
+
+    //! number of leaves to read ahead, bounded by a quarter of the leaf cache
+    size_t read_ahead_leaves() const
+    {
+        return std::max<size_t>(1, std::min(m_read_ahead, m_leaf_cache.size() / 4));
+    }
+
+    //! Prefetches the leaves following the last one prefetched once at most
+    //! half of the read-ahead window is left, skipping the current leaf.
+    void refill_read_ahead(const leaf_bid_type& current) const
+    {
+        const size_t n = read_ahead_leaves();
+        if (m_read_ahead_bids.size() > n / 2 ||
+            !m_key_compare(m_read_ahead_last, m_read_ahead_bound))
+            return;
+
+        std::vector<std::pair<key_type, leaf_bid_type> > leaves;
+        collect_leaves(m_read_ahead_last, n - m_read_ahead_bids.size(), leaves);
+        if (leaves.empty())
+            m_read_ahead_last = m_key_compare.max_value();
+
+        for (const auto& leaf : leaves)
+        {
+            m_read_ahead_last = leaf.first;
+            if (leaf.second == current)
+                continue;
+            m_leaf_cache.prefetch_node(leaf.second);
+            m_read_ahead_bids.push_back(leaf.second);
+        }
+        TLX_LOG << "btree::refill_read_ahead leaves ahead=" << m_read_ahead_bids.size();
+    }
+
+    //! Called by a scanning iterator entering a leaf: keeps read_ahead_leaves()
+    //! leaves prefetched ahead of it. A leaf that was not read ahead starts
+    //! a new scan; the succ leaf alone is prefetched if the read-ahead is 1.
+    void read_ahead_of(const leaf_type& leaf) const
+    {
+        if (read_ahead_leaves() <= 1)
+        {
+            if (leaf.succ().valid())
+                m_leaf_cache.prefetch_node(leaf.succ());
+            return;
+        }
+
+        typename std::deque<leaf_bid_type>::iterator it =
+            std::find(m_read_ahead_bids.begin(), m_read_ahead_bids.end(), leaf.my_bid());
+        if (it != m_read_ahead_bids.end())
+        {
+            m_read_ahead_bids.erase(m_read_ahead_bids.begin(), it + 1);
+        }
+        else
+        {
+            m_read_ahead_bids.clear();
+            m_read_ahead_last = leaf.back().first;
+            m_read_ahead_bound = m_key_compare.max_value();
+        }
+        refill_read_ahead(leaf.my_bid());
+    }
+
+    //! Starts reading ahead the leaves of a scan over [lower, upper).
+    void start_read_ahead(const key_type& lower, const key_type& upper) const
+    {
+        if (!m_prefetching_enabled || read_ahead_leaves() <= 1)
+            return;
+
+        m_read_ahead_bids.clear();
+        m_read_ahead_last = lower;
+        m_read_ahead_bound = upper;
+        refill_read_ahead(leaf_bid_type());
+    }
+
+    //! leaves holding a sorted batch of keys, each with the end of its keys
+    using leaf_groups_type = std::vector<std::pair<leaf_bid_type, size_t> >;
+
+    //! Appends the leaves of the keys [i, end) in the subtree of a node,
+    //! visiting each node on their paths once.
+    void group_keys_by_leaf(const node_bid_type& bid, unsigned height,
+                            const std::vector<key_type>& keys, size_t i, const size_t end,
+                            leaf_groups_type& groups) const
+    {
+        const node_type* node = m_node_cache.get_const_node(bid, true);
+        assert(node);
+        const typename node_type::value_type* first = &(*node)[0];
+        const typename node_type::value_type* last = first + node->size();
+        const key_compare& cmp = m_key_compare;
+
+        while (i < end)
+        {
+            // child containing keys[i], and the end of the keys it contains
+            first = node_type::key_search_type::lower_bound(first, last, keys[i], cmp);
+            assert(first != last);
+            const size_t j = static_cast<size_t>(
+                std::upper_bound(keys.begin() + i, keys.begin() + end, first->first, cmp)
+                - keys.begin());
+
+            if (height == 2)
+                groups.emplace_back(static_cast<leaf_bid_type>(first->second), j);
+            else
+                group_keys_by_leaf(first->second, height - 1, keys, i, j, groups);
+            i = j;
+        }
+
+        m_node_cache.unfix_node(bid);
+    }
+
+    //! Finds the leaves of a sorted batch of keys, from the root.
+    leaf_groups_type group_keys_by_leaf(const std::vector<key_type>& keys) const
+    {
+        assert(std::is_sorted(keys.begin(), keys.end(), m_key_compare));
+
+        leaf_groups_type groups;
+        for (size_t i = 0; i < keys.size(); )
+        {
+            root_node_const_iterator_type it = m_root_node.lower_bound(keys[i]);
+            assert(it != m_root_node.end());
+            const size_t j = static_cast<size_t>(
+                std::upper_bound(keys.begin() + i, keys.end(), it->first, m_key_compare)
+                - keys.begin());
+
+            if (m_height == 2)
+                groups.emplace_back(static_cast<leaf_bid_type>(it->second), j);
+            else
+                group_keys_by_leaf(it->second, m_height - 1, keys, i, j, groups);
+            i = j;
+        }
+        return groups;
+    }
+
+    //! Prefetches the leaves of the groups up to half of the leaf cache ahead
+    //! of group g, continuing at i_prefetch.
+    void prefetch_leaf_groups(const leaf_groups_type& groups, size_t g,
+                              size_t& i_prefetch) const
+    {
+        const size_t window = std::max<size_t>(1, m_leaf_cache.size() / 2);
+        for ( ; i_prefetch < groups.size() && i_prefetch < g + window; ++i_prefetch)
+            m_leaf_cache.prefetch_node(groups[i_prefetch].first);
+    }
+
+    //! Pins the nodes of the upper m_pinned_levels levels below the root in
+    //! the node cache, level by level as far as the cache leaves room for
+    //! fixing a path from the root to a leaf.
+    void refresh_pinned_levels() const
+    {
+        m_node_cache.unpin_all();
+        m_pinned_changes = m_node_cache.nchanges();
+        if (m_pinned_levels == 0 || m_height <= 2)
+            return;
+
+        const size_t max_pinned =
+            m_node_cache.size() > m_height ? m_node_cache.size() - m_height : 0;
+        size_t n_pinned = 0;
+
+        std::vector<node_bid_type> level, next_level;
+        for (root_node_const_iterator_type it = m_root_node.begin();
+             it != m_root_node.end(); ++it)
+            level.push_back(it->second);
+
+        for (unsigned height = m_height - 1;
+             height >= 2 && height + m_pinned_levels >= m_height; --height)
+        {
+            next_level.clear();
+            for (const node_bid_type& bid : level)
+            {
+                if (n_pinned == max_pinned)
+                {
+                    TLX_LOG << "btree::refresh_pinned_levels node cache full, pinned=" << n_pinned;
+                    return;
+                }
+                const node_type* node = m_node_cache.pin_node(bid);
+                assert(node);
+                ++n_pinned;
+
+                if (height > 2)
+                {
+                    for (unsigned i = 0; i < node->size(); ++i)
+                        next_level.push_back((*node)[i].second);
+                }
+            }
+            std::swap(level, next_level);
+        }
+        TLX_LOG << "btree::refresh_pinned_levels pinned=" << n_pinned;
+    }
+
+    //! Determines the pinned nodes again if nodes were created or deleted.
+    void check_pinned_levels() const
+    {
+        if (m_pinned_levels > 0 && m_node_cache.nchanges() != m_pinned_changes)
+            refresh_pinned_levels();
+    }
+
+    //! Pins a node or leaf of a sharded cache while in scope.
+    template <class CacheType>
+    class concurrent_pin
+    {
+        using bid_type = typename CacheType::bid_type;
+        using node_type = typename CacheType::node_type;
+
+        CacheType& m_cache;
+        bid_type m_bid;
+        const node_type* m_node;
+
+    public:
+        concurrent_pin(CacheType& cache, const bid_type& bid)
+            : m_cache(cache), m_bid(bid), m_node(cache.pin_node(bid))
+        { }
+
+        //! non-copyable: delete copy-constructor
+        concurrent_pin(const concurrent_pin&) = delete;
+        //! non-copyable: delete assignment operator
+        concurrent_pin& operator = (const concurrent_pin&) = delete;
+
+        ~concurrent_pin()
+        {
+            m_cache.unpin_node(m_bid);
+        }
+
+        const node_type& operator * () const
+        {
+            return *m_node;
+        }
+    };
+
+    //! Position of the first value not less than k in a node or leaf.
+    template <class NodeType>
+    const typename NodeType::value_type*
+    concurrent_lower_bound(const NodeType& node, const key_type& k) const
+    {
+        const typename NodeType::value_type* first = &node[0];
+        return NodeType::key_search_type::lower_bound(first, first + node.size(), k, m_key_compare);
+    }
+
+    //! Descends to the leaf that contains k, if any, through the sharded
+    //! caches. Each node is pinned only while its child is searched, since
+    //! the tree is not modified in the read-concurrent mode.
+    leaf_bid_type concurrent_find_leaf(const key_type& k) const
+    {
+        root_node_const_iterator_type it = m_root_node.lower_bound(k);
+        assert(it != m_root_node.end());
+
+        if (m_height == 2)
+            return static_cast<leaf_bid_type>(it->second);
+
+        node_bid_type bid = it->second;
+        for (unsigned height = m_height - 1; ; --height)
+        {
+            concurrent_pin<concurrent_node_cache_type> node(*m_concurrent_node_cache, bid);
+            const typename node_type::value_type* child = concurrent_lower_bound(*node, k);
+            assert(child != &(*node)[0] + (*node).size());
+
+            if (height == 2)
+                return static_cast<leaf_bid_type>(child->second);
+            bid = child->second;
+        }
+    }
+
+    //! Number of elements in the subtree of a child of a node of the given
+    //! height, whose children are leaves if the height is 2.
+    size_type subtree_size(const node_bid_type& bid, unsigned height) const
+    {
+        if (height == 2)
+        {
+            const leaf_type* leaf = m_leaf_cache.get_const_node(static_cast<leaf_bid_type>(bid));
+            assert(leaf);
+            return leaf->subtree_size();
+        }
+        const node_type* node = m_node_cache.get_const_node(bid);
+        assert(node);
+        return node->subtree_size();
+    }
+
+    //! Finds the leaf of the element at position i < m_size and its position
+    //! in the leaf by the subtree sizes of the entries.
+    std::pair<leaf_bid_type, unsigned> locate(size_type i) const
+    {
+        check_pinned_levels();
+
+        root_node_const_iterator_type it = m_root_node.begin();
+        typename root_counts_type::const_iterator count_it = m_root_counts.begin();
+        for ( ; i >= count_it->second; ++it, ++count_it)
+            i -= count_it->second;
+
+        node_bid_type bid = it->second;
+        for (unsigned height = m_height; height > 2; --height)
+        {
+            const node_type* node = m_node_cache.get_const_node(bid, true);
+            assert(node);
+            unsigned j = 0;
+            for ( ; i >= node->count(j); ++j)
+                i -= node->count(j);
+            const node_bid_type child = (*node)[j].second;
+            m_node_cache.unfix_node(bid);
+            bid = child;
+        }
+        return std::make_pair(static_cast<leaf_bid_type>(bid), static_cast<unsigned>(i));
+    }
+
+    //! Number of elements in the subtree of the root entry with the given
+    //! key, 0 if not counted.
+    size_type root_count(const key_type& key) const
+    {
+        if (!counted)
+            return 0;
+        typename root_counts_type::const_iterator it = m_root_counts.find(key);
+        assert(it != m_root_counts.end());
+        return it->second;
+    }
+
+    //! whether the root does not fit into a node
+    bool root_overflows() const
+    {
+        if (m_root_node.size() > max_node_size)
+            return true;
+        return node_type::compressed &&
+               node_type::codec_type::size(m_root_node.begin(), m_root_node.end())
+               > node_type::payload_size;
+    }
+
+    //! number of entries of the root to move into the left node on a split
+    size_t root_split_point() const
+    {
+        if (!node_type::compressed)
+            return m_root_node.size() / 2;
+
+        const std::vector<root_node_pair_type> values(m_root_node.begin(), m_root_node.end());
+        return node_type::codec_type::split_point(values.begin(), values.end());
+    }
+
     void insert_into_root(const std::pair<key_type, node_bid_type>& splitter)
     {
         std::pair<root_node_iterator_type, bool> result = m_root_node.insert(splitter);
         assert(result.second);
         tlx::unused(result);
 
-        if (m_root_node.size() > max_node_size) // root overflow
+        if (counted)
+        {
+            // the new child took the smaller part of the split child's elements
+            const size_type left_count = subtree_size(splitter.second, m_height);
+            m_root_counts[splitter.first] = left_count;
+            m_root_counts.upper_bound(splitter.first)->second -= left_count;
+        }
+
+        if (root_overflows())
         {
             TLX_LOG << "btree::insert_into_root, overflow happened, splitting";
 
@@ -126,33 +610,26 @@ private:
             assert(right_node);
 
             const size_t old_size = m_root_node.size();
-            const size_t half = m_root_node.size() / 2;
+            const size_t half = root_split_point();
             size_t i = 0;
             root_node_iterator_type it = m_root_node.begin();
-            typename node_block_type::iterator block_it = left_node->block().begin();
             while (i < half)                    // copy smaller part
             {
-                *block_it = *it;
+                left_node->push_back(*it, root_count(it->first));
                 ++i;
-                ++block_it;
                 ++it;
             }
-            left_node->block().info.cur_size = static_cast<unsigned int>(half);
-            key_type left_key = (left_node->block()[half - 1]).first;
+            assert(left_node->size() == half);
+            key_type left_key = left_node->back().first;
 
-            block_it = right_node->block().begin();
             while (i < old_size)                // copy larger part
             {
-                *block_it = *it;
+                right_node->push_back(*it, root_count(it->first));
                 ++i;
-                ++block_it;
                 ++it;
             }
 
-            const auto right_size = static_cast<size_t>(old_size - half);
-            right_node->block().info.cur_size = right_size;
-
-            key_type right_key = (right_node->block()[right_size - 1]).first;
+            key_type right_key = right_node->back().first;
 
             assert(old_size == right_node->size() + left_node->size());
 
@@ -160,6 +637,12 @@ private:
             m_root_node.clear();
             m_root_node.insert(root_node_pair_type(left_key, left_bid));
             m_root_node.insert(root_node_pair_type(right_key, right_bid));
+            if (counted)
+            {
+                m_root_counts.clear();
+                m_root_counts[left_key] = left_node->subtree_size();
+                m_root_counts[right_key] = right_node->subtree_size();
+            }
 
             ++m_height;
             TLX_LOG << "btree Increasing height to " << m_height;
@@ -198,8 +681,7 @@ private:
         local_node_type* left_node = cache.get_node(left_bid, true);
         local_node_type* right_node = cache.get_node(right_bid, true);
 
-        const size_t total_size = left_node->size() + right_node->size();
-        if (total_size <= right_node->max_nelements())
+        if (right_node->can_fuse(*left_node))
         {
             // --- fuse ---
 
@@ -210,6 +692,12 @@ private:
             // 'delete_node' unfixes left_bid also
             cache.delete_node(left_bid);
 
+            if (counted)
+            {
+                m_root_counts[right_it->first] += m_root_counts[left_it->first];
+                m_root_counts.erase(left_it->first);
+            }
+
             // delete left BID from the root
             m_root_node.erase(left_it);
         }
@@ -219,6 +707,13 @@ private:
 
             key_type new_splitter = right_node->balance(*left_node);
 
+            if (counted)
+            {
+                m_root_counts.erase(left_it->first);
+                m_root_counts[new_splitter] = left_node->subtree_size();
+                m_root_counts[right_it->first] = right_node->subtree_size();
+            }
+
             // delete left BID from the root
             m_root_node.erase(left_it);
 
@@ -238,6 +733,8 @@ private:
         m_end_iterator = new_leaf->end();           // initialize end() iterator
         m_root_node.insert(
             root_node_pair_type(m_key_compare.max_value(), static_cast<node_bid_type>(new_bid)));
+        if (counted)
+            m_root_counts[m_key_compare.max_value()] = 0;
     }
 
     void deallocate_children()
@@ -266,51 +763,459 @@ private:
         }
     }
 
+    //! header of the superblock describing this tree
+    file_storage::header_type superblock_header() const
+    {
+        file_storage::header_type header;
+        header.magic = file_storage::magic;
+        header.version = file_storage::version;
+        header.node_size = node_bid_type::size;
+        header.leaf_size = leaf_bid_type::size;
+        header.key_size = sizeof(key_type);
+        header.data_size = sizeof(data_type);
+        header.compressed = leaf_type::compressed;
+        header.size = m_size;
+        header.height = m_height;
+        header.end = header.meta_bytes = 0;
+        return header;
+    }
+
+    //! Writes the superblock with the root node's entries to the file.
+    void write_superblock()
+    {
+        file_storage::metadata_type meta;
+        meta.put<uint64_t>(m_root_node.size());
+        for (root_node_const_iterator_type it = m_root_node.begin();
+             it != m_root_node.end(); ++it)
+        {
+            meta.put(it->first);
+            meta.put<uint64_t>(it->second.offset);
+            meta.put<uint64_t>(root_count(it->first));
+        }
+        m_storage->put_free_lists(meta);
+        m_storage->write_superblock(superblock_header(), meta);
+    }
+
+    //! Reopens the tree from the superblock of the file.
+    void read_superblock()
+    {
+        auto superblock = m_storage->read_superblock();
+        const file_storage::header_type& header = superblock.first;
+        file_storage::metadata_type& meta = superblock.second;
+
+        const file_storage::header_type expected = superblock_header();
+        if (header.node_size != expected.node_size ||
+            header.leaf_size != expected.leaf_size ||
+            header.key_size != expected.key_size ||
+            header.data_size != expected.data_size ||
+            header.compressed != expected.compressed)
+        {
+            FOXXLL_THROW2(std::runtime_error, "btree::btree",
+                          "The file contains a btree with a different layout.");
+        }
+
+        m_size = header.size;
+        m_height = static_cast<unsigned>(header.height);
+
+        const auto nroot = meta.get<uint64_t>();
+        for (uint64_t i = 0; i < nroot; ++i)
+        {
+            const auto key = meta.get<key_type>();
+            const node_bid_type bid(m_storage->file().get(), meta.get<uint64_t>());
+            m_root_node.insert(root_node_pair_type(key, bid));
+            const auto count = meta.get<uint64_t>();
+            if (counted)
+                m_root_counts[key] = count;
+        }
+        m_storage->get_free_lists(meta);
+
+        // the end() iterator points behind the last leaf
+        node_bid_type bid = m_root_node.rbegin()->second;
+        for (unsigned height = m_height; height > 2; --height)
+        {
+            const node_type* node = m_node_cache.get_const_node(bid);
+            assert(node);
+            bid = node->back().second;
+        }
+        leaf_type* leaf = m_leaf_cache.get_node(static_cast<leaf_bid_type>(bid));
+        assert(leaf);
+        m_end_iterator = leaf->end();
+
+        TLX_LOG << "btree reopened from a file, size=" << m_size
+                << " height=" << m_height;
+    }
+
+    //! Presents an iterator range as a stream to bulk_construction().
     template <class InputIterator>
-    void bulk_construction(InputIterator begin, InputIterator end,
+    class range_stream
+    {
+        InputIterator m_current, m_end;
+
+    public:
+        range_stream(InputIterator begin, InputIterator end)
+            : m_current(begin), m_end(end) { }
+
+        bool empty() const { return m_current == m_end; }
+        decltype(auto) operator * () const { return *m_current; }
+        range_stream& operator ++ ()
+        {
+            ++m_current;
+            return *this;
+        }
+    };
+
+    /*!
+     * Merges the leaves of the tree, from the given first leaf on, with a
+     * sorted range and presents the result as a stream to
+     * bulk_construction(). Each leaf is deleted as soon as it is consumed,
+     * such that the rebuilt tree can reuse its block, and its successor is
+     * prefetched. Of equal keys the element of the tree comes first, hence
+     * bulk_construction() keeps it, as insert() does.
+     */
+    template <class InputIterator>
+    class merge_stream
+    {
+        btree* m_btree;
+        leaf_bid_type m_bid;
+        //! current leaf, fixed in the cache, or nullptr after the last one
+        const leaf_type* m_leaf;
+        size_t m_pos;
+        InputIterator m_current, m_end;
+        //! whether the next element is taken from the leaf
+        bool m_from_leaf;
+
+        void open_leaf(const leaf_bid_type& bid)
+        {
+            m_bid = bid;
+            m_leaf = m_btree->m_leaf_cache.get_node(bid, true);
+            assert(m_leaf);
+            m_pos = 0;
+            if (m_btree->m_prefetching_enabled && m_leaf->succ().valid())
+                m_btree->m_leaf_cache.prefetch_node(m_leaf->succ());
+            if (m_leaf->size() == 0)
+                next_leaf();
+        }
+
+        void next_leaf()
+        {
+            const leaf_bid_type succ = m_leaf->succ();
+            // 'delete_node' unfixes the leaf also
+            m_btree->m_leaf_cache.delete_node(m_bid);
+            m_leaf = nullptr;
+            if (succ.valid())
+                open_leaf(succ);
+        }
+
+        void choose()
+        {
+            m_from_leaf = m_leaf &&
+                          (m_current == m_end ||
+                           !m_btree->m_key_compare(m_current->first, (*m_leaf)[m_pos].first));
+        }
+
+    public:
+        merge_stream(btree* bt, const leaf_bid_type& first_leaf,
+                     InputIterator begin, InputIterator end)
+            : m_btree(bt), m_leaf(nullptr), m_pos(0),
+              m_current(begin), m_end(end)
+        {
+            open_leaf(first_leaf);
+            choose();
+        }
+
+        bool empty() const { return !m_leaf && m_current == m_end; }
+        typename leaf_type::value_type operator * () const
+        {
+            if (m_from_leaf)
+                return (*m_leaf)[m_pos];
+            return typename leaf_type::value_type(m_current->first, m_current->second);
+        }
+        merge_stream& operator ++ ()
+        {
+            if (!m_from_leaf)
+                ++m_current;
+            else if (++m_pos == m_leaf->size())
+                next_leaf();
+            choose();
+            return *this;
+        }
+    };
+
+    //! Returns the BID of the first leaf.
+    leaf_bid_type first_leaf_bid()
+    {
+        node_bid_type bid = m_root_node.begin()->second;
+        for (unsigned height = m_height; height > 2; --height)
+        {
+            const node_type* node = m_node_cache.get_const_node(bid);
+            assert(node);
+            bid = (*node)[0].second;
+        }
+        return static_cast<leaf_bid_type>(bid);
+    }
+
+    //! Returns the BID of the leaf whose key range contains k.
+    leaf_bid_type find_leaf_bid(const key_type& k)
+    {
+        node_bid_type bid = m_root_node.lower_bound(k)->second;
+        for (unsigned height = m_height; height > 2; --height)
+        {
+            const node_type* node = m_node_cache.get_const_node(bid);
+            assert(node);
+            bid = concurrent_lower_bound(*node, k)->second;
+        }
+        return static_cast<leaf_bid_type>(bid);
+    }
+
+    //! Replaces the root, which has a single child node, by that node.
+    void decrease_height()
+    {
+        TLX_LOG << "btree Root has size 1 and height > 2";
+        TLX_LOG << "btree Deallocate root and decrease height";
+        root_node_iterator_type it = m_root_node.begin();
+        node_bid_type root_bid = it->second;
+        assert(it->first == m_key_compare.max_value());
+        node_type* root_node = m_node_cache.get_node(root_bid);
+        assert(root_node);
+        assert(root_node->back().first == m_key_compare.max_value());
+        m_root_node.clear();
+        m_root_node.insert(root_node->block().begin(),
+                           root_node->block().begin() + root_node->size());
+        if (counted)
+        {
+            m_root_counts.clear();
+            for (unsigned i = 0; i < root_node->size(); ++i)
+                m_root_counts[(*root_node)[i].first] = root_node->count(i);
+        }
+
+        m_node_cache.delete_node(root_bid);
+        --m_height;
+        TLX_LOG << "btree Decreasing height to " << m_height;
+    }
+
+    //! Deletes the subtree of a child of a node of the given height, a leaf if
+    //! the height is 2, without reading its leaves. If the nodes carry no
+    //! subtree sizes, the leaves are read to add their sizes to n instead.
+    void delete_subtree(const node_bid_type& bid, unsigned height, size_type& n)
+    {
+        if (height == 2)
+        {
+            const leaf_bid_type leaf_bid = static_cast<leaf_bid_type>(bid);
+            if (!counted)
+                n += m_leaf_cache.get_const_node(leaf_bid)->size();
+            // delete from leaf cache and deallocate bid
+            m_leaf_cache.delete_node(leaf_bid);
+            return;
+        }
+        node_type* node = m_node_cache.get_node(bid, true);
+        assert(node);
+        for (unsigned i = 0; i < node->size(); ++i)
+            delete_subtree((*node)[i].second, height - 1, n);
+        // 'delete_node' unfixes the node also
+        m_node_cache.delete_node(bid);
+    }
+
+    //! Erases the elements with keys in [lower, upper) from the subtree of a
+    //! child of a node of the given height, see normal_node::erase_range().
+    size_type erase_range(const node_bid_type& bid, unsigned height,
+                          const key_type& lower, const key_type& upper, bool erase_front)
+    {
+        if (height == 2)
+        {
+            // the keys of the leaf are at least lower if erase_front
+            const leaf_bid_type leaf_bid = static_cast<leaf_bid_type>(bid);
+            leaf_type* leaf = m_leaf_cache.get_node(leaf_bid, true);
+            assert(leaf);
+            const size_type result = leaf->erase_range(lower, upper);
+            m_leaf_cache.unfix_node(leaf_bid);
+            return result;
+        }
+        node_type* node = m_node_cache.get_node(bid, true);
+        assert(node);
+        const size_type result = node->erase_range(lower, upper, height - 1, erase_front);
+        m_node_cache.unfix_node(bid);
+        return result;
+    }
+
+    //! Erases the elements with keys in [lower, upper) from the children of
+    //! the root, see normal_node::erase_range().
+    size_type erase_range(const key_type& lower, const key_type& upper)
+    {
+        root_node_iterator_type first = m_root_node.lower_bound(lower);
+        root_node_iterator_type last = m_root_node.lower_bound(upper);
+        assert(last != m_root_node.end());
+        size_type result = 0;
+
+        if (first != last)
+        {
+            for (root_node_iterator_type it = std::next(first); it != last; )
+            {
+                if (counted)
+                {
+                    result += m_root_counts[it->first];
+                    m_root_counts.erase(it->first);
+                }
+                delete_subtree(it->second, m_height, result);
+                it = m_root_node.erase(it);
+            }
+
+            const size_type n = erase_range(last->second, m_height, lower, upper, true);
+            if (counted)
+                m_root_counts[last->first] -= n;
+            result += n;
+        }
+
+        const size_type n = erase_range(first->second, m_height, lower, upper, false);
+        if (counted)
+            m_root_counts[first->first] -= n;
+
+        return result + n;
+    }
+
+    //! Fixes the underflows on the path to key k below a child of a node of
+    //! the given height, see normal_node::fix_path(), and returns whether the
+    //! child underflows.
+    bool fix_path(const node_bid_type& bid, unsigned height, const key_type& k, bool& changed)
+    {
+        if (height == 2)
+            return m_leaf_cache.get_const_node(static_cast<leaf_bid_type>(bid))->underflows();
+
+        node_type* node = m_node_cache.get_node(bid, true);
+        assert(node);
+        changed |= node->fix_path(k, height - 1);
+        m_node_cache.unfix_node(bid);
+        return node->underflows();
+    }
+
+    //! Fixes the underflows on the path to key k left by erase_range(), see
+    //! normal_node::fix_path(), and returns whether anything was changed.
+    bool fix_path(const key_type& k)
+    {
+        bool changed = false;
+        while (true)
+        {
+            root_node_iterator_type it = m_root_node.lower_bound(k);
+            assert(it != m_root_node.end());
+
+            if (!fix_path(it->second, m_height, k, changed) || m_root_node.size() == 1)
+                return changed;
+
+            if (m_height == 2)
+                fuse_or_balance(it, m_leaf_cache);
+            else
+                fuse_or_balance(it, m_node_cache);
+            changed = true;
+        }
+    }
+
+    //! Deletes the node with the given BID and the nodes below it, but not
+    //! the leaves.
+    void deallocate_nodes(const node_bid_type& bid, unsigned height)
+    {
+        if (height > 2)
+        {
+            node_type* node = m_node_cache.get_node(bid, true);
+            assert(node);
+            for (unsigned i = 0; i < node->size(); ++i)
+                deallocate_nodes((*node)[i].second, height - 1);
+        }
+        // 'delete_node' unfixes the node also
+        m_node_cache.delete_node(bid);
+    }
+
+    /*!
+     * Whether merging n sorted elements into the leaves and rebuilding the
+     * tree is cheaper than inserting them one by one: the merge reads and
+     * writes each leaf once and sequentially, while the insertions each read
+     * and write a random leaf, so the merge pays off once the range has about
+     * one element per leaf of the result. The merge fixes up to three leaves
+     * at once.
+     */
+    bool merge_is_favorable(size_t n) const
+    {
+        return m_leaf_cache.size() > 3 &&
+               n * (max_leaf_size / 2) >= m_size + n;
+    }
+
+    //! (max key, BID) of the children of a level built by the bulk
+    //! construction
+    using key_bid_pair = std::pair<key_type, node_bid_type>;
+    using key_bid_vector_type = typename stxxl::vector<
+              key_bid_pair, 1, stxxl::random_pager<1>, node_block_type::raw_size
+              >;
+    //! number of elements below each of the children
+    using count_vector_type = typename stxxl::vector<
+              size_type, 1, stxxl::random_pager<1>, node_block_type::raw_size
+              >;
+
+    //! Builds the tree bottom-up from a stream sorted by key: the leaves are
+    //! filled in order and written as soon as they are complete, overlapping
+    //! with filling the next ones, then each level of nodes is built from the
+    //! BIDs of the level below.
+    template <class StreamType>
+    void bulk_construction(StreamType& input,
                            double node_fill_factor, double leaf_fill_factor)
     {
         assert(node_fill_factor >= 0.5);
         assert(leaf_fill_factor >= 0.5);
         key_type last_key = m_key_compare.max_value();
 
-        using key_bid_pair = std::pair<key_type, node_bid_type>;
-        using key_bid_vector_type = typename stxxl::vector<
-                  key_bid_pair, 1, stxxl::random_pager<1>, node_block_type::raw_size
-                  >;
-
         key_bid_vector_type bids;
+        count_vector_type counts;
+
+        using leaf_codec_type = typename leaf_type::codec_type;
 
+        // the leaf being filled is fixed, since the input may read leaves
         leaf_bid_type new_bid;
         leaf_type* leaf = m_leaf_cache.get_new_node(new_bid);
+        m_leaf_cache.fix_node(new_bid);
         const size_t max_leaf_elements = static_cast<size_t>(
             leaf->max_nelements() * leaf_fill_factor);
+        // encoded leaves are filled by bytes
+        const auto max_leaf_bytes = static_cast<size_t>(
+            leaf_type::payload_size * leaf_fill_factor);
+        size_t leaf_bytes = 0;
 
-        while (begin != end)
+        while (!input.empty())
         {
             // write data in leaves
+            const auto& value = *input;
 
-            // if *b not equal to the last element
-            if (m_key_compare(begin->first, last_key) || m_key_compare(last_key, begin->first))
+            // if value not equal to the last element
+            if (m_key_compare(value.first, last_key) || m_key_compare(last_key, value.first))
             {
                 ++m_size;
-                if (leaf->size() == max_leaf_elements)
+                if (leaf_type::compressed)
+                {
+                    leaf_bytes += leaf->size() == 0
+                                  ? leaf_codec_type::first_value_size(value)
+                                  : leaf_codec_type::value_size(leaf->back(), value);
+                }
+                if (leaf_type::compressed
+                    ? leaf->size() > 0 && leaf_bytes > max_leaf_bytes
+                    : leaf->size() == max_leaf_elements)
                 {
                     // overflow, need a new block
                     bids.push_back(key_bid_pair(leaf->back().first, static_cast<node_bid_type>(new_bid)));
+                    counts.push_back(leaf->size());
 
                     leaf_type* new_leaf = m_leaf_cache.get_new_node(new_bid);
                     assert(new_leaf);
+                    m_leaf_cache.fix_node(new_bid);
                     // Setting links
                     leaf->succ() = new_leaf->my_bid();
                     new_leaf->pred() = leaf->my_bid();
 
+                    m_leaf_cache.flush_node(leaf->my_bid());
+                    m_leaf_cache.unfix_node(leaf->my_bid());
+
                     leaf = new_leaf;
+                    leaf_bytes = leaf_codec_type::first_value_size(value);
                 }
-                leaf->push_back(*begin);
-                last_key = begin->first;
+                leaf->push_back(value);
+                last_key = value.first;
             }
-            ++begin;
+            ++input;
         }
 
         // rebalance the last leaf
@@ -318,12 +1223,13 @@ private:
         {
             leaf_type* left_leaf = m_leaf_cache.get_node(static_cast<leaf_bid_type>(bids.back().second));
             assert(left_leaf);
-            if (left_leaf->size() + leaf->size() <= leaf->max_nelements())
+            if (leaf->can_fuse(*left_leaf))
             {
                 // can fuse
                 leaf->fuse(*left_leaf);
                 m_leaf_cache.delete_node(static_cast<leaf_bid_type>(bids.back().second));
                 bids.pop_back();
+                counts.pop_back();
                 assert(!leaf->overflows() && !leaf->underflows());
             }
             else
@@ -331,6 +1237,7 @@ private:
                 // need to rebalance
                 const key_type new_splitter = leaf->balance(*left_leaf);
                 bids.back().first = new_splitter;
+                counts.back() = left_leaf->size();
                 assert(!left_leaf->overflows() && !left_leaf->underflows());
             }
         }
@@ -338,25 +1245,44 @@ private:
         assert(!leaf->overflows() && (!leaf->underflows() || m_size <= max_leaf_size));
 
         m_end_iterator = leaf->end();                 // initialize end() iterator
+        m_leaf_cache.unfix_node(new_bid);
 
         bids.push_back(key_bid_pair(m_key_compare.max_value(), static_cast<node_bid_type>(new_bid)));
+        counts.push_back(leaf->size());
+
+        bulk_construct_nodes(bids, counts, node_fill_factor);
+    }
+
+    //! Builds the levels of nodes above the leaves of a bulk construction,
+    //! each from the (max key, BID) pairs of the level below, and the root.
+    void bulk_construct_nodes(key_bid_vector_type& bids, count_vector_type& counts,
+                              double node_fill_factor)
+    {
+        using node_codec_type = typename node_type::codec_type;
 
         const auto max_node_elements = static_cast<size_t>(
             max_node_size * node_fill_factor);
+        // encoded nodes are filled by bytes
+        const auto max_node_bytes = static_cast<size_t>(
+            node_type::payload_size * node_fill_factor);
 
         //-tb fixes bug with only one child remaining in m_root_node
-        while (bids.size() > node_type::max_nelements())
+        while (bids.size() > node_type::max_nelements() ||
+               (node_type::compressed &&
+                node_codec_type::size(bids.begin(), bids.end()) > node_type::payload_size))
         {
             key_bid_vector_type parent_bids;
+            count_vector_type parent_counts;
 
             size_t nparents = foxxll::div_ceil(bids.size(), max_node_elements);
-            assert(nparents >= 2);
+            assert(node_type::compressed || nparents >= 2);
             TLX_LOG << "btree bulk construct"
                     << " bids.size=" << bids.size()
                     << " nparents=" << nparents
                     << " max_node_elements=" << max_node_elements
                     << " node_type::max_nelements=" << node_type::max_nelements();
 
+            typename count_vector_type::const_iterator count_it = counts.begin();
             for (typename key_bid_vector_type::const_iterator it = bids.begin();
                  it != bids.end(); )
             {
@@ -364,10 +1290,26 @@ private:
                 node_type* node = m_node_cache.get_new_node(new_bid);
                 assert(node);
 
-                for (size_t cnt = 0;
-                     cnt < max_node_elements && it != bids.end(); ++cnt, ++it)
+                if (node_type::compressed)
                 {
-                    node->push_back(*it);
+                    size_t node_bytes = 0;
+                    for ( ; it != bids.end(); ++it, ++count_it)
+                    {
+                        node_bytes += node->size() == 0
+                                      ? node_codec_type::first_value_size(*it)
+                                      : node_codec_type::value_size(node->back(), *it);
+                        if (node->size() > 0 && node_bytes > max_node_bytes)
+                            break;
+                        node->push_back(*it, *count_it);
+                    }
+                }
+                else
+                {
+                    for (size_t cnt = 0;
+                         cnt < max_node_elements && it != bids.end(); ++cnt, ++it, ++count_it)
+                    {
+                        node->push_back(*it, *count_it);
+                    }
                 }
 
                 TLX_LOG << "btree bulk construct node size : " << node->size()
@@ -382,7 +1324,7 @@ private:
 
                     node_type* left_node = m_node_cache.get_node(parent_bids.back().second);
                     assert(left_node);
-                    if (left_node->size() + node->size() <= node->max_nelements())
+                    if (node->can_fuse(*left_node))
                     {
                         // can fuse
                         TLX_LOG << "btree bulk construct fuse last nodes:"
@@ -392,6 +1334,7 @@ private:
                         node->fuse(*left_node);
                         m_node_cache.delete_node(parent_bids.back().second);
                         parent_bids.pop_back();
+                        parent_counts.pop_back();
                     }
                     else
                     {
@@ -402,6 +1345,7 @@ private:
 
                         const key_type new_splitter = node->balance(*left_node, false);
                         parent_bids.back().first = new_splitter;
+                        parent_counts.back() = left_node->subtree_size();
 
                         TLX_LOG << "btree bulk construct after rebalance:"
                                 << " left_node.size=" << left_node->size()
@@ -413,14 +1357,19 @@ private:
                 assert(!node->overflows() && !node->underflows());
 
                 parent_bids.push_back(key_bid_pair(node->back().first, new_bid));
+                parent_counts.push_back(node->subtree_size());
+
+                m_node_cache.flush_node(new_bid);
             }
 
             TLX_LOG << "btree parent_bids.size()=" << parent_bids.size()
                     << " bids.size()=" << bids.size();
 
             std::swap(parent_bids, bids);
+            std::swap(parent_counts, counts);
 
-            assert(nparents == bids.size() || (nparents - 1) == bids.size());
+            assert(node_type::compressed ||
+                   nparents == bids.size() || (nparents - 1) == bids.size());
 
             ++m_height;
             TLX_LOG << "Increasing height to " << m_height;
@@ -432,10 +1381,208 @@ private:
         }
 
         m_root_node.insert(bids.begin(), bids.end());
+        if (counted)
+        {
+            typename count_vector_type::const_iterator count_it = counts.begin();
+            for (typename key_bid_vector_type::const_iterator it = bids.begin();
+                 it != bids.end(); ++it, ++count_it)
+            {
+                m_root_counts[it->first] = *count_it;
+            }
+        }
 
         TLX_LOG << "btree bulk root_node_.size()=" << m_root_node.size();
     }
 
+    //! Whether the iterators address elements in internal memory, which may
+    //! be read by several threads at once: pointers and std::vector iterators.
+    template <class InputIterator>
+    struct is_contiguous_iterator
+    {
+        using element_type = typename std::remove_const<
+                  typename std::iterator_traits<InputIterator>::value_type>::type;
+        static constexpr bool value =
+            std::is_pointer<InputIterator>::value ||
+            std::is_same<InputIterator, typename std::vector<element_type>::iterator>::value ||
+            std::is_same<InputIterator, typename std::vector<element_type>::const_iterator>::value;
+    };
+
+    /*!
+     * Parallel bulk construction from a sorted range in internal memory. The
+     * range is split into one part per thread at key boundaries, and the
+     * number of distinct keys of each part determines its leaves, of the same
+     * sizes the sequential bulk_construction() gives them. Once the leaves'
+     * blocks are allocated, each thread fills the leaves of its part and
+     * writes them directly, bypassing the leaf cache, with up to three leaves
+     * in flight. The levels of nodes are then built by bulk_construct_nodes().
+     *
+     * \return false if nothing was done since the range is too small, the
+     * leaves are compressed, or a part is too small for a leaf of its own
+     */
+    template <class InputIterator>
+    bool parallel_bulk_construction(InputIterator begin, InputIterator end,
+                                    double node_fill_factor, double leaf_fill_factor)
+    {
+#if STXXL_PARALLEL
+        return parallel_bulk_construction(
+            begin, end, node_fill_factor, leaf_fill_factor,
+            std::integral_constant<bool, is_contiguous_iterator<InputIterator>::value>());
+#else
+        tlx::unused(begin, end, node_fill_factor, leaf_fill_factor);
+        return false;
+#endif
+    }
+
+#if STXXL_PARALLEL
+    template <class InputIterator>
+    bool parallel_bulk_construction(InputIterator, InputIterator, double, double,
+                                    std::false_type)
+    {
+        return false;
+    }
+
+    template <class InputIterator>
+    bool parallel_bulk_construction(InputIterator begin, InputIterator end,
+                                    double node_fill_factor, double leaf_fill_factor,
+                                    std::true_type)
+    {
+        assert(node_fill_factor >= 0.5);
+        assert(leaf_fill_factor >= 0.5);
+
+        // minimum number of leaves per thread
+        static constexpr size_t min_leaves_per_thread = 16;
+
+        if (leaf_type::compressed)
+            return false;
+
+        const size_t n = static_cast<size_t>(end - begin);
+        const size_t max_leaf_elements = static_cast<size_t>(
+            leaf_type::max_nelements() * leaf_fill_factor);
+        const size_t num_threads = std::min<size_t>(
+            static_cast<size_t>(omp_get_max_threads()),
+            n / (min_leaves_per_thread * max_leaf_elements));
+        if (num_threads <= 1)
+            return false;
+
+        // whether the element at i starts a new key
+        auto new_key = [&](size_t i) {
+                           return i == 0 || m_key_compare(begin[i - 1].first, begin[i].first);
+                       };
+
+        // the parts start at new keys
+        std::vector<size_t> part(num_threads + 1);
+        for (size_t t = 1; t < num_threads; ++t)
+        {
+            part[t] = std::max(part[t - 1], n * t / num_threads);
+            while (part[t] < n && !new_key(part[t]))
+                ++part[t];
+        }
+        part[num_threads] = n;
+
+        std::vector<size_t> n_keys(num_threads);
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            for (size_t i = part[t]; i < part[t + 1]; ++i)
+                n_keys[t] += new_key(i);
+        }
+
+        // leaves of max_leaf_elements, the last one of a part rebalanced as
+        // by bulk_construction()
+        std::vector<size_t> leaf_sizes, first_leaf(num_threads + 1);
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            first_leaf[t] = leaf_sizes.size();
+            if (n_keys[t] == 0)
+                continue;
+            if (n_keys[t] < leaf_type::min_nelements())
+                return false;
+
+            const size_t n_leaves = foxxll::div_ceil(n_keys[t], max_leaf_elements);
+            leaf_sizes.resize(leaf_sizes.size() + n_leaves, max_leaf_elements);
+            size_t last = n_keys[t] - (n_leaves - 1) * max_leaf_elements;
+            leaf_sizes.back() = last;
+            if (n_leaves > 1 && last < leaf_type::min_nelements())
+            {
+                last += max_leaf_elements;
+                leaf_sizes.pop_back();
+                if (last <= leaf_type::max_nelements())
+                    leaf_sizes.back() = last;
+                else
+                {
+                    leaf_sizes.back() = last / 2;
+                    leaf_sizes.push_back(last - last / 2);
+                }
+            }
+        }
+        first_leaf[num_threads] = leaf_sizes.size();
+
+        const size_t n_leaves = leaf_sizes.size();
+        std::vector<leaf_bid_type> leaf_bids(n_leaves);
+        m_leaf_cache.new_blocks(leaf_bids.begin(), leaf_bids.end());
+        std::vector<key_type> max_keys(n_leaves);
+
+        TLX_LOG << "btree parallel bulk construct threads=" << num_threads
+                << " leaves=" << n_leaves;
+
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            // a leaf is filled while the writes of the previous two complete
+            std::unique_ptr<leaf_type> leaves[3];
+            foxxll::request_ptr reqs[3];
+            for (size_t k = 0; k < 3; ++k)
+                leaves[k].reset(new leaf_type(this, m_key_compare));
+
+            size_t i = part[t];
+            for (size_t j = first_leaf[t]; j < first_leaf[t + 1]; ++j)
+            {
+                if (reqs[j % 3].valid())
+                    reqs[j % 3]->wait();
+
+                leaf_type& leaf = *leaves[j % 3];
+                leaf.init(leaf_bids[j]);
+                if (j > 0)
+                    leaf.pred() = leaf_bids[j - 1];
+                if (j + 1 < n_leaves)
+                    leaf.succ() = leaf_bids[j + 1];
+
+                for ( ; leaf.size() < leaf_sizes[j]; ++i)
+                {
+                    if (new_key(i))
+                        leaf.push_back(begin[i]);
+                }
+                max_keys[j] = leaf.back().first;
+                reqs[j % 3] = leaf.flush();
+            }
+            for (size_t k = 0; k < 3; ++k)
+            {
+                if (reqs[k].valid())
+                    reqs[k]->wait();
+            }
+        }
+
+        key_bid_vector_type bids;
+        count_vector_type counts;
+        for (size_t j = 0; j < n_leaves; ++j)
+        {
+            bids.push_back(key_bid_pair(
+                               j + 1 < n_leaves ? max_keys[j] : m_key_compare.max_value(),
+                               static_cast<node_bid_type>(leaf_bids[j])));
+            counts.push_back(leaf_sizes[j]);
+            m_size += leaf_sizes[j];
+        }
+
+        // initialize end() iterator
+        leaf_type* last_leaf = m_leaf_cache.get_node(leaf_bids.back());
+        assert(last_leaf);
+        m_end_iterator = last_leaf->end();
+
+        bulk_construct_nodes(bids, counts, node_fill_factor);
+        return true;
+    }
+#endif
+
 public:
     btree(const size_t node_cache_size_in_bytes,
           const size_t leaf_cache_size_in_bytes)
@@ -477,6 +1624,44 @@ public:
         create_empty_leaf();
     }
 
+    /*!
+     * Creates a btree stored in the given file, or reopens the btree stored
+     * in it if the file is not empty. All nodes and leaves are allocated in
+     * the file, and flush() and the destructor write a superblock which
+     * records the root node and the free blocks, such that reopening the
+     * file takes O(1) I/Os instead of rebuilding the tree. The file is
+     * consistent only after flush() or the destruction of the tree, and must
+     * be reopened with the same template parameters and an equivalent
+     * comparator.
+     */
+    btree(foxxll::file_ptr file,
+          const key_compare& c_,
+          const size_t node_cache_size_in_bytes,
+          const size_t leaf_cache_size_in_bytes)
+        : m_key_compare(c_),
+          m_storage(new file_storage(std::move(file))),
+          m_node_cache(node_cache_size_in_bytes, this, m_key_compare),
+          m_leaf_cache(leaf_cache_size_in_bytes, this, m_key_compare),
+          m_iterator_map(this),
+          m_size(0),
+          m_height(2),
+          m_prefetching_enabled(true),
+          m_bm(foxxll::block_manager::get_instance())
+    {
+        static_assert(std::is_trivially_copyable<key_type>::value,
+                      "a btree stored in a file requires trivially copyable keys");
+
+        TLX_LOG << "Creating a btree in a file, addr=" << this;
+
+        m_node_cache.set_storage(m_storage.get());
+        m_leaf_cache.set_storage(m_storage.get());
+
+        if (m_storage->has_superblock())
+            read_superblock();
+        else
+            create_empty_leaf();
+    }
+
     //! non-copyable: delete copy-constructor
     btree(const btree&) = delete;
     //! non-copyable: delete assignment operator
@@ -486,7 +1671,10 @@ public:
     {
         try
         {
-            deallocate_children();
+            if (m_storage)
+                flush();
+            else
+                deallocate_children();
         }
         catch (...)
         {
@@ -496,6 +1684,7 @@ public:
 
     size_type size() const
     {
+        apply_messages();
         return m_size;
     }
 
@@ -506,11 +1695,15 @@ public:
 
     bool empty() const
     {
+        apply_messages();
         return !m_size;
     }
 
     std::pair<iterator, bool> insert(const value_type& x)
     {
+        assert(!concurrent_reads());
+        apply_messages();
+        check_pinned_levels();
         root_node_iterator_type it = m_root_node.lower_bound(x.first);
         assert(!m_root_node.empty());
         assert(it != m_root_node.end());
@@ -523,7 +1716,11 @@ public:
             std::pair<key_type, leaf_bid_type> splitter;
             std::pair<iterator, bool> result = leaf->insert(x, splitter);
             if (result.second)
+            {
                 ++m_size;
+                if (counted)
+                    ++m_root_counts[it->first];
+            }
 
             m_leaf_cache.unfix_node(static_cast<leaf_bid_type>(it->second));
             //if(key_compare::max_value() == Splitter.first)
@@ -548,7 +1745,11 @@ public:
         std::pair<key_type, node_bid_type> splitter;
         std::pair<iterator, bool> result = node->insert(x, m_height - 1, splitter);
         if (result.second)
+        {
             ++m_size;
+            if (counted)
+                ++m_root_counts[it->first];
+        }
 
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
         //if(key_compare::max_value() == Splitter.first)
@@ -569,6 +1770,7 @@ public:
 
     iterator begin()
     {
+        apply_messages();
         root_node_iterator_type it = m_root_node.begin();
         assert(it != m_root_node.end());
 
@@ -598,6 +1800,7 @@ public:
 
     const_iterator begin() const
     {
+        apply_messages();
         root_node_const_iterator_type it = m_root_node.begin();
         assert(it != m_root_node.end());
 
@@ -624,11 +1827,13 @@ public:
 
     iterator end()
     {
+        apply_messages();
         return m_end_iterator;
     }
 
     const_iterator end() const
     {
+        apply_messages();
         return m_end_iterator;
     }
 
@@ -639,6 +1844,8 @@ public:
 
     iterator find(const key_type& k)
     {
+        apply_messages();
+        check_pinned_levels();
         root_node_iterator_type it = m_root_node.lower_bound(k);
         assert(it != m_root_node.end());
 
@@ -670,6 +1877,8 @@ public:
 
     const_iterator find(const key_type& k) const
     {
+        apply_messages();
+        check_pinned_levels();
         root_node_const_iterator_type it = m_root_node.lower_bound(k);
         assert(it != m_root_node.end());
 
@@ -699,8 +1908,71 @@ public:
         return result;
     }
 
+    /*!
+     * Look up a sorted batch of keys. The tree is descended once for the
+     * whole batch, visiting each node and leaf on the keys' paths once, and
+     * the leaves are read asynchronously in key order, up to half of the
+     * leaf cache ahead of the keys being looked up.
+     *
+     * \param first begin of the keys to look up, sorted by key_comp()
+     * \param last end of the keys to look up
+     * \param out receives the iterator of find() for each key, in input order
+     * \return end of the output range
+     */
+    template <class InputIterator, class OutputIterator>
+    OutputIterator find_batch(InputIterator first, InputIterator last,
+                              OutputIterator out)
+    {
+        apply_messages();
+        check_pinned_levels();
+        const std::vector<key_type> keys(first, last);
+        const leaf_groups_type groups = group_keys_by_leaf(keys);
+
+        size_t i = 0, i_prefetch = 0;
+        for (size_t g = 0; g < groups.size(); ++g)
+        {
+            prefetch_leaf_groups(groups, g, i_prefetch);
+            leaf_type* leaf = m_leaf_cache.get_node(groups[g].first, true);
+            assert(leaf);
+            for ( ; i < groups[g].second; ++i)
+                *out++ = leaf->find(keys[i]);
+            m_leaf_cache.unfix_node(groups[g].first);
+        }
+
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
+        return out;
+    }
+
+    template <class InputIterator, class OutputIterator>
+    OutputIterator find_batch(InputIterator first, InputIterator last,
+                              OutputIterator out) const
+    {
+        apply_messages();
+        check_pinned_levels();
+        const std::vector<key_type> keys(first, last);
+        const leaf_groups_type groups = group_keys_by_leaf(keys);
+
+        size_t i = 0, i_prefetch = 0;
+        for (size_t g = 0; g < groups.size(); ++g)
+        {
+            prefetch_leaf_groups(groups, g, i_prefetch);
+            const leaf_type* leaf = m_leaf_cache.get_const_node(groups[g].first, true);
+            assert(leaf);
+            for ( ; i < groups[g].second; ++i)
+                *out++ = leaf->find(keys[i]);
+            m_leaf_cache.unfix_node(groups[g].first);
+        }
+
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
+        return out;
+    }
+
     iterator lower_bound(const key_type& k)
     {
+        apply_messages();
+        check_pinned_levels();
         root_node_iterator_type it = m_root_node.lower_bound(k);
         assert(it != m_root_node.end());
 
@@ -730,6 +2002,8 @@ public:
 
     const_iterator lower_bound(const key_type& k) const
     {
+        apply_messages();
+        check_pinned_levels();
         root_node_const_iterator_type it = m_root_node.lower_bound(k);
         assert(it != m_root_node.end());
 
@@ -760,6 +2034,8 @@ public:
 
     iterator upper_bound(const key_type& k)
     {
+        apply_messages();
+        check_pinned_levels();
         root_node_iterator_type it = m_root_node.upper_bound(k);
         assert(it != m_root_node.end());
 
@@ -790,6 +2066,8 @@ public:
 
     const_iterator upper_bound(const key_type& k) const
     {
+        apply_messages();
+        check_pinned_levels();
         root_node_const_iterator_type it = m_root_node.upper_bound(k);
         assert(it != m_root_node.end());
 
@@ -818,6 +2096,48 @@ public:
         return result;
     }
 
+    /*!
+     * Returns the range [lower_bound(lower), lower_bound(upper)) and starts
+     * reading ahead its leaves: while the range is scanned, the next
+     * leaves up to the one containing upper are read asynchronously, see
+     * set_read_ahead(). Scans from begin(), lower_bound() or upper_bound()
+     * read ahead up to the end of the tree.
+     */
+    std::pair<iterator, iterator> range(const key_type& lower, const key_type& upper)
+    {
+        iterator first = lower_bound(lower);
+        iterator last = lower_bound(upper);
+        start_read_ahead(lower, upper);
+        return std::make_pair(first, last);
+    }
+
+    std::pair<const_iterator, const_iterator>
+    range(const key_type& lower, const key_type& upper) const
+    {
+        const_iterator first = lower_bound(lower);
+        const_iterator last = lower_bound(upper);
+        start_read_ahead(lower, upper);
+        return std::make_pair(first, last);
+    }
+
+    //! Snapshot iterators to the begin and end, see btree_snapshot_iterator:
+    //! cheaper to scan than const_iterator, but only valid until the next
+    //! modification.
+    std::pair<snapshot_iterator, snapshot_iterator> snapshot() const
+    {
+        return std::make_pair(snapshot_iterator(begin()), snapshot_iterator(end()));
+    }
+
+    //! Snapshot iterators to the range [lower_bound(lower),
+    //! lower_bound(upper)), whose leaves are read ahead like by range(). Only
+    //! valid until the next modification, see btree_snapshot_iterator.
+    std::pair<snapshot_iterator, snapshot_iterator>
+    snapshot_range(const key_type& lower, const key_type& upper) const
+    {
+        std::pair<const_iterator, const_iterator> r = range(lower, upper);
+        return std::make_pair(snapshot_iterator(r.first), snapshot_iterator(r.second));
+    }
+
     std::pair<iterator, iterator> equal_range(const key_type& k)
     {
         // l->first >= k
@@ -859,8 +2179,86 @@ public:
         return std::pair<const_iterator, const_iterator>(l, u);
     }
 
+    /*!
+     * Number of elements with keys less than k. The tree is descended once
+     * and the subtree sizes of the entries left of the path are summed up,
+     * hence it takes O(log n) I/Os instead of a scan. Requires uncompressed
+     * nodes, whose entries carry the subtree sizes.
+     */
+    size_type rank(const key_type& k) const
+    {
+        static_assert(counted, "rank() requires uncompressed nodes");
+        apply_messages();
+        check_pinned_levels();
+
+        size_type result = 0;
+        root_node_const_iterator_type it = m_root_node.begin();
+        typename root_counts_type::const_iterator count_it = m_root_counts.begin();
+        for ( ; m_key_compare(it->first, k); ++it, ++count_it)
+            result += count_it->second;
+
+        node_bid_type bid = it->second;
+        for (unsigned height = m_height; height > 2; --height)
+        {
+            const node_type* node = m_node_cache.get_const_node(bid, true);
+            assert(node);
+            unsigned i = 0;
+            for ( ; m_key_compare((*node)[i].first, k); ++i)
+                result += node->count(i);
+            const node_bid_type child = (*node)[i].second;
+            m_node_cache.unfix_node(bid);
+            bid = child;
+        }
+
+        const leaf_type* leaf = m_leaf_cache.get_const_node(static_cast<leaf_bid_type>(bid));
+        assert(leaf);
+        result += leaf->rank(k);
+
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
+        return result;
+    }
+
+    //! Iterator to the element at position i in key order, i.e. with rank i,
+    //! or end() if i >= size(), in O(log n) I/Os, see rank().
+    iterator select(size_type i)
+    {
+        static_assert(counted, "select() requires uncompressed nodes");
+        apply_messages();
+        if (i >= m_size)
+            return end();
+        const std::pair<leaf_bid_type, unsigned> pos = locate(i);
+        leaf_type* leaf = m_leaf_cache.get_node(pos.first);
+        assert(leaf);
+        return leaf->at(pos.second);
+    }
+
+    const_iterator select(size_type i) const
+    {
+        static_assert(counted, "select() requires uncompressed nodes");
+        apply_messages();
+        if (i >= m_size)
+            return end();
+        const std::pair<leaf_bid_type, unsigned> pos = locate(i);
+        const leaf_type* leaf = m_leaf_cache.get_const_node(pos.first);
+        assert(leaf);
+        return leaf->at(pos.second);
+    }
+
+    //! Number of elements with keys in [lower, upper), in O(log n) I/Os,
+    //! see rank().
+    size_type count_range(const key_type& lower, const key_type& upper) const
+    {
+        if (!m_key_compare(lower, upper))
+            return 0;
+        return rank(upper) - rank(lower);
+    }
+
     size_type erase(const key_type& k)
     {
+        assert(!concurrent_reads());
+        apply_messages();
+        check_pinned_levels();
         root_node_iterator_type it = m_root_node.lower_bound(k);
         assert(it != m_root_node.end());
 
@@ -871,6 +2269,8 @@ public:
             assert(Leaf);
             size_type result = Leaf->erase(k);
             m_size -= result;
+            if (counted)
+                m_root_counts[it->first] -= result;
             m_leaf_cache.unfix_node(static_cast<leaf_bid_type>(it->second));
             assert(m_leaf_cache.nfixed() == 0);
             assert(m_node_cache.nfixed() == 0);
@@ -895,6 +2295,8 @@ public:
         assert(node);
         size_type result = node->erase(k, m_height - 1);
         m_size -= result;
+        if (counted)
+            m_root_counts[it->first] -= result;
         m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
         assert(m_leaf_cache.nfixed() == 0);
         assert(m_node_cache.nfixed() == 0);
@@ -906,23 +2308,7 @@ public:
         fuse_or_balance(it, m_node_cache);
 
         if (m_root_node.size() == 1)
-        {
-            TLX_LOG << "btree Root has size 1 and height > 2";
-            TLX_LOG << "btree Deallocate root and decrease height";
-            it = m_root_node.begin();
-            node_bid_type root_bid = it->second;
-            assert(it->first == m_key_compare.max_value());
-            node_type* root_node = m_node_cache.get_node(root_bid);
-            assert(root_node);
-            assert(root_node->back().first == m_key_compare.max_value());
-            m_root_node.clear();
-            m_root_node.insert(root_node->block().begin(),
-                               root_node->block().begin() + root_node->size());
-
-            m_node_cache.delete_node(root_bid);
-            --m_height;
-            TLX_LOG << "btree Decreasing height to " << m_height;
-        }
+            decrease_height();
 
         assert(m_leaf_cache.nfixed() == 0);
         assert(m_node_cache.nfixed() == 0);
@@ -940,6 +2326,8 @@ public:
 
     void erase(iterator pos)
     {
+        assert(!concurrent_reads());
+        apply_messages();
         assert(pos != end());
 #ifndef NDEBUG
         size_type old_size = size();
@@ -956,11 +2344,177 @@ public:
         return insert(x).first;
     }
 
+    /*!
+     * Insert a value, or overwrite the value stored with the same key, without
+     * accessing external memory: the value is buffered as a message and
+     * applied together with other messages in key order once the message
+     * buffer is full (see set_message_buffer_size()), or before any other
+     * operation than insert_oblivious(), erase_oblivious() and upsert().
+     * Iterators obtained before the messages are applied do not reflect them.
+     */
+    void insert_oblivious(const value_type& x)
+    {
+        message& m = m_messages[x.first];
+        m.kind = message_insert;
+        m.data = x.second;
+        check_messages();
+    }
+
+    //! Erase the value with the given key, if any, without accessing external
+    //! memory, see insert_oblivious().
+    void erase_oblivious(const key_type& k)
+    {
+        message& m = m_messages[k];
+        m.kind = message_erase;
+        m.data = data_type();
+        check_messages();
+    }
+
+    /*!
+     * Insert a value, or merge it into the value stored with the same key,
+     * without accessing external memory, see insert_oblivious(). Repeated
+     * upserts of a key are merged in the buffer, which needs merge to be
+     * associative. All pending merges use the merge function of the latest
+     * call.
+     *
+     * \param x what to insert or merge
+     * \param merge computes the new data from the stored and the given data
+     */
+    template <class MergeFunction>
+    void upsert(const value_type& x, MergeFunction merge)
+    {
+        m_merge = merge;
+
+        typename message_buffer_type::iterator it = m_messages.find(x.first);
+        if (it == m_messages.end())
+            m_messages.insert(std::make_pair(x.first, message { message_upsert, x.second }));
+        else if (it->second.kind == message_erase)
+            it->second = message { message_insert, x.second };
+        else
+            it->second.data = merge(it->second.data, x.second);
+        check_messages();
+    }
+
+    //! Applies the messages buffered by insert_oblivious(), erase_oblivious()
+    //! and upsert(). This does not change the contents and is called
+    //! implicitly by all other operations.
+    void apply_messages() const
+    {
+        if (!m_messages.empty())
+            const_cast<btree*>(this)->apply_message_buffer();
+    }
+
+    //! Sets the internal memory of the message buffer in bytes.
+    void set_message_buffer_size(const size_t bytes)
+    {
+        m_max_messages = std::max<size_t>(1, bytes / message_bytes);
+        check_messages();
+    }
+
+    /*!
+     * Start the read-concurrent mode, in which concurrent_find() and
+     * concurrent_scan() may be called by any number of threads. Applies the
+     * buffered messages, writes back the modified nodes and leaves, and sets
+     * up sharded node and leaf caches of the same sizes for the readers.
+     * Until end_concurrent_reads(), the tree must not be modified, and other
+     * methods are not thread-safe.
+     *
+     * \param n_shards number of shards of the readers' caches, should be
+     *   about the number of reading threads
+     */
+    void begin_concurrent_reads(size_t n_shards = 16)
+    {
+        assert(!concurrent_reads());
+        apply_messages();
+        m_node_cache.flush();
+        m_leaf_cache.flush();
+        m_concurrent_node_cache.reset(new concurrent_node_cache_type(
+                                          m_node_cache.size() * node_block_type::raw_size,
+                                          n_shards, this, m_key_compare));
+        m_concurrent_leaf_cache.reset(new concurrent_leaf_cache_type(
+                                          m_leaf_cache.size() * leaf_block_type::raw_size,
+                                          n_shards, this, m_key_compare));
+    }
+
+    //! End the read-concurrent mode and release the readers' caches.
+    void end_concurrent_reads()
+    {
+        m_concurrent_node_cache.reset();
+        m_concurrent_leaf_cache.reset();
+    }
+
+    //! Whether the read-concurrent mode is active.
+    bool concurrent_reads() const
+    {
+        return m_concurrent_leaf_cache != nullptr;
+    }
+
+    /*!
+     * Look up the data of a key, thread-safe in the read-concurrent mode, see
+     * begin_concurrent_reads(). Nodes are read through the sharded caches and
+     * pinned only while they are searched.
+     *
+     * \param k key to look up
+     * \param data receives the data stored with k if found
+     * \return true if the key was found
+     */
+    bool concurrent_find(const key_type& k, data_type& data) const
+    {
+        assert(concurrent_reads());
+
+        const leaf_bid_type bid = concurrent_find_leaf(k);
+        concurrent_pin<concurrent_leaf_cache_type> leaf(*m_concurrent_leaf_cache, bid);
+        const typename leaf_type::value_type* it = concurrent_lower_bound(*leaf, k);
+
+        if (it == &(*leaf)[0] + (*leaf).size() || m_key_compare(k, it->first))
+            return false;
+        data = it->second;
+        return true;
+    }
+
+    /*!
+     * Call f(key, data) for all values with keys in [lower, upper) in key
+     * order, thread-safe in the read-concurrent mode, see
+     * begin_concurrent_reads(). The leaves are visited along their successor
+     * links, each pinned while f is called on its values.
+     */
+    template <class Functor>
+    void concurrent_scan(const key_type& lower, const key_type& upper,
+                         Functor f) const
+    {
+        assert(concurrent_reads());
+
+        leaf_bid_type bid = concurrent_find_leaf(lower);
+        bool first_leaf = true;
+        while (bid.valid())
+        {
+            concurrent_pin<concurrent_leaf_cache_type> leaf(*m_concurrent_leaf_cache, bid);
+            const typename leaf_type::value_type* it =
+                first_leaf ? concurrent_lower_bound(*leaf, lower) : &(*leaf)[0];
+            const typename leaf_type::value_type* end = &(*leaf)[0] + (*leaf).size();
+
+            for ( ; it != end; ++it)
+            {
+                if (!m_key_compare(it->first, upper))
+                    return;
+                f(it->first, it->second);
+            }
+
+            first_leaf = false;
+            bid = (*leaf).succ();
+        }
+    }
+
     void clear()
     {
+        assert(!concurrent_reads());
+        m_messages.clear();
+        m_read_ahead_bids.clear();
+
         deallocate_children();
 
         m_root_node.clear();
+        m_root_counts.clear();
 
         m_size = 0;
         m_height = 2,
@@ -970,13 +2524,88 @@ public:
         assert(m_node_cache.nfixed() == 0);
     }
 
+    /*!
+     * Inserts the elements of [b, e), of equal keys only the first. If
+     * range_sorted is true, the range must be sorted by key and allow
+     * multiple passes. Then, if it has about one element per leaf of the
+     * result or more, the leaves are merged with it in one sequential pass and
+     * the tree is rebuilt bottom-up as by bulk_load(), instead of inserting
+     * the elements one by one. The blocks of the old leaves are freed as they
+     * are merged, such that the new ones can reuse them. Like bulk_load(),
+     * the rebuild invalidates all iterators.
+     */
     template <class InputIterator>
-    void insert(InputIterator b, InputIterator e)
+    void insert(InputIterator b, InputIterator e,
+                bool range_sorted = false,
+                double node_fill_factor = 0.75,
+                double leaf_fill_factor = 0.6)
     {
-        while (b != e)
+        if (!range_sorted || !merge_is_favorable(
+                static_cast<size_t>(std::distance(b, e))))
         {
-            insert(*(b++));
+            while (b != e)
+            {
+                insert(*(b++));
+            }
+            return;
+        }
+
+        assert(!concurrent_reads());
+        assert(std::is_sorted(
+                   b, e,
+                   [this](const typename std::iterator_traits<InputIterator>::value_type& x,
+                          const typename std::iterator_traits<InputIterator>::value_type& y) {
+                       return m_key_compare(x.first, y.first);
+                   }));
+        apply_messages();
+        m_read_ahead_bids.clear();
+
+        const leaf_bid_type first_leaf = first_leaf_bid();
+        if (m_height > 2)
+        {
+            for (root_node_const_iterator_type it = m_root_node.begin();
+                 it != m_root_node.end(); ++it)
+            {
+                deallocate_nodes(it->second, m_height - 1);
+            }
         }
+
+        m_root_node.clear();
+        m_root_counts.clear();
+
+        m_size = 0;
+        m_height = 2;
+
+        merge_stream<InputIterator> input(this, first_leaf, b, e);
+        bulk_construction(input, node_fill_factor, leaf_fill_factor);
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
+    }
+
+    //! Replaces the contents by the elements of a stream sorted by key, for
+    //! example the output of stream::sort, with a bottom-up bulk construction
+    //! as by the range constructor with range_sorted = true. Of elements with
+    //! equal keys only the first is kept.
+    template <class StreamType>
+    void bulk_load(StreamType& input,
+                   double node_fill_factor = 0.75,
+                   double leaf_fill_factor = 0.6)
+    {
+        assert(!concurrent_reads());
+        m_messages.clear();
+        m_read_ahead_bids.clear();
+
+        deallocate_children();
+
+        m_root_node.clear();
+        m_root_counts.clear();
+
+        m_size = 0;
+        m_height = 2;
+
+        bulk_construction(input, node_fill_factor, leaf_fill_factor);
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
     }
 
     template <class InputIterator>
@@ -1010,7 +2639,11 @@ public:
             return;
         }
 
-        bulk_construction(begin, end, node_fill_factor, leaf_fill_factor);
+        if (!parallel_bulk_construction(begin, end, node_fill_factor, leaf_fill_factor))
+        {
+            range_stream<InputIterator> input(begin, end);
+            bulk_construction(input, node_fill_factor, leaf_fill_factor);
+        }
         assert(m_leaf_cache.nfixed() == 0);
         assert(m_node_cache.nfixed() == 0);
     }
@@ -1044,18 +2677,60 @@ public:
             return;
         }
 
-        bulk_construction(begin, end, node_fill_factor, leaf_fill_factor);
+        if (!parallel_bulk_construction(begin, end, node_fill_factor, leaf_fill_factor))
+        {
+            range_stream<InputIterator> input(begin, end);
+            bulk_construction(input, node_fill_factor, leaf_fill_factor);
+        }
         assert(m_leaf_cache.nfixed() == 0);
         assert(m_node_cache.nfixed() == 0);
     }
 
+    /*!
+     * Erase the elements in [first, last). The subtrees between the leaves of
+     * first and last are deleted as a whole and their blocks freed without
+     * reading them, only the nodes and leaves on the two boundary paths are
+     * read and fixed. Without subtree sizes in the nodes (see
+     * btree::delta_compression) the deleted leaves are read to count their
+     * elements. Iterators to erased elements are invalidated.
+     */
     void erase(iterator first, iterator last)
     {
+        assert(!concurrent_reads());
+        apply_messages();
+        if (first == last)
+            return;
         if (first == begin() && last == end())
+        {
             clear();
-        else
-            while (first != last)
-                erase(first++);
+            return;
+        }
+        check_pinned_levels();
+        m_read_ahead_bids.clear();
+
+        const key_type lower = first->first;
+        const key_type upper = (last == end()) ? m_key_compare.max_value() : last->first;
+
+        m_size -= erase_range(lower, upper);
+
+        // link the boundary leaves, which may have been distant
+        const leaf_bid_type first_bid = find_leaf_bid(lower);
+        const leaf_bid_type last_bid = find_leaf_bid(upper);
+        if (first_bid != last_bid)
+        {
+            m_leaf_cache.get_node(first_bid)->succ() = last_bid;
+            m_leaf_cache.get_node(last_bid)->pred() = first_bid;
+        }
+
+        // fixing one path may move the other, hence repeat until both stay
+        while (fix_path(lower) | fix_path(upper))
+        { }
+
+        while (m_root_node.size() == 1 && m_height > 2)
+            decrease_height();
+
+        assert(m_leaf_cache.nfixed() == 0);
+        assert(m_node_cache.nfixed() == 0);
     }
 
     key_compare key_comp() const
@@ -1070,6 +2745,7 @@ public:
     void swap(btree& obj)
     {
         std::swap(m_key_compare, obj.m_key_compare);   // OK
+        std::swap(m_storage, obj.m_storage);
 
         std::swap(m_node_cache, obj.m_node_cache);     // OK
         std::swap(m_leaf_cache, obj.m_leaf_cache);     // OK
@@ -1081,6 +2757,36 @@ public:
         std::swap(m_height, obj.m_height);
         std::swap(m_alloc_strategy, obj.m_alloc_strategy);
         std::swap(m_root_node, obj.m_root_node);
+        std::swap(m_root_counts, obj.m_root_counts);
+        std::swap(m_messages, obj.m_messages);
+        std::swap(m_max_messages, obj.m_max_messages);
+        std::swap(m_merge, obj.m_merge);
+        std::swap(m_concurrent_node_cache, obj.m_concurrent_node_cache);
+        std::swap(m_concurrent_leaf_cache, obj.m_concurrent_leaf_cache);
+        std::swap(m_pinned_levels, obj.m_pinned_levels);
+        std::swap(m_pinned_changes, obj.m_pinned_changes);
+        std::swap(m_read_ahead, obj.m_read_ahead);
+        std::swap(m_read_ahead_bids, obj.m_read_ahead_bids);
+        std::swap(m_read_ahead_last, obj.m_read_ahead_last);
+        std::swap(m_read_ahead_bound, obj.m_read_ahead_bound);
+    }
+
+    //! Writes all modified nodes and leaves and, if the tree is stored in a
+    //! file, the superblock, such that the file can be reopened.
+    void flush()
+    {
+        assert(!concurrent_reads());
+        apply_messages();
+        m_node_cache.flush();
+        m_leaf_cache.flush();
+        if (m_storage)
+            write_superblock();
+    }
+
+    //! The file the tree is stored in, or nullptr.
+    foxxll::file_ptr get_file() const
+    {
+        return m_storage ? m_storage->file() : foxxll::file_ptr();
     }
 
     void enable_prefetching()
@@ -1096,6 +2802,37 @@ public:
         return m_prefetching_enabled;
     }
 
+    /*!
+     * Keeps the nodes of the given number of levels below the root in the
+     * node cache, as far as it leaves room for other nodes, such that
+     * lookups in a tree of one level more only read a leaf, regardless of
+     * the accesses meanwhile. Nodes created or deleted by inserts and
+     * erases are accounted before the next lookup. The leaves have a cache
+     * of their own, hence scans do not evict nodes anyway.
+     */
+    void set_pinned_levels(unsigned levels)
+    {
+        m_pinned_levels = levels;
+        refresh_pinned_levels();
+    }
+    unsigned pinned_levels() const
+    {
+        return m_pinned_levels;
+    }
+
+    //! Sets the number of leaves read ahead of scanning iterators while
+    //! prefetching is enabled, at most a quarter of the leaf cache. With 1,
+    //! only the succ leaf of the current one is prefetched.
+    void set_read_ahead(size_t leaves)
+    {
+        m_read_ahead = std::max<size_t>(1, leaves);
+        m_read_ahead_bids.clear();
+    }
+    size_t read_ahead() const
+    {
+        return m_read_ahead;
+    }
+
     void print_statistics(std::ostream& o) const
     {
         o << "Node cache statistics:" << std::endl;
@@ -1115,13 +2852,15 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
 inline bool operator ==
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
 }
@@ -1131,13 +2870,15 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
 inline bool operator !=
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return !(a == b);
 }
@@ -1147,13 +2888,15 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
 inline bool operator <
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
 }
@@ -1163,13 +2906,15 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
 inline bool operator >
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return b < a;
 }
@@ -1179,13 +2924,15 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
 inline bool operator <=
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return !(b < a);
 }
@@ -1195,13 +2942,15 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
 inline bool operator >=
     (const btree<KeyType, DataType, KeyCompareWithMaxType,
-                 LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                 LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& a,
     const btree<KeyType, DataType, KeyCompareWithMaxType,
-                LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return !(a < b);
 }
@@ -1216,12 +2965,14 @@ template <class KeyType,
           class KeyCompareWithMaxType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
 void swap(stxxl::btree::btree<KeyType, DataType, KeyCompareWithMaxType,
-                              LogNodeSize, LogLeafSize, PDAllocStrategy>& a,
+                              LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& a,
           stxxl::btree::btree<KeyType, DataType, KeyCompareWithMaxType,
-                              LogNodeSize, LogLeafSize, PDAllocStrategy>& b)
+                              LogNodeSize, LogLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     if (&a != &b)
         a.swap(b);
@@ -0,0 +1,340 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/btree/compression.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_BTREE_COMPRESSION_HEADER
+#define STXXL_CONTAINERS_BTREE_COMPRESSION_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace stxxl {
+namespace btree {
+
+//! Variable-length encoding of unsigned integers, 7 bits per byte.
+struct varint
+{
+    //! maximum number of bytes of a value of type T
+    template <class T>
+    static constexpr size_t max_size()
+    {
+        return (std::numeric_limits<T>::digits + 6) / 7;
+    }
+
+    static size_t size(uint64_t x)
+    {
+        size_t n = 1;
+        while (x >= 0x80) {
+            x >>= 7;
+            ++n;
+        }
+        return n;
+    }
+
+    static uint8_t * encode(uint64_t x, uint8_t* out)
+    {
+        while (x >= 0x80) {
+            *out++ = static_cast<uint8_t>(x | 0x80);
+            x >>= 7;
+        }
+        *out++ = static_cast<uint8_t>(x);
+        return out;
+    }
+
+    static const uint8_t * decode(const uint8_t* in, uint64_t& x)
+    {
+        x = 0;
+        for (unsigned shift = 0; ; shift += 7) {
+            const uint8_t b = *in++;
+            x |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return in;
+        }
+    }
+
+    //! map signed differences to unsigned values, small magnitudes first
+    static uint64_t zigzag(int64_t d)
+    {
+        return (static_cast<uint64_t>(d) << 1) ^ static_cast<uint64_t>(d >> 63);
+    }
+
+    static int64_t unzigzag(uint64_t u)
+    {
+        return static_cast<int64_t>(u >> 1) ^ -static_cast<int64_t>(u & 1);
+    }
+};
+
+//! Field codec storing values as they are.
+template <class Type>
+struct raw_codec
+{
+    enum { min_size = sizeof(Type), max_size = sizeof(Type) };
+
+    static size_t size(const Type& /* prev */, const Type& /* x */)
+    {
+        return sizeof(Type);
+    }
+
+    static uint8_t * encode(const Type& /* prev */, const Type& x, uint8_t* out)
+    {
+        std::memcpy(out, &x, sizeof(Type));
+        return out + sizeof(Type);
+    }
+
+    static const uint8_t * decode(const Type& /* prev */, Type& x, const uint8_t* in)
+    {
+        std::memcpy(&x, in, sizeof(Type));
+        return in + sizeof(Type);
+    }
+};
+
+//! Field codec storing integral keys as zigzag-coded differences to the
+//! preceding key. The difference of two keys never encodes longer than the
+//! differences to a key between them, hence removing keys never makes a
+//! block longer.
+template <class KeyType>
+struct delta_key_codec
+{
+    static_assert(std::is_integral<KeyType>::value,
+                  "delta_compression requires integral keys");
+
+    using unsigned_type = typename std::make_unsigned<KeyType>::type;
+    using signed_type = typename std::make_signed<KeyType>::type;
+
+    enum { min_size = 1, max_size = varint::max_size<unsigned_type>() };
+
+    static uint64_t delta(const KeyType& prev, const KeyType& x)
+    {
+        const auto d = static_cast<signed_type>(
+            static_cast<unsigned_type>(static_cast<unsigned_type>(x) - static_cast<unsigned_type>(prev)));
+        return varint::zigzag(d);
+    }
+
+    static size_t size(const KeyType& prev, const KeyType& x)
+    {
+        return varint::size(delta(prev, x));
+    }
+
+    static uint8_t * encode(const KeyType& prev, const KeyType& x, uint8_t* out)
+    {
+        return varint::encode(delta(prev, x), out);
+    }
+
+    static const uint8_t * decode(const KeyType& prev, KeyType& x, const uint8_t* in)
+    {
+        uint64_t u;
+        in = varint::decode(in, u);
+        x = static_cast<KeyType>(static_cast<unsigned_type>(
+                                     static_cast<unsigned_type>(prev) + static_cast<unsigned_type>(varint::unzigzag(u))));
+        return in;
+    }
+};
+
+//! Field codec storing BIDs as differences of their offsets to the preceding
+//! BID; the file pointer is only stored where it changes, flagged by the
+//! lowest bit of the coded difference.
+template <class BidType>
+struct bid_codec
+{
+    using storage_type = decltype(BidType().storage);
+
+    enum {
+        min_size = 1,
+        max_size = varint::max_size<uint64_t>() + sizeof(storage_type)
+    };
+
+    static uint64_t delta(const BidType& prev, const BidType& x)
+    {
+        assert(x.offset < (uint64_t(1) << 62));
+        const int64_t d = static_cast<int64_t>(x.offset - prev.offset);
+        return (varint::zigzag(d) << 1) | (x.storage != prev.storage ? 1 : 0);
+    }
+
+    static size_t size(const BidType& prev, const BidType& x)
+    {
+        return varint::size(delta(prev, x))
+               + (x.storage != prev.storage ? sizeof(storage_type) : 0);
+    }
+
+    static uint8_t * encode(const BidType& prev, const BidType& x, uint8_t* out)
+    {
+        out = varint::encode(delta(prev, x), out);
+        if (x.storage != prev.storage) {
+            std::memcpy(out, &x.storage, sizeof(storage_type));
+            out += sizeof(storage_type);
+        }
+        return out;
+    }
+
+    static const uint8_t * decode(const BidType& prev, BidType& x, const uint8_t* in)
+    {
+        uint64_t u;
+        in = varint::decode(in, u);
+        x.offset = prev.offset + static_cast<uint64_t>(varint::unzigzag(u >> 1));
+        if (u & 1) {
+            std::memcpy(&x.storage, in, sizeof(storage_type));
+            in += sizeof(storage_type);
+        }
+        else
+            x.storage = prev.storage;
+        return in;
+    }
+};
+
+/*!
+ * Codec of the (key, data) pairs of a leaf or node, composed of a codec for
+ * each field. Each pair is coded relative to the preceding one, the first
+ * relative to a value-initialized pair.
+ */
+template <class ValueType, class KeyCodec, class DataCodec, bool Compressed = true>
+class pair_codec
+{
+public:
+    using value_type = ValueType;
+
+    //! whether blocks are stored encoded, otherwise their pairs are stored as
+    //! they are, and the codec is not used
+    static constexpr bool compressed = Compressed;
+
+    enum {
+        min_value_size = KeyCodec::min_size + DataCodec::min_size,
+        max_value_size = KeyCodec::max_size + DataCodec::max_size
+    };
+
+    //! encoded size of x following prev
+    template <class Prev, class Value>
+    static size_t value_size(const Prev& prev, const Value& x)
+    {
+        return KeyCodec::size(prev.first, x.first) + DataCodec::size(prev.second, x.second);
+    }
+
+    //! encoded size of x at the beginning of a block
+    template <class Value>
+    static size_t first_value_size(const Value& x)
+    {
+        return value_size(value_type(), x);
+    }
+
+    //! encoded size of [first, last)
+    template <class Iterator>
+    static size_t size(Iterator first, Iterator last)
+    {
+        size_t bytes = 0;
+        value_type prev = value_type();
+        for ( ; first != last; ++first) {
+            bytes += value_size(prev, *first);
+            prev = *first;
+        }
+        return bytes;
+    }
+
+    /*!
+     * Position to split [first, last) at, such that the encoded sizes of both
+     * parts are as equal as possible. Both parts are non-empty if there are
+     * at least two values.
+     */
+    template <class Iterator>
+    static size_t split_point(Iterator first, Iterator last)
+    {
+        const size_t n = static_cast<size_t>(last - first);
+        assert(n >= 2);
+
+        // sizes of the values, each following its predecessor
+        std::vector<size_t> sizes(n);
+        sizes[0] = first_value_size(first[0]);
+        for (size_t i = 1; i < n; ++i)
+            sizes[i] = value_size(first[i - 1], first[i]);
+
+        size_t total = 0;
+        for (size_t i = 0; i < n; ++i)
+            total += sizes[i];
+
+        size_t best = 1, best_max = std::numeric_limits<size_t>::max();
+        size_t left = sizes[0];
+        for (size_t s = 1; s < n; ++s)
+        {
+            // the right part begins with a value coded on its own
+            const size_t right = total - left - sizes[s] + first_value_size(first[s]);
+            const size_t larger = std::max(left, right);
+            if (larger < best_max) {
+                best = s;
+                best_max = larger;
+            }
+            left += sizes[s];
+        }
+        return best;
+    }
+
+    template <class Iterator>
+    static uint8_t * encode(Iterator first, Iterator last, uint8_t* out)
+    {
+        value_type prev = value_type();
+        for ( ; first != last; ++first) {
+            out = KeyCodec::encode(prev.first, first->first, out);
+            out = DataCodec::encode(prev.second, first->second, out);
+            prev = *first;
+        }
+        return out;
+    }
+
+    static const uint8_t * decode(const uint8_t* in, value_type* first, value_type* last)
+    {
+        value_type prev = value_type();
+        for ( ; first != last; ++first) {
+            in = KeyCodec::decode(prev.first, first->first, in);
+            in = DataCodec::decode(prev.second, first->second, in);
+            prev = *first;
+        }
+        return in;
+    }
+};
+
+//! Layout policy of leaves and nodes: the pairs are stored as they are. The
+//! default.
+struct no_compression
+{
+    template <class KeyType, class DataType>
+    using leaf_codec = pair_codec<std::pair<KeyType, DataType>,
+                                  raw_codec<KeyType>, raw_codec<DataType>, false>;
+
+    template <class KeyType, class BidType>
+    using node_codec = pair_codec<std::pair<KeyType, BidType>,
+                                  raw_codec<KeyType>, raw_codec<BidType>, false>;
+};
+
+/*!
+ * Layout policy of leaves and nodes for integral keys: the keys of a leaf and
+ * the child BIDs of a node are delta-coded into variable-length integers,
+ * which for dense or sequential keys multiplies the number of values per
+ * block. Leaves and nodes are decoded when read and encoded when written,
+ * and are split, balanced and fused by their encoded size. The keys of nodes
+ * are stored as they are, since they are replaced in place when nodes are
+ * balanced.
+ */
+struct delta_compression
+{
+    template <class KeyType, class DataType>
+    using leaf_codec = pair_codec<std::pair<KeyType, DataType>,
+                                  delta_key_codec<KeyType>, raw_codec<DataType> >;
+
+    template <class KeyType, class BidType>
+    using node_codec = pair_codec<std::pair<KeyType, BidType>,
+                                  raw_codec<KeyType>, bid_codec<BidType> >;
+};
+
+} // namespace btree
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_BTREE_COMPRESSION_HEADER
@@ -0,0 +1,287 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/btree/file_storage.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_BTREE_FILE_STORAGE_HEADER
+#define STXXL_CONTAINERS_BTREE_FILE_STORAGE_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/utils.hpp>
+#include <foxxll/io/file.hpp>
+#include <foxxll/mng/typed_block.hpp>
+
+namespace stxxl {
+namespace btree {
+
+/*!
+ * Storage of a btree in a single file, which allows to reopen it: the blocks
+ * of the nodes and leaves are allocated in the file, freed blocks are kept in
+ * free lists for reuse, and a superblock records where the tree is.
+ *
+ * The superblock consists of a header at the beginning of the file and of
+ * metadata of variable length, the root node's entries and the free lists,
+ * which is written after the last block of the tree. Reading both takes two
+ * I/Os, independent of the size of the tree.
+ */
+class file_storage
+{
+    static constexpr bool debug = false;
+
+public:
+    //! bytes of the header, and unit of the metadata
+    enum { superblock_size = 4096 };
+
+    using superblock_type = foxxll::typed_block<superblock_size, uint8_t>;
+    using superblock_bid_type = foxxll::BID<superblock_size>;
+
+    //! header of the superblock, at offset 0 of the file
+    struct header_type
+    {
+        uint64_t magic;
+        uint64_t version;
+        //! layout of the tree's blocks, checked when the file is reopened
+        uint64_t node_size, leaf_size;
+        uint64_t key_size, data_size;
+        uint64_t compressed;
+        //! number of elements and height of the tree
+        uint64_t size, height;
+        //! end of the blocks, where the metadata begins
+        uint64_t end;
+        //! bytes of the metadata
+        uint64_t meta_bytes;
+    };
+
+    static constexpr uint64_t magic = 0x3145455254425853ull; // "SXBTREE1"
+    //! version 2 added the subtree sizes of the node entries
+    static constexpr uint64_t version = 2;
+
+    //! Serialized metadata of the superblock.
+    class metadata_type
+    {
+        std::vector<uint8_t> m_bytes;
+        size_t m_pos { 0 };
+
+    public:
+        metadata_type() = default;
+
+        explicit metadata_type(std::vector<uint8_t>&& bytes)
+            : m_bytes(std::move(bytes)) { }
+
+        const std::vector<uint8_t>& bytes() const { return m_bytes; }
+
+        template <class Type>
+        void put(const Type& x)
+        {
+            static_assert(std::is_trivially_copyable<Type>::value,
+                          "the superblock stores trivially copyable types only");
+            const size_t pos = m_bytes.size();
+            m_bytes.resize(pos + sizeof(Type));
+            std::memcpy(m_bytes.data() + pos, &x, sizeof(Type));
+        }
+
+        template <class Type>
+        Type get()
+        {
+            if (m_pos + sizeof(Type) > m_bytes.size())
+                FOXXLL_THROW2(std::runtime_error, "btree::file_storage",
+                              "The metadata of the superblock is truncated.");
+            Type x;
+            std::memcpy(&x, m_bytes.data() + m_pos, sizeof(Type));
+            m_pos += sizeof(Type);
+            return x;
+        }
+    };
+
+private:
+    foxxll::file_ptr m_file;
+    //! end of the allocated blocks
+    uint64_t m_end;
+    //! size the file was last set to, it grows by doubling
+    uint64_t m_capacity;
+    //! offsets of freed blocks, by block size
+    std::map<uint64_t, std::vector<uint64_t> > m_free;
+
+    void reserve(uint64_t end)
+    {
+        if (end <= m_capacity)
+            return;
+        m_capacity = std::max(end, 2 * m_capacity);
+        TLX_LOG << "btree::file_storage growing file to " << m_capacity;
+        m_file->set_size(m_capacity);
+    }
+
+public:
+    explicit file_storage(foxxll::file_ptr file)
+        : m_file(std::move(file)),
+          m_end(superblock_size),
+          m_capacity(m_file->size())
+    { }
+
+    //! non-copyable: delete copy-constructor
+    file_storage(const file_storage&) = delete;
+    //! non-copyable: delete assignment operator
+    file_storage& operator = (const file_storage&) = delete;
+
+    const foxxll::file_ptr& file() const { return m_file; }
+
+    //! whether the file holds a tree, i.e. is not empty
+    bool has_superblock() const { return m_file->size() > 0; }
+
+    template <class BidType>
+    void new_block(BidType& bid)
+    {
+        std::vector<uint64_t>& free = m_free[uint64_t(BidType::size)];
+        bid.storage = m_file.get();
+        if (!free.empty())
+        {
+            bid.offset = free.back();
+            free.pop_back();
+            return;
+        }
+        bid.offset = m_end;
+        m_end += BidType::size;
+        reserve(m_end);
+    }
+
+    template <class BidType>
+    void delete_block(const BidType& bid)
+    {
+        assert(bid.storage == m_file.get());
+        m_free[uint64_t(BidType::size)].push_back(bid.offset);
+    }
+
+    //! Writes the free lists to the metadata.
+    void put_free_lists(metadata_type& meta) const
+    {
+        meta.put<uint64_t>(m_free.size());
+        for (const auto& list : m_free)
+        {
+            meta.put<uint64_t>(list.first);
+            meta.put<uint64_t>(list.second.size());
+            for (const uint64_t& offset : list.second)
+                meta.put(offset);
+        }
+    }
+
+    //! Reads the free lists from the metadata.
+    void get_free_lists(metadata_type& meta)
+    {
+        m_free.clear();
+        const auto nlists = meta.get<uint64_t>();
+        for (uint64_t i = 0; i < nlists; ++i)
+        {
+            std::vector<uint64_t>& free = m_free[meta.get<uint64_t>()];
+            free.resize(meta.get<uint64_t>());
+            for (uint64_t& offset : free)
+                offset = meta.get<uint64_t>();
+        }
+    }
+
+    /*!
+     * Writes the superblock: first the metadata after the last block, then
+     * the header, which points to it. Sets the header's end and meta_bytes,
+     * and truncates the file after the metadata.
+     */
+    void write_superblock(header_type header, const metadata_type& meta)
+    {
+        const std::vector<uint8_t>& bytes = meta.bytes();
+        const size_t nblocks = foxxll::div_ceil(bytes.size(), size_t(superblock_size));
+
+        header.end = m_end;
+        header.meta_bytes = bytes.size();
+
+        std::unique_ptr<superblock_type[]> blocks(new superblock_type[nblocks + 1]);
+        std::memset(blocks[0].begin(), 0, superblock_size);
+        std::memcpy(blocks[0].begin(), &header, sizeof(header));
+        for (size_t i = 0; i < nblocks; ++i)
+        {
+            const size_t pos = i * superblock_size;
+            const size_t n = std::min(bytes.size() - pos, size_t(superblock_size));
+            std::memcpy(blocks[i + 1].begin(), bytes.data() + pos, n);
+        }
+
+        reserve(m_end + nblocks * superblock_size);
+
+        std::vector<foxxll::request_ptr> reqs(nblocks);
+        for (size_t i = 0; i < nblocks; ++i)
+        {
+            reqs[i] = blocks[i + 1].write(
+                superblock_bid_type(m_file.get(), m_end + i * superblock_size));
+        }
+        for (foxxll::request_ptr& req : reqs)
+            req->wait();
+
+        blocks[0].write(superblock_bid_type(m_file.get(), 0))->wait();
+
+        m_capacity = m_end + nblocks * superblock_size;
+        m_file->set_size(m_capacity);
+
+        TLX_LOG << "btree::file_storage wrote superblock, end=" << m_end
+                << " meta_bytes=" << bytes.size();
+    }
+
+    //! Reads the superblock, the blocks are allocated after its end.
+    std::pair<header_type, metadata_type> read_superblock()
+    {
+        std::unique_ptr<superblock_type> block(new superblock_type);
+        block->read(superblock_bid_type(m_file.get(), 0))->wait();
+
+        header_type header;
+        std::memcpy(&header, block->begin(), sizeof(header));
+        if (header.magic != magic || header.version != version)
+        {
+            FOXXLL_THROW2(std::runtime_error, "btree::file_storage",
+                          "The file does not contain a btree.");
+        }
+
+        const size_t nblocks = foxxll::div_ceil(header.meta_bytes, size_t(superblock_size));
+        std::unique_ptr<superblock_type[]> blocks(new superblock_type[nblocks]);
+        std::vector<foxxll::request_ptr> reqs(nblocks);
+        for (size_t i = 0; i < nblocks; ++i)
+        {
+            reqs[i] = blocks[i].read(
+                superblock_bid_type(m_file.get(), header.end + i * superblock_size));
+        }
+
+        std::vector<uint8_t> bytes(header.meta_bytes);
+        for (size_t i = 0; i < nblocks; ++i)
+        {
+            reqs[i]->wait();
+            const size_t pos = i * superblock_size;
+            const size_t n = std::min(bytes.size() - pos, size_t(superblock_size));
+            std::memcpy(bytes.data() + pos, blocks[i].begin(), n);
+        }
+
+        // blocks allocated from now on overwrite the metadata
+        m_end = header.end;
+
+        TLX_LOG << "btree::file_storage read superblock, end=" << m_end
+                << " meta_bytes=" << header.meta_bytes;
+
+        return std::make_pair(header, metadata_type(std::move(bytes)));
+    }
+};
+
+} // namespace btree
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_BTREE_FILE_STORAGE_HEADER
@@ -29,8 +29,10 @@ template <class BTreeType>
 class btree_iterator;
 template <class BTreeType>
 class btree_const_iterator;
+template <class BTreeType>
+class btree_snapshot_iterator;
 template <class KeyType, class DataType, class KeyCmp,
-          unsigned LogNElem, class BTreeType>
+          unsigned LogNElem, class BTreeType, class Compression>
 class normal_leaf;
 
 template <class BTreeType>
@@ -50,8 +52,9 @@ public:
     using leaf_type = typename btree_type::leaf_type;
 
     friend class iterator_map<btree_type>;
+    friend class btree_snapshot_iterator<btree_type>;
     template <class KeyType, class DataType,
-              class KeyCmp, unsigned LogNElem, class AnyBTreeType>
+              class KeyCmp, unsigned LogNElem, class AnyBTreeType, class Compression>
     friend class normal_leaf;
 
     template <class AnyBTreeType>
@@ -185,7 +188,7 @@ public:
     using base_type = btree_iterator_base<btree_type>;
 
     template <class KeyType, class DataType,
-              class KeyCmp, unsigned LogNElem, class AnyBTreeType>
+              class KeyCmp, unsigned LogNElem, class AnyBTreeType, class Compression>
     friend class normal_leaf;
 
     using base_type::non_const_access;
@@ -275,7 +278,7 @@ public:
     using base_type = btree_iterator_base<btree_type>;
 
     template <class KeyType, class DataType,
-              class KeyCmp, unsigned LogNElem, class AnyBTreeType>
+              class KeyCmp, unsigned LogNElem, class AnyBTreeType, class Compression>
     friend class normal_leaf;
 
     using base_type::const_access;
@@ -378,6 +381,82 @@ inline bool operator != (const btree_iterator<BTreeType>& a,
     return a.btree_iterator_base<BTreeType>::operator != (b);
 }
 
+/*!
+ * Read-only iterator that is not registered with the iterator_map of the
+ * btree, hence constructing, copying and advancing it costs no bookkeeping.
+ * It is not fixed by modifications either: it is valid only until the next
+ * modification of the btree. Meant for scans, see btree::snapshot_range().
+ */
+template <class BTreeType>
+class btree_snapshot_iterator
+{
+public:
+    using btree_type = BTreeType;
+    using bid_type = typename btree_type::leaf_bid_type;
+    using value_type = typename btree_type::value_type;
+    using reference = typename btree_type::const_reference;
+    using pointer = typename btree_type::const_pointer;
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = typename btree_type::difference_type;
+
+    using leaf_type = typename btree_type::leaf_type;
+
+    btree_snapshot_iterator()
+        : btree(nullptr), pos(0)
+    { }
+
+    //! Snapshot of the position of a registered iterator.
+    explicit btree_snapshot_iterator(const btree_iterator_base<btree_type>& it)
+        : btree(it.btree), bid(it.bid), pos(it.pos)
+    { }
+
+    reference operator * () const
+    {
+        assert(btree);
+        leaf_type const* leaf = btree->m_leaf_cache.get_const_node(bid);
+        assert(leaf);
+        return reinterpret_cast<reference>((*leaf)[pos]);
+    }
+
+    pointer operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    bool operator == (const btree_snapshot_iterator& obj) const
+    {
+        return bid == obj.bid && pos == obj.pos && btree == obj.btree;
+    }
+
+    bool operator != (const btree_snapshot_iterator& obj) const
+    {
+        return !(*this == obj);
+    }
+
+    btree_snapshot_iterator& operator ++ ()
+    {
+        assert(btree);
+        const bid_type cur_bid = bid;
+        const leaf_type* leaf = btree->m_leaf_cache.get_const_node(cur_bid, true);
+        assert(leaf);
+        leaf->increment_position(bid, pos);
+        btree->m_leaf_cache.unfix_node(cur_bid);
+        return *this;
+    }
+
+    btree_snapshot_iterator operator ++ (int)
+    {
+        btree_snapshot_iterator result(*this);
+        ++(*this);
+        return result;
+    }
+
+private:
+    btree_type* btree;
+    bid_type bid;
+    size_t pos;
+};
+
 } // namespace btree
 } // namespace stxxl
 
@@ -14,12 +14,19 @@
 #define STXXL_CONTAINERS_BTREE_LEAF_HEADER
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include <stxxl/bits/common/locked_memory.h>
+#include <stxxl/bits/common/trace.h>
+#include <stxxl/bits/containers/btree/compression.h>
 #include <stxxl/bits/containers/btree/iterator.h>
 #include <stxxl/bits/containers/btree/node_cache.h>
+#include <stxxl/bits/containers/btree/search.h>
 
 namespace stxxl {
 namespace btree {
@@ -27,19 +34,21 @@ namespace btree {
 template <class NodeType, class BTreeType>
 class node_cache;
 
-template <class KeyType, class DataType, class KeyCompareWithMax, unsigned RawSize, class BTreeType>
+template <class KeyType, class DataType, class KeyCompareWithMax, unsigned RawSize, class BTreeType,
+          class Compression>
 class normal_leaf
 {
     static constexpr bool debug = false;
 
 public:
-    using self_type = normal_leaf<KeyType, DataType, KeyCompareWithMax, RawSize, BTreeType>;
+    using self_type = normal_leaf<KeyType, DataType, KeyCompareWithMax, RawSize, BTreeType, Compression>;
 
     friend class node_cache<self_type, BTreeType>;
 
     using key_type = KeyType;
     using data_type = DataType;
     using key_compare = KeyCompareWithMax;
+    using key_search_type = key_search<key_type, key_compare>;
     using value_type = std::pair<key_type, data_type>;
     using reference = value_type &;
     using const_reference = const value_type &;
@@ -56,13 +65,37 @@ public:
         unsigned cur_size;
     };
 
-    using block_type = foxxll::typed_block<raw_size, value_type, 0, metainfo_type>;
+    using codec_type = typename Compression::template leaf_codec<key_type, data_type>;
+    //! whether the leaf is stored encoded, see compression.h
+    static constexpr bool compressed = codec_type::compressed;
+
+    using plain_block_type = foxxll::typed_block<raw_size, value_type, 0, metainfo_type>;
     enum {
-        nelements = block_type::size - 1,
+        //! bytes of an encoded leaf available for the values
+        payload_size = raw_size - sizeof(metainfo_type),
+        //! an encoded leaf with fewer bytes underflows
+        min_payload_size = payload_size / 2 - 3 * codec_type::max_value_size,
+        nelements = compressed
+                    ? payload_size / codec_type::min_value_size
+                    : plain_block_type::size - 1,
         max_size = nelements,
-        min_size = nelements / 2
+        min_size = compressed
+                   ? min_payload_size / codec_type::max_value_size
+                   : nelements / 2,
+        //! an encoded leaf is decoded into a larger block in internal memory
+        block_raw_size = compressed
+                         ? (sizeof(metainfo_type) + (nelements + 1) * sizeof(value_type)
+                            + raw_size - 1) / raw_size * raw_size
+                         : raw_size
     };
 
+    static_assert(!compressed || payload_size >= 8 * codec_type::max_value_size,
+                  "leaf too small for its encoded values");
+
+    using block_type = foxxll::typed_block<block_raw_size, value_type, 0, metainfo_type>;
+    //! encoded leaf as stored in external memory
+    using disk_block_type = foxxll::typed_block<raw_size, uint8_t>;
+
     using btree_type = BTreeType;
     using size_type = typename btree_type::size_type;
     using iterator_base = btree_iterator_base<btree_type>;
@@ -86,6 +119,10 @@ public:
 
 private:
     block_type* m_block;
+    //! encoded leaf, if compressed
+    disk_block_type* m_disk_block;
+    //! whether m_disk_block was read by prefetch() but not yet decoded
+    bool m_encoded;
     btree_type* m_btree;
 
     key_compare m_cmp;
@@ -93,6 +130,9 @@ private:
 
     void split(std::pair<key_type, bid_type>& splitter)
     {
+        STXXL_TRACE_SPAN(span, "btree::split_leaf");
+        span.add_bytes(block_type::raw_size);
+
         bid_type new_bid;
         m_btree->m_leaf_cache.get_new_node(new_bid);                         // new (left) leaf
         normal_leaf* new_leaf = m_btree->m_leaf_cache.get_node(new_bid, true);
@@ -115,7 +155,9 @@ private:
         iterators2fix_type iterators2fix;
         m_btree->m_iterator_map.find(my_bid(), 0, size(), iterators2fix);
 
-        const unsigned end_of_smaller_part = size() / 2;
+        const unsigned end_of_smaller_part = compressed
+                                             ? unsigned(codec_type::split_point(m_block->begin(), m_block->begin() + size()))
+                                             : size() / 2;
 
         splitter.first = ((*m_block)[end_of_smaller_part - 1]).first;
         splitter.second = new_bid;
@@ -152,16 +194,21 @@ private:
 public:
     virtual ~normal_leaf()
     {
+        unlock_blocks(m_block);
         delete m_block;
+        delete m_disk_block;
     }
 
     normal_leaf(btree_type* btree,
                 key_compare cmp)
         : m_block(new block_type),
+          m_disk_block(compressed ? new disk_block_type : nullptr),
+          m_encoded(false),
           m_btree(btree),
           m_cmp(cmp),
           m_vcmp(cmp)
     {
+        lock_blocks(m_block);
         assert(min_nelements() >= 2);
         assert(2 * min_nelements() - 1 <= max_nelements());
         assert(max_nelements() <= nelements);
@@ -173,12 +220,39 @@ public:
     //! non-copyable: delete assignment operator
     normal_leaf& operator = (const normal_leaf&) = delete;
 
-    bool overflows() const { return m_block->info.cur_size > max_nelements(); }
-    bool underflows() const { return m_block->info.cur_size < min_nelements(); }
+    bool overflows() const
+    {
+        if (compressed)
+            return bytes() > payload_size;
+        return m_block->info.cur_size > max_nelements();
+    }
+    bool underflows() const
+    {
+        if (compressed)
+            return bytes() < min_payload_size;
+        return m_block->info.cur_size < min_nelements();
+    }
 
     static unsigned max_nelements() { return max_size; }
     static unsigned min_nelements() { return min_size; }
 
+    //! Number of bytes of the encoded values.
+    size_t bytes() const
+    {
+        return codec_type::size(m_block->begin(), m_block->begin() + size());
+    }
+
+    //! Whether the values of left and *this fit into one leaf.
+    bool can_fuse(const normal_leaf& left) const
+    {
+        if (left.size() + size() > max_nelements())
+            return false;
+        if (!compressed || left.size() == 0 || size() == 0)
+            return true;
+        return left.bytes() + bytes() - codec_type::first_value_size(front())
+               + codec_type::value_size(left.back(), front()) <= payload_size;
+    }
+
     bid_type & succ()
     {
         return m_block->info.succ;
@@ -226,6 +300,12 @@ public:
         return m_block->info.cur_size;
     }
 
+    //! Number of elements below the leaf's entry in its parent node.
+    size_type subtree_size() const
+    {
+        return size();
+    }
+
     const bid_type & my_bid() const
     {
         return m_block->info.me;
@@ -233,26 +313,42 @@ public:
 
     void save()
     {
-        foxxll::request_ptr req = m_block->write(my_bid());
+        foxxll::request_ptr req = flush();
         req->wait();
     }
 
+    //! Asynchronous save().
+    foxxll::request_ptr flush()
+    {
+        return write(compressed_tag());
+    }
+
     foxxll::request_ptr load(const bid_type& bid)
     {
-        foxxll::request_ptr req = m_block->read(bid);
+        foxxll::request_ptr req = read(bid, compressed_tag());
         req->wait();
+        finish_read();
         assert(bid == my_bid());
         return req;
     }
 
     foxxll::request_ptr prefetch(const bid_type& bid)
     {
-        return m_block->read(bid);
+        return read(bid, compressed_tag());
+    }
+
+    //! Complete a read issued by prefetch(), called by the cache after
+    //! waiting for it.
+    void finish_read()
+    {
+        if (m_encoded)
+            decode();
     }
 
     void init(const bid_type& my_bid_)
     {
         m_block->info.me = my_bid_;
+        m_encoded = false;
         m_block->info.succ = bid_type();
         m_block->info.pred = bid_type();
         m_block->info.cur_size = 0;
@@ -303,7 +399,7 @@ public:
         splitter.first = m_cmp.max_value();
 
         typename block_type::iterator it =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), x, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), x.first, m_cmp);
 
         if (!(m_vcmp(*it, x) || m_vcmp(x, *it)) && it != (m_block->begin() + size()))                    // *it == x
         {
@@ -335,7 +431,7 @@ public:
 
         std::pair<iterator, bool> result(iterator(m_btree, my_bid(), unsigned(it - m_block->begin())), true);
 
-        if (size() <= max_nelements())
+        if (!overflows())
         {
             // no overflow
             dump();
@@ -364,28 +460,33 @@ public:
         return iterator(m_btree, my_bid(), size());
     }
 
-    void increment_iterator(iterator_base& it) const
+    //! Advances the position pos in the leaf, moving to the succ leaf at its
+    //! end, see increment_iterator().
+    void increment_position(bid_type& bid, size_t& pos) const
     {
-        assert(it.bid == my_bid());
-        assert(it.pos != size());
-
-        m_btree->m_iterator_map.unregister_iterator(it);
+        assert(bid == my_bid());
+        assert(pos != size());
 
-        ++(it.pos);
-        if (it.pos == size() && succ().valid())
+        ++pos;
+        if (pos == size() && succ().valid())
         {
             // run to the end of the leaf
             TLX_LOG << "btree::normal_leaf jumping to the next block";
-            it.pos = 0;
-            it.bid = succ();
+            pos = 0;
+            bid = succ();
         }
         // increment of pos from 0 to 1
-        else if (it.pos == 1 && m_btree->m_prefetching_enabled)
+        else if (pos == 1 && m_btree->m_prefetching_enabled)
         {
-            // prefetch the succ leaf
-            if (succ().valid())
-                m_btree->m_leaf_cache.prefetch_node(succ());
+            // prefetch the succ leaves
+            m_btree->read_ahead_of(*this);
         }
+    }
+
+    void increment_iterator(iterator_base& it) const
+    {
+        m_btree->m_iterator_map.unregister_iterator(it);
+        increment_position(it.bid, it.pos);
         m_btree->m_iterator_map.register_iterator(it);
     }
 
@@ -420,7 +521,7 @@ public:
     {
         value_type search_val(k, data_type());
         typename block_type::iterator lb =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), search_val, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), search_val.first, m_cmp);
         if (lb == m_block->begin() + size() || !(lb->first == k))
             return m_btree->end();
 
@@ -431,7 +532,7 @@ public:
     {
         value_type search_val(k, data_type());
         typename block_type::iterator lb =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), search_val, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), search_val.first, m_cmp);
         if (lb == m_block->begin() + size() || !(lb->first == k))
             return m_btree->end();
 
@@ -443,7 +544,7 @@ public:
         value_type search_val(k, data_type());
 
         typename block_type::iterator lb =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), search_val, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), search_val.first, m_cmp);
 
         // lower_bound is in the succ block
         if (lb == m_block->begin() + size() && succ().valid())
@@ -458,7 +559,7 @@ public:
     {
         value_type search_val(k, data_type());
         typename block_type::iterator lb =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), search_val, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), search_val.first, m_cmp);
 
         // lower_bound is in the succ block
         if (lb == m_block->begin() + size() && succ().valid())
@@ -469,11 +570,32 @@ public:
         return const_iterator(m_btree, my_bid(), unsigned(lb - m_block->begin()));
     }
 
+    //! Number of values with keys less than k.
+    unsigned rank(const key_type& k) const
+    {
+        typename block_type::iterator lb =
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), k, m_cmp);
+        return unsigned(lb - m_block->begin());
+    }
+
+    //! Iterator to the value at position pos.
+    iterator at(unsigned pos)
+    {
+        assert(pos < size());
+        return iterator(m_btree, my_bid(), pos);
+    }
+
+    const_iterator at(unsigned pos) const
+    {
+        assert(pos < size());
+        return const_iterator(m_btree, my_bid(), pos);
+    }
+
     iterator upper_bound(const key_type& k)
     {
         value_type search_val(k, data_type());
         typename block_type::iterator lb =
-            std::upper_bound(m_block->begin(), m_block->begin() + size(), search_val, m_vcmp);
+            key_search_type::upper_bound(m_block->begin(), m_block->begin() + size(), search_val.first, m_cmp);
 
         // upper_bound is in the succ block
         if (lb == m_block->begin() + size() && succ().valid())
@@ -488,7 +610,7 @@ public:
     {
         value_type search_val(k, data_type());
         typename block_type::iterator lb =
-            std::upper_bound(m_block->begin(), m_block->begin() + size(), search_val, m_vcmp);
+            key_search_type::upper_bound(m_block->begin(), m_block->begin() + size(), search_val.first, m_cmp);
 
         // upper_bound is in the succ block
         if (lb == m_block->begin() + size() && succ().valid())
@@ -503,7 +625,7 @@ public:
     {
         value_type search_val(k, data_type());
         typename block_type::iterator it =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), search_val, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), search_val.first, m_cmp);
 
         if (it == m_block->begin() + size() || !(it->first == k))
             return 0;
@@ -528,10 +650,50 @@ public:
         return 1;
     }
 
+    //! Erases the elements with keys in [lower, upper) and returns their
+    //! number. Iterators behind them are moved left, iterators to them point
+    //! to the first element behind them afterwards.
+    size_type erase_range(const key_type& lower, const key_type& upper)
+    {
+        typename block_type::iterator begin = m_block->begin();
+        typename block_type::iterator first =
+            key_search_type::lower_bound(begin, begin + size(), lower, m_cmp);
+        typename block_type::iterator last =
+            key_search_type::lower_bound(first, begin + size(), upper, m_cmp);
+
+        const unsigned first_pos = unsigned(first - begin);
+        const unsigned last_pos = unsigned(last - begin);
+        const unsigned n = last_pos - first_pos;
+        if (n == 0)
+            return 0;
+
+        // move elements n positions left
+        std::copy(last, begin + size(), first);
+
+        std::vector<iterator_base*> iterators2fix;
+        m_btree->m_iterator_map.find(my_bid(), first_pos + 1, size(), iterators2fix);
+        typename std::vector<iterator_base*>::iterator it2fix = iterators2fix.begin();
+        for ( ; it2fix != iterators2fix.end(); ++it2fix)
+        {
+            TLX_LOG << "btree::normal_leaf updating iterator " << (*it2fix) << " (pos-" << n << ")";
+            m_btree->m_iterator_map.unregister_iterator(**it2fix);
+            if ((*it2fix)->pos < last_pos)
+                (*it2fix)->pos = first_pos;
+            else
+                (*it2fix)->pos -= n;                   // fixing iterators
+            m_btree->m_iterator_map.register_iterator(**it2fix);
+        }
+
+        m_block->info.cur_size -= n;
+
+        return n;
+    }
+
     void fuse(const normal_leaf& src)
     {
         TLX_LOG << "btree::normal_leaf Fusing";
-        assert(m_vcmp(src.back(), front()));
+        // a range erase may leave either leaf empty
+        assert(src.size() == 0 || size() == 0 || m_vcmp(src.back(), front()));
         const unsigned src_size = src.size();
 
         typename block_type::iterator cur = m_block->begin() + size() - 1;
@@ -584,7 +746,7 @@ public:
         TLX_LOG << "btree::normal_leaf Balancing leaves with bids " <<
             left.my_bid() << " and " << my_bid();
         const unsigned total_size = left.size() + size();
-        unsigned new_left_size = total_size / 2;
+        unsigned new_left_size = compressed ? balance_point(left) : total_size / 2;
         assert(new_left_size <= left.max_nelements());
         assert(new_left_size >= left.min_nelements());
         unsigned new_right_size = total_size - new_left_size;
@@ -686,6 +848,58 @@ public:
         (*this)[size()] = x;
         ++(m_block->info.cur_size);
     }
+
+private:
+    using compressed_tag = std::integral_constant<bool, compressed>;
+
+    foxxll::request_ptr write(std::false_type)
+    {
+        return m_block->write(my_bid());
+    }
+
+    foxxll::request_ptr write(std::true_type)
+    {
+        encode();
+        return m_disk_block->write(my_bid());
+    }
+
+    foxxll::request_ptr read(const bid_type& bid, std::false_type)
+    {
+        return m_block->read(bid);
+    }
+
+    foxxll::request_ptr read(const bid_type& bid, std::true_type)
+    {
+        m_encoded = true;
+        return m_disk_block->read(bid);
+    }
+
+    //! Size of left after balancing: the encoded values of left and *this are
+    //! split in halves.
+    unsigned balance_point(const normal_leaf& left) const
+    {
+        std::vector<value_type> values(left.m_block->begin(), left.m_block->begin() + left.size());
+        values.insert(values.end(), m_block->begin(), m_block->begin() + size());
+        return unsigned(codec_type::split_point(values.begin(), values.end()));
+    }
+
+    void encode()
+    {
+        assert(!overflows());
+        uint8_t* out = m_disk_block->begin();
+        std::memcpy(out, &m_block->info, sizeof(metainfo_type));
+        codec_type::encode(m_block->begin(), m_block->begin() + size(),
+                           out + sizeof(metainfo_type));
+    }
+
+    void decode()
+    {
+        const uint8_t* in = m_disk_block->begin();
+        std::memcpy(&m_block->info, in, sizeof(metainfo_type));
+        codec_type::decode(in + sizeof(metainfo_type),
+                           m_block->begin(), m_block->begin() + size());
+        m_encoded = false;
+    }
 };
 
 } // namespace btree
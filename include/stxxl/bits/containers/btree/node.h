@@ -14,11 +14,21 @@
 #define STXXL_CONTAINERS_BTREE_NODE_HEADER
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <numeric>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
+#include <stxxl/bits/common/locked_memory.h>
+#include <stxxl/bits/common/trace.h>
+#include <stxxl/bits/containers/btree/compression.h>
 #include <stxxl/bits/containers/btree/iterator.h>
 #include <stxxl/bits/containers/btree/node_cache.h>
+#include <stxxl/bits/containers/btree/search.h>
+#include <stxxl/types>
 
 namespace stxxl {
 namespace btree {
@@ -26,18 +36,20 @@ namespace btree {
 template <class NodeType, class BTreeType>
 class node_cache;
 
-template <class KeyType, class KeyCompareWithMax, unsigned RawSize, class BTreeType>
+template <class KeyType, class KeyCompareWithMax, unsigned RawSize, class BTreeType,
+          class Compression>
 class normal_node
 {
     static constexpr bool debug = false;
 
 public:
-    using self_type = normal_node<KeyType, KeyCompareWithMax, RawSize, BTreeType>;
+    using self_type = normal_node<KeyType, KeyCompareWithMax, RawSize, BTreeType, Compression>;
 
     friend class node_cache<self_type, BTreeType>;
 
     using key_type = KeyType;
     using key_compare = KeyCompareWithMax;
+    using key_search_type = key_search<key_type, key_compare>;
 
     enum {
         raw_size = RawSize
@@ -49,18 +61,60 @@ public:
     using reference = value_type &;
     using const_reference = const value_type &;
 
-    struct metainfo_type
+    using codec_type = typename Compression::template node_codec<key_type, bid_type>;
+    //! whether the node is stored encoded, see compression.h
+    static constexpr bool compressed = codec_type::compressed;
+    //! whether the entries carry the number of elements in their subtrees,
+    //! which only uncompressed nodes do
+    static constexpr bool counted = !compressed;
+
+    enum {
+        //! entries of an uncompressed node, each with its subtree size
+        counted_entries = (raw_size - sizeof(bid_type) - 2 * sizeof(external_size_type))
+                          / (sizeof(value_type) + sizeof(external_size_type))
+    };
+
+    struct plain_metainfo_type
     {
         bid_type me;
         unsigned cur_size;
     };
-    using block_type = foxxll::typed_block<raw_size, value_type, 0, metainfo_type>;
+    struct counted_metainfo_type : public plain_metainfo_type
+    {
+        //! number of elements in the subtree of each entry
+        external_size_type counts[counted_entries];
+    };
+    using metainfo_type = typename std::conditional<
+              counted, counted_metainfo_type, plain_metainfo_type>::type;
 
+    using plain_block_type = foxxll::typed_block<raw_size, value_type, 0, metainfo_type>;
     enum {
-        nelements = block_type::size - 1,
+        //! bytes of an encoded node available for the values
+        payload_size = raw_size - sizeof(metainfo_type),
+        //! an encoded node with fewer bytes underflows
+        min_payload_size = payload_size / 2 - 3 * codec_type::max_value_size,
+        nelements = compressed
+                    ? payload_size / codec_type::min_value_size
+                    : counted_entries - 1,
         max_size = nelements,
-        min_size = nelements / 2
+        min_size = compressed
+                   ? min_payload_size / codec_type::max_value_size
+                   : nelements / 2,
+        //! an encoded node is decoded into a larger block in internal memory
+        block_raw_size = compressed
+                         ? (sizeof(metainfo_type) + (nelements + 1) * sizeof(value_type)
+                            + raw_size - 1) / raw_size * raw_size
+                         : raw_size
     };
+
+    static_assert(!compressed || payload_size >= 8 * codec_type::max_value_size,
+                  "node too small for its encoded values");
+    static_assert(compressed || unsigned(plain_block_type::size) >= counted_entries,
+                  "node too small for the subtree sizes of its entries");
+
+    using block_type = foxxll::typed_block<block_raw_size, value_type, 0, metainfo_type>;
+    //! encoded node as stored in external memory
+    using disk_block_type = foxxll::typed_block<raw_size, uint8_t>;
     using block_iterator = typename block_type::iterator;
     using block_const_iterator = typename block_type::const_iterator;
 
@@ -89,18 +143,26 @@ private:
     };
 
     block_type* m_block;
+    //! encoded node, if compressed
+    disk_block_type* m_disk_block;
+    //! whether m_disk_block was read by prefetch() but not yet decoded
+    bool m_encoded;
     btree_type* m_btree;
     key_compare m_cmp;
     value_compare m_vcmp;
 
+    //! Inserts the splitter of the child at place2insert, which was split
+    //! into the new child of the splitter and itself, of the given height.
     std::pair<key_type, bid_type> insert(const std::pair<key_type, bid_type>& splitter,
-                                         const block_iterator& place2insert)
+                                         const block_iterator& place2insert,
+                                         unsigned height)
     {
         std::pair<key_type, bid_type> result(m_cmp.max_value(), bid_type());
 
         // splitter != *place2insert
         assert(m_vcmp(*place2insert, splitter) || m_vcmp(splitter, *place2insert));
 
+        const unsigned pos = unsigned(place2insert - m_block->begin());
         block_iterator cur = m_block->begin() + size() - 1;
         for ( ; cur >= place2insert; --cur)
             *(cur + 1) = *cur;
@@ -108,18 +170,31 @@ private:
 
         *place2insert = splitter;               // insert
 
+        if (counted)
+        {
+            // the new child took the smaller part of the split child's elements
+            const size_type left_count = m_btree->subtree_size(splitter.second, height);
+            std::copy_backward(counts() + pos, counts() + size(), counts() + size() + 1);
+            counts()[pos] = left_count;
+            counts()[pos + 1] -= left_count;
+        }
+
         ++(m_block->info.cur_size);
 
-        if (size() > max_nelements())           // overflow! need to split
+        if (overflows())                        // overflow! need to split
         {
             TLX_LOG << "btree::normal_node::insert overflow happened, splitting";
+            STXXL_TRACE_SPAN(span, "btree::split_node");
+            span.add_bytes(block_type::raw_size);
 
             bid_type new_bid;
             m_btree->m_node_cache.get_new_node(new_bid);                             // new (left) node
             normal_node* new_node = m_btree->m_node_cache.get_node(new_bid, true);
             assert(new_node);
 
-            const unsigned end_of_smaller_part = size() / 2;
+            const unsigned end_of_smaller_part = compressed
+                                                 ? unsigned(codec_type::split_point(m_block->begin(), m_block->begin() + size()))
+                                                 : size() / 2;
 
             result.first = ((*m_block)[end_of_smaller_part - 1]).first;
             result.second = new_bid;
@@ -131,6 +206,11 @@ private:
             // copy the larger part
             std::copy(m_block->begin() + end_of_smaller_part,
                       m_block->begin() + old_size, m_block->begin());
+            if (counted)
+            {
+                std::copy(counts(), counts() + end_of_smaller_part, new_node->counts());
+                std::copy(counts() + end_of_smaller_part, counts() + old_size, counts());
+            }
             m_block->info.cur_size = old_size - end_of_smaller_part;
             assert(size() + new_node->size() == old_size);
 
@@ -168,8 +248,7 @@ private:
         local_node_type* left_node = cache.get_node(left_bid, true);
         local_node_type* right_node = cache.get_node(right_bid, true);
 
-        const unsigned total_size = left_node->size() + right_node->size();
-        if (total_size <= right_node->max_nelements())
+        if (right_node->can_fuse(*left_node))
         {
             // --- fuse ---
 
@@ -181,6 +260,12 @@ private:
             cache.delete_node(left_bid);
 
             // delete left BID from the root
+            const unsigned left_pos = unsigned(leftIt - m_block->begin());
+            if (counted)
+            {
+                counts()[left_pos + 1] += counts()[left_pos];
+                std::copy(counts() + left_pos + 1, counts() + size(), counts() + left_pos);
+            }
             std::copy(leftIt + 1, m_block->begin() + size(), leftIt);
             --(m_block->info.cur_size);
         }
@@ -194,6 +279,13 @@ private:
             leftIt->first = new_splitter;
             assert(m_vcmp(*leftIt, *rightIt));
 
+            if (counted)
+            {
+                const unsigned left_pos = unsigned(leftIt - m_block->begin());
+                counts()[left_pos] = left_node->subtree_size();
+                counts()[left_pos + 1] = right_node->subtree_size();
+            }
+
             cache.unfix_node(left_bid);
             cache.unfix_node(right_bid);
         }
@@ -202,16 +294,21 @@ private:
 public:
     virtual ~normal_node()
     {
+        unlock_blocks(m_block);
         delete m_block;
+        delete m_disk_block;
     }
 
     normal_node(btree_type* btree,
                 key_compare cmp)
         : m_block(new block_type),
+          m_disk_block(compressed ? new disk_block_type : nullptr),
+          m_encoded(false),
           m_btree(btree),
           m_cmp(cmp),
           m_vcmp(cmp)
     {
+        lock_blocks(m_block);
         assert(min_nelements() >= 2);
         assert(2 * min_nelements() - 1 <= max_nelements());
         assert(max_nelements() <= nelements);
@@ -229,12 +326,39 @@ public:
         return *m_block;
     }
 
-    bool overflows() const { return m_block->info.cur_size > max_nelements(); }
-    bool underflows() const { return m_block->info.cur_size < min_nelements(); }
+    bool overflows() const
+    {
+        if (compressed)
+            return bytes() > payload_size;
+        return m_block->info.cur_size > max_nelements();
+    }
+    bool underflows() const
+    {
+        if (compressed)
+            return bytes() < min_payload_size;
+        return m_block->info.cur_size < min_nelements();
+    }
 
     static unsigned max_nelements() { return max_size; }
     static unsigned min_nelements() { return min_size; }
 
+    //! Number of bytes of the encoded values.
+    size_t bytes() const
+    {
+        return codec_type::size(m_block->begin(), m_block->begin() + size());
+    }
+
+    //! Whether the values of left and *this fit into one node.
+    bool can_fuse(const normal_node& left) const
+    {
+        if (left.size() + size() > max_nelements())
+            return false;
+        if (!compressed || left.size() == 0 || size() == 0)
+            return true;
+        return left.bytes() + bytes() - codec_type::first_value_size(front())
+               + codec_type::value_size(left.back(), front()) <= payload_size;
+    }
+
     /*
        template <class InputIterator>
        normal_node(InputIterator begin_, InputIterator end_,
@@ -271,26 +395,42 @@ public:
 
     void save()
     {
-        foxxll::request_ptr req = m_block->write(my_bid());
+        foxxll::request_ptr req = flush();
         req->wait();
     }
 
+    //! Asynchronous save().
+    foxxll::request_ptr flush()
+    {
+        return write(compressed_tag());
+    }
+
     foxxll::request_ptr load(const bid_type& bid)
     {
-        foxxll::request_ptr req = m_block->read(bid);
+        foxxll::request_ptr req = read(bid, compressed_tag());
         req->wait();
+        finish_read();
         assert(bid == my_bid());
         return req;
     }
 
     foxxll::request_ptr prefetch(const bid_type& bid)
     {
-        return m_block->read(bid);
+        return read(bid, compressed_tag());
+    }
+
+    //! Complete a read issued by prefetch(), called by the cache after
+    //! waiting for it.
+    void finish_read()
+    {
+        if (m_encoded)
+            decode();
     }
 
     void init(const bid_type& my_bid_)
     {
         m_block->info.me = my_bid_;
+        m_encoded = false;
         m_block->info.cur_size = 0;
     }
 
@@ -333,7 +473,7 @@ public:
 
         value_type key2search(x.first, bid_type());
         block_iterator it =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), key2search, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), key2search.first, m_cmp);
 
         assert(it != (m_block->begin() + size()));
 
@@ -347,6 +487,8 @@ public:
             std::pair<key_type, leaf_bid_type> bot_splitter;
             std::pair<iterator, bool> result = leaf->insert(x, bot_splitter);
             m_btree->m_leaf_cache.unfix_node(static_cast<leaf_bid_type>(it->second));
+            if (counted && result.second)
+                ++counts()[it - m_block->begin()];
             //if(key_compare::max_value() == BotSplitter.first)
             if (!(m_cmp(m_cmp.max_value(), bot_splitter.first) ||
                   m_cmp(bot_splitter.first, m_cmp.max_value())))
@@ -355,7 +497,7 @@ public:
 
             TLX_LOG << "btree::normal_node Inserting new value in *this";
 
-            splitter = insert(std::make_pair(bot_splitter.first, bid_type(bot_splitter.second)), it);
+            splitter = insert(std::make_pair(bot_splitter.first, bid_type(bot_splitter.second)), it, height);
 
             return result;
         }
@@ -367,6 +509,8 @@ public:
             std::pair<key_type, node_bid_type> bot_splitter;
             std::pair<iterator, bool> result = node->insert(x, height - 1, bot_splitter);
             m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(it->second));
+            if (counted && result.second)
+                ++counts()[it - m_block->begin()];
             //if(key_compare::max_value() == BotSplitter.first)
             if (!(m_cmp(m_cmp.max_value(), bot_splitter.first) ||
                   m_cmp(bot_splitter.first, m_cmp.max_value())))
@@ -375,7 +519,7 @@ public:
 
             TLX_LOG << "btree::normal_node Inserting new value in *this";
 
-            splitter = insert(bot_splitter, it);
+            splitter = insert(bot_splitter, it, height);
 
             return result;
         }
@@ -430,7 +574,7 @@ public:
         value_type key2search(k, bid_type());
 
         block_iterator it =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), key2search, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), key2search.first, m_cmp);
 
         assert(it != (m_block->begin() + size()));
 
@@ -462,7 +606,7 @@ public:
         value_type key2search(k, bid_type());
 
         block_iterator it =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), key2search, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), key2search.first, m_cmp);
 
         assert(it != (m_block->begin() + size()));
 
@@ -494,7 +638,7 @@ public:
         value_type key2search(k, bid_type());
         assert(!m_vcmp(back(), key2search));
         block_iterator it =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), key2search, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), key2search.first, m_cmp);
 
         assert(it != (m_block->begin() + size()));
 
@@ -526,7 +670,7 @@ public:
         value_type key2search(k, bid_type());
         assert(!m_vcmp(back(), key2search));
         block_iterator it =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), key2search, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), key2search.first, m_cmp);
 
         assert(it != (m_block->begin() + size()));
 
@@ -558,7 +702,7 @@ public:
         value_type key2search(k, bid_type());
         assert(m_vcmp(key2search, back()));
         block_iterator it =
-            std::upper_bound(m_block->begin(), m_block->begin() + size(), key2search, m_vcmp);
+            key_search_type::upper_bound(m_block->begin(), m_block->begin() + size(), key2search.first, m_cmp);
 
         assert(it != (m_block->begin() + size()));
 
@@ -590,7 +734,7 @@ public:
         value_type key2search(k, bid_type());
         assert(m_vcmp(key2search, back()));
         block_iterator it =
-            std::upper_bound(m_block->begin(), m_block->begin() + size(), key2search, m_vcmp);
+            key_search_type::upper_bound(m_block->begin(), m_block->begin() + size(), key2search.first, m_cmp);
 
         assert(it != (m_block->begin() + size()));
 
@@ -632,13 +776,19 @@ public:
         // copy Src to *this leaf
         std::copy(src.m_block->begin(), src.m_block->begin() + src_size, m_block->begin());
 
+        if (counted)
+        {
+            std::copy_backward(counts(), counts() + size(), counts() + size() + src_size);
+            std::copy(src.counts(), src.counts() + src_size, counts());
+        }
+
         m_block->info.cur_size += src_size;
     }
 
     key_type balance(normal_node& left, bool check_constraints = true)
     {
         const unsigned total_size = left.size() + size();
-        unsigned new_left_size = total_size / 2;
+        unsigned new_left_size = compressed ? balance_point(left) : total_size / 2;
         unsigned new_right_size = total_size - new_left_size;
 
         assert(!check_constraints || new_left_size <= left.max_nelements());
@@ -664,6 +814,12 @@ public:
             // copy left to *this leaf
             std::copy(left.m_block->begin() + new_left_size,
                       left.m_block->begin() + left.size(), m_block->begin());
+
+            if (counted)
+            {
+                std::copy_backward(counts(), counts() + size(), counts() + size() + nEl2Move);
+                std::copy(left.counts() + new_left_size, left.counts() + left.size(), counts());
+            }
         }
         else
         {
@@ -678,6 +834,12 @@ public:
             // move elements in *this
             std::copy(m_block->begin() + nEl2Move,
                       m_block->begin() + size(), m_block->begin());
+
+            if (counted)
+            {
+                std::copy(counts(), counts() + nEl2Move, left.counts() + left.size());
+                std::copy(counts() + nEl2Move, counts() + size(), counts());
+            }
         }
 
         m_block->info.cur_size = new_right_size;                           // update size
@@ -691,7 +853,7 @@ public:
         value_type key2search(k, bid_type());
 
         block_iterator it =
-            std::lower_bound(m_block->begin(), m_block->begin() + size(), key2search, m_vcmp);
+            key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), key2search.first, m_cmp);
 
         assert(it != (m_block->begin() + size()));
 
@@ -706,6 +868,8 @@ public:
             assert(leaf);
             size_type result = leaf->erase(k);
             m_btree->m_leaf_cache.unfix_node(static_cast<leaf_bid_type>(it->second));
+            if (counted)
+                counts()[it - m_block->begin()] -= result;
             if (!leaf->underflows())
                 return result;
             // no underflow or root has a special degree 1 (too few elements)
@@ -722,6 +886,8 @@ public:
         assert(node);
         size_type result = node->erase(k, height - 1);
         m_btree->m_node_cache.unfix_node(static_cast<node_bid_type>(found_bid));
+        if (counted)
+            counts()[it - m_block->begin()] -= result;
         if (!node->underflows())
             return result;
         // no underflow happened
@@ -732,6 +898,105 @@ public:
         return result;
     }
 
+    /*!
+     * Erases the elements with keys in [lower, upper) from the subtree of the
+     * node of the given height. The children between the ones containing
+     * lower and upper are deleted as a whole, see btree::delete_subtree(),
+     * and only the two boundary children are descended into. These may be
+     * left underflowing, their leaves even empty, see fix_path(). If
+     * erase_front, all keys of the subtree are at least lower, hence no child
+     * contains lower. Returns the number of erased elements.
+     */
+    size_type erase_range(const key_type& lower, const key_type& upper,
+                          unsigned height, bool erase_front)
+    {
+        block_iterator begin = m_block->begin();
+        block_iterator first = erase_front ? begin
+                               : key_search_type::lower_bound(begin, begin + size(), lower, m_cmp);
+        // end if all keys of the subtree are less than upper
+        block_iterator last =
+            key_search_type::lower_bound(first, begin + size(), upper, m_cmp);
+        assert(!erase_front || last != begin + size());
+
+        const unsigned first_pos = unsigned(first - begin);
+        const bool last_partial = (last != begin + size()) && (erase_front || last != first);
+        // if the children behind the one containing lower are deleted, it
+        // takes over their key range: its key and the last key of its node
+        // become the last key of this node
+        const bool erase_back = (last == begin + size());
+        const key_type back_key = back().first;
+        size_type result = 0;
+
+        // delete the children between the boundary ones
+        block_iterator deleted = erase_front ? begin : first + 1;
+        if (deleted < last)
+        {
+            TLX_LOG << "btree::normal_node Deleting " << (last - deleted) << " children";
+            for (block_iterator it = deleted; it != last; ++it)
+            {
+                if (counted)
+                    result += counts()[it - begin];
+                m_btree->delete_subtree(it->second, height, result);
+            }
+
+            const unsigned deleted_pos = unsigned(deleted - begin);
+            const unsigned last_pos = unsigned(last - begin);
+            if (counted)
+                std::copy(counts() + last_pos, counts() + size(), counts() + deleted_pos);
+            std::copy(last, begin + size(), deleted);
+            m_block->info.cur_size -= last_pos - deleted_pos;
+            last = deleted;
+        }
+
+        if (last_partial)
+        {
+            const size_type n = m_btree->erase_range(last->second, height, lower, upper, true);
+            if (counted)
+                counts()[last - begin] -= n;
+            result += n;
+        }
+
+        if (!erase_front)
+        {
+            if (erase_back)
+            {
+                first->first = back_key;
+                if (height > 2)
+                    m_btree->m_node_cache.get_node(static_cast<node_bid_type>(first->second))->back().first = back_key;
+            }
+            const size_type n = m_btree->erase_range(first->second, height, lower, upper, false);
+            if (counted)
+                counts()[first_pos] -= n;
+            result += n;
+        }
+
+        return result;
+    }
+
+    //! Fixes the underflows left by erase_range() on the path to key k in the
+    //! subtree of the node of the given height: the child containing k is
+    //! fixed first, then fused or balanced with a neighbour while it
+    //! underflows. Returns whether any node or leaf was changed.
+    bool fix_path(const key_type& k, unsigned height)
+    {
+        bool changed = false;
+        while (true)
+        {
+            block_iterator it =
+                key_search_type::lower_bound(m_block->begin(), m_block->begin() + size(), k, m_cmp);
+            assert(it != (m_block->begin() + size()));
+
+            if (!m_btree->fix_path(it->second, height, k, changed) || size() == 1)
+                return changed;
+
+            if (height == 2)
+                fuse_or_balance(it, m_btree->m_leaf_cache);
+            else
+                fuse_or_balance(it, m_btree->m_node_cache);
+            changed = true;
+        }
+    }
+
     void deallocate_children(unsigned height)
     {
         if (height == 2)
@@ -758,11 +1023,102 @@ public:
         }
     }
 
-    void push_back(const value_type& x)
+    //! Appends an entry whose subtree has the given number of elements.
+    void push_back(const value_type& x, size_type count)
     {
+        if (counted)
+            counts()[size()] = count;
         (*this)[size()] = x;
         ++(m_block->info.cur_size);
     }
+
+    //! Number of elements in the subtree of entry i, see counted.
+    size_type count(unsigned i) const
+    {
+        assert(counted);
+        return counts()[i];
+    }
+
+    //! Number of elements in the subtree of the node, see counted.
+    size_type subtree_size() const
+    {
+        if (!counted)
+            return 0;
+        return std::accumulate(counts(), counts() + size(), size_type(0));
+    }
+
+private:
+    using compressed_tag = std::integral_constant<bool, compressed>;
+
+    external_size_type* counts(std::true_type)
+    {
+        return m_block->info.counts;
+    }
+
+    external_size_type* counts(std::false_type)
+    {
+        return nullptr;
+    }
+
+    //! subtree sizes of the entries, nullptr if not counted
+    external_size_type* counts()
+    {
+        return counts(std::integral_constant<bool, counted>());
+    }
+
+    const external_size_type* counts() const
+    {
+        return const_cast<normal_node*>(this)->counts();
+    }
+
+    foxxll::request_ptr write(std::false_type)
+    {
+        return m_block->write(my_bid());
+    }
+
+    foxxll::request_ptr write(std::true_type)
+    {
+        encode();
+        return m_disk_block->write(my_bid());
+    }
+
+    foxxll::request_ptr read(const bid_type& bid, std::false_type)
+    {
+        return m_block->read(bid);
+    }
+
+    foxxll::request_ptr read(const bid_type& bid, std::true_type)
+    {
+        m_encoded = true;
+        return m_disk_block->read(bid);
+    }
+
+    //! Size of left after balancing: the encoded values of left and *this are
+    //! split in halves.
+    unsigned balance_point(const normal_node& left) const
+    {
+        std::vector<value_type> values(left.m_block->begin(), left.m_block->begin() + left.size());
+        values.insert(values.end(), m_block->begin(), m_block->begin() + size());
+        return unsigned(codec_type::split_point(values.begin(), values.end()));
+    }
+
+    void encode()
+    {
+        assert(!overflows());
+        uint8_t* out = m_disk_block->begin();
+        std::memcpy(out, &m_block->info, sizeof(metainfo_type));
+        codec_type::encode(m_block->begin(), m_block->begin() + size(),
+                           out + sizeof(metainfo_type));
+    }
+
+    void decode()
+    {
+        const uint8_t* in = m_disk_block->begin();
+        std::memcpy(&m_block->info, in, sizeof(metainfo_type));
+        codec_type::decode(in + sizeof(metainfo_type),
+                           m_block->begin(), m_block->begin() + size());
+        m_encoded = false;
+    }
 };
 
 } // namespace btree
@@ -14,6 +14,9 @@
 #define STXXL_CONTAINERS_BTREE_NODE_CACHE_HEADER
 
 #include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -26,6 +29,7 @@
 #include <foxxll/mng/typed_block.hpp>
 
 #include <stxxl/bits/config.h>
+#include <stxxl/bits/containers/btree/file_storage.h>
 #include <stxxl/bits/containers/pager.h>
 
 namespace stxxl {
@@ -47,7 +51,7 @@ public:
     using key_compare = typename btree_type::key_compare;
 
     using alloc_strategy_type = typename btree_type::alloc_strategy_type;
-    using pager_type = stxxl::lru_pager<>;
+    using pager_type = typename btree_type::pager_type;
 
 private:
     btree_type* m_btree;
@@ -78,6 +82,8 @@ private:
     std::vector<foxxll::request_ptr> m_reqs;
     std::vector<bool> m_fixed;
     std::vector<bool> m_dirty;
+    //! nodes kept in the cache regardless of the pager, see pin_node()
+    std::vector<bool> m_pinned;
     std::vector<size_t> m_free_nodes;
     using bid2node_type = std::unordered_map<bid_type, size_t, bid_hash>;
 
@@ -85,6 +91,8 @@ private:
     pager_type m_pager;
     foxxll::block_manager* m_bm;
     alloc_strategy_type m_alloc_strategy;
+    //! file the blocks are allocated in, if the tree is stored in one
+    file_storage* m_storage { nullptr };
 
     uint64_t n_found { 0 };
     uint64_t n_not_found { 0 };
@@ -94,6 +102,28 @@ private:
     uint64_t n_written { 0 };
     uint64_t n_clean_forced { 0 };
 
+    //! whether the pager may replace a node
+    bool evictable(size_t nodeindex) const
+    {
+        return !m_fixed[nodeindex] && !m_pinned[nodeindex];
+    }
+
+    void new_block(bid_type& bid)
+    {
+        if (m_storage)
+            m_storage->new_block(bid);
+        else
+            m_bm->new_block(m_alloc_strategy, bid);
+    }
+
+    void delete_block(const bid_type& bid)
+    {
+        if (m_storage)
+            m_storage->delete_block(bid);
+        else
+            m_bm->delete_block(bid);
+    }
+
     // changes btree pointer in all contained iterators
     void change_btree_pointers(btree_type* b)
     {
@@ -110,6 +140,7 @@ public:
                key_compare cmp)
         : m_btree(btree),
           m_cmp(cmp),
+          m_pager(cache_size_in_bytes / block_type::raw_size),
           m_bm(foxxll::block_manager::get_instance())
     {
         const size_t nnodes = cache_size_in_bytes / block_type::raw_size;
@@ -123,14 +154,12 @@ public:
         m_free_nodes.reserve(nnodes);
         m_fixed.resize(nnodes, false);
         m_dirty.resize(nnodes, true);
+        m_pinned.resize(nnodes, false);
         for (size_t i = 0; i < nnodes; ++i)
         {
             m_nodes.push_back(new node_type(m_btree, m_cmp));
             m_free_nodes.push_back(i);
         }
-
-        pager_type tmp_pager(nnodes);
-        std::swap(m_pager, tmp_pager);
     }
 
     //! non-copyable: delete copy-constructor
@@ -158,7 +187,10 @@ public:
         {
             const size_t& p = it.second;
             if (m_reqs[p].valid())
+            {
                 m_reqs[p]->wait();
+                m_nodes[p]->finish_read();
+            }
 
             if (m_dirty[p])
                 m_nodes[p]->save();
@@ -188,11 +220,15 @@ public:
                             "Returning nullptr node.";
                         return nullptr;
                     }
-                    m_pager.hit(node2kick);
-                } while (m_fixed[node2kick]);
+                    if (!evictable(node2kick))
+                        pager_retain(m_pager, node2kick);
+                } while (!evictable(node2kick));
             }
             if (m_reqs[node2kick].valid())
+            {
                 m_reqs[node2kick]->wait();
+                m_nodes[node2kick]->finish_read();
+            }
 
             node_type& node = *(m_nodes[node2kick]);
 
@@ -208,9 +244,10 @@ public:
 
             assert(m_bid2node.find(node.my_bid()) != m_bid2node.end());
             m_bid2node.erase(node.my_bid());
-            m_bm->new_block(m_alloc_strategy, new_bid);
+            new_block(new_bid);
 
             m_bid2node[new_bid] = node2kick;
+            pager_load(m_pager, node2kick, bid_hash()(new_bid));
 
             node.init(new_bid);
 
@@ -227,14 +264,14 @@ public:
         m_free_nodes.pop_back();
         assert(m_fixed[free_node] == false);
 
-        m_bm->new_block(m_alloc_strategy, new_bid);
+        new_block(new_bid);
         m_bid2node[new_bid] = free_node;
         node_type& node = *(m_nodes[free_node]);
         node.init(new_bid);
 
         // assert(!(reqs_[free_node].valid()));
 
-        m_pager.hit(free_node);
+        pager_load(m_pager, free_node, bid_hash()(new_bid));
 
         m_dirty[free_node] = true;
 
@@ -245,6 +282,15 @@ public:
         return &node;
     }
 
+    //! Allocates blocks for nodes that are written by the caller, bypassing
+    //! the cache, see btree::parallel_bulk_construction().
+    template <class BidIterator>
+    void new_blocks(BidIterator begin, BidIterator end)
+    {
+        for ( ; begin != end; ++begin)
+            new_block(*begin);
+    }
+
     node_type * get_node(const bid_type& bid, bool fix = false)
     {
         typename bid2node_type::const_iterator it = m_bid2node.find(bid);
@@ -261,6 +307,7 @@ public:
 
             if (m_reqs[nodeindex].valid() && !m_reqs[nodeindex]->poll())
                 m_reqs[nodeindex]->wait();
+            m_nodes[nodeindex]->finish_read();
 
             ++n_found;
             return m_nodes[nodeindex];
@@ -285,12 +332,16 @@ public:
                             "Returning nullptr node.";
                         return nullptr;
                     }
-                    m_pager.hit(node2kick);
-                } while (m_fixed[node2kick]);
+                    if (!evictable(node2kick))
+                        pager_retain(m_pager, node2kick);
+                } while (!evictable(node2kick));
             }
 
             if (m_reqs[node2kick].valid())
+            {
                 m_reqs[node2kick]->wait();
+                m_nodes[node2kick]->finish_read();
+            }
 
             node_type& node = *(m_nodes[node2kick]);
 
@@ -306,6 +357,7 @@ public:
 
             m_reqs[node2kick] = node.load(bid);
             m_bid2node[bid] = node2kick;
+            pager_load(m_pager, node2kick, bid_hash()(bid));
 
             m_fixed[node2kick] = fix;
 
@@ -326,7 +378,7 @@ public:
         m_reqs[free_node] = node.load(bid);
         m_bid2node[bid] = free_node;
 
-        m_pager.hit(free_node);
+        pager_load(m_pager, free_node, bid_hash()(bid));
 
         m_fixed[free_node] = fix;
 
@@ -354,6 +406,7 @@ public:
 
             if (m_reqs[nodeindex].valid() && !m_reqs[nodeindex]->poll())
                 m_reqs[nodeindex]->wait();
+            m_nodes[nodeindex]->finish_read();
 
             ++n_found;
             return m_nodes[nodeindex];
@@ -379,11 +432,15 @@ public:
                         "Returning nullptr node.";
                     return nullptr;
                 }
-                m_pager.hit(node2kick);
-            } while (m_fixed[node2kick]);
+                if (!evictable(node2kick))
+                    pager_retain(m_pager, node2kick);
+            } while (!evictable(node2kick));
 
             if (m_reqs[node2kick].valid())
+            {
                 m_reqs[node2kick]->wait();
+                m_nodes[node2kick]->finish_read();
+            }
 
             node_type& node = *(m_nodes[node2kick]);
             if (m_dirty[node2kick])
@@ -398,6 +455,7 @@ public:
 
             m_reqs[node2kick] = node.load(bid);
             m_bid2node[bid] = node2kick;
+            pager_load(m_pager, node2kick, bid_hash()(bid));
 
             m_fixed[node2kick] = fix;
 
@@ -418,7 +476,7 @@ public:
         m_reqs[free_node] = node.load(bid);
         m_bid2node[bid] = free_node;
 
-        m_pager.hit(free_node);
+        pager_load(m_pager, free_node, bid_hash()(bid));
 
         m_fixed[free_node] = fix;
 
@@ -448,14 +506,15 @@ public:
                 m_free_nodes.push_back(nodeindex);
                 m_bid2node.erase(bid);
                 m_fixed[nodeindex] = false;
+                m_pinned[nodeindex] = false;
             }
             ++n_deleted;
         } catch (const foxxll::io_error& ex)
         {
-            m_bm->delete_block(bid);
+            delete_block(bid);
             throw foxxll::io_error(ex.what());
         }
-        m_bm->delete_block(bid);
+        delete_block(bid);
     }
 
     void prefetch_node(const bid_type& bid)
@@ -481,11 +540,15 @@ public:
                         "Returning nullptr node.";
                     return;
                 }
-                m_pager.hit(node2kick);
-            } while (m_fixed[node2kick]);
+                if (!evictable(node2kick))
+                    pager_retain(m_pager, node2kick);
+            } while (!evictable(node2kick));
 
             if (m_reqs[node2kick].valid())
+            {
                 m_reqs[node2kick]->wait();
+                m_nodes[node2kick]->finish_read();
+            }
 
             node_type& node = *(m_nodes[node2kick]);
 
@@ -501,6 +564,7 @@ public:
 
             m_reqs[node2kick] = node.prefetch(bid);
             m_bid2node[bid] = node2kick;
+            pager_load(m_pager, node2kick, bid_hash()(bid));
 
             m_fixed[node2kick] = false;
 
@@ -521,7 +585,7 @@ public:
         m_reqs[free_node] = node.prefetch(bid);
         m_bid2node[bid] = free_node;
 
-        m_pager.hit(free_node);
+        pager_load(m_pager, free_node, bid_hash()(bid));
 
         m_fixed[free_node] = false;
 
@@ -534,6 +598,88 @@ public:
         return;
     }
 
+    //! Writes a node without removing it from the cache. The write overlaps
+    //! with subsequent work, and the node is only written again if modified.
+    void flush_node(const bid_type& bid)
+    {
+        typename bid2node_type::const_iterator it = m_bid2node.find(bid);
+        assert(it != m_bid2node.end());
+        const size_t nodeindex = it->second;
+        if (!m_dirty[nodeindex])
+            return;
+
+        if (m_reqs[nodeindex].valid())
+        {
+            m_reqs[nodeindex]->wait();
+            m_nodes[nodeindex]->finish_read();
+        }
+        TLX_LOG << "btree::node_cache flush_node, node " << nodeindex;
+        m_reqs[nodeindex] = m_nodes[nodeindex]->flush();
+        m_dirty[nodeindex] = false;
+        ++n_written;
+    }
+
+    //! Writes all modified nodes and waits for all pending requests, such that
+    //! the nodes on disk are up to date.
+    void flush()
+    {
+        for (const auto& it : m_bid2node)
+            flush_node(it.first);
+
+        for (const auto& it : m_bid2node)
+        {
+            const size_t& p = it.second;
+            if (m_reqs[p].valid())
+            {
+                m_reqs[p]->wait();
+                m_nodes[p]->finish_read();
+                m_reqs[p] = foxxll::request_ptr();
+            }
+        }
+    }
+
+    //! Returns a node and keeps it in the cache until unpin_all(), unlike
+    //! fixing, which ends with the next access of the node.
+    node_type const * pin_node(const bid_type& bid)
+    {
+        node_type const* node = get_const_node(bid);
+        if (node)
+            m_pinned[m_bid2node[bid]] = true;
+        return node;
+    }
+
+    void unpin_all()
+    {
+        std::fill(m_pinned.begin(), m_pinned.end(), false);
+    }
+
+    //! number of nodes created and deleted, which changes with the structure
+    //! of the tree
+    uint64_t nchanges() const
+    {
+        return n_created + n_deleted;
+    }
+
+    //! returns the number of pinned nodes
+    size_t npinned() const
+    {
+        return std::count(m_pinned.begin(), m_pinned.end(), true);
+    }
+
+    //! Allocates the blocks of new nodes in the file of storage, instead of
+    //! by the block manager.
+    void set_storage(file_storage* storage)
+    {
+        m_storage = storage;
+    }
+
+    //! Fixes a node in the cache, as get_node(bid, true) without accessing it.
+    void fix_node(const bid_type& bid)
+    {
+        assert(m_bid2node.find(bid) != m_bid2node.end());
+        m_fixed[m_bid2node[bid]] = true;
+    }
+
     void unfix_node(const bid_type& bid)
     {
         assert(m_bid2node.find(bid) != m_bid2node.end());
@@ -549,10 +695,12 @@ public:
         change_btree_pointers(m_btree);
         obj.change_btree_pointers(obj.m_btree);
         std::swap(m_fixed, obj.m_fixed);
+        std::swap(m_pinned, obj.m_pinned);
         std::swap(m_free_nodes, obj.m_free_nodes);
         std::swap(m_bid2node, obj.m_bid2node);
         std::swap(m_pager, obj.m_pager);
         std::swap(m_alloc_strategy, obj.m_alloc_strategy);
+        std::swap(m_storage, obj.m_storage);
         std::swap(n_found, obj.n_found);
         std::swap(n_not_found, obj.n_found);
         std::swap(n_created, obj.n_created);
@@ -590,6 +738,160 @@ public:
     }
 };
 
+/*!
+ * Thread-safe cache of nodes or leaves used while a btree is read
+ * concurrently. The nodes are distributed over shards by their BID, each shard
+ * an LRU cache of its own guarded by a mutex. A node is pinned while it is
+ * read, and a pinned node is never replaced, hence readers of the same node
+ * share it, while readers of different shards do not contend. The tree must
+ * not be modified while the cache is in use.
+ */
+template <class NodeType>
+class sharded_node_cache
+{
+    static constexpr bool debug = false;
+
+public:
+    using node_type = NodeType;
+    using block_type = typename node_type::block_type;
+    using bid_type = typename node_type::bid_type;
+    using btree_type = typename node_type::btree_type;
+    using key_compare = typename node_type::key_compare;
+
+private:
+    struct bid_hash
+    {
+        size_t operator () (const bid_type& bid) const
+        {
+            return foxxll::longhash1(bid.offset + reinterpret_cast<intptr_t>(bid.storage));
+        }
+    };
+
+    struct shard
+    {
+        std::mutex mutex;
+        //! signaled when a node is unpinned
+        std::condition_variable released;
+        std::vector<std::unique_ptr<node_type> > nodes;
+        std::vector<bid_type> bids;
+        std::vector<size_t> pins;
+        std::vector<uint64_t> last_use;
+        std::unordered_map<bid_type, size_t, bid_hash> bid2node;
+        uint64_t clock { 0 };
+        uint64_t n_read { 0 };
+    };
+
+    std::vector<std::unique_ptr<shard> > m_shards;
+
+    shard& shard_of(const bid_type& bid) const
+    {
+        const size_t h = static_cast<size_t>(
+            bid.offset / bid_type::size + reinterpret_cast<intptr_t>(bid.storage));
+        return *m_shards[h % m_shards.size()];
+    }
+
+public:
+    sharded_node_cache(const size_t cache_size_in_bytes, const size_t n_shards,
+                       btree_type* btree, key_compare cmp)
+    {
+        assert(n_shards > 0);
+        const size_t nnodes =
+            std::max<size_t>(1, cache_size_in_bytes / block_type::raw_size / n_shards);
+        TLX_LOG << "btree::sharded_node_cache constructor shards=" << n_shards
+                << " nodes per shard=" << nnodes;
+
+        m_shards.reserve(n_shards);
+        for (size_t i = 0; i < n_shards; ++i)
+        {
+            m_shards.emplace_back(new shard);
+            shard& s = *m_shards.back();
+            for (size_t j = 0; j < nnodes; ++j)
+                s.nodes.emplace_back(new node_type(btree, cmp));
+            s.bids.resize(nnodes);
+            s.pins.resize(nnodes, 0);
+            s.last_use.resize(nnodes, 0);
+        }
+    }
+
+    //! non-copyable: delete copy-constructor
+    sharded_node_cache(const sharded_node_cache&) = delete;
+    //! non-copyable: delete assignment operator
+    sharded_node_cache& operator = (const sharded_node_cache&) = delete;
+
+    //! Returns the node with the given BID, loading it if necessary, and pins
+    //! it until unpin_node() is called. Blocks while all nodes of the shard
+    //! are pinned.
+    const node_type * pin_node(const bid_type& bid)
+    {
+        shard& s = shard_of(bid);
+        std::unique_lock<std::mutex> lock(s.mutex);
+
+        for ( ; ; )
+        {
+            auto it = s.bid2node.find(bid);
+            if (it != s.bid2node.end())
+            {
+                const size_t i = it->second;
+                ++s.pins[i];
+                s.last_use[i] = ++s.clock;
+                return s.nodes[i].get();
+            }
+
+            // replace the least recently used unpinned node
+            size_t victim = s.nodes.size();
+            for (size_t i = 0; i < s.nodes.size(); ++i)
+            {
+                if (s.pins[i] == 0 &&
+                    (victim == s.nodes.size() || s.last_use[i] < s.last_use[victim]))
+                    victim = i;
+            }
+
+            if (victim == s.nodes.size())
+            {
+                s.released.wait(lock);
+                continue;
+            }
+
+            if (s.bids[victim].valid())
+                s.bid2node.erase(s.bids[victim]);
+
+            TLX_LOG << "btree::sharded_node_cache pin_node loading " << bid;
+            s.nodes[victim]->load(bid);
+            ++s.n_read;
+            s.bids[victim] = bid;
+            s.bid2node[bid] = victim;
+            s.pins[victim] = 1;
+            s.last_use[victim] = ++s.clock;
+            return s.nodes[victim].get();
+        }
+    }
+
+    void unpin_node(const bid_type& bid)
+    {
+        shard& s = shard_of(bid);
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            auto it = s.bid2node.find(bid);
+            assert(it != s.bid2node.end());
+            assert(s.pins[it->second] > 0);
+            --s.pins[it->second];
+        }
+        s.released.notify_all();
+    }
+
+    //! number of nodes read, summed over all shards
+    uint64_t n_read() const
+    {
+        uint64_t n = 0;
+        for (const auto& s : m_shards)
+        {
+            std::unique_lock<std::mutex> lock(s->mutex);
+            n += s->n_read;
+        }
+        return n;
+    }
+};
+
 } // namespace btree
 } // namespace stxxl
 
@@ -0,0 +1,134 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/btree/search.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_BTREE_SEARCH_HEADER
+#define STXXL_CONTAINERS_BTREE_SEARCH_HEADER
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+
+#include <stxxl/bits/common/comparator.h>
+
+namespace stxxl {
+namespace btree {
+
+/*!
+ * Whether KeyCompare orders keys of type KeyType by their operator <, such
+ * that leaves and nodes may search them without calling the comparator. True
+ * for arithmetic keys with std::less and ascending stxxl::comparator;
+ * specialize it for other comparators with this ordering.
+ */
+template <class KeyType, class KeyCompare>
+struct is_plain_less_compare : std::false_type
+{ };
+
+template <class KeyType>
+struct is_plain_less_compare<KeyType, std::less<KeyType> >
+    : std::is_arithmetic<KeyType>
+{ };
+
+template <class KeyType>
+struct is_plain_less_compare<KeyType, comparator<KeyType> >
+    : std::is_arithmetic<KeyType>
+{ };
+
+template <class KeyType>
+struct is_plain_less_compare<KeyType, comparator<KeyType, direction::Less> >
+    : std::is_arithmetic<KeyType>
+{ };
+
+/*!
+ * Search of a key in the sorted (key, value) pairs of a leaf or node. The
+ * general version uses std::lower_bound and std::upper_bound with the
+ * comparator.
+ */
+template <class KeyType, class KeyCompare,
+          bool PlainLess = is_plain_less_compare<KeyType, KeyCompare>::value>
+struct key_search
+{
+    template <class Iterator>
+    static Iterator lower_bound(Iterator first, Iterator last,
+                                const KeyType& key, const KeyCompare& cmp)
+    {
+        return std::lower_bound(
+            first, last, key,
+            [&cmp](const typename std::iterator_traits<Iterator>::value_type& x,
+                   const KeyType& k) {
+                return cmp(x.first, k);
+            });
+    }
+
+    template <class Iterator>
+    static Iterator upper_bound(Iterator first, Iterator last,
+                                const KeyType& key, const KeyCompare& cmp)
+    {
+        return std::upper_bound(
+            first, last, key,
+            [&cmp](const KeyType& k,
+                   const typename std::iterator_traits<Iterator>::value_type& x) {
+                return cmp(k, x.first);
+            });
+    }
+};
+
+/*!
+ * Search of arithmetic keys ordered by operator <: a binary search whose
+ * steps compile to conditional moves instead of mispredicted branches,
+ * narrowing the range down to a few pairs which are then counted by a
+ * linear scan without branches.
+ */
+template <class KeyType, class KeyCompare>
+struct key_search<KeyType, KeyCompare, true>
+{
+    //! number of pairs below which the search counts linearly
+    static constexpr size_t linear_size = 16;
+
+    template <class Iterator>
+    static Iterator lower_bound(Iterator first, Iterator last,
+                                const KeyType& key, const KeyCompare& /* cmp */)
+    {
+        size_t n = static_cast<size_t>(last - first);
+        while (n > linear_size)
+        {
+            const size_t half = n / 2;
+            first = (first[half].first < key) ? first + half : first;
+            n -= half;
+        }
+        size_t less = 0;
+        for (size_t i = 0; i < n; ++i)
+            less += (first[i].first < key);
+        return first + less;
+    }
+
+    template <class Iterator>
+    static Iterator upper_bound(Iterator first, Iterator last,
+                                const KeyType& key, const KeyCompare& /* cmp */)
+    {
+        size_t n = static_cast<size_t>(last - first);
+        while (n > linear_size)
+        {
+            const size_t half = n / 2;
+            first = (key < first[half].first) ? first : first + half;
+            n -= half;
+        }
+        size_t not_greater = 0;
+        for (size_t i = 0; i < n; ++i)
+            not_greater += !(key < first[i].first);
+        return first + not_greater;
+    }
+};
+
+} // namespace btree
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_BTREE_SEARCH_HEADER
@@ -0,0 +1,562 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/columnar_vector.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_COLUMNAR_VECTOR_HEADER
+#define STXXL_CONTAINERS_COLUMNAR_VECTOR_HEADER
+
+#include <cassert>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+#include <foxxll/common/types.hpp>
+
+#include <stxxl/bits/containers/pager.h>
+#include <stxxl/bits/containers/vector.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont_vector
+//! \{
+
+//! number of elements per block of the columns of a columnar_vector, blocks
+//! of 2 MiB for 8 byte fields.
+static constexpr size_t columnar_default_block_elements = 256 * 1024;
+
+namespace columnar_vector_local {
+
+//! Call f(I) for each I in the index sequence.
+template <typename Functor, size_t... Is>
+void for_each_index(Functor&& f, std::index_sequence<Is...>)
+{
+    using expander = int[];
+    (void)expander { 0, (f(std::integral_constant<size_t, Is>()), 0) ... };
+}
+
+} // namespace columnar_vector_local
+
+/*!
+ * External vector of records stored as a structure of arrays: each field is
+ * kept in a stxxl::vector of its own, so that scans which touch only some of
+ * the fields read only their columns.
+ *
+ * All columns have BlockElements elements per block, hence the blocks with
+ * the same index hold the same records in all columns. Records are accessed
+ * as std::tuple<Fields...> by value with get() and set(), or through the
+ * zipped const_iterator; single fields with column<I>().
+ *
+ * For scans, column_bufreader_type<I> reads a single column with overlapped
+ * I/O and reader<Columns...> is a stream of tuples of the selected columns
+ * which can be fed into the stream:: algorithms. bufwriter fills all columns
+ * with overlapped I/O.
+ *
+ * The columns cache single blocks, PagerType sets their number of cached
+ * blocks.
+ *
+ * \tparam BlockElements number of elements per block of all columns
+ * \tparam PagerType pager of the page cache of each column
+ * \tparam Fields types of the fields of the records
+ */
+template <size_t BlockElements, typename PagerType, typename... Fields>
+class basic_columnar_vector
+{
+    static_assert(sizeof ... (Fields) > 0, "a columnar_vector needs at least one column");
+
+public:
+    //! \name Types
+    //! \{
+
+    //! type of the records
+    using value_type = std::tuple<Fields...>;
+    using size_type = foxxll::external_size_type;
+    using difference_type = foxxll::external_diff_type;
+
+    //! number of columns
+    static constexpr size_t num_columns = sizeof ... (Fields);
+
+    //! number of elements per block of all columns
+    static constexpr size_t block_elements = BlockElements;
+
+    //! type of the I-th field
+    template <size_t I>
+    using field_type = typename std::tuple_element<I, value_type>::type;
+
+    //! vector storing the I-th column
+    template <size_t I>
+    using column_type = stxxl::vector<field_type<I>, 1, PagerType,
+                                      BlockElements * sizeof(field_type<I>)>;
+
+    //! buffered reader of the I-th column
+    template <size_t I>
+    using column_bufreader_type = typename column_type<I>::bufreader_type;
+
+    //! \}
+
+protected:
+    template <size_t... Is>
+    static std::tuple<column_type<Is>...> make_columns(std::index_sequence<Is...>);
+
+    using columns_type = decltype(make_columns(std::index_sequence_for<Fields...>()));
+
+    columns_type m_columns;
+
+    template <size_t... Is>
+    value_type get(size_type index, std::index_sequence<Is...>) const
+    {
+        return value_type(std::get<Is>(m_columns)[index] ...);
+    }
+
+    //! Call f(column) for each column.
+    template <typename Functor>
+    void for_each_column(Functor&& f)
+    {
+        columnar_vector_local::for_each_index(
+            [this, &f](auto I) { f(std::get<decltype(I)::value>(m_columns)); },
+            std::index_sequence_for<Fields...>());
+    }
+
+    template <typename Functor>
+    void for_each_column(Functor&& f) const
+    {
+        columnar_vector_local::for_each_index(
+            [this, &f](auto I) { f(std::get<decltype(I)::value>(m_columns)); },
+            std::index_sequence_for<Fields...>());
+    }
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Construct a columnar vector of n default records.
+    //! \warning this will not call the constructor of objects in external memory!
+    explicit basic_columnar_vector(size_type n = 0)
+    {
+        resize(n);
+    }
+
+    //! non-copyable: delete copy-constructor
+    basic_columnar_vector(const basic_columnar_vector&) = delete;
+    //! non-copyable: delete assignment operator
+    basic_columnar_vector& operator = (const basic_columnar_vector&) = delete;
+
+    void swap(basic_columnar_vector& obj)
+    {
+        columnar_vector_local::for_each_index(
+            [this, &obj](auto I) {
+                std::get<decltype(I)::value>(m_columns).swap(
+                    std::get<decltype(I)::value>(obj.m_columns));
+            },
+            std::index_sequence_for<Fields...>());
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Number of records.
+    size_type size() const
+    {
+        return std::get<0>(m_columns).size();
+    }
+
+    //! true if the vector has no records.
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    //! Resize all columns to n records.
+    //! \warning this will not call the constructor of objects in external memory!
+    void resize(size_type n)
+    {
+        for_each_column([n](auto& column) { column.resize(n); });
+    }
+
+    //! Reserve external memory for n records in all columns.
+    void reserve(size_type n)
+    {
+        for_each_column([n](auto& column) { column.reserve(n); });
+    }
+
+    //! Erase all records and deallocate the external memory of all columns.
+    void clear()
+    {
+        for_each_column([](auto& column) { column.clear(); });
+    }
+
+    //! Flush the page caches of all columns.
+    void flush() const
+    {
+        for_each_column([](const auto& column) { column.flush(); });
+    }
+
+    //! \}
+
+    //! \name Element Access
+    //! \{
+
+    //! The vector storing the I-th field of the records.
+    template <size_t I>
+    column_type<I>& column()
+    {
+        return std::get<I>(m_columns);
+    }
+
+    //! The vector storing the I-th field of the records.
+    template <size_t I>
+    const column_type<I>& column() const
+    {
+        return std::get<I>(m_columns);
+    }
+
+    //! Return a copy of the record at the given index.
+    value_type get(size_type index) const
+    {
+        assert(index < size());
+        return get(index, std::index_sequence_for<Fields...>());
+    }
+
+    //! Overwrite the record at the given index.
+    void set(size_type index, const value_type& record)
+    {
+        assert(index < size());
+        columnar_vector_local::for_each_index(
+            [this, index, &record](auto I) {
+                std::get<decltype(I)::value>(m_columns)[index] =
+                    std::get<decltype(I)::value>(record);
+            },
+            std::index_sequence_for<Fields...>());
+    }
+
+    //! Append a record at the end.
+    void push_back(const value_type& record)
+    {
+        columnar_vector_local::for_each_index(
+            [this, &record](auto I) {
+                std::get<decltype(I)::value>(m_columns).push_back(
+                    std::get<decltype(I)::value>(record));
+            },
+            std::index_sequence_for<Fields...>());
+    }
+
+    //! \}
+
+    //! \name Iterators
+    //! \{
+
+    /*!
+     * Zipped iterator over the records, which are returned as tuples by
+     * value. Reading records through it accesses all columns, see
+     * reader<Columns...> for scans of some of them.
+     */
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = typename basic_columnar_vector::value_type;
+        using difference_type = typename basic_columnar_vector::difference_type;
+        using size_type = typename basic_columnar_vector::size_type;
+        using reference = value_type;
+        using pointer = void;
+
+    protected:
+        const basic_columnar_vector* m_vector;
+        size_type m_index;
+
+    public:
+        const_iterator()
+            : m_vector(nullptr), m_index(0)
+        { }
+
+        const_iterator(const basic_columnar_vector* vector, size_type index)
+            : m_vector(vector), m_index(index)
+        { }
+
+        //! index of the current record
+        size_type index() const
+        {
+            return m_index;
+        }
+
+        value_type operator * () const
+        {
+            return m_vector->get(m_index);
+        }
+
+        value_type operator [] (difference_type i) const
+        {
+            return m_vector->get(m_index + i);
+        }
+
+        const_iterator& operator ++ ()
+        {
+            ++m_index;
+            return *this;
+        }
+        const_iterator operator ++ (int)
+        {
+            const_iterator it = *this;
+            ++m_index;
+            return it;
+        }
+        const_iterator& operator -- ()
+        {
+            --m_index;
+            return *this;
+        }
+        const_iterator operator -- (int)
+        {
+            const_iterator it = *this;
+            --m_index;
+            return it;
+        }
+        const_iterator& operator += (difference_type i)
+        {
+            m_index += i;
+            return *this;
+        }
+        const_iterator& operator -= (difference_type i)
+        {
+            m_index -= i;
+            return *this;
+        }
+        const_iterator operator + (difference_type i) const
+        {
+            return const_iterator(m_vector, m_index + i);
+        }
+        const_iterator operator - (difference_type i) const
+        {
+            return const_iterator(m_vector, m_index - i);
+        }
+        difference_type operator - (const const_iterator& it) const
+        {
+            return static_cast<difference_type>(m_index - it.m_index);
+        }
+
+        bool operator == (const const_iterator& it) const
+        {
+            return m_index == it.m_index;
+        }
+        bool operator != (const const_iterator& it) const
+        {
+            return m_index != it.m_index;
+        }
+        bool operator < (const const_iterator& it) const
+        {
+            return m_index < it.m_index;
+        }
+        bool operator <= (const const_iterator& it) const
+        {
+            return m_index <= it.m_index;
+        }
+        bool operator > (const const_iterator& it) const
+        {
+            return m_index > it.m_index;
+        }
+        bool operator >= (const const_iterator& it) const
+        {
+            return m_index >= it.m_index;
+        }
+    };
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, size());
+    }
+
+    const_iterator cend() const
+    {
+        return end();
+    }
+
+    //! \}
+
+    //! \name Buffered Readers and Writers
+    //! \{
+
+    /*!
+     * Stream of the records [begin, end) restricted to the given columns,
+     * read with one column_bufreader_type per column. Only the blocks of
+     * these columns are read. The stream returns std::tuple of the selected
+     * fields and can be used as input of the stream:: algorithms.
+     */
+    template <size_t... Columns>
+    class reader
+    {
+    public:
+        //! tuple of the selected fields
+        using value_type = std::tuple<field_type<Columns>...>;
+        using size_type = typename basic_columnar_vector::size_type;
+
+    protected:
+        std::tuple<std::unique_ptr<column_bufreader_type<Columns> >...> m_readers;
+        size_type m_size;
+
+    public:
+        //! Create a reader of the records [begin, end) of the columns.
+        //! \param vec columnar vector to read, it is flushed
+        //! \param begin index of the first record
+        //! \param end index after the last record
+        //! \param nbuffers number of buffers of each column (>= 2*D recommended)
+        reader(const basic_columnar_vector& vec, size_type begin, size_type end,
+               size_t nbuffers = 0)
+            : m_readers(std::unique_ptr<column_bufreader_type<Columns> >(
+                            new column_bufreader_type<Columns>(
+                                vec.template column<Columns>().cbegin() + begin,
+                                vec.template column<Columns>().cbegin() + end,
+                                nbuffers)) ...),
+              m_size(end - begin)
+        {
+            assert(begin <= end && end <= vec.size());
+        }
+
+        //! Create a reader of all records of the columns.
+        explicit reader(const basic_columnar_vector& vec, size_t nbuffers = 0)
+            : reader(vec, 0, vec.size(), nbuffers)
+        { }
+
+        //! non-copyable: delete copy-constructor
+        reader(const reader&) = delete;
+        //! non-copyable: delete assignment operator
+        reader& operator = (const reader&) = delete;
+
+        //! Return the selected fields of the current record.
+        value_type operator * () const
+        {
+            return get(std::index_sequence_for<field_type<Columns>...>());
+        }
+
+        //! Advance to the next record (asserts if !empty()).
+        reader& operator ++ ()
+        {
+            assert(!empty());
+            columnar_vector_local::for_each_index(
+                [this](auto I) { ++(*std::get<decltype(I)::value>(m_readers)); },
+                std::index_sequence_for<field_type<Columns>...>());
+            --m_size;
+            return *this;
+        }
+
+        //! Read the current record into variable and advance to next one.
+        reader& operator >> (value_type& v)
+        {
+            v = operator * ();
+            return operator ++ ();
+        }
+
+        //! Return the number of remaining records.
+        size_type size() const
+        {
+            return m_size;
+        }
+
+        //! Returns true once the whole range has been read.
+        bool empty() const
+        {
+            return m_size == 0;
+        }
+
+    protected:
+        template <size_t... Is>
+        value_type get(std::index_sequence<Is...>) const
+        {
+            return value_type(*(*std::get<Is>(m_readers)) ...);
+        }
+    };
+
+    /*!
+     * Buffered writer of records from the beginning of the vector, which
+     * writes each column with a vector_bufwriter. The vector grows as
+     * needed and is shortened to the records written by finish().
+     */
+    class bufwriter
+    {
+    protected:
+        template <size_t... Is>
+        static std::tuple<std::unique_ptr<typename column_type<Is>::bufwriter_type>...>
+        make_writers(std::index_sequence<Is...>);
+
+        using writers_type = decltype(make_writers(std::index_sequence_for<Fields...>()));
+
+        writers_type m_writers;
+
+    public:
+        //! Create a writer for the vector's beginning.
+        //! \param vec columnar vector to write
+        //! \param nbuffers number of buffers of each column (>= 2*D recommended)
+        explicit bufwriter(basic_columnar_vector& vec, size_t nbuffers = 0)
+        {
+            columnar_vector_local::for_each_index(
+                [this, &vec, nbuffers](auto I) {
+                    constexpr size_t i = decltype(I)::value;
+                    std::get<i>(m_writers).reset(
+                        new typename column_type<i>::bufwriter_type(
+                            vec.template column<i>(), nbuffers));
+                },
+                std::index_sequence_for<Fields...>());
+        }
+
+        //! non-copyable: delete copy-constructor
+        bufwriter(const bufwriter&) = delete;
+        //! non-copyable: delete assignment operator
+        bufwriter& operator = (const bufwriter&) = delete;
+
+        //! Finish writing and flush output back to the vector.
+        ~bufwriter()
+        {
+            finish();
+        }
+
+        //! Write a record and advance.
+        bufwriter& operator << (const value_type& record)
+        {
+            columnar_vector_local::for_each_index(
+                [this, &record](auto I) {
+                    *std::get<decltype(I)::value>(m_writers)
+                        << std::get<decltype(I)::value>(record);
+                },
+                std::index_sequence_for<Fields...>());
+            return *this;
+        }
+
+        //! Finish writing and flush output back to the vector.
+        void finish()
+        {
+            columnar_vector_local::for_each_index(
+                [this](auto I) { std::get<decltype(I)::value>(m_writers)->finish(); },
+                std::index_sequence_for<Fields...>());
+        }
+    };
+
+    //! \}
+};
+
+//! Columnar vector with blocks of columnar_default_block_elements elements.
+template <typename... Fields>
+using columnar_vector =
+          basic_columnar_vector<columnar_default_block_elements, lru_pager<8>, Fields...>;
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_COLUMNAR_VECTOR_HEADER
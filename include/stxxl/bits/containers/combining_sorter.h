@@ -0,0 +1,317 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/combining_sorter.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_COMBINING_SORTER_HEADER
+#define STXXL_CONTAINERS_COMBINING_SORTER_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include <tlx/define.hpp>
+
+#include <stxxl/bits/stream/sort_stream.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External sorter which combines items with equal keys, for "sort then
+ * reduce by key" uses such as counting.
+ *
+ * Like stxxl::sorter, the container has an input and an output phase. The
+ * pushed items are collected in a buffer in internal memory. A full buffer is
+ * sorted, items comparing equal are combined into one by the Combine
+ * function object, and the result is written as a sorted run. Hence the runs
+ * hold each key at most once and shrink by the repetition of the keys within
+ * a buffer. In the output phase, after sort(), the runs are merged and equal
+ * items of different runs are combined again, so the output holds each key
+ * exactly once, in sorted order.
+ *
+ * Combine is called as combine(a, b) with two items comparing equal and
+ * returns the combined item, e.g. which adds the counts of a and b. It must
+ * be associative and commutative, the order of combination is unspecified.
+ *
+ * \tparam ValueType   type of the contained objects (POD with no references to internal memory)
+ * \tparam CompareType type of comparison object used for sorting the runs
+ * \tparam CombineType type of the binary function object combining equal items
+ * \tparam BlockSize   size of the external memory block in bytes, default is \c STXXL_DEFAULT_BLOCK_SIZE(ValTp)
+ * \tparam AllocStr    parallel disk block allocation strategy, default is \c foxxll::default_alloc_strategy
+ */
+template <typename ValueType,
+          typename CompareType,
+          typename CombineType,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
+          class AllocStrategy = foxxll::default_alloc_strategy>
+class combining_sorter
+{
+public:
+    // *** Template Parameters
+
+    using value_type = ValueType;
+    using cmp_type = CompareType;
+    using combine_type = CombineType;
+    enum {
+        block_size = BlockSize
+    };
+    using alloc_strategy_type = AllocStrategy;
+
+    // *** Constructed Types
+
+    //! runs creator type writing the combined buffers as runs
+    using runs_creator_type = stream::runs_creator<stream::from_sorted_sequences<ValueType>, cmp_type,
+                                                   block_size, alloc_strategy_type>;
+
+    //! corresponding runs merger type
+    using runs_merger_type = stream::runs_merger<typename runs_creator_type::sorted_runs_type,
+                                                 cmp_type, alloc_strategy_type>;
+
+    //! size type
+    using size_type = typename runs_merger_type::size_type;
+
+protected:
+    // *** Object Attributes
+
+    //! current state of sorter
+    enum { STATE_INPUT, STATE_OUTPUT } m_state;
+
+    cmp_type m_cmp;
+
+    combine_type m_combine;
+
+    //! memory of the runs_creator
+    size_t m_creator_memory_to_use;
+
+    //! number of items in the buffer which are sorted into one run
+    size_t m_buffer_elements;
+
+    //! buffer collecting the pushed items
+    std::vector<value_type> m_buffer;
+
+    //! runs creator writing the combined buffers
+    std::unique_ptr<runs_creator_type> m_runs_creator;
+
+    //! runs merger reading items when in STATE_OUTPUT
+    runs_merger_type m_runs_merger;
+
+    //! number of items pushed
+    size_type m_size;
+
+    //! number of items written to the runs, after combining
+    size_type m_run_size;
+
+    //! current output item, combined of all equal items of the runs
+    value_type m_current;
+
+    //! true if the output is exhausted
+    bool m_output_empty;
+
+    //! true if a and b are equal with respect to m_cmp
+    bool equal(const value_type& a, const value_type& b) const
+    {
+        return !m_cmp(a, b) && !m_cmp(b, a);
+    }
+
+    //! Sort and combine the buffer and write it as a run.
+    void write_buffer()
+    {
+        if (m_buffer.empty())
+            return;
+
+        std::sort(m_buffer.begin(), m_buffer.end(), m_cmp);
+
+        value_type current = m_buffer[0];
+        for (size_t i = 1; i < m_buffer.size(); ++i)
+        {
+            if (equal(current, m_buffer[i]))
+            {
+                current = m_combine(current, m_buffer[i]);
+                continue;
+            }
+            m_runs_creator->push(current);
+            ++m_run_size;
+            current = m_buffer[i];
+        }
+        m_runs_creator->push(current);
+        ++m_run_size;
+
+        m_runs_creator->finish();
+        m_buffer.clear();
+    }
+
+    //! Combine the next equal items of the merger into m_current.
+    void fetch_next()
+    {
+        if (m_runs_merger.empty())
+        {
+            m_output_empty = true;
+            return;
+        }
+
+        m_current = *m_runs_merger;
+        ++m_runs_merger;
+        while (!m_runs_merger.empty() && equal(m_current, *m_runs_merger))
+        {
+            m_current = m_combine(m_current, *m_runs_merger);
+            ++m_runs_merger;
+        }
+        m_output_empty = false;
+    }
+
+public:
+    //! \name Constructors
+    //! \{
+
+    //! Constructor allocating memory_to_use bytes in ram for the buffer and
+    //! the runs_creator, and later the runs_merger.
+    combining_sorter(const cmp_type& cmp, size_t memory_to_use,
+                     const combine_type& combine = combine_type())
+        : m_state(STATE_INPUT),
+          m_cmp(cmp),
+          m_combine(combine),
+          m_creator_memory_to_use(
+              std::max<size_t>(memory_to_use / 8, 2 * block_size * sort_memory_usage_factor())),
+          m_buffer_elements(std::max<size_t>(
+                                1, (memory_to_use - std::min(memory_to_use, m_creator_memory_to_use))
+                                / sizeof(value_type))),
+          m_runs_creator(new runs_creator_type(cmp, m_creator_memory_to_use)),
+          m_runs_merger(cmp, memory_to_use),
+          m_size(0),
+          m_run_size(0),
+          m_output_empty(true)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    combining_sorter(const combining_sorter&) = delete;
+    //! non-copyable: delete assignment operator
+    combining_sorter& operator = (const combining_sorter&) = delete;
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Remove all items and return to input state.
+    void clear()
+    {
+        if (m_state == STATE_OUTPUT)
+            m_runs_merger.deallocate();
+
+        m_buffer.clear();
+        m_runs_creator.reset(new runs_creator_type(m_cmp, m_creator_memory_to_use));
+        m_size = m_run_size = 0;
+        m_output_empty = true;
+        m_state = STATE_INPUT;
+    }
+
+    //! Push another item (only callable during input state).
+    void push(const value_type& val)
+    {
+        assert(m_state == STATE_INPUT);
+        if (m_buffer.empty())
+            m_buffer.reserve(m_buffer_elements);
+
+        m_buffer.push_back(val);
+        ++m_size;
+        if (TLX_UNLIKELY(m_buffer.size() >= m_buffer_elements))
+            write_buffer();
+    }
+
+    //! Switch to output state.
+    void sort()
+    {
+        assert(m_state == STATE_INPUT);
+        write_buffer();
+
+        // release the buffer memory for the runs_merger
+        std::vector<value_type>().swap(m_buffer);
+
+        m_runs_merger.initialize(m_runs_creator->result());
+        m_state = STATE_OUTPUT;
+        fetch_next();
+    }
+
+    //! Rewind output stream to beginning.
+    void rewind()
+    {
+        assert(m_state == STATE_OUTPUT);
+        m_runs_merger.deallocate();
+        m_runs_merger.initialize(m_runs_creator->result());
+        fetch_next();
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Number of items pushed, before combining.
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    //! Number of items written to the runs, after combining within the
+    //! buffers. Items still in the buffer are not counted.
+    size_type run_size() const
+    {
+        return m_run_size;
+    }
+
+    //! Number of items per buffer, which are sorted into one run
+    size_t num_els_in_buffer() const { return m_buffer_elements; }
+
+    //! Standard stream method
+    bool empty() const
+    {
+        assert(m_state == STATE_OUTPUT);
+        return m_output_empty;
+    }
+
+    //! \}
+
+    //! \name Operators
+    //! \{
+
+    //! Standard stream method: the combination of all items with the current
+    //! key.
+    const value_type& operator * () const
+    {
+        assert(m_state == STATE_OUTPUT);
+        assert(!m_output_empty);
+        return m_current;
+    }
+
+    //! Standard stream method
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method (preincrement operator)
+    combining_sorter& operator ++ ()
+    {
+        assert(m_state == STATE_OUTPUT);
+        assert(!m_output_empty);
+        fetch_next();
+        return *this;
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_COMBINING_SORTER_HEADER
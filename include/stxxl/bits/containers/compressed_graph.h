@@ -0,0 +1,484 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/compressed_graph.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_COMPRESSED_GRAPH_HEADER
+#define STXXL_CONTAINERS_COMPRESSED_GRAPH_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <foxxll/common/exceptions.hpp>
+#include <foxxll/common/types.hpp>
+
+#include <stxxl/bits/common/binary_buffer.h>
+#include <stxxl/bits/common/task_runtime.h>
+#include <stxxl/bits/containers/pager.h>
+#include <stxxl/bits/containers/vector.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External directed graph in compressed sparse row format with compressed
+ * adjacency lists.
+ *
+ * The adjacency lists of the nodes are packed one after the other into a
+ * stxxl::vector of bytes: the degree of the node, the first neighbor as
+ * difference to the node, and the gaps between consecutive neighbors, all as
+ * varints as written by binary_buffer::put_varint(). A stxxl::vector of
+ * offsets holds the beginning of each list and the end of the last. On graphs
+ * with locality, like web graphs, most gaps take one byte, instead of the
+ * sixteen bytes of an edge pair.
+ *
+ * The graph is built with build() in one pass over a stream of the edges (u,
+ * v) sorted by u and then v. An edge_stream reads the edges of a range of
+ * nodes in order from the bytes alone, with overlapped I/O. neighbors() reads
+ * the list of one node by random access. For parallel scans, partition()
+ * splits the nodes into ranges of about the same number of bytes, which
+ * for_each_parallel() scans concurrently.
+ *
+ * \tparam NodeId node id type, an unsigned integer
+ * \tparam PagerType pager of the page caches of offsets and bytes
+ * \tparam BlockSize external block size in bytes of offsets and bytes
+ * \tparam AllocStr parallel disk block allocation strategy
+ */
+template <typename NodeId = uint64_t,
+          typename PagerType = lru_pager<8>,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(uint64_t),
+          typename AllocStr = foxxll::default_alloc_strategy>
+class compressed_graph
+{
+    static_assert(std::is_unsigned<NodeId>::value &&
+                  sizeof(NodeId) <= sizeof(uint64_t),
+                  "node ids must be unsigned integers of up to 64 bits");
+
+public:
+    //! \name Types
+    //! \{
+
+    using node_type = NodeId;
+    using size_type = foxxll::external_size_type;
+
+    //! (u, v)
+    using edge_type = std::tuple<NodeId, NodeId>;
+
+    //! vector of the beginnings of the adjacency lists
+    using offset_vector_type = stxxl::vector<uint64_t, 4, PagerType, BlockSize, AllocStr>;
+    //! vector of the compressed adjacency lists
+    using byte_vector_type = stxxl::vector<uint8_t, 4, PagerType, BlockSize, AllocStr>;
+
+    //! Beginning of the adjacency list of a node, which bounds the parts of a
+    //! partitioned scan.
+    struct bound_type
+    {
+        size_type node;
+        uint64_t offset;
+    };
+
+    //! \}
+
+protected:
+    offset_vector_type m_offsets;
+    byte_vector_type m_bytes;
+
+    //! number of nodes
+    size_type m_num_nodes;
+
+    //! number of edges
+    size_type m_num_edges;
+
+    //! Read a varint from an input iterator or stream of bytes.
+    template <typename Iterator>
+    static uint64_t get_varint(Iterator& it)
+    {
+        uint64_t value = 0;
+        for (unsigned shift = 0; ; shift += 7)
+        {
+            assert(shift < 64);
+            const uint8_t byte = *it;
+            ++it;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+    }
+
+    //! Encode the difference of the first neighbor v to its node u, which may
+    //! be negative, zig-zag style.
+    static uint64_t encode_first(NodeId u, NodeId v)
+    {
+        const int64_t diff = static_cast<int64_t>(
+            static_cast<uint64_t>(v) - static_cast<uint64_t>(u));
+        return (static_cast<uint64_t>(diff) << 1) ^ static_cast<uint64_t>(diff >> 63);
+    }
+
+    //! Decode the first neighbor of node u.
+    static NodeId decode_first(NodeId u, uint64_t code)
+    {
+        const uint64_t diff = (code >> 1) ^ (~(code & 1) + 1);
+        return static_cast<NodeId>(static_cast<uint64_t>(u) + diff);
+    }
+
+    //! Offset of the adjacency list of node u.
+    uint64_t offset(size_type u) const
+    {
+        assert(u <= m_num_nodes);
+        const offset_vector_type& offsets = m_offsets;
+        return offsets[u];
+    }
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    compressed_graph()
+        : m_num_nodes(0), m_num_edges(0)
+    {
+        m_offsets.push_back(0);
+    }
+
+    //! non-copyable: delete copy-constructor
+    compressed_graph(const compressed_graph&) = delete;
+    //! non-copyable: delete assignment operator
+    compressed_graph& operator = (const compressed_graph&) = delete;
+
+    void swap(compressed_graph& obj)
+    {
+        m_offsets.swap(obj.m_offsets);
+        m_bytes.swap(obj.m_bytes);
+        std::swap(m_num_nodes, obj.m_num_nodes);
+        std::swap(m_num_edges, obj.m_num_edges);
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Number of nodes.
+    size_type num_nodes() const { return m_num_nodes; }
+
+    //! Number of edges.
+    size_type num_edges() const { return m_num_edges; }
+
+    bool empty() const { return m_num_nodes == 0; }
+
+    //! Total number of bytes of the compressed adjacency lists.
+    size_type bytes() const { return m_bytes.size(); }
+
+    //! Remove all nodes and edges and deallocate the external memory.
+    void clear()
+    {
+        m_offsets.clear();
+        m_bytes.clear();
+        m_offsets.push_back(0);
+        m_num_nodes = 0;
+        m_num_edges = 0;
+    }
+
+    //! Flush the page caches.
+    void flush() const
+    {
+        m_offsets.flush();
+        m_bytes.flush();
+    }
+
+    //! \}
+
+    //! \name Construction
+    //! \{
+
+    /*!
+     * Build the graph of num_nodes nodes from a stream of edges, replacing
+     * the graph built before. The edges must be sorted by source and then by
+     * target, e.g. by a stxxl::sorter or the bufreader of a sorted edge
+     * vector; duplicates are kept. Values of the stream must support
+     * std::get<0> and std::get<1>, like std::tuple and std::pair.
+     */
+    template <typename EdgeStream>
+    void build(size_type num_nodes, EdgeStream& edges)
+    {
+        if (num_nodes > 0 &&
+            num_nodes - 1 > static_cast<size_type>(std::numeric_limits<NodeId>::max()))
+            throw foxxll::bad_parameter("compressed_graph::build(): graph is too large for the node type");
+
+        clear();
+
+        typename offset_vector_type::bufwriter_type offset_writer(m_offsets);
+        typename byte_vector_type::bufwriter_type byte_writer(m_bytes);
+
+        uint64_t end = 0;
+        offset_writer << end;
+
+        // adjacency list of the current node without its degree, and the
+        // encoded degree
+        binary_buffer list, head;
+        size_type node = 0;
+        uint64_t degree = 0;
+        NodeId prev = 0;
+
+        auto write_list = [&]() {
+                              head.clear().put_varint(degree);
+                              for (size_t i = 0; i < head.size(); ++i)
+                                  byte_writer << static_cast<uint8_t>(head.data()[i]);
+                              for (size_t i = 0; i < list.size(); ++i)
+                                  byte_writer << static_cast<uint8_t>(list.data()[i]);
+                              end += head.size() + list.size();
+                              offset_writer << end;
+                              list.clear();
+                              degree = 0;
+                              ++node;
+                          };
+
+        for ( ; !edges.empty(); ++edges)
+        {
+            const NodeId u = std::get<0>(*edges), v = std::get<1>(*edges);
+            if (static_cast<size_type>(u) >= num_nodes || static_cast<size_type>(v) >= num_nodes)
+                throw foxxll::bad_parameter("compressed_graph::build(): edge endpoint out of range");
+            if (u < node || (u == node && degree > 0 && v < prev))
+                throw foxxll::bad_parameter("compressed_graph::build(): edges are not sorted");
+
+            while (node < u)
+                write_list();
+
+            if (degree == 0)
+                list.put_varint(encode_first(u, v));
+            else
+                list.put_varint(static_cast<uint64_t>(v - prev));
+            prev = v;
+            ++degree;
+            ++m_num_edges;
+        }
+        while (node < num_nodes)
+            write_list();
+
+        offset_writer.finish();
+        byte_writer.finish();
+        m_num_nodes = num_nodes;
+    }
+
+    //! \}
+
+    //! \name Element Access
+    //! \{
+
+    //! Number of neighbors of node u.
+    size_type degree(size_type u) const
+    {
+        assert(u < m_num_nodes);
+        typename byte_vector_type::const_iterator it = m_bytes.cbegin() + offset(u);
+        return get_varint(it);
+    }
+
+    //! Read the neighbors of node u into out, in ascending order.
+    void neighbors(size_type u, std::vector<NodeId>& out) const
+    {
+        assert(u < m_num_nodes);
+        out.clear();
+        typename byte_vector_type::const_iterator it = m_bytes.cbegin() + offset(u);
+        uint64_t degree = get_varint(it);
+        if (degree == 0)
+            return;
+        out.reserve(degree);
+        out.push_back(decode_first(static_cast<NodeId>(u), get_varint(it)));
+        while (--degree > 0)
+            out.push_back(static_cast<NodeId>(out.back() + get_varint(it)));
+    }
+
+    //! \}
+
+    //! \name Streams
+    //! \{
+
+    /*!
+     * Stream of the edges (u, v) of a range of nodes, sorted by u and v,
+     * which reads the compressed lists with overlapped I/O.
+     */
+    class edge_stream
+    {
+    public:
+        using value_type = edge_type;
+
+    protected:
+        typename byte_vector_type::bufreader_type m_bytes;
+        //! next node whose list is read, and end of the range
+        size_type m_node, m_end;
+        //! neighbors of the current node left to read
+        uint64_t m_left;
+        value_type m_edge;
+        bool m_empty;
+
+        //! Decode the next edge.
+        void next()
+        {
+            if (m_left > 0)
+            {
+                --m_left;
+                std::get<1>(m_edge) = static_cast<NodeId>(
+                    std::get<1>(m_edge) + get_varint(m_bytes));
+                return;
+            }
+            while (m_node < m_end)
+            {
+                const uint64_t degree = get_varint(m_bytes);
+                const NodeId u = static_cast<NodeId>(m_node++);
+                if (degree == 0)
+                    continue;
+                m_left = degree - 1;
+                m_edge = value_type(u, decode_first(u, get_varint(m_bytes)));
+                return;
+            }
+            m_empty = true;
+        }
+
+    public:
+        //! Stream of all edges.
+        explicit edge_stream(const compressed_graph& graph)
+            : edge_stream(graph,
+                          bound_type { 0, 0 },
+                          bound_type { graph.num_nodes(), graph.bytes() })
+        { }
+
+        //! Stream of the edges of the nodes in [first, last), whose lists
+        //! are located by random access.
+        edge_stream(const compressed_graph& graph, size_type first, size_type last)
+            : edge_stream(graph,
+                          bound_type { first, graph.offset(first) },
+                          bound_type { last, graph.offset(last) })
+        { }
+
+        /*!
+         * Stream of the edges of the nodes between two bounds, e.g. of
+         * partition(). If flush_container is false, the streams of several
+         * threads may be created and used concurrently, after the graph was
+         * flushed.
+         */
+        edge_stream(const compressed_graph& graph,
+                    const bound_type& begin, const bound_type& end,
+                    bool flush_container = true)
+            : m_bytes(graph.m_bytes.cbegin() + begin.offset,
+                      graph.m_bytes.cbegin() + end.offset, 0, flush_container),
+              m_node(begin.node), m_end(end.node),
+              m_left(0), m_empty(false)
+        {
+            assert(begin.node <= end.node && end.node <= graph.num_nodes());
+            next();
+        }
+
+        //! standard stream method
+        bool empty() const { return m_empty; }
+
+        //! standard stream method
+        const value_type& operator * () const
+        {
+            assert(!empty());
+            return m_edge;
+        }
+
+        //! standard stream method
+        const value_type* operator -> () const
+        {
+            return &(operator * ());
+        }
+
+        //! standard stream method
+        edge_stream& operator ++ ()
+        {
+            assert(!empty());
+            next();
+            return *this;
+        }
+    };
+
+    //! \}
+
+    //! \name Parallel Scans
+    //! \{
+
+    /*!
+     * Split the nodes into n_parts ranges of about the same number of bytes
+     * of their lists, by binary search over the offsets. Returns the n_parts
+     * + 1 bounds of the ranges, the first at node 0 and the last at
+     * num_nodes(). A node with a long list may leave the ranges around it
+     * empty.
+     */
+    std::vector<bound_type> partition(size_t n_parts) const
+    {
+        assert(n_parts > 0);
+        std::vector<bound_type> bounds;
+        bounds.reserve(n_parts + 1);
+        bounds.push_back(bound_type { 0, 0 });
+
+        for (size_t p = 1; p < n_parts; ++p)
+        {
+            const uint64_t target = bytes() * p / n_parts;
+            // first node at or after the last bound whose list begins at or
+            // after the target
+            size_type lo = bounds.back().node, hi = m_num_nodes;
+            while (lo < hi)
+            {
+                const size_type mid = lo + (hi - lo) / 2;
+                if (offset(mid) < target)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            bounds.push_back(bound_type { lo, offset(lo) });
+        }
+
+        bounds.push_back(bound_type { m_num_nodes, bytes() });
+        return bounds;
+    }
+
+    /*!
+     * Call function(u, v) for each edge (u, v), in parallel. The nodes are
+     * split by partition() into n_parts ranges, which are scanned
+     * concurrently by edge_streams, each edge of a range in order. The graph
+     * must not be modified until it returns. function must be safe to call
+     * from several threads; task_runtime::thread_id() tells them apart for
+     * per-thread state.
+     *
+     * \param function called as function(NodeId u, NodeId v)
+     * \param n_parts number of ranges, default: the number of threads
+     */
+    template <typename Functor>
+    void for_each_parallel(Functor function, size_t n_parts = 0) const
+    {
+        if (n_parts == 0)
+            n_parts = task_runtime::get_instance().max_threads();
+
+        const std::vector<bound_type> bounds = partition(n_parts);
+
+        // the streams do not flush the page cache themselves
+        flush();
+
+        parallel_for(
+            0, n_parts, [&](size_t p) {
+                edge_stream edges(*this, bounds[p], bounds[p + 1], false);
+                for ( ; !edges.empty(); ++edges)
+                    function(std::get<0>(*edges), std::get<1>(*edges));
+            });
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_COMPRESSED_GRAPH_HEADER
@@ -0,0 +1,421 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/concurrent_queue.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_CONCURRENT_QUEUE_HEADER
+#define STXXL_CONTAINERS_CONCURRENT_QUEUE_HEADER
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include <tlx/define.hpp>
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/read_write_pool.hpp>
+#include <foxxll/mng/typed_block.hpp>
+
+#include <stxxl/bits/defines.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External FIFO queue which any number of threads may push to and pop from
+ * concurrently, e.g. to connect the stages of a pipeline.
+ *
+ * Like stxxl::queue, it keeps a head and a tail block in internal memory and
+ * the blocks between them in external memory. Producers and consumers
+ * synchronize by separate short locks: pushing locks only the tail block and
+ * popping only the head block, except when a block is full or empty. A full
+ * tail block is written out in the background through the read_write_pool,
+ * and refilling the head block reads the oldest written block, prefetching
+ * the following ones, or takes over the partially filled tail block if no
+ * block was written.
+ *
+ * pop() waits until an element is available or the queue was closed by
+ * close(), try_pop() returns immediately.
+ *
+ * \tparam ValueType type of the contained objects (POD with no references to internal memory)
+ * \tparam BlockSize size of the external memory block in bytes, default is \c STXXL_DEFAULT_BLOCK_SIZE(ValueType)
+ * \tparam AllocStr parallel disk block allocation strategy, default is \c foxxll::default_alloc_strategy
+ * \tparam SizeType size data type, default is \c external_size_type
+ */
+template <class ValueType,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
+          class AllocStr = foxxll::default_alloc_strategy,
+          class SizeType = external_size_type>
+class concurrent_queue
+{
+    static constexpr bool debug = false;
+
+public:
+    using value_type = ValueType;
+    using alloc_strategy_type = AllocStr;
+    using size_type = SizeType;
+    enum {
+        block_size = BlockSize
+    };
+
+    using block_type = foxxll::typed_block<block_size, value_type>;
+    using bid_type = foxxll::BID<block_size>;
+
+private:
+    using pool_type = foxxll::read_write_pool<block_type>;
+
+    //! \name Head block, locked by consumers
+    //! \{
+    std::mutex m_head_mutex;
+    block_type* m_head_block;
+    //! the elements [m_head_pos, m_head_end) of the head block are queued
+    size_t m_head_pos, m_head_end;
+    //! \}
+
+    //! \name Tail block, locked by producers
+    //! \{
+    std::mutex m_tail_mutex;
+    block_type* m_tail_block;
+    //! the elements [0, m_tail_end) of the tail block are queued
+    size_t m_tail_end;
+    //! \}
+
+    //! \name Blocks in external memory and the pool, locked by both
+    //! \{
+    std::mutex m_pool_mutex;
+    bool m_delete_pool;
+    pool_type* m_pool;
+    alloc_strategy_type m_alloc_strategy;
+    size_t m_alloc_count;
+    std::deque<bid_type> m_bids;
+    foxxll::block_manager* m_bm;
+    size_t m_blocks2prefetch;
+    //! \}
+
+    std::atomic<size_type> m_size;
+    std::atomic<bool> m_closed;
+
+    //! \name Consumers waiting in pop()
+    //! \{
+    std::mutex m_wait_mutex;
+    std::condition_variable m_cv;
+    std::atomic<size_t> m_waiters;
+    //! \}
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Constructs empty queue with own write and prefetch block pool.
+    //!
+    //! \param D  number of parallel disks, defaulting to the configured number of scratch disks,
+    //!           memory consumption will be 2 * D + 3 blocks
+    explicit concurrent_queue(int D = -1)
+        : m_delete_pool(true),
+          m_alloc_count(0),
+          m_bm(foxxll::block_manager::get_instance()),
+          m_size(0), m_closed(false), m_waiters(0)
+    {
+        const size_t disks =
+            (D < 1)
+            ? foxxll::config::get_instance()->disks_number()
+            : static_cast<size_t>(D);
+
+        TLX_LOG << "concurrent_queue[" << this << "]::concurrent_queue(D)";
+        m_pool = new pool_type(disks, disks + 3);
+        init();
+    }
+
+    //! Constructs empty queue with own write and prefetch block pool.
+    //!
+    //! \param w_pool_size  number of blocks in the write pool, must be at least 3, recommended at least 4
+    //! \param p_pool_size  number of blocks in the prefetch pool, recommended at least 1
+    //! \param blocks2prefetch  defines the number of blocks to prefetch (\c front side),
+    //!                         default is number of block in the prefetch pool
+    concurrent_queue(size_t w_pool_size, size_t p_pool_size, int blocks2prefetch = -1)
+        : m_delete_pool(true),
+          m_alloc_count(0),
+          m_bm(foxxll::block_manager::get_instance()),
+          m_size(0), m_closed(false), m_waiters(0)
+    {
+        TLX_LOG << "concurrent_queue[" << this << "]::concurrent_queue(sizes)";
+        m_pool = new pool_type(p_pool_size, w_pool_size);
+        init(blocks2prefetch);
+    }
+
+    //! Constructs empty queue.
+    //!
+    //! \param pool block write/prefetch pool, which the queue must not share
+    //!             with other threads
+    //! \param blocks2prefetch  defines the number of blocks to prefetch (\c front side),
+    //!                         default is number of blocks in the prefetch pool
+    //!  \warning Number of blocks in the write pool must be at least 3, recommended at least 4
+    //!  \warning Number of blocks in the prefetch pool recommended at least 1
+    explicit concurrent_queue(pool_type& pool, int blocks2prefetch = -1)
+        : m_delete_pool(false),
+          m_pool(&pool),
+          m_alloc_count(0),
+          m_bm(foxxll::block_manager::get_instance()),
+          m_size(0), m_closed(false), m_waiters(0)
+    {
+        TLX_LOG << "concurrent_queue[" << this << "]::concurrent_queue(pool)";
+        init(blocks2prefetch);
+    }
+
+    //! non-copyable: delete copy-constructor
+    concurrent_queue(const concurrent_queue&) = delete;
+    //! non-copyable: delete assignment operator
+    concurrent_queue& operator = (const concurrent_queue&) = delete;
+
+    //! Destroys the queue, no thread may access it anymore.
+    ~concurrent_queue()
+    {
+        m_pool->add(m_head_block);
+        m_pool->add(m_tail_block);
+
+        if (m_delete_pool)
+            delete m_pool;
+
+        if (!m_bids.empty())
+            m_bm->delete_blocks(m_bids.begin(), m_bids.end());
+    }
+
+    //! \}
+
+private:
+    void init(int blocks2prefetch = -1)
+    {
+        // the head and the tail block, and one block being written
+        if (m_pool->size_write() < 3) {
+            TLX_LOG1 << "concurrent_queue: invalid configuration, not enough blocks (" << m_pool->size_write() <<
+                ") in write pool, at least 3 are needed, resizing to 4";
+            m_pool->resize_write(4);
+        }
+
+        if (m_pool->size_write() < 4) {
+            TLX_LOG1 << "concurrent_queue: inefficient configuration, no blocks for buffered writing available";
+        }
+
+        if (m_pool->size_prefetch() < 1) {
+            TLX_LOG1 << "concurrent_queue: inefficient configuration, no blocks for prefetching available";
+        }
+
+        m_head_block = m_pool->steal();
+        m_head_pos = m_head_end = 0;
+        m_tail_block = m_pool->steal();
+        m_tail_end = 0;
+        set_prefetch_aggr(blocks2prefetch);
+    }
+
+    //! Writes the full tail block and replaces it by an empty one, with the
+    //! tail lock held.
+    void write_tail()
+    {
+        std::unique_lock<std::mutex> pool_lock(m_pool_mutex);
+
+        bid_type bid;
+        m_bm->new_block(m_alloc_strategy, bid, m_alloc_count++);
+
+        TLX_LOG << "concurrent_queue[" << this << "]: push block " << m_tail_block << " @ " << bid;
+        m_bids.push_back(bid);
+        m_pool->write(m_tail_block, bid);
+        if (m_bids.size() <= m_blocks2prefetch)
+            m_pool->hint(bid);
+
+        m_tail_block = m_pool->steal();
+        m_tail_end = 0;
+    }
+
+    //! Refills the empty head block, with the head lock held. Returns false
+    //! if the queue is empty.
+    bool refill_head()
+    {
+        assert(m_head_pos == m_head_end);
+
+        // the tail lock keeps producers from writing the tail block, which
+        // would queue it before the elements of the current one.
+        std::unique_lock<std::mutex> tail_lock(m_tail_mutex);
+        std::unique_lock<std::mutex> pool_lock(m_pool_mutex);
+
+        if (!m_bids.empty())
+        {
+            tail_lock.unlock();
+
+            const bid_type bid = m_bids.front();
+            m_bids.pop_front();
+
+            foxxll::request_ptr req = m_pool->read(m_head_block, bid);
+            TLX_LOG << "concurrent_queue[" << this << "]: pop block " << m_head_block << " @ " << bid;
+
+            // give prefetching hints
+            for (size_t i = 0; i < m_blocks2prefetch && i < m_bids.size(); ++i)
+                m_pool->hint(m_bids[i]);
+
+            pool_lock.unlock();
+
+            req->wait();
+            m_bm->delete_block(bid);
+
+            m_head_pos = 0;
+            m_head_end = block_type::size;
+            return true;
+        }
+
+        pool_lock.unlock();
+
+        if (m_tail_end == 0)
+            return false;
+
+        // no block in external memory: take over the tail block
+        TLX_LOG << "concurrent_queue[" << this << "]: take tail block " << m_tail_block;
+        std::swap(m_head_block, m_tail_block);
+        m_head_pos = 0;
+        m_head_end = m_tail_end;
+        m_tail_end = 0;
+        return true;
+    }
+
+    //! Wakes a consumer waiting in pop(), if any.
+    void notify_consumer()
+    {
+        if (TLX_LIKELY(m_waiters.load() == 0))
+            return;
+
+        // a consumer holds the lock from checking the size until it waits
+        { std::lock_guard<std::mutex> lock(m_wait_mutex); }
+        m_cv.notify_one();
+    }
+
+public:
+    //! \name Miscellaneous
+    //! \{
+
+    //! Defines the number of blocks to prefetch (\c front side). Not thread-safe.
+    //! This method should be called whenever the prefetch pool is resized
+    //! \param blocks2prefetch  defines the number of blocks to prefetch (\c front side),
+    //!                         a negative value means to use the number of blocks in the prefetch pool
+    void set_prefetch_aggr(int blocks2prefetch)
+    {
+        if (blocks2prefetch < 0)
+            m_blocks2prefetch = m_pool->size_prefetch();
+        else
+            m_blocks2prefetch = blocks2prefetch;
+    }
+
+    //! Returns the number of blocks prefetched from the \c front side.
+    size_t get_prefetch_aggr() const
+    {
+        return m_blocks2prefetch;
+    }
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Adds an element at the back of the queue. Must not be called after
+    //! close().
+    void push(const value_type& val)
+    {
+        {
+            std::unique_lock<std::mutex> tail_lock(m_tail_mutex);
+            assert(!m_closed.load());
+
+            if (TLX_UNLIKELY(m_tail_end == block_type::size))
+                write_tail();
+
+            (*m_tail_block)[m_tail_end++] = val;
+            ++m_size;
+        }
+        notify_consumer();
+    }
+
+    //! Removes the element at the front of the queue into val, if the queue
+    //! is not empty. Returns immediately whether an element was removed.
+    bool try_pop(value_type& val)
+    {
+        std::unique_lock<std::mutex> head_lock(m_head_mutex);
+
+        if (m_head_pos == m_head_end && !refill_head())
+            return false;
+
+        val = (*m_head_block)[m_head_pos++];
+        --m_size;
+        return true;
+    }
+
+    //! Removes the element at the front of the queue into val, waiting until
+    //! one is available. Returns false if the queue is empty and closed.
+    bool pop(value_type& val)
+    {
+        for ( ; ; )
+        {
+            if (try_pop(val))
+                return true;
+
+            std::unique_lock<std::mutex> wait_lock(m_wait_mutex);
+            ++m_waiters;
+            m_cv.wait(wait_lock, [this]() {
+                          return m_size.load() != 0 || m_closed.load();
+                      });
+            --m_waiters;
+
+            if (m_size.load() == 0 && m_closed.load())
+                return false;
+        }
+    }
+
+    //! Marks the end of the input: no element may be pushed thereafter, and
+    //! pop() returns false instead of waiting once the queue is empty.
+    void close()
+    {
+        m_closed = true;
+
+        { std::lock_guard<std::mutex> lock(m_wait_mutex); }
+        m_cv.notify_all();
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Returns the size of the queue, which other threads may change
+    //! meanwhile.
+    size_type size() const
+    {
+        return m_size.load();
+    }
+
+    //! Returns \c true if queue is empty.
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    //! Returns \c true if close() was called.
+    bool closed() const
+    {
+        return m_closed.load();
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_CONCURRENT_QUEUE_HEADER
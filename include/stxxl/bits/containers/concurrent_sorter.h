@@ -0,0 +1,384 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/concurrent_sorter.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_CONCURRENT_SORTER_HEADER
+#define STXXL_CONTAINERS_CONCURRENT_SORTER_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tlx/define.hpp>
+
+#include <stxxl/bits/stream/sort_stream.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External sorter which many threads push into concurrently.
+ *
+ * Like stxxl::sorter, the container has an input and an output phase. In the
+ * input phase, each producer thread pushes through its own pusher object,
+ * which fills a buffer in internal memory. A full buffer is sorted by the
+ * producer and handed to a background thread, which writes it as a sorted
+ * run through a runs_creator<from_sorted_sequences>. The producers only
+ * synchronize to hand over a full buffer and get an empty one, and wait only
+ * if all buffers are full and not yet written.
+ *
+ * sort() waits until all handed over buffers are written and switches to the
+ * output phase, in which a runs_merger delivers the items in sorted order
+ * with the stream interface. All pushers must be destroyed or flushed
+ * before sort().
+ *
+ * \tparam ValueType   type of the contained objects (POD with no references to internal memory)
+ * \tparam CompareType type of comparison object used for sorting the runs
+ * \tparam BlockSize   size of the external memory block in bytes, default is \c STXXL_DEFAULT_BLOCK_SIZE(ValTp)
+ * \tparam AllocStr    parallel disk block allocation strategy, default is \c foxxll::default_alloc_strategy
+ */
+template <typename ValueType,
+          typename CompareType,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
+          class AllocStrategy = foxxll::default_alloc_strategy>
+class concurrent_sorter
+{
+public:
+    // *** Template Parameters
+
+    using value_type = ValueType;
+    using cmp_type = CompareType;
+    enum {
+        block_size = BlockSize
+    };
+    using alloc_strategy_type = AllocStrategy;
+
+    // *** Constructed Types
+
+    //! runs creator type writing presorted buffers as runs
+    using runs_creator_type = stream::runs_creator<stream::from_sorted_sequences<ValueType>, cmp_type,
+                                                   block_size, alloc_strategy_type>;
+
+    //! corresponding runs merger type
+    using runs_merger_type = stream::runs_merger<typename runs_creator_type::sorted_runs_type,
+                                                 cmp_type, alloc_strategy_type>;
+
+    //! size type
+    using size_type = typename runs_merger_type::size_type;
+
+    //! buffer of a producer
+    using buffer_type = std::vector<value_type>;
+
+    /*!
+     * Push handle of one producer thread, which owns a buffer of the sorter.
+     * The destructor hands over the remaining items.
+     */
+    class pusher
+    {
+        concurrent_sorter& m_sorter;
+        buffer_type m_buffer;
+
+    public:
+        explicit pusher(concurrent_sorter& sorter)
+            : m_sorter(sorter), m_buffer(sorter.acquire_buffer())
+        { }
+
+        //! non-copyable: delete copy-constructor
+        pusher(const pusher&) = delete;
+        //! non-copyable: delete assignment operator
+        pusher& operator = (const pusher&) = delete;
+
+        ~pusher()
+        {
+            flush();
+            m_sorter.release_buffer(m_buffer);
+        }
+
+        //! Push another item, sorts and hands over the buffer when it is full.
+        void push(const value_type& val)
+        {
+            m_buffer.push_back(val);
+            if (TLX_UNLIKELY(m_buffer.size() >= m_sorter.m_buffer_elements))
+                m_sorter.submit(m_buffer);
+        }
+
+        //! Hand over the items pushed so far.
+        void flush()
+        {
+            if (!m_buffer.empty())
+                m_sorter.submit(m_buffer);
+        }
+    };
+
+protected:
+    // *** Object Attributes
+
+    //! current state of sorter
+    enum { STATE_INPUT, STATE_OUTPUT } m_state;
+
+    cmp_type m_cmp;
+
+    //! memory of the runs_creator
+    size_t m_creator_memory_to_use;
+
+    //! number of buffers and items per buffer
+    size_t m_num_buffers, m_buffer_elements;
+
+    //! runs creator used by the writer thread
+    std::unique_ptr<runs_creator_type> m_runs_creator;
+
+    //! runs merger reading items when in STATE_OUTPUT
+    runs_merger_type m_runs_merger;
+
+    //! protects the following attributes
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    //! sorted buffers waiting for the writer thread
+    std::deque<buffer_type> m_full;
+    //! written buffers for reuse
+    std::vector<buffer_type> m_free;
+    //! number of buffers in use, at most m_num_buffers
+    size_t m_buffers_allocated;
+    //! number of items handed over
+    size_type m_size;
+    //! tells the writer thread to exit once m_full is empty
+    bool m_stop;
+
+    std::thread m_writer;
+
+    //! The writer thread: writes the sorted buffers as runs.
+    void writer()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_cv.wait(lock, [this]() { return m_stop || !m_full.empty(); });
+            if (m_full.empty())
+                return;
+
+            buffer_type buffer = std::move(m_full.front());
+            m_full.pop_front();
+            lock.unlock();
+
+            for (const value_type& val : buffer)
+                m_runs_creator->push(val);
+            m_runs_creator->finish();
+            buffer.clear();
+
+            lock.lock();
+            m_free.push_back(std::move(buffer));
+            m_cv.notify_all();
+        }
+    }
+
+    //! Get an empty buffer, waits if all buffers are in use.
+    buffer_type acquire_buffer()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        assert(m_state == STATE_INPUT);
+        m_cv.wait(lock, [this]() {
+                      return !m_free.empty() || m_buffers_allocated < m_num_buffers;
+                  });
+        if (!m_free.empty())
+        {
+            buffer_type buffer = std::move(m_free.back());
+            m_free.pop_back();
+            return buffer;
+        }
+        ++m_buffers_allocated;
+        buffer_type buffer;
+        buffer.reserve(m_buffer_elements);
+        return buffer;
+    }
+
+    //! Return an unused buffer.
+    void release_buffer(buffer_type& buffer)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        assert(buffer.empty());
+        m_free.push_back(std::move(buffer));
+        m_cv.notify_all();
+    }
+
+    //! Sort the buffer, hand it to the writer thread and replace it by an
+    //! empty one.
+    void submit(buffer_type& buffer)
+    {
+        std::sort(buffer.begin(), buffer.end(), m_cmp);
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_size += buffer.size();
+            m_full.push_back(std::move(buffer));
+            m_cv.notify_all();
+        }
+        buffer = acquire_buffer();
+    }
+
+    void start_writer()
+    {
+        m_runs_creator.reset(new runs_creator_type(m_cmp, m_creator_memory_to_use));
+        m_stop = false;
+        m_size = 0;
+        m_writer = std::thread([this]() { writer(); });
+    }
+
+    //! Wait for the writer thread to write all handed over buffers.
+    void stop_writer()
+    {
+        if (!m_writer.joinable())
+            return;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+            m_cv.notify_all();
+        }
+        m_writer.join();
+    }
+
+public:
+    //! \name Constructors
+    //! \{
+
+    //! Constructor allocating memory_to_use bytes in ram: the buffers of
+    //! num_threads producers and the runs_creator, and later the
+    //! runs_merger.
+    concurrent_sorter(const cmp_type& cmp, size_t memory_to_use, size_t num_threads)
+        : m_state(STATE_INPUT),
+          m_cmp(cmp),
+          m_creator_memory_to_use(
+              std::max<size_t>(memory_to_use / 8, 2 * block_size * sort_memory_usage_factor())),
+          // a full and a filling buffer per producer
+          m_num_buffers(2 * std::max<size_t>(num_threads, 1)),
+          m_buffer_elements(std::max<size_t>(
+                                1, (memory_to_use - std::min(memory_to_use, m_creator_memory_to_use))
+                                / m_num_buffers / sizeof(value_type))),
+          m_runs_merger(cmp, memory_to_use),
+          m_buffers_allocated(0),
+          m_size(0),
+          m_stop(false)
+    {
+        start_writer();
+    }
+
+    //! non-copyable: delete copy-constructor
+    concurrent_sorter(const concurrent_sorter&) = delete;
+    //! non-copyable: delete assignment operator
+    concurrent_sorter& operator = (const concurrent_sorter&) = delete;
+
+    ~concurrent_sorter()
+    {
+        stop_writer();
+    }
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Remove all items and return to input state.
+    void clear()
+    {
+        stop_writer();
+        if (m_state == STATE_OUTPUT)
+            m_runs_merger.deallocate();
+
+        m_full.clear();
+        m_state = STATE_INPUT;
+        start_writer();
+    }
+
+    //! Switch to output state, after all pushers were flushed.
+    void sort()
+    {
+        assert(m_state == STATE_INPUT);
+        stop_writer();
+
+        // release the memory of the buffers for the runs_merger
+        m_free.clear();
+        m_buffers_allocated = 0;
+
+        m_runs_merger.initialize(m_runs_creator->result());
+        m_state = STATE_OUTPUT;
+    }
+
+    //! Rewind output stream to beginning.
+    void rewind()
+    {
+        assert(m_state == STATE_OUTPUT);
+        m_runs_merger.deallocate();
+        m_runs_merger.initialize(m_runs_creator->result());
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Number of items handed over by the pushers, or items remaining to be
+    //! read.
+    size_type size()
+    {
+        if (m_state == STATE_OUTPUT)
+            return m_runs_merger.size();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_size;
+    }
+
+    //! Number of items per buffer, which are sorted into one run
+    size_t num_els_in_buffer() const { return m_buffer_elements; }
+
+    //! Standard stream method
+    bool empty() const
+    {
+        assert(m_state == STATE_OUTPUT);
+        return m_runs_merger.empty();
+    }
+
+    //! \}
+
+    //! \name Operators
+    //! \{
+
+    //! Standard stream method
+    const value_type& operator * () const
+    {
+        assert(m_state == STATE_OUTPUT);
+        return *m_runs_merger;
+    }
+
+    //! Standard stream method
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method (preincrement operator)
+    concurrent_sorter& operator ++ ()
+    {
+        assert(m_state == STATE_OUTPUT);
+        ++m_runs_merger;
+        return *this;
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_CONCURRENT_SORTER_HEADER
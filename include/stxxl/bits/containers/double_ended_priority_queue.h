@@ -0,0 +1,559 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/double_ended_priority_queue.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_DOUBLE_ENDED_PRIORITY_QUEUE_HEADER
+#define STXXL_CONTAINERS_DOUBLE_ENDED_PRIORITY_QUEUE_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+#include <tlx/math/integer_log2.hpp>
+
+#include <foxxll/mng/read_write_pool.hpp>
+
+#include <stxxl/bits/containers/sequence.h>
+#include <stxxl/bits/defines.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External double-ended priority queue: top_min() and pop_min() access an
+ * element with the smallest key, top_max() and pop_max() one with the
+ * largest key. With a bound, a push() into a full queue evicts the largest
+ * element, which keeps the bound smallest elements pushed, as for a beam
+ * search or top-N selection.
+ *
+ * Pushed elements go into an internal min-max heap. When it is full, its
+ * smallest and largest quarter stay in memory, and its middle half is
+ * sorted and written to external memory as a run, an stxxl::sequence from
+ * whose front the minima and from whose back the maxima are popped. Hence
+ * both ends of the queue are served from memory while the pushed elements
+ * are spread around the middle. Like the groups of stxxl::priority_queue,
+ * the runs are merged by levels: once there are run_arity runs of one level,
+ * they are merged into a run of the next level, so that each element is
+ * written once per level. The smallest front and largest back of the runs
+ * are found by scanning them, at most run_arity per level, whenever the run
+ * they were taken from changed.
+ *
+ * Each run holds its front and back block in memory, taken from a block
+ * pool shared by the runs, which grows by two blocks per run.
+ *
+ * \tparam ValueType type of the contained objects (POD with no references to
+ *   internal memory)
+ * \tparam CompareType strict weak ordering, smaller elements are the minima
+ * \tparam BlockSize size of the external memory blocks in bytes
+ * \tparam AllocStr parallel disk block allocation strategy
+ */
+template <class ValueType,
+          class CompareType = std::less<ValueType>,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
+          class AllocStr = foxxll::default_alloc_strategy>
+class double_ended_priority_queue
+{
+    static constexpr bool debug = false;
+
+public:
+    //! The type of object stored in the double_ended_priority_queue.
+    using value_type = ValueType;
+    //! Comparison object.
+    using comparator_type = CompareType;
+    using size_type = external_size_type;
+
+    //! type of the runs
+    using sequence_type = sequence<value_type, BlockSize, AllocStr>;
+    using block_type = typename sequence_type::block_type;
+    using pool_type = foxxll::read_write_pool<block_type>;
+
+protected:
+    //! a run sorted ascendingly and its level
+    struct run_type
+    {
+        std::unique_ptr<sequence_type> seq;
+        size_t level;
+    };
+
+    static constexpr size_t no_run = std::numeric_limits<size_t>::max();
+
+    //! the comparator object
+    comparator_type m_cmp;
+
+    //! internal min-max heap: the elements on even levels are smaller than
+    //! their descendants, those on odd levels larger
+    std::vector<value_type> m_heap;
+
+    //! number of elements held by the heap before it is spilled
+    size_t m_heap_capacity;
+
+    //! number of runs of a level merged into a run of the next level
+    size_t m_run_arity;
+
+    //! maximum size, 0 if unbounded
+    size_type m_bound;
+
+    //! block pool shared by the runs, grows by two blocks per run, declared
+    //! before them as they return their blocks on destruction
+    pool_type m_pool;
+
+    //! number of runs the pool has blocks for
+    size_t m_pool_runs;
+
+    //! runs in external memory
+    std::vector<run_type> m_runs;
+
+    //! run with the smallest front and run with the largest back, or no_run
+    //! if they have to be determined
+    size_t m_min_run, m_max_run;
+
+    //! number of elements
+    size_type m_size;
+
+    //! \name Internal min-max heap
+    //! \{
+
+    static bool is_min_level(size_t i)
+    {
+        return tlx::integer_log2_floor(static_cast<uint64_t>(i + 1)) % 2 == 0;
+    }
+
+    //! Moves the element at i up while it is smaller (Less = true) or larger
+    //! than its grandparent.
+    template <bool Less>
+    void bubble_up_grandparent(size_t i)
+    {
+        while (i >= 3)
+        {
+            const size_t gp = ((i - 1) / 2 - 1) / 2;
+            if (!(Less ? m_cmp(m_heap[i], m_heap[gp]) : m_cmp(m_heap[gp], m_heap[i])))
+                break;
+            std::swap(m_heap[i], m_heap[gp]);
+            i = gp;
+        }
+    }
+
+    void bubble_up(size_t i)
+    {
+        if (i == 0)
+            return;
+        const size_t p = (i - 1) / 2;
+        if (is_min_level(i))
+        {
+            if (m_cmp(m_heap[p], m_heap[i]))
+            {
+                std::swap(m_heap[i], m_heap[p]);
+                bubble_up_grandparent<false>(p);
+            }
+            else
+                bubble_up_grandparent<true>(i);
+        }
+        else
+        {
+            if (m_cmp(m_heap[i], m_heap[p]))
+            {
+                std::swap(m_heap[i], m_heap[p]);
+                bubble_up_grandparent<true>(p);
+            }
+            else
+                bubble_up_grandparent<false>(i);
+        }
+    }
+
+    //! Moves the element at i down on the min levels (Less = true) or on the
+    //! max levels.
+    template <bool Less>
+    void trickle_down(size_t i)
+    {
+        auto before = [this](const value_type& a, const value_type& b) {
+                          return Less ? m_cmp(a, b) : m_cmp(b, a);
+                      };
+
+        const size_t n = m_heap.size();
+        while (2 * i + 1 < n)
+        {
+            // the smallest (largest) of the children and grandchildren
+            size_t m = 2 * i + 1;
+            if (m + 1 < n && before(m_heap[m + 1], m_heap[m]))
+                m = m + 1;
+            for (size_t g = 4 * i + 3; g < std::min(4 * i + 7, n); ++g)
+            {
+                if (before(m_heap[g], m_heap[m]))
+                    m = g;
+            }
+
+            if (!before(m_heap[m], m_heap[i]))
+                return;
+            std::swap(m_heap[m], m_heap[i]);
+            if (m <= 2 * i + 2)
+                return;
+
+            // a grandchild: its parent is on the other kind of level
+            const size_t p = (m - 1) / 2;
+            if (before(m_heap[p], m_heap[m]))
+                std::swap(m_heap[m], m_heap[p]);
+            i = m;
+        }
+    }
+
+    void heap_push(const value_type& obj)
+    {
+        m_heap.push_back(obj);
+        bubble_up(m_heap.size() - 1);
+    }
+
+    //! Index of a largest element of the non-empty heap.
+    size_t heap_max() const
+    {
+        if (m_heap.size() <= 2)
+            return m_heap.size() - 1;
+        return m_cmp(m_heap[1], m_heap[2]) ? 2 : 1;
+    }
+
+    //! Removes the heap element at i, the minimum or the maximum.
+    void heap_erase(size_t i)
+    {
+        m_heap[i] = m_heap.back();
+        m_heap.pop_back();
+        if (i >= m_heap.size())
+            return;
+        if (is_min_level(i))
+            trickle_down<true>(i);
+        else
+            trickle_down<false>(i);
+    }
+
+    //! \}
+
+    //! \name Runs
+    //! \{
+
+    //! Run with the smallest front.
+    size_t min_run()
+    {
+        if (m_min_run == no_run && !m_runs.empty())
+        {
+            m_min_run = 0;
+            for (size_t r = 1; r < m_runs.size(); ++r)
+            {
+                if (m_cmp(m_runs[r].seq->front(), m_runs[m_min_run].seq->front()))
+                    m_min_run = r;
+            }
+        }
+        return m_min_run;
+    }
+
+    //! Run with the largest back.
+    size_t max_run()
+    {
+        if (m_max_run == no_run && !m_runs.empty())
+        {
+            m_max_run = 0;
+            for (size_t r = 1; r < m_runs.size(); ++r)
+            {
+                if (m_cmp(m_runs[m_max_run].seq->back(), m_runs[r].seq->back()))
+                    m_max_run = r;
+            }
+        }
+        return m_max_run;
+    }
+
+    //! Whether the minimum is in a run rather than in the heap.
+    bool min_in_run()
+    {
+        const size_t r = min_run();
+        return r != no_run &&
+               (m_heap.empty() || m_cmp(m_runs[r].seq->front(), m_heap.front()));
+    }
+
+    //! Whether the maximum is in a run rather than in the heap.
+    bool max_in_run()
+    {
+        const size_t r = max_run();
+        return r != no_run &&
+               (m_heap.empty() || m_cmp(m_heap[heap_max()], m_runs[r].seq->back()));
+    }
+
+    //! Creates an empty run, growing the pool if there are more runs than
+    //! ever before.
+    std::unique_ptr<sequence_type> new_run()
+    {
+        if (m_runs.size() + 1 > m_pool_runs)
+        {
+            m_pool.resize_write(m_pool.size_write() + 2);
+            ++m_pool_runs;
+        }
+        return std::unique_ptr<sequence_type>(new sequence_type(m_pool));
+    }
+
+    //! Removes the empty run r.
+    void erase_run(size_t r)
+    {
+        assert(m_runs[r].seq->empty());
+        m_runs.erase(m_runs.begin() + r);
+        m_min_run = m_max_run = no_run;
+    }
+
+    //! Adds a run of the given level and merges the runs of a level that
+    //! reached run_arity.
+    void add_run(std::unique_ptr<sequence_type>&& seq, size_t level)
+    {
+        m_runs.push_back(run_type { std::move(seq), level });
+        m_min_run = m_max_run = no_run;
+
+        while (true)
+        {
+            std::vector<size_t> same;
+            for (size_t r = 0; r < m_runs.size(); ++r)
+            {
+                if (m_runs[r].level == level)
+                    same.push_back(r);
+            }
+            if (same.size() < m_run_arity)
+                return;
+
+            merge_runs(same, level + 1);
+            ++level;
+        }
+    }
+
+    //! Merges the given runs into one run of the given level.
+    void merge_runs(const std::vector<size_t>& which, size_t level)
+    {
+        std::vector<std::unique_ptr<sequence_type> > inputs;
+        for (size_t i = which.size(); i-- > 0; )
+        {
+            inputs.push_back(std::move(m_runs[which[i]].seq));
+            m_runs.erase(m_runs.begin() + which[i]);
+        }
+
+        TLX_LOG << "double_ended_priority_queue::merge_runs() " << inputs.size()
+                << " runs into level " << level;
+
+        std::unique_ptr<sequence_type> out = new_run();
+        while (true)
+        {
+            size_t m = no_run;
+            for (size_t i = 0; i < inputs.size(); ++i)
+            {
+                if (!inputs[i]->empty() &&
+                    (m == no_run || m_cmp(inputs[i]->front(), inputs[m]->front())))
+                    m = i;
+            }
+            if (m == no_run)
+                break;
+            out->push_back(inputs[m]->front());
+            inputs[m]->pop_front();
+        }
+        inputs.clear();
+
+        m_runs.push_back(run_type { std::move(out), level });
+        m_min_run = m_max_run = no_run;
+    }
+
+    //! Keeps the smallest and largest quarter of the full heap and writes
+    //! the middle half as a run of level 0.
+    void spill()
+    {
+        std::vector<value_type> values;
+        std::swap(values, m_heap);
+
+        const size_t quarter = values.size() / 4;
+        std::nth_element(values.begin(), values.begin() + quarter, values.end(), m_cmp);
+        std::nth_element(values.begin() + quarter, values.end() - quarter, values.end(), m_cmp);
+        std::sort(values.begin() + quarter, values.end() - quarter, m_cmp);
+
+        TLX_LOG << "double_ended_priority_queue::spill() "
+                << values.size() - 2 * quarter << " elements";
+
+        std::unique_ptr<sequence_type> seq = new_run();
+        seq->push_back(values.begin() + quarter, values.end() - quarter);
+
+        m_heap.reserve(m_heap_capacity);
+        for (size_t i = 0; i < quarter; ++i)
+            heap_push(values[i]);
+        for (size_t i = values.size() - quarter; i < values.size(); ++i)
+            heap_push(values[i]);
+
+        add_run(std::move(seq), 0);
+    }
+
+    //! Inserts the element, spilling the heap if it is full.
+    void insert(const value_type& obj)
+    {
+        if (m_heap.size() >= m_heap_capacity)
+            spill();
+        heap_push(obj);
+        ++m_size;
+    }
+
+    //! \}
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Constructs an empty queue.
+    //!
+    //! \param bound maximum number of elements, 0 for an unbounded queue
+    //! \param heap_capacity number of elements held in internal memory, at
+    //!   least 4
+    //! \param run_arity number of runs of a level merged into one, at least 2
+    //! \param cmp comparator object
+    //! \param w_pool_size number of blocks for buffered writing, in addition
+    //!   to the two blocks held by each run
+    //! \param p_pool_size number of blocks for prefetching
+    explicit double_ended_priority_queue(
+        const size_type bound = 0,
+        const size_t heap_capacity = 1024 * 1024,
+        const size_t run_arity = 16,
+        const comparator_type& cmp = comparator_type(),
+        const size_t w_pool_size = 2, const size_t p_pool_size = 2)
+        : m_cmp(cmp),
+          m_heap_capacity(std::max<size_t>(heap_capacity, 4)),
+          m_run_arity(std::max<size_t>(run_arity, 2)),
+          m_bound(bound),
+          m_pool(p_pool_size, w_pool_size),
+          m_pool_runs(0),
+          m_min_run(no_run),
+          m_max_run(no_run),
+          m_size(0)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    double_ended_priority_queue(const double_ended_priority_queue&) = delete;
+    //! non-copyable: delete assignment operator
+    double_ended_priority_queue& operator = (const double_ended_priority_queue&) = delete;
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Returns number of elements contained.
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    //! Returns true if queue has no elements.
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    //! Returns the maximum number of elements, 0 if unbounded.
+    size_type bound() const
+    {
+        return m_bound;
+    }
+
+    //! Returns the number of runs in external memory.
+    size_t num_runs() const
+    {
+        return m_runs.size();
+    }
+
+    //! \}
+
+    //! \name Operators
+    //! \{
+
+    //! Returns an element with the smallest key. Precondition: \c empty() is
+    //! false. Not const, as it may determine the run with the smallest front.
+    const value_type & top_min()
+    {
+        assert(!empty());
+        if (min_in_run())
+            return m_runs[m_min_run].seq->front();
+        return m_heap.front();
+    }
+
+    //! Returns an element with the largest key. Precondition: \c empty() is
+    //! false. Not const, as it may determine the run with the largest back.
+    const value_type & top_max()
+    {
+        assert(!empty());
+        if (max_in_run())
+            return m_runs[m_max_run].seq->back();
+        return m_heap[heap_max()];
+    }
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Inserts the element. If the queue is bounded and full, the largest of
+    //! its elements and obj is dropped.
+    void push(const value_type& obj)
+    {
+        if (m_bound != 0 && m_size >= m_bound)
+        {
+            if (!m_cmp(obj, top_max()))
+                return;
+            pop_max();
+        }
+        insert(obj);
+    }
+
+    //! Removes an element with the smallest key. Precondition: \c empty() is
+    //! false.
+    void pop_min()
+    {
+        assert(!empty());
+        if (min_in_run())
+        {
+            sequence_type& seq = *m_runs[m_min_run].seq;
+            seq.pop_front();
+            if (seq.empty())
+                erase_run(m_min_run);
+            else
+                m_min_run = no_run;
+        }
+        else
+            heap_erase(0);
+        --m_size;
+    }
+
+    //! Removes an element with the largest key. Precondition: \c empty() is
+    //! false.
+    void pop_max()
+    {
+        assert(!empty());
+        if (max_in_run())
+        {
+            sequence_type& seq = *m_runs[m_max_run].seq;
+            seq.pop_back();
+            if (seq.empty())
+                erase_run(m_max_run);
+            else
+                m_max_run = no_run;
+        }
+        else
+            heap_erase(heap_max());
+        --m_size;
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_DOUBLE_ENDED_PRIORITY_QUEUE_HEADER
@@ -0,0 +1,735 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/dynamic_priority_queue.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_DYNAMIC_PRIORITY_QUEUE_HEADER
+#define STXXL_CONTAINERS_DYNAMIC_PRIORITY_QUEUE_HEADER
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+
+#include <stxxl/bits/containers/pq_ext_merger.h>
+#include <stxxl/bits/containers/pq_helpers.h>
+#include <stxxl/bits/containers/pq_int_merger.h>
+#include <stxxl/bits/containers/pq_mergers.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External priority queue like stxxl::priority_queue, but the length of the
+ * group buffers, the size of the delete buffer, the arities of the mergers
+ * and the number of groups are runtime parameters, so that the queue can be
+ * sized from the memory available at startup. The group mergers and buffers
+ * are allocated on the heap.
+ *
+ * The block size of the external mergers remains a template parameter, since
+ * the blocks and pools are typed by it; the arities are bounded by the
+ * template parameters MaxIntArity and MaxExtArity, which only determine the
+ * size of small per-sequence arrays. The external mergers allocate one block
+ * per sequence of their runtime arity.
+ *
+ * \tparam ValueType type of the contained objects (POD with no references to
+ *   internal memory)
+ * \tparam CompareTypeWithMin comparator with a min_value() sentinel, see
+ *   stxxl::priority_queue
+ * \tparam BlockSize external block size in bytes
+ * \tparam MaxIntArity upper bound of the arity of the internal mergers
+ * \tparam MaxExtArity upper bound of the arity of the external mergers
+ * \tparam AllocStr block allocation strategy
+ */
+template <class ValueType,
+          class CompareTypeWithMin,
+          size_t BlockSize = (2* 1024* 1024),
+          unsigned MaxIntArity = 256,
+          unsigned MaxExtArity = 1024,
+          class AllocStr = foxxll::default_alloc_strategy>
+class dynamic_priority_queue
+{
+    static constexpr bool debug = false;
+
+public:
+    //! The type of object stored in the priority_queue.
+    using value_type = ValueType;
+    //! Comparison object.
+    using comparator_type = CompareTypeWithMin;
+    using alloc_strategy_type = AllocStr;
+    using size_type = external_size_type;
+    //! Type of the block used in disk-memory transfers
+    using block_type = foxxll::typed_block<BlockSize, value_type>;
+    using pool_type = foxxll::read_write_pool<block_type>;
+
+    //! maximum number of groups merged into the delete buffer
+    static constexpr size_t max_groups = 4;
+
+    //! Runtime parameters of the queue, see priority_queue_config.
+    struct parameters
+    {
+        //! size of the delete buffer
+        size_t delete_buffer_size = 32;
+        //! length of the group buffers and the sequences of group 1
+        size_t N = 512;
+        //! arity of the internal mergers, at most MaxIntArity
+        size_t int_arity = 64;
+        //! number of internal groups
+        size_t num_int_groups = 2;
+        //! arity of the external mergers, at most MaxExtArity
+        size_t ext_arity = 64;
+        //! number of external groups
+        size_t num_ext_groups = 2;
+
+        /*!
+         * Compute the parameters for the given internal memory and maximum
+         * number of elements like PRIORITY_QUEUE_GENERATOR does at compile
+         * time, for the block size of this queue.
+         *
+         * \param int_memory upper limit of the internal memory in bytes, not
+         *   including the pools
+         * \param max_items upper limit of the number of elements
+         * \param tune start arity of the internal mergers is 2^tune
+         */
+        static parameters from_memory(size_t int_memory, external_size_type max_items,
+                                      unsigned tune = 6)
+        {
+            const size_t element_size = sizeof(value_type);
+            const external_size_type kilo_items = foxxll::div_ceil(max_items, 1024);
+            const size_t B = BlockSize;
+            const size_t k = int_memory / B;
+
+            // number of blocks of the external merger buffers, see find_B_m
+            size_t m = 1;
+            for ( ; m < k; ++m)
+            {
+                const bool fits =
+                    (k - m > 10) &&
+                    (external_size_type(k - m) * m * (m * B / (element_size * 4 * 1024)) >= kilo_items) &&
+                    (kilo_items < external_size_type((k - m) * m / (2 * element_size)) * 1024 || m >= 128);
+                if (fits)
+                    break;
+            }
+            if (m >= k)
+            {
+                FOXXLL_THROW2(std::runtime_error, "dynamic_priority_queue::parameters::from_memory()",
+                              "no parameters found for " << int_memory << " bytes of internal memory and "
+                                                         << max_items << " items, increase the memory");
+            }
+
+            // number of elements in the internal groups, see compute_N
+            const size_t X = B * (k - m) / element_size;
+            size_t AI = size_t(1) << tune;
+            while (AI > 1 && X / (AI * AI) < 4 * 32)
+                AI /= 2;
+            if (AI == 1)
+            {
+                FOXXLL_THROW2(std::runtime_error, "dynamic_priority_queue::parameters::from_memory()",
+                              "no parameters found, try to change the tune parameter");
+            }
+
+            parameters p;
+            p.delete_buffer_size = 32;
+            p.N = X / (AI * AI);
+            p.int_arity = std::min<size_t>(AI, MaxIntArity);
+            p.num_int_groups = 2;
+            p.ext_arity = std::min<size_t>(std::max<size_t>(m / 2, 2), MaxExtArity);
+            p.num_ext_groups = 2;
+            return p;
+        }
+    };
+
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Constructs external priority queue object.
+    //! \param pool_ pool of blocks that will be used
+    //! for data writing and prefetching for the disk<->memory transfers
+    //! happening in the priority queue.
+    //! \param params_ runtime parameters of the queue
+    dynamic_priority_queue(pool_type& pool_,
+                           const parameters& params_ = parameters(),
+                           const comparator_type& comp_ = comparator_type())
+        : cmp(comp_),
+          params(params_),
+          pool(&pool_),
+          pool_owned(false),
+          insert_heap(params_.N + 2, comp_),
+          num_active_groups(0), size_(0)
+    {
+        TLX_LOG << "dynamic_priority_queue(pool)";
+        init();
+    }
+
+    //! Constructs external priority queue object.
+    //! \param p_pool_mem memory (in bytes) for prefetch pool
+    //! \param w_pool_mem memory (in bytes) for buffered write pool
+    //! \param params_ runtime parameters of the queue
+    dynamic_priority_queue(const size_t p_pool_mem, const size_t w_pool_mem,
+                           const parameters& params_ = parameters(),
+                           const comparator_type& comp_ = comparator_type())
+        : cmp(comp_),
+          params(params_),
+          pool(new pool_type(p_pool_mem / BlockSize, w_pool_mem / BlockSize)),
+          pool_owned(true),
+          insert_heap(params_.N + 2, comp_),
+          num_active_groups(0), size_(0)
+    {
+        TLX_LOG << "dynamic_priority_queue(pool sizes)";
+        init();
+    }
+
+    //! non-copyable: delete copy-constructor
+    dynamic_priority_queue(const dynamic_priority_queue&) = delete;
+    //! non-copyable: delete assignment operator
+    dynamic_priority_queue& operator = (const dynamic_priority_queue&) = delete;
+
+    ~dynamic_priority_queue()
+    {
+        TLX_LOG << "~dynamic_priority_queue()";
+        // destroy the external mergers before their pool
+        ext_mergers.clear();
+        if (pool_owned)
+            delete pool;
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Returns number of elements contained.
+    size_type size() const
+    {
+        return size_ +
+               insert_heap.size() - 1 +
+               (delete_buffer_end - delete_buffer_current_min);
+    }
+
+    //! Returns true if queue has no elements.
+    bool empty() const { return (size() == 0); }
+
+    //! \}
+
+    //! \name Operators
+    //! \{
+
+    //! Returns "largest" element, see priority_queue::top().
+    const value_type & top() const
+    {
+        assert(!insert_heap.empty());
+
+        const value_type& t = insert_heap.top();
+        if (cmp(*delete_buffer_current_min, t))
+            return t;
+        else
+            return *delete_buffer_current_min;
+    }
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Removes the element at the top.
+    void pop()
+    {
+        assert(!insert_heap.empty());
+
+        if (cmp(*delete_buffer_current_min, insert_heap.top()))
+            insert_heap.pop();
+        else
+        {
+            assert(delete_buffer_current_min < delete_buffer_end);
+            ++delete_buffer_current_min;
+            if (delete_buffer_current_min == delete_buffer_end)
+                refill_delete_buffer();
+        }
+    }
+
+    //! Inserts x into the priority_queue.
+    void push(const value_type& obj)
+    {
+        assert(!int_mergers[0]->is_sentinel(obj));
+        if (insert_heap.size() == params.N + 1)
+            empty_insert_heap();
+
+        assert(!insert_heap.empty());
+
+        insert_heap.push(obj);
+    }
+
+    //! \}
+
+    //! \name Miscellaneous
+    //! \{
+
+    //! The runtime parameters of the queue.
+    const parameters & get_parameters() const
+    {
+        return params;
+    }
+
+    //! Number of bytes consumed by the \b priority_queue from the internal
+    //! memory not including pools (see the constructor)
+    size_t mem_cons() const
+    {
+        size_t dynam_alloc_mem = 0;
+        for (size_t i = 0; i < params.num_int_groups; ++i)
+            dynam_alloc_mem += int_mergers[i]->mem_cons();
+
+        for (size_t i = 0; i < params.num_ext_groups; ++i)
+            dynam_alloc_mem += ext_mergers[i]->mem_cons();
+
+        return (sizeof(*this) +
+                sizeof(int_merger_type) * params.num_int_groups +
+                sizeof(ext_merger_type) * params.num_ext_groups +
+                (group_buffers.size() + delete_buffer.size() + temp_buffer.size())
+                * sizeof(value_type) +
+                dynam_alloc_mem);
+    }
+
+    void dump_params() const
+    {
+        TLX_LOG1 << "params: delete_buffer_size=" << params.delete_buffer_size
+                 << " N=" << params.N
+                 << " int_arity=" << params.int_arity
+                 << " num_int_groups=" << params.num_int_groups
+                 << " ext_arity=" << params.ext_arity
+                 << " num_ext_groups=" << params.num_ext_groups
+                 << " BlockSize=" << BlockSize;
+    }
+
+    //! \}
+
+protected:
+    using insert_heap_type = priority_queue_local::internal_priority_queue<
+              value_type, std::vector<value_type>, comparator_type>;
+    using int_merger_type = priority_queue_local::int_merger<
+              value_type, comparator_type, MaxIntArity>;
+    using ext_merger_type = priority_queue_local::ext_merger<
+              block_type, comparator_type, MaxExtArity, alloc_strategy_type>;
+
+    comparator_type cmp;
+
+    parameters params;
+
+    std::vector<std::unique_ptr<int_merger_type> > int_mergers;
+
+    pool_type* pool;
+    bool pool_owned;
+    std::vector<std::unique_ptr<ext_merger_type> > ext_mergers;
+
+    //! one delete buffer for each tree of N + 1 elements (extra space for
+    //! sentinel): tree->group_buffers->delete_buffer
+    std::vector<value_type> group_buffers;
+    //! current start of each group buffer, its end is group_buffer(i) + N
+    std::vector<value_type*> group_buffer_current_mins;
+
+    // overall delete buffer
+    std::vector<value_type> delete_buffer;
+    value_type* delete_buffer_current_min;                     // current start of delete_buffer
+    value_type* delete_buffer_end;                             // end of delete_buffer
+
+    //! temporary storage of empty_insert_heap()
+    std::vector<value_type> temp_buffer;
+
+    // insert buffer
+    insert_heap_type insert_heap;
+
+    // how many groups are active
+    size_t num_active_groups;
+
+    // total size not counting insert_heap and delete_buffer
+    size_type size_;
+
+    size_t total_num_groups() const
+    {
+        return params.num_int_groups + params.num_ext_groups;
+    }
+
+    value_type * group_buffer(const size_t i)
+    {
+        return group_buffers.data() + i * (params.N + 1);
+    }
+
+    const value_type * group_buffer(const size_t i) const
+    {
+        return group_buffers.data() + i * (params.N + 1);
+    }
+
+    value_type * group_buffer_end(const size_t i)
+    {
+        return group_buffer(i) + params.N;
+    }
+
+private:
+    void init()
+    {
+        assert(!cmp(cmp.min_value(), cmp.min_value())); // verify strict weak ordering
+
+        if (params.delete_buffer_size == 0 || params.N < params.delete_buffer_size)
+        {
+            FOXXLL_THROW2(std::runtime_error, "dynamic_priority_queue::init()",
+                          "N=" << params.N << " must be at least the delete buffer size "
+                               << params.delete_buffer_size << " > 0");
+        }
+        if (params.num_int_groups == 0 || params.num_ext_groups == 0 ||
+            total_num_groups() > max_groups)
+        {
+            FOXXLL_THROW2(std::runtime_error, "dynamic_priority_queue::init()",
+                          "at least one internal and one external group are required, "
+                          "at most " << max_groups << " groups in total");
+        }
+        if (params.int_arity < 2 || params.int_arity > MaxIntArity ||
+            params.ext_arity < 2 || params.ext_arity > MaxExtArity)
+        {
+            FOXXLL_THROW2(std::runtime_error, "dynamic_priority_queue::init()",
+                          "merger arities int_arity=" << params.int_arity
+                                                      << " ext_arity=" << params.ext_arity
+                                                      << " are out of range");
+        }
+
+        int_mergers.reserve(params.num_int_groups);
+        for (size_t j = 0; j < params.num_int_groups; ++j)
+            int_mergers.emplace_back(new int_merger_type(cmp, params.int_arity));
+
+        ext_mergers.reserve(params.num_ext_groups);
+        for (size_t j = 0; j < params.num_ext_groups; ++j)
+        {
+            ext_mergers.emplace_back(new ext_merger_type(cmp, params.ext_arity));
+            ext_mergers[j]->set_pool(pool);
+        }
+
+        value_type sentinel = cmp.min_value();
+        insert_heap.push(sentinel);                                // always keep the sentinel
+
+        delete_buffer.resize(params.delete_buffer_size + 1);
+        delete_buffer[params.delete_buffer_size] = sentinel;       // sentinel
+        delete_buffer_end = delete_buffer.data() + params.delete_buffer_size;
+        delete_buffer_current_min = delete_buffer_end;             // empty
+
+        group_buffers.resize(total_num_groups() * (params.N + 1));
+        group_buffer_current_mins.resize(total_num_groups());
+        for (size_t i = 0; i < total_num_groups(); i++)
+        {
+            *group_buffer_end(i) = sentinel;                       // sentinel
+            group_buffer_current_mins[i] = group_buffer_end(i);    // empty
+        }
+
+        temp_buffer.resize(params.N + params.delete_buffer_size + 1);
+    }
+
+    void refill_delete_buffer()
+    {
+        TLX_LOG << "refill_delete_buffer()";
+
+        const size_t delete_buffer_size = params.delete_buffer_size;
+
+        size_type total_group_size = 0;
+        for (size_t i = num_active_groups; i > 0; )
+        {
+            --i;
+            if (current_group_buffer_size(i) < delete_buffer_size)
+            {
+                size_type length = refill_group_buffer(i);
+                // max active level dry now?
+                if (length == 0 && i == num_active_groups - 1)
+                    --num_active_groups;
+
+                total_group_size += length;
+            }
+            else
+                total_group_size += delete_buffer_size;  // actually only a sufficient lower bound
+        }
+
+        size_type length;
+        if (total_group_size >= delete_buffer_size)      // buffer can be filled completely
+        {
+            length = delete_buffer_size;                 // amount to be copied
+            size_ -= size_type(delete_buffer_size);      // amount left in group_buffers
+        }
+        else
+        {
+            length = total_group_size;
+            assert(size_ == length); // trees and group_buffers get empty
+            size_ = 0;
+        }
+
+        // now call simplified refill routines
+        // which can make the assumption that
+        // they find all they are asked in the buffers
+        delete_buffer_current_min = delete_buffer_end - length;
+        TLX_LOG << "refill_del... Active groups = " << num_active_groups;
+#if STXXL_PARALLEL && STXXL_PARALLEL_PQ_MULTIWAY_MERGE_DELETE_BUFFER
+        if (num_active_groups > 1)
+        {
+            priority_queue_local::invert_order<comparator_type, value_type, value_type> inv_cmp(cmp);
+
+            std::pair<value_type*, value_type*> seqs[max_groups];
+            for (size_t i = 0; i < num_active_groups; ++i)
+                seqs[i] = std::make_pair(group_buffer_current_mins[i], group_buffer_end(i));
+
+            potentially_parallel::multiway_merge_sentinels(
+                seqs, seqs + num_active_groups, delete_buffer_current_min, length, inv_cmp);
+            // sequence iterators are progressed appropriately
+
+            for (size_t i = 0; i < num_active_groups; ++i)
+                group_buffer_current_mins[i] = seqs[i].first;
+            return;
+        }
+#endif
+        switch (num_active_groups)
+        {
+        case 0:
+            break;
+        case 1:
+            std::copy(group_buffer_current_mins[0], group_buffer_current_mins[0] + length, delete_buffer_current_min);
+            group_buffer_current_mins[0] += length;
+            break;
+        case 2:
+            priority_queue_local::merge2_iterator(
+                group_buffer_current_mins[0], group_buffer_current_mins[1],
+                delete_buffer_current_min, delete_buffer_current_min + length, cmp);
+            break;
+        case 3:
+            priority_queue_local::merge3_iterator(
+                group_buffer_current_mins[0],
+                group_buffer_current_mins[1],
+                group_buffer_current_mins[2],
+                delete_buffer_current_min, delete_buffer_current_min + length, cmp);
+            break;
+        case 4:
+            priority_queue_local::merge4_iterator(
+                group_buffer_current_mins[0],
+                group_buffer_current_mins[1],
+                group_buffer_current_mins[2],
+                group_buffer_current_mins[3],
+                delete_buffer_current_min, delete_buffer_current_min + length, cmp);
+            break;
+        default:
+            FOXXLL_THROW2(std::runtime_error, "dynamic_priority_queue<...>::refill_delete_buffer()",
+                          "Overflow! The number of groups is limited to " << max_groups);
+        }
+    }
+
+    size_type refill_group_buffer(const size_t group)
+    {
+        TLX_LOG << "refill_group_buffer(" << group << ")";
+
+        const size_t N = params.N;
+        value_type* target;
+        size_type length;
+        size_type group_size = (group < params.num_int_groups) ?
+                               int_mergers[group]->size() :
+                               ext_mergers[group - params.num_int_groups]->size(); // elements left in segments
+        size_t left_elements = current_group_buffer_size(group);                   // elements left in target buffer
+        if (group_size + left_elements >= size_type(N))
+        {                                                                          // buffer will be filled completely
+            target = group_buffer(group);
+            length = N - left_elements;
+        }
+        else
+        {
+            target = group_buffer(group) + N - group_size - left_elements;
+            length = group_size;
+        }
+
+        if (length > 0)
+        {
+            // shift remaininig elements to front
+            memmove(target, group_buffer_current_mins[group], left_elements * sizeof(value_type));
+            group_buffer_current_mins[group] = target;
+
+            // fill remaining space from group
+            if (group < params.num_int_groups)
+                int_mergers[group]->multi_merge(target + left_elements,
+                                                target + left_elements + length);
+            else
+                ext_mergers[group - params.num_int_groups]->multi_merge(
+                    target + left_elements,
+                    target + left_elements + length);
+        }
+
+        return length + left_elements;
+    }
+
+    size_t make_space_available(const size_t level)
+    {
+        TLX_LOG << "make_space_available(" << level << ")";
+
+        const size_t num_int_groups = params.num_int_groups;
+        size_t finalLevel;
+        assert(level < total_num_groups());
+
+        assert(level <= num_active_groups);
+
+        if (level == num_active_groups)
+            ++num_active_groups;
+
+        const bool spaceIsAvailable_ =
+            (level < num_int_groups) ? int_mergers[level]->is_space_available()
+            : (ext_mergers[level - num_int_groups]->is_space_available());
+
+        if (spaceIsAvailable_)
+        {
+            finalLevel = level;
+        }
+        else if (level == total_num_groups() - 1)
+        {
+            TLX_LOG1 << "dynamic_priority_queue OVERFLOW - all groups full, size=" << size();
+            dump_params();
+
+            const size_t extLevel = level - num_int_groups;
+            const size_type segmentSize = ext_mergers[extLevel]->size();
+            TLX_LOG << "Inserting segment into last level external: " << level << " " << segmentSize;
+            std::unique_ptr<ext_merger_type> overflow_merger(
+                new ext_merger_type(cmp, params.ext_arity));
+            overflow_merger->set_pool(pool);
+            overflow_merger->append_merger(*ext_mergers[extLevel], segmentSize);
+            std::swap(ext_mergers[extLevel], overflow_merger);
+            finalLevel = level;
+        }
+        else
+        {
+            finalLevel = make_space_available(level + 1);
+
+            if (level < num_int_groups - 1)                                            // from internal to internal tree
+            {
+                const size_t segmentSize = int_mergers[level]->size();
+                value_type* newSegment = new value_type[segmentSize + 1];
+                int_mergers[level]->multi_merge(newSegment, newSegment + segmentSize); // empty this level
+
+                newSegment[segmentSize] = delete_buffer[params.delete_buffer_size];    // sentinel
+                int_mergers[level + 1]->append_array(newSegment, segmentSize);
+            }
+            else
+            {
+                if (level == num_int_groups - 1) // from internal to external tree
+                {
+                    const size_t segmentSize = int_mergers[num_int_groups - 1]->size();
+                    TLX_LOG << "make_space... Inserting segment into first level external: " << level << " " << segmentSize;
+                    ext_mergers[0]->append_merger(*int_mergers[num_int_groups - 1], segmentSize);
+                }
+                else // from external to external tree
+                {
+                    const size_type segmentSize = ext_mergers[level - num_int_groups]->size();
+                    TLX_LOG << "make_space... Inserting segment into second level external: " << level << " " << segmentSize;
+                    ext_mergers[level - num_int_groups + 1]->append_merger(*ext_mergers[level - num_int_groups], segmentSize);
+                }
+            }
+        }
+        return finalLevel;
+    }
+
+    void empty_insert_heap()
+    {
+        TLX_LOG << "empty_insert_heap()";
+
+        const size_t N = params.N;
+        assert(insert_heap.size() == (N + 1));
+
+        const value_type sup = get_supremum();
+
+        // build new segment
+        value_type* newSegment = new value_type[N + 1];
+        value_type* newPos = newSegment;
+
+        // put the new data there for now
+        value_type* SortTo = newSegment;
+
+        insert_heap.sort_to(SortTo);
+
+        SortTo = newSegment + N;
+        insert_heap.clear();
+        insert_heap.push(*SortTo);
+
+        assert(insert_heap.size() == 1);
+
+        newSegment[N] = sup; // sentinel
+
+        // copy the delete_buffer and group_buffers[0] to temporary storage
+        const size_t kTempSize = N + params.delete_buffer_size;
+        value_type* temp = temp_buffer.data();
+        const size_t sz1 = current_delete_buffer_size();
+        const size_t sz2 = current_group_buffer_size(0);
+        value_type* pos = temp + kTempSize - sz1 - sz2;
+        std::copy(delete_buffer_current_min, delete_buffer_current_min + sz1, pos);
+        std::copy(group_buffer_current_mins[0], group_buffer_current_mins[0] + sz2, pos + sz1);
+        temp[kTempSize] = sup; // sentinel
+
+        // refill delete_buffer
+        priority_queue_local::merge2_iterator(
+            pos, newPos,
+            delete_buffer_current_min, delete_buffer_current_min + sz1, cmp);
+
+        // refill group_buffers[0]
+        priority_queue_local::merge2_iterator(
+            pos, newPos,
+            group_buffer_current_mins[0], group_buffer_current_mins[0] + sz2, cmp);
+
+        // merge the rest to the new segment
+        // note that merge exactly trips into the footsteps
+        // of itself
+        priority_queue_local::merge2_iterator(pos, newPos,
+                                              newSegment, newSegment + N, cmp);
+
+        // and insert it
+        const size_t freeLevel = make_space_available(0);
+        assert(freeLevel == 0 || int_mergers[0]->size() == 0);
+        int_mergers[0]->append_array(newSegment, N);
+
+        // get rid of invalid level 2 buffers
+        // by inserting them into tree 0 (which is almost empty in this case)
+        if (freeLevel > 0)
+        {
+            for (size_t i = freeLevel + 1; i-- > 0; )
+            {
+                newSegment = new value_type[current_group_buffer_size(i) + 1]; // with sentinel
+                std::copy(group_buffer_current_mins[i], group_buffer_current_mins[i] + current_group_buffer_size(i) + 1, newSegment);
+                int_mergers[0]->append_array(newSegment, current_group_buffer_size(i));
+                group_buffer_current_mins[i] = group_buffer_end(i);           // empty
+            }
+        }
+
+        // update size
+        size_ += size_type(N);
+
+        // special case if the tree was empty before
+        if (delete_buffer_current_min == delete_buffer_end)
+            refill_delete_buffer();
+    }
+
+    value_type get_supremum() const
+    {
+        return cmp.min_value();
+    }
+
+    size_t current_delete_buffer_size() const
+    {
+        return delete_buffer_end - delete_buffer_current_min;
+    }
+
+    size_t current_group_buffer_size(const size_t i) const
+    {
+        return (group_buffer(i) + params.N) - group_buffer_current_mins[i];
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_DYNAMIC_PRIORITY_QUEUE_HEADER
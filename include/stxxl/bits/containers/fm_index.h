@@ -0,0 +1,364 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/fm_index.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_FM_INDEX_HEADER
+#define STXXL_CONTAINERS_FM_INDEX_HEADER
+
+#include <cassert>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+
+#include <stxxl/bits/algo/suffix_array.h>
+#include <stxxl/bits/containers/vector.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External memory FM-index of a text, which counts and locates the
+ * occurrences of patterns by backward search on the Burrows-Wheeler
+ * transform. All tables are stored in stxxl::vector objects and are written
+ * in one pass by build(), which streams the BWT from the final merge of DC3.
+ *
+ * The BWT matrix has n + 1 rows, row zero is the rotation starting with the
+ * sentinel and row k + 1 the suffix sa[k], see burrows_wheeler_transform().
+ * The index stores
+ * - the BWT without the sentinel and its row, the primary index,
+ * - samples of the character counts before every occ_rate-th BWT character,
+ *   of sigma() counts each,
+ * - the suffix array at every sa_rate-th row, as in BWA, from which locate()
+ *   walks LF steps to the nearest sampled row.
+ *
+ * occ() reads at most occ_rate BWT characters, hence a count() reads
+ * O(m * occ_rate / B) blocks for a pattern of length m. The samples take
+ * sigma() * sizeof(OffsetType) / occ_rate bytes per character.
+ *
+ * \tparam AlphabetType unsigned character type of at most 16 bits
+ * \tparam OffsetType type of the stored positions and counts
+ */
+template <typename AlphabetType = unsigned char,
+          typename OffsetType = external_size_type>
+class fm_index
+{
+    static_assert(std::is_unsigned<AlphabetType>::value && sizeof(AlphabetType) <= 2,
+                  "fm_index requires an unsigned alphabet of at most 16 bits");
+
+    static constexpr bool debug = false;
+
+public:
+    //! \name Types
+    //! \{
+
+    using alphabet_type = AlphabetType;
+    using offset_type = OffsetType;
+    using size_type = external_size_type;
+
+    using bwt_vector_type = stxxl::vector<alphabet_type>;
+    using offset_vector_type = stxxl::vector<offset_type>;
+
+    //! \}
+
+protected:
+    //! BWT characters between count samples
+    size_type m_occ_rate;
+
+    //! rows between suffix array samples
+    size_type m_sa_rate;
+
+    //! length of the text
+    size_type m_size;
+
+    //! row of the suffix at position zero, whose BWT character is the sentinel
+    size_type m_primary;
+
+    //! largest character plus one
+    size_type m_sigma;
+
+    //! number of rows starting with a character smaller than c, or the
+    //! sentinel, for c = 0..sigma
+    std::vector<size_type> m_C;
+
+    //! BWT without the sentinel
+    bwt_vector_type m_bwt;
+
+    //! counts of each character in bwt[0, j * occ_rate), sigma per sample
+    offset_vector_type m_occ;
+
+    //! suffix array at the rows j * sa_rate
+    offset_vector_type m_ssa;
+
+public:
+    //! \name Constructors
+    //! \{
+
+    //! Create an empty index with the given sampling rates.
+    explicit fm_index(size_type occ_rate = 256, size_type sa_rate = 32)
+        : m_occ_rate(occ_rate), m_sa_rate(sa_rate),
+          m_size(0), m_primary(0), m_sigma(0), m_C(1, 1)
+    {
+        if (occ_rate == 0 || sa_rate == 0)
+            throw foxxll::bad_parameter("stxxl::fm_index(): sampling rates must be positive");
+    }
+
+    //! non-copyable: delete copy-constructor
+    fm_index(const fm_index&) = delete;
+    //! non-copyable: delete assignment operator
+    fm_index& operator = (const fm_index&) = delete;
+
+    //! \}
+
+    //! \name Construction
+    //! \{
+
+    /*!
+     * Build the index of the text [text_begin, text_end), replacing the
+     * previous one. The characters are scanned once for the alphabet size,
+     * then DC3 runs with M bytes of internal memory and its final merge
+     * writes the BWT, the count samples and the suffix array samples.
+     */
+    template <typename TextIterator>
+    void build(TextIterator text_begin, TextIterator text_end, size_t M)
+    {
+        const size_type n = static_cast<size_type>(text_end - text_begin);
+        suffix_array_local::check_text_length<offset_type>(n, "stxxl::fm_index::build()");
+
+        m_size = n;
+        m_primary = 0;
+        m_sigma = 0;
+        for (TextIterator it = text_begin; it != text_end; ++it)
+        {
+            if (static_cast<size_type>(*it) >= m_sigma)
+                m_sigma = static_cast<size_type>(*it) + 1;
+        }
+
+        m_bwt.clear();
+        m_occ.clear();
+        m_ssa.clear();
+
+        typename bwt_vector_type::bufwriter_type bwt_writer(m_bwt);
+        typename offset_vector_type::bufwriter_type occ_writer(m_occ);
+        typename offset_vector_type::bufwriter_type ssa_writer(m_ssa);
+
+        std::vector<size_type> counts(m_sigma, 0);
+        size_type length = 0;
+
+        auto put = [&](const alphabet_type& c) {
+                       if (length % m_occ_rate == 0) {
+                           for (const size_type& k : counts)
+                               occ_writer << static_cast<offset_type>(k);
+                       }
+                       bwt_writer << c;
+                       ++counts[c];
+                       ++length;
+                   };
+
+        // sentinel row
+        ssa_writer << static_cast<offset_type>(n);
+
+        if (n != 0)
+        {
+            put(static_cast<alphabet_type>(*(text_end - 1)));
+
+            size_type row = 0;
+            suffix_array_local::dc3_with_preceding<offset_type>(
+                text_begin, text_end, M,
+                [&](const offset_type& pos, const offset_type& prev) {
+                    ++row;
+                    if (row % m_sa_rate == 0)
+                        ssa_writer << pos;
+                    if (prev == offset_type(0))
+                        m_primary = row;
+                    else
+                        put(static_cast<alphabet_type>(prev - 1));
+                });
+        }
+
+        // final sample, such that occ() never reads past the samples
+        if (length % m_occ_rate == 0) {
+            for (const size_type& k : counts)
+                occ_writer << static_cast<offset_type>(k);
+        }
+
+        bwt_writer.finish();
+        occ_writer.finish();
+        ssa_writer.finish();
+
+        m_C.assign(m_sigma + 1, 1);
+        for (size_type c = 0; c < m_sigma; ++c)
+            m_C[c + 1] = m_C[c] + counts[c];
+
+        TLX_LOG << "fm_index::build(): n = " << n << " sigma = " << m_sigma
+                << " primary = " << m_primary;
+    }
+
+    //! \}
+
+    //! \name Properties
+    //! \{
+
+    //! length of the text
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    //! number of rows of the BWT matrix, size() + 1
+    size_type rows() const
+    {
+        return m_size + 1;
+    }
+
+    //! largest character of the text plus one
+    size_type sigma() const
+    {
+        return m_sigma;
+    }
+
+    //! row of the suffix at position zero
+    size_type primary_index() const
+    {
+        return m_primary;
+    }
+
+    //! BWT characters between count samples
+    size_type occ_rate() const
+    {
+        return m_occ_rate;
+    }
+
+    //! rows between suffix array samples
+    size_type sa_rate() const
+    {
+        return m_sa_rate;
+    }
+
+    //! the BWT without the sentinel, see burrows_wheeler_transform()
+    const bwt_vector_type & bwt() const
+    {
+        return m_bwt;
+    }
+
+    //! \}
+
+    //! \name Queries
+    //! \{
+
+    //! Number of occurrences of c in the last column in the rows [0, row).
+    size_type occ(const alphabet_type& c, size_type row) const
+    {
+        assert(row <= rows());
+        if (static_cast<size_type>(c) >= m_sigma)
+            return 0;
+
+        // skip the sentinel
+        const size_type end = row - (row > m_primary ? 1 : 0);
+        const size_type sample = end / m_occ_rate;
+
+        size_type result = m_occ[sample * m_sigma + c];
+        for (typename bwt_vector_type::const_iterator it = m_bwt.cbegin() + sample * m_occ_rate;
+             it != m_bwt.cbegin() + end; ++it)
+        {
+            if (*it == c)
+                ++result;
+        }
+        return result;
+    }
+
+    //! Row of the suffix one position before that of row, which must not be
+    //! the primary index.
+    size_type lf(size_type row) const
+    {
+        assert(row != m_primary && row < rows());
+        const alphabet_type c = m_bwt[row - (row > m_primary ? 1 : 0)];
+        return m_C[c] + occ(c, row);
+    }
+
+    /*!
+     * Rows [first, second) of the suffixes starting with the pattern
+     * [pattern_begin, pattern_end), an empty range if it does not occur. The
+     * empty pattern matches all rows.
+     */
+    template <typename PatternIterator>
+    std::pair<size_type, size_type>
+    backward_search(PatternIterator pattern_begin, PatternIterator pattern_end) const
+    {
+        size_type first = 0, second = rows();
+        while (pattern_end != pattern_begin && first < second)
+        {
+            --pattern_end;
+            const size_type c = static_cast<size_type>(*pattern_end);
+            if (c >= m_sigma)
+                return std::make_pair(size_type(0), size_type(0));
+
+            first = m_C[c] + occ(static_cast<alphabet_type>(c), first);
+            second = m_C[c] + occ(static_cast<alphabet_type>(c), second);
+        }
+        if (first >= second)
+            return std::make_pair(size_type(0), size_type(0));
+        return std::make_pair(first, second);
+    }
+
+    //! Number of occurrences of the pattern [pattern_begin, pattern_end).
+    template <typename PatternIterator>
+    size_type count(PatternIterator pattern_begin, PatternIterator pattern_end) const
+    {
+        const std::pair<size_type, size_type> range =
+            backward_search(pattern_begin, pattern_end);
+        return range.second - range.first;
+    }
+
+    //! Position of the suffix of row, found by LF steps to the nearest
+    //! sampled row or the primary index.
+    size_type locate_row(size_type row) const
+    {
+        assert(row < rows());
+        size_type steps = 0;
+        while (row % m_sa_rate != 0)
+        {
+            if (row == m_primary)
+                return steps;
+            row = lf(row);
+            ++steps;
+        }
+        return m_ssa[row / m_sa_rate] + steps;
+    }
+
+    /*!
+     * Write the positions of all occurrences of the pattern [pattern_begin,
+     * pattern_end) to out, in lexicographic order of their suffixes, and
+     * return their number.
+     */
+    template <typename PatternIterator, typename OutputIterator>
+    size_type locate(PatternIterator pattern_begin, PatternIterator pattern_end,
+                     OutputIterator out) const
+    {
+        const std::pair<size_type, size_type> range =
+            backward_search(pattern_begin, pattern_end);
+        for (size_type row = range.first; row < range.second; ++row)
+            *out++ = static_cast<offset_type>(locate_row(row));
+        return range.second - range.first;
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_FM_INDEX_HEADER
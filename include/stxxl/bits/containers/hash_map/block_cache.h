@@ -15,14 +15,19 @@
 #define STXXL_CONTAINERS_HASH_MAP_BLOCK_CACHE_HEADER
 
 #include <algorithm>
+#include <condition_variable>
+#include <cstdint>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <foxxll/mng/block_manager.hpp>
 
+#include <stxxl/bits/common/locked_memory.h>
 #include <stxxl/bits/containers/pager.h>
 
 namespace stxxl {
@@ -51,6 +56,7 @@ public:
 
         for (size_t i = 0; i < size; i++) {
             blocks_.push_back(new block_type());
+            lock_blocks(blocks_.back());
             free_blocks_.push_back(i);
         }
     }
@@ -111,7 +117,10 @@ public:
     {
         flush();
         for (size_t i = 0; i < blocks_.size(); i++)
+        {
+            unlock_blocks(blocks_[i]);
             delete blocks_[i];
+        }
     }
 };
 
@@ -211,6 +220,7 @@ public:
         for (size_t i = 0; i < cache_size; i++)
         {
             blocks_[i] = new block_type();
+            lock_blocks(blocks_[i]);
             free_blocks_[i] = i;
         }
     }
@@ -246,7 +256,10 @@ public:
         write_buffer_.flush();
 
         for (size_t i = 0; i < size(); ++i)
+        {
+            unlock_blocks(blocks_[i]);
             delete blocks_[i];
+        }
     }
 
 protected:
@@ -270,11 +283,9 @@ protected:
             pager_.hit(i_block2kick);
         } while (retain_count_[i_block2kick] > 0);
 
-        if (valid_subblock_[i_block2kick] == valid_all &&
-            reqs_[i_block2kick].valid())
-        {
+        // complete block or subblock may still be loading
+        if (reqs_[i_block2kick].valid())
             reqs_[i_block2kick]->wait();
-        }
 
         if (dirty_[i_block2kick])
         {
@@ -355,6 +366,27 @@ public:
         return true;
     }
 
+    //! Check whether get_subblock() can serve the subblock without kicking
+    //! or overwriting a retained block, i.e. a block whose subblocks may
+    //! still be read by a client.
+    bool can_get_subblock(const bid_type& bid, const size_t i_subblock) const
+    {
+        typename bid_map_type::const_iterator it = bid_map_.find(bid);
+        if (it != bid_map_.end())
+        {
+            const size_t i_block = (*it).second;
+            return valid_subblock_[i_block] == valid_all ||
+                   valid_subblock_[i_block] == i_subblock ||
+                   retain_count_[i_block] == 0;
+        }
+
+        if (!free_blocks_.empty())
+            return true;
+
+        return std::find(retain_count_.begin(), retain_count_.end(), 0)
+               != retain_count_.end();
+    }
+
     //! Retrieve a subblock from the cache. If not yet cached, only the
     //! subblock will be loaded.
     //!
@@ -380,8 +412,7 @@ public:
             {
                 ++n_found;
 
-                if (valid_subblock_[i_block] == valid_all &&
-                    reqs_[i_block].valid())
+                if (reqs_[i_block].valid())
                 {
                     // request not yet completed?
                     if (reqs_[i_block]->poll() == false)
@@ -395,7 +426,10 @@ public:
             {
                 ++n_not_found;
                 ++n_wrong_subblock;
-                // actually loading the subblock will be done below
+                // actually loading the subblock will be done below, after a
+                // prefetch_subblock() of the other one completed
+                if (reqs_[i_block].valid())
+                    reqs_[i_block]->wait();
 
                 // note: if a client still holds a reference to the "old"
                 // subblock, it will find its data to be still valid.
@@ -421,8 +455,8 @@ public:
         // now actually load the wanted subblock and store it within *block
         subblock_bid_type subblock_bid(
             bid.storage, bid.offset + i_subblock * subblock_type::raw_size);
-        foxxll::request_ptr req = ((*block)[i_subblock]).read(subblock_bid);
-        req->wait();
+        reqs_[i_block] = ((*block)[i_subblock]).read(subblock_bid);
+        reqs_[i_block]->wait();
 
         valid_subblock_[i_block] = i_subblock;
         pager_.hit(i_block);
@@ -470,6 +504,51 @@ public:
         pager_.hit(i_block);
     }
 
+    //! Load a subblock in advance, get_subblock() waits for it.
+    //! \param bid block, to which the subblock belongs
+    //! \param i_subblock index of the subblock
+    void prefetch_subblock(const bid_type& bid, const size_t i_subblock)
+    {
+        size_t i_block;
+
+        // cached
+        typename bid_map_type::const_iterator it = bid_map_.find(bid);
+        if (it != bid_map_.end())
+        {
+            i_block = (*it).second;
+
+            // complete block or wanted subblock cached; we can finish here
+            if (valid_subblock_[i_block] == valid_all ||
+                valid_subblock_[i_block] == i_subblock) {
+                pager_.hit(i_block);
+                return;
+            }
+
+            // another subblock cached, it may still be loading
+            if (reqs_[i_block].valid())
+                reqs_[i_block]->wait();
+        }
+        // not even a subblock cached
+        else {
+            if (free_blocks_.empty())
+                kick_block();
+
+            i_block = free_blocks_.back(), free_blocks_.pop_back();
+
+            bid_map_[bid] = i_block;
+            bids_[i_block] = bid;
+            retain_count_[i_block] = 0;
+            dirty_[i_block] = false;
+        }
+
+        // now actually start loading the subblock
+        subblock_bid_type subblock_bid(
+            bid.storage, bid.offset + i_subblock * subblock_type::raw_size);
+        reqs_[i_block] = ((*blocks_[i_block])[i_subblock]).read(subblock_bid);
+        valid_subblock_[i_block] = i_subblock;
+        pager_.hit(i_block);
+    }
+
     //! Write all dirty blocks back to disk
     void flush()
     {
@@ -588,6 +667,117 @@ public:
 #endif
 };
 
+/*!
+ * Block cache for concurrent readers, split into shards by block. Each shard
+ * is a block_cache of its own, guarded by a mutex, which is held while a
+ * subblock is located or loaded, but not while it is read: pin_subblock()
+ * retains the block, such that it is neither kicked nor overwritten before
+ * unpin_subblock(). A reader waits for a shard all of whose blocks are
+ * pinned.
+ *
+ * The blocks are never made dirty, hence the cache must only be used while
+ * the blocks on disk are not modified.
+ */
+template <class BlockType>
+class sharded_block_cache
+{
+public:
+    using block_type = BlockType;
+    using bid_type = typename block_type::bid_type;
+    using subblock_type = typename block_type::value_type;
+    using cache_type = block_cache<block_type>;
+
+protected:
+    struct shard
+    {
+        std::mutex mutex;
+        //! signaled when a block is unpinned
+        std::condition_variable released;
+        cache_type cache;
+
+        explicit shard(const size_t cache_size) : cache(cache_size) { }
+    };
+
+    std::vector<std::unique_ptr<shard> > shards_;
+
+    shard& shard_of(const bid_type& bid) const
+    {
+        // consecutive blocks of a file go to different shards
+        return *shards_[static_cast<size_t>(bid.offset / block_type::raw_size
+                                            + reinterpret_cast<uintptr_t>(bid.storage))
+                        % shards_.size()];
+    }
+
+public:
+    //! Construct a new sharded block-cache.
+    //! \param cache_size cache-size in number of blocks, at least two blocks
+    //!   per shard
+    //! \param n_shards number of shards
+    sharded_block_cache(const size_t cache_size, const size_t n_shards)
+    {
+        const size_t num_shards = std::max<size_t>(1, n_shards);
+        const size_t shard_size = std::max<size_t>(2, cache_size / num_shards);
+        for (size_t i = 0; i < num_shards; ++i)
+            shards_.emplace_back(new shard(shard_size));
+    }
+
+    //! non-copyable: delete copy-constructor
+    sharded_block_cache(const sharded_block_cache&) = delete;
+    //! non-copyable: delete assignment operator
+    sharded_block_cache& operator = (const sharded_block_cache&) = delete;
+
+    //! Return number of shards
+    size_t num_shards() const
+    {
+        return shards_.size();
+    }
+
+    //! Return cache-size
+    size_t size() const
+    {
+        return shards_.size() * shards_[0]->cache.size();
+    }
+
+    //! Retrieve a subblock and pin its block, see block_cache::get_subblock().
+    //! Thread-safe. Each pin_subblock() must be followed by unpin_subblock().
+    //! \param bid block, to which the requested subblock belongs
+    //! \param i_subblock index of requested subblock
+    //! \return pointer to subblock
+    subblock_type * pin_subblock(const bid_type& bid, const size_t i_subblock)
+    {
+        shard& s = shard_of(bid);
+        std::unique_lock<std::mutex> lock(s.mutex);
+        s.released.wait(
+            lock, [&]() { return s.cache.can_get_subblock(bid, i_subblock); });
+
+        subblock_type* subblock = s.cache.get_subblock(bid, i_subblock);
+        s.cache.retain_block(bid);
+        return subblock;
+    }
+
+    //! Release a block pinned by pin_subblock(). Thread-safe.
+    void unpin_subblock(const bid_type& bid)
+    {
+        shard& s = shard_of(bid);
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            s.cache.release_block(bid);
+        }
+        s.released.notify_all();
+    }
+
+    //! Print statistics of all shards.
+    void print_statistics(std::ostream& o = std::cout) const
+    {
+        for (size_t i = 0; i < shards_.size(); ++i)
+        {
+            std::unique_lock<std::mutex> lock(shards_[i]->mutex);
+            o << "Shard " << i << ":" << std::endl;
+            shards_[i]->cache.print_statistics(o);
+        }
+    }
+};
+
 } // namespace hash_map
 } // namespace stxxl
 
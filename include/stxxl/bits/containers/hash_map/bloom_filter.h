@@ -0,0 +1,165 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/hash_map/bloom_filter.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_HASH_MAP_BLOOM_FILTER_HEADER
+#define STXXL_CONTAINERS_HASH_MAP_BLOOM_FILTER_HEADER
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <stxxl/bits/config.h>
+#include <stxxl/types>
+
+namespace stxxl {
+namespace hash_map {
+
+/*!
+ * Bloom filter of the keys stored in external memory, indexed by their hash
+ * values. may_contain() is false only for hash values never inserted, hence
+ * lookups of such keys need no I/O. Keys cannot be removed; the filter is
+ * built anew whenever the external part is rewritten.
+ */
+class bloom_filter
+{
+    //! bit array, empty if disabled
+    std::vector<uint64_t> bits_;
+    //! number of bits
+    uint64_t num_bits_ = 0;
+    //! number of bits set per key, 0 if disabled
+    size_t num_hashes_ = 0;
+
+    //! scramble the bits of a user-supplied hash value
+    static uint64_t mix(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+        x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+        return x ^ (x >> 31);
+    }
+
+public:
+    //! Resize and empty the filter.
+    //! \param n_keys (estimated) number of keys to be inserted
+    //! \param bits_per_key bits per key, 0 disables the filter
+    //! \param max_bytes memory limit of the filter in bytes
+    void reset(external_size_type n_keys, double bits_per_key, size_t max_bytes)
+    {
+        std::vector<uint64_t>().swap(bits_);
+        num_bits_ = 0;
+        num_hashes_ = 0;
+
+        const uint64_t max_words = max_bytes / sizeof(uint64_t);
+        if (bits_per_key <= 0 || max_words == 0)
+            return;
+
+        n_keys = std::max<external_size_type>(n_keys, 1);
+        const uint64_t n_words = std::min<uint64_t>(
+            max_words, static_cast<uint64_t>(
+                std::ceil(static_cast<double>(n_keys) * bits_per_key / 64)));
+
+        bits_.assign(static_cast<size_t>(std::max<uint64_t>(n_words, 1)), 0);
+        num_bits_ = bits_.size() * 64;
+
+        // optimal number of hash functions for the bits actually available
+        const double bits = static_cast<double>(num_bits_) / static_cast<double>(n_keys);
+        num_hashes_ = static_cast<size_t>(
+            std::min(16.0, std::max(1.0, std::round(bits * std::log(2.0)))));
+    }
+
+    //! Disable the filter and release its memory.
+    void clear()
+    {
+        reset(0, 0, 0);
+    }
+
+    //! Whether the filter is in use.
+    bool enabled() const
+    {
+        return num_hashes_ != 0;
+    }
+
+    //! Insert a hash value.
+    void insert(uint64_t hash)
+    {
+        if (!enabled())
+            return;
+
+        const uint64_t h = mix(hash);
+        const uint64_t h1 = h & 0xFFFFFFFF, h2 = (h >> 32) | 1;
+        for (size_t i = 0; i < num_hashes_; ++i)
+        {
+            const uint64_t pos = (h1 + i * h2) % num_bits_;
+            bits_[pos / 64] |= uint64_t(1) << (pos % 64);
+        }
+    }
+
+    //! Insert a hash value; may be called by several threads at once.
+    void concurrent_insert(uint64_t hash)
+    {
+        if (!enabled())
+            return;
+
+        const uint64_t h = mix(hash);
+        const uint64_t h1 = h & 0xFFFFFFFF, h2 = (h >> 32) | 1;
+        for (size_t i = 0; i < num_hashes_; ++i)
+        {
+            const uint64_t pos = (h1 + i * h2) % num_bits_;
+            uint64_t& word = bits_[pos / 64];
+#if STXXL_PARALLEL
+#pragma omp atomic
+#endif
+            word |= uint64_t(1) << (pos % 64);
+        }
+    }
+
+    //! Whether a hash value may have been inserted; always true if the filter
+    //! is disabled.
+    bool may_contain(uint64_t hash) const
+    {
+        if (!enabled())
+            return true;
+
+        const uint64_t h = mix(hash);
+        const uint64_t h1 = h & 0xFFFFFFFF, h2 = (h >> 32) | 1;
+        for (size_t i = 0; i < num_hashes_; ++i)
+        {
+            const uint64_t pos = (h1 + i * h2) % num_bits_;
+            if ((bits_[pos / 64] & (uint64_t(1) << (pos % 64))) == 0)
+                return false;
+        }
+        return true;
+    }
+
+    //! Number of bits set per key.
+    size_t num_hashes() const
+    {
+        return num_hashes_;
+    }
+
+    //! Number of bytes of internal memory used.
+    size_t mem_cons() const
+    {
+        return bits_.size() * sizeof(uint64_t);
+    }
+
+    void swap(bloom_filter& obj)
+    {
+        std::swap(bits_, obj.bits_);
+        std::swap(num_bits_, obj.num_bits_);
+        std::swap(num_hashes_, obj.num_hashes_);
+    }
+};
+
+} // namespace hash_map
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_HASH_MAP_BLOOM_FILTER_HEADER
@@ -15,6 +15,7 @@
 #define STXXL_CONTAINERS_HASH_MAP_HASH_MAP_HEADER
 
 #include <algorithm>
+#include <cassert>
 #include <functional>
 #include <iostream>
 #include <limits>
@@ -25,14 +26,22 @@
 
 #include <foxxll/mng/block_manager.hpp>
 
+#include <stxxl/bits/common/task_runtime.h>
+#include <stxxl/bits/common/trace.h>
+#include <stxxl/bits/config.h>
 #include <stxxl/bits/stream/sort_stream.h>
 #include <stxxl/bits/stream/stream.h>
 
 #include <stxxl/bits/containers/hash_map/block_cache.h>
+#include <stxxl/bits/containers/hash_map/bloom_filter.h>
 #include <stxxl/bits/containers/hash_map/iterator.h>
 #include <stxxl/bits/containers/hash_map/iterator_map.h>
 #include <stxxl/bits/containers/hash_map/util.h>
 
+#if STXXL_PARALLEL
+#include <omp.h>
+#endif
+
 namespace stxxl {
 
 //! External memory hash-map
@@ -96,6 +105,7 @@ public:
 
     using iterator = hash_map_iterator<self_type>;
     using const_iterator = hash_map_const_iterator<self_type>;
+    using snapshot_iterator = hash_map_snapshot_iterator<self_type>;
 
     //! subblock- and block-size in bytes
     enum {
@@ -137,10 +147,14 @@ public:
 
     using block_cache_type = block_cache<block_type>;
 
+    using sharded_cache_type = sharded_block_cache<block_type>;
+
     using reader_type = buffered_reader<block_cache_type, bid_iterator_type>;
 
     using node_allocator_type = typename allocator_type::template rebind<node_type>::other;
 
+    using node_pool_type = node_pool<node_type, node_allocator_type>;
+
 protected:
     //! user supplied mother hash-function
     hasher hash_;
@@ -156,17 +170,41 @@ protected:
     internal_size_type max_buffer_size_;
     //! keeps track of all active iterators
     iterator_map_type iterator_map_;
+    //! tuning parameters, updated by the readers' adaptive prefetching
+    mutable tuning_parameters tuning_;
 
     mutable block_cache_type block_cache_;
+    //! block cache of concurrent_find(), see begin_concurrent_reads()
+    std::unique_ptr<sharded_cache_type> concurrent_cache_;
     //! used to allocate new nodes for internal buffer
-    node_allocator_type node_allocator_;
+    node_pool_type node_pool_;
     //! false if the total-number of values is correct (false) or true if
     //! estimated (true); see *oblivious_-methods
     mutable bool oblivious_;
+    //! merge function of the values buffered by upsert(), see _resolve_merge()
+    std::function<mapped_type(const mapped_type&, const mapped_type&)> merge_;
+    //! called with each value written by _rebuild_buckets(), see
+    //! set_rebuild_hook()
+    std::function<void(value_type&)> rebuild_hook_;
     //! (estimated) number of values
     mutable external_size_type num_total_;
     //! desired load factor after rehashing
     float opt_load_factor_;
+    //! filter of the keys stored in external memory
+    bloom_filter filter_;
+    //! bits per key of filter_, 0 if disabled
+    double filter_bits_per_key_;
+    //! true if the buffer is flushed by a sweep, see incremental_rehash()
+    bool incremental_rehash_;
+    //! linear hashing: number of buckets split in the current round, their
+    //! upper halves are appended to the buckets
+    internal_size_type split_;
+    //! next base bucket to be rewritten by the sweep
+    internal_size_type sweep_pos_;
+    //! number of blocks at the begin of the sweep, which are unused at its end
+    internal_size_type sweep_begin_block_;
+    //! number of base buckets the sweep is behind
+    double sweep_credit_;
 
 public:
     /*!
@@ -188,11 +226,18 @@ public:
           bids_(0),
           buffer_size_(0),
           iterator_map_(this),
-          block_cache_(tuning::get_instance()->blockcache_size),
-          node_allocator_(a),
+          tuning_(*tuning::get_instance()),
+          block_cache_(tuning_.blockcache_size),
+          node_pool_(a),
           oblivious_(false),
           num_total_(0),
-          opt_load_factor_(0.875)
+          opt_load_factor_(0.875),
+          filter_bits_per_key_(0),
+          incremental_rehash_(false),
+          split_(0),
+          sweep_pos_(0),
+          sweep_begin_block_(0),
+          sweep_credit_(0)
     {
         max_buffer_size_ = buffer_size / sizeof(node_type);
     }
@@ -224,16 +269,66 @@ public:
           bids_(0),
           buffer_size_(0),
           iterator_map_(this),
-          block_cache_(tuning::get_instance()->blockcache_size),
-          node_allocator_(a),
+          tuning_(*tuning::get_instance()),
+          block_cache_(tuning_.blockcache_size),
+          node_pool_(a),
           oblivious_(false),
           num_total_(0),
-          opt_load_factor_(0.875)
+          opt_load_factor_(0.875),
+          filter_bits_per_key_(0),
+          incremental_rehash_(false),
+          split_(0),
+          sweep_pos_(0),
+          sweep_begin_block_(0),
+          sweep_credit_(0)
     {
         max_buffer_size_ = buffer_size / sizeof(node_type);
         insert(begin, end, mem_to_sort);
     }
 
+    /*!
+     * Construct a new hash-map from all values of a stream, see bulk_load().
+     *
+     * \param input stream of values
+     * \param num_values (estimated) number of values in the stream, determines
+     * the number of buckets
+     * \param mem_to_sort internal memory that may be used for bulk-construction (not
+     * to be confused with the buffer-memory)
+     * \param hf hash-function
+     * \param cmp comparator-object
+     * \param buffer_size size of internal-memory buffer in bytes
+     * \param a allocation-strategory for internal-memory buffer
+     */
+    template <class InputStream>
+    hash_map(InputStream& input, external_size_type num_values,
+             internal_size_type mem_to_sort = 256*1024*1024,
+             const hasher& hf = hasher(),
+             const key_compare& cmp = key_compare(),
+             internal_size_type buffer_size = 128*1024*1024,
+             const allocator_type& a = allocator_type())
+        : hash_(hf),
+          cmp_(cmp),
+          buckets_(0),                 // bulk_load will determine a good size
+          bids_(0),
+          buffer_size_(0),
+          iterator_map_(this),
+          tuning_(*tuning::get_instance()),
+          block_cache_(tuning_.blockcache_size),
+          node_pool_(a),
+          oblivious_(false),
+          num_total_(0),
+          opt_load_factor_(0.875),
+          filter_bits_per_key_(0),
+          incremental_rehash_(false),
+          split_(0),
+          sweep_pos_(0),
+          sweep_begin_block_(0),
+          sweep_credit_(0)
+    {
+        max_buffer_size_ = buffer_size / sizeof(node_type);
+        bulk_load(input, num_values, mem_to_sort);
+    }
+
     //! non-copyable: delete copy-constructor
     hash_map(const hash_map&) = delete;
     //! non-copyable: delete assignment operator
@@ -255,7 +350,7 @@ public:
 
     //! Get node memory allocator
     allocator_type get_allocator() const
-    { return node_allocator_; }
+    { return node_pool_.get_allocator(); }
 
 protected:
     /*!
@@ -271,7 +366,7 @@ protected:
         using values_stream_type = HashedValuesStream<self_type, reader_type>;
 
         // this will start prefetching automatically
-        reader_type reader(bids_.begin(), bids_.end(), block_cache_);
+        reader_type reader(bids_.begin(), bids_.end(), block_cache_, 0, true, tuning_);
         values_stream_type values(buckets_.begin(), buckets_.end(),
                                   reader, bids_.begin(), *this);
 
@@ -335,6 +430,8 @@ public:
                 node->value_ = value;
                 ++num_total_;
             }
+            else
+                _resolve_merge(bucket, node);
             return std::pair<iterator, bool>(
                 iterator(this, i_bucket, node,
                          0, src_internal, false, value.first), old_deleted);
@@ -367,8 +464,7 @@ public:
                             0, src_internal, false, value.first);
 
                 ++buffer_size_;
-                if (buffer_size_ >= max_buffer_size_)
-                    _rebuild_buckets();                 // will fix it as well
+                _check_buffer();                 // will fix it as well
 
                 return std::pair<iterator, bool>(it, true);
             }
@@ -416,13 +512,68 @@ public:
                         0, src_internal, false, value.first);
 
             ++buffer_size_;
-            if (buffer_size_ >= max_buffer_size_)
-                _rebuild_buckets();
+            _check_buffer();
 
             return it;
         }
     }
 
+    /*!
+     * Insert a value, or merge it into the value already stored with the same
+     * key; external memory is not accessed. If the key is not buffered, the
+     * value is buffered and merged with the external value, if any, when it is
+     * read or when the buffer is written to external memory. Repeated upserts
+     * of a key are merged in the buffer, which needs merge to be associative.
+     * All pending merges use the merge function of the latest call.
+     *
+     * \param value what to insert or merge
+     * \param merge computes the new mapped value from the stored and the
+     * given mapped value
+     */
+    template <class MergeFunction>
+    void upsert(const value_type& value, MergeFunction merge)
+    {
+        if (buckets_.size() == 0)
+            _rebuild_buckets(128);
+
+        internal_size_type i_bucket = _bkt_num(value.first);
+        bucket_type& bucket = buckets_[i_bucket];
+        node_type* node = _find_key_internal(bucket, value.first);
+
+        // found value in internal memory; merge it there, a pending merge
+        // with the external value stays pending
+        if (node && _eq(node->value_.first, value.first))
+        {
+            if (node->deleted())
+            {
+                node->set_deleted(false);
+                node->value_ = value;
+                ++num_total_;
+            }
+            else
+                node->value_.second = merge(node->value_.second, value.second);
+            return;
+        }
+
+        // not found; ignore external memory and buffer the value to be merged
+        merge_ = merge;
+        oblivious_ = true;
+        ++num_total_;
+        node_type* new_node =
+            node
+            ? node->set_next(_new_node(value, node->next(), false))
+            : (bucket.list_ = _new_node(value, bucket.list_, false));
+        new_node->set_merge_pending(true);
+
+        // iterators referencing the key in external memory now point to
+        // new_node, which must therefore hold the merged value
+        if (iterator_map_.fix_iterators_2int(i_bucket, value.first, new_node) > 0)
+            _resolve_merge(bucket, new_node);
+
+        ++buffer_size_;
+        _check_buffer();
+    }
+
     //! Erase value by iterator
     //! \param it iterator pointing to the value to erase
     void erase(const_iterator it)
@@ -449,8 +600,7 @@ public:
             iterator_map_.fix_iterators_2end(it.i_bucket_, it.key_);
 
             ++buffer_size_;
-            if (buffer_size_ >= max_buffer_size_)
-                _rebuild_buckets();
+            _check_buffer();
         }
     }
 
@@ -497,8 +647,7 @@ public:
                 iterator_map_.fix_iterators_2end(i_bucket, key);
 
                 ++buffer_size_;
-                if (buffer_size_ >= max_buffer_size_)
-                    _rebuild_buckets();
+                _check_buffer();
 
                 return 1;
             }
@@ -540,8 +689,7 @@ public:
             iterator_map_.fix_iterators_2end(i_bucket, key);
 
             ++buffer_size_;
-            if (buffer_size_ >= max_buffer_size_)
-                _rebuild_buckets();
+            _check_buffer();
         }
     }
 
@@ -561,6 +709,7 @@ public:
             _erase_nodes(buckets_[i_bucket].list_, nullptr);
             buckets_[i_bucket] = bucket_type();
         }
+        node_pool_.release();
         oblivious_ = false;
         num_total_ = 0;
         buffer_size_ = 0;
@@ -569,6 +718,10 @@ public:
         foxxll::block_manager* bm = foxxll::block_manager::get_instance();
         bm->delete_blocks(bids_.begin(), bids_.end());
         bids_.clear();
+        filter_.clear();
+        sweep_pos_ = 0;
+        sweep_begin_block_ = 0;
+        sweep_credit_ = 0;
     }
 
     //! Exchange stored values with another hash-map
@@ -579,9 +732,11 @@ public:
         std::swap(bids_, obj.bids_);
 
         std::swap(oblivious_, obj.oblivious_);
+        std::swap(merge_, obj.merge_);
+        std::swap(rebuild_hook_, obj.rebuild_hook_);
         std::swap(num_total_, obj.num_total_);
 
-        std::swap(node_allocator_, obj.node_allocator_);
+        node_pool_.swap(obj.node_pool_);
 
         std::swap(hash_, obj.hash_);
         std::swap(cmp_, obj.cmp_);
@@ -590,10 +745,19 @@ public:
         std::swap(max_buffer_size_, obj.max_buffer_size_);
 
         std::swap(opt_load_factor_, obj.opt_load_factor_);
+        std::swap(filter_bits_per_key_, obj.filter_bits_per_key_);
+        filter_.swap(obj.filter_);
+        std::swap(tuning_, obj.tuning_);
+        std::swap(incremental_rehash_, obj.incremental_rehash_);
+        std::swap(split_, obj.split_);
+        std::swap(sweep_pos_, obj.sweep_pos_);
+        std::swap(sweep_begin_block_, obj.sweep_begin_block_);
+        std::swap(sweep_credit_, obj.sweep_credit_);
 
         std::swap(iterator_map_, obj.iterator_map_);
 
         std::swap(block_cache_, obj.block_cache_);
+        std::swap(concurrent_cache_, obj.concurrent_cache_);
     }
 
 protected:
@@ -619,6 +783,13 @@ public:
         o << "  Found external     : " << n_found_external << std::endl;
         o << "  Not found          : " << n_not_found << std::endl;
         o << "  Subblocks searched : " << n_subblocks_loaded << std::endl;
+        o << "  Filter             : " << filter_.mem_cons() << " bytes, "
+          << filter_.num_hashes() << " bits per key set" << std::endl;
+        o << "  Buffer             : " << node_pool_.size() << " nodes, "
+          << node_pool_.mem_cons() << " bytes allocated" << std::endl;
+        if (incremental_rehash_)
+            o << "  Sweep              : bucket " << sweep_pos_ << " of "
+              << buckets_.size() - split_ << ", " << split_ << " split" << std::endl;
 
         iterator_map_.print_statistics(o);
         block_cache_.print_statistics(o);
@@ -628,8 +799,7 @@ public:
     //! \param key key for value to look up
     iterator find(const key_type& key)
     {
-        if (buffer_size_ + 1 >= max_buffer_size_)       // (*)
-            _rebuild_buckets();
+        _check_buffer(1);       // (*)
 
         internal_size_type i_bucket = _bkt_num(key);
         bucket_type& bucket = buckets_[i_bucket];
@@ -640,8 +810,8 @@ public:
             n_found_internal++;
             if (node->deleted())
                 return this->_end<iterator>();
-            else
-                return iterator(this, i_bucket, node, 0, src_internal, false, key);
+            _resolve_merge(bucket, node);
+            return iterator(this, i_bucket, node, 0, src_internal, false, key);
         }
         // search external elements
         else {
@@ -693,8 +863,8 @@ public:
             n_found_internal++;
             if (node->deleted())
                 return this->_end<const_iterator>();
-            else
-                return const_iterator(const_cast<self_type*>(this), i_bucket, node, 0, src_internal, false, key);
+            _resolve_merge(bucket, node);
+            return const_iterator(const_cast<self_type*>(this), i_bucket, node, 0, src_internal, false, key);
         }
         // search external elements
         else {
@@ -716,6 +886,148 @@ public:
         }
     }
 
+    /*!
+     * Look up a batch of keys. Const access.
+     *
+     * The keys are grouped by bucket and looked up in bucket order, which is
+     * the order of the buckets' subblocks on disk. The first subblock of the
+     * next buckets is prefetched asynchronously, so that up to half of the
+     * block cache is being read while the current keys are looked up. Keys
+     * in the same subblock are served by the cache.
+     *
+     * \param first begin of the keys to look up
+     * \param last end of the keys to look up
+     * \param out receives the iterator of find() for each key, in input order
+     * \return end of the output range
+     */
+    template <class InputIterator, class OutputIterator>
+    OutputIterator find_batch(InputIterator first, InputIterator last,
+                              OutputIterator out) const
+    {
+        const std::vector<key_type> keys(first, last);
+
+        // (bucket, index of key) in bucket order
+        std::vector<std::pair<internal_size_type, internal_size_type> > order;
+        order.reserve(keys.size());
+        for (internal_size_type i = 0; i < keys.size(); ++i)
+            order.emplace_back(_bkt_num(keys[i]), i);
+        std::sort(order.begin(), order.end());
+
+        const internal_size_type prefetch_window =
+            std::max<internal_size_type>(1, block_cache_.size() / 2);
+
+        std::vector<const_iterator> results(keys.size(), this->end());
+
+        // next position in order to prefetch, number of buckets in flight
+        internal_size_type i_prefetch = 0, n_prefetched = 0;
+
+        for (internal_size_type i = 0; i < order.size(); ++i)
+        {
+            // a new bucket is looked up, it leaves the prefetch window
+            if (i == 0 || order[i].first != order[i - 1].first) {
+                if (n_prefetched > 0)
+                    --n_prefetched;
+
+                while (i_prefetch < order.size() && n_prefetched < prefetch_window)
+                {
+                    if (i_prefetch == 0 ||
+                        order[i_prefetch].first != order[i_prefetch - 1].first)
+                    {
+                        const bucket_type& bucket = buckets_[order[i_prefetch].first];
+                        if (bucket.n_external_ > 0)
+                            _prefetch_subblock(bucket, 0);
+                        ++n_prefetched;
+                    }
+                    ++i_prefetch;
+                }
+            }
+
+            results[order[i].second] = find(keys[order[i].second]);
+        }
+
+        return std::copy(results.begin(), results.end(), out);
+    }
+
+    /*!
+     * Start the read-concurrent mode, in which concurrent_find() may be called
+     * by any number of threads. Writes back the dirty blocks of the block
+     * cache and sets up a sharded block cache of the same size for the
+     * readers. Until end_concurrent_reads(), only const methods other than
+     * concurrent_find() are allowed, and are not thread-safe.
+     *
+     * \param n_shards number of shards of the readers' block cache, should be
+     *   about the number of reading threads
+     */
+    void begin_concurrent_reads(internal_size_type n_shards = 16)
+    {
+        assert(!concurrent_cache_);
+        block_cache_.flush();
+        concurrent_cache_.reset(new sharded_cache_type(
+                                    tuning_.blockcache_size, n_shards));
+    }
+
+    //! End the read-concurrent mode and release the readers' block cache.
+    void end_concurrent_reads()
+    {
+        concurrent_cache_.reset();
+    }
+
+    //! Whether the read-concurrent mode is active.
+    bool concurrent_reads() const
+    {
+        return concurrent_cache_ != nullptr;
+    }
+
+    /*!
+     * Look up value by key, thread-safe in the read-concurrent mode, see
+     * begin_concurrent_reads(). The internal-memory buffer is only read, the
+     * external part is read through the sharded block cache, which pins a
+     * block only while one of its subblocks is searched. Lookups are not
+     * counted in the statistics of the hash-map.
+     *
+     * \param key key for value to look up
+     * \param value receives the value's mapped part if found
+     * \return true if the key was found
+     */
+    bool concurrent_find(const key_type& key, mapped_type& value) const
+    {
+        assert(concurrent_cache_);
+
+        const bucket_type& bucket = buckets_[_bkt_num(key)];
+        node_type* node = _find_key_internal(bucket, key);
+
+        // found in internal-memory buffer
+        if (node && _eq(node->value_.first, key)) {
+            if (node->deleted())
+                return false;
+            value = node->value_.second;
+            if (!node->merge_pending())
+                return true;
+        }
+
+        // search external elements
+        external_size_type i_external;
+        value_type ext_value;
+
+        concurrent_subblock_loader loader(*this);
+        std::tie(i_external, ext_value) = _find_key_external(bucket, key, loader);
+
+        const bool found_external =
+            (i_external < bucket.n_external_ && _eq(ext_value.first, key));
+
+        // pending merge of an upsert; the buffer is not modified
+        if (node && _eq(node->value_.first, key)) {
+            if (found_external)
+                value = merge_(ext_value.second, value);
+            return true;
+        }
+        if (found_external) {
+            value = ext_value.second;
+            return true;
+        }
+        return false;
+    }
+
     //! Number of values with given key
     //! \param k key for value to look up
     //! \return 0 or 1 depending on the presence of a value with the given key
@@ -747,8 +1059,7 @@ public:
     //! since using this operator will check external-memory.
     mapped_type& operator [] (const key_type& key)
     {
-        if (buffer_size_ + 1 >= max_buffer_size_)       // (*)
-            _rebuild_buckets();
+        _check_buffer(1);       // (*)
 
         internal_size_type i_bucket = _bkt_num(key);
         bucket_type& bucket = buckets_[i_bucket];
@@ -761,6 +1072,8 @@ public:
                 node->value_.second = mapped_type();
                 ++num_total_;
             }
+            else
+                _resolve_merge(bucket, node);
             return node->value_.second;
         }
         // search external elements
@@ -770,10 +1083,12 @@ public:
 
             std::tie(i_external, found_value) = _find_key_external(bucket, key);
 
+            const bool found =
+                (i_external < bucket.n_external_ && _eq(found_value.first, key));
             value_type buffer_value =
-                (i_external < bucket.n_external_ && _eq(found_value.first, key))
-                ? found_value
-                : value_type(key, mapped_type());
+                found ? found_value : value_type(key, mapped_type());
+            if (!found)
+                ++num_total_;
 
             // add a new node to the buffer. this new node's value overwrites
             // the external value if it was found and otherwise is set to (key,
@@ -824,6 +1139,17 @@ public:
         _rebuild_buckets(n);
     }
 
+    /*!
+     * Set a function called with each value written when the whole table is
+     * rewritten, e.g. by rehash() or a full buffer, which may change the
+     * mapped data, e.g. to move data kept out of line. A rewrite with a hook
+     * runs on one thread. An empty function removes the hook.
+     */
+    void set_rebuild_hook(std::function<void(value_type&)> hook)
+    {
+        rebuild_hook_ = std::move(hook);
+    }
+
     //! Number of bytes occupied by buffer
     internal_size_type buffer_size() const
     {
@@ -842,11 +1168,333 @@ public:
     void max_buffer_size(internal_size_type buffer_size)
     {
         max_buffer_size_ = buffer_size / sizeof(node_type);
-        if (buffer_size_ >= max_buffer_size_)
-            _rebuild_buckets();
+        _check_buffer();
+    }
+
+    //! Whether the buffer is flushed incrementally, see
+    //! incremental_rehash(bool).
+    bool incremental_rehash() const
+    {
+        return incremental_rehash_;
+    }
+
+    /*!
+     * Enable or disable the incremental mode. A full buffer is then not
+     * flushed by rewriting all buckets at once. Instead, a sweep rewrites a
+     * run of buckets every few insertions, merging their buffered values, and
+     * completes about once per half a buffer of insertions. While the load
+     * factor exceeds opt_load_factor(), the sweep also splits the buckets in
+     * order (linear hashing), such that their number grows with the values.
+     *
+     * Buckets are written to new blocks, the old ones are released at the end
+     * of each sweep, so external memory holds up to two copies of the table.
+     * Iterators stay valid, but splits change the order of iteration.
+     * rehash() still rewrites all buckets.
+     */
+    void incremental_rehash(bool enable)
+    {
+        incremental_rehash_ = enable;
+        _reset_sweep();
+    }
+
+    //! Tuning parameters of this hash-map, initially those of the tuning
+    //! singleton. learned_prefetch_pages is the prefetch depth adapted by
+    //! previous scans.
+    const tuning_parameters& get_tuning() const
+    {
+        return tuning_;
+    }
+
+    //! Override the tuning parameters of this hash-map, e.g. for a disk of
+    //! its own. A new blockcache_size writes back and drops the cached
+    //! blocks.
+    //! \param params new tuning parameters
+    void set_tuning(const tuning_parameters& params)
+    {
+        assert(!concurrent_cache_);
+
+        const bool resize = (params.blockcache_size != tuning_.blockcache_size);
+        tuning_ = params;
+        if (!resize)
+            return;
+
+        // the iterators' readers retain blocks of the old cache
+        iterator_map_.fix_iterators_renumber(
+            [](internal_size_type i_bucket) { return i_bucket; });
+        block_cache_.flush();
+        block_cache_.clear();
+        block_cache_type new_cache(tuning_.blockcache_size);
+        block_cache_.swap(new_cache);
+    }
+
+    //! Bits per key of the filter of the keys in external memory, 0 if
+    //! disabled.
+    double filter_bits_per_key() const
+    {
+        return filter_bits_per_key_;
+    }
+
+    /*!
+     * Set bits per key of the in-memory Bloom filter of the keys in external
+     * memory, which answers lookups of absent keys without I/O. About 10 bits
+     * per key let 1% of them read external memory. The filter is counted
+     * against the buffer and uses at most half of it. It is built whenever
+     * the external part is rewritten, call rehash() to build it now.
+     * \param bits_per_key bits per key, 0 disables the filter
+     */
+    void filter_bits_per_key(double bits_per_key)
+    {
+        filter_bits_per_key_ = bits_per_key;
+        if (bits_per_key <= 0)
+            filter_.clear();
     }
 
 protected:
+    //! Number of nodes the buffer may hold, its memory less the filter's.
+    internal_size_type _buffer_capacity() const
+    {
+        const internal_size_type filter_nodes = filter_.mem_cons() / sizeof(node_type);
+        return max_buffer_size_ - std::min(filter_nodes, max_buffer_size_);
+    }
+
+    /*!
+     * Make room in the buffer. It is flushed completely by _rebuild_buckets()
+     * if full, or, in the incremental mode, gradually by _sweep().
+     * \param n_reserved number of nodes about to be added
+     */
+    void _check_buffer(internal_size_type n_reserved = 0)
+    {
+        if (incremental_rehash_ && !buckets_.empty())
+            _sweep(n_reserved);
+        else if (buffer_size_ + n_reserved >= _buffer_capacity())
+            _rebuild_buckets();
+    }
+
+    //! Restart the sweep, after all buckets were written anew.
+    void _reset_sweep()
+    {
+        sweep_pos_ = 0;
+        sweep_begin_block_ = bids_.size();
+        sweep_credit_ = 0;
+    }
+
+    /*!
+     * Advance the sweep of the incremental mode by about as many buckets per
+     * added node, that a complete sweep takes half the nodes of the buffer,
+     * and in runs of a block's worth of buckets. If the buffer is full, the
+     * sweep advances until it is not.
+     */
+    void _sweep(internal_size_type n_reserved)
+    {
+        const internal_size_type capacity = _buffer_capacity();
+        const internal_size_type n_base = buckets_.size() - split_;
+
+        sweep_credit_ += static_cast<double>(n_base)
+                         / static_cast<double>(std::max<internal_size_type>(1, capacity / 2));
+
+        while (sweep_credit_ >= static_cast<double>(_sweep_run_length()) ||
+               (buffer_size_ > 0 && buffer_size_ + n_reserved >= capacity))
+        {
+            const internal_size_type n_run = _sweep_run();
+            sweep_credit_ = std::max(0.0, sweep_credit_ - static_cast<double>(n_run));
+        }
+    }
+
+    //! Number of base buckets of the next run of the sweep.
+    internal_size_type _sweep_run_length() const
+    {
+        return std::min<internal_size_type>(
+            subblocks_per_block, buckets_.size() - split_ - sweep_pos_);
+    }
+
+    /*!
+     * Rewrite the next run of base buckets of the sweep, merging their
+     * buffered values. While the load factor exceeds the desired one, the
+     * next bucket to split is split into itself and a new bucket, its upper
+     * half, which is appended. The buckets are written to new blocks.
+     *
+     * \return number of base buckets rewritten
+     */
+    internal_size_type _sweep_run()
+    {
+        assert(!concurrent_cache_);
+
+        using writer_type = buffered_writer<block_type, bid_container_type>;
+        using values_stream_type = HashedValuesStream<self_type, reader_type>;
+
+        const internal_size_type n_base = buckets_.size() - split_;
+        const internal_size_type n_run = _sweep_run_length();
+
+        // values of the rewritten buckets, and for each bucket: its index,
+        // its index before a split and the end of its values
+        std::vector<value_type> values;
+        std::vector<std::tuple<internal_size_type, internal_size_type, size_t> > parts;
+
+        // move the values of a bucket to values
+        auto collect = [&](internal_size_type i_bucket) {
+                           bucket_type& bucket = buckets_[i_bucket];
+                           {
+                               reader_type reader(
+                                   bucket.n_external_ ? bids_.begin() + bucket.i_block_ : bids_.end(),
+                                   bids_.end(), block_cache_, bucket.i_subblock_, false);
+                               values_stream_type stream(
+                                   buckets_.begin() + i_bucket, buckets_.begin() + i_bucket + 1,
+                                   reader, bids_.begin(), *this);
+                               for ( ; !stream.empty(); ++stream)
+                                   values.push_back((*stream).value_);
+                           }
+                           for (node_type* node = bucket.list_; node; node = node->next())
+                               --buffer_size_;
+                           _erase_nodes(bucket.list_, nullptr);
+                           bucket.list_ = nullptr;
+                       };
+
+        for (internal_size_type i_bucket = sweep_pos_;
+             i_bucket < sweep_pos_ + n_run; ++i_bucket)
+        {
+            if (i_bucket < split_)
+            {
+                collect(i_bucket);
+                parts.emplace_back(i_bucket, i_bucket, values.size());
+                collect(n_base + i_bucket);
+                parts.emplace_back(n_base + i_bucket, n_base + i_bucket, values.size());
+            }
+            else if (i_bucket == split_ && load_factor() > opt_load_factor_)
+            {
+                const size_t begin = values.size();
+                collect(i_bucket);
+
+                // values are sorted by hash, the upper half follows the lower
+                const size_t mid = static_cast<size_t>(
+                    std::partition_point(
+                        values.begin() + begin, values.end(),
+                        [&](const value_type& v) {
+                            return _bkt_num(v.first, 2 * n_base) % 2 == 0;
+                        }) - values.begin());
+
+                buckets_.push_back(bucket_type());
+                ++split_;
+
+                parts.emplace_back(i_bucket, i_bucket, mid);
+                parts.emplace_back(n_base + i_bucket, i_bucket, values.size());
+            }
+            else
+            {
+                collect(i_bucket);
+                parts.emplace_back(i_bucket, i_bucket, values.size());
+            }
+        }
+
+        // write the buckets to new blocks, appended to bids_
+        const size_t write_buffer_size = foxxll::config::get_instance()->disks_number() * 2;
+        const internal_size_type first_block = bids_.size();
+        bid_container_type new_bids;
+        size_t n_blocks;
+        {
+            writer_type writer(&new_bids, write_buffer_size, write_buffer_size / 2);
+
+            size_t i_value = 0;
+            for (const auto& part : parts)
+            {
+                const internal_size_type i_bucket = std::get<0>(part);
+                bucket_type& bucket = buckets_[i_bucket];
+                bucket.i_block_ = first_block + writer.i_block();
+                bucket.i_subblock_ = writer.i_subblock();
+                bucket.n_external_ = std::get<2>(part) - i_value;
+
+                for (external_size_type i_ext = 0; i_value < std::get<2>(part); ++i_value, ++i_ext)
+                {
+                    iterator_map_.fix_iterators_2ext(
+                        std::get<1>(part), values[i_value].first, i_bucket, i_ext);
+                    writer.append(values[i_value]);
+                    filter_.insert(hash_(values[i_value].first));
+                }
+                writer.finish_subblock();
+            }
+            writer.flush();
+            n_blocks = writer.i_block();
+        }
+        // the writer's destructor flushes once more, beyond n_blocks
+        bids_.insert(bids_.end(), new_bids.begin(), new_bids.begin() + n_blocks);
+        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+        bm->delete_blocks(new_bids.begin() + n_blocks, new_bids.end());
+
+        TLX_LOG << "_sweep_run() buckets=" << sweep_pos_ << "+" << n_run
+                << " of " << n_base << " split=" << split_
+                << " values=" << values.size() << " blocks=" << n_blocks;
+
+        sweep_pos_ += n_run;
+        if (sweep_pos_ == n_base)
+            _finish_sweep();
+
+        return n_run;
+    }
+
+    /*!
+     * End a sweep: all buckets were rewritten, hence the blocks from before
+     * the sweep are not used any more and released. If all base buckets were
+     * split, the round of linear hashing is complete, and the buckets are
+     * reordered by hash value.
+     */
+    void _finish_sweep()
+    {
+        if (split_ > 0 && split_ == buckets_.size() - split_)
+            _merge_split_buckets();
+        else
+            iterator_map_.fix_iterators_renumber(
+                [](internal_size_type i_bucket) { return i_bucket; });
+
+        block_cache_.flush();
+        block_cache_.clear();
+
+        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+        bm->delete_blocks(bids_.begin(), bids_.begin() + sweep_begin_block_);
+        bids_.erase(bids_.begin(), bids_.begin() + sweep_begin_block_);
+        for (bucket_type& bucket : buckets_)
+            bucket.i_block_ -= sweep_begin_block_;
+
+        _reset_sweep();
+    }
+
+    /*!
+     * Reorder the buckets by hash value, placing the upper halves of split
+     * buckets behind their lower halves, and end the round of linear hashing.
+     * Unless all base buckets were split, _bkt_num() is only valid again after
+     * the buckets are rebuilt.
+     */
+    void _merge_split_buckets()
+    {
+        if (split_ == 0)
+            return;
+
+        const internal_size_type n_split = split_;
+        const internal_size_type n_base = buckets_.size() - n_split;
+
+        auto new_index = [n_split, n_base](internal_size_type i_bucket) {
+                             if (i_bucket < n_split)
+                                 return 2 * i_bucket;
+                             if (i_bucket < n_base)
+                                 return i_bucket + n_split;
+                             return 2 * (i_bucket - n_base) + 1;
+                         };
+
+        buckets_container_type merged(buckets_.size());
+        for (internal_size_type i_bucket = 0; i_bucket < buckets_.size(); ++i_bucket)
+            merged[new_index(i_bucket)] = buckets_[i_bucket];
+        std::swap(buckets_, merged);
+
+        iterator_map_.fix_iterators_renumber(new_index);
+        split_ = 0;
+    }
+
+    //! Empty the filter and size it for n_keys keys to be written to
+    //! external memory.
+    void _reset_filter(external_size_type n_keys)
+    {
+        filter_.reset(n_keys, filter_bits_per_key_,
+                      max_buffer_size_ * sizeof(node_type) / 2);
+    }
+
     //! iterator pointing to the beginnning of the hash-map
     template <class Iterator>
     Iterator _begin() const
@@ -886,17 +1534,84 @@ public:
     //! Returns a const_iterator pointing to the end of the hash-map
     const_iterator end() const { return _end<const_iterator>(); }
 
+    //! Returns a snapshot_iterator pointing to the beginning of the hash-map:
+    //! cheaper to scan with than a const_iterator, but only valid until the
+    //! next modification, see hash_map_snapshot_iterator
+    snapshot_iterator snapshot_begin() const { return _begin<snapshot_iterator>(); }
+
+    //! Returns a snapshot_iterator pointing to the end of the hash-map
+    snapshot_iterator snapshot_end() const { return _end<snapshot_iterator>(); }
+
+    /*!
+     * Call function(value) for each value of the hash-map, in parallel and in
+     * no particular order. The buckets are partitioned into n_parts ranges,
+     * which are scanned concurrently, each by a prefetching reader with a
+     * block cache of its own, merging in the values of the internal-memory
+     * buffer. No iterators are registered, hence this is much cheaper than
+     * iterating with const_iterator, but the hash-map must not be modified
+     * until it returns. function must be safe to call from several threads;
+     * task_runtime::thread_id() tells them apart for per-thread state.
+     *
+     * \param function called as function(const value_type&)
+     * \param n_parts number of ranges, default: the number of threads
+     */
+    template <class Functor>
+    void for_each_parallel(Functor function, internal_size_type n_parts = 0) const
+    {
+        using values_stream_type = HashedValuesStream<self_type, reader_type>;
+
+        assert(!concurrent_cache_);
+
+        // minimum number of buckets per part
+        static constexpr internal_size_type min_buckets_per_part = 256;
+
+        const internal_size_type n_buckets = buckets_.size();
+        if (n_buckets == 0)
+            return;
+        if (n_parts == 0)
+            n_parts = task_runtime::get_instance().max_threads();
+        n_parts = std::max<internal_size_type>(
+            1, std::min(n_parts, n_buckets / min_buckets_per_part));
+
+        // the readers do not see the dirty blocks of the block cache
+        block_cache_.flush();
+
+        self_type* non_const_this = const_cast<self_type*>(this);
+        bid_container_type& bids = non_const_this->bids_;
+        buckets_container_type& buckets = non_const_this->buckets_;
+
+        parallel_for(
+            0, n_parts, [&](size_t p) {
+                const internal_size_type begin = n_buckets * p / n_parts;
+                const internal_size_type end = n_buckets * (p + 1) / n_parts;
+
+                block_cache_type cache(block_cache_.size());
+                // the reader stores the pages it learned to prefetch
+                tuning_parameters params = tuning_;
+
+                const size_t i_block = std::min<size_t>(
+                    buckets[begin].i_block_, bids.empty() ? 0 : bids.size() - 1);
+                reader_type reader(bids.begin() + i_block, bids.end(), cache,
+                                   buckets[begin].i_subblock_, true, params);
+                values_stream_type values(buckets.begin() + begin, buckets.begin() + end,
+                                          reader, bids.begin(), *non_const_this);
+
+                for ( ; !values.empty(); ++values)
+                    function((*values).value_);
+            });
+    }
+
 protected:
     //! Allocate a new buffer-node
     node_type * _get_node()
     {
-        return node_allocator_.allocate(1);
+        return node_pool_.allocate();
     }
 
     //! Free given node
     void _put_node(node_type* node)
     {
-        node_allocator_.deallocate(node, 1);
+        node_pool_.deallocate(node);
     }
 
     //! Allocate a new buffer-node and initialize with given value, node and
@@ -905,11 +1620,37 @@ protected:
     {
         node_type* node = _get_node();
         node->value_ = value;
+        node->next_and_del_ = nullptr;
         node->set_next(nxt);
         node->set_deleted(del);
         return node;
     }
 
+    //! Merge the value of a node buffered by upsert() with the external value
+    //! of the same key.
+    void _apply_merge(node_type* node, const value_type& ext_value) const
+    {
+        node->value_.second = merge_(ext_value.second, node->value_.second);
+        node->set_merge_pending(false);
+    }
+
+    //! Complete a pending merge of a node in the given bucket; external
+    //! memory is accessed.
+    void _resolve_merge(const bucket_type& bucket, node_type* node) const
+    {
+        if (!node->merge_pending())
+            return;
+
+        external_size_type i_external;
+        value_type ext_value;
+        std::tie(i_external, ext_value) = _find_key_external(bucket, node->value_.first);
+
+        if (i_external < bucket.n_external_ && _eq(ext_value.first, node->value_.first))
+            _apply_merge(node, ext_value);
+        else
+            node->set_merge_pending(false);
+    }
+
     //! Free nodes in range [first, last). If last is nullptr all nodes will be
     //! freed.
     void _erase_nodes(node_type* first, node_type* last)
@@ -926,7 +1667,17 @@ protected:
     //! Bucket-index for values with given key
     internal_size_type _bkt_num(const key_type& key) const
     {
-        return _bkt_num(key, buckets_.size());
+        if (split_ == 0)
+            return _bkt_num(key, buckets_.size());
+
+        // linear hashing: the first split_ of the n_base buckets were split,
+        // the upper half of bucket i is bucket n_base + i
+        const internal_size_type hash = hash_(key);
+        const internal_size_type n_base = buckets_.size() - split_;
+        const internal_size_type i_bucket = _bkt_num_of_hash(hash, n_base);
+        if (i_bucket < split_ && _bkt_num_of_hash(hash, 2 * n_base) % 2 == 1)
+            return n_base + i_bucket;
+        return i_bucket;
     }
 
     /*!
@@ -940,11 +1691,17 @@ protected:
      * http://www.cs.uaf.edu/~cs301/notes/Chapter5/node5.html
     */
     internal_size_type _bkt_num(const key_type& key, internal_size_type n) const
+    {
+        return _bkt_num_of_hash(hash_(key), n);
+    }
+
+    //! Bucket-index for values with the given hash-value, see above.
+    internal_size_type _bkt_num_of_hash(internal_size_type hash, internal_size_type n) const
     {
         //! TODO maybe specialize double arithmetic to integer. the old code
         //! was faulty -tb.
         return static_cast<internal_size_type>(
-            n * (static_cast<double>(hash_(key)) / std::numeric_limits<internal_size_type>::max()));
+            n * (static_cast<double>(hash) / std::numeric_limits<internal_size_type>::max()));
     }
 
     /*!
@@ -973,9 +1730,28 @@ protected:
      */
     std::tuple<external_size_type, value_type>
     _find_key_external(const bucket_type& bucket, const key_type& key) const
+    {
+        return _find_key_external(
+            bucket, key,
+            [this](const bucket_type& b, internal_size_type which_subblock) {
+                return _load_subblock(b, which_subblock);
+            });
+    }
+
+    //! Search for key in external part of bucket, with subblocks provided by
+    //! load_subblock(bucket, which_subblock), see above.
+    template <class SubblockLoader>
+    std::tuple<external_size_type, value_type>
+    _find_key_external(const bucket_type& bucket, const key_type& key,
+                       SubblockLoader&& load_subblock) const
     {
         subblock_type* subblock;
 
+        // definitely not stored externally
+        if (!filter_.may_contain(hash_(key)))
+            return std::tuple<external_size_type, value_type>(
+                bucket.n_external_, value_type());
+
         // number of subblocks occupied by bucket
         internal_size_type n_subblocks = static_cast<internal_size_type>(
             bucket.n_external_ / subblock_size);
@@ -985,7 +1761,7 @@ protected:
         for (internal_size_type i_subblock = 0;
              i_subblock < n_subblocks; i_subblock++)
         {
-            subblock = _load_subblock(bucket, i_subblock);
+            subblock = load_subblock(bucket, i_subblock);
             // number of values in i-th subblock
             internal_size_type n_values =
                 (i_subblock + 1 < n_subblocks)
@@ -1035,6 +1811,18 @@ protected:
     {
         n_subblocks_loaded++;
 
+        bid_type bid;
+        internal_size_type i_subblock_within;
+        std::tie(bid, i_subblock_within) = _locate_subblock(bucket, which_subblock);
+
+        return block_cache_.get_subblock(bid, i_subblock_within);
+    }
+
+    //! Block and index within it of the given bucket's i-th subblock, see
+    //! _load_subblock().
+    std::pair<bid_type, internal_size_type>
+    _locate_subblock(const bucket_type& bucket, internal_size_type which_subblock) const
+    {
         // index of the requested subblock counted from the very beginning of
         // the bucket's first block
         external_size_type i_abs_subblock = bucket.i_subblock_ + which_subblock;
@@ -1044,9 +1832,60 @@ protected:
         /* 2. */
         internal_size_type i_subblock_within = static_cast<internal_size_type>(i_abs_subblock % subblocks_per_block);
 
-        return block_cache_.get_subblock(bid, i_subblock_within);
+        return std::pair<bid_type, internal_size_type>(bid, i_subblock_within);
     }
 
+    //! Start loading the given bucket's i-th subblock, see _load_subblock().
+    void _prefetch_subblock(const bucket_type& bucket,
+                            internal_size_type which_subblock) const
+    {
+        bid_type bid;
+        internal_size_type i_subblock_within;
+        std::tie(bid, i_subblock_within) = _locate_subblock(bucket, which_subblock);
+
+        block_cache_.prefetch_subblock(bid, i_subblock_within);
+    }
+
+    //! Provides subblocks to _find_key_external() from the sharded block
+    //! cache, keeping the block of the last subblock pinned.
+    class concurrent_subblock_loader
+    {
+        const self_type& map_;
+        bid_type bid_;
+        bool pinned_ = false;
+
+    public:
+        explicit concurrent_subblock_loader(const self_type& map)
+            : map_(map) { }
+
+        //! non-copyable: delete copy-constructor
+        concurrent_subblock_loader(const concurrent_subblock_loader&) = delete;
+        //! non-copyable: delete assignment operator
+        concurrent_subblock_loader& operator = (const concurrent_subblock_loader&) = delete;
+
+        ~concurrent_subblock_loader()
+        {
+            if (pinned_)
+                map_.concurrent_cache_->unpin_subblock(bid_);
+        }
+
+        subblock_type* operator () (const bucket_type& bucket,
+                                    internal_size_type which_subblock)
+        {
+            if (pinned_)
+                map_.concurrent_cache_->unpin_subblock(bid_);
+
+            internal_size_type i_subblock_within;
+            std::tie(bid_, i_subblock_within) =
+                map_._locate_subblock(bucket, which_subblock);
+
+            subblock_type* subblock =
+                map_.concurrent_cache_->pin_subblock(bid_, i_subblock_within);
+            pinned_ = true;
+            return subblock;
+        }
+    };
+
     using hashed_value_type = HashedValue<self_type>;
 
     //! Functor to extracts the actual value from a HashedValue-struct
@@ -1113,11 +1952,15 @@ protected:
     {
         TLX_LOG << "_rebuild_buckets()";
 
-        using writer_type = buffered_writer<block_type, bid_container_type>;
-        using values_stream_type = HashedValuesStream<self_type, reader_type>;
-        using hashing_stream_type = HashingStream<values_stream_type, HashedValueExtractor>;
+        assert(!concurrent_cache_);
 
-        const size_t write_buffer_size = foxxll::config::get_instance()->disks_number() * 4;
+        STXXL_TRACE_SPAN(span, "hash_map::rehash");
+        span.add_bytes(num_total_ * sizeof(value_type));
+
+        // the values are read in the order of the buckets
+        const internal_size_type n_split = split_;
+        const internal_size_type n_base = buckets_.size() - split_;
+        _merge_split_buckets();
 
         // determine new number of buckets from desired load_factor ...
         internal_size_type n_new;
@@ -1135,23 +1978,60 @@ protected:
         bid_container_type old_bids;
         std::swap(bids_, old_bids);
 
+        // re-distribute values among new buckets.
+        _reset_filter(num_total_);
+        num_total_ = 0;
+#if STXXL_PARALLEL
+        if (rebuild_hook_ ||
+            !_rewrite_buckets_parallel(old_buckets, old_bids, n_base, n_split))
+            _rewrite_buckets(old_buckets, old_bids);
+#else
+        _rewrite_buckets(old_buckets, old_bids);
+#endif
+        block_cache_.clear();
+
+        // get rid of old blocks and buckets
+        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+        bm->delete_blocks(old_bids.begin(), old_bids.end());
+
+        for (internal_size_type i_bucket = 0;
+             i_bucket < old_buckets.size(); i_bucket++)
+        {
+            _erase_nodes(old_buckets[i_bucket].list_, nullptr);
+            old_buckets[i_bucket] = bucket_type();
+        }
+        node_pool_.recycle();
+
+        buffer_size_ = 0;
+        oblivious_ = false;
+        _reset_sweep();
+    }
+
+    //! Write the values of old_buckets, stored in old_bids, to the new buckets
+    //! in buckets_ and blocks in bids_.
+    void _rewrite_buckets(buckets_container_type& old_buckets, bid_container_type& old_bids)
+    {
+        using writer_type = buffered_writer<block_type, bid_container_type>;
+        using values_stream_type = HashedValuesStream<self_type, reader_type>;
+        using hashing_stream_type = HashingStream<values_stream_type, HashedValueExtractor>;
+
+        const size_t write_buffer_size = foxxll::config::get_instance()->disks_number() * 4;
+
         // read stored values in consecutive order
 
         // use new to control point of destruction (see below)
         reader_type* reader
-            = new reader_type(old_bids.begin(), old_bids.end(), block_cache_);
+            = new reader_type(old_bids.begin(), old_bids.end(), block_cache_,
+                              0, true, tuning_);
 
         values_stream_type values_stream(old_buckets.begin(), old_buckets.end(),
                                          *reader, old_bids.begin(), *this);
 
         writer_type writer(&bids_, write_buffer_size, write_buffer_size / 2);
 
-        // re-distribute values among new buckets.
-
         // this makes use of the fact that if value1 preceeds value2 before
         // resizing, value1 will preceed value2 after resizing as well (uniform
         // rehashing)
-        num_total_ = 0;
         for (internal_size_type i_bucket = 0;
              i_bucket < buckets_.size(); i_bucket++)
         {
@@ -1166,7 +2046,15 @@ protected:
                 const hashed_value_type& hvalue = *hasher;
                 iterator_map_.fix_iterators_2ext(hvalue.i_bucket_, hvalue.value_.first, i_bucket, i_ext);
 
-                writer.append(hvalue.value_);
+                if (rebuild_hook_)
+                {
+                    value_type value = hvalue.value_;
+                    rebuild_hook_(value);
+                    writer.append(value);
+                }
+                else
+                    writer.append(hvalue.value_);
+                filter_.insert(hash_(hvalue.value_.first));
                 ++hasher;
                 ++i_ext;
             }
@@ -1179,22 +2067,199 @@ protected:
         // reader must be deleted before deleting old_bids because its
         // destructor will dereference the bid-iterator
         delete reader;
-        block_cache_.clear();
+    }
 
-        // get rid of old blocks and buckets
+#if STXXL_PARALLEL
+    /*!
+     * Parallel version of _rewrite_buckets(). The old buckets are partitioned
+     * into one range per thread, and each thread reads its range through its
+     * own block cache and reader and writes the new buckets its values fall
+     * into to its own blocks. As the old and new bucket boundaries differ, a
+     * new bucket at the border of two ranges receives values of two threads;
+     * these are collected in internal memory and written after the threads
+     * joined. The blocks of the threads are then concatenated.
+     *
+     * No iterators may be registered, as they cannot be fixed concurrently,
+     * and each thread must have a new bucket of its own, otherwise nothing is
+     * done and false is returned.
+     *
+     * \param n_base number of base buckets before _merge_split_buckets()
+     * \param n_split number of split buckets before _merge_split_buckets()
+     */
+    bool _rewrite_buckets_parallel(buckets_container_type& old_buckets,
+                                   bid_container_type& old_bids,
+                                   internal_size_type n_base,
+                                   internal_size_type n_split)
+    {
+        using writer_type = buffered_writer<block_type, bid_container_type>;
+        using values_stream_type = HashedValuesStream<self_type, reader_type>;
+        using hashing_stream_type = HashingStream<values_stream_type, HashedValueExtractor>;
+
+        // minimum number of old buckets per thread
+        static constexpr internal_size_type min_buckets_per_thread = 256;
+
+        const internal_size_type n_old = old_buckets.size();
+        const internal_size_type n_new = buckets_.size();
+        const size_t num_threads = static_cast<size_t>(std::min<internal_size_type>(
+            static_cast<internal_size_type>(omp_get_max_threads()),
+            n_old / min_buckets_per_thread));
+
+        if (num_threads <= 1 || !iterator_map_.empty())
+            return false;
+
+        // old bucket of a hash value: the buckets were merged in hash order,
+        // split buckets came first and have half the size
+        auto old_bkt_num_of_hash = [&](internal_size_type hash) {
+                                       const internal_size_type i_bucket = _bkt_num_of_hash(hash, n_base);
+                                       if (i_bucket < n_split)
+                                           return _bkt_num_of_hash(hash, 2 * n_base);
+                                       return i_bucket + n_split;
+                                   };
+
+        // thread t reads the old buckets [old_begin[t], old_begin[t + 1]),
+        // whose values fall into the new buckets [new_begin[t], new_begin[t +
+        // 1]], the last one being shared with the next thread.
+        std::vector<internal_size_type> old_begin(num_threads + 1), new_begin(num_threads + 1);
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            old_begin[t] = static_cast<internal_size_type>(n_old * t / num_threads);
+
+            // smallest hash value of old bucket old_begin[t]
+            internal_size_type lo = 0, hi = std::numeric_limits<internal_size_type>::max();
+            while (lo < hi)
+            {
+                const internal_size_type mid = lo + (hi - lo) / 2;
+                if (old_bkt_num_of_hash(mid) >= old_begin[t])
+                    hi = mid;
+                else
+                    lo = mid + 1;
+            }
+            new_begin[t] = t == 0 ? 0 : _bkt_num_of_hash(lo, n_new);
+
+            if (t > 0 && new_begin[t] <= new_begin[t - 1])
+                return false;
+        }
+        old_begin[num_threads] = n_old;
+        new_begin[num_threads] = n_new;
+        if (new_begin[num_threads - 1] >= n_new)
+            return false;
+
+        TLX_LOG << "_rewrite_buckets_parallel() threads=" << num_threads
+                << " buckets=" << n_old << "->" << n_new;
+
+        const size_t write_buffer_size = foxxll::config::get_instance()->disks_number() * 4;
+
+        // for each thread: its blocks, the number of blocks written, its
+        // values of its first and last new bucket, and its number of values
+        std::vector<bid_container_type> thread_bids(num_threads);
+        std::vector<size_t> thread_blocks(num_threads);
+        std::vector<std::vector<value_type> > head(num_threads), tail(num_threads);
+        std::vector<external_size_type> thread_total(num_threads);
+
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            block_cache_type cache(block_cache_.size());
+            // the reader stores the pages it learned to prefetch
+            tuning_parameters params = tuning_;
+
+            const bucket_type& first = old_buckets[old_begin[t]];
+            reader_type reader(old_bids.begin() + std::min<size_t>(first.i_block_, old_bids.size()),
+                               old_bids.end(), cache, first.i_subblock_, true, params);
+            values_stream_type values_stream(
+                old_buckets.begin() + old_begin[t], old_buckets.begin() + old_begin[t + 1],
+                reader, old_bids.begin(), *this);
+
+            writer_type writer(&thread_bids[t], write_buffer_size, write_buffer_size / 2);
+
+            const internal_size_type new_end =
+                t + 1 < num_threads ? new_begin[t + 1] + 1 : n_new;
+            for (internal_size_type i_bucket = new_begin[t]; i_bucket < new_end; ++i_bucket)
+            {
+                hashing_stream_type hasher(values_stream, i_bucket, HashedValueExtractor(), this);
+
+                std::vector<value_type>* shared =
+                    (t > 0 && i_bucket == new_begin[t]) ? &head[t]
+                    : (t + 1 < num_threads && i_bucket == new_begin[t + 1]) ? &tail[t]
+                    : nullptr;
+
+                if (shared)
+                {
+                    for ( ; !hasher.empty(); ++hasher)
+                    {
+                        shared->push_back((*hasher).value_);
+                        filter_.concurrent_insert(hash_((*hasher).value_.first));
+                    }
+                    thread_total[t] += hasher.bucket_size_;
+                    continue;
+                }
+
+                // block index local to the thread, offset below
+                buckets_[i_bucket] = bucket_type();
+                buckets_[i_bucket].i_block_ = writer.i_block();
+                buckets_[i_bucket].i_subblock_ = writer.i_subblock();
+
+                for ( ; !hasher.empty(); ++hasher)
+                {
+                    writer.append((*hasher).value_);
+                    filter_.concurrent_insert(hash_((*hasher).value_.first));
+                }
+
+                writer.finish_subblock();
+                buckets_[i_bucket].n_external_ = hasher.bucket_size_;
+                thread_total[t] += hasher.bucket_size_;
+            }
+            writer.flush();
+            thread_blocks[t] = writer.i_block();
+        }
+
+        // concatenate the blocks of the threads, the writers' destructors
+        // flushed once more, beyond thread_blocks
         foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-        bm->delete_blocks(old_bids.begin(), old_bids.end());
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            const internal_size_type offset = bids_.size();
+            const internal_size_type new_end =
+                t + 1 < num_threads ? new_begin[t + 1] : n_new;
+            for (internal_size_type i_bucket = new_begin[t] + (t > 0); i_bucket < new_end; ++i_bucket)
+                buckets_[i_bucket].i_block_ += offset;
+
+            bids_.insert(bids_.end(), thread_bids[t].begin(),
+                         thread_bids[t].begin() + thread_blocks[t]);
+            bm->delete_blocks(thread_bids[t].begin() + thread_blocks[t], thread_bids[t].end());
+            num_total_ += thread_total[t];
+        }
 
-        for (internal_size_type i_bucket = 0;
-             i_bucket < old_buckets.size(); i_bucket++)
+        // write the shared buckets: the values of the lower thread have the
+        // smaller hash values
+        bid_container_type shared_bids;
+        size_t n_blocks;
         {
-            _erase_nodes(old_buckets[i_bucket].list_, nullptr);
-            old_buckets[i_bucket] = bucket_type();
+            writer_type writer(&shared_bids, write_buffer_size, write_buffer_size / 2);
+            const internal_size_type offset = bids_.size();
+            for (size_t t = 1; t < num_threads; ++t)
+            {
+                bucket_type& bucket = buckets_[new_begin[t]];
+                bucket = bucket_type();
+                bucket.i_block_ = offset + writer.i_block();
+                bucket.i_subblock_ = writer.i_subblock();
+                bucket.n_external_ = tail[t - 1].size() + head[t].size();
+
+                for (const value_type& value : tail[t - 1])
+                    writer.append(value);
+                for (const value_type& value : head[t])
+                    writer.append(value);
+                writer.finish_subblock();
+            }
+            writer.flush();
+            n_blocks = writer.i_block();
         }
+        bids_.insert(bids_.end(), shared_bids.begin(), shared_bids.begin() + n_blocks);
+        bm->delete_blocks(shared_bids.begin() + n_blocks, shared_bids.end());
 
-        buffer_size_ = 0;
-        oblivious_ = false;
+        return true;
     }
+#endif
 
     /*!
      * Stream for filtering duplicates. Used to eliminate duplicated values
@@ -1326,6 +2391,9 @@ public:
 
         TLX_LOG << "insert() items=" << (l - f) << " buckets_new=" << n_buckets_new;
 
+        // the old values are read in the order of the buckets
+        _merge_split_buckets();
+
         // prepare new buckets and bids
         buckets_container_type old_buckets(static_cast<internal_size_type>(n_buckets_new));
         std::swap(buckets_, old_buckets);
@@ -1335,7 +2403,7 @@ public:
 
         // already stored values ("old values")
         reader_type* reader = new reader_type(old_bids.begin(), old_bids.end(),
-                                              block_cache_);
+                                              block_cache_, 0, true, tuning_);
         old_values_stream old_values(old_buckets.begin(), old_buckets.end(),
                                      *reader, old_bids.begin(), *this);
 
@@ -1347,6 +2415,7 @@ public:
 
         writer_type writer(&bids_, write_buffer_size, write_buffer_size / 2);
 
+        _reset_filter(num_total_new);
         num_total_ = 0;
         for (internal_size_type i_bucket = 0; i_bucket < buckets_.size(); i_bucket++)
         {
@@ -1372,6 +2441,7 @@ public:
                     const hashed_value_type& hvalue = *old_hasher;
                     iterator_map_.fix_iterators_2ext(hvalue.i_bucket_, hvalue.value_.first, i_bucket, bucket_size);
                     writer.append(hvalue.value_);
+                    filter_.insert(old_hash);
                     ++old_hasher;
                 }
                 // new value smaller or equal => new value wins
@@ -1384,6 +2454,7 @@ public:
                         ++old_hasher;
                     }
                     writer.append((*new_hasher).second);
+                    filter_.insert(new_hash);
                     ++new_hasher;
                 }
                 ++bucket_size;
@@ -1394,6 +2465,7 @@ public:
                 const hashed_value_type& hvalue = *old_hasher;
                 iterator_map_.fix_iterators_2ext(hvalue.i_bucket_, hvalue.value_.first, i_bucket, bucket_size);
                 writer.append(hvalue.value_);
+                filter_.insert(hash_(hvalue.value_.first));
                 ++old_hasher;
                 ++bucket_size;
             }
@@ -1401,6 +2473,7 @@ public:
             while (!new_hasher.empty())
             {
                 writer.append((*new_hasher).second);
+                filter_.insert((*new_hasher).first);
                 ++new_hasher;
                 ++bucket_size;
             }
@@ -1424,9 +2497,81 @@ public:
             _erase_nodes(old_buckets[i_bucket].list_, nullptr);
             old_buckets[i_bucket] = bucket_type();
         }
+        node_pool_.recycle();
 
         buffer_size_ = 0;
         oblivious_ = false;
+        _reset_sweep();
+    }
+
+    //! Bulk-load the values of a stream into the empty hash-map. The values
+    //! are sorted by bucket and the buckets are written sequentially in a
+    //! single pass, no stored data is read. Of several values with equal keys
+    //! only one is kept.
+    //! \param input stream of values
+    //! \param num_values (estimated) number of values in the stream,
+    //! determines the number of buckets
+    //! \param mem internal memory that may be used for sorting (note: this
+    //! memory will be used additionally to the buffer). The more the better
+    template <class InputStream>
+    void bulk_load(InputStream& input, external_size_type num_values,
+                   internal_size_type mem)
+    {
+        assert(num_total_ == 0 && buffer_size_ == 0 && bids_.empty());
+
+        //! values with added hash: (hash, (key, mapped))
+        using values_stream = AddHashStream<InputStream>;
+        //! values sorted by <hash-value, key>
+        using sorted_values_stream = stxxl::stream::sort<values_stream, Cmp>;
+        //! values sorted by <hash-value, key> with duplicates eliminated
+        using unique_values_stream = UniqueValueStream<sorted_values_stream>;
+
+        using writer_type = buffered_writer<block_type, bid_container_type>;
+
+        const size_t write_buffer_size = foxxll::config::get_instance()->disks_number() * 2;
+
+        external_size_type n_buckets = static_cast<external_size_type>(ceil(
+                                                                           static_cast<double>(num_values) / (subblock_size * opt_load_factor())));
+        if (n_buckets > max_bucket_count())
+            n_buckets = max_bucket_count();
+        if (n_buckets == 0)
+            n_buckets = 1;
+
+        TLX_LOG << "bulk_load() items=" << num_values << " buckets=" << n_buckets;
+
+        buckets_container_type(static_cast<internal_size_type>(n_buckets)).swap(buckets_);
+
+        values_stream values(input, *this);
+        sorted_values_stream sorted_values(values, Cmp(*this), mem);
+        unique_values_stream unique_values(sorted_values, *this);
+
+        writer_type writer(&bids_, write_buffer_size, write_buffer_size / 2);
+
+        _reset_filter(num_values);
+        for (internal_size_type i_bucket = 0; i_bucket < buckets_.size(); i_bucket++)
+        {
+            buckets_[i_bucket].i_block_ = writer.i_block();
+            buckets_[i_bucket].i_subblock_ = writer.i_subblock();
+
+            // the hash-value was computed for sorting, use it for the bucket
+            internal_size_type bucket_size = 0;
+            while (!unique_values.empty() &&
+                   _bkt_num_of_hash((*unique_values).first, buckets_.size()) == i_bucket)
+            {
+                writer.append((*unique_values).second);
+                filter_.insert((*unique_values).first);
+                ++unique_values;
+                ++bucket_size;
+            }
+
+            writer.finish_subblock();
+            buckets_[i_bucket].n_external_ = bucket_size;
+            num_total_ += bucket_size;
+        }
+        writer.flush();
+        _reset_sweep();
+
+        assert(unique_values.empty());
     }
 
 protected:
@@ -1457,6 +2602,7 @@ protected:
     friend class hash_map_iterator_base<self_type>;
     friend class hash_map_iterator<self_type>;
     friend class hash_map_const_iterator<self_type>;
+    friend class hash_map_snapshot_iterator<self_type>;
     friend class iterator_map<self_type>;
     friend class block_cache<block_type>;
     friend struct HashedValuesStream<self_type, reader_type>;
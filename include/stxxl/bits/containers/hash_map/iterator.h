@@ -28,6 +28,8 @@ class hash_map_iterator;
 template <class HashMap>
 class hash_map_const_iterator;
 template <class HashMap>
+class hash_map_snapshot_iterator;
+template <class HashMap>
 class block_cache;
 
 template <class HashMap>
@@ -86,12 +88,15 @@ protected:
     bool ext_valid_;
     //! true if iterator equals end()
     bool end_;
+    //! false for snapshot iterators, which the iterator_map does not fix,
+    //! see hash_map_snapshot_iterator
+    bool registered_;
 
 public:
     //! Construct a new iterator
     hash_map_iterator_base(HashMap* map, internal_size_type i_bucket, node_type* node,
                            external_size_type i_external, source_type source,
-                           bool ext_valid, key_type key)
+                           bool ext_valid, key_type key, bool registered = true)
         : map_(map),
           reader_(nullptr),
           prefetch_(false),
@@ -101,14 +106,16 @@ public:
           i_external_(i_external),
           key_(key),
           ext_valid_(ext_valid),
-          end_(false)
+          end_(false),
+          registered_(registered)
     {
         TLX_LOG << "hash_map_iterator_base parameter construct addr=" << this;
-        map_->iterator_map_.register_iterator(*this);
+        if (registered_)
+            map_->iterator_map_.register_iterator(*this);
     }
 
     //! Construct a new iterator pointing to the end of the given hash-map.
-    explicit hash_map_iterator_base(hash_map_type* map)
+    explicit hash_map_iterator_base(hash_map_type* map, bool registered = true)
         : map_(map),
           reader_(nullptr),
           prefetch_(false),
@@ -117,7 +124,8 @@ public:
           node_(nullptr),
           i_external_(0),
           ext_valid_(false),
-          end_(true)
+          end_(true),
+          registered_(registered)
     { }
 
     //! Construct a new iterator from an existing one
@@ -131,11 +139,12 @@ public:
           i_external_(obj.i_external_),
           key_(obj.key_),
           ext_valid_(obj.ext_valid_),
-          end_(obj.end_)
+          end_(obj.end_),
+          registered_(obj.registered_)
     {
         TLX_LOG << "hash_map_iterator_base constr from" << (&obj) << " to " << this;
 
-        if (!end_ && map_)
+        if (!end_ && map_ && registered_)
             map_->iterator_map_.register_iterator(*this);
     }
 
@@ -146,7 +155,7 @@ public:
 
         if (&obj != this)
         {
-            if (map_ && !end_)
+            if (map_ && !end_ && registered_)
                 map_->iterator_map_.unregister_iterator(*this);
 
             reset_reader();
@@ -160,8 +169,9 @@ public:
             prefetch_ = obj.prefetch_;
             end_ = obj.end_;
             key_ = obj.key_;
+            registered_ = obj.registered_;
 
-            if (map_ && !end_)
+            if (map_ && !end_ && registered_)
                 map_->iterator_map_.register_iterator(*this);
         }
         return *this;
@@ -199,7 +209,7 @@ protected:
         bid_iterator_type end = map_->bids_.end();
 
         reader_ = new reader_type(begin, end, map_->block_cache_,
-                                  bucket.i_subblock_, prefetch_);
+                                  bucket.i_subblock_, prefetch_, map_->tuning_);
 
         // external value's index already known
         if (ext_valid_)
@@ -294,6 +304,8 @@ public:
                     node_ = tmp_node;
                     if (map_->_eq(node_->value_.first, reader_->const_value().first))
                     {
+                        if (node_->merge_pending())
+                            map_->_apply_merge(node_, reader_->const_value());
                         ++i_external_;
                         ++(*reader_);
                     }
@@ -357,6 +369,9 @@ public:
         }
 
 end_search:
+        if (!registered_)
+            return;
+
         if (end_)
         {
             this->map_->iterator_map_.unregister_iterator(*this, i_bucket_old);
@@ -372,7 +387,7 @@ end_search:
     {
         TLX_LOG << "hash_map_iterator_base deconst " << this;
 
-        if (map_ && !end_)
+        if (map_ && !end_ && registered_)
             map_->iterator_map_.unregister_iterator(*this);
         reset_reader();
     }
@@ -580,6 +595,97 @@ public:
     }
 };
 
+/*!
+ * Read-only iterator that is not registered with the iterator_map of the
+ * hash-map, hence copying it and moving it between buckets costs no
+ * bookkeeping. It is not fixed by modifications either: it is valid only
+ * until the next modification of the hash-map. Meant for scans, see
+ * hash_map::snapshot_begin().
+ */
+template <class HashMap>
+class hash_map_snapshot_iterator : public hash_map_iterator_base<HashMap>
+{
+public:
+    using hash_map_type = HashMap;
+    using internal_size_type = typename hash_map_type::internal_size_type;
+    using external_size_type = typename hash_map_type::external_size_type;
+    using value_type = typename hash_map_type::value_type;
+    using key_type = typename hash_map_type::key_type;
+    using reference = typename hash_map_type::const_reference;
+    using const_reference = typename hash_map_type::const_reference;
+    using pointer = typename hash_map_type::const_pointer;
+    using const_pointer = typename hash_map_type::const_pointer;
+    using node_type = typename hash_map_type::node_type;
+    using source_type = typename hash_map_type::source_type;
+
+    using iterator_category = std::forward_iterator_tag;
+
+    using base_type = stxxl::hash_map::hash_map_iterator_base<hash_map_type>;
+
+public:
+    hash_map_snapshot_iterator(hash_map_type* map, internal_size_type i_bucket,
+                               node_type* node, external_size_type i_external,
+                               source_type source, bool ext_valid, key_type key)
+        : base_type(map, i_bucket, node, i_external, source, ext_valid, key, false)
+    { }
+
+    hash_map_snapshot_iterator()
+        : base_type(nullptr, false)
+    { }
+
+    explicit hash_map_snapshot_iterator(hash_map_type* map)
+        : base_type(map, false)
+    { }
+
+    hash_map_snapshot_iterator(const hash_map_snapshot_iterator& obj)
+        : base_type(obj)
+    { }
+
+    hash_map_snapshot_iterator& operator = (const hash_map_snapshot_iterator& obj)
+    {
+        base_type::operator = (obj);
+        return *this;
+    }
+
+    bool operator == (const hash_map_snapshot_iterator& obj) const
+    {
+        return base_type::operator == (obj);
+    }
+
+    bool operator != (const hash_map_snapshot_iterator& obj) const
+    {
+        return base_type::operator != (obj);
+    }
+
+    //! Return const-reference to current value
+    const_reference operator * ()
+    {
+        if (this->source_ == hash_map_type::src_internal)
+        {
+            return this->node_->value_;
+        }
+        else
+        {
+            if (this->reader_ == nullptr)
+                base_type::init_reader();
+
+            return this->reader_->const_value();
+        }
+    }
+
+    const_pointer operator -> ()
+    {
+        return &operator * ();
+    }
+
+    //! Increment iterator
+    hash_map_snapshot_iterator<hash_map_type>& operator ++ ()
+    {
+        base_type::find_next(true);
+        return *this;
+    }
+};
+
 } // namespace hash_map
 } // namespace stxxl
 
@@ -92,6 +92,12 @@ public:
         it_map_.clear();
     }
 
+    //! Whether no iterators are registered.
+    bool empty() const
+    {
+        return it_map_.empty();
+    }
+
     void register_iterator(iterator_base& it)
     {
         register_iterator(it, it.i_bucket_);
@@ -164,13 +170,16 @@ public:
     }
 
     //! Update iterators with given key and bucket and make them point to the
-    //! specified node in internal memory (will be called by insert_oblivious)
-    void fix_iterators_2int(internal_size_type i_bucket, const key_type& key, node_type* node)
+    //! specified node in internal memory (will be called by insert_oblivious
+    //! and upsert)
+    //! \return number of iterators fixed
+    size_t fix_iterators_2int(internal_size_type i_bucket, const key_type& key, node_type* node)
     {
         TLX_LOG << "hash_map::iterator_map fix_iterators_2int i_bucket=" << i_bucket << " node=" << node;
 
         std::vector<iterator_base*> its2fix;
         _find(i_bucket, its2fix);
+        size_t n_fixed = 0;
 
         for (typename std::vector<iterator_base*>::iterator
              it2fix = its2fix.begin(); it2fix != its2fix.end(); ++it2fix)
@@ -180,12 +189,14 @@ public:
 
             assert((**it2fix).source_ == hash_map_type::src_external);
 
+            ++n_fixed;
             (**it2fix).source_ = hash_map_type::src_internal;
             (**it2fix).node_ = node;
             (**it2fix).i_external_++;
             if ((**it2fix).reader_)
                 (**it2fix).reader_->operator ++ ();
         }
+        return n_fixed;
     }
 
     //! Update iterators with given key and bucket and make them point to the
@@ -209,6 +220,24 @@ public:
         }
     }
 
+    //! Update the buckets of all iterators by the given function of the old
+    //! bucket and reset their readers (used when the buckets are reordered or
+    //! their blocks moved by incremental rehashing)
+    template <class BucketMap>
+    void fix_iterators_renumber(BucketMap bucket_map)
+    {
+        multimap_type new_map;
+        for (mmiterator_type it2fix = it_map_.begin();
+             it2fix != it_map_.end(); ++it2fix)
+        {
+            iterator_base& it = *(*it2fix).second;
+            it.i_bucket_ = bucket_map(it.i_bucket_);
+            it.reset_reader();
+            new_map.insert(pair_type(it.i_bucket_, &it));
+        }
+        std::swap(it_map_, new_map);
+    }
+
     //! Update all iterators and make them point to the end of the hash-map
     //! (used by clear())
     void fix_iterators_all2end()
@@ -20,28 +20,45 @@
 namespace stxxl {
 namespace hash_map {
 
-//! Tuning parameters for external memory hash map.
-class tuning : public foxxll::singleton<tuning>
+//! Tuning parameters for external memory hash map. Each hash map copies the
+//! defaults of the tuning singleton on construction and may override them,
+//! see hash_map::set_tuning().
+struct tuning_parameters
 {
-    friend class foxxll::singleton<tuning>;
-
-public:
     //! see buffered_reader
     size_t prefetch_page_size;
-    //! see buffered_reader
+    //! see buffered_reader, the minimum if adaptive_prefetch is set
     size_t prefetch_pages;
     //! see block_cache and hash_map
     size_t blockcache_size;
+    //! adapt the number of prefetched pages to stalls observed while reading,
+    //! see buffered_reader
+    bool adaptive_prefetch;
+    //! maximum number of prefetched pages if adaptive_prefetch is set
+    size_t max_prefetch_pages;
+    //! number of prefetched pages learned by previous readers, 0 if none
+    size_t learned_prefetch_pages;
 
-private:
     /*! set reasonable default values for tuning params */
-    tuning()
+    tuning_parameters()
         : prefetch_page_size(foxxll::config::get_instance()->disks_number() * 2),
           prefetch_pages(2),
-          blockcache_size(foxxll::config::get_instance()->disks_number() * 12)
+          blockcache_size(foxxll::config::get_instance()->disks_number() * 12),
+          adaptive_prefetch(true),
+          max_prefetch_pages(16),
+          learned_prefetch_pages(0)
     { }
 };
 
+//! Default tuning parameters of all external memory hash maps.
+class tuning : public foxxll::singleton<tuning>, public tuning_parameters
+{
+    friend class foxxll::singleton<tuning>;
+
+private:
+    tuning() = default;
+};
+
 } // namespace hash_map
 } // namespace stxxl
 
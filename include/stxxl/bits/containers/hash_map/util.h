@@ -15,6 +15,12 @@
 #define STXXL_CONTAINERS_HASH_MAP_UTIL_HEADER
 #define STXXL_CONTAINERS_HASHMAP__UTIL_H
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <utility>
+#include <vector>
+
 #include <foxxll/mng/block_manager.hpp>
 #include <foxxll/mng/buf_writer.hpp>
 
@@ -26,7 +32,8 @@ namespace stxxl {
 namespace hash_map {
 
 // For internal memory chaining: struct to compose next-pointer and delete-flag
-// share the same memory: the lowest bit is occupied by the del-flag.
+// share the same memory: the lowest bit is occupied by the del-flag, the
+// second lowest by the merge-flag.
 template <class ValueType>
 struct node
 {
@@ -38,25 +45,39 @@ struct node
     {
         return (reinterpret_cast<uintptr_t>(next_and_del_) & 0x01) == 1;
     }
-    //! change deleted flag on the next node
+    //! change deleted flag on the next node; clears the merge-flag
     bool set_deleted(bool d)
     {
         next_and_del_ = reinterpret_cast<node<ValueType>*>(
-            (reinterpret_cast<uintptr_t>(next_and_del_) & ~uintptr_t(0x01u)) | static_cast<uintptr_t>(d));
+            (reinterpret_cast<uintptr_t>(next_and_del_) & ~uintptr_t(0x03u)) | static_cast<uintptr_t>(d));
         return d;
     }
 
+    //! check if the value still has to be merged with the external value of
+    //! the same key (see hash_map::upsert)
+    bool merge_pending()
+    {
+        return (reinterpret_cast<uintptr_t>(next_and_del_) & 0x02) != 0;
+    }
+    //! change the merge-flag
+    bool set_merge_pending(bool m)
+    {
+        next_and_del_ = reinterpret_cast<node<ValueType>*>(
+            (reinterpret_cast<uintptr_t>(next_and_del_) & ~uintptr_t(0x02u)) | (static_cast<uintptr_t>(m) << 1));
+        return m;
+    }
+
     //! return the next node, without the "next" flag.
     node<ValueType> * next()
     {
         return reinterpret_cast<node<ValueType>*>(
-            reinterpret_cast<uintptr_t>(next_and_del_) & ~uintptr_t(0x01u));
+            reinterpret_cast<uintptr_t>(next_and_del_) & ~uintptr_t(0x03u));
     }
     //! change the "next" value of next node pointer
     node<ValueType> * set_next(node<ValueType>* n)
     {
         next_and_del_ = reinterpret_cast<node<ValueType>*>(
-            (reinterpret_cast<uintptr_t>(next_and_del_) & 0x01u) | reinterpret_cast<uintptr_t>(n));
+            (reinterpret_cast<uintptr_t>(next_and_del_) & 0x03u) | reinterpret_cast<uintptr_t>(n));
 
         return n;
     }
@@ -94,7 +115,141 @@ struct bucket
     { }
 };
 
-//! Used to scan external memory with prefetching.
+/*!
+ * Pool of buffer-nodes: nodes are carved from large chunks, hence an insertion
+ * needs no call of the allocator, and nodes allocated one after another are
+ * adjacent in memory. Freed nodes are chained into a free-list through their
+ * next-pointer. Chunks are kept until release().
+ */
+template <class NodeType, class Allocator>
+class node_pool
+{
+public:
+    using node_type = NodeType;
+    using allocator_type = Allocator;
+
+    //! number of nodes per chunk, about 64 KiB
+    enum { chunk_size = (64 * 1024) / sizeof(node_type) > 0
+                        ? (64 * 1024) / sizeof(node_type) : 1 };
+
+private:
+    allocator_type alloc_;
+    //! all chunks of chunk_size nodes
+    std::vector<node_type*> chunks_;
+    //! index of the chunk nodes are currently carved from
+    size_t i_chunk_;
+    //! next unused node in chunks_[i_chunk_]
+    size_t i_node_;
+    //! first node of the free-list
+    node_type* free_;
+    //! number of nodes handed out
+    size_t n_used_;
+
+public:
+    explicit node_pool(const allocator_type& a = allocator_type())
+        : alloc_(a), i_chunk_(0), i_node_(0), free_(nullptr), n_used_(0)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    node_pool(const node_pool&) = delete;
+    //! non-copyable: delete assignment operator
+    node_pool& operator = (const node_pool&) = delete;
+
+    ~node_pool()
+    {
+        release();
+    }
+
+    //! Get a node, its contents are uninitialized.
+    node_type * allocate()
+    {
+        ++n_used_;
+        if (free_)
+        {
+            node_type* node = free_;
+            free_ = free_->next_and_del_;
+            return node;
+        }
+        if (i_chunk_ == chunks_.size())
+            chunks_.push_back(alloc_.allocate(chunk_size));
+
+        node_type* node = chunks_[i_chunk_] + i_node_;
+        if (++i_node_ == chunk_size)
+        {
+            ++i_chunk_;
+            i_node_ = 0;
+        }
+        return node;
+    }
+
+    //! Return a node to the pool.
+    void deallocate(node_type* node)
+    {
+        assert(n_used_ > 0);
+        --n_used_;
+        node->next_and_del_ = free_;
+        free_ = node;
+    }
+
+    //! If no node is in use: forget the free-list and carve nodes from the
+    //! first chunk again, such that new nodes are adjacent.
+    void recycle()
+    {
+        if (n_used_ != 0)
+            return;
+        free_ = nullptr;
+        i_chunk_ = 0;
+        i_node_ = 0;
+    }
+
+    //! Free all chunks. No node must be in use.
+    void release()
+    {
+        assert(n_used_ == 0);
+        for (node_type* chunk : chunks_)
+            alloc_.deallocate(chunk, chunk_size);
+        chunks_.clear();
+        recycle();
+    }
+
+    //! Number of nodes handed out.
+    size_t size() const
+    {
+        return n_used_;
+    }
+
+    //! Number of bytes of internal memory allocated.
+    size_t mem_cons() const
+    {
+        return chunks_.size() * chunk_size * sizeof(node_type);
+    }
+
+    allocator_type get_allocator() const
+    {
+        return alloc_;
+    }
+
+    void swap(node_pool& obj)
+    {
+        std::swap(alloc_, obj.alloc_);
+        std::swap(chunks_, obj.chunks_);
+        std::swap(i_chunk_, obj.i_chunk_);
+        std::swap(i_node_, obj.i_node_);
+        std::swap(free_, obj.free_);
+        std::swap(n_used_, obj.n_used_);
+    }
+};
+
+/*!
+ * Used to scan external memory with prefetching. The reader keeps up to
+ * prefetch_pages pages of page_size blocks prefetched ahead of the current
+ * block, refilling them page by page. With tuning_parameters::adaptive_prefetch
+ * the number of pages adapts to the disk: it is increased whenever the reader
+ * had to wait for a block for a noticeable part of the time spent on the
+ * previous one, i.e. if the I/O did not keep up with consumption, and slowly
+ * decreased again while no waits occur. The depth learned is kept in the
+ * tuning parameters for the next reader.
+ */
 template <class CacheType, class BidIterator>
 class buffered_reader
 {
@@ -111,6 +266,8 @@ public:
     enum { block_size = block_type::size, subblock_size = subblock_type::size };
 
 private:
+    using clock_type = std::chrono::steady_clock;
+
     //! index within current block
     size_t i_value_;
     //! points to the beginning of the block-sequence
@@ -124,13 +281,22 @@ private:
 
     //! shared block-cache
     cache_type& cache_;
+    //! tuning parameters, receives the learned prefetch depth
+    tuning_parameters& params_;
 
     //! true if prefetching enabled
     bool prefetch_;
     //! pages, which are read at once from disk, consist of this many blocks
     const size_t page_size_;
     //! number of pages to prefetch
-    const size_t prefetch_pages_;
+    size_t prefetch_pages_;
+    //! bounds of prefetch_pages_
+    const size_t min_prefetch_pages_, max_prefetch_pages_;
+
+    //! time the last block was entered, zero after (re)starting prefetching
+    clock_type::time_point entered_;
+    //! number of blocks entered without waiting
+    size_t n_calm_blocks_;
 
     //! current block dirty ?
     bool dirty_;
@@ -144,20 +310,36 @@ public:
     //! \param cache Block-cache used for prefetching
     //! \param i_subblock Start reading from this subblock
     //! \param prefetch Enable/Disable prefetching
+    //! \param params Tuning parameters, the hash map's or the defaults
     buffered_reader(bid_iterator seq_begin, bid_iterator seq_end,
                     cache_type& cache,
-                    size_t i_subblock = 0, bool prefetch = true)
+                    size_t i_subblock = 0, bool prefetch = true,
+                    tuning_parameters& params = *tuning::get_instance())
         : i_value_(0),
           begin_bid_(seq_begin),
           curr_bid_(seq_begin),
           end_bid_(seq_end),
           cache_(cache),
+          params_(params),
           prefetch_(false),
-          page_size_(tuning::get_instance()->prefetch_page_size),
-          prefetch_pages_(tuning::get_instance()->prefetch_pages),
+          page_size_(std::max<size_t>(params.prefetch_page_size, 1)),
+          min_prefetch_pages_(params.prefetch_pages),
+          // at most half of the cache is filled by prefetching, otherwise
+          // blocks prefetched would kick each other out
+          max_prefetch_pages_(
+              params.adaptive_prefetch
+              ? std::max(min_prefetch_pages_,
+                         std::min(params.max_prefetch_pages,
+                                  cache.size() / (2 * page_size_)))
+              : min_prefetch_pages_),
+          n_calm_blocks_(0),
           dirty_(false),
           subblock_(nullptr)
     {
+        prefetch_pages_ = std::min(
+            max_prefetch_pages_,
+            std::max(min_prefetch_pages_, params.learned_prefetch_pages));
+
         if (seq_begin == seq_end)
             return;
 
@@ -177,6 +359,9 @@ public:
     {
         if (curr_bid_ != end_bid_)
             cache_.release_block(*curr_bid_);
+
+        if (prefetch_ && max_prefetch_pages_ > min_prefetch_pages_)
+            params_.learned_prefetch_pages = prefetch_pages_;
     }
 
     void enable_prefetching()
@@ -185,18 +370,74 @@ public:
             return;
 
         prefetch_ = true;
+        restart_prefetching();
+    }
+
+    //! Number of pages currently prefetched ahead.
+    size_t prefetch_pages() const
+    {
+        return prefetch_pages_;
+    }
+
+private:
+    //! start prefetching page_size*prefetch_pages blocks beginning with
+    //! current one
+    void restart_prefetching()
+    {
         pref_bid_ = curr_bid_;
-        // start prefetching page_size*prefetch_pages blocks beginning with current one
-        for (size_t i = 0; i < page_size_ * prefetch_pages_; i++)
-        {
-            if (pref_bid_ == end_bid_)
-                break;
+        entered_ = clock_type::time_point();
+        refill_prefetching();
+    }
 
+    //! prefetch blocks until page_size*prefetch_pages are ahead of the
+    //! current one
+    void refill_prefetching()
+    {
+        while (pref_bid_ != end_bid_ &&
+               static_cast<size_t>(pref_bid_ - curr_bid_) < page_size_ * prefetch_pages_)
+        {
             cache_.prefetch_block(*pref_bid_);
             ++pref_bid_;
         }
     }
 
+    //! get the first subblock of a newly entered block, and adapt the
+    //! prefetch depth to the time waited for it
+    subblock_type * enter_block()
+    {
+        if (!prefetch_ || max_prefetch_pages_ == min_prefetch_pages_)
+            return cache_.get_subblock(*curr_bid_, 0);
+
+        const clock_type::time_point start = clock_type::now();
+        subblock_type* subblock = cache_.get_subblock(*curr_bid_, 0);
+        const clock_type::time_point stop = clock_type::now();
+
+        if (entered_ != clock_type::time_point())
+        {
+            // waited for more than about a tenth of the time: deeper
+            if ((stop - start) * 8 > start - entered_)
+            {
+                n_calm_blocks_ = 0;
+                if (prefetch_pages_ < max_prefetch_pages_)
+                {
+                    ++prefetch_pages_;
+                    refill_prefetching();
+                }
+            }
+            // no waits for twice the depth: shallower
+            else if (++n_calm_blocks_ >= 2 * page_size_ * prefetch_pages_)
+            {
+                n_calm_blocks_ = 0;
+                if (prefetch_pages_ > min_prefetch_pages_)
+                    --prefetch_pages_;
+            }
+        }
+        entered_ = stop;
+        return subblock;
+    }
+
+public:
+
     //! Get const-reference to current value.
     const value_type & const_value()
     {
@@ -243,15 +484,10 @@ public:
 
             // if a complete page has been consumed, prefetch the next one
             if (prefetch_ && (curr_bid_ - begin_bid_) % page_size_ == 0)
-            {
-                for (unsigned i = 0; i < page_size_; i++)
-                {
-                    if (pref_bid_ == end_bid_)
-                        break;
-                    cache_.prefetch_block(*pref_bid_);
-                    ++pref_bid_;
-                }
-            }
+                refill_prefetching();
+
+            subblock_ = enter_block();
+            return true;
         }
 
         // entered new subblock
@@ -284,20 +520,20 @@ public:
         if (bid == end_bid_)
             return;
 
+        // jump to a block behind or beyond the prefetched ones, as the
+        // buckets of an incrementally rehashed hash_map are not in order
+        if (!prefetch_ || bid < curr_bid_ || bid >= pref_bid_)
+        {
+            curr_bid_ = bid;
+            if (prefetch_)
+                restart_prefetching();
+        }
         // skip to block
         while (curr_bid_ != bid) {
             ++curr_bid_;
 
             if (prefetch_ && (curr_bid_ - begin_bid_) % page_size_ == 0)
-            {
-                for (unsigned i = 0; i < page_size_; i++)
-                {
-                    if (pref_bid_ == end_bid_)
-                        break;
-                    cache_.prefetch_block(*pref_bid_);
-                    ++pref_bid_;
-                }
-            }
+                refill_prefetching();
         }
         // skip to subblock
         i_value_ = i_subblock * subblock_size;
@@ -521,8 +757,11 @@ struct HashedValuesStream
           node_(curr_bucket_ != end_bucket_ ? curr_bucket_->list_ : nullptr),
           i_external_(0)
     {
-        if (!empty())
+        if (!empty()) {
+            // the first bucket need not start at the first block
+            reader_.skip_to(begin_bid_ + curr_bucket_->i_block_, curr_bucket_->i_subblock_);
             value_ = find_next();
+        }
     }
 
     const value_type& operator * () { return value_; }
@@ -552,10 +791,13 @@ struct HashedValuesStream
                 {
                     if (map_._eq(node_->value_.first, reader_.const_value().first))
                     {
+                        if (node_->merge_pending())
+                            map_._apply_merge(node_, reader_.const_value());
                         ++reader_;
                         ++i_external_;
                     }
 
+                    node_->set_merge_pending(false);
                     if (!node_->deleted())
                         return value_type(node_->value_, i_bucket_, hash_map_type::src_internal, node_, i_external_);
                     else
@@ -567,6 +809,7 @@ struct HashedValuesStream
             // only internal elements left
             while (node_)
             {
+                node_->set_merge_pending(false);
                 if (!node_->deleted())
                     return value_type(node_->value_, i_bucket_, hash_map_type::src_internal, node_, i_external_);
                 else
@@ -0,0 +1,485 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/inverted_index.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_INVERTED_INDEX_HEADER
+#define STXXL_CONTAINERS_INVERTED_INDEX_HEADER
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <foxxll/common/types.hpp>
+
+#include <stxxl/bits/common/binary_buffer.h>
+#include <stxxl/bits/containers/combining_sorter.h>
+#include <stxxl/bits/containers/pager.h>
+#include <stxxl/bits/containers/static_index.h>
+#include <stxxl/bits/containers/vector.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+template <typename TermId, typename DocId, typename PagerType, size_t BlockSize,
+          typename AllocStr>
+class inverted_index_builder;
+
+/*!
+ * External inverted index from terms to their postings: the documents
+ * containing a term with the number of its occurrences in each, as built by
+ * inverted_index_builder.
+ *
+ * The posting lists of the terms are packed one after the other into a
+ * stxxl::vector of bytes, each as the gaps between the ascending document ids
+ * and the frequencies, all as varints as written by
+ * binary_buffer::put_varint(). The dictionary is a sorted stxxl::vector of
+ * the terms with the number of documents and the location of their list,
+ * searched by a static_index. A lookup thus reads about one block of the
+ * dictionary and the blocks spanned by the list.
+ *
+ * \tparam TermId term id type, an integer
+ * \tparam DocId document id type, an unsigned integer
+ * \tparam PagerType pager of the page caches of dictionary and postings
+ * \tparam BlockSize external block size in bytes of dictionary and postings
+ * \tparam AllocStr parallel disk block allocation strategy
+ */
+template <typename TermId = uint64_t,
+          typename DocId = uint64_t,
+          typename PagerType = lru_pager<8>,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(uint64_t),
+          typename AllocStr = foxxll::default_alloc_strategy>
+class inverted_index
+{
+    static_assert(std::is_integral<TermId>::value, "term ids must be integers");
+    static_assert(std::is_unsigned<DocId>::value &&
+                  sizeof(DocId) <= sizeof(uint64_t),
+                  "document ids must be unsigned integers of up to 64 bits");
+
+    friend class inverted_index_builder<TermId, DocId, PagerType, BlockSize, AllocStr>;
+
+public:
+    //! \name Types
+    //! \{
+
+    using term_type = TermId;
+    using doc_type = DocId;
+    using size_type = foxxll::external_size_type;
+
+    //! A document containing a term and the number of occurrences in it.
+    struct posting_type
+    {
+        DocId doc;
+        uint64_t freq;
+    };
+
+    //! Entry of the dictionary: a term, its number of documents and the
+    //! bytes of its posting list.
+    struct term_entry_type
+    {
+        TermId term;
+        uint64_t docs;
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    //! key of a term_entry_type
+    struct term_of_entry
+    {
+        const TermId& operator () (const term_entry_type& entry) const
+        {
+            return entry.term;
+        }
+    };
+
+    //! sorted vector of the terms
+    using dictionary_type = stxxl::vector<term_entry_type, 4, PagerType, BlockSize, AllocStr>;
+    //! vector of the compressed posting lists
+    using byte_vector_type = stxxl::vector<uint8_t, 4, PagerType, BlockSize, AllocStr>;
+    //! search index of the dictionary
+    using dictionary_index_type = static_index<
+              dictionary_type, term_of_entry, std::less<TermId>, BlockSize, AllocStr>;
+
+    //! \}
+
+protected:
+    dictionary_type m_dictionary;
+    byte_vector_type m_bytes;
+
+    //! index of m_dictionary, if not empty
+    std::unique_ptr<dictionary_index_type> m_index;
+
+    //! number of postings
+    size_type m_num_postings;
+
+    //! Read a varint from an input iterator or stream of bytes.
+    template <typename Iterator>
+    static uint64_t get_varint(Iterator& it)
+    {
+        uint64_t value = 0;
+        for (unsigned shift = 0; ; shift += 7)
+        {
+            assert(shift < 64);
+            const uint8_t byte = *it;
+            ++it;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+    }
+
+    //! Index the dictionary, after it was written.
+    void build_index(size_t top_bytes)
+    {
+        assert(!m_index);
+        if (!m_dictionary.empty())
+            m_index.reset(new dictionary_index_type(m_dictionary, top_bytes));
+    }
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    inverted_index()
+        : m_num_postings(0)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    inverted_index(const inverted_index&) = delete;
+    //! non-copyable: delete assignment operator
+    inverted_index& operator = (const inverted_index&) = delete;
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Number of terms.
+    size_type num_terms() const { return m_dictionary.size(); }
+
+    //! Number of postings of all terms.
+    size_type num_postings() const { return m_num_postings; }
+
+    bool empty() const { return m_dictionary.empty(); }
+
+    //! Total number of bytes of the compressed posting lists.
+    size_type bytes() const { return m_bytes.size(); }
+
+    //! Remove all terms and deallocate the external memory.
+    void clear()
+    {
+        m_index.reset();
+        m_dictionary.clear();
+        m_bytes.clear();
+        m_num_postings = 0;
+    }
+
+    //! \}
+
+    //! \name Lookup
+    //! \{
+
+    //! Look up the dictionary entry of term. Returns false if the term has no
+    //! postings.
+    bool find(const term_type& term, term_entry_type& entry) const
+    {
+        return m_index && m_index->find(term, entry);
+    }
+
+    //! Read the posting list of a dictionary entry into out, in ascending
+    //! order of the documents.
+    void postings(const term_entry_type& entry, std::vector<posting_type>& out) const
+    {
+        assert(entry.offset + entry.length <= bytes());
+        binary_buffer list;
+        list.alloc(entry.length).set_size(entry.length);
+        typename byte_vector_type::const_iterator it = m_bytes.cbegin() + entry.offset;
+        char* data = list.data();
+        for (uint64_t i = 0; i < entry.length; ++i, ++it)
+            data[i] = static_cast<char>(*it);
+
+        out.clear();
+        out.reserve(entry.docs);
+        binary_reader reader(list);
+        DocId doc = 0;
+        for (uint64_t i = 0; i < entry.docs; ++i)
+        {
+            doc = static_cast<DocId>(doc + reader.get_varint64());
+            out.push_back(posting_type { doc, reader.get_varint64() });
+        }
+    }
+
+    //! Read the posting list of term into out. Returns false if the term has
+    //! no postings.
+    bool postings(const term_type& term, std::vector<posting_type>& out) const
+    {
+        term_entry_type entry;
+        if (!find(term, entry))
+        {
+            out.clear();
+            return false;
+        }
+        postings(entry, out);
+        return true;
+    }
+
+    //! The sorted dictionary, e.g. to scan all terms with its bufreader.
+    const dictionary_type& dictionary() const { return m_dictionary; }
+
+    //! \}
+
+    //! \name Streams
+    //! \{
+
+    /*!
+     * Stream of the postings of a dictionary entry in ascending order of the
+     * documents, which reads the list with overlapped I/O, for lists too long
+     * for internal memory.
+     */
+    class posting_stream
+    {
+    public:
+        using value_type = posting_type;
+
+    protected:
+        typename byte_vector_type::bufreader_type m_bytes;
+        //! postings left, including the current one
+        uint64_t m_left;
+        value_type m_posting;
+
+        //! Decode the next posting.
+        void next()
+        {
+            m_posting.doc = static_cast<DocId>(m_posting.doc + get_varint(m_bytes));
+            m_posting.freq = get_varint(m_bytes);
+        }
+
+    public:
+        posting_stream(const inverted_index& index, const term_entry_type& entry)
+            : m_bytes(index.m_bytes.cbegin() + entry.offset,
+                      index.m_bytes.cbegin() + (entry.offset + entry.length)),
+              m_left(entry.docs),
+              m_posting(posting_type { 0, 0 })
+        {
+            if (m_left > 0)
+                next();
+        }
+
+        //! number of postings left
+        size_type size() const { return m_left; }
+
+        //! standard stream method
+        bool empty() const { return m_left == 0; }
+
+        //! standard stream method
+        const value_type& operator * () const
+        {
+            assert(!empty());
+            return m_posting;
+        }
+
+        //! standard stream method
+        const value_type* operator -> () const
+        {
+            return &(operator * ());
+        }
+
+        //! standard stream method
+        posting_stream& operator ++ ()
+        {
+            assert(!empty());
+            if (--m_left > 0)
+                next();
+            return *this;
+        }
+    };
+
+    //! \}
+};
+
+/*!
+ * Builder of an inverted_index from the occurrences of terms in documents,
+ * in any order.
+ *
+ * The occurrences (term, doc) are pushed into a combining_sorter, which adds
+ * up the frequencies of equal pairs already before writing its runs. build()
+ * merges the runs and encodes the posting lists and the dictionary directly
+ * from the merged stream, so no sorted copy of the occurrences is written.
+ * Positions within the documents are not kept. The largest term id together
+ * with the largest document id is the sentinel of the sorter and must not
+ * be pushed.
+ *
+ * \tparam TermId term id type, an integer
+ * \tparam DocId document id type, an unsigned integer
+ * \tparam PagerType pager of the page caches of the index
+ * \tparam BlockSize external block size in bytes of the sorter and the index
+ * \tparam AllocStr parallel disk block allocation strategy
+ */
+template <typename TermId = uint64_t,
+          typename DocId = uint64_t,
+          typename PagerType = lru_pager<8>,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(uint64_t),
+          typename AllocStr = foxxll::default_alloc_strategy>
+class inverted_index_builder
+{
+public:
+    //! \name Types
+    //! \{
+
+    using index_type = inverted_index<TermId, DocId, PagerType, BlockSize, AllocStr>;
+    using size_type = typename index_type::size_type;
+
+    //! Occurrences of a term in a document.
+    struct occurrence_type
+    {
+        TermId term;
+        DocId doc;
+        uint64_t freq;
+    };
+
+    //! \}
+
+protected:
+    //! orders the occurrences by term and document
+    struct occurrence_less
+    {
+        bool operator () (const occurrence_type& a, const occurrence_type& b) const
+        {
+            return a.term < b.term || (a.term == b.term && a.doc < b.doc);
+        }
+        occurrence_type min_value() const
+        {
+            return occurrence_type {
+                       std::numeric_limits<TermId>::min(), std::numeric_limits<DocId>::min(), 0
+            };
+        }
+        occurrence_type max_value() const
+        {
+            return occurrence_type {
+                       std::numeric_limits<TermId>::max(), std::numeric_limits<DocId>::max(), 0
+            };
+        }
+    };
+
+    //! adds up the frequencies of a term in a document
+    struct occurrence_combine
+    {
+        occurrence_type operator () (const occurrence_type& a, const occurrence_type& b) const
+        {
+            return occurrence_type { a.term, a.doc, a.freq + b.freq };
+        }
+    };
+
+    using sorter_type = combining_sorter<
+              occurrence_type, occurrence_less, occurrence_combine, BlockSize, AllocStr>;
+
+    sorter_type m_sorter;
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Constructor allocating memory_to_use bytes in ram for sorting.
+    explicit inverted_index_builder(size_t memory_to_use)
+        : m_sorter(occurrence_less(), memory_to_use)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    inverted_index_builder(const inverted_index_builder&) = delete;
+    //! non-copyable: delete assignment operator
+    inverted_index_builder& operator = (const inverted_index_builder&) = delete;
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Add freq occurrences of term in doc.
+    void push(const TermId& term, const DocId& doc, uint64_t freq = 1)
+    {
+        m_sorter.push(occurrence_type { term, doc, freq });
+    }
+
+    //! Number of pushes since the last build().
+    size_type size() const { return m_sorter.size(); }
+
+    /*!
+     * Write the index of the occurrences pushed to index, replacing its
+     * contents, and clear the builder for the next index.
+     *
+     * \param index the index to write
+     * \param top_bytes internal memory of the dictionary's static_index
+     */
+    void build(index_type& index, size_t top_bytes = 16 * 1024 * 1024)
+    {
+        using term_entry_type = typename index_type::term_entry_type;
+
+        index.clear();
+        m_sorter.sort();
+        {
+            typename index_type::dictionary_type::bufwriter_type dict_writer(index.m_dictionary);
+            typename index_type::byte_vector_type::bufwriter_type byte_writer(index.m_bytes);
+
+            binary_buffer posting;
+            uint64_t end = 0;
+            term_entry_type entry = term_entry_type { TermId(), 0, 0, 0 };
+            DocId prev = 0;
+
+            for ( ; !m_sorter.empty(); ++m_sorter)
+            {
+                const occurrence_type& occ = *m_sorter;
+                if (entry.docs == 0 || occ.term != entry.term)
+                {
+                    if (entry.docs != 0)
+                    {
+                        entry.length = end - entry.offset;
+                        dict_writer << entry;
+                    }
+                    entry = term_entry_type { occ.term, 0, end, 0 };
+                    prev = 0;
+                }
+
+                posting.clear();
+                posting.put_varint(static_cast<uint64_t>(occ.doc - prev));
+                posting.put_varint(occ.freq);
+                for (size_t i = 0; i < posting.size(); ++i)
+                    byte_writer << static_cast<uint8_t>(posting.data()[i]);
+                end += posting.size();
+
+                prev = occ.doc;
+                ++entry.docs;
+                ++index.m_num_postings;
+            }
+            if (entry.docs != 0)
+            {
+                entry.length = end - entry.offset;
+                dict_writer << entry;
+            }
+
+            dict_writer.finish();
+            byte_writer.finish();
+        }
+        m_sorter.clear();
+
+        index.build_index(top_bytes);
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_INVERTED_INDEX_HEADER
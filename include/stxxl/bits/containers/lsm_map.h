@@ -0,0 +1,793 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/lsm_map.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_LSM_MAP_HEADER
+#define STXXL_CONTAINERS_LSM_MAP_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/types.hpp>
+#include <foxxll/io/request_operations.hpp>
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/config.hpp>
+#include <foxxll/mng/typed_block.hpp>
+
+#include <stxxl/bits/common/block_array.h>
+#include <stxxl/bits/common/disk_space.h>
+#include <stxxl/bits/common/winner_tree.h>
+#include <stxxl/bits/containers/hash_map/bloom_filter.h>
+#include <stxxl/bits/defines.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External ordered key-value store organized as a log-structured merge tree,
+ * for workloads dominated by writes.
+ *
+ * insert_or_assign() and erase() go into the memtable, an std::map in
+ * internal memory. When it is full, it is written sequentially as a table, a
+ * sorted run of blocks holding each key at most once, erased keys as
+ * tombstones. The tables are merged size-tiered: the new tables form level 0,
+ * and once a level has fanout tables, its oldest fanout tables are merged into
+ * one table, the newest of the next level. The merge runs in the background
+ * while the map is used; one merge at a time, the next one starts when a
+ * flush finds the last one finished, and the writes stall while a level has
+ * twice fanout tables. Tombstones are dropped by merges into the deepest
+ * level. Hence each entry is written once per level, and all I/O
+ * apart from lookups is sequential.
+ *
+ * Each table keeps the first key of each of its blocks, the fence pointers,
+ * and a Bloom filter of its keys in internal memory. find() searches the
+ * memtable and then the tables from the newest to the oldest, skipping those
+ * whose Bloom filter rules the key out, and reads one block of each other
+ * table. range() merges the memtable and the tables with a
+ * keyed_winner_tree, in which newer versions of a key win.
+ *
+ * The map is not thread-safe, the background merge synchronizes itself.
+ *
+ * \tparam KeyType type of the keys
+ * \tparam DataType type of the data (POD with no references to internal
+ *   memory)
+ * \tparam CompareType strict weak ordering of the keys
+ * \tparam HashType hash function of the keys for the Bloom filters
+ * \tparam BlockSize size of the external memory blocks in bytes
+ * \tparam AllocStr parallel disk block allocation strategy
+ */
+template <class KeyType, class DataType,
+          class CompareType = std::less<KeyType>,
+          class HashType = std::hash<KeyType>,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(KeyType),
+          class AllocStr = foxxll::default_alloc_strategy>
+class lsm_map
+{
+    static constexpr bool debug = false;
+
+public:
+    using key_type = KeyType;
+    using data_type = DataType;
+    using value_type = std::pair<key_type, data_type>;
+    using key_compare = CompareType;
+    using hasher = HashType;
+    using size_type = external_size_type;
+
+    //! entry of the memtable and the tables, deleted marks a tombstone
+    struct entry_type
+    {
+        key_type key;
+        data_type data;
+        bool deleted;
+    };
+
+    using block_type = foxxll::typed_block<BlockSize, entry_type>;
+    using bid_type = typename block_type::bid_type;
+
+    //! number of entries per block
+    static constexpr size_t block_entries = block_type::size;
+
+protected:
+    //! An immutable sorted run of entries in external memory, holding each
+    //! key at most once. Its blocks are freed with the last reference.
+    struct table_type
+    {
+        std::vector<bid_type> bids;
+        //! first key of each block, the fence pointers
+        std::vector<key_type> fences;
+        //! number of entries
+        size_type size = 0;
+        //! Bloom filter of the keys' hash values
+        hash_map::bloom_filter bloom;
+
+        table_type() = default;
+
+        //! non-copyable: delete copy-constructor
+        table_type(const table_type&) = delete;
+        //! non-copyable: delete assignment operator
+        table_type& operator = (const table_type&) = delete;
+
+        ~table_type()
+        {
+            disk_space_reclaimer::get_instance().delete_blocks(bids.begin(), bids.end());
+        }
+
+        //! Number of entries in block i.
+        size_t block_size(size_t i) const
+        {
+            assert(i < fences.size());
+            return (i + 1 < fences.size())
+                   ? block_entries
+                   : static_cast<size_t>(size - i * static_cast<size_type>(block_entries));
+        }
+    };
+
+    using table_ptr = std::shared_ptr<const table_type>;
+
+    //! Writes entries in key order into a new table of at most max_size
+    //! entries, through 2 * disks_number blocks written asynchronously.
+    class table_writer
+    {
+        std::shared_ptr<table_type> m_table;
+        const hasher& m_hash;
+        size_t m_nbuffers;
+        block_type* m_blocks;
+        //! block being filled and number of entries in it
+        size_t m_buffer = 0, m_fill = 0;
+        std::vector<foxxll::request_ptr> m_reqs;
+
+    public:
+        table_writer(size_type max_size, double bloom_bits_per_key, const hasher& hash)
+            : m_table(std::make_shared<table_type>()), m_hash(hash),
+              m_nbuffers(2 * foxxll::config::get_instance()->disks_number()),
+              m_blocks(new_block_array<block_type>(m_nbuffers))
+        {
+            m_table->bids.resize(static_cast<size_t>(foxxll::div_ceil(max_size, block_entries)));
+            foxxll::block_manager::get_instance()->new_blocks(
+                AllocStr(), m_table->bids.begin(), m_table->bids.end());
+            m_table->bloom.reset(max_size, bloom_bits_per_key,
+                                 std::numeric_limits<size_t>::max());
+        }
+
+        //! non-copyable: delete copy-constructor
+        table_writer(const table_writer&) = delete;
+        //! non-copyable: delete assignment operator
+        table_writer& operator = (const table_writer&) = delete;
+
+        ~table_writer()
+        {
+            wait_all(m_reqs.begin(), m_reqs.end());
+            delete_block_array(m_blocks, m_nbuffers);
+        }
+
+        //! Append an entry with a key larger than the previous one.
+        void push(const entry_type& e)
+        {
+            if (m_fill == 0)
+                m_table->fences.push_back(e.key);
+            m_blocks[m_buffer].elem[m_fill] = e;
+            m_table->bloom.insert(m_hash(e.key));
+            ++m_table->size;
+            if (++m_fill == block_entries)
+                write_block();
+        }
+
+        //! Write the last block and return the table, freeing its unused
+        //! blocks.
+        table_ptr finish()
+        {
+            if (m_fill > 0)
+                write_block();
+            wait_all(m_reqs.begin(), m_reqs.end());
+            m_reqs.clear();
+
+            std::vector<bid_type>& bids = m_table->bids;
+            disk_space_reclaimer::get_instance().delete_blocks(
+                bids.begin() + m_table->fences.size(), bids.end());
+            bids.resize(m_table->fences.size());
+            return m_table;
+        }
+
+    private:
+        void write_block()
+        {
+            m_reqs.push_back(m_blocks[m_buffer].write(
+                                 m_table->bids[m_table->fences.size() - 1]));
+            m_fill = 0;
+            if (++m_buffer < m_nbuffers)
+                return;
+            wait_all(m_reqs.begin(), m_reqs.end());
+            m_reqs.clear();
+            m_buffer = 0;
+        }
+    };
+
+    //! Reads the entries of a table in key order, starting at the first
+    //! entry not less than a given key, with the next block read ahead.
+    class table_reader
+    {
+        table_ptr m_table;
+        block_type* m_blocks;
+        //! block index and buffer of the current block, position in it
+        size_t m_block, m_buffer = 0, m_pos = 0;
+        foxxll::request_ptr m_ahead;
+
+    public:
+        table_reader(const table_ptr& table, const key_type* lower, const key_compare& less)
+            : m_table(table), m_blocks(new_block_array<block_type>(2)), m_block(0)
+        {
+            const std::vector<key_type>& fences = m_table->fences;
+            if (lower)
+            {
+                // the last block starting with a key not greater than lower
+                const size_t b = static_cast<size_t>(
+                    std::upper_bound(fences.begin(), fences.end(), *lower, less) - fences.begin());
+                m_block = (b > 0) ? b - 1 : 0;
+            }
+            if (m_block >= fences.size())
+                return;
+
+            m_blocks[0].read(m_table->bids[m_block])->wait();
+            read_ahead();
+
+            if (lower)
+            {
+                const entry_type* begin = m_blocks[0].elem;
+                const entry_type* end = begin + m_table->block_size(m_block);
+                m_pos = static_cast<size_t>(
+                    std::lower_bound(begin, end, *lower,
+                                     [&less](const entry_type& e, const key_type& k) {
+                                         return less(e.key, k);
+                                     }) - begin);
+                if (begin + m_pos == end)
+                    next_block();
+            }
+        }
+
+        //! non-copyable: delete copy-constructor
+        table_reader(const table_reader&) = delete;
+        //! non-copyable: delete assignment operator
+        table_reader& operator = (const table_reader&) = delete;
+
+        ~table_reader()
+        {
+            if (m_ahead.valid())
+                m_ahead->wait();
+            delete_block_array(m_blocks, 2);
+        }
+
+        bool empty() const
+        {
+            return m_block >= m_table->fences.size();
+        }
+
+        const entry_type& operator * () const
+        {
+            assert(!empty());
+            return m_blocks[m_buffer].elem[m_pos];
+        }
+
+        table_reader& operator ++ ()
+        {
+            assert(!empty());
+            if (++m_pos == m_table->block_size(m_block))
+                next_block();
+            return *this;
+        }
+
+    private:
+        void read_ahead()
+        {
+            if (m_block + 1 < m_table->fences.size())
+                m_ahead = m_blocks[1 - m_buffer].read(m_table->bids[m_block + 1]);
+        }
+
+        void next_block()
+        {
+            ++m_block;
+            m_pos = 0;
+            if (empty())
+                return;
+            m_ahead->wait();
+            m_ahead = foxxll::request_ptr();
+            m_buffer = 1 - m_buffer;
+            read_ahead();
+        }
+    };
+
+public:
+    /*!
+     * Stream of the entries in a key range in key order, returned by range()
+     * and scan(), with the stream interface empty(), operator * and
+     * operator ++. It holds the tables of the map and a copy of the
+     * memtable's entries in the range at its construction, hence it is not
+     * affected by later modifications of the map.
+     */
+    class range_stream
+    {
+        key_compare m_less;
+        bool m_has_upper;
+        key_type m_upper;
+
+        //! memtable entries, player 0 of the tree
+        std::vector<entry_type> m_memtable;
+        size_t m_mem_pos = 0;
+        //! readers of the tables from the newest to the oldest, players 1..
+        std::vector<std::unique_ptr<table_reader> > m_readers;
+
+        //! winner tree of the sources, equal keys are won by the newest
+        keyed_winner_tree<key_type, key_compare> m_tree;
+
+        value_type m_current;
+        bool m_empty = false;
+
+        friend class lsm_map;
+
+        range_stream(const lsm_map& map, const key_type* lower, const key_type* upper)
+            : m_less(map.m_less), m_has_upper(upper != nullptr),
+              m_upper(upper ? *upper : key_type()),
+              m_tree(1 + map.num_tables(), m_less)
+        {
+            typename memtable_type::const_iterator it =
+                lower ? map.m_memtable.lower_bound(*lower) : map.m_memtable.begin();
+            for ( ; it != map.m_memtable.end() && in_range(it->first); ++it)
+                m_memtable.push_back(it->second);
+
+            for (const std::vector<table_ptr>& level : map.m_levels)
+            {
+                for (const table_ptr& table : level)
+                    m_readers.emplace_back(new table_reader(table, lower, m_less));
+            }
+
+            for (size_t i = 0; i <= m_readers.size(); ++i)
+                update(i);
+            fetch();
+        }
+
+    public:
+        bool empty() const
+        {
+            return m_empty;
+        }
+
+        const value_type& operator * () const
+        {
+            assert(!empty());
+            return m_current;
+        }
+
+        const value_type* operator -> () const
+        {
+            return &operator * ();
+        }
+
+        range_stream& operator ++ ()
+        {
+            assert(!empty());
+            fetch();
+            return *this;
+        }
+
+    private:
+        bool in_range(const key_type& key) const
+        {
+            return !m_has_upper || m_less(key, m_upper);
+        }
+
+        const entry_type& head(size_t i) const
+        {
+            return (i == 0) ? m_memtable[m_mem_pos] : **m_readers[i - 1];
+        }
+
+        //! Replay source i after it was advanced.
+        void update(size_t i)
+        {
+            const bool done = (i == 0) ? (m_mem_pos == m_memtable.size())
+                              : (m_readers[i - 1]->empty() || !in_range(head(i).key));
+            if (done)
+                m_tree.deactivate_player(i);
+            else
+                m_tree.activate_player(i, head(i).key);
+        }
+
+        void advance(size_t i)
+        {
+            if (i == 0)
+                ++m_mem_pos;
+            else
+                ++*m_readers[i - 1];
+            update(i);
+        }
+
+        //! Take the next key which is not a tombstone, skipping its older
+        //! versions.
+        void fetch()
+        {
+            while (!m_tree.empty())
+            {
+                const size_t winner = m_tree.top();
+                const entry_type e = head(winner);
+                advance(winner);
+                while (!m_tree.empty() && !m_less(e.key, m_tree.top_key()))
+                    advance(m_tree.top());
+
+                if (!e.deleted) {
+                    m_current = value_type(e.key, e.data);
+                    return;
+                }
+            }
+            m_empty = true;
+        }
+    };
+
+protected:
+    using memtable_type = std::map<key_type, entry_type, key_compare>;
+
+    key_compare m_less;
+    hasher m_hash;
+
+    //! maximum number of entries in the memtable
+    size_t m_memtable_entries;
+    //! number of tables of a level which are merged
+    size_t m_fanout;
+    //! bits per key of the Bloom filters, 0 disables them
+    double m_bloom_bits_per_key;
+
+    memtable_type m_memtable;
+
+    //! the tables of each level, from the newest to the oldest
+    std::vector<std::vector<table_ptr> > m_levels;
+
+    //! background merge of the oldest m_fanout tables of m_merge_level
+    std::future<table_ptr> m_merge;
+    size_t m_merge_level = 0;
+
+    //! block buffer of find()
+    block_type* m_lookup_block;
+
+public:
+    /*!
+     * Constructs an empty map.
+     *
+     * \param memtable_bytes internal memory of the memtable, counting the
+     *   nodes of the std::map
+     * \param fanout number of tables of a level which are merged, at least 2
+     * \param bloom_bits_per_key bits per key of the Bloom filters, 0 disables
+     *   them
+     * \param less comparison object of the keys
+     * \param hash hash function of the keys
+     */
+    explicit lsm_map(size_t memtable_bytes = 16 * 1024 * 1024,
+                     size_t fanout = 4,
+                     double bloom_bits_per_key = 10.0,
+                     const key_compare& less = key_compare(),
+                     const hasher& hash = hasher())
+        : m_less(less), m_hash(hash),
+          m_memtable_entries(std::max<size_t>(
+                                 memtable_bytes / (sizeof(typename memtable_type::value_type) + 4 * sizeof(void*)), 1)),
+          m_fanout(std::max<size_t>(fanout, 2)),
+          m_bloom_bits_per_key(bloom_bits_per_key),
+          m_memtable(less),
+          m_lookup_block(new_block_array<block_type>(1))
+    { }
+
+    //! non-copyable: delete copy-constructor
+    lsm_map(const lsm_map&) = delete;
+    //! non-copyable: delete assignment operator
+    lsm_map& operator = (const lsm_map&) = delete;
+
+    ~lsm_map()
+    {
+        if (m_merge.valid())
+            m_merge.wait();
+        delete_block_array(m_lookup_block, 1);
+    }
+
+    //! \name Modifiers
+    //! \{
+
+    //! Insert key with data, or overwrite the data of key.
+    void insert_or_assign(const key_type& key, const data_type& data)
+    {
+        put(entry_type { key, data, false });
+    }
+
+    //! Erase key, if present.
+    void erase(const key_type& key)
+    {
+        put(entry_type { key, data_type(), true });
+    }
+
+    //! Write the memtable as a new table, if not empty.
+    void flush()
+    {
+        if (m_memtable.empty())
+            return;
+
+        TLX_LOG << "lsm_map: flushing " << m_memtable.size() << " entries";
+
+        table_writer writer(m_memtable.size(), m_bloom_bits_per_key, m_hash);
+        for (const typename memtable_type::value_type& e : m_memtable)
+            writer.push(e.second);
+        table_ptr table = writer.finish();
+        m_memtable.clear();
+
+        if (m_levels.empty())
+            m_levels.emplace_back();
+        m_levels[0].insert(m_levels[0].begin(), table);
+
+        check_merges(false);
+    }
+
+    //! Merge the levels until none has fanout tables, waiting for the
+    //! background merges.
+    void wait_merges()
+    {
+        check_merges(true);
+    }
+
+    //! \}
+
+    //! \name Lookup
+    //! \{
+
+    //! Look up key: returns whether it is present and sets data to its data.
+    bool find(const key_type& key, data_type& data) const
+    {
+        typename memtable_type::const_iterator it = m_memtable.find(key);
+        if (it != m_memtable.end())
+            return found(it->second, data);
+
+        const uint64_t hash = m_hash(key);
+        for (const std::vector<table_ptr>& level : m_levels)
+        {
+            for (const table_ptr& table : level)
+            {
+                if (!table->bloom.may_contain(hash))
+                    continue;
+
+                // the block which would hold key
+                const std::vector<key_type>& fences = table->fences;
+                const size_t b = static_cast<size_t>(
+                    std::upper_bound(fences.begin(), fences.end(), key, m_less) - fences.begin());
+                if (b == 0)
+                    continue;
+
+                m_lookup_block->read(table->bids[b - 1])->wait();
+                const entry_type* begin = m_lookup_block->elem;
+                const entry_type* end = begin + table->block_size(b - 1);
+                const entry_type* e = std::lower_bound(
+                    begin, end, key,
+                    [this](const entry_type& a, const key_type& k) { return m_less(a.key, k); });
+                if (e != end && !m_less(key, e->key))
+                    return found(*e, data);
+            }
+        }
+        return false;
+    }
+
+    //! Returns whether key is present.
+    bool contains(const key_type& key) const
+    {
+        data_type data;
+        return find(key, data);
+    }
+
+    //! Stream of the entries with keys in [lower, upper) in key order.
+    range_stream range(const key_type& lower, const key_type& upper) const
+    {
+        return range_stream(*this, &lower, &upper);
+    }
+
+    //! Stream of all entries in key order.
+    range_stream scan() const
+    {
+        return range_stream(*this, nullptr, nullptr);
+    }
+
+    //! \}
+
+    //! \name Properties
+    //! \{
+
+    //! Number of entries in the memtable, including tombstones.
+    size_t memtable_size() const
+    {
+        return m_memtable.size();
+    }
+
+    //! Number of tables in external memory.
+    size_t num_tables() const
+    {
+        size_t n = 0;
+        for (const std::vector<table_ptr>& level : m_levels)
+            n += level.size();
+        return n;
+    }
+
+    //! Number of levels of tables.
+    size_t num_levels() const
+    {
+        return m_levels.size();
+    }
+
+    //! Bytes of internal memory used by the fence pointers and Bloom filters.
+    size_t index_memory() const
+    {
+        size_t bytes = 0;
+        for (const std::vector<table_ptr>& level : m_levels)
+        {
+            for (const table_ptr& table : level)
+                bytes += table->fences.size() * sizeof(key_type) + table->bloom.mem_cons();
+        }
+        return bytes;
+    }
+
+    //! \}
+
+protected:
+    void put(const entry_type& e)
+    {
+        std::pair<typename memtable_type::iterator, bool> r = m_memtable.emplace(e.key, e);
+        if (!r.second)
+            r.first->second = e;
+        if (m_memtable.size() >= m_memtable_entries)
+            flush();
+    }
+
+    static bool found(const entry_type& e, data_type& data)
+    {
+        if (e.deleted)
+            return false;
+        data = e.data;
+        return true;
+    }
+
+    /*!
+     * Install a finished background merge and start the next one on the
+     * level with the most tables, if it has fanout tables. While a level has
+     * twice fanout tables, wait for the merges, which stalls the writes until
+     * the merges catch up. If wait is set, wait for the merges until no level
+     * has fanout tables.
+     */
+    void check_merges(bool wait)
+    {
+        while (true)
+        {
+            if (m_merge.valid())
+            {
+                if (!wait && !overfull() &&
+                    m_merge.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                    return;
+                install_merge();
+            }
+
+            size_t level = 0;
+            for (size_t l = 1; l < m_levels.size(); ++l)
+            {
+                if (m_levels[l].size() > m_levels[level].size())
+                    level = l;
+            }
+            if (m_levels.empty() || m_levels[level].size() < m_fanout)
+                return;
+
+            start_merge(level);
+            if (!wait && !overfull())
+                return;
+        }
+    }
+
+    //! Whether a level has twice fanout tables.
+    bool overfull() const
+    {
+        for (const std::vector<table_ptr>& level : m_levels)
+        {
+            if (level.size() >= 2 * m_fanout)
+                return true;
+        }
+        return false;
+    }
+
+    //! Merge the oldest m_fanout tables of level in the background.
+    void start_merge(size_t level)
+    {
+        const std::vector<table_ptr>& tables = m_levels[level];
+        std::vector<table_ptr> inputs(tables.end() - m_fanout, tables.end());
+
+        // tombstones are needed as long as older tables may hold the key
+        bool deepest = true;
+        for (size_t l = level + 1; l < m_levels.size(); ++l)
+            deepest = deepest && m_levels[l].empty();
+
+        TLX_LOG << "lsm_map: merging " << m_fanout << " tables of level " << level;
+
+        m_merge_level = level;
+        m_merge = std::async(std::launch::async, [this, inputs, deepest]() {
+                                 return merge_tables(inputs, deepest);
+                             });
+    }
+
+    void install_merge()
+    {
+        table_ptr table = m_merge.get();
+
+        // the merged tables are still the oldest, flushes add new ones in front
+        std::vector<table_ptr>& tables = m_levels[m_merge_level];
+        tables.erase(tables.end() - m_fanout, tables.end());
+
+        if (m_levels.size() == m_merge_level + 1)
+            m_levels.emplace_back();
+        if (table->size > 0) {
+            std::vector<table_ptr>& next = m_levels[m_merge_level + 1];
+            next.insert(next.begin(), table);
+        }
+    }
+
+    //! Merge the tables, ordered from the newest to the oldest, into one,
+    //! keeping the newest version of each key. Runs in the background.
+    table_ptr merge_tables(const std::vector<table_ptr>& inputs, bool drop_tombstones) const
+    {
+        size_type size = 0;
+        for (const table_ptr& table : inputs)
+            size += table->size;
+
+        std::vector<std::unique_ptr<table_reader> > readers;
+        keyed_winner_tree<key_type, key_compare> tree(inputs.size(), m_less);
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            readers.emplace_back(new table_reader(inputs[i], nullptr, m_less));
+            if (!readers[i]->empty())
+                tree.activate_player(i, (**readers[i]).key);
+        }
+
+        table_writer writer(size, m_bloom_bits_per_key, m_hash);
+        while (!tree.empty())
+        {
+            const size_t winner = tree.top();
+            const entry_type e = **readers[winner];
+            if (!e.deleted || !drop_tombstones)
+                writer.push(e);
+
+            // skip the older versions of the key
+            advance(readers, tree, winner);
+            while (!tree.empty() && !m_less(e.key, tree.top_key()))
+                advance(readers, tree, tree.top());
+        }
+        return writer.finish();
+    }
+
+    static void advance(std::vector<std::unique_ptr<table_reader> >& readers,
+                        keyed_winner_tree<key_type, key_compare>& tree, size_t i)
+    {
+        ++*readers[i];
+        if (readers[i]->empty())
+            tree.deactivate_player(i);
+        else
+            tree.activate_player(i, (**readers[i]).key);
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_LSM_MAP_HEADER
@@ -28,7 +28,9 @@ template <class KeyType,
           class CompareType,
           unsigned LogNodeSize,
           unsigned LogLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
 class btree;
 
@@ -73,17 +75,25 @@ class btree;
 //! \tparam RawNodeSize size of internal nodes of map in bytes (btree implementation).
 //! \tparam RawLeafSize size of leaves of map in bytes (btree implementation).
 //! \tparam PDAllocStrategy parallel disk block allocation strategy (\c foxxll::simple_random is recommended and default)
+//! \tparam Compression layout of leaves and nodes in external memory:
+//! \c btree::no_compression (default) or \c btree::delta_compression, which
+//! delta-codes integral keys and the BIDs of nodes.
+//! \tparam PagerType replacement strategy of the node and leaf caches:
+//! \c lru_pager<> (default), \c clock_pager<>, the scan resistant
+//! \c two_queue_pager<> or \c random_pager<0>
 //!
 template <class KeyType,
           class DataType,
           class CompareType,
           unsigned RawNodeSize = 16* 1024,      // 16 KBytes default
           unsigned RawLeafSize = 128* 1024,     // 128 KBytes default
-          class PDAllocStrategy = foxxll::simple_random
+          class PDAllocStrategy = foxxll::simple_random,
+          class Compression = btree::no_compression,
+          class PagerType = lru_pager<>
           >
 class map
 {
-    using impl_type = btree::btree<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>;
+    using impl_type = btree::btree<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>;
 
     impl_type impl;
 
@@ -105,6 +115,7 @@ public:
     using difference_type = typename impl_type::difference_type;
     using iterator = typename impl_type::iterator;
     using const_iterator = typename impl_type::const_iterator;
+    using snapshot_iterator = typename impl_type::snapshot_iterator;
     using reverse_iterator = std::reverse_iterator<iterator>;
     using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
@@ -183,6 +194,19 @@ public:
         : impl(c_, node_cache_size_in_bytes, leaf_cache_size_in_bytes)
     { }
 
+    //! Constructs a map stored in a file, or reopens the map stored in it if
+    //! the file is not empty, see flush()
+    //! \param file file holding all blocks of the map and its superblock
+    //! \param c_ comparator object, equivalent to the one the map was created with
+    //! \param node_cache_size_in_bytes size of node cache in bytes (btree implementation)
+    //! \param leaf_cache_size_in_bytes size of leaf cache in bytes (btree implementation)
+    map(foxxll::file_ptr file,
+        const key_compare& c_,
+        const size_t node_cache_size_in_bytes,
+        const size_t leaf_cache_size_in_bytes)
+        : impl(std::move(file), c_, node_cache_size_in_bytes, leaf_cache_size_in_bytes)
+    { }
+
     //! Constructs a map from a given input range
     //! \param b beginning of the range
     //! \param e end of the range
@@ -246,10 +270,65 @@ public:
     {
         return impl.insert(pos, x);
     }
+    //! Inserts the elements of [b, e); a range sorted by key that is long
+    //! compared to the map is merged with the leaves and the tree rebuilt
+    //! bottom-up (btree implementation), which invalidates all iterators
+    //! \param range_sorted whether [b, e) is sorted by key and allows
+    //! multiple passes
+    //! \param node_fill_factor node fill factor in [0,1] for the rebuild
+    //! \param leaf_fill_factor leaf fill factor in [0,1] for the rebuild
     template <class InputIterator>
-    void insert(InputIterator b, InputIterator e)
+    void insert(InputIterator b, InputIterator e,
+                bool range_sorted = false,
+                double node_fill_factor = 0.75,
+                double leaf_fill_factor = 0.6)
+    {
+        impl.insert(b, e, range_sorted, node_fill_factor, leaf_fill_factor);
+    }
+    //! Replaces the contents by the elements of a stream sorted by key, for
+    //! example the output of stream::sort, using a fast bottom-up bulk
+    //! construction (btree implementation)
+    //! \param input stream of value pairs, sorted by key
+    //! \param node_fill_factor node fill factor in [0,1] for bulk construction
+    //! \param leaf_fill_factor leaf fill factor in [0,1] for bulk construction
+    template <class StreamType>
+    void bulk_load(StreamType& input,
+                   const double node_fill_factor = 0.75,
+                   const double leaf_fill_factor = 0.6)
+    {
+        impl.bulk_load(input, node_fill_factor, leaf_fill_factor);
+    }
+    //! Insert or overwrite a value without accessing external memory; the
+    //! value is buffered and applied in a batch with others (btree
+    //! implementation), see btree::insert_oblivious()
+    void insert_oblivious(const value_type& x)
+    {
+        impl.insert_oblivious(x);
+    }
+    //! Erase by key without accessing external memory, see insert_oblivious()
+    void erase_oblivious(const key_type& k)
+    {
+        impl.erase_oblivious(k);
+    }
+    //! Insert a value or merge it into the stored value without accessing
+    //! external memory, see insert_oblivious() and btree::upsert()
+    //! \param x what to insert or merge
+    //! \param merge computes the new data from the stored and the given data
+    template <class MergeFunction>
+    void upsert(const value_type& x, MergeFunction merge)
+    {
+        impl.upsert(x, merge);
+    }
+    //! Apply the buffered messages of insert_oblivious(), erase_oblivious()
+    //! and upsert(), which all other operations do implicitly
+    void apply_messages() const
     {
-        impl.insert(b, e);
+        impl.apply_messages();
+    }
+    //! Set the internal memory of the message buffer in bytes
+    void set_message_buffer_size(const size_t bytes)
+    {
+        impl.set_message_buffer_size(bytes);
     }
     void erase(iterator pos)
     {
@@ -281,6 +360,20 @@ public:
     {
         return impl.find(k);
     }
+    //! Looks up a sorted batch of keys in one descent, see btree::find_batch()
+    //! \param out receives the iterator of find() for each key
+    template <class InputIterator, class OutputIterator>
+    OutputIterator find_batch(InputIterator first, InputIterator last,
+                              OutputIterator out)
+    {
+        return impl.find_batch(first, last, out);
+    }
+    template <class InputIterator, class OutputIterator>
+    OutputIterator find_batch(InputIterator first, InputIterator last,
+                              OutputIterator out) const
+    {
+        return impl.find_batch(first, last, out);
+    }
     size_type count(const key_type& k)
     {
         return impl.count(k);
@@ -309,6 +402,51 @@ public:
     {
         return impl.equal_range(k);
     }
+    //! Returns [lower_bound(lower), lower_bound(upper)) and reads its
+    //! leaves ahead while it is scanned, see btree::range()
+    std::pair<iterator, iterator> range(const key_type& lower, const key_type& upper)
+    {
+        return impl.range(lower, upper);
+    }
+    std::pair<const_iterator, const_iterator>
+    range(const key_type& lower, const key_type& upper) const
+    {
+        return impl.range(lower, upper);
+    }
+    //! Returns unregistered iterators to [begin(), end()), valid until the
+    //! next modification, see btree::snapshot()
+    std::pair<snapshot_iterator, snapshot_iterator> snapshot() const
+    {
+        return impl.snapshot();
+    }
+    //! Returns unregistered iterators to range(lower, upper), valid until
+    //! the next modification, see btree::snapshot_range()
+    std::pair<snapshot_iterator, snapshot_iterator>
+    snapshot_range(const key_type& lower, const key_type& upper) const
+    {
+        return impl.snapshot_range(lower, upper);
+    }
+    //! Returns the number of elements with keys less than k in O(log n)
+    //! I/Os, see btree::rank()
+    size_type rank(const key_type& k) const
+    {
+        return impl.rank(k);
+    }
+    //! Returns the element at position i in key order, or end()
+    iterator select(size_type i)
+    {
+        return impl.select(i);
+    }
+    const_iterator select(size_type i) const
+    {
+        return impl.select(i);
+    }
+    //! Returns the number of elements with keys in [lower, upper) in
+    //! O(log n) I/Os
+    size_type count_range(const key_type& lower, const key_type& upper) const
+    {
+        return impl.count_range(lower, upper);
+    }
 
     //! \}
 
@@ -325,6 +463,20 @@ public:
     //! \name Miscellaneous
     //! \{
 
+    //! Writes all modified nodes and leaves and, if the map is stored in a
+    //! file, its superblock, such that the file can be reopened; the
+    //! destructor does the same (btree implementation)
+    void flush()
+    {
+        impl.flush();
+    }
+
+    //! The file the map is stored in, or nullptr
+    foxxll::file_ptr get_file() const
+    {
+        return impl.get_file();
+    }
+
     //! Enables leaf prefetching during scanning
     void enable_prefetching()
     {
@@ -343,6 +495,66 @@ public:
         return impl.prefetching_enabled();
     }
 
+    //! Keeps the nodes of the given number of levels below the root cached,
+    //! see btree::set_pinned_levels()
+    void set_pinned_levels(unsigned levels)
+    {
+        impl.set_pinned_levels(levels);
+    }
+
+    //! Returns the number of node levels kept cached
+    unsigned pinned_levels() const
+    {
+        return impl.pinned_levels();
+    }
+
+    //! Sets the number of leaves read ahead during scanning
+    void set_read_ahead(size_t leaves)
+    {
+        impl.set_read_ahead(leaves);
+    }
+
+    //! Returns the number of leaves read ahead during scanning
+    size_t read_ahead() const
+    {
+        return impl.read_ahead();
+    }
+
+    //! Starts the read-concurrent mode, see btree::begin_concurrent_reads()
+    //! \param n_shards number of shards of the readers' caches
+    void begin_concurrent_reads(size_t n_shards = 16)
+    {
+        impl.begin_concurrent_reads(n_shards);
+    }
+
+    //! Ends the read-concurrent mode
+    void end_concurrent_reads()
+    {
+        impl.end_concurrent_reads();
+    }
+
+    //! Returns whether the read-concurrent mode is active
+    bool concurrent_reads() const
+    {
+        return impl.concurrent_reads();
+    }
+
+    //! Looks up the data of a key, thread-safe in the read-concurrent mode
+    //! \return true if the key was found
+    bool concurrent_find(const key_type& k, data_type& data) const
+    {
+        return impl.concurrent_find(k, data);
+    }
+
+    //! Calls f(key, data) for all values with keys in [lower, upper) in key
+    //! order, thread-safe in the read-concurrent mode
+    template <class Functor>
+    void concurrent_scan(const key_type& lower, const key_type& upper,
+                         Functor f) const
+    {
+        impl.concurrent_scan(lower, upper, f);
+    }
+
     //! Prints cache statistics
     void print_statistics(std::ostream& o) const
     {
@@ -363,54 +575,66 @@ public:
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator == (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              class Compression_,
+              class PagerType_>
+    friend bool operator == (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& a,
+                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& b);
     //////////////////////////////////////////////////
     template <class KeyType_,
               class DataType_,
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator < (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                            const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              class Compression_,
+              class PagerType_>
+    friend bool operator < (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& a,
+                            const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& b);
     //////////////////////////////////////////////////
     template <class KeyType_,
               class DataType_,
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator > (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                            const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              class Compression_,
+              class PagerType_>
+    friend bool operator > (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& a,
+                            const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& b);
     //////////////////////////////////////////////////
     template <class KeyType_,
               class DataType_,
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator != (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              class Compression_,
+              class PagerType_>
+    friend bool operator != (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& a,
+                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& b);
     //////////////////////////////////////////////////
     template <class KeyType_,
               class DataType_,
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator <= (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              class Compression_,
+              class PagerType_>
+    friend bool operator <= (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& a,
+                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& b);
     //////////////////////////////////////////////////
     template <class KeyType_,
               class DataType_,
               class CompareType_,
               unsigned RawNodeSize_,
               unsigned RawLeafSize_,
-              class PDAllocStrategy_>
-    friend bool operator >= (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& a,
-                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_>& b);
+              class PDAllocStrategy_,
+              class Compression_,
+              class PagerType_>
+    friend bool operator >= (const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& a,
+                             const map<KeyType_, DataType_, CompareType_, RawNodeSize_, RawLeafSize_, PDAllocStrategy_, Compression_, PagerType_>& b);
     //////////////////////////////////////////////////
 };
 
@@ -419,10 +643,12 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
-inline bool operator == (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator == (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& a,
+                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return a.impl == b.impl;
 }
@@ -432,10 +658,12 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
-inline bool operator < (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                        const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator < (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& a,
+                        const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return a.impl < b.impl;
 }
@@ -445,10 +673,12 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
-inline bool operator > (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                        const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator > (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& a,
+                        const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return a.impl > b.impl;
 }
@@ -458,10 +688,12 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
-inline bool operator != (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator != (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& a,
+                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return a.impl != b.impl;
 }
@@ -471,10 +703,12 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
-inline bool operator <= (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator <= (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& a,
+                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return a.impl <= b.impl;
 }
@@ -484,10 +718,12 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
-inline bool operator >= (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b)
+inline bool operator >= (const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& a,
+                         const map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& b)
 {
     return a.impl >= b.impl;
 }
@@ -503,10 +739,12 @@ template <class KeyType,
           class CompareType,
           unsigned RawNodeSize,
           unsigned RawLeafSize,
-          class PDAllocStrategy
+          class PDAllocStrategy,
+          class Compression,
+          class PagerType
           >
-void swap(stxxl::map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& a,
-          stxxl::map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy>& b
+void swap(stxxl::map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& a,
+          stxxl::map<KeyType, DataType, CompareType, RawNodeSize, RawLeafSize, PDAllocStrategy, Compression, PagerType>& b
           )
 {
     a.swap(b);
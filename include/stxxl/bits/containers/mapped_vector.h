@@ -0,0 +1,368 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/mapped_vector.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_MAPPED_VECTOR_HEADER
+#define STXXL_CONTAINERS_MAPPED_VECTOR_HEADER
+
+#include <stxxl/bits/config.h>
+
+#if STXXL_HAVE_MMAP_FILE
+
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/types.hpp>
+
+namespace stxxl {
+
+//! \addtogroup stlcont_vector
+//! \{
+
+/*!
+ * Read-only view of the elements stored in a file, which is memory mapped
+ * instead of being read through a page cache of blocks.
+ *
+ * The file must hold the elements contiguously, as the files written by a
+ * stxxl::vector attached to a file_ptr do, which requires blocks without
+ * gaps. Opening the view only maps the file, its pages are read by the
+ * operating system when they are first accessed and may be evicted and
+ * shared with other processes mapping the same file, so large precomputed
+ * vectors are available immediately without occupying memory of their own.
+ *
+ * The access pattern can be hinted to the kernel by advise(), e.g. to read
+ * ahead aggressively for scans or not at all for random access. The
+ * iterators are random access iterators over the constant elements, and the
+ * view is safe to read from any number of threads.
+ */
+template <typename ValueType>
+class mapped_vector
+{
+    static constexpr bool debug = false;
+
+public:
+    using value_type = ValueType;
+    using size_type = foxxll::external_size_type;
+    using difference_type = std::ptrdiff_t;
+    using const_reference = const value_type&;
+    using reference = const_reference;
+    using const_pointer = const value_type*;
+    using pointer = const_pointer;
+    using const_iterator = const value_type*;
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    //! access patterns passed to madvise()
+    enum access_hint
+    {
+        //! default read-ahead of the kernel
+        normal,
+        //! pages are accessed in order, read ahead aggressively
+        sequential,
+        //! pages are accessed randomly, do not read ahead
+        random,
+        //! pages will be accessed soon, start reading them now
+        willneed
+    };
+
+protected:
+    int m_fd = -1;
+    void* m_map = nullptr;
+    size_t m_length = 0;
+    size_type m_size = 0;
+
+    static int advice_of(access_hint hint)
+    {
+        switch (hint)
+        {
+        case sequential:
+            return MADV_SEQUENTIAL;
+        case random:
+            return MADV_RANDOM;
+        case willneed:
+            return MADV_WILLNEED;
+        default:
+            return MADV_NORMAL;
+        }
+    }
+
+    void close()
+    {
+        if (m_map != nullptr)
+            munmap(m_map, m_length);
+        if (m_fd != -1)
+            ::close(m_fd);
+        m_map = nullptr;
+        m_fd = -1;
+        m_length = 0;
+        m_size = 0;
+    }
+
+public:
+    /*!
+     * Map the file read-only.
+     * \param filename file holding the elements
+     * \param size number of elements, default: as many as fit into the file
+     * \param hint access pattern passed to advise()
+     */
+    explicit mapped_vector(const std::string& filename,
+                           size_type size = size_type(-1),
+                           access_hint hint = normal)
+    {
+        m_fd = ::open(filename.c_str(), O_RDONLY);
+        if (m_fd == -1)
+            FOXXLL_THROW_ERRNO(foxxll::io_error,
+                               "mapped_vector: open() failed for path " << filename);
+
+        struct stat st;
+        if (fstat(m_fd, &st) != 0)
+        {
+            close();
+            FOXXLL_THROW_ERRNO(foxxll::io_error,
+                               "mapped_vector: fstat() failed for path " << filename);
+        }
+
+        const size_type file_length = static_cast<size_type>(st.st_size);
+        if (size == size_type(-1))
+            size = file_length / sizeof(value_type);
+
+        if (size * sizeof(value_type) > file_length)
+        {
+            close();
+            FOXXLL_THROW2(std::runtime_error, "mapped_vector::mapped_vector",
+                          "file " << filename << " of " << file_length
+                                  << " bytes is too short for " << size << " elements");
+        }
+
+        m_size = size;
+        m_length = static_cast<size_t>(size * sizeof(value_type));
+
+        // mmap() rejects empty mappings
+        if (m_length == 0)
+            return;
+
+        m_map = mmap(nullptr, m_length, PROT_READ, MAP_SHARED, m_fd, 0);
+        if (m_map == MAP_FAILED)
+        {
+            m_map = nullptr;
+            close();
+            FOXXLL_THROW_ERRNO(foxxll::io_error,
+                               "mapped_vector: mmap() failed for path " << filename);
+        }
+
+        TLX_LOG << "mapped_vector: mapped " << m_length << " bytes of " << filename;
+
+        advise(hint);
+    }
+
+    //! non-copyable: delete copy-constructor
+    mapped_vector(const mapped_vector&) = delete;
+    //! non-copyable: delete assignment operator
+    mapped_vector& operator = (const mapped_vector&) = delete;
+
+    //! move-constructor
+    mapped_vector(mapped_vector&& other) noexcept
+    {
+        swap(other);
+    }
+
+    //! move-assignment
+    mapped_vector& operator = (mapped_vector&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            swap(other);
+        }
+        return *this;
+    }
+
+    ~mapped_vector()
+    {
+        close();
+    }
+
+    void swap(mapped_vector& other) noexcept
+    {
+        std::swap(m_fd, other.m_fd);
+        std::swap(m_map, other.m_map);
+        std::swap(m_length, other.m_length);
+        std::swap(m_size, other.m_size);
+    }
+
+    //! \name Hints
+    //! \{
+
+    //! Hint the access pattern of the whole vector to the kernel.
+    void advise(access_hint hint) const
+    {
+        advise(hint, 0, m_size);
+    }
+
+    //! Hint the access pattern of the elements [begin, end) to the kernel.
+    void advise(access_hint hint, size_type begin, size_type end) const
+    {
+        assert(begin <= end && end <= m_size);
+        if (begin == end)
+            return;
+
+        // madvise() requires the start to be aligned to a page
+        static const size_t os_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t first = static_cast<size_t>(begin * sizeof(value_type))
+                             / os_page_size * os_page_size;
+        const size_t last = static_cast<size_t>(end * sizeof(value_type));
+
+        if (madvise(static_cast<char*>(m_map) + first, last - first, advice_of(hint)) != 0)
+        {
+            TLX_LOG << "mapped_vector: madvise() failed";
+        }
+    }
+
+    //! Start reading the elements [begin, end) in the background.
+    void prefetch(size_type begin, size_type end) const
+    {
+        advise(willneed, begin, end);
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Number of elements.
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    //! Whether the vector has no elements.
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    //! \}
+
+    //! \name Element Access
+    //! \{
+
+    //! Return constant reference to the element at the given index.
+    const_reference operator [] (size_type index) const
+    {
+        assert(index < m_size);
+        return data()[index];
+    }
+
+    //! Return constant reference to the element at the given index, checks
+    //! the range.
+    const_reference at(size_type index) const
+    {
+        if (index >= m_size)
+            throw std::out_of_range("mapped_vector::at");
+        return data()[index];
+    }
+
+    //! Return constant reference to the first element.
+    const_reference front() const
+    {
+        assert(!empty());
+        return *data();
+    }
+
+    //! Return constant reference to the last element.
+    const_reference back() const
+    {
+        assert(!empty());
+        return data()[m_size - 1];
+    }
+
+    //! Return the mapped elements.
+    const_pointer data() const
+    {
+        return static_cast<const_pointer>(m_map);
+    }
+
+    //! \}
+
+    //! \name Iterators
+    //! \{
+
+    const_iterator begin() const
+    {
+        return data();
+    }
+
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+
+    const_iterator end() const
+    {
+        return data() + m_size;
+    }
+
+    const_iterator cend() const
+    {
+        return end();
+    }
+
+    const_reverse_iterator rbegin() const
+    {
+        return const_reverse_iterator(end());
+    }
+
+    const_reverse_iterator crbegin() const
+    {
+        return rbegin();
+    }
+
+    const_reverse_iterator rend() const
+    {
+        return const_reverse_iterator(begin());
+    }
+
+    const_reverse_iterator crend() const
+    {
+        return rend();
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+namespace std {
+
+template <typename ValueType>
+void swap(stxxl::mapped_vector<ValueType>& a,
+          stxxl::mapped_vector<ValueType>& b)
+{
+    a.swap(b);
+}
+
+} // namespace std
+
+#endif // STXXL_HAVE_MMAP_FILE
+
+#endif // !STXXL_CONTAINERS_MAPPED_VECTOR_HEADER
@@ -14,14 +14,19 @@
 #define STXXL_CONTAINERS_MATRIX_HEADER
 
 #include <algorithm>
-#include <vector>
+#include <cassert>
+#include <deque>
+#include <stdexcept>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 #include <tlx/counting_ptr.hpp>
 #include <tlx/logger/core.hpp>
 
 #include <foxxll/mng/block_scheduler.hpp>
 
+#include <stxxl/bits/common/task_runtime.h>
 #include <stxxl/bits/containers/vector.h>
 #include <stxxl/bits/containers/matrix_arithmetic.h>
 
@@ -221,12 +226,11 @@ public:
     {
         // get_internal_block checks acquired
         internal_block_type& data = get_internal_block();
-        #if STXXL_PARALLEL
-        #pragma omp parallel for
-        #endif
-        for (unsigned row = 0; row < BlockSideLength; ++row)
-            for (unsigned col = 0; col < BlockSideLength; ++col)
-                data[row * BlockSideLength + col] = 0;
+        parallel_for(
+            0, BlockSideLength, [&](size_t row) {
+                for (unsigned col = 0; col < BlockSideLength; ++col)
+                    data[row * BlockSideLength + col] = 0;
+            });
     }
 };
 
@@ -1033,6 +1037,292 @@ public:
     using const_matrix_iterator_type::set_pos;
 };
 
+//! Block scheduling algorithm that provides a recorded prediction sequence
+//! to the offline algorithms, instead of a simulation run. It must be
+//! replaced by an offline algorithm before any block is accessed.
+template <typename SwappableBlockType>
+class block_scheduler_algorithm_replay
+    : public foxxll::block_scheduler_algorithm_simulation<SwappableBlockType>
+{
+    using super_type = foxxll::block_scheduler_algorithm_simulation<SwappableBlockType>;
+    using block_scheduler_type = foxxll::block_scheduler<SwappableBlockType>;
+    using prediction_sequence_type = typename block_scheduler_type::prediction_sequence_type;
+
+    const prediction_sequence_type& m_sequence;
+
+public:
+    block_scheduler_algorithm_replay(block_scheduler_type& bs, const prediction_sequence_type& sequence)
+        : super_type(bs), m_sequence(sequence) { }
+
+    const prediction_sequence_type & get_prediction_sequence() const override
+    { return m_sequence; }
+};
+
+//! Recorded schedule of the block accesses of a matrix multiplication, for
+//! repeated multiplications with matrix::multiply(right, plan).
+//!
+//! The first multiplication simulates the algorithm and records the
+//! prediction sequence, the following ones with the same blocks of the
+//! operands and the result, and the same algorithms, replay it with the
+//! offline scheduling algorithm and skip the simulation. The multiplication
+//! algorithms which allocate temporary blocks are simulated every time.
+template <typename ValueType, unsigned BlockSideLength>
+class matrix_multiply_plan
+{
+    friend class matrix<ValueType, BlockSideLength>;
+
+    using swappable_block_matrix_type = swappable_block_matrix<ValueType, BlockSideLength>;
+    using block_scheduler_type = typename swappable_block_matrix_type::block_scheduler_type;
+    using prediction_sequence_type = typename block_scheduler_type::prediction_sequence_type;
+    using blocks_type = typename swappable_block_matrix_type::blocks_type;
+
+    //! the algorithms and the blocks of the operands and the result of the
+    //! recorded multiplication
+    int m_multiplication_algorithm;
+    blocks_type m_blocks;
+    std::vector<bool> m_initialized;
+
+    prediction_sequence_type m_sequence;
+    bool m_recorded;
+
+    size_t m_replays;
+
+public:
+    matrix_multiply_plan()
+        : m_multiplication_algorithm(-1), m_recorded(false), m_replays(0) { }
+
+    //! Returns true if a schedule was recorded.
+    bool recorded() const { return m_recorded; }
+
+    //! Number of multiplications which replayed the recorded schedule.
+    size_t num_replays() const { return m_replays; }
+
+    //! Drops the recorded schedule.
+    void clear()
+    {
+        m_multiplication_algorithm = -1;
+        m_blocks.clear();
+        m_initialized.clear();
+        m_sequence.clear();
+        m_recorded = false;
+    }
+};
+
+//! \name Matrix expressions
+//!
+//! The sums, differences, scalar multiples and products of matrices are
+//! expressions, which are evaluated when assigned to a matrix or used to
+//! construct one. An expression is a linear combination of matrices and of
+//! products of two matrices, which are evaluated into the result with one
+//! sweep over the blocks for all element-wise terms, each block of the
+//! result being written once, followed by one multiply-and-add into the
+//! result for each product with coefficient one. Thus A * B + C - D reads C
+//! and D once and needs no temporary matrices. Other products, and the
+//! operands of products that are expressions themselves, are evaluated into
+//! temporaries.
+//!
+//! Expressions keep references to the matrices in them, which have to live
+//! until the expression is evaluated.
+//! \{
+
+//! base class of the matrices and the matrix expressions
+template <typename Derived, typename ValueType, unsigned BlockSideLength>
+class matrix_expression
+{
+public:
+    using value_type = ValueType;
+
+    const Derived & derived() const
+    { return static_cast<const Derived&>(*this); }
+};
+
+namespace matrix_local {
+
+//! the terms of a matrix expression: the sum of s * A over the (s, A) in
+//! sums and of s * A * B over the (s, A, B) in products
+template <typename ValueType, unsigned BlockSideLength>
+struct matrix_terms
+{
+    using matrix_type = matrix<ValueType, BlockSideLength>;
+
+    std::vector<std::pair<ValueType, const matrix_type*> > sums;
+    std::vector<std::tuple<ValueType, const matrix_type*, const matrix_type*> > products;
+    //! evaluated operands of products, which keep their addresses
+    std::deque<matrix_type> temporaries;
+};
+
+//! how an expression keeps its operands: matrices by reference, expressions
+//! by value
+template <typename Expression>
+struct matrix_expression_operand
+{ using type = const Expression; };
+
+template <typename ValueType, unsigned BlockSideLength>
+struct matrix_expression_operand<matrix<ValueType, BlockSideLength> >
+{ using type = const matrix<ValueType, BlockSideLength>&; };
+
+template <typename ValueType, unsigned BlockSideLength>
+void collect_terms(const matrix<ValueType, BlockSideLength>& m,
+                   matrix_terms<ValueType, BlockSideLength>& terms, const ValueType& coefficient)
+{ terms.sums.emplace_back(coefficient, &m); }
+
+template <typename Expression, typename ValueType, unsigned BlockSideLength>
+void collect_terms(const matrix_expression<Expression, ValueType, BlockSideLength>& e,
+                   matrix_terms<ValueType, BlockSideLength>& terms, const ValueType& coefficient)
+{ e.derived().collect_terms(terms, coefficient); }
+
+template <typename ValueType, unsigned BlockSideLength>
+const matrix<ValueType, BlockSideLength>&
+evaluate_operand(const matrix<ValueType, BlockSideLength>& m, matrix_terms<ValueType, BlockSideLength>&)
+{ return m; }
+
+template <typename Expression, typename ValueType, unsigned BlockSideLength>
+const matrix<ValueType, BlockSideLength>&
+evaluate_operand(const matrix_expression<Expression, ValueType, BlockSideLength>& e,
+                 matrix_terms<ValueType, BlockSideLength>& terms)
+{
+    terms.temporaries.emplace_back(e);
+    return terms.temporaries.back();
+}
+
+} // namespace matrix_local
+
+//! expression left + coefficient * right
+template <typename Left, typename Right, typename ValueType, unsigned BlockSideLength>
+class matrix_sum_expression
+    : public matrix_expression<matrix_sum_expression<Left, Right, ValueType, BlockSideLength>,
+                               ValueType, BlockSideLength>
+{
+    typename matrix_local::matrix_expression_operand<Left>::type left;
+    typename matrix_local::matrix_expression_operand<Right>::type right;
+    const ValueType coefficient;
+
+public:
+    matrix_sum_expression(const Left& left, const Right& right, const ValueType& coefficient)
+        : left(left), right(right), coefficient(coefficient)
+    { assert(left.get_height() == right.get_height() && left.get_width() == right.get_width()); }
+
+    size_t get_height() const
+    { return left.get_height(); }
+
+    size_t get_width() const
+    { return left.get_width(); }
+
+    void collect_terms(matrix_local::matrix_terms<ValueType, BlockSideLength>& terms, const ValueType& c) const
+    {
+        matrix_local::collect_terms(left, terms, c);
+        matrix_local::collect_terms(right, terms, ValueType(c * coefficient));
+    }
+};
+
+//! expression scalar * operand
+template <typename Operand, typename ValueType, unsigned BlockSideLength>
+class matrix_scaled_expression
+    : public matrix_expression<matrix_scaled_expression<Operand, ValueType, BlockSideLength>,
+                               ValueType, BlockSideLength>
+{
+    typename matrix_local::matrix_expression_operand<Operand>::type operand;
+    const ValueType scalar;
+
+public:
+    matrix_scaled_expression(const Operand& operand, const ValueType& scalar)
+        : operand(operand), scalar(scalar)
+    { }
+
+    size_t get_height() const
+    { return operand.get_height(); }
+
+    size_t get_width() const
+    { return operand.get_width(); }
+
+    void collect_terms(matrix_local::matrix_terms<ValueType, BlockSideLength>& terms, const ValueType& c) const
+    { matrix_local::collect_terms(operand, terms, ValueType(c * scalar)); }
+};
+
+//! expression left * right
+template <typename Left, typename Right, typename ValueType, unsigned BlockSideLength>
+class matrix_product_expression
+    : public matrix_expression<matrix_product_expression<Left, Right, ValueType, BlockSideLength>,
+                               ValueType, BlockSideLength>
+{
+    typename matrix_local::matrix_expression_operand<Left>::type left;
+    typename matrix_local::matrix_expression_operand<Right>::type right;
+
+public:
+    matrix_product_expression(const Left& left, const Right& right)
+        : left(left), right(right)
+    { assert(left.get_width() == right.get_height()); }
+
+    size_t get_height() const
+    { return left.get_height(); }
+
+    size_t get_width() const
+    { return right.get_width(); }
+
+    void collect_terms(matrix_local::matrix_terms<ValueType, BlockSideLength>& terms, const ValueType& c) const
+    {
+        const matrix<ValueType, BlockSideLength>& l = matrix_local::evaluate_operand(left, terms);
+        const matrix<ValueType, BlockSideLength>& r = matrix_local::evaluate_operand(right, terms);
+        terms.products.emplace_back(c, &l, &r);
+    }
+};
+
+template <typename Left, typename Right, typename ValueType, unsigned BlockSideLength>
+matrix_sum_expression<Left, Right, ValueType, BlockSideLength>
+operator + (const matrix_expression<Left, ValueType, BlockSideLength>& left,
+            const matrix_expression<Right, ValueType, BlockSideLength>& right)
+{
+    return matrix_sum_expression<Left, Right, ValueType, BlockSideLength>(
+        left.derived(), right.derived(), ValueType(1));
+}
+
+template <typename Left, typename Right, typename ValueType, unsigned BlockSideLength>
+matrix_sum_expression<Left, Right, ValueType, BlockSideLength>
+operator - (const matrix_expression<Left, ValueType, BlockSideLength>& left,
+            const matrix_expression<Right, ValueType, BlockSideLength>& right)
+{
+    return matrix_sum_expression<Left, Right, ValueType, BlockSideLength>(
+        left.derived(), right.derived(), ValueType(-1));
+}
+
+template <typename Operand, typename ValueType, unsigned BlockSideLength>
+matrix_scaled_expression<Operand, ValueType, BlockSideLength>
+operator - (const matrix_expression<Operand, ValueType, BlockSideLength>& operand)
+{
+    return matrix_scaled_expression<Operand, ValueType, BlockSideLength>(
+        operand.derived(), ValueType(-1));
+}
+
+template <typename Operand, typename ValueType, unsigned BlockSideLength>
+matrix_scaled_expression<Operand, ValueType, BlockSideLength>
+operator * (const matrix_expression<Operand, ValueType, BlockSideLength>& operand,
+            const typename matrix_expression<Operand, ValueType, BlockSideLength>::value_type& scalar)
+{
+    return matrix_scaled_expression<Operand, ValueType, BlockSideLength>(
+        operand.derived(), scalar);
+}
+
+template <typename Operand, typename ValueType, unsigned BlockSideLength>
+matrix_scaled_expression<Operand, ValueType, BlockSideLength>
+operator * (const typename matrix_expression<Operand, ValueType, BlockSideLength>::value_type& scalar,
+            const matrix_expression<Operand, ValueType, BlockSideLength>& operand)
+{
+    return matrix_scaled_expression<Operand, ValueType, BlockSideLength>(
+        operand.derived(), scalar);
+}
+
+//! the product, multiplied with the default algorithms of matrix::multiply()
+template <typename Left, typename Right, typename ValueType, unsigned BlockSideLength>
+matrix_product_expression<Left, Right, ValueType, BlockSideLength>
+operator * (const matrix_expression<Left, ValueType, BlockSideLength>& left,
+            const matrix_expression<Right, ValueType, BlockSideLength>& right)
+{
+    return matrix_product_expression<Left, Right, ValueType, BlockSideLength>(
+        left.derived(), right.derived());
+}
+
+//! \}
+
 //! External matrix container. \n
 //! <b> Introduction </b> to matrix container: see \ref tutorial_matrix tutorial. \n
 //! <b> Design and Internals </b> of matrix container: see \ref design_matrix.
@@ -1043,8 +1333,10 @@ public:
 //! Divides the matrix in square submatrices (blocks).
 //! Blocks can be swapped individually to and from external memory.
 //! They are only swapped if necessary to minimize I/O.
+//! Sums, differences, scalar multiples and products of matrices are matrix
+//! expressions, see matrix_expression.
 template <typename ValueType, unsigned BlockSideLength>
-class matrix
+class matrix : public matrix_expression<matrix<ValueType, BlockSideLength>, ValueType, BlockSideLength>
 {
 protected:
     using matrix_type = matrix<ValueType, BlockSideLength>;
@@ -1056,6 +1348,8 @@ protected:
     using elem_size_type = typename swappable_block_matrix_type::elem_size_type;
     using Ops = matrix_local::matrix_operations<ValueType, BlockSideLength>;
     using swappable_block_type = matrix_swappable_block<ValueType, BlockSideLength>;
+    using swappable_block_identifier_type = typename swappable_block_matrix_type::swappable_block_identifier_type;
+    using internal_block_type = typename swappable_block_type::internal_block_type;
 
 public:
     using iterator = matrix_iterator<ValueType, BlockSideLength>;
@@ -1110,6 +1404,27 @@ public:
               )
     { Ops::recursive_matrix_from_vectors(*data, left, right); }
 
+    //! Evaluates the matrix expression, see matrix_expression.
+    template <typename Expression>
+    matrix(const matrix_expression<Expression, ValueType, BlockSideLength>& e)
+        : height(e.derived().get_height()),
+          width(e.derived().get_width())
+    {
+        matrix_local::matrix_terms<ValueType, BlockSideLength> terms;
+        matrix_local::collect_terms(e.derived(), terms, ValueType(1));
+        data = tlx::make_counting<swappable_block_matrix_type>(
+            (terms.sums.empty() ? std::get<1>(terms.products.front()) : terms.sums.front().second)->data->bs,
+            foxxll::div_ceil(height, BlockSideLength),
+            foxxll::div_ceil(width, BlockSideLength));
+        add_terms(terms);
+    }
+
+    //! Evaluates the matrix expression into a new matrix, such that it may
+    //! contain this.
+    template <typename Expression>
+    matrix_type& operator = (const matrix_expression<Expression, ValueType, BlockSideLength>& e)
+    { return *this = matrix_type(e); }
+
     ~matrix() { }
     //! \}
 
@@ -1161,6 +1476,27 @@ public:
         std::swap(height, width);
     }
 
+    //! Returns the transposed matrix with its elements rearranged, unlike
+    //! transpose() which only swaps the blocks and transposes their element
+    //! order. Each block is read and written once, zero blocks are skipped.
+    matrix_type transposed_copy() const
+    {
+        matrix_type res(data->bs, width, height);
+        block_scheduler_type& bs = data->bs;
+        for (block_size_type row = 0; row < data->get_height(); ++row)
+            for (block_size_type col = 0; col < data->get_width(); ++col)
+            {
+                const swappable_block_identifier_type& src = data->block(row, col);
+                if (! bs.is_initialized(src))
+                    continue;
+                const swappable_block_identifier_type& dst = res.data->block(col, row);
+                transpose_block(bs.acquire(src), data->is_transposed(), bs.acquire(dst, true));
+                bs.release(src, false);
+                bs.release(dst, true);
+            }
+        return res;
+    }
+
     void set_zero()
     {
         if (data.unique())
@@ -1172,33 +1508,129 @@ public:
     }
     //! \}
 
-    //! \name Operations
+    //! \name Import/Export
     //! \{
-    matrix_type operator + (const matrix_type& right) const
-    {
-        assert(height == right.height && width == right.width);
-        matrix_type res(data->bs, height, width);
-        Ops::element_op(*res.data, *data, *right.data, typename Ops::addition()); // more efficient than copying this and then adding right
-        return res;
-    }
 
-    matrix_type operator - (const matrix_type& right) const
-    {
-        assert(height == right.height && width == right.width);
-        matrix_type res(data->bs, height, width);
-        Ops::element_op(*res.data, *data, *right.data, typename Ops::subtraction()); // more efficient than copying this and then subtracting right
-        return res;
-    }
+    //! Overwrites the matrix with height * width elements from the stream in
+    //! row-major order. Acquires one row of blocks at a time, which the block
+    //! scheduler must be able to hold, and writes each block once.
+    template <typename InputStream>
+    void import_row_major(InputStream& elements)
+    { import_elements(elements, false); }
+
+    //! Overwrites the matrix with height * width elements from the stream in
+    //! column-major order. Acquires one column of blocks at a time, which the
+    //! block scheduler must be able to hold, and writes each block once.
+    template <typename InputStream>
+    void import_col_major(InputStream& elements)
+    { import_elements(elements, true); }
+
+    //! Stream of the elements in row-major or column-major order, e.g. for
+    //! stream::materialize() into a stxxl::vector. Acquires one row (or
+    //! column) of blocks at a time, which the block scheduler must be able to
+    //! hold, and reads each block once. The stream keeps the elements of the
+    //! matrix at its construction.
+    class stream
+    {
+    public:
+        using value_type = ValueType;
+
+    protected:
+        swappable_block_matrix_pointer_type m_data;
+        bool m_col_major;
+        //! number of elements per row (column) of the matrix
+        elem_size_type m_inner_size;
+        //! elements left
+        elem_size_type m_size;
+        //! index of the acquired row (column) of blocks
+        block_size_type m_strip;
+        //! position of the current element in the acquired row (column) of blocks
+        elem_size_type m_outer, m_inner;
+        std::vector<const internal_block_type*> m_blocks;
+
+        const swappable_block_identifier_type& strip_block(const block_size_type i) const
+        { return m_col_major ? m_data->block(i, m_strip) : m_data->block(m_strip, i); }
+
+        void acquire_strip()
+        {
+            for (block_size_type i = 0; i < m_blocks.size(); ++i)
+                m_blocks[i] = &m_data->bs.acquire(strip_block(i));
+        }
 
-    matrix_type operator * (const matrix_type& right) const
-    { return multiply(right); }
+        void release_strip()
+        {
+            for (block_size_type i = 0; i < m_blocks.size(); ++i)
+                m_data->bs.release(strip_block(i), false);
+        }
 
-    matrix_type operator * (const ValueType scalar) const
-    {
-        matrix_type res(data->bs, height, width);
-        Ops::element_op(*res.data, *data, typename Ops::scalar_multiplication(scalar));
-        return res;
-    }
+    public:
+        explicit stream(const matrix_type& m, const bool col_major = false)
+            : m_data(m.data),
+              m_col_major(col_major),
+              m_inner_size(col_major ? m.height : m.width),
+              m_size(m.height * m.width),
+              m_strip(0), m_outer(0), m_inner(0),
+              m_blocks(foxxll::div_ceil(m_inner_size, BlockSideLength))
+        {
+            if (m_size > 0)
+                acquire_strip();
+        }
+
+        //! non-copyable: delete copy-constructor
+        stream(const stream&) = delete;
+        //! non-copyable: delete assignment operator
+        stream& operator = (const stream&) = delete;
+
+        ~stream()
+        {
+            if (m_size > 0)
+                release_strip();
+        }
+
+        //! number of elements left
+        elem_size_type size() const { return m_size; }
+
+        //! standard stream method
+        bool empty() const { return m_size == 0; }
+
+        //! standard stream method
+        const value_type& operator * () const
+        {
+            assert(! empty());
+            return (*m_blocks[m_inner / BlockSideLength])[
+                m_col_major ? m_data->elem_index_in_block_from_elem(m_inner, m_outer)
+                : m_data->elem_index_in_block_from_elem(m_outer, m_inner)];
+        }
+
+        //! standard stream method
+        const value_type* operator -> () const
+        { return &(operator * ()); }
+
+        //! standard stream method
+        stream& operator ++ ()
+        {
+            assert(! empty());
+            --m_size;
+            if (++m_inner < m_inner_size)
+                return *this;
+            m_inner = 0;
+            if (++m_outer < BlockSideLength && m_size > 0)
+                return *this;
+            m_outer = 0;
+            release_strip();
+            ++m_strip;
+            if (m_size > 0)
+                acquire_strip();
+            return *this;
+        }
+    };
+
+    //! \}
+
+    //! \name Operations
+    //! \{
+    // the sums, differences and products are matrix expressions, see
+    // matrix_expression
 
     matrix_type& operator += (const matrix_type& right)
     {
@@ -1216,8 +1648,19 @@ public:
         return *this;
     }
 
+    //! adds the expression, folding its products with coefficient one into
+    //! the multiply-and-add, see matrix_expression
+    template <typename Expression>
+    matrix_type& operator += (const matrix_expression<Expression, ValueType, BlockSideLength>& e)
+    { return add_expression(e.derived(), ValueType(1)); }
+
+    //! subtracts the expression, see matrix_expression
+    template <typename Expression>
+    matrix_type& operator -= (const matrix_expression<Expression, ValueType, BlockSideLength>& e)
+    { return add_expression(e.derived(), ValueType(-1)); }
+
     matrix_type& operator *= (const matrix_type& right)
-    { return *this = operator * (right); } // implicitly unifies by constructing a result-matrix
+    { return *this = multiply(right); } // implicitly unifies by constructing a result-matrix
 
     matrix_type& operator *= (const ValueType scalar)
     {
@@ -1244,6 +1687,32 @@ public:
         return res;
     }
 
+    //! multiply with a column vector, with one scan over the blocks of the
+    //! matrix and one over the vector per row of blocks, for vectors that do
+    //! not fit into internal memory
+    //! \param right vector to multiply with
+    //! \param scheduling_algorithm as for multiply(), the offline algorithms
+    //! prefetch the blocks of the next rows
+    column_vector_type multiply_streaming(const column_vector_type& right, const int scheduling_algorithm = 2) const
+    {
+        assert(elem_size_type(right.size()) == width);
+        column_vector_type res(height);
+        multiply_vector_streaming(right, res, false, scheduling_algorithm);
+        return res;
+    }
+
+    //! multiply a row vector from the left, with one scan over the blocks of
+    //! the matrix and one over the vector per column of blocks
+    //! \param left vector to multiply with
+    //! \param scheduling_algorithm as for multiply_streaming()
+    row_vector_type multiply_from_left_streaming(const row_vector_type& left, const int scheduling_algorithm = 2) const
+    {
+        assert(elem_size_type(left.size()) == height);
+        row_vector_type res(width);
+        multiply_vector_streaming(left, res, true, scheduling_algorithm);
+        return res;
+    }
+
     //! multiply with another matrix
     //! \param right matrix to multiply with
     //! \param multiplication_algorithm allows to choose the applied algorithm
@@ -1256,8 +1725,163 @@ public:
     //!    3: multi_level_strassen_winograd_multiply_and_add (sometimes fast but unstable time and I/O complexity) \n
     //!    4: strassen_winograd_multiply, optimized pre- and postadditions (sometimes fast but unstable time and I/O complexity) \n
     //!    5: strassen_winograd_multiply_and_add_interleaved, optimized preadditions (sometimes fast but unstable time and I/O complexity) \n
-    //!    6: multi_level_strassen_winograd_multiply_and_add_block_grained (sometimes fast but unstable time and I/O complexity)
-    matrix_type multiply(const matrix_type& right, const int multiplication_algorithm = 1, const int scheduling_algorithm = 2) const
+    //!    6: multi_level_strassen_winograd_multiply_and_add_block_grained (sometimes fast but unstable time and I/O complexity) \n
+    //!    7: parallel_recursive_multiply_and_add (recursive_multiply_and_add with parallel tasks, always uses online LRU scheduling)
+    matrix_type multiply(const matrix_type& right, const int multiplication_algorithm = 1, int scheduling_algorithm = 2) const
+    {
+        matrix_operation_profile profile;
+        return multiply(right, profile, multiplication_algorithm, scheduling_algorithm);
+    }
+
+    //! multiply with another matrix and record the profile of the call
+    //! \param right matrix to multiply with
+    //! \param profile is overwritten with the shape, the algorithms, the
+    //! block operations, the I/Os and the times of the call
+    //! \param multiplication_algorithm as for multiply()
+    //! \param scheduling_algorithm as for multiply()
+    matrix_type multiply(const matrix_type& right, matrix_operation_profile& profile,
+                         const int multiplication_algorithm = 1, int scheduling_algorithm = 2) const
+    {
+        assert(width == right.height);
+        assert(&data->bs == &right.data->bs);
+        matrix_type res(data->bs, height, right.width);
+
+        // the parallel tasks access the blocks in no fixed order, which the
+        // offline algorithms cannot replay
+        if (multiplication_algorithm == 7)
+            scheduling_algorithm = 0;
+
+        profile = matrix_operation_profile();
+        profile.height = height;
+        profile.width = right.width;
+        profile.inner = width;
+        profile.block_side_length = BlockSideLength;
+        profile.multiplication_algorithm = multiplication_algorithm;
+        profile.scheduling_algorithm = scheduling_algorithm;
+        profile.strassen_winograd_levels = Ops::strassen_winograd_num_levels(
+            multiplication_algorithm, res.data->get_height(), res.data->get_width(), data->get_width());
+        const foxxll::stats_data io_begin(*foxxll::stats::get_instance());
+        const double time_begin = foxxll::timestamp();
+
+        const matrix_operation_statistic_data blocks_begin;
+        profile.simulation_time = multiply_and_add_to(right, res, multiplication_algorithm, scheduling_algorithm);
+
+        profile.blocks = matrix_operation_statistic_data() - blocks_begin;
+        profile.elapsed_time = foxxll::timestamp() - time_begin;
+        const foxxll::stats_data io = foxxll::stats_data(*foxxll::stats::get_instance()) - io_begin;
+        profile.read_count = io.get_read_count();
+        profile.write_count = io.get_write_count();
+        profile.read_bytes = io.get_read_bytes();
+        profile.write_bytes = io.get_write_bytes();
+        profile.io_wait_time = io.get_io_wait_time();
+        return res;
+    }
+
+    //! choose the multiplication algorithm and the Strassen-Winograd base
+    //! case for the multiplication with right, see matrix_multiply_calibration
+    //! \param right matrix to multiply with
+    //! \param internal_memory bytes of internal memory of the block scheduler
+    matrix_multiply_choice choose_multiplication(const matrix_type& right, const size_t internal_memory) const
+    {
+        assert(width == right.height);
+        return matrix_multiply_calibration<ValueType, BlockSideLength>::get().choose(
+            data->get_height(), right.data->get_width(), data->get_width(), internal_memory);
+    }
+
+    //! multiply with another matrix, with the multiplication algorithm and
+    //! the Strassen-Winograd base case of choose_multiplication()
+    //! \param right matrix to multiply with
+    //! \param internal_memory bytes of internal memory of the block scheduler
+    //! \param profile is overwritten with the profile of the call
+    //! \param scheduling_algorithm as for multiply()
+    matrix_type multiply_auto(const matrix_type& right, const size_t internal_memory,
+                              matrix_operation_profile& profile, const int scheduling_algorithm = 2) const
+    {
+        const matrix_multiply_choice choice = choose_multiplication(right, internal_memory);
+        const unsigned base_case = Ops::strassen_winograd_base_case_size;
+        Ops::strassen_winograd_base_case_size = choice.strassen_winograd_base_case_size;
+        matrix_type res = multiply(right, profile, choice.multiplication_algorithm, scheduling_algorithm);
+        Ops::strassen_winograd_base_case_size = base_case;
+        return res;
+    }
+
+    //! multiply with another matrix, see multiply_auto()
+    matrix_type multiply_auto(const matrix_type& right, const size_t internal_memory,
+                              const int scheduling_algorithm = 2) const
+    {
+        matrix_operation_profile profile;
+        return multiply_auto(right, internal_memory, profile, scheduling_algorithm);
+    }
+
+    //! multiply with another matrix, with offline scheduling by a schedule
+    //! recorded in the plan
+    //!
+    //! If the plan was recorded for the same blocks of this, right and the
+    //! result, e.g. for the same operands and a result of the same shape after
+    //! the previous one was destroyed, the recorded schedule is replayed
+    //! without simulation. Otherwise the multiplication is simulated and the
+    //! plan records its schedule.
+    //! \param right matrix to multiply with
+    //! \param plan recorded schedule, see matrix_multiply_plan
+    //! \param multiplication_algorithm as for multiply(), except 7
+    //! \param scheduling_algorithm 1: offline LFD, 2: offline LRU prefetching
+    matrix_type multiply(const matrix_type& right, matrix_multiply_plan<ValueType, BlockSideLength>& plan,
+                         const int multiplication_algorithm = 1, const int scheduling_algorithm = 2) const
+    {
+        assert(width == right.height);
+        assert(&data->bs == &right.data->bs);
+        assert(multiplication_algorithm != 7);
+        assert(scheduling_algorithm > 0);
+        matrix_type res(data->bs, height, right.width);
+
+        // naive and recursive multiplication only access the blocks of the
+        // operands and the result
+        const bool replayable = (multiplication_algorithm == 0 || multiplication_algorithm == 1);
+
+        // the schedule depends on the blocks and which of them are zero
+        typename swappable_block_matrix_type::blocks_type blocks;
+        std::vector<bool> initialized;
+        for (const swappable_block_matrix_type* m : { &*data, &*right.data, &*res.data })
+            for (block_size_type row = 0; row < m->get_height(); ++row)
+                for (block_size_type col = 0; col < m->get_width(); ++col)
+                {
+                    blocks.push_back((*m)(row, col));
+                    initialized.push_back(data->bs.is_initialized(blocks.back()));
+                }
+
+        if (replayable && plan.m_recorded
+            && plan.m_multiplication_algorithm == multiplication_algorithm
+            && plan.m_blocks == blocks && plan.m_initialized == initialized)
+        {
+            delete data->bs.switch_algorithm_to(
+                new block_scheduler_algorithm_replay<swappable_block_type>(data->bs, plan.m_sequence));
+            ++plan.m_replays;
+        }
+        else
+        {
+            delete data->bs.switch_algorithm_to(
+                new foxxll::block_scheduler_algorithm_simulation<swappable_block_type>(data->bs));
+            multiply_with_algorithm(right, res, multiplication_algorithm);
+
+            plan.clear();
+            if (replayable)
+            {
+                plan.m_multiplication_algorithm = multiplication_algorithm;
+                plan.m_blocks.swap(blocks);
+                plan.m_initialized.swap(initialized);
+                plan.m_sequence = data->bs.get_prediction_sequence();
+                plan.m_recorded = true;
+            }
+        }
+        switch_scheduling_algorithm(scheduling_algorithm);
+        multiply_with_algorithm(right, res, multiplication_algorithm);
+        delete data->bs.switch_algorithm_to(
+            new foxxll::block_scheduler_algorithm_online_lru<swappable_block_type>(data->bs));
+        return res;
+    }
+
+    //! Use internal memory multiplication. Designated for testing. May exceed memory limitations.
+    matrix_type multiply_internal(const matrix_type& right, const int scheduling_algorithm = 2) const
     {
         assert(width == right.height);
         assert(&data->bs == &right.data->bs);
@@ -1268,51 +1892,282 @@ public:
             // all offline algos need a simulation-run
             delete data->bs.switch_algorithm_to(
                 new foxxll::block_scheduler_algorithm_simulation<swappable_block_type>(data->bs));
-            switch (multiplication_algorithm)
+            multiply_internal(right, res);
+        }
+        switch_scheduling_algorithm(scheduling_algorithm);
+        multiply_internal(right, res);
+        delete data->bs.switch_algorithm_to(
+            new foxxll::block_scheduler_algorithm_online_lru<swappable_block_type>(data->bs));
+        return res;
+    }
+    //! \}
+
+    //! \name Factorizations
+    //! The factorizations recurse on halves of the matrix like the recursive
+    //! multiplication, whose block kernels update the trailing submatrices.
+    //! \{
+
+    //! Cholesky factorization of a symmetric positive definite matrix, of
+    //! which only the elements on and below the diagonal are read. Returns
+    //! the lower triangular L with this = L * L^T. Throws std::domain_error if
+    //! the matrix is not positive definite.
+    //! \param scheduling_algorithm as for multiply(); the block accesses do
+    //! not depend on the values, hence the offline algorithms prefetch all
+    //! of them
+    matrix_type cholesky(const int scheduling_algorithm = 2) const
+    {
+        assert(height == width);
+        matrix_type res(data->bs, height, width);
+        for (block_size_type row = 0; row < data->get_height(); ++row)
+            for (block_size_type col = 0; col <= row; ++col)
+                Ops::element_op_swappable_block(
+                    (*res.data)(row, col), res.data->is_transposed(), res.data->bs,
+                    (*data)(row, col), data->is_transposed(), data->bs, typename Ops::addition());
+
+        bool positive_definite = true;
+        res.run_scheduled([&]() { positive_definite = Ops::recursive_cholesky(*res.data, last_block_size()); },
+                          scheduling_algorithm);
+        if (! positive_definite)
+            throw std::domain_error("stxxl::matrix::cholesky(): the matrix is not positive definite");
+        return res;
+    }
+
+    //! LU factorization with partial pivoting of a square matrix. Returns L
+    //! and U in one matrix with P * this = L * U, where L has a unit diagonal
+    //! and is stored below it. Throws std::domain_error if the matrix is
+    //! singular. The factorization of a column of blocks scans it once per
+    //! column, so it should fit into the internal memory of the scheduler.
+    //! \param pivots is overwritten with P: row r was interchanged with row
+    //! pivots[r] >= r, for r = 0, 1, ...
+    //! \param scheduling_algorithm as for multiply(); the pivots depend on the
+    //! values, hence the offline algorithms prefetch the blocks of each update
+    //! of a trailing submatrix after its pivots are known, the columns of
+    //! blocks are factored with online LRU
+    matrix_type lu(std::vector<elem_size_type>& pivots, const int scheduling_algorithm = 2) const
+    {
+        assert(height == width);
+        matrix_type res(*this);
+        res.data.unify();
+
+        pivots.clear();
+        auto schedule = [&](const auto& f) { res.run_scheduled(f, scheduling_algorithm); };
+        if (! Ops::recursive_lu(*res.data, last_block_size(), pivots, schedule))
+            throw std::domain_error("stxxl::matrix::lu(): the matrix is singular");
+        return res;
+    }
+
+    //! Solves L * L^T * x = b for this factor L of cholesky(), with x in
+    //! internal memory.
+    column_vector_type cholesky_solve(const column_vector_type& b) const
+    {
+        assert(height == width && elem_size_type(b.size()) == height);
+        std::vector<ValueType> x = import_vector(b);
+
+        Ops::triangular_solve(*data, false, false, x);
+        swappable_block_matrix_type transposed(*data, data->get_height(), data->get_width(), 0, 0);
+        transposed.transpose();
+        Ops::triangular_solve(transposed, true, false, x);
+
+        return export_vector(x);
+    }
+
+    //! Solves A * x = b for these factors and pivots of A.lu(), with x in
+    //! internal memory.
+    column_vector_type lu_solve(const std::vector<elem_size_type>& pivots, const column_vector_type& b) const
+    {
+        assert(height == width && elem_size_type(b.size()) == height);
+        assert(elem_size_type(pivots.size()) == height);
+        std::vector<ValueType> x = import_vector(b);
+
+        for (elem_size_type r = 0; r < height; ++r)
+            std::swap(x[r], x[pivots[r]]);
+        Ops::triangular_solve(*data, false, true, x);
+        Ops::triangular_solve(*data, true, false, x);
+
+        return export_vector(x);
+    }
+    //! \}
+
+protected:
+    //! reads the elements into one row (column) of blocks after the other
+    template <typename InputStream>
+    void import_elements(InputStream& elements, const bool col_major)
+    {
+        data.unify();
+        block_scheduler_type& bs = data->bs;
+        const elem_size_type inner_size = col_major ? height : width,
+            outer_size = col_major ? width : height;
+        std::vector<internal_block_type*> blocks(foxxll::div_ceil(inner_size, BlockSideLength));
+
+        for (elem_size_type outer_begin = 0; outer_begin < outer_size; outer_begin += BlockSideLength)
+        {
+            const block_size_type strip = outer_begin / BlockSideLength;
+            const elem_size_type outer_end = std::min<elem_size_type>(BlockSideLength, outer_size - outer_begin);
+            for (block_size_type i = 0; i < blocks.size(); ++i)
             {
-            case 0:
-                Ops::naive_multiply_and_add(*data, *right.data, *res.data);
-                break;
-            case 1:
-                Ops::recursive_multiply_and_add(*data, *right.data, *res.data);
-                break;
-            case 2:
-                Ops::strassen_winograd_multiply_and_add(*data, *right.data, *res.data);
-                break;
-            case 3:
-                Ops::multi_level_strassen_winograd_multiply_and_add(*data, *right.data, *res.data);
-                break;
-            case 4:
-                Ops::strassen_winograd_multiply(*data, *right.data, *res.data);
-                break;
-            case 5:
-                Ops::strassen_winograd_multiply_and_add_interleaved(*data, *right.data, *res.data);
-                break;
-            case 6:
-                Ops::multi_level_strassen_winograd_multiply_and_add_block_grained(*data, *right.data, *res.data);
-                break;
-            default:
-                TLX_LOG1 << "invalid multiplication-algorithm number";
-                break;
+                blocks[i] = &bs.acquire(col_major ? data->block(i, strip) : data->block(strip, i), true);
+                // the part of the block outside of the matrix has to be zero
+                if (outer_end < BlockSideLength || (i + 1) * BlockSideLength > inner_size)
+                    for (size_t k = 0; k < BlockSideLength * BlockSideLength; ++k)
+                        (*blocks[i])[k] = ValueType(0);
             }
+
+            for (elem_size_type outer = 0; outer < outer_end; ++outer)
+                for (elem_size_type inner = 0; inner < inner_size; ++inner, ++elements)
+                {
+                    assert(! elements.empty());
+                    (*blocks[inner / BlockSideLength])[
+                        col_major ? data->elem_index_in_block_from_elem(inner, outer)
+                        : data->elem_index_in_block_from_elem(outer, inner)] = *elements;
+                }
+
+            for (block_size_type i = 0; i < blocks.size(); ++i)
+                bs.release(col_major ? data->block(i, strip) : data->block(strip, i), true);
         }
-        switch (scheduling_algorithm)
+    }
+
+    //! dst = src^T with dst in row-major and src in col-major if src_transposed
+    static void transpose_block(const internal_block_type& src, const bool src_transposed,
+                                internal_block_type& dst)
+    {
+        if (src_transposed)
         {
-        case 0:
-            delete data->bs.switch_algorithm_to(
-                new foxxll::block_scheduler_algorithm_online_lru<swappable_block_type>(data->bs));
-            break;
-        case 1:
+            // src in col-major is its transpose in row-major
+            for (size_t k = 0; k < BlockSideLength * BlockSideLength; ++k)
+                dst[k] = src[k];
+            return;
+        }
+        // transpose in tiles to keep the rows of src and dst in cache
+        const unsigned tile = 16;
+        for (unsigned row_begin = 0; row_begin < BlockSideLength; row_begin += tile)
+            for (unsigned col_begin = 0; col_begin < BlockSideLength; col_begin += tile)
+                for (unsigned row = row_begin; row < std::min(row_begin + tile, BlockSideLength); ++row)
+                    for (unsigned col = col_begin; col < std::min(col_begin + tile, BlockSideLength); ++col)
+                        dst[col * BlockSideLength + row] = src[row * BlockSideLength + col];
+    }
+
+    //! calculates res = this * right + res with the multiplication_algorithm
+    //! and the scheduling_algorithm, after a simulation run for the offline
+    //! scheduling algorithms, and returns the time of the simulation run
+    double multiply_and_add_to(const matrix_type& right, matrix_type& res,
+                               const int multiplication_algorithm, const int scheduling_algorithm) const
+    {
+        double simulation_time = 0;
+        if (scheduling_algorithm > 0)
+        {
+            // all offline algos need a simulation-run
+            const double time_begin = foxxll::timestamp();
             delete data->bs.switch_algorithm_to(
-                new foxxll::block_scheduler_algorithm_offline_lfd<swappable_block_type>(data->bs));
-            break;
-        case 2:
+                new foxxll::block_scheduler_algorithm_simulation<swappable_block_type>(data->bs));
+            multiply_with_algorithm(right, res, multiplication_algorithm);
+            simulation_time = foxxll::timestamp() - time_begin;
+        }
+        switch_scheduling_algorithm(scheduling_algorithm);
+        multiply_with_algorithm(right, res, multiplication_algorithm);
+        delete data->bs.switch_algorithm_to(
+            new foxxll::block_scheduler_algorithm_online_lru<swappable_block_type>(data->bs));
+        return simulation_time;
+    }
+
+    //! runs the block operations of function with the scheduling_algorithm,
+    //! after a simulation run for the offline scheduling algorithms, for
+    //! which function has to acquire the same blocks when called twice
+    template <typename Function>
+    void run_scheduled(Function function, const int scheduling_algorithm) const
+    {
+        if (scheduling_algorithm > 0)
+        {
             delete data->bs.switch_algorithm_to(
-                new foxxll::block_scheduler_algorithm_offline_lru_prefetching<swappable_block_type>(data->bs));
-            break;
-        default:
-            TLX_LOG1 << "invalid scheduling-algorithm number";
+                new foxxll::block_scheduler_algorithm_simulation<swappable_block_type>(data->bs));
+            function();
+        }
+        switch_scheduling_algorithm(scheduling_algorithm);
+        function();
+        delete data->bs.switch_algorithm_to(
+            new foxxll::block_scheduler_algorithm_online_lru<swappable_block_type>(data->bs));
+    }
+
+    //! valid rows of the last row of blocks
+    size_t last_block_size() const
+    { return (height == 0) ? 0 : (height - 1) % BlockSideLength + 1; }
+
+    //! the vector padded to the rows of blocks with zeros
+    std::vector<ValueType> import_vector(const column_vector_type& v) const
+    {
+        std::vector<ValueType> x(data->get_height() * BlockSideLength, ValueType(0));
+        typename column_vector_type::bufreader_type reader(v);
+        for (elem_size_type i = 0; i < elem_size_type(v.size()); ++i, ++reader)
+            x[i] = *reader;
+        return x;
+    }
+
+    column_vector_type export_vector(const std::vector<ValueType>& x) const
+    {
+        column_vector_type v(height);
+        typename column_vector_type::bufwriter_type writer(v);
+        for (elem_size_type i = 0; i < height; ++i)
+            writer << x[i];
+        writer.finish();
+        return v;
+    }
+
+    //! adds the terms of an expression to this, which is none of their
+    //! matrices: the element-wise terms and the products with a coefficient
+    //! other than one in one sweep, then the other products by
+    //! multiply-and-add
+    void add_terms(matrix_local::matrix_terms<ValueType, BlockSideLength>& terms)
+    {
+        std::vector<std::pair<ValueType, const swappable_block_matrix_type*> > sums;
+        for (const std::pair<ValueType, const matrix_type*>& t : terms.sums)
+            sums.emplace_back(t.first, &*t.second->data);
+        for (const std::tuple<ValueType, const matrix_type*, const matrix_type*>& p : terms.products)
+        {
+            if (std::get<0>(p) == ValueType(1))
+                continue;
+            terms.temporaries.push_back(std::get<1>(p)->multiply(*std::get<2>(p)));
+            sums.emplace_back(std::get<0>(p), &*terms.temporaries.back().data);
+        }
+
+        if (! sums.empty())
+            Ops::linear_combination(*data, sums);
+
+        for (const std::tuple<ValueType, const matrix_type*, const matrix_type*>& p : terms.products)
+        {
+            if (std::get<0>(p) == ValueType(1))
+                std::get<1>(p)->multiply_and_add_to(*std::get<2>(p), *this, 1, 2);
+        }
+    }
+
+    //! this += coefficient * e
+    template <typename Expression>
+    matrix_type& add_expression(const Expression& e, const ValueType& coefficient)
+    {
+        assert(height == e.get_height() && width == e.get_width());
+        matrix_local::matrix_terms<ValueType, BlockSideLength> terms;
+        matrix_local::collect_terms(e, terms, coefficient);
+        data.unify();
+
+        bool aliased = false;
+        for (const std::pair<ValueType, const matrix_type*>& t : terms.sums)
+            aliased = aliased || t.second->data == data;
+        for (const std::tuple<ValueType, const matrix_type*, const matrix_type*>& p : terms.products)
+            aliased = aliased || std::get<1>(p)->data == data
+                      || std::get<2>(p)->data == data;
+        if (aliased)
+        {
+            // evaluate the terms into a temporary first
+            matrix_type tmp(data->bs, height, width);
+            tmp.add_terms(terms);
+            Ops::element_op(*data, *tmp.data, typename Ops::addition());
         }
+        else
+            add_terms(terms);
+        return *this;
+    }
+
+    //! calculates res = this * right + res with the multiplication_algorithm
+    void multiply_with_algorithm(const matrix_type& right, matrix_type& res, const int multiplication_algorithm) const
+    {
         switch (multiplication_algorithm)
         {
         case 0:
@@ -1336,29 +2191,37 @@ public:
         case 6:
             Ops::multi_level_strassen_winograd_multiply_and_add_block_grained(*data, *right.data, *res.data);
             break;
+        case 7:
+            Ops::parallel_recursive_multiply_and_add(*data, *right.data, *res.data);
+            break;
         default:
             TLX_LOG1 << "invalid multiplication-algorithm number";
             break;
         }
-        delete data->bs.switch_algorithm_to(
-            new foxxll::block_scheduler_algorithm_online_lru<swappable_block_type>(data->bs));
-        return res;
     }
 
-    //! Use internal memory multiplication. Designated for testing. May exceed memory limitations.
-    matrix_type multiply_internal(const matrix_type& right, const int scheduling_algorithm = 2) const
+    //! calculates res = this * x, or res = x * this if from_left
+    template <typename InputVector, typename OutputVector>
+    void multiply_vector_streaming(const InputVector& x, OutputVector& res, const bool from_left,
+                                   const int scheduling_algorithm) const
     {
-        assert(width == right.height);
-        assert(&data->bs == &right.data->bs);
-        matrix_type res(data->bs, height, right.width);
-
         if (scheduling_algorithm > 0)
         {
             // all offline algos need a simulation-run
             delete data->bs.switch_algorithm_to(
                 new foxxll::block_scheduler_algorithm_simulation<swappable_block_type>(data->bs));
-            multiply_internal(right, res);
+            Ops::streaming_matrix_vector_multiply(*data, from_left, x, res);
         }
+        switch_scheduling_algorithm(scheduling_algorithm);
+        Ops::streaming_matrix_vector_multiply(*data, from_left, x, res);
+        delete data->bs.switch_algorithm_to(
+            new foxxll::block_scheduler_algorithm_online_lru<swappable_block_type>(data->bs));
+    }
+
+    //! switches the block scheduler to the scheduling_algorithm, after a
+    //! simulation run for the offline algorithms
+    void switch_scheduling_algorithm(const int scheduling_algorithm) const
+    {
         switch (scheduling_algorithm)
         {
         case 0:
@@ -1376,14 +2239,8 @@ public:
         default:
             TLX_LOG1 << "invalid scheduling-algorithm number";
         }
-        multiply_internal(right, res);
-        delete data->bs.switch_algorithm_to(
-            new foxxll::block_scheduler_algorithm_online_lru<swappable_block_type>(data->bs));
-        return res;
     }
-    //! \}
 
-protected:
     void multiply_internal(const matrix_type& right, matrix_type& res) const
     {
         ValueType* A = new ValueType[height * width];
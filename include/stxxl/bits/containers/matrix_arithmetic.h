@@ -13,12 +13,20 @@
 #ifndef STXXL_CONTAINERS_MATRIX_ARITHMETIC_HEADER
 #define STXXL_CONTAINERS_MATRIX_ARITHMETIC_HEADER
 
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io/request_operations.hpp>
 #include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/typed_block.hpp>
 #include <stxxl/bits/containers/matrix_low_level.h>
 #include <tlx/math/round_to_power_of_two.hpp>
 #include <tlx/math/integer_log2.hpp>
 
 #include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
 
 namespace stxxl {
 
@@ -47,12 +55,18 @@ struct matrix_operation_statistic_dataset
         block_multiplications_saved_through_zero,
         block_addition_calls,
         block_additions_saved_through_zero;
+    //! blocks acquired by the block multiplications and additions
+    int64_t block_acquisitions;
+    //! seconds spent in low_level_matrix_multiply_and_add, summed over threads
+    double block_multiplication_time;
 
     matrix_operation_statistic_dataset()
         : block_multiplication_calls(0),
           block_multiplications_saved_through_zero(0),
           block_addition_calls(0),
-          block_additions_saved_through_zero(0) { }
+          block_additions_saved_through_zero(0),
+          block_acquisitions(0),
+          block_multiplication_time(0) { }
 
     matrix_operation_statistic_dataset operator + (const matrix_operation_statistic_dataset& stat)
     {
@@ -61,6 +75,8 @@ struct matrix_operation_statistic_dataset
         res.block_multiplications_saved_through_zero += stat.block_multiplications_saved_through_zero;
         res.block_addition_calls += stat.block_addition_calls;
         res.block_additions_saved_through_zero += stat.block_additions_saved_through_zero;
+        res.block_acquisitions += stat.block_acquisitions;
+        res.block_multiplication_time += stat.block_multiplication_time;
         return res;
     }
 
@@ -71,6 +87,8 @@ struct matrix_operation_statistic_dataset
         res.block_multiplications_saved_through_zero -= stat.block_multiplications_saved_through_zero;
         res.block_addition_calls -= stat.block_addition_calls;
         res.block_additions_saved_through_zero -= stat.block_additions_saved_through_zero;
+        res.block_acquisitions -= stat.block_acquisitions;
+        res.block_multiplication_time -= stat.block_multiplication_time;
         return res;
     }
 };
@@ -117,6 +135,126 @@ std::ostream& operator << (std::ostream& o, const matrix_operation_statistic_dat
       << statsd.block_additions_saved_through_zero << std::endl;
     o << "block additions performed                      : "
       << statsd.block_addition_calls - statsd.block_additions_saved_through_zero << std::endl;
+    o << "block acquisitions                             : "
+      << statsd.block_acquisitions << std::endl;
+    o << "block multiplication time                      : "
+      << statsd.block_multiplication_time << " s" << std::endl;
+    return o;
+}
+
+/*!
+ * Profile of one matrix multiplication, filled by matrix::multiply(right,
+ * profile, ...). It holds the shape, the chosen algorithms, the block
+ * operations and acquisitions of the multiplication run (without the
+ * simulation run) and the I/O and time of the whole call, to compare the
+ * multiplication algorithms for a shape.
+ */
+struct matrix_operation_profile
+{
+    //! \name Shape and Algorithms
+    //! \{
+
+    //! C (height x width) = A (height x inner) * B (inner x width), in elements
+    uint64_t height, width, inner;
+    unsigned block_side_length;
+    int multiplication_algorithm, scheduling_algorithm;
+    //! levels of Strassen-Winograd recursion above the block-recursive base
+    //! case, 0 for the algorithms without Strassen-Winograd
+    unsigned strassen_winograd_levels;
+
+    //! \}
+
+    //! \name Measurements
+    //! \{
+
+    //! block operations of the multiplication run
+    matrix_operation_statistic_dataset blocks;
+    //! I/Os through the block scheduler's block manager
+    uint64_t read_count, write_count, read_bytes, write_bytes;
+    //! seconds waiting for I/O
+    double io_wait_time;
+    //! seconds of the simulation run and of the whole call
+    double simulation_time, elapsed_time;
+
+    //! \}
+
+    matrix_operation_profile()
+        : height(0), width(0), inner(0), block_side_length(0),
+          multiplication_algorithm(0), scheduling_algorithm(0),
+          strassen_winograd_levels(0),
+          read_count(0), write_count(0), read_bytes(0), write_bytes(0),
+          io_wait_time(0), simulation_time(0), elapsed_time(0) { }
+
+    //! fraction of the block acquisitions that did not read the block, i.e.
+    //! found it in internal memory or prefetched. Estimated from the number
+    //! of reads, which also counts the reads of the simulation run.
+    double acquisition_hit_rate() const
+    {
+        if (blocks.block_acquisitions <= 0)
+            return 1.0;
+        const double misses = static_cast<double>(read_count)
+                              / static_cast<double>(blocks.block_acquisitions);
+        return misses < 1.0 ? 1.0 - misses : 0.0;
+    }
+
+    //! fraction of the elapsed time in the block multiplication kernel
+    double block_multiplication_fraction() const
+    { return elapsed_time > 0 ? blocks.block_multiplication_time / elapsed_time : 0.0; }
+
+    //! fraction of the elapsed time waiting for I/O
+    double io_wait_fraction() const
+    { return elapsed_time > 0 ? io_wait_time / elapsed_time : 0.0; }
+
+    //! write the profile as one JSON object
+    void write_json(std::ostream& o) const
+    {
+        o << "{\"height\":" << height
+          << ",\"width\":" << width
+          << ",\"inner\":" << inner
+          << ",\"block_side_length\":" << block_side_length
+          << ",\"multiplication_algorithm\":" << multiplication_algorithm
+          << ",\"scheduling_algorithm\":" << scheduling_algorithm
+          << ",\"strassen_winograd_levels\":" << strassen_winograd_levels
+          << ",\"block_multiplication_calls\":" << blocks.block_multiplication_calls
+          << ",\"block_multiplications_saved_through_zero\":" << blocks.block_multiplications_saved_through_zero
+          << ",\"block_addition_calls\":" << blocks.block_addition_calls
+          << ",\"block_additions_saved_through_zero\":" << blocks.block_additions_saved_through_zero
+          << ",\"block_acquisitions\":" << blocks.block_acquisitions
+          << ",\"acquisition_hit_rate\":" << acquisition_hit_rate()
+          << ",\"read_count\":" << read_count
+          << ",\"write_count\":" << write_count
+          << ",\"read_bytes\":" << read_bytes
+          << ",\"write_bytes\":" << write_bytes
+          << ",\"block_multiplication_time\":" << blocks.block_multiplication_time
+          << ",\"io_wait_time\":" << io_wait_time
+          << ",\"simulation_time\":" << simulation_time
+          << ",\"elapsed_time\":" << elapsed_time
+          << "}";
+    }
+};
+
+std::ostream& operator << (std::ostream& o, const matrix_operation_profile& profile)
+{
+    o << "matrix multiplication profile" << std::endl;
+    o << "shape (height x inner x width)                 : "
+      << profile.height << " x " << profile.inner << " x " << profile.width << std::endl;
+    o << "multiplication / scheduling algorithm          : "
+      << profile.multiplication_algorithm << " / " << profile.scheduling_algorithm << std::endl;
+    o << "Strassen-Winograd levels                       : "
+      << profile.strassen_winograd_levels << std::endl;
+    o << matrix_operation_statistic_data(profile.blocks);
+    o << "acquisition hit rate                           : "
+      << profile.acquisition_hit_rate() << std::endl;
+    o << "reads / bytes read                             : "
+      << profile.read_count << " / " << profile.read_bytes << std::endl;
+    o << "writes / bytes written                         : "
+      << profile.write_count << " / " << profile.write_bytes << std::endl;
+    o << "I/O wait time                                  : "
+      << profile.io_wait_time << " s" << std::endl;
+    o << "simulation time                                : "
+      << profile.simulation_time << " s" << std::endl;
+    o << "elapsed time                                   : "
+      << profile.elapsed_time << " s" << std::endl;
     return o;
 }
 
@@ -1022,7 +1160,8 @@ struct matrix_operations
 {
     // tuning-parameter: Only matrices larger than this (in blocks) are processed by Strassen-Winograd.
     // you have to adapt choose_level_for_feedable_sw, too
-    static const unsigned strassen_winograd_base_case_size;
+    // matrix::multiply_auto() sets it for the duration of a multiplication.
+    static unsigned strassen_winograd_base_case_size;
 
     using swappable_block_matrix_type =  swappable_block_matrix<ValueType, BlockSideLength>;
     using block_scheduler_type =  typename swappable_block_matrix_type::block_scheduler_type;
@@ -1068,6 +1207,14 @@ struct matrix_operations
         const ValueType s;
     };
 
+    struct scaled_addition
+    {
+        explicit scaled_addition(const ValueType scalar = 1) : s(scalar) { }
+        inline ValueType& operator () (ValueType& c, const ValueType& a) { return c += a * s; }
+        inline ValueType operator () (const ValueType& a) { return a * s; }
+        const ValueType s;
+    };
+
     // element_op<Op>(C,A,B) calculates C = A <Op> B
     template <class Op>
     static swappable_block_matrix_type&
@@ -1110,6 +1257,22 @@ struct matrix_operations
         return C;
     }
 
+    // linear_combination(C,terms) calculates C += sum of s * A over the (s, A) in terms
+    // in one sweep over the blocks, acquiring each block of C once per term in a row
+    static swappable_block_matrix_type&
+    linear_combination(swappable_block_matrix_type& C,
+                       const std::vector<std::pair<ValueType, const swappable_block_matrix_type*> >& terms)
+    {
+        for (size_type row = 0; row < C.get_height(); ++row)
+            for (size_type col = 0; col < C.get_width(); ++col)
+                for (const std::pair<ValueType, const swappable_block_matrix_type*>& t : terms)
+                    element_op_swappable_block(
+                        C(row, col), C.is_transposed(), C.bs,
+                        (*t.second)(row, col), t.second->is_transposed(), t.second->bs,
+                        scaled_addition(t.first));
+        return C;
+    }
+
     // calculates c = a <Op> b
     template <class Op>
     static void
@@ -1131,6 +1294,9 @@ struct matrix_operations
         }
         a_is_transposed = a_is_transposed != c_is_transposed;
         b_is_transposed = b_is_transposed != c_is_transposed;
+        if (! bs_c.is_simulating())
+            matrix_operation_statistic::get_instance()->block_acquisitions
+                += (bs_a.is_initialized(a) && bs_b.is_initialized(b)) ? 3 : 2;
         if (! bs_a.is_initialized(a))
         {
             // a is zero -> copy b
@@ -1208,6 +1374,8 @@ struct matrix_operations
         }
         const bool c_is_zero = ! bs_c.is_initialized(c);
         // acquire
+        if (! bs_c.is_simulating())
+            matrix_operation_statistic::get_instance()->block_acquisitions += 2;
         internal_block_type& ic = bs_c.acquire(c, c_is_zero),
         & ia = bs_a.acquire(a);
         // add
@@ -1248,6 +1416,8 @@ struct matrix_operations
             return;
         }
         // acquire
+        if (! bs_c.is_simulating())
+            ++matrix_operation_statistic::get_instance()->block_acquisitions;
         internal_block_type& ic = bs_c.acquire(c);
         // add
         if (! bs_c.is_simulating())
@@ -1423,6 +1593,50 @@ struct matrix_operations
               ul(upleft), ur(upright), dl(downleft), dr(downright) {}
     };
 
+    //! number of Strassen-Winograd recursion levels of multiplication
+    //! algorithm (numbered as in matrix::multiply()) for C = A * B, from the
+    //! height n and width m of C and the width l of A in blocks
+    static unsigned strassen_winograd_num_levels(const int multiplication_algorithm,
+                                                 size_type n, size_type m, size_type l)
+    {
+        const size_type min_side = std::min(l, std::min(m, n));
+        switch (multiplication_algorithm)
+        {
+        case 3:
+            // choose_level_for_feedable_sw uses two levels
+            return (min_side == 0 || tlx::integer_log2_ceil(min_side) < 2) ? 0 : 2;
+        case 6:
+        {
+            const size_t num_levels = (min_side == 0) ? 0 : tlx::integer_log2_ceil(min_side);
+            if (num_levels > STXXL_MATRIX_MULTI_LEVEL_STRASSEN_WINOGRAD_BASE_CASE)
+            {
+                const size_t levels = std::min<size_t>(
+                    num_levels, STXXL_MATRIX_MULTI_LEVEL_STRASSEN_WINOGRAD_MAX_NUM_LEVELS);
+                if (levels <= 5)
+                    return static_cast<unsigned>(levels);
+            }
+            // falls back to strassen_winograd_multiply_and_add_interleaved
+        }
+        // fallthrough
+        case 2:
+        case 4:
+        case 5:
+        {
+            unsigned levels = 0;
+            for ( ; n > strassen_winograd_base_case_size && m > strassen_winograd_base_case_size
+                  && l > strassen_winograd_base_case_size; ++levels)
+            {
+                n = foxxll::div_ceil(n, 2);
+                m = foxxll::div_ceil(m, 2);
+                l = foxxll::div_ceil(l, 2);
+            }
+            return levels;
+        }
+        default:
+            return 0;
+        }
+    }
+
     //! calculates C = A * B + C
     // requires fitting dimensions
     static swappable_block_matrix_type&
@@ -1807,6 +2021,102 @@ struct matrix_operations
         return C;
     }
 
+    //! calculates C = A * B + C like recursive_multiply_and_add, but the
+    //! quadrants of C are computed by parallel OpenMP tasks, as they are
+    //! independent. The order of the block accesses is not deterministic,
+    //! hence the block scheduler must use online scheduling; while simulating,
+    //! this falls back to recursive_multiply_and_add. The scheduler needs
+    //! three internal blocks per thread.
+    // assumes fitting dimensions
+    static swappable_block_matrix_type&
+    parallel_recursive_multiply_and_add(const swappable_block_matrix_type& A,
+                                        const swappable_block_matrix_type& B,
+                                        swappable_block_matrix_type& C)
+    {
+#if STXXL_PARALLEL
+        const size_t num_threads = static_cast<size_t>(omp_get_max_threads());
+        if (C.bs.is_simulating() || num_threads <= 1)
+            return recursive_multiply_and_add(A, B, C);
+
+        // spawn tasks for the upper levels, up to about four tasks per thread
+        unsigned task_levels = 1;
+        while ((size_t(1) << (2 * task_levels)) < 4 * num_threads)
+            ++task_levels;
+
+        #pragma omp parallel
+        #pragma omp single
+        parallel_recursive_multiply_and_add(A, B, C, task_levels);
+
+        return C;
+#else
+        return recursive_multiply_and_add(A, B, C);
+#endif
+    }
+
+#if STXXL_PARALLEL
+    static void
+    parallel_recursive_multiply_and_add(const swappable_block_matrix_type& A,
+                                        const swappable_block_matrix_type& B,
+                                        swappable_block_matrix_type& C,
+                                        unsigned task_levels)
+    {
+        // catch empty intervals
+        if (C.get_height() * C.get_width() * A.get_width() == 0)
+            return;
+        // base case
+        if ((C.get_height() == 1) + (C.get_width() == 1) + (A.get_width() == 1) >= 2)
+        {
+            for (size_type i = 0; i < C.get_height(); ++i)
+                for (size_type j = 0; j < C.get_width(); ++j)
+                    for (size_type k = 0; k < A.get_width(); ++k)
+                        locked_multiply_and_add_swappable_block(A(i, k), A.is_transposed(), A.bs,
+                                                                B(k, j), B.is_transposed(), B.bs,
+                                                                C(i, j), C.is_transposed(), C.bs);
+            return;
+        }
+
+        // partition matrix
+        swappable_block_matrix_approximative_quarterer qa(A), qb(B), qc(C);
+        if (task_levels == 0)
+        {
+            // same order as recursive_multiply_and_add
+            parallel_recursive_multiply_and_add(qa.ul, qb.ul, qc.ul, 0);
+            parallel_recursive_multiply_and_add(qa.ur, qb.dl, qc.ul, 0);
+            parallel_recursive_multiply_and_add(qa.ur, qb.dr, qc.ur, 0);
+            parallel_recursive_multiply_and_add(qa.ul, qb.ur, qc.ur, 0);
+            parallel_recursive_multiply_and_add(qa.dl, qb.ur, qc.dr, 0);
+            parallel_recursive_multiply_and_add(qa.dr, qb.dr, qc.dr, 0);
+            parallel_recursive_multiply_and_add(qa.dr, qb.dl, qc.dl, 0);
+            parallel_recursive_multiply_and_add(qa.dl, qb.ul, qc.dl, 0);
+            return;
+        }
+
+        // one task per quadrant of C, which adds its two products in turn
+        --task_levels;
+        #pragma omp task shared(qa, qb, qc) firstprivate(task_levels)
+        {
+            parallel_recursive_multiply_and_add(qa.ul, qb.ul, qc.ul, task_levels);
+            parallel_recursive_multiply_and_add(qa.ur, qb.dl, qc.ul, task_levels);
+        }
+        #pragma omp task shared(qa, qb, qc) firstprivate(task_levels)
+        {
+            parallel_recursive_multiply_and_add(qa.ur, qb.dr, qc.ur, task_levels);
+            parallel_recursive_multiply_and_add(qa.ul, qb.ur, qc.ur, task_levels);
+        }
+        #pragma omp task shared(qa, qb, qc) firstprivate(task_levels)
+        {
+            parallel_recursive_multiply_and_add(qa.dl, qb.ur, qc.dr, task_levels);
+            parallel_recursive_multiply_and_add(qa.dr, qb.dr, qc.dr, task_levels);
+        }
+        #pragma omp task shared(qa, qb, qc) firstprivate(task_levels)
+        {
+            parallel_recursive_multiply_and_add(qa.dr, qb.dl, qc.dl, task_levels);
+            parallel_recursive_multiply_and_add(qa.dl, qb.ul, qc.dl, task_levels);
+        }
+        #pragma omp taskwait
+    }
+#endif
+
     //! calculates C = A * B + C
     // requires fitting dimensions
     static swappable_block_matrix_type&
@@ -1847,16 +2157,555 @@ struct matrix_operations
         * cp = bs_c.acquire(c).begin();
         // multiply
         if (! bs_c.is_simulating())
+        {
+            matrix_operation_statistic& stat = *matrix_operation_statistic::get_instance();
+            stat.block_acquisitions += 3;
+            const double begin = foxxll::timestamp();
             low_level_matrix_multiply_and_add<ValueType, BlockSideLength>
                 (ap, a_is_transposed, bp, b_is_transposed, cp, c_is_transposed);
+            stat.block_multiplication_time += foxxll::timestamp() - begin;
+        }
         // release
         bs_a.release(a, false);
         bs_b.release(b, false);
         bs_c.release(c, true);
     }
 
+    //! serializes the calls of the parallel recursion to the block schedulers
+    static std::mutex& scheduler_mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    //! like multiply_and_add_swappable_block, but holds scheduler_mutex()
+    //! to acquire and release the blocks. The acquired blocks stay in internal
+    //! memory, hence the block multiplications run concurrently.
+    static void locked_multiply_and_add_swappable_block(
+        const swappable_block_identifier_type a, const bool a_is_transposed, block_scheduler_type& bs_a,
+        const swappable_block_identifier_type b, const bool b_is_transposed, block_scheduler_type& bs_b,
+        const swappable_block_identifier_type c, const bool c_is_transposed, block_scheduler_type& bs_c)
+    {
+        ValueType* ap, * bp, * cp;
+        {
+            std::unique_lock<std::mutex> lock(scheduler_mutex());
+            ++matrix_operation_statistic::get_instance()->block_multiplication_calls;
+            // check if zero-block (== ! initialized)
+            if (! bs_a.is_initialized(a) || ! bs_b.is_initialized(b))
+            {
+                ++matrix_operation_statistic::get_instance()->block_multiplications_saved_through_zero;
+                return;
+            }
+            matrix_operation_statistic::get_instance()->block_acquisitions += 3;
+            ap = bs_a.acquire(a).begin();
+            bp = bs_b.acquire(b).begin();
+            cp = bs_c.acquire(c).begin();
+        }
+        const double begin = foxxll::timestamp();
+        low_level_matrix_multiply_and_add<ValueType, BlockSideLength>
+            (ap, a_is_transposed, bp, b_is_transposed, cp, c_is_transposed);
+        const double time = foxxll::timestamp() - begin;
+        std::unique_lock<std::mutex> lock(scheduler_mutex());
+        matrix_operation_statistic::get_instance()->block_multiplication_time += time;
+        bs_a.release(a, false);
+        bs_b.release(b, false);
+        bs_c.release(c, true);
+    }
+
     // +-+ end matrix multiplication +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 
+    // +-+-+-+ factorization +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
+    /* The factorizations recurse on halves of the matrix (in blocks), like
+     * recursive_multiply_and_add, such that the updates of the trailing
+     * submatrices are recursive multiplications with their locality. The
+     * diagonal blocks and the panels are factored by the block kernels below,
+     * the updates use low_level_matrix_multiply_and_add, which runs in
+     * parallel or calls BLAS.
+     *
+     * The block matrices of the factorizations are square and padded, the
+     * last block on the diagonal has last_size valid rows and columns. The
+     * padding stays zero.
+     */
+
+    //! element (row, col) of an internal block
+    static ValueType& block_element(ValueType* a, const bool a_is_transposed,
+                                    const size_t row, const size_t col)
+    { return a_is_transposed ? a[row + col * BlockSideLength] : a[row * BlockSideLength + col]; }
+
+    //! calculates C -= A * B, in the order of recursive_multiply_and_add
+    // assumes fitting dimensions
+    static swappable_block_matrix_type&
+    recursive_multiply_and_subtract(const swappable_block_matrix_type& A,
+                                    const swappable_block_matrix_type& B,
+                                    swappable_block_matrix_type& C)
+    {
+        // catch empty intervals
+        if (C.get_height() * C.get_width() * A.get_width() == 0)
+            return C;
+        // base case
+        if ((C.get_height() == 1) + (C.get_width() == 1) + (A.get_width() == 1) >= 2)
+        {
+            for (size_type i = 0; i < C.get_height(); ++i)
+                for (size_type j = 0; j < C.get_width(); ++j)
+                    for (size_type k = 0; k < A.get_width(); ++k)
+                        multiply_and_subtract_swappable_block(A(i, k), A.is_transposed(), A.bs,
+                                                              B(k, j), B.is_transposed(), B.bs,
+                                                              C(i, j), C.is_transposed(), C.bs);
+            return C;
+        }
+
+        // partition matrix
+        swappable_block_matrix_approximative_quarterer qa(A), qb(B), qc(C);
+        recursive_multiply_and_subtract(qa.ul, qb.ul, qc.ul);
+        recursive_multiply_and_subtract(qa.ur, qb.dl, qc.ul);
+        recursive_multiply_and_subtract(qa.ur, qb.dr, qc.ur);
+        recursive_multiply_and_subtract(qa.ul, qb.ur, qc.ur);
+        recursive_multiply_and_subtract(qa.dl, qb.ur, qc.dr);
+        recursive_multiply_and_subtract(qa.dr, qb.dr, qc.dr);
+        recursive_multiply_and_subtract(qa.dr, qb.dl, qc.dl);
+        recursive_multiply_and_subtract(qa.dl, qb.ul, qc.dl);
+
+        return C;
+    }
+
+    //! calculates c -= a * b as c = -(-c + a * b), to use the multiplication kernel
+    static void multiply_and_subtract_swappable_block(
+        const swappable_block_identifier_type a, const bool a_is_transposed, block_scheduler_type& bs_a,
+        const swappable_block_identifier_type b, const bool b_is_transposed, block_scheduler_type& bs_b,
+        const swappable_block_identifier_type c, const bool c_is_transposed, block_scheduler_type& bs_c)
+    {
+        if (! bs_c.is_simulating())
+            ++matrix_operation_statistic::get_instance()->block_multiplication_calls;
+        // check if zero-block (== ! initialized)
+        if (! bs_a.is_initialized(a) || ! bs_b.is_initialized(b))
+        {
+            // => one factor is zero => product is zero
+            if (! bs_c.is_simulating())
+                ++matrix_operation_statistic::get_instance()->block_multiplications_saved_through_zero;
+            return;
+        }
+        // acquire
+        ValueType* ap = bs_a.acquire(a).begin(),
+        * bp = bs_b.acquire(b).begin(),
+        * cp = bs_c.acquire(c).begin();
+        // multiply
+        if (! bs_c.is_simulating())
+        {
+            matrix_operation_statistic& stat = *matrix_operation_statistic::get_instance();
+            stat.block_acquisitions += 3;
+            const double begin = foxxll::timestamp();
+            for (size_t k = 0; k < BlockSideLength * BlockSideLength; ++k)
+                cp[k] = -cp[k];
+            low_level_matrix_multiply_and_add<ValueType, BlockSideLength>
+                (ap, a_is_transposed, bp, b_is_transposed, cp, c_is_transposed);
+            for (size_t k = 0; k < BlockSideLength * BlockSideLength; ++k)
+                cp[k] = -cp[k];
+            stat.block_multiplication_time += foxxll::timestamp() - begin;
+        }
+        // release
+        bs_a.release(a, false);
+        bs_b.release(b, false);
+        bs_c.release(c, true);
+    }
+
+    //! calculates the lower triangular L with L * L^T = A in place, ignoring
+    //! the elements of A above the diagonal, which are set to zero. Returns
+    //! whether A is positive definite; if not, L contains NaNs.
+    static bool recursive_cholesky(swappable_block_matrix_type& A, const size_t last_size)
+    {
+        const size_type n = A.get_height();
+        if (n == 0)
+            return true;
+        if (n == 1)
+            return cholesky_swappable_block(A(0, 0), A.is_transposed(), A.bs, last_size);
+
+        // A11 = L11 * L11^T, A21 = L21 * L11^T, A22 - L21 * L21^T = L22 * L22^T
+        const size_type n1 = n / 2;
+        swappable_block_matrix_type A11(A, n1, n1, 0, 0), A12(A, n1, n - n1, 0, n1),
+            A21(A, n - n1, n1, n1, 0), A22(A, n - n1, n - n1, n1, n1), A21t(A21, n - n1, n1, 0, 0);
+        A21t.transpose();
+
+        const bool positive_definite = recursive_cholesky(A11, BlockSideLength);
+        recursive_transposed_lower_solve(A11, A21);
+        recursive_lower_multiply_and_subtract(A21, A21t, A22);
+        A12.set_zero();
+        return recursive_cholesky(A22, last_size) && positive_definite;
+    }
+
+    //! calculates X = X * L^-T with L the lower triangle of A
+    // assumes fitting dimensions
+    static void recursive_transposed_lower_solve(const swappable_block_matrix_type& A,
+                                                 swappable_block_matrix_type& X)
+    {
+        const size_type n = A.get_height();
+        if (X.get_height() * n == 0)
+            return;
+        if (n == 1)
+        {
+            for (size_type i = 0; i < X.get_height(); ++i)
+                transposed_lower_solve_swappable_block(A(0, 0), A.is_transposed(), A.bs,
+                                                       X(i, 0), X.is_transposed(), X.bs);
+            return;
+        }
+
+        // X1 * L11^T = X1, X2 * L22^T = X2 - X1 * L21^T
+        const size_type n1 = n / 2;
+        swappable_block_matrix_type A11(A, n1, n1, 0, 0), A21t(A, n - n1, n1, n1, 0),
+            A22(A, n - n1, n - n1, n1, n1),
+            X1(X, X.get_height(), n1, 0, 0), X2(X, X.get_height(), n - n1, 0, n1);
+        A21t.transpose();
+
+        recursive_transposed_lower_solve(A11, X1);
+        recursive_multiply_and_subtract(X1, A21t, X2);
+        recursive_transposed_lower_solve(A22, X2);
+    }
+
+    //! calculates C -= A * A^T on and below the diagonal of C, with At = A^T
+    // assumes fitting dimensions
+    static void recursive_lower_multiply_and_subtract(const swappable_block_matrix_type& A,
+                                                      const swappable_block_matrix_type& At,
+                                                      swappable_block_matrix_type& C)
+    {
+        const size_type n = C.get_height();
+        if (n * A.get_width() == 0)
+            return;
+        if (n == 1)
+        {
+            for (size_type k = 0; k < A.get_width(); ++k)
+                multiply_and_subtract_swappable_block(A(0, k), A.is_transposed(), A.bs,
+                                                      At(k, 0), At.is_transposed(), At.bs,
+                                                      C(0, 0), C.is_transposed(), C.bs);
+            return;
+        }
+
+        const size_type n1 = n / 2;
+        swappable_block_matrix_type A1(A, n1, A.get_width(), 0, 0), A2(A, n - n1, A.get_width(), n1, 0),
+            At1(At, At.get_height(), n1, 0, 0), At2(At, At.get_height(), n - n1, 0, n1),
+            C11(C, n1, n1, 0, 0), C21(C, n - n1, n1, n1, 0), C22(C, n - n1, n - n1, n1, n1);
+
+        recursive_lower_multiply_and_subtract(A1, At1, C11);
+        recursive_multiply_and_subtract(A2, At1, C21);
+        recursive_lower_multiply_and_subtract(A2, At2, C22);
+    }
+
+    //! calculates the lower triangular L with L * L^T = A for the leading
+    //! size x size elements of the block a, with the elements above the
+    //! diagonal set to zero
+    static bool cholesky_swappable_block(const swappable_block_identifier_type a, const bool a_is_transposed,
+                                         block_scheduler_type& bs, const size_t size)
+    {
+        ValueType* ap = bs.acquire(a).begin();
+        bool positive_definite = true;
+        if (! bs.is_simulating())
+        {
+            for (size_t j = 0; j < size; ++j)
+            {
+                ValueType d = block_element(ap, a_is_transposed, j, j);
+                for (size_t k = 0; k < j; ++k)
+                    d -= block_element(ap, a_is_transposed, j, k) * block_element(ap, a_is_transposed, j, k);
+                // also catches NaN
+                if (! (d > ValueType(0)))
+                    positive_definite = false;
+                const ValueType l_jj = std::sqrt(d);
+                block_element(ap, a_is_transposed, j, j) = l_jj;
+
+                #if STXXL_PARALLEL
+                #pragma omp parallel for
+                #endif
+                for (omp_int_type i = omp_int_type(j) + 1; i < omp_int_type(size); ++i)
+                {
+                    ValueType s = block_element(ap, a_is_transposed, i, j);
+                    for (size_t k = 0; k < j; ++k)
+                        s -= block_element(ap, a_is_transposed, i, k) * block_element(ap, a_is_transposed, j, k);
+                    block_element(ap, a_is_transposed, i, j) = s / l_jj;
+                }
+            }
+            for (size_t i = 0; i < BlockSideLength; ++i)
+                for (size_t j = i + 1; j < BlockSideLength; ++j)
+                    block_element(ap, a_is_transposed, i, j) = ValueType(0);
+        }
+        bs.release(a, true);
+        return positive_definite;
+    }
+
+    //! calculates x = x * L^-T with L the lower triangle of the block a
+    static void transposed_lower_solve_swappable_block(
+        const swappable_block_identifier_type a, const bool a_is_transposed, block_scheduler_type& bs_a,
+        const swappable_block_identifier_type x, const bool x_is_transposed, block_scheduler_type& bs_x)
+    {
+        if (! bs_x.is_initialized(x))
+            return; // zero block
+        ValueType* ap = bs_a.acquire(a).begin(),
+        * xp = bs_x.acquire(x).begin();
+        if (! bs_x.is_simulating())
+        {
+            // the rows of x are independent
+            #if STXXL_PARALLEL
+            #pragma omp parallel for
+            #endif
+            for (omp_int_type i = 0; i < omp_int_type(BlockSideLength); ++i)
+                for (size_t j = 0; j < BlockSideLength; ++j)
+                {
+                    ValueType s = block_element(xp, x_is_transposed, i, j);
+                    for (size_t k = 0; k < j; ++k)
+                        s -= block_element(xp, x_is_transposed, i, k) * block_element(ap, a_is_transposed, j, k);
+                    block_element(xp, x_is_transposed, i, j) = s / block_element(ap, a_is_transposed, j, j);
+                }
+        }
+        bs_a.release(a, false);
+        bs_x.release(x, true);
+    }
+
+    /*!
+     * calculates P * A = L * U in place with partial pivoting, for A of at
+     * least as many rows as columns, of which the last block column has
+     * last_size valid columns. L has a unit diagonal and is stored below it.
+     * Appends the pivots, relative to the first row of A, to pivots: row r of
+     * A was swapped with row pivots[r] >= r, in the order of r. Returns
+     * whether no pivot was zero.
+     *
+     * The pivots depend on the values, hence a panel is factored with the
+     * current scheduling algorithm. The updates of the trailing submatrix
+     * depend only on the pivots and are passed to schedule(f), which calls f
+     * once or twice, e.g. in a simulation run first.
+     */
+    template <typename Schedule>
+    static bool recursive_lu(swappable_block_matrix_type& A, const size_t last_size,
+                             std::vector<size_t>& pivots, Schedule& schedule)
+    {
+        const size_type m = A.get_height(), n = A.get_width();
+        if (n == 0)
+            return true;
+        if (n == 1)
+            return lu_panel(A, last_size, pivots);
+
+        const size_type n1 = n / 2;
+        swappable_block_matrix_type left(A, m, n1, 0, 0), right(A, m, n - n1, 0, n1),
+            L11(A, n1, n1, 0, 0), L21(A, m - n1, n1, n1, 0),
+            A12(A, n1, n - n1, 0, n1), A22(A, m - n1, n - n1, n1, n1);
+
+        const size_t first = pivots.size();
+        bool nonsingular = recursive_lu(left, BlockSideLength, pivots, schedule);
+        const std::vector<size_t> left_pivots(pivots.begin() + first, pivots.end());
+
+        // A12 = L11 * U12, A22 - L21 * U12 = L22 * U22
+        schedule([&]() {
+                     apply_row_swaps(right, left_pivots);
+                     recursive_lower_unit_solve(L11, A12);
+                     recursive_multiply_and_subtract(L21, A12, A22);
+                 });
+
+        std::vector<size_t> lower_pivots;
+        nonsingular = recursive_lu(A22, last_size, lower_pivots, schedule) && nonsingular;
+        schedule([&]() { apply_row_swaps(L21, lower_pivots); });
+        for (const size_t& p : lower_pivots)
+            pivots.push_back(p + n1 * BlockSideLength);
+        return nonsingular;
+    }
+
+    //! factors a column of blocks as in recursive_lu, one column after the
+    //! other with one scan over the blocks each
+    static bool lu_panel(swappable_block_matrix_type& A, const size_t last_size, std::vector<size_t>& pivots)
+    {
+        block_scheduler_type& bs = A.bs;
+        const bool t = A.is_transposed();
+        assert(! bs.is_simulating());
+        const size_type m = A.get_height();
+        std::vector<ValueType> pivot_row(BlockSideLength);
+        bool nonsingular = true;
+
+        // the pivot of the first column
+        size_t pivot = 0;
+        ValueType max = ValueType(0);
+        for (size_type i = 0; i < m; ++i)
+        {
+            if (! bs.is_initialized(A(i, 0)))
+                continue; // zero block
+            ValueType* ap = bs.acquire(A(i, 0)).begin();
+            for (size_t r = 0; r < BlockSideLength; ++r)
+                if (std::abs(block_element(ap, t, r, 0)) > max)
+                    max = std::abs(block_element(ap, t, r, 0)), pivot = i * BlockSideLength + r;
+            bs.release(A(i, 0), false);
+        }
+
+        for (size_t c = 0; c < last_size; ++c)
+        {
+            pivots.push_back(pivot);
+            if (max == ValueType(0))
+                nonsingular = false;
+
+            // swap the rows c and pivot, and keep the pivot row
+            ValueType* cp = bs.acquire(A(0, 0)).begin();
+            ValueType* pp = (pivot < BlockSideLength) ? cp : bs.acquire(A(pivot / BlockSideLength, 0)).begin();
+            for (size_t j = 0; j < BlockSideLength; ++j)
+            {
+                std::swap(block_element(cp, t, c, j), block_element(pp, t, pivot % BlockSideLength, j));
+                pivot_row[j] = block_element(cp, t, c, j);
+            }
+            if (pivot >= BlockSideLength)
+                bs.release(A(pivot / BlockSideLength, 0), true);
+            bs.release(A(0, 0), true);
+
+            // scale the column below the pivot and update the columns to its
+            // right, while searching the pivot of the next column
+            pivot = c + 1;
+            max = ValueType(0);
+            for (size_type i = 0; i < m; ++i)
+            {
+                const size_t r_begin = (i == 0) ? c + 1 : 0;
+                if (r_begin >= BlockSideLength || ! bs.is_initialized(A(i, 0)))
+                    continue;
+                ValueType* ap = bs.acquire(A(i, 0)).begin();
+                for (size_t r = r_begin; r < BlockSideLength; ++r)
+                {
+                    ValueType& l = block_element(ap, t, r, c);
+                    if (pivot_row[c] != ValueType(0))
+                        l /= pivot_row[c];
+                    for (size_t j = c + 1; j < BlockSideLength; ++j)
+                        block_element(ap, t, r, j) -= l * pivot_row[j];
+                    if (c + 1 < last_size && std::abs(block_element(ap, t, r, c + 1)) > max)
+                        max = std::abs(block_element(ap, t, r, c + 1)), pivot = i * BlockSideLength + r;
+                }
+                bs.release(A(i, 0), true);
+            }
+        }
+        return nonsingular;
+    }
+
+    //! swaps the rows r and pivots[r] of A in the order of r, one column of
+    //! blocks after the other
+    static void apply_row_swaps(const swappable_block_matrix_type& A, const std::vector<size_t>& pivots)
+    {
+        block_scheduler_type& bs = A.bs;
+        const bool t = A.is_transposed();
+        for (size_type col = 0; col < A.get_width(); ++col)
+            for (size_t r = 0; r < pivots.size(); ++r)
+            {
+                const size_t p = pivots[r];
+                if (p == r)
+                    continue;
+                const swappable_block_identifier_type& a = A(r / BlockSideLength, col),
+                & b = A(p / BlockSideLength, col);
+                if (! bs.is_initialized(a) && ! bs.is_initialized(b))
+                    continue; // zero rows
+                ValueType* ap = bs.acquire(a).begin();
+                ValueType* bp = (a == b) ? ap : bs.acquire(b).begin();
+                if (! bs.is_simulating())
+                    for (size_t j = 0; j < BlockSideLength; ++j)
+                        std::swap(block_element(ap, t, r % BlockSideLength, j),
+                                  block_element(bp, t, p % BlockSideLength, j));
+                if (a != b)
+                    bs.release(b, true);
+                bs.release(a, true);
+            }
+    }
+
+    //! calculates X = L^-1 * X with L the lower triangle of A with a unit diagonal
+    // assumes fitting dimensions
+    static void recursive_lower_unit_solve(const swappable_block_matrix_type& A,
+                                           swappable_block_matrix_type& X)
+    {
+        const size_type n = A.get_height();
+        if (n * X.get_width() == 0)
+            return;
+        if (n == 1)
+        {
+            for (size_type j = 0; j < X.get_width(); ++j)
+                lower_unit_solve_swappable_block(A(0, 0), A.is_transposed(), A.bs,
+                                                 X(0, j), X.is_transposed(), X.bs);
+            return;
+        }
+
+        // L11 * X1 = X1, L22 * X2 = X2 - L21 * X1
+        const size_type n1 = n / 2;
+        swappable_block_matrix_type A11(A, n1, n1, 0, 0), A21(A, n - n1, n1, n1, 0),
+            A22(A, n - n1, n - n1, n1, n1),
+            X1(X, n1, X.get_width(), 0, 0), X2(X, n - n1, X.get_width(), n1, 0);
+
+        recursive_lower_unit_solve(A11, X1);
+        recursive_multiply_and_subtract(A21, X1, X2);
+        recursive_lower_unit_solve(A22, X2);
+    }
+
+    //! calculates x = L^-1 * x with L the lower triangle of the block a with a unit diagonal
+    static void lower_unit_solve_swappable_block(
+        const swappable_block_identifier_type a, const bool a_is_transposed, block_scheduler_type& bs_a,
+        const swappable_block_identifier_type x, const bool x_is_transposed, block_scheduler_type& bs_x)
+    {
+        if (! bs_x.is_initialized(x))
+            return; // zero block
+        ValueType* ap = bs_a.acquire(a).begin(),
+        * xp = bs_x.acquire(x).begin();
+        if (! bs_x.is_simulating())
+        {
+            // the columns of x are independent, subtract rows in ranges of columns
+            const omp_int_type cols = 32;
+            #if STXXL_PARALLEL
+            #pragma omp parallel for
+            #endif
+            for (omp_int_type col_begin = 0; col_begin < omp_int_type(BlockSideLength); col_begin += cols)
+            {
+                const size_t col_end = std::min(size_t(col_begin + cols), size_t(BlockSideLength));
+                for (size_t i = 1; i < BlockSideLength; ++i)
+                    for (size_t k = 0; k < i; ++k)
+                    {
+                        const ValueType l_ik = block_element(ap, a_is_transposed, i, k);
+                        for (size_t j = size_t(col_begin); j < col_end; ++j)
+                            block_element(xp, x_is_transposed, i, j) -= l_ik * block_element(xp, x_is_transposed, k, j);
+                    }
+            }
+        }
+        bs_a.release(a, false);
+        bs_x.release(x, true);
+    }
+
+    //! solves T * x = b in place, with T the lower or upper triangle of A and
+    //! its diagonal taken as one if unit, in one scan over the blocks of the
+    //! triangle. The padding of x has to be zero.
+    static void triangular_solve(const swappable_block_matrix_type& A, const bool upper,
+                                 const bool unit, std::vector<ValueType>& x)
+    {
+        block_scheduler_type& bs = A.bs;
+        const bool t = A.is_transposed();
+        const size_type n = A.get_height();
+        std::vector<ValueType> z(BlockSideLength);
+        for (size_type step = 0; step < n; ++step)
+        {
+            const size_type i = upper ? n - 1 - step : step;
+            ValueType* xi = x.data() + i * BlockSideLength;
+
+            // subtract the blocks off the diagonal
+            std::fill(z.begin(), z.end(), ValueType(0));
+            for (size_type j = (upper ? i + 1 : 0); j < (upper ? n : i); ++j)
+            {
+                if (! bs.is_initialized(A(i, j)))
+                    continue; // zero block
+                block_vector_multiply_and_add(bs.acquire(A(i, j)), t, x.data() + j * BlockSideLength, z.data(),
+                                              BlockSideLength, BlockSideLength);
+                bs.release(A(i, j), false);
+            }
+            for (size_t r = 0; r < BlockSideLength; ++r)
+                xi[r] -= z[r];
+
+            // substitute in the diagonal block
+            ValueType* ap = bs.acquire(A(i, i)).begin();
+            for (size_t u = 0; u < BlockSideLength; ++u)
+            {
+                const size_t r = upper ? BlockSideLength - 1 - u : u;
+                ValueType s = xi[r];
+                for (size_t k = (upper ? r + 1 : 0); k < (upper ? BlockSideLength : r); ++k)
+                    s -= block_element(ap, t, r, k) * xi[k];
+                const ValueType d = unit ? ValueType(1) : block_element(ap, t, r, r);
+                // the padding of x stays zero
+                xi[r] = (d == ValueType(0)) ? ValueType(0) : s / d;
+            }
+            bs.release(A(i, i), false);
+        }
+    }
+
+    // +-+ end factorization +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+
     // +-+-+-+ matrix-vector multiplication +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 
     //! calculates z = A * x
@@ -1995,6 +2844,101 @@ struct matrix_operations
         bs_a.release(a, false);
     }
 
+    //! calculates z = A * x, or z = x * A if from_left, in one scan over the
+    //! rows (columns if from_left) of blocks of A. For each row of blocks, the
+    //! slices of x are read with overlapped I/O, and the slice of z is
+    //! accumulated in internal memory and then written once, so neither
+    //! vector has to fit into internal memory. The blocks are acquired in the
+    //! order of the scan, which an offline scheduling algorithm prefetches.
+    template <typename InputVector, typename OutputVector>
+    static OutputVector&
+    streaming_matrix_vector_multiply(const swappable_block_matrix_type& A, const bool from_left,
+                                     const InputVector& x, OutputVector& z)
+    {
+        block_scheduler_type& bs = A.bs;
+        const size_type num_strips = from_left ? A.get_width() : A.get_height(),
+            strip_length = from_left ? A.get_height() : A.get_width();
+
+        if (bs.is_simulating())
+        {
+            // only the block accesses are recorded
+            for (size_type strip = 0; strip < num_strips; ++strip)
+                for (size_type i = 0; i < strip_length; ++i)
+                {
+                    const swappable_block_identifier_type& a = from_left ? A(i, strip) : A(strip, i);
+                    if (! bs.is_initialized(a))
+                        continue;
+                    bs.acquire(a);
+                    bs.release(a, false);
+                }
+            return z;
+        }
+
+        // the slices of x are transposed blocks if from_left
+        const bool col_major = (A.is_transposed() != from_left);
+        std::vector<ValueType> x_slice(BlockSideLength), z_slice(BlockSideLength);
+        typename OutputVector::bufwriter_type writer(z);
+        for (size_type strip = 0; strip < num_strips; ++strip)
+        {
+            const unsigned z_limit = unsigned(std::min<vector_size_type>(BlockSideLength, z.size() - strip * BlockSideLength));
+            std::fill(z_slice.begin(), z_slice.end(), ValueType(0));
+
+            typename InputVector::bufreader_type reader(x);
+            for (size_type i = 0; i < strip_length; ++i)
+            {
+                const unsigned x_limit = unsigned(std::min<vector_size_type>(BlockSideLength, x.size() - i * BlockSideLength));
+                for (unsigned k = 0; k < x_limit; ++k, ++reader)
+                    x_slice[k] = *reader;
+
+                const swappable_block_identifier_type& a = from_left ? A(i, strip) : A(strip, i);
+                if (! bs.is_initialized(a))
+                    continue; // zero block
+                block_vector_multiply_and_add(bs.acquire(a), col_major, x_slice.data(), z_slice.data(), x_limit, z_limit);
+                bs.release(a, false);
+            }
+
+            for (unsigned k = 0; k < z_limit; ++k)
+                writer << z_slice[k];
+        }
+        writer.finish();
+        return z;
+    }
+
+    //! calculates z += M * x for a block M, in parallel over the rows of M
+    static void block_vector_multiply_and_add(const internal_block_type& m, const bool m_is_transposed,
+                                              const ValueType* x, ValueType* z,
+                                              const unsigned x_limit, const unsigned z_limit)
+    {
+        if (m_is_transposed)
+        {
+            // add up the columns, in ranges of rows for locality
+            const omp_int_type rows = 64;
+            #if STXXL_PARALLEL
+            #pragma omp parallel for
+            #endif
+            for (omp_int_type row_begin = 0; row_begin < omp_int_type(z_limit); row_begin += rows)
+            {
+                const unsigned row_end = unsigned(std::min(row_begin + rows, omp_int_type(z_limit)));
+                for (unsigned col = 0; col < x_limit; ++col)
+                    for (unsigned row = unsigned(row_begin); row < row_end; ++row)
+                        z[row] += m[row + col * BlockSideLength] * x[col];
+            }
+        }
+        else
+        {
+            #if STXXL_PARALLEL
+            #pragma omp parallel for
+            #endif
+            for (omp_int_type row = 0; row < omp_int_type(z_limit); ++row)
+            {
+                ValueType sum = z[row];
+                for (unsigned col = 0; col < x_limit; ++col)
+                    sum += m[row * BlockSideLength + col] * x[col];
+                z[row] = sum;
+            }
+        }
+    }
+
     // +-+ end matrix-vector multiplication +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 
     // +-+-+-+ vector-vector multiplication +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
@@ -2061,10 +3005,180 @@ struct matrix_operations
 
 // Adjust choose_level_for_feedable_sw, too!
 template <typename ValueType, unsigned BlockSideLength>
-const unsigned matrix_operations<ValueType, BlockSideLength>::strassen_winograd_base_case_size = 3;
+unsigned matrix_operations<ValueType, BlockSideLength>::strassen_winograd_base_case_size = 3;
 
 } // namespace matrix_local
 
+//! \addtogroup matrix
+//! \{
+
+//! Multiplication algorithm and Strassen-Winograd base case chosen by
+//! matrix_multiply_calibration::choose().
+struct matrix_multiply_choice
+{
+    //! algorithm number of matrix::multiply()
+    int multiplication_algorithm;
+    //! strassen_winograd_base_case_size in blocks
+    unsigned strassen_winograd_base_case_size;
+    //! levels of Strassen-Winograd recursion, 0 for algorithm 1
+    unsigned strassen_winograd_levels;
+    //! estimated seconds of the multiplication
+    double estimated_time;
+};
+
+/*!
+ * Measured costs of the block operations of matrix multiplications, and a
+ * cost model choosing the multiplication algorithm for a shape from them.
+ *
+ * get() measures once per process and ValueType, BlockSideLength: the time
+ * of the block multiplication and addition kernels in internal memory, and
+ * of writing and reading blocks through the block manager. choose() then
+ * compares recursive multiplication (algorithm 1) with Strassen-Winograd
+ * (algorithm 4) for all base cases. The model assumes that the offline
+ * scheduling overlaps the I/Os with the block operations, and that the
+ * recursion needs 3 * side^2 / memory block I/Os per block multiplication
+ * once the operands do not fit into memory.
+ */
+template <typename ValueType, unsigned BlockSideLength>
+struct matrix_multiply_calibration
+{
+    //! seconds of one block multiplication-and-addition and of one block addition
+    double block_multiplication_time, block_addition_time;
+    //! seconds per block written or read
+    double block_io_time;
+
+    //! number of timed block operations and block I/Os of measure()
+    static constexpr unsigned calibration_repetitions = 8;
+
+    //! The calibration of this process, measured at the first call.
+    static const matrix_multiply_calibration& get()
+    {
+        static const matrix_multiply_calibration calibration = measure();
+        return calibration;
+    }
+
+    //! Times the block kernels and the block I/Os.
+    static matrix_multiply_calibration measure()
+    {
+        using Ops = matrix_local::matrix_operations<ValueType, BlockSideLength>;
+        using block_type = foxxll::typed_block<sizeof(ValueType) * BlockSideLength * BlockSideLength, ValueType>;
+        using bid_type = typename block_type::bid_type;
+
+        matrix_multiply_calibration calibration;
+
+        block_type* blocks = new block_type[calibration_repetitions];
+        for (unsigned i = 0; i < calibration_repetitions; ++i)
+            std::fill(blocks[i].begin(), blocks[i].end(), ValueType(1));
+
+        double begin = foxxll::timestamp();
+        for (unsigned i = 0; i < calibration_repetitions; ++i)
+            matrix_local::low_level_matrix_multiply_and_add<ValueType, BlockSideLength>(
+                blocks[0].begin(), false, blocks[1].begin(), false, blocks[2 + i % 2].begin(), false);
+        calibration.block_multiplication_time = (foxxll::timestamp() - begin) / calibration_repetitions;
+
+        begin = foxxll::timestamp();
+        for (unsigned i = 0; i < calibration_repetitions; ++i)
+            matrix_local::low_level_matrix_unary_ass_op<ValueType, BlockSideLength, false, typename Ops::addition>(
+                blocks[2 + i % 2].begin(), blocks[0].begin());
+        calibration.block_addition_time = (foxxll::timestamp() - begin) / calibration_repetitions;
+
+        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+        std::vector<bid_type> bids(calibration_repetitions);
+        std::vector<foxxll::request_ptr> requests(calibration_repetitions);
+        bm->new_blocks(foxxll::default_alloc_strategy(), bids.begin(), bids.end());
+        begin = foxxll::timestamp();
+        for (unsigned i = 0; i < calibration_repetitions; ++i)
+            requests[i] = blocks[i].write(bids[i]);
+        foxxll::wait_all(requests.begin(), requests.end());
+        for (unsigned i = 0; i < calibration_repetitions; ++i)
+            requests[i] = blocks[i].read(bids[i]);
+        foxxll::wait_all(requests.begin(), requests.end());
+        calibration.block_io_time = (foxxll::timestamp() - begin) / (2 * calibration_repetitions);
+        bm->delete_blocks(bids.begin(), bids.end());
+        delete[] blocks;
+
+        return calibration;
+    }
+
+    //! estimated seconds of recursive_multiply_and_add of a n x l and a
+    //! l x m matrix of blocks with memory_blocks blocks of internal memory
+    double recursive_time(const double n, const double m, const double l, const double memory_blocks) const
+    {
+        const double compute = n * m * l * block_multiplication_time;
+        double ios = n * l + l * m + n * m;
+        if (ios > memory_blocks)
+        {
+            // recursion down to submatrices with three times side^2 <= memory
+            const double side = std::max(1.0, std::sqrt(memory_blocks / 3));
+            ios = 3 * n * m * l / side + n * m;
+        }
+        return std::max(compute, ios * block_io_time);
+    }
+
+    //! estimated seconds of strassen_winograd_multiply with the base case
+    double strassen_winograd_time(double n, double m, double l, const double memory_blocks,
+                                  const unsigned base_case, unsigned& levels) const
+    {
+        levels = 0;
+        double factor = 1, time = 0;
+        for ( ; n > base_case && m > base_case && l > base_case; ++levels)
+        {
+            const double n2 = std::ceil(n / 2), m2 = std::ceil(m / 2), l2 = std::ceil(l / 2);
+            // 8 preadditions of quarters of A and B, 7 postadditions of C
+            const double additions = 4 * n2 * l2 + 4 * l2 * m2 + 7 * n2 * m2;
+            const double working_set = n * l + l * m + n * m + additions;
+            const double ios = (working_set > memory_blocks) ? 3 * additions : 0;
+            time += factor * std::max(additions * block_addition_time, ios * block_io_time);
+            factor *= 7;
+            n = n2, m = m2, l = l2;
+        }
+        return time + factor * recursive_time(n, m, l, memory_blocks);
+    }
+
+    //! Choose the algorithm and base case for a n x l times l x m matrix of
+    //! blocks, with internal_memory bytes for the block scheduler.
+    matrix_multiply_choice choose(const size_t n, const size_t m, const size_t l,
+                                  const size_t internal_memory) const
+    {
+        const double memory_blocks = static_cast<double>(internal_memory)
+                                     / (sizeof(ValueType) * BlockSideLength * BlockSideLength);
+
+        matrix_multiply_choice best;
+        best.multiplication_algorithm = 1;
+        best.strassen_winograd_base_case_size =
+            matrix_local::matrix_operations<ValueType, BlockSideLength>::strassen_winograd_base_case_size;
+        best.strassen_winograd_levels = 0;
+        best.estimated_time = recursive_time(double(n), double(m), double(l), memory_blocks);
+
+        // base cases 1, 2, 3, 4, 6, 8, 12, ... below the smallest side
+        const size_t min_side = std::min(n, std::min(m, l));
+        std::vector<unsigned> base_cases;
+        for (size_t power = 1; power < min_side; power *= 2)
+        {
+            base_cases.push_back(static_cast<unsigned>(power));
+            if (power >= 2 && power + power / 2 < min_side)
+                base_cases.push_back(static_cast<unsigned>(power + power / 2));
+        }
+
+        for (const unsigned base_case : base_cases)
+        {
+            unsigned levels;
+            const double time = strassen_winograd_time(
+                double(n), double(m), double(l), memory_blocks, base_case, levels);
+            if (levels > 0 && time < best.estimated_time)
+            {
+                best.multiplication_algorithm = 4;
+                best.strassen_winograd_base_case_size = base_case;
+                best.strassen_winograd_levels = levels;
+                best.estimated_time = time;
+            }
+        }
+        return best;
+    }
+};
+
+//! \}
+
 } // namespace stxxl
 
 #endif // !STXXL_CONTAINERS_MATRIX_ARITHMETIC_HEADER
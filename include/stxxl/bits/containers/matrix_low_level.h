@@ -17,11 +17,21 @@
 #define STXXL_BLAS 0
 #endif
 
+//! bytes of the three tiles of a, b and c of the generic block multiplication,
+//! about the size of the L2 cache
+#ifndef STXXL_MATRIX_KERNEL_TILE_BYTES
+#define STXXL_MATRIX_KERNEL_TILE_BYTES (96 * 1024)
+#endif
+
 #include <algorithm>
 #include <complex>
+#include <limits>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <foxxll/common/types.hpp>
+#include <stxxl/bits/common/float16.h>
 #include <stxxl/bits/parallel.h>
 #include <stxxl/types>
 
@@ -140,71 +150,238 @@ struct low_level_matrix_unary_op
     }
 };
 
+//! The type in which the generic block multiplication computes for entries
+//! stored as ValueType. Specialize it for storage types of lower precision,
+//! whose blocks are then converted tile by tile.
+template <typename ValueType>
+struct matrix_compute_type
+{
+    using type = ValueType;
+};
+
+//! float16 entries are multiplied in float
+template <>
+struct matrix_compute_type<float16>
+{
+    using type = float;
+};
+
+//! bfloat16 entries are multiplied in float
+template <>
+struct matrix_compute_type<bfloat16>
+{
+    using type = float;
+};
+
+//! The semiring of the usual addition and multiplication, which is used by
+//! the matrix operations.
+template <typename ValueType>
+struct plus_times_semiring
+{
+    static ValueType zero() { return ValueType(0); }
+    static ValueType add(const ValueType& x, const ValueType& y) { return x + y; }
+    static ValueType multiply(const ValueType& x, const ValueType& y) { return x * y; }
+};
+
+//! The tropical semiring with minimum as addition and addition as
+//! multiplication, e.g. for shortest paths. For integer entries zero() is
+//! max() / 2, so that the product of two zeros does not overflow.
+template <typename ValueType>
+struct min_plus_semiring
+{
+    static ValueType zero()
+    {
+        return std::numeric_limits<ValueType>::has_infinity
+               ? std::numeric_limits<ValueType>::infinity()
+               : std::numeric_limits<ValueType>::max() / 2;
+    }
+    static ValueType add(const ValueType& x, const ValueType& y) { return y < x ? y : x; }
+    static ValueType multiply(const ValueType& x, const ValueType& y) { return x + y; }
+};
+
+//! Side length of the tiles of the generic multiplication kernel: the largest
+//! power of two up to block_side_length such that three tiles of ValueType fit
+//! into STXXL_MATRIX_KERNEL_TILE_BYTES.
+template <typename ValueType>
+constexpr size_t low_level_matrix_tile_side(size_t block_side_length)
+{
+    size_t tile = 1;
+    while (2 * tile <= block_side_length &&
+           3 * (2 * tile) * (2 * tile) * sizeof(ValueType) <= STXXL_MATRIX_KERNEL_TILE_BYTES)
+        tile *= 2;
+    return tile;
+}
+
 //! multiplies matrices A and B, adds result to C, for arbitrary entries
 //! param pointer to blocks of A,B,C; elements in blocks have to be in row-major
+//!
+//! The product is computed over the Semiring, tile by tile of
+//! low_level_matrix_tile_side() rows and columns, such that the tiles stay in
+//! cache. The innermost loop runs along a row of C and a row of B, tiles of a
+//! column-major B are first copied into a row-major buffer, so that the loop
+//! can be vectorized for any Semiring.
+//!
+//! If matrix_compute_type<ValueType> differs from ValueType, the tiles of A, B
+//! and C are converted to it, and each tile of C is accumulated over the whole
+//! row of A and column of B before it is rounded back to ValueType.
 /* designated usage as:
  * void
  * low_level_matrix_multiply_and_add(const double * a, bool a_in_col_major,
                                      const double * b, bool b_in_col_major,
                                      double * c, const bool c_in_col_major)  */
-template <typename ValueType, unsigned BlockSideLength>
+template <typename ValueType, unsigned BlockSideLength,
+          class Semiring = plus_times_semiring<typename matrix_compute_type<ValueType>::type> >
 struct low_level_matrix_multiply_and_add
 {
+    using compute_type = typename matrix_compute_type<ValueType>::type;
+    using converting = std::integral_constant<bool, ! std::is_same<compute_type, ValueType>::value>;
+
+    static constexpr size_t tile = low_level_matrix_tile_side<compute_type>(BlockSideLength);
+    static constexpr size_t num_tiles = (BlockSideLength + tile - 1) / tile;
+
     low_level_matrix_multiply_and_add(const ValueType* a, bool a_in_col_major,
                                       const ValueType* b, bool b_in_col_major,
                                       ValueType* c, const bool c_in_col_major)
     {
         if (c_in_col_major)
+            // calculate c^T += b^T * a^T, which swaps the factors of each product
+            multiply_and_add<true>(b, ! b_in_col_major, a, ! a_in_col_major, c, converting());
+        else
+            multiply_and_add<false>(a, a_in_col_major, b, b_in_col_major, c, converting());
+    }
+
+private:
+    //! c += a * b with c in row-major; multiplies b-entry by a-entry if swapped
+    template <bool swapped>
+    static void multiply_and_add(const ValueType* a, const bool a_in_col_major,
+                                 const ValueType* b, const bool b_in_col_major,
+                                 ValueType* c, std::false_type /* converting */)
+    {
+        #if STXXL_PARALLEL
+        #pragma omp parallel
+        #endif
         {
-            std::swap(a, b);
-            bool a_cm = ! b_in_col_major;
-            b_in_col_major = ! a_in_col_major;
-            a_in_col_major = a_cm;
-        }
-        if (! a_in_col_major)
-        {
-            if (! b_in_col_major)
-            {                                                            // => both row-major
-                #if STXXL_PARALLEL
-                #pragma omp parallel for
-                #endif
-                for (omp_int_type i = 0; i < omp_int_type(BlockSideLength); ++i) //OpenMP does not like unsigned iteration variables
-                    for (size_t k = 0; k < BlockSideLength; ++k)
-                        for (size_t j = 0; j < BlockSideLength; ++j)
-                            c[i * BlockSideLength + j] += a[i * BlockSideLength + k] * b[k * BlockSideLength + j];
-            }
-            else
-            {                                                            // => a row-major, b col-major
-                #if STXXL_PARALLEL
-                #pragma omp parallel for
-                #endif
-                for (omp_int_type i = 0; i < omp_int_type(BlockSideLength); ++i) //OpenMP does not like unsigned iteration variables
-                    for (size_t j = 0; j < BlockSideLength; ++j)
-                        for (size_t k = 0; k < BlockSideLength; ++k)
-                            c[i * BlockSideLength + j] += a[i * BlockSideLength + k] * b[k + j * BlockSideLength];
+            // row-major copy of the current tile of b, if b is in col-major
+            std::vector<ValueType> b_tile(b_in_col_major ? tile * tile : 0);
+
+            #if STXXL_PARALLEL
+            #pragma omp for
+            #endif
+            for (omp_int_type ti = 0; ti < omp_int_type(num_tiles); ++ti) //OpenMP does not like unsigned iteration variables
+            {
+                const size_t i_begin = ti * tile, i_end = std::min(i_begin + tile, size_t(BlockSideLength));
+                for (size_t k_begin = 0; k_begin < BlockSideLength; k_begin += tile)
+                {
+                    const size_t k_end = std::min(k_begin + tile, size_t(BlockSideLength));
+                    for (size_t j_begin = 0; j_begin < BlockSideLength; j_begin += tile)
+                    {
+                        const size_t j_end = std::min(j_begin + tile, size_t(BlockSideLength));
+                        const size_t width = j_end - j_begin;
+
+                        // b_rows[(k - k_begin) * b_stride + (j - j_begin)] is b_kj
+                        const ValueType* b_rows;
+                        size_t b_stride;
+                        if (b_in_col_major)
+                        {
+                            for (size_t j = j_begin; j < j_end; ++j)
+                                for (size_t k = k_begin; k < k_end; ++k)
+                                    b_tile[(k - k_begin) * tile + (j - j_begin)] = b[k + j * BlockSideLength];
+                            b_rows = b_tile.data();
+                            b_stride = tile;
+                        }
+                        else
+                        {
+                            b_rows = b + k_begin * BlockSideLength + j_begin;
+                            b_stride = BlockSideLength;
+                        }
+
+                        for (size_t i = i_begin; i < i_end; ++i)
+                        {
+                            ValueType* c_row = c + i * BlockSideLength + j_begin;
+                            for (size_t k = k_begin; k < k_end; ++k)
+                            {
+                                const ValueType a_ik = a_in_col_major
+                                                       ? a[i + k * BlockSideLength]
+                                                       : a[i * BlockSideLength + k];
+                                const ValueType* b_row = b_rows + (k - k_begin) * b_stride;
+                                #if STXXL_PARALLEL && _OPENMP >= 201307
+                                #pragma omp simd
+                                #endif
+                                for (size_t j = 0; j < width; ++j)
+                                    c_row[j] = Semiring::add(
+                                        c_row[j], swapped ? Semiring::multiply(b_row[j], a_ik)
+                                        : Semiring::multiply(a_ik, b_row[j]));
+                            }
+                        }
+                    }
+                }
             }
         }
-        else
+    }
+
+    //! as above, in tiles converted to compute_type
+    template <bool swapped>
+    static void multiply_and_add(const ValueType* a, const bool a_in_col_major,
+                                 const ValueType* b, const bool b_in_col_major,
+                                 ValueType* c, std::true_type /* converting */)
+    {
+        #if STXXL_PARALLEL
+        #pragma omp parallel
+        #endif
         {
-            if (! b_in_col_major)
-            {                                                            // => a col-major, b row-major
-                #if STXXL_PARALLEL
-                #pragma omp parallel for
-                #endif
-                for (omp_int_type i = 0; i < omp_int_type(BlockSideLength); ++i) //OpenMP does not like unsigned iteration variables
-                    for (size_t k = 0; k < BlockSideLength; ++k)
-                        for (size_t j = 0; j < BlockSideLength; ++j)
-                            c[i * BlockSideLength + j] += a[i + k * BlockSideLength] * b[k * BlockSideLength + j];
-            }
-            else
-            {                                                            // => both col-major
-                #if STXXL_PARALLEL
-                #pragma omp parallel for
-                #endif
-                for (omp_int_type i = 0; i < omp_int_type(BlockSideLength); ++i) //OpenMP does not like unsigned iteration variables
-                    for (size_t k = 0; k < BlockSideLength; ++k)
-                        for (size_t j = 0; j < BlockSideLength; ++j)
-                            c[i * BlockSideLength + j] += a[i + k * BlockSideLength] * b[k + j * BlockSideLength];
+            // row-major tiles of a, b and c in compute_type
+            std::vector<compute_type> a_tile(tile * tile), b_tile(tile * tile), c_tile(tile * tile);
+
+            #if STXXL_PARALLEL
+            #pragma omp for
+            #endif
+            for (omp_int_type ti = 0; ti < omp_int_type(num_tiles); ++ti) //OpenMP does not like unsigned iteration variables
+            {
+                const size_t i_begin = ti * tile, i_end = std::min(i_begin + tile, size_t(BlockSideLength));
+                for (size_t j_begin = 0; j_begin < BlockSideLength; j_begin += tile)
+                {
+                    const size_t j_end = std::min(j_begin + tile, size_t(BlockSideLength));
+                    const size_t width = j_end - j_begin;
+
+                    for (size_t i = i_begin; i < i_end; ++i)
+                        for (size_t j = j_begin; j < j_end; ++j)
+                            c_tile[(i - i_begin) * tile + (j - j_begin)] = compute_type(c[i * BlockSideLength + j]);
+
+                    for (size_t k_begin = 0; k_begin < BlockSideLength; k_begin += tile)
+                    {
+                        const size_t k_end = std::min(k_begin + tile, size_t(BlockSideLength));
+
+                        for (size_t i = i_begin; i < i_end; ++i)
+                            for (size_t k = k_begin; k < k_end; ++k)
+                                a_tile[(i - i_begin) * tile + (k - k_begin)] = compute_type(
+                                    a_in_col_major ? a[i + k * BlockSideLength] : a[i * BlockSideLength + k]);
+                        for (size_t k = k_begin; k < k_end; ++k)
+                            for (size_t j = j_begin; j < j_end; ++j)
+                                b_tile[(k - k_begin) * tile + (j - j_begin)] = compute_type(
+                                    b_in_col_major ? b[k + j * BlockSideLength] : b[k * BlockSideLength + j]);
+
+                        for (size_t i = 0; i < i_end - i_begin; ++i)
+                        {
+                            compute_type* c_row = c_tile.data() + i * tile;
+                            for (size_t k = 0; k < k_end - k_begin; ++k)
+                            {
+                                const compute_type a_ik = a_tile[i * tile + k];
+                                const compute_type* b_row = b_tile.data() + k * tile;
+                                #if STXXL_PARALLEL && _OPENMP >= 201307
+                                #pragma omp simd
+                                #endif
+                                for (size_t j = 0; j < width; ++j)
+                                    c_row[j] = Semiring::add(
+                                        c_row[j], swapped ? Semiring::multiply(b_row[j], a_ik)
+                                        : Semiring::multiply(a_ik, b_row[j]));
+                            }
+                        }
+                    }
+
+                    for (size_t i = i_begin; i < i_end; ++i)
+                        for (size_t j = j_begin; j < j_end; ++j)
+                            c[i * BlockSideLength + j] = ValueType(c_tile[(i - i_begin) * tile + (j - j_begin)]);
+                }
             }
         }
     }
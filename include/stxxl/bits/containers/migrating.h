@@ -0,0 +1,418 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/migrating.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_MIGRATING_HEADER
+#define STXXL_CONTAINERS_MIGRATING_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <tlx/define.hpp>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * A vector that keeps its elements in a std::vector until its size reaches
+ * CritSize, and then migrates to an external vector, e.g. a stxxl::vector, by
+ * appending all elements at once with ExtVector::append(). Small vectors hence
+ * never touch external memory. Like migrating_stack, the vector does not
+ * migrate back when it shrinks, except by clear().
+ *
+ * Elements are accessed by index, iterators and streams are available from
+ * the external vector returned by migrate().
+ */
+template <size_t CritSize, class ExtVector>
+class migrating_vector
+{
+public:
+    using ext_vector_type = ExtVector;
+    using value_type = typename ext_vector_type::value_type;
+    using size_type = typename ext_vector_type::size_type;
+    using int_vector_type = std::vector<value_type>;
+
+private:
+    enum { critical_size = CritSize };
+
+    int_vector_type m_int;
+    std::unique_ptr<ext_vector_type> m_ext;
+
+public:
+    migrating_vector() = default;
+
+    //! non-copyable: delete copy-constructor
+    migrating_vector(const migrating_vector&) = delete;
+    //! non-copyable: delete assignment operator
+    migrating_vector& operator = (const migrating_vector&) = delete;
+
+    void swap(migrating_vector& obj)
+    {
+        std::swap(m_int, obj.m_int);
+        std::swap(m_ext, obj.m_ext);
+    }
+
+    //! Returns true if the elements are in internal memory.
+    bool internal() const { return !m_ext; }
+    //! Returns true if the vector has migrated to external memory.
+    bool external() const { return !!m_ext; }
+
+    size_type size() const
+    {
+        return m_ext ? m_ext->size() : size_type(m_int.size());
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    //! Moves the elements to the external vector, with one bulk write, and
+    //! returns it.
+    ext_vector_type& migrate()
+    {
+        if (!m_ext)
+        {
+            m_ext.reset(new ext_vector_type());
+            m_ext->append(m_int.begin(), m_int.end());
+            int_vector_type().swap(m_int);
+        }
+        return *m_ext;
+    }
+
+    void push_back(const value_type& val)
+    {
+        if (m_ext)
+        {
+            m_ext->push_back(val);
+            return;
+        }
+
+        m_int.push_back(val);
+        if (TLX_UNLIKELY(m_int.size() >= critical_size))
+            migrate();
+    }
+
+    void pop_back()
+    {
+        assert(!empty());
+        if (m_ext)
+            m_ext->pop_back();
+        else
+            m_int.pop_back();
+    }
+
+    //! Resizes the vector, which migrates if n reaches CritSize.
+    void resize(size_type n)
+    {
+        if (!m_ext && n >= critical_size)
+            migrate();
+
+        if (m_ext)
+            m_ext->resize(n);
+        else
+            m_int.resize(static_cast<size_t>(n));
+    }
+
+    //! Removes all elements and returns to internal memory.
+    void clear()
+    {
+        m_ext.reset();
+        m_int.clear();
+    }
+
+    value_type& operator [] (size_type i)
+    {
+        assert(i < size());
+        return m_ext ? (*m_ext)[i] : m_int[static_cast<size_t>(i)];
+    }
+
+    const value_type& operator [] (size_type i) const
+    {
+        assert(i < size());
+        return m_ext ? static_cast<const ext_vector_type&>(*m_ext)[i]
+               : m_int[static_cast<size_t>(i)];
+    }
+
+    value_type & front() { return operator [] (0); }
+    const value_type & front() const { return operator [] (0); }
+
+    value_type & back() { return operator [] (size() - 1); }
+    const value_type & back() const { return operator [] (size() - 1); }
+};
+
+/*!
+ * A FIFO queue that keeps its elements in a std::deque until its size reaches
+ * CritSize, and then migrates to an external queue, e.g. a stxxl::queue, by
+ * pushing all elements at once with ExtQueue::push(first, last). Like
+ * migrating_stack, the queue does not migrate back.
+ */
+template <size_t CritSize, class ExtQueue>
+class migrating_queue
+{
+public:
+    using ext_queue_type = ExtQueue;
+    using value_type = typename ext_queue_type::value_type;
+    using size_type = typename ext_queue_type::size_type;
+    using int_queue_type = std::deque<value_type>;
+
+private:
+    enum { critical_size = CritSize };
+
+    int_queue_type m_int;
+    std::unique_ptr<ext_queue_type> m_ext;
+
+public:
+    migrating_queue() = default;
+
+    //! non-copyable: delete copy-constructor
+    migrating_queue(const migrating_queue&) = delete;
+    //! non-copyable: delete assignment operator
+    migrating_queue& operator = (const migrating_queue&) = delete;
+
+    void swap(migrating_queue& obj)
+    {
+        std::swap(m_int, obj.m_int);
+        std::swap(m_ext, obj.m_ext);
+    }
+
+    //! Returns true if the elements are in internal memory.
+    bool internal() const { return !m_ext; }
+    //! Returns true if the queue has migrated to external memory.
+    bool external() const { return !!m_ext; }
+
+    size_type size() const
+    {
+        return m_ext ? m_ext->size() : size_type(m_int.size());
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    //! Moves the elements to the external queue, with one bulk push, and
+    //! returns it.
+    ext_queue_type& migrate()
+    {
+        if (!m_ext)
+        {
+            m_ext.reset(new ext_queue_type());
+            m_ext->push(m_int.begin(), m_int.end());
+            int_queue_type().swap(m_int);
+        }
+        return *m_ext;
+    }
+
+    void push(const value_type& val)
+    {
+        if (m_ext)
+        {
+            m_ext->push(val);
+            return;
+        }
+
+        m_int.push_back(val);
+        if (TLX_UNLIKELY(m_int.size() >= critical_size))
+            migrate();
+    }
+
+    void pop()
+    {
+        assert(!empty());
+        if (m_ext)
+            m_ext->pop();
+        else
+            m_int.pop_front();
+    }
+
+    value_type & front()
+    {
+        assert(!empty());
+        return m_ext ? m_ext->front() : m_int.front();
+    }
+
+    const value_type & front() const
+    {
+        assert(!empty());
+        return m_ext ? static_cast<const ext_queue_type&>(*m_ext).front() : m_int.front();
+    }
+
+    value_type & back()
+    {
+        assert(!empty());
+        return m_ext ? m_ext->back() : m_int.back();
+    }
+
+    const value_type & back() const
+    {
+        assert(!empty());
+        return m_ext ? static_cast<const ext_queue_type&>(*m_ext).back() : m_int.back();
+    }
+};
+
+/*!
+ * A sorter that collects its items in a std::vector until their number
+ * reaches CritSize, and then migrates to an external sorter, e.g. a
+ * stxxl::sorter, by pushing all items into it. Below the threshold, sort()
+ * sorts the items in internal memory with std::sort, and the external sorter
+ * and its buffers of memory_to_use bytes are never allocated.
+ *
+ * The interface is the one of stxxl::sorter: push() items in the input state,
+ * then sort() and read the items with the stream interface.
+ */
+template <size_t CritSize, class ExtSorter>
+class migrating_sorter
+{
+public:
+    using ext_sorter_type = ExtSorter;
+    using value_type = typename ext_sorter_type::value_type;
+    using cmp_type = typename ext_sorter_type::cmp_type;
+    using size_type = typename ext_sorter_type::size_type;
+
+private:
+    enum { critical_size = CritSize };
+
+    cmp_type m_cmp;
+    size_t m_memory_to_use;
+
+    //! items in internal memory
+    std::vector<value_type> m_int;
+    //! next item in the output state in internal memory
+    size_t m_pos;
+    bool m_output;
+
+    std::unique_ptr<ext_sorter_type> m_ext;
+
+public:
+    //! Constructor, the external sorter will allocate memory_to_use bytes.
+    migrating_sorter(const cmp_type& cmp, size_t memory_to_use)
+        : m_cmp(cmp), m_memory_to_use(memory_to_use),
+          m_pos(0), m_output(false)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    migrating_sorter(const migrating_sorter&) = delete;
+    //! non-copyable: delete assignment operator
+    migrating_sorter& operator = (const migrating_sorter&) = delete;
+
+    //! Returns true if the items are in internal memory.
+    bool internal() const { return !m_ext; }
+    //! Returns true if the sorter has migrated to external memory.
+    bool external() const { return !!m_ext; }
+
+    //! Moves the items to the external sorter and returns it. Only callable
+    //! during the input state.
+    ext_sorter_type& migrate()
+    {
+        assert(!m_output);
+        if (!m_ext)
+        {
+            m_ext.reset(new ext_sorter_type(m_cmp, m_memory_to_use));
+            for (const value_type& val : m_int)
+                m_ext->push(val);
+            std::vector<value_type>().swap(m_int);
+        }
+        return *m_ext;
+    }
+
+    //! Remove all items and return to the internal input state.
+    void clear()
+    {
+        m_ext.reset();
+        m_int.clear();
+        m_pos = 0;
+        m_output = false;
+    }
+
+    //! Push another item (only callable during input state).
+    void push(const value_type& val)
+    {
+        assert(!m_output);
+        if (m_ext)
+        {
+            m_ext->push(val);
+            return;
+        }
+
+        m_int.push_back(val);
+        if (TLX_UNLIKELY(m_int.size() >= critical_size))
+            migrate();
+    }
+
+    //! Switch to output state, rewind() in case the output was already sorted.
+    void sort()
+    {
+        if (m_ext)
+            m_ext->sort();
+        else if (!m_output)
+            std::sort(m_int.begin(), m_int.end(), m_cmp);
+        m_pos = 0;
+        m_output = true;
+    }
+
+    //! Rewind output stream to beginning.
+    void rewind()
+    {
+        assert(m_output);
+        if (m_ext)
+            m_ext->rewind();
+        m_pos = 0;
+    }
+
+    //! Number of items pushed or items remaining to be read.
+    size_type size() const
+    {
+        if (m_ext)
+            return m_ext->size();
+        return size_type(m_int.size() - m_pos);
+    }
+
+    //! Standard stream method
+    bool empty() const
+    {
+        assert(m_output);
+        return m_ext ? m_ext->empty() : (m_pos == m_int.size());
+    }
+
+    //! Standard stream method
+    const value_type& operator * () const
+    {
+        assert(m_output && !empty());
+        return m_ext ? **m_ext : m_int[m_pos];
+    }
+
+    //! Standard stream method
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method (preincrement operator)
+    migrating_sorter& operator ++ ()
+    {
+        assert(m_output && !empty());
+        if (m_ext)
+            ++*m_ext;
+        else
+            ++m_pos;
+        return *this;
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_MIGRATING_HEADER
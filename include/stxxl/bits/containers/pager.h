@@ -16,9 +16,12 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <list>
 #include <random>
 #include <utility>
+#include <vector>
 
 #include <tlx/simple_vector.hpp>
 #include <tlx/unused.hpp>
@@ -28,7 +31,8 @@ namespace stxxl {
 //! \addtogroup stlcont_vector
 //! \{
 
-//! Pager with \b random replacement strategy
+//! Pager with \b random replacement strategy. The victim drawn by kick() is
+//! kept until it is hit, so that it can be inspected in advance.
 template <unsigned npages_>
 class random_pager
 {
@@ -37,22 +41,27 @@ class random_pager
     size_type num_pages;
     std::minstd_rand randgen;
     std::uniform_int_distribution<size_type> distr;
+    //! victim drawn by kick(), or num_pages if none
+    size_type victim;
 
 public:
     static constexpr unsigned default_npages = npages_;
 
     explicit random_pager(size_type num_pages = default_npages)
-        : num_pages(num_pages), distr(0, num_pages - 1) { }
+        : num_pages(num_pages), distr(0, num_pages - 1), victim(num_pages) { }
 
     size_type kick()
     {
-        return distr(randgen);
+        if (victim == num_pages)
+            victim = distr(randgen);
+        return victim;
     }
 
-    void hit(size_type ipage) const
+    void hit(size_type ipage)
     {
         assert(ipage < size());
-        tlx::unused(ipage);
+        if (ipage == victim)
+            victim = num_pages;
     }
 
     size_type size() const
@@ -109,6 +118,326 @@ public:
     }
 };
 
+//! Pager with \b CLOCK replacement strategy, an approximation of LRU whose
+//! hit() only sets a reference bit.
+template <unsigned npages_ = 0>
+class clock_pager
+{
+    using size_type = size_t;
+
+    //! reference bit of each page
+    std::vector<uint8_t> referenced;
+    size_type hand;
+
+public:
+    static constexpr unsigned default_npages = npages_;
+
+    explicit clock_pager(size_type num_pages = default_npages)
+        : referenced(num_pages, 0), hand(0) { }
+
+    //! Advance the hand to the next page which was not referenced since the
+    //! hand passed it, clearing the reference bits on the way.
+    size_type kick()
+    {
+        while (referenced[hand])
+        {
+            referenced[hand] = 0;
+            if (++hand == size())
+                hand = 0;
+        }
+        return hand;
+    }
+
+    void hit(size_type ipage)
+    {
+        assert(ipage < size());
+        referenced[ipage] = 1;
+    }
+
+    size_type size() const
+    {
+        return referenced.size();
+    }
+};
+
+/*!
+ * Pager with the scan resistant \b 2Q replacement strategy of Johnson and
+ * Shasha.
+ *
+ * Newly loaded pages enter a FIFO queue A1in of a quarter of the pages, hits
+ * in it are considered correlated references and ignored. Pages evicted from
+ * A1in are remembered in the queue A1out of the half as many page ids, without
+ * their data. Pages loaded again while remembered in A1out enter the main
+ * queue Am, which is managed by CLOCK. Hence a sequential scan only cycles
+ * through A1in and leaves the working set in Am in place.
+ *
+ * The pager needs the ids of the loaded pages, which it gets from load()
+ * instead of hit(), see pager_load(). All operations are allocation-free,
+ * hit() is O(1), load() is linear in the size of A1out.
+ */
+template <unsigned npages_ = 0>
+class two_queue_pager
+{
+    using size_type = size_t;
+
+    enum queue_type : uint8_t { none, a1in, am };
+
+    //! queue of each page
+    std::vector<uint8_t> queue;
+    //! id of the data in each page
+    std::vector<size_type> page_id;
+    //! intrusive doubly linked lists of the pages in A1in (FIFO) and Am
+    //! (circular, in CLOCK order)
+    std::vector<size_type> next, prev;
+    //! reference bit of each page in Am
+    std::vector<uint8_t> referenced;
+
+    size_type a1in_head, a1in_tail, a1in_size, a1in_max;
+    size_type am_hand, am_size;
+
+    //! ring buffer of the ids of the pages evicted from A1in
+    std::vector<size_type> a1out;
+    size_type a1out_pos, a1out_size;
+
+    static constexpr size_type nil = size_type(-1);
+
+    void unlink(size_type ipage)
+    {
+        if (queue[ipage] == a1in)
+        {
+            if (prev[ipage] == nil)
+                a1in_head = next[ipage];
+            else
+                next[prev[ipage]] = next[ipage];
+            if (next[ipage] == nil)
+                a1in_tail = prev[ipage];
+            else
+                prev[next[ipage]] = prev[ipage];
+            --a1in_size;
+        }
+        else if (queue[ipage] == am)
+        {
+            if (--am_size == 0)
+            {
+                am_hand = nil;
+            }
+            else
+            {
+                next[prev[ipage]] = next[ipage];
+                prev[next[ipage]] = prev[ipage];
+                if (am_hand == ipage)
+                    am_hand = next[ipage];
+            }
+        }
+        queue[ipage] = none;
+    }
+
+    void push_a1in(size_type ipage)
+    {
+        prev[ipage] = a1in_tail;
+        next[ipage] = nil;
+        if (a1in_tail == nil)
+            a1in_head = ipage;
+        else
+            next[a1in_tail] = ipage;
+        a1in_tail = ipage;
+        ++a1in_size;
+        queue[ipage] = a1in;
+    }
+
+    //! insert into Am behind the hand, such that it is examined last
+    void push_am(size_type ipage)
+    {
+        if (am_hand == nil)
+        {
+            next[ipage] = prev[ipage] = ipage;
+            am_hand = ipage;
+        }
+        else
+        {
+            next[ipage] = am_hand;
+            prev[ipage] = prev[am_hand];
+            next[prev[am_hand]] = ipage;
+            prev[am_hand] = ipage;
+        }
+        referenced[ipage] = 0;
+        ++am_size;
+        queue[ipage] = am;
+    }
+
+    void remember(size_type id)
+    {
+        if (a1out.empty())
+            return;
+        a1out[a1out_pos] = id;
+        if (++a1out_pos == a1out.size())
+            a1out_pos = 0;
+        a1out_size = std::min(a1out_size + 1, a1out.size());
+    }
+
+    //! Remove id from A1out, returns whether it was remembered.
+    bool forget(size_type id)
+    {
+        for (size_type i = 0; i < a1out_size; ++i)
+        {
+            if (a1out[i] == id)
+            {
+                a1out[i] = nil;
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    static constexpr unsigned default_npages = npages_;
+
+    explicit two_queue_pager(size_type num_pages = default_npages)
+        : queue(num_pages, none),
+          page_id(num_pages, size_type(nil)),
+          next(num_pages, size_type(nil)), prev(num_pages, size_type(nil)),
+          referenced(num_pages, 0),
+          a1in_head(nil), a1in_tail(nil), a1in_size(0),
+          a1in_max(std::max<size_type>(1, num_pages / 4)),
+          am_hand(nil), am_size(0),
+          a1out(num_pages / 2), a1out_pos(0), a1out_size(0)
+    { }
+
+    //! Returns the head of A1in if A1in exceeds its share of the pages or is
+    //! all there is, otherwise the next page of Am not referenced since the
+    //! CLOCK hand passed it. Pages never loaded are kicked first.
+    size_type kick()
+    {
+        if (a1in_size + am_size < size())
+        {
+            for (size_type i = 0; i < size(); ++i)
+            {
+                if (queue[i] == none)
+                    return i;
+            }
+        }
+        if (a1in_size > a1in_max || am_size == 0)
+            return a1in_head;
+
+        while (referenced[am_hand])
+        {
+            referenced[am_hand] = 0;
+            am_hand = next[am_hand];
+        }
+        return am_hand;
+    }
+
+    //! Record a reference to a page, ignored while it is in A1in.
+    void hit(size_type ipage)
+    {
+        assert(ipage < size());
+        referenced[ipage] = 1;
+    }
+
+    //! Record that a page must not be replaced now, e.g. since it is in use.
+    //! A page in A1in is moved to Am, as hits in A1in are ignored.
+    void retain(size_type ipage)
+    {
+        assert(ipage < size());
+        if (queue[ipage] == a1in)
+        {
+            unlink(ipage);
+            push_am(ipage);
+        }
+        referenced[ipage] = 1;
+    }
+
+    //! Record that the data with the given id is loaded into a page.
+    void load(size_type ipage, size_type id)
+    {
+        assert(ipage < size());
+        if (queue[ipage] == a1in)
+            remember(page_id[ipage]);
+        unlink(ipage);
+
+        page_id[ipage] = id;
+        if (forget(id))
+            push_am(ipage);
+        else
+            push_a1in(ipage);
+    }
+
+    size_type size() const
+    {
+        return queue.size();
+    }
+};
+
+namespace pager_local {
+
+template <typename Pager>
+auto load(Pager& pager, size_t ipage, size_t id, int)
+->decltype(pager.load(ipage, id), void())
+{
+    pager.load(ipage, id);
+}
+
+template <typename Pager>
+void load(Pager& pager, size_t ipage, size_t, long)
+{
+    pager.hit(ipage);
+}
+
+template <typename Pager>
+auto retain(Pager& pager, size_t ipage, int)
+->decltype(pager.retain(ipage), void())
+{
+    pager.retain(ipage);
+}
+
+template <typename Pager>
+void retain(Pager& pager, size_t ipage, long)
+{
+    pager.hit(ipage);
+}
+
+} // namespace pager_local
+
+//! Tell a pager that the data with the given id is loaded into page ipage:
+//! calls its load() if it has one, otherwise hit().
+template <typename Pager>
+void pager_load(Pager& pager, size_t ipage, size_t id)
+{
+    pager_local::load(pager, ipage, id, 0);
+}
+
+//! Tell a pager that the page kicked last must not be replaced now: calls its
+//! retain() if it has one, otherwise hit(), after which kick() returns
+//! another page.
+template <typename Pager>
+void pager_retain(Pager& pager, size_t ipage)
+{
+    pager_local::retain(pager, ipage, 0);
+}
+
+/*!
+ * Detects a constant stride in a sequence of page accesses, used to read ahead
+ * the pages of a sequential or strided scan.
+ */
+class stride_detector
+{
+    size_t last_page = 0;
+    ptrdiff_t last_stride = 0;
+
+public:
+    //! Record an access to a page. Returns the stride if it equals the one of
+    //! the previous access, otherwise zero.
+    ptrdiff_t access(size_t page)
+    {
+        const ptrdiff_t stride =
+            static_cast<ptrdiff_t>(page) - static_cast<ptrdiff_t>(last_page);
+        const bool confirmed = (stride == last_stride);
+        last_page = page;
+        last_stride = stride;
+        return confirmed ? stride : 0;
+    }
+};
+
 //! \}
 
 } // namespace stxxl
@@ -19,17 +19,24 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <functional>
 #include <limits>
 #include <list>
 #include <mutex>
 #include <numeric>
+#include <ostream>
 #include <random>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -38,21 +45,33 @@
 #include <tlx/logger/core.hpp>
 #include <tlx/string.hpp>
 
+#include <foxxll/common/aligned_alloc.hpp>
 #include <foxxll/common/timer.hpp>
 #include <foxxll/common/types.hpp>
+#include <foxxll/io/file.hpp>
 #include <foxxll/io/request_operations.hpp>
 #include <foxxll/mng/block_alloc_strategy.hpp>
 #include <foxxll/mng/block_manager.hpp>
 #include <foxxll/mng/buf_ostream.hpp>
+#include <foxxll/mng/config.hpp>
 #include <foxxll/mng/prefetch_pool.hpp>
 #include <foxxll/mng/read_write_pool.hpp>
 #include <foxxll/mng/typed_block.hpp>
 
+#include <stxxl/bits/common/alloc_strategy.h>
+#include <stxxl/bits/common/binary_buffer.h>
+#include <stxxl/bits/common/block_array.h>
 #include <stxxl/bits/common/custom_stats.h>
+#include <stxxl/bits/common/disk_space.h>
+#include <stxxl/bits/common/io_retry.h>
 #include <stxxl/bits/common/is_heap.h>
+#include <stxxl/bits/common/locked_memory.h>
+#include <stxxl/bits/common/memory_manager.h>
 #include <stxxl/bits/common/swap_vector.h>
+#include <stxxl/bits/common/trace.h>
 #include <stxxl/bits/common/winner_tree.h>
 #include <stxxl/bits/config.h>
+#include <stxxl/bits/containers/block_codec.h>
 #include <stxxl/bits/defines.h>
 #include <stxxl/bits/parallel.h>
 #include <stxxl/seed>
@@ -439,12 +458,20 @@ class external_array_writer;
  * STXXL_DEFAULT_BLOCK_SIZE(ValueType).
  *
  * \tparam AllocStrategy Allocation strategy for the external memory. Default =
- * foxxll::default_alloc_strategy.
+ * runtime_alloc_strategy, see SETTINGS::alloc_strategy.
+ *
+ * \tparam BlockCodec Codec encoding the blocks written to disk, see
+ * frame_of_reference_codec. Default = no_block_codec, the blocks are written
+ * plain. As in stxxl::vector, an encoded block occupies a prefix of its BID,
+ * which saves I/O volume but not disk space. Encoded blocks are written from
+ * a buffer of their own instead of through the write pool, and decoded into
+ * the prefetch block when their read is waited for.
  */
 template <
     class ValueType,
     size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
-    class AllocStrategy = foxxll::default_alloc_strategy
+    class AllocStrategy = runtime_alloc_strategy,
+    class BlockCodec = no_block_codec
     >
 class external_array
 {
@@ -452,7 +479,7 @@ public:
     using value_type = ValueType;
     using iterator = ppq_iterator<value_type>;
 
-    using self_type = external_array<value_type, BlockSize, AllocStrategy>;
+    using self_type = external_array<value_type, BlockSize, AllocStrategy, BlockCodec>;
     using block_type = foxxll::typed_block<BlockSize, value_type>;
     using pool_type = foxxll::read_write_pool<block_type>;
     using bid_vector = std::vector<foxxll::BID<BlockSize> >;
@@ -463,6 +490,11 @@ public:
     using minima_vector = std::vector<value_type>;
     using block_pointers_type = typename iterator::block_pointers_type;
     using writer_type = external_array_writer<self_type>;
+    using block_codec_type = BlockCodec;
+    using extent_vector = std::vector<uint32_t>;
+
+    //! whether the blocks are stored encoded by a block codec
+    static constexpr bool compressed = !std::is_same<BlockCodec, no_block_codec>::value;
 
     //! The number of elements fitting into one block
     enum {
@@ -525,6 +557,24 @@ protected:
     //! needed anymore.
     size_t m_old_unhinted_block;
 
+    //! If compressed: bytes of the encoded prefix of each block's BID, or
+    //! block_type::raw_size for blocks written plain.
+    extent_vector m_extents;
+
+    //! An encoded block being written from its own buffer.
+    struct pending_write
+    {
+        size_t block_index;
+        char* buffer;
+        request_ptr req;
+    };
+
+    //! If compressed: the encoded blocks being written.
+    std::vector<pending_write> m_pending_writes;
+
+    //! If compressed: buffer for encoding a block in the write phase.
+    char* m_encode_buffer;
+
     //! allow writer to access to all variables
     friend class external_array_writer<self_type>;
 
@@ -561,7 +611,9 @@ public:
           m_index(0),
           m_end_index(0),
           m_unhinted_block(0),
-          m_old_unhinted_block(0)
+          m_old_unhinted_block(0),
+          m_extents(compressed ? m_num_blocks : 0, uint32_t(block_type::raw_size)),
+          m_encode_buffer(nullptr)
     {
         assert(m_capacity > 0);
         // allocate blocks in EM.
@@ -569,6 +621,59 @@ public:
         bm->new_blocks(AllocStrategy(), m_bids.begin(), m_bids.end());
     }
 
+    /*!
+     * Constructs an external array in the read phase from blocks which have
+     * already been written, e.g. to a checkpoint file.
+     *
+     * \param size The total number of elements in the blocks.
+     *
+     * \param pool A pool (read_write_pool<block_type>) of read and write buffer blocks
+     *
+     * \param level Level index in the merge hierarchy
+     *
+     * \param bids The blocks holding the elements.
+     *
+     * \param minima The smallest element of each block.
+     *
+     * \param extents If compressed: the bytes of the encoded prefix of each
+     * block, see get_extent(). Empty if all blocks are stored plain.
+     */
+    external_array(const external_size_type size, pool_type* pool, const size_t level,
+                   bid_vector&& bids, minima_vector&& minima,
+                   extent_vector&& extents = extent_vector())
+        :   // constants
+          m_capacity(size),
+          m_num_blocks(static_cast<size_t>(foxxll::div_ceil(m_capacity, block_items))),
+          m_level(level),
+          m_pool(pool),
+
+          // vectors
+          m_bids(std::move(bids)),
+          m_blocks(m_num_blocks, nullptr),
+          m_block_pointers(m_num_blocks),
+          m_requests(m_num_blocks),
+          m_minima(std::move(minima)),
+
+          // state
+          m_write_phase(false),
+
+          // indices
+          m_size(size),
+          m_index(0),
+          m_end_index(0),
+          m_unhinted_block(0),
+          m_old_unhinted_block(0),
+          m_extents(std::move(extents)),
+          m_encode_buffer(nullptr)
+    {
+        assert(m_capacity > 0);
+        assert(m_bids.size() == m_num_blocks);
+        assert(m_minima.size() == m_num_blocks);
+        if (compressed && m_extents.empty())
+            m_extents.assign(m_num_blocks, uint32_t(block_type::raw_size));
+        assert(m_extents.size() == (compressed ? m_num_blocks : 0));
+    }
+
     //! Default constructor. Don't use this directy. Needed for regrowing in
     //! surrounding vector.
     external_array()
@@ -593,7 +698,8 @@ public:
           m_index(0),
           m_end_index(0),
           m_unhinted_block(0),
-          m_old_unhinted_block(0)
+          m_old_unhinted_block(0),
+          m_encode_buffer(nullptr)
     { }
 
     //! Swap external_array with another one.
@@ -623,6 +729,11 @@ public:
         swap(m_end_index, o.m_end_index);
         swap(m_unhinted_block, o.m_unhinted_block);
         swap(m_old_unhinted_block, o.m_old_unhinted_block);
+
+        // compression
+        swap(m_extents, o.m_extents);
+        swap(m_pending_writes, o.m_pending_writes);
+        swap(m_encode_buffer, o.m_encode_buffer);
     }
 
     //! Swap external_array with another one.
@@ -639,6 +750,9 @@ public:
     //! Destructor
     ~external_array()
     {
+        wait_writes();
+        free_encode_buffer();
+
         if (m_size == 0) return;
 
         // not all data has been read! this only happen when the PPQ is
@@ -668,7 +782,7 @@ public:
 
         // figure out first block that is still allocated in EM.
         bid_iterator i_begin = m_bids.begin() + block_index;
-        foxxll::block_manager::get_instance()->delete_blocks(i_begin, m_bids.end());
+        disk_space_reclaimer::get_instance().delete_blocks(i_begin, m_bids.end());
 
         // check that all is empty
         for (size_t i = block_index; i < end_block_index; ++i)
@@ -716,7 +830,8 @@ public:
                + num_blocks * sizeof(typename block_vector::value_type)
                + num_blocks * sizeof(typename block_pointers_type::value_type)
                + num_blocks * sizeof(typename request_vector::value_type)
-               + num_blocks * sizeof(typename minima_vector::value_type);
+               + num_blocks * sizeof(typename minima_vector::value_type)
+               + (compressed ? num_blocks * sizeof(typename extent_vector::value_type) : 0);
     }
 
     //! Return the amount of internal memory used by the EA.
@@ -750,6 +865,41 @@ public:
         return (m_index / block_items);
     }
 
+    //! Returns the index of the smallest element, i.e. the read position.
+    inline external_size_type get_index() const
+    {
+        return m_index;
+    }
+
+    //! Returns the BID of the block with the given index.
+    const typename bid_vector::value_type & get_bid(size_t block_index) const
+    {
+        assert(block_index < m_num_blocks);
+        return m_bids[block_index];
+    }
+
+    //! Returns the smallest element of the block with the given index.
+    const value_type & get_block_min(size_t block_index) const
+    {
+        assert(block_index < m_num_blocks);
+        return m_minima[block_index];
+    }
+
+    //! Returns the bytes of the encoded prefix of the BID of the block with
+    //! the given index, block_type::raw_size if it is stored plain.
+    size_t get_extent(size_t block_index) const
+    {
+        assert(block_index < m_num_blocks);
+        return compressed ? m_extents[block_index] : block_type::raw_size;
+    }
+
+    //! Waits until the encoded blocks being written are on disk.
+    void wait_writes()
+    {
+        while (!m_pending_writes.empty())
+            complete_write(m_pending_writes.size() - 1);
+    }
+
     //! Returns a random-access iterator to the begin of the data
     //! in internal memory.
     iterator begin() const
@@ -843,6 +993,9 @@ protected:
     void prepare_write(const size_t num_threads)
     {
         prepare_write_pool(*m_pool, num_threads);
+        if (compressed && !m_encode_buffer)
+            m_encode_buffer = static_cast<char*>(
+                foxxll::aligned_alloc<block_codec_alignment>(block_type::raw_size));
     }
 
     //! finish the writing phase after multiway_merge() filled the vector. this
@@ -853,6 +1006,8 @@ protected:
         for (size_t i = 0; i < m_num_blocks; ++i)
             assert(m_blocks[i] == nullptr);
 
+        free_encode_buffer();
+
         // compatibility to the block write interface
         m_size = m_capacity;
         m_index = 0;
@@ -899,13 +1054,144 @@ protected:
             // this re-reading is not necessary for full performance builds, so
             // we immediately wait for the I/O to be completed.
             m_blocks[block_index] = m_pool->steal();
-            request_ptr req = m_pool->read(m_blocks[block_index], m_bids[block_index]);
-            req->wait();
-            assert(req->poll());
+            request_ptr req = start_read(block_index);
+            wait_read(req, block_index);
             assert(m_blocks[block_index]);
         }
     }
 
+    //! Start reading block i into m_blocks[i], an encoded one only its
+    //! extent, after its write completed.
+    request_ptr start_read(size_t i)
+    {
+        if (!compressed || m_extents[i] == block_type::raw_size)
+            return m_pool->read(m_blocks[i], m_bids[i]);
+
+        for (size_t w = 0; w < m_pending_writes.size(); ++w)
+        {
+            if (m_pending_writes[w].block_index == i)
+            {
+                complete_write(w);
+                break;
+            }
+        }
+        return m_bids[i].storage->aread(m_blocks[i], m_bids[i].offset, m_extents[i]);
+    }
+
+    //! Wait for the read request req of block i, redoing the read if it
+    //! failed, see io_retry, and decode the block if it is encoded.
+    void wait_read(request_ptr& req, size_t i)
+    {
+        if (!compressed || m_extents[i] == block_type::raw_size)
+        {
+            io_retry::get_instance().wait(req, *m_blocks[i], m_bids[i], false);
+            return;
+        }
+
+        const size_t bytes = m_extents[i];
+        io_retry::get_instance().wait(req, m_bids[i].storage, m_blocks[i],
+                                      m_bids[i].offset, bytes, false);
+
+        // the encoding is read into the front of the block it decodes to
+        static thread_local std::vector<char> encoded;
+        encoded.resize(bytes);
+        memcpy(encoded.data(), static_cast<const void*>(m_blocks[i]), bytes);
+        decode_block(encoded.data(), bytes, i, is_compressed());
+    }
+
+    using is_compressed = std::integral_constant<bool, compressed>;
+
+    //! Encode block i of n elements into m_encode_buffer, see write_encoded().
+    size_t encode_block(size_t i, size_t n, size_t capacity, std::true_type)
+    {
+        return block_codec_type::encode(m_blocks[i]->begin(), n, m_encode_buffer, capacity);
+    }
+
+    size_t encode_block(size_t, size_t, size_t, std::false_type)
+    {
+        return 0;
+    }
+
+    //! Decode the bytes read of block i into m_blocks[i].
+    void decode_block(const char* encoded, size_t bytes, size_t i, std::true_type)
+    {
+        block_codec_type::decode(encoded, bytes, m_blocks[i]->begin(), block_size_of(i));
+    }
+
+    void decode_block(const char*, size_t, size_t, std::false_type) { }
+
+    //! Wait for the read request of block i, see above.
+    void wait_read(size_t i)
+    {
+        wait_read(m_requests[i], i);
+        assert(!m_requests[i] || m_requests[i]->poll());
+    }
+
+    //! Returns the number of elements in the block with the given index.
+    size_t block_size_of(size_t block_index) const
+    {
+        return static_cast<size_t>(std::min<external_size_type>(
+            block_items, m_capacity - block_index * static_cast<external_size_type>(block_items)));
+    }
+
+    //! Wait for the pending write w, redoing it if it failed, and free its
+    //! buffer.
+    void complete_write(size_t w)
+    {
+        pending_write& p = m_pending_writes[w];
+        const size_t i = p.block_index;
+        io_retry::get_instance().wait(p.req, m_bids[i].storage, p.buffer,
+                                      m_bids[i].offset, m_extents[i], true);
+        foxxll::aligned_dealloc<block_codec_alignment>(p.buffer);
+        p = m_pending_writes.back();
+        m_pending_writes.pop_back();
+    }
+
+    void free_encode_buffer()
+    {
+        if (m_encode_buffer)
+            foxxll::aligned_dealloc<block_codec_alignment>(m_encode_buffer);
+        m_encode_buffer = nullptr;
+    }
+
+    /*!
+     * Encode block i into m_encode_buffer and start writing the encoded
+     * bytes, rounded up to block_codec_alignment, from a buffer of their own
+     * to the beginning of the block's BID, returning the block to the write
+     * pool. Returns false if the block does not shrink by at least
+     * block_codec_alignment bytes, then it is to be written plain. Completed
+     * writes are collected, and at most two per disk are kept in flight.
+     */
+    bool write_encoded(size_t i, size_t n)
+    {
+        const size_t raw_size = block_type::raw_size;
+        if (raw_size <= block_codec_alignment)
+            return false;
+
+        size_t bytes = encode_block(i, n, raw_size - block_codec_alignment, is_compressed());
+        if (bytes == 0)
+            return false;
+        bytes = foxxll::div_ceil(bytes, block_codec_alignment) * block_codec_alignment;
+
+        for (size_t w = m_pending_writes.size(); w-- > 0; )
+        {
+            if (m_pending_writes[w].req->poll())
+                complete_write(w);
+        }
+        const size_t max_pending = 2 * foxxll::config::get_instance()->disks_number();
+        while (m_pending_writes.size() >= max_pending)
+            complete_write(0);
+
+        char* buffer = static_cast<char*>(foxxll::aligned_alloc<block_codec_alignment>(bytes));
+        memcpy(buffer, m_encode_buffer, bytes);
+        m_extents[i] = uint32_t(bytes);
+        m_pending_writes.push_back(pending_write {
+                                       i, buffer, m_bids[i].storage->awrite(buffer, m_bids[i].offset, bytes)
+                                   });
+        m_pool->add(m_blocks[i]);
+        return true;
+    }
+
     //! Called by the external_array_writer to write a block from m_blocks[] to
     //! disk. Prior to writing and releasing the memory, extra information is
     //! preserved.
@@ -916,8 +1202,7 @@ protected:
                m_blocks[block_index] != reinterpret_cast<block_type*>(1));
 
         // calculate minimum and maximum values
-        const size_t this_block_items =
-            std::min<size_t>(block_items, m_capacity - block_index * static_cast<external_size_type>(block_items));
+        const size_t this_block_items = block_size_of(block_index);
 
         TLX_LOG << "ea[" << this << "]: write_block index=" << block_index <<
             " this_block_items=" << this_block_items;
@@ -928,7 +1213,12 @@ protected:
         m_minima[block_index] = this_block[0];
 
         // write out block (in background)
-        m_pool->write(m_blocks[block_index], m_bids[block_index]);
+        if (!compressed || !write_encoded(block_index, this_block_items))
+        {
+            if (compressed)
+                m_extents[block_index] = uint32_t(block_type::raw_size);
+            m_pool->write(m_blocks[block_index], m_bids[block_index]);
+        }
 
         m_blocks[block_index] = nullptr;
     }
@@ -954,7 +1244,7 @@ public:
         // steal block from pool, but also perform read via pool, since this
         // checks the associated write_pool.
         m_blocks[i] = m_pool->steal_prefetch();
-        m_requests[i] = m_pool->read(m_blocks[i], m_bids[i]);
+        m_requests[i] = start_read(i);
     }
 
     //! Returns if there is data in EM, that's not already hinted
@@ -1034,7 +1324,7 @@ public:
             assert(m_pool->size_write() > 0);
             assert(m_blocks[i] == nullptr);
             m_blocks[i] = m_pool->steal_prefetch();
-            m_requests[i] = m_pool->read(m_blocks[i], m_bids[i]);
+            m_requests[i] = start_read(i);
         }
     }
 
@@ -1062,8 +1352,7 @@ public:
         assert(m_requests[i].valid());
 
         // wait for prefetched request to finish.
-        m_requests[i]->wait();
-        assert(m_requests[i]->poll());
+        wait_read(i);
         assert(m_blocks[i]);
 
         update_block_pointers(i);
@@ -1075,8 +1364,7 @@ public:
             TLX_LOG << "ea[" << this << "]: poll-ok for" <<
                 " block index=" << i <<
                 " end_index=" << m_end_index;
-            m_requests[i]->wait();
-            assert(m_requests[i]->poll());
+            wait_read(i);
             assert(m_blocks[i]);
 
             update_block_pointers(i);
@@ -1098,8 +1386,7 @@ public:
             TLX_LOG << "wait_all_hinted_blocks(): ea[" << this << "]: waiting for" <<
                 " block index=" << i <<
                 " end_index=" << m_end_index;
-            m_requests[i]->wait();
-            assert(m_requests[i]->poll());
+            wait_read(i);
             assert(m_blocks[i]);
             update_block_pointers(i);
             ++i;
@@ -1141,7 +1428,7 @@ public:
         bid_iterator i_begin = m_bids.begin() + block_index;
         bid_iterator i_end = m_bids.begin() + block_index_after;
         assert(i_begin <= i_end);
-        foxxll::block_manager::get_instance()->delete_blocks(i_begin, i_end);
+        disk_space_reclaimer::get_instance().delete_blocks(i_begin, i_end);
 
         for (size_t i = block_index; i < block_index_after; ++i) {
             assert(block_valid(i));
@@ -1849,6 +2136,152 @@ public:
     }
 };
 
+/*!
+ * Live statistics of the expensive phases of the parallel_priority_queue: how
+ * often each phase ran and the total time spent in it. Unlike the compile-time
+ * stats_type of the queue, these are always gathered, as the phases are
+ * coarse, and may be sampled by any thread at any time via snapshot().
+ *
+ * The times of enclosing phases include those of the phases they run, e.g. an
+ * internal array merge includes the external array merges it triggers.
+ */
+class phase_stats
+{
+public:
+    enum phase_type {
+        //! flushes of insertion heaps into internal arrays
+        insertion_heap_flush,
+        //! merges of the internal arrays into an external array
+        internal_array_merge,
+        //! merges of a level of external arrays
+        external_array_merge,
+        //! rebuilds of the hint tree
+        hint_tree_rebuild,
+        //! waits for blocks of external arrays to be read
+        read_wait,
+        num_phases
+    };
+
+    //! Name of the phase in the JSON export.
+    static const char * name(phase_type phase)
+    {
+        static const char* names[num_phases] = {
+            "insertion_heap_flush", "internal_array_merge",
+            "external_array_merge", "hint_tree_rebuild", "read_wait"
+        };
+        return names[phase];
+    }
+
+    //! Copy of the statistics at one point in time.
+    struct snapshot_type
+    {
+        //! number of runs of each phase
+        uint64_t count[num_phases];
+        //! total time in seconds spent in each phase
+        double seconds[num_phases];
+
+        //! Statistics of the interval between the two snapshots.
+        snapshot_type operator - (const snapshot_type& o) const
+        {
+            snapshot_type d;
+            for (size_t i = 0; i < num_phases; ++i) {
+                d.count[i] = count[i] - o.count[i];
+                d.seconds[i] = seconds[i] - o.seconds[i];
+            }
+            return d;
+        }
+
+        //! Returns the statistics as a JSON object of one object per phase,
+        //! with the fields count and seconds.
+        std::string to_json() const
+        {
+            std::ostringstream os;
+            os << '{';
+            for (size_t i = 0; i < num_phases; ++i) {
+                os << (i ? "," : "")
+                   << '"' << name(static_cast<phase_type>(i)) << "\":{"
+                   << "\"count\":" << count[i] << ','
+                   << "\"seconds\":" << seconds[i] << '}';
+            }
+            os << '}';
+            return os.str();
+        }
+
+        friend std::ostream& operator << (std::ostream& os, const snapshot_type& o)
+        {
+            for (size_t i = 0; i < num_phases; ++i) {
+                os << name(static_cast<phase_type>(i)) << "=" << o.count[i]
+                   << " in " << o.seconds[i] << " s" << std::endl;
+            }
+            return os;
+        }
+    };
+
+    //! Times a phase from construction to destruction.
+    class scoped_timer
+    {
+    public:
+        scoped_timer(phase_stats& stats, phase_type phase)
+            : m_stats(stats), m_phase(phase), m_start(foxxll::timestamp())
+        { }
+
+        ~scoped_timer()
+        {
+            m_stats.add(m_phase, foxxll::timestamp() - m_start);
+        }
+
+        //! non-copyable: delete copy-constructor
+        scoped_timer(const scoped_timer&) = delete;
+        //! non-copyable: delete assignment operator
+        scoped_timer& operator = (const scoped_timer&) = delete;
+
+    protected:
+        phase_stats& m_stats;
+        phase_type m_phase;
+        double m_start;
+    };
+
+    phase_stats()
+    {
+        reset();
+    }
+
+    //! Counts a run of the phase which took the given seconds.
+    void add(phase_type phase, double seconds)
+    {
+        m_count[phase].fetch_add(1, std::memory_order_relaxed);
+        m_nanoseconds[phase].fetch_add(
+            static_cast<uint64_t>(seconds * 1e9), std::memory_order_relaxed);
+    }
+
+    //! Returns a copy of the current statistics.
+    snapshot_type snapshot() const
+    {
+        snapshot_type s;
+        for (size_t i = 0; i < num_phases; ++i) {
+            s.count[i] = m_count[i].load(std::memory_order_relaxed);
+            s.seconds[i] =
+                static_cast<double>(m_nanoseconds[i].load(std::memory_order_relaxed)) / 1e9;
+        }
+        return s;
+    }
+
+    //! Sets all statistics to zero.
+    void reset()
+    {
+        for (size_t i = 0; i < num_phases; ++i) {
+            m_count[i].store(0, std::memory_order_relaxed);
+            m_nanoseconds[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+protected:
+    //! number of runs of each phase
+    std::atomic<uint64_t> m_count[num_phases];
+    //! total time in nanoseconds spent in each phase
+    std::atomic<uint64_t> m_nanoseconds[num_phases];
+};
+
 } // namespace ppq_local
 
 /*!
@@ -1871,15 +2304,25 @@ public:
  * STXXL_DEFAULT_BLOCK_SIZE(ValueType).
  *
  * \tparam AllocStrategy Allocation strategy for the external memory. Default =
- * foxxll::default_alloc_strategy.
+ * runtime_alloc_strategy, see SETTINGS::alloc_strategy.
+ *
+ * \tparam BlockCodec Codec encoding the blocks of the external arrays, e.g.
+ * frame_of_reference_codec<ValueType, true> for integral values, whose
+ * sorted blocks compress well by delta encoding. The blocks hold the
+ * elements in pop order, which is ascending only for a minimum queue, e.g.
+ * with std::greater; otherwise the plain frame of reference codec fits
+ * better. Default = no_block_codec.
+ * The encoded blocks in flight take internal memory beyond the pools, at
+ * most two per disk for each external array being written.
  */
 template <
     class ValueType,
     class CompareType = std::less<ValueType>,
-    class AllocStrategy = foxxll::default_alloc_strategy,
+    class AllocStrategy = runtime_alloc_strategy,
     size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
     size_t DefaultMemSize = 1* 1024L* 1024L* 1024L,
-    external_size_type MaxItems = 0
+    external_size_type MaxItems = 0,
+    class BlockCodec = no_block_codec
     >
 class parallel_priority_queue
 {
@@ -1898,11 +2341,13 @@ public:
     using bids_container_type = bid_vector;
     using pool_type = foxxll::read_write_pool<block_type>;
     using internal_array_type = ppq_local::internal_array<value_type>;
-    using external_array_type = ppq_local::external_array<value_type, block_size, AllocStrategy>;
+    using block_codec_type = BlockCodec;
+    using external_array_type = ppq_local::external_array<value_type, block_size, AllocStrategy, BlockCodec>;
     using external_array_writer_type = typename external_array_type::writer_type;
     using value_iterator = typename std::vector<value_type>::iterator;
     using iterator = typename internal_array_type::iterator;
     using iterator_pair_type = std::pair<iterator, iterator>;
+    using phase_stats_type = ppq_local::phase_stats;
 
     static const bool debug = false;
 
@@ -1912,6 +2357,25 @@ public:
     //! currently global public tuning parameter:
     size_t c_max_external_level_size;
 
+    //! currently global public tuning parameter: bytes of external arrays
+    //! merged by one flush of the internal arrays, 0 = unlimited. Merges of
+    //! full external levels beyond the budget are deferred to the next flush,
+    //! which splits a cascade over the levels into one merge per operation.
+    size_type c_merge_io_budget;
+
+    //! currently global public tuning parameter: if true, shift memory to
+    //! the read/prefetch pool when pops dominate and back to the internal
+    //! arrays when pushes dominate, see adapt_memory().
+    bool c_adaptive_memory;
+
+    //! currently global public tuning parameter: number of pushed and popped
+    //! elements after which adapt_memory() reconsiders the memory split.
+    size_type c_adaptive_window;
+
+    //! currently global public tuning parameter: largest number of
+    //! read/prefetch blocks per external array set by adapt_memory().
+    float c_max_read_blocks_per_ea;
+
 protected:
     //! type of insertion heap itself
     using heap_type = std::vector<value_type>;
@@ -1923,11 +2387,11 @@ protected:
     //! type of minima tree combining the structures
     using minima_type = ppq_local::minima_tree<
               parallel_priority_queue<value_type, compare_type, alloc_strategy,
-                                      block_size, DefaultMemSize, MaxItems> >;
+                                      block_size, DefaultMemSize, MaxItems, BlockCodec> >;
     //! allow minima tree access to internal data structures
     friend class ppq_local::minima_tree<
             parallel_priority_queue<value_type, compare_type, alloc_strategy,
-                                    block_size, DefaultMemSize, MaxItems> >;
+                                    block_size, DefaultMemSize, MaxItems, BlockCodec> >;
 
     //! Inverse comparison functor
     struct inv_compare_type
@@ -2003,6 +2467,18 @@ protected:
     //! is faster than bulk_push.
     static const unsigned c_single_insert_limit = 100;
 
+    /*!
+     * Write to the pages of each newly reserved insertion heap from the thread
+     * with the heap's id, so that the operating system places them on that
+     * thread's NUMA node (first touch) instead of the one calling reserve().
+     *
+     * Loops over the insertion heaps run heap p on thread p of the OpenMP
+     * team, hence heap p and the internal arrays it is flushed into stay on
+     * the node of thread p, if the threads are bound to places, e.g. by
+     * OMP_PROC_BIND=close and OMP_PLACES=cores.
+     */
+    static const bool c_first_touch_heaps = true;
+
     //! \}
 
     //! \name Parameters and Sizes for Memory Allocation Policy
@@ -2014,6 +2490,21 @@ protected:
     size_type m_insertion_heap_capacity;
 
     //! Return size of insertion heap reservation in bytes
+    //! Reserves memory for the insertion heap p if it has none, and places it
+    //! on the NUMA node of the calling thread, see c_first_touch_heaps.
+    void reserve_insertion_heap(size_t p)
+    {
+        heap_type& insheap = m_proc[p]->insertion_heap;
+        if (insheap.capacity() >= m_insertion_heap_capacity)
+            return;
+
+        insheap.reserve(m_insertion_heap_capacity);
+        if (c_first_touch_heaps && insheap.empty()) {
+            insheap.resize(m_insertion_heap_capacity);
+            insheap.clear();
+        }
+    }
+
     size_type insertion_heap_int_memory() const
     {
         return m_insertion_heap_capacity * sizeof(value_type);
@@ -2022,6 +2513,9 @@ protected:
     //! Total amount of internal memory
     size_type m_mem_total;
 
+    //! reservation of the total amount at the memory_manager
+    memory_reservation m_mem_reservation;
+
     //! Maximum size of extract buffer in number of elements
     //! Only relevant if c_limit_extract_buffer==true
     size_type m_extract_buffer_limit;
@@ -2032,6 +2526,16 @@ protected:
     //! Number of read/prefetch blocks per external array.
     float m_num_read_blocks_per_ea;
 
+    //! Number of read/prefetch blocks per external array given to the
+    //! constructor, the least adapt_memory() sets.
+    float m_min_read_blocks_per_ea;
+
+    //! Number of elements popped since the last adapt_memory() window.
+    size_type m_adapt_pops;
+
+    //! Number of elements at the start of the adapt_memory() window.
+    size_type m_adapt_size;
+
     //! Total number of read/prefetch buffer blocks
     size_t m_num_read_blocks;
     //! number of currently hinted prefetch blocks
@@ -2047,6 +2551,19 @@ protected:
     //! Flag if inside a bulk_push sequence.
     bool m_in_bulk_push;
 
+    //! Bytes of external arrays merged by the current check_external_levels().
+    size_type m_merge_io_spent;
+
+    //! Flag if concurrent_push() opened a bulk_push sequence, which the next
+    //! other operation closes.
+    std::atomic<bool> m_in_concurrent_push;
+
+    //! Serializes opening the bulk_push sequence in concurrent_push().
+    std::mutex m_concurrent_push_mutex;
+
+    //! Serializes flushing insertion heaps into internal arrays.
+    std::mutex m_flush_mutex;
+
     //! If the bulk currently being inserted is very large, this boolean is set
     //! and bulk_push just accumulate the elements for eventual sorting.
     bool m_is_very_large_bulk;
@@ -2088,6 +2605,9 @@ protected:
         //! The number of items inserted into the insheap during bulk parallel
         //! access.
         size_type heap_add_size;
+
+        //! Locks the heap against other threads in concurrent_push().
+        std::mutex mutex;
     };
 
     using proc_vector_type = std::vector<ProcessorData*>;
@@ -2095,6 +2615,11 @@ protected:
     //! Array of processor local data structures, including the insertion heaps.
     proc_vector_type m_proc;
 
+    //! Files holding the blocks of external arrays restored by restore(),
+    //! kept open as long as the queue (has to be in front of
+    //! m_external_arrays). The block_manager does not delete their blocks.
+    std::vector<foxxll::file_ptr> m_checkpoint_files;
+
     //! Prefetch and write buffer pool for external arrays (has to be in front
     //! of m_external_arrays)
     pool_type m_pool;
@@ -2346,6 +2871,10 @@ public:
         const size_type extract_buffer_ram = 0)
         : c_max_internal_level_size(64),
           c_max_external_level_size(64),
+          c_merge_io_budget(0),
+          c_adaptive_memory(false),
+          c_adaptive_window(1024 * 1024),
+          c_max_read_blocks_per_ea(8.0f),
           m_compare(compare),
           m_inv_compare(m_compare),
           // Parameters and Sizes for Memory Allocation Policy
@@ -2356,13 +2885,19 @@ public:
 #endif
           m_insertion_heap_capacity(single_heap_ram / sizeof(value_type)),
           m_mem_total(total_ram),
+          m_mem_reservation("parallel_priority_queue", total_ram),
           m_mem_for_heaps(m_num_insertion_heaps * single_heap_ram),
           m_num_read_blocks_per_ea(num_read_blocks_per_ea),
+          m_min_read_blocks_per_ea(num_read_blocks_per_ea),
+          m_adapt_pops(0),
+          m_adapt_size(0),
           m_num_read_blocks(0),
           m_num_hinted_blocks(0),
           m_num_used_read_blocks(0),
           // (unnamed)
           m_in_bulk_push(false),
+          m_merge_io_spent(0),
+          m_in_concurrent_push(false),
           m_is_very_large_bulk(false),
           m_extract_buffer_index(0),
           // Number of elements currently in the data structures
@@ -2424,14 +2959,14 @@ public:
         // total_ram - ram for the heaps - ram for the heap merger
         m_mem_left = m_mem_total - 2 * m_mem_for_heaps;
 
-        // reverse insertion heap memory on processor-local memory
+        // reserve insertion heap memory on processor-local memory
 #if STXXL_PARALLEL
-#pragma omp parallel for
+#pragma omp parallel for num_threads(m_num_insertion_heaps) schedule(static, 1)
 #endif
         for (long p = 0; p < static_cast<long>(m_num_insertion_heaps); ++p)
         {
             m_proc[p] = new ProcessorData;
-            m_proc[p]->insertion_heap.reserve(m_insertion_heap_capacity);
+            reserve_insertion_heap(p);
             assert(m_proc[p]->insertion_heap.capacity() * sizeof(value_type)
                    == insertion_heap_int_memory());
         }
@@ -2479,6 +3014,25 @@ public:
         {
             delete m_proc[p];
         }
+
+        if (locked_memory::get_instance().locked() != 0)
+        {
+            // m_pool.read() exchanges read and write blocks, hence unlock
+            // both pools: the external arrays return their blocks first.
+            m_external_arrays.clear();
+            while (m_pool.free_size_prefetch() > 0)
+            {
+                block_type* block = m_pool.steal_prefetch();
+                unlock_blocks(block);
+                delete block;
+            }
+            while (m_pool.size_write() > 0)
+            {
+                block_type* block = m_pool.steal();
+                unlock_blocks(block);
+                delete block;
+            }
+        }
     }
 
 protected:
@@ -2590,7 +3144,15 @@ public:
     //! The number of elements in the queue.
     inline size_type size() const
     {
-        return m_heaps_size + m_internal_size + m_external_size + m_extract_buffer_size;
+        size_type heaps_size = m_heaps_size;
+
+        // add the elements of concurrent_push() not yet counted
+        if (m_in_concurrent_push.load(std::memory_order_acquire)) {
+            for (size_t p = 0; p < m_num_insertion_heaps; ++p)
+                heaps_size += m_proc[p]->heap_add_size;
+        }
+
+        return heaps_size + m_internal_size + m_external_size + m_extract_buffer_size;
     }
 
     //! Returns if the queue is empty.
@@ -2625,6 +3187,8 @@ public:
      */
     void bulk_push_begin(size_type bulk_size)
     {
+        end_concurrent_push();
+
         assert(!m_in_bulk_push);
         m_in_bulk_push = true;
         m_bulk_first_delayed_external_array = m_external_arrays.size();
@@ -2657,6 +3221,7 @@ public:
      *
      * \param element The element to push.
      * \param p The id of the insertion heap to use (usually the thread id).
+     * Heap p is kept in the memory of thread p, see c_first_touch_heaps.
      */
     void bulk_push(const value_type& element, const size_t p)
     {
@@ -2764,7 +3329,7 @@ public:
         else if (!m_is_very_large_bulk && 1)
         {
 #if STXXL_PARALLEL
-#pragma omp parallel for
+#pragma omp parallel for num_threads(m_num_insertion_heaps) schedule(static, 1)
 #endif
             for (long p = 0; p < static_cast<long>(m_num_insertion_heaps); ++p)
             {
@@ -2790,7 +3355,7 @@ public:
         else // m_is_very_large_bulk
         {
 #if STXXL_PARALLEL
-#pragma omp parallel for
+#pragma omp parallel for num_threads(m_num_insertion_heaps) schedule(static, 1)
 #endif
             for (size_t p = 0; p < m_num_insertion_heaps; ++p)
             {
@@ -2833,6 +3398,9 @@ public:
         }
 
         check_invariants();
+
+        if (c_adaptive_memory && !m_limit_extract)
+            adapt_memory();
     }
 
     //! Extract up to max_size values at once.
@@ -2840,6 +3408,10 @@ public:
     {
         TLX_LOG << "bulk_pop() max_size=" << max_size;
 
+        end_concurrent_push();
+        if (c_adaptive_memory)
+            adapt_memory();
+
         const size_t n_elements = std::min<size_t>(max_size, size());
         assert(n_elements < m_extract_buffer_limit);
 
@@ -2853,6 +3425,7 @@ public:
         out.resize(0);
         using std::swap;
         swap(m_extract_buffer, out);
+        m_adapt_pops += out.size();
         m_extract_buffer_index = 0;
         m_extract_buffer_size = 0;
         m_minima.deactivate_extract_buffer();
@@ -2860,6 +3433,87 @@ public:
         check_invariants();
     }
 
+    /*!
+     * Extract up to max_size values at once into num_parts vectors, which are
+     * merged concurrently from the internal and external arrays. The parts
+     * have nearly equal sizes and follow each other in pop order, each
+     * sorted like the values of bulk_pop(): no value of out[p + 1] is popped
+     * before one of out[p]. The parts are split by multiway selection over
+     * the arrays before merging. num_parts = 0 = Default = number of
+     * insertion heaps.
+     */
+    void bulk_pop_parallel(std::vector<std::vector<value_type> >& out,
+                           size_t max_size, size_t num_parts = 0)
+    {
+        TLX_LOG << "bulk_pop_parallel() max_size=" << max_size <<
+            " num_parts=" << num_parts;
+
+        end_concurrent_push();
+        if (c_adaptive_memory)
+            adapt_memory();
+
+        if (num_parts == 0)
+            num_parts = m_num_insertion_heaps;
+        out.resize(num_parts);
+        for (std::vector<value_type>& part : out)
+            part.resize(0);
+
+        const size_t n_elements = std::min<size_t>(max_size, size());
+
+        if (m_heaps_size > 0)
+            flush_insertion_heaps();
+
+        convert_eb_into_ia();
+
+        cleanup_external_arrays();
+        m_minima.clear_internal_arrays();
+        cleanup_internal_arrays();
+
+        const size_type eas = m_external_arrays.size();
+        const size_type ias = m_internal_arrays.size();
+
+        if (n_elements == 0 || eas + ias == 0) {
+            check_invariants();
+            return;
+        }
+
+        std::vector<size_type> sizes(eas + ias);
+        std::vector<iterator_pair_type> sequences(eas + ias);
+        const size_type output_size = std::min<size_type>(
+            collect_merge_sequences(sizes, sequences, n_elements), n_elements);
+
+        // split[p] are the positions in the sequences where part p begins
+        std::vector<std::vector<size_type> > split(num_parts + 1);
+        split[0].assign(eas + ias, 0);
+        for (size_t p = 1; p <= num_parts; ++p)
+            calculate_splitters(sequences, output_size * p / num_parts, split[p]);
+
+#if STXXL_PARALLEL
+#pragma omp parallel for num_threads(num_parts) schedule(static, 1)
+#endif
+        for (long p = 0; p < static_cast<long>(num_parts); ++p)
+        {
+            std::vector<iterator_pair_type> slices(eas + ias);
+            for (size_type i = 0; i < eas + ias; ++i)
+                slices[i] = std::make_pair(sequences[i].first + split[p][i],
+                                           sequences[i].first + split[p + 1][i]);
+
+            const size_type part_size =
+                output_size * (p + 1) / num_parts - output_size * p / num_parts;
+            out[p].resize(part_size);
+            tlx::multiway_merge(slices.begin(), slices.end(),
+                                out[p].begin(), part_size, m_inv_compare);
+        }
+
+        for (size_type i = 0; i < eas + ias; ++i)
+            sequences[i].first += split[num_parts][i];
+
+        m_adapt_pops += output_size;
+        advance_arrays(sequences, sizes, eas, ias);
+
+        check_invariants();
+    }
+
     //! Extracts all elements which are greater or equal to a given limit.
     //! \param out result vector
     //! \param limit limit value
@@ -2871,6 +3525,7 @@ public:
     {
         TLX_LOG << "bulk_pop_limit with limit=" << limit;
 
+        end_concurrent_push();
         convert_eb_into_ia();
 
         if (m_heaps_size > 0) {
@@ -2999,6 +3654,64 @@ public:
 
     //! \}
 
+    //! \name Concurrent Operations
+    //! \{
+
+    /*!
+     * Push an element from any thread at any time, concurrently with other
+     * calls of concurrent_push() but not with other operations. No
+     * bulk_push_begin() and bulk_push_end() are needed, the first call opens
+     * a bulk_push sequence, which the next other operation closes.
+     *
+     * Each calling thread pushes into one insertion heap, chosen by a
+     * thread-local id. The heap is locked by its own mutex, which is not
+     * contended unless more threads than insertion heaps push. Full heaps are
+     * flushed into internal arrays as in bulk_push().
+     *
+     * \param element The element to push.
+     */
+    void concurrent_push(const value_type& element)
+    {
+        if (!m_in_concurrent_push.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> lock(m_concurrent_push_mutex);
+            if (!m_in_concurrent_push.load(std::memory_order_relaxed)) {
+                bulk_push_begin(0);
+                m_in_concurrent_push.store(true, std::memory_order_release);
+            }
+        }
+
+#if !STXXL_PARALLEL
+        // the item counters are updated without atomics, serialize all pushes
+        std::unique_lock<std::mutex> serial_lock(m_concurrent_push_mutex);
+#endif
+
+        const size_t p = concurrent_push_heap();
+        std::unique_lock<std::mutex> lock(m_proc[p]->mutex);
+        bulk_push(element, p);
+    }
+
+protected:
+    //! Returns the insertion heap of the calling thread in concurrent_push().
+    size_t concurrent_push_heap() const
+    {
+        static std::atomic<size_t> s_next_id(0);
+        static thread_local const size_t s_id = s_next_id++;
+        return s_id % m_num_insertion_heaps;
+    }
+
+    //! Closes the bulk_push sequence opened by concurrent_push(), if any.
+    void end_concurrent_push()
+    {
+        if (m_in_concurrent_push.load(std::memory_order_acquire)) {
+            m_in_concurrent_push.store(false, std::memory_order_relaxed);
+            bulk_push_end();
+        }
+    }
+
+public:
+    //! \}
+
     //! \name Aggregation Operations
     //! \{
 
@@ -3052,8 +3765,12 @@ public:
      */
     void push(const value_type& element, const size_t p = 0)
     {
+        end_concurrent_push();
         assert(!m_in_bulk_push && !m_limit_extract);
 
+        if (c_adaptive_memory)
+            adapt_memory();
+
         heap_type& insheap = m_proc[p]->insertion_heap;
 
         if (insheap.size() >= m_insertion_heap_capacity) {
@@ -3073,6 +3790,7 @@ public:
     //! Access the minimum element.
     const value_type & top()
     {
+        end_concurrent_push();
         assert(!m_in_bulk_push && !m_limit_extract);
         assert(!empty());
 
@@ -3110,8 +3828,13 @@ public:
     //! Remove the minimum element.
     void pop()
     {
+        end_concurrent_push();
         assert(!m_in_bulk_push && !m_limit_extract);
 
+        if (c_adaptive_memory)
+            adapt_memory();
+        ++m_adapt_pops;
+
         m_stats.num_extracts++;
 
         if (extract_buffer_empty()) {
@@ -3263,11 +3986,16 @@ public:
     {
         assert(m_limit_extract);
 
+        ++m_adapt_pops;
         ++m_extract_buffer_index;
         assert(m_extract_buffer_size > 0);
         --m_extract_buffer_size;
 
-        if (extract_buffer_empty() && !m_limit_has_full_range)
+        if (!extract_buffer_empty())
+        {
+            m_minima.update_extract_buffer();
+        }
+        else if (!m_limit_has_full_range)
         {
             // extract more items
             std::vector<value_type> new_extract_buffer;
@@ -3284,6 +4012,11 @@ public:
             else
                 m_minima.deactivate_extract_buffer();
         }
+        else
+        {
+            // the minima tree must not read past the drained buffer
+            m_minima.deactivate_extract_buffer();
+        }
     }
 
     //! Finish bulk-limit extraction session.
@@ -3298,7 +4031,323 @@ public:
 
     //! \}
 
+    //! \name Checkpoints
+    //! \{
+
+    /*!
+     * Write a checkpoint of the queue to file, from which restore() rebuilds
+     * it, also in a later process. The file holds a header with the levels,
+     * sizes and block minima of the external arrays, followed by the elements
+     * held in internal memory, i.e. those of the insertion heaps, internal
+     * arrays, extract buffer, aggregated pushes and the partially read first
+     * blocks of the external arrays, and a copy of the remaining blocks of the
+     * external arrays. The queue itself is not changed. With a BlockCodec the
+     * blocks are copied encoded and the header also holds their extents; such
+     * checkpoints are restored only by queues with the same codec.
+     */
+    void checkpoint(foxxll::file_ptr file)
+    {
+        end_concurrent_push();
+        assert(!m_in_bulk_push && !m_limit_extract);
+
+        for (const foxxll::file_ptr& f : m_checkpoint_files)
+        {
+            if (f.get() == file.get())
+                throw std::runtime_error(
+                          "parallel_priority_queue::checkpoint(): the queue was restored from this file");
+        }
+
+        // the external arrays are stored from their first unread block on,
+        // the rest of a partially read block goes with the internal elements.
+        std::vector<size_t> ea_first_block(m_external_arrays.size());
+        size_type num_values = m_heaps_size + m_internal_size + m_extract_buffer_size;
+        size_t num_eas = 0, num_ea_blocks = 0;
+        for (size_t i = 0; i < m_external_arrays.size(); ++i)
+        {
+            const external_array_type& ea = m_external_arrays[i];
+            ea_first_block[i] = static_cast<size_t>(
+                foxxll::div_ceil(ea.get_index(), block_type::size));
+            num_values += ea_first_index(i, ea_first_block[i]) - ea.get_index();
+            if (ea_first_block[i] < ea.num_blocks()) {
+                ++num_eas;
+                num_ea_blocks += ea.num_blocks() - ea_first_block[i];
+            }
+        }
+
+        binary_buffer body;
+        body.put<uint64_t>(sizeof(value_type));
+        body.put<uint64_t>(num_values);
+        body.put<uint64_t>(m_aggregated_pushes.size());
+        body.put<uint64_t>(num_eas);
+        for (size_t i = 0; i < m_external_arrays.size(); ++i)
+        {
+            const external_array_type& ea = m_external_arrays[i];
+            if (ea_first_block[i] >= ea.num_blocks())
+                continue;
+
+            body.put<uint64_t>(ea.level());
+            body.put<uint64_t>(ea.capacity() - ea_first_index(i, ea_first_block[i]));
+            for (size_t j = ea_first_block[i]; j < ea.num_blocks(); ++j)
+                body.put<value_type>(ea.get_block_min(j));
+            if (external_array_type::compressed)
+            {
+                for (size_t j = ea_first_block[i]; j < ea.num_blocks(); ++j)
+                    body.put<uint64_t>(ea.get_extent(j));
+            }
+        }
+
+        binary_buffer header;
+        header.put<uint64_t>(checkpoint_magic());
+        header.put<uint64_t>(block_type::raw_size);
+        header.put<uint64_t>(body.size());
+        header.append(body);
+
+        const size_t header_blocks = foxxll::div_ceil(header.size(), block_type::raw_size);
+        const size_t value_blocks = static_cast<size_t>(
+            foxxll::div_ceil(num_values + m_aggregated_pushes.size(), block_type::size));
+        file->set_size((header_blocks + value_blocks + num_ea_blocks) * block_type::raw_size);
+
+        // the buffer blocks are allocated one by one, since m_pool.read() may
+        // exchange them with blocks of the write pool.
+        const size_t nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+        std::vector<block_type*> blocks(std::max(header_blocks, nbuffers));
+        for (block_type*& b : blocks)
+            b = new block_type;
+
+        std::vector<foxxll::request_ptr> reqs;
+        for (size_t i = 0; i < header_blocks; ++i)
+        {
+            const size_t offset = i * block_type::raw_size;
+            const size_t n = std::min<size_t>(block_type::raw_size, header.size() - offset);
+            memcpy(static_cast<void*>(blocks[i]), header.data() + offset, n);
+            reqs.push_back(blocks[i]->write(file_bid(file, i)));
+        }
+        wait_all(reqs.begin(), reqs.end());
+        reqs.clear();
+
+        // pack the internal elements into blocks behind the header
+        size_t next_block = header_blocks, buffer = 0, fill = 0;
+        auto put_value =
+            [&](const value_type& v) {
+                blocks[buffer]->elem[fill] = v;
+                if (++fill < block_type::size)
+                    return;
+                reqs.push_back(blocks[buffer]->write(file_bid(file, next_block++)));
+                fill = 0;
+                if (++buffer < nbuffers)
+                    return;
+                wait_all(reqs.begin(), reqs.end());
+                reqs.clear();
+                buffer = 0;
+            };
+
+        for (size_t p = 0; p < m_num_insertion_heaps; ++p)
+        {
+            for (const value_type& v : m_proc[p]->insertion_heap)
+                put_value(v);
+        }
+        for (size_t i = 0; i < m_internal_arrays.size(); ++i)
+        {
+            internal_array_type& ia = m_internal_arrays[i];
+            for (size_t j = ia.get_min_index(); j < ia.capacity(); ++j)
+                put_value(ia[j]);
+        }
+        for (size_type j = 0; j < m_extract_buffer_size; ++j)
+            put_value(m_extract_buffer[m_extract_buffer_index + j]);
+        for (size_t i = 0; i < m_external_arrays.size(); ++i)
+        {
+            // a partially read block is in internal memory
+            const external_array_type& ea = m_external_arrays[i];
+            for (size_type j = ea.get_index(); j < ea_first_index(i, ea_first_block[i]); ++j)
+                put_value(ea[j]);
+        }
+        for (const value_type& v : m_aggregated_pushes)
+            put_value(v);
+
+        if (fill > 0)
+            reqs.push_back(blocks[buffer]->write(file_bid(file, next_block++)));
+        wait_all(reqs.begin(), reqs.end());
+        reqs.clear();
+        assert(next_block == header_blocks + value_blocks);
+
+        // copy the remaining blocks of the external arrays, nbuffers at a
+        // time. m_pool.read() also finds blocks still being written, encoded
+        // ones are written from their own buffers.
+        std::vector<typename bid_vector::value_type> src;
+        for (size_t i = 0; i < m_external_arrays.size(); ++i)
+        {
+            m_external_arrays[i].wait_writes();
+            for (size_t j = ea_first_block[i]; j < m_external_arrays[i].num_blocks(); ++j)
+                src.push_back(m_external_arrays[i].get_bid(j));
+        }
+        for (size_t i = 0; i < src.size(); i += nbuffers)
+        {
+            const size_t n = std::min(nbuffers, src.size() - i);
+            for (size_t k = 0; k < n; ++k)
+                reqs.push_back(m_pool.read(blocks[k], src[i + k]));
+            wait_all(reqs.begin(), reqs.end());
+            reqs.clear();
+            for (size_t k = 0; k < n; ++k)
+                reqs.push_back(blocks[k]->write(file_bid(file, next_block++)));
+            wait_all(reqs.begin(), reqs.end());
+            reqs.clear();
+        }
+
+        for (block_type* b : blocks)
+            delete b;
+    }
+
+    /*!
+     * Restore the queue from a checkpoint written by checkpoint() of a queue
+     * with the same value type and block size. The queue must be empty. The
+     * internal elements are read into an internal array, while the external
+     * arrays refer to the blocks in file without reading them, hence the file
+     * must not be changed as long as the queue uses them.
+     */
+    void restore(foxxll::file_ptr file)
+    {
+        end_concurrent_push();
+        assert(!m_in_bulk_push && !m_limit_extract);
+        tlx_die_unless(empty() && m_aggregated_pushes.empty() &&
+                       "restore() requires an empty queue");
+
+        const size_t nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+        block_type* blocks = new_block_array<block_type>(nbuffers);
+        blocks[0].read(file_bid(file, 0))->wait();
+
+        binary_reader first(static_cast<const void*>(blocks), block_type::raw_size);
+        if (first.get<uint64_t>() != checkpoint_magic() ||
+            first.get<uint64_t>() != block_type::raw_size)
+        {
+            delete_block_array(blocks, nbuffers);
+            throw std::runtime_error(
+                      "parallel_priority_queue::restore(): the file is no checkpoint of a queue with this block size");
+        }
+        const size_t body_size = first.get<uint64_t>();
+        const size_t body_offset = first.curr();
+        const size_t header_size = body_offset + body_size;
+        const size_t header_blocks = foxxll::div_ceil(header_size, block_type::raw_size);
+
+        std::vector<char> header(header_blocks * block_type::raw_size);
+        memcpy(header.data(), static_cast<const void*>(blocks), block_type::raw_size);
+        for (size_t i = 1; i < header_blocks; ++i)
+        {
+            blocks[0].read(file_bid(file, i))->wait();
+            memcpy(header.data() + i * block_type::raw_size,
+                   static_cast<const void*>(blocks), block_type::raw_size);
+        }
+
+        binary_reader body(header.data() + body_offset, header_size - body_offset);
+        if (body.get<uint64_t>() != sizeof(value_type))
+        {
+            delete_block_array(blocks, nbuffers);
+            throw std::runtime_error(
+                      "parallel_priority_queue::restore(): the checkpoint holds values of a different type");
+        }
+        const size_type num_values = body.get<uint64_t>();
+        const size_type num_aggregated = body.get<uint64_t>();
+        const size_t num_eas = body.get<uint64_t>();
+
+        // read the internal elements, nbuffers blocks at a time
+        std::vector<value_type> values(num_values + num_aggregated);
+        size_t next_block = header_blocks;
+        std::vector<foxxll::request_ptr> reqs;
+        for (size_type i = 0; i < values.size(); i += nbuffers * block_type::size)
+        {
+            const size_type n = std::min<size_type>(nbuffers * block_type::size, values.size() - i);
+            const size_t nblocks = static_cast<size_t>(foxxll::div_ceil(n, block_type::size));
+            for (size_t k = 0; k < nblocks; ++k)
+                reqs.push_back(blocks[k].read(file_bid(file, next_block++)));
+            wait_all(reqs.begin(), reqs.end());
+            reqs.clear();
+            for (size_type j = 0; j < n; ++j)
+                values[i + j] = blocks[j / block_type::size].elem[j % block_type::size];
+        }
+        delete_block_array(blocks, nbuffers);
+
+        m_aggregated_pushes.assign(values.begin() + num_values, values.end());
+        values.resize(num_values);
+
+        // register the external arrays like flush_internal_arrays()
+        for (size_t e = 0; e < num_eas; ++e)
+        {
+            const size_t level = body.get<uint64_t>();
+            const size_type size = body.get<uint64_t>();
+            const size_t nblocks = static_cast<size_t>(foxxll::div_ceil(size, block_type::size));
+
+            tlx_die_unless(level < kMaxExternalLevels);
+
+            typename external_array_type::bid_vector bids(nblocks);
+            typename external_array_type::minima_vector minima(nblocks);
+            for (size_t j = 0; j < nblocks; ++j)
+            {
+                bids[j] = file_bid(file, next_block++);
+                minima[j] = body.get<value_type>();
+            }
+            typename external_array_type::extent_vector extents;
+            if (external_array_type::compressed)
+            {
+                extents.resize(nblocks);
+                for (size_t j = 0; j < nblocks; ++j)
+                    extents[j] = static_cast<uint32_t>(body.get<uint64_t>());
+            }
+
+            external_array_type ea(size, &m_pool, level, std::move(bids),
+                                   std::move(minima), std::move(extents));
+            m_external_arrays.swap_back(ea);
+            m_external_size += size;
+
+            m_external_min_tree.activate_without_replay(m_external_arrays.size() - 1);
+            update_external_min_tree(m_external_arrays.size() - 1);
+
+            m_hint_tree.activate_without_replay(m_external_arrays.size() - 1);
+            update_hint_tree(m_external_arrays.size() - 1);
+
+            m_mem_left -= m_external_arrays.back().int_memory();
+            ++m_external_levels[level];
+        }
+        m_stats.max_num_external_arrays.set_max(m_external_arrays.size());
+
+        if (num_eas > 0)
+            m_checkpoint_files.push_back(file);
+
+        resize_read_pool();
+        rebuild_hint_tree();
+
+        if (!values.empty())
+            flush_array_internal(values);
+
+        check_invariants();
+    }
+
+    //! \}
+
 protected:
+    //! first word of a checkpoint file written by checkpoint(), "STXLPPQS",
+    //! or "STXLPPQC" with a BlockCodec
+    static uint64_t checkpoint_magic()
+    {
+        return external_array_type::compressed ? 0x5354584c50505143ull : 0x5354584c50505153ull;
+    }
+
+    //! Index of the first element of block first of the external array
+    //! ea, or its capacity if first is behind its last block.
+    size_type ea_first_index(size_t ea, size_t first) const
+    {
+        return std::min<size_type>(m_external_arrays[ea].capacity(),
+                                   static_cast<size_type>(first) * block_type::size);
+    }
+
+    //! BID of the i-th block of a checkpoint file.
+    static typename bid_vector::value_type
+    file_bid(const foxxll::file_ptr& file, size_t i)
+    {
+        typename bid_vector::value_type bid;
+        bid.storage = file.get();
+        bid.offset = i * block_type::raw_size;
+        return bid;
+    }
+
     //! Flushes all elements of the insertion heaps which are greater
     //! or equal to a given limit.
     //! \param limit limit value
@@ -3442,6 +4491,7 @@ public:
 
             while (new_num_read_blocks > m_num_read_blocks) {
                 block_type* new_block = new block_type();
+                lock_blocks(new_block);
                 m_pool.add_prefetch(new_block);
                 ++m_num_read_blocks;
             }
@@ -3456,6 +4506,7 @@ public:
                    m_pool.free_size_prefetch() > 0)
             {
                 block_type* del_block = m_pool.steal_prefetch();
+                unlock_blocks(del_block);
                 delete del_block;
                 --m_num_read_blocks;
                 m_mem_left += block_size;
@@ -3466,10 +4517,88 @@ public:
         }
     }
 
+    /*!
+     * Shifts memory between the read/prefetch pool and the internal arrays
+     * after each window of c_adaptive_window pushed and popped elements.
+     *
+     * If at least two thirds of the elements in the window were popped, the
+     * number of read blocks per external array is doubled, up to
+     * c_max_read_blocks_per_ea, so that the merges refilling the extract
+     * buffer wait less for reads. The internal arrays are flushed to make
+     * room if necessary. If at most one third were popped, the number is
+     * reset to the constructor's value, which leaves the memory to the
+     * internal arrays and defers their flushes to external arrays.
+     */
+    void adapt_memory()
+    {
+        // elements leaving by bulk_pop_limit() are not counted as pops
+        const size_type cur_size = size();
+        const size_type pushes = (cur_size + m_adapt_pops > m_adapt_size)
+                                 ? cur_size + m_adapt_pops - m_adapt_size : 0;
+        if (pushes + m_adapt_pops < c_adaptive_window)
+            return;
+
+        const bool pop_heavy = m_adapt_pops >= 2 * pushes;
+        const bool push_heavy = 2 * m_adapt_pops <= pushes;
+
+        TLX_LOG << "adapt_memory() pushes=" << pushes << " pops=" << m_adapt_pops
+                << " m_num_read_blocks_per_ea=" << m_num_read_blocks_per_ea;
+
+        m_adapt_pops = 0;
+        m_adapt_size = cur_size;
+
+        float read_blocks_per_ea = m_num_read_blocks_per_ea;
+        if (pop_heavy)
+            read_blocks_per_ea = std::min(2.0f * read_blocks_per_ea, c_max_read_blocks_per_ea);
+        else if (push_heavy)
+            read_blocks_per_ea = m_min_read_blocks_per_ea;
+
+        if (read_blocks_per_ea > m_num_read_blocks_per_ea)
+        {
+            const size_t num_blocks = static_cast<size_t>(
+                read_blocks_per_ea * static_cast<float>(m_external_arrays.size()));
+
+            if (num_blocks > m_num_read_blocks &&
+                m_mem_left < (num_blocks - m_num_read_blocks) * block_size &&
+                m_internal_size > 0)
+            {
+                flush_internal_arrays();
+            }
+
+            // grant as many blocks as memory is left
+            const size_t num_eas = m_external_arrays.size();
+            if (num_eas > 0) {
+                const size_t max_blocks = m_num_read_blocks + m_mem_left / block_size;
+                read_blocks_per_ea = std::min(
+                    read_blocks_per_ea,
+                    static_cast<float>(max_blocks) / static_cast<float>(num_eas));
+                while (read_blocks_per_ea > m_num_read_blocks_per_ea &&
+                       static_cast<size_t>(read_blocks_per_ea * static_cast<float>(num_eas))
+                       > max_blocks)
+                {
+                    read_blocks_per_ea = std::nextafter(read_blocks_per_ea, 0.0f);
+                }
+                read_blocks_per_ea = std::max(read_blocks_per_ea, m_num_read_blocks_per_ea);
+            }
+        }
+
+        if (read_blocks_per_ea == m_num_read_blocks_per_ea)
+            return;
+
+        TLX_LOG << "adapt_memory() new m_num_read_blocks_per_ea=" << read_blocks_per_ea;
+
+        m_num_read_blocks_per_ea = read_blocks_per_ea;
+        resize_read_pool();
+        rebuild_hint_tree();
+        check_invariants();
+    }
+
     //! Rebuild hint tree completely as the hint sequence may have changed, and
     //! re-hint the correct block sequence.
     void rebuild_hint_tree()
     {
+        phase_stats_type::scoped_timer phase_timer(
+            m_phase_stats, phase_stats_type::hint_tree_rebuild);
         m_stats.hint_time.start();
 
         // prepare rehinting sequence: reset hint begin pointer
@@ -3610,9 +4739,23 @@ public:
         //}
 
         TLX_LOG1 << m_stats;
+        TLX_LOG1 << phase_stats();
         m_minima.print_stats();
     }
 
+    //! Returns a snapshot of the live phase statistics. May be called from
+    //! any thread at any time, e.g. by a monitoring thread.
+    phase_stats_type::snapshot_type phase_stats() const
+    {
+        return m_phase_stats.snapshot();
+    }
+
+    //! Sets the live phase statistics to zero.
+    void reset_phase_stats()
+    {
+        m_phase_stats.reset();
+    }
+
 protected:
     //! Calculates the sequences vector needed by the multiway merger,
     //! considering inaccessible data from external arrays.
@@ -3682,7 +4825,10 @@ protected:
                     }
                 }
 
-                assert(gmin_index == test_gmin_index);
+                // the tree may pick another array with an equal minimum
+                assert(gmin_index == test_gmin_index ||
+                       !m_inv_compare(test_gmin_value,
+                                      m_external_arrays[gmin_index].get_next_block_min()));
                 tlx::unused(gmin_index);
             }
             else {
@@ -3827,6 +4973,47 @@ protected:
 
         std::vector<size_type> sizes(eas + ias);
         std::vector<iterator_pair_type> sequences(eas + ias);
+        size_type output_size = collect_merge_sequences(sizes, sequences, minimum_size);
+
+        if (c_limit_extract_buffer) {
+            output_size = std::min<size_t>(output_size, maximum_size);
+        }
+
+        m_stats.max_extract_buffer_size.set_max(output_size);
+        m_stats.total_extract_buffer_size += output_size;
+
+        assert(output_size > 0);
+        m_extract_buffer.resize(output_size);
+        m_extract_buffer_size = output_size;
+
+        m_stats.refill_time_before_merge.stop();
+        m_stats.refill_merge_time.start();
+
+        potentially_parallel::multiway_merge(
+            sequences.begin(), sequences.end(),
+            m_extract_buffer.begin(), output_size, m_inv_compare);
+
+        m_stats.refill_merge_time.stop();
+        m_stats.refill_time_after_merge.start();
+
+        advance_arrays(sequences, sizes, eas, ias);
+
+        m_minima.update_extract_buffer();
+
+        m_stats.refill_time_after_merge.stop();
+        m_stats.refill_extract_buffer_time.stop();
+
+        check_invariants();
+    }
+
+    //! Calculates the merge sequences of all arrays with at least
+    //! minimum_size elements in total if there are as many, waiting for
+    //! further EA blocks as needed. Returns the number of elements.
+    size_type collect_merge_sequences(std::vector<size_type>& sizes,
+                                      std::vector<iterator_pair_type>& sequences,
+                                      size_t minimum_size)
+    {
+        const size_t eas = m_external_arrays.size();
         size_type output_size = 0;
 
         if (minimum_size > 0) {
@@ -3865,35 +5052,76 @@ protected:
             output_size = std::accumulate(sizes.begin(), sizes.end(), 0u);
         }
 
-        if (c_limit_extract_buffer) {
-            output_size = std::min<size_t>(output_size, maximum_size);
-        }
-
-        m_stats.max_extract_buffer_size.set_max(output_size);
-        m_stats.total_extract_buffer_size += output_size;
-
-        assert(output_size > 0);
-        m_extract_buffer.resize(output_size);
-        m_extract_buffer_size = output_size;
-
-        m_stats.refill_time_before_merge.stop();
-        m_stats.refill_merge_time.start();
-
-        potentially_parallel::multiway_merge(
-            sequences.begin(), sequences.end(),
-            m_extract_buffer.begin(), output_size, m_inv_compare);
-
-        m_stats.refill_merge_time.stop();
-        m_stats.refill_time_after_merge.start();
+        return output_size;
+    }
 
-        advance_arrays(sequences, sizes, eas, ias);
+    /*!
+     * Multiway selection: calculates the positions splitting each of the
+     * merge sequences such that the prefixes together hold the rank smallest
+     * elements, in the order of m_inv_compare, and no element of a prefix is
+     * after one of a suffix. Equal elements at the border are taken from the
+     * first sequences.
+     *
+     * The split lies in a window of each sequence; the middle element of the
+     * largest window is used as pivot and its bounds in all sequences either
+     * narrow the windows or fix the split, so there are O(k log n) rounds of
+     * k binary searches.
+     */
+    void calculate_splitters(const std::vector<iterator_pair_type>& sequences,
+                             size_type rank, std::vector<size_type>& split) const
+    {
+        const size_t k = sequences.size();
+        std::vector<size_type> lo(k, 0), hi(k), lower(k), upper(k);
+        for (size_t i = 0; i < k; ++i)
+            hi[i] = sequences[i].second - sequences[i].first;
 
-        m_minima.update_extract_buffer();
+        split.resize(k);
+        while (true)
+        {
+            size_t j = 0;
+            for (size_t i = 1; i < k; ++i)
+            {
+                if (hi[i] - lo[i] > hi[j] - lo[j])
+                    j = i;
+            }
+            if (k == 0 || lo[j] == hi[j])
+            {
+                // all windows are empty, the split is fixed
+                split = lo;
+                return;
+            }
 
-        m_stats.refill_time_after_merge.stop();
-        m_stats.refill_extract_buffer_time.stop();
+            const value_type pivot = *(sequences[j].first + (lo[j] + hi[j]) / 2);
+            size_type below = 0, up_to = 0;
+            for (size_t i = 0; i < k; ++i)
+            {
+                const iterator first = sequences[i].first;
+                lower[i] = std::lower_bound(first + lo[i], first + hi[i],
+                                            pivot, m_inv_compare) - first;
+                upper[i] = std::upper_bound(first + lower[i], first + hi[i],
+                                            pivot, m_inv_compare) - first;
+                below += lower[i];
+                up_to += upper[i];
+            }
 
-        check_invariants();
+            if (rank < below) {
+                hi = lower;
+            }
+            else if (rank > up_to) {
+                lo = upper;
+            }
+            else {
+                // the split is among the elements equal to the pivot
+                size_type left = rank - below;
+                for (size_t i = 0; i < k; ++i)
+                {
+                    const size_type equal = std::min(upper[i] - lower[i], left);
+                    split[i] = lower[i] + equal;
+                    left -= equal;
+                }
+                return;
+            }
+        }
     }
 
     //! Requests more EM data from a given EA and updates
@@ -3902,8 +5130,12 @@ protected:
     {
         TLX_LOG << "wait_next_ea_blocks() ea_index=" << ea_index;
 
-        size_t used_blocks =
-            m_external_arrays[ea_index].wait_next_blocks();
+        size_t used_blocks;
+        {
+            phase_stats_type::scoped_timer phase_timer(
+                m_phase_stats, phase_stats_type::read_wait);
+            used_blocks = m_external_arrays[ea_index].wait_next_blocks();
+        }
 
         m_num_hinted_blocks -= used_blocks;
         m_num_used_read_blocks += used_blocks;
@@ -3974,14 +5206,15 @@ protected:
 
         m_stats.num_insertion_heap_flushes++;
         stats_timer flush_time(true); // separate timer due to parallel sorting
+        phase_stats_type::scoped_timer phase_timer(
+            m_phase_stats, phase_stats_type::insertion_heap_flush);
 
         // sort locally, independent of others
         std::sort(insheap.begin(), insheap.end(), m_inv_compare);
 
-#if STXXL_PARALLEL
-#pragma omp critical(stxxl_flush_insertion_heap)
-#endif
         {
+            std::unique_lock<std::mutex> lock(m_flush_mutex);
+
             // test that enough RAM is available for merged internal array:
             // otherwise flush the existing internal arrays out to disk.
             flush_ia_ea_until_memory_free(
@@ -3993,11 +5226,6 @@ protected:
             // insheap is empty afterwards, as vector was swapped into new_array
             add_as_internal_array(insheap);
 
-            // reserve new insertion heap
-            insheap.reserve(m_insertion_heap_capacity);
-            assert(insheap.capacity() * sizeof(value_type)
-                   == insertion_heap_int_memory());
-
             // update item counts
 #if STXXL_PARALLEL
 #pragma omp atomic
@@ -4005,6 +5233,12 @@ protected:
             m_heaps_size -= size;
         }
 
+        // reserve new insertion heap outside of the critical section, as it
+        // is placed on the memory of the calling thread
+        reserve_insertion_heap(p);
+        assert(insheap.capacity() * sizeof(value_type)
+               == insertion_heap_int_memory());
+
         m_stats.insertion_heap_flush_time += flush_time;
     }
 
@@ -4026,6 +5260,10 @@ protected:
 
         m_stats.num_insertion_heap_flushes++;
         m_stats.insertion_heap_flush_time.start();
+        phase_stats_type::scoped_timer phase_timer(
+            m_phase_stats, phase_stats_type::insertion_heap_flush);
+        STXXL_TRACE_SPAN(span, "ppq::flush_insertion_heaps");
+        span.add_bytes(m_heaps_size * sizeof(value_type));
 
         size_type size = m_heaps_size;
         size_type int_memory = 0;
@@ -4033,7 +5271,7 @@ protected:
         std::vector<std::pair<value_iterator, value_iterator> > sequences(m_num_insertion_heaps);
 
 #if STXXL_PARALLEL
-        #pragma omp parallel for
+        #pragma omp parallel for num_threads(m_num_insertion_heaps) schedule(static, 1)
 #endif
         for (long i = 0; i < static_cast<long>(m_num_insertion_heaps); ++i)
         {
@@ -4060,11 +5298,9 @@ protected:
 
             add_as_internal_array(merged_array);
 
+            // the heaps keep their memory
             for (size_t i = 0; i < m_num_insertion_heaps; ++i)
-            {
                 m_proc[i]->insertion_heap.clear();
-                m_proc[i]->insertion_heap.reserve(m_insertion_heap_capacity);
-            }
             m_minima.clear_heaps();
         }
         else
@@ -4076,11 +5312,15 @@ protected:
                 if (insheap.size() == 0) continue;
 
                 add_as_internal_array(insheap);
-
-                // reserve new insertion heap
-                insheap.reserve(m_insertion_heap_capacity);
             }
 
+            // reserve new insertion heaps, each by the thread of its id
+#if STXXL_PARALLEL
+            #pragma omp parallel for num_threads(m_num_insertion_heaps) schedule(static, 1)
+#endif
+            for (long i = 0; i < static_cast<long>(m_num_insertion_heaps); ++i)
+                reserve_insertion_heap(i);
+
             m_minima.clear_heaps();
         }
 
@@ -4099,6 +5339,9 @@ protected:
 
         m_stats.num_internal_array_flushes++;
         m_stats.internal_array_flush_time.start();
+        phase_stats_type::scoped_timer phase_timer(
+            m_phase_stats, phase_stats_type::internal_array_merge);
+        STXXL_TRACE_SPAN(span, "ppq::flush_internal_arrays");
 
         m_minima.clear_internal_arrays();
 
@@ -4177,7 +5420,7 @@ protected:
 
         // update EA level and potentially merge
         ++m_external_levels[0];
-        check_external_level(0);
+        check_external_levels();
 
         resize_read_pool();
         // Rebuild hint tree completely as the hint sequence may have changed.
@@ -4207,6 +5450,23 @@ protected:
         }
     };
 
+    //! Merges the full external levels, lowest first, until the merges exceed
+    //! c_merge_io_budget. The remaining full levels are merged by the next
+    //! call.
+    void check_external_levels()
+    {
+        m_merge_io_spent = 0;
+
+        for (size_t level = 0; level + 1 < kMaxExternalLevels; ++level)
+        {
+            if (c_merge_io_budget != 0 && m_merge_io_spent >= c_merge_io_budget) {
+                TLX_LOG << "Merge I/O budget exhausted, deferring level " << level;
+                break;
+            }
+            check_external_level(level);
+        }
+    }
+
     //! Merges external arrays if there are too many external arrays on
     //! the same level.
     void check_external_level(const size_t level, const bool force_merge_all = false)
@@ -4239,7 +5499,11 @@ protected:
             return;
         m_mem_left -= external_array_type::int_memory(level_size);
 
-        assert(force_merge_all || c_max_external_level_size == ea_index.size());
+        phase_stats_type::scoped_timer phase_timer(
+            m_phase_stats, phase_stats_type::external_array_merge);
+
+        // levels deferred by check_external_levels() may hold more arrays
+        assert(force_merge_all || c_max_external_level_size <= ea_index.size());
         const size_t num_arrays_to_merge = ea_index.size();
 
         TLX_LOG << "merging external arrays" <<
@@ -4291,6 +5555,7 @@ protected:
                 // === fill available memory with read blocks ===
                 while (m_mem_left >= block_size) {
                     block_type* new_block = new block_type();
+                    lock_blocks(new_block);
                     m_pool.add_prefetch(new_block);
                     ++m_num_read_blocks;
                     m_mem_left -= block_size;
@@ -4347,6 +5612,8 @@ protected:
                 for (size_t i = 0; i < num_arrays_to_merge; ++i) {
                     const size_t index = ea_index[i];
 
+                    phase_stats_type::scoped_timer wait_timer(
+                        m_phase_stats, phase_stats_type::read_wait);
                     const size_t used_blocks =
                         m_external_arrays[index].wait_all_hinted_blocks();
 
@@ -4438,8 +5705,7 @@ protected:
 
         TLX_LOG << "Merge done of new ea " << &ea;
 
-        if (!force_merge_all)
-            check_external_level(level + 1);
+        m_merge_io_spent += level_size * sizeof(value_type);
 
         check_invariants();
     }
@@ -4538,6 +5804,9 @@ protected:
      */
     void flush_array_internal(std::vector<value_type>& values)
     {
+        STXXL_TRACE_SPAN(span, "ppq::flush_array");
+        span.add_bytes(values.size() * sizeof(value_type));
+
         potentially_parallel::sort(values.begin(), values.end(), m_inv_compare);
 
         // flush until enough memory for new array
@@ -4696,6 +5965,9 @@ protected:
     };
 
     stats_type m_stats;
+
+    //! live statistics of the expensive phases
+    phase_stats_type m_phase_stats;
 };
 
 } // namespace stxxl
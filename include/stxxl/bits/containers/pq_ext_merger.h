@@ -18,11 +18,13 @@
 
 #include <algorithm>
 #include <deque>
+#include <functional>
 #include <utility>
 #include <vector>
 
 #include <tlx/logger/core.hpp>
 
+#include <stxxl/bits/common/alloc_strategy.h>
 #include <stxxl/bits/containers/pq_mergers.h>
 #include <stxxl/types>
 
@@ -41,7 +43,7 @@ namespace priority_queue_local {
  * \param Arity  maximum arity of merger, does not need to be a power of 2
  */
 template <class BlockType, class CompareType, unsigned Arity,
-          class AllocStr = foxxll::default_alloc_strategy>
+          class AllocStr = runtime_alloc_strategy>
 class ext_merger
 {
     static constexpr bool debug = false;
@@ -210,12 +212,18 @@ protected:
 
     compare_type cmp;
 
+    //! number of sequences merged, at most arity, each has its own block
+    size_t m_arity;
+
 public:
-    explicit ext_merger(const compare_type& cmp = compare_type()) // TODO: pass pool as parameter
-        : tree(cmp, *this),
+    //! Construct an empty merger of at most arity_limit <= Arity sequences.
+    explicit ext_merger(const compare_type& cmp = compare_type(),
+                        size_t arity_limit = Arity) // TODO: pass pool as parameter
+        : tree(cmp, *this, arity_limit),
           pool(nullptr),
           m_size(0),
-          cmp(cmp)
+          cmp(cmp),
+          m_arity(arity_limit)
     {
         init();
 
@@ -230,7 +238,7 @@ public:
     virtual ~ext_merger()
     {
         TLX_LOG << "ext_merger::~ext_merger()";
-        for (size_t i = 0; i < arity; ++i)
+        for (size_t i = 0; i < m_arity; ++i)
         {
             delete states[i].block;
         }
@@ -317,21 +325,21 @@ protected:
             new (&states[i])sequence_state(cmp);
 
         sentinel_block = nullptr;
-        if (arity < kMaxArity)
+        if (m_arity < kMaxArity)
         {
             sentinel_block = new block_type;
             for (size_t i = 0; i < block_type::size; ++i)
                 (*sentinel_block)[i] = tree.cmp.min_value();
 
             // same memory consumption, but smaller merge width, better use arity = kMaxArity
-            TLX_LOGC(arity + 1 == kMaxArity)
+            TLX_LOGC(m_arity + 1 == kMaxArity)
                 << "inefficient PQ parameters for ext_merger: arity + 1 == kMaxArity";
         }
 
         for (size_t i = 0; i < kMaxArity; ++i)
         {
             states[i].merger = this;
-            if (i < arity)
+            if (i < m_arity)
                 states[i].block = new block_type;
             else
                 states[i].block = sentinel_block;
@@ -356,7 +364,7 @@ protected:
 public:
     size_t mem_cons() const // only rough estimation
     {
-        return (std::min<size_t>(arity + 1, kMaxArity) * block_type::raw_size);
+        return (std::min<size_t>(m_arity + 1, kMaxArity) * block_type::raw_size);
     }
 
     //! Whether there is still space for new array
@@ -467,6 +475,85 @@ public:
         tree.update_on_insert((index + tree.k) >> 1, states[index].current_front(), index);
     }
 
+    /*!
+     * Merge all items from another merger, drop those for which the filter
+     * returns true, and insert the remaining ones as a new external array into
+     * the merger. Blocks are allocated for segment_size items, those not needed
+     * are freed again; the last block of the array is padded with sentinels.
+     * Requires: is_space_available() == 1
+     * \return number of items inserted
+     */
+    template <class Merger, class Filter>
+    size_type append_merger(Merger& another_merger, size_type segment_size,
+                            Filter& filter)
+    {
+        TLX_LOG << "ext_merger::append_merger(merger,...,filter)" << this;
+
+        if (segment_size == 0)
+            return 0;
+
+        // at most as many blocks as for the unfiltered segment
+        size_t nblocks = static_cast<size_t>(segment_size / block_type::size);
+        size_t first_size = static_cast<size_t>(segment_size % block_type::size);
+        if (first_size == 0)
+        {
+            first_size = block_type::size;
+            --nblocks;
+        }
+
+        size_type rest = segment_size;
+
+        // fill the first block and move its items to its end
+        block_type* first_block = new block_type;
+        value_type* first_begin = first_block->begin() + (block_type::size - first_size);
+        const size_t first_kept = merge_filtered(
+            another_merger, rest, first_begin, first_size, filter);
+        std::copy_backward(first_begin, first_begin + first_kept, first_block->end());
+
+        if (first_kept == 0)
+        {
+            // all items were dropped
+            assert(rest == 0);
+            delete first_block;
+            return 0;
+        }
+
+        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+        bid_container_type bids(nblocks);
+        bm->new_blocks(alloc_strategy(), bids.begin(), bids.end());
+
+        assert(pool->size_write() > 0);
+
+        size_type inserted = first_kept;
+        size_t used = 0;
+        for ( ; used < nblocks && rest > 0; ++used)
+        {
+            block_type* b = pool->steal();
+            const size_t kept = merge_filtered(
+                another_merger, rest, b->begin(), block_type::size, filter);
+            std::fill(b->begin() + kept, b->end(), cmp.min_value());
+            inserted += kept;
+            pool->write(b, bids[used]);
+            TLX_LOG << "written to block " << bids[used] << " cached in " << b;
+        }
+        assert(rest == 0);
+
+        bm->delete_blocks(bids.begin() + used, bids.end());
+        bids.resize(used);
+
+        // allocate a new player slot
+        const size_t index = tree.new_player();
+
+        insert_segment(bids, first_block, first_kept, index);
+
+        m_size += inserted;
+
+        // propagate new information up the tree
+        tree.update_on_insert((index + tree.k) >> 1, states[index].current_front(), index);
+
+        return inserted;
+    }
+
     // delete the (length = end-begin) smallest elements and write them to [begin..end)
     // empty segments are deallocated
     // requires:
@@ -485,9 +572,40 @@ public:
 #endif
     }
 
+protected:
+    //! Merge items from another merger into [out, out + n), at most rest, and
+    //! drop those for which the filter returns true, until n items are kept.
+    //! \return number of items kept
+    template <class Merger, class Filter>
+    size_t merge_filtered(Merger& another_merger, size_type& rest,
+                          value_type* out, size_t n, Filter& filter)
+    {
+        size_t kept = 0;
+        while (kept < n && rest > 0)
+        {
+            const size_t length = static_cast<size_t>(
+                std::min<size_type>(n - kept, rest));
+            another_merger.multi_merge(out + kept, out + kept + length);
+            rest -= length;
+            kept = std::remove_if(out + kept, out + kept + length,
+                                  std::ref(filter)) - out;
+        }
+        return kept;
+    }
+
 #if STXXL_PARALLEL && STXXL_PARALLEL_PQ_MULTIWAY_MERGE_EXTERNAL
 
-protected:
+    //! End of the items of the sequence's current block, the last block of a
+    //! sequence may be padded with sentinels.
+    typename block_type::iterator block_end(sequence_state& state)
+    {
+        if (!state.bids.empty())
+            return state.block->end();
+        invert_order<compare_type, value_type, value_type> inv_cmp(tree.cmp);
+        return std::lower_bound(state.block->begin() + state.current, state.block->end(),
+                                tree.cmp.min_value(), inv_cmp);
+    }
+
     //! extract the (length = end - begin) smallest elements using parallel
     //! multiway_merge.
 
@@ -513,7 +631,7 @@ protected:
             if (states[i].current == states[i].block->size || is_sentinel(states[i].current_front()))
                 continue;
 
-            seqs.push_back(std::make_pair(states[i].block->begin() + states[i].current, states[i].block->end()));
+            seqs.push_back(std::make_pair(states[i].block->begin() + states[i].current, block_end(states[i])));
             orig_seq_index.push_back(i);
 
 #if STXXL_CHECK_ORDER_IN_SORTS
@@ -621,7 +739,7 @@ protected:
                 {
                     // has run empty?
 
-                    assert(state.current == state.block->size);
+                    assert(state.current == state.block->size || state.bids.empty());
                     if (state.bids.empty())
                     {
                         // if there is no next block
@@ -647,7 +765,7 @@ protected:
                         if (!(state.bids.empty()))
                             pool->hint(state.bids.front());  // re-hint, reading might have made a block free
                         state.current = 0;
-                        seqs[i] = std::make_pair(state.block->begin() + state.current, state.block->end());
+                        seqs[i] = std::make_pair(state.block->begin() + state.current, block_end(state));
                         foxxll::block_manager::get_instance()->delete_block(bid);
 
 #if STXXL_CHECK_ORDER_IN_SORTS
@@ -56,6 +56,11 @@
 #ifndef STXXL_PARALLEL_PQ_MULTIWAY_MERGE_DELETE_BUFFER
 #define STXXL_PARALLEL_PQ_MULTIWAY_MERGE_DELETE_BUFFER 1
 #endif
+// refill the group buffers of priority_queue concurrently, off by default
+// since it only pays off for large group buffers
+#ifndef STXXL_PARALLEL_PQ_REFILL_GROUPS
+#define STXXL_PARALLEL_PQ_REFILL_GROUPS 0
+#endif
 
 #endif //STXXL_PARALLEL
 
@@ -184,6 +189,23 @@ public:
     }
 };
 
+/*!
+ * Default entry filter of priority_queue: no entry is discarded. An entry
+ * filter is called once for each entry merged into a new sequence and returns
+ * true if the entry is dead and shall be dropped instead of being written.
+ */
+struct keep_all_entries
+{
+    //! whether the priority_queue has to call the filter at all
+    static constexpr bool enabled = false;
+
+    template <typename ValueType>
+    bool operator () (const ValueType&) const
+    {
+        return false;
+    }
+};
+
 //! Inverts the order of a comparison functor by swapping its arguments.
 template <class Predicate, typename FirstType, typename SecondType>
 class invert_order
@@ -157,8 +157,10 @@ public:
     //! \}
 
 public:
-    explicit int_merger(const compare_type& c = compare_type())
-        : tree(c, *this),
+    //! Construct an empty merger of at most arity_limit <= MaxArity sequences.
+    explicit int_merger(const compare_type& c = compare_type(),
+                        size_t arity_limit = MaxArity)
+        : tree(c, *this, arity_limit),
           sentinel(c.min_value()),
           mem_cons_(0),
           m_size(0)
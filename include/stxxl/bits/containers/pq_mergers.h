@@ -18,10 +18,12 @@
 
 #include <algorithm>
 #include <iostream>
+#include <type_traits>
 #include <utility>
 
 #include <tlx/meta/log2.hpp>
 
+#include <stxxl/bits/common/comparator.h>
 #include <stxxl/bits/containers/pq_helpers.h>
 
 namespace stxxl {
@@ -280,6 +282,8 @@ public:
     size_t k;
     //! log of current tree size
     size_t logK;
+    //! number of player slots used, at most arity
+    size_t m_arity;
 
     // only entries 0 .. arity-1 may hold actual sequences, the other
     // entries arity .. max_arity-1 are sentinels to make the size of the tree
@@ -302,10 +306,45 @@ protected:
     //! stack of free player indices
     internal_bounded_stack<size_t, arity> free_slots;
 
+    //! whether matches are played by conditional moves, see
+    //! is_branchless_comparable
+    static constexpr bool branchless =
+        is_branchless_comparable<value_type, compare_type>::value;
+
+    //! Play the winner against the loser at pos, leaves the loser at pos.
+    void play(Entry* pos, value_type& winner_key, size_t& winner_index,
+              std::false_type)
+    {
+        if (cmp(winner_key, pos->key))
+        {
+            value_type key = pos->key;
+            size_t index = pos->index;
+            pos->key = winner_key;
+            pos->index = winner_index;
+            winner_key = key;
+            winner_index = index;
+        }
+    }
+
+    //! Play the winner against the loser at pos without branching on the
+    //! outcome, both are always written.
+    void play(Entry* pos, value_type& winner_key, size_t& winner_index,
+              std::true_type)
+    {
+        const value_type key = pos->key;
+        const size_t index = pos->index;
+        const bool lost = cmp(winner_key, key);
+        pos->key = lost ? winner_key : key;
+        pos->index = lost ? winner_index : index;
+        winner_key = lost ? key : winner_key;
+        winner_index = lost ? index : winner_index;
+    }
+
 public:
-    loser_tree(const compare_type& c, arrays_type& a)
-        : cmp(c), k(1), logK(0), arrays(a)
+    loser_tree(const compare_type& c, arrays_type& a, size_t arity_limit = arity)
+        : cmp(c), k(1), logK(0), m_arity(arity_limit), arrays(a)
     {
+        assert(m_arity >= 1 && m_arity <= arity);
         // verify strict weak ordering
         assert(!cmp(cmp.min_value(), cmp.min_value()));
     }
@@ -357,7 +396,7 @@ public:
     //! Whether there is still space for new array
     bool is_space_available() const
     {
-        return (k < arity) || !free_slots.empty();
+        return (k < m_arity) || !free_slots.empty();
     }
 
     //! rebuild loser tree information from the values in current
@@ -477,14 +516,14 @@ public:
     {
         TLX_LOG << "double_k (before) k=" << k << " logK=" << logK << " arity=" << arity << " max_arity=" << max_arity << " #free=" << free_slots.size();
         assert(k > 0);
-        assert(k < arity);
+        assert(k < m_arity);
         assert(free_slots.empty());             // stack was free (probably not needed)
 
         // make all new entries free and push them on the free stack
         for (size_t i = 2 * k - 1; i >= k; i--) //backwards
         {
             arrays.make_array_sentinel(i);
-            if (i < arity)
+            if (i < m_arity)
                 free_slots.push(i);
         }
 
@@ -547,7 +586,7 @@ public:
         {
             assert(!arrays.is_array_allocated(last_empty));
             arrays.make_array_sentinel(last_empty);
-            if (last_empty < arity)
+            if (last_empty < m_arity)
                 free_slots.push(last_empty);
         }
 
@@ -585,9 +624,6 @@ public:
     template <class OutputIterator>
     void multi_merge_k(OutputIterator begin, OutputIterator end)
     {
-        Entry* current_pos;
-        value_type current_key;
-        size_t current_index; // leaf pointed to by current entry
         size_t winner_index = entry[0].index;
         value_type winner_key = entry[0].key;
 
@@ -607,18 +643,8 @@ public:
 
             // go up the entry-tree
             for (size_t i = (winner_index + k) >> 1; i > 0; i >>= 1)
-            {
-                current_pos = entry + i;
-                current_key = current_pos->key;
-                if (cmp(winner_key, current_key))
-                {
-                    current_index = current_pos->index;
-                    current_pos->key = winner_key;
-                    current_pos->index = winner_index;
-                    winner_key = current_key;
-                    winner_index = current_index;
-                }
-            }
+                play(entry + i, winner_key, winner_index,
+                     std::integral_constant<bool, branchless>());
         }
         entry[0].index = winner_index;
         entry[0].key = winner_key;
@@ -650,14 +676,8 @@ public:
     if (1 << LogK >= 1 << L) {                                             \
         int pos_shift = ((int(LogK - L) + 1) >= 0) ? ((LogK - L) + 1) : 0; \
         Entry* pos = entry + ((winner_index + (1 << LogK)) >> pos_shift);  \
-        value_type key = pos->key;                                         \
-        if (cmp(winner_key, key)) {                                        \
-            size_t index = pos->index;                                     \
-            pos->key = winner_key;                                         \
-            pos->index = winner_index;                                     \
-            winner_key = key;                                              \
-            winner_index = index;                                          \
-        }                                                                  \
+        play(pos, winner_key, winner_index,                                \
+             std::integral_constant<bool, branchless>());                  \
     }
             TreeStep(10);
             TreeStep(9);
@@ -816,6 +836,8 @@ public:
     size_t k;
     //! log of current tree size
     size_t logK;
+    //! number of player slots used, at most arity
+    size_t m_arity;
 
 protected:
     //! reference to the linked arrays
@@ -825,9 +847,11 @@ protected:
     internal_bounded_stack<size_t, arity> free_slots;
 
 public:
-    parallel_merger_adapter(const compare_type& c, arrays_type& a)
-        : cmp(c), k(1), logK(0), arrays(a)
+    parallel_merger_adapter(const compare_type& c, arrays_type& a,
+                            size_t arity_limit = arity)
+        : cmp(c), k(1), logK(0), m_arity(arity_limit), arrays(a)
     {
+        assert(m_arity >= 1 && m_arity <= arity);
         // verify strict weak ordering
         assert(!cmp(cmp.min_value(), cmp.min_value()));
     }
@@ -874,7 +898,7 @@ public:
     //! Whether there is still space for new array
     bool is_space_available() const
     {
-        return (k < arity) || !free_slots.empty();
+        return (k < m_arity) || !free_slots.empty();
     }
 
     //! Initial call to recursive update_on_insert
@@ -888,14 +912,14 @@ public:
     {
         TLX_LOG << "double_k (before) k=" << k << " logK=" << logK << " arity=" << arity << " max_arity=" << max_arity << " #free=" << free_slots.size();
         assert(k > 0);
-        assert(k < arity);
+        assert(k < m_arity);
         assert(free_slots.empty());             // stack was free (probably not needed)
 
         // make all new entries free and push them on the free stack
         for (size_t i = 2 * k - 1; i >= k; i--) //backwards
         {
             arrays.make_array_sentinel(i);
-            if (i < arity)
+            if (i < m_arity)
                 free_slots.push(i);
         }
 
@@ -955,7 +979,7 @@ public:
         {
             assert(!arrays.is_array_allocated(last_empty));
             arrays.make_array_sentinel(last_empty);
-            if (last_empty < arity)
+            if (last_empty < m_arity)
                 free_slots.push(last_empty);
         }
 
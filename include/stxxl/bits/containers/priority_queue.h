@@ -21,13 +21,17 @@
 #define STXXL_CONTAINERS_PRIORITY_QUEUE_HEADER
 
 #include <algorithm>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <tlx/logger/core.hpp>
 
+#include <stxxl/bits/common/alloc_strategy.h>
+#include <stxxl/bits/common/task_runtime.h>
 #include <stxxl/bits/containers/pq_ext_merger.h>
 #include <stxxl/bits/containers/pq_helpers.h>
 #include <stxxl/bits/containers/pq_int_merger.h>
@@ -46,7 +50,7 @@ template <
     size_t BlockSize_ = (2* 1024* 1024),         // external block size
     size_t ExtKMAX_ = 64,                        // maximal arity for external mergers
     size_t ExtLevels_ = 2,                       // number of external groups
-    class AllocStr_ = foxxll::default_alloc_strategy
+    class AllocStr_ = runtime_alloc_strategy
     >
 struct priority_queue_config
 {
@@ -73,7 +77,22 @@ namespace stxxl {
 //! External priority queue data structure \n
 //! <b> Introduction </b> to priority queue container: see \ref tutorial_pqueue tutorial. \n
 //! <b> Design and Internals </b> of priority queue container: see \ref design_pqueue.
-template <class ConfigType>
+//!
+//! The optional EntryFilter is called for each element merged into a new
+//! sequence, elements for which it returns true are dropped instead of being
+//! stored, see priority_queue_local::keep_all_entries. This allows discarding
+//! elements invalidated lazily, as addressable_priority_queue does.
+//!
+//! With set_bound(), at most bound elements are popped in total, such that
+//! the queue selects the largest bound elements of a stream. Elements that
+//! cannot be popped anymore are discarded: each sorted sequence of at least
+//! bound elements raises a threshold, the remaining bound-th largest element,
+//! below which pushed elements are dropped before entering the insertion
+//! heap, and merged sequences are truncated when they are moved to the next
+//! group. If bound is much smaller than the number of elements pushed, most
+//! of them never reach external memory.
+template <class ConfigType,
+          class EntryFilter = priority_queue_local::keep_all_entries>
 class priority_queue
 {
     static constexpr bool debug = false;
@@ -97,6 +116,8 @@ public:
     //! Comparison object.
     using comparator_type = typename Config::comparator_type;
     using alloc_strategy_type = typename Config::alloc_strategy_type;
+    //! Filter of dead elements.
+    using entry_filter_type = EntryFilter;
     using size_type = external_size_type;
     //! Type of the block used in disk-memory transfers
     using block_type = foxxll::typed_block<BlockSize, value_type>;
@@ -117,7 +138,8 @@ public:
           pool_owned(false),
           delete_buffer_end(delete_buffer + kDeleteBufferSize),
           insert_heap(N + 2, comp_),
-          num_active_groups(0), size_(0)
+          num_active_groups(0), size_(0), num_batches_(0),
+          m_bound(unbounded), m_has_threshold(false)
     {
         TLX_LOG << "priority_queue(pool)";
         init();
@@ -139,7 +161,8 @@ public:
           pool_owned(true),
           delete_buffer_end(delete_buffer + kDeleteBufferSize),
           insert_heap(N + 2, comp_),
-          num_active_groups(0), size_(0)
+          num_active_groups(0), size_(0), num_batches_(0),
+          m_bound(unbounded), m_has_threshold(false)
     {
         TLX_LOG << "priority_queue(pool sizes)";
         init();
@@ -193,6 +216,7 @@ public:
         std::swap(insert_heap, obj.insert_heap);
         std::swap(num_active_groups, obj.num_active_groups);
         std::swap(size_, obj.size_);
+        std::swap(num_batches_, obj.num_batches_);
     }
 #endif
 
@@ -203,15 +227,24 @@ public:
     //! \return number of elements contained
     size_type size() const
     {
-        return size_ +
-               insert_heap.size() - 1 +
-               (delete_buffer_end - delete_buffer_current_min);
+        const size_type stored = size_ +
+                                 insert_heap.size() - 1 +
+                                 (delete_buffer_end - delete_buffer_current_min);
+        // elements beyond the bound are never popped
+        return stored < m_bound ? stored : m_bound;
     }
 
     //! Returns true if queue has no elements.
     //! \return \b true if queue has no elements, \b false otherwise
     bool empty() const { return (size() == 0); }
 
+    //! Returns the number of elements that may still be popped, see
+    //! set_bound(), or the maximum of size_type if the queue is unbounded.
+    size_type bound() const
+    {
+        return m_bound;
+    }
+
     //! \}
 
     //! \name Operators
@@ -230,7 +263,7 @@ public:
     {
         assert(!insert_heap.empty());
 
-        const typename priority_queue<ConfigType>::value_type& t = insert_heap.top();
+        const value_type& t = insert_heap.top();
         if (/*(!insert_heap.empty()) && */ cmp(*delete_buffer_current_min, t))
             return t;
         else
@@ -251,6 +284,10 @@ public:
     {
         //TLX_LOG << "priority_queue::pop()";
         assert(!insert_heap.empty());
+        assert(!empty());
+
+        if (m_bound != unbounded)
+            --m_bound;
 
         if (/*(!insert_heap.empty()) && */ cmp(*delete_buffer_current_min, insert_heap.top()))
             insert_heap.pop();
@@ -270,6 +307,9 @@ public:
     void push(const value_type& obj)
     {
         assert(!int_mergers->is_sentinel(obj));
+        if (m_bound != unbounded && (m_bound == 0 || below_threshold(obj)))
+            return;
+
         if (insert_heap.size() == N + 1)
             empty_insert_heap();
 
@@ -278,11 +318,162 @@ public:
         insert_heap.push(obj);
     }
 
+    //! Inserts the elements of [first, last) into the priority_queue.
+    //!
+    //! A batch of at least N elements is sorted and inserted as one sequence
+    //! into the first internal group, bypassing the insertion heap; smaller
+    //! batches are pushed one by one. Postcondition: \c size() will be
+    //! incremented by the number of elements.
+    template <typename InputIterator>
+    void push(InputIterator first, InputIterator last)
+    {
+        std::vector<value_type> batch(first, last);
+        if (m_bound != unbounded)
+        {
+            if (m_bound == 0)
+                return;
+            batch.erase(std::remove_if(batch.begin(), batch.end(),
+                                       [this](const value_type& obj) {
+                                           return below_threshold(obj);
+                                       }),
+                        batch.end());
+        }
+        if (batch.size() < size_t(N))
+        {
+            for (const value_type& obj : batch)
+                push(obj);
+            return;
+        }
+
+        TLX_LOG << "priority_queue::push(batch of " << batch.size() << ")";
+
+        const size_t length = batch.size();
+        value_type* newSegment = new value_type[length + 1];
+        std::copy(batch.begin(), batch.end(), newSegment);
+        std::vector<value_type>().swap(batch);
+
+        for (size_t i = 0; i < length; ++i)
+            assert(!int_mergers->is_sentinel(newSegment[i]));
+
+        // sort descending, the largest element is popped first
+        check_sort_settings();
+        priority_queue_local::invert_order<comparator_type, value_type, value_type> inv_cmp(cmp);
+        potentially_parallel::sort(newSegment, newSegment + length, inv_cmp);
+
+        insert_segment(newSegment, length);
+    }
+
+    //! Removes up to n elements from the top and writes them to out, largest
+    //! first.
+    //!
+    //! Runs of the delete buffer are copied at once and refilled in bulk
+    //! instead of checking for a refill after each element.
+    //! \return number of elements removed, less than n if the queue became
+    //! empty
+    template <typename OutputIterator>
+    size_t pop_bulk(OutputIterator out, size_t n)
+    {
+        if (m_bound < n)
+            n = static_cast<size_t>(m_bound);
+
+        size_t popped = 0;
+        while (popped < n && !empty())
+        {
+            const value_type& t = insert_heap.top();
+            if (cmp(*delete_buffer_current_min, t))
+            {
+                *out = t;
+                ++out;
+                insert_heap.pop();
+                ++popped;
+                continue;
+            }
+
+            // copy the run of the delete buffer preceding the heap's top
+            value_type* run_end = delete_buffer_current_min;
+            const size_t limit = std::min<size_t>(
+                n - popped, delete_buffer_end - delete_buffer_current_min);
+            while (size_t(run_end - delete_buffer_current_min) < limit &&
+                   !cmp(*run_end, t))
+                ++run_end;
+
+            out = std::copy(delete_buffer_current_min, run_end, out);
+            popped += run_end - delete_buffer_current_min;
+            delete_buffer_current_min = run_end;
+            if (delete_buffer_current_min == delete_buffer_end)
+                refill_delete_buffer();
+        }
+
+        if (m_bound != unbounded)
+            m_bound -= popped;
+        return popped;
+    }
+
+    //! Limits the number of elements popped from now on to bound, elements
+    //! that would only be popped afterwards are discarded. Call this on an
+    //! empty queue, the queue then keeps the largest bound elements pushed.
+    //! Not available with an EntryFilter, whose elements may die after they
+    //! raised the threshold.
+    void set_bound(size_type bound)
+    {
+        static_assert(!entry_filter_type::enabled,
+                      "bounded priority_queue with an entry filter");
+        m_bound = bound;
+        m_has_threshold = false;
+    }
+
+    //! Moves all elements of the insertion heap and the internal groups into
+    //! the external groups, which frees the memory of the internal groups
+    //! apart from the fixed size buffers, e.g. to give back the memory of an
+    //! idle queue, see priority_queue_memory_manager. Does nothing if the
+    //! queue has no external groups.
+    void spill()
+    {
+        if (kNumExtGroups == 0)
+            return;
+
+        TLX_LOG << "spill()";
+
+        if (insert_heap.size() > 1)
+        {
+            // the sentinel sorts to the end of the segment
+            const size_t length = insert_heap.size() - 1;
+            value_type* newSegment = new value_type[length + 1];
+            value_type* SortTo = newSegment;
+            insert_heap.sort_to(SortTo);
+            insert_heap.clear();
+            insert_heap.push(newSegment[length]);
+            insert_segment(newSegment, length);
+        }
+
+        // from the last internal group down, moving a group may return the
+        // elements of invalidated group buffers to it
+        for (size_t level = kNumIntGroups; level-- > 0; )
+        {
+            while (int_mergers[level].size() != 0)
+                move_to_external(level);
+        }
+    }
+
     //! \}
 
     //! \name Miscellaneous
     //! \{
 
+    //! Number of batches the queue processed, i.e. of sequences inserted and
+    //! of refills of the delete buffer, which grows with the rate of
+    //! operations.
+    external_size_type num_batches() const
+    {
+        return num_batches_;
+    }
+
+    //! The filter of dead elements.
+    entry_filter_type & entry_filter()
+    {
+        return m_filter;
+    }
+
     //! Number of bytes consumed by the \b priority_queue from the internal
     //! memory not including pools (see the constructor)
     size_t mem_cons() const
@@ -347,6 +538,8 @@ protected:
 
     comparator_type cmp;
 
+    entry_filter_type m_filter;
+
     // this is realy hacky: int_merger_buffer does not have a default constructor
     char int_merger_buffer[kNumIntGroups * sizeof(int_merger_type)];
     int_merger_type* int_mergers;
@@ -373,6 +566,38 @@ protected:
     // total size not counting insert_heap and delete_buffer
     size_type size_;
 
+    // number of sequences inserted and of refills of the delete_buffer
+    external_size_type num_batches_;
+
+    static constexpr size_type unbounded = std::numeric_limits<size_type>::max();
+
+    //! number of elements that may still be popped, or unbounded
+    size_type m_bound;
+
+    //! whether m_threshold is set: in bounded mode, at least m_bound stored
+    //! elements are not smaller than m_threshold, hence smaller ones are
+    //! never popped
+    bool m_has_threshold;
+    value_type m_threshold;
+
+    //! Filter dropping the elements below the threshold of a bounded queue,
+    //! called for the elements of a sequence in descending order: the
+    //! bound-th element kept raises the threshold.
+    struct threshold_filter
+    {
+        priority_queue& pq;
+        size_type kept;
+
+        bool operator () (const value_type& obj)
+        {
+            if (pq.below_threshold(obj))
+                return true;
+            if (++kept == pq.m_bound)
+                pq.raise_threshold(obj);
+            return false;
+        }
+    };
+
 private:
     void init()
     {
@@ -403,8 +628,57 @@ private:
     void refill_delete_buffer()
     {
         TLX_LOG << "refill_delete_buffer()";
+        ++num_batches_;
 
         size_type total_group_size = 0;
+#if STXXL_PARALLEL && STXXL_PARALLEL_PQ_REFILL_GROUPS
+        // refill the group buffers concurrently: one task per internal group
+        // and one for all external groups, which share the block pool
+        size_type lengths[kTotalNumGroups];
+        bool refilled[kTotalNumGroups];
+        size_t tasks[kNumIntGroups + 1];
+        size_t num_tasks = 0;
+        bool refill_ext = false;
+        for (size_t i = 0; i < num_active_groups; ++i)
+        {
+            refilled[i] = current_group_buffer_size(i) < kDeleteBufferSize;
+            if (refilled[i] && i < kNumIntGroups)
+                tasks[num_tasks++] = i;
+            else if (refilled[i])
+                refill_ext = true;
+        }
+        if (refill_ext)
+            tasks[num_tasks++] = kNumIntGroups;
+
+        parallel_for(
+            0, num_tasks, [&](size_t t) {
+                if (tasks[t] < kNumIntGroups)
+                {
+                    lengths[tasks[t]] = refill_group_buffer(tasks[t]);
+                    return;
+                }
+                for (size_t i = kNumIntGroups; i < num_active_groups; ++i)
+                {
+                    if (refilled[i])
+                        lengths[i] = refill_group_buffer(i);
+                }
+            });
+
+        for (size_t i = num_active_groups; i > 0; )
+        {
+            --i;
+            if (refilled[i])
+            {
+                // max active level dry now?
+                if (lengths[i] == 0 && i == num_active_groups - 1)
+                    --num_active_groups;
+
+                total_group_size += lengths[i];
+            }
+            else
+                total_group_size += kDeleteBufferSize;  // actually only a sufficient lower bound
+        }
+#else
         //num_active_groups is <= 4
         for (size_t i = num_active_groups; i > 0; )
         {
@@ -421,6 +695,7 @@ private:
             else
                 total_group_size += kDeleteBufferSize;  // actually only a sufficient lower bound
         }
+#endif
 
         size_type length;
         if (total_group_size >= kDeleteBufferSize)      // buffer can be filled completely
@@ -643,7 +918,7 @@ private:
             TLX_LOG << "Inserting segment into last level external: " << level << " " << segmentSize;
             ext_merger_type* overflow_merger = new ext_merger_type(cmp);
             overflow_merger->set_pool(pool);
-            overflow_merger->append_merger(*ext_mergers[extLevel], segmentSize);
+            append_to_ext(*overflow_merger, *ext_mergers[extLevel], segmentSize);
             std::swap(ext_mergers[extLevel], overflow_merger);
             delete overflow_merger;
             finalLevel = level;
@@ -658,11 +933,13 @@ private:
                 value_type* newSegment = new value_type[segmentSize + 1];
                 int_mergers[level].multi_merge(newSegment, newSegment + segmentSize); // empty this level
 
-                newSegment[segmentSize] = delete_buffer[kDeleteBufferSize];           // sentinel
+                const size_t kept = drop_dead(newSegment, segmentSize);
+                size_ -= size_type(segmentSize - kept);
+                newSegment[kept] = delete_buffer[kDeleteBufferSize];                  // sentinel
                 // for queues where size << #inserts
                 // it might make sense to stay in this level if
                 // segmentSize < alpha * KNN * k^level for some alpha < 1
-                int_mergers[level + 1].append_array(newSegment, segmentSize);
+                int_mergers[level + 1].append_array(newSegment, kept);
             }
             else
             {
@@ -670,29 +947,67 @@ private:
                 {
                     const size_t segmentSize = int_mergers[kNumIntGroups - 1].size();
                     TLX_LOG << "make_space... Inserting segment into first level external: " << level << " " << segmentSize;
-                    ext_mergers[0]->append_merger(int_mergers[kNumIntGroups - 1], segmentSize);
+                    append_to_ext(*ext_mergers[0], int_mergers[kNumIntGroups - 1], segmentSize);
                 }
                 else // from external to external tree
                 {
                     const size_type segmentSize = ext_mergers[level - kNumIntGroups]->size();
                     TLX_LOG << "make_space... Inserting segment into second level external: " << level << " " << segmentSize;
-                    ext_mergers[level - kNumIntGroups + 1]->append_merger(*ext_mergers[level - kNumIntGroups], segmentSize);
+                    append_to_ext(*ext_mergers[level - kNumIntGroups + 1], *ext_mergers[level - kNumIntGroups], segmentSize);
                 }
             }
         }
         return finalLevel;
     }
 
+    //! Move the elements of an internal group into a new sequence of the
+    //! first external group. The group buffers of the groups receiving
+    //! elements may now hold smaller elements than their sequences, so these,
+    //! with the group's own buffer, are moved to the emptied group.
+    void move_to_external(const size_t level)
+    {
+        TLX_LOG << "move_to_external(" << level << ")";
+        assert(level < kNumIntGroups);
+
+        if (num_active_groups < kNumIntGroups)
+            num_active_groups = kNumIntGroups;
+
+        const size_t finalLevel = make_space_available(kNumIntGroups);
+        append_to_ext(*ext_mergers[0], int_mergers[level], int_mergers[level].size());
+
+        size_t length = current_group_buffer_size(level);
+        for (size_t i = kNumIntGroups; i <= finalLevel; ++i)
+            length += current_group_buffer_size(i);
+
+        if (length == 0)
+            return;
+
+        value_type* newSegment = new value_type[length + 1];
+        value_type* pos = newSegment;
+        for (size_t i = kNumIntGroups; i <= finalLevel + 1; ++i)
+        {
+            // the last round takes the buffer of the group itself
+            const size_t group = (i <= finalLevel) ? i : level;
+            pos = std::copy(group_buffer_current_mins[group], group_buffers[group] + N, pos);
+            group_buffer_current_mins[group] = group_buffers[group] + N; // empty
+        }
+        assert(pos == newSegment + length);
+
+        check_sort_settings();
+        priority_queue_local::invert_order<comparator_type, value_type, value_type> inv_cmp(cmp);
+        potentially_parallel::sort(newSegment, newSegment + length, inv_cmp);
+
+        newSegment[length] = get_supremum(); // sentinel
+        int_mergers[level].append_array(newSegment, length);
+    }
+
     void empty_insert_heap()
     {
         TLX_LOG << "empty_insert_heap()";
         assert(insert_heap.size() == (N + 1));
 
-        const value_type sup = get_supremum();
-
         // build new segment
         value_type* newSegment = new value_type[N + 1];
-        value_type* newPos = newSegment;
 
         // put the new data there for now
         //insert_heap.sortTo(newSegment);
@@ -706,7 +1021,28 @@ private:
 
         assert(insert_heap.size() == 1);
 
-        newSegment[N] = sup; // sentinel
+        insert_segment(newSegment, N);
+    }
+
+    //! Insert the sorted segment of length elements, which is followed by
+    //! space for a sentinel, into the first internal group; takes ownership
+    //! of the segment.
+    void insert_segment(value_type* newSegment, size_t length)
+    {
+        TLX_LOG << "insert_segment(" << length << ")";
+        ++num_batches_;
+
+        length = drop_dead(newSegment, length);
+        if (length == 0)
+        {
+            delete[] newSegment;
+            return;
+        }
+
+        const value_type sup = get_supremum();
+        value_type* newPos = newSegment;
+
+        newSegment[length] = sup; // sentinel
 
         // copy the delete_buffer and group_buffers[0] to temporary storage
         // (the temporary can be eliminated using some dirty tricks)
@@ -737,12 +1073,12 @@ private:
         // note that merge exactly trips into the footsteps
         // of itself
         priority_queue_local::merge2_iterator(pos, newPos,
-                                              newSegment, newSegment + N, cmp);
+                                              newSegment, newSegment + length, cmp);
 
         // and insert it
         const size_t freeLevel = make_space_available(0);
         assert(freeLevel == 0 || int_mergers[0].size() == 0);
-        int_mergers[0].append_array(newSegment, N);
+        int_mergers[0].append_array(newSegment, length);
 
         // get rid of invalid level 2 buffers
         // by inserting them into tree 0 (which is almost empty in this case)
@@ -761,7 +1097,7 @@ private:
         }
 
         // update size
-        size_ += size_type(N);
+        size_ += size_type(length);
 
         // special case if the tree was empty before
         if (delete_buffer_current_min == delete_buffer_end)
@@ -773,6 +1109,66 @@ private:
         return cmp.min_value();
     }
 
+    //! Whether obj is smaller than the threshold of the bounded queue.
+    bool below_threshold(const value_type& obj) const
+    {
+        return m_has_threshold && cmp(obj, m_threshold);
+    }
+
+    //! Drop the dead elements of [segment, segment + length), keeping the
+    //! order of the others, and return their number. In bounded mode, the
+    //! sorted segment raises the threshold and is truncated to the elements
+    //! not below it.
+    size_t drop_dead(value_type* segment, size_t length)
+    {
+        if (entry_filter_type::enabled)
+            length = std::remove_if(segment, segment + length, std::ref(m_filter)) - segment;
+
+        if (m_bound == unbounded)
+            return length;
+        if (m_bound == 0)
+            return 0;
+
+        // the segment is sorted descending, its bound-th element is not
+        // larger than the bound-th element of the queue
+        if (length >= m_bound)
+            raise_threshold(segment[m_bound - 1]);
+        while (length > 0 && below_threshold(segment[length - 1]))
+            --length;
+        return length;
+    }
+
+    //! Raise the threshold of the bounded queue to obj, if it is larger.
+    void raise_threshold(const value_type& obj)
+    {
+        if (!m_has_threshold || cmp(m_threshold, obj))
+        {
+            m_threshold = obj;
+            m_has_threshold = true;
+        }
+    }
+
+    //! Move segment_size elements from source into a new sequence of target,
+    //! dropping the dead ones.
+    template <class Merger>
+    void append_to_ext(ext_merger_type& target, Merger& source, const size_type segment_size)
+    {
+        if (m_bound != unbounded)
+        {
+            threshold_filter filter { *this, 0 };
+            const size_type kept = target.append_merger(source, segment_size, filter);
+            size_ -= segment_size - kept;
+            return;
+        }
+        if (!entry_filter_type::enabled)
+        {
+            target.append_merger(source, segment_size);
+            return;
+        }
+        const size_type kept = target.append_merger(source, segment_size, m_filter);
+        size_ -= segment_size - kept;
+    }
+
     size_t current_delete_buffer_size() const
     {
         return delete_buffer_end - delete_buffer_current_min;
@@ -977,9 +1373,9 @@ public:
 
 namespace std {
 
-template <class ConfigType>
-void swap(stxxl::priority_queue<ConfigType>& a,
-          stxxl::priority_queue<ConfigType>& b)   // NOLINT
+template <class ConfigType, class EntryFilter>
+void swap(stxxl::priority_queue<ConfigType, EntryFilter>& a,
+          stxxl::priority_queue<ConfigType, EntryFilter>& b)   // NOLINT
 {
     a.swap(b);
 }
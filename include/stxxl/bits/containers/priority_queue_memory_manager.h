@@ -0,0 +1,210 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/priority_queue_memory_manager.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_PRIORITY_QUEUE_MEMORY_MANAGER_HEADER
+#define STXXL_CONTAINERS_PRIORITY_QUEUE_MEMORY_MANAGER_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * Shares a budget of internal memory among several priority queues, e.g. one
+ * per stage of a time-forward processing pipeline.
+ *
+ * Each queue keeps the fixed size buffers of its configuration, but the
+ * sequences of its internal groups grow with its contents. rebalance()
+ * takes back this memory by spilling the internal groups of a queue to its
+ * external groups, see priority_queue::spill(): first of all queues which
+ * were idle since the last rebalance(), then, while the queues consume more
+ * than the budget, of the least active ones. The activity of a queue is the
+ * number of batches it processed, see priority_queue::num_batches(), which
+ * grows with its rate of operations.
+ *
+ * The queues may have different types, each providing mem_cons(), spill()
+ * and num_batches(). Queues of one block type should share one
+ * foxxll::read_write_pool, whose blocks are then used by the queues
+ * currently performing I/O.
+ */
+class priority_queue_memory_manager
+{
+    static constexpr bool debug = false;
+
+    //! type-erased interface of a managed queue
+    class queue_base
+    {
+    public:
+        virtual ~queue_base() { }
+        virtual const void * address() const = 0;
+        virtual size_t mem_cons() const = 0;
+        virtual void spill() = 0;
+        virtual external_size_type num_batches() const = 0;
+
+        //! num_batches() at the last rebalance()
+        external_size_type last_batches = 0;
+        //! mem_cons() after the last spill(), what it cannot give back
+        size_t spilled_mem = 0;
+    };
+
+    template <class PriorityQueue>
+    class queue_wrapper : public queue_base
+    {
+    public:
+        explicit queue_wrapper(PriorityQueue& pq) : m_pq(pq) { }
+
+        const void * address() const final { return &m_pq; }
+        size_t mem_cons() const final { return m_pq.mem_cons(); }
+        void spill() final { m_pq.spill(); }
+        external_size_type num_batches() const final { return m_pq.num_batches(); }
+
+    protected:
+        PriorityQueue& m_pq;
+    };
+
+    //! budget of internal memory in bytes
+    size_t m_budget;
+
+    //! managed queues
+    std::vector<std::unique_ptr<queue_base> > m_queues;
+
+    //! Spill the queue and remember what it still consumes.
+    static void spill(queue_base& q)
+    {
+        q.spill();
+        q.spilled_mem = q.mem_cons();
+    }
+
+public:
+    //! Constructs a manager of the given budget of internal memory in bytes.
+    explicit priority_queue_memory_manager(size_t budget)
+        : m_budget(budget)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    priority_queue_memory_manager(const priority_queue_memory_manager&) = delete;
+    //! non-copyable: delete assignment operator
+    priority_queue_memory_manager& operator = (const priority_queue_memory_manager&) = delete;
+
+    //! Adds the queue, which must stay alive until it is removed.
+    template <class PriorityQueue>
+    void add(PriorityQueue& pq)
+    {
+        m_queues.emplace_back(new queue_wrapper<PriorityQueue>(pq));
+        m_queues.back()->last_batches = pq.num_batches();
+    }
+
+    //! Removes the queue.
+    template <class PriorityQueue>
+    void remove(const PriorityQueue& pq)
+    {
+        m_queues.erase(
+            std::remove_if(m_queues.begin(), m_queues.end(),
+                           [&pq](const std::unique_ptr<queue_base>& q) {
+                               return q->address() == &pq;
+                           }),
+            m_queues.end());
+    }
+
+    //! Number of managed queues.
+    size_t size() const
+    {
+        return m_queues.size();
+    }
+
+    //! The budget of internal memory in bytes.
+    size_t budget() const
+    {
+        return m_budget;
+    }
+
+    //! Changes the budget, which applies from the next rebalance().
+    void set_budget(size_t budget)
+    {
+        m_budget = budget;
+    }
+
+    //! Number of bytes of internal memory consumed by all queues, not
+    //! including pools.
+    size_t mem_cons() const
+    {
+        size_t total = 0;
+        for (const auto& q : m_queues)
+            total += q->mem_cons();
+        return total;
+    }
+
+    //! Spills the idle queues and, while the budget is exceeded, the least
+    //! active ones, see the class description. Should be called regularly,
+    //! e.g. after each pipeline step.
+    //! \return number of queues spilled
+    size_t rebalance()
+    {
+        size_t num_spilled = 0;
+        size_t total = 0;
+
+        // activity since the last rebalance of the queues not idle
+        std::vector<std::pair<external_size_type, queue_base*> > active;
+
+        for (const auto& q : m_queues)
+        {
+            const external_size_type batches = q->num_batches();
+            const external_size_type activity = batches - q->last_batches;
+            q->last_batches = batches;
+
+            if (activity == 0 && q->mem_cons() > q->spilled_mem)
+            {
+                spill(*q);
+                ++num_spilled;
+            }
+
+            total += q->mem_cons();
+            if (activity != 0)
+                active.emplace_back(activity, q.get());
+        }
+
+        std::sort(active.begin(), active.end(),
+                  [](const std::pair<external_size_type, queue_base*>& a,
+                     const std::pair<external_size_type, queue_base*>& b) {
+                      return a.first < b.first;
+                  });
+
+        for (size_t i = 0; i < active.size() && total > m_budget; ++i)
+        {
+            queue_base& q = *active[i].second;
+            const size_t before = q.mem_cons();
+            spill(q);
+            total -= before - q.spilled_mem;
+            ++num_spilled;
+        }
+
+        TLX_LOG << "priority_queue_memory_manager::rebalance() spilled "
+                << num_spilled << " of " << m_queues.size()
+                << " queues, mem_cons=" << total << " budget=" << m_budget;
+
+        return num_spilled;
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_PRIORITY_QUEUE_MEMORY_MANAGER_HEADER
@@ -15,8 +15,11 @@
 #define STXXL_CONTAINERS_QUEUE_HEADER
 
 #include <algorithm>
+#include <cstring>
 #include <deque>
+#include <iterator>
 #include <queue>
+#include <stdexcept>
 #include <utility>
 #include <vector>
 
@@ -24,12 +27,16 @@
 #include <tlx/logger/core.hpp>
 
 #include <foxxll/common/tmeta.hpp>
+#include <foxxll/io/file.hpp>
 #include <foxxll/mng/block_manager.hpp>
 #include <foxxll/mng/prefetch_pool.hpp>
 #include <foxxll/mng/read_write_pool.hpp>
 #include <foxxll/mng/typed_block.hpp>
 #include <foxxll/mng/write_pool.hpp>
 
+#include <stxxl/bits/common/alloc_strategy.h>
+#include <stxxl/bits/common/binary_buffer.h>
+#include <stxxl/bits/common/prefetch_controller.h>
 #include <stxxl/bits/defines.h>
 #include <stxxl/bits/deprecated.h>
 #include <stxxl/types>
@@ -43,13 +50,17 @@ namespace stxxl {
 //! <b> Introduction </b> to queue container: see \ref tutorial_queue tutorial\n
 //! <b> Design and Internals </b> of queue container: see \ref design_queue.
 //!
+//! A queue constructed with a named file keeps its blocks in the file instead
+//! of the block manager's disks, such that a later process reopens it, see
+//! \ref design_queue_file.
+//!
 //! \tparam ValueType type of the contained objects (POD with no references to internal memory)
 //! \tparam BlockSize size of the external memory block in bytes, default is \c STXXL_DEFAULT_BLOCK_SIZE(ValueType)
-//! \tparam AllocStr parallel disk block allocation strategy, default is \c foxxll::default_alloc_strategy
+//! \tparam AllocStr parallel disk block allocation strategy, default is \c runtime_alloc_strategy
 //! \tparam SizeType size data type, default is \c external_size_type
 template <class ValueType,
           size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
-          class AllocStr = foxxll::default_alloc_strategy,
+          class AllocStr = runtime_alloc_strategy,
           class SizeType = external_size_type>
 class queue
 {
@@ -81,6 +92,35 @@ private:
     std::deque<bid_type> bids;
     foxxll::block_manager* bm;
     size_t blocks2prefetch;
+    //! whether blocks2prefetch adapts to the consumption rate
+    bool prefetch_auto = false;
+    prefetch_controller prefetcher;
+
+    //! \name Durable Queue
+    //! The blocks of a queue backed by a named file are stored in slots of
+    //! the file, slot 0 holds the header. The blocks of the queue on disk form
+    //! a chain: the front block (if on disk), the blocks in bids and the back
+    //! block (if on disk, only after reopening).
+    //! \{
+
+    //! named file backing the queue, or none
+    foxxll::file_ptr m_file;
+    //! buffer of the header block
+    block_type* m_header = nullptr;
+    //! slots of the file holding the header or a block of the chain
+    std::vector<bool> m_live_slots;
+    //! slot allocated last, allocation continues behind it
+    size_t m_last_slot = 0;
+    //! slot holding the front block, or 0 if it is only in memory
+    size_t m_front_slot = 0;
+    //! slot holding a prefix of the back block, or 0
+    size_t m_back_slot = 0;
+    //! whether the front slot holds only a prefix of the front block
+    bool m_front_partial = false;
+    //! number of elements in the last block of the chain
+    size_t m_last_count = 0;
+
+    //! \}
 
 public:
     //! \name Constructors/Destructors
@@ -142,6 +182,31 @@ public:
         init(blocks2prefetch_);
     }
 
+    //! Constructs a durable queue backed by the named file, which is
+    //! reopened if it holds a queue written by an earlier process, otherwise
+    //! the file must be empty. Only the header and the front and back block
+    //! are read, see \ref design_queue_file.
+    //!
+    //! \param file  file holding the blocks of the queue
+    //! \param w_pool_size  number of blocks in the write pool, must be at least 2
+    //! \param p_pool_size  number of blocks in the prefetch pool, recommended at least 1
+    //! \param blocks2prefetch_  defines the number of blocks to prefetch (\c front side),
+    //!                          default is number of block in the prefetch pool
+    explicit queue(foxxll::file_ptr file, const size_t w_pool_size = 3,
+                   const size_t p_pool_size = 1, int blocks2prefetch_ = -1)
+        : m_size(0),
+          delete_pool(true),
+          alloc_count(0),
+          bm(foxxll::block_manager::get_instance()),
+          m_file(file),
+          m_header(new block_type)
+    {
+        TLX_LOG << "queue[" << this << "]::queue(file)";
+        pool = new pool_type(p_pool_size, w_pool_size);
+        init(blocks2prefetch_);
+        open();
+    }
+
     //! non-copyable: delete copy-constructor
     queue(const queue&) = delete;
     //! non-copyable: delete assignment operator
@@ -166,6 +231,16 @@ public:
         std::swap(bids, obj.bids);
         std::swap(bm, obj.bm);
         std::swap(blocks2prefetch, obj.blocks2prefetch);
+        std::swap(prefetch_auto, obj.prefetch_auto);
+        std::swap(prefetcher, obj.prefetcher);
+        std::swap(m_file, obj.m_file);
+        std::swap(m_header, obj.m_header);
+        std::swap(m_live_slots, obj.m_live_slots);
+        std::swap(m_last_slot, obj.m_last_slot);
+        std::swap(m_front_slot, obj.m_front_slot);
+        std::swap(m_back_slot, obj.m_back_slot);
+        std::swap(m_front_partial, obj.m_front_partial);
+        std::swap(m_last_count, obj.m_last_count);
     }
 
     //! \}
@@ -193,6 +268,214 @@ private:
         set_prefetch_aggr(blocks2prefetch_);
     }
 
+    //! Adapts blocks2prefetch after waiting for the front block, hinting the
+    //! additional blocks or dropping the blocks no longer prefetched.
+    void adapt_prefetch(double wait_begin, double wait_end)
+    {
+        const size_t old_blocks2prefetch = blocks2prefetch;
+        blocks2prefetch = prefetcher.on_block(wait_begin, wait_end);
+
+        for (size_t i = old_blocks2prefetch; i < blocks2prefetch && i < bids.size(); ++i)
+            pool->hint(bids[i]);
+        for (size_t i = blocks2prefetch; i < old_blocks2prefetch && i < bids.size(); ++i)
+            pool->invalidate(bids[i]);
+    }
+
+    //! whether the queue is backed by a named file
+    bool durable() const
+    {
+        return m_file.get() != nullptr;
+    }
+
+    //! first word of the header of a durable queue, "STXLQUEU"
+    static uint64_t file_magic() { return 0x5354584c51554555ull; }
+
+    //! BID of a slot of the file.
+    bid_type slot_bid(size_t slot) const
+    {
+        bid_type bid;
+        bid.storage = m_file.get();
+        bid.offset = slot * block_type::raw_size;
+        return bid;
+    }
+
+    //! Allocate a slot behind the last one, wrapping around to the beginning
+    //! of the file, or append one if that slot is used.
+    size_t allocate_slot()
+    {
+        size_t slot = m_last_slot + 1;
+        if (slot >= m_live_slots.size())
+            slot = 1;
+        if (slot >= m_live_slots.size() || m_live_slots[slot])
+        {
+            slot = m_live_slots.size();
+            m_live_slots.push_back(false);
+            m_file->set_size(m_live_slots.size() * block_type::raw_size);
+        }
+        m_live_slots[slot] = true;
+        m_last_slot = slot;
+        return slot;
+    }
+
+    //! Write block synchronously into slot.
+    void write_slot(block_type* block, size_t slot)
+    {
+        block->write(slot_bid(slot))->wait();
+    }
+
+    //! Write the header describing the chain. It must be written before a
+    //! freed slot is reused, and after a new block of the chain is written,
+    //! such that the file is consistent whenever the process stops.
+    void write_header()
+    {
+        std::vector<size_t> chain;
+        if (m_front_slot != 0)
+            chain.push_back(m_front_slot);
+        for (const bid_type& bid : bids)
+            chain.push_back(static_cast<size_t>(bid.offset / block_type::raw_size));
+        if (m_back_slot != 0)
+            chain.push_back(m_back_slot);
+
+        // the elements before the front element are popped
+        size_t front_offset = 0;
+        if (m_front_slot != 0)
+        {
+            front_offset = std::min<size_t>(
+                front_element - front_block->begin(),
+                chain.size() == 1 ? m_last_count : size_t(block_type::size));
+        }
+
+        // the chain as runs of consecutive slots
+        std::vector<std::pair<size_t, size_t> > runs;
+        for (const size_t& slot : chain)
+        {
+            if (!runs.empty() && runs.back().first + runs.back().second == slot)
+                ++runs.back().second;
+            else
+                runs.emplace_back(slot, 1);
+        }
+
+        binary_buffer header;
+        header.put<uint64_t>(file_magic());
+        header.put<uint64_t>(block_type::raw_size);
+        header.put<uint64_t>(sizeof(value_type));
+        header.put<uint64_t>(front_offset);
+        header.put<uint64_t>(m_last_count);
+        header.put<uint64_t>(m_live_slots.size());
+        header.put<uint64_t>(runs.size());
+        for (const std::pair<size_t, size_t>& run : runs)
+        {
+            header.put<uint64_t>(run.first);
+            header.put<uint64_t>(run.second);
+        }
+        if (header.size() > block_type::raw_size)
+            throw std::runtime_error(
+                      "stxxl::queue: the blocks in the file are too fragmented for its header");
+
+        memcpy(static_cast<void*>(m_header), header.data(), header.size());
+        write_slot(m_header, 0);
+    }
+
+    //! Reopen the queue in the file, or write the header of an empty one.
+    void open()
+    {
+        if (m_file->size() == 0)
+        {
+            m_live_slots.assign(1, true);
+            write_header();
+            return;
+        }
+
+        m_header->read(slot_bid(0))->wait();
+        binary_reader header(static_cast<const void*>(m_header), block_type::raw_size);
+        if (header.get<uint64_t>() != file_magic() ||
+            header.get<uint64_t>() != block_type::raw_size ||
+            header.get<uint64_t>() != sizeof(value_type))
+        {
+            throw std::runtime_error(
+                      "stxxl::queue: the file holds no queue with this block and value size");
+        }
+        const size_t front_offset = header.get<uint64_t>();
+        m_last_count = header.get<uint64_t>();
+        m_live_slots.assign(header.get<uint64_t>(), false);
+        m_live_slots[0] = true;
+
+        std::vector<size_t> chain;
+        const size_t nruns = header.get<uint64_t>();
+        for (size_t r = 0; r < nruns; ++r)
+        {
+            const size_t first = header.get<uint64_t>();
+            const size_t count = header.get<uint64_t>();
+            for (size_t slot = first; slot < first + count; ++slot)
+            {
+                m_live_slots[slot] = true;
+                chain.push_back(slot);
+            }
+        }
+        if (chain.empty())
+            return;
+        m_last_slot = chain.back();
+
+        // read the front block, and the back block which may be partial
+        m_front_slot = chain.front();
+        front_block->read(slot_bid(m_front_slot))->wait();
+        front_element = front_block->begin() + front_offset;
+        if (chain.size() == 1)
+        {
+            back_element = back_block->begin() + (m_last_count - 1);
+            m_front_partial = (m_last_count < block_type::size);
+            m_size = m_last_count - front_offset;
+            return;
+        }
+
+        for (size_t i = 1; i + 1 < chain.size(); ++i)
+            bids.push_back(slot_bid(chain[i]));
+        m_back_slot = chain.back();
+        back_block = pool->steal();
+        back_block->read(slot_bid(m_back_slot))->wait();
+        back_element = back_block->begin() + (m_last_count - 1);
+        m_size = static_cast<size_type>(chain.size() - 1) * block_type::size
+                 - front_offset + m_last_count;
+
+        for (size_t i = 0; i < blocks2prefetch && i < bids.size(); ++i)
+            pool->hint(bids[i]);
+    }
+
+    //! Write the blocks in memory and the header, such that the file holds
+    //! all elements.
+    void close()
+    {
+        if (m_size == 0)
+        {
+            if (m_front_slot != 0)
+                m_live_slots[m_front_slot] = false;
+            m_front_slot = 0;
+        }
+        else if (front_block == back_block)
+        {
+            if (m_front_slot == 0)
+                m_front_slot = allocate_slot();
+            write_slot(front_block, m_front_slot);
+            m_last_count = back_element + 1 - back_block->begin();
+        }
+        else
+        {
+            if (m_front_slot == 0)
+            {
+                m_front_slot = allocate_slot();
+                write_slot(front_block, m_front_slot);
+            }
+            else if (m_front_partial)
+                write_slot(front_block, m_front_slot);
+
+            if (m_back_slot == 0)
+                m_back_slot = allocate_slot();
+            write_slot(back_block, m_back_slot);
+            m_last_count = back_element + 1 - back_block->begin();
+        }
+        write_header();
+    }
+
 public:
     //! \name Miscellaneous
     //! \{
@@ -203,12 +486,35 @@ public:
     //!                          a negative value means to use the number of blocks in the prefetch pool
     void set_prefetch_aggr(int blocks2prefetch_)
     {
+        prefetch_auto = false;
         if (blocks2prefetch_ < 0)
             blocks2prefetch = pool->size_prefetch();
         else
             blocks2prefetch = blocks2prefetch_;
     }
 
+    //! Lets the number of blocks to prefetch (\c front side) adapt to the
+    //! rate at which pop() consumes blocks, such that prefetching just covers
+    //! the I/O latency, see prefetch_controller. The blocks are borrowed from
+    //! and returned to the prefetch pool, which may be shared with other
+    //! containers. set_prefetch_aggr() turns this off.
+    //! \param max_blocks  maximum number of blocks to prefetch,
+    //!                    zero means the number of blocks in the prefetch pool
+    void set_prefetch_aggr_auto(size_t max_blocks = 0)
+    {
+        if (max_blocks == 0)
+            max_blocks = std::max<size_t>(pool->size_prefetch(), 1);
+        prefetcher = prefetch_controller(max_blocks);
+        prefetch_auto = true;
+        blocks2prefetch = prefetcher.depth();
+    }
+
+    //! Returns whether the number of blocks to prefetch adapts automatically.
+    bool get_prefetch_aggr_auto() const
+    {
+        return prefetch_auto;
+    }
+
     //! Returns the number of blocks prefetched from the \c front side.
     size_t get_prefetch_aggr() const
     {
@@ -230,7 +536,7 @@ public:
                 // is the same as the front block, must keep it memory
                 TLX_LOG << "queue::push Case 1";
             }
-            else if (size() < 2 * block_type::size)
+            else if (!durable() && size() < 2 * block_type::size)
             {
                 TLX_LOG << "queue::push Case 1.5";
                 // only two blocks with a gap in the beginning, move elements within memory
@@ -248,6 +554,34 @@ public:
                 ++m_size;
                 return;
             }
+            else if (durable())
+            {
+                TLX_LOG << "queue::push Case 2 (file)";
+                // the front block precedes the back block on disk
+                if (m_front_slot == 0)
+                {
+                    m_front_slot = allocate_slot();
+                    write_slot(front_block, m_front_slot);
+                }
+                else if (m_front_partial)
+                    write_slot(front_block, m_front_slot);
+                m_front_partial = false;
+
+                const size_t slot = (m_back_slot != 0) ? m_back_slot : allocate_slot();
+                m_back_slot = 0;
+                write_slot(back_block, slot);
+                bids.push_back(slot_bid(slot));
+                m_last_count = block_type::size;
+                write_header();
+                if (bids.size() <= blocks2prefetch)
+                    pool->hint(bids.back());
+
+                // the block is written, hence it is reused as back block
+                back_element = back_block->begin();
+                *back_element = val;
+                ++m_size;
+                return;
+            }
             else
             {
                 TLX_LOG << "queue::push Case 2";
@@ -277,6 +611,33 @@ public:
         ++m_size;
     }
 
+    //! Adds the elements [first, last) to the queue. They are copied into the
+    //! back block in bulk, checking for a full back block once per block.
+    template <class ForwardIterator>
+    void push(ForwardIterator first, ForwardIterator last)
+    {
+        size_t n = std::distance(first, last);
+        while (n > 0)
+        {
+            const size_t free = back_block->begin() + (block_type::size - 1) - back_element;
+            if (TLX_UNLIKELY(free == 0))
+            {
+                // back block is filled, push() writes it
+                push(*first);
+                ++first;
+                --n;
+                continue;
+            }
+
+            const size_t chunk = std::min(free, n);
+            std::copy_n(first, chunk, back_element + 1);
+            std::advance(first, chunk);
+            back_element += chunk;
+            m_size += chunk;
+            n -= chunk;
+        }
+    }
+
     //! Removes element from the queue.
     void pop()
     {
@@ -295,6 +656,13 @@ public:
                 back_element = back_block->begin() - 1;
                 front_element = back_block->begin();
                 m_size = 0;
+                if (m_front_slot != 0)
+                {
+                    m_live_slots[m_front_slot] = false;
+                    m_front_slot = 0;
+                    m_front_partial = false;
+                    write_header();
+                }
                 return;
             }
 
@@ -307,6 +675,15 @@ public:
                 pool->add(front_block);
                 front_block = back_block;
                 front_element = back_block->begin();
+                if (durable())
+                {
+                    if (m_front_slot != 0)
+                        m_live_slots[m_front_slot] = false;
+                    m_front_slot = m_back_slot;
+                    m_front_partial = (m_back_slot != 0);
+                    m_back_slot = 0;
+                    write_header();
+                }
                 return;
             }
             TLX_LOG << "queue::pop Case 5";
@@ -323,16 +700,64 @@ public:
             }
 
             front_element = front_block->begin();
+            const double wait_begin = prefetch_auto ? foxxll::timestamp() : 0.0;
             req->wait();
 
-            bm->delete_block(bids.front());
-            bids.pop_front();
+            if (durable())
+            {
+                // the slot of the front block stays used until it is popped
+                if (m_front_slot != 0)
+                    m_live_slots[m_front_slot] = false;
+                m_front_slot = static_cast<size_t>(bids.front().offset / block_type::raw_size);
+                bids.pop_front();
+                write_header();
+            }
+            else
+            {
+                bm->delete_block(bids.front());
+                bids.pop_front();
+            }
+            if (prefetch_auto)
+                adapt_prefetch(wait_begin, foxxll::timestamp());
             return;
         }
 
         ++front_element;
         --m_size;
     }
+
+    //! Removes the n elements at the front of the queue, and copies them to
+    //! out in bulk, checking for an empty front block once per block.
+    //! Precondition: n <= size(). Returns the end of the output.
+    template <class OutputIterator>
+    OutputIterator pop(OutputIterator out, size_t n)
+    {
+        assert(n <= size());
+        while (n > 0)
+        {
+            // elements before the last one of the front block, pop() takes
+            // the last one and refills the front block
+            size_t avail = front_block->begin() + (block_type::size - 1) - front_element;
+            if (front_block == back_block)
+                avail = std::min<size_t>(avail, back_element + 1 - front_element);
+            if (TLX_UNLIKELY(avail == 0))
+            {
+                *out = *front_element;
+                ++out;
+                pop();
+                --n;
+                continue;
+            }
+
+            const size_t chunk = std::min(avail, n);
+            out = std::copy_n(front_element, chunk, out);
+            front_element += chunk;
+            m_size -= chunk;
+            n -= chunk;
+        }
+        return out;
+    }
+
     //! \}
 
     //! \name Operators
@@ -373,6 +798,19 @@ public:
 
     ~queue()
     {
+        if (durable())
+        {
+            try
+            {
+                close();
+            }
+            catch (...)
+            {
+                TLX_LOG1 << "Exception thrown in ~queue()...close()";
+            }
+            bids.clear();
+        }
+
         if (front_block != back_block)
             pool->add(back_block);
         pool->add(front_block);
@@ -384,6 +822,8 @@ public:
 
         if (!bids.empty())
             bm->delete_blocks(bids.begin(), bids.end());
+
+        delete m_header;
     }
 
     //! \}
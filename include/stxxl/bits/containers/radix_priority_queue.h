@@ -0,0 +1,258 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/radix_priority_queue.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_RADIX_PRIORITY_QUEUE_HEADER
+#define STXXL_CONTAINERS_RADIX_PRIORITY_QUEUE_HEADER
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include <tlx/define.hpp>
+#include <tlx/logger/core.hpp>
+#include <tlx/math/integer_log2.hpp>
+
+#include <foxxll/mng/read_write_pool.hpp>
+
+#include <stxxl/bits/containers/sequence.h>
+#include <stxxl/bits/defines.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External monotone priority queue for unsigned integer keys, an external
+ * radix heap.
+ *
+ * Monotone means that no pushed key may be smaller than the key of the last
+ * element popped, as holds for Dijkstra's algorithm with non-negative integer
+ * weights or for event simulations. top() returns an element with the
+ * smallest key.
+ *
+ * The elements are kept in buckets, bucket 0 holds the elements with the
+ * last key, bucket i > 0 those whose key differs from it first in bit i - 1.
+ * When bucket 0 is empty at top() or pop(), the first non-empty bucket is
+ * redistributed by its smallest key, each element moves to a smaller bucket.
+ * Each element is thus moved at most once per bit of the key range, all in
+ * sequential passes over the buckets, which are stxxl::sequence containers
+ * sharing one block pool.
+ *
+ * A bucket holds up to two blocks in memory and is created on its first
+ * use, so the memory consumption is two blocks per bucket used, at most
+ * log2 of the key range plus one, in addition to the blocks of the pool.
+ *
+ * \tparam ValueType type of the contained objects (POD with no references to
+ *   internal memory)
+ * \tparam KeyExtractor type of the key extractor, which defines key_type, an
+ *   unsigned integer type, and key_type operator () (const ValueType&)
+ * \tparam BlockSize size of the external memory blocks in bytes
+ * \tparam AllocStr parallel disk block allocation strategy
+ */
+template <class ValueType,
+          class KeyExtractor,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
+          class AllocStr = foxxll::default_alloc_strategy>
+class radix_priority_queue
+{
+    static constexpr bool debug = false;
+
+public:
+    //! The type of object stored in the radix_priority_queue.
+    using value_type = ValueType;
+    //! The type of the key extractor.
+    using key_extractor_type = KeyExtractor;
+    //! The type of the keys.
+    using key_type = typename key_extractor_type::key_type;
+    using size_type = external_size_type;
+
+    static_assert(std::is_unsigned<key_type>::value,
+                  "radix_priority_queue requires an unsigned integer key_type");
+
+    //! type of the buckets
+    using sequence_type = sequence<value_type, BlockSize, AllocStr>;
+    using block_type = typename sequence_type::block_type;
+    using pool_type = foxxll::read_write_pool<block_type>;
+
+    //! number of buckets: one for the last key and one per key bit
+    static constexpr size_t num_buckets = 8 * sizeof(key_type) + 1;
+
+protected:
+    //! the key extractor object
+    key_extractor_type m_key;
+
+    //! block pool shared by the buckets, grows by two blocks per bucket,
+    //! declared before them as they return their blocks on destruction
+    pool_type m_pool;
+
+    //! buckets, created on their first use
+    std::unique_ptr<sequence_type> m_buckets[num_buckets];
+
+    //! smallest key in each non-empty bucket
+    key_type m_bucket_min[num_buckets];
+
+    //! key of bucket 0, the key of the last element popped until a refill
+    //! raises it to the smallest key stored
+    key_type m_last;
+
+    //! number of elements
+    size_type m_size;
+
+    //! Bucket of the key relative to the last key.
+    size_t bucket_of(const key_type& key) const
+    {
+        if (key == m_last)
+            return 0;
+        return 1 + tlx::integer_log2_floor(static_cast<uint64_t>(key ^ m_last));
+    }
+
+    //! Returns the bucket, creates it and grows the pool by the two blocks it
+    //! holds in memory if it is used first.
+    sequence_type& bucket(size_t i)
+    {
+        if (TLX_UNLIKELY(!m_buckets[i]))
+        {
+            m_pool.resize_write(m_pool.size_write() + 2);
+            m_buckets[i].reset(new sequence_type(m_pool));
+        }
+        return *m_buckets[i];
+    }
+
+    //! Appends the element to its bucket.
+    void insert(const value_type& obj)
+    {
+        const key_type key = m_key(obj);
+        const size_t i = bucket_of(key);
+        sequence_type& seq = bucket(i);
+
+        if (seq.empty() || key < m_bucket_min[i])
+            m_bucket_min[i] = key;
+
+        seq.push_back(obj);
+    }
+
+    //! Refills the empty bucket 0 by redistributing the first non-empty
+    //! bucket, whose smallest key becomes the last key. Pushes after pop()
+    //! may still fall below that key, hence top() and pop() refill lazily.
+    void refill()
+    {
+        size_t i = 1;
+        while (!m_buckets[i] || m_buckets[i]->empty())
+            ++i;
+        assert(i < num_buckets);
+
+        sequence_type& seq = *m_buckets[i];
+
+        TLX_LOG << "radix_priority_queue::refill() bucket " << i
+                << " of " << seq.size() << " elements";
+
+        // all its elements move to smaller buckets, as their keys agree with
+        // the new last key in all bits above bit i - 1
+        m_last = m_bucket_min[i];
+        while (!seq.empty())
+        {
+            insert(seq.front());
+            seq.pop_front();
+        }
+    }
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Constructs an empty queue.
+    //!
+    //! \param w_pool_size number of blocks for buffered writing, in addition
+    //!   to the two blocks held by each bucket
+    //! \param p_pool_size number of blocks for prefetching
+    //! \param key key extractor object
+    explicit radix_priority_queue(
+        const size_t w_pool_size = 2, const size_t p_pool_size = 2,
+        const key_extractor_type& key = key_extractor_type())
+        : m_key(key),
+          m_pool(p_pool_size, w_pool_size),
+          m_last(0),
+          m_size(0)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    radix_priority_queue(const radix_priority_queue&) = delete;
+    //! non-copyable: delete assignment operator
+    radix_priority_queue& operator = (const radix_priority_queue&) = delete;
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Returns number of elements contained.
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    //! Returns true if queue has no elements.
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    //! \}
+
+    //! \name Operators
+    //! \{
+
+    //! Returns an element with the smallest key. Precondition: \c empty() is
+    //! false. Not const, as it refills bucket 0 if the last pop() emptied it.
+    const value_type & top()
+    {
+        assert(!empty());
+        if (!m_buckets[0] || m_buckets[0]->empty())
+            refill();
+        return m_buckets[0]->back();
+    }
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Inserts the element. Precondition: its key is not smaller than the key
+    //! of the last element popped.
+    void push(const value_type& obj)
+    {
+        assert(!(m_key(obj) < m_last));
+
+        insert(obj);
+        ++m_size;
+    }
+
+    //! Removes the element at the top. Precondition: \c empty() is false.
+    void pop()
+    {
+        assert(!empty());
+        if (!m_buckets[0] || m_buckets[0]->empty())
+            refill();
+
+        m_buckets[0]->pop_back();
+        --m_size;
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_RADIX_PRIORITY_QUEUE_HEADER
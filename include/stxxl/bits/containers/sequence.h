@@ -17,7 +17,10 @@
 
 #include <algorithm>
 #include <deque>
+#include <iterator>
+#include <mutex>
 #include <utility>
+#include <vector>
 
 #include <tlx/define.hpp>
 #include <tlx/logger/core.hpp>
@@ -29,6 +32,8 @@
 #include <foxxll/mng/typed_block.hpp>
 #include <foxxll/mng/write_pool.hpp>
 
+#include <stxxl/bits/common/alloc_strategy.h>
+#include <stxxl/bits/common/prefetch_controller.h>
 #include <stxxl/bits/defines.h>
 #include <stxxl/bits/deprecated.h>
 #include <stxxl/types>
@@ -56,12 +61,12 @@ namespace stxxl {
  *
  * \tparam ValueType type of the contained objects (POD with no references to internal memory)
  * \tparam BlockSize size of the external memory block in bytes, default is \c STXXL_DEFAULT_BLOCK_SIZE(ValTp)
- * \tparam AllocStr parallel disk block allocation strategy, default is \c foxxll::default_alloc_strategy
+ * \tparam AllocStr parallel disk block allocation strategy, default is \c runtime_alloc_strategy
  * \tparam SizeType size data type, default is \c external_size_type
  */
 template <class ValueType,
           size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
-          class AllocStr = foxxll::default_alloc_strategy,
+          class AllocStr = runtime_alloc_strategy,
           class SizeType = external_size_type>
 class sequence
 {
@@ -119,6 +124,15 @@ private:
     /// number of blocks to prefetch
     size_t m_blocks2prefetch;
 
+    /// whether m_blocks2prefetch adapts to the consumption rate
+    bool m_prefetch_auto = false;
+
+    /// adapts m_blocks2prefetch in the auto mode
+    prefetch_controller m_prefetcher;
+
+    /// serializes the pool accesses of concurrent partition streams
+    mutable std::mutex m_partition_mutex;
+
 public:
     //! \name Constructors/Destructors
     //! \{
@@ -201,6 +215,8 @@ public:
         std::swap(m_bids, obj.m_bids);
         std::swap(m_bm, obj.m_bm);
         std::swap(m_blocks2prefetch, obj.m_blocks2prefetch);
+        std::swap(m_prefetch_auto, obj.m_prefetch_auto);
+        std::swap(m_prefetcher, obj.m_prefetcher);
     }
 
     //! \}
@@ -229,6 +245,21 @@ private:
         set_prefetch_aggr(blocks2prefetch);
     }
 
+    /// adapts m_blocks2prefetch after waiting for the front or back block,
+    /// hinting the additional blocks or dropping the blocks no longer
+    /// prefetched at that end
+    void adapt_prefetch(double wait_begin, double wait_end, bool front)
+    {
+        const size_t old_blocks2prefetch = m_blocks2prefetch;
+        m_blocks2prefetch = m_prefetcher.on_block(wait_begin, wait_end);
+
+        const size_t n = m_bids.size();
+        for (size_t i = old_blocks2prefetch; i < m_blocks2prefetch && i < n; ++i)
+            m_pool->hint(front ? m_bids[i] : m_bids[n - 1 - i]);
+        for (size_t i = m_blocks2prefetch; i < old_blocks2prefetch && i < n; ++i)
+            m_pool->invalidate(front ? m_bids[i] : m_bids[n - 1 - i]);
+    }
+
 public:
     //! \name Miscellaneous
     //! \{
@@ -239,12 +270,35 @@ public:
     //!                         a negative value means to use the number of blocks in the prefetch pool
     void set_prefetch_aggr(int blocks2prefetch)
     {
+        m_prefetch_auto = false;
         if (blocks2prefetch < 0)
             m_blocks2prefetch = m_pool->size_prefetch();
         else
             m_blocks2prefetch = blocks2prefetch;
     }
 
+    //! Lets the number of blocks to prefetch adapt to the rate at which
+    //! pop_front() and pop_back() consume blocks, such that prefetching just
+    //! covers the I/O latency, see prefetch_controller. The blocks are
+    //! borrowed from and returned to the prefetch pool, which may be shared
+    //! with other containers. set_prefetch_aggr() turns this off.
+    //! \param max_blocks  maximum number of blocks to prefetch,
+    //!                    zero means the number of blocks in the prefetch pool
+    void set_prefetch_aggr_auto(size_t max_blocks = 0)
+    {
+        if (max_blocks == 0)
+            max_blocks = std::max<size_t>(m_pool->size_prefetch(), 1);
+        m_prefetcher = prefetch_controller(max_blocks);
+        m_prefetch_auto = true;
+        m_blocks2prefetch = m_prefetcher.depth();
+    }
+
+    //! Returns whether the number of blocks to prefetch adapts automatically
+    bool get_prefetch_aggr_auto() const
+    {
+        return m_prefetch_auto;
+    }
+
     //! Returns the number of blocks prefetched from the \c front side
     const size_t & get_prefetch_aggr() const
     {
@@ -387,6 +441,34 @@ public:
         }
     }
 
+    //! Adds the elements [first, last) to the end of the sequence. They are
+    //! copied into the back block in bulk, checking for a full back block
+    //! once per block.
+    template <class ForwardIterator>
+    void push_back(ForwardIterator first, ForwardIterator last)
+    {
+        size_t n = std::distance(first, last);
+        while (n > 0)
+        {
+            const size_t free = m_back_block->begin() + (block_type::size - 1) - m_back_element;
+            if (TLX_UNLIKELY(free == 0))
+            {
+                // back block is completely filled, push_back() writes it
+                push_back(*first);
+                ++first;
+                --n;
+                continue;
+            }
+
+            const size_t chunk = std::min(free, n);
+            std::copy_n(first, chunk, m_back_element + 1);
+            std::advance(first, chunk);
+            m_back_element += chunk;
+            m_size += chunk;
+            n -= chunk;
+        }
+    }
+
     //! Removes element from the front of the sequence
     void pop_front()
     {
@@ -433,10 +515,13 @@ public:
             }
 
             m_front_element = m_front_block->begin();
+            const double wait_begin = m_prefetch_auto ? foxxll::timestamp() : 0.0;
             req->wait();
 
             m_bm->delete_block(m_bids.front());
             m_bids.pop_front();
+            if (m_prefetch_auto)
+                adapt_prefetch(wait_begin, foxxll::timestamp(), true);
         }
         else
         {
@@ -445,6 +530,38 @@ public:
         }
     }
 
+    //! Removes the n elements at the front of the sequence, and copies them
+    //! to out in bulk, checking for an empty front block once per block.
+    //! Precondition: n <= size(). Returns the end of the output.
+    template <class OutputIterator>
+    OutputIterator pop_front(OutputIterator out, size_t n)
+    {
+        assert(n <= size());
+        while (n > 0)
+        {
+            // elements before the last one of the front block, pop_front()
+            // takes the last one and refills the front block
+            size_t avail = m_front_block->begin() + (block_type::size - 1) - m_front_element;
+            if (m_front_block == m_back_block)
+                avail = std::min<size_t>(avail, m_back_element + 1 - m_front_element);
+            if (TLX_UNLIKELY(avail == 0))
+            {
+                *out = *m_front_element;
+                ++out;
+                pop_front();
+                --n;
+                continue;
+            }
+
+            const size_t chunk = std::min(avail, n);
+            out = std::copy_n(m_front_element, chunk, out);
+            m_front_element += chunk;
+            m_size -= chunk;
+            n -= chunk;
+        }
+        return out;
+    }
+
     //! Removes element from the back of the sequence
     void pop_back()
     {
@@ -492,10 +609,13 @@ public:
             }
 
             m_back_element = m_back_block->end() - 1;
+            const double wait_begin = m_prefetch_auto ? foxxll::timestamp() : 0.0;
             req->wait();
 
             m_bm->delete_block(m_bids.back());
             m_bids.pop_back();
+            if (m_prefetch_auto)
+                adapt_prefetch(wait_begin, foxxll::timestamp(), false);
         }
         else
         {
@@ -836,6 +956,208 @@ public:
     }
 
     //! \}
+
+    /**************************************************************************/
+
+    //! Forward stream over a block-aligned part of the sequence, which may be
+    //! consumed concurrently with the streams over the other parts, see
+    //! get_partition_streams().
+    class partition_stream
+    {
+    public:
+        using value_type = typename sequence::value_type;
+
+    protected:
+        const sequence* m_sequence;
+
+        /// next and end logical block of the part, see block_range()
+        size_t m_next_block, m_end_block;
+
+        /// number of blocks to prefetch ahead within the part
+        size_t m_blocks2prefetch;
+
+        size_type m_size;
+
+        const value_type* m_current_element;
+
+        const value_type* m_block_end;
+
+        /// own buffer of the blocks read from external memory
+        block_type* m_buffer;
+
+        /// points m_current_element to the logical block m_next_block
+        void load_block()
+        {
+            const sequence& seq = *m_sequence;
+            const size_t i = m_next_block++;
+
+            if (i == 0 || i + 1 == seq.num_logical_blocks())
+            {
+                // front or back block, held in internal memory
+                seq.block_range(i, m_current_element, m_block_end);
+                if (m_current_element == m_block_end)
+                    load_block(); // skip an empty front block
+                return;
+            }
+
+            foxxll::request_ptr req;
+            {
+                std::unique_lock<std::mutex> lock(seq.m_partition_mutex);
+
+                if (!m_buffer)
+                    m_buffer = new block_type;
+
+                req = seq.m_pool->read(m_buffer, seq.m_bids[i - 1]);
+                TLX_LOG << "sequence::partition_stream read block " << m_buffer << " @ " << seq.m_bids[i - 1];
+
+                // give prefetching hints, up to the part's last block read from
+                // external memory
+                const size_t end = std::min(m_end_block, seq.num_logical_blocks() - 1);
+                for (size_t j = i + 1; j <= i + m_blocks2prefetch && j < end; ++j)
+                    seq.m_pool->hint(seq.m_bids[j - 1]);
+            }
+
+            req->wait();
+            m_current_element = m_buffer->begin();
+            m_block_end = m_buffer->end();
+        }
+
+    public:
+        partition_stream(const sequence& sequence, size_t begin_block, size_t end_block,
+                         size_t blocks2prefetch)
+            : m_sequence(&sequence),
+              m_next_block(begin_block), m_end_block(end_block),
+              m_blocks2prefetch(blocks2prefetch),
+              m_size(0),
+              m_current_element(nullptr), m_block_end(nullptr),
+              m_buffer(nullptr)
+        {
+            for (size_t i = begin_block; i < end_block; ++i)
+                m_size += sequence.block_size_of(i);
+
+            if (m_size > 0)
+                load_block();
+        }
+
+        //! non-copyable: delete copy-constructor
+        partition_stream(const partition_stream&) = delete;
+        //! non-copyable: delete assignment operator
+        partition_stream& operator = (const partition_stream&) = delete;
+
+        partition_stream(partition_stream&& other)
+            : m_sequence(other.m_sequence),
+              m_next_block(other.m_next_block), m_end_block(other.m_end_block),
+              m_blocks2prefetch(other.m_blocks2prefetch),
+              m_size(other.m_size),
+              m_current_element(other.m_current_element), m_block_end(other.m_block_end),
+              m_buffer(other.m_buffer)
+        {
+            other.m_size = 0;
+            other.m_buffer = nullptr;
+        }
+
+        partition_stream& operator = (partition_stream&&) = delete;
+
+        ~partition_stream()
+        {
+            // the buffer may have been exchanged with one of the prefetch
+            // pool, both were allocated by new
+            delete m_buffer;
+        }
+
+        //! return number of element left till end-of-stream.
+        size_type size() const
+        {
+            return m_size;
+        }
+
+        //! standard stream method
+        bool empty() const
+        {
+            return (m_size == 0);
+        }
+
+        //! standard stream method
+        const value_type& operator * () const
+        {
+            assert(!empty());
+            return *m_current_element;
+        }
+
+        //! standard stream method
+        partition_stream& operator ++ ()
+        {
+            assert(!empty());
+
+            --m_size;
+            if (TLX_UNLIKELY(++m_current_element == m_block_end) && m_size > 0)
+                load_block();
+
+            return *this;
+        }
+    };
+
+    //! \name Miscellaneous
+    //! \{
+
+    //! Splits the sequence into at most n parts of consecutive blocks and
+    //! returns a forward stream over each, which together yield the elements
+    //! in the order of get_stream(). The streams are meant to be consumed by
+    //! parallel threads, one thread each, e.g. by stream::parallel_scan(). They
+    //! read the blocks through the sequence's pool, serialized by a mutex, and
+    //! each keeps one own block in memory. The sequence must not be modified
+    //! or streamed otherwise while the partition streams are in use.
+    //! \param n  maximum number of parts, there are fewer if the sequence has
+    //!           fewer blocks
+    //! \param blocks2prefetch  number of blocks each stream prefetches ahead,
+    //!                         by default the sequence's divided among the parts
+    std::vector<partition_stream> get_partition_streams(
+        size_t n, size_t blocks2prefetch = size_t(-1))
+    {
+        const size_t nblocks = num_logical_blocks();
+        n = std::max<size_t>(1, std::min(n, nblocks));
+        if (blocks2prefetch == size_t(-1))
+            blocks2prefetch = std::max<size_t>(1, m_blocks2prefetch / n);
+
+        std::vector<partition_stream> parts;
+        parts.reserve(n);
+        for (size_t p = 0; p < n; ++p)
+            parts.emplace_back(*this, p * nblocks / n, (p + 1) * nblocks / n, blocks2prefetch);
+        return parts;
+    }
+
+    //! \}
+
+private:
+    /// number of blocks holding elements: the front block, the blocks in
+    /// external memory and the back block, or a single one if they are the same
+    size_t num_logical_blocks() const
+    {
+        return (m_front_block == m_back_block) ? 1 : m_bids.size() + 2;
+    }
+
+    /// number of elements in the logical block i
+    size_type block_size_of(size_t i) const
+    {
+        if (i == 0 || i + 1 == num_logical_blocks())
+        {
+            const value_type* begin, * end;
+            block_range(i, begin, end);
+            return static_cast<size_type>(end - begin);
+        }
+        return block_type::size;
+    }
+
+    /// range of the elements of the logical block i, which must be the front
+    /// or back block
+    void block_range(size_t i, const value_type*& begin, const value_type*& end) const
+    {
+        const size_t nblocks = num_logical_blocks();
+        assert(i == 0 || i + 1 == nblocks);
+
+        begin = (i == 0) ? m_front_element : m_back_block->begin();
+        end = (i + 1 == nblocks) ? m_back_element + 1 : m_front_block->end();
+    }
 };
 
 //! \}
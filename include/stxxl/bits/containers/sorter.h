@@ -14,7 +14,11 @@
 #define STXXL_CONTAINERS_SORTER_HEADER
 
 #include <algorithm>
+#include <memory>
+#include <vector>
 
+#include <stxxl/bits/common/alloc_strategy.h>
+#include <stxxl/bits/common/memory_manager.h>
 #include <stxxl/bits/deprecated.h>
 #include <stxxl/bits/stream/sort_stream.h>
 
@@ -53,12 +57,12 @@ namespace stxxl {
  * \tparam ValueType   type of the contained objects (POD with no references to internal memory)
  * \tparam CompareType type of comparison object used for sorting the runs
  * \tparam BlockSize   size of the external memory block in bytes, default is \c STXXL_DEFAULT_BLOCK_SIZE(ValTp)
- * \tparam AllocStr    parallel disk block allocation strategy, default is \c foxxll::default_alloc_strategy
+ * \tparam AllocStr    parallel disk block allocation strategy, default is \c runtime_alloc_strategy
  */
 template <typename ValueType,
           typename CompareType,
           size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
-          class AllocStrategy = foxxll::default_alloc_strategy>
+          class AllocStrategy = runtime_alloc_strategy>
 class sorter
 {
 public:
@@ -84,12 +88,23 @@ public:
     //! size type
     using size_type = typename runs_merger_type::size_type;
 
+    //! merger of a key range of the output, see partitioned_output()
+    using partition_type = stream::runs_range_merger<typename runs_creator_type::sorted_runs_type,
+                                                     cmp_type, alloc_strategy_type>;
+
 protected:
     // *** Object Attributes
 
     //! current state of sorter
     enum { STATE_INPUT, STATE_OUTPUT } m_state;
 
+    //! comparator object, used to partition the output
+    cmp_type m_cmp;
+
+    //! reservation at the memory_manager of the larger of the memory of the
+    //! runs creator and merger, which are not allocated at the same time
+    memory_reservation m_reservation;
+
     //! runs creator object holding all items
     runs_creator_type m_runs_creator;
 
@@ -103,6 +118,8 @@ public:
     //! Constructor allocation memory_to_use bytes in ram for sorted runs.
     sorter(const cmp_type& cmp, size_t memory_to_use)
         : m_state(STATE_INPUT),
+          m_cmp(cmp),
+          m_reservation("sorter", memory_to_use),
           m_runs_creator(cmp, memory_to_use),
           m_runs_merger(cmp, memory_to_use)
     { }
@@ -110,6 +127,8 @@ public:
     //! Constructor variant with differently sizes runs_creator and runs_merger
     sorter(const cmp_type& cmp, size_t creator_memory_to_use, size_t merger_memory_to_use)
         : m_state(STATE_INPUT),
+          m_cmp(cmp),
+          m_reservation("sorter", std::max(creator_memory_to_use, merger_memory_to_use)),
           m_runs_creator(cmp, creator_memory_to_use),
           m_runs_merger(cmp, merger_memory_to_use)
 
@@ -191,7 +210,7 @@ public:
     //! Switch to output state, rewind() in case the output was already sorted.
     void sort(size_t merger_memory_to_use)
     {
-        m_runs_merger.set_memory_to_use(merger_memory_to_use);
+        set_merger_memory_to_use(merger_memory_to_use);
         sort();
     }
 
@@ -220,11 +239,65 @@ public:
         return sort();
     }
 
+    /*!
+     * Split the sorted output into num_partitions streams of disjoint key
+     * ranges, which together hold all items in sorted order: items of
+     * partition i are not greater than those of partition i + 1. The
+     * partitions are of about equal size, their splitters are selected from
+     * the first items of the blocks of all runs.
+     *
+     * Each partition merges the blocks of the runs overlapping its range with
+     * a runs_merger of its own, hence the partitions can be consumed by
+     * different threads in parallel. The merger memory is divided among them,
+     * but each uses at least one block per run. The sorter's own output
+     * stream is released and must be rewind() before it is read again. The
+     * partitions keep the sorted runs alive until they are destroyed.
+     */
+    std::vector<std::unique_ptr<partition_type> >
+    partitioned_output(size_t num_partitions)
+    {
+        assert(m_state == STATE_OUTPUT);
+        assert(num_partitions > 0);
+
+        return partitioned_output(
+            stream::select_run_splitters(m_runs_creator.result(), num_partitions, m_cmp));
+    }
+
+    /*!
+     * Split the sorted output like partitioned_output(num_partitions), but
+     * at the given ascending splitters, e.g. the quantiles of a kll_sketch
+     * of the pushed items: partition i holds the items in [splitters[i - 1],
+     * splitters[i]), the first and the last partition are open-ended.
+     */
+    std::vector<std::unique_ptr<partition_type> >
+    partitioned_output(const std::vector<value_type>& splitters)
+    {
+        assert(m_state == STATE_OUTPUT);
+
+        const size_t num_partitions = splitters.size() + 1;
+        const size_t memory_to_use = m_runs_merger.memory_to_use();
+        m_runs_merger.deallocate();
+
+        typename runs_creator_type::sorted_runs_type sruns = m_runs_creator.result();
+
+        std::vector<std::unique_ptr<partition_type> > partitions;
+        for (size_t i = 0; i < num_partitions; ++i)
+        {
+            partitions.emplace_back(new partition_type(
+                                        sruns,
+                                        i == 0 ? m_cmp.min_value() : splitters[i - 1],
+                                        i + 1 == num_partitions ? m_cmp.max_value() : splitters[i],
+                                        m_cmp, memory_to_use / num_partitions));
+        }
+        return partitions;
+    }
+
     //! \}
 
     //! Change runs_merger memory usage
     void set_merger_memory_to_use(size_t merger_memory_to_use)
     {
+        m_reservation.resize(std::max(m_reservation.size(), merger_memory_to_use));
         m_runs_merger.set_memory_to_use(merger_memory_to_use);
     }
 
@@ -0,0 +1,505 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/sparse_matrix.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_SPARSE_MATRIX_HEADER
+#define STXXL_CONTAINERS_SPARSE_MATRIX_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <foxxll/common/types.hpp>
+
+#include <stxxl/bits/containers/matrix.h>
+#include <stxxl/bits/containers/sorter.h>
+#include <stxxl/bits/containers/vector.h>
+
+namespace stxxl {
+
+//! \addtogroup matrix
+//! \{
+
+/*!
+ * External sparse matrix, partitioned into square tiles of tile_size rows and
+ * columns.
+ *
+ * Only the tiles with nonzeros are stored, in row-major order of the tiles.
+ * Each tile is a block of (row, column, value) elements in row-major order,
+ * with 32-bit indices within the tile, in one stxxl::vector. The directory of
+ * the tiles is kept in internal memory.
+ *
+ * The matrix is assigned from a stream of entries in any order, which are
+ * sorted with stxxl::sorter, and duplicate entries are added up.
+ *
+ * The multiplications with a column_vector or row_vector stream the elements
+ * once. They hold the segments of the vectors for one row and one column of
+ * tiles in internal memory, 2 * tile_size values. The product of two sparse
+ * matrices is computed by sorting: the entries of the left matrix by column
+ * and of the right by row are joined on the common index, and their products
+ * are sorted into the result, which adds them up.
+ *
+ * \tparam ValueType type of the values (POD with no references to internal memory)
+ */
+template <typename ValueType>
+class sparse_matrix
+{
+public:
+    //! \name Types
+    //! \{
+
+    using value_type = ValueType;
+    using size_type = foxxll::external_size_type;
+    using column_vector_type = column_vector<ValueType>;
+    using row_vector_type = row_vector<ValueType>;
+
+    //! a nonzero of the matrix
+    struct entry_type
+    {
+        size_type row;
+        size_type col;
+        value_type value;
+    };
+
+    //! comparator of entries by row, then column, for stxxl::sorter
+    struct row_major_order
+    {
+        bool operator () (const entry_type& a, const entry_type& b) const
+        {
+            return std::make_pair(a.row, a.col) < std::make_pair(b.row, b.col);
+        }
+        entry_type min_value() const
+        { return entry_type { 0, 0, value_type() }; }
+        entry_type max_value() const
+        { return entry_type { max_index(), max_index(), value_type() }; }
+    };
+
+    //! comparator of entries by column, then row, for stxxl::sorter
+    struct column_major_order
+    {
+        bool operator () (const entry_type& a, const entry_type& b) const
+        {
+            return std::make_pair(a.col, a.row) < std::make_pair(b.col, b.row);
+        }
+        entry_type min_value() const
+        { return entry_type { 0, 0, value_type() }; }
+        entry_type max_value() const
+        { return entry_type { max_index(), max_index(), value_type() }; }
+    };
+
+    //! comparator of entries in the order of the tiles, for stxxl::sorter
+    struct tile_order
+    {
+        size_type tile_size;
+
+        explicit tile_order(size_type tile_size)
+            : tile_size(tile_size) { }
+
+        bool operator () (const entry_type& a, const entry_type& b) const
+        {
+            const size_type ta = a.row / tile_size, tb = b.row / tile_size;
+            if (ta != tb)
+                return ta < tb;
+            const size_type ca = a.col / tile_size, cb = b.col / tile_size;
+            if (ca != cb)
+                return ca < cb;
+            return std::make_pair(a.row, a.col) < std::make_pair(b.row, b.col);
+        }
+        entry_type min_value() const
+        { return entry_type { 0, 0, value_type() }; }
+        entry_type max_value() const
+        { return entry_type { max_index(), max_index(), value_type() }; }
+    };
+
+    //! \}
+
+    //! default number of rows and columns of a tile
+    static constexpr size_type default_tile_size = size_type(1) << 22;
+
+protected:
+    //! a nonzero with indices within its tile
+    struct element_type
+    {
+        uint32_t row;
+        uint32_t col;
+        value_type value;
+    };
+
+    //! a tile with nonzeros, and its first element
+    struct tile_type
+    {
+        size_type row;
+        size_type col;
+        size_type begin;
+    };
+
+    using element_vector_type = stxxl::vector<element_type>;
+    using element_bufreader_type = typename element_vector_type::bufreader_type;
+    using element_bufwriter_type = typename element_vector_type::bufwriter_type;
+
+    size_type m_height, m_width, m_tile_size;
+
+    //! the tiles with nonzeros, in row-major order
+    std::vector<tile_type> m_tiles;
+
+    //! the elements of the tiles
+    element_vector_type m_elements;
+
+    static size_type max_index()
+    {
+        return std::numeric_limits<size_type>::max();
+    }
+
+    //! index after the last element of tile t
+    size_type tile_end(size_t t) const
+    {
+        return (t + 1 < m_tiles.size()) ? m_tiles[t + 1].begin : m_elements.size();
+    }
+
+    //! number of rows or columns of the tile with index i, of dimension n
+    size_type tile_length(size_type i, size_type n) const
+    {
+        return std::min(m_tile_size, n - i * m_tile_size);
+    }
+
+    //! Reads the segment of vec of length n at begin.
+    template <typename Vector>
+    static void load_segment(const Vector& vec, size_type begin, size_type n,
+                             std::vector<value_type>& segment)
+    {
+        segment.resize(static_cast<size_t>(n));
+        typename Vector::bufreader_type reader(vec.cbegin() + begin, vec.cbegin() + begin + n);
+        for (size_t i = 0; i < segment.size(); ++i, ++reader)
+            segment[i] = *reader;
+    }
+
+    //! Writes the segment back into vec at begin.
+    template <typename Vector>
+    static void store_segment(const std::vector<value_type>& segment,
+                              Vector& vec, size_type begin)
+    {
+        typename Vector::iterator it = vec.begin() + begin;
+        for (size_t i = 0; i < segment.size(); ++i, ++it)
+            *it = segment[i];
+    }
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Creates an empty height x width matrix.
+    sparse_matrix(size_type height, size_type width, size_type tile_size = default_tile_size)
+        : m_height(height), m_width(width), m_tile_size(tile_size)
+    {
+        assert(tile_size > 0 && tile_size <= (size_type(1) << 32));
+    }
+
+    //! non-copyable: delete copy-constructor
+    sparse_matrix(const sparse_matrix&) = delete;
+    //! non-copyable: delete assignment operator
+    sparse_matrix& operator = (const sparse_matrix&) = delete;
+
+    void swap(sparse_matrix& obj)
+    {
+        std::swap(m_height, obj.m_height);
+        std::swap(m_width, obj.m_width);
+        std::swap(m_tile_size, obj.m_tile_size);
+        std::swap(m_tiles, obj.m_tiles);
+        m_elements.swap(obj.m_elements);
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    size_type get_height() const { return m_height; }
+
+    size_type get_width() const { return m_width; }
+
+    size_type get_tile_size() const { return m_tile_size; }
+
+    //! Number of stored nonzeros.
+    size_type nnz() const { return m_elements.size(); }
+
+    //! Number of tiles with nonzeros.
+    size_t num_tiles() const { return m_tiles.size(); }
+
+    //! Remove all nonzeros.
+    void clear()
+    {
+        m_tiles.clear();
+        m_elements.clear();
+    }
+
+    //! \}
+
+    //! \name Assignment
+    //! \{
+
+    //! Assigns the entries of a stream in any order, sorted with memory_to_use
+    //! bytes. Duplicate entries are added up.
+    template <typename StreamAlgorithm>
+    void assign(StreamAlgorithm& entries, size_t memory_to_use)
+    {
+        stxxl::sorter<entry_type, tile_order> sorter(tile_order(m_tile_size), memory_to_use);
+        for ( ; !entries.empty(); ++entries)
+            sorter.push(*entries);
+        sorter.sort();
+        assign_sorted(sorter);
+    }
+
+    //! Assigns the entries of a stream sorted by tile_order, e.g. the stream
+    //! of another sparse_matrix with the same tile size. Duplicate entries
+    //! are added up.
+    template <typename StreamAlgorithm>
+    void assign_sorted(StreamAlgorithm& entries)
+    {
+        clear();
+        const tile_order cmp(m_tile_size);
+        element_bufwriter_type writer(m_elements);
+        size_type nnz = 0;
+
+        while (!entries.empty())
+        {
+            entry_type entry = *entries;
+            assert(entry.row < m_height && entry.col < m_width);
+            for (++entries; !entries.empty() && !cmp(entry, *entries); ++entries)
+            {
+                assert(entries->row == entry.row && entries->col == entry.col);
+                entry.value += entries->value;
+            }
+
+            const size_type row = entry.row / m_tile_size, col = entry.col / m_tile_size;
+            if (m_tiles.empty() || m_tiles.back().row != row || m_tiles.back().col != col)
+                m_tiles.push_back(tile_type { row, col, nnz });
+
+            writer << element_type {
+                static_cast<uint32_t>(entry.row % m_tile_size),
+                static_cast<uint32_t>(entry.col % m_tile_size), entry.value
+            };
+            ++nnz;
+        }
+        writer.finish();
+    }
+
+    //! \}
+
+    //! \name Streams
+    //! \{
+
+    //! Stream of the nonzeros in the order of the tiles, which reads the
+    //! elements with overlapped I/O.
+    class stream
+    {
+    public:
+        using value_type = entry_type;
+
+    protected:
+        const sparse_matrix& m_matrix;
+        element_bufreader_type m_reader;
+        //! current tile and number of its elements left
+        size_t m_tile;
+        size_type m_tile_left;
+        entry_type m_entry;
+
+        void read_entry()
+        {
+            while (m_tile_left == 0)
+            {
+                ++m_tile;
+                m_tile_left = m_matrix.tile_end(m_tile) - m_matrix.m_tiles[m_tile].begin;
+            }
+            const tile_type& tile = m_matrix.m_tiles[m_tile];
+            m_entry.row = tile.row * m_matrix.m_tile_size + m_reader->row;
+            m_entry.col = tile.col * m_matrix.m_tile_size + m_reader->col;
+            m_entry.value = m_reader->value;
+        }
+
+    public:
+        explicit stream(const sparse_matrix& matrix)
+            : m_matrix(matrix), m_reader(matrix.m_elements),
+              m_tile(0), m_tile_left(0)
+        {
+            if (!m_reader.empty())
+            {
+                m_tile_left = m_matrix.tile_end(0);
+                read_entry();
+            }
+        }
+
+        //! standard stream method
+        bool empty() const { return m_reader.empty(); }
+
+        //! standard stream method
+        const value_type& operator * () const
+        {
+            assert(!empty());
+            return m_entry;
+        }
+
+        //! standard stream method
+        const value_type* operator -> () const
+        {
+            return &(operator * ());
+        }
+
+        //! standard stream method
+        stream& operator ++ ()
+        {
+            assert(!empty());
+            ++m_reader;
+            --m_tile_left;
+            if (!m_reader.empty())
+                read_entry();
+            return *this;
+        }
+    };
+
+    //! \}
+
+    //! \name Multiplication
+    //! \{
+
+    //! calculates y = A * x + y, in one scan of the nonzeros
+    void multiply_and_add(const column_vector_type& x, column_vector_type& y) const
+    {
+        assert(size_type(x.size()) == m_width && size_type(y.size()) == m_height);
+
+        std::vector<value_type> x_segment, y_segment;
+        element_bufreader_type reader(m_elements);
+
+        for (size_t t = 0; t < m_tiles.size(); )
+        {
+            const size_type row = m_tiles[t].row;
+            load_segment(y, row * m_tile_size, tile_length(row, m_height), y_segment);
+
+            for ( ; t < m_tiles.size() && m_tiles[t].row == row; ++t)
+            {
+                const size_type col = m_tiles[t].col;
+                load_segment(x, col * m_tile_size, tile_length(col, m_width), x_segment);
+
+                for (size_type i = m_tiles[t].begin; i < tile_end(t); ++i, ++reader)
+                    y_segment[reader->row] += reader->value * x_segment[reader->col];
+            }
+
+            store_segment(y_segment, y, row * m_tile_size);
+        }
+    }
+
+    //! calculates y = x * A + y for the row vector x, in one scan of the
+    //! nonzeros
+    void multiply_from_left_and_add(const row_vector_type& x, row_vector_type& y) const
+    {
+        assert(size_type(x.size()) == m_height && size_type(y.size()) == m_width);
+
+        std::vector<value_type> x_segment, y_segment;
+        element_bufreader_type reader(m_elements);
+
+        for (size_t t = 0; t < m_tiles.size(); )
+        {
+            const size_type row = m_tiles[t].row;
+            load_segment(x, row * m_tile_size, tile_length(row, m_height), x_segment);
+
+            for ( ; t < m_tiles.size() && m_tiles[t].row == row; ++t)
+            {
+                const size_type col = m_tiles[t].col;
+                load_segment(y, col * m_tile_size, tile_length(col, m_width), y_segment);
+
+                for (size_type i = m_tiles[t].begin; i < tile_end(t); ++i, ++reader)
+                    y_segment[reader->col] += x_segment[reader->row] * reader->value;
+
+                store_segment(y_segment, y, col * m_tile_size);
+            }
+        }
+    }
+
+    column_vector_type operator * (const column_vector_type& right) const
+    {
+        assert(size_type(right.size()) == m_width);
+        column_vector_type res(m_height);
+        res.set_zero();
+        multiply_and_add(right, res);
+        return res;
+    }
+
+    row_vector_type multiply_from_left(const row_vector_type& left) const
+    {
+        assert(size_type(left.size()) == m_height);
+        row_vector_type res(m_width);
+        res.set_zero();
+        multiply_from_left_and_add(left, res);
+        return res;
+    }
+
+    //! Calculates result = A * right by sorting, with about memory_to_use
+    //! bytes. The nonzeros of a row of right are held in internal memory.
+    void multiply(const sparse_matrix& right, sparse_matrix& result, size_t memory_to_use) const
+    {
+        assert(m_width == right.m_height);
+        assert(result.m_height == m_height && result.m_width == right.m_width);
+        assert(&result != this && &result != &right);
+
+        const size_t sorter_memory = memory_to_use / 3;
+
+        // the entries of this matrix by column, of the right one by row
+        stxxl::sorter<entry_type, column_major_order> left_sorter(
+            column_major_order(), sorter_memory);
+        for (stream s(*this); !s.empty(); ++s)
+            left_sorter.push(*s);
+        left_sorter.sort();
+
+        stxxl::sorter<entry_type, row_major_order> right_sorter(
+            row_major_order(), sorter_memory);
+        for (stream s(right); !s.empty(); ++s)
+            right_sorter.push(*s);
+        right_sorter.sort();
+
+        // join on the common index, and sort the products into the result
+        stxxl::sorter<entry_type, tile_order> product_sorter(
+            tile_order(result.m_tile_size), sorter_memory);
+        std::vector<std::pair<size_type, value_type> > right_row;
+
+        while (!left_sorter.empty())
+        {
+            const size_type k = left_sorter->col;
+            while (!right_sorter.empty() && right_sorter->row < k)
+                ++right_sorter;
+
+            right_row.clear();
+            for ( ; !right_sorter.empty() && right_sorter->row == k; ++right_sorter)
+                right_row.emplace_back(right_sorter->col, right_sorter->value);
+
+            for ( ; !left_sorter.empty() && left_sorter->col == k; ++left_sorter)
+            {
+                for (const std::pair<size_type, value_type>& r : right_row)
+                    product_sorter.push(entry_type {
+                                            left_sorter->row, r.first, left_sorter->value * r.second
+                                        });
+            }
+        }
+
+        left_sorter.finish_clear();
+        right_sorter.finish_clear();
+
+        product_sorter.sort();
+        result.assign_sorted(product_sorter);
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_SPARSE_MATRIX_HEADER
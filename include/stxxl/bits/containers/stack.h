@@ -15,6 +15,7 @@
 #define STXXL_CONTAINERS_STACK_HEADER
 
 #include <algorithm>
+#include <iterator>
 #include <stack>
 #include <type_traits>
 #include <utility>
@@ -32,6 +33,8 @@
 #include <foxxll/mng/typed_block.hpp>
 #include <foxxll/mng/write_pool.hpp>
 
+#include <stxxl/bits/common/alloc_strategy.h>
+#include <stxxl/bits/containers/stack_block_scheduler.h>
 #include <stxxl/bits/defines.h>
 #include <stxxl/bits/deprecated.h>
 #include <stxxl/types>
@@ -46,7 +49,7 @@ namespace stxxl {
 template <class ValueType,
           unsigned BlocksPerPage = 4,
           size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
-          class AllocStr = foxxll::default_alloc_strategy,
+          class AllocStr = runtime_alloc_strategy,
           class SizeType = external_size_type>
 struct stack_config_generator
 {
@@ -253,6 +256,35 @@ public:
         ++cache_offset;
     }
 
+    //! Inserts the elements [first, last) at the top of the stack, such that
+    //! top() is the last inserted element. They are copied into the cache in
+    //! bulk, checking for a cache overflow once per block.
+    template <class ForwardIterator>
+    void push(ForwardIterator first, ForwardIterator last)
+    {
+        size_t n = std::distance(first, last);
+        while (n > 0)
+        {
+            if (TLX_UNLIKELY(cache_offset == 2 * blocks_per_page * block_type::size))
+            {
+                // cache overflow, push() writes the back page
+                push(*first);
+                ++first;
+                --n;
+                continue;
+            }
+
+            // free slots of the block at the cache offset
+            const size_t chunk = std::min(n, block_type::size - cache_offset % block_type::size);
+            std::copy_n(first, chunk, element(cache_offset));
+            std::advance(first, chunk);
+            cache_offset += chunk;
+            m_size += chunk;
+            n -= chunk;
+            current_element = element(cache_offset - 1);
+        }
+    }
+
     //! Removes the element at the top of the stack. Precondition: stack is not
     //! empty(). Postcondition: size() is decremented.
     void pop()
@@ -294,6 +326,44 @@ public:
         current_element = element((--cache_offset) - 1);
     }
 
+    //! Removes the n elements at the top of the stack, and copies them to out
+    //! in bulk, beginning with top(), checking for an empty cache once per
+    //! block. Precondition: n <= size(). Returns the end of the output.
+    template <class OutputIterator>
+    OutputIterator pop(OutputIterator out, size_t n)
+    {
+        assert(n <= m_size);
+        while (n > 0)
+        {
+            assert(cache_offset > 0);
+
+            // pop() takes the element at cache offset 0 if it has to read the
+            // pages below
+            const size_t lowest = (bids.size() >= blocks_per_page) ? 1 : 0;
+            const size_t block_begin = (cache_offset - 1) / block_type::size * block_type::size;
+            const size_t avail = cache_offset - std::max(block_begin, lowest);
+            if (TLX_UNLIKELY(avail == 0))
+            {
+                *out = *current_element;
+                ++out;
+                pop();
+                --n;
+                continue;
+            }
+
+            const size_t chunk = std::min(avail, n);
+            const value_type* elem = element(cache_offset - 1);
+            for (size_t i = 0; i < chunk; ++i, ++out)
+                *out = *elem--;
+            cache_offset -= chunk;
+            m_size -= chunk;
+            n -= chunk;
+            if (cache_offset > 0)
+                current_element = element(cache_offset - 1);
+        }
+        return out;
+    }
+
     //! \}
 
 private:
@@ -578,6 +648,9 @@ public:
     using block_type = foxxll::typed_block<block_size, value_type>;
     using bid_type = foxxll::BID<block_size>;
 
+    //! scheduler of the blocks of stacks sharing a pool
+    using scheduler_type = stack_block_scheduler<block_type, alloc_strategy_type>;
+
 private:
     using pool_type = foxxll::read_write_pool<block_type>;
 
@@ -589,6 +662,10 @@ private:
     size_t pref_aggr;
     pool_type* owned_pool;
     pool_type* pool;
+    //! shared scheduler of the allocation and writes, or nullptr
+    scheduler_type* scheduler;
+    //! unused blocks allocated by the scheduler
+    typename scheduler_type::segment segment;
 
 public:
     //! \name Constructors/Destructors
@@ -605,11 +682,29 @@ public:
           cache(new block_type),
           pref_aggr(prefetch_aggressiveness),
           owned_pool(nullptr),
-          pool(&pool_)
+          pool(&pool_),
+          scheduler(nullptr)
     {
         TLX_LOG << "grow_shrink_stack2::grow_shrink_stack2(...)";
     }
 
+    //! Creates an empty stack whose blocks are allocated and written by a
+    //! scheduler shared with other stacks, which uses its read_write_pool.
+    //! \param scheduler_ scheduler of the stacks, must outlive the stack
+    //! \param prefetch_aggressiveness number of blocks that will be used from prefetch pool
+    explicit grow_shrink_stack2(scheduler_type& scheduler_,
+                                const size_t prefetch_aggressiveness = 0)
+        : m_size(0),
+          cache_offset(0),
+          cache(new block_type),
+          pref_aggr(prefetch_aggressiveness),
+          owned_pool(nullptr),
+          pool(&scheduler_.pool()),
+          scheduler(&scheduler_)
+    {
+        TLX_LOG << "grow_shrink_stack2::grow_shrink_stack2(scheduler)";
+    }
+
     //! non-copyable: delete copy-constructor
     grow_shrink_stack2(const grow_shrink_stack2&) = delete;
     //! non-copyable: delete assignment operator
@@ -630,6 +725,8 @@ public:
         std::swap(pref_aggr, obj.pref_aggr);
         std::swap(owned_pool, obj.owned_pool);
         std::swap(pool, obj.pool);
+        std::swap(scheduler, obj.scheduler);
+        segment.swap(obj.segment);
     }
 
     //! \}
@@ -654,6 +751,12 @@ public:
             typename std::vector<bid_type>::const_iterator end = bids.end();
             for ( ; cur != end; ++cur)
             {
+                if (scheduler)
+                {
+                    // drop the writes the scheduler still holds back
+                    scheduler->cancel(*cur);
+                    continue;
+                }
                 // FIXME: read_write_pool needs something like cancel_write(bid)
                 block_type* b = nullptr; // w_pool.steal(*cur);
                 if (b)
@@ -667,6 +770,8 @@ public:
         catch (const foxxll::io_error&)
         { }
         foxxll::block_manager::get_instance()->delete_blocks(bids.begin(), bids.end());
+        if (scheduler)
+            scheduler->release(segment);
         delete owned_pool;
     }
 
@@ -702,11 +807,20 @@ public:
         {
             TLX_LOG << "grow_shrink_stack2::push(" << val << ") growing, size: " << m_size;
 
-            bids.resize(bids.size() + 1);
-            typename std::vector<bid_type>::iterator cur_bid = bids.end() - 1;
-            foxxll::block_manager::get_instance()->new_blocks(alloc_strategy, cur_bid, bids.end(), cur_bid - bids.begin());
-            pool->write(cache, bids.back());
-            cache = pool->steal();
+            if (scheduler)
+            {
+                bids.push_back(scheduler->new_block(segment));
+                scheduler->write(cache, bids.back());
+                cache = scheduler->steal();
+            }
+            else
+            {
+                bids.resize(bids.size() + 1);
+                typename std::vector<bid_type>::iterator cur_bid = bids.end() - 1;
+                foxxll::block_manager::get_instance()->new_blocks(alloc_strategy, cur_bid, bids.end(), cur_bid - bids.begin());
+                pool->write(cache, bids.back());
+                cache = pool->steal();
+            }
 
             const size_t bids_size = bids.size();
             if (bids_size > 1) {
@@ -760,8 +874,16 @@ public:
 
             bid_type last_block = bids.back();
             bids.pop_back();
-            pool->read(cache, last_block)->wait();
-            foxxll::block_manager::get_instance()->delete_block(last_block);
+            if (scheduler)
+            {
+                scheduler->read(cache, last_block);
+                scheduler->delete_block(segment, last_block);
+            }
+            else
+            {
+                pool->read(cache, last_block)->wait();
+                foxxll::block_manager::get_instance()->delete_block(last_block);
+            }
             rehint();
             cache_offset = block_type::size + 1;
         }
@@ -810,7 +932,11 @@ private:
         const size_t last_pref = (bids.size() > pref_aggr) ? (bids.size() - pref_aggr) : 0u;
 
         for (size_t i = bids.size(); i > last_pref; --i) {
-            pool->hint(bids[i - 1]);  // prefetch
+            // prefetch, except the blocks the scheduler holds back
+            if (scheduler)
+                scheduler->hint(bids[i - 1]);
+            else
+                pool->hint(bids[i - 1]);
         }
     }
 };
@@ -1003,7 +1129,7 @@ enum stack_behaviour { normal, grow_shrink, grow_shrink2 };
 //! \tparam MigrCritSize threshold value for number of elements when
 //!   stxxl::migrating_stack migrates to the external memory, default: <b>2 x BlocksPerPage x BlockSize</b>.
 //!
-//! \tparam AllocStr one of allocation strategies: striping, random_cyclic, simple_random, or fully_random. Default is \b random_cyclic.
+//! \tparam AllocStr one of allocation strategies: striping, random_cyclic, simple_random, fully_random, or runtime_alloc_strategy, which selects one by SETTINGS::alloc_strategy. Default is \b runtime_alloc_strategy.
 //!
 //! \tparam SizeType size type, default is \c external_size_type.
 //!
@@ -1019,7 +1145,7 @@ template <
     class IntStackType = std::stack<ValueType>,
     size_t MigrCritSize = (2* BlocksPerPage* BlockSize),
 
-    class AllocStr = foxxll::default_alloc_strategy,
+    class AllocStr = runtime_alloc_strategy,
     class SizeType = external_size_type
     >
 class STACK_GENERATOR
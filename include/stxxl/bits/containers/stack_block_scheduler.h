@@ -0,0 +1,259 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/stack_block_scheduler.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_STACK_BLOCK_SCHEDULER_HEADER
+#define STXXL_CONTAINERS_STACK_BLOCK_SCHEDULER_HEADER
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/mng/block_alloc_strategy.hpp>
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/read_write_pool.hpp>
+
+namespace stxxl {
+
+//! \addtogroup stlcont_stack
+//! \{
+
+/*!
+ * Schedules the block allocation and the writes of many stacks that share a
+ * read_write_pool, see grow_shrink_stack2, to replace their small random I/Os
+ * by longer sequential ones.
+ *
+ * Each stack allocates its blocks from its own segment, an extent of
+ * consecutive blocks on one disk, which the scheduler requests from the block
+ * manager at once. The disks of the extents follow the allocation strategy.
+ * Blocks popped from a stack return to its segment and are reused by its next
+ * pushes, hence a stack's blocks stay close together.
+ *
+ * The blocks the stacks write are held back until a batch is complete, and
+ * then written in the order of their positions on disk. Reads and prefetch
+ * hints of a held back block are served by the scheduler. The batch takes
+ * blocks of the write pool, and is therefore less than its size.
+ *
+ * The scheduler is not thread-safe, like the pool, and must outlive its
+ * stacks. Call flush() before resizing the write pool.
+ */
+template <typename BlockType,
+          typename AllocStrategy = foxxll::default_alloc_strategy>
+class stack_block_scheduler
+{
+    static constexpr bool debug = false;
+
+public:
+    using block_type = BlockType;
+    using bid_type = typename block_type::bid_type;
+    using alloc_strategy_type = AllocStrategy;
+    using pool_type = foxxll::read_write_pool<block_type>;
+
+    //! The unused blocks of one stack's extents.
+    class segment
+    {
+        friend class stack_block_scheduler;
+
+        //! unused blocks, the next one at the back
+        std::vector<bid_type> m_spare;
+
+    public:
+        void swap(segment& obj)
+        {
+            std::swap(m_spare, obj.m_spare);
+        }
+
+        //! number of blocks allocated but not used by the stack
+        size_t spare() const { return m_spare.size(); }
+    };
+
+private:
+    pool_type* m_pool;
+
+    alloc_strategy_type m_alloc_strategy;
+
+    //! number of blocks of an extent
+    size_t m_extent_blocks;
+
+    //! number of held back blocks which are written together
+    size_t m_batch_blocks;
+
+    //! number of extents allocated
+    size_t m_extents;
+
+    //! blocks which are held back, and the blocks they are written to
+    std::vector<std::pair<bid_type, block_type*> > m_pending;
+
+    typename std::vector<std::pair<bid_type, block_type*> >::iterator
+    find_pending(const bid_type& bid)
+    {
+        return std::find_if(
+            m_pending.begin(), m_pending.end(),
+            [&bid](const std::pair<bid_type, block_type*>& p) {
+                return p.first == bid;
+            });
+    }
+
+public:
+    //! Constructs a scheduler for stacks sharing the pool.
+    //! \param pool  block write/prefetch pool of the stacks
+    //! \param extent_blocks  number of blocks of the extents of the stacks
+    //! \param batch_blocks  number of blocks written together, by default
+    //!                      half of the write pool, at most its size minus one
+    explicit stack_block_scheduler(pool_type& pool, size_t extent_blocks = 16,
+                                   size_t batch_blocks = 0,
+                                   const alloc_strategy_type& alloc_strategy = alloc_strategy_type())
+        : m_pool(&pool),
+          m_alloc_strategy(alloc_strategy),
+          m_extent_blocks(std::max<size_t>(1, extent_blocks)),
+          m_extents(0)
+    {
+        const size_t max_batch = (pool.size_write() > 1) ? pool.size_write() - 1 : 1;
+        m_batch_blocks = std::min((batch_blocks == 0) ? max_batch / 2 : batch_blocks, max_batch);
+        m_batch_blocks = std::max<size_t>(1, m_batch_blocks);
+        m_pending.reserve(m_batch_blocks);
+    }
+
+    //! non-copyable: delete copy-constructor
+    stack_block_scheduler(const stack_block_scheduler&) = delete;
+    //! non-copyable: delete assignment operator
+    stack_block_scheduler& operator = (const stack_block_scheduler&) = delete;
+
+    ~stack_block_scheduler()
+    {
+        flush();
+    }
+
+    pool_type& pool() { return *m_pool; }
+
+    //! number of blocks written together
+    size_t batch_blocks() const { return m_batch_blocks; }
+
+    //! number of blocks held back
+    size_t pending() const { return m_pending.size(); }
+
+    //! Allocates the next block of the stack's segment, and a new extent if
+    //! it has no unused blocks left.
+    bid_type new_block(segment& seg)
+    {
+        if (seg.m_spare.empty())
+        {
+            // one request to the block manager, which places the blocks on
+            // the one disk consecutively as far as it has room
+            std::vector<bid_type> extent(m_extent_blocks);
+            const foxxll::single_disk disk(m_alloc_strategy(m_extents++));
+            foxxll::block_manager::get_instance()->new_blocks(
+                disk, extent.begin(), extent.end());
+            TLX_LOG << "stack_block_scheduler: new extent of " << m_extent_blocks << " blocks";
+
+            seg.m_spare.assign(extent.rbegin(), extent.rend());
+        }
+
+        bid_type bid = seg.m_spare.back();
+        seg.m_spare.pop_back();
+        return bid;
+    }
+
+    //! Returns a block the stack no longer uses to its segment.
+    void delete_block(segment& seg, const bid_type& bid)
+    {
+        seg.m_spare.push_back(bid);
+    }
+
+    //! Frees the unused blocks of the segment.
+    void release(segment& seg)
+    {
+        foxxll::block_manager::get_instance()->delete_blocks(
+            seg.m_spare.begin(), seg.m_spare.end());
+        seg.m_spare.clear();
+    }
+
+    //! Writes the block to bid, with the next batch. The block then belongs
+    //! to the pool.
+    void write(block_type* block, const bid_type& bid)
+    {
+        m_pending.emplace_back(bid, block);
+        if (m_pending.size() >= m_batch_blocks)
+            flush();
+    }
+
+    //! Takes a free block from the pool.
+    block_type * steal()
+    {
+        return m_pool->steal();
+    }
+
+    //! Reads the block at bid into block, which may be exchanged with the
+    //! held back or prefetched one, and waits for it.
+    void read(block_type*& block, const bid_type& bid)
+    {
+        auto it = find_pending(bid);
+        if (it != m_pending.end())
+        {
+            m_pool->add(block);
+            block = it->second;
+            m_pending.erase(it);
+            return;
+        }
+        m_pool->read(block, bid)->wait();
+    }
+
+    //! Gives a prefetch hint, unless the block is held back.
+    bool hint(const bid_type& bid)
+    {
+        if (find_pending(bid) != m_pending.end())
+            return false;
+        return m_pool->hint(bid);
+    }
+
+    //! Drops the prefetched copy of the block.
+    bool invalidate(const bid_type& bid)
+    {
+        return m_pool->invalidate(bid);
+    }
+
+    //! Drops a held back write of a block which is deleted.
+    void cancel(const bid_type& bid)
+    {
+        auto it = find_pending(bid);
+        if (it != m_pending.end())
+        {
+            m_pool->add(it->second);
+            m_pending.erase(it);
+        }
+    }
+
+    //! Writes the held back blocks, in the order of their positions on disk.
+    void flush()
+    {
+        if (m_pending.empty())
+            return;
+
+        TLX_LOG << "stack_block_scheduler: writing " << m_pending.size() << " blocks";
+
+        std::sort(m_pending.begin(), m_pending.end(),
+                  [](const std::pair<bid_type, block_type*>& a,
+                     const std::pair<bid_type, block_type*>& b) {
+                      return std::make_pair(a.first.storage, a.first.offset)
+                             < std::make_pair(b.first.storage, b.first.offset);
+                  });
+
+        for (std::pair<bid_type, block_type*>& p : m_pending)
+            m_pool->write(p.second, p.first);
+        m_pending.clear();
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_STACK_BLOCK_SCHEDULER_HEADER
@@ -0,0 +1,535 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/static_index.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_STATIC_INDEX_HEADER
+#define STXXL_CONTAINERS_STATIC_INDEX_HEADER
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/typed_block.hpp>
+
+#include <stxxl/bits/common/block_array.h>
+#include <stxxl/bits/common/disk_space.h>
+#include <stxxl/bits/containers/vector.h>
+#include <stxxl/bits/defines.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+//! Key of a static_index which is the value itself.
+template <typename ValueType>
+struct static_index_identity
+{
+    const ValueType& operator () (const ValueType& v) const
+    {
+        return v;
+    }
+};
+
+/*!
+ * Read-only search index over a sorted stxxl::vector, built in one sequential
+ * pass, for immutable data which would otherwise be loaded into a
+ * stxxl::map.
+ *
+ * The vector's blocks are the leaves of a static B+-tree. Its fence keys, the
+ * first key of each block of the vector, are kept in internal memory as long
+ * as they fit into top_bytes. Otherwise they are written into fence blocks,
+ * whose first keys form the next level, until the top level fits into
+ * internal memory. A lookup reads one block of each fence level on disk and
+ * one block of the vector; with the default top_bytes, the fence keys of
+ * vectors of several TiB stay in internal memory, and a lookup reads a single
+ * block.
+ *
+ * The batched lookups process the keys in sorted order, such that each block
+ * is read once per batch. The index keeps the last block read of each level,
+ * hence it is not thread-safe.
+ *
+ * The vector is flushed by the construction and is read directly from disk
+ * afterwards; it must not be modified or destroyed as long as the index is
+ * used. Compressed vectors are not supported.
+ *
+ * \tparam VectorType type of the sorted stxxl::vector
+ * \tparam KeyOfValue functor returning the key of a value
+ * \tparam CompareType strict weak ordering of the keys, by which the vector
+ *   is sorted
+ * \tparam BlockSize size of the fence blocks in bytes
+ * \tparam AllocStr parallel disk block allocation strategy of the fence blocks
+ */
+template <typename VectorType,
+          typename KeyOfValue = static_index_identity<typename VectorType::value_type>,
+          typename CompareType = std::less<
+              typename std::decay<typename std::result_of<
+                                      KeyOfValue(const typename VectorType::value_type&)>::type>::type>,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(typename VectorType::value_type),
+          typename AllocStr = foxxll::default_alloc_strategy>
+class static_index
+{
+    static constexpr bool debug = false;
+
+public:
+    using vector_type = VectorType;
+    using value_type = typename vector_type::value_type;
+    using key_type = typename std::decay<
+              typename std::result_of<KeyOfValue(const value_type&)>::type>::type;
+    using key_of_value = KeyOfValue;
+    using key_compare = CompareType;
+    using size_type = typename vector_type::size_type;
+
+    //! block of the vector, a leaf of the index
+    using block_type = typename vector_type::block_type;
+    //! block of fence keys
+    using fence_block_type = foxxll::typed_block<BlockSize, key_type>;
+    using bid_type = typename fence_block_type::bid_type;
+
+    static_assert(!vector_type::compressed,
+                  "static_index reads the blocks of the vector directly, compressed vectors are not supported");
+    static_assert(fence_block_type::size >= 2,
+                  "static_index needs fence blocks of at least two keys");
+
+protected:
+    using bids_container_iterator = typename vector_type::bids_container_iterator;
+
+    //! values per block of the vector
+    static constexpr size_t block_values = block_type::size;
+    //! keys per fence block
+    static constexpr size_t block_fences = fence_block_type::size;
+
+    static constexpr size_t no_block = size_t(-1);
+
+    //! A level of fence keys on disk with the buffer of its lookups.
+    struct level_type
+    {
+        std::vector<bid_type> bids;
+        //! number of keys
+        size_t size = 0;
+        //! buffer of the lookups and the block it holds
+        fence_block_type* block = nullptr;
+        size_t block_no = no_block;
+
+        //! Number of keys in block i.
+        size_t block_size(size_t i) const
+        {
+            return std::min(size_t(block_fences), size - i * block_fences);
+        }
+    };
+
+    //! Writes the keys of a level into its fence blocks, through two blocks
+    //! written asynchronously.
+    class fence_writer
+    {
+        level_type& m_level;
+        fence_block_type* m_blocks;
+        size_t m_buffer = 0;
+        foxxll::request_ptr m_reqs[2];
+
+    public:
+        explicit fence_writer(level_type& level)
+            : m_level(level), m_blocks(new_block_array<fence_block_type>(2))
+        { }
+
+        //! non-copyable: delete copy-constructor
+        fence_writer(const fence_writer&) = delete;
+        //! non-copyable: delete assignment operator
+        fence_writer& operator = (const fence_writer&) = delete;
+
+        ~fence_writer()
+        {
+            wait_writes();
+            delete_block_array(m_blocks, 2);
+        }
+
+        //! Append a key, returns whether it starts a new fence block.
+        bool push(const key_type& key)
+        {
+            const size_t fill = m_level.size % block_fences;
+            if (fill == 0 && m_level.size > 0)
+                write_block();
+            m_blocks[m_buffer].elem[fill] = key;
+            ++m_level.size;
+            return fill == 0;
+        }
+
+        //! Write the last block.
+        void finish()
+        {
+            if (m_level.size > 0)
+                write_block();
+            wait_writes();
+        }
+
+    private:
+        void wait_writes()
+        {
+            for (foxxll::request_ptr& req : m_reqs)
+            {
+                if (req.valid())
+                    req->wait();
+                req = foxxll::request_ptr();
+            }
+        }
+
+        void write_block()
+        {
+            std::vector<bid_type>& bids = m_level.bids;
+            bids.emplace_back();
+            foxxll::block_manager::get_instance()->new_blocks(
+                AllocStr(), bids.end() - 1, bids.end(), bids.size() - 1);
+            m_reqs[m_buffer] = m_blocks[m_buffer].write(bids.back());
+
+            m_buffer = 1 - m_buffer;
+            if (m_reqs[m_buffer].valid())
+            {
+                m_reqs[m_buffer]->wait();
+                m_reqs[m_buffer] = foxxll::request_ptr();
+            }
+        }
+    };
+
+    key_of_value m_key;
+    key_compare m_less;
+
+    //! number of values of the vector
+    size_type m_size;
+    //! blocks of the vector
+    bids_container_iterator m_bids;
+
+    //! maximum number of keys of the top level
+    size_t m_max_top;
+    //! keys of the top level: the fence keys of the vector's blocks if there
+    //! is no level on disk, otherwise the first keys of the blocks of the
+    //! highest level
+    std::vector<key_type> m_top;
+    //! fence levels on disk, level 0 holds the fence keys of the vector
+    std::vector<std::unique_ptr<level_type> > m_levels;
+
+    //! buffer of the lookups and the block of the vector it holds
+    block_type* m_block;
+    mutable size_t m_block_no = no_block;
+
+public:
+    /*!
+     * Build the index of the sorted vector in one sequential pass.
+     *
+     * \param vec vector sorted by the keys, it is flushed
+     * \param top_bytes internal memory of the top level of fence keys
+     * \param key functor returning the key of a value
+     * \param less comparison object of the keys
+     */
+    explicit static_index(const vector_type& vec,
+                          size_t top_bytes = 16 * 1024 * 1024,
+                          const key_of_value& key = key_of_value(),
+                          const key_compare& less = key_compare())
+        : m_key(key), m_less(less),
+          m_size(vec.size()),
+          m_bids(vec.cbegin().bid()),
+          m_max_top(std::max<size_t>(top_bytes / sizeof(key_type), 1)),
+          m_block(new_block_array<block_type>(1))
+    {
+        try {
+            build(vec);
+        }
+        catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    //! non-copyable: delete copy-constructor
+    static_index(const static_index&) = delete;
+    //! non-copyable: delete assignment operator
+    static_index& operator = (const static_index&) = delete;
+
+    ~static_index()
+    {
+        release();
+    }
+
+    //! \name Lookup
+    //! \{
+
+    //! Position of the first value whose key is not less than key.
+    size_type lower_bound(const key_type& key) const
+    {
+        const size_t b = fences_before(key, false);
+        if (b == 0)
+            return 0;
+        const value_type* begin = read_block(b - 1);
+        const value_type* end = begin + block_size(b - 1);
+        return position(b - 1) + static_cast<size_type>(
+            std::lower_bound(begin, end, key,
+                             [this](const value_type& v, const key_type& k) {
+                                 return m_less(m_key(v), k);
+                             }) - begin);
+    }
+
+    //! Position of the first value whose key is greater than key.
+    size_type upper_bound(const key_type& key) const
+    {
+        const size_t b = fences_before(key, true);
+        if (b == 0)
+            return 0;
+        const value_type* begin = read_block(b - 1);
+        const value_type* end = begin + block_size(b - 1);
+        return position(b - 1) + static_cast<size_type>(
+            std::upper_bound(begin, end, key,
+                             [this](const key_type& k, const value_type& v) {
+                                 return m_less(k, m_key(v));
+                             }) - begin);
+    }
+
+    //! Positions [first, last) of the values with keys in [lower, upper), to
+    //! be read by iterators of the vector.
+    std::pair<size_type, size_type> range(const key_type& lower, const key_type& upper) const
+    {
+        const size_type first = lower_bound(lower);
+        return std::make_pair(first, std::max(first, lower_bound(upper)));
+    }
+
+    //! Look up key: returns whether it is present and sets value to a value
+    //! with the key, the first one of its block of the vector. Reads one
+    //! block of each level of fence blocks on disk and one of the vector.
+    bool find(const key_type& key, value_type& value) const
+    {
+        // only the block of the last fence key not greater than key may hold
+        // it, an equal fence key starts the block
+        const size_t b = fences_before(key, true);
+        if (b == 0)
+            return false;
+        const value_type* begin = read_block(b - 1);
+        const value_type* end = begin + block_size(b - 1);
+        const value_type* v = std::lower_bound(
+            begin, end, key,
+            [this](const value_type& a, const key_type& k) { return m_less(m_key(a), k); });
+        if (v == end || m_less(key, m_key(*v)))
+            return false;
+        value = *v;
+        return true;
+    }
+
+    //! Returns whether key is present.
+    bool contains(const key_type& key) const
+    {
+        value_type value;
+        return find(key, value);
+    }
+
+    //! Write lower_bound() of each key in [first, last) to out, in the order
+    //! of the keys. Each block is read at most once.
+    template <typename KeyIterator, typename OutputIterator>
+    OutputIterator lower_bound(KeyIterator first, KeyIterator last, OutputIterator out) const
+    {
+        std::vector<size_type> result;
+        for_each_sorted(first, last, result, [this](const key_type& key) {
+                            return lower_bound(key);
+                        });
+        return std::copy(result.begin(), result.end(), out);
+    }
+
+    //! Look up each key in [first, last) and write the pairs of find()'s
+    //! result and the value found to out, in the order of the keys. Each
+    //! block is read at most once.
+    template <typename KeyIterator, typename OutputIterator>
+    OutputIterator find(KeyIterator first, KeyIterator last, OutputIterator out) const
+    {
+        std::vector<std::pair<bool, value_type> > result;
+        for_each_sorted(first, last, result, [this](const key_type& key) {
+                            std::pair<bool, value_type> r;
+                            r.first = find(key, r.second);
+                            return r;
+                        });
+        return std::copy(result.begin(), result.end(), out);
+    }
+
+    //! \}
+
+    //! \name Properties
+    //! \{
+
+    //! Number of values of the vector.
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    //! Number of levels of fence blocks on disk, each costs a lookup one
+    //! block read.
+    size_t levels() const
+    {
+        return m_levels.size();
+    }
+
+    //! Bytes of internal memory used by the top level of fence keys.
+    size_t index_memory() const
+    {
+        return m_top.size() * sizeof(key_type);
+    }
+
+    //! \}
+
+protected:
+    //! Number of values in block i of the vector.
+    size_t block_size(size_t i) const
+    {
+        return static_cast<size_t>(std::min(size_type(block_values), m_size - position(i)));
+    }
+
+    //! Position of the first value of block i of the vector.
+    static size_type position(size_t i)
+    {
+        return static_cast<size_type>(i) * block_values;
+    }
+
+    //! Scan the vector, appending the first key of each block to the fence
+    //! keys.
+    void build(const vector_type& vec)
+    {
+        std::vector<std::unique_ptr<fence_writer> > writers;
+
+        // Append key to the given level, moving the top level to disk if it
+        // grows too large. A new fence block adds its first key to the level
+        // above.
+        std::function<void(size_t, const key_type&)> push =
+            [&](size_t level, const key_type& key) {
+                if (level < writers.size())
+                {
+                    if (writers[level]->push(key))
+                        push(level + 1, key);
+                    return;
+                }
+                m_top.push_back(key);
+                if (m_top.size() <= m_max_top)
+                    return;
+
+                TLX_LOG << "static_index: moving " << m_top.size()
+                        << " fence keys of level " << level << " to disk";
+                std::vector<key_type> top;
+                top.swap(m_top);
+                m_levels.emplace_back(new level_type());
+                m_levels.back()->block = new_block_array<fence_block_type>(1);
+                writers.emplace_back(new fence_writer(*m_levels.back()));
+                for (const key_type& k : top)
+                    push(level, k);
+            };
+
+        typename vector_type::bufreader_type reader(vec);
+        size_type i = 0;
+        key_type prev = key_type();
+        for ( ; !reader.empty(); ++reader, ++i)
+        {
+            const key_type k = m_key(*reader);
+            if (i > 0 && m_less(k, prev))
+                throw foxxll::bad_parameter("stxxl::static_index(): the vector is not sorted");
+            if (i % block_values == 0)
+                push(0, k);
+            prev = k;
+        }
+
+        for (const std::unique_ptr<fence_writer>& w : writers)
+            w->finish();
+
+        TLX_LOG << "static_index: " << m_size << " values, " << m_levels.size()
+                << " fence levels on disk, " << m_top.size() << " top keys";
+    }
+
+    //! Free the fence blocks and the buffers.
+    void release()
+    {
+        for (const std::unique_ptr<level_type>& level : m_levels)
+        {
+            disk_space_reclaimer::get_instance().delete_blocks(
+                level->bids.begin(), level->bids.end());
+            if (level->block)
+                delete_block_array(level->block, 1);
+        }
+        m_levels.clear();
+        if (m_block)
+            delete_block_array(m_block, 1);
+        m_block = nullptr;
+    }
+
+    /*!
+     * Number of fence keys of the vector's blocks which are less than key,
+     * or not greater than key if upper is set, by descending from the top
+     * level through one fence block of each level on disk.
+     */
+    size_t fences_before(const key_type& key, bool upper) const
+    {
+        auto count = [&](const key_type* begin, const key_type* end) {
+                         return static_cast<size_t>(
+                             (upper ? std::upper_bound(begin, end, key, m_less)
+                              : std::lower_bound(begin, end, key, m_less)) - begin);
+                     };
+
+        size_t c = count(m_top.data(), m_top.data() + m_top.size());
+        for (size_t l = m_levels.size(); l-- > 0 && c > 0; )
+        {
+            // the keys of block c - 1 of level l are split by key, those of
+            // the blocks before by the fence keys of the blocks after
+            level_type& level = *m_levels[l];
+            const size_t b = c - 1;
+            if (level.block_no != b)
+            {
+                level.block_no = no_block;
+                level.block->read(level.bids[b])->wait();
+                level.block_no = b;
+            }
+            c = b * block_fences + count(level.block->elem, level.block->elem + level.block_size(b));
+        }
+        return c;
+    }
+
+    //! Read block i of the vector unless it is the last one read.
+    const value_type* read_block(size_t i) const
+    {
+        if (m_block_no != i)
+        {
+            m_block_no = no_block;
+            m_block->read(m_bids[i])->wait();
+            m_block_no = i;
+        }
+        return m_block->elem;
+    }
+
+    //! Call f for the keys in sorted order, storing the results in result in
+    //! the order of the keys.
+    template <typename KeyIterator, typename Result, typename Functor>
+    void for_each_sorted(KeyIterator first, KeyIterator last,
+                         std::vector<Result>& result, Functor f) const
+    {
+        const std::vector<key_type> keys(first, last);
+        std::vector<size_t> order(keys.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(),
+                  [&](size_t a, size_t b) { return m_less(keys[a], keys[b]); });
+
+        result.resize(keys.size());
+        for (size_t i : order)
+            result[i] = f(keys[i]);
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_STATIC_INDEX_HEADER
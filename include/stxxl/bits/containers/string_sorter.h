@@ -0,0 +1,568 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/string_sorter.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_STRING_SORTER_HEADER
+#define STXXL_CONTAINERS_STRING_SORTER_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/common/binary_buffer.h>
+#include <stxxl/bits/containers/pager.h>
+#include <stxxl/bits/containers/var_vector.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+namespace string_sorter_local {
+
+//! Character at depth, shifted by one such that the end of the string sorts
+//! before all characters, including NUL bytes.
+inline unsigned char_at(const std::string& s, size_t depth)
+{
+    return depth < s.size() ? static_cast<unsigned char>(s[depth]) + 1u : 0u;
+}
+
+//! Length of the longest common prefix of a and b, which are known to have
+//! a common prefix of depth characters.
+inline size_t lcp(const std::string& a, const std::string& b, size_t depth = 0)
+{
+    const size_t n = std::min(a.size(), b.size());
+    while (depth < n && a[depth] == b[depth])
+        ++depth;
+    return depth;
+}
+
+//! Insertion sort of strings with a common prefix of depth characters.
+inline void insertion_sort(const std::string** a, size_t n, size_t depth)
+{
+    for (size_t i = 1; i < n; ++i)
+    {
+        const std::string* s = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1]->compare(depth, std::string::npos,
+                                          *s, depth, std::string::npos) > 0)
+        {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = s;
+    }
+}
+
+//! Multikey quicksort (Bentley and Sedgewick) of strings with a common prefix
+//! of depth characters, which inspects each character about once.
+inline void multikey_quicksort(const std::string** a, size_t n, size_t depth)
+{
+    while (n > 1)
+    {
+        if (n < 16)
+            return insertion_sort(a, n, depth);
+
+        // median of three characters as pivot
+        unsigned c0 = char_at(*a[0], depth), c1 = char_at(*a[n / 2], depth),
+            c2 = char_at(*a[n - 1], depth);
+        if (c0 > c1) std::swap(c0, c1);
+        if (c1 > c2) std::swap(c1, c2);
+        const unsigned pivot = std::max(c0, c1);
+
+        // three-way partition by the character at depth
+        size_t lt = 0, i = 0, gt = n;
+        while (i < gt)
+        {
+            const unsigned c = char_at(*a[i], depth);
+            if (c < pivot)
+                std::swap(a[lt++], a[i++]);
+            else if (c > pivot)
+                std::swap(a[i], a[--gt]);
+            else
+                ++i;
+        }
+
+        multikey_quicksort(a, lt, depth);
+        multikey_quicksort(a + gt, n - gt, depth);
+
+        // the equal strings have ended, or continue at the next character
+        if (pivot == 0)
+            return;
+        a += lt, n = gt - lt, ++depth;
+    }
+}
+
+/*!
+ * Reader of a sorted run, which is stored front-coded in a var_vector: each
+ * record is the LCP with the previous string as varint, followed by the
+ * remaining characters.
+ */
+template <typename RunType>
+class run_reader
+{
+    typename RunType::stream m_stream;
+    std::string m_str;
+    size_t m_lcp;
+
+    void decode()
+    {
+        const binary_buffer& record = *m_stream;
+        binary_reader br(record.data(), record.size());
+        m_lcp = static_cast<size_t>(br.get_varint64());
+        assert(m_lcp <= m_str.size());
+        m_str.resize(m_lcp);
+        m_str.append(record.data() + br.curr(), record.size() - br.curr());
+    }
+
+public:
+    explicit run_reader(const RunType& run)
+        : m_stream(run), m_lcp(0)
+    {
+        if (!m_stream.empty())
+            decode();
+    }
+
+    bool empty() const { return m_stream.empty(); }
+
+    //! current string
+    const std::string & str() const { return m_str; }
+
+    //! LCP of the current string with the previous one of the run
+    size_t lcp() const { return m_lcp; }
+
+    void next()
+    {
+        ++m_stream;
+        if (!m_stream.empty())
+            decode();
+    }
+};
+
+/*!
+ * LCP-aware loser tree merge of sorted runs.
+ *
+ * Each node stores its loser and the LCP of the loser with the winner of the
+ * node. All strings on the path of the last winner hence know their LCP with
+ * it, and so does its successor from the same run. The games on the path then
+ * compare the LCPs first, and only equal LCPs compare characters, after the
+ * common prefix. The LCP of the winner with the previous output is known as
+ * well, and front-codes the output for free.
+ */
+template <typename RunType>
+class lcp_merger
+{
+    using reader_type = run_reader<RunType>;
+
+    struct node_type
+    {
+        size_t loser;
+        size_t lcp;
+    };
+
+    std::vector<std::unique_ptr<reader_type> > m_readers;
+    //! number of leaves, a power of two
+    size_t m_leaves;
+    //! internal nodes 1 .. m_leaves - 1
+    std::vector<node_type> m_nodes;
+    size_t m_winner;
+    size_t m_winner_lcp;
+
+    bool exhausted(size_t i) const
+    {
+        return i >= m_readers.size() || m_readers[i]->empty();
+    }
+
+    //! Plays x, with LCP hx to the previous winner, against the loser of the
+    //! node, and leaves the winner and its LCP in x and hx.
+    void play(size_t node, size_t& x, size_t& hx)
+    {
+        node_type& n = m_nodes[node];
+        if (exhausted(n.loser))
+            return;
+
+        if (exhausted(x) || hx < n.lcp)
+        {
+            std::swap(n.loser, x);
+            std::swap(n.lcp, hx);
+            return;
+        }
+        if (hx > n.lcp)
+            return;
+
+        const std::string& sx = m_readers[x]->str();
+        const std::string& sy = m_readers[n.loser]->str();
+        const size_t h = string_sorter_local::lcp(sx, sy, hx);
+        n.lcp = h;
+        if (char_at(sx, h) > char_at(sy, h))
+            std::swap(n.loser, x);
+    }
+
+    size_t initialize(size_t node)
+    {
+        if (node >= m_leaves)
+            return node - m_leaves;
+
+        size_t x = initialize(2 * node), hx = 0;
+        m_nodes[node] = node_type { initialize(2 * node + 1), 0 };
+        play(node, x, hx);
+        return x;
+    }
+
+public:
+    //! Merges the runs, which must outlive the merger.
+    template <typename RunIterator>
+    lcp_merger(RunIterator begin, RunIterator end)
+        : m_leaves(1), m_winner_lcp(0)
+    {
+        for ( ; begin != end; ++begin)
+            m_readers.emplace_back(new reader_type(**begin));
+        while (m_leaves < m_readers.size())
+            m_leaves *= 2;
+
+        m_nodes.resize(m_leaves);
+        m_winner = initialize(1);
+    }
+
+    bool empty() const { return exhausted(m_winner); }
+
+    //! current smallest string
+    const std::string & str() const
+    {
+        assert(!empty());
+        return m_readers[m_winner]->str();
+    }
+
+    //! LCP of the current string with the previous output
+    size_t lcp() const { return m_winner_lcp; }
+
+    void next()
+    {
+        assert(!empty());
+        size_t x = m_winner;
+        m_readers[x]->next();
+        // the previous string of the run was the previous output
+        size_t hx = exhausted(x) ? 0 : m_readers[x]->lcp();
+
+        for (size_t node = (m_leaves + x) / 2; node >= 1; node /= 2)
+            play(node, x, hx);
+
+        m_winner = x;
+        m_winner_lcp = hx;
+    }
+};
+
+} // namespace string_sorter_local
+
+/*!
+ * External sorter of strings, with run formation by multikey quicksort and an
+ * LCP-aware multiway merge.
+ *
+ * Strings are collected in internal memory until memory_to_use bytes are
+ * filled, then sorted with multikey quicksort and written as a run into a
+ * var_vector. The runs are front-coded: each string stores its LCP (longest
+ * common prefix) with its predecessor, followed by the remaining characters,
+ * hence a run holds its LCP array and long common prefixes do not cost I/O.
+ *
+ * sort() merges the runs with an LCP loser tree, which uses the LCPs of the
+ * runs to avoid comparing the common prefixes again. If there are more runs
+ * than the memory allows to merge at once, groups of runs are merged into
+ * longer runs first. If all strings fit into memory, no run is written.
+ *
+ * Like stxxl::sorter, strings are push()ed in the input state, and read with
+ * the stream interface in the output state after sort(). lcp() returns the LCP
+ * of the current string with the previous one.
+ *
+ * \tparam BlockSize external block size in bytes of the runs
+ * \tparam AllocStr parallel disk block allocation strategy
+ */
+template <size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(uint64_t),
+          typename AllocStr = foxxll::default_alloc_strategy>
+class string_sorter
+{
+    static constexpr bool debug = false;
+
+public:
+    //! \name Types
+    //! \{
+
+    using value_type = std::string;
+    using size_type = foxxll::external_size_type;
+
+    //! container of a front-coded run
+    using run_type = var_vector<lru_pager<2>, BlockSize, AllocStr>;
+
+    //! \}
+
+protected:
+    using merger_type = string_sorter_local::lcp_merger<run_type>;
+
+    //! blocks of the page caches and read buffers of a run
+    static size_t run_blocks()
+    {
+        return 2 * (2 * 4 + 2 * foxxll::config::get_instance()->disks_number());
+    }
+
+    size_t m_memory_to_use;
+
+    //! strings of the current run
+    std::vector<std::string> m_strings;
+    //! memory used by m_strings
+    size_t m_bytes;
+
+    //! the strings in m_strings in sorted order, and their LCPs
+    std::vector<const std::string*> m_sorted;
+    std::vector<size_t> m_lcps;
+
+    std::vector<std::unique_ptr<run_type> > m_runs;
+    std::unique_ptr<merger_type> m_merger;
+
+    size_type m_size;
+    //! next string of the output state in internal memory
+    size_t m_pos;
+    bool m_output;
+
+    //! Sorts m_strings into m_sorted and computes m_lcps.
+    void sort_strings()
+    {
+        m_sorted.resize(m_strings.size());
+        for (size_t i = 0; i < m_strings.size(); ++i)
+            m_sorted[i] = &m_strings[i];
+        string_sorter_local::multikey_quicksort(m_sorted.data(), m_sorted.size(), 0);
+
+        m_lcps.resize(m_sorted.size());
+        for (size_t i = 0; i < m_sorted.size(); ++i)
+            m_lcps[i] = (i == 0) ? 0 : string_sorter_local::lcp(*m_sorted[i - 1], *m_sorted[i]);
+    }
+
+    //! Appends a front-coded string to a run.
+    static void append(run_type& run, const std::string& str, size_t lcp, binary_buffer& record)
+    {
+        record.clear();
+        record.put_varint(static_cast<uint64_t>(lcp));
+        record.append(str.data() + lcp, str.size() - lcp);
+        run.push_back(record);
+    }
+
+    //! Sorts the strings in memory and writes them as a run.
+    void write_run()
+    {
+        if (m_strings.empty())
+            return;
+
+        sort_strings();
+        TLX_LOG << "string_sorter: writing run " << m_runs.size()
+                << " of " << m_strings.size() << " strings";
+
+        m_runs.emplace_back(new run_type());
+        binary_buffer record;
+        for (size_t i = 0; i < m_sorted.size(); ++i)
+            append(*m_runs.back(), *m_sorted[i], m_lcps[i], record);
+        m_runs.back()->flush();
+
+        std::vector<std::string>().swap(m_strings);
+        std::vector<const std::string*>().swap(m_sorted);
+        std::vector<size_t>().swap(m_lcps);
+        m_bytes = 0;
+    }
+
+    //! Merges groups of runs until the rest can be merged at once.
+    void merge_runs()
+    {
+        const size_t fan_in = std::max<size_t>(
+            2, m_memory_to_use / (run_blocks() * BlockSize) - 1);
+
+        while (m_runs.size() > fan_in)
+        {
+            TLX_LOG << "string_sorter: merging " << m_runs.size()
+                    << " runs with fan-in " << fan_in;
+
+            std::vector<std::unique_ptr<run_type> > runs;
+            binary_buffer record;
+            for (size_t i = 0; i < m_runs.size(); i += fan_in)
+            {
+                const size_t end = std::min(i + fan_in, m_runs.size());
+                if (end - i == 1)
+                {
+                    runs.emplace_back(std::move(m_runs[i]));
+                    continue;
+                }
+
+                runs.emplace_back(new run_type());
+                {
+                    merger_type merger(m_runs.begin() + i, m_runs.begin() + end);
+                    for ( ; !merger.empty(); merger.next())
+                        append(*runs.back(), merger.str(), merger.lcp(), record);
+                }
+                runs.back()->flush();
+
+                for (size_t j = i; j < end; ++j)
+                    m_runs[j].reset();
+            }
+            m_runs.swap(runs);
+        }
+    }
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    //! Constructor, the sorter uses about memory_to_use bytes of internal
+    //! memory for the strings of a run, or the buffers of the merge.
+    explicit string_sorter(size_t memory_to_use)
+        : m_memory_to_use(memory_to_use), m_bytes(0),
+          m_size(0), m_pos(0), m_output(false)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    string_sorter(const string_sorter&) = delete;
+    //! non-copyable: delete assignment operator
+    string_sorter& operator = (const string_sorter&) = delete;
+
+    //! \}
+
+    //! \name Input State
+    //! \{
+
+    //! Push another string (only callable during input state).
+    void push(const std::string& str)
+    {
+        assert(!m_output);
+        m_strings.push_back(str);
+        m_bytes += str.size() + sizeof(std::string)
+                   + sizeof(const std::string*) + sizeof(size_t);
+        ++m_size;
+
+        if (m_bytes >= m_memory_to_use)
+            write_run();
+    }
+
+    //! Push a string of n bytes.
+    void push(const void* data, size_t n)
+    {
+        push(std::string(static_cast<const char*>(data), n));
+    }
+
+    //! Switch to output state, rewind() in case the output was already sorted.
+    void sort()
+    {
+        if (m_output)
+            return rewind();
+
+        if (m_runs.empty())
+        {
+            // all strings fit into memory
+            sort_strings();
+        }
+        else
+        {
+            write_run();
+            merge_runs();
+            m_merger.reset(new merger_type(m_runs.begin(), m_runs.end()));
+        }
+        m_pos = 0;
+        m_output = true;
+    }
+
+    //! Remove all strings and return to the input state.
+    void clear()
+    {
+        m_merger.reset();
+        m_runs.clear();
+        std::vector<std::string>().swap(m_strings);
+        m_sorted.clear();
+        m_lcps.clear();
+        m_bytes = 0;
+        m_size = 0;
+        m_pos = 0;
+        m_output = false;
+    }
+
+    //! \}
+
+    //! \name Output State
+    //! \{
+
+    //! Rewind output stream to beginning.
+    void rewind()
+    {
+        assert(m_output);
+        if (!m_runs.empty())
+        {
+            m_merger.reset();
+            m_merger.reset(new merger_type(m_runs.begin(), m_runs.end()));
+        }
+        m_pos = 0;
+    }
+
+    //! Number of strings pushed or strings remaining to be read.
+    size_type size() const
+    {
+        return m_size - m_pos;
+    }
+
+    //! Number of runs written to external memory.
+    size_t num_runs() const
+    {
+        return m_runs.size();
+    }
+
+    //! Standard stream method
+    bool empty() const
+    {
+        assert(m_output);
+        return m_pos == m_size;
+    }
+
+    //! Standard stream method
+    const value_type& operator * () const
+    {
+        assert(m_output && !empty());
+        return m_merger ? m_merger->str() : *m_sorted[m_pos];
+    }
+
+    //! Standard stream method
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! LCP of the current string with the previous one, zero for the first.
+    size_t lcp() const
+    {
+        assert(m_output && !empty());
+        return m_merger ? m_merger->lcp() : m_lcps[m_pos];
+    }
+
+    //! Standard stream method (preincrement operator)
+    string_sorter& operator ++ ()
+    {
+        assert(m_output && !empty());
+        if (m_merger)
+            m_merger->next();
+        ++m_pos;
+        return *this;
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_STRING_SORTER_HEADER
@@ -151,6 +151,29 @@ public:
         : impl(begin, end, mem_to_sort, n, hf, cmp, buffer_size, a)
     { }
 
+    /*!
+     * Construct a new hash-map from all values of a stream, see bulk_load().
+     *
+     * \param input stream of values
+     * \param num_values (estimated) number of values in the stream,
+     * determines the number of buckets
+     * \param mem_to_sort internal memory that may be used for
+     * bulk-construction (not to be confused with the buffer-memory)
+     * \param hf hash-function
+     * \param cmp comparator-object
+     * \param buffer_size size of internal-memory buffer in bytes
+     * \param a allocation-strategory for internal-memory buffer
+     */
+    template <class InputStream>
+    unordered_map(InputStream& input, external_size_type num_values,
+                  internal_size_type mem_to_sort = 256*1024*1024,
+                  const hasher& hf = hasher(),
+                  const key_compare& cmp = key_compare(),
+                  internal_size_type buffer_size = 100*1024*1024,
+                  const allocator_type& a = allocator_type())
+        : impl(input, num_values, mem_to_sort, hf, cmp, buffer_size, a)
+    { }
+
     //! non-copyable: delete copy-constructor
     unordered_map(const unordered_map&) = delete;
     //! non-copyable: delete assignment operator
@@ -212,6 +235,16 @@ public:
         return impl.end();
     }
 
+    //! Call function(value) for each value in parallel and in no particular
+    //! order, without iterators, see hash_map::for_each_parallel().
+    //! \param function called as function(const value_type&)
+    //! \param n_parts number of bucket ranges, default: the number of threads
+    template <class Functor>
+    void for_each_parallel(Functor function, size_t n_parts = 0) const
+    {
+        impl.for_each_parallel(function, n_parts);
+    }
+
     //! \}
 
     //! \name Lookup and Element Access
@@ -238,6 +271,46 @@ public:
         return impl.find(key);
     }
 
+    //! Look up a batch of keys in bucket order, see hash_map::find_batch().
+    //! \param first begin of the keys to look up
+    //! \param last end of the keys to look up
+    //! \param out receives the iterator of find() for each key, in input order
+    template <class InputIterator, class OutputIterator>
+    OutputIterator find_batch(InputIterator first, InputIterator last,
+                              OutputIterator out) const
+    {
+        return impl.find_batch(first, last, out);
+    }
+
+    //! Start the read-concurrent mode, see hash_map::begin_concurrent_reads().
+    //! \param n_shards number of shards of the readers' block cache
+    void begin_concurrent_reads(size_t n_shards = 16)
+    {
+        impl.begin_concurrent_reads(n_shards);
+    }
+
+    //! End the read-concurrent mode.
+    void end_concurrent_reads()
+    {
+        impl.end_concurrent_reads();
+    }
+
+    //! Whether the read-concurrent mode is active.
+    bool concurrent_reads() const
+    {
+        return impl.concurrent_reads();
+    }
+
+    //! Look up value by key, thread-safe in the read-concurrent mode, see
+    //! hash_map::concurrent_find().
+    //! \param key key for value to look up
+    //! \param value receives the value's mapped part if found
+    //! \return true if the key was found
+    bool concurrent_find(const key_type& key, mapped_type& value) const
+    {
+        return impl.concurrent_find(key, value);
+    }
+
     //! Number of values with given key
     //! \param key key for value to look up
     //! \return 0 or 1 depending on the presence of a value with the given key
@@ -292,6 +365,18 @@ public:
         return impl.insert_oblivious(value);
     }
 
+    //! Insert a value, or merge it into the value stored with the same key;
+    //! external memory is not accessed, the merge with an external value is
+    //! deferred until it is read or written anew. merge must be associative.
+    //! \param value what to insert or merge
+    //! \param merge computes the new mapped value from the stored and the
+    //! given mapped value
+    template <class MergeFunction>
+    void upsert(const value_type& value, MergeFunction merge)
+    {
+        impl.upsert(value, merge);
+    }
+
     //! Bulk-insert of values in the range [f, l)
     //! \param first beginning of the range
     //! \param last end of the range
@@ -303,6 +388,20 @@ public:
         impl.insert(first, last, mem);
     }
 
+    //! Bulk-load the values of a stream into the empty hash-map, writing the
+    //! buckets sequentially in a single pass.
+    //! \param input stream of values
+    //! \param num_values (estimated) number of values in the stream,
+    //! determines the number of buckets
+    //! \param mem internal memory that may be used for sorting (note: this
+    //! memory will be used additionally to the buffer). The more the better
+    template <class InputStream>
+    void bulk_load(InputStream& input, external_size_type num_values,
+                   internal_size_type mem)
+    {
+        impl.bulk_load(input, num_values, mem);
+    }
+
     //! \}
 
     //! \name Modifiers: Erase
@@ -392,7 +491,7 @@ public:
     }
 
     //! Rehash with (at least) n buckets
-    void rehash(internal_size_type n)
+    void rehash(internal_size_type n = 0)
     {
         impl.rehash(n);
     }
@@ -450,6 +549,50 @@ public:
         impl.max_buffer_size(buffer_size);
     }
 
+    //! Bits per key of the filter of the keys in external memory, 0 if
+    //! disabled.
+    double filter_bits_per_key() const
+    {
+        return impl.filter_bits_per_key();
+    }
+
+    //! Set bits per key of the in-memory Bloom filter of the keys in external
+    //! memory, see hash_map::filter_bits_per_key().
+    //! \param bits_per_key bits per key, 0 disables the filter
+    void filter_bits_per_key(double bits_per_key)
+    {
+        impl.filter_bits_per_key(bits_per_key);
+    }
+
+    //! Whether the buffer is flushed incrementally, see
+    //! hash_map::incremental_rehash().
+    bool incremental_rehash() const
+    {
+        return impl.incremental_rehash();
+    }
+
+    //! Flush the buffer incrementally (linear hashing) instead of rewriting
+    //! the whole table, see hash_map::incremental_rehash().
+    //! \param enable whether to flush incrementally
+    void incremental_rehash(bool enable)
+    {
+        impl.incremental_rehash(enable);
+    }
+
+    //! Tuning parameters of this hash-map, see hash_map::get_tuning().
+    const hash_map::tuning_parameters& get_tuning() const
+    {
+        return impl.get_tuning();
+    }
+
+    //! Override the tuning parameters of this hash-map, see
+    //! hash_map::set_tuning().
+    //! \param params new tuning parameters
+    void set_tuning(const hash_map::tuning_parameters& params)
+    {
+        impl.set_tuning(params);
+    }
+
     //! \}
 
     //! \name Statistics
@@ -0,0 +1,369 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/var_unordered_map.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_VAR_UNORDERED_MAP_HEADER
+#define STXXL_CONTAINERS_VAR_UNORDERED_MAP_HEADER
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include <foxxll/common/exceptions.hpp>
+#include <foxxll/common/types.hpp>
+
+#include <stxxl/bits/common/binary_buffer.h>
+#include <stxxl/bits/containers/hash_map/hash_map.h>
+#include <stxxl/bits/containers/pager.h>
+#include <stxxl/bits/containers/vector.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont
+//! \{
+
+/*!
+ * External hash map from keys to values of variable length, e.g. strings or
+ * serialized binary_buffer objects.
+ *
+ * The entries of the hash map have a fixed size: a value of at most
+ * InlineSize bytes is stored in its entry, a longer one is appended to a
+ * value log, a stxxl::vector of bytes, and its entry holds the offset. Thus
+ * small values cost no extra I/O, and a long one the pages of the log it
+ * spans.
+ *
+ * Overwritten and erased values leave garbage in the log. When it exceeds
+ * max_garbage_ratio() of the log, the next update compacts the log while the
+ * hash map rewrites its buckets: the live values are copied to a new log in
+ * the order of the buckets. compact() and rehash() do so at any time.
+ *
+ * \tparam KeyType key type
+ * \tparam HashType hash function of the keys, see stxxl::unordered_map
+ * \tparam CompareType less comparator of the keys with min_value() and
+ * max_value(), see stxxl::unordered_map
+ * \tparam InlineSize maximum length of the values stored in the entries
+ * \tparam SubBlockSize subblock size of the hash map in bytes
+ * \tparam SubBlocksPerBlock block size of the hash map in subblocks
+ * \tparam LogBlockSize external block size in bytes of the value log
+ */
+template <
+    class KeyType,
+    class HashType,
+    class CompareType,
+    unsigned InlineSize = 24,
+    unsigned SubBlockSize = 8* 1024,
+    unsigned SubBlocksPerBlock = 256,
+    size_t LogBlockSize = STXXL_DEFAULT_BLOCK_SIZE(uint64_t)
+    >
+class var_unordered_map
+{
+    static_assert(InlineSize >= sizeof(uint64_t),
+                  "the entries must hold the offset of a value in the log");
+
+public:
+    //! \name Types
+    //! \{
+
+    using key_type = KeyType;
+    using hasher = HashType;
+    using key_compare = CompareType;
+
+    using size_type = foxxll::external_size_type;
+    using internal_size_type = size_t;
+
+    //! Mapped value of the hash map: the length of the value and its bytes
+    //! if it has at most InlineSize, otherwise its offset in the log.
+    struct entry_type
+    {
+        uint32_t length = 0;
+        char data[InlineSize];
+
+        bool is_inline() const { return length <= InlineSize; }
+
+        uint64_t offset() const
+        {
+            uint64_t offset;
+            memcpy(&offset, data, sizeof(offset));
+            return offset;
+        }
+
+        void set_offset(uint64_t offset)
+        {
+            memcpy(data, &offset, sizeof(offset));
+        }
+    };
+
+    using map_type = hash_map::hash_map<
+              key_type, entry_type, hasher, key_compare,
+              SubBlockSize, SubBlocksPerBlock>;
+
+    //! append-only vector of the values longer than InlineSize
+    using log_type = stxxl::vector<char, 4, lru_pager<8>, LogBlockSize>;
+
+    //! \}
+
+protected:
+    //! hash map of the entries
+    map_type m_map;
+
+    //! log of the values longer than InlineSize
+    log_type m_log;
+
+    //! bytes of the log no longer referenced by an entry
+    size_type m_garbage;
+
+    //! ratio of garbage in the log above which an update compacts it
+    double m_max_garbage_ratio;
+
+    //! minimum number of buckets, lookups need at least one
+    static constexpr internal_size_type min_buckets = 128;
+
+    //! Read the value of an entry into out.
+    void read(const entry_type& entry, binary_buffer& out) const
+    {
+        out.alloc(entry.length).set_size(entry.length);
+        if (entry.length == 0)
+            return;
+        if (entry.is_inline())
+        {
+            memcpy(out.data(), entry.data, entry.length);
+            return;
+        }
+        assert(entry.offset() + entry.length <= m_log.size());
+        typename log_type::const_iterator it = m_log.cbegin() + entry.offset();
+        char* data = out.data();
+        for (uint32_t i = 0; i < entry.length; ++i, ++it)
+            data[i] = *it;
+    }
+
+    //! Store n bytes of data in an entry, appending them to the log if they
+    //! do not fit.
+    void write(entry_type& entry, const char* data, size_t n)
+    {
+        if (n > std::numeric_limits<uint32_t>::max())
+            throw foxxll::bad_parameter("var_unordered_map: value longer than 4 GiB");
+
+        entry.length = static_cast<uint32_t>(n);
+        if (entry.is_inline())
+        {
+            if (n != 0)
+                memcpy(entry.data, data, n);
+            return;
+        }
+        entry.set_offset(m_log.size());
+        m_log.append(data, data + n);
+    }
+
+    //! Release the bytes of an entry in the log, if any.
+    void release(const entry_type& entry)
+    {
+        if (!entry.is_inline())
+            m_garbage += entry.length;
+    }
+
+    //! Compact the log if it holds too much garbage.
+    void check_garbage()
+    {
+        if (m_garbage > LogBlockSize &&
+            static_cast<double>(m_garbage) > m_max_garbage_ratio * m_log.size())
+            rehash();
+    }
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    /*!
+     * Construct a new map
+     *
+     * \param n initial number of buckets
+     * \param hf hash-function
+     * \param cmp comparator-object
+     * \param buffer_size size of the internal-memory buffer of the hash map in
+     * bytes
+     */
+    explicit var_unordered_map(internal_size_type n = 0,
+                               const hasher& hf = hasher(),
+                               const key_compare& cmp = key_compare(),
+                               internal_size_type buffer_size = 100*1024*1024)
+        : m_map(std::max(n, internal_size_type(min_buckets)), hf, cmp, buffer_size),
+          m_garbage(0),
+          m_max_garbage_ratio(0.5)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    var_unordered_map(const var_unordered_map&) = delete;
+    //! non-copyable: delete assignment operator
+    var_unordered_map& operator = (const var_unordered_map&) = delete;
+
+    void swap(var_unordered_map& obj)
+    {
+        m_map.swap(obj.m_map);
+        m_log.swap(obj.m_log);
+        std::swap(m_garbage, obj.m_garbage);
+        std::swap(m_max_garbage_ratio, obj.m_max_garbage_ratio);
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Number of values.
+    size_type size() const { return m_map.size(); }
+
+    bool empty() const { return m_map.empty(); }
+
+    //! Bytes of the value log, including garbage.
+    size_type log_bytes() const { return m_log.size(); }
+
+    //! Bytes of the value log no longer referenced.
+    size_type garbage_bytes() const { return m_garbage; }
+
+    //! Ratio of garbage in the log above which an update compacts it.
+    double max_garbage_ratio() const { return m_max_garbage_ratio; }
+
+    //! Set the ratio of garbage in the log above which an update compacts
+    //! it; a ratio of 1 or more disables automatic compaction.
+    void max_garbage_ratio(double ratio) { m_max_garbage_ratio = ratio; }
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Store n bytes of data as the value of key, replacing the value stored
+    //! before, if any.
+    void insert_or_assign(const key_type& key, const void* data, size_t n)
+    {
+        entry_type& entry = m_map[key];
+        release(entry);
+        write(entry, static_cast<const char*>(data), n);
+        check_garbage();
+    }
+
+    void insert_or_assign(const key_type& key, const std::string& str)
+    {
+        insert_or_assign(key, str.data(), str.size());
+    }
+
+    void insert_or_assign(const key_type& key, const binary_buffer& bb)
+    {
+        insert_or_assign(key, bb.data(), bb.size());
+    }
+
+    //! Erase the value of key. Returns the number of values erased (0 or 1).
+    size_type erase(const key_type& key)
+    {
+        typename map_type::const_iterator it = m_map.find(key);
+        if (it == m_map.end())
+            return 0;
+        release((*it).second);
+        m_map.erase(it);
+        check_garbage();
+        return 1;
+    }
+
+    //! Erase all values and deallocate the external memory.
+    void clear()
+    {
+        m_map.clear();
+        m_log.clear();
+        m_garbage = 0;
+    }
+
+    /*!
+     * Rewrite the buckets of the hash map with (at least) n buckets and copy
+     * the values in the log to a new log on the way, in the order of the
+     * buckets, dropping the garbage. The old log is read by random access.
+     */
+    void rehash(internal_size_type n = 0)
+    {
+        log_type new_log;
+        binary_buffer value;
+        m_map.set_rebuild_hook(
+            [&](typename map_type::value_type& v) {
+                entry_type& entry = v.second;
+                if (entry.is_inline())
+                    return;
+                read(entry, value);
+                entry.set_offset(new_log.size());
+                new_log.append(value.data(), value.data() + value.size());
+            });
+        try {
+            m_map.rehash(std::max(n, internal_size_type(min_buckets)));
+        }
+        catch (...) {
+            m_map.set_rebuild_hook(nullptr);
+            throw;
+        }
+        m_map.set_rebuild_hook(nullptr);
+
+        m_log.swap(new_log);
+        m_garbage = 0;
+    }
+
+    //! Compact the value log, see rehash().
+    void compact()
+    {
+        rehash();
+    }
+
+    //! \}
+
+    //! \name Lookup
+    //! \{
+
+    //! Read the value of key into out. Returns false if there is none.
+    bool get(const key_type& key, binary_buffer& out) const
+    {
+        typename map_type::const_iterator it = m_map.find(key);
+        if (it == m_map.end())
+            return false;
+        read((*it).second, out);
+        return true;
+    }
+
+    //! Read the value of key into str. Returns false if there is none.
+    bool get(const key_type& key, std::string& str) const
+    {
+        binary_buffer out;
+        if (!get(key, out))
+            return false;
+        str = out.str();
+        return true;
+    }
+
+    //! Whether key has a value.
+    bool contains(const key_type& key) const
+    {
+        return m_map.find(key) != m_map.end();
+    }
+
+    //! \}
+
+    //! \name Hash Map
+    //! \{
+
+    //! The hash map of the entries, e.g. to tune it. Its values must not be
+    //! modified directly.
+    map_type& map() { return m_map; }
+
+    const map_type& map() const { return m_map; }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_VAR_UNORDERED_MAP_HEADER
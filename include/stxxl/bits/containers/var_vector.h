@@ -0,0 +1,339 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/var_vector.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_VAR_VECTOR_HEADER
+#define STXXL_CONTAINERS_VAR_VECTOR_HEADER
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+
+#include <foxxll/common/types.hpp>
+
+#include <stxxl/bits/common/binary_buffer.h>
+#include <stxxl/bits/containers/pager.h>
+#include <stxxl/bits/containers/vector.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont_vector
+//! \{
+
+/*!
+ * External vector of variable-length records, e.g. strings or serialized
+ * binary_buffer objects.
+ *
+ * The records are packed one after the other into a stxxl::vector of bytes,
+ * and a stxxl::vector of offsets holds the beginning of each record and the
+ * end of the last. Records are appended with push_back() and read by index
+ * with get(), which costs the I/Os of the offsets and bytes of the record.
+ * stream(records) reads all records in order with overlapped I/O.
+ *
+ * For sorting, a handle_type of a record is a fixed-size POD, which can be
+ * sorted together with a key by the stxxl sorters. append_from() then copies
+ * the records of a var_vector in the order of a stream of handles.
+ *
+ * \tparam PagerType pager of the page caches of offsets and bytes
+ * \tparam BlockSize external block size in bytes of offsets and bytes
+ * \tparam AllocStr parallel disk block allocation strategy
+ */
+template <typename PagerType = lru_pager<8>,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(uint64_t),
+          typename AllocStr = foxxll::default_alloc_strategy>
+class var_vector
+{
+public:
+    //! \name Types
+    //! \{
+
+    using size_type = foxxll::external_size_type;
+
+    //! vector of the beginnings of the records
+    using offset_vector_type = stxxl::vector<uint64_t, 4, PagerType, BlockSize, AllocStr>;
+    //! vector of the packed records
+    using byte_vector_type = stxxl::vector<char, 4, PagerType, BlockSize, AllocStr>;
+
+    //! Position of a record in the bytes, which identifies it within the
+    //! var_vector as long as it is not cleared.
+    struct handle_type
+    {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    //! \}
+
+protected:
+    offset_vector_type m_offsets;
+    byte_vector_type m_bytes;
+
+    //! Read the bytes of a record.
+    void read(const handle_type& handle, binary_buffer& out) const
+    {
+        out.alloc(handle.length).set_size(handle.length);
+        typename byte_vector_type::const_iterator it = m_bytes.cbegin() + handle.offset;
+        char* data = out.data();
+        for (uint64_t i = 0; i < handle.length; ++i, ++it)
+            data[i] = *it;
+    }
+
+public:
+    //! \name Constructors/Destructors
+    //! \{
+
+    var_vector()
+    {
+        m_offsets.push_back(0);
+    }
+
+    //! non-copyable: delete copy-constructor
+    var_vector(const var_vector&) = delete;
+    //! non-copyable: delete assignment operator
+    var_vector& operator = (const var_vector&) = delete;
+
+    void swap(var_vector& obj)
+    {
+        m_offsets.swap(obj.m_offsets);
+        m_bytes.swap(obj.m_bytes);
+    }
+
+    //! \}
+
+    //! \name Capacity
+    //! \{
+
+    //! Number of records.
+    size_type size() const { return m_offsets.size() - 1; }
+
+    bool empty() const { return size() == 0; }
+
+    //! Total number of bytes of the records.
+    size_type bytes() const { return m_bytes.size(); }
+
+    //! Remove all records and deallocate the external memory.
+    void clear()
+    {
+        m_offsets.clear();
+        m_bytes.clear();
+        m_offsets.push_back(0);
+    }
+
+    //! Flush the page caches.
+    void flush() const
+    {
+        m_offsets.flush();
+        m_bytes.flush();
+    }
+
+    //! \}
+
+    //! \name Modifiers
+    //! \{
+
+    //! Append a record of n bytes.
+    void push_back(const void* data, size_t n)
+    {
+        const char* begin = static_cast<const char*>(data);
+        m_bytes.append(begin, begin + n);
+        m_offsets.push_back(m_bytes.size());
+    }
+
+    void push_back(const std::string& str)
+    {
+        push_back(str.data(), str.size());
+    }
+
+    void push_back(const binary_buffer& bb)
+    {
+        push_back(bb.data(), bb.size());
+    }
+
+    //! Append the records of src in the order of a stream of their handles,
+    //! e.g. after sorting them by key. Reads each record of src by random
+    //! access, src must not be this var_vector.
+    template <typename StreamAlgorithm>
+    void append_from(const var_vector& src, StreamAlgorithm& handles)
+    {
+        assert(&src != this);
+        binary_buffer record;
+        for ( ; !handles.empty(); ++handles)
+        {
+            src.read(*handles, record);
+            push_back(record);
+        }
+    }
+
+    //! \}
+
+    //! \name Element Access
+    //! \{
+
+    //! Handle of the i-th record.
+    handle_type handle(size_type i) const
+    {
+        assert(i < size());
+        const offset_vector_type& offsets = m_offsets;
+        const uint64_t begin = offsets[i];
+        return handle_type { begin, offsets[i + 1] - begin };
+    }
+
+    //! Number of bytes of the i-th record.
+    size_t length(size_type i) const
+    {
+        return static_cast<size_t>(handle(i).length);
+    }
+
+    //! Read the i-th record into out.
+    void get(size_type i, binary_buffer& out) const
+    {
+        read(handle(i), out);
+    }
+
+    //! Read the record of the handle into out.
+    void get(const handle_type& handle, binary_buffer& out) const
+    {
+        assert(handle.offset + handle.length <= bytes());
+        read(handle, out);
+    }
+
+    //! Return the i-th record as string.
+    std::string get(size_type i) const
+    {
+        binary_buffer out;
+        get(i, out);
+        return out.str();
+    }
+
+    //! \}
+
+    //! \name Streams
+    //! \{
+
+    //! Stream of the records, which reads offsets and bytes with overlapped
+    //! I/O. The record is valid until the stream is advanced.
+    class stream
+    {
+    public:
+        using value_type = binary_buffer;
+
+    protected:
+        typename offset_vector_type::bufreader_type m_offsets;
+        typename byte_vector_type::bufreader_type m_bytes;
+        size_type m_size;
+        binary_buffer m_record;
+
+        void read_record()
+        {
+            const uint64_t begin = *m_offsets;
+            ++m_offsets;
+            const size_t n = static_cast<size_t>(*m_offsets - begin);
+
+            m_record.alloc(n).set_size(n);
+            char* data = m_record.data();
+            for (size_t i = 0; i < n; ++i, ++m_bytes)
+                data[i] = *m_bytes;
+        }
+
+    public:
+        explicit stream(const var_vector& records)
+            : m_offsets(records.m_offsets), m_bytes(records.m_bytes),
+              m_size(records.size())
+        {
+            if (m_size > 0)
+                read_record();
+        }
+
+        //! number of records left
+        size_type size() const { return m_size; }
+
+        //! standard stream method
+        bool empty() const { return m_size == 0; }
+
+        //! standard stream method
+        const value_type& operator * () const
+        {
+            assert(!empty());
+            return m_record;
+        }
+
+        //! standard stream method
+        const value_type* operator -> () const
+        {
+            return &(operator * ());
+        }
+
+        //! standard stream method
+        stream& operator ++ ()
+        {
+            assert(!empty());
+            if (--m_size > 0)
+                read_record();
+            return *this;
+        }
+    };
+
+    //! Stream of the handles of the records, which reads the offsets with
+    //! overlapped I/O.
+    class handle_stream
+    {
+    public:
+        using value_type = handle_type;
+
+    protected:
+        typename offset_vector_type::bufreader_type m_offsets;
+        size_type m_size;
+        handle_type m_handle;
+
+        void read_handle()
+        {
+            const uint64_t begin = *m_offsets;
+            ++m_offsets;
+            m_handle = handle_type { begin, *m_offsets - begin };
+        }
+
+    public:
+        explicit handle_stream(const var_vector& records)
+            : m_offsets(records.m_offsets), m_size(records.size())
+        {
+            if (m_size > 0)
+                read_handle();
+        }
+
+        //! number of handles left
+        size_type size() const { return m_size; }
+
+        //! standard stream method
+        bool empty() const { return m_size == 0; }
+
+        //! standard stream method
+        const value_type& operator * () const
+        {
+            assert(!empty());
+            return m_handle;
+        }
+
+        //! standard stream method
+        handle_stream& operator ++ ()
+        {
+            assert(!empty());
+            if (--m_size > 0)
+                read_handle();
+            return *this;
+        }
+    };
+
+    //! \}
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_VAR_VECTOR_HEADER
@@ -17,29 +17,51 @@
 #define STXXL_CONTAINERS_VECTOR_HEADER
 
 #include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <ostream>
 #include <queue>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <tlx/define.hpp>
 #include <tlx/logger/core.hpp>
 
+#include <foxxll/common/aligned_alloc.hpp>
 #include <foxxll/common/tmeta.hpp>
 #include <foxxll/common/types.hpp>
 #include <foxxll/io/request_operations.hpp>
 #include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/block_prefetcher.hpp>
 #include <foxxll/mng/buf_istream.hpp>
 #include <foxxll/mng/buf_istream_reverse.hpp>
 #include <foxxll/mng/buf_ostream.hpp>
 #include <foxxll/mng/typed_block.hpp>
 
+#include <stxxl/bits/common/alloc_strategy.h>
+#include <stxxl/bits/common/coroutine.h>
+#include <stxxl/bits/common/custom_stats.h>
+#include <stxxl/bits/common/disk_space.h>
+#include <stxxl/bits/common/io_retry.h>
 #include <stxxl/bits/common/is_sorted.h>
+#include <stxxl/bits/common/locked_memory.h>
+#include <stxxl/bits/common/memory_manager.h>
+#include <stxxl/bits/common/numa.h>
+#include <stxxl/bits/common/task_runtime.h>
+#include <stxxl/bits/config.h>
+#include <stxxl/bits/containers/block_codec.h>
 #include <stxxl/bits/containers/pager.h>
 #include <stxxl/bits/defines.h>
 #include <stxxl/bits/deprecated.h>
 #include <stxxl/types>
 
+#if STXXL_PARALLEL
+#include <omp.h>
+#endif
+
 namespace stxxl {
 
 //! \defgroup stlcont Containers
@@ -250,12 +272,110 @@ public:
 
 ////////////////////////////////////////////////////////////////////////////
 
+#ifndef STXXL_VECTOR_CACHE_STATS
+#define STXXL_VECTOR_CACHE_STATS 1
+#endif
+
+/*!
+ * Counters of the page cache of a vector, see vector::statistics(). With
+ * STXXL_VECTOR_CACHE_STATS defined to 0 the counters are
+ * dummy_custom_stats_counter, which compile to nothing and read as zero.
+ */
+template <typename CounterType>
+struct basic_vector_cache_stats
+{
+    using counter_type = CounterType;
+
+    //! element accesses to cached pages and to pages fetched on a miss
+    counter_type hits, misses;
+    //! pages read ahead of a sequential or strided scan
+    counter_type read_ahead;
+    //! pages evicted from the cache: clean ones, including those written
+    //! back in the background before, and dirty ones, whose write back the
+    //! eviction waited for
+    counter_type clean_evictions, dirty_evictions;
+    //! bytes read and written by the page cache, encoded sizes if compressed
+    counter_type bytes_read, bytes_written;
+    //! page status transitions: uninitialized and valid on disk pages made
+    //! dirty by a write access, and dirty pages written back
+    counter_type pages_initialized, pages_dirtied, pages_cleaned;
+
+    //! Fraction of element accesses that hit a cached page.
+    double hit_ratio() const
+    {
+        const uint64_t accesses = uint64_t(hits) + uint64_t(misses);
+        return accesses ? double(uint64_t(hits)) / double(accesses) : 1.0;
+    }
+
+    //! Counts between two snapshots, e.g. of one phase of a program.
+    basic_vector_cache_stats operator - (const basic_vector_cache_stats& b) const
+    {
+        basic_vector_cache_stats d;
+        d.hits = uint64_t(hits) - uint64_t(b.hits);
+        d.misses = uint64_t(misses) - uint64_t(b.misses);
+        d.read_ahead = uint64_t(read_ahead) - uint64_t(b.read_ahead);
+        d.clean_evictions = uint64_t(clean_evictions) - uint64_t(b.clean_evictions);
+        d.dirty_evictions = uint64_t(dirty_evictions) - uint64_t(b.dirty_evictions);
+        d.bytes_read = uint64_t(bytes_read) - uint64_t(b.bytes_read);
+        d.bytes_written = uint64_t(bytes_written) - uint64_t(b.bytes_written);
+        d.pages_initialized = uint64_t(pages_initialized) - uint64_t(b.pages_initialized);
+        d.pages_dirtied = uint64_t(pages_dirtied) - uint64_t(b.pages_dirtied);
+        d.pages_cleaned = uint64_t(pages_cleaned) - uint64_t(b.pages_cleaned);
+        return d;
+    }
+
+    void print(std::ostream& o) const
+    {
+        o << "Page hits                         : " << uint64_t(hits)
+          << " (" << 100. * hit_ratio() << "%)" << std::endl;
+        o << "Page misses                       : " << uint64_t(misses) << std::endl;
+        o << "Pages read ahead                  : " << uint64_t(read_ahead) << std::endl;
+        o << "Clean pages evicted               : " << uint64_t(clean_evictions) << std::endl;
+        o << "Dirty pages evicted               : " << uint64_t(dirty_evictions) << std::endl;
+        o << "Bytes read                        : " << uint64_t(bytes_read) << std::endl;
+        o << "Bytes written                     : " << uint64_t(bytes_written) << std::endl;
+        o << "Pages initialized                 : " << uint64_t(pages_initialized) << std::endl;
+        o << "Valid pages made dirty            : " << uint64_t(pages_dirtied) << std::endl;
+        o << "Dirty pages written back          : " << uint64_t(pages_cleaned) << std::endl;
+    }
+};
+
+//! page cache counters of a vector, see basic_vector_cache_stats
+using vector_cache_stats = basic_vector_cache_stats<
+          std::conditional<
+              STXXL_VECTOR_CACHE_STATS != 0,
+              custom_stats_counter<uint64_t>,
+              dummy_custom_stats_counter<uint64_t> >::type>;
+
+////////////////////////////////////////////////////////////////////////////
+
+//! \internal
+//! A block shared by a vector and its snapshots, see vector::snapshot(). The
+//! last reference deletes the block, unless a vector reclaimed it.
+template <typename BidType>
+struct vector_shared_block
+{
+    BidType bid;
+    bool owned;
+
+    explicit vector_shared_block(const BidType& b)
+        : bid(b), owned(true)
+    { }
+
+    ~vector_shared_block()
+    {
+        if (owned)
+            foxxll::block_manager::get_instance()->delete_block(bid);
+    }
+};
+
 template <
     typename ValueType,
     unsigned PageSize,
     typename PagerType,
     size_t BlockSize,
-    typename AllocStr>
+    typename AllocStr,
+    typename BlockCodec>
 class vector;
 
 template <
@@ -263,15 +383,17 @@ template <
     unsigned PageSize,
     typename PagerType,
     size_t BlockSize,
-    typename AllocStr>
+    typename AllocStr,
+    typename BlockCodec>
 struct vector_configuration {
     using value_type = ValueType;
     static constexpr unsigned page_size = PageSize;
     using pager_type = PagerType;
     static constexpr size_t block_size = BlockSize;
     using alloc_str = AllocStr;
+    using block_codec = BlockCodec;
 
-    using vector_type = vector<ValueType, PageSize, PagerType, BlockSize, AllocStr>;
+    using vector_type = vector<ValueType, PageSize, PagerType, BlockSize, AllocStr, BlockCodec>;
 };
 
 template <typename VectorConfig>
@@ -283,6 +405,12 @@ class vector_bufreader;
 template <typename VectorIteratorType>
 class vector_bufreader_reverse;
 
+template <typename VectorIteratorType>
+class vector_bufreader_strided;
+
+template <typename VectorIteratorType>
+class vector_partitioned_bufreader;
+
 template <typename VectorIteratorType>
 class vector_bufwriter;
 
@@ -329,12 +457,54 @@ protected:
     blocked_index_type offset;
     vector_type* p_vector;
 
+    //! first element of the block accessed last, valid while the vector's
+    //! cache epoch equals m_epoch, see block_cached()
+    mutable pointer m_block = nullptr;
+    //! position of the first element of m_block
+    mutable size_type m_block_pos = 0;
+    //! cache epoch of the vector when m_block was fetched
+    mutable size_t m_epoch = 0;
+    //! whether the page of m_block was marked dirty by the access
+    mutable bool m_writable = false;
+
 private:
     //! private constructor for initializing other iterators
     vector_iterator(vector_type* v, size_type o)
         : offset(o), p_vector(v)
     { }
 
+    //! Whether m_block is still cached and holds the current element.
+    bool block_cached() const
+    {
+        return m_block != nullptr && m_epoch == p_vector->m_cache_epoch &&
+               offset.get_pos() - m_block_pos < block_type::size;
+    }
+
+    //! Access the current element through the vector, which touches the
+    //! pager and fetches its page, and keep the pointer to its block.
+    pointer fetch_block(bool writable) const
+    {
+        const size_t i = offset.get_offset();
+        m_block = writable
+                  ? &p_vector->element(offset) - i
+                  : const_cast<pointer>(&p_vector->const_element(offset) - i);
+        m_block_pos = offset.get_pos() - i;
+        m_epoch = p_vector->m_cache_epoch;
+        m_writable = writable;
+        return m_block;
+    }
+
+    //! Pointer to the current element, by the block pointer while valid.
+    pointer current(bool writable) const
+    {
+        if (TLX_LIKELY(block_cached() && (m_writable || !writable)))
+        {
+            ++p_vector->m_stats.hits;
+            return m_block + offset.get_offset();
+        }
+        return fetch_block(writable) + offset.get_offset();
+    }
+
 public:
     //! constructs invalid iterator
     vector_iterator()
@@ -343,7 +513,11 @@ public:
     //! copy-constructor
     vector_iterator(const vector_iterator& a)
         : offset(a.offset),
-          p_vector(a.p_vector)
+          p_vector(a.p_vector),
+          m_block(a.m_block),
+          m_block_pos(a.m_block_pos),
+          m_epoch(a.m_epoch),
+          m_writable(a.m_writable)
     { }
 
     //! \name Iterator Properties
@@ -362,6 +536,12 @@ public:
     //! return iterator to BID containg current element
     bids_container_iterator bid() const
     {
+        static_assert(!vector_type::compressed,
+                      "the blocks of a compressed vector cannot be accessed directly");
+        // the blocks may be written directly, copy those shared with snapshots
+        p_vector->unshare_blocks(
+            static_cast<size_t>(offset.get_block2() * vector_type::page_size + offset.get_block1()),
+            true);
         return p_vector->bid(offset);
     }
 
@@ -373,22 +553,22 @@ public:
     //! return current element
     reference operator * ()
     {
-        return p_vector->element(offset);
+        return *current(true);
     }
     //! return pointer to current element
     pointer operator -> ()
     {
-        return &(p_vector->element(offset));
+        return current(true);
     }
     //! return const reference to current element
     const_reference operator * () const
     {
-        return p_vector->const_element(offset);
+        return *current(false);
     }
     //! return const pointer to current element
     const_pointer operator -> () const
     {
-        return &(p_vector->const_element(offset));
+        return current(false);
     }
     //! return mutable reference to element +i after the current element
     reference operator [] (size_type i)
@@ -601,12 +781,44 @@ protected:
     blocked_index_type offset{0};
     const vector_type* p_vector{nullptr};
 
+    //! first element of the block accessed last, valid while the vector's
+    //! cache epoch equals m_epoch, see block_cached()
+    mutable const_pointer m_block = nullptr;
+    //! position of the first element of m_block
+    mutable size_type m_block_pos = 0;
+    //! cache epoch of the vector when m_block was fetched
+    mutable size_t m_epoch = 0;
+
 private:
     //! private constructor for initializing other iterators
     const_vector_iterator(const vector_type* v, size_type o)
         : offset(o), p_vector(v)
     { }
 
+    //! Whether m_block is still cached and holds the current element.
+    bool block_cached() const
+    {
+        return m_block != nullptr && m_epoch == p_vector->m_cache_epoch &&
+               offset.get_pos() - m_block_pos < block_type::size;
+    }
+
+    //! Pointer to the current element, by the block pointer while valid,
+    //! otherwise through the vector, which touches the pager and fetches its
+    //! page.
+    const_pointer current() const
+    {
+        const size_t i = offset.get_offset();
+        if (TLX_LIKELY(block_cached()))
+        {
+            ++p_vector->m_stats.hits;
+            return m_block + i;
+        }
+        m_block = &p_vector->const_element(offset) - i;
+        m_block_pos = offset.get_pos() - i;
+        m_epoch = p_vector->m_cache_epoch;
+        return m_block + i;
+    }
+
 public:
     //! constructs invalid iterator
     const_vector_iterator() = default;
@@ -617,7 +829,8 @@ public:
 
     //! implicit conversion from mutable iterator
     const_vector_iterator(const mutable_self_type& a) // NOLINT
-        : offset(a.offset), p_vector(a.p_vector)
+        : offset(a.offset), p_vector(a.p_vector),
+          m_block(a.m_block), m_block_pos(a.m_block_pos), m_epoch(a.m_epoch)
     { }
 
     //! \name Iterator Properties
@@ -636,6 +849,8 @@ public:
     //! return iterator to BID containg current element
     bids_container_iterator bid() const
     {
+        static_assert(!vector_type::compressed,
+                      "the blocks of a compressed vector cannot be accessed directly");
         return const_cast<vector_type*>(p_vector)->bid(offset);
     }
 
@@ -647,12 +862,12 @@ public:
     //! return current element
     const_reference operator * () const
     {
-        return p_vector->const_element(offset);
+        return *current();
     }
     //! return pointer to current element
     const_pointer operator -> () const
     {
-        return &(p_vector->const_element(offset));
+        return current();
     }
     //! return const reference to element +i after the current element
     const_reference operator [] (size_type i) const
@@ -818,12 +1033,24 @@ public:
 //! For semantics of the methods see documentation of the STL std::vector
 //! \tparam ValueType type of contained objects (POD with no references to internal memory)
 //! \tparam PageSize number of blocks in a page, default: \b 4 (recommended >= D)
-//! \tparam PagerType type of the pager: \c random_pager or \c lru_pager, default: \b lru_pager. Both take the number of pages as template parameters, default: \b 8 (recommended >= 2)
+//! \tparam PagerType type of the pager: \c random_pager, \c lru_pager, \c clock_pager or the scan resistant \c two_queue_pager, default: \b lru_pager. All take the number of pages as template parameters, default: \b 8 (recommended >= 2)
 //! \tparam BlockSize external block size in bytes, default is <b>2 MiB</b>
 //! \tparam AllocStr parallel disk block allocation strategies: \c striping , \c random_cyclic , \c simple_random , or \c fully_random
-//!  default is \c random_cyclic
+//!  default is \c runtime_alloc_strategy, which uses \c SETTINGS::alloc_strategy
+//! \tparam BlockCodec codec encoding the blocks written to disk, e.g.
+//!  \c frame_of_reference_codec, default: \b no_block_codec
+//!
+//! Memory consumption: BlockSize*x*PageSize bytes, twice that with a BlockCodec
+//!
+//! Misses of the page cache read ahead the following pages asynchronously if
+//! the accessed pages form a sequential or strided scan (see set_readahead()),
+//! and the pager's next victim is written back in the background.
 //!
-//! Memory consumption: BlockSize*x*PageSize bytes
+//! With a BlockCodec each block is encoded when it is written and occupies
+//! only a prefix of its BID on disk, which saves I/O volume but not disk
+//! space. The blocks of a compressed vector cannot be accessed directly, so
+//! it cannot be attached to a file and its buffered readers and writers are
+//! not available; bulk_append() and the page cache handle the encoding.
 //! \warning Do not store references to the elements of an external vector. Such references
 //! might be invalidated during any following access to elements of the vector
 template <
@@ -831,7 +1058,8 @@ template <
     unsigned PageSize = 4,
     typename PagerType = lru_pager<8>,
     size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(ValueType),
-    typename AllocStr = foxxll::default_alloc_strategy>
+    typename AllocStr = runtime_alloc_strategy,
+    typename BlockCodec = no_block_codec>
 class vector
 {
     constexpr static bool debug = false;
@@ -856,13 +1084,17 @@ public:
 
     using pager_type = PagerType;
     using alloc_strategy_type = AllocStr;
+    using block_codec_type = BlockCodec;
 
     static constexpr size_t page_size = PageSize;
     static constexpr size_t block_size = BlockSize;
 
     enum { on_disk = -1 };
 
-    using configuration_type = vector_configuration<ValueType, PageSize, PagerType, BlockSize, AllocStr>;
+    //! whether the blocks are stored encoded by a block codec
+    static constexpr bool compressed = !std::is_same<BlockCodec, no_block_codec>::value;
+
+    using configuration_type = vector_configuration<ValueType, PageSize, PagerType, BlockSize, AllocStr, BlockCodec>;
     static_assert(std::is_same<vector, typename configuration_type::vector_type>::value, "Inconsistent vector type in config");
 
     //! iterator used to iterate through a vector, see \ref design_vector_notes.
@@ -889,6 +1121,12 @@ public:
     //! vector_bufreader compatible with this vector
     using bufreader_reverse_type = vector_bufreader_reverse<const_iterator>;
 
+    //! vector_bufreader_strided compatible with this vector
+    using bufreader_strided_type = vector_bufreader_strided<const_iterator>;
+
+    //! vector_partitioned_bufreader compatible with this vector
+    using partitioned_bufreader_type = vector_partitioned_bufreader<const_iterator>;
+
     //! \internal
     class bid_vector : public std::vector<foxxll::BID<block_size> >
     {
@@ -912,9 +1150,13 @@ public:
     //! \}
 
 private:
+    using shared_block_ptr = std::shared_ptr<
+        vector_shared_block<typename bids_container_type::bid_type> >;
+
     alloc_strategy_type m_alloc_strategy;
     size_type m_size;
-    bids_container_type m_bids;
+    //! mutable since write-back may move shared blocks, see unshare_block()
+    mutable bids_container_type m_bids;
     mutable pager_type m_pager;
 
     // enum specifying status of a page of the vector
@@ -930,6 +1172,41 @@ private:
     mutable tlx::simple_vector<size_t> m_slot_to_page;
     mutable std::queue<size_t> m_free_slots;
     mutable tlx::simple_vector<block_type>* m_cache;
+    //! buffers of the encoded blocks of the cache slots, if compressed
+    mutable tlx::simple_vector<block_type>* m_codec_cache;
+    //! reservation of the page cache at the memory_manager
+    mutable memory_reservation m_cache_reservation { "vector page cache" };
+    //! bytes occupied by each block on disk if compressed: 0 if it was never
+    //! written, raw_size if it is stored plain, otherwise the length of the
+    //! encoded prefix of its BID
+    mutable std::vector<uint32_t> m_extents;
+    //! references to the blocks shared with snapshots, null for blocks owned
+    //! exclusively, sized lazily
+    mutable std::vector<shared_block_ptr> m_shared;
+    //! number of non-null entries of m_shared
+    mutable size_t m_num_shared;
+
+    // flags of the state of a cache slot
+    enum slot_state : uint8_t {
+        slot_idle = 0,
+        slot_reading = 1,
+        slot_writing = 2,
+        slot_prefetched = 4
+    };
+
+    //! requests in flight on the blocks of each cache slot
+    mutable tlx::simple_vector<foxxll::request_ptr> m_slot_reqs;
+    //! state of each cache slot, combination of slot_state flags
+    mutable std::vector<uint8_t> m_slot_state;
+    //! detects sequential and strided page accesses
+    mutable stride_detector m_stride;
+    //! number of pages read ahead of a sequential or strided scan
+    size_t m_readahead;
+    //! counters of the page cache
+    mutable vector_cache_stats m_stats;
+    //! incremented whenever a cached page is unmapped or written back, which
+    //! invalidates the block pointers kept by the iterators
+    mutable size_t m_cache_epoch = 0;
 
     foxxll::file_ptr m_from;
     foxxll::block_manager* m_bm;
@@ -971,6 +1248,12 @@ public:
           m_page_to_slot(foxxll::div_ceil(m_bids.size(), page_size), on_disk),
           m_slot_to_page(npages),
           m_cache(nullptr),
+          m_codec_cache(nullptr),
+          m_extents(compressed ? m_bids.size() : 0, 0),
+          m_num_shared(0),
+          m_slot_reqs(npages * page_size),
+          m_slot_state(npages),
+          m_readahead(default_readahead(npages)),
           m_exported(false)
     {
         m_bm = foxxll::block_manager::get_instance();
@@ -994,12 +1277,24 @@ public:
         std::swap(m_alloc_strategy, obj.m_alloc_strategy);
         std::swap(m_size, obj.m_size);
         std::swap(m_bids, obj.m_bids);
+        std::swap(m_shared, obj.m_shared);
+        std::swap(m_num_shared, obj.m_num_shared);
         std::swap(m_pager, obj.m_pager);
         std::swap(m_page_status, obj.m_page_status);
         std::swap(m_page_to_slot, obj.m_page_to_slot);
         std::swap(m_slot_to_page, obj.m_slot_to_page);
         std::swap(m_free_slots, obj.m_free_slots);
         std::swap(m_cache, obj.m_cache);
+        std::swap(m_codec_cache, obj.m_codec_cache);
+        invalidate_block_pointers();
+        obj.invalidate_block_pointers();
+        m_cache_reservation.swap(obj.m_cache_reservation);
+        std::swap(m_extents, obj.m_extents);
+        std::swap(m_slot_reqs, obj.m_slot_reqs);
+        std::swap(m_slot_state, obj.m_slot_state);
+        std::swap(m_stride, obj.m_stride);
+        std::swap(m_readahead, obj.m_readahead);
+        std::swap(m_stats, obj.m_stats);
         std::swap(m_from, obj.m_from);
         std::swap(m_exported, obj.m_exported);
     }
@@ -1014,7 +1309,34 @@ public:
     {
         //  numpages() might be zero
         if (!m_cache && numpages() > 0)
+            m_cache_reservation.resize(
+                (compressed ? 2 : 1) * numpages() * page_size * sizeof(block_type));
+        if (!m_cache && numpages() > 0)
+        {
             m_cache = new tlx::simple_vector<block_type>(numpages() * page_size);
+            numa_partition_blocks(m_cache->data(), m_cache->size(), page_size);
+            lock_blocks(m_cache->data(), m_cache->size());
+        }
+        if (compressed && !m_codec_cache && numpages() > 0)
+        {
+            m_codec_cache = new tlx::simple_vector<block_type>(numpages() * page_size);
+            numa_partition_blocks(m_codec_cache->data(), m_codec_cache->size(), page_size);
+            lock_blocks(m_codec_cache->data(), m_codec_cache->size());
+        }
+    }
+
+    //! Unlock and free the page caches.
+    void delete_page_cache() const
+    {
+        invalidate_block_pointers();
+        if (m_cache)
+            unlock_blocks(m_cache->data());
+        delete m_cache;
+        m_cache = nullptr;
+        if (m_codec_cache)
+            unlock_blocks(m_codec_cache->data());
+        delete m_codec_cache;
+        m_codec_cache = nullptr;
     }
 
     //! allows to free the cache, but you may not access any element until call
@@ -1022,8 +1344,22 @@ public:
     void deallocate_page_cache() const
     {
         flush();
-        delete m_cache;
-        m_cache = nullptr;
+        delete_page_cache();
+        m_cache_reservation.release();
+    }
+
+    //! Set the number of pages read ahead asynchronously when a sequential or
+    //! strided scan over the pages is detected, zero disables read-ahead.
+    //! Default: a quarter of the cached pages.
+    void set_readahead(size_t npages)
+    {
+        m_readahead = npages;
+    }
+
+    //! Number of pages read ahead of a sequential or strided scan.
+    size_t readahead() const
+    {
+        return m_readahead;
     }
 
     //! \}
@@ -1075,6 +1411,8 @@ public:
         m_page_to_slot.resize(new_pages, on_disk);
 
         m_bids.resize(new_bids_size);
+        if (compressed)
+            m_extents.resize(new_bids_size, 0);
         if (!m_from)
         {
             m_bm->new_blocks(m_alloc_strategy,
@@ -1128,6 +1466,7 @@ private:
                 if (m_page_to_slot[i] != on_disk) {
                     m_free_slots.push(m_page_to_slot[i]);
                     m_page_to_slot[i] = on_disk;
+                    invalidate_block_pointers();
                 }
                 m_page_status[i] = uninitialized;
             }
@@ -1155,12 +1494,15 @@ private:
                 new_pages_size << " pages";
 
             // release blocks
+            wait_all_slots();
             if (m_from)
                 m_from->set_size(new_bids_size * block_type::raw_size);
             else
-                m_bm->delete_blocks(m_bids.begin() + old_bids_size, m_bids.end());
+                delete_blocks(new_bids_size);
 
             m_bids.resize(new_bids_size);
+            if (compressed)
+                m_extents.resize(new_bids_size);
 
             // don't resize m_page_to_slot or m_page_status, because it is
             // still needed to check page status and match the mapping
@@ -1169,6 +1511,7 @@ private:
             // clear dirty flag, so these pages will be never written
             std::fill(m_page_status.begin() + new_pages_size,
                       m_page_status.end(), valid_on_disk);
+            invalidate_block_pointers();
         }
 
         m_size = n;
@@ -1182,13 +1525,16 @@ public:
     //! occupied.
     void clear()
     {
+        wait_all_slots();
         m_size = 0;
         if (!m_from)
-            m_bm->delete_blocks(m_bids.begin(), m_bids.end());
+            delete_blocks(0);
 
         m_bids.clear();
+        m_extents.clear();
         m_page_status.clear();
         m_page_to_slot.clear();
+        invalidate_block_pointers();
         while (!m_free_slots.empty())
             m_free_slots.pop();
 
@@ -1216,6 +1562,180 @@ public:
 
     //! \}
 
+    //! \name Bulk Modifiers
+    //! \{
+
+    /*!
+     * Append the elements [first, last) at the end, bypassing the page cache.
+     *
+     * Only the last partially filled block is completed through the page
+     * cache, all following elements are packed into whole blocks which are
+     * written directly to disk with overlapped I/O, so the cached working set
+     * is not evicted. For forward iterators the external memory needed is
+     * allocated at once beforehand.
+     */
+    template <typename InputIterator>
+    void append(InputIterator first, InputIterator last)
+    {
+        range_source<InputIterator> source(first, last);
+        bulk_append(source,
+                    range_length(first, last,
+                                 typename std::iterator_traits<InputIterator>::iterator_category()));
+    }
+
+    /*!
+     * Replace the contents by the elements of a stream, which are written
+     * directly to disk like by append(). The capacity grows by doubling while
+     * the stream is read, as its length is not known in advance.
+     */
+    template <typename StreamAlgorithm>
+    void assign_from_stream(StreamAlgorithm& stream)
+    {
+        _resize(0);
+        bulk_append(stream, 0);
+    }
+
+    /*!
+     * Append the elements of a stream at the end, which are written directly
+     * to disk like by append(). The capacity grows by doubling while the
+     * stream is read, as its length is not known in advance.
+     */
+    template <typename StreamAlgorithm>
+    void append_from_stream(StreamAlgorithm& stream)
+    {
+        bulk_append(stream, 0);
+    }
+
+    /*!
+     * Append the elements [first, last) of a vector of this type, which may
+     * be this vector. If first is at the same offset within its block as the
+     * end of this vector, e.g. both are block-aligned, the whole blocks are
+     * copied directly between the BIDs like by copy_range(), without
+     * touching the elements.
+     */
+    void append(const const_iterator& first, const const_iterator& last)
+    {
+        const size_type pos = m_size;
+        _resize(m_size + static_cast<size_type>(last - first));
+        copy_range(first, last, pos);
+    }
+
+    /*!
+     * Overwrite the elements from pos on with the elements [first, last) of
+     * a vector of this type, like std::copy(); [pos, pos + (last - first))
+     * must lie within size(). If first and pos are at the same offset within
+     * their blocks, the whole blocks in between are read and written directly
+     * with overlapped I/O and without decoding, bypassing both page caches;
+     * only the elements of the partial blocks at both ends are copied through
+     * the page caches. Otherwise all elements are copied one by one. The
+     * ranges may overlap only if pos is before first.
+     */
+    void copy_range(const const_iterator& first, const const_iterator& last, size_type pos)
+    {
+        const vector& src = *first.parent_vector();
+        size_type n = static_cast<size_type>(last - first);
+        assert(pos + n <= m_size);
+
+        const_iterator in = first;
+        if (static_cast<size_type>(in.block_offset()) != pos % block_type::size ||
+            n < block_type::size)
+        {
+            std::copy(in, last, begin() + pos);
+            return;
+        }
+
+        // the head until the next block boundary
+        const size_type head = std::min(
+            n, (block_type::size - pos % block_type::size) % block_type::size);
+        std::copy(in, in + head, begin() + pos);
+        in += head, pos += head, n -= head;
+
+        const size_t nblocks = static_cast<size_t>(n / block_type::size);
+        src.flush();
+        transfer_blocks(src, static_cast<size_t>((in - src.cbegin()) / block_type::size),
+                        static_cast<size_t>(pos / block_type::size), nblocks);
+        in += nblocks * block_type::size, pos += nblocks * block_type::size;
+
+        // the tail after the last whole block
+        std::copy(in, last, begin() + pos);
+    }
+
+    /*!
+     * Move the elements of src to the end of this vector and leave src
+     * empty. If the size of this vector is a multiple of the block size, the
+     * blocks of src are taken over without I/O besides flushing the page
+     * caches, together with their sharing with snapshots of src. Otherwise,
+     * or if either vector is attached to a file, they are copied by
+     * append().
+     */
+    void splice_back(vector& src)
+    {
+        assert(&src != this);
+
+        if (m_size % block_type::size != 0 || m_from || src.m_from ||
+            m_exported || src.m_exported)
+        {
+            append(src.cbegin(), src.cend());
+            src.clear();
+            return;
+        }
+
+        const size_t used = static_cast<size_t>(m_size / block_type::size);
+        const size_t moved = static_cast<size_t>(
+            foxxll::div_ceil(src.m_size, block_type::size));
+
+        // write back the blocks of src, and evict the pages of this vector
+        // from the partial last one on, which the new blocks complete
+        src.flush();
+        wait_all_slots();
+        for (size_t page_no = used / page_size; page_no < m_page_to_slot.size(); ++page_no)
+            evict_page(page_no);
+
+        // release the capacity behind the used blocks
+        delete_blocks(used);
+        m_bids.resize(used);
+        if (compressed)
+            m_extents.resize(used);
+
+        m_bids.insert(m_bids.end(), src.m_bids.begin(), src.m_bids.begin() + moved);
+        src.m_bids.erase(src.m_bids.begin(), src.m_bids.begin() + moved);
+        if (compressed)
+        {
+            m_extents.insert(m_extents.end(), src.m_extents.begin(),
+                             src.m_extents.begin() + moved);
+            src.m_extents.erase(src.m_extents.begin(), src.m_extents.begin() + moved);
+        }
+        if (src.m_num_shared != 0)
+        {
+            src.m_shared.resize(std::max(src.m_shared.size(), moved));
+            m_shared.resize(used);
+            for (size_t i = 0; i < moved; ++i)
+            {
+                if (src.m_shared[i])
+                    ++m_num_shared, --src.m_num_shared;
+                m_shared.push_back(std::move(src.m_shared[i]));
+            }
+            src.m_shared.erase(src.m_shared.begin(), src.m_shared.begin() + moved);
+        }
+
+        // the page status is not shrunk, see _resize_shrink_capacity()
+        const size_t pages = foxxll::div_ceil(m_bids.size(), page_size);
+        if (m_page_status.size() < pages)
+        {
+            m_page_status.resize(pages, valid_on_disk);
+            m_page_to_slot.resize(pages, on_disk);
+        }
+        std::fill(m_page_status.begin() + used / page_size,
+                  m_page_status.begin() + pages, valid_on_disk);
+        m_size += src.m_size;
+        invalidate_block_pointers();
+
+        // the remaining blocks of src are its capacity
+        src.clear();
+    }
+
+    //! \}
+
     //! \name Operators
     //! \{
 
@@ -1261,9 +1781,17 @@ public:
           m_page_to_slot(foxxll::div_ceil(m_bids.size(), page_size), on_disk),
           m_slot_to_page(npages),
           m_cache(nullptr),
+          m_codec_cache(nullptr),
+          m_extents(compressed ? m_bids.size() : 0, 0),
+          m_num_shared(0),
+          m_slot_reqs(npages * page_size),
+          m_slot_state(npages),
+          m_readahead(default_readahead(npages)),
           m_from(from),
           m_exported(false)
     {
+        static_assert(!compressed, "a compressed vector cannot be attached to a file");
+
         // initialize from file
         if (!block_type::has_only_data)
         {
@@ -1291,6 +1819,37 @@ public:
         from->set_size(offset);
     }
 
+private:
+    struct snapshot_tag { };
+
+    //! Construct a snapshot sharing all blocks of obj, see snapshot().
+    vector(const vector& obj, const size_t npages, snapshot_tag)
+        : m_alloc_strategy(obj.m_alloc_strategy),
+          m_size(obj.m_size),
+          m_bids(obj.m_bids),
+          m_pager(npages),
+          m_page_status(obj.m_page_status),
+          m_page_to_slot(obj.m_page_to_slot.size(), on_disk),
+          m_slot_to_page(npages),
+          m_cache(nullptr),
+          m_codec_cache(nullptr),
+          m_extents(obj.m_extents),
+          m_shared(obj.m_shared),
+          m_num_shared(obj.m_num_shared),
+          m_slot_reqs(npages * page_size),
+          m_slot_state(npages),
+          m_readahead(default_readahead(npages)),
+          m_exported(false)
+    {
+        m_bm = foxxll::block_manager::get_instance();
+
+        allocate_page_cache();
+
+        for (size_t i = 0; i < numpages(); ++i)
+            m_free_slots.push(i);
+    }
+
+public:
     //! copy-constructor
     vector(const vector& obj)
         : m_size(obj.size()),
@@ -1300,6 +1859,12 @@ public:
           m_page_to_slot(foxxll::div_ceil(m_bids.size(), page_size), on_disk),
           m_slot_to_page(obj.numpages()),
           m_cache(nullptr),
+          m_codec_cache(nullptr),
+          m_extents(compressed ? m_bids.size() : 0, 0),
+          m_num_shared(0),
+          m_slot_reqs(obj.numpages() * page_size),
+          m_slot_state(obj.numpages()),
+          m_readahead(obj.m_readahead),
           m_exported(false)
     {
         assert(!obj.m_exported);
@@ -1454,6 +2019,9 @@ public:
             m_free_slots.pop();
         }
 
+        wait_all_slots();
+
+        // write all dirty pages concurrently
         for (size_t i = 0; i < numpages(); i++)
         {
             m_free_slots.push(i);
@@ -1467,8 +2035,11 @@ public:
                 write_page(page_no, i);
 
                 m_page_to_slot[page_no] = on_disk;
+                invalidate_block_pointers();
             }
         }
+
+        wait_all_slots();
     }
 
     //! \}
@@ -1495,7 +2066,7 @@ public:
         if (!m_exported)
         {
             if (!m_from) {
-                m_bm->delete_blocks(m_bids.begin(), m_bids.end());
+                delete_blocks(0);
             }
             else // file must be truncated
             {
@@ -1512,7 +2083,7 @@ public:
                 }
             }
         }
-        delete m_cache;
+        delete_page_cache();
     }
 
     //! \}
@@ -1524,6 +2095,7 @@ public:
     //! files will be numbered ascending.
     void export_files(std::string filename_prefix)
     {
+        static_assert(!compressed, "the blocks of a compressed vector cannot be exported");
         size_t no = 0;
         for (bids_container_iterator i = m_bids.begin(); i != m_bids.end(); ++i) {
             std::ostringstream number;
@@ -1544,6 +2116,42 @@ public:
         return m_from;
     }
 
+    /*!
+     * Take a point-in-time snapshot of the vector: a vector with the same
+     * content which shares all blocks with this one, so only a page cache is
+     * allocated and no block is copied. The blocks are reference counted and
+     * copied on write: a shared block is moved to a new BID when a page of
+     * either vector is written back, and copied when it is accessed directly
+     * through the bid() of a mutable iterator, e.g. by the buffered writers
+     * or stxxl::sort, which copy all shared blocks from that position on.
+     *
+     * The vector is flushed. Both vectors stay fully usable, also from
+     * different threads, and may be destroyed in any order.
+     *
+     * \param npages number of cached pages of the snapshot, default: as many
+     *   as this vector's
+     */
+    vector snapshot(size_t npages = 0) const
+    {
+        if (m_from)
+            throw std::runtime_error("vector::snapshot(): the blocks of a vector attached to a file cannot be shared");
+        assert(!m_exported);
+
+        flush();
+
+        m_shared.resize(m_bids.size());
+        for (size_t i = 0; i < m_bids.size(); ++i)
+        {
+            if (m_shared[i])
+                continue;
+            m_shared[i] = std::make_shared<vector_shared_block<
+                                               typename bids_container_type::bid_type> >(m_bids[i]);
+            ++m_num_shared;
+        }
+
+        return vector(*this, npages != 0 ? npages : numpages(), snapshot_tag());
+    }
+
     //! \}
 
     //! \name Capacity
@@ -1557,9 +2165,13 @@ public:
         const size_t new_bids_size = foxxll::div_ceil(n, block_type::size);
         m_bids.resize(new_bids_size);
         std::copy(bid_begin, bid_end, m_bids.begin());
+        // the blocks were written plain by someone else
+        if (compressed)
+            m_extents.assign(new_bids_size, uint32_t(block_type::raw_size));
         const size_t new_pages = foxxll::div_ceil(new_bids_size, page_size);
         m_page_status.resize(new_pages, valid_on_disk);
         m_page_to_slot.resize(new_pages, on_disk);
+        invalidate_block_pointers();
         m_size = n;
     }
 
@@ -1569,7 +2181,288 @@ public:
         return m_pager.size();
     }
 
+    //! NUMA node holding the cached page of the element at index i, or
+    //! numa_topology::nodes() if it is not cached. The page cache is
+    //! partitioned over the nodes if SETTINGS::numa_partition was set when it
+    //! was allocated, otherwise placed by first touch.
+    size_t cache_node(size_type i) const
+    {
+        const size_t page_no = blocked_index_type(i).get_block2();
+        if (!m_cache || m_page_to_slot[page_no] < 0)
+            return numa_topology::get_instance().nodes();
+        return numa_block_node(
+            size_t(m_page_to_slot[page_no]) * page_size, m_cache->size(), page_size);
+    }
+
+    //! Snapshot of the counters of the page cache, which tell e.g. whether
+    //! more or larger pages would save I/Os.
+    vector_cache_stats statistics() const
+    {
+        return m_stats;
+    }
+
+    //! Reset the counters of the page cache.
+    void reset_statistics()
+    {
+        m_stats = vector_cache_stats();
+    }
+
+    void print_statistics(std::ostream& o) const
+    {
+        m_stats.print(o);
+    }
+
+    //! \}
+
+    //! \name Batched Access
+    //! \{
+
+    /*!
+     * Read the elements at the indexes [index_begin, index_end) into the
+     * random access range out, out[k] being the element at the k-th index,
+     * and return the end of the output.
+     *
+     * Elements of cached pages are copied from the cache. The blocks holding
+     * the others are read once each and in the order of their BIDs, keeping
+     * memory / block size reads in flight, without loading their pages into
+     * the cache. Thus a batch of random lookups costs one I/O per block
+     * touched, instead of one page miss after the other. Compressed vectors
+     * are read through the cache.
+     */
+    template <typename IndexIterator, typename OutputIterator>
+    OutputIterator gather(IndexIterator index_begin, IndexIterator index_end,
+                          OutputIterator out,
+                          size_t memory = 32 * block_type::raw_size) const
+    {
+        struct read_type
+        {
+            size_t block_no, offset, k;
+        };
+        std::vector<read_type> reads;
+
+        size_t n = 0;
+        for (IndexIterator it = index_begin; it != index_end; ++it, ++n)
+        {
+            assert(size_type(*it) < size());
+            const blocked_index_type offset(*it);
+            const size_t page_no = offset.get_block2();
+            if (compressed || m_page_to_slot[page_no] >= 0 ||
+                m_page_status[page_no] == uninitialized)
+            {
+                out[n] = const_element(offset);
+                continue;
+            }
+            reads.push_back(read_type {
+                                page_no * page_size + offset.get_block1(), offset.get_offset(), n
+                            });
+        }
+        if (reads.empty())
+            return out + n;
+        m_stats.misses += reads.size();
+
+        // reads of the same block are adjacent in the order of the BIDs
+        std::sort(reads.begin(), reads.end(),
+                  [this](const read_type& a, const read_type& b) {
+                      return bid_less(m_bids[a.block_no], m_bids[b.block_no]);
+                  });
+        std::vector<size_t> starts;
+        for (size_t r = 0; r < reads.size(); ++r)
+        {
+            if (r == 0 || reads[r].block_no != reads[r - 1].block_no)
+                starts.push_back(r);
+        }
+        starts.push_back(reads.size());
+
+        const size_t num_blocks = starts.size() - 1;
+        const size_t window = std::min(
+            num_blocks, std::max<size_t>(1, memory / block_type::raw_size));
+        memory_reservation reservation("vector gather", window * sizeof(block_type));
+        tlx::simple_vector<block_type> blocks(window);
+        tlx::simple_vector<foxxll::request_ptr> reqs(window);
+
+        auto issue = [&](size_t b) {
+                         const size_t block_no = reads[starts[b]].block_no;
+                         reqs[b % window] = blocks[b % window].read(m_bids[block_no]);
+                         m_stats.bytes_read += block_type::raw_size;
+                     };
+
+        try {
+            for (size_t b = 0; b < window; ++b)
+                issue(b);
+            for (size_t b = 0; b < num_blocks; ++b)
+            {
+                const size_t w = b % window;
+                io_retry::get_instance().wait(
+                    reqs[w], blocks[w], m_bids[reads[starts[b]].block_no], false);
+                reqs[w].reset();
+                for (size_t r = starts[b]; r < starts[b + 1]; ++r)
+                    out[reads[r].k] = blocks[w][reads[r].offset];
+                if (b + window < num_blocks)
+                    issue(b + window);
+            }
+        }
+        catch (...) {
+            // the buffers must outlive the reads still in flight
+            for (size_t w = 0; w < window; ++w)
+            {
+                if (!reqs[w])
+                    continue;
+                try {
+                    reqs[w]->wait();
+                }
+                catch (const foxxll::io_error&) { }
+            }
+            throw;
+        }
+        return out + n;
+    }
+
+    /*!
+     * Hint that the elements at the indexes [index_begin, index_end) will be
+     * accessed soon: start reading the pages of the first of them into the
+     * cache, up to the number of cache pages, in the order of their BIDs.
+     * Accessing the elements then only waits for the reads in flight. Dirty
+     * pages evicted for them are written back first.
+     */
+    template <typename IndexIterator>
+    void prefetch(IndexIterator index_begin, IndexIterator index_end) const
+    {
+        // the pages not cached, by the first index accessing them
+        std::vector<std::pair<size_t, size_t> > pages;
+        size_t k = 0;
+        for (IndexIterator it = index_begin; it != index_end; ++it, ++k)
+        {
+            assert(size_type(*it) < size());
+            const size_t page_no = blocked_index_type(*it).get_block2();
+            if (m_page_to_slot[page_no] < 0 && m_page_status[page_no] != uninitialized)
+                pages.emplace_back(page_no, k);
+        }
+        std::sort(pages.begin(), pages.end());
+        pages.erase(std::unique(pages.begin(), pages.end(),
+                                [](const std::pair<size_t, size_t>& a,
+                                   const std::pair<size_t, size_t>& b) {
+                                    return a.first == b.first;
+                                }),
+                    pages.end());
+
+        if (pages.size() > numpages())
+        {
+            std::sort(pages.begin(), pages.end(),
+                      [](const std::pair<size_t, size_t>& a,
+                         const std::pair<size_t, size_t>& b) {
+                          return a.second < b.second;
+                      });
+            pages.resize(numpages());
+        }
+        std::sort(pages.begin(), pages.end(),
+                  [this](const std::pair<size_t, size_t>& a,
+                         const std::pair<size_t, size_t>& b) {
+                      return bid_less(m_bids[a.first * page_size],
+                                      m_bids[b.first * page_size]);
+                  });
+
+        for (const std::pair<size_t, size_t>& p : pages)
+            read_page(p.first, acquire_slot(p.first));
+    }
+
+    //! \}
+
+#if STXXL_HAVE_COROUTINES
+    //! \name Asynchronous Access
+    //! \{
+
+    /*!
+     * Awaitable value of an element, see async_get(). Elements of pages not
+     * cached are read from disk without loading their page into the cache,
+     * others are ready without suspending.
+     */
+    class async_get_awaitable
+    {
+        const vector* m_vector;
+        size_type m_index;
+        io_scheduler* m_scheduler;
+        value_type m_value;
+
+        //! sector aligned extent of the element read, and its buffer
+        foxxll::file* m_file = nullptr;
+        uint64_t m_offset = 0;
+        size_t m_bytes = 0, m_skip = 0;
+        char* m_buffer = nullptr;
+        foxxll::request_ptr m_req;
+
+    public:
+        async_get_awaitable(const vector* v, size_type i, io_scheduler* s)
+            : m_vector(v), m_index(i), m_scheduler(s)
+        { }
+
+        //! non-copyable: delete copy-constructor
+        async_get_awaitable(const async_get_awaitable&) = delete;
+        //! non-copyable: delete assignment operator
+        async_get_awaitable& operator = (const async_get_awaitable&) = delete;
+
+        ~async_get_awaitable()
+        {
+            if (m_buffer)
+                foxxll::aligned_dealloc<sector_size>(m_buffer);
+        }
+
+        bool await_ready()
+        {
+            return m_vector->async_get_ready(m_index, m_value);
+        }
+
+        //! Start reading the element, whose completion posts h to the
+        //! scheduler.
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            m_vector->async_get_extent(m_index, m_file, m_offset, m_bytes, m_skip);
+            m_buffer = static_cast<char*>(foxxll::aligned_alloc<sector_size>(m_bytes));
+            m_scheduler->submitted();
+            try {
+                m_req = m_file->aread(m_buffer, m_offset, m_bytes,
+                                      io_scheduler::resume_handler { m_scheduler, h });
+            }
+            catch (...) {
+                m_scheduler->cancelled();
+                throw;
+            }
+        }
+
+        //! The value, rethrowing the error of the read, if retrying it failed
+        //! too, see io_retry.
+        value_type await_resume()
+        {
+            if (m_req)
+            {
+                io_retry::get_instance().wait(
+                    m_req, m_file, m_buffer, m_offset, m_bytes, false);
+                m_value = *reinterpret_cast<const value_type*>(m_buffer + m_skip);
+            }
+            return m_value;
+        }
+    };
+
+    /*!
+     * Read element i asynchronously: co_await vec.async_get(i) in a coroutine
+     * suspends it until the element was read, and the scheduler's run()
+     * resumes it. Thus one thread keeps as many reads in flight as it runs
+     * coroutines, e.g. one per lookup of a batch of random indexes.
+     *
+     * Only the sectors holding the element are read, its page is not loaded
+     * into the cache. Elements of cached pages, of pages not initialized yet
+     * and of compressed vectors are accessed through the cache instead,
+     * without suspending. The vector must not be modified while reads are in
+     * flight.
+     */
+    async_get_awaitable
+    async_get(size_type i, io_scheduler& scheduler = io_scheduler::this_thread()) const
+    {
+        assert(i < size());
+        return async_get_awaitable(this, i, &scheduler);
+    }
+
     //! \}
+#endif // STXXL_HAVE_COROUTINES
 
 private:
     bids_container_iterator bid(const size_type& offset)
@@ -1597,103 +2490,689 @@ private:
                 (offset.get_block2() * PageSize + offset.get_block1()));
     }
 
-    void read_page(const size_t& page_no, const size_t& cache_slot) const
+    //! Default number of pages read ahead for a cache of npages pages.
+    static size_t default_readahead(size_t npages)
     {
-        assert(page_no < m_page_status.size());
+        return npages >= 4 ? npages / 4 : npages / 2;
+    }
 
-        if (m_page_status[page_no] == uninitialized)
-            return;
+    using is_compressed = std::integral_constant<bool, compressed>;
 
-        TLX_LOG << "read_page(): page_no=" << page_no << " cache_slot=" << cache_slot;
-        std::vector<foxxll::request_ptr> reqs;
-        reqs.reserve(page_size);
+    //! Encoding buffer of block i of the page cache, if compressed.
+    block_type* codec_buffer(const size_t& i) const
+    {
+        return compressed ? &(*m_codec_cache)[i] : nullptr;
+    }
 
-        size_t block_no = page_no * page_size;
-        const size_t last_block = std::min<size_t>(block_no + page_size, m_bids.size());
-        for (size_t i = cache_slot * page_size; block_no < last_block; ++block_no, ++i) {
-            reqs.push_back((*m_cache)[i].read(m_bids[block_no]));
-        }
+    //! Start reading a block.
+    foxxll::request_ptr read_block(block_type& block, block_type* /* encoded */,
+                                   const size_t& block_no, std::false_type) const
+    {
+        return block.read(m_bids[block_no]);
+    }
 
-        assert(last_block - page_no * page_size > 0);
-        wait_all(reqs.data(), last_block - page_no * page_size);
+    //! Start reading the extent of a block, encoded ones into the encoding
+    //! buffer for decode_page(). Blocks never written are not read.
+    foxxll::request_ptr read_block(block_type& block, block_type* encoded,
+                                   const size_t& block_no, std::true_type) const
+    {
+        const size_t bytes = m_extents[block_no];
+        if (bytes == 0)
+            return foxxll::request_ptr();
+        if (bytes == block_type::raw_size)
+            return block.read(m_bids[block_no]);
+        return m_bids[block_no].storage->aread(
+            encoded, m_bids[block_no].offset, bytes);
     }
 
-    void write_page(const size_t& page_no, const size_t& cache_slot) const
+    //! Start writing a block.
+    foxxll::request_ptr write_block(block_type& block, block_type* /* encoded */,
+                                    const size_t& block_no, std::false_type) const
     {
-        assert(page_no < m_page_status.size());
+        return block.write(m_bids[block_no]);
+    }
 
-        if (!(m_page_status[page_no] & dirty))
-            return;
+    /*!
+     * Encode a block into the encoding buffer and start writing the encoded
+     * bytes, rounded up to block_codec_alignment, to the beginning of the
+     * block's BID. Blocks which do not shrink by at least that much are
+     * written plain.
+     */
+    foxxll::request_ptr write_block(block_type& block, block_type* encoded,
+                                    const size_t& block_no, std::true_type) const
+    {
+        const size_t raw_size = block_type::raw_size;
 
-        TLX_LOG << "write_page(): page_no=" << page_no << " cache_slot=" << cache_slot;
+        size_t bytes = 0;
+        if (raw_size > block_codec_alignment)
+        {
+            bytes = block_codec_type::encode(
+                block.begin(), block_type::size,
+                reinterpret_cast<char*>(encoded), raw_size - block_codec_alignment);
+        }
 
-        std::vector<foxxll::request_ptr> reqs;
-        reqs.reserve(page_size);
+        if (bytes == 0)
+        {
+            m_extents[block_no] = uint32_t(raw_size);
+            return block.write(m_bids[block_no]);
+        }
 
-        size_t block_no = page_no * page_size;
+        bytes = foxxll::div_ceil(bytes, block_codec_alignment) * block_codec_alignment;
+        m_extents[block_no] = uint32_t(bytes);
+        return m_bids[block_no].storage->awrite(
+            encoded, m_bids[block_no].offset, bytes);
+    }
 
-        const size_t last_block = std::min<size_t>(block_no + page_size, m_bids.size());
+    //! Decode the encoded blocks read into a cache slot.
+    void decode_page(const size_t& /* page_no */, const size_t& /* cache_slot */,
+                     std::false_type) const
+    { }
+
+    void decode_page(const size_t& page_no, const size_t& cache_slot,
+                     std::true_type) const
+    {
+        size_t block_no = page_no * page_size;
+        const size_t last_block = std::min<size_t>(block_no + page_size, m_bids.size());
+        for (size_t i = cache_slot * page_size; block_no < last_block; ++block_no, ++i)
+        {
+            const size_t bytes = m_extents[block_no];
+            if (bytes == 0 || bytes == block_type::raw_size)
+                continue;
+            block_codec_type::decode(
+                reinterpret_cast<const char*>(&(*m_codec_cache)[i]), bytes,
+                (*m_cache)[i].begin(), block_type::size);
+        }
+    }
+
+    //! Bytes of the I/O of a block, its extent if compressed.
+    size_t block_bytes(const size_t& block_no) const
+    {
+        return compressed ? m_extents[block_no] : block_type::raw_size;
+    }
+
+    //! Start reading a page into a cache slot, wait_slot() completes it.
+    void read_page(const size_t& page_no, const size_t& cache_slot) const
+    {
+        assert(page_no < m_page_status.size());
+
+        if (m_page_status[page_no] == uninitialized)
+            return;
+
+        TLX_LOG << "read_page(): page_no=" << page_no << " cache_slot=" << cache_slot;
+
+        size_t block_no = page_no * page_size;
+        const size_t last_block = std::min<size_t>(block_no + page_size, m_bids.size());
+        assert(block_no < last_block);
+        for (size_t i = cache_slot * page_size; block_no < last_block; ++block_no, ++i) {
+            m_slot_reqs[i] = read_block((*m_cache)[i], codec_buffer(i), block_no, is_compressed());
+            m_stats.bytes_read += block_bytes(block_no);
+        }
+        m_slot_state[cache_slot] |= slot_reading;
+    }
+
+    //! Invalidate the block pointers kept by the iterators, see
+    //! vector_iterator::block_cached().
+    void invalidate_block_pointers() const
+    {
+        ++m_cache_epoch;
+    }
+
+    //! Start writing a page from a cache slot if it is dirty, wait_slot()
+    //! completes it.
+    void write_page(const size_t& page_no, const size_t& cache_slot) const
+    {
+        assert(page_no < m_page_status.size());
+
+        if (!(m_page_status[page_no] & dirty))
+            return;
+
+        TLX_LOG << "write_page(): page_no=" << page_no << " cache_slot=" << cache_slot;
+
+        size_t block_no = page_no * page_size;
+
+        const size_t last_block = std::min<size_t>(block_no + page_size, m_bids.size());
         assert(block_no < last_block);
         for (size_t i = cache_slot * page_size; block_no < last_block; ++block_no, ++i) {
-            reqs.push_back((*m_cache)[i].write(m_bids[block_no]));
+            unshare_block(block_no);
+            m_slot_reqs[i] = write_block((*m_cache)[i], codec_buffer(i), block_no, is_compressed());
+            m_stats.bytes_written += block_bytes(block_no);
         }
+        m_slot_state[cache_slot] |= slot_writing;
 
         m_page_status[page_no] = valid_on_disk;
-        assert(last_block - page_no * page_size > 0);
+        ++m_stats.pages_cleaned;
+        invalidate_block_pointers();
+    }
 
-        wait_all(reqs.data(), last_block - page_no * page_size);
+    //! Wait for the request of the i-th cache block, which belongs to
+    //! cache_slot, redoing the I/O if it failed, see io_retry.
+    void wait_block(const size_t& cache_slot, const size_t& i, bool write) const
+    {
+        const size_t block_no =
+            m_slot_to_page[cache_slot] * page_size + i - cache_slot * page_size;
+        const bool encoded =
+            compressed && m_extents[block_no] != block_type::raw_size;
+
+        io_retry::get_instance().wait(
+            m_slot_reqs[i], m_bids[block_no].storage,
+            encoded ? static_cast<void*>(codec_buffer(i))
+            : static_cast<void*>(&(*m_cache)[i]),
+            m_bids[block_no].offset,
+            encoded ? m_extents[block_no] : block_type::raw_size, write);
     }
 
-    reference element(size_type offset)
+    //! Wait for the requests in flight on the blocks of a cache slot.
+    void wait_slot(const size_t& cache_slot) const
     {
-        return element(blocked_index_type(offset));
+        if (!(m_slot_state[cache_slot] & (slot_reading | slot_writing)))
+            return;
+
+        const bool write = (m_slot_state[cache_slot] & slot_writing) != 0;
+        for (size_t i = cache_slot * page_size; i < (cache_slot + 1) * page_size; ++i)
+        {
+            if (m_slot_reqs[i])
+            {
+                wait_block(cache_slot, i, write);
+                m_slot_reqs[i].reset();
+            }
+        }
+        if (m_slot_state[cache_slot] & slot_reading)
+            decode_page(m_slot_to_page[cache_slot], cache_slot, is_compressed());
+        m_slot_state[cache_slot] &= ~(slot_reading | slot_writing);
     }
 
-    reference element(const blocked_index_type& offset)
+    //! Wait for the requests in flight on all cache slots.
+    void wait_all_slots() const
     {
-        assert(offset.get_pos() < size());
-        const size_t page_no = offset.get_block2();
-        assert(page_no < m_page_to_slot.size());   // fails if offset is too large, out of bound access
-        const auto cache_slot = m_page_to_slot[page_no];
-        if (cache_slot < 0)                        // == on_disk
+        for (size_t i = 0; i < numpages(); ++i)
+            wait_slot(i);
+    }
+
+    //! Map a page to a cache slot: a free one, or the pager's victim whose
+    //! page is written back first unless this already happened in the
+    //! background.
+    size_t acquire_slot(const size_t& page_no) const
+    {
+        size_t cache_slot;
+        if (!m_free_slots.empty())
         {
-            if (m_free_slots.empty())              // has to kick
+            cache_slot = m_free_slots.front();
+            m_free_slots.pop();
+            wait_slot(cache_slot);
+        }
+        else
+        {
+            cache_slot = m_pager.kick();
+            const size_t old_page_no = m_slot_to_page[cache_slot];
+            m_page_to_slot[old_page_no] = on_disk;
+            invalidate_block_pointers();
+
+            wait_slot(cache_slot);
+            if (m_page_status[old_page_no] & dirty)
+                ++m_stats.dirty_evictions;
+            else
+                ++m_stats.clean_evictions;
+            write_page(old_page_no, cache_slot);
+            wait_slot(cache_slot);
+        }
+        pager_load(m_pager, cache_slot, page_no);
+        m_slot_state[cache_slot] = slot_idle;
+        m_page_to_slot[page_no] = cache_slot;
+        m_slot_to_page[cache_slot] = page_no;
+        return cache_slot;
+    }
+
+    /*!
+     * Read the pages following page_no with the stride detected in the page
+     * accesses, asynchronously into free slots or those of clean victims. A
+     * dirty victim is instead written back in the background and read-ahead
+     * stops; so it does at busy slots or the slot of page_no.
+     */
+    void read_ahead(const size_t& page_no, const size_t& cache_slot) const
+    {
+        const ptrdiff_t stride = m_stride.access(page_no);
+        if (stride == 0)
+            return;
+
+        const size_t num_pages = static_cast<size_t>(
+            foxxll::div_ceil(m_size, block_type::size * page_size));
+
+        ptrdiff_t next = static_cast<ptrdiff_t>(page_no);
+        for (size_t k = 0; k < m_readahead; ++k)
+        {
+            next += stride;
+            if (next < 0 || static_cast<size_t>(next) >= num_pages)
+                return;
+
+            const size_t next_page = static_cast<size_t>(next);
+            if (m_page_to_slot[next_page] >= 0 || m_page_status[next_page] == uninitialized)
+                continue;
+
+            size_t slot;
+            if (!m_free_slots.empty())
+            {
+                slot = m_free_slots.front();
+                m_free_slots.pop();
+                wait_slot(slot);
+            }
+            else
             {
-                const size_t kicked_slot = m_pager.kick();
-                m_pager.hit(kicked_slot);
-                const size_t old_page_no = m_slot_to_page[kicked_slot];
-                m_page_to_slot[page_no] = kicked_slot;
+                slot = m_pager.kick();
+                if (slot == cache_slot || m_slot_state[slot] != slot_idle)
+                    return;
+
+                const size_t old_page_no = m_slot_to_page[slot];
+                if (m_page_status[old_page_no] & dirty)
+                {
+                    write_page(old_page_no, slot);
+                    return;
+                }
                 m_page_to_slot[old_page_no] = on_disk;
-                m_slot_to_page[kicked_slot] = page_no;
+                invalidate_block_pointers();
+                ++m_stats.clean_evictions;
+            }
+
+            TLX_LOG << "read_ahead(): page_no=" << next_page << " stride=" << stride;
+
+            pager_load(m_pager, slot, next_page);
+            m_slot_state[slot] = slot_idle;
+            m_page_to_slot[next_page] = slot;
+            m_slot_to_page[slot] = next_page;
+
+            read_page(next_page, slot);
+            m_slot_state[slot] |= slot_prefetched;
+            ++m_stats.read_ahead;
+        }
+    }
+
+    //! Start writing back the page of the pager's next victim, if it is dirty,
+    //! so that the next miss need not wait for it.
+    void write_behind(const size_t& cache_slot) const
+    {
+        if (!m_free_slots.empty())
+            return;
+
+        const size_t slot = m_pager.kick();
+        if (slot != cache_slot && m_slot_state[slot] == slot_idle)
+            write_page(m_slot_to_page[slot], slot);
+    }
+
+    //! Write back a cached page and release its cache slot.
+    void evict_page(const size_t& page_no) const
+    {
+        const ptrdiff_t cache_slot = m_page_to_slot[page_no];
+        if (cache_slot < 0)                        // == on_disk
+            return;
+
+        const size_t slot = static_cast<size_t>(cache_slot);
+        wait_slot(slot);
+        if (m_page_status[page_no] & dirty)
+            ++m_stats.dirty_evictions;
+        else
+            ++m_stats.clean_evictions;
+        write_page(page_no, slot);
+        wait_slot(slot);
+        m_slot_state[slot] = slot_idle;
+        m_free_slots.push(slot);
+        m_page_to_slot[page_no] = on_disk;
+        invalidate_block_pointers();
+    }
+
+    //! Delete the blocks from first on, shared ones are left to the last of
+    //! their snapshots.
+    void delete_blocks(const size_t& first)
+    {
+        size_t begin = first;
+        for (size_t i = first; i < std::min(m_shared.size(), m_bids.size()); ++i)
+        {
+            if (!m_shared[i])
+                continue;
+            disk_space_reclaimer::get_instance().delete_blocks(
+                m_bids.begin() + begin, m_bids.begin() + i);
+            m_shared[i].reset();
+            --m_num_shared;
+            begin = i + 1;
+        }
+        disk_space_reclaimer::get_instance().delete_blocks(
+            m_bids.begin() + begin, m_bids.end());
+        if (first < m_shared.size())
+            m_shared.resize(first);
+    }
+
+    //! Make a block shared with snapshots exclusive before it is overwritten
+    //! in full: the last reference takes the block back, otherwise the block
+    //! is moved to a new BID, leaving the old one to the snapshots.
+    void unshare_block(const size_t& block_no) const
+    {
+        if (m_num_shared == 0 || block_no >= m_shared.size() || !m_shared[block_no])
+            return;
+
+        if (m_shared[block_no].use_count() == 1)
+        {
+            m_shared[block_no]->owned = false;
+        }
+        else
+        {
+            TLX_LOG << "unshare_block(): moving block " << block_no;
+            m_bm->new_block(m_alloc_strategy, m_bids[block_no], block_no);
+        }
+        m_shared[block_no].reset();
+        --m_num_shared;
+    }
+
+    /*!
+     * Make the blocks from first on exclusive before they are accessed
+     * directly, like unshare_block() but copying the content of blocks moved
+     * to a new BID, since they may be written partially.
+     */
+    void unshare_blocks(const size_t& first, bool copy) const
+    {
+        std::unique_ptr<block_type> buffer;
+        for (size_t i = first; i < m_shared.size() && m_num_shared != 0; ++i)
+        {
+            if (!m_shared[i])
+                continue;
+
+            if (!copy || m_shared[i].use_count() == 1)
+            {
+                unshare_block(i);
+                continue;
+            }
+
+            TLX_LOG << "unshare_blocks(): copying block " << i;
+            if (!buffer)
+                buffer.reset(new block_type);
+
+            typename bids_container_type::bid_type bid;
+            m_bm->new_block(m_alloc_strategy, bid, i);
+            buffer->read(m_bids[i])->wait();
+            buffer->write(bid)->wait();
+
+            m_bids[i] = bid;
+            m_shared[i].reset();
+            --m_num_shared;
+        }
+    }
+
+    //! Input iterator range with the interface of a stream.
+    template <typename Iterator>
+    struct range_source
+    {
+        Iterator m_iter, m_end;
+
+        range_source(Iterator begin, Iterator end)
+            : m_iter(begin), m_end(end) { }
+
+        bool empty() const
+        {
+            return m_iter == m_end;
+        }
+
+        typename std::iterator_traits<Iterator>::reference operator * () const
+        {
+            return *m_iter;
+        }
+
+        range_source& operator ++ ()
+        {
+            ++m_iter;
+            return *this;
+        }
+    };
+
+    template <typename Iterator>
+    static size_type range_length(Iterator, Iterator, std::input_iterator_tag)
+    {
+        return 0;
+    }
 
-                write_page(old_page_no, kicked_slot);
-                read_page(page_no, kicked_slot);
+    template <typename Iterator>
+    static size_type range_length(Iterator first, Iterator last, std::forward_iterator_tag)
+    {
+        return static_cast<size_type>(std::distance(first, last));
+    }
+
+    /*!
+     * Append the elements of a stream: the last block is completed through
+     * the page cache, then whole blocks are written directly from a ring of
+     * 2D buffers. A cached page is written back and evicted before its blocks
+     * are overwritten. If the number of elements is known, it is reserved at
+     * once, otherwise the capacity is doubled when exhausted.
+     */
+    template <typename Source>
+    void bulk_append(Source& source, size_type length)
+    {
+        // direct writes must not race with writes of the page cache
+        wait_all_slots();
+        if (length != 0)
+            reserve(m_size + length);
 
-                m_page_status[page_no] = dirty;
+        while (m_size % block_type::size != 0 && !source.empty())
+        {
+            push_back(*source);
+            ++source;
+        }
+        if (source.empty())
+            return;
+
+        const size_t nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+        tlx::simple_vector<block_type> buffers(nbuffers);
+        tlx::simple_vector<block_type> encoded(compressed ? nbuffers : 0);
+        tlx::simple_vector<foxxll::request_ptr> reqs(nbuffers);
+
+        size_t checked_page = size_t(-1);
+        try
+        {
+            for (size_t i = 0; !source.empty(); i = (i + 1) % nbuffers)
+            {
+                if (reqs[i])
+                {
+                    reqs[i]->wait();
+                    reqs[i].reset();
+                }
 
-                return (*m_cache)[kicked_slot * page_size + offset.get_block1()][offset.get_offset()];
+                size_t n = 0;
+                for ( ; n < block_type::size && !source.empty(); ++n, ++source)
+                    buffers[i][n] = *source;
+
+                const size_t block_no = static_cast<size_t>(m_size / block_type::size);
+                if (block_no >= m_bids.size())
+                    reserve(std::max(2 * capacity(), m_size + n));
+
+                const size_t page_no = block_no / page_size;
+                if (page_no != checked_page)
+                {
+                    evict_page(page_no);
+                    m_page_status[page_no] = valid_on_disk;
+                    checked_page = page_no;
+                }
+
+                TLX_LOG << "bulk_append(): writing block " << block_no;
+                unshare_block(block_no);
+                reqs[i] = write_block(buffers[i], compressed ? &encoded[i] : nullptr,
+                                      block_no, is_compressed());
+                m_size += n;
             }
-            else
+        }
+        catch (...)
+        {
+            for (foxxll::request_ptr& req : reqs)
             {
-                const size_t free_slot = m_free_slots.front();
-                m_free_slots.pop();
-                m_pager.hit(free_slot);
-                m_page_to_slot[page_no] = free_slot;
-                m_slot_to_page[free_slot] = page_no;
+                if (req)
+                    req->wait();
+            }
+            throw;
+        }
+
+        for (foxxll::request_ptr& req : reqs)
+        {
+            if (req)
+                req->wait();
+        }
+    }
 
-                read_page(page_no, free_slot);
+    //! Start reading the stored bytes of block block_no, the encoded ones of
+    //! a compressed block, into buffer.
+    foxxll::request_ptr read_stored_block(block_type& buffer, const size_t& block_no) const
+    {
+        const size_t bytes = block_bytes(block_no);
+        if (bytes == 0)
+            return foxxll::request_ptr();
+        if (bytes == block_type::raw_size)
+            return buffer.read(m_bids[block_no]);
+        return m_bids[block_no].storage->aread(&buffer, m_bids[block_no].offset, bytes);
+    }
 
-                m_page_status[page_no] = dirty;
+    //! Start writing bytes stored bytes of a block from buffer to block
+    //! block_no, see read_stored_block().
+    foxxll::request_ptr write_stored_block(block_type& buffer, const size_t& block_no,
+                                           const size_t& bytes)
+    {
+        if (compressed)
+            m_extents[block_no] = uint32_t(bytes);
+        if (bytes == 0)
+            return foxxll::request_ptr();
+        if (bytes == block_type::raw_size)
+            return buffer.write(m_bids[block_no]);
+        return m_bids[block_no].storage->awrite(&buffer, m_bids[block_no].offset, bytes);
+    }
 
-                return (*m_cache)[free_slot * page_size + offset.get_block1()][offset.get_offset()];
+    /*!
+     * Copy nblocks whole blocks of src from src_block on over the blocks of
+     * this vector from dst_block on, directly between their BIDs: the blocks
+     * are read into a ring of 4D buffers half of a ring ahead and each is
+     * written once read, so reads and writes overlap. Compressed blocks are
+     * copied encoded with their extents. src must be flushed; the cached
+     * pages of the target blocks are written back and evicted before.
+     */
+    void transfer_blocks(const vector& src, size_t src_block, size_t dst_block, size_t nblocks)
+    {
+        if (nblocks == 0)
+            return;
+
+        wait_all_slots();
+        for (size_t page_no = dst_block / page_size;
+             page_no <= (dst_block + nblocks - 1) / page_size; ++page_no)
+        {
+            evict_page(page_no);
+            m_page_status[page_no] = valid_on_disk;
+        }
+
+        const size_t nbuffers = std::min(
+            nblocks, 4 * foxxll::config::get_instance()->disks_number());
+        const size_t ahead = std::max<size_t>(1, nbuffers / 2);
+        tlx::simple_vector<block_type> buffers(nbuffers);
+        tlx::simple_vector<foxxll::request_ptr> reqs(nbuffers);
+
+        // start reading block k into its buffer after the buffer's write
+        auto start_read = [&](size_t k) {
+                              foxxll::request_ptr& req = reqs[k % nbuffers];
+                              if (req)
+                              {
+                                  req->wait();
+                                  req.reset();
+                              }
+                              req = src.read_stored_block(buffers[k % nbuffers], src_block + k);
+                          };
+
+        try
+        {
+            for (size_t k = 0; k < std::min(ahead, nblocks); ++k)
+                start_read(k);
+
+            for (size_t k = 0; k < nblocks; ++k)
+            {
+                foxxll::request_ptr& req = reqs[k % nbuffers];
+                if (req)
+                {
+                    req->wait();
+                    req.reset();
+                }
+
+                TLX_LOG << "transfer_blocks(): block " << src_block + k
+                        << " to " << dst_block + k;
+                unshare_block(dst_block + k);
+                req = write_stored_block(buffers[k % nbuffers], dst_block + k,
+                                         src.block_bytes(src_block + k));
+
+                if (k + ahead < nblocks)
+                    start_read(k + ahead);
             }
         }
+        catch (...)
+        {
+            for (foxxll::request_ptr& req : reqs)
+            {
+                if (req)
+                    req->wait();
+            }
+            throw;
+        }
+
+        for (foxxll::request_ptr& req : reqs)
+        {
+            if (req)
+                req->wait();
+        }
+        invalidate_block_pointers();
+    }
+
+    //! Load a page missing in the cache, returns its cache slot. The read of
+    //! the page overlaps with read-ahead and write-behind.
+    size_t fetch_page(const size_t& page_no) const
+    {
+        const size_t cache_slot = acquire_slot(page_no);
+        read_page(page_no, cache_slot);
+        read_ahead(page_no, cache_slot);
+        write_behind(cache_slot);
+        wait_slot(cache_slot);
+        return cache_slot;
+    }
+
+    //! Complete the requests on a cached page before accessing it, a first
+    //! access to a page read ahead continues the read-ahead.
+    void settle_slot(const size_t& page_no, const size_t& cache_slot) const
+    {
+        wait_slot(cache_slot);
+        if (m_slot_state[cache_slot] & slot_prefetched)
+        {
+            m_slot_state[cache_slot] &= ~slot_prefetched;
+            read_ahead(page_no, cache_slot);
+        }
+    }
+
+    reference element(size_type offset)
+    {
+        return element(blocked_index_type(offset));
+    }
+
+    reference element(const blocked_index_type& offset)
+    {
+        assert(offset.get_pos() < size());
+        const size_t page_no = offset.get_block2();
+        assert(page_no < m_page_to_slot.size());   // fails if offset is too large, out of bound access
+        auto cache_slot = m_page_to_slot[page_no];
+        if (cache_slot < 0)                        // == on_disk
+        {
+            ++m_stats.misses;
+            cache_slot = fetch_page(page_no);
+        }
         else
         {
-            m_page_status[page_no] = dirty;
+            ++m_stats.hits;
             m_pager.hit(cache_slot);
-            return (*m_cache)[cache_slot * page_size + offset.get_block1()][offset.get_offset()];
+            if (m_slot_state[cache_slot] != slot_idle)
+                settle_slot(page_no, cache_slot);
+        }
+        if (m_page_status[page_no] != dirty)
+        {
+            if (m_page_status[page_no] == uninitialized)
+                ++m_stats.pages_initialized;
+            else
+                ++m_stats.pages_dirtied;
+            m_page_status[page_no] = dirty;
         }
+        return (*m_cache)[cache_slot * page_size + offset.get_block1()][offset.get_offset()];
     }
 
     // don't forget to first flush() the vector's cache before updating pages externally
@@ -1707,6 +3186,7 @@ private:
             // remove page from cache
             m_free_slots.push(m_page_to_slot[page_no]);
             m_page_to_slot[page_no] = on_disk;
+            invalidate_block_pointers();
             TLX_LOG << "page_externally_updated(): page_no=" << page_no << " flushed from cache.";
         }
         else {
@@ -1735,41 +3215,20 @@ private:
     {
         const size_t& page_no = offset.get_block2();
         assert(page_no < m_page_to_slot.size());   // fails if offset is too large, out of bound access
-        const auto cache_slot = m_page_to_slot[page_no];
+        auto cache_slot = m_page_to_slot[page_no];
         if (cache_slot < 0)                        // == on_disk
         {
-            if (m_free_slots.empty())              // has to kick
-            {
-                const size_t kicked_slot = m_pager.kick();
-                m_pager.hit(kicked_slot);
-                const size_t old_page_no = m_slot_to_page[kicked_slot];
-                m_page_to_slot[page_no] = kicked_slot;
-                m_page_to_slot[old_page_no] = on_disk;
-                m_slot_to_page[kicked_slot] = page_no;
-
-                write_page(old_page_no, kicked_slot);
-                read_page(page_no, kicked_slot);
-
-                return (*m_cache)[kicked_slot * page_size + offset.get_block1()][offset.get_offset()];
-            }
-            else
-            {
-                const size_t free_slot = m_free_slots.front();
-                m_free_slots.pop();
-                m_pager.hit(free_slot);
-                m_page_to_slot[page_no] = free_slot;
-                m_slot_to_page[free_slot] = page_no;
-
-                read_page(page_no, free_slot);
-
-                return (*m_cache)[free_slot * page_size + offset.get_block1()][offset.get_offset()];
-            }
+            ++m_stats.misses;
+            cache_slot = fetch_page(page_no);
         }
         else
         {
+            ++m_stats.hits;
             m_pager.hit(cache_slot);
-            return (*m_cache)[cache_slot * page_size + offset.get_block1()][offset.get_offset()];
+            if (m_slot_state[cache_slot] != slot_idle)
+                settle_slot(page_no, cache_slot);
         }
+        return (*m_cache)[cache_slot * page_size + offset.get_block1()][offset.get_offset()];
     }
 
     bool is_page_cached(const blocked_index_type& offset) const
@@ -1779,6 +3238,54 @@ private:
         return m_page_to_slot[page_no] >= 0;       // != on_disk;
     }
 
+    //! Order of BIDs by file and offset.
+    static bool bid_less(const typename bids_container_type::bid_type& a,
+                         const typename bids_container_type::bid_type& b)
+    {
+        if (a.storage != b.storage)
+            return std::less<foxxll::file*>()(a.storage, b.storage);
+        return a.offset < b.offset;
+    }
+
+#if STXXL_HAVE_COROUTINES
+    //! alignment of the reads of async_get(), a multiple of the sector size
+    static constexpr size_t sector_size = 4096;
+
+    //! Get element i through the cache, if async_get(i) needs no read.
+    bool async_get_ready(size_type i, value_type& value) const
+    {
+        const blocked_index_type offset(i);
+        const size_t page_no = offset.get_block2();
+        if (compressed || m_page_to_slot[page_no] >= 0 ||
+            m_page_status[page_no] == uninitialized)
+        {
+            value = const_element(offset);
+            return true;
+        }
+        ++m_stats.misses;
+        return false;
+    }
+
+    //! The sector aligned extent of element i in its block on disk, and the
+    //! offset of the element in it.
+    void async_get_extent(size_type i, foxxll::file*& file, uint64_t& offset,
+                          size_t& bytes, size_t& skip) const
+    {
+        const blocked_index_type index(i);
+        const size_t block_no = index.get_block2() * page_size + index.get_block1();
+        const size_t begin = index.get_offset() * sizeof(value_type);
+        const size_t first = begin / sector_size * sector_size;
+        const size_t last = std::min<size_t>(
+            foxxll::div_ceil(begin + sizeof(value_type), sector_size) * sector_size,
+            block_type::raw_size);
+
+        file = m_bids[block_no].storage;
+        offset = m_bids[block_no].offset + first;
+        bytes = last - first;
+        skip = begin - first;
+    }
+#endif // STXXL_HAVE_COROUTINES
+
 public:
     //! \name Comparison Operators
     //! \{
@@ -1841,6 +3348,34 @@ bool is_sorted(
         comp);
 }
 
+//! Copy [first, last) of a vector to result in a vector of the same type,
+//! like std::copy(), but transferring the whole blocks directly if first and
+//! result are at the same offset within their blocks, see
+//! vector::copy_range().
+template <typename VectorConfig>
+stxxl::vector_iterator<VectorConfig> copy(
+    stxxl::const_vector_iterator<VectorConfig> first,
+    stxxl::const_vector_iterator<VectorConfig> last,
+    stxxl::vector_iterator<VectorConfig> result)
+{
+    typename VectorConfig::vector_type& out = *result.parent_vector();
+    out.copy_range(first, last, static_cast<typename VectorConfig::vector_type::size_type>(
+                       result - out.begin()));
+    return result + (last - first);
+}
+
+template <typename VectorConfig>
+stxxl::vector_iterator<VectorConfig> copy(
+    stxxl::vector_iterator<VectorConfig> first,
+    stxxl::vector_iterator<VectorConfig> last,
+    stxxl::vector_iterator<VectorConfig> result)
+{
+    return stxxl::copy(
+        stxxl::const_vector_iterator<VectorConfig>(first),
+        stxxl::const_vector_iterator<VectorConfig>(last),
+        result);
+}
+
 ////////////////////////////////////////////////////////////////////////////
 
 template <typename VectorBufReaderType>
@@ -1914,13 +3449,16 @@ public:
     //! \param begin iterator to position were to start reading in vector
     //! \param end iterator to position were to end reading in vector
     //! \param nbuffers number of buffers used for overlapped I/O (>= 2*D recommended)
+    //! \param flush_container flush the container, otherwise it must have been
+    //! flushed before and the reader does not access it
     vector_bufreader(vector_iterator begin, vector_iterator end,
-                     const size_t nbuffers = 0)
+                     const size_t nbuffers = 0, bool flush_container = true)
         : m_begin(begin), m_end(end),
           m_bufin(nullptr),
           m_nbuffers(nbuffers)
     {
-        m_begin.flush(); // flush container
+        if (flush_container)
+            m_begin.flush(); // flush container
 
         if (m_nbuffers == 0)
             m_nbuffers = 2 * foxxll::config::get_instance()->disks_number();
@@ -2121,6 +3659,134 @@ public:
 
 ////////////////////////////////////////////////////////////////////////////
 
+/*!
+ * Partitioned reader of a vector for parallel scans, for example in an OpenMP
+ * loop.
+ *
+ * The range [begin,end) is split into parts of about the same number of
+ * blocks, whose boundaries are block boundaries. Each part is read by its own
+ * vector_bufreader with a share of the I/O buffers. The container is flushed
+ * once on construction, afterwards the readers of the parts may be created
+ * and used concurrently by different threads. The container must not be
+ * accessed otherwise as long as the parts are read.
+ *
+ * See \ref tutorial_vector_buf
+ */
+template <typename VectorIterator>
+class vector_partitioned_bufreader
+{
+public:
+    //! template parameter: the vector iterator type
+    using vector_iterator = VectorIterator;
+
+    //! value type of the output vector
+    using value_type = typename vector_iterator::value_type;
+
+    //! block type used in the vector
+    using block_type = typename vector_iterator::block_type;
+
+    //! type of the input vector
+    using vector_type = typename vector_iterator::vector_type;
+
+    //! size of the parts
+    using size_type = typename vector_type::size_type;
+
+    //! buffered reader of one part
+    using bufreader_type = vector_bufreader<vector_iterator>;
+
+protected:
+    //! boundaries of the parts
+    std::vector<vector_iterator> m_bounds;
+
+    //! number of blocks to use as buffers per part.
+    size_t m_nbuffers;
+
+public:
+    //! Split the given iterator range into parts.
+    //! \param begin iterator to position were to start reading in vector
+    //! \param end iterator to position were to end reading in vector
+    //! \param nparts number of parts, default: the number of threads
+    //! \param nbuffers number of buffers used for overlapped I/O of all parts
+    //! together, default: two per part, but at least 2*D in total
+    vector_partitioned_bufreader(vector_iterator begin, vector_iterator end,
+                                 size_t nparts = 0, size_t nbuffers = 0)
+    {
+        begin.flush(); // flush container
+
+        if (nparts == 0)
+        {
+            nparts = task_runtime::get_instance().max_threads();
+        }
+        if (nbuffers == 0)
+            nbuffers = 2 * std::max(nparts, foxxll::config::get_instance()->disks_number());
+
+        m_nbuffers = std::max<size_t>(1, nbuffers / nparts);
+
+        // split the blocks of the range, counted from the beginning of the
+        // first block
+        const size_type head = begin.block_offset();
+        const size_type length = static_cast<size_type>(end - begin);
+        const size_type nblocks = foxxll::div_ceil(head + length, block_type::size);
+
+        m_bounds.reserve(nparts + 1);
+        m_bounds.push_back(begin);
+        for (size_t p = 1; p < nparts; ++p)
+        {
+            const size_type pos = p * nblocks / nparts * block_type::size;
+            m_bounds.push_back(
+                begin + std::min(length, pos - std::min(pos, head)));
+        }
+        m_bounds.push_back(end);
+    }
+
+    //! Number of parts.
+    size_t parts() const
+    {
+        return m_bounds.size() - 1;
+    }
+
+    //! Number of buffers of each part's reader.
+    size_t buffers() const
+    {
+        return m_nbuffers;
+    }
+
+    //! Iterator to the beginning of part p.
+    const vector_iterator& part_begin(size_t p) const
+    {
+        assert(p < parts());
+        return m_bounds[p];
+    }
+
+    //! Iterator to the end of part p.
+    const vector_iterator& part_end(size_t p) const
+    {
+        assert(p < parts());
+        return m_bounds[p + 1];
+    }
+
+    //! Return a buffered reader for part p, may be called concurrently.
+    std::unique_ptr<bufreader_type> reader(size_t p) const
+    {
+        return std::unique_ptr<bufreader_type>(
+            new bufreader_type(part_begin(p), part_end(p), m_nbuffers, false));
+    }
+
+    //! Read the parts in parallel, calling function(p, reader) with the
+    //! buffered reader of each part p.
+    template <typename Functor>
+    void for_each_part(Functor function) const
+    {
+        parallel_for(
+            0, parts(), [&](size_t p) {
+                bufreader_type reader(part_begin(p), part_end(p), m_nbuffers, false);
+                function(p, reader);
+            });
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////
+
 /*!
  * Buffered sequential reverse reader from a vector using overlapped I/O.
  *
@@ -2303,6 +3969,238 @@ public:
 
 ////////////////////////////////////////////////////////////////////////////
 
+/*!
+ * Buffered strided reader of a vector using overlapped I/O.
+ *
+ * This buffered reader reads every stride-th element of an iterator range,
+ * beginning with the first one, or for a negative stride every -stride-th
+ * element backwards beginning with the last one. Only the blocks holding
+ * these elements are read, in the order of the scan, with a prefetcher
+ * keeping up to nbuffers reads in flight. As few elements are consumed from
+ * each block for large strides, the default is a deeper prefetch of 4*D
+ * blocks.
+ *
+ * The items are accessed using operator * () and operator ++ () like the
+ * other buffered readers.
+ */
+template <typename VectorIterator>
+class vector_bufreader_strided
+{
+public:
+    //! template parameter: the vector iterator type
+    using vector_iterator = VectorIterator;
+
+    //! value type of the output vector
+    using value_type = typename vector_iterator::value_type;
+
+    //! block type used in the vector
+    using block_type = typename vector_iterator::block_type;
+
+    //! type of the input vector
+    using vector_type = typename vector_iterator::vector_type;
+
+    //! block identifier type of the vector
+    using bid_type = typename vector_iterator::bid_type;
+
+    //! size of remaining data
+    using size_type = typename vector_type::size_type;
+
+    //! signed distance of the elements read
+    using difference_type = typename vector_type::difference_type;
+
+    //! the sequence of blocks read
+    using bid_container_type = std::vector<bid_type>;
+
+    //! prefetcher of the blocks read
+    using prefetcher_type =
+        foxxll::block_prefetcher<block_type, typename bid_container_type::iterator>;
+
+protected:
+    //! iterator to the beginning of the range.
+    vector_iterator m_begin;
+
+    //! iterator to the end of the range.
+    vector_iterator m_end;
+
+    //! distance of the elements read.
+    difference_type m_stride;
+
+    //! number of elements read in total.
+    size_type m_size;
+
+    //! number of elements already read.
+    size_type m_index;
+
+    //! offset of the current element from the first block of the range.
+    size_type m_pos;
+
+    //! blocks holding the elements read, in the order of the scan.
+    bid_container_type m_bids;
+
+    //! prefetch order of m_bids, the identity.
+    std::vector<size_t> m_prefetch_seq;
+
+    //! prefetcher used to overlapped I/O.
+    prefetcher_type* m_prefetcher;
+
+    //! block holding the current element.
+    block_type* m_block;
+
+    //! number of blocks to use as buffers.
+    size_t m_nbuffers;
+
+    //! offset of the k-th element read from the first block of the range.
+    size_type position(size_type k) const
+    {
+        const size_type first = m_begin.block_offset();
+        if (m_stride > 0)
+            return first + k * static_cast<size_type>(m_stride);
+        return first + static_cast<size_type>(m_end - m_begin) - 1
+               - k * static_cast<size_type>(-m_stride);
+    }
+
+    void release()
+    {
+        delete m_prefetcher;
+        m_prefetcher = nullptr;
+        m_block = nullptr;
+    }
+
+public:
+    //! Create overlapped strided reader for the given iterator range.
+    //! \param begin iterator to position were to start reading in vector
+    //! \param end iterator to position were to end reading in vector
+    //! \param stride distance of the elements read, negative to read backwards
+    //! \param nbuffers number of buffers used for overlapped I/O (>= 4*D recommended)
+    vector_bufreader_strided(vector_iterator begin, vector_iterator end,
+                             difference_type stride, size_t nbuffers = 0)
+        : m_begin(begin), m_end(end),
+          m_stride(stride),
+          m_prefetcher(nullptr),
+          m_block(nullptr),
+          m_nbuffers(nbuffers)
+    {
+        assert(m_stride != 0);
+        assert(m_begin <= m_end);
+
+        m_begin.flush(); // flush container
+
+        if (m_nbuffers == 0)
+            m_nbuffers = 4 * foxxll::config::get_instance()->disks_number();
+
+        const size_type length = static_cast<size_type>(m_end - m_begin);
+        const size_type step = static_cast<size_type>(m_stride > 0 ? m_stride : -m_stride);
+        m_size = foxxll::div_ceil(length, step);
+
+        // collect the blocks of the elements read
+        for (size_type k = 0; k < m_size; ++k)
+        {
+            const size_type block = position(k) / block_type::size;
+            if (k == 0 || block != position(k - 1) / block_type::size)
+                m_bids.push_back(*(m_begin.bid() + static_cast<difference_type>(block)));
+        }
+
+        m_prefetch_seq.resize(m_bids.size());
+        for (size_t i = 0; i < m_prefetch_seq.size(); ++i)
+            m_prefetch_seq[i] = i;
+
+        m_nbuffers = std::max<size_t>(1, std::min(m_nbuffers, m_bids.size()));
+
+        rewind();
+    }
+
+    //! Create overlapped strided reader for the whole vector's content.
+    //! \param vec vector to read
+    //! \param stride distance of the elements read, negative to read backwards
+    //! \param nbuffers number of buffers used for overlapped I/O (>= 4*D recommended)
+    vector_bufreader_strided(const vector_type& vec, difference_type stride,
+                             size_t nbuffers = 0)
+        : vector_bufreader_strided(vec.begin(), vec.end(), stride, nbuffers)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    vector_bufreader_strided(const vector_bufreader_strided&) = delete;
+    //! non-copyable: delete assignment operator
+    vector_bufreader_strided& operator = (const vector_bufreader_strided&) = delete;
+
+    //! Rewind stream back to begin. Note that this recreates the prefetcher
+    //! and is thus not cheap.
+    void rewind()
+    {
+        release();
+
+        m_index = 0;
+        if (empty())
+            return;
+
+        m_prefetcher = new prefetcher_type(
+            m_bids.begin(), m_bids.end(), m_prefetch_seq.data(), m_nbuffers);
+        m_block = m_prefetcher->pull_block();
+        m_pos = position(0);
+    }
+
+    //! Finish reading and free the prefetcher.
+    ~vector_bufreader_strided()
+    {
+        release();
+    }
+
+    //! Return constant reference to current item
+    const value_type& operator * () const
+    {
+        return (*m_block)[static_cast<size_t>(m_pos % block_type::size)];
+    }
+
+    //! Return constant pointer to current item
+    const value_type* operator -> () const
+    {
+        return &operator * ();
+    }
+
+    //! Advance to next item (asserts if !empty()).
+    vector_bufreader_strided& operator ++ ()
+    {
+        assert(!empty());
+        ++m_index;
+
+        if (TLX_UNLIKELY(empty())) {
+            release();
+            return *this;
+        }
+
+        const size_type pos = position(m_index);
+        if (pos / block_type::size != m_pos / block_type::size)
+            m_prefetcher->block_consumed(m_block);
+        m_pos = pos;
+
+        return *this;
+    }
+
+    //! Read current item into variable and advance to next one.
+    vector_bufreader_strided& operator >> (value_type& v)
+    {
+        v = operator * ();
+        operator ++ ();
+
+        return *this;
+    }
+
+    //! Return remaining size.
+    size_type size() const
+    {
+        assert(m_index <= m_size);
+        return m_size - m_index;
+    }
+
+    //! Returns true once the whole range has been read.
+    bool empty() const
+    {
+        return (m_index == m_size);
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////
+
 /*!
  * Buffered sequential writer to a vector using overlapped I/O.
  *
@@ -2428,8 +4326,12 @@ public:
                 delete m_bufout;
                 m_bufout = nullptr;
 
+                // inform the vector about the last block written, otherwise
+                // its page may stay uninitialized
                 if (m_iter.block_offset() != 0)
                     m_iter.block_externally_updated();
+                else if (m_prevblk != m_iter)
+                    m_prevblk.block_externally_updated();
             }
 
             vector_type& v = *m_iter.parent_vector();
@@ -2548,9 +4450,10 @@ template <
     unsigned PageSize,
     typename PagerType,
     size_t BlockSize,
-    typename AllocStr>
-void swap(stxxl::vector<ValueType, PageSize, PagerType, BlockSize, AllocStr>& a,
-          stxxl::vector<ValueType, PageSize, PagerType, BlockSize, AllocStr>& b)
+    typename AllocStr,
+    typename BlockCodec>
+void swap(stxxl::vector<ValueType, PageSize, PagerType, BlockSize, AllocStr, BlockCodec>& a,
+          stxxl::vector<ValueType, PageSize, PagerType, BlockSize, AllocStr, BlockCodec>& b)
 {
     a.swap(b);
 }
@@ -0,0 +1,243 @@
+/***************************************************************************
+ *  include/stxxl/bits/containers/vector_concurrent_reader.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_CONTAINERS_VECTOR_CONCURRENT_READER_HEADER
+#define STXXL_CONTAINERS_VECTOR_CONCURRENT_READER_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+#include <tlx/simple_vector.hpp>
+
+#include <stxxl/bits/containers/vector.h>
+
+namespace stxxl {
+
+//! \addtogroup stlcont_vector
+//! \{
+
+/*!
+ * Thread-safe random read access to the elements of a stxxl::vector.
+ *
+ * The const accesses of the vector itself update its pager and page cache,
+ * hence they must not be used concurrently. This reader keeps its own block
+ * cache, which is split into shards by block number, each with its own mutex,
+ * and returns the elements by value, so that any number of threads can call
+ * operator[] at the same time.
+ *
+ * A missing block is read with the shard's mutex released, its slot is pinned
+ * meanwhile, so other threads can access the shard's cached blocks and load
+ * other blocks concurrently; threads requesting the block being loaded wait
+ * for it. The slots of a shard are replaced by CLOCK, skipping pinned ones.
+ *
+ * The vector is flushed on construction and must not be modified as long as
+ * the reader is used.
+ */
+template <typename VectorType>
+class vector_concurrent_reader
+{
+    static constexpr bool debug = false;
+
+public:
+    using vector_type = VectorType;
+    using value_type = typename vector_type::value_type;
+    using size_type = typename vector_type::size_type;
+    using block_type = typename vector_type::block_type;
+    using bids_container_iterator = typename vector_type::bids_container_iterator;
+
+protected:
+    static constexpr size_t no_block = size_t(-1);
+
+    //! part of the cache with its own mutex
+    struct shard
+    {
+        std::mutex mutex;
+        //! signaled when a block finished loading or a slot was unpinned
+        std::condition_variable cv;
+
+        tlx::simple_vector<block_type> blocks;
+        //! block number held by each slot, or no_block
+        std::vector<size_t> slot_block;
+        //! number of threads loading into or waiting on each slot
+        std::vector<size_t> pins;
+        //! whether the block of each slot is being read
+        std::vector<uint8_t> loading;
+        //! CLOCK reference bit of each slot
+        std::vector<uint8_t> referenced;
+        size_t hand = 0;
+
+        //! block number to slot
+        std::unordered_map<size_t, size_t> table;
+
+        explicit shard(size_t nslots)
+            : blocks(nslots),
+              slot_block(nslots, size_t(no_block)),
+              pins(nslots, 0),
+              loading(nslots, 0),
+              referenced(nslots, 0)
+        { }
+
+        //! Find an unpinned slot by CLOCK, returns false if all are pinned.
+        bool find_victim(size_t& slot)
+        {
+            for (size_t i = 0; i < 2 * blocks.size(); ++i)
+            {
+                const size_t s = hand;
+                if (++hand == blocks.size())
+                    hand = 0;
+                if (pins[s] != 0)
+                    continue;
+                if (referenced[s])
+                {
+                    referenced[s] = 0;
+                    continue;
+                }
+                slot = s;
+                return true;
+            }
+            return false;
+        }
+    };
+
+    size_type m_size;
+    bids_container_iterator m_bids;
+    std::vector<std::unique_ptr<shard> > m_shards;
+
+    shard& shard_of(size_t block_no) const
+    {
+        return *m_shards[block_no % m_shards.size()];
+    }
+
+public:
+    /*!
+     * Create a reader for the vector's content.
+     * \param vec vector to read, it is flushed
+     * \param nblocks number of blocks cached, default: the number of blocks
+     *   of the vector's page cache
+     * \param nshards number of shards of the cache, default: four per
+     *   hardware thread
+     */
+    explicit vector_concurrent_reader(const vector_type& vec,
+                                      size_t nblocks = 0, size_t nshards = 0)
+        : m_size(vec.size()),
+          m_bids(vec.cbegin().bid())
+    {
+        vec.flush();
+
+        if (nblocks == 0)
+            nblocks = vec.numpages() * vector_type::page_size;
+        if (nshards == 0)
+            nshards = 4 * std::max(1u, std::thread::hardware_concurrency());
+        nblocks = std::max<size_t>(nblocks, 1);
+        nshards = std::min(nshards, nblocks);
+
+        TLX_LOG << "vector_concurrent_reader: nblocks=" << nblocks
+                << " nshards=" << nshards;
+
+        m_shards.reserve(nshards);
+        for (size_t i = 0; i < nshards; ++i)
+        {
+            const size_t nslots = (i + 1) * nblocks / nshards - i * nblocks / nshards;
+            m_shards.emplace_back(new shard(nslots));
+        }
+    }
+
+    //! non-copyable: delete copy-constructor
+    vector_concurrent_reader(const vector_concurrent_reader&) = delete;
+    //! non-copyable: delete assignment operator
+    vector_concurrent_reader& operator = (const vector_concurrent_reader&) = delete;
+
+    //! Number of elements of the vector.
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    //! Return a copy of the element at the given index, thread-safe.
+    value_type operator [] (size_type index) const
+    {
+        assert(index < m_size);
+        const size_t block_no = static_cast<size_t>(index / block_type::size);
+        const size_t offset = static_cast<size_t>(index % block_type::size);
+
+        shard& s = shard_of(block_no);
+        std::unique_lock<std::mutex> lock(s.mutex);
+
+        while (true)
+        {
+            auto it = s.table.find(block_no);
+            if (it != s.table.end())
+            {
+                const size_t slot = it->second;
+                if (!s.loading[slot])
+                {
+                    s.referenced[slot] = 1;
+                    return s.blocks[slot][offset];
+                }
+                // wait for the thread loading the block
+                ++s.pins[slot];
+                s.cv.wait(lock, [&]() { return !s.loading[slot]; });
+                --s.pins[slot];
+                continue;
+            }
+
+            size_t slot;
+            if (!s.find_victim(slot))
+            {
+                // all slots are being loaded
+                s.cv.wait(lock);
+                continue;
+            }
+
+            if (s.slot_block[slot] != no_block)
+                s.table.erase(s.slot_block[slot]);
+            s.slot_block[slot] = block_no;
+            s.table[block_no] = slot;
+            s.loading[slot] = 1;
+            ++s.pins[slot];
+
+            lock.unlock();
+            try
+            {
+                s.blocks[slot].read(m_bids[block_no])->wait();
+            }
+            catch (...)
+            {
+                lock.lock();
+                s.table.erase(block_no);
+                s.slot_block[slot] = no_block;
+                s.loading[slot] = 0;
+                --s.pins[slot];
+                s.cv.notify_all();
+                throw;
+            }
+            lock.lock();
+
+            s.loading[slot] = 0;
+            s.referenced[slot] = 1;
+            --s.pins[slot];
+            s.cv.notify_all();
+            return s.blocks[slot][offset];
+        }
+    }
+};
+
+//! \}
+
+} // namespace stxxl
+
+#endif // !STXXL_CONTAINERS_VECTOR_CONCURRENT_READER_HEADER
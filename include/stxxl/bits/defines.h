@@ -60,6 +60,13 @@
 //          optimal schedule (Hutchinson, Sanders, Vitter: Duality between
 //          prefetching and queued writing on parallel disks, 2005)
 
+//#define STXXL_SORT_BALANCED_PREFETCHING 0/1
+// default: 1
+// used in: algo/*sort.h, stream/sort_stream.h
+// effect if defined to 0: reads the blocks of merged runs strictly in the
+//          order of the prefetch schedule instead of preferring the blocks on
+//          the disks with the fewest outstanding reads
+
 //#define STXXL_CHECK_ORDER_IN_SORTS 0/1
 // default: 0
 // used in: algo/*sort.h, stream/sort_stream.h, containers/priority_queue.h
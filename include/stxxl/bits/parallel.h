@@ -18,12 +18,14 @@
 #include <stxxl/bits/config.h>
 
 #include <cassert>
+#include <cstddef>
 
 #if STXXL_PARALLEL
  #include <omp.h>
 #endif
 
 #include <stxxl/bits/common/settings.h>
+#include <stxxl/bits/common/task_runtime.h>
 
 #if defined(_GLIBCXX_PARALLEL)
 //use _STXXL_FORCE_SEQUENTIAL to tag calls which are not worthwhile parallelizing
@@ -85,12 +87,22 @@ inline bool do_parallel_merge()
 #endif
 }
 
+//! number of runs formed concurrently in stxxl::sort's run formation, each
+//! thread sorting its own slice of the run formation buffers.
+inline size_t sort_run_formation_threads()
+{
+    if (stxxl::SETTINGS::parallel_run_formation)
+        return task_runtime::get_instance().max_threads();
+    return 1;
+}
+
 //! this namespace provides parallel or sequential algorithms depending on the
 //! compilation settings. it should be used by all components, where
 //! parallelism is optional.
 namespace potentially_parallel {
 
 using std::sort;
+using std::stable_sort;
 
 template<typename... Args>
 void random_shuffle(Args&&... args ) {
@@ -0,0 +1,393 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/distributed_sort.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_DISTRIBUTED_SORT_HEADER
+#define STXXL_STREAM_DISTRIBUTED_SORT_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <stxxl/bits/common/seed.h>
+#include <stxxl/bits/stream/sort_stream.h>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack Stream Package
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     DISTRIBUTED SORT                                               //
+////////////////////////////////////////////////////////////////////////
+
+/*!
+ * Message transport between the processes of a distributed_sort(), e.g. a
+ * wrapper of MPI or of TCP connections. Each process has one communicator.
+ *
+ * send() must not wait for the receiver: it copies or buffers the message,
+ * as MPI_Isend with a request completed later or a socket send buffer.
+ * Messages from one process to another arrive in the order they were sent.
+ */
+class communicator
+{
+public:
+    virtual ~communicator() { }
+
+    //! number of this process, 0 to size() - 1
+    virtual size_t rank() const = 0;
+
+    //! number of processes
+    virtual size_t size() const = 0;
+
+    //! Send a message of bytes to the process dest != rank().
+    virtual void send(size_t dest, const void* data, size_t bytes) = 0;
+
+    //! Receive a message from any process, if one arrived. Returns false
+    //! otherwise.
+    virtual bool try_receive(size_t& source, std::vector<char>& message) = 0;
+
+    //! Wait for and receive a message from any process.
+    virtual void receive(size_t& source, std::vector<char>& message) = 0;
+};
+
+/*!
+ * Communicators of a group of threads in one process, e.g. to sort with
+ * several threads that each own a partition of the data, or to test
+ * distributed algorithms. Messages are queued in internal memory.
+ */
+class local_communicator_group
+{
+    struct message_type
+    {
+        size_t source;
+        std::vector<char> data;
+    };
+
+    //! queue of the messages to one thread
+    struct mailbox
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<message_type> messages;
+    };
+
+    class endpoint : public communicator
+    {
+        local_communicator_group& m_group;
+        size_t m_rank;
+
+    public:
+        endpoint(local_communicator_group& group, size_t rank)
+            : m_group(group), m_rank(rank) { }
+
+        size_t rank() const final { return m_rank; }
+
+        size_t size() const final { return m_group.m_mailboxes.size(); }
+
+        void send(size_t dest, const void* data, size_t bytes) final
+        {
+            assert(dest < size() && dest != m_rank);
+            mailbox& box = *m_group.m_mailboxes[dest];
+            message_type message;
+            message.source = m_rank;
+            message.data.assign(static_cast<const char*>(data),
+                                static_cast<const char*>(data) + bytes);
+            {
+                std::unique_lock<std::mutex> lock(box.mutex);
+                box.messages.push_back(std::move(message));
+            }
+            box.cv.notify_one();
+        }
+
+        bool try_receive(size_t& source, std::vector<char>& message) final
+        {
+            mailbox& box = *m_group.m_mailboxes[m_rank];
+            std::unique_lock<std::mutex> lock(box.mutex);
+            if (box.messages.empty())
+                return false;
+            source = box.messages.front().source;
+            message.swap(box.messages.front().data);
+            box.messages.pop_front();
+            return true;
+        }
+
+        void receive(size_t& source, std::vector<char>& message) final
+        {
+            mailbox& box = *m_group.m_mailboxes[m_rank];
+            std::unique_lock<std::mutex> lock(box.mutex);
+            box.cv.wait(lock, [&box]() { return !box.messages.empty(); });
+            source = box.messages.front().source;
+            message.swap(box.messages.front().data);
+            box.messages.pop_front();
+        }
+    };
+
+    std::vector<std::unique_ptr<mailbox> > m_mailboxes;
+    std::vector<std::unique_ptr<endpoint> > m_endpoints;
+
+public:
+    //! Create the communicators of size threads.
+    explicit local_communicator_group(size_t size)
+    {
+        assert(size > 0);
+        for (size_t i = 0; i < size; ++i)
+        {
+            m_mailboxes.emplace_back(new mailbox);
+            m_endpoints.emplace_back(new endpoint(*this, i));
+        }
+    }
+
+    //! non-copyable: delete copy-constructor
+    local_communicator_group(const local_communicator_group&) = delete;
+    //! non-copyable: delete assignment operator
+    local_communicator_group& operator = (const local_communicator_group&) = delete;
+
+    //! number of threads
+    size_t size() const { return m_endpoints.size(); }
+
+    //! The communicator of thread rank.
+    communicator& operator [] (size_t rank)
+    {
+        assert(rank < size());
+        return *m_endpoints[rank];
+    }
+};
+
+namespace distributed_sort_local {
+
+/*!
+ * Receives the messages of the other processes of a distributed_sort(): the
+ * first message from each process holds its samples, the following ones its
+ * elements for this process, and an empty message ends them.
+ */
+template <typename ValueType, typename RunsCreator>
+class receiver
+{
+    communicator& m_comm;
+    RunsCreator& m_runs_creator;
+
+    std::vector<ValueType> m_samples;
+    std::vector<size_t> m_messages;
+    size_t m_samples_missing, m_ends_missing;
+
+    std::vector<char> m_message;
+
+    void handle(size_t source)
+    {
+        const ValueType* elements = reinterpret_cast<const ValueType*>(m_message.data());
+        const size_t n = m_message.size() / sizeof(ValueType);
+        assert(n * sizeof(ValueType) == m_message.size());
+
+        if (m_messages[source]++ == 0)
+        {
+            m_samples.insert(m_samples.end(), elements, elements + n);
+            --m_samples_missing;
+        }
+        else if (n == 0)
+            --m_ends_missing;
+        else
+        {
+            for (size_t i = 0; i < n; ++i)
+                m_runs_creator.push(elements[i]);
+        }
+    }
+
+public:
+    receiver(communicator& comm, RunsCreator& runs_creator)
+        : m_comm(comm), m_runs_creator(runs_creator),
+          m_messages(comm.size(), 0),
+          m_samples_missing(comm.size() - 1), m_ends_missing(comm.size() - 1)
+    { }
+
+    //! samples of all processes, after wait_for_samples()
+    std::vector<ValueType>& samples() { return m_samples; }
+
+    //! Handle the messages that arrived.
+    void poll()
+    {
+        size_t source;
+        while (m_comm.try_receive(source, m_message))
+            handle(source);
+    }
+
+    void wait_for_samples()
+    {
+        size_t source;
+        while (m_samples_missing > 0)
+        {
+            m_comm.receive(source, m_message);
+            handle(source);
+        }
+    }
+
+    void wait_for_ends()
+    {
+        size_t source;
+        while (m_ends_missing > 0)
+        {
+            m_comm.receive(source, m_message);
+            handle(source);
+        }
+    }
+};
+
+} // namespace distributed_sort_local
+
+/*!
+ * Sorts the elements of the input streams of all processes of comm, such
+ * that process i outputs the i-th range of the global order into its output
+ * vector. Each process calls distributed_sort() with its own input.
+ *
+ * The first batch of the input, up to a quarter of memory_to_use, is kept in
+ * internal memory. Each process draws random samples from its batch and
+ * sends them to all others, then every process picks the same size() - 1
+ * splitters from all samples. The batch and the rest of the input are then
+ * streamed once: every element is classified by the splitters and pushed
+ * into the local runs_creator, or sent to its process in messages of about
+ * one block. Received elements are pushed into the local runs_creator as
+ * they arrive. Finally, each process merges its sorted runs with a
+ * runs_merger into the output.
+ *
+ * Elements equal to a splitter go to the process after it. The partitions
+ * are balanced if the batches are representative of the inputs.
+ *
+ * \tparam BlockSize size of the blocks of the sorted runs
+ * \param input stream of the elements of this process
+ * \param cmp comparator with min_value() and max_value() as for stream::sort
+ * \param memory_to_use bytes of internal memory of this process
+ * \param comm communicator of this process
+ * \param output vector which is resized to the partition of this process
+ * \param oversampling number of samples per process and splitter
+ * \return number of elements in the output of this process
+ */
+template <size_t BlockSize, typename Input, typename CompareType, typename VectorType>
+size_t distributed_sort(Input& input, CompareType cmp, size_t memory_to_use,
+                        communicator& comm, VectorType& output, size_t oversampling = 16)
+{
+    using value_type = typename Input::value_type;
+    using runs_creator_type = runs_creator<use_push<value_type>, CompareType, BlockSize>;
+    using runs_merger_type = runs_merger<typename runs_creator_type::sorted_runs_type, CompareType>;
+    using receiver_type = distributed_sort_local::receiver<value_type, runs_creator_type>;
+
+    const size_t rank = comm.rank(), num_procs = comm.size();
+
+    // message buffers to each other process, of about one block
+    const size_t message_elements = std::max<size_t>(
+        1, std::min<size_t>(BlockSize, memory_to_use / 8 / num_procs) / sizeof(value_type));
+    const size_t batch_elements = std::max<size_t>(1, memory_to_use / 4 / sizeof(value_type));
+
+    typename runs_merger_type::sorted_runs_type runs;
+    {
+        runs_creator_type runs_creator(cmp, memory_to_use / 2);
+        receiver_type receiver(comm, runs_creator);
+
+        // first batch of the input
+        std::vector<value_type> batch;
+        for ( ; !input.empty() && batch.size() < batch_elements; ++input)
+            batch.push_back(*input);
+
+        // send own samples, receive those of the others
+        std::vector<value_type> samples;
+        std::mt19937 rng(seed_sequence::get_ref().get_next_seed() + static_cast<unsigned>(rank));
+        const size_t num_samples = batch.empty() ? 0 : oversampling * num_procs;
+        for (size_t i = 0; i < num_samples; ++i)
+            samples.push_back(batch[rng() % batch.size()]);
+        for (size_t p = 0; p < num_procs; ++p)
+        {
+            if (p != rank)
+                comm.send(p, samples.data(), samples.size() * sizeof(value_type));
+        }
+        receiver.wait_for_samples();
+
+        std::vector<value_type>& all_samples = receiver.samples();
+        all_samples.insert(all_samples.end(), samples.begin(), samples.end());
+        std::sort(all_samples.begin(), all_samples.end(), cmp);
+
+        std::vector<value_type> splitters;
+        if (!all_samples.empty())
+        {
+            for (size_t p = 1; p < num_procs; ++p)
+                splitters.push_back(all_samples[p * all_samples.size() / num_procs]);
+        }
+        TLX_LOG0 << "distributed_sort: rank " << rank << " uses " << splitters.size()
+                 << " splitters from " << all_samples.size() << " samples";
+
+        // distribute the batch and the rest of the input
+        std::vector<std::vector<value_type> > buffers(num_procs);
+        auto distribute = [&](const value_type& element) {
+            const size_t p = splitters.empty() ? rank : static_cast<size_t>(
+                std::upper_bound(splitters.begin(), splitters.end(), element, cmp) - splitters.begin());
+            if (p == rank)
+            {
+                runs_creator.push(element);
+                return;
+            }
+            std::vector<value_type>& buffer = buffers[p];
+            buffer.push_back(element);
+            if (buffer.size() >= message_elements)
+            {
+                comm.send(p, buffer.data(), buffer.size() * sizeof(value_type));
+                buffer.clear();
+                receiver.poll();
+            }
+        };
+        for (const value_type& element : batch)
+            distribute(element);
+        std::vector<value_type>().swap(batch);
+        for ( ; !input.empty(); ++input)
+            distribute(*input);
+
+        // send the rest, then an empty message to end the elements
+        for (size_t p = 0; p < num_procs; ++p)
+        {
+            if (p == rank)
+                continue;
+            if (!buffers[p].empty())
+                comm.send(p, buffers[p].data(), buffers[p].size() * sizeof(value_type));
+            comm.send(p, nullptr, 0);
+        }
+        receiver.wait_for_ends();
+
+        runs = runs_creator.result();
+    }
+
+    runs_merger_type merger(runs, cmp, memory_to_use);
+    const size_t size = static_cast<size_t>(merger.size());
+    output.resize(size);
+    materialize(merger, output.begin(), output.end());
+    return size;
+}
+
+//! distributed_sort() with the default block size of stream::sort.
+template <typename Input, typename CompareType, typename VectorType>
+size_t distributed_sort(Input& input, CompareType cmp, size_t memory_to_use,
+                        communicator& comm, VectorType& output, size_t oversampling = 16)
+{
+    return distributed_sort<STXXL_DEFAULT_BLOCK_SIZE(typename Input::value_type)>(
+        input, cmp, memory_to_use, comm, output, oversampling);
+}
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_DISTRIBUTED_SORT_HEADER
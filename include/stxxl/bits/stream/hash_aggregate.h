@@ -0,0 +1,270 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/hash_aggregate.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_HASH_AGGREGATE_HEADER
+#define STXXL_STREAM_HASH_AGGREGATE_HEADER
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/defines.h>
+#include <stxxl/bits/stream/stream.h>
+#include <stxxl/vector>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     HASH AGGREGATE                                                 //
+////////////////////////////////////////////////////////////////////////
+
+//! Stream which groups the (key, value) pairs of its input by key and
+//! emits each key once with the combination of all its values, in no
+//! particular order. Unlike \c unique it needs no sorted input.
+//!
+//! The pairs are aggregated in an in-memory hash table. Once the table
+//! holds as many keys as fit into memory_to_use, pairs of further keys are
+//! spilled to one of \c fanout partitions on disk by their hash value, while
+//! the keys in the table are still aggregated there. After the table is
+//! emitted, the partitions are aggregated one at a time in the same way,
+//! spilling recursively with a differently mixed hash. If the groups fit
+//! into memory after aggregation, nothing is written to disk. Beyond \c
+//! max_levels of recursion, which only keys with equal hash values reach,
+//! the table grows beyond memory_to_use.
+//!
+//! Combine is called as combine(a, b) with two values of the same key and
+//! returns their combination, it must be associative and commutative. The
+//! pair type of the input must be trivially copyable to be spilled.
+//!
+//! \tparam Input input stream of std::pair<Key, Value>
+//! \tparam CombineType binary function object combining two values
+//! \tparam HashType hash function object of the keys
+//! \tparam KeyEqualType equality of the keys
+//! \tparam BlockSize block size of the spilled partitions
+template <class Input, class CombineType,
+          class HashType = std::hash<typename Input::value_type::first_type>,
+          class KeyEqualType = std::equal_to<typename Input::value_type::first_type>,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(typename Input::value_type)>
+class hash_aggregate
+{
+public:
+    //! Standard stream typedef, pairs of a key and its aggregate.
+    using value_type = typename Input::value_type;
+    using key_type = typename value_type::first_type;
+    using aggregate_type = typename value_type::second_type;
+    using combine_type = CombineType;
+    using hash_type = HashType;
+    using key_equal_type = KeyEqualType;
+
+    //! number of partitions pairs are spilled to per level
+    static constexpr size_t fanout = 16;
+    //! maximum level of recursive partitioning
+    static constexpr size_t max_levels = 8;
+
+    //! external vector holding a spilled partition, caching one block
+    using partition_type = stxxl::vector<value_type, 1, lru_pager<1>, BlockSize>;
+
+private:
+    using table_type = std::unordered_map<
+              key_type, aggregate_type, hash_type, key_equal_type>;
+
+    //! a spilled partition waiting to be aggregated
+    struct pending_partition
+    {
+        std::unique_ptr<partition_type> values;
+        size_t level;
+    };
+
+    Input& m_input;
+    combine_type m_combine;
+    hash_type m_hash;
+
+    //! number of keys fitting into the table
+    size_t m_max_entries;
+
+    //! hash table of the partition currently aggregated and emitted
+    table_type m_table;
+    typename table_type::const_iterator m_iter;
+
+    //! current output value
+    value_type m_current;
+
+    //! spilled partitions which were not aggregated yet
+    std::vector<pending_partition> m_pending;
+
+    //! number of pairs written to partitions
+    uint64_t m_spilled;
+
+    //! Partition of key at a level of the recursion. The hash value is
+    //! salted by the level and mixed with the finalizer of MurmurHash3, such
+    //! that the keys of a partition are split again at the next level.
+    size_t partition_of(const key_type& key, size_t level) const
+    {
+        uint64_t h = static_cast<uint64_t>(m_hash(key))
+                     + (level + 1) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return static_cast<size_t>(h % fanout);
+    }
+
+    //! Aggregate the pairs of a stream into the table, spilling the pairs of
+    //! new keys into partitions of the next level once the table is full.
+    template <typename Stream>
+    void aggregate(Stream& in, size_t level)
+    {
+        std::vector<std::unique_ptr<partition_type> > spill(fanout);
+        const bool may_spill = (level < max_levels);
+
+        for ( ; !in.empty(); ++in)
+        {
+            const value_type& kv = *in;
+            typename table_type::iterator it = m_table.find(kv.first);
+            if (it != m_table.end())
+            {
+                it->second = m_combine(it->second, kv.second);
+            }
+            else if (m_table.size() < m_max_entries || !may_spill)
+            {
+                m_table.emplace(kv.first, kv.second);
+            }
+            else
+            {
+                std::unique_ptr<partition_type>& p = spill[partition_of(kv.first, level)];
+                if (!p)
+                    p.reset(new partition_type());
+                p->push_back(kv);
+                ++m_spilled;
+            }
+        }
+
+        for (std::unique_ptr<partition_type>& p : spill)
+        {
+            if (!p)
+                continue;
+            // release the cached block until the partition is read
+            p->deallocate_page_cache();
+            m_pending.push_back(pending_partition { std::move(p), level + 1 });
+        }
+    }
+
+    //! Aggregate spilled partitions into the table until it holds keys or
+    //! all pairs are emitted, and set the current value.
+    void fetch()
+    {
+        while (m_iter == m_table.end() && !m_pending.empty())
+        {
+            pending_partition part = std::move(m_pending.back());
+            m_pending.pop_back();
+
+            m_table.clear();
+            {
+                const partition_type& values = *part.values;
+                auto in = streamify(values.cbegin(), values.cend());
+                aggregate(in, part.level);
+            }
+            m_iter = m_table.begin();
+        }
+
+        if (m_iter != m_table.end())
+            m_current = value_type(m_iter->first, m_iter->second);
+    }
+
+public:
+    //! Construct the stage and aggregate the input, at least until its
+    //! groups exceed memory_to_use.
+    //! \param input input stream of (key, value) pairs
+    //! \param combine function object combining two values of a key
+    //! \param memory_to_use bytes of internal memory for the hash table and
+    //! the blocks of the partitions
+    //! \param hash function object of the keys
+    hash_aggregate(Input& input, const combine_type& combine,
+                   size_t memory_to_use, const hash_type& hash = hash_type())
+        : m_input(input), m_combine(combine), m_hash(hash),
+          m_table(16, hash), m_spilled(0)
+    {
+        // blocks of the spilled partitions and of reading one of them
+        const size_t block_memory =
+            (fanout + 2 * foxxll::config::get_instance()->disks_number()) * BlockSize;
+        // a table entry is a node with the pair, next pointer and cached
+        // hash value, plus a bucket pointer
+        const size_t entry_size = sizeof(value_type) + 3 * sizeof(void*);
+
+        m_max_entries = (memory_to_use > block_memory)
+                        ? (memory_to_use - block_memory) / entry_size : 0;
+        if (m_max_entries == 0)
+            m_max_entries = 1;
+
+        aggregate(m_input, 0);
+        m_iter = m_table.begin();
+        fetch();
+    }
+
+    //! non-copyable: delete copy-constructor
+    hash_aggregate(const hash_aggregate&) = delete;
+    //! non-copyable: delete assignment operator
+    hash_aggregate& operator = (const hash_aggregate&) = delete;
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return m_current;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    hash_aggregate& operator ++ ()
+    {
+        assert(!empty());
+        ++m_iter;
+        fetch();
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_iter == m_table.end();
+    }
+
+    //! Number of pairs which were spilled to disk so far, zero if all groups
+    //! fit into memory.
+    uint64_t spilled() const
+    {
+        return m_spilled;
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_HASH_AGGREGATE_HEADER
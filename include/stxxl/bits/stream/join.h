@@ -0,0 +1,245 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/join.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_JOIN_HEADER
+#define STXXL_STREAM_JOIN_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <stxxl/vector>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     MERGE_JOIN                                                     //
+////////////////////////////////////////////////////////////////////////
+
+//! Inner equi-join of two streams sorted by their keys.
+//!
+//! Delivers a std::pair of elements (a, b) for each a of InputA and b of
+//! InputB with equal keys, ordered by key, then by a, then by b in input
+//! order. The elements of InputB with the current key are buffered: up to
+//! group_memory bytes are kept in internal memory, larger groups spill the
+//! rest to an external vector, which is then read with overlapped I/O once
+//! for each matching element of InputA.
+//!
+//! Use stream::sort to order unsorted inputs by their keys.
+//!
+//! \tparam InputA type of the first input stream, sorted by KeyA
+//! \tparam InputB type of the second input stream, sorted by KeyB
+//! \tparam KeyA functor extracting the key of an element of InputA
+//! \tparam KeyB functor extracting the key of an element of InputB
+//! \tparam CompareType type of comparison object of the keys, used to sort
+//!         both inputs
+template <class InputA, class InputB, class KeyA, class KeyB,
+          class CompareType = std::less<> >
+class merge_join
+{
+public:
+    using a_value_type = typename InputA::value_type;
+    using b_value_type = typename InputB::value_type;
+
+    //! Standard stream typedef.
+    using value_type = std::pair<a_value_type, b_value_type>;
+
+private:
+    static constexpr bool debug = false;
+
+    //! external vector receiving the elements of large groups
+    using spill_vector_type = stxxl::vector<b_value_type, 1, lru_pager<2> >;
+    using spill_reader_type = typename spill_vector_type::bufreader_type;
+
+    InputA& m_input_a;
+    InputB& m_input_b;
+    KeyA m_key_a;
+    KeyB m_key_b;
+    CompareType m_cmp;
+
+    //! maximum number of elements of a group kept in internal memory
+    size_t m_group_capacity;
+
+    //! internal part of the current group of InputB
+    std::vector<b_value_type> m_group;
+
+    //! external part of the current group of InputB
+    spill_vector_type m_spill;
+
+    //! reader of m_spill, created for each group which spills
+    std::unique_ptr<spill_reader_type> m_spill_reader;
+
+    //! true if m_group holds the group matching the current element of InputA
+    bool m_group_valid;
+
+    //! position of the next b of the group delivered for the current a
+    size_t m_group_pos;
+
+    //! current element
+    value_type m_current;
+
+    //! true if no more matches exist
+    bool m_empty;
+
+    template <typename KeyX, typename KeyY>
+    bool equal_keys(const KeyX& x, const KeyY& y) const
+    {
+        return !m_cmp(x, y) && !m_cmp(y, x);
+    }
+
+    //! Read all elements of InputB equal in key to its current element.
+    void load_group()
+    {
+        m_spill_reader.reset();
+        m_group.clear();
+        m_spill.clear();
+
+        const b_value_type first = *m_input_b;
+        do {
+            if (m_group.size() < m_group_capacity)
+                m_group.push_back(*m_input_b);
+            else
+                m_spill.push_back(*m_input_b);
+            ++m_input_b;
+        } while (!m_input_b.empty() &&
+                 equal_keys(m_key_b(first), m_key_b(*m_input_b)));
+
+        TLX_LOGC(debug && !m_spill.empty())
+            << "merge_join: group of " << m_group.size() + m_spill.size()
+            << " elements, " << m_spill.size() << " spilled";
+
+        m_group_valid = true;
+    }
+
+    //! Set m_current to the first match of the current or a later element of
+    //! InputA.
+    void find_match()
+    {
+        while (!m_input_a.empty())
+        {
+            if (m_group_valid)
+            {
+                if (equal_keys(m_key_a(*m_input_a), m_key_b(m_group.front())))
+                {
+                    // join the current a with the group from its start
+                    m_group_pos = 0;
+                    if (m_spill_reader)
+                        m_spill_reader->rewind();
+                    else if (!m_spill.empty())
+                        m_spill_reader.reset(new spill_reader_type(m_spill));
+                    m_current.first = *m_input_a;
+                    m_current.second = m_group.front();
+                    m_empty = false;
+                    return;
+                }
+                m_group_valid = false;
+            }
+
+            // advance both inputs to the next common key
+            while (!m_input_a.empty() && !m_input_b.empty())
+            {
+                if (m_cmp(m_key_a(*m_input_a), m_key_b(*m_input_b)))
+                    ++m_input_a;
+                else if (m_cmp(m_key_b(*m_input_b), m_key_a(*m_input_a)))
+                    ++m_input_b;
+                else
+                    break;
+            }
+
+            if (m_input_a.empty() || m_input_b.empty())
+                break;
+
+            load_group();
+        }
+
+        m_empty = true;
+    }
+
+public:
+    //! Join the streams input_a and input_b using group_memory bytes of
+    //! internal memory for buffering equal-key groups of input_b.
+    merge_join(InputA& input_a, InputB& input_b,
+               KeyA key_a = KeyA(), KeyB key_b = KeyB(),
+               size_t group_memory = 16 * 1024 * 1024,
+               CompareType cmp = CompareType())
+        : m_input_a(input_a), m_input_b(input_b),
+          m_key_a(key_a), m_key_b(key_b), m_cmp(cmp),
+          m_group_capacity(std::max<size_t>(group_memory / sizeof(b_value_type), 1)),
+          m_group_valid(false), m_group_pos(0), m_empty(true)
+    {
+        find_match();
+    }
+
+    //! non-copyable: delete copy-constructor
+    merge_join(const merge_join&) = delete;
+    //! non-copyable: delete assignment operator
+    merge_join& operator = (const merge_join&) = delete;
+
+    //! Standard stream method.
+    merge_join& operator ++ ()
+    {
+        assert(!m_empty);
+
+        ++m_group_pos;
+        if (m_group_pos < m_group.size())
+        {
+            m_current.second = m_group[m_group_pos];
+            return *this;
+        }
+        if (m_spill_reader && !m_spill_reader->empty())
+        {
+            m_current.second = **m_spill_reader;
+            ++(*m_spill_reader);
+            return *this;
+        }
+
+        // group exhausted for the current a
+        ++m_input_a;
+        find_match();
+        return *this;
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!m_empty);
+        return m_current;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &operator * ();
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_empty;
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_JOIN_HEADER
@@ -15,8 +15,14 @@
 #ifndef STXXL_STREAM_MATERIALIZE_HEADER
 #define STXXL_STREAM_MATERIALIZE_HEADER
 
+#include <algorithm>
 #include <cassert>
+#include <type_traits>
+#include <vector>
 
+#include <foxxll/io/request_operations.hpp>
+
+#include <stxxl/bits/stream/stream.h>
 #include <stxxl/vector>
 
 namespace stxxl {
@@ -71,6 +77,119 @@ materialize(StreamAlgorithm& in, OutputIterator outbegin, OutputIterator outend)
     return outbegin;
 }
 
+//! Copy up to n next values of a stream of ValueType by its batches.
+template <typename StreamAlgorithm, typename ValueType>
+typename std::enable_if<
+    std::is_same<typename StreamAlgorithm::value_type, ValueType>::value, size_t>::type
+materialize_values(StreamAlgorithm& in, ValueType* out, size_t n)
+{
+    return next_batch(in, out, n);
+}
+
+//! Copy up to n next values of a stream of another type, which are converted.
+template <typename StreamAlgorithm, typename ValueType>
+typename std::enable_if<
+    !std::is_same<typename StreamAlgorithm::value_type, ValueType>::value, size_t>::type
+materialize_values(StreamAlgorithm& in, ValueType* out, size_t n)
+{
+    size_t i = 0;
+    for ( ; i < n && !in.empty(); ++i, ++in)
+        out[i] = *in;
+    return i;
+}
+
+//! Fill up to limit values of the block by batches of the stream.
+template <typename StreamAlgorithm, typename BlockType>
+size_t materialize_fill_block(StreamAlgorithm& in, BlockType*& block,
+                              size_t limit, std::false_type)
+{
+    size_t filled = 0;
+    while (filled < limit)
+    {
+        const size_t n = materialize_values(in, block->elem + filled, limit - filled);
+        if (n == 0)
+            break;
+        filled += n;
+    }
+    return filled;
+}
+
+//! Take a full output block handed over by the stream's next_block(), else
+//! fill the block by batches. Returns the number of values in block.
+template <typename StreamAlgorithm, typename BlockType>
+size_t materialize_fill_block(StreamAlgorithm& in, BlockType*& block,
+                              size_t limit, std::true_type)
+{
+    if (limit == BlockType::size)
+    {
+        const size_t n = in.next_block(block);
+        if (n != 0)
+            return n;
+    }
+    return materialize_fill_block(in, block, limit, std::false_type());
+}
+
+//! Writes up to max_values of the stream to the vector starting at out,
+//! which must be at a block boundary, by whole blocks: they are filled by
+//! batches or taken over by the stream's next_block() and written directly
+//! to the vector's blocks with nbuffers overlapped writes. A last partial
+//! block is completed with the values of the vector.
+//! \return iterator behind the written values
+template <typename StreamAlgorithm, typename VectorConfig>
+stxxl::vector_iterator<VectorConfig> materialize_blocks(
+    StreamAlgorithm& in,
+    stxxl::vector_iterator<VectorConfig> out,
+    size_t max_values, size_t nbuffers)
+{
+    using ExtIterator = stxxl::vector_iterator<VectorConfig>;
+    using ConstExtIterator = stxxl::const_vector_iterator<VectorConfig>;
+    using block_type = typename ExtIterator::block_type;
+    using has_block_type = has_next_block<StreamAlgorithm, block_type>;
+
+    assert(out.block_offset() == 0);
+
+    std::vector<block_type*> blocks(nbuffers, nullptr);
+    std::vector<foxxll::request_ptr> requests(nbuffers);
+
+    for (size_t i = 0; max_values != 0 && !in.empty(); ++i)
+    {
+        const size_t k = i % nbuffers;
+        if (requests[k])
+            requests[k]->wait();
+        else if (!blocks[k])
+            blocks[k] = new block_type;
+
+        const size_t n = materialize_fill_block(
+            in, blocks[k], std::min(max_values, size_t(block_type::size)),
+            has_block_type());
+        if (n == 0)
+            break;
+
+        ConstExtIterator const_out = out;
+        if (n < block_type::size)
+        {
+            // copy over the rest of the block from the vector, which might
+            // cause I/Os for loading the page, after the direct writes to it
+            foxxll::wait_all(requests.begin(), requests.end());
+            const_out += n;
+            for (size_t j = n; j < block_type::size; ++j, ++const_out)
+                (*blocks[k])[j] = *const_out;
+            const_out -= block_type::size;
+        }
+
+        requests[k] = blocks[k]->write(*out.bid());
+        const_out.block_externally_updated();
+        out += n;
+        max_values -= n;
+    }
+
+    foxxll::wait_all(requests.begin(), requests.end());
+    for (block_type* b : blocks)
+        delete b;
+
+    return out;
+}
+
 //! Stores consecutively stream content to an output \c stxxl::vector iterator \b until end of the stream or end of the iterator range is reached.
 //! \param in stream to be stored used as source
 //! \param outbegin output \c stxxl::vector iterator used as destination
@@ -82,6 +201,8 @@ materialize(StreamAlgorithm& in, OutputIterator outbegin, OutputIterator outend)
 //! \pre Output range is large enough to hold the all elements in the input stream
 //!
 //! This function is useful when you do not know the length of the stream beforehand.
+//! Whole blocks are filled by batches of the stream, see next_batch(), and
+//! written directly; blocks handed over by next_block() are not copied.
 template <typename StreamAlgorithm, typename VectorConfig>
 stxxl::vector_iterator<VectorConfig> materialize(
     StreamAlgorithm& in,
@@ -89,12 +210,6 @@ stxxl::vector_iterator<VectorConfig> materialize(
     stxxl::vector_iterator<VectorConfig> outend,
     size_t nbuffers = 0)
 {
-    using ExtIterator = stxxl::vector_iterator<VectorConfig>;
-    using ConstExtIterator = stxxl::const_vector_iterator<VectorConfig>;
-    using buf_ostream_type =
-              foxxll::buf_ostream<typename ExtIterator::block_type,
-                                  typename ExtIterator::bids_container_iterator>;
-
     while (outbegin.block_offset())     //  go to the beginning of the block
     //  of the external vector
     {
@@ -111,41 +226,8 @@ stxxl::vector_iterator<VectorConfig> materialize(
 
     outbegin.flush();     // flush container
 
-    // create buffered write stream for blocks
-    buf_ostream_type outstream(outbegin.bid(), nbuffers);
-
-    assert(outbegin.block_offset() == 0);
-
-    // delay calling block_externally_updated() until the block is
-    // completely filled (and written out) in outstream
-    ConstExtIterator prev_block = outbegin;
-
-    while (!in.empty() && outend != outbegin)
-    {
-        if (outbegin.block_offset() == 0) {
-            if (prev_block != outbegin) {
-                prev_block.block_externally_updated();
-                prev_block = outbegin;
-            }
-        }
-
-        *outstream = *in;
-        ++outbegin;
-        ++outstream;
-        ++in;
-    }
-
-    ConstExtIterator const_out = outbegin;
-
-    while (const_out.block_offset())     // filling the rest of the block
-    {
-        *outstream = *const_out;
-        ++const_out;
-        ++outstream;
-    }
-
-    if (prev_block != outbegin)
-        prev_block.block_externally_updated();
+    outbegin = materialize_blocks(
+        in, outbegin, static_cast<size_t>(outend - outbegin), nbuffers);
 
     outbegin.flush();
 
@@ -166,12 +248,6 @@ stxxl::vector_iterator<VectorConfig> materialize(
     stxxl::vector_iterator<VectorConfig> out,
     size_t nbuffers = 0)
 {
-    using ExtIterator = stxxl::vector_iterator<VectorConfig>;
-    using ConstExtIterator = stxxl::const_vector_iterator<VectorConfig>;
-    using buf_ostream_type =
-              foxxll::buf_ostream<typename ExtIterator::block_type,
-                                  typename ExtIterator::bids_container_iterator>;
-
     // on the I/O complexity of "materialize":
     // crossing block boundary causes O(1) I/Os
     // if you stay in a block, then materialize function accesses only the cache of the
@@ -193,49 +269,30 @@ stxxl::vector_iterator<VectorConfig> materialize(
 
     out.flush();     // flush container
 
-    // create buffered write stream for blocks
-    buf_ostream_type outstream(out.bid(), nbuffers);
-
-    assert(out.block_offset() == 0);
-
-    // delay calling block_externally_updated() until the block is
-    // completely filled (and written out) in outstream
-    ConstExtIterator prev_block = out;
-
-    while (!in.empty())
-    {
-        if (out.block_offset() == 0) {
-            if (prev_block != out) {
-                prev_block.block_externally_updated();
-                prev_block = out;
-            }
-        }
-
-        // tells the vector that the block was modified
-        *outstream = *in;
-        ++out;
-        ++outstream;
-        ++in;
-    }
-
-    ConstExtIterator const_out = out;
-
-    // copy over items remaining in block from vector.
-    while (const_out.block_offset())
-    {
-        *outstream = *const_out;                 // might cause I/Os for loading the page that
-        ++const_out;                             // contains data beyond out
-        ++outstream;
-    }
-
-    if (prev_block != out)
-        prev_block.block_externally_updated();
+    out = materialize_blocks(in, out, ~size_t(0), nbuffers);
 
     out.flush();
 
     return out;
 }
 
+//! Appends the stream content to an \c stxxl::vector, which grows while the
+//! stream is read, see stxxl::vector::append_from_stream().
+//! \param in stream to be stored used as source
+//! \param out \c stxxl::vector to append to
+//! \return iterator to the end of the vector
+template <typename StreamAlgorithm, typename ValueType, unsigned PageSize,
+          typename PagerType, size_t BlockSize, typename AllocStr,
+          typename BlockCodec>
+typename stxxl::vector<ValueType, PageSize, PagerType, BlockSize, AllocStr, BlockCodec>::iterator
+materialize(
+    StreamAlgorithm& in,
+    stxxl::vector<ValueType, PageSize, PagerType, BlockSize, AllocStr, BlockCodec>& out)
+{
+    out.append_from_stream(in);
+    return out.end();
+}
+
 //! Reads stream content and discards it.
 //! Useful where you do not need the processed stream anymore,
 //! but are just interested in side effects, or just for debugging.
@@ -0,0 +1,285 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/memory_budget.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_MEMORY_BUDGET_HEADER
+#define STXXL_STREAM_MEMORY_BUDGET_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <foxxll/common/exceptions.hpp>
+
+#include <stxxl/bits/common/memory_manager.h>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     MEMORY BUDGET                                                  //
+////////////////////////////////////////////////////////////////////////
+
+//! Shared budget which divides the internal memory of a pipeline among its
+//! stages, instead of a hand-tuned memory_to_use per stage.
+//!
+//! Each stage registers the minimum and the desired amount of memory with
+//! add_stage() when the pipeline is built, and calls acquire() when it
+//! starts, which fixes its share, and release() when it finishes. A stage
+//! which only starts after another one finished, like the runs merger after
+//! its runs creator, is registered with that stage as predecessor: both
+//! share one assignment, and the successor inherits the memory of its
+//! predecessor.
+//!
+//! On acquire(), the memory not held by running stages is divided among the
+//! stages which have not started yet: each gets its minimum, the rest is
+//! divided equally up to the desired amounts. Hence the memory released by
+//! a finished stage goes to the stages starting later. If the minimums
+//! exceed the budget, foxxll::bad_parameter is thrown.
+//!
+//! The methods may be called by stages running in different threads.
+class memory_budget
+{
+public:
+    using stage_id = size_t;
+
+    //! stage id for no predecessor
+    static constexpr stage_id no_stage = std::numeric_limits<size_t>::max();
+
+    //! desired amount of a stage using as much memory as it can get
+    static constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+
+private:
+    enum state_type { registered, running, finished };
+
+    struct stage_type
+    {
+        size_t min_memory;
+        size_t desired_memory;
+        stage_id predecessor;
+        stage_id successor;
+        state_type state;
+        //! memory held while running, or passed to the successor when
+        //! finished
+        size_t assigned;
+    };
+
+    //! total memory of the pipeline in bytes
+    size_t m_total;
+
+    //! reservation of the total at the memory_manager
+    memory_reservation m_reservation;
+
+    std::vector<stage_type> m_stages;
+
+    mutable std::mutex m_mutex;
+
+    //! Memory not held by running stages.
+    size_t free_memory() const
+    {
+        size_t held = 0;
+        for (const stage_type& s : m_stages)
+        {
+            if (s.state == running)
+                held += s.assigned;
+        }
+        return m_total - std::min(m_total, held);
+    }
+
+    //! Whether stage s is the next one of its chain to start.
+    bool is_pending(const stage_type& s) const
+    {
+        return s.state == registered
+               && (s.predecessor == no_stage
+                   || m_stages[s.predecessor].state == finished);
+    }
+
+    //! Share of the free memory the pending stage s gets: the free memory is
+    //! divided among the chains of the pending stages, each chain needing
+    //! the maximum of the amounts of its remaining stages.
+    size_t plan(stage_id s) const
+    {
+        std::vector<stage_id> heads;
+        std::vector<size_t> mins, desired;
+        for (stage_id i = 0; i < m_stages.size(); ++i)
+        {
+            if (!is_pending(m_stages[i]))
+                continue;
+
+            size_t min_memory = 0, desired_memory = 0;
+            for (stage_id j = i; j != no_stage; j = m_stages[j].successor)
+            {
+                min_memory = std::max(min_memory, m_stages[j].min_memory);
+                desired_memory = std::max(desired_memory, m_stages[j].desired_memory);
+            }
+            desired_memory = std::max(desired_memory, min_memory);
+            // the memory of a finished predecessor is inherited
+            if (m_stages[i].predecessor != no_stage)
+            {
+                min_memory = std::max(min_memory, std::min(
+                                          m_stages[m_stages[i].predecessor].assigned,
+                                          desired_memory));
+            }
+            heads.push_back(i);
+            mins.push_back(min_memory);
+            desired.push_back(desired_memory);
+        }
+
+        size_t free = free_memory(), sum_mins = 0;
+        for (size_t m : mins)
+            sum_mins += m;
+        if (sum_mins > free)
+            throw foxxll::bad_parameter(
+                      "stxxl::stream::memory_budget: INSUFFICIENT MEMORY for "
+                      "the minimum memory of the pipeline stages, please "
+                      "increase the budget");
+
+        // water-filling of the rest up to the desired amounts
+        std::vector<size_t> shares = mins;
+        size_t rest = free - sum_mins;
+        while (rest != 0)
+        {
+            size_t unsaturated = 0;
+            for (size_t k = 0; k < shares.size(); ++k)
+                unsaturated += (shares[k] < desired[k]);
+            if (unsaturated == 0)
+                break;
+
+            const size_t part = std::max<size_t>(rest / unsaturated, 1);
+            for (size_t k = 0; k < shares.size() && rest != 0; ++k)
+            {
+                const size_t add = std::min(
+                    std::min(part, rest), desired[k] - shares[k]);
+                shares[k] += add;
+                rest -= add;
+            }
+        }
+
+        const size_t k = std::find(heads.begin(), heads.end(), s) - heads.begin();
+        assert(k < heads.size());
+        const stage_type& st = m_stages[s];
+        return std::min(shares[k], std::max(st.desired_memory, mins[k]));
+    }
+
+public:
+    //! Create a budget of total bytes of internal memory, which are reserved
+    //! at the memory_manager.
+    explicit memory_budget(size_t total)
+        : m_total(total),
+          m_reservation("stream::memory_budget", total)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    memory_budget(const memory_budget&) = delete;
+    //! non-copyable: delete assignment operator
+    memory_budget& operator = (const memory_budget&) = delete;
+
+    //! Register a stage of the pipeline.
+    //! \param min_memory bytes the stage needs at least
+    //! \param desired_memory bytes beyond which the stage gains nothing
+    //! \param predecessor stage which finishes before this one starts, and
+    //! which has no other successor
+    //! \return id of the stage
+    stage_id add_stage(size_t min_memory, size_t desired_memory = unlimited,
+                       stage_id predecessor = no_stage)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const stage_id id = m_stages.size();
+        if (predecessor != no_stage)
+        {
+            assert(predecessor < id);
+            assert(m_stages[predecessor].successor == no_stage);
+            m_stages[predecessor].successor = id;
+        }
+        m_stages.push_back(stage_type {
+                               min_memory, desired_memory,
+                               predecessor, no_stage, registered, 0
+                           });
+        return id;
+    }
+
+    //! Update the desired amount of a stage which has not started yet, e.g.
+    //! once the number of runs to merge is known.
+    void set_desired(stage_id s, size_t desired_memory)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        assert(s < m_stages.size() && m_stages[s].state == registered);
+        m_stages[s].desired_memory = desired_memory;
+    }
+
+    //! Bytes a stage would get if it started now, or holds if it runs.
+    size_t planned(stage_id s) const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        assert(s < m_stages.size());
+        const stage_type& st = m_stages[s];
+        if (st.state == running)
+            return st.assigned;
+        if (!is_pending(st))
+            return 0;
+        return plan(s);
+    }
+
+    //! Start a stage, whose predecessor must have finished.
+    //! \return bytes of internal memory assigned to the stage
+    size_t acquire(stage_id s)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        assert(s < m_stages.size() && is_pending(m_stages[s]));
+        const size_t memory = plan(s);
+        stage_type& st = m_stages[s];
+        if (st.predecessor != no_stage)
+            m_stages[st.predecessor].assigned = 0;
+        st.assigned = memory;
+        st.state = running;
+        return memory;
+    }
+
+    //! Finish a stage and release its memory to its successor or the
+    //! stages starting later. A stage may also be released without having
+    //! started.
+    void release(stage_id s)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        assert(s < m_stages.size());
+        stage_type& st = m_stages[s];
+        if (st.state == finished)
+            return;
+        if (st.state == registered || st.successor == no_stage)
+            st.assigned = 0;
+        st.state = finished;
+    }
+
+    //! Total bytes of the budget.
+    size_t total() const
+    {
+        return m_total;
+    }
+
+    //! Bytes not held by running stages.
+    size_t available() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return free_memory();
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_MEMORY_BUDGET_HEADER
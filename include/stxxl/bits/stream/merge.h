@@ -0,0 +1,609 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/merge.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_MERGE_HEADER
+#define STXXL_STREAM_MERGE_HEADER
+
+#include <cassert>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <tlx/define.hpp>
+
+#include <stxxl/bits/algo/losertree.h>
+#include <stxxl/bits/common/winner_tree.h>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack Stream Package
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     MERGE                                                          //
+////////////////////////////////////////////////////////////////////////
+
+namespace merge_local {
+
+//! Hands the input streams of a merge to the cursors of the loser tree, one
+//! per pull_block() call.
+template <typename Input>
+struct stream_source
+{
+    Input* const* inputs;
+    size_t next;
+
+    explicit stream_source(Input* const* inputs_)
+        : inputs(inputs_), next(0) { }
+
+    Input* pull_block()
+    {
+        return inputs[next++];
+    }
+};
+
+//! Merge cursor reading from an input stream, usable with \c loser_tree like
+//! \c run_cursor2.
+template <typename Input>
+struct stream_cursor
+{
+    using prefetcher_type = stream_source<Input>;
+    using value_type = typename Input::value_type;
+
+    //! input stream, nullptr for cursors padding the loser tree
+    Input* buffer;
+
+    //! number of the input stream, which breaks ties
+    size_t input;
+
+private:
+    prefetcher_type* prefetcher_;
+
+public:
+    stream_cursor() : buffer(nullptr), input(0), prefetcher_(nullptr) { }
+
+    prefetcher_type* & prefetcher()
+    {
+        return prefetcher_;
+    }
+
+    bool empty() const
+    {
+        return (buffer == nullptr || buffer->empty());
+    }
+
+    auto current() const -> decltype(*std::declval<Input&>())
+    {
+        return **buffer;
+    }
+
+    void operator ++ ()
+    {
+        ++(*buffer);
+    }
+
+    void make_inf()
+    {
+        buffer = nullptr;
+    }
+};
+
+//! Pull the input stream of a stream cursor, recording its number.
+template <typename Input>
+inline void pull_first_block(stream_cursor<Input>& cursor, stream_source<Input>* p)
+{
+    cursor.input = p->next;
+    cursor.buffer = p->pull_block();
+}
+
+//! Comparator of stream_cursor objects, emulating sentinels for exhausted
+//! streams. Equal elements are ordered by the number of their input.
+template <typename CursorType, typename ValueCmp>
+struct stream_cursor_cmp
+{
+    using cursor_type = CursorType;
+    using value_cmp = ValueCmp;
+
+    value_cmp cmp;
+
+    explicit stream_cursor_cmp(value_cmp c) : cmp(c) { }
+
+    bool operator () (const cursor_type& a, const cursor_type& b) const
+    {
+        if (TLX_UNLIKELY(b.empty()))
+            return true;
+        if (TLX_UNLIKELY(a.empty()))
+            return false;
+
+        if (cmp(a.current(), b.current()))
+            return true;
+        return !cmp(b.current(), a.current()) && a.input < b.input;
+    }
+};
+
+} // namespace merge_local
+
+//! Merges k sorted input streams of the same type into one sorted stream,
+//! using a \c loser_tree like the runs merger. Elements comparing equal are
+//! delivered in the order of the inputs.
+//!
+//! The streams are read sequentially, so inputs created by
+//! streamify(vector.begin(), vector.end()) prefetch their blocks. The result
+//! can be consumed as stream or written with materialize().
+//!
+//! \tparam Input type of the input streams
+//! \tparam CompareType type of comparison object used to sort the inputs;
+//!         operator () (a, b) returns true if a < b
+template <class Input, class CompareType>
+class merge
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input::value_type;
+
+private:
+    using cursor_type = merge_local::stream_cursor<Input>;
+    using cursor_cmp_type = merge_local::stream_cursor_cmp<cursor_type, CompareType>;
+    using loser_tree_type = loser_tree<cursor_type, cursor_cmp_type>;
+
+    //! input streams
+    std::vector<Input*> m_inputs;
+
+    //! source handing the inputs to the loser tree
+    merge_local::stream_source<Input> m_source;
+
+    //! loser tree over the input streams
+    loser_tree_type m_losers;
+
+    //! current element
+    value_type m_current;
+
+    //! true if all inputs are exhausted
+    bool m_empty;
+
+    void fetch()
+    {
+        m_empty = m_losers.winner().empty();
+        if (!m_empty)
+            m_losers.multi_merge(&m_current, &m_current + 1);
+    }
+
+public:
+    //! Merge the streams in inputs, which are referenced, not copied.
+    merge(const std::vector<Input*>& inputs, CompareType cmp)
+        : m_inputs(inputs),
+          m_source(m_inputs.data()),
+          m_losers(&m_source, m_inputs.size(), cursor_cmp_type(cmp)),
+          m_empty(true)
+    {
+        fetch();
+    }
+
+    //! Merge the two streams a and b.
+    merge(Input& a, Input& b, CompareType cmp)
+        : merge(std::vector<Input*>({ &a, &b }), cmp)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    merge(const merge&) = delete;
+    //! non-copyable: delete assignment operator
+    merge& operator = (const merge&) = delete;
+
+    //! Standard stream method.
+    merge& operator ++ ()
+    {
+        assert(!m_empty);
+        fetch();
+        return *this;
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!m_empty);
+        return m_current;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &operator * ();
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_empty;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////
+//     MERGE_STREAMS                                                  //
+////////////////////////////////////////////////////////////////////////
+
+//! Merges a fixed number of sorted input streams of possibly different
+//! types into one sorted stream, without intermediate I/O. Elements
+//! comparing equal are delivered in the order of the inputs.
+//!
+//! The current element of each input is kept in a \c winner_tree. Advancing
+//! the winning input dispatches through a table of functions generated for
+//! the inputs, hence the inputs need not share a type, only their
+//! value_types must convert to the one of the first input. For k inputs of
+//! the same type given at runtime, use \c merge.
+//!
+//! \tparam CompareType type of comparison object used to sort the inputs;
+//!         operator () (a, b) returns true if a < b
+//! \tparam Inputs types of the input streams
+template <class CompareType, class... Inputs>
+class merge_streams
+{
+    static_assert(sizeof ... (Inputs) > 0, "merge_streams needs an input");
+
+public:
+    //! Standard stream typedef.
+    using value_type =
+        typename std::tuple_element<0, std::tuple<Inputs...> >::type::value_type;
+
+    //! number of input streams
+    static constexpr size_t num_inputs = sizeof ... (Inputs);
+
+private:
+    //! Compares the current elements of two inputs, the earlier input wins
+    //! ties.
+    struct player_cmp
+    {
+        const merge_streams& merge;
+
+        bool operator () (size_t a, size_t b) const
+        {
+            if (merge.m_cmp(merge.m_heads[a], merge.m_heads[b]))
+                return true;
+            return !merge.m_cmp(merge.m_heads[b], merge.m_heads[a]) && a < b;
+        }
+    };
+
+    using advance_function = bool (*)(merge_streams&);
+
+    //! input streams
+    std::tuple<Inputs& ...> m_inputs;
+
+    CompareType m_cmp;
+
+    //! current element of each input
+    value_type m_heads[num_inputs];
+
+    player_cmp m_player_cmp;
+
+    //! tournament tree over the inputs which are not exhausted
+    winner_tree<player_cmp> m_tree;
+
+    //! Load the current element of input I, false if it is exhausted.
+    template <size_t I>
+    static bool load_input(merge_streams& m)
+    {
+        auto& in = std::get<I>(m.m_inputs);
+        if (in.empty())
+            return false;
+        m.m_heads[I] = *in;
+        return true;
+    }
+
+    //! Advance input I and load its next element, false if it is exhausted.
+    template <size_t I>
+    static bool advance_input(merge_streams& m)
+    {
+        ++std::get<I>(m.m_inputs);
+        return load_input<I>(m);
+    }
+
+    template <size_t... I>
+    void initialize(std::index_sequence<I...>)
+    {
+        const bool loaded[] = { load_input<I>(*this) ... };
+        for (size_t i = 0; i < num_inputs; ++i)
+        {
+            if (loaded[i])
+                m_tree.activate_player(i);
+        }
+    }
+
+    template <size_t... I>
+    bool advance(size_t i, std::index_sequence<I...>)
+    {
+        static const advance_function table[] = { &advance_input<I>... };
+        return table[i](*this);
+    }
+
+public:
+    //! Merge the streams inputs, which are referenced, not copied.
+    explicit merge_streams(CompareType cmp, Inputs& ... inputs)
+        : m_inputs(inputs ...), m_cmp(cmp),
+          m_player_cmp { *this }, m_tree(num_inputs, m_player_cmp)
+    {
+        initialize(std::index_sequence_for<Inputs...>());
+    }
+
+    //! non-copyable: delete copy-constructor
+    merge_streams(const merge_streams&) = delete;
+    //! non-copyable: delete assignment operator
+    merge_streams& operator = (const merge_streams&) = delete;
+
+    //! Standard stream method.
+    merge_streams& operator ++ ()
+    {
+        assert(!empty());
+        const size_t i = m_tree.top();
+        if (advance(i, std::index_sequence_for<Inputs...>()))
+            m_tree.notify_change(i);
+        else
+            m_tree.deactivate_player(i);
+        return *this;
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return m_heads[m_tree.top()];
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &operator * ();
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_tree.empty();
+    }
+};
+
+////////////////////////////////////////////////////////////////////////
+//     SET_UNION                                                      //
+////////////////////////////////////////////////////////////////////////
+
+//! Union of k sorted input streams. Unlike std::set_union, each distinct
+//! element is delivered once, i.e. the union of the sets of elements of the
+//! inputs.
+//!
+//! \tparam Input type of the input streams
+//! \tparam CompareType type of comparison object used to sort the inputs
+template <class Input, class CompareType>
+class set_union
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input::value_type;
+
+private:
+    //! merge of the inputs
+    merge<Input, CompareType> m_merge;
+
+    //! comparator used to detect equal elements
+    CompareType m_cmp;
+
+    //! current element
+    value_type m_current;
+
+    //! true if all inputs are exhausted
+    bool m_empty;
+
+    void fetch()
+    {
+        m_empty = m_merge.empty();
+        if (m_empty)
+            return;
+
+        m_current = *m_merge;
+        // skip the elements equal to m_current
+        do {
+            ++m_merge;
+        } while (!m_merge.empty() && !m_cmp(m_current, *m_merge));
+    }
+
+public:
+    //! Union of the streams in inputs.
+    set_union(const std::vector<Input*>& inputs, CompareType cmp)
+        : m_merge(inputs, cmp), m_cmp(cmp), m_empty(true)
+    {
+        fetch();
+    }
+
+    //! Union of the two streams a and b.
+    set_union(Input& a, Input& b, CompareType cmp)
+        : m_merge(a, b, cmp), m_cmp(cmp), m_empty(true)
+    {
+        fetch();
+    }
+
+    //! Standard stream method.
+    set_union& operator ++ ()
+    {
+        assert(!m_empty);
+        fetch();
+        return *this;
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!m_empty);
+        return m_current;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &operator * ();
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_empty;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////
+//     SET_INTERSECTION                                               //
+////////////////////////////////////////////////////////////////////////
+
+//! Equivalent to std::set_intersection: delivers the elements of sorted
+//! stream A which are contained in sorted stream B, an element occurring m
+//! times in A and n times in B is delivered min(m, n) times. Useful for
+//! joining sorted edge lists.
+//!
+//! \tparam Input1 type of the first input stream
+//! \tparam Input2 type of the second input stream, its value_type must be
+//!         comparable with the one of Input1 using CompareType
+//! \tparam CompareType type of comparison object used to sort the inputs
+template <class Input1, class Input2, class CompareType>
+class set_intersection
+{
+    Input1& A;
+    Input2& B;
+    CompareType cmp;
+
+    void find_next()
+    {
+        while (!A.empty() && !B.empty())
+        {
+            if (cmp(*A, *B))
+                ++A;
+            else if (cmp(*B, *A))
+                ++B;
+            else
+                return;
+        }
+    }
+
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input1::value_type;
+
+    set_intersection(Input1& A_, Input2& B_, CompareType cmp_)
+        : A(A_), B(B_), cmp(cmp_)
+    {
+        find_next();
+    }
+
+    //! Standard stream method.
+    set_intersection& operator ++ ()
+    {
+        assert(!empty());
+        ++A;
+        ++B;
+        find_next();
+        return *this;
+    }
+
+    //! Standard stream method.
+    auto operator * () const -> decltype(*std::declval<Input1&>())
+    {
+        return *A;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(*A);
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return (A.empty() || B.empty());
+    }
+};
+
+////////////////////////////////////////////////////////////////////////
+//     SET_DIFFERENCE                                                 //
+////////////////////////////////////////////////////////////////////////
+
+//! Equivalent to std::set_difference: delivers the elements of sorted
+//! stream A which are not contained in sorted stream B, an element occurring
+//! m times in A and n times in B is delivered max(m - n, 0) times.
+//!
+//! \tparam Input1 type of the first input stream
+//! \tparam Input2 type of the second input stream, its value_type must be
+//!         comparable with the one of Input1 using CompareType
+//! \tparam CompareType type of comparison object used to sort the inputs
+template <class Input1, class Input2, class CompareType>
+class set_difference
+{
+    Input1& A;
+    Input2& B;
+    CompareType cmp;
+
+    void find_next()
+    {
+        while (!A.empty() && !B.empty())
+        {
+            if (cmp(*A, *B))
+                return;
+            else if (cmp(*B, *A))
+                ++B;
+            else
+            {
+                ++A;
+                ++B;
+            }
+        }
+    }
+
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input1::value_type;
+
+    set_difference(Input1& A_, Input2& B_, CompareType cmp_)
+        : A(A_), B(B_), cmp(cmp_)
+    {
+        find_next();
+    }
+
+    //! Standard stream method.
+    set_difference& operator ++ ()
+    {
+        assert(!empty());
+        ++A;
+        find_next();
+        return *this;
+    }
+
+    //! Standard stream method.
+    auto operator * () const -> decltype(*std::declval<Input1&>())
+    {
+        return *A;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(*A);
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return A.empty();
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_MERGE_HEADER
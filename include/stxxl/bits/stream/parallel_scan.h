@@ -0,0 +1,83 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/parallel_scan.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_PARALLEL_SCAN_HEADER
+#define STXXL_STREAM_PARALLEL_SCAN_HEADER
+
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     PARALLEL SCAN                                                  //
+////////////////////////////////////////////////////////////////////////
+
+//! Consumes streams in parallel, each on its own thread, and calls
+//! functor(part, value) for each value of the stream parts[part], in the
+//! order of that stream. The calls of different threads are concurrent.
+//! Returns after all streams are empty, and rethrows the first exception
+//! thrown by a stream or by the functor, after joining all threads.
+//! \param parts streams which may be consumed concurrently, e.g. the ones of
+//! sequence::get_partition_streams()
+//! \param functor called with the index of the stream and each of its values
+template <typename StreamAlgorithm, typename Functor>
+void parallel_scan(std::vector<StreamAlgorithm>& parts, Functor functor)
+{
+    if (parts.size() == 1)
+    {
+        for (StreamAlgorithm& in = parts[0]; !in.empty(); ++in)
+            functor(size_t(0), *in);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(parts.size());
+    std::vector<std::thread> threads;
+    threads.reserve(parts.size());
+
+    for (size_t p = 0; p < parts.size(); ++p)
+    {
+        threads.emplace_back(
+            [&parts, &errors, &functor, p]() {
+                try
+                {
+                    for (StreamAlgorithm& in = parts[p]; !in.empty(); ++in)
+                        functor(p, *in);
+                }
+                catch (...)
+                {
+                    errors[p] = std::current_exception();
+                }
+            });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (std::exception_ptr& error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_PARALLEL_SCAN_HEADER
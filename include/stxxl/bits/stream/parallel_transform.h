@@ -0,0 +1,575 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/parallel_transform.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_PARALLEL_TRANSFORM_HEADER
+#define STXXL_STREAM_PARALLEL_TRANSFORM_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tlx/define.hpp>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     PARALLEL TRANSFORM                                             //
+////////////////////////////////////////////////////////////////////////
+
+//! Stream which applies a functor to each value of its input stream, like
+//! \c transform, using a pool of worker threads.
+//!
+//! The workers take turns reading batches of values from the input, apply
+//! the functor to their batch concurrently and place the results in a ring of
+//! batches, from which they are emitted in the order of the input. The ring
+//! holds 2 * num_threads batches, a worker waits for a free batch if the
+//! consumer falls behind.
+//!
+//! The functor is called as op(value) and returns Operation::value_type. It
+//! is called concurrently by several threads and must be safe for that. The
+//! input stream is only accessed by one thread at a time. An exception
+//! thrown by the input or the functor is rethrown by the consumer's stream
+//! method after the results of all values before it, and ends the stream.
+template <typename Operation, typename Input>
+class parallel_transform
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Operation::value_type;
+    using input_value_type = typename Input::value_type;
+
+private:
+    //! a batch of input values and their results
+    struct batch
+    {
+        std::vector<input_value_type> in;
+        std::vector<value_type> out;
+        //! exception thrown while reading or transforming the batch
+        std::exception_ptr error;
+        //! true if out holds the results and the batch is ready for the consumer
+        bool done = false;
+    };
+
+    static constexpr size_t no_end = std::numeric_limits<size_t>::max();
+
+    Operation& m_op;
+    Input& m_input;
+    size_t m_batch_size;
+
+    //! ring of batches, batch number i is kept at m_batches[i % size]
+    std::vector<batch> m_batches;
+
+    //! serializes reading from the input
+    std::mutex m_input_mutex;
+
+    //! guards the following counters and the done flags
+    std::mutex m_mutex;
+    //! signaled when a batch is done or the input ends
+    std::condition_variable m_cv_done;
+    //! signaled when the consumer releases a batch or the workers shall stop
+    std::condition_variable m_cv_free;
+
+    //! number of the next batch to read from the input
+    size_t m_next_batch;
+    //! number of the batch read by the consumer
+    size_t m_head;
+    //! number of batches, known after the input is exhausted
+    size_t m_end;
+    //! true if the workers shall stop, set by the destructor
+    bool m_stop;
+
+    //! batch read by the consumer and the position in it
+    batch* m_current;
+    size_t m_pos;
+
+    std::vector<std::thread> m_threads;
+
+    //! Read and transform batches until the input ends or stop() is called.
+    void work()
+    {
+        for ( ; ; )
+        {
+            batch* b;
+            {
+                std::unique_lock<std::mutex> input_lock(m_input_mutex);
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_cv_free.wait(lock, [this]() {
+                                       return m_stop || m_next_batch >= m_end ||
+                                       m_next_batch < m_head + m_batches.size();
+                                   });
+                    if (m_stop || m_next_batch >= m_end)
+                        return;
+                }
+
+                b = &m_batches[m_next_batch % m_batches.size()];
+                b->in.clear();
+                b->error = nullptr;
+                try
+                {
+                    for ( ; b->in.size() < m_batch_size && !m_input.empty(); ++m_input)
+                        b->in.push_back(*m_input);
+                }
+                catch (...)
+                {
+                    b->error = std::current_exception();
+                }
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (b->in.empty() && !b->error)
+                {
+                    // input exhausted
+                    m_end = m_next_batch;
+                    lock.unlock();
+                    m_cv_done.notify_all();
+                    m_cv_free.notify_all();
+                    return;
+                }
+                if (b->error)
+                    m_end = m_next_batch + 1;
+                ++m_next_batch;
+            }
+
+            // transform the values read, also before an error of the input
+            size_t i = 0;
+            try
+            {
+                b->out.resize(b->in.size());
+                for ( ; i < b->in.size(); ++i)
+                    b->out[i] = m_op(b->in[i]);
+            }
+            catch (...)
+            {
+                b->out.resize(i);
+                if (!b->error)
+                    b->error = std::current_exception();
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                b->done = true;
+            }
+            m_cv_done.notify_all();
+        }
+    }
+
+    //! Wait for the batch m_head and make it the current one. The error of a
+    //! batch without values is rethrown, or deferred to the next call of
+    //! next_batch().
+    void fetch_batch(bool defer_error = false)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv_done.wait(lock, [this]() {
+                           return m_head >= m_end ||
+                           m_batches[m_head % m_batches.size()].done;
+                       });
+        if (m_head >= m_end)
+        {
+            m_current = nullptr;
+            return;
+        }
+
+        m_current = &m_batches[m_head % m_batches.size()];
+        m_pos = 0;
+        if (TLX_UNLIKELY(m_current->error && m_current->out.empty() && !defer_error))
+            rethrow_error();
+    }
+
+    //! Release the current batch to the workers and fetch the next one.
+    void release_batch(bool defer_error)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_current->done = false;
+            ++m_head;
+        }
+        m_cv_free.notify_all();
+        fetch_batch(defer_error);
+    }
+
+    //! Rethrow the error of the current batch, after its values.
+    void rethrow_error()
+    {
+        std::exception_ptr error = m_current->error;
+        m_current = nullptr;
+        std::rethrow_exception(error);
+    }
+
+    //! Stop and join the workers.
+    void stop()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv_free.notify_all();
+        for (std::thread& thread : m_threads)
+            thread.join();
+        m_threads.clear();
+    }
+
+public:
+    //! Construct the stream and start its workers.
+    //! \param op functor applied to each value, called concurrently
+    //! \param input input stream
+    //! \param num_threads number of worker threads, 0 for the number of cores
+    //! \param batch_size number of values each worker reads from the input at once
+    parallel_transform(Operation& op, Input& input, size_t num_threads = 0,
+                       size_t batch_size = 4096)
+        : m_op(op), m_input(input),
+          m_batch_size(std::max<size_t>(batch_size, 1)),
+          m_next_batch(0), m_head(0), m_end(no_end), m_stop(false),
+          m_current(nullptr), m_pos(0)
+    {
+        if (num_threads == 0)
+            num_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        m_batches.resize(2 * num_threads);
+
+        m_threads.reserve(num_threads);
+        for (size_t t = 0; t < num_threads; ++t)
+            m_threads.emplace_back([this]() { work(); });
+
+        try
+        {
+            fetch_batch();
+        }
+        catch (...)
+        {
+            stop();
+            throw;
+        }
+    }
+
+    //! non-copyable: delete copy-constructor
+    parallel_transform(const parallel_transform&) = delete;
+    //! non-copyable: delete assignment operator
+    parallel_transform& operator = (const parallel_transform&) = delete;
+
+    //! Stops the workers, the remaining input is not read.
+    ~parallel_transform()
+    {
+        stop();
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return m_current->out[m_pos];
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    parallel_transform& operator ++ ()
+    {
+        assert(!empty());
+        if (++m_pos < m_current->out.size())
+            return *this;
+        if (TLX_UNLIKELY(m_current->error))
+            rethrow_error();
+
+        release_batch(false);
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_current == nullptr;
+    }
+
+    //! Batch stream method: copies values of the current batch. An exception
+    //! is rethrown by the call after the one which returned the values before
+    //! it.
+    size_t next_batch(value_type* out, size_t n)
+    {
+        if (empty())
+            return 0;
+        if (TLX_UNLIKELY(m_pos == m_current->out.size()))
+            rethrow_error();
+
+        n = std::min(n, m_current->out.size() - m_pos);
+        std::copy(m_current->out.begin() + m_pos, m_current->out.begin() + m_pos + n, out);
+        if ((m_pos += n) == m_current->out.size() && !m_current->error)
+            release_batch(true);
+        return n;
+    }
+
+    //! Batch stream method.
+    size_t batch_size() const
+    {
+        return m_batch_size;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////
+//     ASYNC BUFFER                                                   //
+////////////////////////////////////////////////////////////////////////
+
+//! Stream which reads its input stream in a separate thread, ahead of the
+//! consumer, and decouples the producing pipeline stages from the consuming
+//! ones. The values are passed in a ring of num_batches batches, the thread
+//! waits for a free batch if the consumer falls behind. An exception thrown
+//! by the input is rethrown by the consumer's stream method after all values
+//! before it, and ends the stream.
+template <typename Input>
+class async_buffer
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input::value_type;
+
+private:
+    //! a batch of values read from the input
+    struct batch
+    {
+        std::vector<value_type> values;
+        //! exception thrown while reading the batch
+        std::exception_ptr error;
+        //! true if the batch is ready for the consumer
+        bool done = false;
+    };
+
+    static constexpr size_t no_end = std::numeric_limits<size_t>::max();
+
+    Input& m_input;
+    size_t m_batch_size;
+
+    //! ring of batches, batch number i is kept at m_batches[i % size]
+    std::vector<batch> m_batches;
+
+    //! guards the following counters and the done flags
+    std::mutex m_mutex;
+    //! signaled when a batch is done or the input ends
+    std::condition_variable m_cv_done;
+    //! signaled when the consumer releases a batch or the reader shall stop
+    std::condition_variable m_cv_free;
+
+    //! number of the batch read by the consumer
+    size_t m_head;
+    //! number of batches, known after the input is exhausted
+    size_t m_end;
+    //! true if the reader shall stop, set by the destructor
+    bool m_stop;
+
+    //! batch read by the consumer and the position in it
+    batch* m_current;
+    size_t m_pos;
+
+    std::thread m_thread;
+
+    //! Read batches until the input ends or the destructor is called.
+    void work()
+    {
+        for (size_t next = 0; ; ++next)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv_free.wait(lock, [this, next]() {
+                                   return m_stop || next < m_head + m_batches.size();
+                               });
+                if (m_stop)
+                    return;
+            }
+
+            batch& b = m_batches[next % m_batches.size()];
+            b.values.clear();
+            b.error = nullptr;
+            try
+            {
+                for ( ; b.values.size() < m_batch_size && !m_input.empty(); ++m_input)
+                    b.values.push_back(*m_input);
+            }
+            catch (...)
+            {
+                b.error = std::current_exception();
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (b.values.empty() && !b.error)
+                    m_end = next;
+                else
+                    b.done = true;
+            }
+            m_cv_done.notify_all();
+            if (m_end != no_end || b.error)
+                return;
+        }
+    }
+
+    //! Wait for the batch m_head and make it the current one. The error of a
+    //! batch without values is rethrown, or deferred to the next call of
+    //! next_batch().
+    void fetch_batch(bool defer_error = false)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv_done.wait(lock, [this]() {
+                           return m_head >= m_end ||
+                           m_batches[m_head % m_batches.size()].done;
+                       });
+        if (m_head >= m_end)
+        {
+            m_current = nullptr;
+            return;
+        }
+
+        m_current = &m_batches[m_head % m_batches.size()];
+        m_pos = 0;
+        if (TLX_UNLIKELY(m_current->error && m_current->values.empty() && !defer_error))
+            rethrow_error();
+    }
+
+    //! Release the current batch to the workers and fetch the next one.
+    void release_batch(bool defer_error)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_current->done = false;
+            ++m_head;
+        }
+        m_cv_free.notify_all();
+        fetch_batch(defer_error);
+    }
+
+    //! Rethrow the error of the current batch, after its values.
+    void rethrow_error()
+    {
+        std::exception_ptr error = m_current->error;
+        m_current = nullptr;
+        std::rethrow_exception(error);
+    }
+
+    //! Stop and join the reader.
+    void stop()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv_free.notify_all();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+public:
+    //! Construct the stream and start reading the input.
+    //! \param input input stream
+    //! \param batch_size number of values passed to the consumer at once
+    //! \param num_batches number of batches in the ring, at least 2
+    explicit async_buffer(Input& input, size_t batch_size = 4096,
+                          size_t num_batches = 4)
+        : m_input(input),
+          m_batch_size(std::max<size_t>(batch_size, 1)),
+          m_batches(std::max<size_t>(num_batches, 2)),
+          m_head(0), m_end(no_end), m_stop(false),
+          m_current(nullptr), m_pos(0),
+          m_thread([this]() { work(); })
+    {
+        try
+        {
+            fetch_batch();
+        }
+        catch (...)
+        {
+            stop();
+            throw;
+        }
+    }
+
+    //! non-copyable: delete copy-constructor
+    async_buffer(const async_buffer&) = delete;
+    //! non-copyable: delete assignment operator
+    async_buffer& operator = (const async_buffer&) = delete;
+
+    //! Stops the reader, the remaining input is not read.
+    ~async_buffer()
+    {
+        stop();
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return m_current->values[m_pos];
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    async_buffer& operator ++ ()
+    {
+        assert(!empty());
+        if (++m_pos < m_current->values.size())
+            return *this;
+        if (TLX_UNLIKELY(m_current->error))
+            rethrow_error();
+
+        release_batch(false);
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_current == nullptr;
+    }
+
+    //! Batch stream method: copies values of the current batch. An exception
+    //! is rethrown by the call after the one which returned the values before
+    //! it.
+    size_t next_batch(value_type* out, size_t n)
+    {
+        if (empty())
+            return 0;
+        if (TLX_UNLIKELY(m_pos == m_current->values.size()))
+            rethrow_error();
+
+        n = std::min(n, m_current->values.size() - m_pos);
+        std::copy(m_current->values.begin() + m_pos, m_current->values.begin() + m_pos + n, out);
+        if ((m_pos += n) == m_current->values.size() && !m_current->error)
+            release_batch(true);
+        return n;
+    }
+
+    //! Batch stream method.
+    size_t batch_size() const
+    {
+        return m_batch_size;
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_PARALLEL_TRANSFORM_HEADER
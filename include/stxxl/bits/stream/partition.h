@@ -0,0 +1,283 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/partition.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_PARTITION_HEADER
+#define STXXL_STREAM_PARTITION_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/buf_istream.hpp>
+#include <foxxll/mng/buf_writer.hpp>
+#include <foxxll/mng/config.hpp>
+#include <foxxll/mng/typed_block.hpp>
+
+#include <stxxl/bits/defines.h>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     PARTITION                                                      //
+////////////////////////////////////////////////////////////////////////
+
+//! Distribution stage which routes each value of its input stream to one of
+//! num_partitions partitions on disk, e.g. for a hash-partitioned sort.
+//!
+//! The constructor reads the whole input. Each partition collects its values
+//! in one block, full blocks are written by a shared foxxll::buffered_writer
+//! with the remaining memory as write buffers, which batches and overlaps
+//! the writes. The blocks are allocated in the order they are written, such
+//! that consecutive writes are striped over the disks. Afterwards, output(i)
+//! returns a stream of the values of partition i in the order of the input,
+//! which may be plugged into a sorter or materialized. The partition object
+//! must outlive its output streams.
+//!
+//! The router is called as router(value) and returns the partition index
+//! of the value, which must be less than num_partitions.
+//!
+//! \tparam Input input stream
+//! \tparam RouterType function object mapping values to partition indexes
+//! \tparam BlockSize block size of the partitions
+//! \tparam AllocStr allocation strategy of the blocks
+template <class Input, class RouterType,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(typename Input::value_type),
+          class AllocStr = foxxll::default_alloc_strategy>
+class partition
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input::value_type;
+    using router_type = RouterType;
+    using block_type = foxxll::typed_block<BlockSize, value_type>;
+    using bid_type = typename block_type::bid_type;
+
+private:
+    using writer_type = foxxll::buffered_writer<block_type>;
+    using bids_iterator = typename std::vector<bid_type>::const_iterator;
+
+    //! values routed to one partition
+    struct bucket_type
+    {
+        //! blocks holding the values, only the last one may be partial
+        std::vector<bid_type> bids;
+        //! block receiving the next values during distribution
+        block_type* block = nullptr;
+        //! number of values in block
+        size_t fill = 0;
+        //! number of values of the partition
+        uint64_t size = 0;
+    };
+
+public:
+    //! Stream of the values of one partition.
+    class output_type
+    {
+    public:
+        //! Standard stream typedef.
+        using value_type = typename Input::value_type;
+
+    private:
+        using buf_istream_type = foxxll::buf_istream<block_type, bids_iterator>;
+
+        //! buffered reader of the blocks
+        std::unique_ptr<buf_istream_type> m_in;
+
+        //! number of values not yet read
+        uint64_t m_remaining;
+
+    public:
+        output_type(const bucket_type& bucket, size_t nbuffers)
+            : m_remaining(bucket.size)
+        {
+            if (m_remaining != 0)
+                m_in.reset(new buf_istream_type(
+                               bucket.bids.begin(), bucket.bids.end(), nbuffers));
+        }
+
+        //! Standard stream method.
+        const value_type& operator * () const
+        {
+            assert(!empty());
+            return **m_in;
+        }
+
+        //! Standard stream method.
+        const value_type* operator -> () const
+        {
+            return &(operator * ());
+        }
+
+        //! Standard stream method.
+        output_type& operator ++ ()
+        {
+            assert(!empty());
+            ++(*m_in);
+            if (--m_remaining == 0)
+                m_in.reset();
+            return *this;
+        }
+
+        //! Standard stream method.
+        bool empty() const
+        {
+            return m_remaining == 0;
+        }
+
+        //! Number of values not yet read.
+        uint64_t size() const
+        {
+            return m_remaining;
+        }
+    };
+
+private:
+    //! the partitions
+    std::vector<bucket_type> m_buckets;
+
+    //! number of values of all partitions
+    uint64_t m_size;
+
+    //! number of blocks allocated, the striping offset of the next one
+    size_t m_nblocks;
+
+    //! Write the block of a bucket to a newly allocated block.
+    void write_block(bucket_type& b, writer_type& writer)
+    {
+        b.bids.emplace_back();
+        foxxll::block_manager::get_instance()->new_block(
+            AllocStr(), b.bids.back(), m_nblocks++);
+        b.block = writer.write(b.block, b.bids.back());
+        b.fill = 0;
+    }
+
+    //! Route the values of the input to the buckets.
+    void distribute(Input& input, const router_type& router,
+                    size_t nwrite_buffers)
+    {
+        writer_type writer(m_buckets.size() + nwrite_buffers, nwrite_buffers);
+
+        for (bucket_type& b : m_buckets)
+            b.block = writer.get_free_block();
+
+        for ( ; !input.empty(); ++input)
+        {
+            const value_type& v = *input;
+            const size_t i = router(v);
+            assert(i < m_buckets.size());
+
+            bucket_type& b = m_buckets[i];
+            b.block->elem[b.fill] = v;
+            ++b.size;
+            if (++b.fill == block_type::size)
+                write_block(b, writer);
+        }
+
+        for (bucket_type& b : m_buckets)
+        {
+            if (b.fill != 0)
+                write_block(b, writer);
+            // the blocks belong to the writer
+            b.block = nullptr;
+            m_size += b.size;
+        }
+        writer.flush();
+    }
+
+public:
+    //! Construct the partitions and distribute the input.
+    //! \param input input stream, which is read completely
+    //! \param router function object returning the partition of a value
+    //! \param num_partitions number of partitions
+    //! \param memory_to_use bytes of internal memory for the blocks of the
+    //! partitions and the write buffers
+    partition(Input& input, const router_type& router,
+              size_t num_partitions, size_t memory_to_use)
+        : m_buckets(num_partitions), m_size(0), m_nblocks(0)
+    {
+        assert(num_partitions > 0);
+        const size_t nblocks = memory_to_use / BlockSize;
+        const size_t nwrite_buffers = std::max<size_t>(
+            nblocks > num_partitions ? nblocks - num_partitions : 0,
+            2 * foxxll::config::get_instance()->disks_number());
+
+        distribute(input, router, nwrite_buffers);
+    }
+
+    //! non-copyable: delete copy-constructor
+    partition(const partition&) = delete;
+    //! non-copyable: delete assignment operator
+    partition& operator = (const partition&) = delete;
+
+    //! Release the blocks of all partitions.
+    ~partition()
+    {
+        for (size_t i = 0; i < m_buckets.size(); ++i)
+            release(i);
+    }
+
+    //! Number of partitions.
+    size_t num_partitions() const
+    {
+        return m_buckets.size();
+    }
+
+    //! Number of values of all partitions.
+    uint64_t size() const
+    {
+        return m_size;
+    }
+
+    //! Number of values of partition i.
+    uint64_t size(size_t i) const
+    {
+        assert(i < m_buckets.size());
+        return m_buckets[i].size;
+    }
+
+    //! Stream of the values of partition i, in the order of the input.
+    //! \param i partition index
+    //! \param nbuffers number of blocks used for overlapped reading (0 is
+    //! default, which equals to (2 * number_of_disks)
+    output_type output(size_t i, size_t nbuffers = 0) const
+    {
+        assert(i < m_buckets.size());
+        if (nbuffers == 0)
+            nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+        return output_type(m_buckets[i], nbuffers);
+    }
+
+    //! Release the blocks of partition i, which must not be read afterwards.
+    void release(size_t i)
+    {
+        assert(i < m_buckets.size());
+        bucket_type& b = m_buckets[i];
+        foxxll::block_manager::get_instance()->delete_blocks(b.bids.begin(), b.bids.end());
+        m_size -= b.size;
+        std::vector<bid_type>().swap(b.bids);
+        b.size = 0;
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_PARTITION_HEADER
@@ -0,0 +1,452 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/run_codec.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_RUN_CODEC_HEADER
+#define STXXL_STREAM_RUN_CODEC_HEADER
+
+#include <cassert>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <tlx/define.hpp>
+
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/buf_writer.hpp>
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/bits/algo/trigger_entry.h>
+#include <stxxl/bits/common/binary_buffer.h>
+
+namespace stxxl {
+namespace stream {
+
+//! \addtogroup streampack Stream Package
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     RUN CODECS                                                     //
+////////////////////////////////////////////////////////////////////////
+
+//! Default run codec of the runs creators: runs are stored as plain
+//! typed_blocks.
+struct no_run_codec { };
+
+//! Run codec storing each element of a sorted run as varint of the
+//! difference to its predecessor. The value type must be an unsigned integer,
+//! runs sorted in ascending order compress best.
+//!
+//! A run codec provides max_encoded_size, the largest number of bytes
+//! encode() appends for one element, and encode()/decode() of an element
+//! relative to its predecessor, which is value_type() for the first element
+//! of each block.
+template <typename ValueType>
+struct delta_varint_codec
+{
+    static_assert(std::is_integral<ValueType>::value && std::is_unsigned<ValueType>::value,
+                  "delta_varint_codec requires an unsigned integer value type");
+
+    using value_type = ValueType;
+
+    static constexpr size_t max_encoded_size = 10;
+
+    static void encode(binary_buffer& bb, const value_type& prev, const value_type& v)
+    {
+        bb.put_varint(static_cast<uint64_t>(static_cast<value_type>(v - prev)));
+    }
+
+    static value_type decode(binary_reader& br, const value_type& prev)
+    {
+        return static_cast<value_type>(prev + br.get_varint64());
+    }
+};
+
+//! Number of write buffers a runs creator keeps for encoding runs.
+inline size_t run_codec_write_buffers(no_run_codec)
+{
+    return 0;
+}
+
+//! Number of write buffers a runs creator keeps for encoding runs.
+template <typename Codec>
+size_t run_codec_write_buffers(Codec)
+{
+    return 2 * foxxll::config::get_instance()->disks_number();
+}
+
+//! Layout of a compressed block: the number of elements as uint32_t,
+//! followed by the encoded elements. The trigger entry of the block carries
+//! the first element uncompressed.
+template <typename BlockType>
+struct compressed_block_layout
+{
+    using value_type = typename BlockType::value_type;
+
+    //! bytes available for encoded elements
+    static constexpr size_t payload =
+        BlockType::size * sizeof(value_type) - sizeof(uint32_t);
+
+    static char * data(BlockType* block)
+    {
+        return reinterpret_cast<char*>(block->elem);
+    }
+
+    static const char * data(const BlockType* block)
+    {
+        return reinterpret_cast<const char*>(block->elem);
+    }
+};
+
+//! Writes sorted sequences of elements into runs of plain blocks, element by
+//! element. The last block of each run is filled with cmp.max_value().
+template <typename BlockType, typename CompareType, typename AllocStr>
+class plain_run_writer
+{
+public:
+    using block_type = BlockType;
+    using value_type = typename block_type::value_type;
+    using trigger_entry_type = sort_helper::trigger_entry<block_type>;
+    using run_type = std::vector<trigger_entry_type>;
+
+private:
+    //! comparator object providing the padding value
+    CompareType m_cmp;
+
+    //! writer transporting the blocks to disk
+    foxxll::buffered_writer<block_type> m_writer;
+
+    //! block receiving the next elements
+    block_type* m_block;
+
+    //! run receiving the trigger entries
+    run_type* m_run;
+
+    //! number of elements in m_block
+    size_t m_offset;
+
+    void flush_block()
+    {
+        trigger_entry_type& trigger = m_run->back();
+        foxxll::block_manager::get_instance()->new_block(
+            AllocStr(), trigger.bid, m_run->size() - 1);
+        m_block = m_writer.write(m_block, trigger.bid);
+        m_offset = 0;
+    }
+
+public:
+    //! Create a writer using nwrite_buffers block buffers.
+    plain_run_writer(size_t nwrite_buffers, CompareType cmp)
+        : m_cmp(cmp),
+          m_writer(nwrite_buffers, nwrite_buffers / 2),
+          m_block(m_writer.get_free_block()),
+          m_run(nullptr),
+          m_offset(0)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    plain_run_writer(const plain_run_writer&) = delete;
+    //! non-copyable: delete assignment operator
+    plain_run_writer& operator = (const plain_run_writer&) = delete;
+
+    //! Start a new run, its trigger entries replace the contents of run.
+    void begin_run(run_type& run)
+    {
+        assert(m_run == nullptr);
+        run.clear();
+        m_run = &run;
+    }
+
+    //! Append the next element of the run, elements must be sorted.
+    void push(const value_type& v)
+    {
+        if (m_offset == 0)
+        {
+            m_run->push_back(trigger_entry_type());
+            m_run->back().value = v;
+        }
+
+        (*m_block)[m_offset] = v;
+
+        if (++m_offset == block_type::size)
+            flush_block();
+    }
+
+    //! Finish the current run, its last block is padded and written.
+    void end_run()
+    {
+        if (m_offset != 0)
+        {
+            for ( ; m_offset != block_type::size; ++m_offset)
+                (*m_block)[m_offset] = m_cmp.max_value();
+            flush_block();
+        }
+        m_run = nullptr;
+    }
+
+    //! Wait until all written blocks are on disk.
+    void flush()
+    {
+        m_writer.flush();
+    }
+};
+
+//! Encodes sorted sequences of elements into compressed runs.
+template <typename BlockType, typename Codec, typename AllocStr>
+class compressed_run_writer
+{
+public:
+    using block_type = BlockType;
+    using value_type = typename block_type::value_type;
+    using trigger_entry_type = sort_helper::trigger_entry<block_type>;
+    using run_type = std::vector<trigger_entry_type>;
+    using layout = compressed_block_layout<block_type>;
+
+private:
+    //! writer transporting the encoded blocks to disk
+    foxxll::buffered_writer<block_type> m_writer;
+
+    //! block receiving the next encoded elements
+    block_type* m_block;
+
+    //! encoded elements of m_block
+    binary_buffer m_buffer;
+
+    //! run receiving the trigger entries
+    run_type* m_run;
+
+    //! number of elements encoded in m_buffer
+    uint32_t m_count;
+
+    //! last element encoded
+    value_type m_prev;
+
+    void flush_block()
+    {
+        if (m_count == 0)
+            return;
+
+        char* data = layout::data(m_block);
+        memcpy(data, &m_count, sizeof(m_count));
+        memcpy(data + sizeof(m_count), m_buffer.data(), m_buffer.size());
+
+        trigger_entry_type& trigger = m_run->back();
+        foxxll::block_manager::get_instance()->new_block(
+            AllocStr(), trigger.bid, m_run->size() - 1);
+        m_block = m_writer.write(m_block, trigger.bid);
+
+        m_buffer.clear();
+        m_count = 0;
+    }
+
+public:
+    //! Create a writer using nwrite_buffers block buffers.
+    explicit compressed_run_writer(size_t nwrite_buffers)
+        : m_writer(nwrite_buffers, nwrite_buffers / 2),
+          m_block(m_writer.get_free_block()),
+          m_run(nullptr),
+          m_count(0)
+    { }
+
+    //! non-copyable: delete copy-constructor
+    compressed_run_writer(const compressed_run_writer&) = delete;
+    //! non-copyable: delete assignment operator
+    compressed_run_writer& operator = (const compressed_run_writer&) = delete;
+
+    //! Start a new run, its trigger entries replace the contents of run.
+    void begin_run(run_type& run)
+    {
+        assert(m_run == nullptr);
+        run.clear();
+        m_run = &run;
+    }
+
+    //! Append the next element of the run, elements must be sorted.
+    void push(const value_type& v)
+    {
+        static_assert(layout::payload >= Codec::max_encoded_size,
+                      "block too small for the run codec");
+
+        if (m_count == 0)
+        {
+            m_run->push_back(trigger_entry_type());
+            m_run->back().value = v;
+            m_prev = value_type();
+        }
+
+        Codec::encode(m_buffer, m_prev, v);
+        m_prev = v;
+        ++m_count;
+
+        if (m_buffer.size() + Codec::max_encoded_size > layout::payload)
+            flush_block();
+    }
+
+    //! Finish the current run, its last block is written.
+    void end_run()
+    {
+        flush_block();
+        m_run = nullptr;
+    }
+
+    //! Encode the sorted sequence [begin,end) as run.
+    template <typename Iterator>
+    void write_run(Iterator begin, Iterator end, run_type& run)
+    {
+        begin_run(run);
+        for ( ; begin != end; ++begin)
+            push(*begin);
+        end_run();
+    }
+
+    //! Wait until all written blocks are on disk.
+    void flush()
+    {
+        m_writer.flush();
+    }
+};
+
+//! Merge cursor decoding the compressed blocks delivered by a prefetcher,
+//! usable with \c loser_tree like \c run_cursor2.
+template <typename BlockType, typename PrefetcherType, typename Codec>
+struct compressed_run_cursor
+{
+    using block_type = BlockType;
+    using prefetcher_type = PrefetcherType;
+    using value_type = typename block_type::value_type;
+    using layout = compressed_block_layout<block_type>;
+
+    //! compressed block currently decoded
+    block_type* buffer;
+
+private:
+    prefetcher_type* prefetcher_;
+
+    //! true once the header and first element of buffer are decoded
+    mutable bool m_loaded;
+
+    //! elements of buffer not yet consumed, including the current one
+    mutable size_t m_remaining;
+
+    //! read cursor into the encoded elements of buffer
+    mutable binary_reader m_reader;
+
+    //! current element
+    mutable value_type m_value;
+
+    void load() const
+    {
+        if (TLX_LIKELY(m_loaded))
+            return;
+
+        const char* data = layout::data(buffer);
+        uint32_t count;
+        memcpy(&count, data, sizeof(count));
+        assert(count > 0);
+
+        m_reader = binary_reader(data + sizeof(count), layout::payload);
+        m_remaining = count;
+        m_value = Codec::decode(m_reader, value_type());
+        m_loaded = true;
+    }
+
+public:
+    explicit compressed_run_cursor(prefetcher_type* p = nullptr)
+        : buffer(nullptr), prefetcher_(p),
+          m_loaded(false), m_remaining(0), m_reader(nullptr, 0)
+    { }
+
+    prefetcher_type* & prefetcher()
+    {
+        return prefetcher_;
+    }
+
+    bool empty() const
+    {
+        load();
+        return (m_remaining == 0);
+    }
+
+    const value_type & current() const
+    {
+        load();
+        return m_value;
+    }
+
+    void operator ++ ()
+    {
+        load();
+        assert(m_remaining > 0);
+        if (TLX_UNLIKELY(--m_remaining == 0))
+        {
+            // decode the next block on demand
+            if (prefetcher_->block_consumed(buffer))
+                m_loaded = false;
+            return;
+        }
+        m_value = Codec::decode(m_reader, m_value);
+    }
+
+    void make_inf()
+    {
+        m_loaded = true;
+        m_remaining = 0;
+    }
+};
+
+//! Comparator of compressed_run_cursor objects, emulating sentinels for
+//! exhausted cursors.
+template <typename CursorType, typename ValueCmp>
+struct compressed_run_cursor_cmp
+{
+    using cursor_type = CursorType;
+    using value_cmp = ValueCmp;
+
+    value_cmp cmp;
+
+    explicit compressed_run_cursor_cmp(value_cmp c) : cmp(c) { }
+
+    bool operator () (const cursor_type& a, const cursor_type& b) const
+    {
+        if (TLX_UNLIKELY(b.empty()))
+            return true;
+        if (TLX_UNLIKELY(a.empty()))
+            return false;
+
+        return cmp(a.current(), b.current());
+    }
+};
+
+//! Decode a compressed block, appending its elements to out.
+template <typename Codec, typename BlockType>
+void decode_compressed_block(const BlockType& block,
+                             std::vector<typename BlockType::value_type>& out)
+{
+    using layout = compressed_block_layout<BlockType>;
+    using value_type = typename BlockType::value_type;
+
+    const char* data = layout::data(&block);
+    uint32_t count;
+    memcpy(&count, data, sizeof(count));
+
+    binary_reader reader(data + sizeof(count), layout::payload);
+    value_type v = value_type();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        v = Codec::decode(reader, v);
+        out.push_back(v);
+    }
+}
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_RUN_CODEC_HEADER
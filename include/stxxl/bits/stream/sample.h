@@ -0,0 +1,308 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/sample.h
+ *
+ *  Bernoulli sampling with geometric skips, and reservoir sampling by
+ *  Kim-Hung Li. "Reservoir-Sampling Algorithms of Time Complexity
+ *  O(n(1 + log(N/n)))". ACM TOMS 1994.
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_SAMPLE_HEADER
+#define STXXL_STREAM_SAMPLE_HEADER
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <foxxll/common/exceptions.hpp>
+
+#include <stxxl/bits/common/seed.h>
+#include <stxxl/bits/stream/stream.h>
+#include <stxxl/types>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     SAMPLE                                                         //
+////////////////////////////////////////////////////////////////////////
+
+namespace sample_local {
+
+//! Uniform random number in (0, 1].
+inline double uniform_positive(std::mt19937_64& rng)
+{
+    double u;
+    do {
+        u = std::generate_canonical<double, 64>(rng);
+    } while (u >= 1.0);
+    return 1.0 - u;
+}
+
+//! Number of failures before the first success of Bernoulli trials with
+//! log_failure = log(1 - p), at most max.
+inline external_size_type geometric_skip(std::mt19937_64& rng, double log_failure,
+                                         external_size_type max)
+{
+    const double skip = std::floor(std::log(uniform_positive(rng)) / log_failure);
+    return (skip < static_cast<double>(max)) ? static_cast<external_size_type>(skip) : max;
+}
+
+} // namespace sample_local
+
+//! Bernoulli sample of a stream: delivers each value of the input
+//! independently with probability p, in input order.
+//!
+//! The number of values skipped between two sampled ones is drawn from the
+//! geometric distribution, such that only one random number is drawn per
+//! sampled value. The skipped values are read by next_batch() if the input
+//! provides it.
+//!
+//! \tparam Input input stream
+template <class Input>
+class bernoulli_sample
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input::value_type;
+
+private:
+    Input& m_input;
+
+    //! log(1 - p), which is 0 if every value is sampled
+    double m_log_failure;
+
+    std::mt19937_64 m_rng;
+
+    //! buffer of the skipped values
+    std::vector<value_type> m_skipped;
+
+    //! Skip the values until the next sampled one.
+    void skip_to_sample()
+    {
+        if (m_log_failure == 0.0)
+            return;
+
+        external_size_type skip = sample_local::geometric_skip(
+            m_rng, m_log_failure, std::numeric_limits<external_size_type>::max());
+
+        if (stream::has_next_batch<Input>::value)
+        {
+            if (m_skipped.empty())
+                m_skipped.resize(stream::batch_size(m_input));
+            while (skip >= m_skipped.size())
+            {
+                const size_t count = stream::next_batch(m_input, m_skipped.data(), m_skipped.size());
+                if (count == 0)
+                    return;
+                skip -= count;
+            }
+        }
+        for ( ; skip != 0 && !m_input.empty(); --skip)
+            ++m_input;
+    }
+
+public:
+    //! Sample the stream input with probability p in [0, 1], drawing the
+    //! random numbers from seed.
+    bernoulli_sample(Input& input, double p,
+                     unsigned seed = seed_sequence::get_ref().get_next_seed())
+        : m_input(input), m_rng(seed)
+    {
+        if (!(p >= 0.0 && p <= 1.0))
+            throw foxxll::bad_parameter(
+                      "stxxl::stream::bernoulli_sample(): p must be in [0, 1]");
+        m_log_failure = std::log1p(-p);
+        if (p == 0.0)
+        {
+            // skip the whole input
+            while (!m_input.empty())
+                ++m_input;
+        }
+        else
+            skip_to_sample();
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        return *m_input;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(*m_input);
+    }
+
+    //! Standard stream method.
+    bernoulli_sample& operator ++ ()
+    {
+        assert(!empty());
+        ++m_input;
+        if (!m_input.empty())
+            skip_to_sample();
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_input.empty();
+    }
+};
+
+//! Pass-through stage which keeps a uniform random sample of k of the values
+//! it forwards, without replacement, e.g. to draw a sample in the pass which
+//! feeds a sorter.
+//!
+//! The reservoir is replaced at random positions whose distances are drawn
+//! by Li's Algorithm L, hence O(k log(n / k)) random numbers are drawn for n
+//! values. The values are sampled when passed on by operator++() or
+//! next_batch().
+//!
+//! \tparam Input input stream
+template <class Input>
+class reservoir_sample
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input::value_type;
+
+private:
+    Input& m_input;
+
+    //! size of the sample
+    size_t m_k;
+
+    //! the sample
+    std::vector<value_type> m_reservoir;
+
+    //! number of values passed on
+    external_size_type m_count;
+
+    //! number of values passed on when the next one replaces a random
+    //! value of the reservoir
+    external_size_type m_next;
+
+    //! Algorithm L's largest of k uniform random numbers
+    double m_w;
+
+    std::mt19937_64 m_rng;
+
+    //! Draw the position of the next replacing value.
+    void advance_next()
+    {
+        m_w *= std::exp(std::log(sample_local::uniform_positive(m_rng))
+                        / static_cast<double>(m_k));
+        const external_size_type max = std::numeric_limits<external_size_type>::max() - m_next - 1;
+        m_next += 1 + ((m_w < 1.0) ? sample_local::geometric_skip(m_rng, std::log1p(-m_w), max) : 0);
+    }
+
+    void insert(const value_type& v)
+    {
+        if (m_reservoir.size() < m_k)
+        {
+            m_reservoir.push_back(v);
+            if (m_reservoir.size() == m_k)
+            {
+                m_next = m_count;
+                advance_next();
+            }
+        }
+        else if (m_count == m_next)
+        {
+            m_reservoir[std::uniform_int_distribution<size_t>(0, m_k - 1)(m_rng)] = v;
+            advance_next();
+        }
+        ++m_count;
+    }
+
+public:
+    //! Forward the stream input, keeping a sample of k of its values, drawing
+    //! the random numbers from seed.
+    reservoir_sample(Input& input, size_t k,
+                     unsigned seed = seed_sequence::get_ref().get_next_seed())
+        : m_input(input), m_k(k), m_count(0), m_next(0), m_w(1.0), m_rng(seed)
+    {
+        if (k == 0)
+            throw foxxll::bad_parameter(
+                      "stxxl::stream::reservoir_sample(): k must be positive");
+        m_reservoir.reserve(k);
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        return *m_input;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(*m_input);
+    }
+
+    //! Standard stream method.
+    reservoir_sample& operator ++ ()
+    {
+        assert(!empty());
+        insert(*m_input);
+        ++m_input;
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_input.empty();
+    }
+
+    //! Batch stream method.
+    size_t next_batch(value_type* out, size_t n)
+    {
+        const size_t count = stream::next_batch(m_input, out, n);
+        for (size_t i = 0; i < count; ++i)
+            insert(out[i]);
+        return count;
+    }
+
+    //! Batch stream method.
+    size_t batch_size() const
+    {
+        return stream::batch_size(m_input);
+    }
+
+    //! The sample of the values passed on, in random order, of
+    //! min(k, number of values passed on) values.
+    const std::vector<value_type>& sample() const
+    {
+        return m_reservoir;
+    }
+
+    //! number of values passed on
+    external_size_type count() const
+    {
+        return m_count;
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_SAMPLE_HEADER
@@ -0,0 +1,130 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/sketch.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_SKETCH_HEADER
+#define STXXL_STREAM_SKETCH_HEADER
+
+#include <cassert>
+#include <functional>
+
+#include <stxxl/bits/common/sketch.h>
+#include <stxxl/bits/stream/stream.h>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     SKETCH                                                         //
+////////////////////////////////////////////////////////////////////////
+
+//! Pass-through stage which inserts each value it forwards into a sketch,
+//! e.g. a kll_sketch or a hyperloglog, such that a summary of the values is
+//! computed in the same pass which consumes them, e.g. the splitters of the
+//! sorted output from the pass feeding a sorter.
+//!
+//! The values are inserted when they are passed on by operator++() or
+//! next_batch(), hence the sketch summarizes the consumed values. For one
+//! sketch of several streams read by different threads, give each stream a
+//! stage of its own and merge their sketches.
+//!
+//! \tparam Input input stream
+//! \tparam Sketch sketch with a method insert(const value_type&)
+template <class Input, class Sketch>
+class sketch
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input::value_type;
+    using sketch_type = Sketch;
+
+private:
+    Input& m_input;
+    Sketch m_sketch;
+
+public:
+    //! Forward the stream input, inserting its values into sk.
+    explicit sketch(Input& input, const Sketch& sk = Sketch())
+        : m_input(input), m_sketch(sk)
+    { }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        return *m_input;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(*m_input);
+    }
+
+    //! Standard stream method.
+    sketch& operator ++ ()
+    {
+        assert(!empty());
+        m_sketch.insert(*m_input);
+        ++m_input;
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_input.empty();
+    }
+
+    //! Batch stream method.
+    size_t next_batch(value_type* out, size_t n)
+    {
+        const size_t count = stream::next_batch(m_input, out, n);
+        for (size_t i = 0; i < count; ++i)
+            m_sketch.insert(out[i]);
+        return count;
+    }
+
+    //! Batch stream method.
+    size_t batch_size() const
+    {
+        return stream::batch_size(m_input);
+    }
+
+    //! The sketch of the values passed on.
+    const Sketch& get_sketch() const
+    {
+        return m_sketch;
+    }
+
+    //! The sketch of the values passed on, e.g. to merge it with others.
+    Sketch& get_sketch()
+    {
+        return m_sketch;
+    }
+};
+
+//! Pass-through stage maintaining a kll_sketch of the values forwarded.
+template <class Input, class CompareType = std::less<typename Input::value_type> >
+using quantile_sketch = sketch<Input, kll_sketch<typename Input::value_type, CompareType> >;
+
+//! Pass-through stage maintaining a hyperloglog of the values forwarded.
+template <class Input, class HashType = std::hash<typename Input::value_type> >
+using cardinality_sketch = sketch<Input, hyperloglog<typename Input::value_type, HashType> >;
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_SKETCH_HEADER
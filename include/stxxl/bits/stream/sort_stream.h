@@ -19,6 +19,8 @@
 #include <algorithm>
 #include <cassert>
 #include <functional>
+#include <future>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -28,13 +30,21 @@
 
 #include <foxxll/mng/block_manager.hpp>
 
+#include <stxxl/bits/algo/balanced_prefetcher.h>
+#include <stxxl/bits/algo/intksort.h>
 #include <stxxl/bits/algo/losertree.h>
 #include <stxxl/bits/algo/run_cursor.h>
+#include <stxxl/bits/algo/sample_sort.h>
 #include <stxxl/bits/algo/sort_base.h>
 #include <stxxl/bits/algo/sort_helper.h>
+#include <stxxl/bits/algo/sort_kernel.h>
 #include <stxxl/bits/algo/trigger_entry.h>
+#include <stxxl/bits/common/alloc_strategy.h>
+#include <stxxl/bits/common/trace.h>
+#include <stxxl/bits/common/block_array.h>
 #include <stxxl/bits/config.h>
 #include <stxxl/bits/parallel.h>
+#include <stxxl/bits/stream/memory_budget.h>
 #include <stxxl/bits/stream/sorted_runs.h>
 #include <stxxl/bits/stream/stream.h>
 
@@ -48,17 +58,66 @@ namespace stream {
 //     CREATE RUNS                                                    //
 ////////////////////////////////////////////////////////////////////////
 
+//! Default key extractor of the runs creators: runs are formed by
+//! comparison sorting.
+struct no_key_extractor { };
+
+//! Key extractor tag of the runs creators: runs are formed by stable
+//! comparison sorting of consecutive parts of the input, and the runs merger
+//! merges them stably, hence equal elements keep their input order.
+struct stable_comparison { };
+
+//! Without a key extractor, runs of integral types are sorted by the
+//! in-memory sort kernel, others by comparison sorting.
+template <typename BlockType, typename CompareType>
+bool sort_run_by_key(BlockType* run, size_t elements, CompareType cmp,
+                     no_key_extractor)
+{
+    return sort_kernel_blocks(run, 0, elements, cmp);
+}
+
+//! Radix sort a run stored in consecutive blocks by the unsigned integer
+//! key (or key prefix) given by keyobj. The comparator finishes runs of
+//! equal keys. Returns false if the blocks do not store their elements
+//! without gaps, which requires comparison sorting.
+template <typename BlockType, typename CompareType, typename KeyExtractor>
+bool sort_run_by_key(BlockType* run, size_t elements, CompareType cmp,
+                     KeyExtractor keyobj)
+{
+    using value_type = typename BlockType::value_type;
+    if (sizeof(BlockType) != BlockType::size * sizeof(value_type))
+        return false;
+
+    radix_sort(run[0].begin(), run[0].begin() + elements, keyobj, cmp);
+    return true;
+}
+
+//! Stable runs are sorted by basic_runs_creator::sort_run() itself.
+template <typename BlockType, typename CompareType>
+bool sort_run_by_key(BlockType*, size_t, CompareType, stable_comparison)
+{
+    return false;
+}
+
 //! Forms sorted runs of data from a stream.
 //!
 //! \tparam Input type of the input stream
 //! \tparam CompareWithMax type of comparison object used for sorting the runs
 //! \tparam BlockSize size of blocks used to store the runs (in bytes)
 //! \tparam AllocStr functor that defines allocation strategy for the runs
+//! \tparam KeyExtractor functor with key_type returning an unsigned integer
+//! key (or key prefix) ordered consistently with CompareWithMax; runs are then
+//! formed by radix sort. Default \c no_key_extractor uses comparison sorting,
+//! \c stable_comparison stable comparison sorting and stable merging.
+//! \tparam RunCodec codec compressing the blocks of the runs, e.g.
+//! \c delta_varint_codec. Default \c no_run_codec writes plain blocks.
 template <
     class Input,
     class CompareWithMax,
     size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(typename Input::value_type),
-    class AllocStr = foxxll::default_alloc_strategy>
+    class AllocStr = runtime_alloc_strategy,
+    class KeyExtractor = no_key_extractor,
+    class RunCodec = no_run_codec>
 class basic_runs_creator
 {
 public:
@@ -66,22 +125,32 @@ public:
     using cmp_type = CompareWithMax;
     static const size_t block_size = BlockSize;
     using allocation_strategy_type = AllocStr;
+    using key_extractor_type = KeyExtractor;
+    using run_codec = RunCodec;
 
 public:
     using value_type = typename Input::value_type;
     using block_type = foxxll::typed_block<BlockSize, value_type>;
     using trigger_entry_type = sort_helper::trigger_entry<block_type>;
-    using sorted_runs_data_type = sorted_runs<trigger_entry_type, cmp_type>;
+    using sorted_runs_data_type = sorted_runs<trigger_entry_type, cmp_type, RunCodec>;
     using run_type = typename sorted_runs_data_type::run_type;
     using sorted_runs_type = tlx::counting_ptr<sorted_runs_data_type>;
 
     using element_iterator = typename element_iterator_traits<block_type, external_size_type>::element_iterator;
 
+    //! true if runs are formed by stable sorting and merged stably
+    static constexpr bool stable = std::is_same<KeyExtractor, stable_comparison>::value;
+
+    static_assert(!stable || std::is_same<RunCodec, no_run_codec>::value,
+                  "stable runs are merged from plain blocks only");
+
 protected:
     //! reference to the input stream
     Input& m_input;
     //! comparator used to sort block groups
     CompareWithMax m_cmp;
+    //! key extractor used to radix sort block groups
+    KeyExtractor m_keyobj;
 
 private:
     //! stores the result (sorted runs) as smart pointer
@@ -90,22 +159,52 @@ private:
     size_t m_memsize;
     //! true iff result is already computed (used in 'result()' method)
     bool m_result_computed;
-
-    //! Fetch data from input into blocks[first_idx,last_idx).
+    //! sort and write runs in a background thread while the next run is
+    //! fetched from the input
+    bool m_async;
+    //! last element of the last run in m_result
+    value_type m_last_value;
+
+    //! Fetch data from input into blocks[first_idx,last_idx). Whole blocks
+    //! are read directly into the blocks if the input supports it, the other
+    //! values are copied by batches into the blocks.
     size_t fetch(block_type* blocks,
                  size_t first_idx, size_t last_idx)
     {
-        element_iterator output = make_element_iterator(blocks, first_idx);
-        size_t curr_idx = first_idx;
-        while (!m_input.empty() && curr_idx != last_idx) {
-            *output = *m_input;
-            ++m_input;
-            ++output;
-            ++curr_idx;
+        size_t curr_idx = fetch_blocks(blocks, first_idx, last_idx,
+                                       has_next_blocks<Input, block_type>());
+        while (curr_idx != last_idx) {
+            block_type& block = blocks[curr_idx / block_type::size];
+            const size_t offset = curr_idx % block_type::size;
+            const size_t n = stream::next_batch(
+                m_input, block.elem + offset,
+                std::min(block_type::size - offset, last_idx - curr_idx));
+            if (n == 0)
+                break;
+            curr_idx += n;
         }
         return curr_idx;
     }
 
+    //! Input without block hand-off.
+    size_t fetch_blocks(block_type*, size_t first_idx, size_t, std::false_type)
+    {
+        return first_idx;
+    }
+
+    //! Let the input read whole blocks into blocks[first_idx,last_idx).
+    size_t fetch_blocks(block_type* blocks, size_t first_idx, size_t last_idx,
+                        std::true_type)
+    {
+        if (first_idx % block_type::size != 0)
+            return first_idx;
+
+        const size_t nblocks = m_input.next_blocks(
+            blocks + first_idx / block_type::size,
+            (last_idx - first_idx) / block_type::size);
+        return first_idx + nblocks * block_type::size;
+    }
+
     //! fill the rest of the block with max values
     void fill_with_max_value(block_type* blocks, size_t num_blocks,
                              size_t first_idx)
@@ -124,13 +223,79 @@ private:
     //! Sort a specific run, contained in a sequences of blocks.
     void sort_run(block_type* run, size_t elements)
     {
+        if (stable)
+        {
+            // a run sorted in descending order is not reversed, which would
+            // reorder equal elements
+            if (!std::is_sorted(make_element_iterator(run, 0),
+                                make_element_iterator(run, elements), m_cmp))
+            {
+                check_sort_settings();
+                potentially_parallel::stable_sort(make_element_iterator(run, 0),
+                                                  make_element_iterator(run, elements),
+                                                  m_cmp);
+            }
+            return;
+        }
+
+        if (sort_helper::sort_presorted(make_element_iterator(run, 0),
+                                        make_element_iterator(run, elements),
+                                        m_cmp))
+            return;
+
+        if (sort_run_by_key(run, elements, m_cmp, m_keyobj))
+            return;
+
         check_sort_settings();
         potentially_parallel::sort(make_element_iterator(run, 0),
                                    make_element_iterator(run, elements),
                                    m_cmp);
     }
 
-    void compute_result();
+    //! Add the run formed of the first elements of blocks to the result,
+    //! concatenating it to the last run if it continues that one.
+    void add_run(const run_type& run, size_t elements, block_type* blocks)
+    {
+        m_result->add_run(run, elements, m_last_value, m_cmp);
+        m_last_value = *make_element_iterator(blocks, elements - 1);
+    }
+
+    //! Sort the run in blocks and write it to newly allocated blocks, waiting
+    //! for the previous write request of each block slot in write_reqs.
+    void write_run(block_type* blocks, foxxll::request_ptr* write_reqs,
+                   size_t elements, run_type& run)
+    {
+        sort_run(blocks, elements);
+
+        const size_t cur_run_size = foxxll::div_ceil(elements, block_type::size);
+        run.resize(cur_run_size);
+        foxxll::block_manager::get_instance()->new_blocks(
+            AllocStr(), make_bid_iterator(run.begin()), make_bid_iterator(run.end()));
+
+        // fill the rest of the last block with max values
+        fill_with_max_value(blocks, cur_run_size, elements);
+
+        for (size_t i = 0; i < cur_run_size; ++i)
+        {
+            run[i].value = blocks[i][0];
+            if (write_reqs[i].get())
+                write_reqs[i]->wait();
+            write_reqs[i] = blocks[i].write(run[i].bid);
+        }
+    }
+
+    void compute_result()
+    {
+        STXXL_TRACE_SPAN(span, "runs_creator::compute_result");
+        compute_result(RunCodec());
+        span.add_bytes(m_result->elements * sizeof(value_type));
+    }
+
+    void compute_result(no_run_codec);
+
+    //! Form runs of the whole memory and encode them with the run codec.
+    template <typename Codec>
+    void compute_result(Codec);
 
 public:
     //! Create the object.
@@ -138,16 +303,24 @@ public:
     //! \param cmp comparator object
     //! \param memory_to_use memory amount that is allowed to used by the
     //! sorter in bytes
+    //! \param keyobj key extractor object
     basic_runs_creator(Input& input, CompareWithMax cmp,
-                       size_t memory_to_use)
+                       size_t memory_to_use,
+                       KeyExtractor keyobj = KeyExtractor())
         : m_input(input),
           m_cmp(cmp),
+          m_keyobj(keyobj),
           m_result(new sorted_runs_data_type),
-          m_memsize(memory_to_use / BlockSize / sort_memory_usage_factor()),
-          m_result_computed(false)
+          m_memsize((memory_to_use - std::min(
+                         memory_to_use, run_codec_write_buffers(RunCodec()) * BlockSize))
+                    / BlockSize / sort_memory_usage_factor()),
+          m_result_computed(false),
+          m_async(SETTINGS::async_pipelining)
     {
         sort_helper::verify_sentinel_strict_weak_ordering(cmp);
-        if (!(2 * BlockSize * sort_memory_usage_factor() <= memory_to_use)) {
+        m_result->stable = stable;
+        if (!(2 * BlockSize * sort_memory_usage_factor()
+              + run_codec_write_buffers(RunCodec()) * BlockSize <= memory_to_use)) {
             throw foxxll::bad_parameter(
                       "stxxl::runs_creator<>:runs_creator(): "
                       "INSUFFICIENT MEMORY provided, "
@@ -161,6 +334,13 @@ public:
     //! non-copyable: delete assignment operator
     basic_runs_creator& operator = (const basic_runs_creator&) = delete;
 
+    //! Minimum memory amount in bytes the runs creator needs.
+    static size_t min_memory_to_use()
+    {
+        return 2 * BlockSize * sort_memory_usage_factor()
+               + run_codec_write_buffers(RunCodec()) * BlockSize;
+    }
+
     //! Returns the sorted runs object.
     //! \return Sorted runs object. The result is computed lazily, i.e. on the first call
     //! \remark Returned object is intended to be used by \c runs_merger object as input
@@ -181,8 +361,10 @@ public:
 //! Finish the results, i. e. create all runs.
 //!
 //! This is the main routine of this class.
-template <class Input, class CompareType, size_t BlockSize, class AllocStr>
-void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result()
+template <class Input, class CompareType, size_t BlockSize, class AllocStr,
+          class KeyExtractor, class RunCodec>
+void basic_runs_creator<Input, CompareType, BlockSize, AllocStr, KeyExtractor, RunCodec>::
+compute_result(no_run_codec)
 {
     constexpr bool debug = false;
     using request_ptr = foxxll::request_ptr;
@@ -195,7 +377,7 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
     block_type* Blocks1 = nullptr;
 
 #ifndef STXXL_SMALL_INPUT_PSORT_OPT
-    Blocks1 = new block_type[m2 * 2];
+    Blocks1 = new_block_array<block_type>(m2 * 2);
 #else
     // push input element into small_run vector in result until it is full
     while (!input.empty() && blocks1_length != block_type::size)
@@ -207,7 +389,7 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
 
     if (blocks1_length == block_type::size && !input.empty())
     {
-        Blocks1 = new block_type[m2 * 2];
+        Blocks1 = new_block_array<block_type>(m2 * 2);
         std::copy(m_result->small_run.begin(), m_result->small_run.end(),
                   Blocks1[0].begin());
         m_result->small_run.clear();
@@ -217,7 +399,10 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
         TLX_LOG << "basic_runs_creator: Small input optimization, input length: " << blocks1_length;
         m_result->elements = blocks1_length;
         check_sort_settings();
-        potentially_parallel::sort(m_result->small_run.begin(), m_result->small_run.end(), cmp);
+        if (stable)
+            potentially_parallel::stable_sort(m_result->small_run.begin(), m_result->small_run.end(), cmp);
+        else
+            potentially_parallel::sort(m_result->small_run.begin(), m_result->small_run.end(), cmp);
         return;
     }
 #endif //STXXL_SMALL_INPUT_PSORT_OPT
@@ -225,17 +410,39 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
     // the first block may be there already, now fetch until memsize is filled.
     blocks1_length = fetch(Blocks1, blocks1_length, el_in_run);
 
+    bool blocks2_fetched = false;
+    if (SETTINGS::in_memory_sort && !m_input.empty())
+    {
+        // fetch the second half before writing the first run, the input may
+        // fit into both
+        blocks2_length = fetch(Blocks1 + m2, 0, el_in_run);
+        blocks2_fetched = true;
+
+        if (m_input.empty())
+        {
+            blocks1_length += blocks2_length;
+            TLX_LOG << "basic_runs_creator: In-memory sort, input length: " << blocks1_length;
+            sort_run(Blocks1, blocks1_length);
+            m_result->small_run.assign(make_element_iterator(Blocks1, 0),
+                                       make_element_iterator(Blocks1, blocks1_length));
+            m_result->elements = blocks1_length;
+            delete_block_array(Blocks1, m2 * 2);
+            return;
+        }
+    }
+
     // sort first run
     sort_run(Blocks1, blocks1_length);
 
-    if (blocks1_length <= block_type::size && m_input.empty())
+    if ((blocks1_length <= block_type::size || SETTINGS::in_memory_sort) && m_input.empty())
     {
         // small input, do not flush it on the disk(s)
         TLX_LOG << "basic_runs_creator: Small input optimization, input length: " << blocks1_length;
         assert(m_result->small_run.empty());
-        m_result->small_run.assign(Blocks1[0].begin(), Blocks1[0].begin() + blocks1_length);
+        m_result->small_run.assign(make_element_iterator(Blocks1, 0),
+                                   make_element_iterator(Blocks1, blocks1_length));
         m_result->elements = blocks1_length;
-        delete[] Blocks1;
+        delete_block_array(Blocks1, m2 * 2);
         return;
     }
 
@@ -258,21 +465,22 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
         run[i].value = Blocks1[i][0];
         write_reqs[i] = Blocks1[i].write(run[i].bid);
     }
-    m_result->runs.push_back(run);
-    m_result->runs_sizes.push_back(blocks1_length);
-    m_result->elements += blocks1_length;
+    add_run(run, blocks1_length, Blocks1);
 
     if (m_input.empty())
     {
         // return
         wait_all(write_reqs, write_reqs + cur_run_size);
         delete[] write_reqs;
-        delete[] Blocks1;
+        delete_block_array(Blocks1, m2 * 2);
         return;
     }
 
-    TLX_LOG << "Filling the second part of the allocated blocks";
-    blocks2_length = fetch(Blocks2, 0, el_in_run);
+    if (!blocks2_fetched)
+    {
+        TLX_LOG << "Filling the second part of the allocated blocks";
+        blocks2_length = fetch(Blocks2, 0, el_in_run);
+    }
 
     if (m_input.empty())
     {
@@ -316,7 +524,7 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
         wait_all(write_reqs1, write_reqs1 + cur_run_size - m2);
         delete[] write_reqs1;
 
-        delete[] Blocks1;
+        delete_block_array(Blocks1, m2 * 2);
 
         return;
     }
@@ -337,7 +545,59 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
     }
     assert((blocks2_length % el_in_run) == 0);
 
-    m_result->add_run(run, blocks2_length);
+    add_run(run, blocks2_length, Blocks2);
+
+    if (m_async)
+    {
+        // Blocks2 is in flight in write_reqs, Blocks1 is free. Each buffer
+        // gets its own request slots, so that one run can be fetched while
+        // the background worker sorts and writes the other one.
+        request_ptr* write_reqs1 = new request_ptr[m2];
+        request_ptr* write_reqs2 = write_reqs;
+        std::future<size_t> worker;
+        run_type async_run;
+
+        while (!m_input.empty())
+        {
+            // the buffer may only be refilled once its previous run is on disk
+            for (i = 0; i < m2; ++i)
+            {
+                if (write_reqs1[i].get())
+                    write_reqs1[i]->wait();
+            }
+
+            blocks1_length = fetch(Blocks1, 0, el_in_run);
+
+            // the worker's run is in Blocks2
+            if (worker.valid())
+                add_run(async_run, worker.get(), Blocks2);
+
+            worker = std::async(
+                std::launch::async,
+                [this, Blocks1, write_reqs1, blocks1_length, &async_run]() {
+                    write_run(Blocks1, write_reqs1, blocks1_length, async_run);
+                    return blocks1_length;
+                });
+
+            std::swap(Blocks1, Blocks2);
+            std::swap(write_reqs1, write_reqs2);
+        }
+
+        if (worker.valid())
+            add_run(async_run, worker.get(), Blocks2);
+
+        for (i = 0; i < m2; ++i)
+        {
+            if (write_reqs1[i].get())
+                write_reqs1[i]->wait();
+            if (write_reqs2[i].get())
+                write_reqs2[i]->wait();
+        }
+        delete[] write_reqs1;
+        delete[] write_reqs2;
+        delete_block_array((Blocks1 < Blocks2) ? Blocks1 : Blocks2, m2 * 2);
+        return;
+    }
 
     while (!m_input.empty())
     {
@@ -356,7 +616,7 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
             write_reqs[i]->wait();
             write_reqs[i] = Blocks1[i].write(run[i].bid);
         }
-        m_result->add_run(run, blocks1_length);
+        add_run(run, blocks1_length, Blocks1);
 
         std::swap(Blocks1, Blocks2);
         std::swap(blocks1_length, blocks2_length);
@@ -364,7 +624,57 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
 
     wait_all(write_reqs, write_reqs + m2);
     delete[] write_reqs;
-    delete[] ((Blocks1 < Blocks2) ? Blocks1 : Blocks2);
+    delete_block_array((Blocks1 < Blocks2) ? Blocks1 : Blocks2, m2 * 2);
+}
+
+template <class Input, class CompareType, size_t BlockSize, class AllocStr,
+          class KeyExtractor, class RunCodec>
+template <typename Codec>
+void basic_runs_creator<Input, CompareType, BlockSize, AllocStr, KeyExtractor, RunCodec>::
+compute_result(Codec)
+{
+    constexpr bool debug = false;
+
+    // runs are encoded into the writer's buffers, hence the blocks are free
+    // again right after encoding and a run may use all of them.
+    const size_t el_in_run = m_memsize * block_type::size;
+    TLX_LOG << "basic_runs_creator::compute_result compressed m=" << m_memsize;
+
+    block_type* blocks = new_block_array<block_type>(m_memsize);
+    size_t length = fetch(blocks, 0, el_in_run);
+    sort_run(blocks, length);
+
+    if (length <= block_type::size && m_input.empty())
+    {
+        // small input, do not flush it on the disk(s)
+        TLX_LOG << "basic_runs_creator: Small input optimization, input length: " << length;
+        m_result->small_run.assign(blocks[0].begin(), blocks[0].begin() + length);
+        m_result->elements = length;
+        delete_block_array(blocks, m_memsize);
+        return;
+    }
+
+    foxxll::disk_queues::get_instance()->set_priority_op(foxxll::request_queue::WRITE);
+
+    compressed_run_writer<block_type, Codec, AllocStr> writer(
+        run_codec_write_buffers(Codec()));
+    run_type run;
+
+    while (true)
+    {
+        writer.write_run(make_element_iterator(blocks, 0),
+                         make_element_iterator(blocks, length), run);
+        add_run(run, length, blocks);
+
+        if (m_input.empty())
+            break;
+
+        length = fetch(blocks, 0, el_in_run);
+        sort_run(blocks, length);
+    }
+
+    writer.flush();
+    delete_block_array(blocks, m_memsize);
 }
 
 //! Forms sorted runs of data from a stream.
@@ -373,16 +683,21 @@ void basic_runs_creator<Input, CompareType, BlockSize, AllocStr>::compute_result
 //! \tparam CompareType type of omparison object used for sorting the runs
 //! \tparam BlockSize size of blocks used to store the runs
 //! \tparam AllocStr functor that defines allocation strategy for the runs
+//! \tparam KeyExtractor optional key extractor to radix sort the runs
+//! \tparam RunCodec optional codec compressing the runs
 template <
     class Input,
     class CompareType,
     size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(typename Input::value_type),
-    class AllocStr = foxxll::default_alloc_strategy
+    class AllocStr = runtime_alloc_strategy,
+    class KeyExtractor = no_key_extractor,
+    class RunCodec = no_run_codec
     >
-class runs_creator : public basic_runs_creator<Input, CompareType, BlockSize, AllocStr>
+class runs_creator
+    : public basic_runs_creator<Input, CompareType, BlockSize, AllocStr, KeyExtractor, RunCodec>
 {
 private:
-    using base = basic_runs_creator<Input, CompareType, BlockSize, AllocStr>;
+    using base = basic_runs_creator<Input, CompareType, BlockSize, AllocStr, KeyExtractor, RunCodec>;
 
 public:
     using cmp_type = typename base::cmp_type;
@@ -397,8 +712,10 @@ public:
     //! \param cmp comparator object
     //! \param memory_to_use memory amount that is allowed to used by the
     //! sorter in bytes
-    runs_creator(Input& input, CompareType cmp, size_t memory_to_use)
-        : base(input, cmp, memory_to_use)
+    //! \param keyobj key extractor object
+    runs_creator(Input& input, CompareType cmp, size_t memory_to_use,
+                 KeyExtractor keyobj = KeyExtractor())
+        : base(input, cmp, memory_to_use, keyobj)
     { }
 };
 
@@ -425,17 +742,23 @@ struct use_push
 //! \tparam CompareType type of comparison object used for sorting the runs
 //! \tparam BlockSize size of blocks used to store the runs
 //! \tparam AllocStr functor that defines allocation strategy for the runs
+//! \tparam KeyExtractor optional key extractor to radix sort the runs
+//! \tparam RunCodec optional codec compressing the runs
 template <
     class ValueType,
     class CompareType,
     size_t BlockSize,
-    class AllocStr
+    class AllocStr,
+    class KeyExtractor,
+    class RunCodec
     >
 class runs_creator<
         use_push<ValueType>,
         CompareType,
         BlockSize,
-        AllocStr
+        AllocStr,
+        KeyExtractor,
+        RunCodec
         >
 {
     static constexpr bool debug = false;
@@ -445,17 +768,23 @@ public:
     using value_type = ValueType;
     using block_type = foxxll::typed_block<BlockSize, value_type>;
     using trigger_entry_type = sort_helper::trigger_entry<block_type>;
-    using sorted_runs_data_type = sorted_runs<trigger_entry_type, cmp_type>;
+    using sorted_runs_data_type = sorted_runs<trigger_entry_type, cmp_type, RunCodec>;
     using sorted_runs_type = tlx::counting_ptr<sorted_runs_data_type>;
     using request_ptr = foxxll::request_ptr;
     using result_type = sorted_runs_type;
 
     using element_iterator = typename element_iterator_traits<block_type, external_size_type>::element_iterator;
 
+    static_assert(!std::is_same<KeyExtractor, stable_comparison>::value,
+                  "stable runs are created from an input stream only");
+
 private:
     //! comparator object to sort runs
     CompareType m_cmp;
 
+    //! key extractor object to radix sort runs
+    KeyExtractor m_keyobj;
+
     using run_type = typename sorted_runs_data_type::run_type;
 
     //! stores the result (sorted runs) in a reference counted object
@@ -485,13 +814,40 @@ private:
     //! accumulation buffer that is currently being written to disk
     block_type* m_blocks2;
 
-    //! reference to write requests transporting the last accumulation buffer
-    //! to disk
-    request_ptr* m_write_reqs;
+    //! write requests transporting the blocks of m_blocks1 to disk
+    request_ptr* m_write_reqs1;
+
+    //! write requests transporting the blocks of m_blocks2 to disk
+    request_ptr* m_write_reqs2;
 
     //! run object containing block ids of the run being written to disk
     run_type run;
 
+    //! sort and write full runs in a background thread while push() fills
+    //! the other accumulation buffer
+    const bool m_async;
+
+    //! background worker sorting and writing m_blocks2 into m_async_run
+    std::future<void> m_async_worker;
+
+    //! run object of the background worker, added to m_result once finished
+    run_type m_async_run;
+
+    //! number of elements in the run of the background worker
+    size_t m_async_elements;
+
+    using run_writer_type = compressed_run_writer<block_type, RunCodec, AllocStr>;
+
+    //! writer encoding the runs if a run codec is used
+    run_writer_type* m_run_writer;
+
+    //! last element of the last run in m_result
+    value_type m_last_value;
+
+    //! true if the first full run is kept unwritten in m_blocks2, as the
+    //! input may still fit into both buffers, see SETTINGS::in_memory_sort
+    bool m_deferred;
+
 protected:
     //!  fill the rest of the block with max values
     void fill_with_max_value(block_type* blocks, size_t num_blocks,
@@ -511,29 +867,56 @@ protected:
     //! Sort a specific run, contained in a sequences of blocks.
     void sort_run(block_type* run, size_t elements)
     {
+        if (sort_helper::sort_presorted(make_element_iterator(run, 0),
+                                        make_element_iterator(run, elements),
+                                        m_cmp))
+            return;
+
+        if (sort_run_by_key(run, elements, m_cmp, m_keyobj))
+            return;
+
         check_sort_settings();
         potentially_parallel::sort(make_element_iterator(run, 0),
                                    make_element_iterator(run, elements),
                                    m_cmp);
     }
 
-    void compute_result()
+    //! Add the run formed of the first elements of blocks to the result,
+    //! concatenating it to the last run if it continues that one.
+    void add_run(const run_type& run, size_t elements, block_type* blocks)
     {
-        if (m_cur_el == 0)
-            return;
+        m_result->add_run(run, elements, m_last_value, m_cmp);
+        m_last_value = *make_element_iterator(blocks, elements - 1);
+    }
+
+    //! Sort the run in blocks and write it to newly allocated blocks of run,
+    //! waiting for the previous write request of each block slot.
+    void write_run(block_type* blocks, request_ptr* write_reqs,
+                   size_t elements, run_type& run)
+    {
+        write_run(blocks, write_reqs, elements, run, RunCodec());
+    }
 
-        sort_run(m_blocks1, m_cur_el);
+    //! Sort the run in blocks and encode it with the run codec. The blocks
+    //! are free again on return, as the writer has its own buffers.
+    template <typename Codec>
+    void write_run(block_type* blocks, request_ptr* /* write_reqs */,
+                   size_t elements, run_type& run, Codec)
+    {
+        sort_run(blocks, elements);
 
-        if (m_cur_el <= block_type::size && m_result->elements == 0)
-        {
-            // small input, do not flush it on the disk(s)
-            TLX_LOG << "runs_creator(use_push): Small input optimization, input length: " << m_cur_el;
-            m_result->small_run.assign(m_blocks1[0].begin(), m_blocks1[0].begin() + m_cur_el);
-            m_result->elements = m_cur_el;
-            return;
-        }
+        foxxll::disk_queues::get_instance()->set_priority_op(foxxll::request_queue::WRITE);
+
+        m_run_writer->write_run(make_element_iterator(blocks, 0),
+                                make_element_iterator(blocks, elements), run);
+    }
 
-        const size_t cur_run_size = foxxll::div_ceil(m_cur_el, block_type::size);         // in blocks
+    void write_run(block_type* blocks, request_ptr* write_reqs,
+                   size_t elements, run_type& run, no_run_codec)
+    {
+        sort_run(blocks, elements);
+
+        const size_t cur_run_size = foxxll::div_ceil(elements, block_type::size);         // in blocks
         run.resize(cur_run_size);
         foxxll::block_manager* bm = foxxll::block_manager::get_instance();
         bm->new_blocks(AllocStr(), make_bid_iterator(run.begin()), make_bid_iterator(run.end()));
@@ -541,41 +924,124 @@ protected:
         foxxll::disk_queues::get_instance()->set_priority_op(foxxll::request_queue::WRITE);
 
         // fill the rest of the last block with max values
-        fill_with_max_value(m_blocks1, cur_run_size, m_cur_el);
+        fill_with_max_value(blocks, cur_run_size, elements);
 
-        size_t i = 0;
-        for ( ; i < cur_run_size; ++i)
+        for (size_t i = 0; i < cur_run_size; ++i)
+        {
+            run[i].value = blocks[i][0];
+            if (write_reqs[i].get())
+                write_reqs[i]->wait();
+
+            write_reqs[i] = blocks[i].write(run[i].bid);
+        }
+    }
+
+    //! Wait for the background worker and add its run to the result.
+    void finish_async_run()
+    {
+        if (!m_async_worker.valid())
+            return;
+
+        // the worker's run is in m_blocks2
+        m_async_worker.get();
+        add_run(m_async_run, m_async_elements, m_blocks2);
+        m_async_elements = 0;
+    }
+
+    //! Wait for all outstanding write requests of an accumulation buffer.
+    void wait_write_reqs(request_ptr* write_reqs)
+    {
+        for (size_t i = 0; i < m_m2; ++i)
+        {
+            if (write_reqs[i].get())
+                write_reqs[i]->wait();
+        }
+    }
+
+    void compute_result()
+    {
+        finish_async_run();
+
+        if (m_deferred)
         {
-            run[i].value = m_blocks1[i][0];
-            if (m_write_reqs[i].get())
-                m_write_reqs[i]->wait();
+            // the input fits into both buffers, sort it in internal memory
+            TLX_LOG << "runs_creator(use_push): In-memory sort, input length: " << m_el_in_run + m_cur_el;
+            std::vector<value_type>& small_run = m_result->small_run;
+            small_run.assign(make_element_iterator(m_blocks2, 0),
+                             make_element_iterator(m_blocks2, m_el_in_run));
+            small_run.insert(small_run.end(), make_element_iterator(m_blocks1, 0),
+                             make_element_iterator(m_blocks1, m_cur_el));
+            check_sort_settings();
+            potentially_parallel::sort(small_run.begin(), small_run.end(), m_cmp);
+            m_result->elements = small_run.size();
+            m_deferred = false;
+            return;
+        }
 
-            m_write_reqs[i] = m_blocks1[i].write(run[i].bid);
+        if (m_cur_el == 0)
+        {
+            wait_write_reqs(m_write_reqs1);
+            wait_write_reqs(m_write_reqs2);
+            return;
         }
-        m_result->add_run(run, m_cur_el);
 
-        for (i = 0; i < m_m2; ++i)
+        if ((m_cur_el <= block_type::size || SETTINGS::in_memory_sort) &&
+            m_result->elements == 0)
         {
-            if (m_write_reqs[i].get())
-                m_write_reqs[i]->wait();
+            // small input, do not flush it on the disk(s)
+            TLX_LOG << "runs_creator(use_push): Small input optimization, input length: " << m_cur_el;
+            sort_run(m_blocks1, m_cur_el);
+            m_result->small_run.assign(make_element_iterator(m_blocks1, 0),
+                                       make_element_iterator(m_blocks1, m_cur_el));
+            m_result->elements = m_cur_el;
+            return;
         }
+
+        write_run(m_blocks1, m_write_reqs1, m_cur_el, run);
+        add_run(run, m_cur_el, m_blocks1);
+
+        wait_write_reqs(m_write_reqs1);
+        wait_write_reqs(m_write_reqs2);
+        if (m_run_writer)
+            m_run_writer->flush();
+    }
+
+    run_writer_type * new_run_writer(no_run_codec)
+    {
+        return nullptr;
+    }
+
+    template <typename Codec>
+    run_writer_type * new_run_writer(Codec)
+    {
+        return new run_writer_type(run_codec_write_buffers(Codec()));
     }
 
 public:
     //! Creates the object.
     //! \param cmp comparator object
     //! \param memory_to_use memory amount that is allowed to used by the sorter in bytes
-    runs_creator(CompareType cmp, size_t memory_to_use)
+    //! \param keyobj key extractor object
+    runs_creator(CompareType cmp, size_t memory_to_use,
+                 KeyExtractor keyobj = KeyExtractor())
         : m_cmp(cmp),
+          m_keyobj(keyobj),
           m_memory_to_use(memory_to_use),
-          m_memsize(memory_to_use / BlockSize / sort_memory_usage_factor()),
+          m_memsize((memory_to_use - std::min(
+                         memory_to_use, run_codec_write_buffers(RunCodec()) * BlockSize))
+                    / BlockSize / sort_memory_usage_factor()),
           m_m2(m_memsize / 2),
           m_el_in_run(m_m2 * block_type::size),
           m_blocks1(nullptr), m_blocks2(nullptr),
-          m_write_reqs(nullptr)
+          m_write_reqs1(nullptr), m_write_reqs2(nullptr),
+          m_async(SETTINGS::async_pipelining),
+          m_async_elements(0),
+          m_run_writer(nullptr),
+          m_deferred(false)
     {
         sort_helper::verify_sentinel_strict_weak_ordering(m_cmp);
-        if (!(2 * BlockSize * sort_memory_usage_factor() <= m_memory_to_use)) {
+        if (!(2 * BlockSize * sort_memory_usage_factor()
+              + run_codec_write_buffers(RunCodec()) * BlockSize <= m_memory_to_use)) {
             throw foxxll::bad_parameter(
                       "stxxl::runs_creator<>:runs_creator(): "
                       "INSUFFICIENT MEMORY provided, "
@@ -593,6 +1059,8 @@ public:
 
     ~runs_creator()
     {
+        // the background worker still uses the accumulation buffers
+        finish_async_run();
         m_result_computed = 1;
         deallocate();
     }
@@ -600,6 +1068,10 @@ public:
     //! Clear current state and remove all items.
     void clear()
     {
+        finish_async_run();
+        if (m_run_writer)
+            m_run_writer->flush();
+
         if (!m_result)
             m_result = sorted_runs_type(new sorted_runs_data_type);
         else
@@ -607,11 +1079,14 @@ public:
 
         m_result_computed = false;
         m_cur_el = 0;
+        m_deferred = false;
 
         for (size_t i = 0; i < m_m2; ++i)
         {
-            if (m_write_reqs[i].get())
-                m_write_reqs[i]->cancel();
+            if (m_write_reqs1[i].get())
+                m_write_reqs1[i]->cancel();
+            if (m_write_reqs2[i].get())
+                m_write_reqs2[i]->cancel();
         }
     }
 
@@ -620,10 +1095,13 @@ public:
     {
         if (!m_blocks1)
         {
-            m_blocks1 = new block_type[m_m2 * 2];
+            m_blocks1 = new_block_array<block_type>(m_m2 * 2);
             m_blocks2 = m_blocks1 + m_m2;
 
-            m_write_reqs = new request_ptr[m_m2];
+            m_write_reqs1 = new request_ptr[m_m2 * 2];
+            m_write_reqs2 = m_write_reqs1 + m_m2;
+
+            m_run_writer = new_run_writer(RunCodec());
         }
 
         clear();
@@ -636,11 +1114,14 @@ public:
 
         if (m_blocks1)
         {
-            delete[] ((m_blocks1 < m_blocks2) ? m_blocks1 : m_blocks2);
+            delete_block_array((m_blocks1 < m_blocks2) ? m_blocks1 : m_blocks2, m_m2 * 2);
             m_blocks1 = m_blocks2 = nullptr;
 
-            delete[] m_write_reqs;
-            m_write_reqs = nullptr;
+            delete[] ((m_write_reqs1 < m_write_reqs2) ? m_write_reqs1 : m_write_reqs2);
+            m_write_reqs1 = m_write_reqs2 = nullptr;
+
+            delete m_run_writer;
+            m_run_writer = nullptr;
         }
     }
 
@@ -659,28 +1140,48 @@ public:
         assert(m_el_in_run == m_cur_el);
         m_cur_el = 0;
 
-        // sort and store m_blocks1
-        sort_run(m_blocks1, m_el_in_run);
-
-        const size_t cur_run_blocks = foxxll::div_ceil(m_el_in_run, block_type::size);        // in blocks
-        run.resize(cur_run_blocks);
-        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
-        bm->new_blocks(AllocStr(), make_bid_iterator(run.begin()), make_bid_iterator(run.end()));
-
-        foxxll::disk_queues::get_instance()->set_priority_op(foxxll::request_queue::WRITE);
-
-        for (size_t i = 0; i < cur_run_blocks; ++i)
+        if (m_deferred)
         {
-            run[i].value = m_blocks1[i][0];
-            if (m_write_reqs[i].get())
-                m_write_reqs[i]->wait();
-
-            m_write_reqs[i] = m_blocks1[i].write(run[i].bid);
+            // the input does not fit into memory, write the deferred run
+            write_run(m_blocks2, m_write_reqs2, m_el_in_run, run);
+            add_run(run, m_el_in_run, m_blocks2);
+            m_deferred = false;
+        }
+        else if (SETTINGS::in_memory_sort && m_result->elements == 0 &&
+                 !m_async_worker.valid())
+        {
+            // keep the first run in memory and fill the other buffer
+            m_deferred = true;
+            std::swap(m_blocks1, m_blocks2);
+            std::swap(m_write_reqs1, m_write_reqs2);
+            push(val);
+            return;
         }
 
-        m_result->add_run(run, m_el_in_run);
+        // sort and store m_blocks1
+        if (m_async)
+        {
+            finish_async_run();
+
+            block_type* blocks = m_blocks1;
+            request_ptr* write_reqs = m_write_reqs1;
+            m_async_elements = m_el_in_run;
+            m_async_worker = std::async(
+                std::launch::async, [this, blocks, write_reqs]() {
+                    write_run(blocks, write_reqs, m_el_in_run, m_async_run);
+                });
+        }
+        else
+        {
+            write_run(m_blocks1, m_write_reqs1, m_el_in_run, run);
+            add_run(run, m_el_in_run, m_blocks1);
+        }
 
         std::swap(m_blocks1, m_blocks2);
+        std::swap(m_write_reqs1, m_write_reqs2);
+
+        // the buffer may only be refilled once its previous run is on disk
+        wait_write_reqs(m_write_reqs1);
 
         push(val);
     }
@@ -704,7 +1205,8 @@ public:
     //! number of items currently inserted.
     external_size_type size() const
     {
-        return m_result->elements + m_cur_el;
+        return m_result->elements + m_async_elements + m_cur_el
+               + (m_deferred ? m_el_in_run : 0);
     }
 
     //! return comparator object.
@@ -747,17 +1249,23 @@ struct from_sorted_sequences
 //! \tparam CompareType type of comparison object used for sorting the runs
 //! \tparam BlockSize size of blocks used to store the runs
 //! \tparam AllocStr functor that defines allocation strategy for the runs
+//! \tparam KeyExtractor unused, the sequences are already sorted
+//! \tparam RunCodec unused, the runs are written as plain blocks
 template <
     class ValueType,
     class CompareType,
     size_t BlockSize,
-    class AllocStr
+    class AllocStr,
+    class KeyExtractor,
+    class RunCodec
     >
 class runs_creator<
         from_sorted_sequences<ValueType>,
         CompareType,
         BlockSize,
-        AllocStr
+        AllocStr,
+        KeyExtractor,
+        RunCodec
         >
 {
 public:
@@ -903,49 +1411,661 @@ public:
     }
 };
 
-//! Checker for the sorted runs object created by the \c runs_creator .
-//! \param sruns sorted runs object
-//! \param cmp comparison object used for checking the order of elements in runs
-//! \return \c true if runs are sorted, \c false otherwise
-template <class RunsType, class CompareType>
-bool check_sorted_runs(const RunsType& sruns, CompareType cmp)
+//! Input strategy for \c runs_creator class.
+//!
+//! This strategy together with \c runs_creator class
+//! allows to create sorted runs
+//! data structure usable for \c runs_merger
+//! pushing elements into the sorter
+//! (using runs_creator::push()), forming the runs by replacement selection.
+template <class ValueType>
+struct use_replacement_selection
 {
-    constexpr bool debug = false;
+    using value_type = ValueType;
+};
 
-    sort_helper::verify_sentinel_strict_weak_ordering(cmp);
-    using block_type = typename RunsType::element_type::block_type;
-    TLX_LOG << "Elements: " << sruns->elements;
-    size_t nruns = sruns->runs.size();
-    TLX_LOG << "Runs: " << nruns;
-    size_t irun = 0;
-    for (irun = 0; irun < nruns; ++irun)
-    {
-        const size_t nblocks = sruns->runs[irun].size();
-        block_type* blocks = new block_type[nblocks];
-        foxxll::request_ptr* reqs = new foxxll::request_ptr[nblocks];
-        for (size_t j = 0; j < nblocks; ++j)
-        {
-            reqs[j] = blocks[j].read(sruns->runs[irun][j].bid);
-        }
-        wait_all(reqs, reqs + nblocks);
-        delete[] reqs;
+//! Forms sorted runs of elements passed in push() method by replacement
+//! selection.
+//!
+//! A specialization of \c runs_creator that keeps a heap of elements in
+//! memory: each push() outputs the smallest element of the heap to the
+//! current run and inserts the new element, into the next run if it is
+//! smaller than the element just output. The runs are about twice as long
+//! as the memory on random input, and nearly sorted input yields a single
+//! run. <BR>
+//! \tparam ValueType type of values (parameter for \c use_replacement_selection strategy)
+//! \tparam CompareType type of comparison object used for sorting the runs
+//! \tparam BlockSize size of blocks used to store the runs
+//! \tparam AllocStr functor that defines allocation strategy for the runs
+//! \tparam KeyExtractor unused, the runs are formed by a heap
+//! \tparam RunCodec optional codec compressing the runs
+template <
+    class ValueType,
+    class CompareType,
+    size_t BlockSize,
+    class AllocStr,
+    class KeyExtractor,
+    class RunCodec
+    >
+class runs_creator<
+        use_replacement_selection<ValueType>,
+        CompareType,
+        BlockSize,
+        AllocStr,
+        KeyExtractor,
+        RunCodec
+        >
+{
+    static constexpr bool debug = false;
 
-        for (size_t j = 0; j < nblocks; ++j)
-        {
-            if (cmp(blocks[j][0], sruns->runs[irun][j].value) ||
-                cmp(sruns->runs[irun][j].value, blocks[j][0]))     //!=
-            {
-                TLX_LOG1 << "check_sorted_runs  wrong trigger in the run";
-                delete[] blocks;
-                return false;
-            }
-        }
-        if (!stxxl::is_sorted(
-                make_element_iterator(blocks, 0),
-                make_element_iterator(blocks, sruns->runs_sizes[irun]),
-                cmp))
-        {
-            TLX_LOG1 << "check_sorted_runs  wrong order in the run";
+public:
+    using cmp_type = CompareType;
+    using value_type = ValueType;
+    using block_type = foxxll::typed_block<BlockSize, value_type>;
+    using trigger_entry_type = sort_helper::trigger_entry<block_type>;
+    using sorted_runs_data_type = sorted_runs<trigger_entry_type, cmp_type, RunCodec>;
+    using sorted_runs_type = tlx::counting_ptr<sorted_runs_data_type>;
+    using result_type = sorted_runs_type;
+
+private:
+    using run_type = typename sorted_runs_data_type::run_type;
+
+    using run_writer_type = typename std::conditional<
+              std::is_same<RunCodec, no_run_codec>::value,
+              plain_run_writer<block_type, CompareType, AllocStr>,
+              compressed_run_writer<block_type, RunCodec, AllocStr>
+              >::type;
+
+    //! comparator object to order the heap
+    CompareType m_cmp;
+
+    //! stores the result (sorted runs) in a reference counted object
+    sorted_runs_type m_result;
+
+    //! memory size in bytes to use
+    const size_t m_memory_to_use;
+
+    //! number of write buffers of the run writer
+    const size_t m_nwrite_buffers;
+
+    //! maximum number of elements kept in memory
+    const size_t m_capacity;
+
+    //! true after the result() method was called for the first time
+    bool m_result_computed;
+
+    //! elements in memory: the heap of the current run in [0,m_heap_size),
+    //! followed by the elements of the next run
+    std::vector<value_type> m_heap;
+
+    //! number of elements in the heap of the current run
+    size_t m_heap_size;
+
+    //! writer transporting the runs to disk
+    run_writer_type* m_run_writer;
+
+    //! run object containing block ids of the run being written
+    run_type m_run;
+
+    //! number of elements written to m_run
+    size_t m_run_elements;
+
+    //! true if m_run was begun in m_run_writer
+    bool m_run_open;
+
+    //! restore the heap property below index i of the current run's heap,
+    //! the smallest element is at the root.
+    void sift_down(size_t i)
+    {
+        value_type v = m_heap[i];
+        size_t child;
+        while ((child = 2 * i + 1) < m_heap_size)
+        {
+            if (child + 1 < m_heap_size && m_cmp(m_heap[child + 1], m_heap[child]))
+                ++child;
+            if (!m_cmp(m_heap[child], v))
+                break;
+            m_heap[i] = m_heap[child];
+            i = child;
+        }
+        m_heap[i] = v;
+    }
+
+    //! build the heap of the current run from all elements in memory
+    void make_heap()
+    {
+        m_heap_size = m_heap.size();
+        for (size_t i = m_heap_size / 2; i-- > 0; )
+            sift_down(i);
+    }
+
+    //! append v to the current run
+    void output(const value_type& v)
+    {
+        if (!m_run_open)
+        {
+            m_run_writer->begin_run(m_run);
+            m_run_open = true;
+        }
+        m_run_writer->push(v);
+        ++m_run_elements;
+    }
+
+    //! finish the current run and add it to the result
+    void finish_run()
+    {
+        if (!m_run_open)
+            return;
+
+        m_run_writer->end_run();
+        m_result->add_run(m_run, m_run_elements);
+        m_run_elements = 0;
+        m_run_open = false;
+    }
+
+    //! write out a range of elements in memory as (the rest of) a run
+    void output_sorted(size_t begin, size_t end)
+    {
+        std::sort(m_heap.begin() + begin, m_heap.begin() + end, m_cmp);
+        for (size_t i = begin; i < end; ++i)
+            output(m_heap[i]);
+        finish_run();
+    }
+
+    void compute_result()
+    {
+        if (m_heap.empty())
+        {
+            if (m_run_writer)
+                m_run_writer->flush();
+            return;
+        }
+
+        if (m_result->elements == 0 && !m_run_open &&
+            m_heap.size() <= block_type::size)
+        {
+            // small input, do not flush it on the disk(s)
+            TLX_LOG << "runs_creator(use_replacement_selection): Small input optimization, input length: " << m_heap.size();
+            std::sort(m_heap.begin(), m_heap.end(), m_cmp);
+            m_result->small_run.assign(m_heap.begin(), m_heap.end());
+            m_result->elements = m_heap.size();
+            m_heap.clear();
+            m_heap_size = 0;
+            return;
+        }
+
+        // the rest of the current run, then the next run
+        output_sorted(0, m_heap_size);
+        output_sorted(m_heap_size, m_heap.size());
+
+        m_heap.clear();
+        m_heap_size = 0;
+        m_run_writer->flush();
+    }
+
+    run_writer_type * new_run_writer(no_run_codec)
+    {
+        return new run_writer_type(m_nwrite_buffers, m_cmp);
+    }
+
+    template <typename Codec>
+    run_writer_type * new_run_writer(Codec)
+    {
+        return new run_writer_type(m_nwrite_buffers);
+    }
+
+public:
+    //! Creates the object.
+    //! \param cmp comparator object
+    //! \param memory_to_use memory amount that is allowed to used by the sorter in bytes
+    runs_creator(CompareType cmp, size_t memory_to_use)
+        : m_cmp(cmp),
+          m_memory_to_use(memory_to_use),
+          m_nwrite_buffers(2 * foxxll::config::get_instance()->disks_number()),
+          m_capacity((memory_to_use - std::min(memory_to_use, m_nwrite_buffers * BlockSize))
+                     / sizeof(value_type)),
+          m_heap_size(0),
+          m_run_writer(nullptr),
+          m_run_elements(0),
+          m_run_open(false)
+    {
+        sort_helper::verify_sentinel_strict_weak_ordering(m_cmp);
+        if (!((m_nwrite_buffers + 1) * BlockSize <= m_memory_to_use)) {
+            throw foxxll::bad_parameter(
+                      "stxxl::runs_creator<>:runs_creator(): "
+                      "INSUFFICIENT MEMORY provided, "
+                      "please increase parameter 'memory_to_use'");
+        }
+        assert(m_capacity > 0);
+
+        allocate();
+    }
+
+    //! Creates the object and forms the runs of all elements of a stream.
+    //! \param input stream of the elements
+    //! \param cmp comparator object
+    //! \param memory_to_use memory amount that is allowed to used by the sorter in bytes
+    template <class Input>
+    runs_creator(Input& input, CompareType cmp, size_t memory_to_use)
+        : runs_creator(cmp, memory_to_use)
+    {
+        for ( ; !input.empty(); ++input)
+            push(*input);
+    }
+
+    //! non-copyable: delete copy-constructor
+    runs_creator(const runs_creator&) = delete;
+    //! non-copyable: delete assignment operator
+    runs_creator& operator = (const runs_creator&) = delete;
+
+    ~runs_creator()
+    {
+        m_result_computed = 1;
+        deallocate();
+    }
+
+    //! Clear current state and remove all items.
+    void clear()
+    {
+        // the blocks of an open run are released with the result
+        finish_run();
+        if (m_run_writer)
+            m_run_writer->flush();
+
+        if (!m_result)
+            m_result = sorted_runs_type(new sorted_runs_data_type);
+        else
+            m_result->clear();
+
+        m_result_computed = false;
+        m_heap.clear();
+        m_heap_size = 0;
+    }
+
+    //! Allocates the heap and write buffers and clears result.
+    void allocate()
+    {
+        if (!m_run_writer)
+        {
+            m_heap.reserve(m_capacity);
+            m_run_writer = new_run_writer(RunCodec());
+        }
+
+        clear();
+    }
+
+    //! Deallocates the heap and write buffers but not the current result.
+    void deallocate()
+    {
+        result();       // finishes result
+
+        if (m_run_writer)
+        {
+            std::vector<value_type>().swap(m_heap);
+
+            delete m_run_writer;
+            m_run_writer = nullptr;
+        }
+    }
+
+    //! Adds new element to the sorter.
+    //! \param val value to be added
+    void push(const value_type& val)
+    {
+        assert(m_result_computed == false);
+        if (TLX_UNLIKELY(m_heap.size() < m_capacity))
+        {
+            // initial filling of the memory, elements of the first run
+            m_heap.push_back(val);
+            if (m_heap.size() == m_capacity)
+                make_heap();
+            return;
+        }
+
+        // move the smallest element to the run, val replaces it
+        output(m_heap[0]);
+
+        if (!m_cmp(val, m_heap[0]))
+        {
+            m_heap[0] = val;
+            sift_down(0);
+            return;
+        }
+
+        // val belongs to the next run, it takes the last slot of the heap
+        --m_heap_size;
+        m_heap[0] = m_heap[m_heap_size];
+        m_heap[m_heap_size] = val;
+
+        if (m_heap_size > 0)
+        {
+            sift_down(0);
+            return;
+        }
+
+        // the current run is complete, all elements form the next one
+        finish_run();
+        make_heap();
+    }
+
+    //! Returns the sorted runs object.
+    //! \return Sorted runs object.
+    //! \remark Returned object is intended to be used by \c runs_merger object as input
+    sorted_runs_type & result()
+    {
+        if (!m_result_computed)
+        {
+            compute_result();
+            m_result_computed = true;
+#ifdef STXXL_PRINT_STAT_AFTER_RF
+            TLX_LOG1 << *stats::get_instance();
+#endif //STXXL_PRINT_STAT_AFTER_RF
+        }
+        return m_result;
+    }
+
+    //! number of items currently inserted.
+    external_size_type size() const
+    {
+        return m_result->elements + m_run_elements + m_heap.size();
+    }
+
+    //! return comparator object.
+    const cmp_type & cmp() const
+    {
+        return m_cmp;
+    }
+
+    //! return memory size used (in bytes).
+    size_t memory_used() const
+    {
+        return m_memory_to_use;
+    }
+};
+
+//! Input strategy for \c runs_creator class.
+//!
+//! This strategy together with \c runs_creator class
+//! allows to create sorted runs
+//! data structure usable for \c runs_merger
+//! pushing elements into the sorter
+//! (using runs_creator::push()), sorting them by distribution.
+template <class ValueType>
+struct use_sample_sort
+{
+    using value_type = ValueType;
+};
+
+//! Sorts the elements passed in push() method with the
+//! \c sample_sort_local::sample_sorter distribution engine.
+//!
+//! A specialization of \c runs_creator that distributes the elements to
+//! buckets by sampled splitters and sorts the buckets in memory in parallel,
+//! the result is a single run which the \c runs_merger only scans. Produces
+//! a merger-compatible result, so it can be used as \c RunsCreatorType of \c
+//! stream::sort. <BR>
+//! \tparam ValueType type of values (parameter for \c use_sample_sort strategy)
+//! \tparam CompareType type of comparison object used for sorting
+//! \tparam BlockSize size of blocks used to store the buckets and the run
+//! \tparam AllocStr functor that defines allocation strategy for the blocks
+//! \tparam KeyExtractor unused, the buckets are sorted by comparison
+//! \tparam RunCodec optional codec compressing the run
+template <
+    class ValueType,
+    class CompareType,
+    size_t BlockSize,
+    class AllocStr,
+    class KeyExtractor,
+    class RunCodec
+    >
+class runs_creator<
+        use_sample_sort<ValueType>,
+        CompareType,
+        BlockSize,
+        AllocStr,
+        KeyExtractor,
+        RunCodec
+        >
+{
+    static constexpr bool debug = false;
+
+public:
+    using cmp_type = CompareType;
+    using value_type = ValueType;
+    using block_type = foxxll::typed_block<BlockSize, value_type>;
+    using trigger_entry_type = sort_helper::trigger_entry<block_type>;
+    using sorted_runs_data_type = sorted_runs<trigger_entry_type, cmp_type, RunCodec>;
+    using sorted_runs_type = tlx::counting_ptr<sorted_runs_data_type>;
+    using result_type = sorted_runs_type;
+
+private:
+    using run_type = typename sorted_runs_data_type::run_type;
+
+    using run_writer_type = typename std::conditional<
+              std::is_same<RunCodec, no_run_codec>::value,
+              plain_run_writer<block_type, CompareType, AllocStr>,
+              compressed_run_writer<block_type, RunCodec, AllocStr>
+              >::type;
+
+    using sorter_type = sample_sort_local::sample_sorter<
+              value_type, CompareType, BlockSize, AllocStr>;
+
+    //! comparator object
+    CompareType m_cmp;
+
+    //! stores the result (sorted runs) in a reference counted object
+    sorted_runs_type m_result;
+
+    //! memory size in bytes to use
+    const size_t m_memory_to_use;
+
+    //! number of write buffers of the run writer
+    const size_t m_nwrite_buffers;
+
+    //! true after the result() method was called for the first time
+    bool m_result_computed;
+
+    //! distribution engine holding the elements pushed
+    sorter_type m_sorter;
+
+    void compute_result()
+    {
+        const external_size_type n = m_sorter.size();
+        if (n == 0)
+            return;
+
+        if (n <= block_type::size)
+        {
+            // small input, do not flush it on the disk(s)
+            TLX_LOG << "runs_creator(use_sample_sort): Small input optimization, input length: " << n;
+            m_result->small_run.reserve(static_cast<size_t>(n));
+            m_sorter.output([this](const value_type& v) { m_result->small_run.push_back(v); });
+            m_result->elements = n;
+            return;
+        }
+
+        run_writer_type* writer = new_run_writer(RunCodec());
+        run_type run;
+        writer->begin_run(run);
+        m_sorter.output([writer](const value_type& v) { writer->push(v); });
+        writer->end_run();
+        writer->flush();
+        delete writer;
+
+        m_result->add_run(run, n);
+    }
+
+    run_writer_type * new_run_writer(no_run_codec)
+    {
+        return new run_writer_type(m_nwrite_buffers, m_cmp);
+    }
+
+    template <typename Codec>
+    run_writer_type * new_run_writer(Codec)
+    {
+        return new run_writer_type(m_nwrite_buffers);
+    }
+
+public:
+    //! Creates the object.
+    //! \param cmp comparator object
+    //! \param memory_to_use memory amount that is allowed to used by the sorter in bytes
+    runs_creator(CompareType cmp, size_t memory_to_use)
+        : m_cmp(cmp),
+          m_result(new sorted_runs_data_type),
+          m_memory_to_use(memory_to_use),
+          m_nwrite_buffers(2 * foxxll::config::get_instance()->disks_number()),
+          m_result_computed(false),
+          m_sorter(cmp, memory_to_use - std::min(memory_to_use, m_nwrite_buffers * BlockSize))
+    {
+        sort_helper::verify_sentinel_strict_weak_ordering(m_cmp);
+    }
+
+    //! Creates the object and sorts all elements of a stream.
+    //! \param input stream of the elements
+    //! \param cmp comparator object
+    //! \param memory_to_use memory amount that is allowed to used by the sorter in bytes
+    template <class Input>
+    runs_creator(Input& input, CompareType cmp, size_t memory_to_use)
+        : runs_creator(cmp, memory_to_use)
+    {
+        for ( ; !input.empty(); ++input)
+            push(*input);
+    }
+
+    //! non-copyable: delete copy-constructor
+    runs_creator(const runs_creator&) = delete;
+    //! non-copyable: delete assignment operator
+    runs_creator& operator = (const runs_creator&) = delete;
+
+    //! Adds new element to the sorter.
+    //! \param val value to be added
+    void push(const value_type& val)
+    {
+        assert(m_result_computed == false);
+        m_sorter.push(val);
+    }
+
+    //! Returns the sorted runs object.
+    //! \return Sorted runs object.
+    //! \remark Returned object is intended to be used by \c runs_merger object as input
+    sorted_runs_type & result()
+    {
+        if (!m_result_computed)
+        {
+            compute_result();
+            m_result_computed = true;
+#ifdef STXXL_PRINT_STAT_AFTER_RF
+            TLX_LOG1 << *stats::get_instance();
+#endif //STXXL_PRINT_STAT_AFTER_RF
+        }
+        return m_result;
+    }
+
+    //! number of items currently inserted.
+    external_size_type size() const
+    {
+        return m_result->elements + m_sorter.size();
+    }
+
+    //! return comparator object.
+    const cmp_type & cmp() const
+    {
+        return m_cmp;
+    }
+
+    //! return memory size used (in bytes).
+    size_t memory_used() const
+    {
+        return m_memory_to_use;
+    }
+};
+
+//! Check the trigger entries and the order of a run of plain blocks.
+template <typename BlockType, typename RunType, typename CompareType>
+bool check_sorted_run(BlockType* blocks, const RunType& run,
+                      size_t run_size, CompareType cmp, no_run_codec)
+{
+    for (size_t j = 0; j < run.size(); ++j)
+    {
+        if (cmp(blocks[j][0], run[j].value) ||
+            cmp(run[j].value, blocks[j][0]))     //!=
+        {
+            TLX_LOG1 << "check_sorted_runs  wrong trigger in the run";
+            return false;
+        }
+    }
+    if (!stxxl::is_sorted(
+            make_element_iterator(blocks, 0),
+            make_element_iterator(blocks, run_size),
+            cmp))
+    {
+        TLX_LOG1 << "check_sorted_runs  wrong order in the run";
+        return false;
+    }
+    return true;
+}
+
+//! Check the trigger entries and the order of a run of compressed blocks.
+template <typename BlockType, typename RunType, typename CompareType,
+          typename Codec>
+bool check_sorted_run(BlockType* blocks, const RunType& run,
+                      size_t run_size, CompareType cmp, Codec)
+{
+    std::vector<typename BlockType::value_type> elements;
+    for (size_t j = 0; j < run.size(); ++j)
+    {
+        const size_t first = elements.size();
+        decode_compressed_block<Codec>(blocks[j], elements);
+        if (elements.size() == first ||
+            cmp(elements[first], run[j].value) ||
+            cmp(run[j].value, elements[first]))     //!=
+        {
+            TLX_LOG1 << "check_sorted_runs  wrong trigger in the run";
+            return false;
+        }
+    }
+    if (elements.size() != run_size ||
+        !stxxl::is_sorted(elements.cbegin(), elements.cend(), cmp))
+    {
+        TLX_LOG1 << "check_sorted_runs  wrong order in the run";
+        return false;
+    }
+    return true;
+}
+
+//! Checker for the sorted runs object created by the \c runs_creator .
+//! \param sruns sorted runs object
+//! \param cmp comparison object used for checking the order of elements in runs
+//! \return \c true if runs are sorted, \c false otherwise
+template <class RunsType, class CompareType>
+bool check_sorted_runs(const RunsType& sruns, CompareType cmp)
+{
+    constexpr bool debug = false;
+
+    sort_helper::verify_sentinel_strict_weak_ordering(cmp);
+    using block_type = typename RunsType::element_type::block_type;
+    using run_codec = typename RunsType::element_type::run_codec;
+    TLX_LOG << "Elements: " << sruns->elements;
+    size_t nruns = sruns->runs.size();
+    TLX_LOG << "Runs: " << nruns;
+    size_t irun = 0;
+    for (irun = 0; irun < nruns; ++irun)
+    {
+        const size_t nblocks = sruns->runs[irun].size();
+        block_type* blocks = new block_type[nblocks];
+        foxxll::request_ptr* reqs = new foxxll::request_ptr[nblocks];
+        for (size_t j = 0; j < nblocks; ++j)
+        {
+            reqs[j] = blocks[j].read(sruns->runs[irun][j].bid);
+        }
+        wait_all(reqs, reqs + nblocks);
+        delete[] reqs;
+
+        if (!check_sorted_run(blocks, sruns->runs[irun],
+                              static_cast<size_t>(sruns->runs_sizes[irun]),
+                              cmp, run_codec()))
+        {
             delete[] blocks;
             return false;
         }
@@ -970,7 +2090,7 @@ bool check_sorted_runs(const RunsType& sruns, CompareType cmp)
 //! storing intermediate results if several merge passes are required
 template <class RunsType,
           class CompareWithMinMax,
-          class AllocStr = foxxll::default_alloc_strategy>
+          class AllocStr = runtime_alloc_strategy>
 class basic_runs_merger
 {
     static constexpr bool debug = false;
@@ -986,10 +2106,17 @@ public:
     using block_type = typename sorted_runs_data_type::block_type;
     using out_block_type = block_type;
     using trigger_entry_type = typename run_type::value_type;
-    using prefetcher_type = foxxll::block_prefetcher<block_type, typename run_type::iterator>;
+    using prefetcher_type = run_prefetcher<block_type, typename run_type::iterator>;
     using run_cursor_type = run_cursor2<block_type, prefetcher_type>;
     using run_cursor2_cmp_type = sort_helper::run_cursor2_cmp<block_type, prefetcher_type, value_cmp>;
     using loser_tree_type = loser_tree<run_cursor_type, run_cursor2_cmp_type>;
+    using stable_cursor_type = stable_run_cursor2<block_type, prefetcher_type>;
+    using stable_cursor_cmp_type = sort_helper::stable_run_cursor2_cmp<block_type, prefetcher_type, value_cmp>;
+    using stable_loser_tree_type = loser_tree<stable_cursor_type, stable_cursor_cmp_type>;
+    using run_codec = typename sorted_runs_data_type::run_codec;
+    using compressed_cursor_type = compressed_run_cursor<block_type, prefetcher_type, run_codec>;
+    using compressed_cursor_cmp_type = compressed_run_cursor_cmp<compressed_cursor_type, value_cmp>;
+    using compressed_loser_tree_type = loser_tree<compressed_cursor_type, compressed_cursor_cmp_type>;
     using diff_type = int64_t;
     using sequence = std::pair<typename block_type::iterator, typename block_type::iterator>;
     using seqs_size_type = typename std::vector<sequence>::size_type;
@@ -1011,9 +2138,22 @@ private:
     //! items remaining in input
     size_type m_elements_remaining;
 
+    //! items not yet merged into an output block
+    size_type m_elements_unmerged;
+
     //! memory buffer for merging from external streams
     out_block_type* m_buffer_block;
 
+    //! merge the next output block in a background thread while the current
+    //! one is consumed
+    bool m_merge_ahead;
+
+    //! output block filled by the background merger, nullptr unless needed
+    out_block_type* m_ahead_block;
+
+    //! background merger filling m_ahead_block, returns the items merged
+    std::future<size_t> m_ahead;
+
     //! pointer into current memory buffer: this is either m_buffer_block or the small_runs vector
     const value_type* m_current_ptr;
 
@@ -1032,6 +2172,18 @@ private:
     //! loser tree used for native merging
     loser_tree_type* m_losers;
 
+    //! loser tree merging stable runs, breaking ties by the order of the runs
+    stable_loser_tree_type* m_stable_losers;
+
+    //! position in the runs of each block of m_consume_seq, if stable
+    std::vector<size_t> m_origin;
+
+    //! loser tree decoding and merging compressed runs
+    compressed_loser_tree_type* m_compressed_losers;
+
+    //! true if the runs are compressed by a run codec
+    static constexpr bool compressed = !std::is_same<run_codec, no_run_codec>::value;
+
 #if STXXL_PARALLEL_MULTIWAY_MERGE
     std::vector<sequence>* seqs;
     std::vector<block_type*>* buffers;
@@ -1045,13 +2197,70 @@ private:
 
     ////////////////////////////////////////////////////////////////////
 
-    void merge_recursively();
+    //! Merge runs until at most final_arity runs remain for the final merge.
+    void merge_recursively(size_t final_arity);
+
+    //! Write the output of merger as a new run of plain blocks.
+    void write_merged_run(basic_runs_merger& merger, run_type& run,
+                          size_type elements, size_t nwrite_buffers, no_run_codec)
+    {
+        // calculate blocks in run
+        const size_t blocks_in_new_run = static_cast<size_t>(foxxll::div_ceil(
+                                                                 elements, block_type::size));
+
+        // allocate blocks for the new runs
+        run.resize(blocks_in_new_run);
+        foxxll::block_manager::get_instance()->new_blocks(
+            alloc_strategy(), make_bid_iterator(run.begin()), make_bid_iterator(run.end()));
+
+        // make sure everything is being destroyed in right time
+        foxxll::buf_ostream<block_type, typename run_type::iterator> out(
+            run.begin(), nwrite_buffers);
+
+        size_type cnt = 0;
+
+        while (cnt != elements)
+        {
+            *out = *merger;
+            if ((cnt % block_type::size) == 0)     // have to write the trigger value
+                run[static_cast<size_t>(cnt / size_type(block_type::size))].value = *merger;
+
+            ++cnt, ++out, ++merger;
+        }
+        assert(merger.empty());
+
+        while (cnt % block_type::size)
+        {
+            *out = m_cmp.max_value();
+            ++out, ++cnt;
+        }
+    }
+
+    //! Write the output of merger as a new run encoded by the run codec.
+    template <typename Codec>
+    void write_merged_run(basic_runs_merger& merger, run_type& run,
+                          size_type elements, size_t nwrite_buffers, Codec)
+    {
+        compressed_run_writer<block_type, Codec, alloc_strategy> writer(nwrite_buffers);
+
+        writer.begin_run(run);
+        for (size_type cnt = 0; cnt != elements; ++cnt, ++merger)
+            writer.push(*merger);
+        assert(merger.empty());
+        writer.end_run();
+        writer.flush();
+    }
 
     void deallocate_prefetcher()
     {
         if (m_prefetcher)
         {
             delete m_losers;
+            delete m_stable_losers;
+            delete m_compressed_losers;
+            m_losers = nullptr;
+            m_stable_losers = nullptr;
+            m_compressed_losers = nullptr;
 #if STXXL_PARALLEL_MULTIWAY_MERGE
             delete seqs;
             delete buffers;
@@ -1062,10 +2271,45 @@ private:
         }
     }
 
-    void fill_buffer_block()
+    void create_compressed_losers(size_t, no_run_codec)
+    {
+        FOXXLL_THROW_UNREACHABLE();
+    }
+
+    template <typename Codec>
+    void create_compressed_losers(size_t nruns, Codec)
+    {
+        m_compressed_losers = new compressed_loser_tree_type(
+            m_prefetcher, nruns, compressed_cursor_cmp_type(m_cmp));
+    }
+
+    void compressed_multi_merge(value_type*, value_type*, no_run_codec)
+    {
+        FOXXLL_THROW_UNREACHABLE();
+    }
+
+    template <typename Codec>
+    void compressed_multi_merge(value_type* first, value_type* last, Codec)
     {
-        TLX_LOG << "fill_buffer_block";
-        if (do_parallel_merge())
+        m_compressed_losers->multi_merge(first, last);
+    }
+
+    //! Merge the next output block into block, returns the items merged.
+    size_t merge_block(out_block_type* block)
+    {
+        TLX_LOG << "merge_block";
+        const size_t output_items = static_cast<size_t>(std::min<size_type>(
+            static_cast<size_type>(out_block_type::size), m_elements_unmerged));
+        if (compressed)
+        {
+            // compressed blocks are decoded by the cursors of a loser tree
+            compressed_multi_merge(block->elem, block->elem + output_items, run_codec());
+        }
+        else if (m_stable_losers)
+        {
+            m_stable_losers->multi_merge(block->elem, block->elem + output_items);
+        }
+        else if (do_parallel_merge())
         {
 #if STXXL_PARALLEL_MULTIWAY_MERGE
 // begin of STL-style merging
@@ -1078,7 +2322,7 @@ private:
                     if (!m_prefetcher || m_prefetcher->empty())
                     {
                         // anything remaining is already in memory
-                        num_currently_mergeable = m_elements_remaining;
+                        num_currently_mergeable = m_elements_unmerged;
                     }
                     else
                     {
@@ -1093,7 +2337,7 @@ private:
 
                 potentially_parallel::multiway_merge(
                     (*seqs).begin(), (*seqs).end(),
-                    m_buffer_block->end() - rest, output_size, m_cmp);
+                    block->end() - rest, output_size, m_cmp);
                 // sequence iterators are progressed appropriately
 
                 rest -= output_size;
@@ -1105,12 +2349,12 @@ private:
             } while (rest > 0 && (*seqs).size() > 0);
 
 #if STXXL_CHECK_ORDER_IN_SORTS
-            if (!stxxl::is_sorted(m_buffer_block->cbegin(), m_buffer_block->cend(), cmp))
+            if (!stxxl::is_sorted(block->cbegin(), block->cend(), cmp))
             {
-                for (value_type* i = m_buffer_block->begin() + 1; i != m_buffer_block->end(); ++i)
+                for (value_type* i = block->begin() + 1; i != block->end(); ++i)
                     if (cmp(*i, *(i - 1)))
                     {
-                        TLX_LOG << "Error at position " << (i - m_buffer_block->begin());
+                        TLX_LOG << "Error at position " << (i - block->begin());
                     }
                 assert(false);
             }
@@ -1124,23 +2368,56 @@ private:
         else
         {
 // begin of native merging procedure
-            m_losers->multi_merge(m_buffer_block->elem,
-                                  m_buffer_block->elem +
-                                  std::min<size_type>(
-                                      static_cast<size_type>(out_block_type::size),
-                                      m_elements_remaining));
+            m_losers->multi_merge(block->elem, block->elem + output_items);
 // end of native merging procedure
         }
         TLX_LOG << "current block filled";
 
-        m_current_ptr = m_buffer_block->elem;
-        m_current_end = m_buffer_block->elem + std::min<size_type>(
-            static_cast<size_type>(out_block_type::size), m_elements_remaining);
+        m_elements_unmerged -= output_items;
 
-        if (m_elements_remaining <= out_block_type::size)
+        if (m_elements_unmerged == 0)
             deallocate_prefetcher();
+
+        return output_items;
+    }
+
+    //! Wait for the background merger, if any, and discard its block.
+    void wait_merge_ahead()
+    {
+        if (m_ahead.valid())
+        {
+            m_ahead.wait();
+            m_ahead = std::future<size_t>();
+        }
+    }
+
+    void fill_buffer_block()
+    {
+        TLX_LOG << "fill_buffer_block";
+
+        size_t output_items;
+        if (m_ahead.valid())
+        {
+            output_items = m_ahead.get();
+            std::swap(m_buffer_block, m_ahead_block);
+        }
+        else
+        {
+            output_items = merge_block(m_buffer_block);
+        }
+
+        m_current_ptr = m_buffer_block->elem;
+        m_current_end = m_buffer_block->elem + output_items;
+
+        if (m_merge_ahead && m_elements_unmerged > 0)
+        {
+            m_ahead = std::async(std::launch::async, [this]() {
+                                     return merge_block(m_ahead_block);
+                                 });
+        }
     }
 
+
 public:
     //! Creates a runs merger object.
     //! \param c comparison object
@@ -1149,9 +2426,13 @@ public:
         : m_cmp(c),
           m_memory_to_use(memory_to_use),
           m_buffer_block(new out_block_type),
+          m_merge_ahead(false),
+          m_ahead_block(nullptr),
           m_prefetch_seq(nullptr),
           m_prefetcher(nullptr),
-          m_losers(nullptr)
+          m_losers(nullptr),
+          m_stable_losers(nullptr),
+          m_compressed_losers(nullptr)
 #if STXXL_PARALLEL_MULTIWAY_MERGE
           , seqs(nullptr),
           buffers(nullptr),
@@ -1175,11 +2456,40 @@ public:
         m_memory_to_use = memory_to_use;
     }
 
+    //! Memory amount in bytes used for the merger.
+    size_t memory_to_use() const
+    {
+        return m_memory_to_use;
+    }
+
+    //! Minimum memory amount in bytes the merger needs, to merge recursively.
+    static size_t min_memory_to_use()
+    {
+        size_t disks_number = foxxll::config::get_instance()->disks_number();
+        size_t out_blocks = (SETTINGS::async_pipelining ? 2 : 1);
+        return (4 * disks_number + out_blocks + 2) * block_type::raw_size;
+    }
+
+    //! Memory amount in bytes to merge sruns in a single pass.
+    static size_t single_pass_memory(const sorted_runs_type& sruns)
+    {
+        size_t disks_number = foxxll::config::get_instance()->disks_number();
+        size_t out_blocks = (SETTINGS::async_pipelining ? 2 : 1);
+        return std::max(
+            min_memory_to_use(),
+            (sruns->runs.size() + 2 * disks_number) * block_type::raw_size
+            + out_blocks * sizeof(out_block_type));
+    }
+
     //! Initialize the runs merger object with a new round of sorted_runs.
     void initialize(const sorted_runs_type& sruns)
     {
+        wait_merge_ahead();
+        deallocate_prefetcher();
+
         m_sruns = sruns;
         m_elements_remaining = m_sruns->elements;
+        m_elements_unmerged = m_elements_remaining;
 
         if (empty())
             return;
@@ -1204,11 +2514,16 @@ public:
 
         foxxll::disk_queues::get_instance()->set_priority_op(foxxll::request_queue::WRITE);
 
+        m_merge_ahead = SETTINGS::async_pipelining;
+        if (m_merge_ahead && !m_ahead_block)
+            m_ahead_block = new out_block_type;
+
         size_t disks_number = foxxll::config::get_instance()->disks_number();
         size_t min_prefetch_buffers = 2 * disks_number;
+        size_t out_blocks_memory = (m_merge_ahead ? 2 : 1) * sizeof(out_block_type);
         size_t input_buffers =
-            (m_memory_to_use > sizeof(out_block_type)
-             ? m_memory_to_use - sizeof(out_block_type)
+            (m_memory_to_use > out_blocks_memory
+             ? m_memory_to_use - out_blocks_memory
              : 0) / block_type::raw_size;
         size_t nruns = m_sruns->runs.size();
 
@@ -1224,9 +2539,10 @@ public:
 
             // check whether we have enough memory to merge recursively
             size_t recursive_merge_buffers = m_memory_to_use / block_type::raw_size;
-            if (recursive_merge_buffers < 2 * min_prefetch_buffers + 1 + 2) {
+            size_t recursive_out_blocks = (m_merge_ahead ? 2 : 1);
+            if (recursive_merge_buffers < 2 * min_prefetch_buffers + recursive_out_blocks + 2) {
                 // recursive merge uses min_prefetch_buffers for input buffering and min_prefetch_buffers output buffering
-                // as well as 1 current output block and at least 2 input blocks
+                // as well as 1 (2 with merge-ahead) current output block and at least 2 input blocks
                 TLX_LOG1 << "There are only m=" << recursive_merge_buffers << " blocks available for recursive merging, but "
                          << min_prefetch_buffers << "+" << min_prefetch_buffers << "+1 are needed read-ahead/write-back/output, and";
                 TLX_LOG1 << "the merger requires memory to store at least two input blocks internally. Aborting.";
@@ -1234,7 +2550,8 @@ public:
                           "basic_runs_merger::sort(): INSUFFICIENT MEMORY provided, please increase parameter 'memory_to_use'");
             }
 
-            merge_recursively();
+            merge_recursively(input_buffers > min_prefetch_buffers
+                              ? input_buffers - min_prefetch_buffers : 1);
 
             nruns = m_sruns->runs.size();
         }
@@ -1243,12 +2560,11 @@ public:
 
         // *** Allocate prefetcher and merge data structure
 
-        deallocate_prefetcher();
-
-        size_t prefetch_seq_size = 0;
+        size_t prefetch_seq_size = 0, max_run_blocks = 0;
         for (size_t i = 0; i < nruns; ++i)
         {
             prefetch_seq_size += m_sruns->runs[i].size();
+            max_run_blocks = std::max(max_run_blocks, m_sruns->runs[i].size());
         }
 
         m_consume_seq.resize(prefetch_seq_size);
@@ -1262,14 +2578,19 @@ public:
                                    copy_start);
         }
 
-        std::stable_sort(m_consume_seq.begin(), m_consume_seq.end(),
-                         sort_helper::trigger_entry_cmp<trigger_entry_type, value_cmp>(m_cmp) _STXXL_SORT_TRIGGER_FORCE_SEQUENTIAL);
+        if (m_sruns->stable)
+            sort_helper::sort_consume_seq_stable(m_consume_seq, m_origin, m_cmp);
+        else
+            std::stable_sort(m_consume_seq.begin(), m_consume_seq.end(),
+                             sort_helper::trigger_entry_cmp<trigger_entry_type, value_cmp>(m_cmp) _STXXL_SORT_TRIGGER_FORCE_SEQUENTIAL);
 
         const size_t n_prefetch_buffers = std::max(min_prefetch_buffers, input_buffers - nruns);
 
 #if STXXL_SORT_OPTIMAL_PREFETCHING
-        // heuristic
-        const size_t n_opt_prefetch_buffers = min_prefetch_buffers + (3 * (n_prefetch_buffers - min_prefetch_buffers)) / 10;
+        // heuristic, skewed runs receive a deeper schedule
+        const size_t n_opt_prefetch_buffers = optimal_prefetch_buffers(
+            min_prefetch_buffers, n_prefetch_buffers,
+            nruns, max_run_blocks, prefetch_seq_size);
 
         compute_prefetch_schedule(
             m_consume_seq,
@@ -1287,7 +2608,17 @@ public:
             m_prefetch_seq,
             std::min(nruns + n_prefetch_buffers, prefetch_seq_size));
 
-        if (do_parallel_merge())
+        if (compressed)
+        {
+            create_compressed_losers(nruns, run_codec());
+        }
+        else if (m_sruns->stable)
+        {
+            // stable merging always uses the native loser tree
+            m_stable_losers = new stable_loser_tree_type(
+                m_prefetcher, nruns, stable_cursor_cmp_type(m_cmp, m_origin.data()));
+        }
+        else if (do_parallel_merge())
         {
 #if STXXL_PARALLEL_MULTIWAY_MERGE
 // begin of STL-style merging
@@ -1317,6 +2648,7 @@ public:
     //! Deallocate temporary structures freeing memory prior to next initialize().
     void deallocate()
     {
+        wait_merge_ahead();
         deallocate_prefetcher();
         m_sruns = nullptr;         // release reference on result object
     }
@@ -1382,20 +2714,75 @@ public:
         return *this;
     }
 
+    //! Batch stream method: copies values of the current output block.
+    size_t next_batch(value_type* out, size_t n)
+    {
+        if (empty())
+            return 0;
+
+        n = std::min<size_t>(n, m_current_end - m_current_ptr);
+        std::copy(m_current_ptr, m_current_ptr + n, out);
+        m_elements_remaining -= n;
+        m_current_ptr += n;
+
+        if (m_current_ptr == m_current_end && !empty())
+            fill_buffer_block();
+
+#if STXXL_CHECK_ORDER_IN_SORTS
+        if (!empty())
+        {
+            assert(!m_cmp(operator * (), out[n - 1]));
+            m_last_element = operator * ();
+        }
+#endif //STXXL_CHECK_ORDER_IN_SORTS
+
+        return n;
+    }
+
+    //! Batch stream method.
+    size_t batch_size() const
+    {
+        return out_block_type::size;
+    }
+
+    //! Block stream method: hand over the current output block if it is full
+    //! and none of its values were read, by swapping it with block, which is
+    //! filled with the following values. The block must be allocated by new,
+    //! like the merger's own. Returns the number of values handed over,
+    //! zero if no full block is available.
+    size_t next_block(out_block_type*& block)
+    {
+        if (empty() || m_current_ptr != m_buffer_block->elem ||
+            m_current_end != m_buffer_block->elem + out_block_type::size)
+            return 0;
+
+        std::swap(block, m_buffer_block);
+        m_elements_remaining -= out_block_type::size;
+
+        if (!empty())
+            fill_buffer_block();
+        else
+            m_current_ptr = m_current_end = m_buffer_block->elem;
+
+        return out_block_type::size;
+    }
+
     //! Destructor.
     //! \remark Deallocates blocks of the input sorted runs object
     virtual ~basic_runs_merger()
     {
+        wait_merge_ahead();
         deallocate_prefetcher();
 
         delete m_buffer_block;
+        delete m_ahead_block;
     }
 };
 
 template <class RunsType, class CompareType, class AllocStr>
-void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively()
+void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively(
+    size_t final_arity)
 {
-    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
     size_t ndisks = foxxll::config::get_instance()->disks_number();
     size_t nwrite_buffers = 2 * ndisks;
     size_t memory_for_write_buffers = nwrite_buffers * sizeof(block_type);
@@ -1403,7 +2790,7 @@ void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively()
     // memory consumption of the recursive merger (uses block_type as
     // out_block_type)
     size_t recursive_merger_memory_prefetch_buffers = 2 * ndisks * sizeof(block_type);
-    size_t recursive_merger_memory_out_block = sizeof(block_type);
+    size_t recursive_merger_memory_out_block = (m_merge_ahead ? 2 : 1) * sizeof(block_type);
     size_t memory_for_buffers = memory_for_write_buffers
                                 + recursive_merger_memory_prefetch_buffers
                                 + recursive_merger_memory_out_block;
@@ -1411,67 +2798,101 @@ void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively()
     size_t max_arity = (m_memory_to_use > memory_for_buffers ? m_memory_to_use - memory_for_buffers : 0) / block_type::raw_size;
 
     size_t nruns = m_sruns->runs.size();
-    const size_t merge_factor = optimal_merge_factor(nruns, max_arity);
-    assert(merge_factor > 1);
-    assert(merge_factor <= max_arity);
+    assert(max_arity > 1);
+    assert(final_arity > 0);
 
-    while (nruns > max_arity)
+    STXXL_TRACE_SPAN(span, "runs_merger::merge_recursively");
+
+    while (nruns > final_arity)
     {
-        size_t new_nruns = foxxll::div_ceil(nruns, merge_factor);
+        // *** plan the groups of runs merged in this phase
+
+        std::vector<std::vector<size_t> > groups;
+
+        size_t reduction = nruns - final_arity;
+        size_t partial_groups = foxxll::div_ceil(reduction, max_arity - 1);
+
+        if (reduction + partial_groups <= nruns && !m_sruns->stable)
+        {
+            // the final merge is reached in this phase: merge only the
+            // shortest runs, as few elements as possible are rewritten.
+            // Stable runs are merged in groups of consecutive runs only.
+            std::vector<size_t> order(nruns);
+            for (size_t i = 0; i < nruns; ++i)
+                order[i] = i;
+            std::stable_sort(order.begin(), order.end(),
+                             [this](size_t a, size_t b) {
+                                 return m_sruns->runs_sizes[a] < m_sruns->runs_sizes[b];
+                             });
+
+            size_t pos = 0, to_merge = reduction + partial_groups;
+            for (size_t g = 0; g < partial_groups; ++g)
+            {
+                size_t group_size = to_merge / partial_groups + (g < to_merge % partial_groups ? 1 : 0);
+                groups.emplace_back(order.begin() + pos, order.begin() + pos + group_size);
+                pos += group_size;
+            }
+            for ( ; pos < nruns; ++pos)
+                groups.emplace_back(1, order[pos]);
+        }
+        else
+        {
+            const size_t merge_factor = optimal_merge_factor(nruns, max_arity);
+            assert(merge_factor > 1);
+            assert(merge_factor <= max_arity);
+
+            for (size_t i = 0; i < nruns; i += merge_factor)
+            {
+                groups.emplace_back();
+                for (size_t j = i; j < std::min(nruns, i + merge_factor); ++j)
+                    groups.back().push_back(j);
+            }
+        }
+
+        size_t new_nruns = groups.size();
         TLX_LOG1 << "Starting new merge phase: nruns: " << nruns <<
-            " opt_merge_factor: " << merge_factor <<
+            " final_arity: " << final_arity <<
             " max_arity: " << max_arity << " new_nruns: " << new_nruns;
 
         // construct new sorted_runs data object which will be swapped into
         // m_sruns
 
         sorted_runs_data_type new_runs;
+        new_runs.stable = m_sruns->stable;
         new_runs.runs.resize(new_nruns);
         new_runs.runs_sizes.resize(new_nruns);
         new_runs.elements = m_sruns->elements;
 
         // merge all runs from m_runs into news_runs
 
-        size_t runs_left = nruns;
-        size_t cur_out_run = 0;
         size_type elements_left = m_sruns->elements;
 
-        while (runs_left > 0)
+        for (size_t cur_out_run = 0; cur_out_run < new_nruns; ++cur_out_run)
         {
-            size_t runs2merge = std::min(runs_left, merge_factor);
-            TLX_LOG1 << "Merging " << runs2merge << " runs";
+            const std::vector<size_t>& group = groups[cur_out_run];
+            size_t runs2merge = group.size();
 
             if (runs2merge > 1)     // non-trivial merge
             {
-                // count the number of elements in the run
-                size_type elements_in_new_run = 0;
-                for (size_t i = nruns - runs_left; i < (nruns - runs_left + runs2merge); ++i)
-                {
-                    elements_in_new_run += m_sruns->runs_sizes[i];
-                }
-                new_runs.runs_sizes[cur_out_run] = elements_in_new_run;
-
-                // calculate blocks in run
-                const size_t blocks_in_new_run = static_cast<size_t>(foxxll::div_ceil(
-                                                                         elements_in_new_run, block_type::size));
-
-                // allocate blocks for the new runs
-                new_runs.runs[cur_out_run].resize(blocks_in_new_run);
-                bm->new_blocks(alloc_strategy(), make_bid_iterator(new_runs.runs[cur_out_run].begin()), make_bid_iterator(new_runs.runs[cur_out_run].end()));
+                TLX_LOG1 << "Merging " << runs2merge << " runs";
 
                 // Construct temporary sorted_runs object as input into recursive merger.
                 // This sorted_runs is copied a subset of the over-large set of runs, which
                 // will be deallocated from external memory once the runs are merged.
                 sorted_runs_type cur_runs(new sorted_runs_data_type);
+                cur_runs->stable = m_sruns->stable;
                 cur_runs->runs.resize(runs2merge);
                 cur_runs->runs_sizes.resize(runs2merge);
 
-                std::copy(m_sruns->runs.begin() + nruns - runs_left,
-                          m_sruns->runs.begin() + nruns - runs_left + runs2merge,
-                          cur_runs->runs.begin());
-                std::copy(m_sruns->runs_sizes.begin() + nruns - runs_left,
-                          m_sruns->runs_sizes.begin() + nruns - runs_left + runs2merge,
-                          cur_runs->runs_sizes.begin());
+                // count the number of elements in the run
+                size_type elements_in_new_run = 0;
+                for (size_t i = 0; i < runs2merge; ++i)
+                {
+                    cur_runs->runs[i].swap(m_sruns->runs[group[i]]);
+                    cur_runs->runs_sizes[i] = m_sruns->runs_sizes[group[i]];
+                    elements_in_new_run += cur_runs->runs_sizes[i];
+                }
+                new_runs.runs_sizes[cur_out_run] = elements_in_new_run;
 
                 cur_runs->elements = elements_in_new_run;
                 elements_left -= elements_in_new_run;
@@ -1482,47 +2903,20 @@ void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively()
                 merger(m_cmp, m_memory_to_use - memory_for_write_buffers);
                 merger.initialize(cur_runs);
 
-                {
-                    // make sure everything is being destroyed in right time
-                    foxxll::buf_ostream<block_type, typename run_type::iterator> out(
-                        new_runs.runs[cur_out_run].begin(),
-                        nwrite_buffers);
-
-                    size_type cnt = 0;
-                    const size_type cnt_max = cur_runs->elements;
-
-                    while (cnt != cnt_max)
-                    {
-                        *out = *merger;
-                        if ((cnt % block_type::size) == 0)     // have to write the trigger value
-                            new_runs.runs[cur_out_run][static_cast<size_t>(cnt / size_type(block_type::size))].value = *merger;
-
-                        ++cnt, ++out, ++merger;
-                    }
-                    assert(merger.empty());
-
-                    while (cnt % block_type::size)
-                    {
-                        *out = m_cmp.max_value();
-                        ++out, ++cnt;
-                    }
-                }
+                write_merged_run(merger, new_runs.runs[cur_out_run],
+                                 elements_in_new_run, nwrite_buffers, run_codec());
+                span.add_bytes(elements_in_new_run * sizeof(value_type));
 
                 // deallocate merged runs by destroying cur_runs
             }
             else     // runs2merge = 1 -> no merging needed
             {
-                assert(cur_out_run + 1 == new_runs.runs.size());
-
-                elements_left -= m_sruns->runs_sizes.back();
+                elements_left -= m_sruns->runs_sizes[group[0]];
 
-                // copy block identifiers into new sorted_runs object
-                new_runs.runs.back() = m_sruns->runs.back();
-                new_runs.runs_sizes.back() = m_sruns->runs_sizes.back();
+                // move block identifiers into new sorted_runs object
+                new_runs.runs[cur_out_run].swap(m_sruns->runs[group[0]]);
+                new_runs.runs_sizes[cur_out_run] = m_sruns->runs_sizes[group[0]];
             }
-
-            runs_left -= runs2merge;
-            ++cur_out_run;
         }
 
         assert(elements_left == 0);
@@ -1532,7 +2926,7 @@ void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively()
         m_sruns->runs.clear();
 
         // replaces data in referenced counted object m_sruns end while (nruns
-        // > max_arity)
+        // > final_arity)
         std::swap(nruns, new_nruns);
         m_sruns->swap(new_runs);
     }
@@ -1546,7 +2940,7 @@ void basic_runs_merger<RunsType, CompareType, AllocStr>::merge_recursively()
 //! storing intermediate results if several merge passes are required
 template <class RunsType,
           class CompareType = typename RunsType::element_type::cmp_type,
-          class AllocStr = foxxll::default_alloc_strategy>
+          class AllocStr = runtime_alloc_strategy>
 class runs_merger : public basic_runs_merger<RunsType, CompareType, AllocStr>
 {
 protected:
@@ -1578,6 +2972,217 @@ public:
     { }
 };
 
+//! Select splitters dividing the elements of sorted runs into num_partitions
+//! key ranges of about equal size.
+//!
+//! The splitters are selected from the trigger entries of the runs, which
+//! each stand for the elements of one block, so the parts differ by a few
+//! blocks per run at most. Part i holds the elements in [splitters[i-1],
+//! splitters[i]), where the first part starts at cmp.min_value() and the last
+//! ends at cmp.max_value(). Equal splitters produce empty parts.
+//! \return num_partitions - 1 non-decreasing splitters
+template <class RunsType, class CompareType>
+std::vector<typename RunsType::element_type::value_type>
+select_run_splitters(const RunsType& sruns, size_t num_partitions, CompareType cmp)
+{
+    using value_type = typename RunsType::element_type::value_type;
+    assert(num_partitions > 0);
+
+    std::vector<value_type> splitters;
+    if (!sruns->small_run.empty())
+    {
+        // the small run is sorted, select the splitters by rank
+        const std::vector<value_type>& small_run = sruns->small_run;
+        for (size_t i = 1; i < num_partitions; ++i)
+            splitters.push_back(small_run[i * small_run.size() / num_partitions]);
+        return splitters;
+    }
+
+    std::vector<value_type> samples;
+    for (size_t r = 0; r < sruns->runs.size(); ++r)
+    {
+        for (size_t j = 0; j < sruns->runs[r].size(); ++j)
+            samples.push_back(sruns->runs[r][j].value);
+    }
+
+    if (samples.empty())
+    {
+        splitters.resize(num_partitions - 1, cmp.max_value());
+        return splitters;
+    }
+
+    for (size_t i = 1; i < num_partitions; ++i)
+    {
+        // the samples before the previous rank are already smaller
+        typename std::vector<value_type>::iterator nth =
+            samples.begin() + i * samples.size() / num_partitions;
+        std::nth_element(samples.begin() + (i - 1) * samples.size() / num_partitions,
+                         nth, samples.end(), cmp);
+        splitters.push_back(*nth);
+    }
+    return splitters;
+}
+
+//! Merges the elements of sorted runs in the key range [lower, upper).
+//!
+//! Only the blocks of each run which may hold elements of the range are
+//! read, by a runs_merger of its own. The blocks are shared with the input
+//! runs, which are kept alive and not modified, hence several range mergers
+//! on disjoint ranges of the same runs can be consumed concurrently by
+//! different threads, see \c sorter::partitioned_output().
+//!
+//! \tparam RunsType type of the sorted runs, available as \c runs_creator::sorted_runs_type ,
+//! \tparam CompareType type of comparison object used for merging
+//! \tparam AllocStr allocation strategy, unused since no merge pass is written
+template <class RunsType,
+          class CompareType = typename RunsType::element_type::cmp_type,
+          class AllocStr = runtime_alloc_strategy>
+class runs_range_merger
+{
+public:
+    using sorted_runs_type = RunsType;
+    using value_cmp = CompareType;
+    using sorted_runs_data_type = typename sorted_runs_type::element_type;
+    using value_type = typename sorted_runs_data_type::value_type;
+    using size_type = typename sorted_runs_data_type::size_type;
+    using run_type = typename sorted_runs_data_type::run_type;
+    using block_type = typename sorted_runs_data_type::block_type;
+    using trigger_entry_type = typename run_type::value_type;
+    using merger_type = runs_merger<sorted_runs_type, value_cmp, AllocStr>;
+
+    static_assert(std::is_same<typename sorted_runs_data_type::run_codec, no_run_codec>::value,
+                  "runs_range_merger requires runs of plain blocks");
+
+protected:
+    //! comparator object
+    value_cmp m_cmp;
+
+    //! upper bound of the range, exclusive
+    value_type m_upper;
+
+    //! input runs, referenced to keep their blocks alive
+    sorted_runs_type m_source;
+
+    //! the parts of the input runs overlapping the range, sharing their blocks
+    sorted_runs_type m_sruns;
+
+    //! merger of m_sruns
+    merger_type m_merger;
+
+    //! Memory needed to merge nruns runs in a single pass.
+    static size_t single_pass_memory(size_t nruns)
+    {
+        size_t disks_number = foxxll::config::get_instance()->disks_number();
+        return (nruns + 2 * disks_number) * block_type::raw_size + 2 * sizeof(block_type);
+    }
+
+public:
+    //! Creates a merger of the elements of sruns in [lower, upper).
+    //! \param sruns input sorted runs object, which is not modified
+    //! \param lower lower bound of the range, inclusive
+    //! \param upper upper bound of the range, exclusive
+    //! \param cmp comparison object
+    //! \param memory_to_use amount of memory available for the merger in
+    //! bytes, raised to one block per overlapping run plus prefetch buffers,
+    //! since a recursive merge would delete the shared blocks
+    runs_range_merger(const sorted_runs_type& sruns,
+                      const value_type& lower, const value_type& upper,
+                      value_cmp cmp, size_t memory_to_use)
+        : m_cmp(cmp),
+          m_upper(upper),
+          m_source(sruns),
+          m_sruns(new sorted_runs_data_type),
+          m_merger(cmp, memory_to_use)
+    {
+        if (!m_source->small_run.empty())
+        {
+            // small input kept in internal memory: copy the range
+            const std::vector<value_type>& small_run = m_source->small_run;
+            m_sruns->small_run.assign(
+                std::lower_bound(small_run.begin(), small_run.end(), lower, m_cmp),
+                std::lower_bound(small_run.begin(), small_run.end(), upper, m_cmp));
+            m_sruns->elements = m_sruns->small_run.size();
+        }
+        else
+        {
+            sort_helper::trigger_entry_cmp<trigger_entry_type, value_cmp> trigger_cmp(m_cmp);
+            trigger_entry_type lower_entry, upper_entry;
+            lower_entry.value = lower;
+            upper_entry.value = upper;
+
+            for (size_t r = 0; r < m_source->runs.size(); ++r)
+            {
+                const run_type& run = m_source->runs[r];
+
+                // the block before the first one starting at lower may
+                // end with elements of the range
+                size_t begin = std::lower_bound(run.begin(), run.end(), lower_entry, trigger_cmp)
+                               - run.begin();
+                if (begin > 0)
+                    --begin;
+                size_t end = std::lower_bound(run.begin() + begin, run.end(), upper_entry, trigger_cmp)
+                             - run.begin();
+                if (end <= begin)
+                    continue;
+
+                size_type elements = size_type(end - begin) * block_type::size;
+                if (end == run.size())   // last block is padded
+                    elements -= size_type(run.size()) * block_type::size - m_source->runs_sizes[r];
+
+                m_sruns->add_run(run_type(run.begin() + begin, run.begin() + end), elements);
+            }
+
+            m_merger.set_memory_to_use(
+                std::max(memory_to_use, single_pass_memory(m_sruns->runs.size())));
+        }
+
+        m_merger.initialize(m_sruns);
+
+        // skip the elements of the first blocks before the range
+        while (!m_merger.empty() && m_cmp(*m_merger, lower))
+            ++m_merger;
+    }
+
+    //! non-copyable: delete copy-constructor
+    runs_range_merger(const runs_range_merger&) = delete;
+    //! non-copyable: delete assignment operator
+    runs_range_merger& operator = (const runs_range_merger&) = delete;
+
+    ~runs_range_merger()
+    {
+        m_merger.deallocate();
+        // the blocks belong to m_source, do not delete them with m_sruns
+        m_sruns->runs.clear();
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_merger.empty() || !m_cmp(*m_merger, m_upper);
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return *m_merger;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    runs_range_merger& operator ++ ()
+    {
+        assert(!empty());
+        ++m_merger;
+        return *this;
+    }
+};
+
 ////////////////////////////////////////////////////////////////////////
 //     SORT                                                           //
 ////////////////////////////////////////////////////////////////////////
@@ -1593,7 +3198,7 @@ template <
     class Input,
     class CompareType,
     size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(typename Input::value_type),
-    class AllocStr = foxxll::default_alloc_strategy,
+    class AllocStr = runtime_alloc_strategy,
     class RunsCreatorType = runs_creator<Input, CompareType, BlockSize, AllocStr>
     >
 class sort
@@ -1602,9 +3207,34 @@ class sort
     using sorted_runs_type = typename runs_creator_type::sorted_runs_type;
     using runs_merger_type = runs_merger<sorted_runs_type, CompareType, AllocStr>;
 
+    //! shared memory budget, nullptr with fixed memory amounts
+    memory_budget* m_budget;
+    //! stages of the runs creator and the merger in m_budget
+    memory_budget::stage_id m_creator_stage, m_merger_stage;
+
     runs_creator_type creator;
     runs_merger_type merger;
 
+    //! Register both phases with the budget and start the runs creator.
+    size_t acquire_creator(memory_budget& budget)
+    {
+        m_creator_stage = budget.add_stage(runs_creator_type::min_memory_to_use());
+        m_merger_stage = budget.add_stage(
+            runs_merger_type::min_memory_to_use(), memory_budget::unlimited,
+            m_creator_stage);
+        return budget.acquire(m_creator_stage);
+    }
+
+    //! Release the memory of the merger once the output is exhausted.
+    void release_merger()
+    {
+        if (m_budget && merger.empty())
+        {
+            m_budget->release(m_merger_stage);
+            m_budget = nullptr;
+        }
+    }
+
 public:
     //! Standard stream typedef.
     using value_type = typename Input::value_type;
@@ -1614,7 +3244,8 @@ public:
     //! \param c comparator object
     //! \param memory_to_use memory amount that is allowed to used by the sorter in bytes
     sort(Input& in, CompareType c, size_t memory_to_use)
-        : creator(in, c, memory_to_use),
+        : m_budget(nullptr),
+          creator(in, c, memory_to_use),
           merger(creator.result(), c, memory_to_use)
     {
         sort_helper::verify_sentinel_strict_weak_ordering(c);
@@ -1627,12 +3258,43 @@ public:
     //! \param m_memory_to_use memory amount that is allowed to used by the merger in bytes
     sort(Input& in, CompareType c, size_t m_memory_to_userc,
          size_t m_memory_to_use)
-        : creator(in, c, m_memory_to_userc),
+        : m_budget(nullptr),
+          creator(in, c, m_memory_to_userc),
           merger(creator.result(), c, m_memory_to_use)
     {
         sort_helper::verify_sentinel_strict_weak_ordering(c);
     }
 
+    //! Creates the object with memory from a budget shared by the stages
+    //! of a pipeline. The runs creator and the merger are registered as
+    //! consecutive stages, the merger inherits the memory of the runs
+    //! creator and gets at most the memory to merge in a single pass. The
+    //! memory is released when the output is exhausted.
+    //! \param in input stream
+    //! \param c comparator object
+    //! \param budget memory budget of the pipeline
+    sort(Input& in, CompareType c, memory_budget& budget)
+        : m_budget(&budget),
+          creator(in, c, acquire_creator(budget)),
+          merger(c, 0)
+    {
+        sort_helper::verify_sentinel_strict_weak_ordering(c);
+
+        sorted_runs_type& sruns = creator.result();
+        budget.release(m_creator_stage);
+        budget.set_desired(m_merger_stage, runs_merger_type::single_pass_memory(sruns));
+        merger.set_memory_to_use(budget.acquire(m_merger_stage));
+        merger.initialize(sruns);
+        release_merger();
+    }
+
+    //! Releases the memory of a budget.
+    ~sort()
+    {
+        if (m_budget)
+            m_budget->release(m_merger_stage);
+    }
+
     //! non-copyable: delete copy-constructor
     sort(const sort&) = delete;
     //! non-copyable: delete assignment operator
@@ -1661,10 +3323,52 @@ public:
     sort& operator ++ ()
     {
         ++merger;
+        release_merger();
         return *this;
     }
+
+    //! Batch stream method.
+    size_t next_batch(value_type* out, size_t n)
+    {
+        size_t count = merger.next_batch(out, n);
+        release_merger();
+        return count;
+    }
+
+    //! Batch stream method.
+    size_t batch_size() const
+    {
+        return merger.batch_size();
+    }
+
+    //! Block stream method.
+    size_t next_block(typename runs_merger_type::out_block_type*& block)
+    {
+        size_t count = merger.next_block(block);
+        release_merger();
+        return count;
+    }
 };
 
+//! Produces a stably sorted stream from input stream: equal elements are
+//! output in their input order. The runs are formed by stable comparison
+//! sorting and always merged by the native loser tree.
+//!
+//! \tparam Input type of the input stream
+//! \tparam CompareType type of comparison object used for sorting the runs
+//! \tparam BlockSize size of blocks used to store the runs
+//! \tparam AllocStr functor that defines allocation strategy for the runs
+template <
+    class Input,
+    class CompareType,
+    size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(typename Input::value_type),
+    class AllocStr = runtime_alloc_strategy
+    >
+using stable_sort = sort<
+          Input, CompareType, BlockSize, AllocStr,
+          runs_creator<Input, CompareType, BlockSize, AllocStr, stable_comparison>
+          >;
+
 //! Computes sorted runs type from value type and block size.
 //!
 //! \tparam ValueType type of values ins sorted runs
@@ -16,15 +16,25 @@
 #define STXXL_STREAM_SORTED_RUNS_HEADER
 
 #include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <tlx/counting_ptr.hpp>
 
+#include <foxxll/io/file.hpp>
+#include <foxxll/io/request_operations.hpp>
 #include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/config.hpp>
 #include <foxxll/mng/typed_block.hpp>
 
 #include <stxxl/bits/algo/trigger_entry.h>
+#include <stxxl/bits/common/binary_buffer.h>
+#include <stxxl/bits/common/block_array.h>
+#include <stxxl/bits/common/disk_space.h>
+#include <stxxl/bits/stream/run_codec.h>
 
 namespace stxxl {
 namespace stream {
@@ -37,7 +47,11 @@ namespace stream {
 ////////////////////////////////////////////////////////////////////////
 
 //! All sorted runs of a sort operation.
-template <typename TriggerEntryType, typename CompareType>
+//!
+//! With a RunCodec other than \c no_run_codec the blocks of the runs are
+//! compressed, see \c compressed_run_writer.
+template <typename TriggerEntryType, typename CompareType,
+          typename RunCodec = no_run_codec>
 struct sorted_runs : public tlx::reference_counter
 {
     using trigger_entry_type = TriggerEntryType;
@@ -50,6 +64,7 @@ struct sorted_runs : public tlx::reference_counter
     using run_index_type = typename std::vector<run_type>::size_type;
 
     using cmp_type = CompareType;
+    using run_codec = RunCodec;
 
     //! total number of elements in all runs
     size_type elements;
@@ -66,9 +81,18 @@ struct sorted_runs : public tlx::reference_counter
     // array "small_run"
     small_run_type small_run;
 
+    //! files holding the blocks of runs restored by load(), kept open as
+    //! long as the runs. The block_manager does not delete their blocks.
+    std::vector<foxxll::file_ptr> files;
+
+    //! true if the runs hold consecutive parts of the input in order, as
+    //! formed by stable run formation, which the runs merger then merges
+    //! stably
+    bool stable;
+
 public:
     sorted_runs()
-        : elements(0)
+        : elements(0), stable(false)
     { }
 
     //! non-copyable: delete copy-constructor
@@ -90,6 +114,7 @@ public:
         runs.clear();
         runs_sizes.clear();
         small_run.clear();
+        files.clear();
     }
 
     //! Add a new run with given number of elements
@@ -100,6 +125,26 @@ public:
         elements += run_size;
     }
 
+    //! Add a new run with given number of elements, or append it to the last
+    //! run if its first element is not smaller than prev_last, the last
+    //! element of the last run. Plain runs are only concatenated if the last
+    //! run has no padding in its last block.
+    void add_run(const run_type& run, size_type run_size,
+                 const value_type& prev_last, cmp_type cmp)
+    {
+        if (runs.empty() || run.empty() || cmp(run[0].value, prev_last) ||
+            (std::is_same<run_codec, no_run_codec>::value &&
+             runs_sizes.back() % block_type::size != 0))
+        {
+            add_run(run, run_size);
+            return;
+        }
+
+        runs.back().insert(runs.back().end(), run.begin(), run.end());
+        runs_sizes.back() += run_size;
+        elements += run_size;
+    }
+
     //! Swap contents with another object. This is used by the recursive
     //! merger to swap in a sorted_runs object with fewer runs.
     void swap(sorted_runs& b)
@@ -108,9 +153,244 @@ public:
         std::swap(runs, b.runs);
         std::swap(runs_sizes, b.runs_sizes);
         std::swap(small_run, b.small_run);
+        std::swap(files, b.files);
+        std::swap(stable, b.stable);
+    }
+
+    //! \name Checkpoints
+    //! \{
+
+    //! Write a checkpoint of the runs to file, from which load() restores
+    //! them, also in a later process. The file holds a header with the run
+    //! sizes, the trigger values and the small run, followed by a copy of all
+    //! blocks of the runs. The runs themselves are not changed.
+    void save(foxxll::file_ptr file) const
+    {
+        using trigger_value_type = typename trigger_entry_type::value_type;
+
+        binary_buffer body;
+        body.put<uint64_t>(sizeof(trigger_value_type));
+        body.put<uint64_t>(sizeof(value_type));
+        body.put<uint64_t>(elements);
+        body.put<uint64_t>(runs.size());
+        body.put<uint64_t>(small_run.size());
+        size_t nblocks = 0;
+        for (size_t r = 0; r < runs.size(); ++r)
+        {
+            body.put<uint64_t>(runs[r].size());
+            body.put<uint64_t>(runs_sizes[r]);
+            for (size_t j = 0; j < runs[r].size(); ++j)
+                body.put<trigger_value_type>(runs[r][j].value);
+            nblocks += runs[r].size();
+        }
+        for (size_t i = 0; i < small_run.size(); ++i)
+            body.put<value_type>(small_run[i]);
+
+        binary_buffer header;
+        header.put<uint64_t>(checkpoint_magic());
+        header.put<uint64_t>(block_type::raw_size);
+        header.put<uint64_t>(body.size());
+        header.append(body);
+
+        const size_t header_blocks = foxxll::div_ceil(header.size(), block_type::raw_size);
+        file->set_size((header_blocks + nblocks) * block_type::raw_size);
+
+        // write the header through blocks, which are aligned for direct I/O
+        const size_t nbuffers = 2 * foxxll::config::get_instance()->disks_number();
+        const size_t nblocks_buffer = std::max(header_blocks, nbuffers);
+        block_type* blocks = new_block_array<block_type>(nblocks_buffer);
+        std::vector<foxxll::request_ptr> reqs;
+        for (size_t i = 0; i < header_blocks; ++i)
+        {
+            const size_t offset = i * block_type::raw_size;
+            const size_t n = std::min<size_t>(block_type::raw_size, header.size() - offset);
+            memcpy(static_cast<void*>(&blocks[i]), header.data() + offset, n);
+            reqs.push_back(blocks[i].write(file_bid(file, i)));
+        }
+        wait_all(reqs.begin(), reqs.end());
+
+        // copy the blocks of the runs behind the header, nbuffers at a time
+        std::vector<bid_type> src, dst;
+        for (size_t r = 0; r < runs.size(); ++r)
+        {
+            for (size_t j = 0; j < runs[r].size(); ++j)
+            {
+                src.push_back(runs[r][j].bid);
+                dst.push_back(file_bid(file, header_blocks + dst.size()));
+            }
+        }
+        for (size_t i = 0; i < src.size(); i += nbuffers)
+        {
+            const size_t n = std::min(nbuffers, src.size() - i);
+            reqs.clear();
+            for (size_t k = 0; k < n; ++k)
+                reqs.push_back(blocks[k].read(src[i + k]));
+            wait_all(reqs.begin(), reqs.end());
+            reqs.clear();
+            for (size_t k = 0; k < n; ++k)
+                reqs.push_back(blocks[k].write(dst[i + k]));
+            wait_all(reqs.begin(), reqs.end());
+        }
+
+        delete_block_array(blocks, nblocks_buffer);
+    }
+
+    //! Restore the runs from a checkpoint written by save(), replacing the
+    //! contents of this object. The blocks are not copied, the runs refer to
+    //! the blocks in file, which must not be changed as long as they are
+    //! used. Merging them does not delete the file's blocks.
+    void load(foxxll::file_ptr file)
+    {
+        using trigger_value_type = typename trigger_entry_type::value_type;
+
+        clear();
+
+        block_type* block = new_block_array<block_type>(1);
+        block->read(file_bid(file, 0))->wait();
+
+        binary_reader first(static_cast<const void*>(block), block_type::raw_size);
+        if (first.get<uint64_t>() != checkpoint_magic() ||
+            first.get<uint64_t>() != block_type::raw_size)
+        {
+            delete_block_array(block, 1);
+            throw std::runtime_error(
+                      "sorted_runs::load(): the file is no checkpoint of sorted runs with this block size");
+        }
+        const size_t body_size = first.get<uint64_t>();
+        const size_t body_offset = first.curr();
+        const size_t header_size = body_offset + body_size;
+        const size_t header_blocks = foxxll::div_ceil(header_size, block_type::raw_size);
+
+        std::vector<char> header(header_blocks * block_type::raw_size);
+        memcpy(header.data(), static_cast<const void*>(block), block_type::raw_size);
+        for (size_t i = 1; i < header_blocks; ++i)
+        {
+            block->read(file_bid(file, i))->wait();
+            memcpy(header.data() + i * block_type::raw_size,
+                   static_cast<const void*>(block), block_type::raw_size);
+        }
+        delete_block_array(block, 1);
+
+        binary_reader body(header.data() + body_offset, header_size - body_offset);
+        if (body.get<uint64_t>() != sizeof(trigger_value_type) ||
+            body.get<uint64_t>() != sizeof(value_type))
+        {
+            throw std::runtime_error(
+                      "sorted_runs::load(): the checkpoint holds values of a different type");
+        }
+
+        elements = body.get<uint64_t>();
+        runs.resize(body.get<uint64_t>());
+        small_run.resize(body.get<uint64_t>());
+        runs_sizes.resize(runs.size());
+
+        size_t next_block = header_blocks;
+        for (size_t r = 0; r < runs.size(); ++r)
+        {
+            runs[r].resize(body.get<uint64_t>());
+            runs_sizes[r] = body.get<uint64_t>();
+            for (size_t j = 0; j < runs[r].size(); ++j)
+            {
+                runs[r][j].bid = file_bid(file, next_block++);
+                runs[r][j].value = body.get<trigger_value_type>();
+            }
+        }
+        for (size_t i = 0; i < small_run.size(); ++i)
+            small_run[i] = body.get<value_type>();
+
+        files.push_back(file);
     }
 
+    //! Move all runs of other into this object, e.g. to merge runs restored
+    //! by load() together with new ones. Small runs of both objects are
+    //! written as runs of blocks first. other is empty afterwards.
+    template <typename AllocStr = foxxll::default_alloc_strategy>
+    void append(sorted_runs& other, cmp_type cmp = cmp_type())
+    {
+        write_small_run<AllocStr>(cmp, run_codec());
+        other.template write_small_run<AllocStr>(cmp, run_codec());
+
+        for (size_t r = 0; r < other.runs.size(); ++r)
+            add_run(other.runs[r], other.runs_sizes[r]);
+        files.insert(files.end(), other.files.begin(), other.files.end());
+
+        // the blocks belong to this object now
+        other.runs.clear();
+        other.clear();
+    }
+
+    //! \}
+
 private:
+    using bid_type = typename block_type::bid_type;
+
+    //! first word of a checkpoint file written by save(), "STXLRUNS"
+    static uint64_t checkpoint_magic() { return 0x5354584c52554e53ull; }
+
+    //! BID of the i-th block of a checkpoint file.
+    static bid_type file_bid(const foxxll::file_ptr& file, size_t i)
+    {
+        bid_type bid;
+        bid.storage = file.get();
+        bid.offset = i * block_type::raw_size;
+        return bid;
+    }
+
+    //! Write the small run as a run of plain blocks.
+    template <typename AllocStr>
+    void write_small_run(cmp_type cmp, no_run_codec)
+    {
+        if (small_run.empty())
+            return;
+
+        run_type run(foxxll::div_ceil(small_run.size(), block_type::size));
+        foxxll::block_manager::get_instance()->new_blocks(
+            AllocStr(), make_bid_iterator(run.begin()), make_bid_iterator(run.end()));
+
+        block_type* blocks = new_block_array<block_type>(run.size());
+        std::vector<foxxll::request_ptr> reqs;
+        for (size_t i = 0; i < run.size() * block_type::size; ++i)
+        {
+            blocks[i / block_type::size][i % block_type::size] =
+                i < small_run.size() ? small_run[i] : cmp.max_value();
+        }
+        for (size_t j = 0; j < run.size(); ++j)
+        {
+            run[j].value = blocks[j][0];
+            reqs.push_back(blocks[j].write(run[j].bid));
+        }
+        wait_all(reqs.begin(), reqs.end());
+        delete_block_array(blocks, run.size());
+
+        const size_type run_size = small_run.size();
+        small_run.clear();
+        elements -= run_size;
+        add_run(run, run_size);
+    }
+
+    //! Write the small run as a run encoded by the run codec.
+    template <typename AllocStr, typename Codec>
+    void write_small_run(cmp_type, Codec)
+    {
+        if (small_run.empty())
+            return;
+
+        run_type run;
+        {
+            compressed_run_writer<block_type, Codec, AllocStr> writer(2);
+            writer.begin_run(run);
+            for (size_t i = 0; i < small_run.size(); ++i)
+                writer.push(small_run[i]);
+            writer.end_run();
+            writer.flush();
+        }
+
+        const size_type run_size = small_run.size();
+        small_run.clear();
+        elements -= run_size;
+        add_run(run, run_size);
+    }
+
     //! Deallocates the blocks which the runs occupy.
     //!
     //! \remark There is no need in calling this method, the blocks are
@@ -118,11 +398,11 @@ private:
     //! object, then this function can be used to clear its state.
     void deallocate_blocks()
     {
-        foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+        disk_space_reclaimer& reclaimer = disk_space_reclaimer::get_instance();
         for (size_t i = 0; i < runs.size(); ++i)
         {
-            bm->delete_blocks(make_bid_iterator(runs[i].begin()),
-                              make_bid_iterator(runs[i].end()));
+            reclaimer.delete_blocks(make_bid_iterator(runs[i].begin()),
+                                    make_bid_iterator(runs[i].end()));
         }
     }
 };
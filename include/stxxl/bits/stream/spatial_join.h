@@ -0,0 +1,271 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/spatial_join.h
+ *
+ *  Plane-sweep join of rectangles and points with a striped sweep line as
+ *  described in Lars Arge et al. "Scalable Sweeping-Based Spatial Join".
+ *  VLDB 1998.
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_SPATIAL_JOIN_HEADER
+#define STXXL_STREAM_SPATIAL_JOIN_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     PLANE_SWEEP_JOIN                                               //
+////////////////////////////////////////////////////////////////////////
+
+//! Join of a stream of rectangles with a stream of points, delivering a
+//! std::pair (r, p) for each point p contained in the closed rectangle r.
+//!
+//! The inputs are swept in ascending y: the rectangles must be sorted by
+//! y_min and the points by y. The active rectangles, which the sweep line
+//! intersects, are held in internal memory, distributed over num_strips
+//! vertical strips of equal width covering [x_begin, x_end]. A rectangle is
+//! stored in each strip it overlaps, and a point only scans the rectangles
+//! of its strip, from which the rectangles below the sweep line are removed
+//! lazily. Coordinates outside of [x_begin, x_end] are joined correctly,
+//! but fall into the first or last strip. The pairs of a point are
+//! delivered in arbitrary order.
+//!
+//! Use stream::sort to order unsorted inputs, or stxxl::spatial_join() to
+//! run the sorts and the sweep.
+//!
+//! \tparam RectangleInput stream of rectangles with unsigned members x_min,
+//!         y_min, x_max and y_max
+//! \tparam PointInput stream of points with unsigned members x and y
+template <class RectangleInput, class PointInput>
+class plane_sweep_join
+{
+public:
+    using rectangle_type = typename RectangleInput::value_type;
+    using point_type = typename PointInput::value_type;
+
+    //! Standard stream typedef.
+    using value_type = std::pair<rectangle_type, point_type>;
+
+private:
+    static constexpr bool debug = false;
+
+    RectangleInput& m_rectangles;
+    PointInput& m_points;
+
+    //! first coordinate of the strips
+    uint64_t m_x_begin;
+
+    //! width of each strip
+    uint64_t m_strip_width;
+
+    //! active rectangles of each strip, possibly below the sweep line
+    std::vector<std::vector<rectangle_type> > m_strips;
+
+    //! rectangles stored in all strips
+    size_t m_stored;
+
+    //! m_stored at which the rectangles below the sweep line are removed
+    //! from all strips
+    size_t m_purge_threshold;
+
+    //! strip of the current point, and position of its next rectangle
+    size_t m_strip, m_pos;
+
+    //! current element
+    value_type m_current;
+
+    //! true if no more pairs exist
+    bool m_empty;
+
+    //! Strip containing the coordinate x.
+    template <typename Coord>
+    size_t strip_of(const Coord& x) const
+    {
+        const uint64_t ux = static_cast<uint64_t>(x);
+        if (ux <= m_x_begin)
+            return 0;
+        return std::min<size_t>(
+            static_cast<size_t>((ux - m_x_begin) / m_strip_width), m_strips.size() - 1);
+    }
+
+    //! Remove the rectangles below y from all strips.
+    template <typename Coord>
+    void purge(const Coord& y)
+    {
+        m_stored = 0;
+        for (std::vector<rectangle_type>& strip : m_strips)
+        {
+            strip.erase(std::remove_if(strip.begin(), strip.end(),
+                                       [&y](const rectangle_type& r) { return r.y_max < y; }),
+                        strip.end());
+            m_stored += strip.size();
+        }
+        m_purge_threshold = std::max<size_t>(2 * m_stored, 1024);
+
+        TLX_LOG << "plane_sweep_join: " << m_stored << " rectangles stored after purge";
+    }
+
+    //! Insert the rectangles reaching the sweep line at the current point.
+    void insert_rectangles()
+    {
+        const point_type& p = *m_points;
+        while (!m_rectangles.empty() && !(p.y < (*m_rectangles).y_min))
+        {
+            const rectangle_type& r = *m_rectangles;
+            if (!(r.y_max < p.y) && !(r.x_max < r.x_min))
+            {
+                const size_t last = strip_of(r.x_max);
+                for (size_t s = strip_of(r.x_min); s <= last; ++s)
+                    m_strips[s].push_back(r);
+                m_stored += last - strip_of(r.x_min) + 1;
+            }
+            ++m_rectangles;
+        }
+        if (m_stored >= m_purge_threshold)
+            purge(p.y);
+    }
+
+    //! Set m_current to the next rectangle of the strip of the current
+    //! point containing it, starting at m_pos. Returns false if there is
+    //! none.
+    bool scan_strip()
+    {
+        const point_type& p = *m_points;
+        std::vector<rectangle_type>& strip = m_strips[m_strip];
+        while (m_pos < strip.size())
+        {
+            const rectangle_type& r = strip[m_pos];
+            if (r.y_max < p.y)
+            {
+                // below the sweep line: remove lazily
+                strip[m_pos] = strip.back();
+                strip.pop_back();
+                --m_stored;
+                continue;
+            }
+            if (!(p.x < r.x_min) && !(r.x_max < p.x))
+            {
+                m_current.first = r;
+                m_current.second = p;
+                return true;
+            }
+            ++m_pos;
+        }
+        return false;
+    }
+
+    //! Advance the point input to the next point contained in a rectangle.
+    void find_match()
+    {
+        while (!m_points.empty())
+        {
+            insert_rectangles();
+            m_strip = strip_of((*m_points).x);
+            m_pos = 0;
+            if (scan_strip())
+            {
+                m_empty = false;
+                return;
+            }
+            ++m_points;
+        }
+        m_empty = true;
+    }
+
+public:
+    //! Join the streams rectangles and points, using num_strips strips of
+    //! the sweep line over [x_begin, x_end].
+    plane_sweep_join(RectangleInput& rectangles, PointInput& points,
+                     size_t num_strips = 1024,
+                     uint64_t x_begin = 0, uint64_t x_end = UINT32_MAX)
+        : m_rectangles(rectangles), m_points(points),
+          m_x_begin(x_begin), m_stored(0), m_purge_threshold(1024),
+          m_strip(0), m_pos(0), m_empty(true)
+    {
+        if (num_strips == 0)
+            throw foxxll::bad_parameter(
+                      "stxxl::stream::plane_sweep_join(): num_strips must be positive");
+        if (x_end < x_begin)
+            throw foxxll::bad_parameter(
+                      "stxxl::stream::plane_sweep_join(): x_end is before x_begin");
+
+        m_strip_width = (x_end - x_begin) / num_strips + 1;
+        m_strips.resize(static_cast<size_t>(
+                            std::min<uint64_t>(num_strips, (x_end - x_begin) / m_strip_width + 1)));
+
+        find_match();
+    }
+
+    //! non-copyable: delete copy-constructor
+    plane_sweep_join(const plane_sweep_join&) = delete;
+    //! non-copyable: delete assignment operator
+    plane_sweep_join& operator = (const plane_sweep_join&) = delete;
+
+    //! Standard stream method.
+    plane_sweep_join& operator ++ ()
+    {
+        assert(!m_empty);
+
+        ++m_pos;
+        if (scan_strip())
+            return *this;
+
+        // rectangles exhausted for the current point
+        ++m_points;
+        find_match();
+        return *this;
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!m_empty);
+        return m_current;
+    }
+
+    //! Standard stream method.
+    const value_type* operator -> () const
+    {
+        return &operator * ();
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_empty;
+    }
+
+    //! Number of active rectangles stored in all strips, counting each
+    //! strip a rectangle is stored in.
+    size_t stored_rectangles() const
+    {
+        return m_stored;
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_SPATIAL_JOIN_HEADER
@@ -16,8 +16,12 @@
 #ifndef STXXL_STREAM_STREAM_HEADER
 #define STXXL_STREAM_STREAM_HEADER
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <tlx/define.hpp>
 #include <tlx/meta/apply_tuple.hpp>
@@ -26,6 +30,7 @@
 #include <tlx/meta/vmap_foreach_tuple.hpp>
 
 #include <foxxll/common/error_handling.hpp>
+#include <foxxll/io/request_operations.hpp>
 #include <foxxll/mng/buf_istream.hpp>
 #include <foxxll/mng/buf_ostream.hpp>
 
@@ -39,6 +44,195 @@ namespace stream {
 //! \addtogroup streampack
 //! \{
 
+////////////////////////////////////////////////////////////////////////
+//     BATCH INTERFACE                                                //
+////////////////////////////////////////////////////////////////////////
+
+//! \name Batch Interface
+//!
+//! Besides operator*() and operator++(), a stream may deliver its values in
+//! batches by the optional methods
+//!
+//! - size_t next_batch(value_type* out, size_t n): copy up to n > 0 next
+//!   values to out and advance the stream past them. Returns the number of
+//!   values copied, which is zero only if the stream is empty, and may be less
+//!   than n, e.g. at the end of a block.
+//! - size_t batch_size() const: the number of values the stream delivers
+//!   efficiently per call of next_batch(), e.g. the values of one block.
+//!
+//! Stages implement them natively if they hold their values in blocks or
+//! buffers. The free functions next_batch() and batch_size() use them if
+//! available, and otherwise fall back to the element interface, while
+//! batch2stream provides the element interface for a stream which only
+//! implements next_batch().
+//! \{
+
+//! Trait which is true if Stream implements next_batch().
+template <typename Stream, typename = void>
+struct has_next_batch : std::false_type { };
+
+template <typename Stream>
+struct has_next_batch<
+    Stream, decltype(void(std::declval<Stream&>().next_batch(
+                              std::declval<typename Stream::value_type*>(), size_t())))>
+    : std::true_type { };
+
+//! Trait which is true if Stream implements batch_size().
+template <typename Stream, typename = void>
+struct has_batch_size : std::false_type { };
+
+template <typename Stream>
+struct has_batch_size<
+    Stream, decltype(void(std::declval<const Stream&>().batch_size()))>
+    : std::true_type { };
+
+//! Trait which is true if Stream hands over whole blocks of its input by a
+//! method next_blocks(BlockType* blocks, size_t nblocks), which reads up to
+//! nblocks blocks directly into blocks and returns their number, zero if the
+//! stream is not at a block boundary.
+template <typename Stream, typename BlockType, typename = void>
+struct has_next_blocks : std::false_type { };
+
+template <typename Stream, typename BlockType>
+struct has_next_blocks<
+    Stream, BlockType, decltype(void(std::declval<Stream&>().next_blocks(
+                                         std::declval<BlockType*>(), size_t())))>
+    : std::true_type { };
+
+//! Trait which is true if Stream hands over its output blocks by a method
+//! next_block(BlockType*& block), which swaps block with a full block of its
+//! next values and returns their number, zero if no full block is available.
+template <typename Stream, typename BlockType, typename = void>
+struct has_next_block : std::false_type { };
+
+template <typename Stream, typename BlockType>
+struct has_next_block<
+    Stream, BlockType, decltype(void(std::declval<Stream&>().next_block(
+                                         std::declval<BlockType*&>())))>
+    : std::true_type { };
+
+//! Copy up to n > 0 next values of the stream to out, by its next_batch()
+//! method. Returns the number of values copied, zero only if the stream is
+//! empty.
+template <typename Stream>
+typename std::enable_if<has_next_batch<Stream>::value, size_t>::type
+next_batch(Stream& in, typename Stream::value_type* out, size_t n)
+{
+    return in.next_batch(out, n);
+}
+
+//! Copy up to n > 0 next values of the stream to out, by the element
+//! interface. Returns the number of values copied, zero only if the stream
+//! is empty.
+template <typename Stream>
+typename std::enable_if<!has_next_batch<Stream>::value, size_t>::type
+next_batch(Stream& in, typename Stream::value_type* out, size_t n)
+{
+    size_t i = 0;
+    for ( ; i < n && !in.empty(); ++i, ++in)
+        out[i] = *in;
+    return i;
+}
+
+//! Number of values the stream delivers efficiently per call of
+//! next_batch(), by its batch_size() method.
+template <typename Stream>
+typename std::enable_if<has_batch_size<Stream>::value, size_t>::type
+batch_size(const Stream& in)
+{
+    return std::max<size_t>(in.batch_size(), 1);
+}
+
+//! Number of values the stream delivers efficiently per call of
+//! next_batch(), 1024 for streams without a batch_size() method.
+template <typename Stream>
+typename std::enable_if<!has_batch_size<Stream>::value, size_t>::type
+batch_size(const Stream&)
+{
+    return 1024;
+}
+
+//! A model of stream that provides the element interface for an input which
+//! only implements next_batch(), by reading batches of batch_size(input)
+//! values into a buffer. A call of next_batch() returns the rest of the
+//! buffer, or passes the call on to the input once the buffer is read.
+template <typename BatchInput>
+class batch2stream
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename BatchInput::value_type;
+
+private:
+    BatchInput& m_input;
+    std::vector<value_type> m_buffer;
+    size_t m_pos, m_size;
+
+    void fill()
+    {
+        m_pos = 0;
+        m_size = m_input.next_batch(m_buffer.data(), m_buffer.size());
+    }
+
+public:
+    explicit batch2stream(BatchInput& input)
+        : m_input(input), m_buffer(stream::batch_size(input))
+    {
+        fill();
+    }
+
+    //! Standard stream method.
+    const value_type& operator * () const
+    {
+        assert(!empty());
+        return m_buffer[m_pos];
+    }
+
+    const value_type* operator -> () const
+    {
+        return &(operator * ());
+    }
+
+    //! Standard stream method.
+    batch2stream& operator ++ ()
+    {
+        assert(!empty());
+        if (TLX_UNLIKELY(++m_pos == m_size))
+            fill();
+        return *this;
+    }
+
+    //! Standard stream method.
+    bool empty() const
+    {
+        return m_pos == m_size;
+    }
+
+    //! Batch stream method.
+    size_t next_batch(value_type* out, size_t n)
+    {
+        if (m_pos == m_size)
+            return m_input.next_batch(out, n);
+
+        n = std::min(n, m_size - m_pos);
+        std::copy(m_buffer.begin() + m_pos, m_buffer.begin() + m_pos + n, out);
+        if ((m_pos += n) == m_size)
+        {
+            // continue with the input, unless it is empty
+            fill();
+        }
+        return n;
+    }
+
+    //! Batch stream method.
+    size_t batch_size() const
+    {
+        return m_buffer.size();
+    }
+};
+
+//! \}
+
 ////////////////////////////////////////////////////////////////////////
 //     STREAMIFY                                                      //
 ////////////////////////////////////////////////////////////////////////
@@ -87,6 +281,15 @@ public:
     {
         return (m_current == m_end);
     }
+
+    //! Batch stream method.
+    size_t next_batch(value_type* out, size_t n)
+    {
+        size_t i = 0;
+        for ( ; i < n && m_current != m_end; ++i, ++m_current)
+            out[i] = *m_current;
+        return i;
+    }
 };
 
 //! Input iterator range to stream converter.
@@ -114,13 +317,36 @@ struct streamify_traits
 template <typename InputIterator>
 class vector_iterator2stream
 {
+public:
+    //! type of the vector's blocks, which next_blocks() reads
+    using block_type = typename InputIterator::block_type;
+
+private:
     InputIterator m_current, m_end;
-    using buf_istream_type = foxxll::buf_istream<typename InputIterator::block_type,
+    using buf_istream_type = foxxll::buf_istream<block_type,
                                                  typename InputIterator::bids_container_iterator>;
 
     using buf_istream_unique_ptr_type = std::unique_ptr<buf_istream_type>;
     mutable buf_istream_unique_ptr_type in;
 
+    //! number of blocks used for overlapped reading
+    size_t m_nbuffers;
+
+    //! Start the buffered reading at the current value. It is delayed until
+    //! the first value is accessed, so that next_blocks() may read whole
+    //! blocks without it.
+    void open_stream() const
+    {
+        typename InputIterator::bids_container_iterator end_iter
+            = m_end.bid() + ((m_end.block_offset()) ? 1 : 0);
+
+        in.reset(new buf_istream_type(m_current.bid(), end_iter, m_nbuffers));
+
+        // skip the beginning of the block
+        for (size_t i = 0; i < m_current.block_offset(); ++i)
+            ++(*in);
+    }
+
     void delete_stream()
     {
         in.reset();      // delete object
@@ -133,27 +359,14 @@ public:
     vector_iterator2stream(InputIterator begin, InputIterator end,
                            size_t nbuffers = 0)
         : m_current(begin), m_end(end),
-          in(static_cast<buf_istream_type*>(nullptr))
+          in(static_cast<buf_istream_type*>(nullptr)),
+          m_nbuffers(nbuffers ? nbuffers :
+                     (2 * foxxll::config::get_instance()->disks_number()))
     {
         if (empty())
             return;
 
         begin.flush();         // flush container
-        typename InputIterator::bids_container_iterator end_iter
-            = end.bid() + ((end.block_offset()) ? 1 : 0);
-
-        if (end_iter - begin.bid() > 0)
-        {
-            in.reset(new buf_istream_type(
-                         begin.bid(), end_iter, nbuffers ? nbuffers :
-                         (2 * foxxll::config::get_instance()->disks_number())));
-
-            InputIterator cur = begin - begin.block_offset();
-
-            // skip the beginning of the block
-            for ( ; cur != begin; ++cur)
-                ++(*in);
-        }
     }
 
     //! non-copyable: delete copy-constructor
@@ -168,18 +381,22 @@ public:
     //! Standard stream method.
     const value_type& operator * () const
     {
+        if (TLX_UNLIKELY(!in))
+            open_stream();
         return **in;
     }
 
     const value_type* operator -> () const
     {
-        return &(**in);
+        return &(operator * ());
     }
 
     //! Standard stream method.
     vector_iterator2stream& operator ++ ()
     {
         assert(m_end != m_current);
+        if (TLX_UNLIKELY(!in))
+            open_stream();
         ++m_current;
         ++(*in);
         if (TLX_UNLIKELY(empty()))
@@ -194,6 +411,28 @@ public:
         return (m_current == m_end);
     }
 
+    //! Block stream method: read up to nblocks whole blocks of the vector
+    //! directly into blocks, without copying the values. Only possible at a
+    //! block boundary before the buffered reading of single values started,
+    //! returns the number of blocks read, zero otherwise.
+    size_t next_blocks(block_type* blocks, size_t nblocks)
+    {
+        if (in || m_current.block_offset() != 0)
+            return 0;
+
+        nblocks = std::min<size_t>(
+            nblocks, static_cast<size_t>(m_end - m_current) / block_type::size);
+
+        std::vector<foxxll::request_ptr> reqs(nblocks);
+        typename InputIterator::bids_container_iterator bid = m_current.bid();
+        for (size_t i = 0; i < nblocks; ++i, ++bid)
+            reqs[i] = blocks[i].read(*bid);
+        foxxll::wait_all(reqs.begin(), reqs.end());
+
+        m_current += nblocks * block_type::size;
+        return nblocks;
+    }
+
     virtual ~vector_iterator2stream()
     {
         delete_stream();          // not needed actually
@@ -609,13 +848,31 @@ public:
     {
         return (A.empty() && B.empty());
     }
+
+    //! Batch stream method.
+    size_t next_batch(value_type* out, size_t n)
+    {
+        if (!A.empty())
+            return stream::next_batch(A, out, n);
+        return stream::next_batch(B, out, n);
+    }
+
+    //! Batch stream method.
+    size_t batch_size() const
+    {
+        return std::max(stream::batch_size(A), stream::batch_size(B));
+    }
 };
 
 } // namespace stream
 } // namespace stxxl
 
 #include <stxxl/bits/stream/choose.h>
+#include <stxxl/bits/stream/join.h>
 #include <stxxl/bits/stream/materialize.h>
+#include <stxxl/bits/stream/merge.h>
+#include <stxxl/bits/stream/sample.h>
+#include <stxxl/bits/stream/sketch.h>
 #include <stxxl/bits/stream/unique.h>
 
 #endif // !STXXL_STREAM_STREAM_HEADER
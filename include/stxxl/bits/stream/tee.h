@@ -0,0 +1,271 @@
+/***************************************************************************
+ *  include/stxxl/bits/stream/tee.h
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef STXXL_STREAM_TEE_HEADER
+#define STXXL_STREAM_TEE_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <stxxl/bits/defines.h>
+#include <stxxl/vector>
+
+namespace stxxl {
+
+//! Stream package subnamespace.
+namespace stream {
+
+//! \addtogroup streampack
+//! \{
+
+////////////////////////////////////////////////////////////////////////
+//     TEE                                                            //
+////////////////////////////////////////////////////////////////////////
+
+//! Fan-out stage which delivers each value of its input stream to several
+//! output streams, such that the input is read only once, e.g. to sort it by
+//! two different keys.
+//!
+//! The outputs may be consumed at different speeds. The values between the
+//! slowest and the fastest output are buffered in internal memory, up to
+//! memory_to_use bytes. When the gap grows beyond, the oldest buffered
+//! values are spilled by whole blocks to an external vector, from which the
+//! slower outputs read them through a page cache of one block per output.
+//! The spilled values are dropped once all outputs passed them.
+//!
+//! \tparam Input input stream
+//! \tparam BlockSize block size of the spilled values
+template <class Input,
+          size_t BlockSize = STXXL_DEFAULT_BLOCK_SIZE(typename Input::value_type)>
+class tee
+{
+public:
+    //! Standard stream typedef.
+    using value_type = typename Input::value_type;
+
+    //! external vector holding spilled values
+    using spill_type = stxxl::vector<value_type, 1, lru_pager<2>, BlockSize>;
+    using block_type = typename spill_type::block_type;
+
+    //! One of the output streams of the tee, which reads all values of the
+    //! input.
+    class output_type
+    {
+    public:
+        //! Standard stream typedef.
+        using value_type = typename Input::value_type;
+
+    private:
+        tee& m_tee;
+
+        //! index of the current value in the input
+        uint64_t m_pos;
+
+        //! current value
+        value_type m_current;
+
+    public:
+        explicit output_type(tee& t)
+            : m_tee(t), m_pos(0)
+        {
+            if (!empty())
+                m_current = m_tee.value_at(m_pos);
+        }
+
+        //! non-copyable: delete copy-constructor
+        output_type(const output_type&) = delete;
+        //! non-copyable: delete assignment operator
+        output_type& operator = (const output_type&) = delete;
+
+        //! Standard stream method.
+        const value_type& operator * () const
+        {
+            assert(!empty());
+            return m_current;
+        }
+
+        //! Standard stream method.
+        const value_type* operator -> () const
+        {
+            return &(operator * ());
+        }
+
+        //! Standard stream method.
+        output_type& operator ++ ()
+        {
+            assert(!empty());
+            m_tee.advance(m_pos);
+            if (!empty())
+                m_current = m_tee.value_at(m_pos);
+            return *this;
+        }
+
+        //! Standard stream method.
+        bool empty() const
+        {
+            return m_tee.empty_at(m_pos);
+        }
+
+        //! Number of values this output read.
+        uint64_t position() const
+        {
+            return m_pos;
+        }
+    };
+
+private:
+    Input& m_input;
+
+    //! output streams
+    std::vector<std::unique_ptr<output_type> > m_outputs;
+
+    //! maximum number of values buffered in internal memory
+    size_t m_max_buffered;
+
+    //! newest values read from the input, from index m_memory_begin
+    std::deque<value_type> m_memory;
+
+    //! spilled older values, from index m_spill_begin up to m_memory_begin
+    spill_type m_spill;
+
+    //! index of the first value in m_spill
+    uint64_t m_spill_begin;
+
+    //! index of the first value in m_memory
+    uint64_t m_memory_begin;
+
+    //! number of values read from the input
+    uint64_t m_end;
+
+    //! position of the slowest output
+    uint64_t m_min_pos;
+
+    //! Read the next value from the input, and spill the oldest block of
+    //! buffered values if the buffer is full.
+    void pull()
+    {
+        m_memory.push_back(*m_input);
+        ++m_input;
+        ++m_end;
+
+        if (m_memory.size() > m_max_buffered)
+        {
+            m_spill.append(m_memory.begin(), m_memory.begin() + block_type::size);
+            m_memory.erase(m_memory.begin(), m_memory.begin() + block_type::size);
+            m_memory_begin += block_type::size;
+        }
+    }
+
+    //! Value at index pos of the input, which is read if necessary.
+    const value_type& value_at(uint64_t pos)
+    {
+        assert(pos >= m_spill_begin && pos <= m_end);
+        if (pos == m_end)
+            pull();
+        if (pos >= m_memory_begin)
+            return m_memory[static_cast<size_t>(pos - m_memory_begin)];
+
+        const spill_type& spill = m_spill;
+        return spill[pos - m_spill_begin];
+    }
+
+    //! Whether the input has no value at index pos.
+    bool empty_at(uint64_t pos) const
+    {
+        return pos == m_end && m_input.empty();
+    }
+
+    //! Advance an output, and drop the values all outputs passed once the
+    //! slowest one moves on.
+    void advance(uint64_t& pos)
+    {
+        const bool slowest = (pos == m_min_pos);
+        ++pos;
+        if (!slowest)
+            return;
+
+        uint64_t min_pos = pos;
+        for (const std::unique_ptr<output_type>& out : m_outputs)
+        {
+            if (out)
+                min_pos = std::min(min_pos, out->position());
+        }
+        m_min_pos = min_pos;
+
+        if (m_min_pos < m_memory_begin)
+            return;
+
+        if (m_spill_begin != m_memory_begin)
+            m_spill.clear();
+
+        while (m_memory_begin < m_min_pos && !m_memory.empty())
+        {
+            m_memory.pop_front();
+            ++m_memory_begin;
+        }
+        m_spill_begin = m_memory_begin;
+    }
+
+public:
+    //! Construct a tee with num_outputs output streams.
+    //! \param input input stream
+    //! \param num_outputs number of output streams
+    //! \param memory_to_use bytes of internal memory for buffered values
+    tee(Input& input, size_t num_outputs, size_t memory_to_use)
+        : m_input(input),
+          m_spill(0, num_outputs + 1),
+          m_spill_begin(0), m_memory_begin(0), m_end(0), m_min_pos(0)
+    {
+        const size_t cache_memory = (num_outputs + 1) * BlockSize;
+        m_max_buffered = std::max<size_t>(
+            (memory_to_use > cache_memory ? memory_to_use - cache_memory : 0)
+            / sizeof(value_type),
+            2 * block_type::size);
+
+        m_outputs.resize(num_outputs);
+        for (std::unique_ptr<output_type>& out : m_outputs)
+            out.reset(new output_type(*this));
+    }
+
+    //! non-copyable: delete copy-constructor
+    tee(const tee&) = delete;
+    //! non-copyable: delete assignment operator
+    tee& operator = (const tee&) = delete;
+
+    //! Output stream number i.
+    output_type& output(size_t i)
+    {
+        assert(i < m_outputs.size());
+        return *m_outputs[i];
+    }
+
+    //! Number of output streams.
+    size_t num_outputs() const
+    {
+        return m_outputs.size();
+    }
+
+    //! Number of values currently spilled to external memory.
+    uint64_t spilled() const
+    {
+        return m_spill.size();
+    }
+};
+
+//! \}
+
+} // namespace stream
+} // namespace stxxl
+
+#endif // !STXXL_STREAM_TEE_HEADER
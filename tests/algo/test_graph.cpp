@@ -0,0 +1,196 @@
+/***************************************************************************
+ *  tests/algo/test_graph.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example algo/test_graph.cpp
+//! Test \c stxxl::breadth_first_search() and \c stxxl::connected_components()
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/graph>
+#include <stxxl/vector>
+
+using node_type = uint32_t;
+using dist_type = uint32_t;
+using edge_list = std::vector<std::pair<node_type, node_type> >;
+
+//! random edges, and some duplicates and self-loops
+edge_list random_graph(size_t n, size_t m, std::mt19937_64& rng)
+{
+    edge_list edges;
+    for (size_t k = 0; k < m; ++k)
+        edges.emplace_back(rng() % n, rng() % n);
+    for (size_t k = 0; k < m / 100; ++k)
+    {
+        edges.push_back(edges[rng() % m]);
+        const node_type v = rng() % n;
+        edges.emplace_back(v, v);
+    }
+    return edges;
+}
+
+std::vector<std::vector<node_type> > adjacency(size_t n, const edge_list& edges)
+{
+    std::vector<std::vector<node_type> > adj(n);
+    for (const auto& e : edges)
+    {
+        adj[e.first].push_back(e.second);
+        adj[e.second].push_back(e.first);
+    }
+    return adj;
+}
+
+template <typename EdgeVector>
+void test_bfs(size_t n, const edge_list& edges, const EdgeVector& edge_vector,
+              node_type source, size_t M)
+{
+    LOG1 << "breadth_first_search() of " << n << " nodes and " << edges.size() << " edges";
+
+    const std::vector<std::vector<node_type> > adj = adjacency(n, edges);
+    std::vector<dist_type> ref(n, std::numeric_limits<dist_type>::max());
+    std::deque<node_type> queue(1, source);
+    ref[source] = 0;
+    while (!queue.empty())
+    {
+        const node_type v = queue.front();
+        queue.pop_front();
+        for (node_type w : adj[v])
+        {
+            if (ref[w] == std::numeric_limits<dist_type>::max()) {
+                ref[w] = ref[v] + 1;
+                queue.push_back(w);
+            }
+        }
+    }
+
+    for (stxxl::bfs_algorithm algo : { stxxl::bfs_algorithm::munagala_ranade,
+                                       stxxl::bfs_algorithm::mehlhorn_meyer })
+    {
+        stxxl::vector<dist_type> dist;
+        stxxl::graph_profile profile;
+        stxxl::breadth_first_search(edge_vector, n, source, dist, M, algo, &profile);
+        die_unless(!profile.empty());
+        die_unequal(dist.size(), n);
+        for (size_t v = 0; v < n; ++v)
+            die_unequal(dist[v], ref[v]);
+    }
+}
+
+template <typename EdgeVector>
+void test_components(size_t n, const edge_list& edges, const EdgeVector& edge_vector, size_t M)
+{
+    LOG1 << "connected_components() of " << n << " nodes and " << edges.size() << " edges";
+
+    const std::vector<std::vector<node_type> > adj = adjacency(n, edges);
+    std::vector<node_type> ref(n, std::numeric_limits<node_type>::max());
+    for (size_t s = 0; s < n; ++s)
+    {
+        if (ref[s] != std::numeric_limits<node_type>::max())
+            continue;
+        std::vector<node_type> stack(1, s);
+        ref[s] = s;
+        while (!stack.empty())
+        {
+            const node_type v = stack.back();
+            stack.pop_back();
+            for (node_type w : adj[v])
+            {
+                if (ref[w] == std::numeric_limits<node_type>::max())
+                    ref[w] = s, stack.push_back(w);
+            }
+        }
+    }
+
+    stxxl::vector<node_type> component;
+    stxxl::connected_components(edge_vector, n, component, M);
+    die_unequal(component.size(), n);
+    for (size_t v = 0; v < n; ++v)
+        die_unequal(component[v], ref[v]);
+}
+
+void test_graph(size_t n, const edge_list& edges, node_type source, size_t M)
+{
+    // pairs and tuples of different width
+    stxxl::vector<std::pair<node_type, node_type> > pairs(edges.size());
+    std::copy(edges.begin(), edges.end(), pairs.begin());
+
+    stxxl::vector<std::tuple<uint64_t, uint64_t> > tuples(edges.size());
+    for (size_t k = 0; k < edges.size(); ++k)
+        tuples[k] = std::make_tuple(edges[k].first, edges[k].second);
+
+    if (n != 0) {
+        test_bfs(n, edges, pairs, source, M);
+        test_bfs(n, edges, tuples, source, M);
+    }
+    test_components(n, edges, pairs, M);
+    test_components(n, edges, tuples, M);
+}
+
+int main()
+{
+    // small enough for several rounds of contraction
+    const size_t M = 1024 * 1024;
+    std::mt19937_64 rng(42);
+
+    test_graph(0, { }, 0, M);
+    test_graph(1, { }, 0, M);
+    test_graph(1, { std::make_pair(0, 0) }, 0, M);
+
+    for (size_t n : { 100, 200000 })
+    {
+        // sparse graphs below and above the giant component threshold
+        test_graph(n, random_graph(n, n / 4, rng), 0, M);
+        test_graph(n, random_graph(n, n * 3 / 2, rng), n / 2, M);
+
+        // a path in random order, and two disjoint stars
+        edge_list path;
+        for (size_t v = 1; v < n; ++v)
+            path.emplace_back(v - 1, v);
+        std::shuffle(path.begin(), path.end(), rng);
+        test_graph(n, path, n / 3, M);
+
+        edge_list stars;
+        for (size_t v = 2; v < n; ++v)
+            stars.emplace_back(v, v % 2);
+        test_graph(n, stars, 1, M);
+    }
+
+    // source and endpoints out of range
+    stxxl::vector<std::pair<node_type, node_type> > bad(1);
+    bad[0] = std::make_pair(0, 5);
+    stxxl::vector<dist_type> dist;
+    stxxl::vector<node_type> component;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        bool thrown = false;
+        try {
+            if (k == 2)
+                stxxl::connected_components(bad, 5, component, M);
+            else
+                stxxl::breadth_first_search(bad, 5, k == 0 ? 5 : 0, dist, M);
+        }
+        catch (const foxxll::bad_parameter&) {
+            thrown = true;
+        }
+        die_unless(thrown);
+    }
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+/***************************************************************************
+ *  tests/algo/test_list_rank.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example algo/test_list_rank.cpp
+//! Test \c stxxl::list_rank() and \c stxxl::euler_tour()
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/list_rank>
+#include <stxxl/vector>
+
+using node_type = uint64_t;
+using rank_type = int64_t;
+
+//! random lists of the given lengths over a random permutation of the nodes
+std::vector<node_type> random_lists(const std::vector<size_t>& lengths, std::mt19937_64& rng)
+{
+    const size_t n = std::accumulate(lengths.begin(), lengths.end(), size_t(0));
+    std::vector<node_type> perm(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::shuffle(perm.begin(), perm.end(), rng);
+
+    std::vector<node_type> succ(n);
+    size_t begin = 0;
+    for (size_t len : lengths)
+    {
+        for (size_t k = begin; k + 1 < begin + len; ++k)
+            succ[perm[k]] = perm[k + 1];
+        succ[perm[begin + len - 1]] = perm[begin + len - 1];
+        begin += len;
+    }
+    return succ;
+}
+
+void test_list_rank(const std::vector<node_type>& succ, std::mt19937_64& rng, size_t M)
+{
+    const size_t n = succ.size();
+    LOG1 << "list_rank() of " << n << " nodes";
+
+    stxxl::vector<node_type> succ_vector(n);
+    std::copy(succ.begin(), succ.end(), succ_vector.begin());
+
+    std::vector<rank_type> weight(n);
+    for (rank_type& w : weight)
+        w = static_cast<rank_type>(rng() % 7) - 3;
+    stxxl::vector<rank_type> weight_vector(n);
+    std::copy(weight.begin(), weight.end(), weight_vector.begin());
+
+    // rank naively by following the successors from the tails backwards
+    std::vector<node_type> pred(n, n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (succ[i] != i)
+            pred[succ[i]] = i;
+    }
+    std::vector<rank_type> ref(n), ref_weighted(n);
+    for (size_t t = 0; t < n; ++t)
+    {
+        if (succ[t] != t)
+            continue;
+        ref[t] = ref_weighted[t] = 0;
+        for (node_type i = t; pred[i] != n; i = pred[i])
+        {
+            ref[pred[i]] = ref[i] + 1;
+            ref_weighted[pred[i]] = ref_weighted[i] + weight[pred[i]];
+        }
+    }
+
+    stxxl::vector<rank_type> rank;
+    stxxl::list_rank(succ_vector, rank, M);
+    die_unequal(rank.size(), n);
+    for (size_t i = 0; i < n; ++i)
+        die_unequal(rank[i], ref[i]);
+
+    stxxl::list_rank(succ_vector, weight_vector, rank, M);
+    die_unequal(rank.size(), n);
+    for (size_t i = 0; i < n; ++i)
+        die_unequal(rank[i], ref_weighted[i]);
+}
+
+//! append the Euler tour of the subtree of v
+void naive_tour(const std::vector<std::vector<node_type> >& children, node_type v,
+                std::vector<node_type>& tour)
+{
+    // iteratively, the trees may be paths
+    std::vector<std::pair<node_type, size_t> > stack(1, std::make_pair(v, 0));
+    tour.push_back(v);
+    while (!stack.empty())
+    {
+        std::pair<node_type, size_t>& top = stack.back();
+        if (top.second < children[top.first].size())
+        {
+            const node_type c = children[top.first][top.second++];
+            tour.push_back(c);
+            stack.emplace_back(c, 0);
+        }
+        else
+        {
+            tour.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+}
+
+void test_euler_tour(const std::vector<node_type>& parent, size_t M)
+{
+    const size_t n = parent.size();
+    LOG1 << "euler_tour() of " << n << " nodes";
+
+    std::vector<std::vector<node_type> > children(n);
+    for (size_t v = 0; v < n; ++v)
+    {
+        if (parent[v] != v)
+            children[parent[v]].push_back(v);
+    }
+    std::vector<node_type> ref;
+    for (size_t v = 0; v < n; ++v)
+    {
+        if (parent[v] == v)
+            naive_tour(children, v, ref);
+    }
+
+    stxxl::vector<node_type> parent_vector(n);
+    std::copy(parent.begin(), parent.end(), parent_vector.begin());
+
+    stxxl::vector<node_type> tour;
+    stxxl::euler_tour(parent_vector, tour, M);
+    die_unequal(tour.size(), 2 * n);
+    for (size_t k = 0; k < 2 * n; ++k)
+        die_unequal(tour[k], ref[k]);
+}
+
+int main()
+{
+    // small enough for several rounds of independent set removal
+    const size_t M = 1024 * 1024;
+    std::mt19937_64 rng(42);
+
+    test_list_rank(random_lists({ }, rng), rng, M);
+    test_list_rank(random_lists({ 1 }, rng), rng, M);
+    test_list_rank(random_lists({ 1000 }, rng), rng, M);
+    test_list_rank(random_lists({ 400000 }, rng), rng, M);
+    test_list_rank(random_lists(std::vector<size_t>(200000, 1), rng), rng, M);
+
+    std::vector<size_t> lengths;
+    for (size_t k = 0; k < 2000; ++k)
+        lengths.push_back(1 + rng() % 300);
+    test_list_rank(random_lists(lengths, rng), rng, M);
+
+    test_euler_tour({ }, M);
+    test_euler_tour({ 0 }, M);
+
+    for (size_t n : { 100, 300000 })
+    {
+        // random forest: a node's parent has a smaller id or is itself
+        std::vector<node_type> parent(n);
+        for (size_t v = 0; v < n; ++v)
+            parent[v] = (v == 0 || rng() % 100 == 0) ? v : rng() % v;
+        test_euler_tour(parent, M);
+
+        // a path and a star
+        for (size_t v = 0; v < n; ++v)
+            parent[v] = v ? v - 1 : 0;
+        test_euler_tour(parent, M);
+        for (size_t v = 0; v < n; ++v)
+            parent[v] = n / 2;
+        test_euler_tour(parent, M);
+    }
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+/***************************************************************************
+ *  tests/algo/test_permute.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example algo/test_permute.cpp
+//! Test \c stxxl::scatter() and \c stxxl::permute()
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/permute>
+#include <stxxl/vector>
+
+using vector_type = stxxl::vector<uint64_t, 1, stxxl::lru_pager<2>, 4096>;
+
+// 64 blocks of memory do not hold the 800 KB of the vectors, which are
+// distributed into buckets
+constexpr size_t block_size = 4096;
+constexpr size_t memory = 64 * block_size;
+
+void test_scatter_permute(size_t n)
+{
+    vector_type in(n), perm(n), out(n), back(n);
+    for (size_t i = 0; i < n; ++i)
+        in[i] = 3 * i + 1;
+
+    std::vector<uint64_t> p(n);
+    std::iota(p.begin(), p.end(), 0);
+    std::shuffle(p.begin(), p.end(), std::mt19937_64(n));
+    std::copy(p.begin(), p.end(), perm.begin());
+
+    LOG1 << "scatter of " << n << " elements";
+    stxxl::scatter<block_size>(in.cbegin(), in.cend(), perm.cbegin(), out.begin(), memory);
+    for (size_t i = 0; i < n; ++i)
+        die_unequal(out[p[i]], 3 * i + 1);
+
+    // gathering by the same permutation reverts the scatter
+    LOG1 << "permute of " << n << " elements";
+    stxxl::permute<block_size>(out.cbegin(), out.cend(), perm.cbegin(), perm.cend(),
+                               back.begin(), memory);
+    for (size_t i = 0; i < n; ++i)
+        die_unequal(back[i], 3 * i + 1);
+}
+
+void test_permute_indexes()
+{
+    // any index vector, with duplicates and sources never read
+    const size_t n = 100000, m = 30000;
+    vector_type in(n), idx(m), out(m);
+    for (size_t i = 0; i < n; ++i)
+        in[i] = 5 * i;
+
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> ix(m);
+    for (uint64_t& i : ix)
+        i = rng() % (n / 2);
+    std::copy(ix.begin(), ix.end(), idx.begin());
+
+    stxxl::permute<block_size>(in.cbegin(), in.cend(), idx.cbegin(), idx.cend(),
+                               out.begin(), memory);
+    for (size_t i = 0; i < m; ++i)
+        die_unequal(out[i], 5 * ix[i]);
+
+    // into internal memory
+    std::vector<uint64_t> small(m);
+    stxxl::permute<block_size>(in.cbegin(), in.cend(), ix.begin(), ix.end(),
+                               small.begin(), memory);
+    for (size_t i = 0; i < m; ++i)
+        die_unequal(small[i], 5 * ix[i]);
+}
+
+int main()
+{
+    test_scatter_permute(1000);
+    test_scatter_permute(100000);
+    test_permute_indexes();
+
+    return 0;
+}
+
+/******************************************************************************/
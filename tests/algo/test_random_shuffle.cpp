@@ -20,10 +20,13 @@
 //! \example algo/test_random_shuffle.cpp
 //! Test \c stxxl::random_shuffle()
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <random>
+#include <vector>
 
+#include <tlx/die.hpp>
 #include <tlx/logger.hpp>
 
 #include <stxxl/bits/defines.h>
@@ -106,8 +109,36 @@ void short_test()
     std::cout << std::endl;
 }
 
+void parallel_test()
+{
+    using vector_type = stxxl::vector<int, 1, stxxl::lru_pager<2>, 4096>;
+    vector_type::size_type i;
+    vector_type v(128 * 1024 + 17);
+    for (i = 0; i < v.size(); ++i)
+        v[i] = static_cast<int>(i);
+    v.flush();
+
+    LOG1 << "Permute randomly in parallel...";
+    stxxl::parallel_shuffle(v.begin() + 100, v.end() - 100, 64 * 4096);
+
+    for (i = 0; i < 100; ++i)
+    {
+        die_unless(v[i] == static_cast<int>(i));
+        die_unless(v[v.size() - 1 - i] == static_cast<int>(v.size() - 1 - i));
+    }
+
+    std::vector<int> sorted;
+    for (i = 100; i < v.size() - 100; ++i)
+        sorted.push_back(v[i]);
+    die_unless(!std::is_sorted(sorted.begin(), sorted.end()));
+    std::sort(sorted.begin(), sorted.end());
+    for (i = 0; i < sorted.size(); ++i)
+        die_unless(sorted[i] == static_cast<int>(i + 100));
+}
+
 int main()
 {
     short_test();
     long_test();
+    parallel_test();
 }
@@ -0,0 +1,178 @@
+/***************************************************************************
+ *  tests/algo/test_sample.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example algo/test_sample.cpp
+//! Test \c stxxl::sample(), \c stxxl::stream::bernoulli_sample and
+//! \c stxxl::stream::reservoir_sample
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/algorithm>
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+using values_type = std::vector<value_type>;
+using vector_type = stxxl::vector<value_type>;
+using stream_type = stxxl::stream::streamify_traits<values_type::const_iterator>::stream_type;
+
+//! check that the counts of the buckets are within 10% of their mean
+void check_uniform(const std::vector<size_t>& buckets)
+{
+    const double mean = std::accumulate(buckets.begin(), buckets.end(), 0.0) / buckets.size();
+    for (const size_t& count : buckets)
+        die_unless(std::fabs(count - mean) < 0.1 * mean);
+}
+
+void test_vector_sample(size_t n, size_t k)
+{
+    LOG1 << "sample of " << k << " of " << n << " vector elements";
+
+    vector_type v(n);
+    for (size_t i = 0; i < n; ++i)
+        v[i] = i;
+
+    // distinct elements in the order of the vector
+    const values_type s = stxxl::sample(v, k);
+    die_unequal(s.size(), std::min(n, k));
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        die_unless(s[i] < n);
+        die_unless(i == 0 || s[i - 1] < s[i]);
+    }
+
+    // the same seed gives the same sample
+    die_unless(stxxl::sample(v, k, 42) == stxxl::sample(v, k, 42));
+}
+
+void test_vector_uniform()
+{
+    LOG1 << "uniformity of the vector sample";
+
+    const size_t n = 10000, k = 100;
+    vector_type v(n);
+    for (size_t i = 0; i < n; ++i)
+        v[i] = i;
+
+    std::vector<size_t> buckets(10);
+    for (unsigned seed = 0; seed < 200; ++seed)
+    {
+        for (const value_type& x : stxxl::sample(v, k, seed))
+            ++buckets[x * buckets.size() / n];
+    }
+    check_uniform(buckets);
+}
+
+void test_bernoulli(size_t n, double p)
+{
+    LOG1 << "bernoulli_sample of " << n << " values with p=" << p;
+
+    values_type values(n);
+    std::iota(values.begin(), values.end(), 0);
+
+    stream_type input = stxxl::stream::streamify(values.cbegin(), values.cend());
+    stxxl::stream::bernoulli_sample<stream_type> sample(input, p, 7);
+
+    values_type s;
+    for ( ; !sample.empty(); ++sample)
+    {
+        die_unless(s.empty() || s.back() < *sample);
+        s.push_back(*sample);
+    }
+
+    // within five standard deviations of the expected size
+    const double mean = n * p, sigma = std::sqrt(n * p * (1 - p));
+    die_unless(std::fabs(s.size() - mean) <= 5 * sigma);
+    if (p == 1.0)
+        die_unless(s == values);
+}
+
+void test_reservoir()
+{
+    LOG1 << "reservoir_sample uniformity";
+
+    const size_t n = 1000, k = 10;
+    values_type values(n);
+    std::iota(values.begin(), values.end(), 0);
+
+    std::vector<size_t> buckets(10);
+    for (unsigned seed = 0; seed < 2000; ++seed)
+    {
+        stream_type input = stxxl::stream::streamify(values.cbegin(), values.cend());
+        stxxl::stream::reservoir_sample<stream_type> reservoir(input, k, seed);
+
+        // half by elements, half by batches, all values passed on
+        values_type out;
+        for (size_t i = 0; i < n / 2; ++i, ++reservoir)
+            out.push_back(*reservoir);
+        values_type batch(64);
+        while (size_t count = stxxl::stream::next_batch(reservoir, batch.data(), batch.size()))
+            out.insert(out.end(), batch.begin(), batch.begin() + count);
+        die_unless(out == values);
+        die_unequal(reservoir.count(), n);
+
+        values_type s = reservoir.sample();
+        die_unequal(s.size(), k);
+        std::sort(s.begin(), s.end());
+        die_unless(std::adjacent_find(s.begin(), s.end()) == s.end());
+        for (const value_type& x : s)
+            ++buckets[x * buckets.size() / n];
+    }
+    check_uniform(buckets);
+}
+
+void test_errors()
+{
+    values_type values(10);
+    for (size_t k = 0; k < 3; ++k)
+    {
+        stream_type input = stxxl::stream::streamify(values.cbegin(), values.cend());
+        bool thrown = false;
+        try {
+            if (k == 0)
+                stxxl::stream::bernoulli_sample<stream_type>(input, -0.5);
+            else if (k == 1)
+                stxxl::stream::bernoulli_sample<stream_type>(input, 1.5);
+            else
+                stxxl::stream::reservoir_sample<stream_type>(input, 0);
+        }
+        catch (const foxxll::bad_parameter&) {
+            thrown = true;
+        }
+        die_unless(thrown);
+    }
+}
+
+int main()
+{
+    for (size_t n : { 0, 10, 100000 })
+    {
+        for (size_t k : { 1, 10, 1000 })
+            test_vector_sample(n, k);
+    }
+    test_vector_uniform();
+
+    for (double p : { 0.0, 0.001, 0.1, 0.5, 1.0 })
+        test_bernoulli(100000, p);
+    test_reservoir();
+    test_errors();
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
@@ -16,6 +16,8 @@
 //! This is an example of how to use \c stxxl::for_each() and \c stxxl::find() algorithms
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
 #include <iostream>
 
 #include <tlx/die.hpp>
@@ -106,6 +108,66 @@ int main()
         die_verbose_unless(v[i] == 555, "Error at position " << i);
     }
 
+    LOG1 << "parallel_generate ...";
+    stxxl::parallel_generate(v.begin() + 3, v.end() - 5,
+                             [](stxxl::vector<int64_t>::size_type pos) {
+                                 return int64_t(pos);
+                             });
+    die_verbose_unless(v[0] == 0, "Error at position " << 0);
+    die_verbose_unless(v[2] == 555, "Error at position " << 2);
+    for (i = 3; i < v.size() - 5; ++i)
+    {
+        die_verbose_unless(v[i] == int64_t(i - 3), "Error at position " << i);
+    }
+    die_verbose_unless(v[v.size() - 5] == 555, "Error at position " << v.size() - 5);
+
+    LOG1 << "parallel_for_each_m ...";
+    b = timestamp();
+    stxxl::parallel_for_each_m(v.begin() + 3, v.end() - 5, square<int64_t>());
+    e = timestamp();
+    LOG1 << "parallel_for_each_m time: " << (e - b);
+
+    stxxl::parallel_transform_m(v.begin() + 3, v.end() - 5,
+                                [](int64_t x) { return x + 1; });
+
+    LOG1 << "check";
+    die_verbose_unless(v[2] == 555, "Error at position " << 2);
+    for (i = 3; i < v.size() - 5; ++i)
+    {
+        die_verbose_unless(v[i] == int64_t((i - 3) * (i - 3) + 1), "Error at position " << i);
+    }
+    die_verbose_unless(v[v.size() - 5] == 555, "Error at position " << v.size() - 5);
+
+    LOG1 << "parallel_for_each ...";
+    std::atomic<int64_t> found(0);
+    stxxl::parallel_for_each(v.begin(), v.end(),
+                             [&found](const int64_t& x) {
+                                 if (x == 555) ++found;
+                             });
+    die_unless(found == 6);
+
+    LOG1 << "reduce ...";
+    {
+        stxxl::vector<int64_t> w(10 * STXXL_DEFAULT_BLOCK_SIZE(int64_t) + 123);
+        stxxl::generate(w.begin(), w.end(), counter<int64_t>(), 4);
+
+        const int64_t n = static_cast<int64_t>(w.size());
+        die_unless(stxxl::reduce(w.begin(), w.end(), int64_t(0)) == n * (n - 1) / 2);
+        die_unless(stxxl::reduce(w.begin() + 5, w.end(), int64_t(7)) == n * (n - 1) / 2 - 10 + 7);
+        die_unless(stxxl::transform_reduce(
+                       w.begin(), w.end(), int64_t(0), std::plus<int64_t>(),
+                       [](const int64_t& x) { return x % 2; }) == n / 2);
+
+        LOG1 << "prefix_sum ...";
+        stxxl::generate(w.begin(), w.end(), fill_value<int64_t>(1), 4);
+        stxxl::prefix_sum(w.begin() + 3, w.end());
+        for (i = 0; i < w.size(); ++i)
+        {
+            const int64_t expected = (i < 3) ? 1 : int64_t(i - 2);
+            die_verbose_unless(w[i] == expected, "Error at position " << i);
+        }
+    }
+
     std::cout << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
 
     return 0;
@@ -0,0 +1,100 @@
+/***************************************************************************
+ *  tests/algo/test_select.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example algo/test_select.cpp
+//! Test \c stxxl::nth_element() and \c stxxl::partial_sort()
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/algorithm>
+#include <stxxl/comparator>
+#include <stxxl/vector>
+
+using value_type = uint32_t;
+using vector_type = stxxl::vector<value_type>;
+using cmp_type = stxxl::comparator<value_type>;
+
+void fill(vector_type& v, std::vector<value_type>& ref, value_type max)
+{
+    std::mt19937 rng(static_cast<unsigned>(v.size() + max));
+    for (size_t i = 0; i < v.size(); ++i)
+        v[i] = rng() % max;
+    ref.assign(v.cbegin(), v.cend());
+    std::sort(ref.begin(), ref.end());
+}
+
+//! check that v is a permutation of the sorted ref
+void check_permutation(const vector_type& v, const std::vector<value_type>& ref)
+{
+    std::vector<value_type> copy(v.cbegin(), v.cend());
+    std::sort(copy.begin(), copy.end());
+    die_unless(copy == ref);
+}
+
+void test_nth_element(size_t n, size_t nth, value_type max, size_t M)
+{
+    LOG1 << "nth_element n=" << n << " nth=" << nth << " max=" << max << " M=" << M;
+
+    vector_type v(n);
+    std::vector<value_type> ref;
+    fill(v, ref, max);
+
+    stxxl::nth_element(v.begin(), v.begin() + nth, v.end(), cmp_type(), M);
+
+    const value_type x = v[nth];
+    die_unless(x == ref[nth]);
+    for (size_t i = 0; i < nth; ++i)
+        die_unless(v[i] <= x);
+    for (size_t i = nth + 1; i < n; ++i)
+        die_unless(v[i] >= x);
+    check_permutation(v, ref);
+}
+
+void test_partial_sort(size_t n, size_t k, value_type max, size_t M)
+{
+    LOG1 << "partial_sort n=" << n << " k=" << k << " max=" << max << " M=" << M;
+
+    vector_type v(n);
+    std::vector<value_type> ref;
+    fill(v, ref, max);
+
+    stxxl::partial_sort(v.begin(), v.begin() + k, v.end(), cmp_type(), M);
+
+    for (size_t i = 0; i < k; ++i)
+        die_unless(v[i] == ref[i]);
+    check_permutation(v, ref);
+}
+
+int main()
+{
+    const size_t block = STXXL_DEFAULT_BLOCK_SIZE(value_type);
+    const size_t n = 256 * block / sizeof(value_type);
+
+    // bounded heap
+    test_nth_element(n, 17, 1000000, 64 * block);
+    test_nth_element(n, n - 1, 1000000, 1024 * block);
+    test_partial_sort(n, 1000, 1000000, 64 * block);
+
+    // sampling-based partitioning
+    test_nth_element(n, n / 2, 1000000, 64 * block);
+    test_nth_element(n, n / 3, 1000000, 32 * block);
+    test_nth_element(n, n / 2, 4, 32 * block);
+    test_partial_sort(n, n / 2, 1000000, 64 * block);
+    test_partial_sort(n, n - 1, 16, 32 * block);
+
+    return 0;
+}
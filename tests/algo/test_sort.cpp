@@ -17,12 +17,14 @@
 //! This is an example of how to use \c stxxl::sort() algorithm
 
 #include <iostream>
+#include <tuple>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
 
 #include <foxxll/mng.hpp>
 
+#include <stxxl/bits/common/comparator.h>
 #include <stxxl/bits/common/padding.h>
 #include <stxxl/bits/defines.h>
 #include <stxxl/sort>
@@ -74,6 +76,149 @@ int main()
 
     LOG1 << "Done, output size=" << v.size();
 
+    {
+        // sort presorted input again, its runs are concatenated
+        LOG1 << "Sorting presorted input...";
+        stxxl::sort(v.begin(), v.end(), cmp(), memory_to_use);
+        die_unless(stxxl::is_sorted(v.cbegin(), v.cend(), cmp()));
+
+        // reverse sorted input, the runs are reversed instead of sorted
+        for (uint64_t i = 0; i < n_records; ++i)
+            v[i] = my_type(KeyType(n_records - i));
+
+        LOG1 << "Sorting reverse sorted input...";
+        stxxl::sort(v.begin(), v.end(), cmp(), memory_to_use);
+        die_unless(stxxl::is_sorted(v.cbegin(), v.cend(), cmp()));
+        die_unless(v[0].key == 1);
+    }
+
+    {
+        // form several runs concurrently, one per thread
+        stxxl::SETTINGS::parallel_run_formation = true;
+
+        random_fill_vector(v, [](uint64_t x) -> my_type { return my_type(1 + (x % 0xfffffff)); });
+
+        LOG1 << "Sorting with parallel run formation...";
+        stxxl::sort(v.begin(), v.end(), cmp(), memory_to_use);
+
+        LOG1 << "Checking order...";
+        die_unless(stxxl::is_sorted(v.cbegin(), v.cend(), cmp()));
+
+        stxxl::SETTINGS::parallel_run_formation = false;
+    }
+
+    {
+        // distribute to buckets by sampled splitters instead of merging runs
+        stxxl::SETTINGS::sample_sort = true;
+
+        random_fill_vector(v, [](uint64_t x) -> my_type { return my_type(1 + (x % 0xfffffff)); });
+
+        LOG1 << "Sorting with sample sort...";
+        stxxl::sort(v.begin(), v.end(), cmp(), memory_to_use);
+        die_unless(stxxl::is_sorted(v.cbegin(), v.cend(), cmp()));
+
+        // the splitters of the first batch put most of presorted input into
+        // the last bucket, which is distributed again
+        LOG1 << "Sorting presorted input with sample sort...";
+        stxxl::sort(v.begin(), v.end(), cmp(), memory_to_use);
+        die_unless(stxxl::is_sorted(v.cbegin(), v.cend(), cmp()));
+
+        // few distinct keys end up in the buckets of equal elements
+        random_fill_vector(v, [](uint64_t x) -> my_type { return my_type(1 + (x % 3)); });
+
+        LOG1 << "Sorting few distinct keys with sample sort...";
+        stxxl::sort(v.begin(), v.end(), cmp(), memory_to_use);
+        die_unless(stxxl::is_sorted(v.cbegin(), v.cend(), cmp()));
+
+        // a range not aligned to blocks, the elements around it are kept
+        for (uint64_t i = 0; i < n_records; ++i)
+            v[i] = my_type(KeyType(n_records - i));
+
+        LOG1 << "Sorting a subrange with sample sort...";
+        stxxl::sort(v.begin() + 7, v.end() - 5, cmp(), memory_to_use);
+        die_unless(stxxl::is_sorted(v.cbegin() + 7, v.cend() - 5, cmp()));
+        die_unless(v[6].key == KeyType(n_records - 6));
+        die_unless(v[7].key == 6);
+        die_unless(v[n_records - 5].key == 5);
+
+        stxxl::SETTINGS::sample_sort = false;
+    }
+
+    {
+        // integral keys and pairs are sorted by the in-memory sort kernel
+        using uint_vector_type = stxxl::vector<uint64_t>;
+        uint_vector_type u(n_records);
+        random_fill_vector(u, [](uint64_t x) -> uint64_t { return x % 0xfffff; });
+
+        LOG1 << "Sorting integers with the sort kernel...";
+        stxxl::sort(u.begin(), u.end(), stxxl::comparator<uint64_t>(), memory_to_use);
+        die_unless(stxxl::is_sorted(u.cbegin(), u.cend(), stxxl::comparator<uint64_t>()));
+
+        using pair_type = std::pair<uint32_t, uint32_t>;
+        using pair_cmp = stxxl::comparator<pair_type, stxxl::direction::Greater, stxxl::direction::Less>;
+        using pair_vector_type = stxxl::vector<pair_type>;
+        pair_vector_type p(n_records);
+        random_fill_vector(p, [](uint64_t x) -> pair_type {
+                               return pair_type(uint32_t(x % 1000), uint32_t(x >> 32));
+                           });
+
+        LOG1 << "Sorting pairs with the sort kernel...";
+        stxxl::sort(p.begin(), p.end(), pair_cmp(), memory_to_use);
+        die_unless(stxxl::is_sorted(p.cbegin(), p.cend(), pair_cmp()));
+
+        using tuple_type = std::tuple<uint32_t, int32_t, uint64_t>;
+        using tuple_cmp = stxxl::comparator<tuple_type, stxxl::direction::Less, stxxl::direction::Greater>;
+        using tuple_vector_type = stxxl::vector<tuple_type>;
+        tuple_vector_type t(n_records);
+        random_fill_vector(t, [](uint64_t x) -> tuple_type {
+                               return tuple_type(uint32_t(x % 100), int32_t(x >> 40) - 100, x);
+                           });
+
+        LOG1 << "Sorting tuples field by field with the sort kernel...";
+        stxxl::sort(t.begin(), t.end(), tuple_cmp(), memory_to_use);
+        die_unless(stxxl::is_sorted(t.cbegin(), t.cend(), tuple_cmp()));
+
+        struct record_type
+        {
+            int32_t key;
+            uint32_t tie;
+            uint64_t payload;
+        };
+        const auto record_cmp = stxxl::make_struct_comparator<
+            record_type, stxxl::direction::Greater, stxxl::direction::Less>(
+            [](auto& r) { return std::tie(r.key, r.tie); });
+        static_assert(stxxl::sort_kernel_traits<
+                          record_type, std::decay_t<decltype(record_cmp)> >::enabled,
+                      "struct_comparator with an integral first key uses the sort kernel");
+        using record_vector_type = stxxl::vector<record_type>;
+        record_vector_type r(n_records);
+        random_fill_vector(r, [](uint64_t x) -> record_type {
+                               return record_type {
+                                   int32_t(x % 1000) - 500, uint32_t(x >> 40), x
+                               };
+                           });
+
+        LOG1 << "Sorting structs by their first key with the sort kernel...";
+        stxxl::sort(r.begin(), r.end(), record_cmp, memory_to_use);
+        die_unless(stxxl::is_sorted(r.cbegin(), r.cend(), record_cmp));
+
+        // large records sorted by a normalized prefix of their key with
+        // ties decided by the comparator
+        using large_type = key_with_padding<uint64_t, 256>;
+        using large_cmp = large_type::compare_less;
+        const auto normalized_cmp = stxxl::make_normalized_key_comparator(
+            large_cmp(), [](const large_type& x) { return uint32_t(x.key >> 32); });
+        using large_vector_type = stxxl::vector<large_type>;
+        large_vector_type l(n_records / 32);
+        random_fill_vector(l, [](uint64_t x) -> large_type {
+                               return large_type((x % 1000) << 32 | (x >> 32));
+                           });
+
+        LOG1 << "Sorting large records by a normalized key...";
+        stxxl::sort(l.begin(), l.end(), normalized_cmp, memory_to_use);
+        die_unless(stxxl::is_sorted(l.cbegin(), l.cend(), large_cmp()));
+    }
+
     std::cout << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
 
     return 0;
@@ -0,0 +1,99 @@
+/***************************************************************************
+ *  tests/algo/test_sort_plan.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <sstream>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/algo/sort_plan.h>
+
+int main()
+{
+    // runs formed by one thread, the memory usage factor is 1, see CMake
+    stxxl::SETTINGS::parallel_run_formation = false;
+    stxxl::SETTINGS::async_pipelining = false;
+    stxxl::SETTINGS::in_memory_sort = false;
+
+    const size_t B = 4096;
+    const uint64_t n = 512 * 1000;   // 1000 blocks of 8-byte records
+
+    LOG1 << "stxxl::sort";
+    {
+        // 20 runs of 50 blocks, merged in one pass
+        stxxl::sort_plan p = stxxl::plan_sort(n, 8, 100 * B, 1, B);
+        die_unless(p.feasible && !p.in_memory);
+        die_unequal(p.blocks, 1000u);
+        die_unequal(p.runs, 20u);
+        die_unequal(p.run_blocks, 50u);
+        die_unequal(p.merge_levels, 1u);
+        die_unequal(p.bytes_read, 2 * 1000 * B);
+        die_unequal(p.bytes_written, 2 * 1000 * B);
+        die_unequal(p.min_memory, 2 * B);
+        // 46 blocks form 44 runs of 23 blocks, 45 blocks 46 runs of 22
+        die_unequal(p.single_pass_memory, 46 * B);
+
+        // 200 runs of 5 blocks, merged 6 at a time: 200, 34, 6, 1
+        p = stxxl::plan_sort(n, 8, 10 * B, 1, B);
+        die_unequal(p.runs, 200u);
+        die_unequal(p.merge_levels, 3u);
+        die_unequal(p.bytes_read, 4 * 1000 * B);
+
+        p = stxxl::plan_sort(n, 8, 8 * 1000 * B, 1, B);
+        die_unless(p.feasible && p.in_memory);
+        die_unequal(p.merge_levels, 0u);
+
+        p = stxxl::plan_sort(n, 8, B, 1, B);
+        die_unless(!p.feasible);
+    }
+
+    LOG1 << "stream::sort";
+    {
+        // 20 runs of 50 blocks fit into the merger at once
+        stxxl::sort_plan p = stxxl::plan_stream_sort(n, 8, 100 * B, 1, B);
+        die_unless(p.feasible && !p.in_memory);
+        die_unequal(p.runs, 20u);
+        die_unequal(p.merge_levels, 1u);
+        die_unequal(p.bytes_read, 1000 * B);
+        die_unequal(p.bytes_written, 1000 * B);
+        die_unequal(p.min_memory, 7 * B);
+        // 47 blocks form 44 runs of 23 blocks, which fit besides 3 buffers
+        die_unequal(p.single_pass_memory, 47 * B);
+
+        // 100 runs of 10 blocks for a merger of 17 runs: one level merges
+        // 89 runs in 6 groups of at most 15
+        p = stxxl::plan_stream_sort(n, 8, 20 * B, 1, B);
+        die_unequal(p.runs, 100u);
+        die_unequal(p.merge_levels, 2u);
+        die_unequal(p.bytes_read, (890 + 1000) * B);
+        die_unequal(p.bytes_written, (1000 + 890) * B);
+
+        // a single block stays in memory
+        p = stxxl::plan_stream_sort(512, 8, 100 * B, 1, B);
+        die_unless(p.feasible && p.in_memory);
+        die_unequal(p.bytes_written, 0u);
+
+        p = stxxl::plan_stream_sort(n, 8, 6 * B, 1, B);
+        die_unless(!p.feasible);
+
+        // more disks need more prefetch buffers
+        die_unequal(stxxl::plan_stream_sort(n, 8, 100 * B, 4, B).single_pass_memory, 50 * B);
+    }
+
+    std::ostringstream os;
+    os << stxxl::plan_sort(n, 8, 10 * B, 1, B);
+    die_unless(os.str().find("merge levels:       3") != std::string::npos);
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
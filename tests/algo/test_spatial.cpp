@@ -0,0 +1,228 @@
+/***************************************************************************
+ *  tests/algo/test_spatial.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example algo/test_spatial.cpp
+//! Test the space-filling curve keys and \c stxxl::spatial_join()
+
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/ksort>
+#include <stxxl/spatial>
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+using point_type = stxxl::spatial_point;
+using rectangle_type = stxxl::spatial_rectangle;
+
+//! Hilbert key by rotating the quadrants one level at a time
+uint64_t hilbert_reference(uint32_t x, uint32_t y)
+{
+    uint64_t d = 0;
+    for (uint64_t s = uint64_t(1) << 31; s > 0; s /= 2)
+    {
+        const uint64_t rx = (x & s) != 0, ry = (y & s) != 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1)
+                x = ~x, y = ~y;
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+void test_keys(std::mt19937_64& rng)
+{
+    LOG1 << "space-filling curve keys";
+
+    for (size_t k = 0; k < 100000; ++k)
+    {
+        const uint32_t x = static_cast<uint32_t>(rng()), y = static_cast<uint32_t>(rng());
+
+        uint64_t morton = 0;
+        for (unsigned b = 0; b < 32; ++b)
+            morton |= (uint64_t((x >> b) & 1) << (2 * b)) | (uint64_t((y >> b) & 1) << (2 * b + 1));
+        die_unequal(stxxl::morton_encode(x, y), morton);
+
+        uint32_t dx, dy;
+        stxxl::morton_decode(morton, dx, dy);
+        die_unequal(dx, x);
+        die_unequal(dy, y);
+
+        const uint64_t hilbert = stxxl::hilbert_encode(x, y);
+        die_unequal(hilbert, hilbert_reference(x, y));
+        stxxl::hilbert_decode(hilbert, dx, dy);
+        die_unequal(dx, x);
+        die_unequal(dy, y);
+
+        // consecutive Hilbert keys are neighbors
+        uint32_t nx, ny;
+        stxxl::hilbert_decode(hilbert + 1, nx, ny);
+        if (hilbert + 1 != 0)
+            die_unequal(std::max(x, nx) - std::min(x, nx) + std::max(y, ny) - std::min(y, ny), 1u);
+    }
+
+    const point_type last = stxxl::hilbert_key<>().max_value();
+    die_unequal(last.x, UINT32_MAX);
+    die_unequal(last.y, 0u);
+    die_unequal(stxxl::hilbert_key<>()(stxxl::hilbert_key<>().min_value()), 0u);
+}
+
+void test_sort(size_t n, std::mt19937_64& rng)
+{
+    LOG1 << "sorting " << n << " points by Morton and Hilbert keys";
+
+    stxxl::vector<point_type> points(n);
+    for (size_t i = 0; i < n; ++i)
+        points[i] = point_type { static_cast<uint32_t>(rng()), static_cast<uint32_t>(rng() % 1000), i };
+
+    // ksort by Morton keys
+    stxxl::vector<point_type> sorted(points);
+    stxxl::ksort(sorted.begin(), sorted.end(), stxxl::morton_key<>(), 64 * 1024 * 1024);
+    for (size_t i = 1; i < n; ++i)
+        die_unless(stxxl::morton_key<>()(sorted[i - 1]) <= stxxl::morton_key<>()(sorted[i]));
+
+    // sorter by Hilbert keys
+    using hilbert_less = stxxl::spatial_key_less<stxxl::hilbert_key<> >;
+    stxxl::sorter<point_type, hilbert_less> sorter(hilbert_less(), 64 * 1024 * 1024);
+    for (size_t i = 0; i < n; ++i)
+        sorter.push(points[i]);
+    sorter.sort();
+
+    std::vector<bool> seen(n, false);
+    uint64_t prev = 0;
+    for ( ; !sorter.empty(); ++sorter)
+    {
+        const uint64_t key = stxxl::hilbert_key<>()(*sorter);
+        die_unless(prev <= key);
+        prev = key;
+        die_unless(!seen[sorter->id]);
+        seen[sorter->id] = true;
+    }
+    die_unless(std::find(seen.begin(), seen.end(), false) == seen.end());
+}
+
+using pair_type = std::pair<uint64_t, uint64_t>;
+
+void test_join(const std::vector<rectangle_type>& rectangles,
+               const std::vector<point_type>& points, size_t num_strips)
+{
+    LOG1 << "spatial_join() of " << rectangles.size() << " rectangles and "
+         << points.size() << " points with " << num_strips << " strips";
+
+    std::vector<pair_type> ref;
+    for (const rectangle_type& r : rectangles)
+    {
+        for (const point_type& p : points)
+        {
+            if (r.x_min <= p.x && p.x <= r.x_max && r.y_min <= p.y && p.y <= r.y_max)
+                ref.emplace_back(r.id, p.id);
+        }
+    }
+    std::sort(ref.begin(), ref.end());
+
+    auto rectangle_stream = stxxl::stream::streamify(rectangles.begin(), rectangles.end());
+    auto point_stream = stxxl::stream::streamify(points.begin(), points.end());
+
+    std::vector<pair_type> out;
+    const stxxl::external_size_type pairs = stxxl::spatial_join(
+        rectangle_stream, point_stream,
+        [&out](const rectangle_type& r, const point_type& p) {
+            out.emplace_back(r.id, p.id);
+        }, 16 * 1024 * 1024, num_strips);
+
+    die_unequal(pairs, out.size());
+    std::sort(out.begin(), out.end());
+    die_unless(out == ref);
+}
+
+void test_joins(std::mt19937_64& rng)
+{
+    test_join({ }, { }, 16);
+    test_join({ rectangle_type { 0, 0, 0, 0, 0 } }, { point_type { 0, 0, 0 } }, 16);
+
+    for (uint32_t extent : { 100u, 1u << 20, UINT32_MAX })
+    {
+        // small rectangles, a few covering the whole extent, and points on
+        // their corners
+        std::vector<rectangle_type> rectangles;
+        std::vector<point_type> points;
+        for (uint64_t i = 0; i < 2000; ++i)
+        {
+            const uint32_t w = (i % 100 == 0) ? extent : static_cast<uint32_t>(rng() % (extent / 20 + 1));
+            const uint32_t h = static_cast<uint32_t>(rng() % (extent / 20 + 1));
+            const uint32_t x = static_cast<uint32_t>(rng() % (extent - w + uint64_t(1)));
+            const uint32_t y = static_cast<uint32_t>(rng() % (extent - h + uint64_t(1)));
+            rectangles.push_back(rectangle_type { x, y, x + w, y + h, i });
+            points.push_back(point_type { x + w, y, 2 * i });
+        }
+        for (uint64_t i = 0; i < 2000; ++i)
+        {
+            points.push_back(point_type { static_cast<uint32_t>(rng() % (uint64_t(extent) + 1)),
+                                          static_cast<uint32_t>(rng() % (uint64_t(extent) + 1)),
+                                          2 * i + 1 });
+        }
+        for (size_t num_strips : { 1, 7, 1024 })
+            test_join(rectangles, points, num_strips);
+    }
+
+    // many points in one strip
+    std::vector<rectangle_type> rectangles;
+    std::vector<point_type> points;
+    for (uint64_t i = 0; i < 3000; ++i)
+    {
+        const uint32_t y = static_cast<uint32_t>(rng() % 10000);
+        rectangles.push_back(rectangle_type { 0, y, static_cast<uint32_t>(rng() % 100), y + 50, i });
+        points.push_back(point_type { static_cast<uint32_t>(rng() % 100), static_cast<uint32_t>(rng() % 10000), i });
+    }
+    test_join(rectangles, points, 64);
+}
+
+void test_errors()
+{
+    std::vector<rectangle_type> rectangles;
+    std::vector<point_type> points;
+    auto rectangle_stream = stxxl::stream::streamify(rectangles.begin(), rectangles.end());
+    auto point_stream = stxxl::stream::streamify(points.begin(), points.end());
+    using join_type = stxxl::stream::plane_sweep_join<decltype(rectangle_stream), decltype(point_stream)>;
+
+    for (size_t k = 0; k < 2; ++k)
+    {
+        bool thrown = false;
+        try {
+            join_type join(rectangle_stream, point_stream, k, 10, 10 - k);
+        }
+        catch (const foxxll::bad_parameter&) {
+            thrown = true;
+        }
+        die_unless(thrown);
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(42);
+
+    test_keys(rng);
+    test_sort(1000000, rng);
+    test_joins(rng);
+    test_errors();
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
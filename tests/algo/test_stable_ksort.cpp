@@ -52,5 +52,15 @@ int main()
     LOG1 << "Checking order...";
     die_unless(stxxl::is_sorted(v.cbegin(), v.cend()));
 
+    // skewed keys: every second record has the same key and the others are
+    // concentrated in a narrow range, which would overflow uniform buckets.
+    random_fill_vector(v, [](uint64_t x) { return my_type((x & 1) ? 42 : (x >> 1) % 4096); });
+
+    LOG1 << "Sorting skewed keys...";
+    stxxl::stable_ksort(v.begin(), v.end(), my_type::key_extract(), memory_to_use);
+
+    LOG1 << "Checking order...";
+    die_unless(stxxl::is_sorted(v.cbegin(), v.cend()));
+
     return 0;
 }
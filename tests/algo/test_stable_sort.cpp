@@ -0,0 +1,137 @@
+/***************************************************************************
+ *  tests/algo/test_stable_sort.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+//! \example algo/test_stable_sort.cpp
+//! Test \c stxxl::stable_sort() and \c stxxl::stream::stable_sort
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/sort>
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+#include <test_helpers.h>
+
+//! key and position in the input
+using value_type = std::pair<uint32_t, uint32_t>;
+using vector_type = stxxl::vector<value_type>;
+
+//! compares the keys only
+struct key_cmp
+{
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        return a.first < b.first;
+    }
+    value_type min_value() const
+    {
+        return value_type(std::numeric_limits<uint32_t>::min(), 0);
+    }
+    value_type max_value() const
+    {
+        return value_type(std::numeric_limits<uint32_t>::max(), 0);
+    }
+};
+
+const size_t memory_to_use = 64 * STXXL_DEFAULT_BLOCK_SIZE(value_type);
+const size_t n_records = 1000 * STXXL_DEFAULT_BLOCK_SIZE(value_type) / sizeof(value_type);
+
+//! check that the keys are sorted, and equal keys in input order
+template <typename Iterator>
+void check_stable(Iterator begin, Iterator end)
+{
+    for (Iterator prev = begin++; begin != end; prev = begin++)
+    {
+        const value_type a = *prev, b = *begin;
+        die_unless(a.first < b.first || (a.first == b.first && a.second < b.second));
+    }
+}
+
+void test_vector(size_t distinct)
+{
+    LOG1 << "stable_sort of a vector with " << distinct << " distinct keys";
+
+    vector_type v(n_records);
+    random_fill_vector(v, [distinct](uint64_t x) -> value_type {
+                           return value_type(uint32_t(x % distinct), 0);
+                       });
+    for (size_t i = 0; i < n_records; ++i)
+        v[i] = value_type(v[i].first, uint32_t(i));
+
+    stxxl::stable_sort(v.begin(), v.end(), key_cmp(), memory_to_use);
+    check_stable(v.cbegin(), v.cend());
+
+    // a range not aligned to blocks, the elements around it are kept
+    random_fill_vector(v, [distinct](uint64_t x) -> value_type {
+                           return value_type(uint32_t(x % distinct), 0);
+                       });
+    for (size_t i = 0; i < n_records; ++i)
+        v[i] = value_type(v[i].first, uint32_t(i));
+    const value_type first = v[6], last = v[n_records - 5];
+
+    stxxl::stable_sort(v.begin() + 7, v.end() - 5, key_cmp(), memory_to_use);
+    check_stable(v.cbegin() + 7, v.cend() - 5);
+    die_unless(v[6] == first);
+    die_unless(v[n_records - 5] == last);
+
+    // sample sort is unstable and not used
+    stxxl::SETTINGS::sample_sort = true;
+    for (size_t i = 0; i < n_records; ++i)
+        v[i] = value_type(uint32_t((n_records - i) % distinct), uint32_t(i));
+    stxxl::stable_sort(v.begin(), v.end(), key_cmp(), memory_to_use);
+    check_stable(v.cbegin(), v.cend());
+    stxxl::SETTINGS::sample_sort = false;
+}
+
+void test_stream(size_t n, size_t distinct, size_t memory)
+{
+    LOG1 << "stream::stable_sort of " << n << " values with " << distinct
+         << " distinct keys using " << memory / STXXL_DEFAULT_BLOCK_SIZE(value_type)
+         << " blocks";
+
+    std::vector<value_type> values(n);
+    random_fill_vector(values, [distinct](uint64_t x) -> value_type {
+                           return value_type(uint32_t(x % distinct), 0);
+                       });
+    for (size_t i = 0; i < n; ++i)
+        values[i].second = uint32_t(i);
+
+    using input_type = stxxl::stream::streamify_traits<std::vector<value_type>::const_iterator>::stream_type;
+    input_type input = stxxl::stream::streamify(values.cbegin(), values.cend());
+    stxxl::stream::stable_sort<input_type, key_cmp> sorted(input, key_cmp(), memory);
+
+    std::vector<value_type> out;
+    for ( ; !sorted.empty(); ++sorted)
+        out.push_back(*sorted);
+    die_unequal(out.size(), n);
+    check_stable(out.cbegin(), out.cend());
+}
+
+int main()
+{
+    for (size_t distinct : { 1, 3, 1000 })
+        test_vector(distinct);
+
+    for (size_t n : { 0, 100, 100000 })
+        test_stream(n, 7, memory_to_use);
+    // more runs than fit into memory, which are merged recursively
+    test_stream(n_records, 5, 16 * STXXL_DEFAULT_BLOCK_SIZE(value_type));
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+/***************************************************************************
+ *  tests/algo/test_suffix_array.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example algo/test_suffix_array.cpp
+//! Test \c stxxl::suffix_array() with DC3 and prefix doubling, and
+//! \c stxxl::burrows_wheeler_transform()
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/suffix_array>
+#include <stxxl/vector>
+
+using alphabet_type = unsigned char;
+using offset_type = uint32_t;
+using text_vector_type = stxxl::vector<alphabet_type>;
+using offset_vector_type = stxxl::vector<offset_type>;
+
+//! check the suffix and LCP arrays against sorting the suffixes naively
+void test(const std::vector<alphabet_type>& text,
+          stxxl::suffix_array_algorithm algo, size_t M)
+{
+    const size_t n = text.size();
+    LOG1 << "text of " << n << " characters, algorithm " << static_cast<int>(algo);
+
+    text_vector_type text_vector(n);
+    std::copy(text.begin(), text.end(), text_vector.begin());
+
+    offset_vector_type sa, lcp;
+    stxxl::suffix_array(text_vector.cbegin(), text_vector.cend(), sa, lcp, M, algo);
+
+    std::vector<offset_type> ref(n);
+    for (size_t i = 0; i < n; ++i)
+        ref[i] = static_cast<offset_type>(i);
+    std::sort(ref.begin(), ref.end(),
+              [&text](offset_type a, offset_type b) {
+                  return std::lexicographical_compare(
+                      text.begin() + a, text.end(), text.begin() + b, text.end());
+              });
+
+    die_unequal(sa.size(), n);
+    die_unequal(lcp.size(), n);
+    for (size_t k = 0; k < n; ++k)
+    {
+        die_unequal(sa[k], ref[k]);
+
+        size_t h = 0;
+        if (k > 0)
+        {
+            while (ref[k] + h < n && ref[k - 1] + h < n &&
+                   text[ref[k] + h] == text[ref[k - 1] + h])
+                ++h;
+        }
+        die_unequal(lcp[k], h);
+    }
+
+    if (algo != stxxl::suffix_array_algorithm::dc3)
+        return;
+
+    // the BWT omits the sentinel, which precedes the suffix at position zero
+    std::vector<alphabet_type> bwt_ref;
+    size_t primary_ref = 0;
+    if (n > 0)
+        bwt_ref.push_back(text[n - 1]);
+    for (size_t k = 0; k < n; ++k)
+    {
+        if (ref[k] == 0)
+            primary_ref = k + 1;
+        else
+            bwt_ref.push_back(text[ref[k] - 1]);
+    }
+
+    offset_vector_type sa2;
+    text_vector_type bwt;
+    die_unequal(stxxl::burrows_wheeler_transform(
+                    text_vector.cbegin(), text_vector.cend(), sa2, bwt, M), primary_ref);
+    die_unequal(sa2.size(), n);
+    die_unequal(bwt.size(), n);
+    for (size_t k = 0; k < n; ++k)
+    {
+        die_unequal(sa2[k], ref[k]);
+        die_unequal(bwt[k], bwt_ref[k]);
+    }
+
+    text_vector_type bwt2;
+    die_unequal(stxxl::burrows_wheeler_transform<offset_type>(
+                    text.begin(), text.end(), bwt2, M), primary_ref);
+    die_unequal(bwt2.size(), n);
+    for (size_t k = 0; k < n; ++k)
+        die_unequal(bwt2[k], bwt_ref[k]);
+}
+
+int main()
+{
+    const size_t M = 16 * 1024 * 1024;
+    std::mt19937 rng(42);
+
+    for (stxxl::suffix_array_algorithm algo :
+         { stxxl::suffix_array_algorithm::dc3,
+           stxxl::suffix_array_algorithm::prefix_doubling,
+           stxxl::suffix_array_algorithm::automatic })
+    {
+        for (size_t n : { 0, 1, 2, 3, 4, 7, 100, 20000, 200000 })
+        {
+            for (unsigned sigma : { 2, 4, 256 })
+            {
+                std::vector<alphabet_type> text(n);
+                for (alphabet_type& c : text)
+                    c = static_cast<alphabet_type>('a' + rng() % sigma);
+                test(text, algo, M);
+            }
+        }
+
+        // long repeats need many prefix doubling rounds
+        test(std::vector<alphabet_type>(3000, 'a'), algo, M);
+
+        std::vector<alphabet_type> periodic(5000);
+        for (size_t i = 0; i < periodic.size(); ++i)
+            periodic[i] = static_cast<alphabet_type>("abaabab"[i % 7]);
+        test(periodic, algo, M);
+    }
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
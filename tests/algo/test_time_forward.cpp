@@ -0,0 +1,134 @@
+/***************************************************************************
+ *  tests/algo/test_time_forward.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example algo/test_time_forward.cpp
+//! Test \c stxxl::time_forward by counting the paths of random DAGs.
+
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/time_forward>
+
+using node_type = uint64_t;
+using tf_type = stxxl::time_forward<node_type, uint64_t>;
+
+//! successors of a random DAG in which each edge leaves the batch of its
+//! source, the batches being batch consecutive nodes
+std::vector<std::vector<node_type> >
+random_dag(size_t n, size_t batch, size_t degree, std::mt19937_64& rng)
+{
+    std::vector<std::vector<node_type> > succ(n);
+    for (size_t v = 0; v < n; ++v)
+    {
+        const size_t first = (v / batch + 1) * batch;
+        if (first >= n)
+            continue;
+        const size_t d = rng() % (2 * degree + 1);
+        for (size_t k = 0; k < d; ++k)
+        {
+            // mostly to the next batches
+            const size_t span = (rng() % 4) ? 2 * batch : n - first;
+            succ[v].push_back(first + rng() % std::min(span, n - first));
+        }
+    }
+    return succ;
+}
+
+void test_paths(size_t n, size_t batch, size_t degree, std::mt19937_64& rng)
+{
+    LOG1 << "time_forward: " << n << " nodes in batches of " << batch;
+
+    const std::vector<std::vector<node_type> > succ = random_dag(n, batch, degree, rng);
+
+    // number of paths ending at each node, modulo 2^64
+    std::vector<uint64_t> ref(n, 1);
+    for (size_t v = 0; v < n; ++v)
+    {
+        for (node_type w : succ[v])
+            ref[w] += ref[v];
+    }
+
+    std::vector<uint64_t> paths(n, 0);
+    tf_type tf(64 * 1024 * 1024);
+
+    // an initial message for the first node
+    tf.push(0, 0);
+
+    tf.run(n, batch,
+           [&](const node_type& v, tf_type::message_iterator begin,
+               tf_type::message_iterator end, tf_type::sender& out) {
+               uint64_t p = 1;
+               for (tf_type::message_iterator it = begin; it != end; ++it)
+                   p += *it;
+               paths[v] = p;
+               for (node_type w : succ[v])
+                   out.send(w, p);
+           });
+
+    die_unequal(tf.next_node(), n);
+    die_unless(tf.empty());
+    for (size_t v = 0; v < n; ++v)
+        die_unequal(paths[v], ref[v]);
+}
+
+void test_errors()
+{
+    tf_type tf(64 * 1024 * 1024);
+    tf.push(5, 1);
+
+    // sending into the current batch
+    bool thrown = false;
+    try {
+        tf.step(10, [](const node_type& v, tf_type::message_iterator,
+                       tf_type::message_iterator, tf_type::sender& out) {
+                    out.send(v + 1, 0);
+                });
+    }
+    catch (const foxxll::bad_parameter&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+    die_unequal(tf.next_node(), 10u);
+
+    // pushing to an evaluated node
+    thrown = false;
+    try {
+        tf.push(3, 1);
+    }
+    catch (const foxxll::bad_parameter&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+
+    // the messages beyond the evaluated nodes stay in flight
+    tf.push(20, 1);
+    die_unequal(tf.step(15, [](const node_type&, tf_type::message_iterator,
+                               tf_type::message_iterator, tf_type::sender&) { }), 0u);
+    die_unequal(tf.size(), 1u);
+}
+
+int main()
+{
+    std::mt19937_64 rng(42);
+
+    test_paths(1, 1, 2, rng);
+    test_paths(1000, 1, 2, rng);
+    test_paths(100000, 100, 3, rng);
+    test_paths(1000000, 10000, 2, rng);
+
+    test_errors();
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
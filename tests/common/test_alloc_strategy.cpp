@@ -0,0 +1,137 @@
+/***************************************************************************
+ *  tests/common/test_alloc_strategy.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/common/alloc_strategy.h>
+#include <stxxl/vector>
+
+void test_shares()
+{
+    stxxl::disk_weights& w = stxxl::disk_weights::get_instance();
+    w.clear();
+
+    // without measurements all disks are equally fast
+    std::vector<double> s = w.shares(0, 4);
+    for (double x : s)
+        die_unless(std::abs(x - 0.25) < 1e-9);
+
+    // unknown disks get the mean speed of the measured ones
+    w.set_speed(0, 300, 300);
+    w.set_speed(1, 100, 100);
+    s = w.shares(0, 3);
+    die_unless(std::abs(s[0] - 0.5) < 1e-9);
+    die_unless(std::abs(s[1] - 1.0 / 6) < 1e-9);
+    die_unless(std::abs(s[2] - 1.0 / 3) < 1e-9);
+}
+
+void test_weighted_striping()
+{
+    stxxl::disk_weights& w = stxxl::disk_weights::get_instance();
+    w.clear();
+    w.set_speed(0, 300, 300);
+    w.set_speed(1, 100, 100);
+
+    // every 128 consecutive blocks hold the exact shares, interleaved
+    stxxl::weighted_striping ws(0, 2);
+    size_t count[2] = { 0, 0 }, longest_run = 0, run = 0;
+    for (size_t i = 0; i < 1280; ++i)
+    {
+        const size_t d = ws(i);
+        die_unless(d < 2);
+        count[d]++;
+        run = (i > 0 && ws(i - 1) == d) ? run + 1 : 1;
+        longest_run = std::max(longest_run, run);
+    }
+    die_unequal(count[0], 960u);
+    die_unequal(count[1], 320u);
+    die_unless(longest_run <= 3);
+
+    // a strategy over disks [2, 4) stays within them
+    stxxl::weighted_striping ws_off(2, 4);
+    for (size_t i = 0; i < 256; ++i)
+        die_unless(ws_off(i) >= 2 && ws_off(i) < 4);
+
+    w.clear();
+}
+
+void test_load_save()
+{
+    stxxl::disk_weights& w = stxxl::disk_weights::get_instance();
+    w.clear();
+    w.set_speed(0, 200e6, 100e6);
+    w.set_speed(1, 500e6, 400e6);
+
+    const std::string path = "test_alloc_strategy_weights.txt";
+    w.save(path);
+    w.clear();
+    die_unequal(w.speed(1), 0.0);
+
+    w.load(path);
+    die_unless(std::abs(w.speed(0) - 150e6) < 1);
+    die_unless(std::abs(w.speed(1) - 450e6) < 1);
+    std::remove(path.c_str());
+
+    bool thrown = false;
+    try {
+        w.load("nonexistent/disk_weights.txt");
+    }
+    catch (const foxxll::io_error&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+
+    w.clear();
+}
+
+void test_runtime_strategy()
+{
+    using stxxl::alloc_strategy_kind;
+
+    stxxl::runtime_alloc_strategy striping(alloc_strategy_kind::striping);
+    die_unequal(std::string(striping.name()), foxxll::striping::name());
+
+    // the setting is read when the strategy is constructed
+    stxxl::SETTINGS::alloc_strategy = alloc_strategy_kind::weighted;
+    stxxl::runtime_alloc_strategy weighted;
+    die_unequal(std::string(weighted.name()), stxxl::weighted_striping::name());
+
+    // containers allocate their blocks with the selected strategy
+    {
+        stxxl::vector<uint64_t> vec(4 * 1024 * 1024);
+        for (size_t i = 0; i < vec.size(); ++i)
+            vec[i] = i;
+        for (size_t i = 0; i < vec.size(); i += 4096)
+            die_unequal(vec[i], i);
+    }
+
+    stxxl::SETTINGS::alloc_strategy = alloc_strategy_kind::default_strategy;
+    stxxl::runtime_alloc_strategy def;
+    die_unequal(std::string(def.name()), foxxll::default_alloc_strategy::name());
+}
+
+int main()
+{
+    test_shares();
+    test_weighted_striping();
+    test_load_save();
+    test_runtime_strategy();
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,161 @@
+/***************************************************************************
+ *  tests/common/test_arena.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/common/arena.h>
+#include <stxxl/comparator>
+#include <stxxl/unordered_map>
+
+void test_reuse()
+{
+    stxxl::arena a(stxxl::arena::unlimited, 64 * 1024, false);
+
+    void* p = a.allocate(100);
+    die_unequal(a.allocated(), 128u);
+    die_unequal(a.reserved(), 64 * 1024u);
+    a.deallocate(p, 100);
+    die_unequal(a.allocated(), 0u);
+
+    // a freed chunk is reused by its size class
+    die_unless(a.allocate(120) == p);
+    a.deallocate(p, 120);
+
+    // large requests get a mapping of their own
+    void* large = a.allocate(100 * 1024);
+    die_unequal(a.reserved(), (64 + 100) * 1024u);
+    memset(large, 1, 100 * 1024);
+    a.deallocate(large, 100 * 1024);
+    die_unequal(a.reserved(), 64 * 1024u);
+    die_unequal(a.peak(), 100 * 1024u);
+
+    a.release();
+    die_unequal(a.reserved(), 0u);
+}
+
+void test_capacity()
+{
+    // four slabs of 64 KiB, quarter slab chunks
+    stxxl::arena a(256 * 1024, 64 * 1024, false);
+
+    std::vector<void*> chunks;
+    bool thrown = false;
+    try {
+        for (size_t i = 0; i < 100; ++i)
+            chunks.push_back(a.allocate(16 * 1024));
+    }
+    catch (const std::bad_alloc&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+    die_unequal(chunks.size(), 16u);
+    die_unequal(a.reserved(), a.capacity());
+
+    // freed chunks are allocated again within the capacity
+    a.deallocate(chunks.back(), 16 * 1024);
+    chunks.back() = a.allocate(16 * 1024);
+    for (void* p : chunks)
+        a.deallocate(p, 16 * 1024);
+    die_unequal(a.allocated(), 0u);
+}
+
+void test_threads()
+{
+    stxxl::arena a;
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 8; ++t)
+    {
+        threads.emplace_back(
+            [&a, t]() {
+                std::mt19937 rng(t);
+                std::vector<std::pair<uint8_t*, size_t> > chunks;
+                for (size_t i = 0; i < 20000; ++i)
+                {
+                    if (chunks.empty() || rng() % 3 != 0)
+                    {
+                        const size_t bytes = 1 + rng() % 4096;
+                        uint8_t* p = static_cast<uint8_t*>(a.allocate(bytes));
+                        memset(p, static_cast<int>(bytes & 0xFF), bytes);
+                        chunks.emplace_back(p, bytes);
+                    }
+                    else
+                    {
+                        const size_t k = rng() % chunks.size();
+                        const size_t bytes = chunks[k].second;
+                        for (size_t j = 0; j < bytes; ++j)
+                            die_unequal(chunks[k].first[j], bytes & 0xFF);
+                        a.deallocate(chunks[k].first, bytes);
+                        chunks[k] = chunks.back();
+                        chunks.pop_back();
+                    }
+                }
+                for (const auto& c : chunks)
+                    a.deallocate(c.first, c.second);
+            });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    die_unequal(a.allocated(), 0u);
+    LOG1 << "arena peak " << a.peak() << " reserved " << a.reserved();
+}
+
+void test_containers()
+{
+    stxxl::arena a;
+
+    {
+        std::vector<uint64_t, stxxl::arena_allocator<uint64_t> > vec {
+            stxxl::arena_allocator<uint64_t>(a)
+        };
+        for (uint64_t i = 0; i < 100000; ++i)
+            vec.push_back(i);
+        die_unless(a.allocated() >= vec.size() * sizeof(uint64_t));
+    }
+    die_unequal(a.allocated(), 0u);
+
+    using alloc_type = stxxl::arena_allocator<std::pair<const int, int> >;
+    using map_type = stxxl::unordered_map<
+              int, int, std::hash<int>, stxxl::comparator<int>,
+              4 * 1024, 4, alloc_type>;
+    {
+        // the buffer of the map is allocated from the arena
+        map_type map(0, std::hash<int>(), stxxl::comparator<int>(),
+                     16 * 1024 * 1024, alloc_type(a));
+        for (int i = 0; i < 100000; ++i)
+            map.insert(std::make_pair(i, 2 * i));
+        die_unless(a.allocated() > 0);
+        die_unless(map.get_allocator().get_arena() == &a);
+        for (int i = 0; i < 100000; i += 1000)
+            die_unequal(map.find(i)->second, 2 * i);
+    }
+    die_unequal(a.allocated(), 0u);
+}
+
+int main()
+{
+    test_reuse();
+    test_capacity();
+    test_threads();
+    test_containers();
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -10,7 +10,12 @@
  *  http://www.boost.org/LICENSE_1_0.txt)
  **************************************************************************/
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <random>
+#include <string>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
@@ -87,8 +92,108 @@ void test1()
 //! [deserialize]
 }
 
+//! varints of mixed lengths, mostly one byte
+std::vector<uint32_t> random_varints(size_t n)
+{
+    std::mt19937 rng(42);
+    std::vector<uint32_t> values(n);
+    for (uint32_t& v : values)
+    {
+        switch (rng() % 8) {
+        case 0: v = static_cast<uint32_t>(rng()); break;
+        case 1: v = rng() % 100000; break;
+        default: v = rng() % 128; break;
+        }
+    }
+    return values;
+}
+
+void test_varint_array()
+{
+    const std::vector<uint32_t> values = random_varints(10000);
+
+    stxxl::binary_buffer bb;
+    for (uint32_t v : values)
+        bb.put_varint(v);
+    bb.put_varint(7);
+
+    // bulk decoding matches get_varint() and stops at the same position
+    stxxl::binary_reader br(bb);
+    std::vector<uint32_t> out(values.size());
+    br.get_varint_array(out.data(), out.size());
+    die_unless(out == values);
+    die_unequal(br.get_varint(), 7u);
+    die_unless(br.empty());
+
+    // underrun
+    stxxl::binary_reader br2(bb);
+    std::vector<uint32_t> more(values.size() + 2);
+    bool thrown = false;
+    try {
+        br2.get_varint_array(more.data(), more.size());
+    }
+    catch (const std::underflow_error&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+}
+
+void test_segmented()
+{
+    const std::vector<uint32_t> values = random_varints(5000);
+
+    stxxl::binary_buffer bb;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        bb.put_varint(values[i]);
+        bb.put<uint64_t>(values[i] * uint64_t(3));
+        bb.put_varint(uint64_t(values[i]) << 20);
+        bb.put_string(std::string(values[i] % 50, 'x'));
+    }
+    for (uint32_t v : values)
+        bb.put_varint(v);
+
+    // blocks of odd size, such that all items span boundaries somewhere
+    struct block_type
+    {
+        char data[37];
+    };
+    std::vector<block_type> blocks((bb.size() + sizeof(block_type) - 1) / sizeof(block_type));
+    memcpy(blocks.data(), bb.data(), bb.size());
+
+    stxxl::segmented_binary_reader sr;
+    sr.add_blocks(blocks.begin(), blocks.end());
+    die_unequal(sr.size(), blocks.size() * sizeof(block_type));
+
+    stxxl::binary_buffer staging;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        die_unequal(sr.get_varint(), values[i]);
+        die_unequal(sr.get<uint64_t>(), values[i] * uint64_t(3));
+        die_unequal(sr.get_varint64(), uint64_t(values[i]) << 20);
+        stxxl::binary_buffer_ref str = sr.get_binary_buffer_ref(staging);
+        die_unless(str == stxxl::binary_buffer_ref(std::string(values[i] % 50, 'x')));
+    }
+    std::vector<uint32_t> out(values.size());
+    sr.get_varint_array(out.data(), out.size());
+    die_unless(out == values);
+    die_unequal(sr.curr(), bb.size());
+
+    sr.skip(sr.size() - sr.curr());
+    die_unless(sr.empty());
+
+    // the same through segments of one contiguous region
+    sr = stxxl::segmented_binary_reader();
+    sr.add_segment(bb.data(), 1).add_segment(bb.data() + 1, bb.size() - 1);
+    die_unequal(sr.get_varint(), values[0]);
+    sr.rewind();
+    die_unequal(sr.get_varint(), values[0]);
+}
+
 int main(int, char**)
 {
     test1();
+    test_varint_array();
+    test_segmented();
     return 0;
 }
@@ -0,0 +1,62 @@
+/***************************************************************************
+ *  tests/common/test_block_array.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng/typed_block.hpp>
+
+#include <stxxl/bits/common/block_array.h>
+
+using block_type = foxxll::typed_block<1024 * 1024, uint64_t>;
+
+//! Fill and check an array of n blocks.
+void test_block_array(size_t n)
+{
+    block_type* blocks = stxxl::new_block_array<block_type>(n);
+    die_unless(reinterpret_cast<uintptr_t>(blocks) % 4096 == 0);
+
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < block_type::size; ++j)
+            blocks[i][j] = i * block_type::size + j;
+
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < block_type::size; ++j)
+            die_unequal(blocks[i][j], i * block_type::size + j);
+
+    stxxl::delete_block_array(blocks, n);
+}
+
+int main()
+{
+    // normal allocation
+    test_block_array(1);
+    test_block_array(5);
+
+    // huge pages: smaller arrays than a huge page are allocated normally,
+    // large ones are mapped or fall back to normal allocation
+    stxxl::SETTINGS::huge_pages = true;
+    LOG1 << "huge pages supported: " << STXXL_HAVE_HUGE_PAGES;
+    test_block_array(1);
+    test_block_array(5);
+    test_block_array(64);
+
+    // an array allocated with huge pages is released normally if the
+    // setting is switched off meanwhile
+    block_type* blocks = stxxl::new_block_array<block_type>(8);
+    stxxl::SETTINGS::huge_pages = false;
+    stxxl::delete_block_array(blocks, 8);
+
+    return EXIT_SUCCESS;
+}
+
+/******************************************************************************/
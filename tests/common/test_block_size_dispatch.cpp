@@ -0,0 +1,76 @@
+/***************************************************************************
+ *  tests/common/test_block_size_dispatch.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/common/block_size_dispatch.h>
+#include <stxxl/queue>
+#include <stxxl/vector>
+
+//! Fill and check a vector and a queue with the block size chosen at run
+//! time, return the block size of the vector.
+size_t run_containers(size_t block_size)
+{
+    return stxxl::dispatch_block_size(
+        block_size, [](auto bs) -> size_t {
+            constexpr size_t size = decltype(bs)::value;
+
+            stxxl::vector<uint64_t, 1, stxxl::lru_pager<2>, size> vec(
+                4 * size / sizeof(uint64_t));
+            for (size_t i = 0; i < vec.size(); ++i)
+                vec[i] = i;
+            for (size_t i = 0; i < vec.size(); ++i)
+                die_unequal(vec[i], i);
+
+            stxxl::queue<uint64_t, size> queue;
+            for (uint64_t i = 0; i < vec.size(); ++i)
+                queue.push(i);
+            for (uint64_t i = 0; i < vec.size(); ++i, queue.pop())
+                die_unequal(queue.front(), i);
+
+            return decltype(vec)::block_size;
+        });
+}
+
+int main()
+{
+    for (size_t block_size : { 64 * 1024, 1024 * 1024, 8 * 1024 * 1024 })
+    {
+        LOG1 << "block size " << block_size;
+        die_unequal(run_containers(block_size), block_size);
+    }
+
+    // block sizes not in the list are rejected
+    bool thrown = false;
+    try {
+        run_containers(3 * 1024 * 1024);
+    }
+    catch (const foxxll::bad_parameter&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+
+    // a custom list instantiates only the given sizes
+    size_t calls = 0;
+    stxxl::dispatch_block_size<stxxl::block_size_list<4096, 8192> >(
+        8192, [&calls](auto bs) {
+            die_unequal(decltype(bs)::value, 8192u);
+            calls++;
+        });
+    die_unequal(calls, 1u);
+
+    return 0;
+}
+
+/******************************************************************************/
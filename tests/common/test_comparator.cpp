@@ -12,6 +12,9 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <functional>
+#include <tuple>
+#include <type_traits>
 #include <iostream>
 #include <vector>
 
@@ -228,6 +231,84 @@ void test_comparator_extract()
     }
 }
 
+void test_branchless_comparable()
+{
+    std::cout << "Test branchless comparable trait" << std::endl;
+
+    struct small_type {
+        int key;
+        int val;
+    };
+    struct large_type {
+        int key;
+        double val[4];
+    };
+
+    static_assert(stxxl::is_branchless_comparable<int, std::less<int> >::value,
+                  "arithmetic keys are branchless");
+    static_assert(stxxl::is_branchless_comparable<double*, std::less<double*> >::value,
+                  "pointer keys are branchless");
+    static_assert(stxxl::is_branchless_comparable<
+                      std::pair<int, char>, stxxl::comparator<std::pair<int, char> > >::value,
+                  "small pairs are branchless with stxxl::comparator");
+    static_assert(!stxxl::is_branchless_comparable<
+                      std::pair<int, char>, std::less<std::pair<int, char> > >::value,
+                  "pairs are not branchless with other comparators");
+
+    const auto small_cmp = stxxl::make_struct_comparator<small_type, direction::Less>(
+        [](auto& o) { return std::tie(o.key); });
+    const auto large_cmp = stxxl::make_struct_comparator<large_type, direction::Less>(
+        [](auto& o) { return std::tie(o.key); });
+
+    static_assert(stxxl::is_branchless_comparable<
+                      small_type, std::decay_t<decltype(small_cmp)> >::value,
+                  "small structs are branchless with stxxl::struct_comparator");
+    static_assert(!stxxl::is_branchless_comparable<
+                      large_type, std::decay_t<decltype(large_cmp)> >::value,
+                  "large structs are not branchless");
+
+    die_unless(small_cmp(small_type { 1, 2 }, small_type { 2, 1 }));
+    die_unless(large_cmp(large_type { 1, { } }, large_type { 2, { } }));
+}
+
+void test_comparator_traits()
+{
+    std::cout << "Test comparator traits" << std::endl;
+
+    struct record_type {
+        uint32_t key;
+        double weight;
+    };
+
+    using pair_traits = stxxl::comparator_traits<
+              stxxl::comparator<std::pair<int, char>, direction::Greater> >;
+    static_assert(pair_traits::is_typed, "stxxl::comparator is typed");
+    static_assert(pair_traits::num_keys == 2, "pairs have two keys");
+    static_assert(pair_traits::integral_keys, "int and char are integral keys");
+    static_assert(pair_traits::first_direction == direction::Greater,
+                  "direction of the first key");
+    static_assert(std::is_same<pair_traits::directions,
+                               stxxl::direction_list<direction::Greater> >::value,
+                  "directions as given");
+
+    static_assert(stxxl::comparator_traits<stxxl::comparator<int> >::first_direction
+                  == direction::Less, "ascending by default");
+    static_assert(!stxxl::comparator_traits<std::less<int> >::is_typed,
+                  "other comparators are not typed");
+
+    const auto cmp = stxxl::make_struct_comparator<record_type, direction::Less, direction::Greater>(
+        [](auto& o) { return std::tie(o.key, o.weight); });
+    using record_traits = stxxl::comparator_traits<std::decay_t<decltype(cmp)> >;
+    static_assert(record_traits::is_typed, "stxxl::struct_comparator is typed");
+    static_assert(std::is_same<record_traits::key_type, std::tuple<uint32_t, double> >::value,
+                  "key type without references");
+    static_assert(!record_traits::integral_keys, "double is no integral key");
+
+    const record_type r { 42, 0.5 };
+    die_unequal(std::get<0>(record_traits::keys(cmp, r)), 42u);
+    die_unequal(std::get<1>(record_traits::keys(cmp, r)), 0.5);
+}
+
 int main()
 {
     const std::vector<int> int_values({ -5, -1, 0, 1, 5 });
@@ -248,6 +329,8 @@ int main()
 
     test_own_implementation();
     test_comparator_extract();
+    test_branchless_comparable();
+    test_comparator_traits();
 
     std::cout << "Success." << std::endl;
     return 0;
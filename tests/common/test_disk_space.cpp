@@ -0,0 +1,81 @@
+/***************************************************************************
+ *  tests/common/test_disk_space.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/common/disk_space.h>
+#include <stxxl/sorter>
+#include <stxxl/vector>
+
+using vector_type = stxxl::vector<uint64_t, 1, stxxl::lru_pager<2>, 1024 * 1024>;
+
+static const uint64_t num_items = 16 * 1024 * 1024;
+
+static void fill(vector_type& vec, uint64_t salt)
+{
+    vec.resize(num_items);
+    vector_type::bufwriter_type writer(vec);
+    for (uint64_t i = 0; i < num_items; ++i)
+        writer << (i ^ salt);
+    writer.finish();
+}
+
+int main()
+{
+    stxxl::SETTINGS::reclaim_disk_space = true;
+    stxxl::disk_space_reclaimer& reclaimer = stxxl::disk_space_reclaimer::get_instance();
+
+    // the blocks of a destroyed vector are punched in few coalesced holes
+    {
+        vector_type vec;
+        fill(vec, 0);
+    }
+    const uint64_t reclaimed = reclaimer.reclaimed_bytes();
+    LOG1 << "reclaimed " << reclaimed << " bytes in "
+         << reclaimer.holes_punched() << " holes";
+    if (reclaimed > 0)
+    {
+        die_unequal(reclaimed, num_items * sizeof(uint64_t));
+        die_unless(reclaimer.holes_punched() < 128);
+    }
+
+    // reallocated blocks hold their new data
+    {
+        vector_type vec;
+        fill(vec, 0x5555);
+        vector_type::bufreader_type reader(vec);
+        for (uint64_t i = 0; i < vec.size(); ++i, ++reader)
+            die_unequal(*reader, i ^ 0x5555);
+    }
+
+    // the runs of a sorter are reclaimed when it is cleared
+    {
+        stxxl::sorter<uint64_t, stxxl::comparator<uint64_t> > sorter(
+            stxxl::comparator<uint64_t>(), 16 * 1024 * 1024);
+        for (uint64_t i = 0; i < 8 * 1024 * 1024; ++i)
+            sorter.push((i * 0x9E3779B97F4A7C15ull) >> 8);
+        sorter.sort();
+        uint64_t prev = 0;
+        for ( ; !sorter.empty(); ++sorter)
+        {
+            die_unless(prev <= *sorter);
+            prev = *sorter;
+        }
+        sorter.clear();
+    }
+    LOG1 << "reclaimed " << reclaimer.reclaimed_bytes() << " bytes in total";
+
+    return 0;
+}
+
+/******************************************************************************/
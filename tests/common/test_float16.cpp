@@ -0,0 +1,71 @@
+/***************************************************************************
+ *  tests/common/test_float16.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cmath>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/common/float16.h>
+
+using stxxl::float16;
+using stxxl::bfloat16;
+
+//! every value except NaN converts back to its bit representation
+template <typename Float>
+void test_round_trip()
+{
+    for (uint32_t bits = 0; bits < 0x10000; ++bits)
+    {
+        const float value = Float::to_float(static_cast<uint16_t>(bits));
+        if (std::isnan(value))
+            die_unless(std::isnan(float(Float(value))));
+        else
+            die_unequal(Float::from_float(value), bits);
+    }
+}
+
+//! values between two float16 round to the nearer one, midpoints to even
+void test_float16_rounding()
+{
+    for (uint16_t bits = 0; bits < 0x7BFF; ++bits)
+    {
+        const uint16_t next = static_cast<uint16_t>(bits + 1);
+        const float mid = static_cast<float>(
+            (double(float16::to_float(bits)) + double(float16::to_float(next))) / 2);
+        die_unequal(float16::from_float(mid), (bits % 2 == 0) ? bits : next);
+        die_unequal(float16::from_float(std::nextafter(mid, 0.0f)), bits);
+        die_unequal(float16::from_float(std::nextafter(mid, 1e30f)), next);
+    }
+
+    // overflow and underflow
+    die_unequal(float16::from_float(65519.0f), 0x7BFF);
+    die_unequal(float16::from_float(65520.0f), 0x7C00);
+    die_unequal(float16::from_float(-1e30f), 0xFC00);
+    die_unequal(float16::from_float(1e-8f), 0);
+}
+
+int main()
+{
+    test_round_trip<float16>();
+    test_round_trip<bfloat16>();
+    test_float16_rounding();
+
+    die_unequal(float(bfloat16(3.14159f)), 3.140625f);
+
+    float16 h = 1.5f;
+    h += 2;
+    h *= 2;
+    die_unequal(float(h), 7.0f);
+
+    LOG1 << "float16 size " << sizeof(float16) << ", bfloat16 size " << sizeof(bfloat16);
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+/***************************************************************************
+ *  tests/common/test_io_retry.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+#include <foxxll/mng.hpp>
+
+#include <stxxl/bits/common/io_retry.h>
+
+using block_type = foxxll::typed_block<16384, uint64_t>;
+
+//! The failing requests come from files which cannot serve them: reads at
+//! the end of an empty file and writes to a file opened read-only. The
+//! retries are then made on the file passed to io_retry::wait().
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " file" << std::endl;
+        return -1;
+    }
+
+    const std::string fn = argv[1];
+    stxxl::io_retry& retry = stxxl::io_retry::get_instance();
+    retry.set_backoff(0);
+    retry.set_max_retries(2);
+
+    std::unique_ptr<block_type> block(new block_type), check(new block_type);
+    for (size_t i = 0; i < block_type::size; ++i)
+        (*block)[i] = 3 * i + 1;
+
+    foxxll::file_ptr data = foxxll::create_file(
+        "syscall", fn + ".data", foxxll::file::CREAT | foxxll::file::RDWR);
+    foxxll::file_ptr empty = foxxll::create_file(
+        "syscall", fn + ".empty", foxxll::file::CREAT | foxxll::file::RDWR);
+    empty->set_size(0);
+
+    const uint64_t retried0 = retry.retried(), split0 = retry.split();
+    const uint64_t failed0 = retry.failed(), zeroed0 = retry.zeroed();
+
+    LOG1 << "recovering a failed write";
+    {
+        data->set_size(2 * block_type::raw_size);
+        foxxll::file_ptr rdonly = foxxll::create_file(
+            "syscall", fn + ".data", foxxll::file::RDONLY);
+        foxxll::request_ptr req = rdonly->awrite(block.get(), 0, block_type::raw_size);
+        retry.wait(req, data.get(), block.get(), 0, block_type::raw_size, true);
+
+        die_unequal(retry.retried(), retried0 + 1);
+        die_unequal(retry.split(), split0 + 2);
+        die_unequal(retry.failed(), failed0);
+
+        data->aread(check.get(), 0, block_type::raw_size)->wait();
+        for (size_t i = 0; i < block_type::size; ++i)
+            die_unequal((*check)[i], 3 * i + 1);
+    }
+
+    LOG1 << "recovering a failed read";
+    {
+        foxxll::request_ptr req = empty->aread(check.get(), 0, block_type::raw_size);
+        retry.wait(req, data.get(), check.get(), 0, block_type::raw_size, false);
+
+        die_unequal(retry.retried(), retried0 + 2);
+        die_unequal(retry.split(), split0 + 4);
+        for (size_t i = 0; i < block_type::size; ++i)
+            die_unequal((*check)[i], 3 * i + 1);
+    }
+
+    LOG1 << "zeroing a read beyond the end of the file";
+    {
+        // the second block of data ends after its first half
+        data->awrite(block.get(), block_type::raw_size, block_type::raw_size)->wait();
+        data->set_size(block_type::raw_size + block_type::raw_size / 2);
+
+        foxxll::request_ptr req = empty->aread(check.get(), 0, block_type::raw_size);
+        retry.wait(req, data.get(), check.get(), block_type::raw_size,
+                   block_type::raw_size, false);
+
+        die_unequal(retry.retried(), retried0 + 3);
+        die_unequal(retry.split(), split0 + 6);
+        die_unequal(retry.zeroed(), zeroed0 + block_type::raw_size / 2);
+        for (size_t i = 0; i < block_type::size; ++i)
+            die_unequal((*check)[i], i < block_type::size / 2 ? 3 * i + 1 : 0);
+
+        // nothing is left to read at the end of the empty file
+        req = empty->aread(check.get(), 0, block_type::raw_size);
+        retry.wait(req, empty.get(), check.get(), 0, block_type::raw_size, false);
+        die_unequal(retry.zeroed(), zeroed0 + 3 * block_type::raw_size / 2);
+        for (size_t i = 0; i < block_type::size; ++i)
+            die_unequal((*check)[i], 0u);
+    }
+
+    LOG1 << "rethrowing after the last attempt";
+    {
+        foxxll::file_ptr rdonly = foxxll::create_file(
+            "syscall", fn + ".data", foxxll::file::RDONLY);
+        foxxll::request_ptr req = rdonly->awrite(block.get(), 0, block_type::raw_size);
+
+        bool thrown = false;
+        try {
+            retry.wait(req, rdonly.get(), block.get(), 0, block_type::raw_size, true);
+        }
+        catch (const foxxll::io_error&) {
+            thrown = true;
+        }
+        die_unless(thrown);
+
+        // two attempts in 2 and 4 parts, all waited for before the rethrow
+        die_unequal(retry.retried(), retried0 + 5);
+        die_unequal(retry.split(), split0 + 6 + 2 + 4);
+        die_unequal(retry.failed(), failed0 + 1);
+    }
+
+    // no retries at all
+    {
+        retry.set_max_retries(0);
+        foxxll::request_ptr req = empty->aread(check.get(), 0, block_type::raw_size);
+
+        bool thrown = false;
+        try {
+            retry.wait(req, empty.get(), check.get(), 0, block_type::raw_size, false);
+        }
+        catch (const foxxll::io_error&) {
+            thrown = true;
+        }
+        die_unless(thrown);
+        die_unequal(retry.retried(), retried0 + 5);
+        retry.set_max_retries(3);
+    }
+
+    retry.print_status(std::cout);
+
+    data->close_remove();
+    empty->close_remove();
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,83 @@
+/***************************************************************************
+ *  tests/common/test_locked_memory.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng/typed_block.hpp>
+
+#include <stxxl/bits/common/locked_memory.h>
+#include <stxxl/vector>
+
+using block_type = foxxll::typed_block<64 * 1024, uint64_t>;
+
+int main()
+{
+    stxxl::locked_memory& lm = stxxl::locked_memory::get_instance();
+    LOG1 << "RLIMIT_MEMLOCK: " << lm.limit() << " bytes";
+
+    block_type* blocks = new block_type[4];
+
+    // nothing is locked unless enabled
+    stxxl::lock_blocks(blocks, 4);
+    die_unequal(lm.locked(), 0u);
+
+    stxxl::SETTINGS::lock_memory = true;
+
+    // the locked bytes are accounted, mlock() may be refused here
+    if (lm.limit() >= 2 * sizeof(block_type))
+    {
+        const bool locked = lm.lock(blocks, 2 * sizeof(block_type));
+        LOG1 << "mlock() " << (locked ? "succeeded" : "failed");
+        die_unequal(lm.locked(), locked ? 2 * sizeof(block_type) : 0u);
+        lm.unlock(blocks);
+        die_unequal(lm.locked(), 0u);
+    }
+
+    // ranges without a whole page and unknown pointers are ignored
+    die_unless(!lm.lock(reinterpret_cast<char*>(blocks) + 1, 4095));
+    lm.unlock(blocks + 3);
+    die_unequal(lm.locked(), 0u);
+
+    // over the limit, the blocks fall back to unlocked memory
+    const size_t limit = lm.limit();
+    lm.set_limit(sizeof(block_type));
+    for (size_t i = 0; i < 4; ++i)
+        stxxl::lock_blocks(blocks + i);
+    die_unless(lm.locked() <= sizeof(block_type));
+    for (size_t i = 0; i < 4; ++i)
+        stxxl::unlock_blocks(blocks + i);
+    die_unequal(lm.locked(), 0u);
+    lm.set_limit(limit);
+
+    delete[] blocks;
+
+    // the page cache of a vector is unlocked with it
+    {
+        using vector_type = stxxl::vector<uint64_t, 2, stxxl::lru_pager<4>, 64 * 1024>;
+        vector_type v(1024 * 1024);
+        for (size_t i = 0; i < v.size(); ++i)
+            v[i] = i;
+        for (size_t i = 0; i < v.size(); ++i)
+            die_unequal(v[i], i);
+        LOG1 << "vector page cache: " << lm.locked() << " bytes locked";
+    }
+    die_unequal(lm.locked(), 0u);
+
+    stxxl::SETTINGS::lock_memory = false;
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
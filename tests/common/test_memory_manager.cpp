@@ -0,0 +1,155 @@
+/***************************************************************************
+ *  tests/common/test_memory_manager.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/memory_manager>
+#include <stxxl/vector>
+
+using stxxl::memory_manager;
+using stxxl::memory_reservation;
+
+void test_reservations()
+{
+    memory_manager& mm = memory_manager::get_instance();
+    const size_t base = mm.reserved();
+
+    {
+        memory_reservation a("a", 1000);
+        memory_reservation b("b");
+        die_unequal(mm.reserved(), base + 1000);
+
+        b.resize(500);
+        a.resize(200);
+        die_unequal(mm.reserved(), base + 700);
+
+        // moving keeps the reservation
+        memory_reservation c(std::move(a));
+        die_unequal(c.size(), 200u);
+        die_unequal(a.size(), 0u);
+        die_unequal(mm.reserved(), base + 700);
+
+        c.release();
+        die_unequal(mm.reserved(), base + 500);
+    }
+    die_unequal(mm.reserved(), base);
+}
+
+void test_limit()
+{
+    memory_manager& mm = memory_manager::get_instance();
+    mm.set_limit(mm.reserved() + 1000);
+
+    memory_reservation a("a", 600);
+
+    // overdraft throws and keeps the previous size
+    bool thrown = false;
+    try {
+        memory_reservation b("b", 600);
+    }
+    catch (const foxxll::bad_parameter& e) {
+        LOG1 << "caught: " << e.what();
+        thrown = true;
+    }
+    die_unless(thrown);
+    die_unequal(mm.available(), 400u);
+
+    thrown = false;
+    try {
+        a.resize(2000);
+    }
+    catch (const foxxll::bad_parameter&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+    die_unequal(a.size(), 600u);
+
+    // with the allow policy the reservation is granted
+    mm.set_overdraft_policy(memory_manager::allow);
+    a.resize(2000);
+    die_unequal(mm.available(), 0u);
+    mm.set_overdraft_policy(memory_manager::throw_error);
+
+    a.release();
+    mm.set_limit(memory_manager::unlimited);
+}
+
+void test_shrink()
+{
+    memory_manager& mm = memory_manager::get_instance();
+    mm.set_limit(mm.reserved() + 1000);
+
+    // a buffer which spills half of its memory when asked
+    size_t spilled = 0;
+    memory_reservation buffer;
+    buffer = memory_reservation(
+        "buffer", 800,
+        [&](size_t needed) {
+            const size_t release = std::min(buffer.size(), std::max(needed, buffer.size() / 2));
+            buffer.resize(buffer.size() - release);
+            spilled += release;
+            return release;
+        });
+
+    memory_reservation other("other", 500);
+    die_unless(spilled >= 300);
+    die_unless(mm.reserved() <= mm.limit());
+
+    // the buffer spills everything for the growth of the other reservation,
+    // but its callback is not asked for its own growth
+    other.resize(1000);
+    die_unequal(buffer.size(), 0u);
+    bool thrown = false;
+    try {
+        buffer.resize(1000);
+    }
+    catch (const foxxll::bad_parameter&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+
+    mm.set_limit(memory_manager::unlimited);
+}
+
+void test_vector()
+{
+    memory_manager& mm = memory_manager::get_instance();
+    const size_t base = mm.reserved();
+
+    {
+        using vector_type = stxxl::vector<uint64_t, 4, stxxl::lru_pager<8> >;
+        vector_type vec(1024 * 1024);
+        die_unequal(mm.reserved(), base + 8 * 4 * sizeof(vector_type::block_type));
+
+        vec.deallocate_page_cache();
+        die_unequal(mm.reserved(), base);
+        vec.allocate_page_cache();
+        mm.print_status(std::cout);
+    }
+    die_unequal(mm.reserved(), base);
+}
+
+int main()
+{
+    test_reservations();
+    test_limit();
+    test_shrink();
+    test_vector();
+
+    return 0;
+}
+
+/******************************************************************************/
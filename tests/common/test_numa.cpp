@@ -0,0 +1,89 @@
+/***************************************************************************
+ *  tests/common/test_numa.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng/typed_block.hpp>
+
+#include <stxxl/bits/common/numa.h>
+#include <stxxl/scan>
+#include <stxxl/vector>
+
+using block_type = foxxll::typed_block<64 * 1024, uint64_t>;
+
+int main()
+{
+    stxxl::numa_topology& topology = stxxl::numa_topology::get_instance();
+    LOG1 << "NUMA nodes: " << topology.nodes();
+    die_unless(topology.nodes() >= 1);
+    die_unless(topology.current_node() < topology.nodes());
+
+    stxxl::SETTINGS::numa_partition = true;
+
+    // blocks are partitioned into contiguous ranges per node, groups stay
+    // on one node
+    const size_t n = 100;
+    for (size_t i = 1; i < n; ++i)
+    {
+        die_unless(stxxl::numa_block_node(i, n) < topology.nodes());
+        die_unless(stxxl::numa_block_node(i - 1, n) <= stxxl::numa_block_node(i, n));
+        if (i % 4 != 0)
+            die_unequal(stxxl::numa_block_node(i - 1, n, 4), stxxl::numa_block_node(i, n, 4));
+    }
+    die_unequal(stxxl::numa_block_node(0, n), 0u);
+    die_unequal(stxxl::numa_block_node(n - 1, n), topology.nodes() - 1);
+
+    block_type* blocks = new block_type[8];
+    stxxl::numa_partition_blocks(blocks, 8);
+    for (size_t i = 0; i < 8; ++i)
+        blocks[i][0] = i;
+    delete[] blocks;
+
+    // each index is called once, wherever the threads run
+    {
+        std::unique_ptr<std::atomic<size_t>[]> calls(new std::atomic<size_t>[1000]);
+        for (size_t i = 0; i < 1000; ++i)
+            calls[i] = 0;
+        stxxl::numa_parallel_for(
+            1000, [](size_t i) { return stxxl::numa_block_node(i, 1000); },
+            [&](size_t i) { ++calls[i]; });
+        for (size_t i = 0; i < 1000; ++i)
+            die_unequal(size_t(calls[i]), 1u);
+    }
+
+    // a vector with a partitioned page cache, scanned in parallel
+    {
+        using vector_type = stxxl::vector<uint64_t, 2, stxxl::lru_pager<4>, 64 * 1024>;
+        vector_type v(1024 * 1024);
+        for (size_t i = 0; i < v.size(); ++i)
+            v[i] = i;
+        die_unless(v.cache_node(v.size() - 1) < topology.nodes());
+        for (size_t i = 0; i < v.size(); ++i)
+            die_unequal(v[i], i);
+
+        std::atomic<uint64_t> sum { 0 };
+        stxxl::parallel_for_each(v.begin(), v.end(), [&sum](uint64_t x) { sum += x; });
+        die_unequal(uint64_t(sum), uint64_t(v.size()) * (v.size() - 1) / 2);
+        die_unequal(v.cache_node(0), topology.nodes());
+    }
+
+    stxxl::SETTINGS::numa_partition = false;
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
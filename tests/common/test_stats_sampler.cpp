@@ -0,0 +1,86 @@
+/***************************************************************************
+ *  tests/common/test_stats_sampler.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stats_sampler>
+#include <stxxl/vector>
+
+int main()
+{
+    stxxl::custom_stats_counter<uint64_t> counter;
+    std::ostringstream log;
+
+    {
+        stxxl::stats_sampler sampler(0.01, 4);
+        sampler.add_counter("items", counter);
+        sampler.add_counter("constant", []() { return uint64_t(42); });
+        sampler.set_log(log);
+        sampler.start();
+
+        // some I/O while sampling
+        stxxl::vector<uint64_t> vec(4 * 1024 * 1024);
+        for (uint64_t i = 0; i < vec.size(); ++i)
+        {
+            vec[i] = i;
+            ++counter;
+        }
+        // fill the ring buffer regardless of the scheduling of the thread
+        for (size_t i = 0; i < 4; ++i)
+            sampler.sample();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        sampler.stop();
+
+        // the ring buffer holds the last samples, oldest first
+        std::vector<stxxl::stats_sample> samples = sampler.samples();
+        die_unequal(samples.size(), 4u);
+        for (size_t i = 1; i < samples.size(); ++i)
+        {
+            die_unless(samples[i - 1].time <= samples[i].time);
+            die_unless(samples[i - 1].counters[0] <= samples[i].counters[0]);
+            die_unless(samples[i - 1].io.get_write_count() <= samples[i].io.get_write_count());
+        }
+        die_unequal(samples.back().counters.size(), 2u);
+        die_unequal(samples.back().counters[0], vec.size());
+        die_unequal(samples.back().counters[1], 42u);
+
+        // stopping twice, and a manual sample after stopping
+        sampler.stop();
+        sampler.sample();
+        die_unequal(sampler.samples().back().counters[0], vec.size());
+    }
+
+    // every sample is one line of the log
+    std::istringstream in(log.str());
+    std::string line, last;
+    size_t lines = 0;
+    while (std::getline(in, line))
+    {
+        die_unless(line.compare(0, 11, "STATS time=") == 0);
+        last = line;
+        ++lines;
+    }
+    LOG1 << "samples logged: " << lines;
+    die_unless(lines >= 5);
+    die_unless(last.find(" counter.items=" + std::to_string(static_cast<uint64_t>(counter))) != std::string::npos);
+    die_unless(last.find(" counter.constant=42") != std::string::npos);
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,118 @@
+/***************************************************************************
+ *  tests/common/test_task_runtime.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/common/task_runtime.h>
+
+void test_pool()
+{
+    stxxl::work_stealing_pool pool(4);
+    die_unequal(pool.concurrency(), 4u);
+
+    // tasks submitted by tasks run on the workers, too
+    std::atomic<size_t> count { 0 };
+    for (size_t i = 0; i < 100; ++i)
+    {
+        pool.submit([&]() {
+                        for (size_t j = 0; j < 10; ++j)
+                            pool.submit([&]() { ++count; });
+                    });
+    }
+    while (count != 1000)
+        std::this_thread::yield();
+}
+
+void test_parallel_for(size_t threads)
+{
+    stxxl::task_runtime& rt = stxxl::task_runtime::get_instance();
+    rt.set_executor(std::make_shared<stxxl::work_stealing_pool>(threads));
+    die_unequal(rt.max_threads(), threads);
+
+    // each index is called once, with a thread id below max_threads()
+    std::vector<size_t> calls(10000, 0);
+    std::vector<size_t> ids(calls.size());
+    stxxl::parallel_for(
+        0, calls.size(), [&](size_t i) {
+            ++calls[i];
+            ids[i] = stxxl::task_runtime::thread_id();
+        });
+    for (size_t i = 0; i < calls.size(); ++i)
+    {
+        die_unequal(calls[i], 1u);
+        die_unless(ids[i] < threads);
+    }
+
+    // nested loops take part in their own loop and cannot dead-lock
+    std::atomic<size_t> sum { 0 };
+    stxxl::parallel_for(
+        10, 20, [&](size_t i) {
+            stxxl::parallel_for(0, i, [&](size_t j) { sum += j; });
+        });
+    die_unequal(sum.load(), 1020u);
+
+    // the first exception is rethrown to the caller
+    bool thrown = false;
+    try {
+        stxxl::parallel_for(
+            0, 1000, [](size_t i) {
+                if (i == 500)
+                    throw std::runtime_error("index 500");
+            });
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+}
+
+void test_function_executor()
+{
+    stxxl::task_runtime& rt = stxxl::task_runtime::get_instance();
+
+    // an application's executor, here starting one thread per task
+    std::atomic<size_t> submitted { 0 };
+    std::vector<std::thread> threads;
+    rt.set_executor(
+        [&](stxxl::task_type task) {
+            ++submitted;
+            threads.emplace_back(std::move(task));
+        }, 3);
+    die_unequal(rt.max_threads(), 3u);
+
+    std::atomic<size_t> count { 0 };
+    stxxl::parallel_for(0, 100, [&](size_t) { ++count; });
+    die_unequal(count.load(), 100u);
+    die_unequal(submitted.load(), 2u);
+
+    for (std::thread& t : threads)
+        t.join();
+
+    rt.set_executor(nullptr);
+}
+
+int main()
+{
+    test_pool();
+    test_parallel_for(1);
+    test_parallel_for(4);
+    test_function_executor();
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,98 @@
+/***************************************************************************
+ *  tests/common/test_trace.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/common/trace.h>
+
+void test_spans()
+{
+    stxxl::trace_recorder& rec = stxxl::trace_recorder::get_instance();
+    rec.clear();
+
+    // nothing is recorded while disabled
+    rec.enable(false);
+    {
+        stxxl::trace_span span("disabled");
+    }
+    die_unequal(rec.events().size(), 0u);
+
+    rec.enable(true);
+    {
+        stxxl::trace_span outer("outer");
+        outer.add_bytes(1000);
+        {
+            stxxl::trace_span inner("inner");
+            inner.add_bytes(24);
+        }
+        outer.add_bytes(24);
+    }
+
+    // spans are recorded when they end, inner spans within outer ones
+    std::vector<stxxl::trace_recorder::event_type> events = rec.events();
+    die_unequal(events.size(), 2u);
+    die_unequal(std::string(events[0].name), "inner");
+    die_unequal(std::string(events[1].name), "outer");
+    die_unequal(events[0].bytes, 24u);
+    die_unequal(events[1].bytes, 1024u);
+    die_unless(events[1].begin <= events[0].begin);
+    die_unless(events[0].end <= events[1].end);
+
+    // each thread records into a buffer of its own
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([]() {
+                                 for (size_t i = 0; i < 100; ++i)
+                                     stxxl::trace_span span("thread");
+                             });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    events = rec.events();
+    die_unequal(events.size(), 402u);
+    die_unless(events.back().thread != events.front().thread);
+
+    rec.enable(false);
+}
+
+void test_chrome_trace()
+{
+    stxxl::trace_recorder& rec = stxxl::trace_recorder::get_instance();
+    rec.clear();
+    rec.record("merge_runs", 10, 30, 4096);
+
+    std::ostringstream os;
+    rec.write_chrome_trace(os);
+    const std::string json = os.str();
+    die_unless(json.find("\"traceEvents\"") != std::string::npos);
+    die_unless(json.find("\"name\":\"merge_runs\"") != std::string::npos);
+    die_unless(json.find("\"ts\":10,\"dur\":20") != std::string::npos);
+    die_unless(json.find("\"bytes\":4096") != std::string::npos);
+
+    rec.clear();
+}
+
+int main()
+{
+    test_spans();
+    test_chrome_trace();
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -13,6 +13,7 @@
 #include <algorithm>
 #include <iostream>
 #include <random>
+#include <utility>
 #include <vector>
 
 #include <tlx/die.hpp>
@@ -145,8 +146,92 @@ void test_vecs(size_t vecnum, bool test_rebuild)
     die_unless(output == correct);
 }
 
+// forced instantiation
+template class stxxl::keyed_winner_tree<size_t>;
+
+//! Merge random sorted vectors with a keyed_winner_tree, popping up to
+//! max_pops winners per replay. Equal keys are won by the smaller index.
+void test_keyed(size_t vecnum, size_t max_pops)
+{
+    std::cout << "testing keyed_winner_tree with " << vecnum << " players and "
+              << max_pops << " pops per replay\n";
+
+    std::mt19937_64 randgen(vecnum);
+
+    std::vector<std::vector<size_t> > vec(vecnum);
+    std::vector<std::pair<size_t, size_t> > output, correct;
+
+    for (size_t i = 0; i < vecnum; ++i)
+    {
+        std::uniform_int_distribution<size_t> distr1(0, 127);
+        std::uniform_int_distribution<size_t> distr2(0, vecnum * 20);
+
+        vec[i].resize(distr1(randgen));
+        for (size_t j = 0; j < vec[i].size(); ++j)
+            vec[i][j] = distr2(randgen);
+        std::sort(vec[i].begin(), vec[i].end());
+
+        for (size_t v : vec[i])
+            correct.emplace_back(v, i);
+    }
+    std::sort(correct.begin(), correct.end());
+
+    std::vector<size_t> pos(vecnum, 0);
+    stxxl::keyed_winner_tree<size_t> wt(vecnum);
+
+    // activate half of the players with replays, rebuild for the rest
+    for (size_t i = 0; i < vecnum / 2; ++i)
+    {
+        if (!vec[i].empty())
+            wt.activate_player(i, vec[i][0]);
+    }
+    for (size_t i = vecnum / 2; i < vecnum; ++i)
+    {
+        if (!vec[i].empty())
+            wt.activate_without_replay(i, vec[i][0]);
+    }
+    wt.rebuild();
+
+    auto advance = [&](size_t i, size_t& key) {
+                       output.emplace_back(key, i);
+                       die_unless(key == vec[i][pos[i]]);
+                       if (++pos[i] == vec[i].size())
+                           return false;
+                       key = vec[i][pos[i]];
+                       return true;
+                   };
+
+    while (!wt.empty())
+    {
+        if (max_pops == 0)
+        {
+            // single pops through top_key() and replay_on_pop(key)
+            const size_t i = wt.top();
+            size_t key = wt.top_key();
+            if (advance(i, key))
+                wt.replay_on_pop(key);
+            else
+                wt.deactivate_player(i);
+        }
+        else
+        {
+            const size_t pops = wt.replay_on_pop(advance, max_pops);
+            die_unless(pops >= 1 && pops <= max_pops);
+        }
+    }
+
+    die_unless(output == correct);
+}
+
 int main()
 {
+    // run keyed winner tree tests for 1..20 players
+    for (size_t i = 1; i <= 20; ++i) {
+        test_keyed(i, 0);
+        test_keyed(i, 1);
+        test_keyed(i, 16);
+    }
+
     // run winner tree tests for 2..20 players
     for (size_t i = 2; i <= 20; ++i) {
         test_vecs(i, false);
@@ -14,8 +14,16 @@
 
 #include "test_btree_common.h"
 
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <thread>
+#include <vector>
+
 #include <tlx/logger.hpp>
 
+#include <stxxl/stream>
+
 #define node_cache_size (25 * 1024 * 1024)
 #define leaf_cache_size (25 * 1024 * 1024)
 
@@ -205,6 +213,200 @@ int main(int argc, char* argv[])
     btree_type BTree5(BTree3.begin(), BTree3.end(), comp_type(), node_cache_size, leaf_cache_size, true);
     die_unless(BTree5 == BTree3);
 
+    LOG1 << "Bulk loading of BTree6 from a stream of BTree3 that has " << BTree3.size() << " elements";
+    btree_type BTree6(node_cache_size, leaf_cache_size);
+    BTree6[1] = 1.;
+    {
+        auto input = stxxl::stream::streamify(BTree3.begin(), BTree3.end());
+        BTree6.bulk_load(input);
+    }
+    die_unless(BTree6 == BTree3);
+    {
+        auto input = stxxl::stream::streamify(BTree1.begin(), BTree1.end());
+        BTree6.bulk_load(input);
+    }
+    die_unless(BTree6.empty());
+
+    LOG1 << "Buffered insert, erase and upsert messages on BTree6";
+    {
+        std::map<int, double> ref;
+        BTree6.set_message_buffer_size(64 * 1024);
+        std::uniform_int_distribution<> key_distr(0, 2 * nins);
+        for (unsigned int i = 0; i < nins; ++i)
+        {
+            const int key = key_distr(randgen);
+            if (i % 3 == 0)
+            {
+                BTree6.insert_oblivious(std::pair<int, double>(key, i));
+                ref[key] = i;
+            }
+            else if (i % 3 == 1)
+            {
+                BTree6.upsert(std::pair<int, double>(key, 1.),
+                              [](double a, double b) { return a + b; });
+                ref[key] += 1.;
+            }
+            else
+            {
+                BTree6.erase_oblivious(key);
+                ref.erase(key);
+            }
+            // reads apply the messages
+            if (i % 1000 == 0)
+                die_unless(BTree6.count(key) == ref.count(key));
+        }
+        die_unless(BTree6.size() == ref.size());
+        die_unless(std::equal(ref.begin(), ref.end(), BTree6.begin()));
+        BTree6.clear();
+    }
+
+    LOG1 << "Concurrent lookups and scans on BTree5 that has " << BTree5.size() << " elements";
+    {
+        const std::vector<pair> values(BTree5.begin(), BTree5.end());
+        const int max_key = values.back().first + 2;
+        const unsigned nthreads = 4;
+
+        BTree5.begin_concurrent_reads(nthreads);
+        die_unless(BTree5.concurrent_reads());
+
+        std::vector<std::thread> readers;
+        for (unsigned t = 0; t < nthreads; ++t)
+        {
+            readers.emplace_back(
+                [&, t]() {
+                    std::mt19937 thread_randgen(t);
+                    std::uniform_int_distribution<> key_distr(-1, max_key);
+                    for (unsigned int i = 0; i < nins / nthreads; ++i)
+                    {
+                        const int key = key_distr(thread_randgen);
+                        auto it = std::lower_bound(
+                            values.begin(), values.end(), key,
+                            [](const pair& a, int b) { return a.first < b; });
+                        double data;
+                        const bool found = BTree5.concurrent_find(key, data);
+                        die_unless(found == (it != values.end() && it->first == key));
+                        die_unless(!found || data == it->second);
+
+                        if (i % 100 != 0)
+                            continue;
+
+                        // scan about a hundred values from key
+                        std::vector<pair> scanned;
+                        BTree5.concurrent_scan(
+                            key, key + 200,
+                            [&scanned](const int& k, const double& d) {
+                                scanned.push_back(pair(k, d));
+                            });
+                        auto last = std::lower_bound(
+                            it, values.end(), key + 200,
+                            [](const pair& a, int b) { return a.first < b; });
+                        die_unless(scanned.size() == size_t(last - it));
+                        die_unless(std::equal(scanned.begin(), scanned.end(), it));
+                    }
+                });
+        }
+        for (std::thread& reader : readers)
+            reader.join();
+
+        BTree5.end_concurrent_reads();
+        die_unless(!BTree5.concurrent_reads());
+        die_unless(BTree5 == BTree3);
+    }
+
+    LOG1 << "Range scans of BTree5 with read-ahead";
+    {
+        const std::vector<pair> values(BTree5.begin(), BTree5.end());
+        std::uniform_int_distribution<> key_distr(0, values.back().first);
+        for (size_t read_ahead : { 1, 4, 64 })
+        {
+            BTree5.set_read_ahead(read_ahead);
+            for (unsigned int i = 0; i < 10; ++i)
+            {
+                const int lower = key_distr(randgen);
+                const int upper = lower + key_distr(randgen) / 4;
+                auto it = std::lower_bound(
+                    values.begin(), values.end(), lower,
+                    [](const pair& a, int b) { return a.first < b; });
+                std::pair<btree_type::iterator, btree_type::iterator> range =
+                    BTree5.range(lower, upper);
+                for ( ; range.first != range.second; ++range.first, ++it)
+                {
+                    die_unless(it != values.end() && it->first < upper);
+                    die_unless(*range.first == *it);
+                }
+                die_unless(it == values.end() || it->first >= upper);
+            }
+        }
+    }
+
+    LOG1 << "Batched lookups in BTree5";
+    {
+        std::vector<int> keys(std::min<size_t>(nins / 10, 10000));
+        std::uniform_int_distribution<> key_distr(-1, nins);
+        for (int& key : keys)
+            key = key_distr(randgen);
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<btree_type::iterator> results;
+        BTree5.find_batch(keys.begin(), keys.end(), std::back_inserter(results));
+        die_unless(results.size() == keys.size());
+        for (size_t i = 0; i < keys.size(); ++i)
+            die_unless(results[i] == BTree5.find(keys[i]));
+    }
+
+    LOG1 << "Copy of BTree5 with a 2Q pager and pinned upper levels";
+    {
+        using btree_2q_type = stxxl::btree::btree<
+                  key_type, payload_type, comp_type, 4096, 4096, foxxll::simple_random,
+                  stxxl::btree::no_compression, stxxl::two_queue_pager<> >;
+        btree_2q_type BTree7(BTree5.begin(), BTree5.end(), comp_type(),
+                             node_cache_size, leaf_cache_size, true);
+        BTree7.set_pinned_levels(1);
+        die_unless(BTree7.pinned_levels() == 1);
+
+        std::map<int, double> ref(BTree5.begin(), BTree5.end());
+        std::uniform_int_distribution<> key_distr(0, 2 * nins);
+        for (unsigned int i = 0; i < nins / 10; ++i)
+        {
+            const int key = key_distr(randgen);
+            if (i % 2)
+                die_unless(BTree7.count(key) == ref.count(key));
+            else
+                die_unless(BTree7.insert(pair(key, 1.)).second == ref.insert(pair(key, 1.)).second);
+        }
+        die_unless(BTree7.size() == ref.size());
+        die_unless(std::equal(ref.begin(), ref.end(), BTree7.begin()));
+    }
+
+    LOG1 << "Merging a sorted range into a copy of BTree5";
+    {
+        btree_type BTree8(BTree5.begin(), BTree5.end(), comp_type(),
+                          node_cache_size, leaf_cache_size, true);
+        std::map<int, double> ref(BTree5.begin(), BTree5.end());
+
+        // a tenth of new keys, some of which exist and must stay unchanged
+        std::vector<std::pair<int, double> > delta(nins / 10);
+        std::uniform_int_distribution<> key_distr(0, 2 * nins);
+        for (auto& value : delta)
+            value = std::make_pair(key_distr(randgen), -1.);
+        std::sort(delta.begin(), delta.end());
+
+        BTree8.insert(delta.begin(), delta.end(), true);
+        ref.insert(delta.begin(), delta.end());
+        die_unless(BTree8.size() == ref.size());
+        die_unless(std::equal(ref.begin(), ref.end(), BTree8.begin()));
+
+        for (unsigned int i = 0; i < nins / 10; ++i)
+        {
+            const int key = key_distr(randgen);
+            if (i % 2)
+                die_unless(BTree8.erase(key) == ref.erase(key));
+            else
+                die_unless(BTree8.insert(pair(key, 1.)).second == ref.insert(pair(key, 1.)).second);
+        }
+        die_unless(std::equal(ref.begin(), ref.end(), BTree8.begin()));
+    }
+
     btree_type::iterator b3 = BTree3.begin();
     btree_type::iterator b4 = BTree4.begin();
     btree_type::iterator e3 = BTree3.end();
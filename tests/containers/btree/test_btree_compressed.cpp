@@ -0,0 +1,139 @@
+/***************************************************************************
+ *  tests/containers/btree/test_btree_compressed.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/utils.hpp>
+
+#include <stxxl/bits/containers/btree/btree.h>
+#include <stxxl/comparator>
+
+using key_type = uint64_t;
+using data_type = uint64_t;
+using comp_type = stxxl::comparator<key_type>;
+using btree_type = stxxl::btree::btree<
+          key_type, data_type, comp_type, 4096, 4096, foxxll::simple_random,
+          stxxl::btree::delta_compression>;
+using reference_type = std::map<key_type, data_type>;
+
+template <class BTree>
+void check_equal(const BTree& btree, const reference_type& ref)
+{
+    die_unequal(btree.size(), ref.size());
+
+    auto it = ref.begin();
+    for (auto bit = btree.begin(); bit != btree.end(); ++bit, ++it)
+    {
+        die_unless(it != ref.end());
+        die_unequal(bit->first, it->first);
+        die_unequal(bit->second, it->second);
+    }
+    die_unless(it == ref.end());
+}
+
+void test_bulk(size_t n, key_type step)
+{
+    LOG1 << "Bulk construction of " << n << " keys with step " << step;
+
+    std::vector<std::pair<key_type, data_type> > values(n);
+    reference_type ref;
+    for (size_t i = 0; i < n; ++i)
+    {
+        values[i] = std::make_pair(key_type(i) * step, data_type(i));
+        ref.insert(values[i]);
+    }
+
+    btree_type btree(values.begin(), values.end(), comp_type(),
+                     1024 * 128, 1024 * 128, true);
+    check_equal(btree, ref);
+
+    // erase every other key, fusing and balancing the encoded leaves
+    for (size_t i = 0; i < n; i += 2)
+    {
+        die_unequal(btree.erase(values[i].first), 1u);
+        ref.erase(values[i].first);
+    }
+    check_equal(btree, ref);
+
+    for (size_t i = 1; i < n; i += 2)
+    {
+        auto it = btree.find(values[i].first);
+        die_unless(it != btree.end());
+        die_unequal(it->second, values[i].second);
+        die_unless(btree.find(values[i - 1].first) == btree.end());
+    }
+}
+
+void test_random(size_t n, key_type range)
+{
+    LOG1 << "Random insertion of " << n << " keys in [0, " << range << ")";
+
+    btree_type btree(1024 * 128, 1024 * 128);
+    reference_type ref;
+
+    std::mt19937_64 randgen;
+    std::uniform_int_distribution<key_type> dist(0, range - 1);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const key_type key = dist(randgen);
+        const bool inserted = btree.insert(std::make_pair(key, data_type(i))).second;
+        die_unequal(inserted, ref.insert(std::make_pair(key, data_type(i))).second);
+    }
+    check_equal(btree, ref);
+
+    // modify data in place, which is stored unencoded
+    for (auto it = btree.begin(); it != btree.end(); ++it)
+        it->second = it->first + 1;
+    for (auto& value : ref)
+        value.second = value.first + 1;
+    check_equal(btree, ref);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const key_type key = dist(randgen);
+        die_unequal(btree.erase(key), ref.erase(key));
+    }
+    check_equal(btree, ref);
+
+    while (!ref.empty())
+    {
+        die_unequal(btree.erase(ref.begin()->first), 1u);
+        ref.erase(ref.begin());
+    }
+    die_unless(btree.empty());
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = 100000;
+    if (argc > 1)
+        n = static_cast<size_t>(foxxll::atoi64(argv[1]));
+
+    // dense keys and small deltas
+    test_bulk(n, 1);
+    // sparse keys, deltas of several bytes
+    test_bulk(n, key_type(1) << 40);
+
+    test_random(n, key_type(4) * n);
+    test_random(n, std::numeric_limits<key_type>::max());
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
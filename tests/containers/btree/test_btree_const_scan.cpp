@@ -49,6 +49,19 @@ uint64_t scan(btree_type& BTree, const std::string& test_key)
     return sum;
 }
 
+uint64_t scan_snapshot(const btree_type& BTree, const key_type& lower, const key_type& upper)
+{
+    foxxll::scoped_print_timer timer("Scan with snapshot iterator", (upper - lower) * sizeof(*BTree.begin()));
+
+    uint64_t sum = 0;
+    std::pair<btree_type::snapshot_iterator, btree_type::snapshot_iterator> range =
+        BTree.snapshot_range(lower, upper);
+    for (btree_type::snapshot_iterator it = range.first; it != range.second; ++it)
+        sum += it->second.key;
+
+    return sum;
+}
+
 int main(int argc, char* argv[])
 {
     die_verbose_if(argc < 2, "Usage: " << argv[0] << " #ins");
@@ -76,6 +89,10 @@ int main(int argc, char* argv[])
 
         die_unless(checksum == scan<btree_type::const_iterator>(BTree1, "const iterator"));
         die_unless(checksum == scan<btree_type::iterator>(BTree2, "non-const iterator"));
+        die_unless(checksum == scan_snapshot(BTree1, 0, nins));
+        // sum of [nins / 4, nins / 2)
+        die_unequal(scan_snapshot(BTree2, nins / 4, nins / 2),
+                    (uint64_t(nins / 2) * (nins / 2 - 1) - uint64_t(nins / 4) * (nins / 4 - 1)) / 2);
     }
 
     LOG1 << "Scan without prefetching";
@@ -88,6 +105,10 @@ int main(int argc, char* argv[])
 
         die_unless(checksum == scan<btree_type::const_iterator>(BTree1, "const iterator"));
         die_unless(checksum == scan<btree_type::iterator>(BTree2, "non-const iterator"));
+        die_unless(checksum == scan_snapshot(BTree1, 0, nins));
+        // sum of [nins / 4, nins / 2)
+        die_unequal(scan_snapshot(BTree2, nins / 4, nins / 2),
+                    (uint64_t(nins / 2) * (nins / 2 - 1) - uint64_t(nins / 4) * (nins / 4 - 1)) / 2);
     }
 
     LOG1 << "All tests passed successfully";
@@ -0,0 +1,132 @@
+/***************************************************************************
+ *  tests/containers/btree/test_btree_erase_range.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include "test_btree_common.h"
+
+#include <limits>
+#include <map>
+
+#include <tlx/logger.hpp>
+
+using reference_type = std::map<key_type, payload_type>;
+using compressed_btree_type = stxxl::btree::btree<
+          key_type, payload_type, comp_type, 4096, 4096, foxxll::simple_random,
+          stxxl::btree::delta_compression>;
+
+template <class BTreeType>
+void check_equal(const BTreeType& BTree, const reference_type& ref)
+{
+    die_unequal(BTree.size(), ref.size());
+
+    typename BTreeType::const_iterator it = BTree.begin();
+    for (reference_type::const_iterator r = ref.begin(); r != ref.end(); ++r, ++it)
+    {
+        die_unless(it != BTree.end());
+        die_unequal(it->first, r->first);
+        die_unequal(it->second, r->second);
+    }
+    die_unless(it == BTree.end());
+
+    // backwards through the pred links of the leaves
+    reference_type::const_reverse_iterator r = ref.rbegin();
+    for (it = BTree.end(); it != BTree.begin(); ++r)
+    {
+        --it;
+        die_unequal(it->first, r->first);
+    }
+    die_unless(r == ref.rend());
+}
+
+// checks the subtree sizes of the nodes by rank() of every 16th key
+void check_ranks(const btree_type& BTree, const reference_type& ref)
+{
+    size_t i = 0;
+    for (reference_type::const_iterator r = ref.begin(); r != ref.end(); ++r, ++i)
+    {
+        if (i % 16 == 0)
+            die_unequal(BTree.rank(r->first), i);
+    }
+    die_unequal(BTree.rank(std::numeric_limits<key_type>::max()), ref.size());
+}
+
+void check_ranks(const compressed_btree_type&, const reference_type&)
+{ }
+
+template <class BTreeType>
+void test_erase_range(size_t nins, std::mt19937_64& randgen)
+{
+    BTreeType BTree(1024 * 128, 1024 * 128);
+    reference_type ref;
+    for (size_t i = 0; i < nins; ++i)
+    {
+        const key_type k = static_cast<key_type>(randgen() % (4 * nins)) * 2;
+        BTree.insert(pair(k, k + 1));
+        ref.insert(pair(k, k + 1));
+    }
+    check_equal(BTree, ref);
+
+    const key_type max_key = static_cast<key_type>(8 * nins);
+    for (size_t round = 0; round < 100 && !ref.empty(); ++round)
+    {
+        // short ranges within a leaf and long ones spanning many subtrees
+        const key_type lower = static_cast<key_type>(randgen() % max_key);
+        const key_type length = static_cast<key_type>(
+            randgen() % ((randgen() % 8 == 0) ? max_key / 2 : 64) + 1);
+        const key_type upper = std::min<key_type>(lower + length, max_key);
+
+        typename BTreeType::iterator first = BTree.lower_bound(lower);
+        typename BTreeType::iterator last = BTree.lower_bound(upper);
+        const bool last_is_end = (last == BTree.end());
+
+        LOG1 << "Erasing [" << lower << ", " << upper << ") of " << ref.size() << " elements";
+        BTree.erase(first, last);
+        ref.erase(ref.lower_bound(lower), ref.lower_bound(upper));
+
+        // last still points to the first element behind the range
+        if (last_is_end)
+            die_unless(last == BTree.end());
+        else
+            die_unequal(last->first, ref.lower_bound(upper)->first);
+
+        check_equal(BTree, ref);
+        check_ranks(BTree, ref);
+
+        // refill some keys into the gap
+        for (key_type k = lower; k < upper && k < lower + 16; k += 2)
+        {
+            BTree.insert(pair(k, k + 1));
+            ref.insert(pair(k, k + 1));
+        }
+        check_equal(BTree, ref);
+    }
+
+    BTree.erase(BTree.begin(), BTree.end());
+    die_unless(BTree.empty());
+}
+
+int main(int argc, char* argv[])
+{
+    die_verbose_if(argc < 2, "Usage: " << argv[0] << " #ins");
+    const auto nins = static_cast<size_t>(foxxll::atoi64(argv[1]));
+
+    std::mt19937_64 randgen;
+
+    LOG1 << "Erasing ranges from a tree with subtree sizes";
+    test_erase_range<btree_type>(nins, randgen);
+
+    LOG1 << "Erasing ranges from a compressed tree";
+    test_erase_range<compressed_btree_type>(nins, randgen);
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,115 @@
+/***************************************************************************
+ *  tests/containers/btree/test_btree_file.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+
+#include <stxxl/comparator>
+#include <stxxl/map>
+
+using key_type = int;
+using data_type = uint64_t;
+using comp_type = stxxl::comparator<key_type>;
+using map_type = stxxl::map<key_type, data_type, comp_type, 4096, 4096>;
+using reference_type = std::map<key_type, data_type>;
+
+static const size_t node_cache_size = 16 * map_type::node_block_type::raw_size;
+static const size_t leaf_cache_size = 16 * map_type::leaf_block_type::raw_size;
+
+foxxll::file_ptr open_file(const char* fn, const char* ft, int extra_flags = 0)
+{
+    return foxxll::create_file(
+        ft, fn, foxxll::file::CREAT | foxxll::file::DIRECT | foxxll::file::RDWR | extra_flags);
+}
+
+void check_equal(const map_type& map, const reference_type& ref)
+{
+    die_unequal(map.size(), ref.size());
+    die_unless(std::equal(ref.begin(), ref.end(), map.begin()));
+}
+
+void modify(map_type& map, reference_type& ref, size_t n, std::mt19937_64& randgen)
+{
+    std::uniform_int_distribution<key_type> key_distr(0, static_cast<key_type>(4 * n));
+    for (size_t i = 0; i < n; ++i)
+    {
+        const key_type key = key_distr(randgen);
+        if (i % 3 == 2) {
+            die_unequal(map.erase(key), ref.erase(key));
+        }
+        else {
+            const auto value = std::make_pair(key, data_type(i));
+            die_unequal(map.insert(value).second, ref.insert(value).second);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " file [filetype] [n]" << std::endl;
+        return -1;
+    }
+
+    const char* fn = argv[1];
+    const char* ft = (argc >= 3) ? argv[2] : "syscall";
+    const size_t n = (argc >= 4) ? static_cast<size_t>(foxxll::atoi64(argv[3])) : 100000;
+
+    std::mt19937_64 randgen;
+    reference_type ref;
+
+    {
+        LOG1 << "Creating a map of " << n << " operations in " << fn;
+        map_type map(open_file(fn, ft, foxxll::file::TRUNC), comp_type(),
+                     node_cache_size, leaf_cache_size);
+        die_unless(map.empty());
+        modify(map, ref, n, randgen);
+        check_equal(map, ref);
+    }
+
+    for (int round = 0; round < 2; ++round)
+    {
+        LOG1 << "Reopening the map, round " << round;
+        map_type map(open_file(fn, ft), comp_type(), node_cache_size, leaf_cache_size);
+        check_equal(map, ref);
+        die_unless(ref.empty() || (--map.end())->first == ref.rbegin()->first);
+
+        // reuses the blocks freed by erasing
+        modify(map, ref, n / 2, randgen);
+        map.flush();
+        check_equal(map, ref);
+    }
+
+    {
+        LOG1 << "Reopening the map and clearing it";
+        map_type map(open_file(fn, ft), comp_type(), node_cache_size, leaf_cache_size);
+        check_equal(map, ref);
+        map.clear();
+        ref.clear();
+    }
+
+    {
+        map_type map(open_file(fn, ft), comp_type(), node_cache_size, leaf_cache_size);
+        die_unless(map.empty());
+    }
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
@@ -13,8 +13,16 @@
 
 #include "test_btree_common.h"
 
+#include <cstdint>
+#include <limits>
+#include <set>
+
 #include <tlx/logger.hpp>
 
+// searched by stxxl::btree::key_search without the comparator
+static_assert(stxxl::btree::is_plain_less_compare<key_type, comp_type>::value,
+              "comparator<int> should select the plain search");
+
 int main(int argc, char* argv[])
 {
     size_t nins;
@@ -53,6 +61,31 @@ int main(int argc, char* argv[])
         }
     }
 
+    {
+        LOG1 << "Checking lower_bound() and upper_bound() around " << nins << " elements";
+        const std::set<key_type> keys(Values.cbegin(), Values.cend());
+        for (auto it = Values.cbegin(); it != Values.cend(); ++it) {
+            for (int64_t d = -1; d <= 1; ++d) {
+                // keys next to the element, within the range of key_type
+                const int64_t k64 = int64_t(*it) + d;
+                if (k64 < std::numeric_limits<key_type>::min() ||
+                    k64 >= std::numeric_limits<key_type>::max())
+                    continue;
+                const key_type k = static_cast<key_type>(k64);
+
+                auto lb = keys.lower_bound(k);
+                btree_type::iterator bLb = BTree.lower_bound(k);
+                die_unless((bLb == BTree.end()) == (lb == keys.end()));
+                die_unless(lb == keys.end() || bLb->first == *lb);
+
+                auto ub = keys.upper_bound(k);
+                btree_type::iterator bUb = BTree.upper_bound(k);
+                die_unless((bUb == BTree.end()) == (ub == keys.end()));
+                die_unless(ub == keys.end() || bUb->first == *ub);
+            }
+        }
+    }
+
     LOG1 << "Test passed.";
     return 0;
 }
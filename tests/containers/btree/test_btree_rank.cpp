@@ -0,0 +1,97 @@
+/***************************************************************************
+ *  tests/containers/btree/test_btree_rank.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include "test_btree_common.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <tlx/logger.hpp>
+
+// checks rank(), select() and count_range() against the sorted keys
+void check_order_statistics(const btree_type& BTree, const std::vector<key_type>& keys,
+                            std::mt19937_64& randgen)
+{
+    die_unequal(BTree.size(), keys.size());
+
+    for (size_t n = 0; n < 1000; ++n)
+    {
+        const size_t i = randgen() % keys.size();
+        die_unequal(BTree.rank(keys[i]), i);
+        // a key between the ones present
+        die_unequal(BTree.rank(keys[i] + 1),
+                    size_t(std::lower_bound(keys.begin(), keys.end(), keys[i] + 1) - keys.begin()));
+
+        btree_type::const_iterator it = BTree.select(i);
+        die_unless(it != BTree.end());
+        die_unequal(it->first, keys[i]);
+
+        const size_t j = randgen() % keys.size();
+        die_unequal(BTree.count_range(keys[std::min(i, j)], keys[std::max(i, j)]),
+                    std::max(i, j) - std::min(i, j));
+    }
+
+    die_unequal(BTree.rank(keys.front()), 0u);
+    die_unequal(BTree.rank(std::numeric_limits<key_type>::max()), keys.size());
+    die_unequal(BTree.select(keys.size() - 1)->first, keys.back());
+    die_unless(BTree.select(keys.size()) == BTree.end());
+}
+
+int main(int argc, char* argv[])
+{
+    die_verbose_if(argc < 2, "Usage: " << argv[0] << " #ins");
+    const auto nins = static_cast<size_t>(foxxll::atoi64(argv[1]));
+
+    std::mt19937_64 randgen;
+    std::vector<key_type> keys(nins);
+    for (size_t i = 0; i < nins; ++i)
+        keys[i] = static_cast<key_type>(randgen() % (16 * nins)) * 2;
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    {
+        LOG1 << "Inserting " << keys.size() << " random keys";
+        btree_type BTree(1024 * 128, 1024 * 128);
+        std::vector<key_type> shuffled = keys;
+        std::shuffle(shuffled.begin(), shuffled.end(), randgen);
+        for (const key_type& k : shuffled)
+            BTree.insert(pair(k, k + 1));
+        check_order_statistics(BTree, keys, randgen);
+
+        LOG1 << "Erasing half of the keys";
+        std::vector<key_type> kept;
+        for (size_t i = 0; i < shuffled.size(); ++i)
+        {
+            if (i % 2 == 0)
+                die_unequal(BTree.erase(shuffled[i]), 1u);
+            else
+                kept.push_back(shuffled[i]);
+        }
+        std::sort(kept.begin(), kept.end());
+        check_order_statistics(BTree, kept, randgen);
+    }
+
+    {
+        LOG1 << "Bulk construction of " << keys.size() << " keys";
+        std::vector<pair> values;
+        for (const key_type& k : keys)
+            values.emplace_back(k, k + 1);
+        btree_type BTree(values.begin(), values.end(), comp_type(),
+                         1024 * 128, 1024 * 128, true);
+        check_order_statistics(BTree, keys, randgen);
+    }
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -11,8 +11,14 @@
  *  http://www.boost.org/LICENSE_1_0.txt)
  **************************************************************************/
 
+#include <atomic>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <random>
+#include <thread>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
@@ -289,6 +295,261 @@ void basic_test()
     std::cout << "passed" << std::endl;
     LOG1 << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
 
+    // --- bulk-load from a stream
+    std::cout << "Bulk-load from stream...";
+    stats_begin = *foxxll::stats::get_instance();
+    {
+        auto input = stxxl::stream::streamify(values1.begin(), values1.end());
+        unordered_map loaded_map(input, n_values, mem_to_sort);
+        die_unless(loaded_map.size() == n_values);
+        const unordered_map& cloaded_map = loaded_map;
+        for (size_t i = 0; i < n_values; i++)
+        {
+            const_iterator cit = cloaded_map.find(values1[i].first);
+            die_unless(cit != cloaded_map.end());
+            die_unless((*cit).second == values1[i].second);
+        }
+    }
+    std::cout << "passed" << std::endl;
+    LOG1 << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+
+    std::cout << "Batched lookup...";
+    stats_begin = *foxxll::stats::get_instance();
+    {
+        // present and missing keys, shuffled by the alternation
+        std::vector<unordered_map::key_type> keys;
+        for (size_t i = 0; i < n_tests; i++)
+        {
+            keys.push_back(values1[i].first);
+            keys.push_back(values2[i].first);
+        }
+        std::vector<const_iterator> results;
+        cmap.find_batch(keys.begin(), keys.end(), std::back_inserter(results));
+        die_unequal(results.size(), keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            const_iterator cit = cmap.find(keys[i]);
+            die_unless(results[i] == cit);
+            if (cit != cmap.end())
+                die_unless((*results[i]).second == (*cit).second);
+        }
+    }
+    std::cout << "passed" << std::endl;
+    LOG1 << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+
+    // --- negative lookups answered by the filter
+    std::cout << "Filtered lookups...";
+    stats_begin = *foxxll::stats::get_instance();
+    {
+        map.filter_bits_per_key(10);
+        map.rehash();
+        for (size_t i = 0; i < n_values; i++)
+            die_unless(cmap.find(values1[i].first) != cmap.end());
+
+        const foxxll::stats_data stats_filtered = *foxxll::stats::get_instance();
+        for (size_t i = 0; i < n_tests; i++)
+            die_unless(cmap.find(values3[i].first) == cmap.end());
+        const foxxll::stats_data stats_misses =
+            foxxll::stats_data(*foxxll::stats::get_instance()) - stats_filtered;
+        LOG1 << "reads of " << n_tests << " misses: " << stats_misses.get_read_count();
+        die_unless(stats_misses.get_read_count() < n_tests / 10);
+    }
+    std::cout << "passed" << std::endl;
+    LOG1 << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+
+    // --- rehash to many buckets and back, in parallel if threads are available
+    std::cout << "Rehash to many buckets...";
+    stats_begin = *foxxll::stats::get_instance();
+    {
+        const size_t n_buckets = map.bucket_count(), n_size = map.size();
+        map.rehash(16 * n_buckets + 4096);
+        die_unless(map.bucket_count() > n_buckets);
+        die_unequal(map.size(), n_size);
+        for (size_t i = 0; i < n_values; i++)
+            die_unless(cmap.find(values1[i].first) != cmap.end());
+        for (size_t i = 0; i < n_tests; i++)
+            die_unless(cmap.find(values3[i].first) == cmap.end());
+
+        map.rehash();
+        die_unequal(map.size(), n_size);
+        for (size_t i = 0; i < n_values; i++)
+            die_unless(cmap.find(values1[i].first) != cmap.end());
+    }
+    std::cout << "passed" << std::endl;
+    LOG1 << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+
+    // --- concurrent lookups, external (values1) and internal (values2)
+    std::cout << "Concurrent lookups...";
+    stats_begin = *foxxll::stats::get_instance();
+    {
+        for (size_t i = 0; i < n_tests; i++)
+            map.insert_oblivious(values2[i]);
+
+        map.begin_concurrent_reads(4);
+        die_unless(map.concurrent_reads());
+
+        const size_t n_threads = 8;
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < n_threads; t++)
+        {
+            threads.emplace_back(
+                [&, t]() {
+                    unordered_map::mapped_type value;
+                    for (size_t i = t; i < n_values; i += n_threads)
+                    {
+                        die_unless(cmap.concurrent_find(values1[i].first, value));
+                        die_unless(value == values1[i].second);
+                    }
+                    for (size_t i = t; i < n_tests; i += n_threads)
+                    {
+                        die_unless(cmap.concurrent_find(values2[i].first, value));
+                        die_unless(value == values2[i].second);
+                        die_unless(!cmap.concurrent_find(values3[i].first, value));
+                    }
+                });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        map.end_concurrent_reads();
+        die_unless(!map.concurrent_reads());
+    }
+    std::cout << "passed" << std::endl;
+    LOG1 << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+
+    // --- incremental rehash: small buffer, flushed bucket by bucket
+    std::cout << "Incremental rehash...";
+    stats_begin = *foxxll::stats::get_instance();
+    {
+        map.rehash();
+        map.incremental_rehash(true);
+        map.max_buffer_size((n_tests / 4) * (value_size + sizeof(int*)));
+        die_unless(map.incremental_rehash());
+
+        const size_t n_buckets = map.bucket_count();
+        for (size_t i = 0; i < n_values / 2; i++)
+            map.insert(values3[i]);
+        LOG1 << "buckets: " << n_buckets << " -> " << map.bucket_count();
+        die_unless(map.bucket_count() > n_buckets);
+        die_unless(map.buffer_size() <= map.max_buffer_size());
+
+        for (size_t i = 0; i < n_values; i++)
+            die_unless(cmap.find(values1[i].first) != cmap.end());
+        for (size_t i = 0; i < n_values / 2; i++)
+        {
+            const_iterator cit = cmap.find(values3[i].first);
+            die_unless(cit != cmap.end());
+            die_unless((*cit).second == values3[i].second);
+        }
+
+        map.incremental_rehash(false);
+        map.max_buffer_size(buffer_size);
+    }
+    std::cout << "passed" << std::endl;
+    LOG1 << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+
+    // --- per-map tuning while iterating, adaptive prefetching of the scan
+    std::cout << "Tuning...";
+    stats_begin = *foxxll::stats::get_instance();
+    {
+        stxxl::hash_map::tuning_parameters params = map.get_tuning();
+        params.blockcache_size *= 2;
+        params.prefetch_pages = 1;
+        params.learned_prefetch_pages = 0;
+
+        const_iterator it = cmap.begin();
+        ++it;
+        map.set_tuning(params);
+        die_unless(map.get_tuning().blockcache_size == params.blockcache_size);
+
+        size_t n_scanned = 1;
+        for ( ; it != cmap.end(); ++it)
+            ++n_scanned;
+        die_unless(n_scanned == map.size());
+
+        const stxxl::hash_map::tuning_parameters& learned = map.get_tuning();
+        LOG1 << "prefetch pages learned: " << learned.learned_prefetch_pages;
+        die_unless(learned.learned_prefetch_pages <= learned.max_prefetch_pages);
+    }
+    std::cout << "passed" << std::endl;
+    LOG1 << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+
+    // --- parallel scan, with buffered, overwritten and erased values
+    std::cout << "Parallel scan...";
+    stats_begin = *foxxll::stats::get_instance();
+    {
+        for (size_t i = 0; i < n_tests / 2; i++)
+            map.insert_oblivious(value_type(values1[i].first, values1[i].second + 1));
+        for (size_t i = n_tests / 2; i < n_tests; i++)
+            map.erase_oblivious(values1[i].first);
+
+        size_t n_expected = 0;
+        int64_t sum_expected = 0;
+        for (const_iterator it = cmap.begin(); it != cmap.end(); ++it, ++n_expected)
+            sum_expected += int64_t((*it).first) * 3 + (*it).second;
+
+        for (size_t n_parts : { 0, 1, 7 })
+        {
+            std::atomic<size_t> n_scanned { 0 };
+            std::atomic<int64_t> sum { 0 };
+            cmap.for_each_parallel(
+                [&](const unordered_map::value_type& value) {
+                    ++n_scanned;
+                    sum += int64_t(value.first) * 3 + value.second;
+                }, n_parts);
+            die_unequal(size_t(n_scanned), n_expected);
+            die_unequal(int64_t(sum), sum_expected);
+        }
+    }
+    std::cout << "passed" << std::endl;
+    LOG1 << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+
+    // --- upsert: word-count style aggregation, merged with external values
+    std::cout << "Upsert...";
+    stats_begin = *foxxll::stats::get_instance();
+    {
+        unordered_map counts;
+        const unordered_map& ccounts = counts;
+        counts.max_buffer_size((n_tests / 8) * (value_size + sizeof(int*)));
+        std::map<int, int> expected;
+
+        auto word = [&](size_t i) { return values1[i].first % 1000; };
+
+        for (size_t i = 0; i < n_values / 2; i++) {
+            counts.upsert(value_type(word(i), 1), std::plus<int>());
+            ++expected[word(i)];
+        }
+        counts.rehash();
+
+        // an iterator referencing an external value is fixed by upsert
+        const_iterator cit = ccounts.find(word(0));
+        die_unless(cit != ccounts.end());
+        counts.upsert(value_type(word(0), 5), std::plus<int>());
+        expected[word(0)] += 5;
+        die_unless((*cit).second == expected[word(0)]);
+
+        for (size_t i = n_values / 2; i < n_values; i++) {
+            counts.upsert(value_type(word(i), 1), std::plus<int>());
+            ++expected[word(i)];
+        }
+
+        for (const auto& e : expected)
+        {
+            const_iterator it = ccounts.find(e.first);
+            die_unless(it != ccounts.end());
+            die_unless((*it).second == e.second);
+        }
+        die_unless(counts.size() == expected.size());
+
+        counts.rehash();
+        size_t n_scanned = 0;
+        for (const_iterator it = ccounts.begin(); it != ccounts.end(); ++it, ++n_scanned)
+            die_unless((*it).second == expected[(*it).first]);
+        die_unless(n_scanned == expected.size());
+    }
+    std::cout << "passed" << std::endl;
+    LOG1 << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+
     // --- test equality predicate
     unordered_map::key_equal key_eq = map.key_eq();
     die_unless(key_eq(42, 42));
@@ -112,6 +112,18 @@ void cmp_with_internal_map()
     }
     std::cout << "passed" << std::endl;
 
+    // --- the same scan with unregistered snapshot iterators
+    std::cout << "Compare snapshot scan with internal-memory map...";
+    size_t n_scanned = 0;
+    for (hash_map::snapshot_iterator sit = cmap.snapshot_begin();
+         sit != cmap.snapshot_end(); ++sit, ++n_scanned) {
+        int_hash_map::const_iterator found = int_map.find(sit->first);
+        die_unless(found != int_map.end());
+        die_unless(found->second == sit->second);
+    }
+    die_unless(n_scanned == int_map.size());
+    std::cout << "passed" << std::endl;
+
     // --- another bulk insert
     std::cout << "Compare with internal-memory map after another bulk-insert...";
     map.insert(values3.begin(), values3.end(), mem_to_sort);
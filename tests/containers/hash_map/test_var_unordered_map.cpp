@@ -0,0 +1,139 @@
+/***************************************************************************
+ *  tests/containers/hash_map/test_var_unordered_map.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <map>
+#include <random>
+#include <string>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/comparator>
+#include <stxxl/var_unordered_map>
+
+struct hash_int
+{
+    size_t operator () (int key) const
+    {
+        // a simple integer hash function
+        return static_cast<size_t>(key * 2654435761u);
+    }
+};
+
+using cmp = stxxl::comparator<int>;
+
+using map_type = stxxl::var_unordered_map<int, hash_int, cmp, 16, 4* 1024, 4, 4096>;
+
+// forced instantiation
+template class stxxl::var_unordered_map<int, hash_int, cmp>;
+
+void check(const map_type& map, const std::map<int, std::string>& ref)
+{
+    die_unequal(map.size(), ref.size());
+    std::string value;
+    for (const auto& kv : ref)
+    {
+        die_unless(map.get(kv.first, value));
+        die_unequal(value, kv.second);
+    }
+}
+
+int main()
+{
+    const size_t n = 20000;
+
+    std::mt19937 randgen;
+    std::uniform_int_distribution<size_t> distr_length(0, 64);
+    std::uniform_int_distribution<int> distr_char('a', 'z');
+    std::uniform_int_distribution<int> distr_key(0, 4 * n);
+
+    auto random_value = [&](size_t i) {
+                            // some values longer than a block of the log
+                            std::string str(i % 1000 == 0 ? 5000 : distr_length(randgen), ' ');
+                            for (char& c : str)
+                                c = static_cast<char>(distr_char(randgen));
+                            return str;
+                        };
+
+    // a small buffer, so that the buckets are rewritten several times
+    map_type map(0, hash_int(), cmp(), 64 * 1024);
+    map.max_garbage_ratio(1.0);
+    std::map<int, std::string> ref;
+
+    LOG1 << "inserts";
+    for (size_t i = 0; i < n; ++i)
+    {
+        const int key = distr_key(randgen);
+        const std::string value = random_value(i);
+        map.insert_or_assign(key, value);
+        ref[key] = value;
+    }
+    check(map, ref);
+
+    // short values are stored in the entries
+    uint64_t long_bytes = 0;
+    for (const auto& kv : ref)
+        long_bytes += kv.second.size() > 16 ? kv.second.size() : 0;
+    die_unequal(map.log_bytes() - map.garbage_bytes(), long_bytes);
+
+    LOG1 << "overwrites and erases without compaction";
+    for (size_t i = 0; i < n; ++i)
+    {
+        const int key = distr_key(randgen);
+        if (i % 3 == 0)
+        {
+            die_unequal(map.erase(key), ref.erase(key));
+        }
+        else
+        {
+            const std::string value = random_value(i);
+            map.insert_or_assign(key, value);
+            ref[key] = value;
+        }
+    }
+    check(map, ref);
+    die_unless(map.garbage_bytes() > 0);
+    die_unless(!map.contains(-1));
+    die_unequal(map.erase(-1), 0u);
+
+    LOG1 << "compaction";
+    map.compact();
+    die_unequal(map.garbage_bytes(), 0u);
+    long_bytes = 0;
+    for (const auto& kv : ref)
+        long_bytes += kv.second.size() > 16 ? kv.second.size() : 0;
+    die_unequal(map.log_bytes(), long_bytes);
+    check(map, ref);
+
+    LOG1 << "automatic compaction";
+    map.max_garbage_ratio(0.5);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const int key = distr_key(randgen);
+        const std::string value = random_value(i);
+        map.insert_or_assign(key, value);
+        ref[key] = value;
+        die_unless(map.garbage_bytes() <= 4096 ||
+                   map.garbage_bytes() <= map.log_bytes() / 2);
+    }
+    check(map, ref);
+
+    map.clear();
+    die_unless(map.empty());
+    die_unequal(map.log_bytes(), 0u);
+    map.insert_or_assign(1, std::string(100, 'x'));
+    check(map, { { 1, std::string(100, 'x') } });
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -14,9 +14,13 @@
 
 #define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <random>
+#include <thread>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
@@ -67,6 +71,10 @@ void test_simple()
 
     die_unless(ppq.size() == nelements);
 
+    const ppq_type::phase_stats_type::snapshot_type phase_stats = ppq.phase_stats();
+    LOG1 << "Phase statistics: " << phase_stats.to_json();
+    die_unless(phase_stats.count[ppq_type::phase_stats_type::insertion_heap_flush] > 0);
+
     {
         scoped_print_timer timer("Emptying PPQ",
                                  nelements * sizeof(my_type));
@@ -98,6 +106,10 @@ void test_bulk_pop()
 
     LOG1 << "Running bulk_pop() test. bulk_size = " << bulk_size;
 
+    // the fill is push-heavy and the bulk pops are pop-heavy
+    ppq.c_adaptive_memory = true;
+    ppq.c_adaptive_window = 64 * 1024;
+
     {
         scoped_print_timer timer("Filling PPQ",
                                  nelements * sizeof(my_type));
@@ -141,6 +153,56 @@ void test_bulk_pop()
     die_unless(ppq.empty());
 }
 
+void test_bulk_pop_parallel()
+{
+    // little memory, the parts are merged from external arrays
+    ppq_type ppq(my_cmp(), 16L * 1024L * 1024L, 4);
+
+    const uint64_t volume = 64L * 1024L * 1024L;
+    const size_t num_parts = 4;
+
+    uint64_t nelements = volume / sizeof(my_type);
+
+    LOG1 << "Running bulk_pop_parallel() test. num_parts = " << num_parts;
+
+    // many equal keys, which straddle the borders of the parts
+    std::mt19937_64 randgen(stxxl::seed_sequence::get_ref().get_next_seed());
+    std::vector<int> keys(nelements);
+    for (uint64_t i = 0; i < nelements; i++)
+    {
+        keys[i] = int(randgen() % (nelements / 16));
+        ppq.push(my_type(keys[i]));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    die_unequal(ppq.size(), nelements);
+
+    {
+        scoped_print_timer timer("Emptying PPQ in parallel parts",
+                                 nelements * sizeof(my_type));
+
+        std::vector<std::vector<my_type> > out;
+        for (uint64_t i = 0, bulk_size = 1; i < nelements; bulk_size *= 3)
+        {
+            ppq.bulk_pop_parallel(out, bulk_size, num_parts);
+            die_unequal(out.size(), num_parts);
+
+            size_t popped = 0;
+            for (size_t p = 0; p < num_parts; ++p)
+            {
+                die_unless(out[p].size() + 1 >= out[0].size());
+                for (size_t j = 0; j < out[p].size(); ++j)
+                    die_unequal(out[p][j].key, keys[i++]);
+                popped += out[p].size();
+            }
+            die_unless(popped > 0);
+        }
+    }
+
+    die_unequal(ppq.size(), 0u);
+    die_unless(ppq.empty());
+}
+
 void test_bulk_limit(const size_t bulk_size)
 {
     ppq_type ppq(my_cmp(), 256L * 1024L * 1024L, 4);
@@ -229,6 +291,81 @@ void test_bulk_limit(const size_t bulk_size)
     die_unless(ppq.empty());
 }
 
+void test_concurrent_push()
+{
+    ppq_type ppq(my_cmp(), 128L * 1024L * 1024L, 4);
+
+    const uint64_t volume = 64L * 1024L * 1024L;
+    const size_t num_threads = 8;
+
+    uint64_t nelements = volume / sizeof(my_type) / num_threads * num_threads;
+
+    LOG1 << "Running concurrent_push() test. num_threads = " << num_threads;
+
+    for (size_t round = 0; round < 2; ++round)
+    {
+        scoped_print_timer timer("Concurrently filling and emptying PPQ",
+                                 nelements * sizeof(my_type));
+
+        // thread t pushes the keys t+1, t+1+num_threads, ...
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            threads.emplace_back([&, t]() {
+                                     for (uint64_t i = t; i < nelements; i += num_threads)
+                                         ppq.concurrent_push(my_type(int(nelements - i)));
+                                 });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        die_unequal(ppq.size(), nelements);
+
+        for (uint64_t i = 0; i < nelements; ++i)
+        {
+            die_unequal(ppq.top().key, int(i + 1));
+            ppq.pop();
+        }
+
+        die_unless(ppq.empty());
+    }
+}
+
+void test_compressed()
+{
+    // a minimum queue, whose blocks are ascending and packed by the delta
+    // codec into a fraction of the 64 KiB blocks
+    using key_type = uint64_t;
+    using cppq_type = stxxl::parallel_priority_queue<
+              key_type, std::greater<key_type>, foxxll::default_alloc_strategy,
+              64 * 1024, 1024 * 1024, 0,
+              stxxl::frame_of_reference_codec<key_type, true> >;
+
+    cppq_type ppq(std::greater<key_type>(), 4 * 1024 * 1024, 1.5f, 8, 2, 64 * 1024, 256 * 1024);
+
+    const size_t nelements = 4 * 1024 * 1024;
+    std::mt19937_64 rng(stxxl::seed_sequence::get_ref().get_next_seed());
+    std::vector<key_type> expected(nelements);
+
+    LOG1 << "Running compressed() test. nelements = " << nelements;
+
+    for (size_t i = 0; i < nelements; ++i)
+    {
+        expected[i] = (uint64_t(1) << 40) + rng() % (16 * nelements);
+        ppq.push(expected[i]);
+    }
+    die_unequal(ppq.size(), nelements);
+
+    std::sort(expected.begin(), expected.end());
+    for (size_t i = 0; i < nelements; ++i)
+    {
+        die_unequal(ppq.top(), expected[i]);
+        ppq.pop();
+    }
+
+    die_unless(ppq.empty());
+}
+
 int main()
 {
     foxxll::stats* stats = foxxll::stats::get_instance();
@@ -239,10 +376,19 @@ int main()
     test_bulk_pop();
     std::cout << "Stats after bulk_pop :" << (foxxll::stats_data(*stats) - stats_begin);
     stats_begin = *foxxll::stats::get_instance();
+    test_bulk_pop_parallel();
+    std::cout << "Stats after bulk_pop_parallel :" << (foxxll::stats_data(*stats) - stats_begin);
+    stats_begin = *foxxll::stats::get_instance();
     test_bulk_limit(1000);
     std::cout << "Stats after bulk_limit_1000 :" << (foxxll::stats_data(*stats) - stats_begin);
     stats_begin = *foxxll::stats::get_instance();
     test_bulk_limit(1024 * 1024);
     std::cout << "Stats after bulk_limit_1M: " << (foxxll::stats_data(*stats) - stats_begin);
+    stats_begin = *foxxll::stats::get_instance();
+    test_concurrent_push();
+    std::cout << "Stats after concurrent_push: " << (foxxll::stats_data(*stats) - stats_begin);
+    stats_begin = *foxxll::stats::get_instance();
+    test_compressed();
+    std::cout << "Stats after compressed: " << (foxxll::stats_data(*stats) - stats_begin);
     return 0;
 }
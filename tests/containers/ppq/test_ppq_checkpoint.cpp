@@ -0,0 +1,130 @@
+/***************************************************************************
+ *  tests/containers/ppq/test_ppq_checkpoint.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+
+#include <stxxl/bits/containers/parallel_priority_queue.h>
+
+using value_type = uint64_t;
+using cmp_type = std::less<value_type>;
+
+using ppq_type = stxxl::parallel_priority_queue<
+          value_type, cmp_type, foxxll::default_alloc_strategy, 4096, 1024 * 1024>;
+
+// small enough that the pushes are flushed into several external arrays
+const uint64_t total_ram = 4 * 1024 * 1024;
+
+ppq_type* new_ppq()
+{
+    return new ppq_type(cmp_type(), total_ram, 1.5f, 8, 2, 64 * 1024, 256 * 1024);
+}
+
+//! pops all elements, checks that they are ordered and returns them
+std::vector<value_type> pop_all(ppq_type& ppq)
+{
+    std::vector<value_type> out;
+    out.reserve(ppq.size());
+    while (!ppq.empty())
+    {
+        // the queue pops the largest element first
+        die_unless(out.empty() || !(out.back() < ppq.top()));
+        out.push_back(ppq.top());
+        ppq.pop();
+    }
+    return out;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0] << " file type" << std::endl;
+        return -1;
+    }
+
+    const size_t n = 2000000, m = 1000;
+    std::mt19937_64 rng(1);
+
+    std::vector<value_type> expected;
+    {
+        std::unique_ptr<ppq_type> ppq(new_ppq());
+        for (size_t i = 0; i < n; ++i)
+            ppq->push(rng() % 1000000000);
+
+        // read the external arrays partially, then push more
+        for (size_t i = 0; i < n / 3; ++i)
+            ppq->pop();
+        for (size_t i = 0; i < m; ++i)
+            ppq->push(rng() % 1000000000);
+
+        foxxll::file_ptr f = foxxll::create_file(
+            argv[2], argv[1], foxxll::file::CREAT | foxxll::file::DIRECT | foxxll::file::RDWR);
+        ppq->checkpoint(f);
+        LOG1 << "checkpoint of " << ppq->size() << " elements";
+
+        // the checkpoint does not change the queue
+        die_unequal(ppq->size(), n - n / 3 + m);
+        expected = pop_all(*ppq);
+    }
+
+    {
+        // restore the queue as a later process would
+        foxxll::file_ptr f = foxxll::create_file(
+            argv[2], argv[1], foxxll::file::DIRECT | foxxll::file::RDWR);
+        std::unique_ptr<ppq_type> ppq(new_ppq());
+        ppq->restore(f);
+        LOG1 << "restored " << ppq->size() << " elements";
+        die_unequal(ppq->size(), n - n / 3 + m);
+
+        // a checkpoint of the restored queue equals the first one
+        foxxll::file_ptr g = foxxll::create_file(
+            argv[2], std::string(argv[1]) + ".2",
+            foxxll::file::CREAT | foxxll::file::DIRECT | foxxll::file::RDWR);
+        ppq->checkpoint(g);
+
+        die_unless(pop_all(*ppq) == expected);
+
+        std::unique_ptr<ppq_type> again(new_ppq());
+        again->restore(g);
+        die_unless(pop_all(*again) == expected);
+    }
+
+    {
+        // a checkpoint of a queue without external arrays
+        std::unique_ptr<ppq_type> ppq(new_ppq());
+        for (size_t i = 0; i < m; ++i)
+            ppq->push(i);
+
+        foxxll::file_ptr f = foxxll::create_file(
+            argv[2], argv[1], foxxll::file::CREAT | foxxll::file::DIRECT | foxxll::file::RDWR);
+        ppq->checkpoint(f);
+
+        std::unique_ptr<ppq_type> restored(new_ppq());
+        restored->restore(f);
+        die_unless(pop_all(*restored) == pop_all(*ppq));
+    }
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
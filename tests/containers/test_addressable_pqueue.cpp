@@ -0,0 +1,109 @@
+/***************************************************************************
+ *  tests/containers/test_addressable_pqueue.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_addressable_pqueue.cpp
+//! This is an example of how to use \c stxxl::addressable_priority_queue for
+//! decrease-key by lazy invalidation
+
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <utility>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/priority_queue>
+
+#include <key_with_padding.h>
+
+using KeyType = int;
+constexpr size_t RecordSize = 16;
+using my_type = key_with_padding<KeyType, RecordSize>;
+
+using pq_type = stxxl::addressable_priority_queue<
+          my_type, my_type::compare_greater, 16* 1024* 1024, 1024* 1024>;
+using handle_type = pq_type::handle_type;
+using block_type = pq_type::block_type;
+
+int main()
+{
+    const size_t mem_for_pools = 16 * 1024 * 1024;
+    foxxll::read_write_pool<block_type> pool(
+        (mem_for_pools / 2) / block_type::raw_size,
+        (mem_for_pools / 2) / block_type::raw_size);
+
+    pq_type p(pool);
+
+    // live elements as (key, handle) and by handle
+    std::set<std::pair<KeyType, handle_type> > ref;
+    std::map<handle_type, KeyType> live;
+
+    std::mt19937 rng(42);
+    const size_t nops = 1024 * 1024;
+
+    for (size_t i = 0; i < nops; ++i)
+    {
+        const unsigned op = rng() % 10;
+        if (op < 5 || live.empty())
+        {
+            const KeyType key = KeyType(rng() % 1000000);
+            const handle_type h = p.push(my_type(key));
+            ref.emplace(key, h);
+            live[h] = key;
+        }
+        else if (op < 9)
+        {
+            // decrease the key of, or delete, a random live element
+            auto it = live.lower_bound(rng() % (live.rbegin()->first + 1));
+            if (it == live.end())
+                it = live.begin();
+            ref.erase(std::make_pair(it->second, it->first));
+
+            if (op < 8)
+            {
+                const KeyType key = it->second / 2;
+                const handle_type h = p.update(it->first, my_type(key));
+                live.erase(it);
+                ref.emplace(key, h);
+                live[h] = key;
+            }
+            else
+            {
+                p.invalidate(it->first);
+                live.erase(it);
+            }
+        }
+        else
+        {
+            die_unless(p.top().key == ref.begin()->first);
+            live.erase(p.top_handle());
+            ref.erase(std::make_pair(p.top().key, p.top_handle()));
+            p.pop();
+        }
+
+        die_unless(p.size() == ref.size());
+    }
+
+    LOG1 << "live elements: " << p.size() << " dead elements: " << p.num_dead();
+
+    while (!p.empty())
+    {
+        die_unless(p.top().key == ref.begin()->first);
+        ref.erase(std::make_pair(p.top().key, p.top_handle()));
+        p.pop();
+    }
+
+    die_unless(ref.empty());
+    die_unless(p.num_dead() == 0);
+
+    return 0;
+}
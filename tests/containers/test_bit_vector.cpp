@@ -0,0 +1,156 @@
+/***************************************************************************
+ *  tests/containers/test_bit_vector.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bit_vector>
+
+using bit_vector_type = stxxl::bit_vector<stxxl::lru_pager<8>, 4096>;
+
+void check_equal(const bit_vector_type& bits, const std::vector<bool>& check)
+{
+    die_unequal(bits.size(), check.size());
+    for (size_t i = 0; i < check.size(); ++i)
+        die_unequal(bits.test(i), check[i]);
+
+    size_t ones = 0;
+    for (bool b : check)
+        ones += b;
+    die_unequal(bits.count(), ones);
+
+    // stream of the bits
+    bit_vector_type::stream stream(bits);
+    for (size_t i = 0; i < check.size(); ++stream, ++i)
+    {
+        die_unless(!stream.empty());
+        die_unequal(*stream, check[i]);
+    }
+    die_unless(stream.empty());
+
+    // scan of the set bits
+    size_t next = 0;
+    bits.for_each_set(
+        [&](uint64_t i) {
+            while (next < i)
+                die_unless(!check[next++]);
+            die_unless(check[next++]);
+        });
+    while (next < check.size())
+        die_unless(!check[next++]);
+}
+
+void check_rank_select(bit_vector_type& bits, const std::vector<bool>& check, size_t sample_words)
+{
+    bits.build_rank_index(sample_words);
+    die_unless(bits.has_rank_index());
+
+    uint64_t ones = 0;
+    for (size_t i = 0; i <= check.size(); ++i)
+    {
+        die_unequal(bits.rank(i), ones);
+        if (i < check.size() && check[i])
+        {
+            die_unequal(bits.select(ones), i);
+            ++ones;
+        }
+    }
+    die_unequal(bits.count(), ones);
+}
+
+void test_size(size_t n)
+{
+    std::mt19937_64 randgen(n);
+    std::uniform_int_distribution<int> distr_bit(0, 3);
+
+    bit_vector_type a(n), b(n);
+    std::vector<bool> check_a(n), check_b(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (distr_bit(randgen) == 0)
+        {
+            a.set(i);
+            check_a[i] = true;
+        }
+        if (distr_bit(randgen) != 0)
+        {
+            die_unless(!b.test_and_set(i));
+            check_b[i] = true;
+        }
+    }
+    check_equal(a, check_a);
+    check_equal(b, check_b);
+    check_rank_select(a, check_a, 1);
+    check_rank_select(b, check_b, 3);
+
+    a |= b;
+    for (size_t i = 0; i < n; ++i)
+        check_a[i] = check_a[i] || check_b[i];
+    die_unless(!a.has_rank_index());
+    check_equal(a, check_a);
+
+    b.flip(n / 2);
+    check_b[n / 2] = !check_b[n / 2];
+    a &= b;
+    for (size_t i = 0; i < n; ++i)
+        check_a[i] = check_a[i] && check_b[i];
+    check_equal(a, check_a);
+
+    a ^= b;
+    for (size_t i = 0; i < n; ++i)
+        check_a[i] = check_a[i] != check_b[i];
+    check_equal(a, check_a);
+    check_rank_select(a, check_a, 2);
+
+    // words and shrinking drop the bits after size()
+    a.set_word(a.num_words() - 1, ~uint64_t(0));
+    for (size_t i = (a.num_words() - 1) * 64; i < n; ++i)
+        check_a[i] = true;
+    check_equal(a, check_a);
+
+    a.resize(n / 3);
+    check_a.resize(n / 3);
+    check_equal(a, check_a);
+    a.resize(n);
+    check_a.resize(n, false);
+    check_equal(a, check_a);
+
+    a.fill(true);
+    check_a.assign(n, true);
+    check_equal(a, check_a);
+
+    a ^= a;
+    check_a.assign(n, false);
+    check_equal(a, check_a);
+
+    bit_vector_type c;
+    std::vector<bool> check_c;
+    for (size_t i = 0; i < n; ++i)
+    {
+        c.push_back(check_b[i]);
+        check_c.push_back(check_b[i]);
+    }
+    check_equal(c, check_c);
+}
+
+int main()
+{
+    for (size_t n : { 1, 63, 64, 65, 1000, 4096 * 8 * 3 + 17 })
+    {
+        LOG1 << "bit_vector with " << n << " bits";
+        test_size(n);
+    }
+
+    return 0;
+}
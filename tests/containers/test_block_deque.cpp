@@ -0,0 +1,145 @@
+/***************************************************************************
+ *  tests/containers/test_block_deque.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <deque>
+#include <random>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/utils.hpp>
+
+#include <stxxl/block_deque>
+
+using my_type = uint64_t;
+using deque_type = stxxl::block_deque<my_type, 4096>;
+
+// forced instantiation
+template class stxxl::block_deque<my_type, 4096>;
+
+void check(const deque_type& xdeque, const std::deque<my_type>& sdeque)
+{
+    die_unequal(xdeque.size(), sdeque.size());
+    die_unequal(xdeque.empty(), sdeque.empty());
+    if (!sdeque.empty())
+    {
+        die_unequal(xdeque.front(), sdeque.front());
+        die_unequal(xdeque.back(), sdeque.back());
+    }
+}
+
+void check_all(const deque_type& xdeque, const std::deque<my_type>& sdeque)
+{
+    check(xdeque, sdeque);
+    for (size_t i = 0; i < sdeque.size(); ++i)
+        die_unequal(xdeque[i], sdeque[i]);
+}
+
+int main(int argc, char* argv[])
+{
+    const uint64_t ops = (argc >= 2)
+                         ? foxxll::atouint64(argv[1])
+                         : (64 * deque_type::block_type::size);
+
+    deque_type xdeque(4, 4);
+    std::deque<my_type> sdeque;
+
+    std::mt19937_64 randgen;
+    std::uniform_int_distribution<int> distr_op(0, 9);
+    std::uniform_int_distribution<my_type> distr_value;
+
+    LOG1 << "Random operations at both ends and random access";
+    for (uint64_t i = 0; i < ops; ++i)
+    {
+        const my_type value = distr_value(randgen);
+
+        switch (distr_op(randgen))
+        {
+        case 0: // make insertion a bit more likely
+        case 1:
+            xdeque.push_front(value);
+            sdeque.push_front(value);
+            break;
+        case 2:
+        case 3:
+            xdeque.push_back(value);
+            sdeque.push_back(value);
+            break;
+        case 4:
+            if (!sdeque.empty())
+            {
+                xdeque.pop_front();
+                sdeque.pop_front();
+            }
+            break;
+        case 5:
+            if (!sdeque.empty())
+            {
+                xdeque.pop_back();
+                sdeque.pop_back();
+            }
+            break;
+        case 6:
+        case 7:
+            if (!sdeque.empty())
+            {
+                // modify an element, such that the accessed block is dirty
+                const size_t n = static_cast<size_t>(value % sdeque.size());
+                xdeque[n] = value;
+                sdeque[n] = value;
+            }
+            break;
+        default:
+            if (!sdeque.empty())
+            {
+                const size_t n = static_cast<size_t>(value % sdeque.size());
+                die_unequal(xdeque[n], sdeque[n]);
+            }
+            break;
+        }
+
+        check(xdeque, sdeque);
+
+        if (i % (16 * deque_type::block_type::size) == 0)
+            check_all(xdeque, sdeque);
+    }
+    check_all(xdeque, sdeque);
+
+    LOG1 << "Sliding window of " << ops / 4 << " elements";
+    xdeque.clear();
+    sdeque.clear();
+    check(xdeque, sdeque);
+    for (uint64_t i = 0; i < ops; ++i)
+    {
+        xdeque.push_back(i);
+        sdeque.push_back(i);
+        if (sdeque.size() > ops / 4)
+        {
+            die_unequal(xdeque.front(), sdeque.front());
+            xdeque.pop_front();
+            sdeque.pop_front();
+        }
+    }
+    check_all(xdeque, sdeque);
+
+    LOG1 << "Draining from the front";
+    while (!sdeque.empty())
+    {
+        die_unequal(xdeque.front(), sdeque.front());
+        xdeque.pop_front();
+        sdeque.pop_front();
+    }
+    check(xdeque, sdeque);
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
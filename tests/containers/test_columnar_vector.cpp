@@ -0,0 +1,116 @@
+/***************************************************************************
+ *  tests/containers/test_columnar_vector.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+struct tag  // 3 bytes, not a power of 2 intentionally
+{
+    char c[3];
+};
+
+using columnar_type = stxxl::basic_columnar_vector<
+          1024, stxxl::lru_pager<4>, uint64_t, int32_t, double, tag>;
+using record_type = columnar_type::value_type;
+
+record_type make_record(uint64_t i)
+{
+    return record_type(i, static_cast<int32_t>(2 * i), 0.5 * double(i),
+                       tag { { static_cast<char>(i), 0, 0 } });
+}
+
+int main()
+{
+    const uint64_t size = 64 * 1024 + 42;
+
+    columnar_type cv;
+    {
+        columnar_type::bufwriter writer(cv);
+        for (uint64_t i = 0; i < size; ++i)
+            writer << make_record(i);
+    }
+    die_unless(cv.size() == size);
+    die_unless(cv.column<1>().size() == size);
+
+    // random access to whole records and single fields
+    for (uint64_t i = 0; i < size; i += 97)
+    {
+        const record_type r = cv.get(i);
+        die_unless(std::get<0>(r) == i);
+        die_unless(std::get<1>(r) == static_cast<int32_t>(2 * i));
+        die_unless(std::get<3>(r).c[0] == static_cast<char>(i));
+        die_unless(cv.column<2>()[i] == 0.5 * double(i));
+    }
+
+    cv.set(5, make_record(7));
+    die_unless(std::get<0>(*(cv.begin() + 5)) == 7);
+    cv.set(5, make_record(5));
+
+    cv.push_back(make_record(size));
+    die_unless(cv.end() - cv.begin() == static_cast<int64_t>(size + 1));
+    die_unless(std::get<0>(cv.end()[-1]) == size);
+
+    // zipped iterators
+    {
+        uint64_t i = 0;
+        for (columnar_type::const_iterator it = cv.begin(); it != cv.end(); ++it, ++i)
+            die_unless(std::get<1>(*it) == static_cast<int32_t>(2 * i));
+        die_unless(i == size + 1);
+    }
+
+    // per-column buffered reader
+    {
+        columnar_type::column_bufreader_type<2> reader(cv.column<2>());
+        uint64_t i = 0;
+        for ( ; !reader.empty(); ++reader, ++i)
+            die_unless(*reader == 0.5 * double(i));
+        die_unless(i == size + 1);
+    }
+
+    // stream of two columns, fed into a stream algorithm
+    {
+        const uint64_t begin = 1000;
+        columnar_type::reader<1, 3> reader(cv, begin, size);
+        die_unless(reader.size() == size - begin);
+
+        std::vector<std::tuple<int32_t, tag> > out(size - begin);
+        stxxl::stream::materialize(reader, out.begin());
+        die_unless(reader.empty());
+
+        for (uint64_t i = 0; i < out.size(); ++i)
+        {
+            die_unless(std::get<0>(out[i]) == static_cast<int32_t>(2 * (begin + i)));
+            die_unless(std::get<1>(out[i]).c[0] == static_cast<char>(begin + i));
+        }
+    }
+
+    columnar_type cv2;
+    cv2.swap(cv);
+    die_unless(cv.empty() && cv2.size() == size + 1);
+
+    cv2.resize(10);
+    die_unless(std::get<0>(cv2.get(9)) == 9);
+    cv2.clear();
+    die_unless(cv2.empty());
+
+    stxxl::columnar_vector<uint64_t, uint32_t> cv3(3);
+    die_unless(cv3.size() == 3);
+
+    LOG1 << "success";
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+/***************************************************************************
+ *  tests/containers/test_combining_sorter.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/combining_sorter>
+
+//! a key with its number of occurrences
+struct key_count
+{
+    uint64_t key;
+    uint64_t count;
+};
+
+struct Cmp
+{
+    bool operator () (const key_count& a, const key_count& b) const
+    {
+        return a.key < b.key;
+    }
+    key_count min_value() const
+    {
+        return key_count { std::numeric_limits<uint64_t>::min(), 0 };
+    }
+    key_count max_value() const
+    {
+        return key_count { std::numeric_limits<uint64_t>::max(), 0 };
+    }
+};
+
+struct Combine
+{
+    key_count operator () (const key_count& a, const key_count& b) const
+    {
+        return key_count { a.key, a.count + b.count };
+    }
+};
+
+using sorter_type = stxxl::combining_sorter<key_count, Cmp, Combine, 4096>;
+
+// forced instantiation
+template class stxxl::combining_sorter<key_count, Cmp, Combine, 4096>;
+
+//! checks that the output of the sorter holds each key of expected once
+//! with its count, in sorted order
+void check_output(sorter_type& s, const std::map<uint64_t, uint64_t>& expected)
+{
+    std::map<uint64_t, uint64_t>::const_iterator it = expected.begin();
+    for ( ; !s.empty(); ++s, ++it)
+    {
+        die_unless(it != expected.end());
+        die_unequal(s->key, it->first);
+        die_unequal(s->count, it->second);
+    }
+    die_unless(it == expected.end());
+}
+
+//! pushes n items with keys out of num_keys
+void test_combining_sorter(sorter_type& s, size_t n, uint64_t num_keys)
+{
+    LOG1 << "Pushing " << n << " items with " << num_keys << " distinct keys";
+
+    std::mt19937_64 rng(n);
+    std::map<uint64_t, uint64_t> expected;
+    for (size_t i = 0; i < n; ++i)
+    {
+        key_count x { 1 + rng() % num_keys, 1 + i % 3 };
+        expected[x.key] += x.count;
+        s.push(x);
+    }
+    die_unequal(s.size(), n);
+
+    s.sort();
+    LOG1 << "Items in runs after combining: " << s.run_size();
+    die_unless(s.run_size() <= n);
+
+    check_output(s, expected);
+    s.rewind();
+    check_output(s, expected);
+}
+
+int main()
+{
+    const size_t memory_to_use = 64 * 4096;
+
+    sorter_type s(Cmp(), memory_to_use);
+    LOG1 << "Items per buffer: " << s.num_els_in_buffer();
+
+    // repeated keys: each buffer holds every key at most once
+    test_combining_sorter(s, 500000, 1000);
+    die_unless(s.run_size() <= 1000 * (500000 / s.num_els_in_buffer() + 1));
+
+    // mostly distinct keys, combined during the merge only
+    s.clear();
+    test_combining_sorter(s, 200000, 1000000000);
+
+    // a single buffer
+    s.clear();
+    test_combining_sorter(s, 100, 10);
+    die_unequal(s.run_size(), 10u);
+
+    // nothing pushed
+    s.clear();
+    test_combining_sorter(s, 0, 1);
+
+    return 0;
+}
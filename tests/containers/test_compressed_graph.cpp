@@ -0,0 +1,180 @@
+/***************************************************************************
+ *  tests/containers/test_compressed_graph.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/compressed_graph>
+#include <stxxl/vector>
+
+using graph_type = stxxl::compressed_graph<uint32_t, stxxl::lru_pager<8>, 4096>;
+using edge_type = graph_type::edge_type;
+using edge_vector_type = stxxl::vector<edge_type>;
+
+// forced instantiation
+template class stxxl::compressed_graph<uint64_t>;
+
+int main()
+{
+    const uint32_t n = 100000;
+
+    // a graph with locality: most neighbors are close to their node, some
+    // are anywhere, and the last nodes are isolated
+    std::mt19937 randgen;
+    std::uniform_int_distribution<uint32_t> distr_degree(0, 20);
+    std::uniform_int_distribution<uint32_t> distr_local(0, 64);
+    std::uniform_int_distribution<uint32_t> distr_node(0, n - 1);
+
+    std::vector<edge_type> edges;
+    for (uint32_t u = 0; u < n - 100; ++u)
+    {
+        const uint32_t degree = distr_degree(randgen);
+        for (uint32_t i = 0; i < degree; ++i)
+        {
+            const uint32_t v = (i % 8 == 7) ? distr_node(randgen)
+                               : std::min(n - 1, std::max(u, 32u) - 32 + distr_local(randgen));
+            edges.emplace_back(u, v);
+        }
+    }
+    // a node of high degree, with a duplicate edge
+    for (uint32_t v = 0; v < n; v += 3)
+        edges.emplace_back(n / 2, v);
+    edges.emplace_back(n / 2, 0);
+    std::sort(edges.begin(), edges.end());
+
+    edge_vector_type edge_vector;
+    {
+        edge_vector_type::bufwriter_type writer(edge_vector);
+        for (const edge_type& e : edges)
+            writer << e;
+        writer.finish();
+    }
+
+    graph_type graph;
+    {
+        edge_vector_type::bufreader_type reader(edge_vector);
+        graph.build(n, reader);
+    }
+    die_unequal(graph.num_nodes(), n);
+    die_unequal(graph.num_edges(), edges.size());
+
+    LOG1 << "compressed " << edges.size() << " edges into " << graph.bytes()
+         << " bytes, " << static_cast<double>(graph.bytes()) / edges.size()
+         << " bytes per edge";
+    die_unless(graph.bytes() < 3 * edges.size());
+
+    LOG1 << "edge stream";
+    {
+        graph_type::edge_stream stream(graph);
+        for (const edge_type& e : edges)
+        {
+            die_unless(!stream.empty());
+            die_unless(*stream == e);
+            ++stream;
+        }
+        die_unless(stream.empty());
+    }
+
+    LOG1 << "random access";
+    {
+        std::vector<uint32_t> neighbors;
+        std::vector<edge_type>::const_iterator it = edges.begin();
+        for (uint32_t u = 0; u < n; ++u)
+        {
+            graph.neighbors(u, neighbors);
+            die_unequal(graph.degree(u), neighbors.size());
+            for (uint32_t v : neighbors)
+            {
+                die_unless(it != edges.end() && *it == edge_type(u, v));
+                ++it;
+            }
+        }
+        die_unless(it == edges.end());
+    }
+
+    LOG1 << "ranges of nodes";
+    {
+        const uint32_t first = n / 2 - 10, last = n / 2 + 10;
+        std::vector<edge_type>::const_iterator it = std::lower_bound(
+            edges.begin(), edges.end(), edge_type(first, 0));
+        for (graph_type::edge_stream stream(graph, first, last); !stream.empty(); ++stream, ++it)
+            die_unless(*stream == *it);
+        die_unless(std::get<0>(*it) >= last);
+
+        graph_type::edge_stream empty_stream(graph, n - 50, n);
+        die_unless(empty_stream.empty());
+    }
+
+    LOG1 << "partitioned scans";
+    {
+        const size_t n_parts = 7;
+        const std::vector<graph_type::bound_type> bounds = graph.partition(n_parts);
+        die_unequal(bounds.size(), n_parts + 1);
+        die_unequal(bounds.back().node, n);
+
+        std::vector<edge_type>::const_iterator it = edges.begin();
+        for (size_t p = 0; p < n_parts; ++p)
+        {
+            die_unless(bounds[p].node <= bounds[p + 1].node);
+            for (graph_type::edge_stream stream(graph, bounds[p], bounds[p + 1]); !stream.empty(); ++stream, ++it)
+                die_unless(*stream == *it);
+        }
+        die_unless(it == edges.end());
+
+        std::atomic<uint64_t> count(0), checksum(0);
+        graph.for_each_parallel(
+            [&](uint32_t u, uint32_t v) {
+                ++count;
+                checksum += uint64_t(u) * n + v;
+            }, n_parts);
+
+        uint64_t expected = 0;
+        for (const edge_type& e : edges)
+            expected += uint64_t(std::get<0>(e)) * n + std::get<1>(e);
+        die_unequal(count.load(), edges.size());
+        die_unequal(checksum.load(), expected);
+    }
+
+    LOG1 << "unsorted edges";
+    {
+        std::swap(edges[10], edges[20]);
+        edge_vector_type unsorted;
+        edge_vector_type::bufwriter_type writer(unsorted);
+        for (const edge_type& e : edges)
+            writer << e;
+        writer.finish();
+
+        bool thrown = false;
+        try {
+            edge_vector_type::bufreader_type reader(unsorted);
+            graph.build(n, reader);
+        }
+        catch (const foxxll::bad_parameter&) {
+            thrown = true;
+        }
+        die_unless(thrown);
+    }
+
+    graph.clear();
+    die_unless(graph.empty());
+    die_unequal(graph.bytes(), 0u);
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,143 @@
+/***************************************************************************
+ *  tests/containers/test_concurrent_queue.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/utils.hpp>
+
+#include <stxxl/concurrent_queue>
+
+using value_type = uint64_t;
+using queue_type = stxxl::concurrent_queue<value_type, 4096>;
+
+// forced instantiation
+template class stxxl::concurrent_queue<value_type, 4096>;
+
+//! values encode their producer in the upper bits
+static const unsigned producer_shift = 40;
+
+void test_sequential(size_t n)
+{
+    LOG1 << "Sequential push and try_pop of " << n << " elements";
+
+    queue_type q(4, 2);
+    value_type x;
+    die_unless(!q.try_pop(x));
+
+    for (size_t round = 0; round < 2; ++round)
+    {
+        for (value_type i = 0; i < n; ++i)
+            q.push(i);
+        die_unequal(q.size(), n);
+
+        for (value_type i = 0; i < n / 2; ++i)
+        {
+            die_unless(q.try_pop(x));
+            die_unequal(x, i);
+        }
+        // alternate, such that the head block takes over the tail block
+        for (value_type i = n / 2; i < n; ++i)
+        {
+            q.push(n + i);
+            die_unless(q.try_pop(x));
+            die_unequal(x, i);
+        }
+        for (value_type i = n / 2; i < n; ++i)
+        {
+            die_unless(q.try_pop(x));
+            die_unequal(x, n + i);
+        }
+        die_unless(q.empty());
+        die_unless(!q.try_pop(x));
+    }
+
+    q.close();
+    die_unless(!q.pop(x));
+}
+
+void test_concurrent(size_t n, unsigned producers, unsigned consumers)
+{
+    LOG1 << "Concurrent push and pop of " << n << " elements by "
+         << producers << " producers and " << consumers << " consumers";
+
+    queue_type q(8, 4);
+
+    // per consumer: the number of popped elements of each producer
+    std::vector<std::vector<value_type> > counts(
+        consumers, std::vector<value_type>(producers, 0));
+
+    std::vector<std::thread> threads;
+    for (unsigned c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back(
+            [&q, &counts, c, producers]() {
+                std::vector<value_type> next(producers, 0);
+                value_type x;
+                while (q.pop(x))
+                {
+                    const value_type p = x >> producer_shift;
+                    const value_type seq = x & ((value_type(1) << producer_shift) - 1);
+                    die_unless(p < producers);
+                    // the elements of one producer arrive in order
+                    die_unless(seq >= next[p]);
+                    next[p] = seq + 1;
+                    ++counts[c][p];
+                }
+            });
+    }
+
+    std::vector<std::thread> producer_threads;
+    for (unsigned p = 0; p < producers; ++p)
+    {
+        producer_threads.emplace_back(
+            [&q, p, n, producers]() {
+                for (value_type i = p; i < n; i += producers)
+                    q.push((value_type(p) << producer_shift) | (i / producers));
+            });
+    }
+    for (std::thread& t : producer_threads)
+        t.join();
+
+    q.close();
+    for (std::thread& t : threads)
+        t.join();
+
+    die_unless(q.empty());
+
+    for (unsigned p = 0; p < producers; ++p)
+    {
+        value_type total = 0;
+        for (unsigned c = 0; c < consumers; ++c)
+            total += counts[c][p];
+        die_unequal(total, (n - p + producers - 1) / producers);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = 1000000;
+    if (argc > 1)
+        n = static_cast<size_t>(foxxll::atoi64(argv[1]));
+
+    test_sequential(n);
+    test_concurrent(n, 1, 1);
+    test_concurrent(n, 4, 1);
+    test_concurrent(n, 1, 4);
+    test_concurrent(n, 4, 4);
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
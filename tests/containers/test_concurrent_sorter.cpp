@@ -0,0 +1,137 @@
+/***************************************************************************
+ *  tests/containers/test_concurrent_sorter.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/concurrent_sorter>
+
+using value_type = uint64_t;
+
+struct Cmp
+{
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        return a < b;
+    }
+    value_type min_value() const
+    {
+        return std::numeric_limits<value_type>::min();
+    }
+    value_type max_value() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+};
+
+using sorter_type = stxxl::concurrent_sorter<value_type, Cmp, 4096>;
+
+// forced instantiation
+template class stxxl::concurrent_sorter<value_type, Cmp, 4096>;
+
+//! pushes n random values into the sorter from each of num_threads threads,
+//! and checks that the output is sorted and has the pushed checksum
+void test_concurrent_push(sorter_type& s, size_t num_threads, size_t n)
+{
+    LOG1 << "Pushing " << n << " elements from each of " << num_threads << " threads";
+
+    std::vector<value_type> checksums(num_threads, 0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(
+            [&, t]() {
+                std::mt19937_64 rng(t);
+                sorter_type::pusher pusher(s);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    value_type x = rng() % (n * num_threads);
+                    checksums[t] += x;
+                    pusher.push(x);
+                }
+            });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    die_unequal(s.size(), n * num_threads);
+    s.sort();
+
+    for (size_t round = 0; round < 2; ++round)
+    {
+        die_unequal(s.size(), n * num_threads);
+
+        value_type checksum = 0, prev = 0;
+        size_t count = 0;
+        for ( ; !s.empty(); ++s, ++count)
+        {
+            die_unless(prev <= *s);
+            prev = *s;
+            checksum += *s;
+        }
+        die_unequal(count, n * num_threads);
+
+        value_type expected = 0;
+        for (const value_type& c : checksums)
+            expected += c;
+        die_unequal(checksum, expected);
+
+        s.rewind();
+    }
+}
+
+int main()
+{
+    const size_t memory_to_use = 64 * 4096;
+
+    {
+        // few items, all in the buffers of the pushers
+        sorter_type s(Cmp(), memory_to_use, 4);
+        {
+            sorter_type::pusher p1(s), p2(s);
+            p1.push(42);
+            p2.push(0);
+            p1.push(23);
+        }
+        s.sort();
+
+        die_unequal(*s, 0u);
+        ++s;
+        die_unequal(*s, 23u);
+        ++s;
+        die_unequal(*s, 42u);
+        ++s;
+        die_unless(s.empty());
+    }
+
+    {
+        sorter_type s(Cmp(), memory_to_use, 4);
+        LOG1 << "Items per buffer: " << s.num_els_in_buffer();
+
+        // many runs from several threads
+        test_concurrent_push(s, 4, 200000);
+
+        // reuse the sorter after clear, with more threads than buffers
+        s.clear();
+        test_concurrent_push(s, 12, 20000);
+
+        // nothing pushed
+        s.clear();
+        test_concurrent_push(s, 2, 0);
+    }
+
+    return 0;
+}
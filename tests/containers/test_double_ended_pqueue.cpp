@@ -0,0 +1,126 @@
+/***************************************************************************
+ *  tests/containers/test_double_ended_pqueue.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_double_ended_pqueue.cpp
+//! This is an example of how to use \c stxxl::double_ended_priority_queue,
+//! also as a bounded queue keeping the smallest elements
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <set>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/double_ended_priority_queue>
+
+using depq_type = stxxl::double_ended_priority_queue<
+          uint64_t, std::less<uint64_t>, 4096>;
+using ref_type = std::multiset<uint64_t>;
+
+//! push, pop_min and pop_max randomly with a small heap, such that the heap
+//! is spilled and the runs are merged, and check against a multiset.
+void test_random(size_t nelements, uint64_t max_key)
+{
+    LOG1 << "Test " << nelements << " elements with keys below " << max_key;
+
+    depq_type pq(0, 1024, 4);
+    ref_type ref;
+
+    std::mt19937_64 rng(nelements + max_key);
+
+    for (size_t i = 0; i < nelements; ++i)
+    {
+        // pop more often in the second half to empty the queue
+        const unsigned r = rng() % 16;
+        if (!pq.empty() && r < (i < nelements / 2 ? 3u : 6u))
+        {
+            die_unequal(pq.top_min(), *ref.begin());
+            pq.pop_min();
+            ref.erase(ref.begin());
+        }
+        else if (!pq.empty() && r < (i < nelements / 2 ? 6u : 12u))
+        {
+            die_unequal(pq.top_max(), *ref.rbegin());
+            pq.pop_max();
+            ref.erase(std::prev(ref.end()));
+        }
+        else
+        {
+            const uint64_t key = rng() % max_key;
+            pq.push(key);
+            ref.insert(key);
+        }
+        die_unequal(pq.size(), ref.size());
+
+        if (i == nelements / 2)
+            LOG1 << "Runs after the first half: " << pq.num_runs();
+    }
+
+    while (!pq.empty())
+    {
+        die_unequal(pq.top_min(), *ref.begin());
+        die_unequal(pq.top_max(), *ref.rbegin());
+        if (rng() % 2)
+        {
+            pq.pop_min();
+            ref.erase(ref.begin());
+        }
+        else
+        {
+            pq.pop_max();
+            ref.erase(std::prev(ref.end()));
+        }
+    }
+
+    die_unless(ref.empty());
+}
+
+//! push into a bounded queue, which keeps the smallest elements.
+void test_bounded(size_t nelements, size_t bound)
+{
+    LOG1 << "Test bounded queue of " << bound << " out of " << nelements;
+
+    depq_type pq(bound, 1024, 4);
+    ref_type ref;
+
+    std::mt19937_64 rng(nelements + bound);
+
+    for (size_t i = 0; i < nelements; ++i)
+    {
+        const uint64_t key = rng() % (4 * nelements);
+        pq.push(key);
+        ref.insert(key);
+        if (ref.size() > bound)
+            ref.erase(std::prev(ref.end()));
+        die_unequal(pq.size(), ref.size());
+        die_unequal(pq.top_max(), *ref.rbegin());
+    }
+
+    for (ref_type::const_iterator it = ref.begin(); it != ref.end(); ++it)
+    {
+        die_unequal(pq.top_min(), *it);
+        pq.pop_min();
+    }
+    die_unless(pq.empty());
+}
+
+int main()
+{
+    test_random(100000, 1000);
+    test_random(1000000, uint64_t(1) << 40);
+    test_bounded(1000000, 10000);
+    test_bounded(100000, 100);
+
+    LOG1 << "Success.";
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+/***************************************************************************
+ *  tests/containers/test_dynamic_pqueue.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_dynamic_pqueue.cpp
+//! This is an example of how to use \c stxxl::dynamic_priority_queue with
+//! parameters chosen at runtime
+
+#include <iostream>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/priority_queue>
+
+#include <key_with_padding.h>
+
+using KeyType = int;
+constexpr size_t RecordSize = 128;
+using my_type = key_with_padding<KeyType, RecordSize>;
+
+using pq_type = stxxl::dynamic_priority_queue<
+          my_type, my_type::compare_greater, 64* 1024>;
+using block_type = pq_type::block_type;
+
+template <typename PQ>
+void fill_and_empty(PQ& p, size_t nelements)
+{
+    LOG1 << "Internal memory consumption of the priority queue: " << p.mem_cons() << " B";
+
+    for (size_t i = 0; i < nelements; i++)
+        p.push(my_type(int(nelements - i)));
+
+    die_unless(p.size() == nelements);
+
+    for (size_t i = 0; i < nelements; ++i)
+    {
+        die_unless(!p.empty());
+        die_unless(p.top().key == int(i + 1));
+        p.pop();
+    }
+
+    die_unless(p.size() == 0);
+    die_unless(p.empty());
+}
+
+int main()
+{
+    const size_t mem_for_pools = 16 * 1024 * 1024;
+    foxxll::read_write_pool<block_type> pool(
+        (mem_for_pools / 2) / block_type::raw_size,
+        (mem_for_pools / 2) / block_type::raw_size);
+
+    {
+        // parameters computed from the memory limit at runtime
+        const size_t nelements = 256 * 1024;
+        pq_type::parameters params =
+            pq_type::parameters::from_memory(4 * 1024 * 1024, nelements);
+
+        pq_type p(pool, params);
+        p.dump_params();
+        fill_and_empty(p, nelements);
+    }
+    {
+        // tiny groups and mergers, the last external group overflows
+        pq_type::parameters params;
+        params.delete_buffer_size = 16;
+        params.N = 64;
+        params.int_arity = 4;
+        params.num_int_groups = 2;
+        params.ext_arity = 4;
+        params.num_ext_groups = 2;
+
+        pq_type p(pool, params);
+        fill_and_empty(p, 64 * 1024);
+    }
+    {
+        // invalid parameters are rejected
+        pq_type::parameters params;
+        params.int_arity = 1024;
+
+        bool thrown = false;
+        try {
+            pq_type p(pool, params);
+        }
+        catch (std::runtime_error&) {
+            thrown = true;
+        }
+        die_unless(thrown);
+    }
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+/***************************************************************************
+ *  tests/containers/test_fm_index.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_fm_index.cpp
+//! Test \c stxxl::fm_index against searching the text naively
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/fm_index>
+#include <stxxl/vector>
+
+using alphabet_type = unsigned char;
+using offset_type = uint32_t;
+using fm_index_type = stxxl::fm_index<alphabet_type, offset_type>;
+
+const size_t M = 16 * 1024 * 1024;
+
+//! check count() and locate() of the pattern
+void check(const fm_index_type& index, const std::vector<alphabet_type>& text,
+           const std::vector<alphabet_type>& pattern)
+{
+    // the empty pattern also matches the empty suffix
+    std::vector<offset_type> ref;
+    for (size_t i = 0; i + pattern.size() <= text.size(); ++i)
+    {
+        if (std::equal(pattern.begin(), pattern.end(), text.begin() + i))
+            ref.push_back(static_cast<offset_type>(i));
+    }
+
+    die_unequal(index.count(pattern.begin(), pattern.end()), ref.size());
+
+    std::vector<offset_type> found;
+    die_unequal(index.locate(pattern.begin(), pattern.end(), std::back_inserter(found)),
+                ref.size());
+    std::sort(found.begin(), found.end());
+    die_unless(found == ref);
+}
+
+void test(const std::vector<alphabet_type>& text, size_t occ_rate, size_t sa_rate,
+          std::mt19937& rng)
+{
+    const size_t n = text.size();
+    LOG1 << "text of " << n << " characters, occ_rate " << occ_rate
+         << " sa_rate " << sa_rate;
+
+    stxxl::vector<alphabet_type> text_vector(n);
+    std::copy(text.begin(), text.end(), text_vector.begin());
+
+    fm_index_type index(occ_rate, sa_rate);
+    index.build(text_vector.cbegin(), text_vector.cend(), M);
+    die_unequal(index.size(), n);
+    die_unequal(index.bwt().size(), n);
+
+    // the rows are ordered by their suffixes
+    die_unequal(index.locate_row(0), n);
+    die_unequal(index.locate_row(index.primary_index()), 0u);
+    for (size_t row = 1; row + 1 < index.rows(); row += 1 + n / 1000)
+    {
+        const size_t a = index.locate_row(row), b = index.locate_row(row + 1);
+        die_unless(std::lexicographical_compare(
+                       text.begin() + a, text.end(), text.begin() + b, text.end()));
+    }
+
+    check(index, text, std::vector<alphabet_type>());
+    for (size_t r = 0; r < 200 && n > 0; ++r)
+    {
+        const size_t pos = rng() % n;
+        const size_t m = 1 + rng() % std::min<size_t>(n - pos, 12);
+        std::vector<alphabet_type> pattern(text.begin() + pos, text.begin() + pos + m);
+        check(index, text, pattern);
+
+        // likely absent
+        pattern.push_back(static_cast<alphabet_type>(rng()));
+        check(index, text, pattern);
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(42);
+
+    for (size_t n : { 0, 1, 2, 3, 100, 5000, 100000 })
+    {
+        for (unsigned sigma : { 2, 4, 256 })
+        {
+            std::vector<alphabet_type> text(n);
+            for (alphabet_type& c : text)
+                c = static_cast<alphabet_type>('a' + rng() % sigma);
+            test(text, 256, 32, rng);
+            test(text, 7, 5, rng);
+            if (n <= 5000)
+                test(text, 1, 1, rng);
+        }
+    }
+
+    test(std::vector<alphabet_type>(3000, 'a'), 64, 16, rng);
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,136 @@
+/***************************************************************************
+ *  tests/containers/test_inverted_index.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/inverted_index>
+
+using builder_type = stxxl::inverted_index_builder<uint32_t, uint32_t, stxxl::lru_pager<8>, 4096>;
+using index_type = builder_type::index_type;
+
+// forced instantiation
+template class stxxl::inverted_index<uint64_t, uint64_t>;
+template class stxxl::inverted_index_builder<uint64_t, uint64_t>;
+
+//! expected frequencies by term and document
+using reference_type = std::map<uint32_t, std::map<uint32_t, uint64_t> >;
+
+void check(const index_type& index, const reference_type& ref)
+{
+    die_unequal(index.num_terms(), ref.size());
+
+    uint64_t num_postings = 0;
+    std::vector<index_type::posting_type> postings;
+    for (const auto& term : ref)
+    {
+        die_unless(index.postings(term.first, postings));
+        die_unequal(postings.size(), term.second.size());
+
+        index_type::term_entry_type entry;
+        die_unless(index.find(term.first, entry));
+        index_type::posting_stream stream(index, entry);
+
+        size_t i = 0;
+        for (const auto& doc : term.second)
+        {
+            die_unequal(postings[i].doc, doc.first);
+            die_unequal(postings[i].freq, doc.second);
+            die_unless(!stream.empty());
+            die_unequal(stream->doc, doc.first);
+            die_unequal(stream->freq, doc.second);
+            ++stream, ++i;
+        }
+        die_unless(stream.empty());
+        num_postings += term.second.size();
+    }
+    die_unequal(index.num_postings(), num_postings);
+}
+
+int main()
+{
+    const size_t n = 500000;
+    const uint32_t num_terms = 5000, num_docs = 20000;
+
+    std::mt19937 randgen;
+    // a skewed distribution of the terms, as of words
+    std::geometric_distribution<uint32_t> distr_term(0.002);
+    std::uniform_int_distribution<uint32_t> distr_doc(0, num_docs - 1);
+
+    builder_type builder(1024 * 1024);
+    reference_type ref;
+
+    LOG1 << "pushing " << n << " occurrences";
+    for (size_t i = 0; i < n; ++i)
+    {
+        const uint32_t term = 2 * (distr_term(randgen) % num_terms);
+        const uint32_t doc = distr_doc(randgen);
+        const uint64_t freq = 1 + i % 2;
+        builder.push(term, doc, freq);
+        ref[term][doc] += freq;
+    }
+    die_unequal(builder.size(), n);
+
+    index_type index;
+    builder.build(index, 4096);
+    die_unequal(builder.size(), 0u);
+
+    LOG1 << "built the index of " << index.num_terms() << " terms and "
+         << index.num_postings() << " postings in " << index.bytes() << " bytes";
+    check(index, ref);
+
+    // terms without postings
+    std::vector<index_type::posting_type> postings;
+    die_unless(!index.postings(1, postings));
+    die_unless(postings.empty());
+    die_unless(!index.postings(2 * num_terms + 1, postings));
+
+    // the dictionary is sorted by term
+    {
+        auto it = ref.begin();
+        for (index_type::dictionary_type::bufreader_type reader(index.dictionary());
+             !reader.empty(); ++reader, ++it)
+        {
+            die_unequal(reader->term, it->first);
+            die_unequal(reader->docs, it->second.size());
+        }
+        die_unless(it == ref.end());
+    }
+
+    LOG1 << "rebuilding";
+    ref.clear();
+    for (uint32_t doc = 0; doc < 1000; ++doc)
+    {
+        builder.push(7, doc);
+        ref[7][doc] += 1;
+    }
+    builder.push(3, 5, 10);
+    ref[3][5] += 10;
+    builder.build(index);
+    check(index, ref);
+
+    index.clear();
+    die_unless(index.empty());
+    die_unless(!index.postings(7, postings));
+
+    builder.build(index);
+    die_unless(index.empty());
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
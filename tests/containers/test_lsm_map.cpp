@@ -0,0 +1,119 @@
+/***************************************************************************
+ *  tests/containers/test_lsm_map.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_lsm_map.cpp
+//! This is an example of how to use \c stxxl::lsm_map
+
+#include <cstdint>
+#include <map>
+#include <random>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/lsm_map>
+
+using lsm_type = stxxl::lsm_map<
+          uint64_t, uint64_t, std::less<uint64_t>, std::hash<uint64_t>, 4096>;
+using ref_type = std::map<uint64_t, uint64_t>;
+
+//! check that a stream yields the entries of the reference in [lower, upper)
+void check_range(lsm_type::range_stream s,
+                 ref_type::const_iterator it, ref_type::const_iterator end)
+{
+    for ( ; it != end; ++it, ++s)
+    {
+        die_if(s.empty());
+        die_unequal(s->first, it->first);
+        die_unequal(s->second, it->second);
+    }
+    die_unless(s.empty());
+}
+
+void check(const lsm_type& map, const ref_type& ref, uint64_t max_key, std::mt19937_64& rng)
+{
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        const uint64_t key = rng() % max_key;
+        ref_type::const_iterator it = ref.find(key);
+        uint64_t data;
+        die_unequal(map.find(key, data), it != ref.end());
+        if (it != ref.end())
+            die_unequal(data, it->second);
+    }
+
+    for (size_t i = 0; i < 10; ++i)
+    {
+        uint64_t lower = rng() % max_key, upper = rng() % max_key;
+        if (upper < lower)
+            std::swap(lower, upper);
+        check_range(map.range(lower, upper), ref.lower_bound(lower), ref.lower_bound(upper));
+    }
+
+    check_range(map.scan(), ref.begin(), ref.end());
+}
+
+//! insert and erase randomly with a small memtable, such that many tables
+//! are flushed and merged, and check against a std::map.
+void test_random(size_t nops, uint64_t max_key)
+{
+    LOG1 << "Test " << nops << " operations with keys below " << max_key;
+
+    lsm_type map(64 * 1024, 3);
+    ref_type ref;
+
+    std::mt19937_64 rng(nops + max_key);
+
+    for (size_t i = 0; i < nops; ++i)
+    {
+        const uint64_t key = rng() % max_key;
+        if (rng() % 4 == 0) {
+            map.erase(key);
+            ref.erase(key);
+        }
+        else {
+            const uint64_t data = rng();
+            map.insert_or_assign(key, data);
+            ref[key] = data;
+        }
+
+        if ((i + 1) % (nops / 4) == 0)
+        {
+            LOG1 << "  " << map.num_tables() << " tables in "
+                 << map.num_levels() << " levels";
+            check(map, ref, max_key, rng);
+        }
+    }
+
+    map.flush();
+    map.wait_merges();
+    die_unless(map.memtable_size() == 0);
+    // no level holds fanout tables
+    die_unless(map.num_tables() < 3 * map.num_levels());
+    check(map, ref, max_key, rng);
+
+    // erase everything, the deepest merge drops the tombstones
+    for (const ref_type::value_type& e : ref)
+        map.erase(e.first);
+    ref.clear();
+    check(map, ref, max_key, rng);
+}
+
+int main()
+{
+    test_random(200000, 1000000);
+    test_random(200000, 10000);
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
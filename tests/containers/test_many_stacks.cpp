@@ -16,12 +16,17 @@
 //! with \c stxxl::grow_shrink_stack implementation, \b four blocks per page,
 //! block size \b 4096 bytes
 
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
 #include <tlx/logger.hpp>
 
 #include <stxxl/stack>
 
 // forced instantiation
 template class stxxl::STACK_GENERATOR<int, stxxl::external, stxxl::normal, 4, 4096>;
+template class stxxl::STACK_GENERATOR<int, stxxl::external, stxxl::grow_shrink2, 1, 4096>;
 
 int main(int argc, char* argv[])
 {
@@ -37,5 +42,60 @@ int main(int argc, char* argv[])
 
     delete[] my_stacks;
 
+    // many grow_shrink2 stacks whose blocks are allocated and written by a
+    // shared scheduler, filled in random order like random_shuffle's buckets
+    using gs2_stack_type = stxxl::STACK_GENERATOR<int, stxxl::external, stxxl::grow_shrink2, 1, 4096>::result;
+    using block_type = gs2_stack_type::block_type;
+
+    const size_t nstacks = static_cast<size_t>(atoi(argv[1]));
+    foxxll::read_write_pool<block_type> pool(4, 16);
+    gs2_stack_type::scheduler_type scheduler(pool, 4);
+    die_unless(scheduler.batch_blocks() == 7);
+
+    std::vector<gs2_stack_type*> stacks(nstacks);
+    for (size_t j = 0; j < nstacks; ++j)
+        stacks[j] = new gs2_stack_type(scheduler, 2);
+
+    std::mt19937 randgen;
+    std::uniform_int_distribution<size_t> distr_stack(0, nstacks - 1);
+    std::vector<std::vector<int> > expected(nstacks);
+
+    for (int i = 0; i < static_cast<int>(nstacks * 8 * block_type::size); ++i)
+    {
+        const size_t j = distr_stack(randgen);
+        stacks[j]->push(i);
+        expected[j].push_back(i);
+
+        // pop some elements again, which reads back held back blocks
+        if (i % 1000 == 999)
+        {
+            for (size_t n = 0; n < block_type::size && !expected[j].empty(); ++n)
+            {
+                die_unequal(stacks[j]->top(), expected[j].back());
+                stacks[j]->pop();
+                expected[j].pop_back();
+            }
+        }
+    }
+
+    scheduler.flush();
+    die_unless(scheduler.pending() == 0);
+
+    for (size_t j = 0; j < nstacks; ++j)
+    {
+        die_unequal(stacks[j]->size(), expected[j].size());
+        // delete half of the stacks unread, with blocks still in the pool
+        if (j % 2 == 0)
+        {
+            while (!expected[j].empty())
+            {
+                die_unequal(stacks[j]->top(), expected[j].back());
+                stacks[j]->pop();
+                expected[j].pop_back();
+            }
+        }
+        delete stacks[j];
+    }
+
     return 0;
 }
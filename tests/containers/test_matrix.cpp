@@ -11,8 +11,13 @@
  *  http://www.boost.org/LICENSE_1_0.txt)
  **************************************************************************/
 
+#include <cmath>
 #include <iostream>
 #include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
@@ -32,6 +37,7 @@ template class stxxl::const_matrix_row_major_iterator<int, 32>;
 template class stxxl::const_matrix_col_major_iterator<int, 32>;
 template class stxxl::column_vector<int>;
 template class stxxl::row_vector<int>;
+template class stxxl::matrix_multiply_plan<int, 32>;
 template struct stxxl::matrix_local::matrix_operations<int, 32>;
 /*
 
@@ -319,8 +325,9 @@ void test2(int rank, int mult_algo_num, int sched_algo_num)
     matrix_stats_before.set();
     stats_before = *foxxll::stats::get_instance();
 
+    stxxl::matrix_operation_profile profile;
     if (mult_algo_num >= 0)
-        *c = a->multiply(*b, mult_algo_num, sched_algo_num);
+        *c = a->multiply(*b, profile, mult_algo_num, sched_algo_num);
     else
         *c = a->multiply_internal(*b, sched_algo_num);
 
@@ -331,6 +338,27 @@ void test2(int rank, int mult_algo_num, int sched_algo_num)
 
     LOG1 << matrix_stats_after - matrix_stats_before;
     LOG1 << stats_after - stats_before;
+    if (mult_algo_num >= 0)
+    {
+        LOG1 << profile;
+        std::ostringstream json;
+        profile.write_json(json);
+        LOG1 << json.str();
+
+        die_unequal(profile.height, uint64_t(rank));
+        die_unequal(profile.inner, uint64_t(rank));
+        die_unequal(profile.multiplication_algorithm, mult_algo_num);
+        // all blocks of a and b are nonzero
+        die_unless(profile.blocks.block_multiplication_calls > 0);
+        die_unequal(profile.blocks.block_multiplications_saved_through_zero, 0);
+        die_unless(profile.blocks.block_acquisitions
+                   >= 3 * profile.blocks.block_multiplication_calls);
+        die_unless(profile.acquisition_hit_rate() >= 0 && profile.acquisition_hit_rate() <= 1);
+        die_unless(profile.elapsed_time >= profile.simulation_time);
+        die_unless(json.str().front() == '{' && json.str().back() == '}');
+        if (mult_algo_num == 0 || mult_algo_num == 1 || mult_algo_num == 7)
+            die_unequal(profile.strassen_winograd_levels, 0u);
+    }
     {
         size_t num_err = 0;
         for (const_row_major_iterator mit = c->cbegin(); mit != c->cend(); ++mit)
@@ -344,6 +372,530 @@ void test2(int rank, int mult_algo_num, int sched_algo_num)
     delete bs_ptr;
 }
 
+void test3(int rank, int sched_algo_num)
+{
+    LOG1 << "multiplying two full double matrices of rank " << rank << " repeatedly with a plan"
+         << ", scheduling-algo " << sched_algo_num;
+
+    using value_type = double;
+
+    using block_scheduler_type = foxxll::block_scheduler<
+              stxxl::matrix_swappable_block<value_type, block_order> >;
+    using matrix_type = stxxl::matrix<value_type, block_order>;
+    using row_major_iterator = matrix_type::row_major_iterator;
+    using const_row_major_iterator = matrix_type::const_row_major_iterator;
+
+    block_scheduler_type* bs_ptr = new block_scheduler_type(internal_memory);
+    block_scheduler_type& bs = *bs_ptr;
+    matrix_type
+    * a = new matrix_type(bs, rank, rank),
+        * b = new matrix_type(bs, rank, rank);
+
+    for (row_major_iterator mit = a->begin(); mit != a->end(); ++mit)
+        *mit = 1;
+    for (row_major_iterator mit = b->begin(); mit != b->end(); ++mit)
+        *mit = 1;
+    bs.flush();
+
+    stxxl::matrix_multiply_plan<value_type, block_order> plan;
+    for (int i = 0; i < 3; ++i)
+    {
+        matrix_type* c = new matrix_type(bs, rank, rank);
+        *c = a->multiply(*b, plan, 1, sched_algo_num);
+        die_unless(plan.recorded());
+
+        size_t num_err = 0;
+        for (const_row_major_iterator mit = c->cbegin(); mit != c->cend(); ++mit)
+            num_err += (*mit != rank);
+        die_verbose_unless(num_err == 0, "c had " << num_err << " errors");
+        delete c;
+    }
+    LOG1 << "replayed the schedule " << plan.num_replays() << " times";
+
+    delete a;
+    delete b;
+    delete bs_ptr;
+}
+
+//! compare the generic block multiplication kernel over a Semiring to the
+//! naive triple loop, for all major orders of a, b and c
+template <typename ValueType, unsigned BlockSideLength, class Semiring>
+void test_low_level_kernel()
+{
+    using kernel_type = stxxl::matrix_local::low_level_matrix_multiply_and_add<
+              ValueType, BlockSideLength, Semiring>;
+    using compute_type = typename kernel_type::compute_type;
+    const size_t n = BlockSideLength;
+
+    LOG1 << "testing low-level block multiplication of order " << n
+         << " with tiles of order " << kernel_type::tile;
+
+    std::vector<ValueType> a(n * n), b(n * n), c(n * n), expected(n * n);
+    for (int orders = 0; orders < 8; ++orders)
+    {
+        const bool a_cm = (orders & 1) != 0, b_cm = (orders & 2) != 0, c_cm = (orders & 4) != 0;
+        for (size_t i = 0; i < n * n; ++i)
+        {
+            a[i] = ValueType(i % 7);
+            b[i] = ValueType((i * 3) % 5);
+            c[i] = ValueType(i % 11);
+        }
+
+        // accumulate in the compute type, and round once
+        expected = c;
+        for (size_t i = 0; i < n; ++i)
+            for (size_t j = 0; j < n; ++j)
+            {
+                ValueType& e = expected[c_cm ? i + j * n : i * n + j];
+                compute_type sum = compute_type(e);
+                for (size_t k = 0; k < n; ++k)
+                    sum = Semiring::add(sum, Semiring::multiply(compute_type(a[a_cm ? i + k * n : i * n + k]),
+                                                                compute_type(b[b_cm ? k + j * n : k * n + j])));
+                e = ValueType(sum);
+            }
+
+        kernel_type(a.data(), a_cm, b.data(), b_cm, c.data(), c_cm);
+        for (size_t i = 0; i < n * n; ++i)
+            die_unequal(compute_type(c[i]), compute_type(expected[i]));
+    }
+}
+
+void test4()
+{
+    // 100 is no multiple of the tiles of order 64
+    test_low_level_kernel<int64_t, 100, stxxl::matrix_local::plus_times_semiring<int64_t> >();
+    test_low_level_kernel<int64_t, 100, stxxl::matrix_local::min_plus_semiring<int64_t> >();
+    test_low_level_kernel<int, 32, stxxl::matrix_local::min_plus_semiring<int> >();
+    test_low_level_kernel<float, 70, stxxl::matrix_local::min_plus_semiring<float> >();
+    // half-width storage, multiplied in float
+    test_low_level_kernel<stxxl::float16, 100, stxxl::matrix_local::plus_times_semiring<float> >();
+    test_low_level_kernel<stxxl::bfloat16, 64, stxxl::matrix_local::plus_times_semiring<float> >();
+    test_low_level_kernel<stxxl::float16, 32, stxxl::matrix_local::min_plus_semiring<float> >();
+}
+
+void test5(int rank)
+{
+    LOG1 << "importing, exporting and transposing an int matrix of size "
+         << rank << " x " << rank + 13;
+
+    using value_type = int;
+
+    using block_scheduler_type = foxxll::block_scheduler<
+              stxxl::matrix_swappable_block<value_type, block_order> >;
+    using matrix_type = stxxl::matrix<value_type, block_order>;
+    using const_row_major_iterator = matrix_type::const_row_major_iterator;
+    using vector_type = stxxl::vector<value_type>;
+
+    const size_t height = rank, width = rank + 13;
+
+    block_scheduler_type* bs_ptr = new block_scheduler_type(internal_memory);
+    block_scheduler_type& bs = *bs_ptr;
+    matrix_type
+    * a = new matrix_type(bs, height, width),
+        * b = new matrix_type(bs, height, width);
+
+    vector_type elements(height * width);
+    for (size_t i = 0; i < elements.size(); ++i)
+        elements[i] = static_cast<value_type>(i);
+
+    {
+        auto input = stxxl::stream::streamify(elements.cbegin(), elements.cend());
+        a->import_row_major(input);
+    }
+    {
+        // element i in column-major order is (i % height, i / height)
+        auto input = stxxl::stream::streamify(elements.cbegin(), elements.cend());
+        b->import_col_major(input);
+    }
+
+    size_t index = 0;
+    for (const_row_major_iterator mit = a->cbegin(); mit != a->cend(); ++mit, ++index)
+        die_unequal(*mit, static_cast<value_type>(index));
+
+    // export in column-major
+    vector_type exported(height * width);
+    {
+        matrix_type::stream output(*a, true);
+        die_unequal(output.size(), height * width);
+        stxxl::stream::materialize(output, exported.begin(), exported.end());
+    }
+    for (size_t i = 0; i < exported.size(); ++i)
+        die_unequal(exported[i], static_cast<value_type>((i % height) * width + i / height));
+
+    {
+        // b has the elements in column-major, so its transpose in row-major
+        matrix_type t = b->transposed_copy();
+        die_unequal(t.get_height(), width);
+        die_unequal(t.get_width(), height);
+        index = 0;
+        for (matrix_type::stream output(t); !output.empty(); ++output, ++index)
+            die_unequal(*output, static_cast<value_type>(index));
+    }
+    {
+        // materializing the transpose of a lazily transposed matrix
+        a->transpose();
+        matrix_type u = a->transposed_copy();
+        index = 0;
+        for (matrix_type::stream output(u); !output.empty(); ++output, ++index)
+            die_unequal(*output, static_cast<value_type>(index));
+    }
+
+    delete a;
+    delete b;
+    delete bs_ptr;
+}
+
+void test6(int rank, int sched_algo_num)
+{
+    LOG1 << "multiplying an int matrix of size " << rank << " x " << rank + 13
+         << " with streamed vectors, scheduling-algo " << sched_algo_num;
+
+    using value_type = int;
+
+    using block_scheduler_type = foxxll::block_scheduler<
+              stxxl::matrix_swappable_block<value_type, block_order> >;
+    using matrix_type = stxxl::matrix<value_type, block_order>;
+    using row_major_iterator = matrix_type::row_major_iterator;
+    using column_vector_type = matrix_type::column_vector_type;
+    using row_vector_type = matrix_type::row_vector_type;
+
+    const size_t height = rank, width = rank + 13;
+
+    block_scheduler_type* bs_ptr = new block_scheduler_type(internal_memory);
+    block_scheduler_type& bs = *bs_ptr;
+    matrix_type* a = new matrix_type(bs, height, width);
+
+    // the last row of blocks stays zero
+    size_t index = 0;
+    for (row_major_iterator mit = a->begin(); mit != a->end(); ++mit, ++index)
+        *mit = (index / width < height - height % block_order) ? int(index % 7) - 3 : 0;
+    bs.flush();
+
+    column_vector_type x(width);
+    for (size_t i = 0; i < width; ++i)
+        x[i] = int(i % 5);
+    row_vector_type y(height);
+    for (size_t i = 0; i < height; ++i)
+        y[i] = int(i % 3) - 1;
+
+    for (int transposed = 0; transposed < 2; ++transposed)
+    {
+        column_vector_type z = a->multiply_streaming(x, sched_algo_num), z_expected = *a * x;
+        row_vector_type w = a->multiply_from_left_streaming(y, sched_algo_num), w_expected = a->multiply_from_left(y);
+        die_unequal(z.size(), z_expected.size());
+        for (size_t i = 0; i < z.size(); ++i)
+            die_unequal(z[i], z_expected[i]);
+        die_unequal(w.size(), w_expected.size());
+        for (size_t i = 0; i < w.size(); ++i)
+            die_unequal(w[i], w_expected[i]);
+
+        // the same matrix with the elements in its blocks in column-major
+        *a = a->transposed_copy();
+        a->transpose();
+    }
+
+    delete a;
+    delete bs_ptr;
+}
+
+void test7(int rank)
+{
+    LOG1 << "choosing the multiplication algorithm for double matrices of rank " << rank;
+
+    using value_type = double;
+
+    using block_scheduler_type = foxxll::block_scheduler<
+              stxxl::matrix_swappable_block<value_type, block_order> >;
+    using matrix_type = stxxl::matrix<value_type, block_order>;
+    using calibration_type = stxxl::matrix_multiply_calibration<value_type, block_order>;
+    using row_major_iterator = matrix_type::row_major_iterator;
+    using const_row_major_iterator = matrix_type::const_row_major_iterator;
+
+    // with free additions and I/Os, Strassen-Winograd recurses down to
+    // single blocks, with expensive additions it does not pay off
+    calibration_type model;
+    model.block_multiplication_time = 1e-3;
+    model.block_addition_time = 0;
+    model.block_io_time = 0;
+    stxxl::matrix_multiply_choice choice = model.choose(64, 64, 64, internal_memory);
+    die_unequal(choice.multiplication_algorithm, 4);
+    die_unequal(choice.strassen_winograd_base_case_size, 1u);
+    die_unequal(choice.strassen_winograd_levels, 6u);
+    model.block_addition_time = 4 * model.block_multiplication_time;
+    choice = model.choose(64, 64, 64, internal_memory);
+    die_unequal(choice.multiplication_algorithm, 1);
+    die_unequal(choice.strassen_winograd_levels, 0u);
+
+    const calibration_type& calibration = calibration_type::get();
+    LOG1 << "block multiplication " << calibration.block_multiplication_time
+         << " s, block addition " << calibration.block_addition_time
+         << " s, block I/O " << calibration.block_io_time << " s";
+    die_unless(&calibration == &calibration_type::get());
+
+    block_scheduler_type* bs_ptr = new block_scheduler_type(internal_memory);
+    block_scheduler_type& bs = *bs_ptr;
+    {
+        matrix_type a(bs, rank, rank), b(bs, rank, rank);
+        for (row_major_iterator mit = a.begin(); mit != a.end(); ++mit)
+            *mit = 1;
+        for (row_major_iterator mit = b.begin(); mit != b.end(); ++mit)
+            *mit = 1;
+
+        choice = a.choose_multiplication(b, internal_memory);
+        LOG1 << "chose multiplication-algo " << choice.multiplication_algorithm
+             << ", base case " << choice.strassen_winograd_base_case_size
+             << ", estimated " << choice.estimated_time << " s";
+
+        stxxl::matrix_operation_profile profile;
+        matrix_type c = a.multiply_auto(b, internal_memory, profile);
+        die_unequal(profile.multiplication_algorithm, choice.multiplication_algorithm);
+        die_unequal(profile.strassen_winograd_levels, choice.strassen_winograd_levels);
+        LOG1 << "took " << profile.elapsed_time << " s";
+
+        size_t num_err = 0;
+        for (const_row_major_iterator mit = c.cbegin(); mit != c.cend(); ++mit)
+            num_err += (*mit != rank);
+        die_verbose_unless(num_err == 0, "c had " << num_err << " errors");
+    }
+    delete bs_ptr;
+}
+
+void test8(int rank)
+{
+    LOG1 << "evaluating expressions of double matrices of rank " << rank;
+
+    using value_type = double;
+
+    using block_scheduler_type = foxxll::block_scheduler<
+              stxxl::matrix_swappable_block<value_type, block_order> >;
+    using matrix_type = stxxl::matrix<value_type, block_order>;
+    using row_major_iterator = matrix_type::row_major_iterator;
+    using const_row_major_iterator = matrix_type::const_row_major_iterator;
+
+    const size_t n = rank;
+    std::vector<value_type> va(n * n), vb(n * n), vc(n * n);
+    for (size_t i = 0; i < n * n; ++i)
+    {
+        va[i] = value_type(int(i % 7) - 3);
+        vb[i] = value_type(int(i % 5));
+        vc[i] = value_type(int(i % 3) - 1);
+    }
+    // the product of the row-major elements
+    auto product = [n](const std::vector<value_type>& l, const std::vector<value_type>& r) {
+                       std::vector<value_type> res(n * n, 0);
+                       for (size_t i = 0; i < n; ++i)
+                           for (size_t k = 0; k < n; ++k)
+                               for (size_t j = 0; j < n; ++j)
+                                   res[i * n + j] += l[i * n + k] * r[k * n + j];
+                       return res;
+                   };
+    const std::vector<value_type> vab = product(va, vb);
+
+    block_scheduler_type* bs_ptr = new block_scheduler_type(internal_memory);
+    block_scheduler_type& bs = *bs_ptr;
+    {
+        matrix_type a(bs, n, n), b(bs, n, n), c(bs, n, n);
+        size_t i = 0;
+        for (row_major_iterator mit = a.begin(); mit != a.end(); ++mit, ++i)
+            *mit = va[i];
+        i = 0;
+        for (row_major_iterator mit = b.begin(); mit != b.end(); ++mit, ++i)
+            *mit = vb[i];
+        i = 0;
+        for (row_major_iterator mit = c.begin(); mit != c.end(); ++mit, ++i)
+            *mit = vc[i];
+
+        auto check = [&](const matrix_type& m, const std::vector<value_type>& expected) {
+                         size_t num_err = 0, k = 0;
+                         for (const_row_major_iterator mit = m.cbegin(); mit != m.cend(); ++mit, ++k)
+                             num_err += (*mit != expected[k]);
+                         die_verbose_unless(num_err == 0, "had " << num_err << " errors");
+                     };
+
+        std::vector<value_type> expected(n * n);
+
+        // element-wise terms in one sweep
+        matrix_type d = 2 * a - b + c * 3 - (-a);
+        for (size_t k = 0; k < n * n; ++k)
+            expected[k] = 3 * va[k] - vb[k] + 3 * vc[k];
+        check(d, expected);
+
+        // a product folded into the multiply-and-add, and a scaled product
+        d = a * b + c;
+        for (size_t k = 0; k < n * n; ++k)
+            expected[k] = vab[k] + vc[k];
+        check(d, expected);
+
+        d = c - 2 * (a * b);
+        for (size_t k = 0; k < n * n; ++k)
+            expected[k] = vc[k] - 2 * vab[k];
+        check(d, expected);
+
+        // the operands of a product being expressions
+        d = (a + b) * (b - c);
+        {
+            std::vector<value_type> l(n * n), r(n * n);
+            for (size_t k = 0; k < n * n; ++k)
+                l[k] = va[k] + vb[k], r[k] = vb[k] - vc[k];
+            expected = product(l, r);
+        }
+        check(d, expected);
+
+        // adding into a matrix, and into one of the operands
+        d = c;
+        d += a * b;
+        d -= a - b;
+        for (size_t k = 0; k < n * n; ++k)
+            expected[k] = vc[k] + vab[k] - va[k] + vb[k];
+        check(d, expected);
+        check(c, vc);
+
+        c += c * b;
+        expected = product(vc, vb);
+        for (size_t k = 0; k < n * n; ++k)
+            expected[k] += vc[k];
+        check(c, expected);
+
+        a = a * b;
+        check(a, vab);
+    }
+    delete bs_ptr;
+}
+
+void test9(int rank, int sched_algo_num)
+{
+    LOG1 << "factoring double matrices of rank " << rank << " with scheduling-algo " << sched_algo_num;
+
+    using value_type = double;
+
+    using block_scheduler_type = foxxll::block_scheduler<
+              stxxl::matrix_swappable_block<value_type, block_order> >;
+    using matrix_type = stxxl::matrix<value_type, block_order>;
+    using column_vector_type = matrix_type::column_vector_type;
+    using row_major_iterator = matrix_type::row_major_iterator;
+    using const_row_major_iterator = matrix_type::const_row_major_iterator;
+
+    const size_t n = rank;
+    std::mt19937_64 rng(rank);
+    std::uniform_real_distribution<value_type> uniform(-1, 1);
+
+    // a symmetric positive definite and a general matrix
+    std::vector<value_type> m(n * n), spd(n * n, 0), general(n * n);
+    for (size_t i = 0; i < n * n; ++i)
+        m[i] = uniform(rng), general[i] = uniform(rng);
+    for (size_t i = 0; i < n; ++i)
+    {
+        spd[i * n + i] = value_type(n);
+        for (size_t j = 0; j < n; ++j)
+            for (size_t k = 0; k < n; ++k)
+                spd[i * n + j] += m[i * n + k] * m[j * n + k];
+    }
+    std::vector<value_type> x0(n);
+    for (size_t i = 0; i < n; ++i)
+        x0[i] = value_type(int(i % 7) - 3);
+
+    auto import = [](matrix_type& a, const std::vector<value_type>& v) {
+                      size_t k = 0;
+                      for (row_major_iterator mit = a.begin(); mit != a.end(); ++mit, ++k)
+                          *mit = v[k];
+                  };
+    auto export_ = [](const matrix_type& a) {
+                       std::vector<value_type> v;
+                       for (const_row_major_iterator mit = a.cbegin(); mit != a.cend(); ++mit)
+                           v.push_back(*mit);
+                       return v;
+                   };
+    // b = v * x0
+    auto multiply = [n, &x0](const std::vector<value_type>& v) {
+                        column_vector_type b(n);
+                        for (size_t i = 0; i < n; ++i)
+                        {
+                            value_type s = 0;
+                            for (size_t k = 0; k < n; ++k)
+                                s += v[i * n + k] * x0[k];
+                            b[i] = s;
+                        }
+                        return b;
+                    };
+    auto check_solution = [n, &x0](const column_vector_type& x) {
+                              die_unequal(x.size(), n);
+                              for (size_t i = 0; i < n; ++i)
+                                  die_unless(std::abs(x[i] - x0[i]) < 1e-6);
+                          };
+
+    block_scheduler_type* bs_ptr = new block_scheduler_type(internal_memory);
+    block_scheduler_type& bs = *bs_ptr;
+    {
+        matrix_type a(bs, n, n);
+        import(a, spd);
+
+        // L * L^T = A with L lower triangular
+        matrix_type l = a.cholesky(sched_algo_num);
+        const std::vector<value_type> lv = export_(l);
+        for (size_t i = 0; i < n; ++i)
+        {
+            die_unless(lv[i * n + i] > 0);
+            for (size_t j = 0; j < n; ++j)
+            {
+                value_type s = 0;
+                for (size_t k = 0; k < n; ++k)
+                    s += lv[i * n + k] * lv[j * n + k];
+                die_unless(std::abs(s - spd[i * n + j]) < 1e-9 * n);
+                if (j > i)
+                    die_unequal(lv[i * n + j], 0.0);
+            }
+        }
+        check_solution(l.cholesky_solve(multiply(spd)));
+
+        // P * A = L * U
+        import(a, general);
+        std::vector<size_t> pivots;
+        matrix_type lu = a.lu(pivots, sched_algo_num);
+        die_unequal(pivots.size(), n);
+        std::vector<value_type> pa = general;
+        for (size_t r = 0; r < n; ++r)
+        {
+            die_unless(pivots[r] >= r && pivots[r] < n);
+            for (size_t j = 0; j < n; ++j)
+                std::swap(pa[r * n + j], pa[pivots[r] * n + j]);
+        }
+        const std::vector<value_type> luv = export_(lu);
+        for (size_t i = 0; i < n; ++i)
+            for (size_t j = 0; j < n; ++j)
+            {
+                // L has a unit diagonal, and partial pivoting bounds it by one
+                value_type s = (i <= j) ? luv[i * n + j] : 0;
+                for (size_t k = 0; k < std::min(i, j + 1); ++k)
+                {
+                    die_unless(std::abs(luv[i * n + k]) <= 1);
+                    s += luv[i * n + k] * luv[k * n + j];
+                }
+                die_unless(std::abs(s - pa[i * n + j]) < 1e-9 * n);
+            }
+        check_solution(lu.lu_solve(pivots, multiply(general)));
+
+        // not positive definite and singular
+        a.set_zero();
+        bool thrown = false;
+        try {
+            a.cholesky(sched_algo_num);
+        }
+        catch (const std::domain_error&) {
+            thrown = true;
+        }
+        die_unless(thrown || n == 0);
+        thrown = false;
+        try {
+            a.lu(pivots, sched_algo_num);
+        }
+        catch (const std::domain_error&) {
+            thrown = true;
+        }
+        die_unless(thrown || n == 0);
+    }
+    delete bs_ptr;
+}
+
 int main(int argc, char** argv)
 {
     int test_case = -1;
@@ -358,7 +910,7 @@ int main(int argc, char** argv)
 
     cp.add_opt_param_int(
         "K", test_case,
-        "number of the test case to run: 1 or 2, or by default: all");
+        "number of the test case to run: 1 to 9, or by default: all");
 
     cp.add_int('r', "rank", "<N>", rank,
                "rank of the matrices, default: 500");
@@ -376,6 +928,7 @@ int main(int argc, char** argv)
                "   4: strassen_winograd_multiply (block-interleaved pre- and postadditions)\n"
                "   5: strassen_winograd_multiply_and_add_interleaved (block-interleaved preadditions)\n"
                "   6: multi_level_strassen_winograd_multiply_and_add_block_grained\n"
+               "   7: parallel_recursive_multiply_and_add (online LRU scheduling)\n"
                "  default: 2");
 
     cp.add_int('s', "scheduling-algo", "<N>", sched_algo_num,
@@ -396,13 +949,23 @@ int main(int argc, char** argv)
     default:
         test1(rank);
 
-        for (int mult_algo = 0; mult_algo <= 6; ++mult_algo)
+        for (int mult_algo = 0; mult_algo <= 7; ++mult_algo)
         {
             for (int sched_algo = 0; sched_algo <= 2; ++sched_algo)
             {
                 test2(rank, mult_algo, sched_algo);
             }
         }
+        test3(rank, 1);
+        test3(rank, 2);
+        test4();
+        test5(rank);
+        for (int sched_algo = 0; sched_algo <= 2; ++sched_algo)
+            test6(rank, sched_algo);
+        test7(rank);
+        test8(rank);
+        for (int sched_algo = 0; sched_algo <= 2; ++sched_algo)
+            test9(rank, sched_algo);
         break;
     case 1:
         test1(rank);
@@ -410,6 +973,27 @@ int main(int argc, char** argv)
     case 2:
         test2(rank, mult_algo_num, sched_algo_num);
         break;
+    case 3:
+        test3(rank, sched_algo_num);
+        break;
+    case 4:
+        test4();
+        break;
+    case 5:
+        test5(rank);
+        break;
+    case 6:
+        test6(rank, sched_algo_num);
+        break;
+    case 7:
+        test7(rank);
+        break;
+    case 8:
+        test8(rank);
+        break;
+    case 9:
+        test9(rank, sched_algo_num);
+        break;
     }
 
     LOG1 << "end of test";
@@ -0,0 +1,155 @@
+/***************************************************************************
+ *  tests/containers/test_migrating.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/migrating>
+#include <stxxl/queue>
+#include <stxxl/sorter>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+
+struct my_cmp : public std::less<value_type>
+{
+    value_type min_value() const { return std::numeric_limits<value_type>::min(); }
+    value_type max_value() const { return std::numeric_limits<value_type>::max(); }
+};
+
+constexpr size_t crit_size = 10000;
+
+void test_vector(size_t n)
+{
+    using ext_vector_type = stxxl::VECTOR_GENERATOR<value_type>::result;
+    stxxl::migrating_vector<crit_size, ext_vector_type> vector;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        vector.push_back(i);
+        die_unequal(vector.internal(), vector.size() < crit_size);
+    }
+    die_unequal(vector.size(), n);
+    for (size_t i = 0; i < n; ++i)
+        die_unequal(vector[i], i);
+
+    if (n > 0)
+    {
+        vector.back() = 42;
+        die_unequal(vector[n - 1], 42u);
+        vector.pop_back();
+        die_unequal(vector.size(), n - 1);
+    }
+
+    vector.resize(2 * crit_size);
+    die_unless(vector.external());
+    die_unequal(vector.migrate().size(), 2 * crit_size);
+
+    vector.clear();
+    die_unless(vector.internal() && vector.empty());
+}
+
+void test_queue(size_t n)
+{
+    using ext_queue_type = stxxl::queue<value_type>;
+    stxxl::migrating_queue<crit_size, ext_queue_type> queue;
+    std::deque<value_type> check;
+    size_t max_size = 0;
+
+    std::mt19937 randgen;
+    std::uniform_int_distribution<int> distr_op(0, 2);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (distr_op(randgen) > 0 || check.empty())
+        {
+            queue.push(i);
+            check.push_back(i);
+            max_size = std::max(max_size, check.size());
+        }
+        else
+        {
+            die_unequal(queue.front(), check.front());
+            queue.pop();
+            check.pop_front();
+        }
+
+        die_unequal(queue.size(), check.size());
+        if (!check.empty())
+            die_unequal(queue.back(), check.back());
+    }
+
+    die_unequal(queue.external(), max_size >= crit_size);
+
+    while (!check.empty())
+    {
+        die_unequal(queue.front(), check.front());
+        queue.pop();
+        check.pop_front();
+    }
+    die_unless(queue.empty());
+}
+
+void test_sorter(size_t n)
+{
+    using ext_sorter_type = stxxl::sorter<value_type, my_cmp>;
+    stxxl::migrating_sorter<crit_size, ext_sorter_type> sorter(my_cmp(), 64 * 1024 * 1024);
+
+    std::mt19937_64 randgen;
+    std::vector<value_type> check;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const value_type v = randgen();
+        sorter.push(v);
+        check.push_back(v);
+    }
+    die_unequal(sorter.internal(), n < crit_size);
+    die_unequal(sorter.size(), n);
+
+    std::sort(check.begin(), check.end());
+    sorter.sort();
+
+    for (size_t pass = 0; pass < 2; ++pass)
+    {
+        for (const value_type& v : check)
+        {
+            die_unless(!sorter.empty());
+            die_unequal(*sorter, v);
+            ++sorter;
+        }
+        die_unless(sorter.empty());
+        sorter.rewind();
+    }
+
+    sorter.clear();
+    die_unless(sorter.internal());
+    sorter.push(1);
+    sorter.sort();
+    die_unequal(*sorter, 1u);
+}
+
+int main()
+{
+    for (size_t n : { size_t(0), size_t(100), crit_size - 1, crit_size, 5 * crit_size })
+    {
+        LOG1 << "migrating containers with " << n << " items";
+        test_vector(n);
+        test_queue(n);
+        test_sorter(n);
+    }
+
+    return 0;
+}
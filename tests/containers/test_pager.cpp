@@ -0,0 +1,124 @@
+/***************************************************************************
+ *  tests/containers/test_pager.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/containers/pager.h>
+
+//! A cache of page ids managed by a pager, counting the misses.
+template <typename PagerType>
+class page_cache
+{
+    static constexpr size_t none = size_t(-1);
+
+    PagerType m_pager;
+    std::vector<size_t> m_slot_to_id;
+    size_t m_used = 0;
+
+public:
+    size_t misses = 0;
+
+    explicit page_cache(size_t npages)
+        : m_pager(npages), m_slot_to_id(npages, size_t(none)) { }
+
+    void access(size_t id)
+    {
+        for (size_t slot = 0; slot < m_slot_to_id.size(); ++slot)
+        {
+            if (m_slot_to_id[slot] == id)
+            {
+                m_pager.hit(slot);
+                return;
+            }
+        }
+
+        ++misses;
+        size_t slot = m_used;
+        if (m_used < m_slot_to_id.size())
+        {
+            ++m_used;
+        }
+        else
+        {
+            // the victim is kept until it is loaded
+            slot = m_pager.kick();
+            die_unless(slot < m_slot_to_id.size());
+            die_unless(m_pager.kick() == slot);
+        }
+        m_slot_to_id[slot] = id;
+        stxxl::pager_load(m_pager, slot, id);
+    }
+};
+
+//! Misses on a working set after a scan, which follows a phase of accesses to
+//! the working set interleaved with random other pages.
+template <typename PagerType>
+size_t misses_after_scan()
+{
+    const size_t npages = 16, working_set = 4;
+    page_cache<PagerType> cache(npages);
+    std::mt19937_64 randgen(42);
+
+    for (size_t i = 0; i < 4000; ++i)
+    {
+        cache.access(i % working_set);
+        cache.access(1000 + randgen() % 10000);
+    }
+
+    for (size_t i = 0; i < 256; ++i)
+    {
+        // a scan touches each page repeatedly
+        cache.access(100000 + i);
+        cache.access(100000 + i);
+    }
+
+    const size_t misses = cache.misses;
+    for (size_t i = 0; i < working_set; ++i)
+        cache.access(i);
+    return cache.misses - misses;
+}
+
+//! Misses of random accesses with a skewed distribution.
+template <typename PagerType>
+size_t skewed_misses()
+{
+    page_cache<PagerType> cache(32);
+    std::mt19937_64 randgen(7);
+    std::geometric_distribution<size_t> distr(0.05);
+
+    for (size_t i = 0; i < 100000; ++i)
+        cache.access(distr(randgen));
+    return cache.misses;
+}
+
+int main()
+{
+    const size_t lru = misses_after_scan<stxxl::lru_pager<> >();
+    const size_t clock = misses_after_scan<stxxl::clock_pager<> >();
+    const size_t two_queue = misses_after_scan<stxxl::two_queue_pager<> >();
+
+    LOG1 << "misses on the working set after a scan: lru " << lru
+         << " clock " << clock << " 2q " << two_queue;
+
+    die_unless(lru == 4);
+    die_unless(two_queue == 0);
+
+    LOG1 << "misses of skewed accesses:"
+         << " random " << skewed_misses<stxxl::random_pager<32> >()
+         << " lru " << skewed_misses<stxxl::lru_pager<> >()
+         << " clock " << skewed_misses<stxxl::clock_pager<> >()
+         << " 2q " << skewed_misses<stxxl::two_queue_pager<> >();
+
+    return 0;
+}
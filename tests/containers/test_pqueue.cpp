@@ -18,8 +18,11 @@
 //! This is an example of how to use \c stxxl::PRIORITY_QUEUE_GENERATOR
 //! and \c stxxl::priority_queue
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <limits>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
@@ -119,6 +122,113 @@ int main()
 
     LOG1 << "Internal memory consumption of the priority queue: " << p.mem_cons() << " B";
 
+    {
+        scoped_print_timer timer("Bulk filling and emptying PQ",
+                                 nelements * sizeof(my_type));
+
+        // bursts of descending keys, alternating large and small batches
+        std::vector<my_type> batch;
+        size_t pushed = 0;
+        for (size_t burst = 0; pushed < nelements; ++burst)
+        {
+            const size_t burst_size = std::min<size_t>(
+                burst % 2 ? 7 : 3 * gen::N + 5, nelements - pushed);
+            batch.clear();
+            for (size_t i = 0; i < burst_size; ++i)
+                batch.push_back(my_type(int(nelements - pushed - i)));
+            std::reverse(batch.begin(), batch.end());
+            p.push(batch.begin(), batch.end());
+            pushed += burst_size;
+        }
+
+        die_unless(p.size() == nelements);
+
+        std::vector<my_type> out;
+        size_t popped = 0;
+        while (!p.empty())
+        {
+            out.clear();
+            const size_t n = p.pop_bulk(std::back_inserter(out), 1000);
+            die_unless(n == out.size());
+            for (size_t i = 0; i < n; ++i)
+                die_unless(out[i].key == int(popped + i + 1));
+            popped += n;
+        }
+
+        die_unless(popped == nelements);
+        die_unless(p.pop_bulk(std::back_inserter(out), 1) == 0);
+    }
+
+    {
+        scoped_print_timer timer("Spilling PQ",
+                                 nelements / 4 * sizeof(my_type));
+
+        // p is busy while q stays idle, so rebalance() spills q
+        pq_type q(pool, comp_without_def_construct { 1 });
+        stxxl::priority_queue_memory_manager manager(64 * 1024 * 1024);
+        manager.add(p);
+        manager.add(q);
+
+        const size_t n = nelements / 4;
+        for (size_t i = 0; i < n; ++i)
+            q.push(my_type(int(n - i)));
+
+        manager.rebalance();
+        for (size_t i = 0; i < n; ++i)
+            p.push(my_type(int(n - i)));
+
+        const size_t mem_before = q.mem_cons();
+        die_unless(manager.rebalance() == 1);
+        LOG1 << "Internal memory consumption of the idle priority queue: "
+             << mem_before << " B before and " << q.mem_cons() << " B after spilling";
+        die_unless(q.mem_cons() < mem_before);
+
+        // spilling a busy queue keeps its elements
+        p.spill();
+        die_unless(p.size() == n && q.size() == n);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            die_unless(p.top().key == int(i + 1));
+            die_unless(q.top().key == int(i + 1));
+            p.pop();
+            q.pop();
+        }
+        die_unless(p.empty() && q.empty());
+
+        manager.remove(p);
+        manager.remove(q);
+        die_unless(manager.size() == 0);
+    }
+
+    {
+        scoped_print_timer timer("Bounded PQ",
+                                 nelements * sizeof(my_type));
+
+        // keep the smallest keys of a permutation, most pushes are dropped
+        const size_t bound = 3 * gen::N + 5;
+        pq_type q(pool, comp_without_def_construct { 1 });
+        q.set_bound(bound);
+        for (size_t i = 0; i < nelements; ++i)
+            q.push(my_type(int((i * 7919) % nelements + 1)));
+
+        die_unless(q.size() == bound);
+        for (size_t i = 0; i < bound / 2; ++i)
+        {
+            die_unless(q.top().key == int(i + 1));
+            q.pop();
+        }
+
+        // pushes count against the remaining bound
+        q.push(my_type(1));
+        std::vector<my_type> out;
+        die_unless(q.pop_bulk(std::back_inserter(out), bound) == bound - bound / 2);
+        die_unless(out.front().key == 1);
+        for (size_t i = 1; i < out.size(); ++i)
+            die_unless(out[i].key == int(bound / 2 + i));
+        die_unless(q.empty());
+    }
+
     std::cout << foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
 
     return 0;
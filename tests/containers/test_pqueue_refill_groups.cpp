@@ -0,0 +1,109 @@
+/***************************************************************************
+ *  tests/containers/test_pqueue_refill_groups.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+// built with STXXL_PARALLEL_PQ_REFILL_GROUPS=1, see CMakeLists.txt
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/bits/common/task_runtime.h>
+#include <stxxl/priority_queue>
+
+struct my_type
+{
+    uint32_t key, id;
+};
+
+struct my_cmp
+{
+    bool operator () (const my_type& a, const my_type& b) const
+    {
+        return a.key > b.key;
+    }
+
+    my_type min_value() const
+    {
+        return my_type { std::numeric_limits<uint32_t>::max(), 0 };
+    }
+};
+
+constexpr size_t max_items = 4 * 1024 * 1024;
+constexpr size_t mem_for_queue = 1024 * 1024;
+
+using pq_type = stxxl::PRIORITY_QUEUE_GENERATOR<
+          my_type, my_cmp, mem_for_queue, max_items / 1024>::result;
+using block_type = pq_type::block_type;
+
+//! Push n elements with many equal keys, filling the internal and external
+//! groups, and pop them all.
+std::vector<my_type> push_pop(size_t n)
+{
+    foxxll::read_write_pool<block_type> pool(16, 16);
+    pq_type pq(pool);
+
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < n; ++i)
+        pq.push(my_type { uint32_t(rng() % (n / 8)), uint32_t(i) });
+    die_unequal(pq.size(), n);
+
+    std::vector<my_type> out;
+    out.reserve(n);
+    while (!pq.empty())
+    {
+        out.push_back(pq.top());
+        pq.pop();
+    }
+    return out;
+}
+
+int main()
+{
+    const size_t n = max_items;
+    LOG1 << "Max threads: " << stxxl::task_runtime::get_instance().max_threads();
+
+    LOG1 << "Refilling the groups concurrently";
+    const std::vector<my_type> concurrent = push_pop(n);
+
+    // on one thread the groups are refilled one after another, as on the
+    // sequential path
+    LOG1 << "Refilling the groups one after another";
+    stxxl::task_runtime::get_instance().set_executor(
+        [](stxxl::task_type task) { task(); }, 1);
+    const std::vector<my_type> sequential = push_pop(n);
+    stxxl::task_runtime::get_instance().set_executor(nullptr);
+
+    // the keys are sorted, each element is popped once, and the elements of
+    // equal keys come in the same order on both paths
+    die_unequal(concurrent.size(), n);
+    die_unequal(sequential.size(), n);
+    std::vector<bool> seen(n, false);
+    for (size_t i = 0; i < n; ++i)
+    {
+        die_unless(i == 0 || concurrent[i - 1].key <= concurrent[i].key);
+        die_unless(!seen[concurrent[i].id]);
+        seen[concurrent[i].id] = true;
+
+        die_unequal(concurrent[i].key, sequential[i].key);
+        die_unequal(concurrent[i].id, sequential[i].id);
+    }
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
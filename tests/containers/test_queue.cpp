@@ -18,6 +18,7 @@
 
 #include <queue>
 #include <random>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
@@ -164,6 +165,72 @@ int main()
         }
     }
 
+    LOG1 << "Testing bulk push and pop";
+    {
+        stxxl::queue<my_type> xqueue2(3, 2, -1);
+        std::queue<my_type> squeue2;
+        std::uniform_int_distribution<size_t> distr_n(0, 3 * stxxl::queue<my_type>::block_type::size);
+        std::vector<my_type> values;
+
+        for (cnt = 0; cnt < 200; ++cnt)
+        {
+            if (distr02(randgen) > 0 || squeue2.empty())
+            {
+                values.resize(distr_n(randgen));
+                for (my_type& val : values)
+                {
+                    val = distr(randgen);
+                    squeue2.push(val);
+                }
+                xqueue2.push(values.begin(), values.end());
+            }
+            else
+            {
+                values.resize(std::min<size_t>(distr_n(randgen), squeue2.size()));
+                die_unless(xqueue2.pop(values.begin(), values.size()) == values.end());
+                for (const my_type& val : values)
+                {
+                    die_unless(val == squeue2.front());
+                    squeue2.pop();
+                }
+            }
+            check(xqueue2, squeue2);
+        }
+
+        values.resize(squeue2.size());
+        xqueue2.pop(values.begin(), values.size());
+        die_unless(xqueue2.empty());
+    }
+
+    LOG1 << "Testing adaptive prefetching with a shared pool";
+    {
+        foxxll::read_write_pool<block_type> shared_pool(4, 6);
+        stxxl::queue<my_type> xqueue3(shared_pool), xqueue4(shared_pool);
+        xqueue3.set_prefetch_aggr_auto();
+        xqueue4.set_prefetch_aggr_auto(2);
+        die_unless(xqueue3.get_prefetch_aggr_auto());
+
+        const my_type n = 20 * stxxl::queue<my_type>::block_type::size;
+        for (my_type i = 0; i < n; ++i)
+        {
+            xqueue3.push(i);
+            xqueue4.push(n - i);
+        }
+        for (my_type i = 0; i < n; ++i)
+        {
+            die_unless(xqueue3.front() == i);
+            die_unless(xqueue4.front() == n - i);
+            xqueue3.pop();
+            xqueue4.pop();
+            die_unless(xqueue3.get_prefetch_aggr() >= 1 && xqueue3.get_prefetch_aggr() <= 4);
+            die_unless(xqueue4.get_prefetch_aggr() >= 1 && xqueue4.get_prefetch_aggr() <= 2);
+        }
+        die_unless(xqueue3.empty() && xqueue4.empty());
+
+        xqueue3.set_prefetch_aggr(1);
+        die_unless(!xqueue3.get_prefetch_aggr_auto());
+    }
+
     {
         // test proper destruction of a single-block queue
         stxxl::queue<int> q;
@@ -0,0 +1,172 @@
+/***************************************************************************
+ *  tests/containers/test_queue_file.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_queue_file.cpp
+//! Test \c stxxl::queue backed by a named file
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+
+#include <stxxl/queue>
+
+using value_type = uint64_t;
+using queue_type = stxxl::queue<value_type, 4096>;
+
+const size_t block_items = queue_type::block_type::size;
+
+std::string file_type, file_name;
+
+foxxll::file_ptr open_file(int flags = 0)
+{
+    return foxxll::create_file(
+        file_type, file_name, flags | foxxll::file::DIRECT | foxxll::file::RDWR);
+}
+
+//! pops n values, which must be next, next + 1, ...
+void pop_values(queue_type& q, uint64_t& next, size_t n)
+{
+    for (size_t i = 0; i < n; ++i, ++next)
+    {
+        die_unequal(q.front(), next);
+        q.pop();
+    }
+}
+
+//! a queue which is closed is reopened unchanged
+void test_reopen()
+{
+    LOG1 << "reopen a closed queue";
+
+    uint64_t pushed = 0, popped = 0;
+    {
+        queue_type q(open_file(foxxll::file::CREAT | foxxll::file::TRUNC));
+        die_unless(q.empty());
+        for ( ; pushed < 10 * block_items + 17; ++pushed)
+            q.push(pushed);
+        pop_values(q, popped, 3 * block_items + 5);
+    }
+    for (size_t round = 0; round < 4; ++round)
+    {
+        queue_type q(open_file());
+        die_unequal(q.size(), pushed - popped);
+        die_unequal(q.back(), pushed - 1);
+        pop_values(q, popped, 2 * block_items + round);
+        for (size_t i = 0; i < block_items + 3; ++i)
+            q.push(pushed++);
+    }
+    {
+        queue_type q(open_file());
+        pop_values(q, popped, static_cast<size_t>(q.size()));
+        die_unless(q.empty());
+    }
+    {
+        // an empty queue is reopened empty, small ones stay in one block
+        queue_type q(open_file());
+        die_unless(q.empty());
+        q.push(pushed++);
+        q.push(pushed++);
+    }
+    {
+        queue_type q(open_file());
+        die_unequal(q.size(), 2u);
+        pop_values(q, popped, 2);
+    }
+}
+
+//! a queue which is not closed loses only the values pushed after the last
+//! written block, and delivers values popped since then again
+void test_crash()
+{
+    LOG1 << "reopen a queue which was not closed";
+
+    uint64_t pushed = 0, popped = 0;
+    {
+        // the queue and its file are leaked to skip the destructor
+        queue_type* q = new queue_type(open_file(foxxll::file::CREAT | foxxll::file::TRUNC));
+        for ( ; pushed < 20 * block_items + 100; ++pushed)
+            q->push(pushed);
+        pop_values(*q, popped, 5 * block_items + 50);
+    }
+
+    queue_type q(open_file());
+    const uint64_t first = q.front(), last = q.back();
+    LOG1 << "recovered " << first << " .. " << last << " of " << popped << " .. " << pushed - 1;
+    die_unless(first <= popped && popped - first < block_items);
+    die_unless(last < pushed && pushed - last <= 2 * block_items);
+    die_unequal(q.size(), last - first + 1);
+    pop_values(q, popped = first, static_cast<size_t>(q.size()));
+}
+
+//! the file is reused as long as the queue does not grow
+void test_wrap_around()
+{
+    LOG1 << "reuse the blocks of the file";
+
+    foxxll::file_ptr file = open_file(foxxll::file::CREAT | foxxll::file::TRUNC);
+    uint64_t pushed = 0, popped = 0;
+    {
+        queue_type q(file);
+        for (size_t round = 0; round < 100; ++round)
+        {
+            for (size_t i = 0; i < 8 * block_items; ++i)
+                q.push(pushed++);
+            if (round > 0)
+                pop_values(q, popped, 8 * block_items);
+        }
+    }
+    LOG1 << "file size: " << file->size() / queue_type::block_type::raw_size << " blocks";
+    die_unless(file->size() <= 32 * queue_type::block_type::raw_size);
+
+    queue_type q(file);
+    die_unequal(q.size(), 8 * block_items);
+    pop_values(q, popped, 8 * block_items);
+}
+
+//! a queue of another value type is refused
+void test_wrong_type()
+{
+    bool thrown = false;
+    try {
+        stxxl::queue<uint32_t, 4096> q(open_file());
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    die_unless(thrown);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0] << " file type" << std::endl;
+        return -1;
+    }
+    file_name = argv[1];
+    file_type = argv[2];
+
+    test_reopen();
+    test_crash();
+    test_wrap_around();
+    test_wrong_type();
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
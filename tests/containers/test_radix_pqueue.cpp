@@ -0,0 +1,104 @@
+/***************************************************************************
+ *  tests/containers/test_radix_pqueue.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_radix_pqueue.cpp
+//! This is an example of how to use \c stxxl::radix_priority_queue for a
+//! monotone workload like Dijkstra's algorithm
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/radix_priority_queue>
+
+struct my_type
+{
+    uint64_t key;
+    uint64_t load;
+};
+
+struct my_key_extract
+{
+    using key_type = uint64_t;
+
+    key_type operator () (const my_type& obj) const
+    {
+        return obj.key;
+    }
+};
+
+using pq_type = stxxl::radix_priority_queue<my_type, my_key_extract, 4096>;
+using ref_type = std::priority_queue<
+          uint64_t, std::vector<uint64_t>, std::greater<uint64_t> >;
+
+//! push and pop randomly, each pushed key exceeds the last popped key by less
+//! than max_delta, and check the keys against an internal priority queue.
+void test_monotone(size_t nelements, uint64_t max_delta)
+{
+    LOG1 << "Test " << nelements << " elements with max_delta " << max_delta;
+
+    pq_type pq;
+    ref_type ref;
+
+    std::mt19937_64 rng(nelements + max_delta);
+    std::uniform_int_distribution<uint64_t> delta(0, max_delta - 1);
+
+    uint64_t base = 1000, load_in = 0, load_out = 0;
+
+    for (size_t i = 0; i < nelements; ++i)
+    {
+        // pop more often in the second half to empty the queue
+        const bool do_pop = !pq.empty() && rng() % 8 < (i < nelements / 2 ? 3u : 6u);
+        if (do_pop)
+        {
+            die_unequal(pq.top().key, ref.top());
+            base = pq.top().key;
+            load_out += pq.top().load;
+            pq.pop();
+            ref.pop();
+        }
+        else
+        {
+            const my_type obj { base + delta(rng), rng() };
+            load_in += obj.load;
+            pq.push(obj);
+            ref.push(obj.key);
+        }
+        die_unequal(pq.size(), ref.size());
+    }
+
+    while (!pq.empty())
+    {
+        die_unequal(pq.top().key, ref.top());
+        load_out += pq.top().load;
+        pq.pop();
+        ref.pop();
+    }
+
+    die_unless(ref.empty());
+    die_unequal(load_in, load_out);
+}
+
+int main()
+{
+    test_monotone(100000, 1);
+    test_monotone(100000, 16);
+    test_monotone(1000000, 1000);
+    test_monotone(1000000, uint64_t(1) << 40);
+
+    LOG1 << "Success.";
+
+    return 0;
+}
@@ -15,10 +15,12 @@
 #include <iostream>
 #include <iterator>
 #include <random>
+#include <vector>
 
 #include <tlx/die.hpp>
 
 #include <stxxl/sequence>
+#include <stxxl/stream>
 
 using my_type = int;
 
@@ -110,7 +112,91 @@ int main(int argc, char* argv[])
 
             die_unless(b == STDDeque.rend());
         }
+
+        if (!(i % 5000))
+        {
+            std::cout << "Complete check of partitioned sequence/deque (size " << XXLDeque.size() << ")\n";
+            const size_t n = 1 + (i / 5000) % 5;
+            std::vector<stxxl::sequence<int>::partition_stream> parts = XXLDeque.get_partition_streams(n);
+            die_unless(parts.size() >= 1 && parts.size() <= n);
+
+            std::vector<std::vector<int> > outputs(parts.size());
+            stxxl::stream::parallel_scan(
+                parts, [&outputs](size_t part, const int& value) {
+                    outputs[part].push_back(value);
+                });
+
+            std::deque<int>::const_iterator b = STDDeque.begin();
+            for (const std::vector<int>& output : outputs)
+            {
+                for (const int& value : output)
+                {
+                    die_unless(b != STDDeque.end());
+                    die_unless(value == *b);
+                    ++b;
+                }
+            }
+
+            die_unless(b == STDDeque.end());
+        }
+    }
+
+    // bulk push_back and pop_front, which keep the sequence in FIFO order
+    std::uniform_int_distribution<size_t> distr_n(0, 3 * stxxl::sequence<my_type>::block_type::size);
+    std::vector<my_type> values;
+
+    for (uint64_t i = 0; i < ops / 1000; ++i)
+    {
+        if (distr_op(randgen) < 3 || STDDeque.empty())
+        {
+            values.resize(distr_n(randgen));
+            for (my_type& value : values)
+            {
+                value = distr_value(randgen);
+                STDDeque.push_back(value);
+            }
+            XXLDeque.push_back(values.begin(), values.end());
+        }
+        else
+        {
+            values.resize(std::min<size_t>(distr_n(randgen), STDDeque.size()));
+            die_unless(XXLDeque.pop_front(values.begin(), values.size()) == values.end());
+            for (const my_type& value : values)
+            {
+                die_unless(value == STDDeque.front());
+                STDDeque.pop_front();
+            }
+        }
+
+        die_unless(XXLDeque.size() == STDDeque.size());
+        if (XXLDeque.size() > 0)
+        {
+            die_unless(XXLDeque.back() == STDDeque.back());
+            die_unless(XXLDeque.front() == STDDeque.front());
+        }
+    }
+
+    // adaptive prefetching at both ends
+    XXLDeque.set_prefetch_aggr_auto();
+    die_unless(XXLDeque.get_prefetch_aggr_auto());
+    for (uint64_t i = 0; i < 8 * stxxl::sequence<my_type>::block_type::size; ++i)
+    {
+        XXLDeque.push_back(static_cast<my_type>(i));
+        STDDeque.push_back(static_cast<my_type>(i));
+    }
+    while (!STDDeque.empty())
+    {
+        die_unless(XXLDeque.front() == STDDeque.front());
+        XXLDeque.pop_front();
+        STDDeque.pop_front();
+        if (STDDeque.empty())
+            break;
+        die_unless(XXLDeque.back() == STDDeque.back());
+        XXLDeque.pop_back();
+        STDDeque.pop_back();
+        die_unless(XXLDeque.get_prefetch_aggr() >= 1);
     }
+    die_unless(XXLDeque.empty());
 
     return 0;
 }
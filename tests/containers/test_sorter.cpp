@@ -15,7 +15,10 @@
 //! This is an example of how to use \c stxxl::sorter() container
 
 #include <limits>
+#include <memory>
 #include <random>
+#include <thread>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
@@ -132,6 +135,53 @@ int main()
 
         die_unless(s.size() == 0);
 
+        // read the output in key ranges by parallel threads
+        LOG1 << "Checking partitioned output...";
+
+        const size_t num_partitions = 4;
+        std::vector<std::unique_ptr<sorter_type::partition_type> > partitions =
+            s.partitioned_output(num_partitions);
+        die_unless(partitions.size() == num_partitions);
+
+        std::vector<uint64_t> counts(num_partitions, 0);
+        std::vector<my_type> firsts(num_partitions), lasts(num_partitions);
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < num_partitions; ++p)
+        {
+            threads.emplace_back(
+                [&, p]() {
+                    sorter_type::partition_type& part = *partitions[p];
+                    if (part.empty())
+                        return;
+                    firsts[p] = lasts[p] = *part;
+                    for ( ; !part.empty(); ++part)
+                    {
+                        die_unless(lasts[p] <= *part);
+                        lasts[p] = *part;
+                        ++counts[p];
+                    }
+                });
+        }
+        for (std::thread& t : threads)
+            t.join();
+        partitions.clear();
+
+        count = 0;
+        for (size_t p = 0; p < num_partitions; ++p)
+        {
+            LOG1 << "partition " << p << ": " << counts[p] << " items";
+            die_unless(counts[p] > 0);
+            if (p > 0)
+                die_unless(lasts[p - 1] < firsts[p]);
+            count += counts[p];
+        }
+        die_unless(count == n_records);
+        LOG1 << "OK";
+
+        // the sorter's own output is available again after rewind
+        s.rewind();
+        die_unless(s.size() == n_records);
+
         LOG1 << "Done";
     }
 
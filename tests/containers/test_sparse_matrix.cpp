@@ -0,0 +1,135 @@
+/***************************************************************************
+ *  tests/containers/test_sparse_matrix.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/bits/containers/sparse_matrix.h>
+
+using value_type = double;
+using matrix_type = stxxl::sparse_matrix<value_type>;
+using entry_type = matrix_type::entry_type;
+using dense_type = std::vector<std::vector<value_type> >;
+
+constexpr size_t memory_to_use = 16 * 1024 * 1024;
+
+//! random entries with duplicates and small integer values, which are exact
+std::vector<entry_type> random_entries(size_t height, size_t width, size_t n, unsigned seed)
+{
+    std::mt19937 randgen(seed);
+    std::uniform_int_distribution<size_t> distr_row(0, height - 1), distr_col(0, width - 1);
+    std::uniform_int_distribution<int> distr_value(-4, 4);
+
+    std::vector<entry_type> entries;
+    for (size_t i = 0; i < n; ++i)
+        entries.push_back(entry_type { distr_row(randgen), distr_col(randgen),
+                                       value_type(distr_value(randgen)) });
+    return entries;
+}
+
+dense_type to_dense(const std::vector<entry_type>& entries, size_t height, size_t width)
+{
+    dense_type dense(height, std::vector<value_type>(width, 0));
+    for (const entry_type& e : entries)
+        dense[e.row][e.col] += e.value;
+    return dense;
+}
+
+void check_equal(const matrix_type& matrix, const dense_type& dense)
+{
+    dense_type check(matrix.get_height(), std::vector<value_type>(matrix.get_width(), 0));
+    matrix_type::tile_order cmp(matrix.get_tile_size());
+
+    size_t nnz = 0;
+    entry_type prev = cmp.min_value();
+    for (matrix_type::stream s(matrix); !s.empty(); ++s, ++nnz)
+    {
+        die_unless(nnz == 0 || cmp(prev, *s));
+        check[s->row][s->col] = s->value;
+        prev = *s;
+    }
+    die_unequal(nnz, matrix.nnz());
+    die_unless(check == dense);
+}
+
+int main()
+{
+    const size_t height = 1000, width = 700, depth = 500, tile_size = 128;
+
+    LOG1 << "assigning a " << height << " x " << width << " matrix";
+    std::vector<entry_type> a_entries = random_entries(height, width, 20000, 1);
+    matrix_type a(height, width, tile_size);
+    {
+        auto input = stxxl::stream::streamify(a_entries.begin(), a_entries.end());
+        a.assign(input, memory_to_use);
+    }
+    const dense_type a_dense = to_dense(a_entries, height, width);
+    check_equal(a, a_dense);
+    die_unless(a.num_tiles() > 1);
+
+    LOG1 << "multiplying with vectors";
+    {
+        stxxl::column_vector<value_type> x(width);
+        for (size_t j = 0; j < width; ++j)
+            x[j] = value_type(j % 7);
+
+        stxxl::column_vector<value_type> y = a * x;
+        die_unequal(y.size(), height);
+        for (size_t i = 0; i < height; ++i)
+        {
+            value_type sum = 0;
+            for (size_t j = 0; j < width; ++j)
+                sum += a_dense[i][j] * value_type(j % 7);
+            die_unequal(y[i], sum);
+        }
+
+        stxxl::row_vector<value_type> z(height);
+        for (size_t i = 0; i < height; ++i)
+            z[i] = value_type(i % 5);
+
+        stxxl::row_vector<value_type> w = a.multiply_from_left(z);
+        die_unequal(w.size(), width);
+        for (size_t j = 0; j < width; ++j)
+        {
+            value_type sum = 0;
+            for (size_t i = 0; i < height; ++i)
+                sum += value_type(i % 5) * a_dense[i][j];
+            die_unequal(w[j], sum);
+        }
+    }
+
+    LOG1 << "multiplying with a " << width << " x " << depth << " matrix";
+    {
+        std::vector<entry_type> b_entries = random_entries(width, depth, 5000, 2);
+        matrix_type b(width, depth, tile_size);
+        auto input = stxxl::stream::streamify(b_entries.begin(), b_entries.end());
+        b.assign(input, memory_to_use);
+        const dense_type b_dense = to_dense(b_entries, width, depth);
+
+        // a different tile size of the result
+        matrix_type c(height, depth, 100);
+        a.multiply(b, c, memory_to_use);
+
+        dense_type c_dense(height, std::vector<value_type>(depth, 0));
+        for (size_t i = 0; i < height; ++i)
+            for (size_t k = 0; k < width; ++k)
+                if (a_dense[i][k] != 0)
+                    for (size_t j = 0; j < depth; ++j)
+                        c_dense[i][j] += a_dense[i][k] * b_dense[k][j];
+
+        check_equal(c, c_dense);
+    }
+
+    return 0;
+}
@@ -19,6 +19,9 @@
 //! with \c stxxl::grow_shrink_stack implementation, \b four blocks per page,
 //! block size \b STXXL_DEFAULT_BLOCK_SIZE(T) bytes
 
+#include <algorithm>
+#include <vector>
+
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
 
@@ -116,6 +119,39 @@ void simple_test(stack_type& my_stack, size_t test_size)
     test_lvalue_correctness(my_stack, 4 * STXXL_DEFAULT_BLOCK_SIZE(size_t) / 4 * 2, 4 * STXXL_DEFAULT_BLOCK_SIZE(size_t) / 4 * 2 * 20);
 }
 
+template <typename stack_type>
+void bulk_test(stack_type& my_stack, size_t test_size)
+{
+    std::vector<size_t> values(test_size);
+    for (size_t i = 0; i < test_size; i++)
+        values[i] = i;
+
+    // push in bursts of different sizes, crossing block and page boundaries
+    for (size_t i = 0, burst = 1; i < test_size; burst = 2 * burst + 1)
+    {
+        const size_t n = std::min(burst, test_size - i);
+        my_stack.push(values.begin() + i, values.begin() + i + n);
+        i += n;
+        die_unless(my_stack.top() == i - 1);
+        die_unless(my_stack.size() == i);
+    }
+
+    std::vector<size_t> popped(test_size);
+    for (size_t i = test_size, burst = 1; i > 0; burst = 2 * burst + 1)
+    {
+        const size_t n = std::min(burst, i);
+        die_unless(my_stack.pop(popped.begin(), n) == popped.begin() + n);
+        for (size_t j = 0; j < n; ++j)
+            die_unless(popped[j] == i - 1 - j);
+        i -= n;
+        die_unless(my_stack.size() == i);
+        if (i > 0)
+            die_unless(my_stack.top() == i - 1);
+    }
+
+    LOG1 << "Bulk test passed.";
+}
+
 int main(int argc, char* argv[])
 {
     using ext_normal_stack_type = stxxl::STACK_GENERATOR<
@@ -139,6 +175,7 @@ int main(int argc, char* argv[])
     {
         ext_normal_stack_type my_stack;
         simple_test(my_stack, atoi(argv[1]) * STXXL_DEFAULT_BLOCK_SIZE(int) / sizeof(int));
+        bulk_test(my_stack, atoi(argv[1]) * STXXL_DEFAULT_BLOCK_SIZE(int) / sizeof(int));
     }
     {
         ext_migrating_stack_type my_stack;
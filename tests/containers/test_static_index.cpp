@@ -0,0 +1,137 @@
+/***************************************************************************
+ *  tests/containers/test_static_index.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+//! \example containers/test_static_index.cpp
+//! This is an example of how to use \c stxxl::static_index
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+
+#include <stxxl/static_index>
+#include <stxxl/vector>
+
+struct entry
+{
+    uint64_t key;
+    uint64_t data;
+};
+
+struct entry_key
+{
+    uint64_t operator () (const entry& e) const
+    {
+        return e.key;
+    }
+};
+
+using vector_type = stxxl::vector<entry, 2, stxxl::lru_pager<2>, 4096>;
+using index_type = stxxl::static_index<vector_type, entry_key, std::less<uint64_t>, 4096>;
+
+//! check the lookups of index against the keys of the vector
+void check(const index_type& index, const std::vector<uint64_t>& keys, std::mt19937_64& rng)
+{
+    const uint64_t max_key = keys.empty() ? 10 : keys.back() + 10;
+
+    std::vector<uint64_t> queries(2000);
+    for (uint64_t& q : queries)
+        q = rng() % max_key;
+
+    for (uint64_t q : queries)
+    {
+        const uint64_t lower = std::lower_bound(keys.begin(), keys.end(), q) - keys.begin();
+        const uint64_t upper = std::upper_bound(keys.begin(), keys.end(), q) - keys.begin();
+        die_unequal(index.lower_bound(q), lower);
+        die_unequal(index.upper_bound(q), upper);
+
+        entry e;
+        die_unequal(index.find(q, e), lower != upper);
+        if (lower != upper)
+            die_unequal(e.key, q);
+
+        const std::pair<uint64_t, uint64_t> r = index.range(q, q + 100);
+        die_unequal(r.first, lower);
+        die_unequal(r.second, uint64_t(std::lower_bound(keys.begin(), keys.end(), q + 100) - keys.begin()));
+    }
+
+    std::vector<uint64_t> positions;
+    index.lower_bound(queries.begin(), queries.end(), std::back_inserter(positions));
+    std::vector<std::pair<bool, entry> > found;
+    index.find(queries.begin(), queries.end(), std::back_inserter(found));
+    die_unequal(positions.size(), queries.size());
+    die_unequal(found.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        die_unequal(positions[i], index.lower_bound(queries[i]));
+        die_unequal(found[i].first, index.contains(queries[i]));
+        if (found[i].first)
+            die_unequal(found[i].second.key, queries[i]);
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(42);
+
+    for (size_t n : { size_t(0), size_t(1), size_t(1000), size_t(200000) })
+    {
+        // sorted keys with duplicates
+        std::vector<uint64_t> keys(n);
+        vector_type v(n);
+        uint64_t key = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            key += rng() % 3;
+            keys[i] = key;
+            v[i] = entry { key, i };
+        }
+
+        // the fence keys in internal memory, and on one or more levels of
+        // fence blocks on disk
+        for (size_t top_bytes : { size_t(16 * 1024 * 1024), size_t(4096), size_t(64) })
+        {
+            index_type index(v, top_bytes);
+            LOG1 << "n=" << n << " top_bytes=" << top_bytes
+                 << " levels=" << index.levels() << " memory=" << index.index_memory();
+            die_unequal(index.size(), n);
+            die_unless(index.index_memory() <= std::max<size_t>(top_bytes, sizeof(uint64_t)));
+            check(index, keys, rng);
+        }
+    }
+
+    // an unsorted vector is refused
+    {
+        vector_type v(2);
+        v[0] = entry { 2, 0 };
+        v[1] = entry { 1, 1 };
+        bool thrown = false;
+        try {
+            index_type index(v);
+        }
+        catch (const foxxll::bad_parameter&) {
+            thrown = true;
+        }
+        die_unless(thrown);
+    }
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,94 @@
+/***************************************************************************
+ *  tests/containers/test_string_sorter.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/string_sorter>
+
+using string_sorter_type = stxxl::string_sorter<4096>;
+
+size_t common_prefix(const std::string& a, const std::string& b)
+{
+    size_t i = 0;
+    while (i < a.size() && i < b.size() && a[i] == b[i])
+        ++i;
+    return i;
+}
+
+void test(size_t n, size_t memory_to_use, size_t expected_runs)
+{
+    LOG1 << "sorting " << n << " strings with " << memory_to_use << " bytes";
+
+    std::mt19937 randgen(static_cast<unsigned>(n));
+    std::uniform_int_distribution<size_t> distr_length(0, 40);
+    std::uniform_int_distribution<int> distr_char(0, 3);
+
+    // strings with long common prefixes, duplicates and NUL bytes
+    const std::string prefixes[] = {
+        "", "http://stxxl.org/", "http://stxxl.org/tags/", std::string(3, '\0')
+    };
+
+    string_sorter_type sorter(memory_to_use);
+    std::vector<std::string> check;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        std::string str = prefixes[i % 4];
+        const size_t length = distr_length(randgen);
+        for (size_t j = 0; j < length; ++j)
+            str += static_cast<char>("\0az\xff"[distr_char(randgen)]);
+
+        sorter.push(str);
+        check.push_back(str);
+    }
+    die_unequal(sorter.size(), n);
+
+    std::sort(check.begin(), check.end());
+
+    sorter.sort();
+    if (expected_runs == 0)
+        die_unequal(sorter.num_runs(), 0u);
+    else
+        die_unless(sorter.num_runs() > 0 && sorter.num_runs() <= expected_runs);
+
+    for (size_t pass = 0; pass < 2; ++pass)
+    {
+        for (size_t i = 0; i < n; ++i, ++sorter)
+        {
+            die_unless(!sorter.empty());
+            die_unequal(sorter.size(), n - i);
+            die_unequal(*sorter, check[i]);
+            die_unequal(sorter.lcp(), i == 0 ? 0 : common_prefix(check[i - 1], check[i]));
+        }
+        die_unless(sorter.empty());
+        sorter.rewind();
+    }
+
+    sorter.clear();
+    die_unequal(sorter.size(), 0u);
+}
+
+int main()
+{
+    // in internal memory
+    test(10000, 16 * 1024 * 1024, 0);
+    // a single merge
+    test(50000, 1024 * 1024, 9);
+    // merges of groups of runs
+    test(50000, 256 * 1024, 2);
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+/***************************************************************************
+ *  tests/containers/test_var_vector.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/var_vector>
+
+using var_vector_type = stxxl::var_vector<stxxl::lru_pager<8>, 4096>;
+
+int main()
+{
+    const size_t n = 20000;
+
+    std::mt19937 randgen;
+    std::uniform_int_distribution<size_t> distr_length(0, 100);
+    std::uniform_int_distribution<int> distr_char('a', 'z');
+
+    var_vector_type records;
+    std::vector<std::string> check;
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        // some records longer than a block
+        std::string str(i % 1000 == 0 ? 5000 : distr_length(randgen), ' ');
+        for (char& c : str)
+            c = static_cast<char>(distr_char(randgen));
+
+        records.push_back(str);
+        check.push_back(str);
+        bytes += str.size();
+    }
+
+    die_unequal(records.size(), n);
+    die_unequal(records.bytes(), bytes);
+
+    LOG1 << "random access";
+    for (size_t i = 0; i < n; i += 7)
+    {
+        die_unequal(records.get(i), check[i]);
+        die_unequal(records.length(i), check[i].size());
+    }
+
+    LOG1 << "streams";
+    {
+        var_vector_type::stream stream(records);
+        for (size_t i = 0; i < n; ++i, ++stream)
+        {
+            die_unless(!stream.empty());
+            die_unequal(stream->str(), check[i]);
+        }
+        die_unless(stream.empty());
+
+        var_vector_type::handle_stream handles(records);
+        stxxl::binary_buffer record;
+        for (size_t i = 0; i < n; ++i, ++handles)
+        {
+            records.get(*handles, record);
+            die_unequal(record.str(), check[i]);
+        }
+        die_unless(handles.empty());
+    }
+
+    LOG1 << "sorting handles by key";
+    {
+        std::vector<var_vector_type::handle_type> handles;
+        for (var_vector_type::handle_stream stream(records); !stream.empty(); ++stream)
+            handles.push_back(*stream);
+
+        std::stable_sort(handles.begin(), handles.end(),
+                         [](const var_vector_type::handle_type& a,
+                            const var_vector_type::handle_type& b) {
+                             return a.length < b.length;
+                         });
+
+        var_vector_type sorted;
+        auto handle_stream = stxxl::stream::streamify(handles.begin(), handles.end());
+        sorted.append_from(records, handle_stream);
+
+        std::stable_sort(check.begin(), check.end(),
+                         [](const std::string& a, const std::string& b) {
+                             return a.size() < b.size();
+                         });
+
+        die_unequal(sorted.size(), n);
+        var_vector_type::stream stream(sorted);
+        for (size_t i = 0; i < n; ++i, ++stream)
+            die_unequal(stream->str(), check[i]);
+    }
+
+    records.clear();
+    die_unless(records.empty());
+    records.push_back(std::string());
+    die_unequal(records.get(0), std::string());
+
+    return 0;
+}
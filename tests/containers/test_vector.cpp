@@ -21,7 +21,11 @@
 #include <cassert>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <numeric>
 #include <random>
+#include <thread>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
@@ -165,10 +169,467 @@ void test_resize_shrink()
     vector.flush();
 }
 
+//! check sequential, reverse and strided scans, which read ahead, and
+//! modifications, which are written back in the background
+template <typename PagerType>
+void test_readahead()
+{
+    using vector_type = stxxl::vector<uint64_t, 2, PagerType, 4096>;
+    const size_t n = 64 * 2 * 4096 / sizeof(uint64_t);
+    vector_type v(n);
+    const vector_type& cv = v;
+
+    for (size_t i = 0; i < n; ++i)
+        v[i] = i;
+    v.flush();
+
+    for (size_t i = 0; i < n; ++i)
+        die_unless(cv[i] == i);
+    for (size_t i = n; i-- > 0; )
+        die_unless(cv[i] == i);
+    for (size_t i = 0; i < n; i += 3 * 1024)
+        die_unless(cv[i] == i);
+
+    for (size_t i = 0; i < n; ++i)
+        v[i] += 1;
+
+    std::mt19937_64 randgen(42);
+    for (size_t k = 0; k < 64; ++k)
+    {
+        const size_t begin = randgen() % (n - 4096);
+        for (size_t i = begin; i < begin + 4096; ++i)
+            die_unless(cv[i] == i + 1);
+    }
+
+    v.set_readahead(0);
+    for (size_t i = n; i-- > 0; )
+        die_unless(cv[i] == i + 1);
+}
+
+//! check concurrent random reads by many threads
+void test_concurrent_reader()
+{
+    using vector_type = stxxl::vector<uint64_t, 2, stxxl::lru_pager<8>, 4096>;
+    const size_t n = 256 * 4096 / sizeof(uint64_t);
+    vector_type v(n);
+    for (size_t i = 0; i < n; ++i)
+        v[i] = i * 3;
+
+    stxxl::vector_concurrent_reader<vector_type> reader(v, 16, 4);
+    die_unless(reader.size() == n);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 8; ++t)
+    {
+        threads.emplace_back(
+            [&reader, n, t]() {
+                std::mt19937_64 randgen(t);
+                for (size_t k = 0; k < 20000; ++k)
+                {
+                    const size_t i = randgen() % n;
+                    die_unless(reader[i] == i * 3);
+                }
+            });
+    }
+    for (std::thread& t : threads)
+        t.join();
+}
+
+//! stream of the multiples of three
+struct multiples_stream
+{
+    uint64_t i, n;
+
+    bool empty() const { return i == n; }
+    uint64_t operator * () const { return 3 * i; }
+    multiples_stream& operator ++ ()
+    {
+        ++i;
+        return *this;
+    }
+};
+
+//! check appending and assigning ranges which bypass the page cache
+void test_bulk_append()
+{
+    using vector_type = stxxl::vector<uint64_t, 2, stxxl::lru_pager<4>, 4096>;
+    vector_type v;
+    std::vector<uint64_t> mirror;
+
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        v.push_back(i);
+        mirror.push_back(i);
+    }
+
+    std::mt19937_64 randgen(42);
+    for (size_t round = 0; round < 4; ++round)
+    {
+        std::vector<uint64_t> input(randgen() % 20000);
+        for (uint64_t& x : input)
+            x = randgen();
+
+        v.append(input.begin(), input.end());
+        mirror.insert(mirror.end(), input.begin(), input.end());
+        die_unless(v.size() == mirror.size());
+
+        for (size_t k = 0; k < 1000; ++k)
+        {
+            const size_t i = randgen() % mirror.size();
+            v[i] = k;
+            mirror[i] = k;
+        }
+    }
+
+    for (size_t i = 0; i < mirror.size(); ++i)
+        die_unless(v[i] == mirror[i]);
+
+    multiples_stream stream = { 0, 100000 };
+    v.assign_from_stream(stream);
+    die_unless(v.size() == 100000);
+    for (size_t i = 0; i < v.size(); ++i)
+        die_unless(v[i] == 3 * i);
+}
+
+//! check a vector whose blocks are encoded on disk
+void test_compressed()
+{
+    using vector_type = stxxl::vector<
+        uint64_t, 2, stxxl::lru_pager<4>, 65536, foxxll::default_alloc_strategy,
+        stxxl::frame_of_reference_codec<uint64_t, true> >;
+    vector_type v;
+    std::vector<uint64_t> mirror;
+
+    // sorted values compress well, the random ones below are stored plain
+    for (uint64_t i = 0; i < 200000; ++i)
+    {
+        v.push_back(3 * i);
+        mirror.push_back(3 * i);
+    }
+
+    std::mt19937_64 randgen(42);
+    for (size_t k = 0; k < 1000; ++k)
+    {
+        const size_t i = randgen() % mirror.size();
+        v[i] = randgen();
+        mirror[i] = v[i];
+    }
+
+    std::vector<uint64_t> input(50000);
+    for (size_t i = 0; i < input.size(); ++i)
+        input[i] = i / 7;
+    v.append(input.begin(), input.end());
+    mirror.insert(mirror.end(), input.begin(), input.end());
+
+    v.flush();
+    die_unless(v.size() == mirror.size());
+    for (size_t i = 0; i < mirror.size(); ++i)
+        die_unless(v[i] == mirror[i]);
+
+    const vector_type& cv = v;
+    for (size_t k = 0; k < 10000; ++k)
+    {
+        const size_t i = randgen() % mirror.size();
+        die_unless(cv[i] == mirror[i]);
+    }
+
+    v.resize(1000);
+    v.resize(100000);
+    for (size_t i = 0; i < 1000; ++i)
+        die_unless(v[i] == mirror[i]);
+}
+
+//! check that snapshots keep their content while the vectors are modified
+void test_snapshot()
+{
+    using vector_type = stxxl::vector<uint64_t, 2, stxxl::lru_pager<4>, 4096>;
+    std::mt19937_64 randgen(42);
+
+    std::unique_ptr<vector_type> v(new vector_type);
+    std::vector<uint64_t> mirror;
+    for (uint64_t i = 0; i < 20000; ++i)
+    {
+        v->push_back(i);
+        mirror.push_back(i);
+    }
+
+    vector_type s1 = v->snapshot();
+    const std::vector<uint64_t> mirror1 = mirror;
+
+    for (size_t k = 0; k < 1000; ++k)
+    {
+        const size_t i = randgen() % mirror.size();
+        (*v)[i] = randgen();
+        mirror[i] = (*v)[i];
+    }
+    std::vector<uint64_t> input(10000, 7);
+    v->append(input.begin(), input.end());
+    mirror.insert(mirror.end(), input.begin(), input.end());
+    v->flush();
+
+    die_unless(s1.size() == mirror1.size());
+    for (size_t i = 0; i < mirror1.size(); ++i)
+        die_unless(s1[i] == mirror1[i]);
+
+    // a snapshot of a snapshot, the snapshot overwritten directly
+    vector_type s2 = s1.snapshot(2);
+    {
+        vector_type::bufwriter_type writer(s1);
+        for (uint64_t i = 0; i < 5000; ++i)
+            writer << 3 * i;
+    }
+    for (size_t i = 0; i < mirror1.size(); ++i)
+    {
+        die_unless(s1[i] == (i < 5000 ? 3 * i : mirror1[i]));
+        die_unless(s2[i] == mirror1[i]);
+    }
+
+    v->resize(100, true);
+    for (size_t i = 0; i < 100; ++i)
+        die_unless((*v)[i] == mirror[i]);
+    v.reset();
+
+    for (size_t i = 0; i < mirror1.size(); ++i)
+        die_unless(s2[i] == mirror1[i]);
+}
+
+//! check the copies of whole blocks between vectors and the splicing of their
+//! blocks, together with the elementwise fallbacks
+void test_copy_range()
+{
+    using vector_type = stxxl::vector<uint64_t, 2, stxxl::lru_pager<4>, 4096>;
+    const size_t per_block = 4096 / sizeof(uint64_t);
+    std::mt19937_64 randgen(42);
+
+    vector_type a, b(20 * per_block + 17);
+    std::fill(b.begin(), b.end(), 1);
+    std::vector<uint64_t> mirror_a, mirror_b(b.size(), 1);
+    for (uint64_t i = 0; i < 30 * per_block + 100; ++i)
+    {
+        a.push_back(randgen());
+        mirror_a.push_back(a.back());
+    }
+    const vector_type& ca = a;
+
+    // an aligned copy with partial blocks at both ends, from dirty pages
+    a[per_block + 5] = 42;
+    mirror_a[per_block + 5] = 42;
+    b.copy_range(ca.begin() + 3 * per_block + 10, ca.begin() + 15 * per_block + 20,
+                 per_block + 10);
+    std::copy(mirror_a.begin() + 3 * per_block + 10, mirror_a.begin() + 15 * per_block + 20,
+              mirror_b.begin() + per_block + 10);
+
+    // an unaligned copy
+    stxxl::copy(ca.begin() + 7, ca.begin() + 3 * per_block, b.begin() + 16 * per_block);
+    std::copy(mirror_a.begin() + 7, mirror_a.begin() + 3 * per_block,
+              mirror_b.begin() + 16 * per_block);
+
+    die_unless(b.size() == mirror_b.size());
+    for (size_t i = 0; i < mirror_b.size(); ++i)
+        die_unless(b[i] == mirror_b[i]);
+
+    // an aligned append, and one of a vector to itself
+    b.resize(20 * per_block);
+    mirror_b.resize(20 * per_block);
+    b.append(ca.begin() + per_block, ca.end());
+    mirror_b.insert(mirror_b.end(), mirror_a.begin() + per_block, mirror_a.end());
+    b.append(b.cbegin(), b.cbegin() + 2 * per_block + 1);
+    mirror_b.insert(mirror_b.end(), mirror_b.begin(), mirror_b.begin() + 2 * per_block + 1);
+
+    die_unless(b.size() == mirror_b.size());
+    for (size_t i = 0; i < mirror_b.size(); ++i)
+        die_unless(b[i] == mirror_b[i]);
+
+    // splicing the blocks keeps a snapshot of the source
+    vector_type c(4 * per_block);
+    std::fill(c.begin(), c.end(), 5);
+    std::vector<uint64_t> mirror_c(c.size(), 5);
+    vector_type s = a.snapshot();
+    c.splice_back(a);
+    mirror_c.insert(mirror_c.end(), mirror_a.begin(), mirror_a.end());
+    die_unless(a.empty());
+    c[4 * per_block] = 7;
+    mirror_c[4 * per_block] = 7;
+    c.flush();
+
+    die_unless(c.size() == mirror_c.size());
+    for (size_t i = 0; i < mirror_c.size(); ++i)
+        die_unless(c[i] == mirror_c[i]);
+    for (size_t i = 0; i < mirror_a.size(); ++i)
+        die_unless(s[i] == mirror_a[i]);
+
+    // a partial last block falls back to the copy
+    c.splice_back(s);
+    mirror_c.insert(mirror_c.end(), mirror_a.begin(), mirror_a.end());
+    die_unless(s.empty());
+    die_unless(c.size() == mirror_c.size());
+    for (size_t i = 0; i < mirror_c.size(); ++i)
+        die_unless(c[i] == mirror_c[i]);
+}
+
+//! check the counters of the page cache over a write and a read pass
+void test_statistics()
+{
+    using vector_type = stxxl::vector<uint64_t, 1, stxxl::lru_pager<2>, 4096>;
+    const size_t per_page = 4096 / sizeof(uint64_t), pages = 8;
+    const size_t n = pages * per_page;
+    vector_type v(n);
+    const vector_type& cv = v;
+
+    for (size_t i = 0; i < n; ++i)
+        v[i] = i;
+    v.flush();
+
+    stxxl::vector_cache_stats st = v.statistics();
+    die_unequal(uint64_t(st.misses), pages);
+    die_unequal(uint64_t(st.hits), n - pages);
+    die_unequal(uint64_t(st.pages_initialized), pages);
+    die_unequal(uint64_t(st.pages_dirtied), 0u);
+    die_unequal(uint64_t(st.clean_evictions) + uint64_t(st.dirty_evictions), pages - 2);
+    die_unequal(uint64_t(st.pages_cleaned), pages);
+    die_unequal(uint64_t(st.bytes_read), 0u);
+    die_unequal(uint64_t(st.bytes_written), pages * 4096);
+
+    // each page is read once, on a miss or ahead of the scan
+    v.reset_statistics();
+    for (size_t i = 0; i < n; ++i)
+        die_unless(cv[i] == i);
+    st = v.statistics();
+    die_unequal(uint64_t(st.hits) + uint64_t(st.misses), n);
+    die_unequal(uint64_t(st.misses) + uint64_t(st.read_ahead), pages);
+    die_unequal(uint64_t(st.bytes_read), pages * 4096);
+    die_unequal(uint64_t(st.dirty_evictions), 0u);
+    die_unless(st.hit_ratio() > 0.99);
+
+    // overwriting a cached page makes it dirty once
+    const stxxl::vector_cache_stats before = v.statistics();
+    for (size_t i = n - per_page; i < n; ++i)
+        v[i] = i + 1;
+    const stxxl::vector_cache_stats diff = v.statistics() - before;
+    die_unequal(uint64_t(diff.pages_dirtied), 1u);
+    die_unequal(uint64_t(diff.misses), 0u);
+
+    v.print_statistics(std::cout);
+}
+
+//! gather random elements, each block touched is read once
+void test_gather()
+{
+    using vector_type = stxxl::vector<uint64_t, 1, stxxl::lru_pager<2>, 4096>;
+    const size_t per_block = 4096 / sizeof(uint64_t), blocks = 64;
+    const size_t n = blocks * per_block;
+    vector_type v(n);
+    for (size_t i = 0; i < n; ++i)
+        v[i] = 7 * i;
+    v.flush();
+
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> indexes(5000);
+    for (uint64_t& i : indexes)
+        i = rng() % n;
+
+    for (size_t memory : { size_t(32 * 4096), size_t(4096) })
+    {
+        v.reset_statistics();
+        std::vector<uint64_t> out(indexes.size());
+        die_unless(v.gather(indexes.begin(), indexes.end(), out.begin(), memory) == out.end());
+        for (size_t k = 0; k < indexes.size(); ++k)
+            die_unequal(out[k], 7 * indexes[k]);
+
+        const stxxl::vector_cache_stats st = v.statistics();
+        die_unequal(uint64_t(st.hits) + uint64_t(st.misses), indexes.size());
+        die_unless(uint64_t(st.bytes_read) <= blocks * 4096);
+    }
+}
+
+//! prefetched pages are accessed without misses
+void test_prefetch()
+{
+    using vector_type = stxxl::vector<uint64_t, 1, stxxl::lru_pager<4>, 4096>;
+    const size_t per_page = 4096 / sizeof(uint64_t), pages = 16;
+    vector_type v(pages * per_page);
+    const vector_type& cv = v;
+    for (size_t i = 0; i < v.size(); ++i)
+        v[i] = i;
+    v.flush();
+
+    // elements of three pages, the first pages are not cached
+    const std::vector<uint64_t> indexes = {
+        3 * per_page + 1, 0, 3 * per_page + 5, per_page + 2, 7
+    };
+    v.prefetch(indexes.begin(), indexes.end());
+
+    v.reset_statistics();
+    for (uint64_t i : indexes)
+        die_unequal(cv[i], i);
+    const stxxl::vector_cache_stats st = v.statistics();
+    die_unequal(uint64_t(st.misses), 0u);
+    die_unequal(uint64_t(st.hits), indexes.size());
+}
+
+//! iterators keep the pointer to their block only while it is cached
+void test_iterator_block()
+{
+    using vector_type = stxxl::vector<uint64_t, 1, stxxl::lru_pager<2>, 4096>;
+    const size_t per_page = 4096 / sizeof(uint64_t), pages = 8;
+    const size_t n = pages * per_page;
+    vector_type v(n);
+    const vector_type& cv = v;
+
+    std::iota(v.begin(), v.end(), uint64_t(0));
+    die_unequal(std::accumulate(cv.begin(), cv.end(), uint64_t(0)), uint64_t(n) * (n - 1) / 2);
+
+    // three iterators in different pages evict each other's page all the time
+    vector_type::iterator a = v.begin(), b = v.begin() + 3 * per_page, c = v.begin() + 6 * per_page;
+    for (size_t i = 0; i < 2 * per_page; ++i, ++a, ++b, ++c)
+    {
+        *a += 1;
+        const uint64_t x = *a;
+        *b += x;
+        die_unequal(*c, 6 * per_page + i);
+        if (i % 100 == 0)
+            v.flush();
+    }
+    v.flush();
+    for (size_t i = 0; i < 2 * per_page; ++i)
+    {
+        die_unequal(cv[i], i + 1);
+        die_unequal(cv[3 * per_page + i], 3 * per_page + 2 * i + 1);
+    }
+
+    // a const iterator taken from a mutable one sees its writes
+    vector_type::iterator w = v.begin() + 5;
+    *w = 42;
+    vector_type::const_iterator r = w;
+    die_unequal(*r, 42u);
+    v.flush();
+    die_unequal(*r, 42u);
+
+    // a resize drops the cached pages
+    v.resize(2 * per_page);
+    vector_type::const_iterator e = cv.begin() + per_page;
+    die_unequal(*e, per_page + 1);
+    v.resize(n);
+    die_unequal(*e, per_page + 1);
+}
+
 int main()
 {
     test_vector1();
     test_resize_shrink();
+    test_readahead<stxxl::lru_pager<8> >();
+    test_readahead<stxxl::random_pager<8> >();
+    test_readahead<stxxl::clock_pager<8> >();
+    test_readahead<stxxl::two_queue_pager<8> >();
+    test_concurrent_reader();
+    test_bulk_append();
+    test_compressed();
+    test_snapshot();
+    test_copy_range();
+    test_statistics();
+    test_gather();
+    test_prefetch();
+    test_iterator_block();
 
     return 0;
 }
@@ -186,6 +647,7 @@ template class stxxl::const_vector_iterator<stxxl::vector<double>::configuration
 using const_vector_iterator = stxxl::vector<double>::const_iterator;
 template class stxxl::vector_bufreader<const_vector_iterator>;
 template class stxxl::vector_bufreader_reverse<const_vector_iterator>;
+template class stxxl::vector_bufreader_strided<const_vector_iterator>;
 template class stxxl::vector_bufreader_iterator<stxxl::vector_bufreader<const_vector_iterator> >;
 
 using vector_iterator = stxxl::vector<double>::iterator;
@@ -0,0 +1,90 @@
+/***************************************************************************
+ *  tests/containers/test_vector_async.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <atomic>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/vector>
+
+#if STXXL_HAVE_COROUTINES
+
+struct element  // 24 bytes, some elements straddle two sectors
+{
+    uint64_t key, a, b;
+};
+
+// pages of two 16 KiB blocks, of which two are cached
+using vector_type = stxxl::vector<element, 2, stxxl::lru_pager<2>, 16 * 1024>;
+
+stxxl::detached_task lookup(const vector_type& v, uint64_t i, std::atomic<size_t>& found)
+{
+    const element e = co_await v.async_get(i);
+    die_unequal(e.key, i);
+    die_unequal(e.a, 3 * i);
+    die_unequal(e.b, ~i);
+    ++found;
+}
+
+void test_async_get()
+{
+    const uint64_t size = 100 * vector_type::block_type::size;
+    vector_type v(size);
+    for (uint64_t i = 0; i < size; ++i)
+        v[i] = element { i, 3 * i, ~i };
+    v.flush();
+
+    // each lookup suspends on its read, all of them are in flight at once
+    std::mt19937_64 rng(42);
+    std::atomic<size_t> found { 0 };
+    const size_t lookups = 2000;
+    stxxl::io_scheduler& scheduler = stxxl::io_scheduler::this_thread();
+    for (size_t n = 0; n < lookups; ++n)
+        lookup(v, rng() % size, found);
+    scheduler.run();
+    die_unequal(found.load(), lookups);
+    die_unequal(scheduler.in_flight(), 0u);
+
+    // elements straddling a sector boundary, and the first and last
+    found = 0;
+    const uint64_t boundary = 4096 / sizeof(element);
+    for (uint64_t i : { uint64_t(0), boundary, boundary + vector_type::block_type::size, size - 1 })
+        lookup(v, i, found);
+    scheduler.run();
+    die_unequal(found.load(), 4u);
+
+    // elements of cached pages, here the last one, are ready without reading
+    v.reset_statistics();
+    found = 0;
+    lookup(v, size - 1, found);
+    die_unequal(found.load(), 1u);
+    die_unequal(scheduler.in_flight(), 0u);
+    const stxxl::vector_cache_stats st = v.statistics();
+    die_unequal(uint64_t(st.hits), 1u);
+    die_unequal(uint64_t(st.misses), 0u);
+}
+
+#endif // STXXL_HAVE_COROUTINES
+
+int main()
+{
+#if STXXL_HAVE_COROUTINES
+    test_async_get();
+#else
+    LOG1 << "test_vector_async: coroutines not supported, skipped.";
+#endif
+
+    return 0;
+}
+
+/******************************************************************************/
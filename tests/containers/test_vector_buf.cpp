@@ -14,6 +14,7 @@
 
 #include <algorithm>
 #include <iostream>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
@@ -236,6 +237,28 @@ void test_vector_buf(size_t size)
 
         die_unless(reader.empty());
     }
+    {   // read every k-th element of the vector forwards and backwards
+        foxxll::scoped_print_timer tm("vector_bufreader_strided");
+        using bufreader_strided_type = typename vector_type::bufreader_strided_type;
+
+        const vector_type& cvec = vec;
+
+        for (int64_t stride : { 1, 3, 1000, -1, -7, -1000 })
+        {
+            bufreader_strided_type reader(cvec, stride);
+
+            const uint64_t step = static_cast<uint64_t>(stride > 0 ? stride : -stride);
+            die_unless(reader.size() == (size + step - 1) / step);
+
+            uint64_t i = (stride > 0) ? 0 : size - 1;
+            for ( ; !reader.empty(); i += static_cast<uint64_t>(stride))
+            {
+                ValueType v;
+                reader >> v;
+                die_unless(v == ValueType(i));
+            }
+        }
+    }
     {   // read vector using C++11 for loop construct
         foxxll::scoped_print_timer tm("C++11 for loop");
 
@@ -249,6 +272,34 @@ void test_vector_buf(size_t size)
 
         die_unless(i == vec.size());
     }
+    {   // read vector ranges in parallel parts
+        foxxll::scoped_print_timer tm("vector_partitioned_bufreader");
+        using partitioned_bufreader_type = typename vector_type::partitioned_bufreader_type;
+
+        const size_t first = std::min<size_t>(vec.size(), 42);
+        for (size_t nparts : { 1, 3, 7 })
+        {
+            partitioned_bufreader_type parts(vec.cbegin() + first, vec.cend(), nparts, 8);
+            die_unless(parts.parts() == nparts);
+
+            std::vector<uint64_t> counts(nparts);
+            parts.for_each_part(
+                [&](size_t p, typename partitioned_bufreader_type::bufreader_type& reader) {
+                    uint64_t i = parts.part_begin(p) - vec.cbegin();
+                    die_unless(parts.part_begin(p) == parts.part_begin(0) ||
+                               parts.part_begin(p).block_offset() == 0);
+                    for ( ; !reader.empty(); ++reader, ++i)
+                        die_unless(*reader == ValueType(i));
+                    die_unless(vec.cbegin() + i == parts.part_end(p));
+                    counts[p] = parts.part_end(p) - parts.part_begin(p);
+                });
+
+            uint64_t total = 0;
+            for (uint64_t c : counts)
+                total += c;
+            die_unless(total == vec.size() - first);
+        }
+    }
     {   // read vector using C++11 for loop construct
         foxxll::scoped_print_timer tm("C++11 bufreader for loop");
         using bufreader_type = typename vector_type::bufreader_type;
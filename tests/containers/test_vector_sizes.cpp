@@ -24,6 +24,9 @@
 using my_type = int;
 using vector_type = stxxl::vector<my_type>;
 using block_type = vector_type::block_type;
+#if STXXL_HAVE_MMAP_FILE
+using mapped_vector_type = stxxl::mapped_vector<my_type>;
+#endif
 
 void test_write(const char* fn, const char* ft, size_t sz, my_type ofs)
 {
@@ -66,11 +69,30 @@ void test_rdonly(const char* fn, const char* ft, size_t sz, my_type ofs)
     }
 }
 
+#if STXXL_HAVE_MMAP_FILE
+void test_mapped(const char* fn, size_t sz, my_type ofs)
+{
+    mapped_vector_type v(fn, mapped_vector_type::size_type(-1), mapped_vector_type::sequential);
+    LOG1 << "reading " << v.size() << " elements (mapped)";
+    die_unless(v.size() == sz);
+    my_type expected = ofs;
+    for (mapped_vector_type::const_iterator it = v.begin(); it != v.end(); ++it)
+        die_unless(*it == expected++);
+
+    v.advise(mapped_vector_type::random);
+    for (size_t i = 0; i < v.size(); i += 4099)
+        die_unless(v[i] == ofs + my_type(i));
+}
+#endif
+
 void test(const char* fn, const char* ft, size_t sz, my_type ofs)
 {
     test_write(fn, ft, sz, ofs);
     test_rdwr<const vector_type>(fn, ft, sz, ofs);
     test_rdwr<vector_type>(fn, ft, sz, ofs);
+#if STXXL_HAVE_MMAP_FILE
+    test_mapped(fn, sz, ofs);
+#endif
 
     // 2013-tb: there is a bug with read-only vectors on mmap backed files:
     // copying from mmapped area will fail for invalid ranges at the end,
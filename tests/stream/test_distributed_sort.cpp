@@ -0,0 +1,118 @@
+/***************************************************************************
+ *  tests/stream/test_distributed_sort.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger/core.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+using vector_type = stxxl::vector<value_type>;
+using stream_type = stxxl::stream::streamify_traits<std::vector<value_type>::const_iterator>::stream_type;
+
+struct Cmp
+{
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        return a < b;
+    }
+    value_type min_value() const
+    {
+        return std::numeric_limits<value_type>::min();
+    }
+    value_type max_value() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+};
+
+//! sorts the inputs with one thread per input, and checks that the
+//! concatenated outputs are the sorted union of the inputs
+void test_distributed_sort(const std::vector<std::vector<value_type> >& inputs, size_t memory)
+{
+    const size_t num_procs = inputs.size();
+    TLX_LOG1 << "distributed_sort with " << num_procs << " processes";
+
+    stxxl::stream::local_communicator_group group(num_procs);
+    std::vector<vector_type> outputs(num_procs);
+    std::vector<size_t> sizes(num_procs);
+
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < num_procs; ++p)
+    {
+        threads.emplace_back(
+            [&, p]() {
+                stream_type input = stxxl::stream::streamify(inputs[p].cbegin(), inputs[p].cend());
+                sizes[p] = stxxl::stream::distributed_sort(
+                    input, Cmp(), memory, group[p], outputs[p]);
+            });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    std::vector<value_type> expected;
+    for (const std::vector<value_type>& input : inputs)
+        expected.insert(expected.end(), input.begin(), input.end());
+    std::sort(expected.begin(), expected.end());
+
+    std::vector<value_type> result;
+    for (size_t p = 0; p < num_procs; ++p)
+    {
+        die_unequal(sizes[p], outputs[p].size());
+        TLX_LOG1 << "process " << p << " has " << sizes[p] << " elements";
+        for (vector_type::bufreader_type reader(outputs[p]); !reader.empty(); ++reader)
+            result.push_back(*reader);
+    }
+    die_unless(result == expected);
+}
+
+int main()
+{
+    const size_t memory = 8 * 1024 * 1024;
+    const size_t n = 400000;
+
+    std::mt19937_64 rng(42);
+    {
+        // random inputs of different sizes
+        std::vector<std::vector<value_type> > inputs(4);
+        for (size_t p = 0; p < inputs.size(); ++p)
+            for (size_t i = 0; i < n * (p + 1) / 2; ++i)
+                inputs[p].push_back(rng());
+        test_distributed_sort(inputs, memory);
+    }
+    {
+        // one empty input, and few distinct values
+        std::vector<std::vector<value_type> > inputs(3);
+        for (size_t i = 0; i < n; ++i)
+            inputs[1 + i % 2].push_back(rng() % 5);
+        test_distributed_sort(inputs, memory);
+    }
+    {
+        // all inputs empty
+        std::vector<std::vector<value_type> > inputs(3);
+        test_distributed_sort(inputs, memory);
+    }
+    {
+        // a single process
+        std::vector<std::vector<value_type> > inputs(1);
+        for (size_t i = 0; i < n; ++i)
+            inputs[0].push_back(rng());
+        test_distributed_sort(inputs, memory);
+    }
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+/***************************************************************************
+ *  tests/stream/test_hash_aggregate.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng/config.hpp>
+
+#include <stxxl/stream>
+
+using pair_type = std::pair<uint64_t, uint64_t>;
+
+//! stream of n pairs (key, 1) with keys cycling through groups values
+class key_stream
+{
+public:
+    using value_type = pair_type;
+
+    key_stream(uint64_t n, uint64_t groups)
+        : m_current(0, 1), m_index(0), m_n(n), m_groups(groups)
+    { }
+
+    const value_type& operator * () const
+    {
+        return m_current;
+    }
+
+    key_stream& operator ++ ()
+    {
+        ++m_index;
+        // scatter the keys over the groups
+        m_current.first = (m_index * 7919) % m_groups;
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return m_index >= m_n;
+    }
+
+private:
+    value_type m_current;
+    uint64_t m_index, m_n, m_groups;
+};
+
+struct add
+{
+    uint64_t operator () (const uint64_t& a, const uint64_t& b) const
+    {
+        return a + b;
+    }
+};
+
+//! hash function mapping all keys to the same value
+struct constant_hash
+{
+    size_t operator () (const uint64_t&) const
+    {
+        return 42;
+    }
+};
+
+const size_t block_size = 4096;
+
+//! memory for the blocks of the partitions and about entries keys
+size_t memory_for(size_t entries)
+{
+    return (16 + 2 * foxxll::config::get_instance()->disks_number()) * block_size
+           + entries * 64;
+}
+
+template <typename Hash>
+void test_aggregate(uint64_t n, uint64_t groups, size_t memory_to_use,
+                    bool expect_spill)
+{
+    LOG1 << "aggregating " << n << " pairs of " << groups << " groups";
+
+    using aggregate_type = stxxl::stream::hash_aggregate<
+              key_stream, add, Hash, std::equal_to<uint64_t>, block_size>;
+
+    key_stream input(n, groups);
+    aggregate_type output(input, add(), memory_to_use);
+
+    std::vector<uint64_t> counts(groups, 0);
+    uint64_t total = 0;
+    for ( ; !output.empty(); ++output)
+    {
+        die_unless(output->first < groups);
+        die_unequal(counts[output->first], 0u);
+        counts[output->first] = output->second;
+        total += output->second;
+    }
+    die_unequal(total, n);
+
+    for (uint64_t k = 0; k < groups; ++k)
+        die_unequal(counts[k], n / groups + (k < n % groups ? 1 : 0));
+
+    LOG1 << "spilled " << output.spilled() << " pairs";
+    die_unequal(output.spilled() != 0, expect_spill);
+}
+
+int main()
+{
+    // the groups fit into memory: no I/O
+    test_aggregate<std::hash<uint64_t> >(1000000, 1000, memory_for(10000), false);
+    test_aggregate<std::hash<uint64_t> >(0, 1, memory_for(100), false);
+
+    // recursive partitioning
+    test_aggregate<std::hash<uint64_t> >(300000, 100000, memory_for(100), true);
+    test_aggregate<std::hash<uint64_t> >(1000000, 20000, memory_for(1000), true);
+
+    // keys which cannot be partitioned by their hash values
+    test_aggregate<constant_hash>(10000, 2000, memory_for(100), true);
+
+    return 0;
+}
@@ -13,6 +13,8 @@
 
 #define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
 
+#include <cstdint>
+#include <numeric>
 #include <vector>
 
 #include <tlx/die.hpp>
@@ -160,4 +162,39 @@ int main()
         stxxl::stream::materialize(_42mill.reset(), v.begin(), v.end(), 42);
         check_42_fill(v, _42mill.len());
     }
+    {
+        // materialize batches of streamify into stxxl vector
+        std::vector<int> input(42 * 10000);
+        std::iota(input.begin(), input.end(), 0);
+        stxxl::vector<int> v(60 * 10000);
+        stxxl::generate(v.begin(), v.end(), generate_0, 42);
+
+        auto in = stxxl::stream::streamify(input.begin(), input.end());
+        stxxl::stream::materialize(in, v.begin());
+        check_42_fill(v, input.size());
+
+        auto in_range = stxxl::stream::streamify(input.begin(), input.end());
+        stxxl::stream::materialize(in_range, v.begin(), v.begin() + 1000);
+        die_unless(!in_range.empty());
+        check_42_fill(v, 1000);
+    }
+    {
+        forty_two _42mill(42 * 10000);
+
+        // materialize into stxxl vector of another value type
+        stxxl::vector<int64_t> v(60 * 10000);
+        stxxl::generate(v.begin(), v.end(), generate_0, 42);
+
+        stxxl::stream::materialize(_42mill.reset(), v.begin());
+        check_42_fill(v, _42mill.len());
+    }
+    {
+        forty_two _42mill(42 * 10000);
+
+        // append to stxxl vector, which grows while the stream is read
+        stxxl::vector<int> v;
+        stxxl::stream::materialize(_42mill.reset(), v);
+        die_unequal(v.size(), _42mill.len());
+        check_42_fill(v, _42mill.len());
+    }
 }
@@ -0,0 +1,168 @@
+/***************************************************************************
+ *  tests/stream/test_memory_budget.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <limits>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+
+using value_type = uint64_t;
+using stxxl::stream::memory_budget;
+
+//! stream of size pseudo-random values
+class random_stream
+{
+public:
+    using value_type = ::value_type;
+
+    explicit random_stream(uint64_t size)
+        : m_current(1), m_index(0), m_size(size)
+    { }
+
+    const value_type& operator * () const
+    {
+        return m_current;
+    }
+
+    random_stream& operator ++ ()
+    {
+        m_current = m_current * 6364136223846793005ull + 1442695040888963407ull;
+        ++m_index;
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return m_index >= m_size;
+    }
+
+private:
+    value_type m_current;
+    uint64_t m_index, m_size;
+};
+
+template <bool Descending>
+struct Cmp
+{
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        return Descending ? b < a : a < b;
+    }
+    value_type min_value() const
+    {
+        return Descending ? std::numeric_limits<value_type>::max()
+               : std::numeric_limits<value_type>::min();
+    }
+    value_type max_value() const
+    {
+        return Descending ? std::numeric_limits<value_type>::min()
+               : std::numeric_limits<value_type>::max();
+    }
+};
+
+void test_planning()
+{
+    {
+        // independent stages share the memory beyond their minimums
+        memory_budget budget(100);
+        memory_budget::stage_id a = budget.add_stage(10);
+        memory_budget::stage_id b = budget.add_stage(20);
+        die_unequal(budget.planned(a), 45u);
+        die_unequal(budget.acquire(a), 45u);
+        die_unequal(budget.acquire(b), 55u);
+        die_unequal(budget.available(), 0u);
+        budget.release(a);
+        die_unequal(budget.available(), 45u);
+        budget.release(b);
+        die_unequal(budget.available(), 100u);
+    }
+    {
+        // the merger inherits the memory of its runs creator
+        memory_budget budget(100);
+        memory_budget::stage_id creator = budget.add_stage(10);
+        memory_budget::stage_id merger =
+            budget.add_stage(30, memory_budget::unlimited, creator);
+        memory_budget::stage_id other = budget.add_stage(10, 20);
+        die_unequal(budget.acquire(creator), 80u);
+        die_unequal(budget.acquire(other), 20u);
+        budget.release(creator);
+        die_unequal(budget.acquire(merger), 80u);
+        budget.release(other);
+        budget.release(merger);
+        die_unequal(budget.available(), 100u);
+    }
+    {
+        // memory beyond the desired amount returns to the budget
+        memory_budget budget(100);
+        memory_budget::stage_id creator = budget.add_stage(10);
+        memory_budget::stage_id merger =
+            budget.add_stage(30, memory_budget::unlimited, creator);
+        die_unequal(budget.acquire(creator), 100u);
+        budget.release(creator);
+        budget.set_desired(merger, 50);
+        die_unequal(budget.acquire(merger), 50u);
+        die_unequal(budget.available(), 50u);
+    }
+    {
+        memory_budget budget(10);
+        memory_budget::stage_id a = budget.add_stage(20);
+        bool thrown = false;
+        try {
+            budget.acquire(a);
+        }
+        catch (const foxxll::bad_parameter&) {
+            thrown = true;
+        }
+        die_unless(thrown);
+    }
+}
+
+//! sorts n values ascending and the result descending with two sorters
+//! sharing one budget
+void test_pipeline(uint64_t n, size_t total_memory)
+{
+    LOG1 << "pipeline of two sorts of " << n << " values";
+
+    using sort1_type = stxxl::stream::sort<random_stream, Cmp<false> >;
+    using sort2_type = stxxl::stream::sort<sort1_type, Cmp<true> >;
+
+    memory_budget budget(total_memory);
+    {
+        random_stream input(n);
+        sort1_type sort1(input, Cmp<false>(), budget);
+        sort2_type sort2(sort1, Cmp<true>(), budget);
+        die_unless(sort1.empty());
+
+        uint64_t count = 0;
+        value_type last = std::numeric_limits<value_type>::max();
+        for ( ; !sort2.empty(); ++sort2, ++count)
+        {
+            die_unless(*sort2 <= last);
+            last = *sort2;
+        }
+        die_unequal(count, n);
+        die_unequal(budget.available(), total_memory);
+    }
+    die_unequal(budget.available(), total_memory);
+}
+
+int main()
+{
+    test_planning();
+
+    test_pipeline(0, 64 * 1024 * 1024);
+    test_pipeline(100000, 64 * 1024 * 1024);
+    test_pipeline(10000000, 128 * 1024 * 1024);
+
+    return 0;
+}
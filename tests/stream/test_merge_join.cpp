@@ -0,0 +1,90 @@
+/***************************************************************************
+ *  tests/stream/test_merge_join.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger/core.hpp>
+
+#include <stxxl/stream>
+
+// edges (source, target) joined on target of the first and source of the
+// second input
+using edge_type = std::pair<uint32_t, uint32_t>;
+using edges_type = std::vector<edge_type>;
+using stream_type = stxxl::stream::streamify_traits<edges_type::const_iterator>::stream_type;
+
+struct key_target
+{
+    uint32_t operator () (const edge_type& e) const { return e.second; }
+};
+
+struct key_source
+{
+    uint32_t operator () (const edge_type& e) const { return e.first; }
+};
+
+using join_type = stxxl::stream::merge_join<stream_type, stream_type, key_target, key_source>;
+
+//! join by nested loops
+std::vector<join_type::value_type>
+nested_loop_join(const edges_type& a, const edges_type& b)
+{
+    std::vector<join_type::value_type> out;
+    for (const edge_type& x : a)
+        for (const edge_type& y : b)
+            if (x.second == y.first)
+                out.emplace_back(x, y);
+    return out;
+}
+
+void test_join(size_t na, size_t nb, uint32_t nkeys, size_t group_memory)
+{
+    TLX_LOG1 << "merge_join of " << na << " x " << nb << " edges with "
+             << nkeys << " keys and " << group_memory << " bytes group memory";
+
+    std::mt19937 rng(na + nb + nkeys);
+    edges_type a(na), b(nb);
+    for (edge_type& e : a)
+        e = edge_type(rng() % 1000, rng() % nkeys);
+    for (edge_type& e : b)
+        e = edge_type(rng() % nkeys, rng() % 1000);
+
+    std::stable_sort(a.begin(), a.end(),
+                     [](const edge_type& x, const edge_type& y) { return x.second < y.second; });
+    std::stable_sort(b.begin(), b.end(),
+                     [](const edge_type& x, const edge_type& y) { return x.first < y.first; });
+
+    stream_type sa = stxxl::stream::streamify(a.cbegin(), a.cend());
+    stream_type sb = stxxl::stream::streamify(b.cbegin(), b.cend());
+    join_type join(sa, sb, key_target(), key_source(), group_memory);
+
+    std::vector<join_type::value_type> out;
+    for ( ; !join.empty(); ++join)
+        out.push_back(*join);
+
+    die_unless(out == nested_loop_join(a, b));
+}
+
+int main()
+{
+    test_join(0, 100, 10, 1024);
+    test_join(100, 0, 10, 1024);
+    test_join(1000, 1000, 100, 1024 * 1024);
+    test_join(1000, 1000, 1000000, 1024 * 1024);
+    // large groups of the second input spill to disk
+    test_join(100, 100000, 10, 1024);
+    test_join(20, 100000, 1, 64 * 1024);
+
+    return 0;
+}
@@ -0,0 +1,211 @@
+/***************************************************************************
+ *  tests/stream/test_parallel_transform.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+
+using value_type = uint64_t;
+
+//! stream of the values 0, ..., size - 1, which throws when reaching throw_at
+class sequence_stream
+{
+public:
+    using value_type = ::value_type;
+
+    explicit sequence_stream(value_type size, value_type throw_at = ~value_type(0))
+        : m_current(0), m_size(size), m_throw_at(throw_at)
+    { }
+
+    const value_type& operator * () const
+    {
+        return m_current;
+    }
+
+    sequence_stream& operator ++ ()
+    {
+        if (++m_current == m_throw_at)
+            throw std::runtime_error("input failed");
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return m_current >= m_size;
+    }
+
+private:
+    value_type m_current, m_size, m_throw_at;
+};
+
+//! functor mixing the bits of its argument, which throws when reaching throw_at
+struct mix
+{
+    using value_type = ::value_type;
+
+    value_type throw_at;
+
+    value_type operator () (const value_type& x) const
+    {
+        if (x == throw_at)
+            throw std::runtime_error("functor failed");
+        return x * 0x9E3779B97F4A7C15ull + 12345;
+    }
+};
+
+void test_parallel_transform(size_t n, size_t num_threads, size_t batch_size)
+{
+    LOG1 << "parallel_transform of " << n << " values with " << num_threads
+         << " threads, batches of " << batch_size;
+
+    sequence_stream input(n);
+    mix op { ~value_type(0) };
+    stxxl::stream::parallel_transform<mix, sequence_stream> output(
+        op, input, num_threads, batch_size);
+
+    size_t count = 0;
+    for ( ; !output.empty(); ++output, ++count)
+        die_unequal(*output, op(count));
+    die_unequal(count, n);
+}
+
+void test_async_buffer(size_t n, size_t batch_size, size_t num_batches)
+{
+    LOG1 << "async_buffer of " << n << " values in " << num_batches
+         << " batches of " << batch_size;
+
+    sequence_stream input(n);
+    stxxl::stream::async_buffer<sequence_stream> output(input, batch_size, num_batches);
+
+    size_t count = 0;
+    for ( ; !output.empty(); ++output, ++count)
+        die_unequal(*output, count);
+    die_unequal(count, n);
+}
+
+//! runs the stream to its end and returns the number of values read before
+//! an exception was thrown
+template <typename Stream>
+size_t count_until_exception(Stream& s)
+{
+    size_t count = 0;
+    try
+    {
+        for ( ; !s.empty(); ++s)
+            ++count;
+    }
+    catch (const std::exception&)
+    {
+        return count;
+    }
+    die("no exception thrown");
+    return count;
+}
+
+//! reads the stream by batches and returns the number of values read before
+//! an exception was thrown
+template <typename Stream>
+size_t count_batches_until_exception(Stream& s)
+{
+    std::vector<value_type> batch(300);
+    size_t count = 0, k;
+    try
+    {
+        while ((k = s.next_batch(batch.data(), batch.size())) != 0)
+            count += k;
+    }
+    catch (const std::exception&)
+    {
+        return count;
+    }
+    die("no exception thrown");
+    return count;
+}
+
+int main()
+{
+    for (size_t n : { 0, 1, 100, 4096, 4097, 1000000 })
+    {
+        test_parallel_transform(n, 4, 4096);
+        test_async_buffer(n, 4096, 4);
+    }
+    test_parallel_transform(100000, 1, 1);
+    test_parallel_transform(100000, 16, 7);
+    test_parallel_transform(100000, 0, 1000);
+    test_async_buffer(100000, 1, 2);
+
+    {
+        // a pipeline with both stages
+        sequence_stream input(500000);
+        stxxl::stream::async_buffer<sequence_stream> buffer(input);
+        mix op { ~value_type(0) };
+        stxxl::stream::parallel_transform<mix, stxxl::stream::async_buffer<sequence_stream> >
+        output(op, buffer, 4, 1000);
+
+        size_t count = 0;
+        for ( ; !output.empty(); ++output, ++count)
+            die_unequal(*output, op(count));
+        die_unequal(count, 500000u);
+    }
+
+    {
+        // exceptions of the input and of the functor reach the consumer in order
+        sequence_stream input(100000, 50000);
+        mix op { ~value_type(0) };
+        stxxl::stream::parallel_transform<mix, sequence_stream> output(op, input, 4, 1000);
+        die_unequal(count_until_exception(output), 50000u);
+    }
+    {
+        sequence_stream input(100000);
+        mix op { 70000 };
+        stxxl::stream::parallel_transform<mix, sequence_stream> output(op, input, 4, 1000);
+        die_unequal(count_until_exception(output), 70000u);
+    }
+    {
+        sequence_stream input(100000, 30000);
+        stxxl::stream::async_buffer<sequence_stream> output(input, 1000);
+        die_unequal(count_until_exception(output), 30000u);
+    }
+    {
+        sequence_stream input(100000);
+        mix op { 70000 };
+        stxxl::stream::parallel_transform<mix, sequence_stream> output(op, input, 4, 1000);
+        die_unequal(count_batches_until_exception(output), 70000u);
+    }
+    {
+        sequence_stream input(100000, 30000);
+        stxxl::stream::async_buffer<sequence_stream> output(input, 1000);
+        die_unequal(count_batches_until_exception(output), 30000u);
+    }
+    {
+        // the input fails after a full batch
+        sequence_stream input(100000, 30000);
+        stxxl::stream::async_buffer<sequence_stream> output(input, 30000);
+        die_unequal(count_batches_until_exception(output), 30000u);
+    }
+
+    {
+        // destroying a stage before its end stops the threads
+        sequence_stream input(1000000);
+        mix op { ~value_type(0) };
+        stxxl::stream::parallel_transform<mix, sequence_stream> output(op, input, 4, 100);
+        stxxl::stream::async_buffer<stxxl::stream::parallel_transform<mix, sequence_stream> >
+        buffer(output, 100);
+        for (size_t i = 0; i < 1000; ++i, ++buffer)
+            die_unequal(*buffer, op(i));
+    }
+
+    return 0;
+}
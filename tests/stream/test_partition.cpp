@@ -0,0 +1,174 @@
+/***************************************************************************
+ *  tests/stream/test_partition.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+
+using value_type = uint64_t;
+
+//! stream of size pseudo-random values
+class random_stream
+{
+public:
+    using value_type = ::value_type;
+
+    explicit random_stream(value_type size)
+        : m_rng(size), m_index(0), m_size(size)
+    {
+        m_current = m_rng();
+    }
+
+    const value_type& operator * () const
+    {
+        return m_current;
+    }
+
+    random_stream& operator ++ ()
+    {
+        ++m_index;
+        m_current = m_rng();
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return m_index >= m_size;
+    }
+
+private:
+    std::mt19937_64 m_rng;
+    value_type m_current, m_index, m_size;
+};
+
+struct modulo_router
+{
+    size_t k;
+
+    size_t operator () (const value_type& x) const
+    {
+        return static_cast<size_t>(x % k);
+    }
+};
+
+struct Cmp
+{
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        return a < b;
+    }
+    value_type min_value() const
+    {
+        return std::numeric_limits<value_type>::min();
+    }
+    value_type max_value() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+};
+
+const size_t block_size = 4096;
+
+using partition_type = stxxl::stream::partition<random_stream, modulo_router, block_size>;
+
+//! partitions n values into k partitions and checks that each holds the
+//! values routed to it in the order of the input
+void test_partition(value_type n, size_t k, size_t memory_to_use)
+{
+    LOG1 << "partitioning " << n << " values into " << k << " partitions";
+
+    random_stream input(n);
+    partition_type parts(input, modulo_router { k }, k, memory_to_use);
+    die_unless(input.empty());
+    die_unequal(parts.num_partitions(), k);
+    die_unequal(parts.size(), n);
+
+    // expected values of each partition
+    std::vector<std::vector<value_type> > expected(k);
+    for (random_stream check(n); !check.empty(); ++check)
+        expected[*check % k].push_back(*check);
+
+    for (size_t i = 0; i < k; ++i)
+    {
+        die_unequal(parts.size(i), expected[i].size());
+
+        partition_type::output_type out = parts.output(i);
+        size_t count = 0;
+        for ( ; !out.empty(); ++out, ++count)
+            die_unequal(*out, expected[i][count]);
+        die_unequal(count, expected[i].size());
+    }
+
+    // outputs of different partitions may be read at the same time
+    if (k >= 2)
+    {
+        partition_type::output_type a = parts.output(0), b = parts.output(1);
+        for (size_t count = 0; !a.empty() || !b.empty(); ++count)
+        {
+            if (!a.empty())
+            {
+                die_unequal(*a, expected[0][count]);
+                ++a;
+            }
+            if (!b.empty())
+            {
+                die_unequal(*b, expected[1][count]);
+                ++b;
+            }
+        }
+    }
+
+    parts.release(0);
+    die_unequal(parts.size(0), 0u);
+    die_unless(parts.output(0).empty());
+    die_unequal(parts.size(), n - expected[0].size());
+}
+
+int main()
+{
+    test_partition(0, 4, 16 * block_size);
+    test_partition(100000, 1, 16 * block_size);
+    test_partition(100000, 7, 16 * block_size);
+    test_partition(100000, 100, 0);
+    test_partition(1000000, 16, 64 * block_size);
+
+    {
+        // hash-partitioned sort: each partition is sorted separately
+        const size_t n = 300000, k = 4;
+        random_stream input(n);
+        partition_type parts(input, modulo_router { k }, k, 16 * block_size);
+
+        size_t total = 0;
+        for (size_t i = 0; i < k; ++i)
+        {
+            using sort_type = stxxl::stream::sort<partition_type::output_type, Cmp, block_size>;
+            partition_type::output_type out = parts.output(i);
+            sort_type sorted(out, Cmp(), 64 * block_size);
+            parts.release(i);
+
+            value_type prev = 0;
+            for ( ; !sorted.empty(); ++sorted, ++total)
+            {
+                die_unless(prev <= *sorted);
+                die_unequal(*sorted % k, i);
+                prev = *sorted;
+            }
+        }
+        die_unequal(total, n);
+    }
+
+    return 0;
+}
@@ -21,10 +21,13 @@
 
 #include <limits>
 #include <random>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
 
+#include <foxxll/io/iostats.hpp>
+
 #include <stxxl/bits/defines.h>
 #include <stxxl/stream>
 
@@ -49,25 +52,50 @@ struct Cmp : public std::binary_function<value_type, value_type, bool>
     }
 };
 
+// radix sort the runs by the upper half of the value only
+struct KeyPrefix
+{
+    using key_type = unsigned;
+    key_type operator () (const value_type& v) const
+    {
+        return v >> 16;
+    }
+};
+
 // special parameter type
 using InputType = stxxl::stream::use_push<value_type>;
 using CreateRunsAlg = stxxl::stream::runs_creator<
           InputType, Cmp, 4096, foxxll::random_cyclic>;
 using SortedRunsType = CreateRunsAlg::sorted_runs_type;
 
+using CreateRunsKeyAlg = stxxl::stream::runs_creator<
+          InputType, Cmp, 4096, foxxll::random_cyclic, KeyPrefix>;
+
+using CreateRunsCompressedAlg = stxxl::stream::runs_creator<
+          InputType, Cmp, 4096, foxxll::random_cyclic,
+          stxxl::stream::no_key_extractor,
+          stxxl::stream::delta_varint_codec<value_type> >;
+
+using CreateRunsReplacementAlg = stxxl::stream::runs_creator<
+          stxxl::stream::use_replacement_selection<value_type>,
+          Cmp, 4096, foxxll::random_cyclic>;
+
+using CreateRunsSampleSortAlg = stxxl::stream::runs_creator<
+          stxxl::stream::use_sample_sort<value_type>,
+          Cmp, 4096, foxxll::random_cyclic>;
+
 // forced instantiation
 template class stxxl::stream::runs_merger<SortedRunsType, Cmp>;
 
-int main()
+template <typename RunsCreator>
+void test_push_sort()
 {
-#if STXXL_PARALLEL_MULTIWAY_MERGE
-    LOG1 << "STXXL_PARALLEL_MULTIWAY_MERGE";
-#endif
+    using RunsType = typename RunsCreator::sorted_runs_type;
 
     unsigned input_size = (10 * megabyte / sizeof(value_type));
 
     Cmp c;
-    CreateRunsAlg SortedRuns(c, 10 * megabyte);
+    RunsCreator SortedRuns(c, 10 * megabyte);
     value_type checksum_before(0);
 
     std::mt19937 rnd;
@@ -80,11 +108,11 @@ int main()
         SortedRuns.push(element);               // push into the sorter
     }
 
-    SortedRunsType Runs = SortedRuns.result();  // get sorted_runs data structure
+    RunsType Runs = SortedRuns.result();        // get sorted_runs data structure
     die_unless(stxxl::stream::check_sorted_runs(Runs, Cmp()));
 
     // merge the runs
-    stxxl::stream::runs_merger<SortedRunsType, Cmp> merger(Runs, Cmp(), 10 * megabyte);
+    stxxl::stream::runs_merger<RunsType, Cmp> merger(Runs, Cmp(), 10 * megabyte);
     stxxl::vector<value_type, 4, stxxl::lru_pager<8> > array;
     LOG1 << input_size << " " << Runs->elements;
     LOG1 << "checksum before: " << checksum_before;
@@ -99,6 +127,108 @@ int main()
     die_unless(stxxl::is_sorted(array.cbegin(), array.cend(), Cmp()));
     die_unless(checksum_before == checksum_after);
     die_unless(merger.empty());
+}
+
+// replacement selection forms a single run of nearly sorted input
+void test_replacement_selection_presorted()
+{
+    using RunsType = CreateRunsReplacementAlg::sorted_runs_type;
+
+    unsigned input_size = (10 * megabyte / sizeof(value_type));
+
+    Cmp c;
+    CreateRunsReplacementAlg SortedRuns(c, megabyte);
+
+    std::mt19937 rnd;
+    std::uniform_int_distribution<value_type> distr(0, 1024);
+
+    for (unsigned cnt = 0; cnt < input_size; ++cnt)
+        SortedRuns.push(16 * cnt + distr(rnd));
+
+    RunsType Runs = SortedRuns.result();
+    die_unless(stxxl::stream::check_sorted_runs(Runs, Cmp()));
+    die_unless(Runs->elements == input_size);
+    die_unless(Runs->runs.size() == 1);
+}
+
+// inputs fitting into the run buffers are sorted without any I/O
+void test_in_memory_sort()
+{
+    using RunsType = CreateRunsAlg::sorted_runs_type;
+    using stream_type = stxxl::stream::streamify_traits<std::vector<value_type>::const_iterator>::stream_type;
+    using StreamSortAlg = stxxl::stream::sort<stream_type, Cmp, 4096>;
+
+    stxxl::SETTINGS::in_memory_sort = true;
+
+    for (unsigned input_size : { 1000u, unsigned(megabyte), unsigned(8 * megabyte) })
+    {
+        std::mt19937 rnd(input_size);
+        std::vector<value_type> input(input_size);
+        for (value_type& x : input)
+            x = rnd() % (std::numeric_limits<value_type>::max() - 1);
+        std::vector<value_type> expected = input;
+        std::sort(expected.begin(), expected.end());
+
+        // the 32 MiB of the last input exceed the memory
+        const bool fits = input_size * sizeof(value_type) <= 4 * megabyte;
+
+        foxxll::stats_data stats_begin(*foxxll::stats::get_instance());
+
+        CreateRunsAlg SortedRuns(Cmp(), 16 * megabyte);
+        for (const value_type& x : input)
+            SortedRuns.push(x);
+        die_unless(SortedRuns.size() == input_size);
+
+        RunsType Runs = SortedRuns.result();
+        die_unless(Runs->elements == input_size);
+        die_unless(Runs->runs.empty() == fits);
+
+        stxxl::stream::runs_merger<RunsType, Cmp> merger(Runs, Cmp(), 16 * megabyte);
+        for (const value_type& x : expected)
+        {
+            die_unless(*merger == x);
+            ++merger;
+        }
+        die_unless(merger.empty());
+
+        stream_type in = stxxl::stream::streamify(input.cbegin(), input.cend());
+        StreamSortAlg sorter(in, Cmp(), 16 * megabyte);
+        for (const value_type& x : expected)
+        {
+            die_unless(*sorter == x);
+            ++sorter;
+        }
+        die_unless(sorter.empty());
+
+        foxxll::stats_data stats_elapsed =
+            foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+        LOG1 << input_size << " elements sorted with " << stats_elapsed.get_write_count() << " writes";
+        if (fits)
+            die_unless(stats_elapsed.get_write_count() == 0);
+    }
+
+    stxxl::SETTINGS::in_memory_sort = false;
+}
+
+int main()
+{
+#if STXXL_PARALLEL_MULTIWAY_MERGE
+    LOG1 << "STXXL_PARALLEL_MULTIWAY_MERGE";
+#endif
+
+    test_push_sort<CreateRunsAlg>();
+    test_push_sort<CreateRunsKeyAlg>();
+    test_push_sort<CreateRunsCompressedAlg>();
+    test_push_sort<CreateRunsReplacementAlg>();
+    test_replacement_selection_presorted();
+    test_push_sort<CreateRunsSampleSortAlg>();
+
+    // sort and write runs, and merge ahead, in background threads
+    stxxl::SETTINGS::async_pipelining = true;
+    test_push_sort<CreateRunsAlg>();
+    stxxl::SETTINGS::async_pipelining = false;
+
+    test_in_memory_sort();
 
     return 0;
 }
@@ -0,0 +1,236 @@
+/***************************************************************************
+ *  tests/stream/test_set_ops.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#define STXXL_DEFAULT_BLOCK_SIZE(T) 4096
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger/core.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+using vector_type = stxxl::vector<value_type>;
+using stream_type = stxxl::stream::streamify_traits<vector_type::const_iterator>::stream_type;
+
+struct cmp_less : public std::less<value_type>
+{ };
+
+//! fill v with n sorted random values below max, also copy them to ref
+void fill_sorted(vector_type& v, std::vector<value_type>& ref,
+                 size_t n, value_type max, std::mt19937_64& rng)
+{
+    ref.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        ref[i] = rng() % max;
+    std::sort(ref.begin(), ref.end());
+
+    v.resize(n);
+    std::copy(ref.begin(), ref.end(), v.begin());
+}
+
+template <typename StreamType>
+std::vector<value_type> collect(StreamType& s)
+{
+    std::vector<value_type> out;
+    for ( ; !s.empty(); ++s)
+        out.push_back(*s);
+    return out;
+}
+
+void test_merge(size_t k, size_t n, std::mt19937_64& rng)
+{
+    TLX_LOG1 << "merge of " << k << " vectors";
+
+    std::vector<vector_type> vectors(k);
+    std::vector<value_type> all, ref;
+    for (size_t i = 0; i < k; ++i)
+    {
+        fill_sorted(vectors[i], ref, n + i * 1000, 10 * n, rng);
+        all.insert(all.end(), ref.begin(), ref.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    std::vector<stream_type> streams;
+    streams.reserve(k);
+    std::vector<stream_type*> inputs;
+    for (size_t i = 0; i < k; ++i)
+    {
+        streams.push_back(stxxl::stream::streamify(vectors[i].cbegin(), vectors[i].cend()));
+        inputs.push_back(&streams.back());
+    }
+
+    {
+        // materialize the merge into a vector
+        stxxl::stream::merge<stream_type, cmp_less> merged(inputs, cmp_less());
+        vector_type out(all.size());
+        stxxl::stream::materialize(merged, out.begin(), out.end());
+        die_unless(merged.empty());
+        die_unless(std::equal(all.begin(), all.end(), out.cbegin()));
+    }
+
+    for (size_t i = 0; i < k; ++i)
+        streams[i] = stxxl::stream::streamify(vectors[i].cbegin(), vectors[i].cend());
+
+    {
+        stxxl::stream::set_union<stream_type, cmp_less> united(inputs, cmp_less());
+        all.erase(std::unique(all.begin(), all.end()), all.end());
+        die_unless(collect(united) == all);
+    }
+}
+
+//! check that equal elements are delivered in the order of their inputs
+void test_merge_ties(size_t k, size_t n, std::mt19937_64& rng)
+{
+    TLX_LOG1 << "merge of " << k << " inputs with equal keys";
+
+    // pairs of a key and the number of the input and position in it
+    using pair_type = std::pair<value_type, value_type>;
+    struct key_less
+    {
+        bool operator () (const pair_type& a, const pair_type& b) const
+        {
+            return a.first < b.first;
+        }
+    };
+
+    std::vector<std::vector<pair_type> > vectors(k);
+    std::vector<pair_type> all;
+    for (size_t i = 0; i < k; ++i)
+    {
+        for (size_t j = 0; j < n; ++j)
+            vectors[i].emplace_back(rng() % 50, 0);
+        std::sort(vectors[i].begin(), vectors[i].end());
+        for (size_t j = 0; j < n; ++j)
+            vectors[i][j].second = i * n + j;
+        all.insert(all.end(), vectors[i].begin(), vectors[i].end());
+    }
+    std::stable_sort(all.begin(), all.end(), key_less());
+
+    using pair_stream_type = stxxl::stream::streamify_traits<
+        std::vector<pair_type>::const_iterator>::stream_type;
+    std::vector<pair_stream_type> streams;
+    streams.reserve(k);
+    std::vector<pair_stream_type*> inputs;
+    for (size_t i = 0; i < k; ++i)
+    {
+        streams.push_back(stxxl::stream::streamify(vectors[i].cbegin(), vectors[i].cend()));
+        inputs.push_back(&streams.back());
+    }
+
+    stxxl::stream::merge<pair_stream_type, key_less> merged(inputs, key_less());
+    for (const pair_type& p : all)
+    {
+        die_unless(!merged.empty());
+        die_unequal(merged->second, p.second);
+        ++merged;
+    }
+    die_unless(merged.empty());
+}
+
+void test_merge_streams(size_t n, std::mt19937_64& rng)
+{
+    TLX_LOG1 << "merge of streams of different types";
+
+    // an external vector, an internal vector and one of narrower values
+    vector_type a;
+    std::vector<value_type> ref_a, b, all;
+    fill_sorted(a, ref_a, n, n, rng);
+    for (size_t i = 0; i < n / 3; ++i)
+        b.push_back(rng() % n);
+    std::sort(b.begin(), b.end());
+    std::vector<uint32_t> c(n / 2);
+    for (size_t i = 0; i < c.size(); ++i)
+        c[i] = static_cast<uint32_t>(i * 2);
+
+    all = ref_a;
+    all.insert(all.end(), b.begin(), b.end());
+    all.insert(all.end(), c.begin(), c.end());
+    std::sort(all.begin(), all.end());
+
+    stream_type sa = stxxl::stream::streamify(a.cbegin(), a.cend());
+    auto sb = stxxl::stream::streamify(b.cbegin(), b.cend());
+    auto sc = stxxl::stream::streamify(c.cbegin(), c.cend());
+
+    stxxl::stream::merge_streams<cmp_less, stream_type, decltype(sb), decltype(sc)>
+    merged(cmp_less(), sa, sb, sc);
+    die_unless(collect(merged) == all);
+    die_unless(sa.empty() && sb.empty() && sc.empty());
+}
+
+void test_set_operations(size_t n, std::mt19937_64& rng)
+{
+    vector_type a, b;
+    std::vector<value_type> ref_a, ref_b, ref;
+    fill_sorted(a, ref_a, n, n, rng);
+    fill_sorted(b, ref_b, n / 2, n, rng);
+
+    {
+        stream_type sa = stxxl::stream::streamify(a.cbegin(), a.cend());
+        stream_type sb = stxxl::stream::streamify(b.cbegin(), b.cend());
+        stxxl::stream::set_intersection<stream_type, stream_type, cmp_less>
+        intersection(sa, sb, cmp_less());
+
+        ref.clear();
+        std::set_intersection(ref_a.begin(), ref_a.end(), ref_b.begin(), ref_b.end(),
+                              std::back_inserter(ref));
+        die_unless(collect(intersection) == ref);
+    }
+    {
+        stream_type sa = stxxl::stream::streamify(a.cbegin(), a.cend());
+        stream_type sb = stxxl::stream::streamify(b.cbegin(), b.cend());
+        stxxl::stream::set_difference<stream_type, stream_type, cmp_less>
+        difference(sa, sb, cmp_less());
+
+        ref.clear();
+        std::set_difference(ref_a.begin(), ref_a.end(), ref_b.begin(), ref_b.end(),
+                            std::back_inserter(ref));
+        die_unless(collect(difference) == ref);
+    }
+    {
+        stream_type sa = stxxl::stream::streamify(a.cbegin(), a.cend());
+        stream_type sb = stxxl::stream::streamify(b.cbegin(), b.cend());
+        stxxl::stream::set_union<stream_type, cmp_less> united(sa, sb, cmp_less());
+
+        ref.clear();
+        std::set_union(ref_a.begin(), ref_a.end(), ref_b.begin(), ref_b.end(),
+                       std::back_inserter(ref));
+        ref.erase(std::unique(ref.begin(), ref.end()), ref.end());
+        die_unless(collect(united) == ref);
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(42);
+
+    test_merge(1, 10000, rng);
+    test_merge(2, 10000, rng);
+    test_merge(7, 100000, rng);
+    test_merge(40, 1000, rng);
+
+    test_merge_ties(2, 1000, rng);
+    test_merge_ties(13, 1000, rng);
+
+    test_merge_streams(0, rng);
+    test_merge_streams(100000, rng);
+
+    test_set_operations(0, rng);
+    test_set_operations(100, rng);
+    test_set_operations(1000000, rng);
+
+    return 0;
+}
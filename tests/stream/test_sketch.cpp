@@ -0,0 +1,194 @@
+/***************************************************************************
+ *  tests/stream/test_sketch.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/comparator>
+#include <stxxl/sorter>
+#include <stxxl/stream>
+
+using value_type = uint64_t;
+using values_type = std::vector<value_type>;
+using stream_type = stxxl::stream::streamify_traits<values_type::const_iterator>::stream_type;
+
+//! maximum difference of the estimated and the true ranks of the quantiles
+//! of sorted, relative to its size
+double max_rank_error(const stxxl::kll_sketch<value_type>& sketch, const values_type& sorted)
+{
+    double error = 0;
+    for (size_t i = 0; i <= 100; ++i)
+    {
+        const double q = i / 100.0;
+        const value_type v = sketch.quantile(q);
+        const double lo = std::lower_bound(sorted.begin(), sorted.end(), v) - sorted.begin();
+        const double hi = std::upper_bound(sorted.begin(), sorted.end(), v) - sorted.begin();
+        const double target = q * sorted.size();
+        error = std::max(error, std::max(lo - target, target - hi) / sorted.size());
+
+        const double rank = static_cast<double>(sketch.rank(v));
+        error = std::max(error, std::fabs(rank - lo) / sorted.size());
+    }
+    return error;
+}
+
+void test_quantiles(size_t n, std::mt19937_64& rng)
+{
+    LOG1 << "kll_sketch of " << n << " values";
+
+    values_type values(n);
+    for (value_type& v : values)
+        v = rng() % (n / 2 + 1);
+    values_type sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+
+    // one sketch, and one per part merged
+    stxxl::kll_sketch<value_type> sketch;
+    for (const value_type& v : values)
+        sketch.insert(v);
+    die_unequal(sketch.size(), n);
+    die_unless(sketch.num_retained() < 2000);
+    die_unless(max_rank_error(sketch, sorted) < 0.02);
+
+    stxxl::kll_sketch<value_type> merged;
+    for (size_t p = 0; p < 4; ++p)
+    {
+        stxxl::kll_sketch<value_type> part(200, std::less<value_type>(), p + 1);
+        for (size_t i = p * n / 4; i < (p + 1) * n / 4; ++i)
+            part.insert(values[i]);
+        merged.merge(part);
+    }
+    die_unequal(merged.size(), n);
+    die_unless(max_rank_error(merged, sorted) < 0.02);
+
+    die_unequal(sketch.quantile(0), sorted.front());
+    die_unequal(sketch.quantile(1), sorted.back());
+}
+
+void test_cardinality(size_t distinct, std::mt19937_64& rng)
+{
+    LOG1 << "hyperloglog of " << distinct << " distinct values";
+
+    // each value up to three times, in random order
+    values_type values;
+    for (size_t i = 0; i < distinct; ++i)
+        values.insert(values.end(), 1 + rng() % 3, i);
+    std::shuffle(values.begin(), values.end(), rng);
+
+    stxxl::hyperloglog<value_type> hll;
+    std::vector<stxxl::hyperloglog<value_type> > parts(3);
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        hll.insert(values[i]);
+        parts[i % parts.size()].insert(values[i]);
+    }
+
+    const double error = 4 * 1.04 / std::sqrt(1 << hll.precision());
+    die_unless(std::fabs(hll.estimate() - distinct) <= error * distinct + 1);
+
+    // merging the parts gives the same registers
+    for (size_t p = 1; p < parts.size(); ++p)
+        parts[0].merge(parts[p]);
+    die_unequal(parts[0].estimate(), hll.estimate());
+}
+
+void test_stages(size_t n, std::mt19937_64& rng)
+{
+    LOG1 << "sketch stages feeding a sorter with " << n << " values";
+
+    values_type values(n);
+    for (value_type& v : values)
+        v = rng();
+
+    stream_type input = stxxl::stream::streamify(values.cbegin(), values.cend());
+    stxxl::stream::quantile_sketch<stream_type> quantiles(input);
+    stxxl::stream::cardinality_sketch<decltype(quantiles)> cardinality(quantiles);
+
+    using sorter_type = stxxl::sorter<value_type, stxxl::comparator<value_type> >;
+    sorter_type sorter(stxxl::comparator<value_type>(), 64 * 1024 * 1024);
+
+    // half by elements, half by batches
+    for (size_t i = 0; i < n / 2; ++i, ++cardinality)
+        sorter.push(*cardinality);
+    values_type batch(1000);
+    while (size_t count = stxxl::stream::next_batch(cardinality, batch.data(), batch.size()))
+    {
+        for (size_t i = 0; i < count; ++i)
+            sorter.push(batch[i]);
+    }
+    sorter.sort();
+
+    die_unequal(quantiles.get_sketch().size(), n);
+    die_unless(std::fabs(cardinality.get_sketch().estimate() - n) < 0.05 * n);
+
+    // partitions at the splitters of the sketch are of about equal size
+    const size_t num_partitions = 8;
+    std::vector<std::unique_ptr<sorter_type::partition_type> > partitions =
+        sorter.partitioned_output(quantiles.get_sketch().splitters(num_partitions));
+    die_unequal(partitions.size(), num_partitions);
+
+    value_type last = 0;
+    size_t total = 0;
+    for (size_t p = 0; p < num_partitions; ++p)
+    {
+        size_t count = 0;
+        for (sorter_type::partition_type& part = *partitions[p]; !part.empty(); ++part, ++count)
+        {
+            die_unless(last <= *part);
+            last = *part;
+        }
+        die_unless(std::fabs(static_cast<double>(count) - n / num_partitions) < 0.03 * n);
+        total += count;
+    }
+    die_unequal(total, n);
+}
+
+void test_errors()
+{
+    for (size_t k = 0; k < 3; ++k)
+    {
+        bool thrown = false;
+        try {
+            if (k == 0)
+                stxxl::kll_sketch<value_type> sketch(4);
+            else if (k == 1)
+                stxxl::hyperloglog<value_type> hll(20);
+            else
+                stxxl::hyperloglog<value_type>(10).merge(stxxl::hyperloglog<value_type>(12));
+        }
+        catch (const foxxll::bad_parameter&) {
+            thrown = true;
+        }
+        die_unless(thrown);
+    }
+}
+
+int main()
+{
+    std::mt19937_64 rng(42);
+
+    for (size_t n : { 1, 100, 10000, 1000000 })
+        test_quantiles(n, rng);
+    for (size_t distinct : { 0, 10, 1000, 100000, 1000000 })
+        test_cardinality(distinct, rng);
+    test_stages(1000000, rng);
+    test_errors();
+
+    LOG1 << "Test passed.";
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+/***************************************************************************
+ *  tests/stream/test_sort_vector_blocks.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <limits>
+#include <random>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+using value_type = uint64_t;
+
+struct Cmp
+{
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        return a < b;
+    }
+    value_type min_value() const
+    {
+        return std::numeric_limits<value_type>::min();
+    }
+    value_type max_value() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+};
+
+const size_t block_size = 4096;
+const size_t block_values = block_size / sizeof(value_type);
+const size_t memory_to_use = 64 * block_size;
+
+using vector_type = stxxl::vector<value_type, 4, stxxl::lru_pager<8>, block_size>;
+
+using input_stream_type = stxxl::stream::vector_iterator2stream<vector_type::const_iterator>;
+
+static_assert(stxxl::stream::has_next_blocks<
+                  input_stream_type, input_stream_type::block_type>::value,
+              "vector streams hand over whole blocks");
+
+//! sorts input[begin,end) by stream::sort with BlockSize into output[out,...)
+//! and checks the result
+template <size_t BlockSize>
+void test_sort(const vector_type& input, size_t begin, size_t end,
+               vector_type& output, size_t out, bool range)
+{
+    LOG1 << "sorting [" << begin << "," << end << ") to " << out
+         << " with blocks of " << BlockSize << (range ? " into a range" : "");
+
+    using sort_type = stxxl::stream::sort<input_stream_type, Cmp, BlockSize>;
+
+    input_stream_type in(input.cbegin() + begin, input.cbegin() + end);
+    sort_type sorted(in, Cmp(), memory_to_use);
+    die_unequal(sorted.size(), end - begin);
+
+    vector_type::iterator last;
+    if (range)
+        last = stxxl::stream::materialize(
+            sorted, output.begin() + out, output.begin() + out + (end - begin));
+    else
+        last = stxxl::stream::materialize(sorted, output.begin() + out);
+
+    die_unless(sorted.empty());
+    die_unequal(static_cast<size_t>(last - output.begin()), out + end - begin);
+
+    value_type sum_in = 0, sum_out = 0;
+    for (size_t i = begin; i < end; ++i)
+        sum_in += input[i];
+
+    const vector_type& coutput = output;
+    for (size_t i = out; i < out + end - begin; ++i)
+    {
+        if (i > out)
+            die_unless(coutput[i - 1] <= coutput[i]);
+        sum_out += coutput[i];
+    }
+    die_unequal(sum_in, sum_out);
+}
+
+int main()
+{
+    const size_t n = 100 * block_values + 123;
+
+    vector_type input(n);
+    std::mt19937_64 rng(n);
+    for (size_t i = 0; i < n; ++i)
+        input[i] = rng() % 1000000;
+
+    vector_type output(n + block_values);
+
+    // block aligned input and output: blocks are passed on whole
+    test_sort<block_size>(input, 0, 80 * block_values, output, 0, false);
+    test_sort<block_size>(input, 0, 80 * block_values, output, 0, true);
+    test_sort<block_size>(input, 0, n, output, block_values, false);
+
+    // unaligned input or output: the values are copied around the blocks
+    test_sort<block_size>(input, 17, n, output, 0, false);
+    test_sort<block_size>(input, block_values, n - 5, output, 3, true);
+
+    // the sorter's blocks differ from the vector's
+    test_sort<2 * block_size>(input, 0, n, output, 0, false);
+    test_sort<2 * block_size>(input, 0, n, output, 0, true);
+
+    // small input, sorted in memory
+    test_sort<block_size>(input, 0, 100, output, 0, false);
+
+    return 0;
+}
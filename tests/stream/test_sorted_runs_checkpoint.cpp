@@ -0,0 +1,146 @@
+/***************************************************************************
+ *  tests/stream/test_sorted_runs_checkpoint.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+
+#include <stxxl/stream>
+
+using value_type = uint64_t;
+
+struct Cmp
+{
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        return a < b;
+    }
+    value_type min_value() const
+    {
+        return std::numeric_limits<value_type>::min();
+    }
+    value_type max_value() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+};
+
+using runs_creator_type = stxxl::stream::runs_creator<
+          stxxl::stream::use_push<value_type>, Cmp, 4096>;
+using sorted_runs_type = runs_creator_type::sorted_runs_type;
+using runs_merger_type = stxxl::stream::runs_merger<sorted_runs_type, Cmp>;
+
+const size_t memory_to_use = 64 * 4096;
+
+//! sorts n values derived from seed into runs
+sorted_runs_type create_runs(size_t n, uint64_t seed, value_type& checksum)
+{
+    runs_creator_type creator(Cmp(), memory_to_use);
+    std::mt19937_64 rng(seed);
+    for (size_t i = 0; i < n; ++i)
+    {
+        value_type x = rng() % 1000000000;
+        checksum += x;
+        creator.push(x);
+    }
+    return creator.result();
+}
+
+//! merges the runs and checks sortedness, size and checksum
+void check_merge(const sorted_runs_type& sruns, size_t n, value_type checksum)
+{
+    runs_merger_type merger(Cmp(), memory_to_use);
+    merger.initialize(sruns);
+    die_unequal(merger.size(), n);
+
+    value_type prev = 0, sum = 0;
+    size_t count = 0;
+    for ( ; !merger.empty(); ++merger, ++count)
+    {
+        die_unless(prev <= *merger);
+        prev = *merger;
+        sum += *merger;
+    }
+    die_unequal(count, n);
+    die_unequal(sum, checksum);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0] << " file type" << std::endl;
+        return -1;
+    }
+
+    const size_t n = 300000, m = 100;
+    value_type checksum = 0;
+
+    {
+        // sort into runs and save a checkpoint
+        sorted_runs_type sruns = create_runs(n, 1, checksum);
+        LOG1 << "saving " << sruns->runs.size() << " runs with " << sruns->elements << " values";
+        die_unless(sruns->runs.size() > 1);
+
+        foxxll::file_ptr f = foxxll::create_file(
+            argv[2], argv[1], foxxll::file::CREAT | foxxll::file::DIRECT | foxxll::file::RDWR);
+        sruns->save(f);
+    }
+
+    {
+        // restore the runs as a later process would, and merge them twice
+        foxxll::file_ptr f = foxxll::create_file(
+            argv[2], argv[1], foxxll::file::DIRECT | foxxll::file::RDWR);
+        sorted_runs_type sruns = sorted_runs_type(new runs_creator_type::sorted_runs_data_type);
+        sruns->load(f);
+        LOG1 << "loaded " << sruns->runs.size() << " runs with " << sruns->elements << " values";
+        die_unequal(sruns->elements, n);
+
+        check_merge(sruns, n, checksum);
+        check_merge(sruns, n, checksum);
+
+        // merge them together with new runs, including a small one
+        sorted_runs_type more = create_runs(n / 2, 2, checksum);
+        sorted_runs_type small = create_runs(m, 3, checksum);
+        die_unless(!small->small_run.empty());
+
+        sruns->append(*more, Cmp());
+        sruns->append(*small, Cmp());
+        die_unequal(more->elements, 0u);
+        die_unequal(small->elements, 0u);
+        die_unless(sruns->small_run.empty());
+
+        check_merge(sruns, n + n / 2 + m, checksum);
+    }
+
+    {
+        // a checkpoint of a small run only
+        value_type small_checksum = 0;
+        sorted_runs_type sruns = create_runs(m, 4, small_checksum);
+        die_unless(sruns->runs.empty());
+
+        foxxll::file_ptr f = foxxll::create_file(
+            argv[2], argv[1], foxxll::file::CREAT | foxxll::file::DIRECT | foxxll::file::RDWR);
+        sruns->save(f);
+
+        sorted_runs_type loaded = sorted_runs_type(new runs_creator_type::sorted_runs_data_type);
+        loaded->load(f);
+        die_unequal(loaded->small_run.size(), m);
+        check_merge(loaded, m, small_checksum);
+    }
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+/***************************************************************************
+ *  tests/stream/test_stream_batch.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+
+using value_type = uint64_t;
+
+struct Cmp
+{
+    bool operator () (const value_type& a, const value_type& b) const
+    {
+        return a < b;
+    }
+    value_type min_value() const
+    {
+        return std::numeric_limits<value_type>::min();
+    }
+    value_type max_value() const
+    {
+        return std::numeric_limits<value_type>::max();
+    }
+};
+
+//! stream of the values 0, ..., size - 1 with the element interface only
+class sequence_stream
+{
+public:
+    using value_type = ::value_type;
+
+    explicit sequence_stream(value_type size)
+        : m_current(0), m_size(size)
+    { }
+
+    const value_type& operator * () const
+    {
+        return m_current;
+    }
+
+    sequence_stream& operator ++ ()
+    {
+        ++m_current;
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return m_current >= m_size;
+    }
+
+private:
+    value_type m_current, m_size;
+};
+
+//! source of the values 0, ..., size - 1 with the batch interface only,
+//! which delivers batches of varying size
+class sequence_batches
+{
+public:
+    using value_type = ::value_type;
+
+    explicit sequence_batches(value_type size)
+        : m_current(0), m_size(size)
+    { }
+
+    size_t next_batch(value_type* out, size_t n)
+    {
+        n = std::min<size_t>(std::min<size_t>(n, 1 + m_current % 100), m_size - m_current);
+        for (size_t i = 0; i < n; ++i)
+            out[i] = m_current++;
+        return n;
+    }
+
+    size_t batch_size() const
+    {
+        return 64;
+    }
+
+private:
+    value_type m_current, m_size;
+};
+
+static_assert(!stxxl::stream::has_next_batch<sequence_stream>::value,
+              "element stream without batches");
+static_assert(stxxl::stream::has_next_batch<sequence_batches>::value,
+              "batch source");
+static_assert(stxxl::stream::has_batch_size<sequence_batches>::value,
+              "batch source");
+
+//! reads the stream by batches of at most n values and checks that it holds
+//! 0, ..., size - 1
+template <typename Stream>
+void check_batches(Stream& s, size_t size, size_t n)
+{
+    std::vector<value_type> batch(n);
+    size_t count = 0, k;
+    while ((k = stxxl::stream::next_batch(s, batch.data(), n)) != 0)
+    {
+        die_unless(k <= n);
+        for (size_t i = 0; i < k; ++i)
+            die_unequal(batch[i], count + i);
+        count += k;
+    }
+    die_unequal(count, size);
+}
+
+int main()
+{
+    const size_t n = 100000;
+
+    {
+        // fallback to the element interface
+        sequence_stream s(n);
+        die_unequal(stxxl::stream::batch_size(s), 1024u);
+        check_batches(s, n, 1000);
+        die_unless(s.empty());
+    }
+    {
+        // native batches of iterator2stream
+        std::vector<value_type> v(n);
+        for (size_t i = 0; i < n; ++i)
+            v[i] = i;
+        auto s = stxxl::stream::streamify(v.begin(), v.end());
+        check_batches(s, n, 333);
+        die_unless(s.empty());
+    }
+    {
+        // element interface for a batch source, and mixing both interfaces
+        sequence_batches source(n);
+        stxxl::stream::batch2stream<sequence_batches> s(source);
+        die_unequal(stxxl::stream::batch_size(s), 64u);
+
+        value_type expected = 0;
+        for (size_t i = 0; i < 1000; ++i, ++s, ++expected)
+            die_unequal(*s, expected);
+
+        std::vector<value_type> batch(50);
+        size_t k = stxxl::stream::next_batch(s, batch.data(), batch.size());
+        die_unless(k > 0);
+        for (size_t i = 0; i < k; ++i, ++expected)
+            die_unequal(batch[i], expected);
+
+        for ( ; !s.empty(); ++s, ++expected)
+            die_unequal(*s, expected);
+        die_unequal(expected, n);
+    }
+    {
+        // concatenate passes batches of both inputs on
+        sequence_stream a(n / 2);
+        std::vector<value_type> v(n - n / 2);
+        for (size_t i = 0; i < v.size(); ++i)
+            v[i] = n / 2 + i;
+        auto b = stxxl::stream::streamify(v.begin(), v.end());
+        stxxl::stream::concatenate<sequence_stream, decltype(b)> s(a, b);
+        check_batches(s, n, 4096);
+    }
+    {
+        // runs_merger returns the values of its output blocks
+        using runs_creator_type = stxxl::stream::runs_creator<
+                  stxxl::stream::use_push<value_type>, Cmp, 4096>;
+        using runs_merger_type = stxxl::stream::runs_merger<
+                  runs_creator_type::sorted_runs_type, Cmp>;
+
+        runs_creator_type creator(Cmp(), 64 * 4096);
+        std::vector<value_type> v(n);
+        for (size_t i = 0; i < n; ++i)
+            v[i] = i;
+        std::shuffle(v.begin(), v.end(), std::mt19937_64(n));
+        for (const value_type& x : v)
+            creator.push(x);
+
+        runs_merger_type merger(creator.result(), Cmp(), 64 * 4096);
+        die_unequal(stxxl::stream::batch_size(merger), 4096 / sizeof(value_type));
+        check_batches(merger, n, 1000);
+        die_unless(merger.empty());
+    }
+    {
+        // threaded stages return the values of their batches
+        sequence_stream input(n);
+        stxxl::stream::async_buffer<sequence_stream> s(input, 1000);
+        check_batches(s, n, 300);
+    }
+
+    return 0;
+}
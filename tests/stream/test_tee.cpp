@@ -0,0 +1,123 @@
+/***************************************************************************
+ *  tests/stream/test_tee.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstdint>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <stxxl/stream>
+
+using value_type = uint64_t;
+
+//! stream of the values 0, ..., size - 1
+class sequence_stream
+{
+public:
+    using value_type = ::value_type;
+
+    explicit sequence_stream(value_type size)
+        : m_current(0), m_size(size)
+    { }
+
+    const value_type& operator * () const
+    {
+        return m_current;
+    }
+
+    sequence_stream& operator ++ ()
+    {
+        ++m_current;
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return m_current >= m_size;
+    }
+
+private:
+    value_type m_current, m_size;
+};
+
+const size_t block_size = 4096;
+
+using tee_type = stxxl::stream::tee<sequence_stream, block_size>;
+
+//! reads the outputs of a tee of n values, where output i advances by
+//! steps[i] values per round, and checks that each reads all values
+void test_tee(value_type n, const std::vector<size_t>& steps,
+              size_t memory_to_use, bool expect_spill)
+{
+    LOG1 << "tee of " << n << " values to " << steps.size() << " outputs";
+
+    sequence_stream input(n);
+    tee_type tee(input, steps.size(), memory_to_use);
+    die_unequal(tee.num_outputs(), steps.size());
+
+    std::vector<value_type> expected(steps.size(), 0);
+    bool spilled = false;
+    for (bool all_empty = false; !all_empty; )
+    {
+        all_empty = true;
+        for (size_t i = 0; i < steps.size(); ++i)
+        {
+            tee_type::output_type& out = tee.output(i);
+            for (size_t j = 0; j < steps[i] && !out.empty(); ++j, ++out)
+                die_unequal(*out, expected[i]++);
+            all_empty = all_empty && out.empty();
+        }
+        spilled = spilled || tee.spilled() != 0;
+    }
+
+    for (size_t i = 0; i < steps.size(); ++i)
+    {
+        die_unequal(expected[i], n);
+        die_unequal(tee.output(i).position(), n);
+    }
+    die_unequal(spilled, expect_spill);
+    die_unequal(tee.spilled(), 0u);
+}
+
+int main()
+{
+    const size_t memory_to_use = 16 * block_size;
+
+    // outputs in lockstep buffer one value
+    test_tee(100000, { 1, 1 }, memory_to_use, false);
+    test_tee(0, { 1, 1, 1 }, memory_to_use, false);
+    test_tee(1, { 1, 1 }, memory_to_use, false);
+
+    // a small gap stays in memory
+    test_tee(100000, { 100, 99 }, memory_to_use, false);
+
+    // the first output runs ahead, the others read spilled values
+    test_tee(200000, { 1000000, 1 }, memory_to_use, true);
+    test_tee(200000, { 100, 1, 37 }, memory_to_use, true);
+    test_tee(200000, { 1, 1000, 10, 1000000 }, 0, true);
+
+    {
+        // drain one output completely before the next
+        sequence_stream input(100000);
+        tee_type tee(input, 2, memory_to_use);
+        value_type count = 0;
+        for (tee_type::output_type& out = tee.output(0); !out.empty(); ++out)
+            die_unequal(*out, count++);
+        die_unless(tee.spilled() > 0);
+
+        count = 0;
+        for (tee_type::output_type& out = tee.output(1); !out.empty(); ++out)
+            die_unequal(*out, count++);
+        die_unequal(count, 100000u);
+    }
+
+    return 0;
+}
@@ -0,0 +1,621 @@
+/***************************************************************************
+ *  tools/benchmark_containers.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+static const char* description =
+    "Benchmark the external containers of STXXL on 64-bit values. Each "
+    "combination of benchmark, block size and cache size is run and reported "
+    "as one row of CSV or RESULT lines with the operation rate and the I/O "
+    "volume. The cache size is the internal memory of the container: the "
+    "pages of a vector or its buffered reader, the node and leaf caches of a "
+    "map, the buffer and block cache of an unordered_map, the pools of a "
+    "queue or stack. Benchmarks: vector_fill (buffered writer), vector_scan "
+    "(iterators through the page cache), vector_bufreader, vector_random "
+    "(random reads through the page cache), map_find, map_range, map_insert, "
+    "unordered_map_find, unordered_map_insert, queue, sequence, stack. "
+    "Lookups hit an existing key with the given hit ratio. "
+    "Block sizes: 64KiB, 256KiB, 1MiB, 4MiB.";
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+#include <tlx/string/parse_si_iec_units.hpp>
+#include <tlx/string/split.hpp>
+
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io/iostats.hpp>
+#include <foxxll/mng/read_write_pool.hpp>
+
+#include <stxxl/bits/common/block_size_dispatch.h>
+#include <stxxl/bits/common/cmdline.h>
+#include <stxxl/comparator>
+#include <stxxl/map>
+#include <stxxl/queue>
+#include <stxxl/sequence>
+#include <stxxl/stack>
+#include <stxxl/unordered_map>
+#include <stxxl/vector>
+
+using foxxll::timestamp;
+using foxxll::external_size_type;
+
+using value_type = uint64_t;
+
+/******************************************************************************/
+// Benchmarks and Results
+
+enum class benchmark {
+    vector_fill, vector_scan, vector_bufreader, vector_random,
+    map_find, map_range, map_insert,
+    unordered_map_find, unordered_map_insert,
+    queue, sequence, stack, count
+};
+
+static const char* benchmark_names[] = {
+    "vector_fill", "vector_scan", "vector_bufreader", "vector_random",
+    "map_find", "map_range", "map_insert",
+    "unordered_map_find", "unordered_map_insert",
+    "queue", "sequence", "stack"
+};
+
+struct benchmark_config
+{
+    std::vector<benchmark> benchmarks;
+    std::vector<size_t> block_sizes;
+    std::vector<size_t> cache_sizes;
+    //! values in the containers
+    external_size_type items;
+    //! point queries or inserts of the random access benchmarks
+    external_size_type queries;
+    //! fraction of lookups hitting an existing key
+    double hit_ratio;
+    //! values visited per range query
+    external_size_type range_length;
+    unsigned seed;
+};
+
+struct result_row
+{
+    benchmark bench;
+    size_t block_size;
+    size_t cache_size;
+    //! number of operations: values read or written, queries or inserts
+    external_size_type ops;
+    //! lookups which found their key, for find and insert benchmarks
+    external_size_type hits;
+    double time;
+    foxxll::stats_data io;
+};
+
+class result_writer
+{
+public:
+    enum format_type { csv, result };
+
+    result_writer(std::ostream& os, format_type format)
+        : m_os(os), m_format(format)
+    {
+        if (m_format == csv)
+        {
+            m_os << "benchmark,block_size,cache_size,ops,hits,time_s,ops_per_s,"
+                 << "read_count,read_bytes,write_count,write_bytes,io_wait_s"
+                 << std::endl;
+        }
+    }
+
+    void write(const result_row& r)
+    {
+        const double ops_per_s = r.time > 0 ? static_cast<double>(r.ops) / r.time : 0;
+
+        if (m_format == csv)
+        {
+            m_os << benchmark_names[static_cast<int>(r.bench)] << ','
+                 << r.block_size << ',' << r.cache_size << ','
+                 << r.ops << ',' << r.hits << ','
+                 << r.time << ',' << ops_per_s << ','
+                 << r.io.get_read_count() << ',' << r.io.get_read_bytes() << ','
+                 << r.io.get_write_count() << ',' << r.io.get_write_bytes() << ','
+                 << r.io.get_io_wait_time() << std::endl;
+        }
+        else
+        {
+            m_os << "RESULT benchmark=containers"
+                 << " container_benchmark=" << benchmark_names[static_cast<int>(r.bench)]
+                 << " block_size=" << r.block_size
+                 << " cache_size=" << r.cache_size
+                 << " ops=" << r.ops
+                 << " hits=" << r.hits
+                 << " time=" << r.time
+                 << " ops_per_s=" << ops_per_s
+                 << " read_count=" << r.io.get_read_count()
+                 << " read_bytes=" << r.io.get_read_bytes()
+                 << " write_count=" << r.io.get_write_count()
+                 << " write_bytes=" << r.io.get_write_bytes()
+                 << " io_wait=" << r.io.get_io_wait_time()
+                 << std::endl;
+        }
+    }
+
+private:
+    std::ostream& m_os;
+    format_type m_format;
+};
+
+/******************************************************************************/
+// Benchmark Runs
+
+//! The containers hold the even keys 0, 2, ..., 2 * (items - 1), such that
+//! odd keys miss.
+struct hash_value
+{
+    size_t operator () (const value_type& key) const
+    {
+        return static_cast<size_t>(key * 0x9E3779B97F4A7C15ull);
+    }
+};
+
+template <size_t BlockSize>
+class BenchmarkContainers
+{
+    static constexpr unsigned page_size = 4;
+    static constexpr unsigned subblock_size = 8 * 1024;
+
+    using vector_type = stxxl::vector<
+              value_type, page_size, stxxl::lru_pager<>, BlockSize>;
+
+    using cmp_type = stxxl::comparator<value_type>;
+    using map_type = stxxl::map<
+              value_type, value_type, cmp_type, 16 * 1024, BlockSize>;
+    using pair_vector_type = stxxl::vector<
+              std::pair<value_type, value_type>, page_size, stxxl::lru_pager<>, BlockSize>;
+
+    using unordered_map_type = stxxl::unordered_map<
+              value_type, value_type, hash_value, cmp_type,
+              subblock_size, BlockSize / subblock_size>;
+
+    using queue_type = stxxl::queue<value_type, BlockSize>;
+    using sequence_type = stxxl::sequence<value_type, BlockSize>;
+
+    using stack_type = typename stxxl::STACK_GENERATOR<
+              value_type, stxxl::external, stxxl::grow_shrink2,
+              page_size, BlockSize>::result;
+    using stack_pool_type = foxxll::read_write_pool<typename stack_type::block_type>;
+
+    const benchmark_config& m_config;
+    result_writer& m_writer;
+
+    std::mt19937_64 m_rng;
+
+    //! Blocks of internal memory a run gets, at least min_blocks.
+    size_t cache_blocks(const result_row& row, size_t min_blocks) const
+    {
+        const size_t blocks = row.cache_size / BlockSize;
+        if (blocks < min_blocks)
+            throw std::runtime_error(
+                      "cache holds fewer than " + std::to_string(min_blocks) + " blocks");
+        return blocks;
+    }
+
+    //! Random query key, an existing one with probability hit_ratio.
+    value_type query_key()
+    {
+        const value_type i = m_rng() % m_config.items;
+        return std::uniform_real_distribution<double>()(m_rng) < m_config.hit_ratio
+               ? 2 * i : 2 * i + 1;
+    }
+
+    void fill_vector(vector_type& vec, size_t nbuffers)
+    {
+        typename vector_type::bufwriter_type writer(vec, nbuffers);
+        for (external_size_type i = 0; i < m_config.items; ++i)
+            writer << 2 * i;
+        writer.finish();
+    }
+
+    //! Pairs (key, index) of the keys the maps hold, sorted by key.
+    void fill_pairs(pair_vector_type& pairs)
+    {
+        pairs.resize(m_config.items);
+        typename pair_vector_type::bufwriter_type writer(pairs);
+        for (external_size_type i = 0; i < m_config.items; ++i)
+            writer << std::make_pair(2 * i, i);
+        writer.finish();
+    }
+
+    void run_vector(result_row& row)
+    {
+        const size_t npages = cache_blocks(row, page_size) / page_size;
+        const size_t nbuffers = cache_blocks(row, 2);
+
+        vector_type vec(0, npages);
+        if (row.bench != benchmark::vector_fill)
+            fill_vector(vec, nbuffers);
+
+        foxxll::stats_data stats_begin(*foxxll::stats::get_instance());
+        const double ts = timestamp();
+        value_type sum = 0;
+
+        switch (row.bench)
+        {
+        case benchmark::vector_fill:
+            fill_vector(vec, nbuffers);
+            row.ops = m_config.items;
+            break;
+        case benchmark::vector_scan:
+            for (typename vector_type::const_iterator it = vec.cbegin();
+                 it != vec.cend(); ++it)
+                sum += *it;
+            row.ops = m_config.items;
+            break;
+        case benchmark::vector_bufreader:
+            for (typename vector_type::bufreader_type reader(vec, nbuffers);
+                 !reader.empty(); ++reader)
+                sum += *reader;
+            row.ops = m_config.items;
+            break;
+        case benchmark::vector_random: {
+            const vector_type& cvec = vec;
+            for (external_size_type i = 0; i < m_config.queries; ++i)
+                sum += cvec[m_rng() % m_config.items];
+            row.ops = m_config.queries;
+            break;
+        }
+        default:
+            abort();
+        }
+
+        row.time = timestamp() - ts;
+        row.io = foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+
+        if (row.bench == benchmark::vector_scan || row.bench == benchmark::vector_bufreader)
+            die_unequal(sum, m_config.items * (m_config.items - 1));
+    }
+
+    void run_map(result_row& row)
+    {
+        // the leaf cache must hold three leaves
+        cache_blocks(row, 4);
+
+        pair_vector_type pairs;
+        fill_pairs(pairs);
+        map_type map(pairs.cbegin(), pairs.cend(),
+                     row.cache_size / 4, row.cache_size / 4 * 3, true);
+        pairs.clear();
+
+        foxxll::stats_data stats_begin(*foxxll::stats::get_instance());
+        const double ts = timestamp();
+
+        row.ops = m_config.queries;
+        switch (row.bench)
+        {
+        case benchmark::map_find:
+            for (external_size_type i = 0; i < m_config.queries; ++i)
+                row.hits += (map.find(query_key()) != map.end());
+            break;
+        case benchmark::map_range: {
+            value_type sum = 0;
+            for (external_size_type i = 0; i < m_config.queries; ++i)
+            {
+                typename map_type::const_iterator it =
+                    static_cast<const map_type&>(map).lower_bound(query_key());
+                for (external_size_type j = 0;
+                     j < m_config.range_length && it != map.cend(); ++j, ++it)
+                    sum += it->second;
+                ++row.hits;
+            }
+            die_unless(sum != 0 || m_config.items <= 1);
+            break;
+        }
+        case benchmark::map_insert:
+            for (external_size_type i = 0; i < m_config.queries; ++i)
+                row.hits += !map.insert(std::make_pair(query_key(), i)).second;
+            break;
+        default:
+            abort();
+        }
+
+        row.time = timestamp() - ts;
+        row.io = foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+    }
+
+    void run_unordered_map(result_row& row)
+    {
+        // half of the memory buffers changes, half caches blocks
+        const size_t blocks = cache_blocks(row, 2);
+
+        unordered_map_type map(0, hash_value(), cmp_type(), row.cache_size / 2);
+        stxxl::hash_map::tuning_parameters params = map.get_tuning();
+        params.blockcache_size = blocks / 2;
+        map.set_tuning(params);
+
+        {
+            pair_vector_type pairs;
+            fill_pairs(pairs);
+            map.insert(pairs.cbegin(), pairs.cend(), row.cache_size);
+        }
+
+        foxxll::stats_data stats_begin(*foxxll::stats::get_instance());
+        const double ts = timestamp();
+
+        row.ops = m_config.queries;
+        switch (row.bench)
+        {
+        case benchmark::unordered_map_find: {
+            const unordered_map_type& cmap = map;
+            for (external_size_type i = 0; i < m_config.queries; ++i)
+                row.hits += (cmap.find(query_key()) != cmap.end());
+            break;
+        }
+        case benchmark::unordered_map_insert:
+            for (external_size_type i = 0; i < m_config.queries; ++i)
+                row.hits += !map.insert(std::make_pair(query_key(), i)).second;
+            break;
+        default:
+            abort();
+        }
+
+        row.time = timestamp() - ts;
+        row.io = foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+    }
+
+    //! Push all values, then pop them, both count as operations.
+    void run_sequential(result_row& row)
+    {
+        // the pools hold at least two write and two prefetch blocks
+        const size_t blocks = cache_blocks(row, 4);
+
+        foxxll::stats_data stats_begin(*foxxll::stats::get_instance());
+        const double ts = timestamp();
+        value_type sum = 0;
+
+        switch (row.bench)
+        {
+        case benchmark::queue: {
+            queue_type queue(blocks / 2, blocks / 2);
+            for (external_size_type i = 0; i < m_config.items; ++i)
+                queue.push(i);
+            for ( ; !queue.empty(); queue.pop())
+                sum += queue.front();
+            break;
+        }
+        case benchmark::sequence: {
+            sequence_type sequence(blocks / 2, blocks / 2);
+            for (external_size_type i = 0; i < m_config.items; ++i)
+                sequence.push_back(i);
+            for ( ; !sequence.empty(); sequence.pop_front())
+                sum += sequence.front();
+            break;
+        }
+        case benchmark::stack: {
+            stack_pool_type pool(blocks / 2, blocks / 2);
+            stack_type stack(pool, blocks / 2);
+            for (external_size_type i = 0; i < m_config.items; ++i)
+                stack.push(i);
+            for ( ; !stack.empty(); stack.pop())
+                sum += stack.top();
+            break;
+        }
+        default:
+            abort();
+        }
+
+        row.time = timestamp() - ts;
+        row.io = foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+        row.ops = 2 * m_config.items;
+
+        die_unequal(sum, m_config.items * (m_config.items - 1) / 2);
+    }
+
+    void run(result_row& row)
+    {
+        switch (row.bench)
+        {
+        case benchmark::map_find:
+        case benchmark::map_range:
+        case benchmark::map_insert:
+            return run_map(row);
+        case benchmark::unordered_map_find:
+        case benchmark::unordered_map_insert:
+            return run_unordered_map(row);
+        case benchmark::queue:
+        case benchmark::sequence:
+        case benchmark::stack:
+            return run_sequential(row);
+        default:
+            return run_vector(row);
+        }
+    }
+
+public:
+    BenchmarkContainers(const benchmark_config& config, result_writer& writer)
+        : m_config(config), m_writer(writer), m_rng(config.seed)
+    {
+        result_row row;
+        row.block_size = BlockSize;
+
+        for (size_t cache_size : config.cache_sizes)
+        {
+            row.cache_size = cache_size;
+            for (benchmark bench : config.benchmarks)
+            {
+                row.bench = bench;
+                row.ops = row.hits = 0;
+                try {
+                    run(row);
+                }
+                catch (const std::exception& e) {
+                    LOG1 << "# " << benchmark_names[static_cast<int>(bench)]
+                         << " with " << BlockSize << " byte blocks and "
+                         << cache_size << " bytes cache failed: " << e.what();
+                    continue;
+                }
+                m_writer.write(row);
+            }
+        }
+    }
+};
+
+/******************************************************************************/
+// Command Line
+
+template <typename Enum>
+static bool parse_list(const std::string& str, const char* const names[],
+                       Enum count, std::vector<Enum>& out)
+{
+    for (const std::string& s : tlx::split(',', str))
+    {
+        int i = 0;
+        while (i < static_cast<int>(count) && s != names[i])
+            ++i;
+        if (i == static_cast<int>(count)) {
+            std::cerr << "Unknown name \"" << s << "\"." << std::endl;
+            return false;
+        }
+        out.push_back(static_cast<Enum>(i));
+    }
+    return true;
+}
+
+static bool parse_bytes_list(const std::string& str, std::vector<size_t>& out)
+{
+    for (const std::string& s : tlx::split(',', str))
+    {
+        uint64_t bytes;
+        if (!tlx::parse_si_iec_units(s, &bytes)) {
+            std::cerr << "Cannot parse size \"" << s << "\"." << std::endl;
+            return false;
+        }
+        out.push_back(bytes);
+    }
+    return true;
+}
+
+int benchmark_containers(int argc, char* argv[])
+{
+    // parse command line
+    stxxl::cmdline_parser cp;
+
+    cp.set_description(description);
+
+    uint64_t volume = 256 * 1024 * 1024;
+    cp.add_bytes('n', "volume", volume,
+                 "Data volume of the containers, default: 256MiB.");
+
+    unsigned queries = 1000000;
+    cp.add_uint('q', "queries", queries,
+                "Point queries or inserts of the map, unordered_map and "
+                "vector_random benchmarks, default: 1000000.");
+
+    std::string benchmarks =
+        "vector_fill,vector_scan,vector_bufreader,vector_random,"
+        "map_find,map_range,map_insert,unordered_map_find,"
+        "unordered_map_insert,queue,sequence,stack";
+    cp.add_string('B', "benchmarks", benchmarks,
+                  "Comma separated list of benchmarks, default: all.");
+
+    std::string block_sizes = "256KiB,1MiB,4MiB";
+    cp.add_string('b', "block-sizes", block_sizes,
+                  "Comma separated list of block sizes from 64KiB, 256KiB, "
+                  "1MiB and 4MiB, default: 256KiB,1MiB,4MiB.");
+
+    std::string cache_sizes = "16MiB,64MiB,256MiB";
+    cp.add_string('c', "cache-sizes", cache_sizes,
+                  "Comma separated list of cache sizes per container, "
+                  "default: 16MiB,64MiB,256MiB.");
+
+    unsigned hit_percent = 50;
+    cp.add_uint('H', "hit-ratio", hit_percent,
+                "Percentage of lookups and inserts of existing keys, "
+                "default: 50.");
+
+    unsigned range_length = 1000;
+    cp.add_uint('L', "range-length", range_length,
+                "Values visited per range query of map_range, default: 1000.");
+
+    unsigned seed = 42;
+    cp.add_uint('S', "seed", seed, "Seed of the random queries, default: 42.");
+
+    std::string format = "csv";
+    cp.add_string('f', "format", format,
+                  "Output format: csv or result, default: csv.");
+
+    std::string output;
+    cp.add_string('o', "output", output,
+                  "Write the results to this file instead of stdout.");
+
+    if (!cp.process(argc, argv))
+        return -1;
+
+    benchmark_config config;
+    config.items = std::max<uint64_t>(volume / sizeof(value_type), 1);
+    config.queries = queries;
+    config.hit_ratio = std::min(hit_percent, 100u) / 100.0;
+    config.range_length = range_length;
+    config.seed = seed;
+
+    if (!parse_list(benchmarks, benchmark_names, benchmark::count, config.benchmarks) ||
+        !parse_bytes_list(block_sizes, config.block_sizes) ||
+        !parse_bytes_list(cache_sizes, config.cache_sizes))
+    {
+        cp.print_usage();
+        return -1;
+    }
+
+    result_writer::format_type fmt;
+    if (format == "csv")
+        fmt = result_writer::csv;
+    else if (format == "result")
+        fmt = result_writer::result;
+    else {
+        std::cerr << "Unknown output format \"" << format << "\"." << std::endl;
+        cp.print_usage();
+        return -1;
+    }
+
+    std::ofstream ofs;
+    if (!output.empty()) {
+        ofs.open(output.c_str());
+        if (!ofs.good()) {
+            std::cerr << "Cannot open output file \"" << output << "\"." << std::endl;
+            return -1;
+        }
+    }
+    result_writer writer(output.empty() ? std::cout : ofs, fmt);
+
+    using block_sizes_type = stxxl::block_size_list<
+              64 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024>;
+
+    for (size_t block_size : config.block_sizes)
+    {
+        try {
+            stxxl::dispatch_block_size<block_sizes_type>(
+                block_size, [&](auto bs) {
+                    BenchmarkContainers<decltype(bs)::value>(config, writer);
+                });
+        }
+        catch (const foxxll::bad_parameter& e) {
+            std::cerr << e.what() << std::endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -10,214 +10,692 @@
  *  http://www.boost.org/LICENSE_1_0.txt)
  **************************************************************************/
 
-/*
- * This program will benchmark the different sorting methods provided by STXXL
- * using three different data types: first a pair of 32-bit uints, "then a pair
- * 64-bit uint and then a larger structure of 64 bytes.
- */
+static const char* description =
+    "Benchmark the sorting engines of STXXL on records of 8 to 256 bytes with "
+    "a 64-bit key. Each combination of engine, record size, key distribution, "
+    "thread count and memory budget is sorted and reported as one row of CSV, "
+    "JSON lines or RESULT lines, with the run formation and merge phases "
+    "timed separately where the engine exposes them, and the I/O volume. "
+    "Engines: sort, sort_radix (sort with the radix sort kernel in run "
+    "formation), sample_sort, ksort, stable_ksort, stream_sort, stream_radix "
+    "(runs formed by radix sort on the key), stream_sample_sort, "
+    "stream_replacement (runs formed by replacement selection). "
+    "Distributions: uniform, zipf, sorted, reverse, few_unique.";
 
 #include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <random>
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+#include <tlx/string/parse_si_iec_units.hpp>
+#include <tlx/string/split.hpp>
+
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io/iostats.hpp>
 
 #include <stxxl/bits/common/cmdline.h>
+#include <stxxl/bits/parallel.h>
 #include <stxxl/comparator>
 #include <stxxl/ksort>
 #include <stxxl/sort>
+#include <stxxl/stable_ksort>
 #include <stxxl/stream>
 #include <stxxl/vector>
 
+#include "../tests/include/key_with_padding.h"
+
 using foxxll::timestamp;
 using foxxll::external_size_type;
 
 #define MB (1024 * 1024)
 
-// pair of uint32_t = 8 bytes
-using pair32_type = std::pair<uint32_t, uint32_t>;
+// records of Size bytes with a 64-bit key
+template <size_t Size>
+using record_type = key_with_padding<uint64_t, Size>;
+
+//! Comparator of records for which the sort kernel radix sorts runs by the
+//! key, unlike the plain comparator which sorts by comparison.
+template <typename ValueType>
+struct radix_compare : public ValueType::compare_less
+{ };
+
+namespace stxxl {
+
+template <typename KeyType, size_t Size>
+struct sort_kernel_traits<key_with_padding<KeyType, Size>,
+                          radix_compare<key_with_padding<KeyType, Size> > >
+    : sort_kernel_enabled<typename key_with_padding<KeyType, Size>::key_extract>{ };
+
+} // namespace stxxl
+
+/******************************************************************************/
+// Key Distributions
+
+enum class distribution { uniform, zipf, sorted, reverse, few_unique };
+
+static const char* distribution_names[] = {
+    "uniform", "zipf", "sorted", "reverse", "few_unique"
+};
+
+/*!
+ * Zipf distributed ranks in [1, n] with exponent s by rejection-inversion
+ * sampling (W. Hörmann and G. Derflinger), which needs constant time and
+ * space per sample for any n.
+ */
+class zipf_distribution
+{
+public:
+    zipf_distribution(uint64_t n, double s)
+        : m_n(static_cast<double>(n)), m_s(s),
+          m_h_x1(h_integral(1.5) - 1.0),
+          m_h_n(h_integral(m_n + 0.5)),
+          m_sd(2.0 - h_integral_inverse(h_integral(2.5) - h(2.0)))
+    { }
+
+    template <typename RNG>
+    uint64_t operator () (RNG& rng)
+    {
+        std::uniform_real_distribution<double> uniform;
+        while (true)
+        {
+            const double u = m_h_n + uniform(rng) * (m_h_x1 - m_h_n);
+            const double x = h_integral_inverse(u);
+            const double k = std::min(std::max(std::floor(x + 0.5), 1.0), m_n);
+            if (k - x <= m_sd || u >= h_integral(k + 0.5) - h(k))
+                return static_cast<uint64_t>(k);
+        }
+    }
+
+private:
+    double m_n, m_s, m_h_x1, m_h_n, m_sd;
+
+    //! log1p(x) / x, continued for x near zero
+    static double helper1(double x)
+    {
+        if (std::abs(x) > 1e-8)
+            return std::log1p(x) / x;
+        return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    //! expm1(x) / x, continued for x near zero
+    static double helper2(double x)
+    {
+        if (std::abs(x) > 1e-8)
+            return std::expm1(x) / x;
+        return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+
+    double h(double x) const
+    {
+        return std::exp(-m_s * std::log(x));
+    }
 
-// pair of uint64_t = 16 bytes
-using pair64_type = std::pair<uint64_t, uint64_t>;
+    double h_integral(double x) const
+    {
+        const double log_x = std::log(x);
+        return helper2((1.0 - m_s) * log_x) * log_x;
+    }
 
-// larger struct of 64 bytes
-using pair64_with_junk_type = std::tuple<
-          uint64_t, uint64_t,                                        // keys
-          uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t // junk
-          >;
+    double h_integral_inverse(double x) const
+    {
+        const double t = std::max(x * (1.0 - m_s), -1.0);
+        return std::exp(helper1(t) * x);
+    }
+};
 
-// construct a simple sorting benchmark for the value type
+//! Stream of size records whose keys follow a distribution.
 template <typename ValueType>
-class BenchmarkSort
+class record_stream
 {
+public:
     using value_type = ValueType;
 
-    struct value_key_second
+    record_stream(distribution dist, external_size_type size, unsigned seed)
+        : m_dist(dist), m_size(size), m_index(0),
+          m_rng(seed), m_zipf(std::max<external_size_type>(size, 1), 1.0)
     {
-        using key_type = typename std::tuple_element<1, value_type>::type;
+        m_value.key = next_key();
+    }
 
-        key_type operator () (const value_type& p) const
-        {
-            return std::get<1>(p);
-        }
+    const value_type& operator * () const
+    {
+        return m_value;
+    }
 
-        static value_type min_value()
-        {
-            value_type res;
-            std::get<0>(res) = std::numeric_limits<key_type>::min();
-            std::get<1>(res) = std::numeric_limits<key_type>::min();
-            return res;
-        }
+    record_stream& operator ++ ()
+    {
+        assert(m_index < m_size);
+        ++m_index;
+        m_value.key = next_key();
+        return *this;
+    }
+
+    bool empty() const
+    {
+        return m_index >= m_size;
+    }
+
+private:
+    distribution m_dist;
+    external_size_type m_size, m_index;
+    std::mt19937_64 m_rng;
+    zipf_distribution m_zipf;
+    value_type m_value;
+
+    //! bijective scramble such that frequent keys are spread over the key
+    //! range
+    static uint64_t scramble(uint64_t x)
+    {
+        return x * 0x9E3779B97F4A7C15ull;
+    }
 
-        static value_type max_value()
+    uint64_t next_key()
+    {
+        switch (m_dist)
         {
-            value_type res;
-            std::get<0>(res) = std::numeric_limits<key_type>::max();
-            std::get<1>(res) = std::numeric_limits<key_type>::max();
-            return res;
+        case distribution::uniform:
+            return m_rng();
+        case distribution::zipf:
+            return scramble(m_zipf(m_rng));
+        case distribution::sorted:
+            return m_index;
+        case distribution::reverse:
+            return m_size - m_index;
+        case distribution::few_unique:
+            return scramble(m_rng() % 16);
         }
-    };
+        return 0;
+    }
+};
 
-    struct random_stream
-    {
-        using value_type = ValueType;
+/******************************************************************************/
+// Engines and Results
 
-        value_type m_value;
+enum class engine {
+    sort, sort_radix, sample_sort, ksort, stable_ksort,
+    stream_sort, stream_radix, stream_sample_sort, stream_replacement
+};
 
-        external_size_type m_counter;
+static const char* engine_names[] = {
+    "sort", "sort_radix", "sample_sort", "ksort", "stable_ksort",
+    "stream_sort", "stream_radix", "stream_sample_sort", "stream_replacement"
+};
+
+//! One measurement: a sort of one configuration.
+struct result_row
+{
+    engine eng;
+    size_t record_size;
+    distribution dist;
+    size_t threads;
+    size_t ram;
+    unsigned repetition;
+    external_size_type items;
+
+    //! phase times in seconds, negative if the engine does not expose them
+    double run_formation = -1, merge = -1;
+    double total = 0;
+
+    foxxll::stats_data io;
+};
 
-        explicit random_stream(external_size_type size)
-            : m_counter(size)
+//! Writes results as CSV, JSON lines or RESULT lines.
+class result_writer
+{
+public:
+    enum format_type { csv, json, result };
+
+    result_writer(std::ostream& os, format_type format)
+        : m_os(os), m_format(format)
+    {
+        if (m_format == csv)
         {
-            std::get<0>(m_value) = m_rng();
-            std::get<1>(m_value) = m_rng();
+            m_os << "engine,record_size,distribution,threads,ram,repetition,"
+                 << "items,bytes,run_formation_s,merge_s,total_s,mib_per_s,"
+                 << "read_bytes,write_bytes,io_wait_s" << std::endl;
         }
+    }
+
+    void write(const result_row& r)
+    {
+        const external_size_type bytes = r.items * r.record_size;
+        const double mib_per_s =
+            r.total > 0 ? static_cast<double>(bytes) / MB / r.total : 0;
 
-        const value_type& operator * () const
+        if (m_format == csv)
         {
-            return m_value;
+            m_os << engine_names[static_cast<int>(r.eng)] << ','
+                 << r.record_size << ','
+                 << distribution_names[static_cast<int>(r.dist)] << ','
+                 << r.threads << ',' << r.ram << ',' << r.repetition << ','
+                 << r.items << ',' << bytes << ',';
+            phase(r.run_formation, "", ",");
+            phase(r.merge, "", ",");
+            m_os << r.total << ',' << mib_per_s << ','
+                 << r.io.get_read_bytes() << ',' << r.io.get_write_bytes() << ','
+                 << r.io.get_io_wait_time() << std::endl;
         }
-
-        random_stream& operator ++ ()
+        else if (m_format == json)
         {
-            assert(m_counter > 0);
-            --m_counter;
-
-            std::get<0>(m_value) = m_rng();
-            std::get<1>(m_value) = m_rng();
-            return *this;
+            m_os << "{\"engine\":\"" << engine_names[static_cast<int>(r.eng)] << '"'
+                 << ",\"record_size\":" << r.record_size
+                 << ",\"distribution\":\"" << distribution_names[static_cast<int>(r.dist)] << '"'
+                 << ",\"threads\":" << r.threads
+                 << ",\"ram\":" << r.ram
+                 << ",\"repetition\":" << r.repetition
+                 << ",\"items\":" << r.items
+                 << ",\"bytes\":" << bytes;
+            phase(r.run_formation, ",\"run_formation_s\":", "");
+            phase(r.merge, ",\"merge_s\":", "");
+            m_os << ",\"total_s\":" << r.total
+                 << ",\"mib_per_s\":" << mib_per_s
+                 << ",\"read_bytes\":" << r.io.get_read_bytes()
+                 << ",\"write_bytes\":" << r.io.get_write_bytes()
+                 << ",\"io_wait_s\":" << r.io.get_io_wait_time()
+                 << '}' << std::endl;
         }
-
-        bool empty() const
+        else
         {
-            return (m_counter == 0);
+            m_os << "RESULT benchmark=sort"
+                 << " engine=" << engine_names[static_cast<int>(r.eng)]
+                 << " record_size=" << r.record_size
+                 << " distribution=" << distribution_names[static_cast<int>(r.dist)]
+                 << " threads=" << r.threads
+                 << " ram=" << r.ram
+                 << " repetition=" << r.repetition
+                 << " items=" << r.items
+                 << " bytes=" << bytes;
+            if (r.run_formation >= 0)
+                m_os << " run_formation_time=" << r.run_formation
+                     << " merge_time=" << r.merge;
+            m_os << " time=" << r.total
+                 << " mib_per_s=" << mib_per_s
+                 << " read_bytes=" << r.io.get_read_bytes()
+                 << " write_bytes=" << r.io.get_write_bytes()
+                 << " wait_io_time=" << r.io.get_io_wait_time()
+                 << std::endl;
         }
+    }
 
-    private:
-        using key_type = typename std::tuple_element<0, value_type>::type;
-        std::default_random_engine m_rng;
-    };
+private:
+    std::ostream& m_os;
+    format_type m_format;
 
-    static void output_result(double elapsed, external_size_type vec_size)
+    //! write a phase time, null or empty if not available
+    void phase(double t, const char* prefix, const char* suffix)
     {
-        std::cout << "finished in " << elapsed << " seconds @ "
-                  << (static_cast<double>(vec_size) * sizeof(value_type) / MB / elapsed)
-                  << " MiB/s" << std::endl;
+        m_os << prefix;
+        if (t >= 0)
+            m_os << t;
+        else if (m_format == json)
+            m_os << "null";
+        m_os << suffix;
     }
+};
 
-public:
-    BenchmarkSort(const char* desc, external_size_type length, size_t memsize)
-    {
-        // construct vector
-        external_size_type vec_size = foxxll::div_ceil(length, sizeof(ValueType));
+/******************************************************************************/
+// Benchmark of one Record Type
+
+//! Configuration of a sweep over engines, distributions, threads and memory
+//! budgets.
+struct benchmark_config
+{
+    external_size_type length;
+    std::vector<engine> engines;
+    std::vector<distribution> dists;
+    std::vector<size_t> threads;
+    std::vector<size_t> rams;
+    unsigned repetitions;
+    unsigned seed;
+    bool check;
+};
 
-        stxxl::vector<ValueType> vec(vec_size);
+template <typename ValueType>
+class BenchmarkSort
+{
+    using value_type = ValueType;
+    using vector_type = stxxl::vector<value_type>;
+    using stream_type = record_stream<value_type>;
+
+    using cmp_type = typename value_type::compare_less;
+    using radix_cmp_type = radix_compare<value_type>;
+    using key_extract_type = typename value_type::key_extract;
 
-        auto comp_fst = stxxl::make_struct_comparator<value_type>([](auto& o) { return std::tie(std::get<0>(o)); });
+    const benchmark_config& m_config;
+    result_writer& m_writer;
 
-        // construct random stream
-        std::cout << "#!!! running sorting test with " << desc << " = " << sizeof(ValueType) << " bytes."
-                  << std::endl;
+    //! Sort a vector in place, only the total time is observable.
+    void run_vector(engine eng, result_row& row)
+    {
+        vector_type vec(row.items);
         {
-            std::cout << "# materialize random_stream into vector of size " << vec.size() << std::endl;
-            double ts1 = timestamp();
+            stream_type input(row.dist, row.items, m_config.seed + row.repetition);
+            stxxl::stream::materialize(input, vec.begin(), vec.end());
+        }
 
-            random_stream rs(vec_size);
-            stxxl::stream::materialize(rs, vec.begin(), vec.end());
+        foxxll::stats_data stats_begin(*foxxll::stats::get_instance());
+        const double ts = timestamp();
 
-            double elapsed = timestamp() - ts1;
-            output_result(elapsed, vec_size);
-        }
+        switch (eng)
         {
-            std::cout << "# stxxl::sort vector of size " << vec.size() << std::endl;
-            double ts1 = timestamp();
+        case engine::sort:
+            stxxl::sort(vec.begin(), vec.end(), cmp_type(), row.ram);
+            break;
+        case engine::sort_radix:
+            stxxl::sort(vec.begin(), vec.end(), radix_cmp_type(), row.ram);
+            break;
+        case engine::sample_sort:
+            stxxl::SETTINGS::sample_sort = true;
+            stxxl::sort(vec.begin(), vec.end(), cmp_type(), row.ram);
+            stxxl::SETTINGS::sample_sort = false;
+            break;
+        case engine::ksort:
+            stxxl::ksort(vec.begin(), vec.end(), key_extract_type(), row.ram);
+            break;
+        case engine::stable_ksort:
+            stxxl::stable_ksort(vec.begin(), vec.end(), key_extract_type(), row.ram);
+            break;
+        default:
+            abort();
+        }
 
-            stxxl::sort(vec.begin(), vec.end(), comp_fst, memsize);
+        row.total = timestamp() - ts;
+        row.io = foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
 
-            double elapsed = timestamp() - ts1;
-            output_result(elapsed, vec_size);
+        if (m_config.check)
+            die_unless(stxxl::is_sorted(vec.cbegin(), vec.cend(), cmp_type()));
+    }
+
+    //! Sort a generated stream with a runs creator and a runs merger, timing
+    //! run formation (including generating the input) and merge apart.
+    template <typename RunsCreator, typename CompareType>
+    void run_stream(CompareType cmp, result_row& row)
+    {
+        using merger_type = stxxl::stream::runs_merger<
+                  typename RunsCreator::sorted_runs_type, CompareType>;
+
+        foxxll::stats_data stats_begin(*foxxll::stats::get_instance());
+        const double ts = timestamp();
+
+        stream_type input(row.dist, row.items, m_config.seed + row.repetition);
+        RunsCreator creator(input, cmp, row.ram);
+        typename RunsCreator::sorted_runs_type& runs = creator.result();
+
+        const double ts_merge = timestamp();
+        row.run_formation = ts_merge - ts;
+
+        merger_type merger(runs, cmp, row.ram);
+        if (m_config.check)
+        {
+            external_size_type count = 0;
+            value_type last = cmp.min_value();
+            for ( ; !merger.empty(); ++merger, ++count)
+            {
+                die_unless(!cmp(*merger, last));
+                last = *merger;
+            }
+            die_unequal(count, row.items);
         }
+        else
         {
-            std::cout << "# stxxl::ksort vector of size " << vec.size() << std::endl;
-            double ts1 = timestamp();
+            stxxl::stream::discard(merger);
+        }
 
-            stxxl::ksort(vec.begin(), vec.end(), value_key_second(), memsize);
+        const double te = timestamp();
+        row.merge = te - ts_merge;
+        row.total = te - ts;
+        row.io = foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+    }
 
-            double elapsed = timestamp() - ts1;
-            output_result(elapsed, vec_size);
-        }
-        vec.clear();
+    void run(engine eng, result_row& row)
+    {
+        using stxxl::stream::runs_creator;
 
+        switch (eng)
         {
-            std::cout << "# stxxl::stream::sort of size " << vec_size << std::endl;
-            double ts1 = timestamp();
-            using random_stream_sort_type = stxxl::stream::sort<random_stream, decltype(comp_fst)>;
+        case engine::stream_sort:
+            return run_stream<runs_creator<stream_type, cmp_type> >(cmp_type(), row);
+        case engine::stream_radix:
+            return run_stream<runs_creator<
+                                  stream_type, cmp_type,
+                                  STXXL_DEFAULT_BLOCK_SIZE(value_type),
+                                  foxxll::default_alloc_strategy,
+                                  key_extract_type> >(cmp_type(), row);
+        case engine::stream_sample_sort:
+            return run_stream<runs_creator<
+                                  stxxl::stream::use_sample_sort<value_type>,
+                                  cmp_type> >(cmp_type(), row);
+        case engine::stream_replacement:
+            return run_stream<runs_creator<
+                                  stxxl::stream::use_replacement_selection<value_type>,
+                                  cmp_type> >(cmp_type(), row);
+        default:
+            return run_vector(eng, row);
+        }
+    }
 
-            random_stream stream(vec_size);
-            random_stream_sort_type stream_sort(stream, comp_fst, memsize);
+public:
+    BenchmarkSort(const benchmark_config& config, result_writer& writer)
+        : m_config(config), m_writer(writer)
+    {
+        result_row row;
+        row.record_size = sizeof(value_type);
+        row.items = foxxll::div_ceil(config.length, sizeof(value_type));
 
-            stxxl::stream::discard(stream_sort);
+        for (size_t threads : config.threads)
+        {
+            row.threads = threads;
+#if STXXL_PARALLEL
+            omp_set_num_threads(static_cast<int>(threads));
+#endif
+            stxxl::SETTINGS::parallel_run_formation = (threads > 1);
+
+            for (size_t ram : config.rams)
+            {
+                row.ram = ram;
+                for (distribution dist : config.dists)
+                {
+                    row.dist = dist;
+                    for (engine eng : config.engines)
+                    {
+                        row.eng = eng;
+                        for (unsigned r = 0; r < config.repetitions; ++r)
+                        {
+                            row.repetition = r;
+                            row.run_formation = row.merge = -1;
+                            try {
+                                run(eng, row);
+                            }
+                            catch (const std::exception& e) {
+                                LOG1 << "# " << engine_names[static_cast<int>(eng)]
+                                     << " with " << row.record_size
+                                     << " byte records failed: " << e.what();
+                                continue;
+                            }
+                            m_writer.write(row);
+                        }
+                    }
+                }
+            }
+        }
+        stxxl::SETTINGS::parallel_run_formation = false;
+    }
+};
+
+/******************************************************************************/
+// Command Line
 
-            double elapsed = timestamp() - ts1;
-            output_result(elapsed, vec_size);
+//! Look up a comma-separated list of names in a table, die on unknown names.
+template <typename Enum, size_t N>
+static std::vector<Enum> parse_names(const std::string& list,
+                                     const char* (&names)[N])
+{
+    std::vector<Enum> out;
+    for (const std::string& s : tlx::split(',', list))
+    {
+        if (s == "all")
+        {
+            for (size_t i = 0; i < N; ++i)
+                out.push_back(static_cast<Enum>(i));
+            continue;
         }
+        size_t i = 0;
+        while (i < N && s != names[i])
+            ++i;
+        die_unless(i < N && "unknown name in list");
+        out.push_back(static_cast<Enum>(i));
+    }
+    return out;
+}
 
-        std::cout << std::endl;
+//! Parse a comma-separated list of amounts, with units for bytes.
+static std::vector<size_t> parse_amounts(const std::string& list, bool bytes)
+{
+    std::vector<size_t> out;
+    for (const std::string& s : tlx::split(',', list))
+    {
+        uint64_t value;
+        if (bytes)
+            die_unless(tlx::parse_si_iec_units(s.c_str(), &value) && "invalid amount");
+        else
+            value = std::stoull(s);
+        out.push_back(static_cast<size_t>(value));
     }
-};
+    return out;
+}
 
-// run sorting benchmark for the three types defined above.
+template <size_t Size>
+static void benchmark_size(const benchmark_config& config, result_writer& writer)
+{
+    BenchmarkSort<record_type<Size> >(config, writer);
+}
+
+// run the sorting benchmark suite
 int benchmark_sort(int argc, char* argv[])
 {
     // parse command line
     stxxl::cmdline_parser cp;
 
-    cp.set_description(
-        "This program will benchmark the different sorting methods provided by "
-        "STXXL using three different data types: first a pair of 32-bit uints, "
-        "then a pair 64-bit uint and then a larger structure of 64 bytes.");
+    cp.set_description(description);
     cp.set_author("Timo Bingmann <tb@panthema.net>");
 
     external_size_type length = 0;
     cp.add_param_bytes("size", length,
                        "Amount of data to sort (e.g. 1GiB)");
 
-    std::uint64_t memsize = 256 * MB;
-    cp.add_bytes('M', "ram", memsize,
-                 "Amount of RAM to use when sorting, default: 256 MiB");
+    std::string rams = "256MiB";
+    cp.add_string('M', "ram", rams,
+                  "Comma-separated amounts of RAM to use when sorting, "
+                  "default: 256MiB");
+
+    std::string engines = "all";
+    cp.add_string('e', "engines", engines,
+                  "Comma-separated engines, default: all");
+
+    std::string dists = "uniform";
+    cp.add_string('d', "distributions", dists,
+                  "Comma-separated key distributions or all, "
+                  "default: uniform");
+
+    std::string sizes = "8,16,64";
+    cp.add_string('s', "record-sizes", sizes,
+                  "Comma-separated record sizes out of 8, 16, 32, 64, 128 "
+                  "and 256 bytes, default: 8,16,64");
+
+    std::string threads = "1";
+    cp.add_string('t', "threads", threads,
+                  "Comma-separated thread counts, default: 1");
+
+    unsigned repetitions = 1;
+    cp.add_uint('r', "repetitions", repetitions,
+                "Repetitions of each configuration, default: 1");
+
+    unsigned seed = 1;
+    cp.add_uint('S', "seed", seed, "Seed of the generated keys, default: 1");
+
+    std::string format = "csv";
+    cp.add_string('f', "format", format,
+                  "Output format: csv (default), json (one object per line) "
+                  "or result (RESULT lines)");
+
+    std::string output;
+    cp.add_string('o', "output", output,
+                  "Write the results to a file instead of stdout");
+
+    bool check = false;
+    cp.add_flag('c', "check", check, "Verify the order of the sorted output");
 
     if (!cp.process(argc, argv))
         return -1;
 
-    BenchmarkSort<pair32_type>(
-        "pair of uint32_t", length, memsize);
+    benchmark_config config;
+    config.length = length;
+    config.engines = parse_names<engine>(engines, engine_names);
+    config.dists = parse_names<distribution>(dists, distribution_names);
+    config.threads = parse_amounts(threads, false);
+    config.rams = parse_amounts(rams, true);
+    config.repetitions = repetitions;
+    config.seed = seed;
+    config.check = check;
+
+#if !STXXL_PARALLEL
+    for (size_t& t : config.threads)
+    {
+        if (t != 1)
+            LOG1 << "# built without parallelism, running " << t << " threads as 1";
+        t = 1;
+    }
+#endif
+
+    result_writer::format_type format_type;
+    if (format == "csv")
+        format_type = result_writer::csv;
+    else if (format == "json")
+        format_type = result_writer::json;
+    else if (format == "result")
+        format_type = result_writer::result;
+    else
+    {
+        cp.print_usage();
+        return -1;
+    }
 
-    BenchmarkSort<pair64_type>(
-        "pair of uint64_t", length, memsize);
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output.c_str());
+        die_unless(file.good() && "cannot open output file");
+    }
+    result_writer writer(output.empty() ? std::cout : file, format_type);
 
-    static_assert(sizeof(pair64_with_junk_type) == 64, "Junk type too small");
-    BenchmarkSort<pair64_with_junk_type>(
-        "struct of 64 bytes", length, memsize);
+    for (size_t size : parse_amounts(sizes, false))
+    {
+        switch (size)
+        {
+        case 8: benchmark_size<8>(config, writer);
+            break;
+        case 16: benchmark_size<16>(config, writer);
+            break;
+        case 32: benchmark_size<32>(config, writer);
+            break;
+        case 64: benchmark_size<64>(config, writer);
+            break;
+        case 128: benchmark_size<128>(config, writer);
+            break;
+        case 256: benchmark_size<256>(config, writer);
+            break;
+        default:
+            LOG1 << "# unsupported record size " << size;
+        }
+    }
 
     return 0;
 }
@@ -0,0 +1,672 @@
+/***************************************************************************
+ *  tools/benchmarks/pq_trace_benchmark.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+static const char* description =
+    "Benchmark the external priority queues on recorded operation traces. "
+    "A trace of pushes and pops is recorded from a workload: Dijkstra's "
+    "algorithm on a DIMACS graph or a random graph, time-forward processing "
+    "of a random DAG, or a hold-model event simulation. The trace file is "
+    "then replayed against priority_queue, parallel_priority_queue, "
+    "radix_priority_queue (if the trace is monotone) and std::priority_queue "
+    "with the same memory budget. Each replay checks the popped keys and "
+    "reports RESULT lines with the throughput, the I/O volume and "
+    "percentiles of the pop latency.";
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+#include <tlx/math/integer_log2.hpp>
+#include <tlx/string/split.hpp>
+
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io/iostats.hpp>
+
+#include <stxxl/bits/common/cmdline.h>
+#include <stxxl/parallel_priority_queue>
+#include <stxxl/priority_queue>
+#include <stxxl/radix_priority_queue>
+
+#include "../../tests/include/key_with_padding.h"
+
+static const size_t MiB = 1024 * 1024;
+
+// elements of the queues: 64-bit key with 8 bytes payload
+using value_type = key_with_padding<uint64_t, 16>;
+static_assert(sizeof(value_type) == 16, "value_type has invalid size");
+
+/******************************************************************************/
+// Trace Files
+
+//! One recorded operation: push of an element with key, or pop of an
+//! element whose key must be key.
+struct trace_op
+{
+    uint64_t key;
+    uint32_t is_pop;
+    uint32_t reserved;
+};
+
+static const char trace_magic[8] = { 'S', 'T', 'X', 'X', 'L', 'P', 'Q', 'T' };
+
+//! Header of a trace file, followed by num_ops trace_op records.
+struct trace_header
+{
+    char magic[8];
+    uint64_t num_ops;
+    uint64_t num_pops;
+    //! maximum queue size during the trace
+    uint64_t max_size;
+    //! no pushed key is smaller than the key of the last pop
+    uint32_t monotone;
+    uint32_t reserved;
+};
+
+//! Records a trace while a workload runs on an in-memory queue, which also
+//! yields the keys the replays must pop.
+class trace_writer
+{
+public:
+    explicit trace_writer(const std::string& path)
+        : m_file(path.c_str(), std::ios::binary | std::ios::trunc)
+    {
+        die_unless(m_file.good() && "cannot open trace file for writing");
+        std::memset(&m_header, 0, sizeof(m_header));
+        std::memcpy(m_header.magic, trace_magic, sizeof(trace_magic));
+        m_header.monotone = 1;
+        m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+        m_buffer.reserve(buffer_size);
+    }
+
+    ~trace_writer()
+    {
+        flush();
+        m_file.seekp(0);
+        m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    }
+
+    void push(uint64_t key)
+    {
+        if (key < m_last_pop)
+            m_header.monotone = 0;
+        m_queue.push(key);
+        m_header.max_size = std::max<uint64_t>(m_header.max_size, m_queue.size());
+        append(trace_op { key, 0, 0 });
+    }
+
+    //! Pop the smallest key.
+    uint64_t pop()
+    {
+        assert(!m_queue.empty());
+        const uint64_t key = m_queue.top();
+        m_queue.pop();
+        m_last_pop = key;
+        ++m_header.num_pops;
+        append(trace_op { key, 1, 0 });
+        return key;
+    }
+
+    //! Smallest key, without recording an operation.
+    uint64_t top() const
+    {
+        assert(!m_queue.empty());
+        return m_queue.top();
+    }
+
+    bool empty() const
+    {
+        return m_queue.empty();
+    }
+
+    const trace_header & header() const
+    {
+        return m_header;
+    }
+
+private:
+    static constexpr size_t buffer_size = 1024 * 1024 / sizeof(trace_op);
+
+    std::ofstream m_file;
+    trace_header m_header;
+    std::vector<trace_op> m_buffer;
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t> > m_queue;
+    uint64_t m_last_pop = 0;
+
+    void append(const trace_op& op)
+    {
+        m_buffer.push_back(op);
+        ++m_header.num_ops;
+        if (m_buffer.size() == buffer_size)
+            flush();
+    }
+
+    void flush()
+    {
+        m_file.write(reinterpret_cast<const char*>(m_buffer.data()),
+                     static_cast<std::streamsize>(m_buffer.size() * sizeof(trace_op)));
+        m_buffer.clear();
+    }
+};
+
+//! Reads the operations of a trace file in chunks.
+class trace_reader
+{
+public:
+    explicit trace_reader(const std::string& path)
+        : m_file(path.c_str(), std::ios::binary)
+    {
+        die_unless(m_file.good() && "cannot open trace file");
+        m_file.read(reinterpret_cast<char*>(&m_header), sizeof(m_header));
+        die_unless(m_file.good() &&
+                   std::memcmp(m_header.magic, trace_magic, sizeof(trace_magic)) == 0 &&
+                   "not a priority queue trace file");
+    }
+
+    const trace_header & header() const
+    {
+        return m_header;
+    }
+
+    //! Read the next chunk of operations into ops, empty at the end.
+    void next_chunk(std::vector<trace_op>& ops)
+    {
+        ops.resize(chunk_size);
+        m_file.read(reinterpret_cast<char*>(ops.data()),
+                    static_cast<std::streamsize>(chunk_size * sizeof(trace_op)));
+        ops.resize(static_cast<size_t>(m_file.gcount()) / sizeof(trace_op));
+    }
+
+private:
+    static constexpr size_t chunk_size = 1024 * 1024 / sizeof(trace_op);
+
+    std::ifstream m_file;
+    trace_header m_header;
+};
+
+/******************************************************************************/
+// Workloads
+
+//! Directed graph with integer edge weights in adjacency array format.
+struct graph_type
+{
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> targets;
+    std::vector<uint32_t> weights;
+
+    size_t num_nodes() const
+    {
+        return offsets.size() - 1;
+    }
+
+    //! Build the adjacency arrays of edges (source, target, weight).
+    void build(size_t n, std::vector<std::tuple<uint32_t, uint32_t, uint32_t> >& edges)
+    {
+        std::sort(edges.begin(), edges.end());
+        offsets.assign(n + 1, 0);
+        targets.resize(edges.size());
+        weights.resize(edges.size());
+        for (size_t i = 0; i < edges.size(); ++i)
+        {
+            ++offsets[std::get<0>(edges[i]) + 1];
+            targets[i] = std::get<1>(edges[i]);
+            weights[i] = std::get<2>(edges[i]);
+        }
+        for (size_t v = 0; v < n; ++v)
+            offsets[v + 1] += offsets[v];
+    }
+};
+
+//! Read a graph in DIMACS shortest path format: "p sp n m" and "a u v w"
+//! lines with nodes numbered from 1.
+static void read_dimacs_graph(const std::string& path, graph_type& g)
+{
+    std::ifstream in(path.c_str());
+    die_unless(in.good() && "cannot open graph file");
+
+    size_t n = 0;
+    std::vector<std::tuple<uint32_t, uint32_t, uint32_t> > edges;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream ls(line);
+        char type;
+        if (!(ls >> type))
+            continue;
+        if (type == 'p')
+        {
+            std::string format;
+            size_t m;
+            ls >> format >> n >> m;
+            edges.reserve(m);
+        }
+        else if (type == 'a')
+        {
+            uint32_t u, v, w;
+            ls >> u >> v >> w;
+            die_unless(u >= 1 && u <= n && v >= 1 && v <= n);
+            edges.emplace_back(u - 1, v - 1, w);
+        }
+    }
+    g.build(n, edges);
+}
+
+//! Random graph of n nodes with degree random out-edges each and a
+//! Hamiltonian cycle, such that all nodes are reachable from node 0.
+static void random_graph(size_t n, size_t degree, std::mt19937_64& rng, graph_type& g)
+{
+    std::uniform_int_distribution<uint32_t> node(0, static_cast<uint32_t>(n - 1));
+    std::uniform_int_distribution<uint32_t> weight(1, 1000);
+
+    std::vector<std::tuple<uint32_t, uint32_t, uint32_t> > edges;
+    edges.reserve(n * (degree + 1));
+    for (uint32_t v = 0; v < n; ++v)
+    {
+        edges.emplace_back(v, static_cast<uint32_t>((v + 1) % n), weight(rng));
+        for (size_t i = 0; i < degree; ++i)
+            edges.emplace_back(v, node(rng), weight(rng));
+    }
+    g.build(n, edges);
+}
+
+//! Dijkstra's algorithm from node 0 without decrease-key: each improved
+//! tentative distance is pushed, stale entries are popped and skipped. The
+//! keys are distance * n + node, such that a pop identifies the node.
+static void record_dijkstra(const graph_type& g, trace_writer& trace)
+{
+    const uint64_t n = g.num_nodes();
+    std::vector<uint64_t> dist(n, std::numeric_limits<uint64_t>::max());
+    dist[0] = 0;
+    trace.push(0);
+    while (!trace.empty())
+    {
+        const uint64_t key = trace.pop();
+        const uint64_t v = key % n, d = key / n;
+        if (d != dist[v])
+            continue;
+        for (uint64_t e = g.offsets[v]; e < g.offsets[v + 1]; ++e)
+        {
+            const uint64_t u = g.targets[e], du = d + g.weights[e];
+            if (du < dist[u])
+            {
+                dist[u] = du;
+                trace.push(du * n + u);
+            }
+        }
+    }
+}
+
+//! Time-forward processing of a random DAG of n nodes: node v, in
+//! topological order, pops the messages sent to it and sends a message to
+//! each of degree random successors within a window of later nodes. The
+//! keys are the target nodes.
+static void record_tfp(size_t n, size_t degree, std::mt19937_64& rng, trace_writer& trace)
+{
+    const size_t window = std::max<size_t>(16, n / 64);
+    std::uniform_int_distribution<uint64_t> offset(1, window);
+    for (uint64_t v = 0; v < n; ++v)
+    {
+        // the messages to v are on top, as all other keys are larger
+        while (!trace.empty() && trace.top() == v)
+            trace.pop();
+        for (size_t i = 0; i < degree; ++i)
+        {
+            const uint64_t u = v + offset(rng);
+            if (u < n)
+                trace.push(u);
+        }
+    }
+}
+
+//! Hold model of a discrete event simulation with a population of events:
+//! each step pops the next event and schedules one, or with small
+//! probability two or none, at an exponentially distributed delay. The keys
+//! are the event times in ticks.
+static void record_event(size_t population, size_t steps, std::mt19937_64& rng,
+                         trace_writer& trace)
+{
+    std::exponential_distribution<double> delay(1.0 / 1000.0);
+    std::uniform_int_distribution<int> churn(0, 99);
+    for (size_t i = 0; i < population; ++i)
+        trace.push(static_cast<uint64_t>(delay(rng)));
+    for (size_t s = 0; s < steps && !trace.empty(); ++s)
+    {
+        const uint64_t now = trace.pop();
+        const int c = churn(rng);
+        const size_t spawn = c == 0 ? 0 : c == 1 ? 2 : 1;
+        for (size_t i = 0; i < spawn; ++i)
+            trace.push(now + static_cast<uint64_t>(delay(rng)));
+    }
+    while (!trace.empty())
+        trace.pop();
+}
+
+/******************************************************************************/
+// Queues
+
+//! Log-scale histogram of latencies with eight bins per power of two, i.e.
+//! at most 12.5% relative error.
+class latency_histogram
+{
+public:
+    latency_histogram()
+        : m_bins(64 * 8, 0), m_count(0), m_max(0)
+    { }
+
+    void add(uint64_t ns)
+    {
+        ++m_bins[bin(ns)];
+        ++m_count;
+        m_max = std::max(m_max, ns);
+    }
+
+    //! Latency in ns below which a fraction q of the samples lie.
+    uint64_t percentile(double q) const
+    {
+        const uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(m_count));
+        uint64_t sum = 0;
+        for (size_t b = 0; b < m_bins.size(); ++b)
+        {
+            sum += m_bins[b];
+            if (sum > rank)
+                return std::min(lower_bound(b + 1), m_max);
+        }
+        return m_max;
+    }
+
+    uint64_t max() const
+    {
+        return m_max;
+    }
+
+private:
+    std::vector<uint64_t> m_bins;
+    uint64_t m_count, m_max;
+
+    static size_t bin(uint64_t ns)
+    {
+        if (ns < 8)
+            return static_cast<size_t>(ns);
+        const unsigned e = tlx::integer_log2_floor(ns);
+        return (e - 2) * 8 + static_cast<size_t>((ns >> (e - 3)) & 7);
+    }
+
+    static uint64_t lower_bound(size_t b)
+    {
+        if (b < 8)
+            return b;
+        return (8 + uint64_t(b % 8)) << (b / 8 - 1);
+    }
+};
+
+//! Wrapper of the STXXL PQ with half of the memory for the queue.
+template <size_t RAM>
+class stxxl_pq
+    : public stxxl::PRIORITY_QUEUE_GENERATOR<
+          value_type, value_type::compare_greater, RAM / 2, RAM / sizeof(value_type) * 32 / 1024>::result
+{
+public:
+    using pq_type = typename stxxl::PRIORITY_QUEUE_GENERATOR<
+              value_type, value_type::compare_greater, RAM / 2, RAM / sizeof(value_type) * 32 / 1024>::result;
+
+    stxxl_pq()
+        : pq_type(RAM / 4, RAM / 4)
+    { }
+};
+
+//! Wrapper of the parallel PQ.
+template <size_t RAM>
+class stxxl_ppq
+    : public stxxl::parallel_priority_queue<value_type, value_type::compare_greater>
+{
+public:
+    using pq_type = stxxl::parallel_priority_queue<value_type, value_type::compare_greater>;
+
+    stxxl_ppq()
+        : pq_type(value_type::compare_greater(), RAM)
+    { }
+};
+
+//! Wrapper of the radix PQ, with smaller blocks than the default, as each
+//! used bucket holds two blocks.
+template <size_t RAM>
+class stxxl_radix_pq
+    : public stxxl::radix_priority_queue<value_type, value_type::key_extract, 256 * 1024>
+{
+public:
+    using pq_type = stxxl::radix_priority_queue<value_type, value_type::key_extract, 256 * 1024>;
+    static constexpr size_t block_size = 256 * 1024;
+
+    //! blocks for the pools: the budget minus two blocks per bucket
+    static constexpr size_t pool_blocks =
+        RAM / block_size > 2 * pq_type::num_buckets + 4
+        ? (RAM / block_size - 2 * pq_type::num_buckets) / 2 : 2;
+
+    stxxl_radix_pq()
+        : pq_type(pool_blocks, pool_blocks)
+    { }
+};
+
+//! Wrapper of the STL PQ in internal memory, ignoring the budget.
+template <size_t RAM>
+class stl_pq
+    : public std::priority_queue<value_type, std::vector<value_type>,
+                                 value_type::compare_greater>
+{ };
+
+/******************************************************************************/
+// Replay
+
+static std::string g_trace_name; // NOLINT
+
+//! Replay a trace against a queue and print a RESULT line.
+template <typename Queue>
+static void replay(const std::string& path, const char* name, size_t ram)
+{
+    trace_reader trace(path);
+    const trace_header& header = trace.header();
+
+    Queue queue;
+    latency_histogram latency;
+    std::vector<trace_op> ops;
+
+    foxxll::stats_data stats_begin(*foxxll::stats::get_instance());
+    const double ts = foxxll::timestamp();
+
+    for (trace.next_chunk(ops); !ops.empty(); trace.next_chunk(ops))
+    {
+        for (const trace_op& op : ops)
+        {
+            if (!op.is_pop)
+            {
+                queue.push(value_type(op.key));
+                continue;
+            }
+
+            const auto t0 = std::chrono::steady_clock::now();
+            const uint64_t key = queue.top().key;
+            queue.pop();
+            const auto t1 = std::chrono::steady_clock::now();
+
+            latency.add(static_cast<uint64_t>(
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+            die_unequal(key, op.key);
+        }
+    }
+
+    const double elapsed = foxxll::timestamp() - ts;
+    const foxxll::stats_data io =
+        foxxll::stats_data(*foxxll::stats::get_instance()) - stats_begin;
+    die_unless(queue.empty());
+
+    std::cout << "RESULT benchmark=pq_trace"
+              << " trace=" << g_trace_name
+              << " queue=" << name
+              << " ram=" << ram
+              << " ops=" << header.num_ops
+              << " pops=" << header.num_pops
+              << " max_size=" << header.max_size
+              << " time=" << elapsed
+              << " ops_per_s=" << static_cast<double>(header.num_ops) / elapsed
+              << " read_bytes=" << io.get_read_bytes()
+              << " write_bytes=" << io.get_write_bytes()
+              << " wait_io_time=" << io.get_io_wait_time()
+              << " pop_p50_ns=" << latency.percentile(0.5)
+              << " pop_p90_ns=" << latency.percentile(0.9)
+              << " pop_p99_ns=" << latency.percentile(0.99)
+              << " pop_p999_ns=" << latency.percentile(0.999)
+              << " pop_max_ns=" << latency.max()
+              << std::endl;
+}
+
+template <size_t RAM>
+static void replay_all(const std::string& path, const std::vector<std::string>& queues)
+{
+    trace_reader trace(path);
+    for (const std::string& q : queues)
+    {
+        if (q == "pq")
+            replay<stxxl_pq<RAM> >(path, "pq", RAM);
+        else if (q == "ppq")
+            replay<stxxl_ppq<RAM> >(path, "ppq", RAM);
+        else if (q == "radix" && trace.header().monotone)
+            replay<stxxl_radix_pq<RAM> >(path, "radix", RAM);
+        else if (q == "radix")
+            LOG1 << "# trace is not monotone, skipping radix_priority_queue";
+        else if (q == "stl")
+            replay<stl_pq<RAM> >(path, "stl", RAM);
+        else
+            LOG1 << "# unknown queue " << q;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    stxxl::cmdline_parser cp;
+    cp.set_description(description);
+
+    std::string workload;
+    cp.add_param_string("workload", workload,
+                        "Workload to record: dijkstra, tfp or event; or "
+                        "replay to replay an existing trace file");
+
+    std::string trace_path = "pq_trace.bin";
+    cp.add_string('o', "trace", trace_path,
+                  "Trace file to record to or replay, default: pq_trace.bin");
+
+    std::string graph_path;
+    cp.add_string('g', "graph", graph_path,
+                  "Graph in DIMACS format for dijkstra, default: a random graph");
+
+    uint64_t size = 1000000;
+    cp.add_bytes('n', "size", size,
+                 "Nodes of the random graph or DAG, population of the "
+                 "event simulation, default: 1M");
+
+    unsigned degree = 4;
+    cp.add_uint('d', "degree", degree,
+                "Out-degree of the random graph or DAG, default: 4");
+
+    uint64_t steps = 0;
+    cp.add_bytes('s', "steps", steps,
+                 "Steps of the event simulation, default: 8 * size");
+
+    std::string queues = "pq,ppq,radix";
+    cp.add_string('q', "queues", queues,
+                  "Comma-separated queues to replay: pq, ppq, radix, stl; "
+                  "default: pq,ppq,radix");
+
+    unsigned config = 1;
+    cp.add_uint('p', "ram", config,
+                "Memory budget of every queue: 1 = 256 MiB (default), "
+                "2 = 1 GiB, 3 = 8 GiB");
+
+    unsigned seed = 1;
+    cp.add_uint('S', "seed", seed, "Seed of the random workloads, default: 1");
+
+    if (!cp.process(argc, argv))
+        return -1;
+
+    std::mt19937_64 rng(seed);
+    if (workload == "dijkstra")
+    {
+        graph_type g;
+        if (!graph_path.empty())
+            read_dimacs_graph(graph_path, g);
+        else
+            random_graph(size, degree, rng, g);
+        g_trace_name = "dijkstra";
+        trace_writer trace(trace_path);
+        record_dijkstra(g, trace);
+    }
+    else if (workload == "tfp")
+    {
+        g_trace_name = "tfp";
+        trace_writer trace(trace_path);
+        record_tfp(size, degree, rng, trace);
+    }
+    else if (workload == "event")
+    {
+        g_trace_name = "event";
+        trace_writer trace(trace_path);
+        record_event(size, steps ? steps : 8 * size, rng, trace);
+    }
+    else if (workload == "replay")
+    {
+        g_trace_name = trace_path;
+    }
+    else
+    {
+        cp.print_usage();
+        return -1;
+    }
+
+    {
+        trace_reader trace(trace_path);
+        LOG1 << "# trace " << trace_path << ": " << trace.header().num_ops
+             << " operations, " << trace.header().num_pops << " pops, maximum size "
+             << trace.header().max_size
+             << (trace.header().monotone ? ", monotone" : "");
+    }
+
+    const std::vector<std::string> queue_list = tlx::split(',', queues);
+    switch (config)
+    {
+    case 1:
+        replay_all<256* MiB>(trace_path, queue_list);
+        break;
+    case 2:
+        replay_all<1024* MiB>(trace_path, queue_list);
+        break;
+#if __x86_64__ || __LP64__ || (__WORDSIZE == 64)
+    case 3:
+        replay_all<8192* MiB>(trace_path, queue_list);
+        break;
+#endif
+    default:
+        LOG1 << "Invalid memory configuration.";
+        return -1;
+    }
+
+    return 0;
+}
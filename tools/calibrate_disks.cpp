@@ -0,0 +1,130 @@
+/***************************************************************************
+ *  tools/calibrate_disks.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <tlx/logger.hpp>
+#include <tlx/string/format_iec_units.hpp>
+
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io/request_operations.hpp>
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/config.hpp>
+#include <foxxll/mng/typed_block.hpp>
+
+#include <stxxl/bits/common/alloc_strategy.h>
+#include <stxxl/bits/common/cmdline.h>
+
+using foxxll::external_size_type;
+
+//! block size of the measurement, large enough for sequential throughput
+static constexpr size_t calibrate_block_size = 8 * 1024 * 1024;
+
+using calibrate_block_type = foxxll::typed_block<calibrate_block_size, uint64_t>;
+using calibrate_bid_type = foxxll::BID<calibrate_block_size>;
+
+//! Write and read back the blocks bids of one disk with num_buffers requests
+//! in flight, return the seconds taken by each phase.
+static void measure_disk(std::vector<calibrate_bid_type>& bids,
+                         std::vector<calibrate_block_type>& buffers,
+                         double& write_time, double& read_time)
+{
+    std::vector<foxxll::request_ptr> reqs(buffers.size());
+
+    for (int phase = 0; phase < 2; ++phase)
+    {
+        const double start = foxxll::timestamp();
+        for (size_t i = 0; i < bids.size(); i += buffers.size())
+        {
+            const size_t n = std::min(buffers.size(), bids.size() - i);
+            for (size_t j = 0; j < n; ++j)
+            {
+                reqs[j] = (phase == 0)
+                          ? buffers[j].write(bids[i + j])
+                          : buffers[j].read(bids[i + j]);
+            }
+            foxxll::wait_all(reqs.begin(), reqs.begin() + n);
+        }
+        (phase == 0 ? write_time : read_time) = foxxll::timestamp() - start;
+    }
+}
+
+int do_calibrate_disks(int argc, char* argv[])
+{
+    // parse command line
+    stxxl::cmdline_parser cp;
+
+    cp.set_description(
+        "Measure the sequential write and read throughput of each disk of the "
+        "STXXL configuration and save them for the weighted_striping "
+        "allocation strategy, which distributes blocks to the disks in "
+        "proportion to their speed. Load the file by setting "
+        "STXXL_DISK_WEIGHTS to its path.");
+
+    std::string output = "stxxl_disk_weights.txt";
+    cp.add_string('o', "output", output,
+                  "File to save the speeds to, default: stxxl_disk_weights.txt.");
+
+    external_size_type volume = 1024 * 1024 * 1024;
+    cp.add_bytes('s', "size", volume,
+                 "Bytes written to and read from each disk, default: 1 GiB.");
+
+    unsigned num_buffers = 8;
+    cp.add_uint('q', "queue", num_buffers,
+                "Number of 8 MiB requests in flight per disk, default: 8.");
+
+    if (!cp.process(argc, argv))
+        return -1;
+
+    foxxll::config* cfg = foxxll::config::get_instance();
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    stxxl::disk_weights& weights = stxxl::disk_weights::get_instance();
+
+    const size_t num_blocks = std::max<size_t>(
+        1, static_cast<size_t>(volume / calibrate_block_size));
+    std::vector<calibrate_block_type> buffers(std::max(1u, num_buffers));
+    for (calibrate_block_type& b : buffers)
+        std::fill(b.begin(), b.end(), 0x5555555555555555ull);
+
+    std::cout << std::setw(6) << "disk" << std::setw(14) << "write/s"
+              << std::setw(14) << "read/s" << "  path" << std::endl;
+
+    for (size_t d = 0; d < cfg->disks_number(); ++d)
+    {
+        std::vector<calibrate_bid_type> bids(num_blocks);
+        bm->new_blocks(foxxll::single_disk(d), bids.begin(), bids.end());
+
+        double write_time = 0, read_time = 0;
+        measure_disk(bids, buffers, write_time, read_time);
+        bm->delete_blocks(bids.begin(), bids.end());
+
+        const double bytes = static_cast<double>(num_blocks) * calibrate_block_size;
+        const double write_speed = bytes / std::max(write_time, 1e-9);
+        const double read_speed = bytes / std::max(read_time, 1e-9);
+        weights.set_speed(d, read_speed, write_speed);
+
+        std::cout << std::setw(6) << d
+                  << std::setw(13) << tlx::format_iec_units(static_cast<uint64_t>(write_speed)) << 'B'
+                  << std::setw(13) << tlx::format_iec_units(static_cast<uint64_t>(read_speed)) << 'B'
+                  << "  " << cfg->disk(d).path << std::endl;
+    }
+
+    weights.save(output);
+    LOG1 << "Saved disk speeds to \"" << output << "\".";
+
+    return 0;
+}
+
+/******************************************************************************/
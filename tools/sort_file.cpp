@@ -0,0 +1,471 @@
+/***************************************************************************
+ *  tools/sort_file.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+static const char* description =
+    "Sort a binary file of fixed-size records by a key at a given offset, in "
+    "place or into an output file. Integer keys of 1 to 8 bytes (uint or int, "
+    "little or big endian) are sorted by radix sorting the runs, other keys "
+    "(bytes, compared lexicographically as unsigned bytes) by comparison "
+    "sorting, and the runs are merged in parallel if STXXL is built with "
+    "parallelism. The time of run formation (reading the input) and of "
+    "merging (writing the output) is reported apart. The runs take as much "
+    "temporary space on the STXXL disks as the input.";
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <tlx/logger.hpp>
+#include <tlx/string/format_iec_units.hpp>
+
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io.hpp>
+#include <foxxll/io/iostats.hpp>
+
+#include <stxxl/bits/common/cmdline.h>
+#include <stxxl/bits/common/is_sorted.h>
+#include <stxxl/bits/parallel.h>
+#include <stxxl/stream>
+#include <stxxl/vector>
+
+using foxxll::timestamp;
+
+/******************************************************************************/
+// Records and Keys
+
+//! Record of Size bytes, whose key is described by a key_layout.
+template <size_t Size>
+struct file_record
+{
+    unsigned char bytes[Size];
+};
+
+enum class key_kind { unsigned_int, signed_int, bytes };
+
+//! Position, type and order of the key in the records.
+struct key_layout
+{
+    size_t offset;
+    size_t length;
+    key_kind kind;
+    bool big_endian;
+    bool descending;
+};
+
+//! Extracts integer keys as unsigned 64-bit integers ordered as the records
+//! are to be sorted: the sign bit of signed keys and all bits of descending
+//! keys are flipped. Also the key extractor of the radix sorted runs.
+template <typename Record>
+class integer_key_extract
+{
+public:
+    using key_type = uint64_t;
+
+    explicit integer_key_extract(const key_layout& layout)
+        : m_offset(layout.offset), m_length(layout.length),
+          m_big_endian(layout.big_endian),
+          m_mask(layout.length == 8 ? ~uint64_t(0)
+                 : (uint64_t(1) << (8 * layout.length)) - 1),
+          m_flip((layout.kind == key_kind::signed_int ? uint64_t(1) << (8 * layout.length - 1) : 0)
+                 ^ (layout.descending ? m_mask : 0))
+    { }
+
+    key_type operator () (const Record& r) const
+    {
+        const unsigned char* p = r.bytes + m_offset;
+        uint64_t x = 0;
+        if (m_big_endian)
+        {
+            for (size_t i = 0; i < m_length; ++i)
+                x = (x << 8) | p[i];
+        }
+        else
+        {
+            for (size_t i = m_length; i != 0; --i)
+                x = (x << 8) | p[i - 1];
+        }
+        return x ^ m_flip;
+    }
+
+    //! Record with all bytes zero but the key, whose extracted key is key.
+    Record make_record(key_type key) const
+    {
+        Record r;
+        std::fill(r.bytes, r.bytes + sizeof(r.bytes), 0);
+        uint64_t x = key ^ m_flip;
+        for (size_t i = 0; i < m_length; ++i, x >>= 8)
+            r.bytes[m_offset + (m_big_endian ? m_length - 1 - i : i)] = static_cast<unsigned char>(x);
+        return r;
+    }
+
+    //! largest extracted key
+    key_type max_key() const
+    {
+        return m_mask;
+    }
+
+private:
+    size_t m_offset, m_length;
+    bool m_big_endian;
+    uint64_t m_mask, m_flip;
+};
+
+//! Compares the records by their integer keys.
+template <typename Record>
+class integer_key_cmp
+{
+public:
+    explicit integer_key_cmp(const key_layout& layout)
+        : m_key(layout)
+    { }
+
+    bool operator () (const Record& a, const Record& b) const
+    {
+        return m_key(a) < m_key(b);
+    }
+
+    Record min_value() const
+    {
+        return m_key.make_record(0);
+    }
+
+    Record max_value() const
+    {
+        return m_key.make_record(m_key.max_key());
+    }
+
+private:
+    integer_key_extract<Record> m_key;
+};
+
+//! Compares the records by their keys as strings of unsigned bytes.
+template <typename Record>
+class bytes_key_cmp
+{
+public:
+    explicit bytes_key_cmp(const key_layout& layout)
+        : m_offset(layout.offset), m_length(layout.length),
+          m_descending(layout.descending)
+    { }
+
+    bool operator () (const Record& a, const Record& b) const
+    {
+        const int c = std::memcmp(a.bytes + m_offset, b.bytes + m_offset, m_length);
+        return m_descending ? c > 0 : c < 0;
+    }
+
+    Record min_value() const
+    {
+        return make_record(m_descending ? 0xFF : 0x00);
+    }
+
+    Record max_value() const
+    {
+        return make_record(m_descending ? 0x00 : 0xFF);
+    }
+
+private:
+    size_t m_offset, m_length;
+    bool m_descending;
+
+    Record make_record(unsigned char key_byte) const
+    {
+        Record r;
+        std::fill(r.bytes, r.bytes + sizeof(r.bytes), 0);
+        std::fill(r.bytes + m_offset, r.bytes + m_offset + m_length, key_byte);
+        return r;
+    }
+};
+
+/******************************************************************************/
+// Sorting
+
+//! Options of one sort.
+struct sort_config
+{
+    std::string input, output;
+    key_layout key;
+    bool radix;
+    size_t ram;
+    bool check;
+};
+
+template <size_t Size>
+class SortFile
+{
+    using record_type = file_record<Size>;
+
+    //! blocks of about 2 MiB holding whole records, a multiple of the page
+    //! size as required for vectors mapped to files
+    static constexpr size_t block_size = Size * 4096 * std::max<size_t>(1, 512 / Size);
+
+    using vector_type = stxxl::vector<record_type, 1, stxxl::lru_pager<8>, block_size>;
+    using stream_type = typename stxxl::stream::streamify_traits<
+              typename vector_type::const_iterator>::stream_type;
+
+    const sort_config& m_config;
+
+    //! Form the runs from the input, then merge them into the output.
+    template <typename CompareType, typename KeyExtractor>
+    void sort(vector_type& input, vector_type& output,
+              CompareType cmp, KeyExtractor keyobj)
+    {
+        using creator_type = stxxl::stream::runs_creator<
+                  stream_type, CompareType, block_size,
+                  stxxl::runtime_alloc_strategy, KeyExtractor>;
+        using merger_type = stxxl::stream::runs_merger<
+                  typename creator_type::sorted_runs_type, CompareType>;
+
+        foxxll::stats_data stats_begin(*foxxll::stats::get_instance());
+        const double ts = timestamp();
+
+        typename creator_type::sorted_runs_type runs;
+        {
+            stream_type in = stxxl::stream::streamify(input.cbegin(), input.cend());
+            creator_type creator(in, cmp, m_config.ram, keyobj);
+            runs = creator.result();
+        }
+
+        const double ts_merge = timestamp();
+        foxxll::stats_data stats_merge(*foxxll::stats::get_instance());
+        LOG1 << "Run formation: " << ts_merge - ts << " s, "
+             << runs->runs.size() << " runs, "
+             << (stats_merge - stats_begin).get_read_bytes() << " bytes read, "
+             << (stats_merge - stats_begin).get_write_bytes() << " bytes written";
+
+        {
+            merger_type merger(runs, cmp, m_config.ram);
+            stxxl::stream::materialize(merger, output.begin(), output.end());
+        }
+        output.flush();
+
+        const double te = timestamp();
+        foxxll::stats_data stats_end(*foxxll::stats::get_instance());
+        LOG1 << "Merge: " << te - ts_merge << " s, "
+             << (stats_end - stats_merge).get_read_bytes() << " bytes read, "
+             << (stats_end - stats_merge).get_write_bytes() << " bytes written";
+
+        const double bytes = static_cast<double>(input.size()) * Size;
+        LOG1 << "Sorted " << input.size() << " records of " << Size << " bytes in "
+             << te - ts << " s, "
+             << tlx::format_iec_units(static_cast<uint64_t>(bytes / std::max(te - ts, 1e-9)))
+             << "B/s, I/O wait " << (stats_end - stats_begin).get_io_wait_time() << " s";
+
+        if (m_config.check)
+        {
+            const bool sorted = stxxl::is_sorted(output.cbegin(), output.cend(), cmp);
+            LOG1 << "Checking order... " << (sorted ? "OK" : "WRONG");
+            if (!sorted)
+                throw std::runtime_error("output is not sorted");
+        }
+    }
+
+    void sort(vector_type& input, vector_type& output)
+    {
+        const bool radix = m_config.radix && m_config.key.kind != key_kind::bytes;
+        LOG1 << "Engine: " << (radix ? "radix" : "comparison") << " sorted runs, "
+             << (stxxl::do_parallel_merge() ? "parallel" : "sequential") << " merge";
+
+        if (m_config.key.kind == key_kind::bytes)
+        {
+            sort(input, output, bytes_key_cmp<record_type>(m_config.key),
+                 stxxl::stream::no_key_extractor());
+        }
+        else if (radix)
+        {
+            sort(input, output, integer_key_cmp<record_type>(m_config.key),
+                 integer_key_extract<record_type>(m_config.key));
+        }
+        else
+        {
+            sort(input, output, integer_key_cmp<record_type>(m_config.key),
+                 stxxl::stream::no_key_extractor());
+        }
+    }
+
+public:
+    explicit SortFile(const sort_config& config)
+        : m_config(config)
+    {
+        const bool in_place = config.output.empty();
+        foxxll::file_ptr in_file = tlx::make_counting<foxxll::syscall_file>(
+            config.input, foxxll::file::DIRECT |
+            (in_place ? foxxll::file::RDWR : foxxll::file::RDONLY));
+
+        if (in_file->size() % Size != 0)
+            throw std::runtime_error("the file size is not a multiple of the record size");
+
+        vector_type input(in_file);
+        if (in_place)
+        {
+            sort(input, input);
+        }
+        else
+        {
+            foxxll::file_ptr out_file = tlx::make_counting<foxxll::syscall_file>(
+                config.output, foxxll::file::DIRECT | foxxll::file::RDWR |
+                foxxll::file::CREAT | foxxll::file::TRUNC);
+            vector_type output(out_file);
+            output.resize(input.size());
+            sort(input, output);
+        }
+    }
+};
+
+template <size_t Size>
+static void sort_size(const sort_config& config)
+{
+    SortFile<Size> sort(config);
+}
+
+/******************************************************************************/
+// Command Line
+
+int do_sort_file(int argc, char* argv[])
+{
+    // parse command line
+    stxxl::cmdline_parser cp;
+
+    cp.set_description(description);
+
+    sort_config config;
+
+    cp.add_param_string("file", config.input, "File of records to sort");
+
+    cp.add_string('o', "output", config.output,
+                  "Write the sorted records to this file instead of sorting "
+                  "the input file in place");
+
+    unsigned record_size = 0;
+    cp.add_param_uint("record-size", record_size,
+                      "Bytes per record, one of 4, 8, 12, 16, 24, 32, 48, 64, "
+                      "100, 128, 256 and 512");
+
+    unsigned key_offset = 0;
+    cp.add_uint('k', "key-offset", key_offset,
+                "Offset of the key in the records, default: 0");
+
+    unsigned key_length = 8;
+    cp.add_uint('l', "key-length", key_length,
+                "Bytes of the key, up to 8 for integer keys, default: 8");
+
+    std::string key_type = "uint";
+    cp.add_string('t', "key-type", key_type,
+                  "Type of the key: uint (default), int or bytes");
+
+    bool big_endian = false;
+    cp.add_flag('b', "big-endian", big_endian,
+                "Integer keys are big endian instead of little endian");
+
+    std::string order = "asc";
+    cp.add_string('O', "order", order, "Order: asc (default) or desc");
+
+    std::string engine = "auto";
+    cp.add_string('e', "engine", engine,
+                  "Run formation: auto (default, radix for integer keys), "
+                  "radix or comparison");
+
+    uint64_t ram = 1024 * 1024 * 1024;
+    cp.add_bytes('M', "ram", ram,
+                 "Amount of RAM of run formation and merging, default: 1 GiB");
+
+    config.check = false;
+    cp.add_flag('c', "check", config.check, "Verify the order of the output");
+
+    if (!cp.process(argc, argv))
+        return -1;
+
+    config.key.offset = key_offset;
+    config.key.length = key_length;
+    config.key.big_endian = big_endian;
+    config.ram = static_cast<size_t>(ram);
+
+    if (key_type == "uint")
+        config.key.kind = key_kind::unsigned_int;
+    else if (key_type == "int")
+        config.key.kind = key_kind::signed_int;
+    else if (key_type == "bytes")
+        config.key.kind = key_kind::bytes;
+    else
+    {
+        LOG1 << "Unknown key type '" << key_type << "'";
+        return -1;
+    }
+
+    if (order != "asc" && order != "desc")
+    {
+        LOG1 << "Unknown order '" << order << "'";
+        return -1;
+    }
+    config.key.descending = (order == "desc");
+
+    if (engine != "auto" && engine != "radix" && engine != "comparison")
+    {
+        LOG1 << "Unknown engine '" << engine << "'";
+        return -1;
+    }
+    config.radix = (engine != "comparison");
+    if (engine == "radix" && config.key.kind == key_kind::bytes)
+    {
+        LOG1 << "The radix engine needs an integer key";
+        return -1;
+    }
+
+    if (key_length == 0 || key_offset + key_length > record_size ||
+        (config.key.kind != key_kind::bytes && key_length > 8))
+    {
+        LOG1 << "Invalid key of " << key_length << " bytes at offset "
+             << key_offset << " in records of " << record_size << " bytes";
+        return -1;
+    }
+
+    try {
+        switch (record_size)
+        {
+        case 4: sort_size<4>(config);
+            break;
+        case 8: sort_size<8>(config);
+            break;
+        case 12: sort_size<12>(config);
+            break;
+        case 16: sort_size<16>(config);
+            break;
+        case 24: sort_size<24>(config);
+            break;
+        case 32: sort_size<32>(config);
+            break;
+        case 48: sort_size<48>(config);
+            break;
+        case 64: sort_size<64>(config);
+            break;
+        case 100: sort_size<100>(config);
+            break;
+        case 128: sort_size<128>(config);
+            break;
+        case 256: sort_size<256>(config);
+            break;
+        case 512: sort_size<512>(config);
+            break;
+        default:
+            LOG1 << "Unsupported record size " << record_size;
+            return -1;
+        }
+    }
+    catch (const std::exception& e) {
+        LOG1 << "Sorting " << config.input << " failed: " << e.what();
+        return -1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************/
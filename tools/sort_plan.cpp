@@ -0,0 +1,97 @@
+/***************************************************************************
+ *  tools/sort_plan.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+static const char* description =
+    "Predict the runs, merge levels and I/O volume of sorting a number of "
+    "records of a given size with stxxl::sort and with stream::sort or "
+    "sorter, and the least memory which merges the runs in a single pass, "
+    "without sorting anything. The predictions follow the current settings "
+    "of the build, like the number of threads.";
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include <tlx/logger.hpp>
+#include <tlx/string/format_iec_units.hpp>
+
+#include <foxxll/io.hpp>
+
+#include <stxxl/bits/algo/sort_plan.h>
+#include <stxxl/bits/common/cmdline.h>
+#include <stxxl/bits/defines.h>
+
+static void print_plan(const char* name, const stxxl::sort_plan& p)
+{
+    std::cout << name << ":" << std::endl;
+    if (!p.feasible)
+    {
+        std::cout << "  insufficient memory, at least "
+                  << tlx::format_iec_units(p.min_memory) << "B are needed" << std::endl;
+        return;
+    }
+    if (p.in_memory)
+        std::cout << "  sorted in internal memory" << std::endl;
+    else
+        std::cout << "  runs:               " << p.runs << " of " << p.run_blocks << " blocks" << std::endl
+                  << "  merge levels:       " << p.merge_levels << std::endl;
+    std::cout << "  bytes read:         " << tlx::format_iec_units(p.bytes_read) << "B" << std::endl
+              << "  bytes written:      " << tlx::format_iec_units(p.bytes_written) << "B" << std::endl
+              << "  single pass memory: " << tlx::format_iec_units(p.single_pass_memory) << "B" << std::endl;
+}
+
+int do_sort_plan(int argc, char* argv[])
+{
+    stxxl::cmdline_parser cp;
+
+    cp.set_description(description);
+
+    uint64_t records = 0;
+    cp.add_param_bytes("records", records,
+                       "Number of records to sort, possibly with a suffix like 1G");
+
+    uint64_t record_size = 0;
+    cp.add_param_bytes("record-size", record_size, "Bytes per record");
+
+    uint64_t ram = 1024 * 1024 * 1024;
+    cp.add_bytes('M', "ram", ram, "Amount of RAM of the sort, default: 1 GiB");
+
+    uint64_t block_size = STXXL_DEFAULT_BLOCK_SIZE(void);
+    cp.add_bytes('B', "block-size", block_size, "Block size, default: 2 MiB");
+
+    unsigned disks = 0;
+    cp.add_uint('D', "disks", disks,
+                "Number of disks, default: the disks of the configuration");
+
+    if (!cp.process(argc, argv))
+        return -1;
+
+    if (record_size == 0 || record_size > block_size)
+    {
+        LOG1 << "The record size must be between 1 and the block size";
+        return -1;
+    }
+    if (disks == 0)
+        disks = static_cast<unsigned>(foxxll::config::get_instance()->disks_number());
+
+    std::cout << records << " records of " << record_size << " bytes, "
+              << tlx::format_iec_units(ram) << "B of RAM, "
+              << disks << " disks, blocks of " << tlx::format_iec_units(block_size) << "B"
+              << std::endl;
+
+    print_plan("stxxl::sort", stxxl::plan_sort(
+                   records, record_size, ram, disks, block_size));
+    print_plan("stream::sort", stxxl::plan_stream_sort(
+                   records, record_size, ram, disks, block_size));
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -50,8 +50,13 @@ int stxxl_info(int, char**)
 
 extern int benchmark_sort(int argc, char* argv[]);
 extern int benchmark_pqueue(int argc, char* argv[]);
+extern int benchmark_containers(int argc, char* argv[]);
+extern int do_calibrate_disks(int argc, char* argv[]);
+extern int do_sort_file(int argc, char* argv[]);
+extern int do_sort_plan(int argc, char* argv[]);
 extern int do_mlock(int argc, char* argv[]);
 extern int do_mallinfo(int argc, char* argv[]);
+extern int do_top(int argc, char* argv[]);
 
 struct SubTool
 {
@@ -75,6 +80,26 @@ struct SubTool subtools[] = {
         "benchmark_pqueue", &benchmark_pqueue, false,
         "Benchmark priority queue implementation using sequence of operations."
     },
+    {
+        "benchmark_containers", &benchmark_containers, false,
+        "Benchmark the external containers over a grid of block and cache sizes."
+    },
+    {
+        "calibrate_disks", &do_calibrate_disks, false,
+        "Measure the throughput of each configured disk and save it for the "
+        "weighted_striping allocation strategy."
+    },
+    {
+        "sort", &do_sort_file, false,
+        "Sort a binary file of fixed-size records by an integer or byte "
+        "string key, in place or into an output file, and report the phase "
+        "timings."
+    },
+    {
+        "sort_plan", &do_sort_plan, false,
+        "Predict the runs, merge levels, I/O volume and single-pass memory "
+        "of sorting n records of a given size with a given amount of RAM."
+    },
     {
         "mlock", &do_mlock, true,
         "Lock physical memory."
@@ -83,6 +108,10 @@ struct SubTool subtools[] = {
         "mallinfo", &do_mallinfo, true,
         "Show mallinfo statistics."
     },
+    {
+        "top", &do_top, false,
+        "Follow the log of a stats_sampler and show I/O and memory rates."
+    },
     { nullptr, nullptr, false, nullptr }
 };
 
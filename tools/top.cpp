@@ -0,0 +1,173 @@
+/***************************************************************************
+ *  tools/top.cpp
+ *
+ *  Part of the STXXL. See http://stxxl.org
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <tlx/string/format_iec_units.hpp>
+#include <tlx/string/split.hpp>
+
+#include <stxxl/bits/common/cmdline.h>
+
+//! One line of a stats_sampler log as key=value pairs, in the order of the
+//! line.
+using log_sample = std::vector<std::pair<std::string, double> >;
+
+static bool parse_sample(const std::string& line, log_sample& out)
+{
+    std::vector<std::string> fields = tlx::split(' ', line);
+    if (fields.empty() || fields[0] != "STATS")
+        return false;
+
+    out.clear();
+    for (size_t i = 1; i < fields.size(); ++i)
+    {
+        const std::string::size_type eq = fields[i].find('=');
+        if (eq == std::string::npos)
+            continue;
+        out.emplace_back(fields[i].substr(0, eq),
+                         std::strtod(fields[i].c_str() + eq + 1, nullptr));
+    }
+    return true;
+}
+
+static double get(const log_sample& s, const std::string& key)
+{
+    for (const std::pair<std::string, double>& kv : s)
+    {
+        if (kv.first == key)
+            return kv.second;
+    }
+    return 0;
+}
+
+static void print_header(const log_sample& s)
+{
+    std::cout << std::setw(10) << "time"
+              << std::setw(11) << "read/s" << std::setw(9) << "rd ops/s"
+              << std::setw(11) << "write/s" << std::setw(9) << "wr ops/s"
+              << std::setw(8) << "wait%" << std::setw(11) << "heap";
+    for (const std::pair<std::string, double>& kv : s)
+    {
+        if (kv.first.compare(0, 8, "counter.") == 0)
+            std::cout << ' ' << std::setw(12) << kv.first.substr(8) + "/s";
+    }
+    std::cout << std::endl;
+}
+
+//! Print the rates between two samples.
+static void print_rates(const log_sample& prev, const log_sample& cur)
+{
+    const double dt = get(cur, "time") - get(prev, "time");
+    if (dt <= 0)
+        return;
+
+    auto rate = [&](const std::string& key) {
+                    return std::max(0.0, get(cur, key) - get(prev, key)) / dt;
+                };
+
+    std::cout << std::fixed << std::setprecision(1)
+              << std::setw(10) << get(cur, "time")
+              << std::setw(10)
+              << tlx::format_iec_units(static_cast<uint64_t>(rate("read_bytes"))) << 'B'
+              << std::setw(9) << rate("read_count")
+              << std::setw(10)
+              << tlx::format_iec_units(static_cast<uint64_t>(rate("write_bytes"))) << 'B'
+              << std::setw(9) << rate("write_count")
+              << std::setw(8) << 100.0 * rate("io_wait")
+              << std::setw(10)
+              << tlx::format_iec_units(static_cast<uint64_t>(get(cur, "malloc_current"))) << 'B';
+    for (const std::pair<std::string, double>& kv : cur)
+    {
+        if (kv.first.compare(0, 8, "counter.") == 0)
+            std::cout << ' ' << std::setw(12) << rate(kv.first);
+    }
+    std::cout << std::endl;
+}
+
+int do_top(int argc, char* argv[])
+{
+    // parse command line
+    stxxl::cmdline_parser cp;
+
+    cp.set_description(
+        "Follow the log written by stxxl::stats_sampler of a running program "
+        "and print the I/O rates, the fraction of time waiting for I/O, the "
+        "heap allocation and the rates of the registered counters per "
+        "sample.");
+
+    std::string path;
+    cp.add_param_string("log", path, "Log file of the stats_sampler.");
+
+    bool once = false;
+    cp.add_flag('1', "once", once,
+                "Print the samples in the log and exit instead of following it.");
+
+    unsigned header_lines = 20;
+    cp.add_uint('H', "header", header_lines,
+                "Repeat the header every this many lines, default: 20.");
+
+    if (!cp.process(argc, argv))
+        return -1;
+
+    std::ifstream in(path.c_str());
+    if (!in.good()) {
+        std::cerr << "Cannot open log file \"" << path << "\"." << std::endl;
+        return -1;
+    }
+
+    log_sample prev, cur;
+    bool have_prev = false;
+    unsigned lines = 0;
+    std::string line, partial;
+
+    while (true)
+    {
+        const bool got = static_cast<bool>(std::getline(in, line));
+        if (!got || (in.eof() && !once))
+        {
+            if (!got && once)
+                break;
+            // keep an incomplete last line and wait for the writer
+            if (got)
+                partial += line;
+            in.clear();
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            continue;
+        }
+        line = partial + line;
+        partial.clear();
+
+        if (!parse_sample(line, cur))
+            continue;
+
+        if (have_prev)
+        {
+            if (header_lines != 0 && lines++ % header_lines == 0)
+                print_header(cur);
+            print_rates(prev, cur);
+        }
+        prev.swap(cur);
+        have_prev = true;
+    }
+
+    return 0;
+}
+
+/******************************************************************************/